@@ -19,22 +19,11 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
+#include "backends/aiger/aigerwriter.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
-void aiger_encode(std::ostream &f, int x)
-{
-	log_assert(x >= 0);
-
-	while (x & ~0x7f) {
-		f.put((x & 0x7f) | 0x80);
-		x = x >> 7;
-	}
-
-	f.put(x);
-}
-
 struct AigerWriter
 {
 	Module *module;
@@ -54,7 +43,7 @@ struct AigerWriter
 	int aig_m = 0, aig_i = 0, aig_l = 0, aig_o = 0, aig_a = 0;
 	int aig_b = 0, aig_c = 0, aig_j = 0, aig_f = 0;
 
-	dict<SigBit, int> aig_map;
+	AigerLitMap aig_map;
 	dict<SigBit, int> ordered_outputs;
 	dict<SigBit, int> ordered_latches;
 
@@ -70,30 +59,28 @@ struct AigerWriter
 
 	int bit2aig(SigBit bit)
 	{
-		auto it = aig_map.find(bit);
-		if (it != aig_map.end()) {
-			log_assert(it->second >= 0);
-			return it->second;
-		}
-
-		// NB: Cannot use iterator returned from aig_map.insert()
-		//     since this function is called recursively
+		const int *lit = aig_map.find(bit);
+		if (lit != nullptr)
+			return *lit;
 
 		int a = -1;
-		if (not_map.count(bit)) {
-			a = bit2aig(not_map.at(bit)) ^ 1;
-		} else
-		if (and_map.count(bit)) {
-			auto args = and_map.at(bit);
-			int a0 = bit2aig(args.first);
-			int a1 = bit2aig(args.second);
-			a = mkgate(a0, a1);
-		} else
-		if (alias_map.count(bit)) {
-			a = bit2aig(alias_map.at(bit));
-		} else
-		if (initstate_bits.count(bit)) {
-			a = initstate_ff;
+		auto not_it = not_map.find(bit);
+		if (not_it != not_map.end()) {
+			a = bit2aig(not_it->second) ^ 1;
+		} else {
+			auto and_it = and_map.find(bit);
+			if (and_it != and_map.end()) {
+				auto args = and_it->second;
+				int a0 = bit2aig(args.first);
+				int a1 = bit2aig(args.second);
+				a = mkgate(a0, a1);
+			} else {
+				auto alias_it = alias_map.find(bit);
+				if (alias_it != alias_map.end())
+					a = bit2aig(alias_it->second);
+				else if (initstate_bits.count(bit))
+					a = initstate_ff;
+			}
 		}
 
 		if (bit == State::Sx || bit == State::Sz)
@@ -104,7 +91,7 @@ struct AigerWriter
 		return a;
 	}
 
-	AigerWriter(Module *module, bool zinit_mode, bool imode, bool omode, bool bmode, bool lmode) : module(module), zinit_mode(zinit_mode), sigmap(module)
+	AigerWriter(Module *module, bool zinit_mode, bool imode, bool omode, bool bmode, bool lmode) : module(module), zinit_mode(zinit_mode), sigmap(module), aig_map(module)
 	{
 		pool<SigBit> undriven_bits;
 		pool<SigBit> unused_bits;
@@ -472,69 +459,73 @@ struct AigerWriter
 			f << stringf("\n");
 		}
 
+		AigerOutBuffer out(f);
+
 		if (ascii_mode)
 		{
 			for (int i = 0; i < aig_i; i++)
-				f << stringf("%d\n", 2*i+2);
+				out.put_line(2*i+2);
 
 			for (int i = 0; i < aig_l; i++) {
 				if (zinit_mode || aig_latchinit.at(i) == 0)
-					f << stringf("%d %d\n", 2*(aig_i+i)+2, aig_latchin.at(i));
+					out.put_line(2*(aig_i+i)+2, aig_latchin[i]);
 				else if (aig_latchinit.at(i) == 1)
-					f << stringf("%d %d 1\n", 2*(aig_i+i)+2, aig_latchin.at(i));
+					out.put_line(2*(aig_i+i)+2, aig_latchin[i], 1);
 				else if (aig_latchinit.at(i) == 2)
-					f << stringf("%d %d %d\n", 2*(aig_i+i)+2, aig_latchin.at(i), 2*(aig_i+i)+2);
+					out.put_line(2*(aig_i+i)+2, aig_latchin[i], 2*(aig_i+i)+2);
 			}
 
 			for (int i = 0; i < aig_obc; i++)
-				f << stringf("%d\n", aig_outputs.at(i));
+				out.put_line(aig_outputs[i]);
 
 			for (int i = aig_obc; i < aig_obcj; i++)
-				f << stringf("1\n");
+				out.put_line(1);
 
 			for (int i = aig_obc; i < aig_obcj; i++)
-				f << stringf("%d\n", aig_outputs.at(i));
+				out.put_line(aig_outputs[i]);
 
 			for (int i = aig_obcj; i < aig_obcjf; i++)
-				f << stringf("%d\n", aig_outputs.at(i));
+				out.put_line(aig_outputs[i]);
 
 			for (int i = 0; i < aig_a; i++)
-				f << stringf("%d %d %d\n", 2*(aig_i+aig_l+i)+2, aig_gates.at(i).first, aig_gates.at(i).second);
+				out.put_line(2*(aig_i+aig_l+i)+2, aig_gates[i].first, aig_gates[i].second);
 		}
 		else
 		{
 			for (int i = 0; i < aig_l; i++) {
 				if (zinit_mode || aig_latchinit.at(i) == 0)
-					f << stringf("%d\n", aig_latchin.at(i));
+					out.put_line(aig_latchin[i]);
 				else if (aig_latchinit.at(i) == 1)
-					f << stringf("%d 1\n", aig_latchin.at(i));
+					out.put_line(aig_latchin[i], 1);
 				else if (aig_latchinit.at(i) == 2)
-					f << stringf("%d %d\n", aig_latchin.at(i), 2*(aig_i+i)+2);
+					out.put_line(aig_latchin[i], 2*(aig_i+i)+2);
 			}
 
 			for (int i = 0; i < aig_obc; i++)
-				f << stringf("%d\n", aig_outputs.at(i));
+				out.put_line(aig_outputs[i]);
 
 			for (int i = aig_obc; i < aig_obcj; i++)
-				f << stringf("1\n");
+				out.put_line(1);
 
 			for (int i = aig_obc; i < aig_obcj; i++)
-				f << stringf("%d\n", aig_outputs.at(i));
+				out.put_line(aig_outputs[i]);
 
 			for (int i = aig_obcj; i < aig_obcjf; i++)
-				f << stringf("%d\n", aig_outputs.at(i));
+				out.put_line(aig_outputs[i]);
 
 			for (int i = 0; i < aig_a; i++) {
 				int lhs = 2*(aig_i+aig_l+i)+2;
-				int rhs0 = aig_gates.at(i).first;
-				int rhs1 = aig_gates.at(i).second;
+				int rhs0 = aig_gates[i].first;
+				int rhs1 = aig_gates[i].second;
 				int delta0 = lhs - rhs0;
 				int delta1 = rhs0 - rhs1;
-				aiger_encode(f, delta0);
-				aiger_encode(f, delta1);
+				out.encode(delta0);
+				out.encode(delta1);
 			}
 		}
 
+		out.flush();
+
 		if (symbols_mode)
 		{
 			dict<string, vector<string>> symbols;
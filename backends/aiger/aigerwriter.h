@@ -0,0 +1,194 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef AIGERWRITER_H
+#define AIGERWRITER_H
+
+#include "kernel/yosys.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// Map from the bits of one module to AIGER literals. Every wire bit and every
+// constant state gets a slot in a flat vector, so lookups do not need to hash
+// the SigBit. Only the wire is looked up, and consecutive bits of the same
+// wire skip even that.
+struct AigerLitMap
+{
+	dict<RTLIL::Wire*, int> wire_offset;
+	std::vector<int> lits;
+	int num_entries = 0;
+
+	mutable RTLIL::Wire *last_wire = nullptr;
+	mutable int last_offset = 0;
+
+	AigerLitMap(RTLIL::Module *module)
+	{
+		// the first slots are for the constants, indexed by State
+		int offset = RTLIL::Sm + 1;
+		for (auto wire : module->wires()) {
+			wire_offset[wire] = offset;
+			offset += wire->width;
+		}
+		lits.resize(offset, -1);
+	}
+
+	int index(const RTLIL::SigBit &bit) const
+	{
+		if (bit.wire == nullptr)
+			return bit.data;
+		if (bit.wire != last_wire) {
+			auto it = wire_offset.find(bit.wire);
+			log_assert(it != wire_offset.end());
+			last_wire = bit.wire;
+			last_offset = it->second;
+		}
+		return last_offset + bit.offset;
+	}
+
+	// returns nullptr if the bit has no literal yet
+	const int *find(const RTLIL::SigBit &bit) const
+	{
+		const int &lit = lits[index(bit)];
+		return lit < 0 ? nullptr : &lit;
+	}
+
+	int count(const RTLIL::SigBit &bit) const
+	{
+		return lits[index(bit)] < 0 ? 0 : 1;
+	}
+
+	int at(const RTLIL::SigBit &bit) const
+	{
+		int lit = lits[index(bit)];
+		log_assert(lit >= 0);
+		return lit;
+	}
+
+	// like dict::operator[], a new entry starts out as literal 0
+	int &operator[](const RTLIL::SigBit &bit)
+	{
+		int &lit = lits[index(bit)];
+		if (lit < 0) {
+			lit = 0;
+			num_entries++;
+		}
+		return lit;
+	}
+
+	int size() const
+	{
+		return num_entries;
+	}
+};
+
+// Output buffer for AIGER files: numbers and binary deltas are formatted into
+// a block of memory that is handed to the stream in one write when it is full.
+struct AigerOutBuffer
+{
+	std::ostream &f;
+	std::string buffer;
+
+	static const size_t block_size = 1 << 16;
+
+	AigerOutBuffer(std::ostream &f) : f(f)
+	{
+		buffer.reserve(block_size + 64);
+	}
+
+	~AigerOutBuffer()
+	{
+		flush();
+	}
+
+	void flush()
+	{
+		f.write(buffer.data(), buffer.size());
+		buffer.clear();
+	}
+
+	void check_flush()
+	{
+		if (buffer.size() >= block_size)
+			flush();
+	}
+
+	void put(char c)
+	{
+		buffer += c;
+	}
+
+	void put(const std::string &str)
+	{
+		buffer += str;
+		check_flush();
+	}
+
+	void put_int(int x)
+	{
+		log_assert(x >= 0);
+		char digits[16];
+		int n = 0;
+		do {
+			digits[n++] = '0' + x % 10;
+			x /= 10;
+		} while (x != 0);
+		while (n > 0)
+			buffer += digits[--n];
+		check_flush();
+	}
+
+	// one line of space separated numbers
+	void put_line(int a)
+	{
+		put_int(a);
+		put('\n');
+	}
+
+	void put_line(int a, int b)
+	{
+		put_int(a);
+		put(' ');
+		put_line(b);
+	}
+
+	void put_line(int a, int b, int c)
+	{
+		put_int(a);
+		put(' ');
+		put_line(b, c);
+	}
+
+	// variable length delta as used for the AND gates of binary AIGER files
+	void encode(int x)
+	{
+		log_assert(x >= 0);
+
+		while (x & ~0x7f) {
+			buffer += (char)((x & 0x7f) | 0x80);
+			x = x >> 7;
+		}
+
+		buffer += (char)x;
+		check_flush();
+	}
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
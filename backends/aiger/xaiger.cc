@@ -47,6 +47,7 @@ inline static uint32_t bswap32(uint32_t x)
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
 #include "kernel/utils.h"
+#include "backends/aiger/aigerwriter.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -61,18 +62,6 @@ inline int32_t to_big_endian(int32_t i32) {
 #endif
 }
 
-void aiger_encode(std::ostream &f, int x)
-{
-	log_assert(x >= 0);
-
-	while (x & ~0x7f) {
-		f.put((x & 0x7f) | 0x80);
-		x = x >> 7;
-	}
-
-	f.put(x);
-}
-
 struct XAigerWriter
 {
 	Module *module;
@@ -89,7 +78,7 @@ struct XAigerWriter
 	vector<int> aig_outputs;
 	int aig_m = 0, aig_i = 0, aig_l = 0, aig_o = 0, aig_a = 0;
 
-	dict<SigBit, int> aig_map;
+	AigerLitMap aig_map;
 	dict<SigBit, int> ordered_outputs;
 
 	vector<Cell*> box_list;
@@ -103,27 +92,26 @@ struct XAigerWriter
 
 	int bit2aig(SigBit bit)
 	{
-		auto it = aig_map.find(bit);
-		if (it != aig_map.end()) {
-			log_assert(it->second >= 0);
-			return it->second;
-		}
-
-		// NB: Cannot use iterator returned from aig_map.insert()
-		//     since this function is called recursively
+		const int *lit = aig_map.find(bit);
+		if (lit != nullptr)
+			return *lit;
 
 		int a = -1;
-		if (not_map.count(bit)) {
-			a = bit2aig(not_map.at(bit)) ^ 1;
-		} else
-		if (and_map.count(bit)) {
-			auto args = and_map.at(bit);
-			int a0 = bit2aig(args.first);
-			int a1 = bit2aig(args.second);
-			a = mkgate(a0, a1);
-		} else
-		if (alias_map.count(bit)) {
-			a = bit2aig(alias_map.at(bit));
+		auto not_it = not_map.find(bit);
+		if (not_it != not_map.end()) {
+			a = bit2aig(not_it->second) ^ 1;
+		} else {
+			auto and_it = and_map.find(bit);
+			if (and_it != and_map.end()) {
+				auto args = and_it->second;
+				int a0 = bit2aig(args.first);
+				int a1 = bit2aig(args.second);
+				a = mkgate(a0, a1);
+			} else {
+				auto alias_it = alias_map.find(bit);
+				if (alias_it != alias_map.end())
+					a = bit2aig(alias_it->second);
+			}
 		}
 
 		if (bit == State::Sx || bit == State::Sz) {
@@ -136,7 +124,7 @@ struct XAigerWriter
 		return a;
 	}
 
-	XAigerWriter(Module *module, bool holes_mode=false) : module(module), sigmap(module)
+	XAigerWriter(Module *module, bool holes_mode=false) : module(module), sigmap(module), aig_map(module)
 	{
 		pool<SigBit> undriven_bits;
 		pool<SigBit> unused_bits;
@@ -515,46 +503,50 @@ struct XAigerWriter
 
 		if (ascii_mode)
 		{
+			AigerOutBuffer out(f);
+
 			for (int i = 0; i < aig_i; i++)
-				f << stringf("%d\n", 2*i+2);
+				out.put_line(2*i+2);
 
 			for (int i = 0; i < aig_obc; i++)
-				f << stringf("%d\n", aig_outputs.at(i));
+				out.put_line(aig_outputs[i]);
 
 			for (int i = aig_obc; i < aig_obcj; i++)
-				f << stringf("1\n");
+				out.put_line(1);
 
 			for (int i = aig_obc; i < aig_obcj; i++)
-				f << stringf("%d\n", aig_outputs.at(i));
+				out.put_line(aig_outputs[i]);
 
 			for (int i = aig_obcj; i < aig_obcjf; i++)
-				f << stringf("%d\n", aig_outputs.at(i));
+				out.put_line(aig_outputs[i]);
 
 			for (int i = 0; i < aig_a; i++)
-				f << stringf("%d %d %d\n", 2*(aig_i+aig_l+i)+2, aig_gates.at(i).first, aig_gates.at(i).second);
+				out.put_line(2*(aig_i+aig_l+i)+2, aig_gates[i].first, aig_gates[i].second);
 		}
 		else
 		{
+			AigerOutBuffer out(f);
+
 			for (int i = 0; i < aig_obc; i++)
-				f << stringf("%d\n", aig_outputs.at(i));
+				out.put_line(aig_outputs[i]);
 
 			for (int i = aig_obc; i < aig_obcj; i++)
-				f << stringf("1\n");
+				out.put_line(1);
 
 			for (int i = aig_obc; i < aig_obcj; i++)
-				f << stringf("%d\n", aig_outputs.at(i));
+				out.put_line(aig_outputs[i]);
 
 			for (int i = aig_obcj; i < aig_obcjf; i++)
-				f << stringf("%d\n", aig_outputs.at(i));
+				out.put_line(aig_outputs[i]);
 
 			for (int i = 0; i < aig_a; i++) {
 				int lhs = 2*(aig_i+aig_l+i)+2;
-				int rhs0 = aig_gates.at(i).first;
-				int rhs1 = aig_gates.at(i).second;
+				int rhs0 = aig_gates[i].first;
+				int rhs1 = aig_gates[i].second;
 				int delta0 = lhs - rhs0;
 				int delta1 = rhs0 - rhs1;
-				aiger_encode(f, delta0);
-				aiger_encode(f, delta1);
+				out.encode(delta0);
+				out.encode(delta1);
 			}
 		}
 
@@ -25,6 +25,7 @@
 #include "kernel/register.h"
 #include "kernel/sigtools.h"
 #include "kernel/celltypes.h"
+#include "kernel/emitter.h"
 #include "kernel/log.h"
 #include <string>
 
@@ -56,7 +57,7 @@ struct BlifDumperConfig
 
 struct BlifDumper
 {
-	std::ostream &f;
+	EmitBuffer &f;
 	RTLIL::Module *module;
 	RTLIL::Design *design;
 	BlifDumperConfig *config;
@@ -65,8 +66,13 @@ struct BlifDumper
 	SigMap sigmap;
 	dict<SigBit, int> init_bits;
 
-	BlifDumper(std::ostream &f, RTLIL::Module *module, RTLIL::Design *design, BlifDumperConfig *config) :
-			f(f), module(module), design(design), config(config), ct(design), sigmap(module)
+	EmitNames<RTLIL::IdString> id_names;
+	EmitNames<RTLIL::SigBit> bit_names;
+	pool<SigBit> cstr_bits_seen;
+
+	BlifDumper(EmitBuffer &f, RTLIL::Module *module, RTLIL::Design *design, BlifDumperConfig *config) :
+			f(f), module(module), design(design), config(config), ct(design), sigmap(module),
+			id_names(escape_id), bit_names(escape_bit)
 	{
 		for (Wire *wire : module->wires())
 			if (wire->attributes.count("\\init")) {
@@ -86,17 +92,26 @@ struct BlifDumper
 			}
 	}
 
-	vector<shared_str> cstr_buf;
-	pool<SigBit> cstr_bits_seen;
-
-	const char *cstr(RTLIL::IdString id)
+	static std::string escape_id(const RTLIL::IdString &id)
 	{
 		std::string str = RTLIL::unescape_id(id);
 		for (size_t i = 0; i < str.size(); i++)
 			if (str[i] == '#' || str[i] == '=' || str[i] == '<' || str[i] == '>')
 				str[i] = '?';
-		cstr_buf.push_back(str);
-		return cstr_buf.back().c_str();
+		return str;
+	}
+
+	static std::string escape_bit(const RTLIL::SigBit &sig)
+	{
+		std::string str = escape_id(sig.wire->name);
+		if (sig.wire->width != 1)
+			str += stringf("[%d]", sig.wire->upto ? sig.wire->start_offset+sig.wire->width-sig.offset-1 : sig.wire->start_offset+sig.offset);
+		return str;
+	}
+
+	const char *cstr(RTLIL::IdString id)
+	{
+		return id_names(id).c_str();
 	}
 
 	const char *cstr(RTLIL::SigBit sig)
@@ -109,29 +124,34 @@ struct BlifDumper
 			return config->undef_type == "-" || config->undef_type == "+" ? config->undef_out.c_str() : "$undef";
 		}
 
-		std::string str = RTLIL::unescape_id(sig.wire->name);
-		for (size_t i = 0; i < str.size(); i++)
-			if (str[i] == '#' || str[i] == '=' || str[i] == '<' || str[i] == '>')
-				str[i] = '?';
-
-		if (sig.wire->width != 1)
-			str += stringf("[%d]", sig.wire->upto ? sig.wire->start_offset+sig.wire->width-sig.offset-1 : sig.wire->start_offset+sig.offset);
-
-		cstr_buf.push_back(str);
-		return cstr_buf.back().c_str();
+		return bit_names(sig).c_str();
 	}
 
 	const char *cstr_init(RTLIL::SigBit sig)
 	{
 		sigmap.apply(sig);
 
-		if (init_bits.count(sig) == 0)
+		auto it = init_bits.find(sig);
+		if (it == init_bits.end())
 			return " 2";
+		return it->second ? " 1" : " 0";
+	}
 
-		string str = stringf(" %d", init_bits.at(sig));
+	// a .names statement with the signals of the ports and the given table
+	void dump_names(RTLIL::Cell *cell, std::initializer_list<RTLIL::IdString> ports, const char *table)
+	{
+		f << ".names";
+		for (auto &port : ports)
+			f << ' ' << cstr(cell->getPort(port));
+		f << '\n' << table;
+	}
 
-		cstr_buf.push_back(str);
-		return cstr_buf.back().c_str();
+	void dump_latch(RTLIL::Cell *cell, const char *type)
+	{
+		f << ".latch " << cstr(cell->getPort(ID(D))) << ' ' << cstr(cell->getPort(ID(Q)));
+		if (type != nullptr)
+			f << ' ' << type << ' ' << cstr(cell->getPort(cell->hasPort(ID(C)) ? ID(C) : ID(E)));
+		f << cstr_init(cell->getPort(ID(Q))) << '\n';
 	}
 
 	const char *subckt_or_gate(std::string cell_type)
@@ -167,7 +187,7 @@ struct BlifDumper
 
 	void dump()
 	{
-		f << stringf("\n");
+		f << '\n';
 		f << stringf(".model %s\n", cstr(module->name));
 
 		std::map<int, RTLIL::Wire*> inputs, outputs;
@@ -180,21 +200,21 @@ struct BlifDumper
 				outputs[wire->port_id] = wire;
 		}
 
-		f << stringf(".inputs");
+		f << ".inputs";
 		for (auto &it : inputs) {
 			RTLIL::Wire *wire = it.second;
 			for (int i = 0; i < wire->width; i++)
-				f << stringf(" %s", cstr(RTLIL::SigSpec(wire, i)));
+				f << ' ' << cstr(RTLIL::SigSpec(wire, i));
 		}
-		f << stringf("\n");
+		f << '\n';
 
-		f << stringf(".outputs");
+		f << ".outputs";
 		for (auto &it : outputs) {
 			RTLIL::Wire *wire = it.second;
 			for (int i = 0; i < wire->width; i++)
-				f << stringf(" %s", cstr(RTLIL::SigSpec(wire, i)));
+				f << ' ' << cstr(RTLIL::SigSpec(wire, i));
 		}
-		f << stringf("\n");
+		f << '\n';
 
 		if (module->get_blackbox_attribute()) {
 			f << stringf(".blackbox\n");
@@ -235,146 +255,121 @@ struct BlifDumper
 
 			if (config->unbuf_types.count(cell->type)) {
 				auto portnames = config->unbuf_types.at(cell->type);
-				f << stringf(".names %s %s\n1 1\n",
-						cstr(cell->getPort(portnames.first)), cstr(cell->getPort(portnames.second)));
+				f << ".names " << cstr(cell->getPort(portnames.first)) << ' ' << cstr(cell->getPort(portnames.second)) << "\n1 1\n";
 				continue;
 			}
 
-			if (!config->icells_mode && cell->type == "$_NOT_") {
-				f << stringf(".names %s %s\n0 1\n",
-						cstr(cell->getPort("\\A")), cstr(cell->getPort("\\Y")));
+			if (!config->icells_mode && cell->type == ID($_NOT_)) {
+				dump_names(cell, {ID::A, ID::Y}, "0 1\n");
 				goto internal_cell;
 			}
 
-			if (!config->icells_mode && cell->type == "$_AND_") {
-				f << stringf(".names %s %s %s\n11 1\n",
-						cstr(cell->getPort("\\A")), cstr(cell->getPort("\\B")), cstr(cell->getPort("\\Y")));
+			if (!config->icells_mode && cell->type == ID($_AND_)) {
+				dump_names(cell, {ID::A, ID::B, ID::Y}, "11 1\n");
 				goto internal_cell;
 			}
 
-			if (!config->icells_mode && cell->type == "$_OR_") {
-				f << stringf(".names %s %s %s\n1- 1\n-1 1\n",
-						cstr(cell->getPort("\\A")), cstr(cell->getPort("\\B")), cstr(cell->getPort("\\Y")));
+			if (!config->icells_mode && cell->type == ID($_OR_)) {
+				dump_names(cell, {ID::A, ID::B, ID::Y}, "1- 1\n-1 1\n");
 				goto internal_cell;
 			}
 
-			if (!config->icells_mode && cell->type == "$_XOR_") {
-				f << stringf(".names %s %s %s\n10 1\n01 1\n",
-						cstr(cell->getPort("\\A")), cstr(cell->getPort("\\B")), cstr(cell->getPort("\\Y")));
+			if (!config->icells_mode && cell->type == ID($_XOR_)) {
+				dump_names(cell, {ID::A, ID::B, ID::Y}, "10 1\n01 1\n");
 				goto internal_cell;
 			}
 
-			if (!config->icells_mode && cell->type == "$_NAND_") {
-				f << stringf(".names %s %s %s\n0- 1\n-0 1\n",
-						cstr(cell->getPort("\\A")), cstr(cell->getPort("\\B")), cstr(cell->getPort("\\Y")));
+			if (!config->icells_mode && cell->type == ID($_NAND_)) {
+				dump_names(cell, {ID::A, ID::B, ID::Y}, "0- 1\n-0 1\n");
 				goto internal_cell;
 			}
 
-			if (!config->icells_mode && cell->type == "$_NOR_") {
-				f << stringf(".names %s %s %s\n00 1\n",
-						cstr(cell->getPort("\\A")), cstr(cell->getPort("\\B")), cstr(cell->getPort("\\Y")));
+			if (!config->icells_mode && cell->type == ID($_NOR_)) {
+				dump_names(cell, {ID::A, ID::B, ID::Y}, "00 1\n");
 				goto internal_cell;
 			}
 
-			if (!config->icells_mode && cell->type == "$_XNOR_") {
-				f << stringf(".names %s %s %s\n11 1\n00 1\n",
-						cstr(cell->getPort("\\A")), cstr(cell->getPort("\\B")), cstr(cell->getPort("\\Y")));
+			if (!config->icells_mode && cell->type == ID($_XNOR_)) {
+				dump_names(cell, {ID::A, ID::B, ID::Y}, "11 1\n00 1\n");
 				goto internal_cell;
 			}
 
-			if (!config->icells_mode && cell->type == "$_ANDNOT_") {
-				f << stringf(".names %s %s %s\n10 1\n",
-						cstr(cell->getPort("\\A")), cstr(cell->getPort("\\B")), cstr(cell->getPort("\\Y")));
+			if (!config->icells_mode && cell->type == ID($_ANDNOT_)) {
+				dump_names(cell, {ID::A, ID::B, ID::Y}, "10 1\n");
 				goto internal_cell;
 			}
 
-			if (!config->icells_mode && cell->type == "$_ORNOT_") {
-				f << stringf(".names %s %s %s\n1- 1\n-0 1\n",
-						cstr(cell->getPort("\\A")), cstr(cell->getPort("\\B")), cstr(cell->getPort("\\Y")));
+			if (!config->icells_mode && cell->type == ID($_ORNOT_)) {
+				dump_names(cell, {ID::A, ID::B, ID::Y}, "1- 1\n-0 1\n");
 				goto internal_cell;
 			}
 
-			if (!config->icells_mode && cell->type == "$_AOI3_") {
-				f << stringf(".names %s %s %s %s\n-00 1\n0-0 1\n",
-						cstr(cell->getPort("\\A")), cstr(cell->getPort("\\B")), cstr(cell->getPort("\\C")), cstr(cell->getPort("\\Y")));
+			if (!config->icells_mode && cell->type == ID($_AOI3_)) {
+				dump_names(cell, {ID::A, ID::B, ID(C), ID::Y}, "-00 1\n0-0 1\n");
 				goto internal_cell;
 			}
 
-			if (!config->icells_mode && cell->type == "$_OAI3_") {
-				f << stringf(".names %s %s %s %s\n00- 1\n--0 1\n",
-						cstr(cell->getPort("\\A")), cstr(cell->getPort("\\B")), cstr(cell->getPort("\\C")), cstr(cell->getPort("\\Y")));
+			if (!config->icells_mode && cell->type == ID($_OAI3_)) {
+				dump_names(cell, {ID::A, ID::B, ID(C), ID::Y}, "00- 1\n--0 1\n");
 				goto internal_cell;
 			}
 
-			if (!config->icells_mode && cell->type == "$_AOI4_") {
-				f << stringf(".names %s %s %s %s %s\n-0-0 1\n-00- 1\n0--0 1\n0-0- 1\n",
-						cstr(cell->getPort("\\A")), cstr(cell->getPort("\\B")),
-						cstr(cell->getPort("\\C")), cstr(cell->getPort("\\D")), cstr(cell->getPort("\\Y")));
+			if (!config->icells_mode && cell->type == ID($_AOI4_)) {
+				dump_names(cell, {ID::A, ID::B, ID(C), ID(D), ID::Y}, "-0-0 1\n-00- 1\n0--0 1\n0-0- 1\n");
 				goto internal_cell;
 			}
 
-			if (!config->icells_mode && cell->type == "$_OAI4_") {
-				f << stringf(".names %s %s %s %s %s\n00-- 1\n--00 1\n",
-						cstr(cell->getPort("\\A")), cstr(cell->getPort("\\B")),
-						cstr(cell->getPort("\\C")), cstr(cell->getPort("\\D")), cstr(cell->getPort("\\Y")));
+			if (!config->icells_mode && cell->type == ID($_OAI4_)) {
+				dump_names(cell, {ID::A, ID::B, ID(C), ID(D), ID::Y}, "00-- 1\n--00 1\n");
 				goto internal_cell;
 			}
 
-			if (!config->icells_mode && cell->type == "$_MUX_") {
-				f << stringf(".names %s %s %s %s\n1-0 1\n-11 1\n",
-						cstr(cell->getPort("\\A")), cstr(cell->getPort("\\B")),
-						cstr(cell->getPort("\\S")), cstr(cell->getPort("\\Y")));
+			if (!config->icells_mode && cell->type == ID($_MUX_)) {
+				dump_names(cell, {ID::A, ID::B, ID(S), ID::Y}, "1-0 1\n-11 1\n");
 				goto internal_cell;
 			}
 
-			if (!config->icells_mode && cell->type == "$_NMUX_") {
-				f << stringf(".names %s %s %s %s\n0-0 1\n-01 1\n",
-						cstr(cell->getPort("\\A")), cstr(cell->getPort("\\B")),
-						cstr(cell->getPort("\\S")), cstr(cell->getPort("\\Y")));
+			if (!config->icells_mode && cell->type == ID($_NMUX_)) {
+				dump_names(cell, {ID::A, ID::B, ID(S), ID::Y}, "0-0 1\n-01 1\n");
 				goto internal_cell;
 			}
 
-			if (!config->icells_mode && cell->type == "$_FF_") {
-				f << stringf(".latch %s %s%s\n", cstr(cell->getPort("\\D")), cstr(cell->getPort("\\Q")),
-						cstr_init(cell->getPort("\\Q")));
+			if (!config->icells_mode && cell->type == ID($_FF_)) {
+				dump_latch(cell, nullptr);
 				goto internal_cell;
 			}
 
-			if (!config->icells_mode && cell->type == "$_DFF_N_") {
-				f << stringf(".latch %s %s fe %s%s\n", cstr(cell->getPort("\\D")), cstr(cell->getPort("\\Q")),
-						cstr(cell->getPort("\\C")), cstr_init(cell->getPort("\\Q")));
+			if (!config->icells_mode && cell->type == ID($_DFF_N_)) {
+				dump_latch(cell, "fe");
 				goto internal_cell;
 			}
 
-			if (!config->icells_mode && cell->type == "$_DFF_P_") {
-				f << stringf(".latch %s %s re %s%s\n", cstr(cell->getPort("\\D")), cstr(cell->getPort("\\Q")),
-						cstr(cell->getPort("\\C")), cstr_init(cell->getPort("\\Q")));
+			if (!config->icells_mode && cell->type == ID($_DFF_P_)) {
+				dump_latch(cell, "re");
 				goto internal_cell;
 			}
 
-			if (!config->icells_mode && cell->type == "$_DLATCH_N_") {
-				f << stringf(".latch %s %s al %s%s\n", cstr(cell->getPort("\\D")), cstr(cell->getPort("\\Q")),
-						cstr(cell->getPort("\\E")), cstr_init(cell->getPort("\\Q")));
+			if (!config->icells_mode && cell->type == ID($_DLATCH_N_)) {
+				dump_latch(cell, "al");
 				goto internal_cell;
 			}
 
-			if (!config->icells_mode && cell->type == "$_DLATCH_P_") {
-				f << stringf(".latch %s %s ah %s%s\n", cstr(cell->getPort("\\D")), cstr(cell->getPort("\\Q")),
-						cstr(cell->getPort("\\E")), cstr_init(cell->getPort("\\Q")));
+			if (!config->icells_mode && cell->type == ID($_DLATCH_P_)) {
+				dump_latch(cell, "ah");
 				goto internal_cell;
 			}
 
-			if (!config->icells_mode && cell->type == "$lut") {
-				f << stringf(".names");
-				auto &inputs = cell->getPort("\\A");
+			if (!config->icells_mode && cell->type == ID($lut)) {
+				f << ".names";
+				auto &inputs = cell->getPort(ID::A);
 				auto width = cell->parameters.at("\\WIDTH").as_int();
 				log_assert(inputs.size() == width);
 				for (int i = width-1; i >= 0; i--)
-					f << stringf(" %s", cstr(inputs.extract(i, 1)));
-				auto &output = cell->getPort("\\Y");
+					f << ' ' << cstr(inputs[i]);
+				auto &output = cell->getPort(ID::Y);
 				log_assert(output.size() == 1);
-				f << stringf(" %s", cstr(output));
-				f << stringf("\n");
+				f << ' ' << cstr(output);
+				f << '\n';
 				RTLIL::SigSpec mask = cell->parameters.at("\\LUT");
 				for (int i = 0; i < (1 << width); i++)
 					if (mask[i] == State::S1) {
@@ -386,21 +381,21 @@ struct BlifDumper
 				goto internal_cell;
 			}
 
-			if (!config->icells_mode && cell->type == "$sop") {
-				f << stringf(".names");
-				auto &inputs = cell->getPort("\\A");
+			if (!config->icells_mode && cell->type == ID($sop)) {
+				f << ".names";
+				auto &inputs = cell->getPort(ID::A);
 				auto width = cell->parameters.at("\\WIDTH").as_int();
 				auto depth = cell->parameters.at("\\DEPTH").as_int();
-				vector<State> table = cell->parameters.at("\\TABLE").bits;
+				vector<State> table = cell->parameters.at("\\TABLE").to_bits();
 				while (GetSize(table) < 2*width*depth)
 					table.push_back(State::S0);
 				log_assert(inputs.size() == width);
 				for (int i = 0; i < width; i++)
-					f << stringf(" %s", cstr(inputs.extract(i, 1)));
-				auto &output = cell->getPort("\\Y");
+					f << ' ' << cstr(inputs[i]);
+				auto &output = cell->getPort(ID::Y);
 				log_assert(output.size() == 1);
-				f << stringf(" %s", cstr(output));
-				f << stringf("\n");
+				f << ' ' << cstr(output);
+				f << '\n';
 				for (int i = 0; i < depth; i++) {
 					for (int j = 0; j < width; j++) {
 						bool pat0 = table.at(2*width*i + 2*j + 0) == State::S1;
@@ -414,11 +409,11 @@ struct BlifDumper
 				goto internal_cell;
 			}
 
-			f << stringf(".%s %s", subckt_or_gate(cell->type.str()), cstr(cell->type));
+			f << '.' << subckt_or_gate(cell->type.str()) << ' ' << cstr(cell->type);
 			for (auto &conn : cell->connections())
 			{
 				if (conn.second.size() == 1) {
-					f << stringf(" %s=%s", cstr(conn.first), cstr(conn.second[0]));
+					f << ' ' << cstr(conn.first) << '=' << cstr(conn.second[0]);
 					continue;
 				}
 
@@ -427,17 +422,17 @@ struct BlifDumper
 
 				if (w == nullptr) {
 					for (int i = 0; i < GetSize(conn.second); i++)
-						f << stringf(" %s[%d]=%s", cstr(conn.first), i, cstr(conn.second[i]));
+						f << ' ' << cstr(conn.first) << '[' << i << "]=" << cstr(conn.second[i]);
 				} else {
 					for (int i = 0; i < std::min(GetSize(conn.second), GetSize(w)); i++) {
 						SigBit sig(w, i);
-						f << stringf(" %s[%d]=%s", cstr(conn.first), sig.wire->upto ?
+						f << ' ' << cstr(conn.first) << '[' << (sig.wire->upto ?
 								sig.wire->start_offset+sig.wire->width-sig.offset-1 :
-								sig.wire->start_offset+sig.offset, cstr(conn.second[i]));
+								sig.wire->start_offset+sig.offset) << "]=" << cstr(conn.second[i]);
 					}
 				}
 			}
-			f << stringf("\n");
+			f << '\n';
 
 			if (config->cname_mode)
 				f << stringf(".cname %s\n", cstr(cell->name));
@@ -465,18 +460,18 @@ struct BlifDumper
 				continue;
 
 			if (config->conn_mode)
-				f << stringf(".conn %s %s\n", cstr(rhs_bit), cstr(lhs_bit));
+				f << ".conn " << cstr(rhs_bit) << ' ' << cstr(lhs_bit) << '\n';
 			else if (!config->buf_type.empty())
 				f << stringf(".%s %s %s=%s %s=%s\n", subckt_or_gate(config->buf_type), config->buf_type.c_str(),
 						config->buf_in.c_str(), cstr(rhs_bit), config->buf_out.c_str(), cstr(lhs_bit));
 			else
-				f << stringf(".names %s %s\n1 1\n", cstr(rhs_bit), cstr(lhs_bit));
+				f << ".names " << cstr(rhs_bit) << ' ' << cstr(lhs_bit) << "\n1 1\n";
 		}
 
 		f << stringf(".end\n");
 	}
 
-	static void dump(std::ostream &f, RTLIL::Module *module, RTLIL::Design *design, BlifDumperConfig &config)
+	static void dump(EmitBuffer &f, RTLIL::Module *module, RTLIL::Design *design, BlifDumperConfig &config)
 	{
 		BlifDumper dumper(f, module, design, &config);
 		dumper.dump();
@@ -554,6 +549,10 @@ struct BlifBackend : public Backend {
 		log("    -impltf\n");
 		log("        do not write definitions for the $true, $false and $undef wires.\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        write up to N modules concurrently. The output is the same as with\n");
+		log("        -j 1. The default is the number of threads set with 'yosys -j'.\n");
+		log("\n");
 	}
 	void execute(std::ostream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
 	{
@@ -562,6 +561,7 @@ struct BlifBackend : public Backend {
 		std::string true_type, true_out;
 		std::string false_type, false_out;
 		BlifDumperConfig config;
+		int num_threads = yosys_threads;
 
 		log_header(design, "Executing BLIF backend.\n");
 
@@ -644,6 +644,10 @@ struct BlifBackend : public Backend {
 				config.noalias_mode = true;
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
 			break;
 		}
 		extra_args(f, filename, args, argidx);
@@ -669,8 +673,9 @@ struct BlifBackend : public Backend {
 			if (module->memories.size() != 0)
 				log_error("Found unmapped memories in module %s: unmapped memories are not supported in BLIF backend!\n", RTLIL::id2cstr(module->name));
 
+			// the top module is written first
 			if (module->name == RTLIL::escape_id(top_module_name)) {
-				BlifDumper::dump(*f, module, design, config);
+				mod_list.insert(mod_list.begin(), module);
 				top_module_name.clear();
 				continue;
 			}
@@ -681,8 +686,9 @@ struct BlifBackend : public Backend {
 		if (!top_module_name.empty())
 			log_error("Can't find top module `%s'!\n", top_module_name.c_str());
 
-		for (auto module : mod_list)
-			BlifDumper::dump(*f, module, design, config);
+		emit_modules(*f, mod_list, num_threads, [&](EmitBuffer &buffer, RTLIL::Module *module) {
+			BlifDumper::dump(buffer, module, design, config);
+		});
 	}
 } BlifBackend;
 
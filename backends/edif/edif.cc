@@ -24,6 +24,7 @@
 #include "kernel/register.h"
 #include "kernel/sigtools.h"
 #include "kernel/celltypes.h"
+#include "kernel/emitter.h"
 #include "kernel/log.h"
 #include <string>
 
@@ -34,14 +35,40 @@ PRIVATE_NAMESPACE_BEGIN
 #define EDIF_DEFR(_id, _ren, _bl, _br) edif_names(RTLIL::unescape_id(_id), true, _ren, _bl, _br).c_str()
 #define EDIF_REF(_id) edif_names(RTLIL::unescape_id(_id), false).c_str()
 
+// The names of the design (modules, library cells and ports) are created
+// first, every module then gets its own EdifNames for the instances, nets and
+// properties with the design names as parent. This way the generated names do
+// not depend on the order in which the modules are written.
 struct EdifNames
 {
 	int counter;
 	char delim_left, delim_right;
 	std::set<std::string> generated_names, used_names;
 	std::map<std::string, std::string> name_map;
+	const EdifNames *parent;
 
-	EdifNames() : counter(1), delim_left('['), delim_right(']') { }
+	EdifNames() : counter(1), delim_left('['), delim_right(']'), parent(nullptr) { }
+
+	EdifNames(const EdifNames *parent) : counter(parent->counter), delim_left(parent->delim_left),
+			delim_right(parent->delim_right), parent(parent) { }
+
+	bool is_generated(const std::string &id) const
+	{
+		return generated_names.count(id) > 0 || (parent && parent->is_generated(id));
+	}
+
+	bool is_used(const std::string &id) const
+	{
+		return used_names.count(id) > 0 || (parent && parent->is_used(id));
+	}
+
+	const std::string *find(const std::string &id) const
+	{
+		auto it = name_map.find(id);
+		if (it != name_map.end())
+			return &it->second;
+		return parent ? parent->find(id) : nullptr;
+	}
 
 	std::string operator()(std::string id, bool define, bool port_rename = false, int range_left = 0, int range_right = 0)
 	{
@@ -52,9 +79,9 @@ struct EdifNames
 			return new_id != id ? stringf("(rename %s \"%s\")", new_id.c_str(), id.c_str()) : id;
 		}
 
-		if (name_map.count(id) > 0)
-			return name_map.at(id);
-		if (generated_names.count(id) > 0)
+		if (const std::string *mapped = find(id))
+			return *mapped;
+		if (is_generated(id))
 			goto do_rename;
 		if (id == "GND" || id == "VCC")
 			goto do_rename;
@@ -78,8 +105,7 @@ struct EdifNames
 		std::string gen_name;
 		while (1) {
 			gen_name = stringf("id%05d", counter++);
-			if (generated_names.count(gen_name) == 0 &&
-					used_names.count(gen_name) == 0)
+			if (!is_generated(gen_name) && !is_used(gen_name))
 				break;
 		}
 		generated_names.insert(gen_name);
@@ -88,6 +114,209 @@ struct EdifNames
 	}
 };
 
+// Writes the cell of one module of the design into a buffer, with its own
+// names for the instances and nets (see EdifNames).
+struct EdifModuleWriter
+{
+	EmitBuffer &f;
+	RTLIL::Design *design;
+	const std::map<RTLIL::IdString, std::map<RTLIL::IdString, int>> &lib_cell_ports;
+	bool port_rename, attr_properties, nogndvcc, gndvccy;
+
+	EdifNames edif_names;
+	EmitNames<RTLIL::IdString> refs;
+
+	EdifModuleWriter(EmitBuffer &f, RTLIL::Design *design, const EdifNames *design_names,
+			const std::map<RTLIL::IdString, std::map<RTLIL::IdString, int>> &lib_cell_ports,
+			bool port_rename, bool attr_properties, bool nogndvcc, bool gndvccy) :
+			f(f), design(design), lib_cell_ports(lib_cell_ports), port_rename(port_rename),
+			attr_properties(attr_properties), nogndvcc(nogndvcc), gndvccy(gndvccy), edif_names(design_names),
+			refs([this](const RTLIL::IdString &id) { return edif_names(RTLIL::unescape_id(id), false); })
+	{
+	}
+
+	void add_prop(IdString name, Const val)
+	{
+		if ((val.flags & RTLIL::CONST_FLAG_STRING) != 0)
+			f << stringf("\n            (property %s (string \"%s\"))", EDIF_DEF(name), val.decode_string().c_str());
+		else if (val.size() <= 32 && RTLIL::SigSpec(val).is_fully_def())
+			f << stringf("\n            (property %s (integer %u))", EDIF_DEF(name), val.as_int());
+		else {
+			std::string hex_string = "";
+			for (int i = 0; i < val.size(); i += 4) {
+				int digit_value = 0;
+				if (i+0 < val.size() && val[i+0] == RTLIL::State::S1) digit_value |= 1;
+				if (i+1 < val.size() && val[i+1] == RTLIL::State::S1) digit_value |= 2;
+				if (i+2 < val.size() && val[i+2] == RTLIL::State::S1) digit_value |= 4;
+				if (i+3 < val.size() && val[i+3] == RTLIL::State::S1) digit_value |= 8;
+				char digit_str[2] = { "0123456789abcdef"[digit_value], 0 };
+				hex_string = std::string(digit_str) + hex_string;
+			}
+			f << stringf("\n            (property %s (string \"%d'h%s\"))", EDIF_DEF(name), GetSize(val), hex_string.c_str());
+		}
+	}
+
+	void dump(RTLIL::Module *module)
+	{
+		SigMap sigmap(module);
+		std::map<RTLIL::SigSpec, std::set<std::pair<std::string, bool>>> net_join_db;
+
+		f << stringf("    (cell %s\n", EDIF_DEF(module->name));
+		f << stringf("      (cellType GENERIC)\n");
+		f << stringf("      (view VIEW_NETLIST\n");
+		f << stringf("        (viewType NETLIST)\n");
+		f << stringf("        (interface\n");
+		for (auto &wire_it : module->wires_) {
+			RTLIL::Wire *wire = wire_it.second;
+			if (wire->port_id == 0)
+				continue;
+			const char *dir = "INOUT";
+			if (!wire->port_output)
+				dir = "INPUT";
+			else if (!wire->port_input)
+				dir = "OUTPUT";
+			if (wire->width == 1) {
+				f << stringf("          (port %s (direction %s)", EDIF_DEF(wire->name), dir);
+				if (attr_properties)
+					for (auto &p : wire->attributes)
+						add_prop(p.first, p.second);
+				f << ")\n";
+				RTLIL::SigSpec sig = sigmap(RTLIL::SigSpec(wire));
+				net_join_db[sig].insert(make_pair(stringf("(portRef %s)", refs(wire->name).c_str()), wire->port_input));
+			} else {
+				int b[2];
+				b[wire->upto ? 0 : 1] = wire->start_offset;
+				b[wire->upto ? 1 : 0] = wire->start_offset + GetSize(wire) - 1;
+				f << stringf("          (port (array %s %d) (direction %s)", EDIF_DEFR(wire->name, port_rename, b[0], b[1]), wire->width, dir);
+				if (attr_properties)
+					for (auto &p : wire->attributes)
+						add_prop(p.first, p.second);
+
+				f << ")\n";
+				for (int i = 0; i < wire->width; i++) {
+					RTLIL::SigSpec sig = sigmap(RTLIL::SigSpec(wire, i));
+					net_join_db[sig].insert(make_pair(stringf("(portRef (member %s %d))", refs(wire->name).c_str(), GetSize(wire)-i-1), wire->port_input));
+				}
+			}
+		}
+		f << stringf("        )\n");
+		f << stringf("        (contents\n");
+		if (!nogndvcc) {
+			f << stringf("          (instance GND (viewRef VIEW_NETLIST (cellRef GND (libraryRef LIB))))\n");
+			f << stringf("          (instance VCC (viewRef VIEW_NETLIST (cellRef VCC (libraryRef LIB))))\n");
+		}
+		for (auto &cell_it : module->cells_) {
+			RTLIL::Cell *cell = cell_it.second;
+			f << "          (instance " << EDIF_DEF(cell->name) << '\n';
+			f << "            (viewRef VIEW_NETLIST (cellRef " << refs(cell->type);
+			f << (lib_cell_ports.count(cell->type) > 0 ? " (libraryRef LIB)))" : "))");
+			for (auto &p : cell->parameters)
+				add_prop(p.first, p.second);
+			if (attr_properties)
+				for (auto &p : cell->attributes)
+					add_prop(p.first, p.second);
+
+			f << ")\n";
+			for (auto &p : cell->connections()) {
+				RTLIL::SigSpec sig = sigmap(p.second);
+				for (int i = 0; i < GetSize(sig); i++)
+					if (sig[i].wire == NULL && sig[i] != RTLIL::State::S0 && sig[i] != RTLIL::State::S1)
+						log_warning("Bit %d of cell port %s.%s.%s driven by %s will be left unconnected in EDIF output.\n",
+								i, log_id(module), log_id(cell), log_id(p.first), log_signal(sig[i]));
+					else {
+						int member_idx = GetSize(sig)-i-1;
+						auto m = design->module(cell->type);
+						int width = sig.size();
+						if (m) {
+							auto w = m->wire(p.first);
+							if (w) {
+								member_idx = GetSize(w)-i-1;
+								width = GetSize(w);
+							}
+						}
+						if (width == 1)
+							net_join_db[sig[i]].insert(make_pair(stringf("(portRef %s (instanceRef %s))", refs(p.first).c_str(), refs(cell->name).c_str()), cell->output(p.first)));
+						else {
+							net_join_db[sig[i]].insert(make_pair(stringf("(portRef (member %s %d) (instanceRef %s))",
+									refs(p.first).c_str(), member_idx, refs(cell->name).c_str()), cell->output(p.first)));
+						}
+					}
+			}
+		}
+		for (auto &it : net_join_db) {
+			RTLIL::SigBit sig = it.first;
+			if (sig.wire == NULL && sig != RTLIL::State::S0 && sig != RTLIL::State::S1) {
+				if (sig == RTLIL::State::Sx) {
+					for (auto &ref : it.second)
+						log_warning("Exporting x-bit on %s as zero bit.\n", ref.first.c_str());
+					sig = RTLIL::State::S0;
+				} else if (sig == RTLIL::State::Sz) {
+					continue;
+				} else {
+					for (auto &ref : it.second)
+						log_error("Don't know how to handle %s on %s.\n", log_signal(sig), ref.first.c_str());
+					log_abort();
+				}
+			}
+			std::string netname;
+			if (sig == RTLIL::State::S0)
+				netname = "GND_NET";
+			else if (sig == RTLIL::State::S1)
+				netname = "VCC_NET";
+			else {
+				netname = log_signal(sig);
+				for (size_t i = 0; i < netname.size(); i++)
+					if (netname[i] == ' ' || netname[i] == '\\')
+						netname.erase(netname.begin() + i--);
+			}
+			f << "          (net " << EDIF_DEF(netname) << " (joined\n";
+			for (auto &ref : it.second)
+				f << "            " << ref.first << '\n';
+			if (sig.wire == NULL) {
+				if (nogndvcc)
+					log_error("Design contains constant nodes (map with \"hilomap\" first).\n");
+				if (sig == RTLIL::State::S0)
+					f << stringf("            (portRef %c (instanceRef GND))\n", gndvccy ? 'Y' : 'G');
+				if (sig == RTLIL::State::S1)
+					f << stringf("            (portRef %c (instanceRef VCC))\n", gndvccy ? 'Y' : 'P');
+			}				
+			f << "            )";
+			if (attr_properties && sig.wire != NULL)
+				for (auto &p : sig.wire->attributes)
+					add_prop(p.first, p.second);
+			f << "\n          )\n";
+		}
+		for (auto &wire_it : module->wires_) {
+			RTLIL::Wire *wire = wire_it.second;
+			if (!wire->get_bool_attribute(ID::keep))
+				continue;
+			for(int i = 0; i < wire->width; i++) {
+				SigBit raw_sig = RTLIL::SigSpec(wire, i);
+				SigBit mapped_sig = sigmap(raw_sig);
+				if (raw_sig == mapped_sig || net_join_db.count(mapped_sig) == 0)
+					continue;
+				std::string netname = log_signal(raw_sig);
+				for (size_t i = 0; i < netname.size(); i++)
+					if (netname[i] == ' ' || netname[i] == '\\')
+						netname.erase(netname.begin() + i--);
+				f << stringf("          (net %s (joined\n", EDIF_DEF(netname));
+				auto &joined = net_join_db.at(mapped_sig);
+				for (auto &ref : joined)
+					if (ref.second)
+						f << stringf("            %s\n", ref.first.c_str());
+				f << stringf("            )");
+				if (attr_properties && raw_sig.wire != NULL)
+					for (auto &p : raw_sig.wire->attributes)
+						add_prop(p.first, p.second);
+				f << stringf("\n          )\n");
+			}
+		}
+		f << stringf("        )\n");
+		f << stringf("      )\n");
+		f << stringf("    )\n");
+	}
+};
+
 struct EdifBackend : public Backend {
 	EdifBackend() : Backend("edif", "write design to EDIF netlist file") { }
 	void help() YS_OVERRIDE
@@ -117,6 +346,10 @@ struct EdifBackend : public Backend {
 		log("        sets the delimiting character for module port rename clauses to\n");
 		log("        parentheses, square brackets, or angle brackets.\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        write up to N modules concurrently. The output is the same as with\n");
+		log("        -j 1. The default is the number of threads set with 'yosys -j'.\n");
+		log("\n");
 		log("Unfortunately there are different \"flavors\" of the EDIF file format. This\n");
 		log("command generates EDIF files for the Xilinx place&route tools. It might be\n");
 		log("necessary to make small modifications to this command when a different tool\n");
@@ -133,6 +366,7 @@ struct EdifBackend : public Backend {
 		bool nogndvcc = false, gndvccy = false;
 		CellTypes ct(design);
 		EdifNames edif_names;
+		int num_threads = yosys_threads;
 
 		size_t argidx;
 		for (argidx = 1; argidx < args.size(); argidx++)
@@ -166,6 +400,10 @@ struct EdifBackend : public Backend {
 				}
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
 			break;
 		}
 		extra_args(f, filename, args, argidx);
@@ -307,187 +545,23 @@ struct EdifBackend : public Backend {
 		*f << stringf("    (edifLevel 0)\n");
 		*f << stringf("    (technology (numberDefinition))\n");
 
-		auto add_prop = [&](IdString name, Const val) {
-			if ((val.flags & RTLIL::CONST_FLAG_STRING) != 0)
-				*f << stringf("\n            (property %s (string \"%s\"))", EDIF_DEF(name), val.decode_string().c_str());
-			else if (val.bits.size() <= 32 && RTLIL::SigSpec(val).is_fully_def())
-				*f << stringf("\n            (property %s (integer %u))", EDIF_DEF(name), val.as_int());
-			else {
-				std::string hex_string = "";
-				for (size_t i = 0; i < val.bits.size(); i += 4) {
-					int digit_value = 0;
-					if (i+0 < val.bits.size() && val.bits.at(i+0) == RTLIL::State::S1) digit_value |= 1;
-					if (i+1 < val.bits.size() && val.bits.at(i+1) == RTLIL::State::S1) digit_value |= 2;
-					if (i+2 < val.bits.size() && val.bits.at(i+2) == RTLIL::State::S1) digit_value |= 4;
-					if (i+3 < val.bits.size() && val.bits.at(i+3) == RTLIL::State::S1) digit_value |= 8;
-					char digit_str[2] = { "0123456789abcdef"[digit_value], 0 };
-					hex_string = std::string(digit_str) + hex_string;
-				}
-				*f << stringf("\n            (property %s (string \"%d'h%s\"))", EDIF_DEF(name), GetSize(val.bits), hex_string.c_str());
-			}
-		};		
-		for (auto module : sorted_modules)
-		{
+		std::vector<RTLIL::Module*> mod_list;
+		for (auto module : sorted_modules) {
 			if (module->get_blackbox_attribute())
 				continue;
+			// the names of the modules and ports are shared by all modules
+			edif_names(RTLIL::unescape_id(module->name), false);
+			for (auto wire : module->wires())
+				if (wire->port_id != 0)
+					edif_names(RTLIL::unescape_id(wire->name), false);
+			mod_list.push_back(module);
+		}
 
-			SigMap sigmap(module);
-			std::map<RTLIL::SigSpec, std::set<std::pair<std::string, bool>>> net_join_db;
+		emit_modules(*f, mod_list, num_threads, [&](EmitBuffer &buffer, RTLIL::Module *module) {
+			EdifModuleWriter writer(buffer, design, &edif_names, lib_cell_ports, port_rename, attr_properties, nogndvcc, gndvccy);
+			writer.dump(module);
+		});
 
-			*f << stringf("    (cell %s\n", EDIF_DEF(module->name));
-			*f << stringf("      (cellType GENERIC)\n");
-			*f << stringf("      (view VIEW_NETLIST\n");
-			*f << stringf("        (viewType NETLIST)\n");
-			*f << stringf("        (interface\n");
-			for (auto &wire_it : module->wires_) {
-				RTLIL::Wire *wire = wire_it.second;
-				if (wire->port_id == 0)
-					continue;
-				const char *dir = "INOUT";
-				if (!wire->port_output)
-					dir = "INPUT";
-				else if (!wire->port_input)
-					dir = "OUTPUT";
-				if (wire->width == 1) {
-					*f << stringf("          (port %s (direction %s)", EDIF_DEF(wire->name), dir);
-					if (attr_properties)
-						for (auto &p : wire->attributes)
-							add_prop(p.first, p.second);
-					*f << ")\n";
-					RTLIL::SigSpec sig = sigmap(RTLIL::SigSpec(wire));
-					net_join_db[sig].insert(make_pair(stringf("(portRef %s)", EDIF_REF(wire->name)), wire->port_input));
-				} else {
-					int b[2];
-					b[wire->upto ? 0 : 1] = wire->start_offset;
-					b[wire->upto ? 1 : 0] = wire->start_offset + GetSize(wire) - 1;
-					*f << stringf("          (port (array %s %d) (direction %s)", EDIF_DEFR(wire->name, port_rename, b[0], b[1]), wire->width, dir);
-					if (attr_properties)
-						for (auto &p : wire->attributes)
-							add_prop(p.first, p.second);
-
-					*f << ")\n";
-					for (int i = 0; i < wire->width; i++) {
-						RTLIL::SigSpec sig = sigmap(RTLIL::SigSpec(wire, i));
-						net_join_db[sig].insert(make_pair(stringf("(portRef (member %s %d))", EDIF_REF(wire->name), GetSize(wire)-i-1), wire->port_input));
-					}
-				}
-			}
-			*f << stringf("        )\n");
-			*f << stringf("        (contents\n");
-			if (!nogndvcc) {
-				*f << stringf("          (instance GND (viewRef VIEW_NETLIST (cellRef GND (libraryRef LIB))))\n");
-				*f << stringf("          (instance VCC (viewRef VIEW_NETLIST (cellRef VCC (libraryRef LIB))))\n");
-			}
-			for (auto &cell_it : module->cells_) {
-				RTLIL::Cell *cell = cell_it.second;
-				*f << stringf("          (instance %s\n", EDIF_DEF(cell->name));
-				*f << stringf("            (viewRef VIEW_NETLIST (cellRef %s%s))", EDIF_REF(cell->type),
-						lib_cell_ports.count(cell->type) > 0 ? " (libraryRef LIB)" : "");
-				for (auto &p : cell->parameters)
-					add_prop(p.first, p.second);
-				if (attr_properties)
-					for (auto &p : cell->attributes)
-						add_prop(p.first, p.second);
-
-				*f << stringf(")\n");
-				for (auto &p : cell->connections()) {
-					RTLIL::SigSpec sig = sigmap(p.second);
-					for (int i = 0; i < GetSize(sig); i++)
-						if (sig[i].wire == NULL && sig[i] != RTLIL::State::S0 && sig[i] != RTLIL::State::S1)
-							log_warning("Bit %d of cell port %s.%s.%s driven by %s will be left unconnected in EDIF output.\n",
-									i, log_id(module), log_id(cell), log_id(p.first), log_signal(sig[i]));
-						else {
-							int member_idx = GetSize(sig)-i-1;
-							auto m = design->module(cell->type);
-							int width = sig.size();
-							if (m) {
-								auto w = m->wire(p.first);
-								if (w) {
-									member_idx = GetSize(w)-i-1;
-									width = GetSize(w);
-								}
-							}
-							if (width == 1)
-								net_join_db[sig[i]].insert(make_pair(stringf("(portRef %s (instanceRef %s))", EDIF_REF(p.first), EDIF_REF(cell->name)), cell->output(p.first)));
-							else {
-								net_join_db[sig[i]].insert(make_pair(stringf("(portRef (member %s %d) (instanceRef %s))",
-										EDIF_REF(p.first), member_idx, EDIF_REF(cell->name)), cell->output(p.first)));
-							}
-						}
-				}
-			}
-			for (auto &it : net_join_db) {
-				RTLIL::SigBit sig = it.first;
-				if (sig.wire == NULL && sig != RTLIL::State::S0 && sig != RTLIL::State::S1) {
-					if (sig == RTLIL::State::Sx) {
-						for (auto &ref : it.second)
-							log_warning("Exporting x-bit on %s as zero bit.\n", ref.first.c_str());
-						sig = RTLIL::State::S0;
-					} else if (sig == RTLIL::State::Sz) {
-						continue;
-					} else {
-						for (auto &ref : it.second)
-							log_error("Don't know how to handle %s on %s.\n", log_signal(sig), ref.first.c_str());
-						log_abort();
-					}
-				}
-				std::string netname;
-				if (sig == RTLIL::State::S0)
-					netname = "GND_NET";
-				else if (sig == RTLIL::State::S1)
-					netname = "VCC_NET";
-				else {
-					netname = log_signal(sig);
-					for (size_t i = 0; i < netname.size(); i++)
-						if (netname[i] == ' ' || netname[i] == '\\')
-							netname.erase(netname.begin() + i--);
-				}
-				*f << stringf("          (net %s (joined\n", EDIF_DEF(netname));
-				for (auto &ref : it.second)
-					*f << stringf("            %s\n", ref.first.c_str());
-				if (sig.wire == NULL) {
-					if (nogndvcc)
-						log_error("Design contains constant nodes (map with \"hilomap\" first).\n");
-					if (sig == RTLIL::State::S0)
-						*f << stringf("            (portRef %c (instanceRef GND))\n", gndvccy ? 'Y' : 'G');
-					if (sig == RTLIL::State::S1)
-						*f << stringf("            (portRef %c (instanceRef VCC))\n", gndvccy ? 'Y' : 'P');
-				}				
-				*f << stringf("            )");
-				if (attr_properties && sig.wire != NULL)
-					for (auto &p : sig.wire->attributes)
-						add_prop(p.first, p.second);
-				*f << stringf("\n          )\n");
-			}
-			for (auto &wire_it : module->wires_) {
-				RTLIL::Wire *wire = wire_it.second;
-				if (!wire->get_bool_attribute(ID::keep))
-					continue;
-				for(int i = 0; i < wire->width; i++) {
-					SigBit raw_sig = RTLIL::SigSpec(wire, i);
-					SigBit mapped_sig = sigmap(raw_sig);
-					if (raw_sig == mapped_sig || net_join_db.count(mapped_sig) == 0)
-						continue;
-					std::string netname = log_signal(raw_sig);
-					for (size_t i = 0; i < netname.size(); i++)
-						if (netname[i] == ' ' || netname[i] == '\\')
-							netname.erase(netname.begin() + i--);
-					*f << stringf("          (net %s (joined\n", EDIF_DEF(netname));
-					auto &refs = net_join_db.at(mapped_sig);
-					for (auto &ref : refs)
-						if (ref.second)
-							*f << stringf("            %s\n", ref.first.c_str());
-					*f << stringf("            )");
-					if (attr_properties && raw_sig.wire != NULL)
-						for (auto &p : raw_sig.wire->attributes)
-							add_prop(p.first, p.second);
-					*f << stringf("\n          )\n");
-				}
-			}
-			*f << stringf("        )\n");
-			*f << stringf("      )\n");
-			*f << stringf("    )\n");
-		}
 		*f << stringf("  )\n");
 
 		*f << stringf("  (design %s\n", EDIF_DEF(top_module_name));
@@ -23,6 +23,7 @@
 #include "kernel/celltypes.h"
 #include "kernel/cellaigs.h"
 #include "kernel/log.h"
+#include "kernel/emitter.h"
 #include <algorithm>
 #include <string>
 #include <regex>
@@ -32,9 +33,15 @@
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
-pool<string> used_names;
-dict<IdString, string> namecache;
-int autoid_counter;
+// Names of the modules and module ports, created before the modules are
+// written and shared by all of them
+pool<string> global_used_names;
+dict<IdString, string> global_namecache;
+
+// Names within the module that is written by this thread
+thread_local pool<string> used_names;
+thread_local dict<IdString, string> namecache;
+thread_local int autoid_counter;
 
 typedef unsigned FDirection;
 static const FDirection FD_NODIRECTION = 0x0;
@@ -64,7 +71,7 @@ string next_id()
 
 	while (1) {
 		new_id = stringf("_%d", autoid_counter++);
-		if (used_names.count(new_id) == 0) break;
+		if (used_names.count(new_id) == 0 && global_used_names.count(new_id) == 0) break;
 	}
 
 	used_names.insert(new_id);
@@ -75,6 +82,8 @@ const char *make_id(IdString id)
 {
 	if (namecache.count(id) != 0)
 		return namecache.at(id).c_str();
+	if (global_namecache.count(id) != 0)
+		return global_namecache.at(id).c_str();
 
 	string new_id = log_id(id);
 
@@ -88,7 +97,7 @@ const char *make_id(IdString id)
 		ch = '_';
 	}
 
-	while (used_names.count(new_id) != 0)
+	while (used_names.count(new_id) != 0 || global_used_names.count(new_id) != 0)
 		new_id += '_';
 
 	namecache[id] = new_id;
@@ -99,7 +108,7 @@ const char *make_id(IdString id)
 struct FirrtlWorker
 {
 	Module *module;
-	std::ostream &f;
+	EmitBuffer &f;
 
 	dict<SigBit, pair<string, int>> reverse_wire_map;
 	string unconn_id;
@@ -231,8 +240,11 @@ struct FirrtlWorker
 			reverse_wire_map[sig[i]] = make_pair(id, i);
 	}
 
-	FirrtlWorker(Module *module, std::ostream &f, RTLIL::Design *theDesign) : module(module), f(f), design(theDesign), indent("    ")
+	FirrtlWorker(Module *module, EmitBuffer &f, RTLIL::Design *theDesign) : module(module), f(f), design(theDesign), indent("    ")
 	{
+		used_names.clear();
+		namecache.clear();
+		autoid_counter = 0;
 	}
 
 	static string make_expr(const SigSpec &sig)
@@ -746,7 +758,7 @@ struct FirrtlWorker
 				int wr_ports = cell->parameters.at("\\WR_PORTS").as_int();
 
 				Const initdata = cell->parameters.at("\\INIT");
-				for (State bit : initdata.bits)
+				for (State bit : initdata)
 					if (bit != State::Sx)
 						log_error("Memory with initialization data: %s.%s\n", log_id(module), log_id(cell));
 
@@ -1080,18 +1092,33 @@ struct FirrtlBackend : public Backend {
 		log("The following commands are executed by this command:\n");
 		log("        pmuxtree\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        write up to N modules concurrently. The output is the same as with\n");
+		log("        -j 1. The default is the number of threads set with 'yosys -j'.\n");
+		log("\n");
+		log("    -cache <dir>\n");
+		log("        keep the FIRRTL text of every written module in the given directory\n");
+		log("        and reuse it in later calls, as long as the module, the names and\n");
+		log("        ports of all modules and the yosys version are unchanged.\n");
+		log("\n");
 	}
 	void execute(std::ostream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
 	{
-		size_t argidx = args.size();	// We aren't expecting any arguments.
-
-		// If we weren't explicitly passed a filename, use the last argument (if it isn't a flag).
-		if (filename == "") {
-			if (argidx > 0 && args[argidx - 1][0] != '-') {
-				// extra_args and friends need to see this argument.
-				argidx -= 1;
-				filename = args[argidx];
+		int num_threads = std::max(yosys_threads, 1);
+		std::string cache_dir;
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
+			if (args[argidx] == "-cache" && argidx+1 < args.size()) {
+				cache_dir = args[++argidx];
+				continue;
 			}
+			break;
 		}
 		extra_args(f, filename, args, argidx);
 
@@ -1103,6 +1130,7 @@ struct FirrtlBackend : public Backend {
 
 		Pass::call(design, stringf("pmuxtree"));
 
+		used_names.clear();
 		namecache.clear();
 		autoid_counter = 0;
 
@@ -1126,12 +1154,49 @@ struct FirrtlBackend : public Backend {
 
 		*f << stringf("circuit %s:\n", make_id(top->name));
 
-		for (auto module : design->modules())
-		{
-			FirrtlWorker worker(module, *f, design);
-			worker.run();
+		// the names created so far are the same in all modules, the names
+		// within a module only depend on the module and these
+		global_used_names.clear();
+		global_namecache.clear();
+		std::swap(global_used_names, used_names);
+		std::swap(global_namecache, namecache);
+
+		std::vector<Module*> modules = design->modules().to_vector();
+		EmitCache cache(cache_dir, ".fir");
+		std::string interface_key;
+
+		if (cache.enabled()) {
+			std::stringstream buf;
+			for (auto module : modules) {
+				buf << module->name.str() << "\n";
+				for (auto port : module->ports) {
+					Wire *wire = module->wire(port);
+					buf << " " << port.str() << " " << wire->width << " " << wire->port_input << wire->port_output << "\n";
+				}
+			}
+			interface_key = EmitCache::key({buf.str()});
 		}
 
+		emit_modules(*f, modules, num_threads, [&](EmitBuffer &buf, Module *module) {
+			if (!cache.enabled()) {
+				FirrtlWorker worker(module, buf, design);
+				worker.run();
+				return;
+			}
+			std::string key = EmitCache::key({module->name.str(), module->content_hash(), interface_key});
+			if (cache.load(key, buf)) {
+				log("Reusing FIRRTL text of module %s from the cache.\n", log_id(module));
+				return;
+			}
+			EmitBuffer module_buf;
+			FirrtlWorker worker(module, module_buf, design);
+			worker.run();
+			cache.store(key, module_buf.text);
+			buf << module_buf.text;
+		});
+
+		global_used_names.clear();
+		global_namecache.clear();
 		namecache.clear();
 		autoid_counter = 0;
 	}
@@ -24,333 +24,394 @@
 
 #include "ilang_backend.h"
 #include "kernel/yosys.h"
+#include "kernel/emitter.h"
 #include <errno.h>
 
 USING_YOSYS_NAMESPACE
 using namespace ILANG_BACKEND;
 YOSYS_NAMESPACE_BEGIN
 
-void ILANG_BACKEND::dump_const(std::ostream &f, const RTLIL::Const &data, int width, int offset, bool autoint)
+namespace {
+
+// The dump functions write to a std::ostream (the public interface) or to an
+// EmitBuffer, which write_ilang uses to render the modules concurrently. Names
+// are stored in their escaped form, so they are written as they are.
+template<typename Out>
+struct IlangDumper
 {
-	if (width < 0)
-		width = data.bits.size() - offset;
-	if ((data.flags & RTLIL::CONST_FLAG_STRING) == 0 || width != (int)data.bits.size()) {
-		if (width == 32 && autoint) {
-			int32_t val = 0;
-			for (int i = 0; i < width; i++) {
-				log_assert(offset+i < (int)data.bits.size());
-				switch (data.bits[offset+i]) {
-				case State::S0: break;
-				case State::S1: val |= 1 << i; break;
-				default: val = -1; break;
+	Out &f;
+
+	IlangDumper(Out &f) : f(f) { }
+
+	void dump_const(const RTLIL::Const &data, int width = -1, int offset = 0, bool autoint = true)
+	{
+		if (width < 0)
+			width = data.size() - offset;
+		if ((data.flags & RTLIL::CONST_FLAG_STRING) == 0 || width != (int)data.size()) {
+			if (width == 32 && autoint) {
+				int32_t val = 0;
+				for (int i = 0; i < width; i++) {
+					log_assert(offset+i < (int)data.size());
+					switch (data[offset+i]) {
+					case State::S0: break;
+					case State::S1: val |= 1 << i; break;
+					default: val = -1; break;
+					}
+				}
+				if (val >= 0) {
+					f << int(val);
+					return;
 				}
 			}
-			if (val >= 0) {
-				f << stringf("%d", val);
-				return;
+			f << width << '\'';
+			for (int i = offset+width-1; i >= offset; i--) {
+				log_assert(i < (int)data.size());
+				switch (data[i]) {
+				case State::S0: f << '0'; break;
+				case State::S1: f << '1'; break;
+				case RTLIL::Sx: f << 'x'; break;
+				case RTLIL::Sz: f << 'z'; break;
+				case RTLIL::Sa: f << '-'; break;
+				case RTLIL::Sm: f << 'm'; break;
+				}
 			}
-		}
-		f << stringf("%d'", width);
-		for (int i = offset+width-1; i >= offset; i--) {
-			log_assert(i < (int)data.bits.size());
-			switch (data.bits[i]) {
-			case State::S0: f << stringf("0"); break;
-			case State::S1: f << stringf("1"); break;
-			case RTLIL::Sx: f << stringf("x"); break;
-			case RTLIL::Sz: f << stringf("z"); break;
-			case RTLIL::Sa: f << stringf("-"); break;
-			case RTLIL::Sm: f << stringf("m"); break;
+		} else {
+			f << '"';
+			std::string str = data.decode_string();
+			for (size_t i = 0; i < str.size(); i++) {
+				if (str[i] == '\n')
+					f << "\\n";
+				else if (str[i] == '\t')
+					f << "\\t";
+				else if (str[i] < 32)
+					f << stringf("\\%03o", str[i]);
+				else if (str[i] == '"')
+					f << "\\\"";
+				else if (str[i] == '\\')
+					f << "\\\\";
+				else
+					f << str[i];
 			}
+			f << '"';
 		}
-	} else {
-		f << stringf("\"");
-		std::string str = data.decode_string();
-		for (size_t i = 0; i < str.size(); i++) {
-			if (str[i] == '\n')
-				f << stringf("\\n");
-			else if (str[i] == '\t')
-				f << stringf("\\t");
-			else if (str[i] < 32)
-				f << stringf("\\%03o", str[i]);
-			else if (str[i] == '"')
-				f << stringf("\\\"");
-			else if (str[i] == '\\')
-				f << stringf("\\\\");
+	}
+
+	void dump_sigchunk(const RTLIL::SigChunk &chunk, bool autoint = true)
+	{
+		if (chunk.wire == NULL) {
+			dump_const(chunk.data, chunk.width, chunk.offset, autoint);
+		} else {
+			f << chunk.wire->name.c_str();
+			if (chunk.width == chunk.wire->width && chunk.offset == 0)
+				return;
+			if (chunk.width == 1)
+				f << " [" << chunk.offset << ']';
 			else
-				f << str[i];
+				f << " [" << chunk.offset+chunk.width-1 << ':' << chunk.offset << ']';
 		}
-		f << stringf("\"");
 	}
-}
 
-void ILANG_BACKEND::dump_sigchunk(std::ostream &f, const RTLIL::SigChunk &chunk, bool autoint)
-{
-	if (chunk.wire == NULL) {
-		dump_const(f, chunk.data, chunk.width, chunk.offset, autoint);
-	} else {
-		if (chunk.width == chunk.wire->width && chunk.offset == 0)
-			f << stringf("%s", chunk.wire->name.c_str());
-		else if (chunk.width == 1)
-			f << stringf("%s [%d]", chunk.wire->name.c_str(), chunk.offset);
-		else
-			f << stringf("%s [%d:%d]", chunk.wire->name.c_str(), chunk.offset+chunk.width-1, chunk.offset);
+	void dump_sigspec(const RTLIL::SigSpec &sig, bool autoint = true)
+	{
+		if (sig.is_chunk()) {
+			dump_sigchunk(sig.as_chunk(), autoint);
+		} else {
+			f << "{ ";
+			for (auto it = sig.chunks().rbegin(); it != sig.chunks().rend(); ++it) {
+				dump_sigchunk(*it, false);
+				f << ' ';
+			}
+			f << '}';
+		}
 	}
-}
 
-void ILANG_BACKEND::dump_sigspec(std::ostream &f, const RTLIL::SigSpec &sig, bool autoint)
-{
-	if (sig.is_chunk()) {
-		dump_sigchunk(f, sig.as_chunk(), autoint);
-	} else {
-		f << stringf("{ ");
-		for (auto it = sig.chunks().rbegin(); it != sig.chunks().rend(); ++it) {
-			dump_sigchunk(f, *it, false);
-			f << stringf(" ");
+	void dump_attributes(const std::string &indent, const dict<RTLIL::IdString, RTLIL::Const> &attributes)
+	{
+		for (auto &it : attributes) {
+			f << indent << "attribute " << it.first.c_str() << ' ';
+			dump_const(it.second);
+			f << '\n';
 		}
-		f << stringf("}");
 	}
-}
 
-void ILANG_BACKEND::dump_wire(std::ostream &f, std::string indent, const RTLIL::Wire *wire)
-{
-	for (auto &it : wire->attributes) {
-		f << stringf("%s" "attribute %s ", indent.c_str(), it.first.c_str());
-		dump_const(f, it.second);
-		f << stringf("\n");
+	void dump_wire(const std::string &indent, const RTLIL::Wire *wire)
+	{
+		dump_attributes(indent, wire->attributes);
+		f << indent << "wire ";
+		if (wire->width != 1)
+			f << "width " << wire->width << ' ';
+		if (wire->upto)
+			f << "upto ";
+		if (wire->start_offset != 0)
+			f << "offset " << wire->start_offset << ' ';
+		if (wire->port_input && !wire->port_output)
+			f << "input " << wire->port_id << ' ';
+		if (!wire->port_input && wire->port_output)
+			f << "output " << wire->port_id << ' ';
+		if (wire->port_input && wire->port_output)
+			f << "inout " << wire->port_id << ' ';
+		f << wire->name.c_str() << '\n';
 	}
-	f << stringf("%s" "wire ", indent.c_str());
-	if (wire->width != 1)
-		f << stringf("width %d ", wire->width);
-	if (wire->upto)
-		f << stringf("upto ");
-	if (wire->start_offset != 0)
-		f << stringf("offset %d ", wire->start_offset);
-	if (wire->port_input && !wire->port_output)
-		f << stringf("input %d ", wire->port_id);
-	if (!wire->port_input && wire->port_output)
-		f << stringf("output %d ", wire->port_id);
-	if (wire->port_input && wire->port_output)
-		f << stringf("inout %d ", wire->port_id);
-	f << stringf("%s\n", wire->name.c_str());
-}
 
-void ILANG_BACKEND::dump_memory(std::ostream &f, std::string indent, const RTLIL::Memory *memory)
-{
-	for (auto &it : memory->attributes) {
-		f << stringf("%s" "attribute %s ", indent.c_str(), it.first.c_str());
-		dump_const(f, it.second);
-		f << stringf("\n");
+	void dump_memory(const std::string &indent, const RTLIL::Memory *memory)
+	{
+		dump_attributes(indent, memory->attributes);
+		f << indent << "memory ";
+		if (memory->width != 1)
+			f << "width " << memory->width << ' ';
+		if (memory->size != 0)
+			f << "size " << memory->size << ' ';
+		if (memory->start_offset != 0)
+			f << "offset " << memory->start_offset << ' ';
+		f << memory->name.c_str() << '\n';
 	}
-	f << stringf("%s" "memory ", indent.c_str());
-	if (memory->width != 1)
-		f << stringf("width %d ", memory->width);
-	if (memory->size != 0)
-		f << stringf("size %d ", memory->size);
-	if (memory->start_offset != 0)
-		f << stringf("offset %d ", memory->start_offset);
-	f << stringf("%s\n", memory->name.c_str());
-}
 
-void ILANG_BACKEND::dump_cell(std::ostream &f, std::string indent, const RTLIL::Cell *cell)
-{
-	for (auto &it : cell->attributes) {
-		f << stringf("%s" "attribute %s ", indent.c_str(), it.first.c_str());
-		dump_const(f, it.second);
-		f << stringf("\n");
-	}
-	f << stringf("%s" "cell %s %s\n", indent.c_str(), cell->type.c_str(), cell->name.c_str());
-	for (auto &it : cell->parameters) {
-		f << stringf("%s  parameter%s%s %s ", indent.c_str(),
-				(it.second.flags & RTLIL::CONST_FLAG_SIGNED) != 0 ? " signed" : "",
-				(it.second.flags & RTLIL::CONST_FLAG_REAL) != 0 ? " real" : "",
-				it.first.c_str());
-		dump_const(f, it.second);
-		f << stringf("\n");
+	void dump_cell(const std::string &indent, const RTLIL::Cell *cell)
+	{
+		dump_attributes(indent, cell->attributes);
+		f << indent << "cell " << cell->type.c_str() << ' ' << cell->name.c_str() << '\n';
+		for (auto &it : cell->parameters) {
+			f << indent << "  parameter";
+			if ((it.second.flags & RTLIL::CONST_FLAG_SIGNED) != 0)
+				f << " signed";
+			if ((it.second.flags & RTLIL::CONST_FLAG_REAL) != 0)
+				f << " real";
+			f << ' ' << it.first.c_str() << ' ';
+			dump_const(it.second);
+			f << '\n';
+		}
+		for (auto &it : cell->connections()) {
+			f << indent << "  connect " << it.first.c_str() << ' ';
+			dump_sigspec(it.second);
+			f << '\n';
+		}
+		f << indent << "end\n";
 	}
-	for (auto &it : cell->connections()) {
-		f << stringf("%s  connect %s ", indent.c_str(), it.first.c_str());
-		dump_sigspec(f, it.second);
-		f << stringf("\n");
+
+	void dump_proc_case_body(const std::string &indent, const RTLIL::CaseRule *cs)
+	{
+		for (auto it = cs->actions.begin(); it != cs->actions.end(); ++it)
+		{
+			f << indent << "assign ";
+			dump_sigspec(it->first);
+			f << ' ';
+			dump_sigspec(it->second);
+			f << '\n';
+		}
+
+		for (auto it = cs->switches.begin(); it != cs->switches.end(); ++it)
+			dump_proc_switch(indent, *it);
 	}
-	f << stringf("%s" "end\n", indent.c_str());
-}
 
-void ILANG_BACKEND::dump_proc_case_body(std::ostream &f, std::string indent, const RTLIL::CaseRule *cs)
-{
-	for (auto it = cs->actions.begin(); it != cs->actions.end(); ++it)
+	void dump_proc_switch(const std::string &indent, const RTLIL::SwitchRule *sw)
 	{
-		f << stringf("%s" "assign ", indent.c_str());
-		dump_sigspec(f, it->first);
-		f << stringf(" ");
-		dump_sigspec(f, it->second);
-		f << stringf("\n");
+		dump_attributes(indent, sw->attributes);
+
+		f << indent << "switch ";
+		dump_sigspec(sw->signal);
+		f << '\n';
+
+		for (auto it = sw->cases.begin(); it != sw->cases.end(); ++it)
+		{
+			dump_attributes(indent + "  ", (*it)->attributes);
+			f << indent << "  case ";
+			for (size_t i = 0; i < (*it)->compare.size(); i++) {
+				if (i > 0)
+					f << " , ";
+				dump_sigspec((*it)->compare[i]);
+			}
+			f << '\n';
+
+			dump_proc_case_body(indent + "    ", *it);
+		}
+
+		f << indent << "end\n";
 	}
 
-	for (auto it = cs->switches.begin(); it != cs->switches.end(); ++it)
-		dump_proc_switch(f, indent, *it);
-}
+	void dump_proc_sync(const std::string &indent, const RTLIL::SyncRule *sy)
+	{
+		f << indent << "sync ";
+		switch (sy->type) {
+		case RTLIL::ST0: f << "low ";
+		if (0) case RTLIL::ST1: f << "high ";
+		if (0) case RTLIL::STp: f << "posedge ";
+		if (0) case RTLIL::STn: f << "negedge ";
+		if (0) case RTLIL::STe: f << "edge ";
+			dump_sigspec(sy->signal);
+			f << '\n';
+			break;
+		case RTLIL::STa: f << "always\n"; break;
+		case RTLIL::STg: f << "global\n"; break;
+		case RTLIL::STi: f << "init\n"; break;
+		}
 
-void ILANG_BACKEND::dump_proc_switch(std::ostream &f, std::string indent, const RTLIL::SwitchRule *sw)
-{
-	for (auto it = sw->attributes.begin(); it != sw->attributes.end(); ++it) {
-		f << stringf("%s" "attribute %s ", indent.c_str(), it->first.c_str());
-		dump_const(f, it->second);
-		f << stringf("\n");
+		for (auto it = sy->actions.begin(); it != sy->actions.end(); ++it) {
+			f << indent << "  update ";
+			dump_sigspec(it->first);
+			f << ' ';
+			dump_sigspec(it->second);
+			f << '\n';
+		}
 	}
 
-	f << stringf("%s" "switch ", indent.c_str());
-	dump_sigspec(f, sw->signal);
-	f << stringf("\n");
+	void dump_proc(const std::string &indent, const RTLIL::Process *proc)
+	{
+		dump_attributes(indent, proc->attributes);
+		f << indent << "process " << proc->name.c_str() << '\n';
+		dump_proc_case_body(indent + "  ", &proc->root_case);
+		for (auto it = proc->syncs.begin(); it != proc->syncs.end(); ++it)
+			dump_proc_sync(indent + "  ", *it);
+		f << indent << "end\n";
+	}
 
-	for (auto it = sw->cases.begin(); it != sw->cases.end(); ++it)
+	void dump_conn(const std::string &indent, const RTLIL::SigSpec &left, const RTLIL::SigSpec &right)
 	{
-		for (auto ait = (*it)->attributes.begin(); ait != (*it)->attributes.end(); ++ait) {
-			f << stringf("%s  attribute %s ", indent.c_str(), ait->first.c_str());
-			dump_const(f, ait->second);
-			f << stringf("\n");
+		f << indent << "connect ";
+		dump_sigspec(left);
+		f << ' ';
+		dump_sigspec(right);
+		f << '\n';
+	}
+
+	void dump_module(const std::string &indent, RTLIL::Module *module, RTLIL::Design *design, bool only_selected, bool flag_m, bool flag_n)
+	{
+		bool print_header = flag_m || design->selected_whole_module(module->name);
+		bool print_body = !flag_n || !design->selected_whole_module(module->name);
+		std::string body_indent = indent + "  ";
+
+		if (print_header)
+		{
+			dump_attributes(indent, module->attributes);
+
+			f << indent << "module " << module->name.c_str() << '\n';
+
+			if (!module->avail_parameters.empty()) {
+				if (only_selected)
+					f << '\n';
+				for (auto &p : module->avail_parameters)
+					f << indent << "  parameter " << p.c_str() << '\n';
+			}
 		}
-		f << stringf("%s  case ", indent.c_str());
-		for (size_t i = 0; i < (*it)->compare.size(); i++) {
-			if (i > 0)
-				f << stringf(" , ");
-			dump_sigspec(f, (*it)->compare[i]);
+
+		if (print_body)
+		{
+			for (auto it : module->wires())
+				if (!only_selected || design->selected(module, it)) {
+					if (only_selected)
+						f << '\n';
+					dump_wire(body_indent, it);
+				}
+
+			for (auto it : module->memories)
+				if (!only_selected || design->selected(module, it.second)) {
+					if (only_selected)
+						f << '\n';
+					dump_memory(body_indent, it.second);
+				}
+
+			for (auto it : module->cells())
+				if (!only_selected || design->selected(module, it)) {
+					if (only_selected)
+						f << '\n';
+					dump_cell(body_indent, it);
+				}
+
+			for (auto it : module->processes)
+				if (!only_selected || design->selected(module, it.second)) {
+					if (only_selected)
+						f << '\n';
+					dump_proc(body_indent, it.second);
+				}
+
+			bool first_conn_line = true;
+			for (auto it = module->connections().begin(); it != module->connections().end(); ++it) {
+				bool show_conn = !only_selected;
+				if (only_selected) {
+					RTLIL::SigSpec sigs = it->first;
+					sigs.append(it->second);
+					for (auto &c : sigs.chunks()) {
+						if (c.wire == NULL || !design->selected(module, c.wire))
+							continue;
+						show_conn = true;
+					}
+				}
+				if (show_conn) {
+					if (only_selected && first_conn_line)
+						f << '\n';
+					dump_conn(body_indent, it->first, it->second);
+					first_conn_line = false;
+				}
+			}
 		}
-		f << stringf("\n");
 
-		dump_proc_case_body(f, indent + "    ", *it);
+		if (print_header)
+			f << indent << "end\n";
 	}
+};
 
-	f << stringf("%s" "end\n", indent.c_str());
 }
 
-void ILANG_BACKEND::dump_proc_sync(std::ostream &f, std::string indent, const RTLIL::SyncRule *sy)
+void ILANG_BACKEND::dump_const(std::ostream &f, const RTLIL::Const &data, int width, int offset, bool autoint)
 {
-	f << stringf("%s" "sync ", indent.c_str());
-	switch (sy->type) {
-	case RTLIL::ST0: f << stringf("low ");
-	if (0) case RTLIL::ST1: f << stringf("high ");
-	if (0) case RTLIL::STp: f << stringf("posedge ");
-	if (0) case RTLIL::STn: f << stringf("negedge ");
-	if (0) case RTLIL::STe: f << stringf("edge ");
-		dump_sigspec(f, sy->signal);
-		f << stringf("\n");
-		break;
-	case RTLIL::STa: f << stringf("always\n"); break;
-	case RTLIL::STg: f << stringf("global\n"); break;
-	case RTLIL::STi: f << stringf("init\n"); break;
-	}
-
-	for (auto it = sy->actions.begin(); it != sy->actions.end(); ++it) {
-		f << stringf("%s  update ", indent.c_str());
-		dump_sigspec(f, it->first);
-		f << stringf(" ");
-		dump_sigspec(f, it->second);
-		f << stringf("\n");
-	}
+	IlangDumper<std::ostream>(f).dump_const(data, width, offset, autoint);
 }
 
-void ILANG_BACKEND::dump_proc(std::ostream &f, std::string indent, const RTLIL::Process *proc)
+void ILANG_BACKEND::dump_sigchunk(std::ostream &f, const RTLIL::SigChunk &chunk, bool autoint)
 {
-	for (auto it = proc->attributes.begin(); it != proc->attributes.end(); ++it) {
-		f << stringf("%s" "attribute %s ", indent.c_str(), it->first.c_str());
-		dump_const(f, it->second);
-		f << stringf("\n");
-	}
-	f << stringf("%s" "process %s\n", indent.c_str(), proc->name.c_str());
-	dump_proc_case_body(f, indent + "  ", &proc->root_case);
-	for (auto it = proc->syncs.begin(); it != proc->syncs.end(); ++it)
-		dump_proc_sync(f, indent + "  ", *it);
-	f << stringf("%s" "end\n", indent.c_str());
+	IlangDumper<std::ostream>(f).dump_sigchunk(chunk, autoint);
 }
 
-void ILANG_BACKEND::dump_conn(std::ostream &f, std::string indent, const RTLIL::SigSpec &left, const RTLIL::SigSpec &right)
+void ILANG_BACKEND::dump_sigspec(std::ostream &f, const RTLIL::SigSpec &sig, bool autoint)
 {
-	f << stringf("%s" "connect ", indent.c_str());
-	dump_sigspec(f, left);
-	f << stringf(" ");
-	dump_sigspec(f, right);
-	f << stringf("\n");
+	IlangDumper<std::ostream>(f).dump_sigspec(sig, autoint);
 }
 
-void ILANG_BACKEND::dump_module(std::ostream &f, std::string indent, RTLIL::Module *module, RTLIL::Design *design, bool only_selected, bool flag_m, bool flag_n)
+void ILANG_BACKEND::dump_wire(std::ostream &f, std::string indent, const RTLIL::Wire *wire)
 {
-	bool print_header = flag_m || design->selected_whole_module(module->name);
-	bool print_body = !flag_n || !design->selected_whole_module(module->name);
-
-	if (print_header)
-	{
-		for (auto it = module->attributes.begin(); it != module->attributes.end(); ++it) {
-			f << stringf("%s" "attribute %s ", indent.c_str(), it->first.c_str());
-			dump_const(f, it->second);
-			f << stringf("\n");
-		}
+	IlangDumper<std::ostream>(f).dump_wire(indent, wire);
+}
 
-		f << stringf("%s" "module %s\n", indent.c_str(), module->name.c_str());
+void ILANG_BACKEND::dump_memory(std::ostream &f, std::string indent, const RTLIL::Memory *memory)
+{
+	IlangDumper<std::ostream>(f).dump_memory(indent, memory);
+}
 
-		if (!module->avail_parameters.empty()) {
-			if (only_selected)
-				f << stringf("\n");
-			for (auto &p : module->avail_parameters)
-				f << stringf("%s" "  parameter %s\n", indent.c_str(), p.c_str());
-		}
-	}
+void ILANG_BACKEND::dump_cell(std::ostream &f, std::string indent, const RTLIL::Cell *cell)
+{
+	IlangDumper<std::ostream>(f).dump_cell(indent, cell);
+}
 
-	if (print_body)
-	{
-		for (auto it : module->wires())
-			if (!only_selected || design->selected(module, it)) {
-				if (only_selected)
-					f << stringf("\n");
-				dump_wire(f, indent + "  ", it);
-			}
+void ILANG_BACKEND::dump_proc_case_body(std::ostream &f, std::string indent, const RTLIL::CaseRule *cs)
+{
+	IlangDumper<std::ostream>(f).dump_proc_case_body(indent, cs);
+}
 
-		for (auto it : module->memories)
-			if (!only_selected || design->selected(module, it.second)) {
-				if (only_selected)
-					f << stringf("\n");
-				dump_memory(f, indent + "  ", it.second);
-			}
+void ILANG_BACKEND::dump_proc_switch(std::ostream &f, std::string indent, const RTLIL::SwitchRule *sw)
+{
+	IlangDumper<std::ostream>(f).dump_proc_switch(indent, sw);
+}
 
-		for (auto it : module->cells())
-			if (!only_selected || design->selected(module, it)) {
-				if (only_selected)
-					f << stringf("\n");
-				dump_cell(f, indent + "  ", it);
-			}
+void ILANG_BACKEND::dump_proc_sync(std::ostream &f, std::string indent, const RTLIL::SyncRule *sy)
+{
+	IlangDumper<std::ostream>(f).dump_proc_sync(indent, sy);
+}
 
-		for (auto it : module->processes)
-			if (!only_selected || design->selected(module, it.second)) {
-				if (only_selected)
-					f << stringf("\n");
-				dump_proc(f, indent + "  ", it.second);
-			}
+void ILANG_BACKEND::dump_proc(std::ostream &f, std::string indent, const RTLIL::Process *proc)
+{
+	IlangDumper<std::ostream>(f).dump_proc(indent, proc);
+}
 
-		bool first_conn_line = true;
-		for (auto it = module->connections().begin(); it != module->connections().end(); ++it) {
-			bool show_conn = !only_selected;
-			if (only_selected) {
-				RTLIL::SigSpec sigs = it->first;
-				sigs.append(it->second);
-				for (auto &c : sigs.chunks()) {
-					if (c.wire == NULL || !design->selected(module, c.wire))
-						continue;
-					show_conn = true;
-				}
-			}
-			if (show_conn) {
-				if (only_selected && first_conn_line)
-					f << stringf("\n");
-				dump_conn(f, indent + "  ", it->first, it->second);
-				first_conn_line = false;
-			}
-		}
-	}
+void ILANG_BACKEND::dump_conn(std::ostream &f, std::string indent, const RTLIL::SigSpec &left, const RTLIL::SigSpec &right)
+{
+	IlangDumper<std::ostream>(f).dump_conn(indent, left, right);
+}
 
-	if (print_header)
-		f << stringf("%s" "end\n", indent.c_str());
+void ILANG_BACKEND::dump_module(std::ostream &f, std::string indent, RTLIL::Module *module, RTLIL::Design *design, bool only_selected, bool flag_m, bool flag_n)
+{
+	IlangDumper<std::ostream>(f).dump_module(indent, module, design, only_selected, flag_m, flag_n);
 }
 
-void ILANG_BACKEND::dump_design(std::ostream &f, RTLIL::Design *design, bool only_selected, bool flag_m, bool flag_n)
+void ILANG_BACKEND::dump_design(std::ostream &f, RTLIL::Design *design, bool only_selected, bool flag_m, bool flag_n, int num_threads)
 {
 #ifndef NDEBUG
 	int init_autoidx = autoidx;
@@ -371,16 +432,19 @@ void ILANG_BACKEND::dump_design(std::ostream &f, RTLIL::Design *design, bool onl
 	if (!only_selected || flag_m) {
 		if (only_selected)
 			f << stringf("\n");
-		f << stringf("autoidx %d\n", autoidx);
+		f << stringf("autoidx %d\n", autoidx.load());
 	}
 
-	for (auto it = design->modules_.begin(); it != design->modules_.end(); ++it) {
-		if (!only_selected || design->selected(it->second)) {
-			if (only_selected)
-				f << stringf("\n");
-			dump_module(f, "", it->second, design, only_selected, flag_m, flag_n);
-		}
-	}
+	std::vector<RTLIL::Module*> modules;
+	for (auto it = design->modules_.begin(); it != design->modules_.end(); ++it)
+		if (!only_selected || design->selected(it->second))
+			modules.push_back(it->second);
+
+	emit_modules(f, modules, num_threads, [&](EmitBuffer &buffer, RTLIL::Module *module) {
+		if (only_selected)
+			buffer << '\n';
+		IlangDumper<EmitBuffer>(buffer).dump_module("", module, design, only_selected, flag_m, flag_n);
+	});
 
 	log_assert(init_autoidx == autoidx);
 }
@@ -402,10 +466,15 @@ struct IlangBackend : public Backend {
 		log("    -selected\n");
 		log("        only write selected parts of the design.\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        write up to N modules concurrently. The output is the same as with\n");
+		log("        -j 1. The default is the number of threads set with 'yosys -j'.\n");
+		log("\n");
 	}
 	void execute(std::ostream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
 	{
 		bool selected = false;
+		int num_threads = yosys_threads;
 
 		log_header(design, "Executing ILANG backend.\n");
 
@@ -416,6 +485,10 @@ struct IlangBackend : public Backend {
 				selected = true;
 				continue;
 			}
+			if (arg == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
 			break;
 		}
 		extra_args(f, filename, args, argidx);
@@ -424,7 +497,7 @@ struct IlangBackend : public Backend {
 
 		log("Output filename: %s\n", filename.c_str());
 		*f << stringf("# Generated by %s\n", yosys_version_str);
-		ILANG_BACKEND::dump_design(*f, design, selected, true, false);
+		ILANG_BACKEND::dump_design(*f, design, selected, true, false, num_threads);
 	}
 } IlangBackend;
 
@@ -23,7 +23,10 @@
 #include "kernel/celltypes.h"
 #include "kernel/cellaigs.h"
 #include "kernel/log.h"
+#include "kernel/threadpool.h"
 #include <string>
+#include <sys/stat.h>
+#include <errno.h>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -34,13 +37,14 @@ struct JsonWriter
 	bool use_selection;
 	bool aig_mode;
 	bool compat_int_mode;
+	int num_threads = 1;
 
 	Design *design;
 	Module *module;
 
 	SigMap sigmap;
 	int sigidcounter;
-	dict<SigBit, string> sigids;
+	dict<SigBit, int> sigids;
 	pool<Aig> aig_models;
 
 	JsonWriter(std::ostream &f, bool use_selection, bool aig_mode, bool compat_int_mode) :
@@ -63,26 +67,28 @@ struct JsonWriter
 		return get_string(RTLIL::unescape_id(name));
 	}
 
-	string get_bits(SigSpec sig)
+	// bit vectors of flattened netlists can be huge, so they are written
+	// directly instead of being built as a string first
+	void write_bits(SigSpec sig)
 	{
 		bool first = true;
-		string str = "[";
+		f << "[";
 		for (auto bit : sigmap(sig)) {
-			str += first ? " " : ", ";
+			f << (first ? " " : ", ");
 			first = false;
-			if (sigids.count(bit) == 0) {
-				string &s = sigids[bit];
-				if (bit.wire == nullptr) {
-					if (bit == State::S0) s = "\"0\"";
-					else if (bit == State::S1) s = "\"1\"";
-					else if (bit == State::Sz) s = "\"z\"";
-					else s = "\"x\"";
-				} else
-					s = stringf("%d", sigidcounter++);
+			if (bit.wire == nullptr) {
+				if (bit == State::S0) f << "\"0\"";
+				else if (bit == State::S1) f << "\"1\"";
+				else if (bit == State::Sz) f << "\"z\"";
+				else f << "\"x\"";
+				continue;
 			}
-			str += sigids[bit];
+			auto it = sigids.find(bit);
+			if (it == sigids.end())
+				it = sigids.insert(std::make_pair(bit, sigidcounter++)).first;
+			f << it->second;
 		}
-		return str + " ]";
+		f << " ]";
 	}
 
 	void write_parameter_value(const Const &value)
@@ -154,7 +160,9 @@ struct JsonWriter
 				f << stringf("          \"offset\": %d,\n", w->start_offset);
 			if (w->upto)
 				f << stringf("          \"upto\": 1,\n");
-			f << stringf("          \"bits\": %s\n", get_bits(w).c_str());
+			f << "          \"bits\": ";
+			write_bits(w);
+			f << "\n";
 			f << stringf("        }");
 			first = false;
 		}
@@ -199,7 +207,8 @@ struct JsonWriter
 			bool first2 = true;
 			for (auto &conn : c->connections()) {
 				f << stringf("%s\n", first2 ? "" : ",");
-				f << stringf("            %s: %s", get_name(conn.first).c_str(), get_bits(conn.second).c_str());
+				f << stringf("            %s: ", get_name(conn.first).c_str());
+				write_bits(conn.second);
 				first2 = false;
 			}
 			f << stringf("\n          }\n");
@@ -216,7 +225,9 @@ struct JsonWriter
 			f << stringf("%s\n", first ? "" : ",");
 			f << stringf("        %s: {\n", get_name(w->name).c_str());
 			f << stringf("          \"hide_name\": %s,\n", w->name[0] == '$' ? "1" : "0");
-			f << stringf("          \"bits\": %s,\n", get_bits(w).c_str());
+			f << "          \"bits\": ";
+			write_bits(w);
+			f << ",\n";
 			if (w->start_offset)
 				f << stringf("          \"offset\": %d,\n", w->start_offset);
 			if (w->upto)
@@ -232,23 +243,15 @@ struct JsonWriter
 		f << stringf("    }");
 	}
 
-	void write_design(Design *design_)
+	void write_header()
 	{
-		design = design_;
-		design->sort();
-
 		f << stringf("{\n");
 		f << stringf("  \"creator\": %s,\n", get_string(yosys_version_str).c_str());
-		f << stringf("  \"modules\": {\n");
-		vector<Module*> modules = use_selection ? design->selected_modules() : design->modules();
-		bool first_module = true;
-		for (auto mod : modules) {
-			if (!first_module)
-				f << stringf(",\n");
-			write_module(mod);
-			first_module = false;
-		}
-		f << stringf("\n  }");
+	}
+
+	// writes the "models" section, if any, and the end of the document
+	void write_models()
+	{
 		if (!aig_models.empty()) {
 			f << stringf(",\n  \"models\": {\n");
 			bool first_model = true;
@@ -280,6 +283,118 @@ struct JsonWriter
 		}
 		f << stringf("\n}\n");
 	}
+
+	// writes a module with a writer of its own, for use on worker threads
+	void write_module_to(std::ostream &out, Module *module_, vector<Aig> &models)
+	{
+		JsonWriter writer(out, use_selection, aig_mode, compat_int_mode);
+		writer.design = design;
+		writer.write_module(module_);
+		// pools iterate in reverse insertion order
+		for (auto &aig : writer.aig_models)
+			models.push_back(aig);
+		std::reverse(models.begin(), models.end());
+	}
+
+	vector<Module*> get_modules()
+	{
+		return use_selection ? design->selected_modules() : design->modules();
+	}
+
+	void write_design(Design *design_)
+	{
+		design = design_;
+		design->sort();
+
+		write_header();
+		f << stringf("  \"modules\": {\n");
+		vector<Module*> modules = get_modules();
+		if (num_threads > 1 && GetSize(modules) > 1)
+		{
+			// Modules are written into buffers concurrently and copied to the
+			// output in order. Merging the AIG models in the same order keeps
+			// the "models" section identical to a serial run.
+			vector<string> buffers(GetSize(modules));
+			vector<vector<Aig>> models(GetSize(modules));
+			for_each_ordered(GetSize(modules), num_threads, [&](int i) {
+				std::ostringstream buf;
+				write_module_to(buf, modules[i], models[i]);
+				buffers[i] = buf.str();
+			}, [&](int i) {
+				if (i > 0)
+					f << stringf(",\n");
+				f << buffers[i];
+				string().swap(buffers[i]);
+				for (auto &aig : models[i])
+					aig_models.insert(aig);
+				vector<Aig>().swap(models[i]);
+			});
+		}
+		else
+		{
+			bool first_module = true;
+			for (auto mod : modules) {
+				if (!first_module)
+					f << stringf(",\n");
+				write_module(mod);
+				first_module = false;
+			}
+		}
+		f << stringf("\n  }");
+		write_models();
+	}
+
+	// Writes every module as a JSON document of its own into a directory, and
+	// an index of these files to the regular output.
+	void write_split(Design *design_, string dir)
+	{
+		design = design_;
+		design->sort();
+
+		struct stat st;
+#ifdef _WIN32
+		if (stat(dir.c_str(), &st) != 0 && mkdir(dir.c_str()) != 0)
+#else
+		if (stat(dir.c_str(), &st) != 0 && mkdir(dir.c_str(), 0777) != 0)
+#endif
+			log_error("Can't create directory `%s': %s\n", dir.c_str(), strerror(errno));
+
+		// file names are the module names with anything unusual replaced
+		vector<Module*> modules = get_modules();
+		vector<string> filenames;
+		pool<string> used_filenames;
+		for (auto mod : modules) {
+			string name = RTLIL::unescape_id(mod->name);
+			for (auto &c : name)
+				if (!isalnum((unsigned char)c) && c != '_' && c != '-' && c != '.')
+					c = '_';
+			string filename = name + ".json";
+			for (int i = 1; used_filenames.count(filename); i++)
+				filename = stringf("%s_%d.json", name.c_str(), i);
+			used_filenames.insert(filename);
+			filenames.push_back(filename);
+		}
+
+		write_header();
+		f << stringf("  \"module_files\": {");
+		for_each_ordered(GetSize(modules), num_threads, [&](int i) {
+			string path = dir + "/" + filenames[i];
+			std::ofstream mf(path.c_str(), std::ofstream::trunc);
+			if (mf.fail())
+				log_error("Can't open file `%s' for writing: %s\n", path.c_str(), strerror(errno));
+			JsonWriter writer(mf, use_selection, aig_mode, compat_int_mode);
+			writer.design = design;
+			writer.write_header();
+			mf << stringf("  \"modules\": {\n");
+			writer.write_module(modules[i]);
+			mf << stringf("\n  }");
+			writer.write_models();
+		}, [&](int i) {
+			f << stringf("%s\n", i > 0 ? "," : "");
+			f << stringf("    %s: %s", get_name(modules[i]->name).c_str(), get_string(filenames[i]).c_str());
+		});
+		f << stringf("\n  }\n}\n");
+	}
 };
 
 struct JsonBackend : public Backend {
@@ -299,6 +414,23 @@ struct JsonBackend : public Backend {
 		log("        emit 32-bit or smaller fully-defined parameter values directly\n");
 		log("        as JSON numbers (for compatibility with old parsers)\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        write up to N modules concurrently. The output is the same as with\n");
+		log("        -j 1. The default is the number of threads set with 'yosys -j'.\n");
+		log("\n");
+		log("    -split <directory>\n");
+		log("        write each module as a JSON document of its own (with the \"models\"\n");
+		log("        used by it) into the given directory, named after the module. The\n");
+		log("        regular output then only lists these files, relative to the\n");
+		log("        directory:\n");
+		log("\n");
+		log("            {\n");
+		log("              \"module_files\": {\n");
+		log("                <module_name>: <file_name>,\n");
+		log("                ...\n");
+		log("              }\n");
+		log("            }\n");
+		log("\n");
 		log("\n");
 		log("The general syntax of the JSON output created by this command is as follows:\n");
 		log("\n");
@@ -500,6 +632,8 @@ struct JsonBackend : public Backend {
 	{
 		bool aig_mode = false;
 		bool compat_int_mode = false;
+		int num_threads = yosys_threads;
+		std::string split_dir;
 
 		size_t argidx;
 		for (argidx = 1; argidx < args.size(); argidx++)
@@ -512,6 +646,15 @@ struct JsonBackend : public Backend {
 				compat_int_mode = true;
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
+			if (args[argidx] == "-split" && argidx+1 < args.size()) {
+				split_dir = args[++argidx];
+				rewrite_filename(split_dir);
+				continue;
+			}
 			break;
 		}
 		extra_args(f, filename, args, argidx);
@@ -519,7 +662,11 @@ struct JsonBackend : public Backend {
 		log_header(design, "Executing JSON backend.\n");
 
 		JsonWriter json_writer(*f, false, aig_mode, compat_int_mode);
-		json_writer.write_design(design);
+		json_writer.num_threads = num_threads;
+		if (split_dir.empty())
+			json_writer.write_design(design);
+		else
+			json_writer.write_split(design, split_dir);
 	}
 } JsonBackend;
 
@@ -19,6 +19,9 @@
  */
 
 #include <google/protobuf/text_format.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/wire_format_lite.h>
 
 #include "kernel/rtlil.h"
 #include "kernel/register.h"
@@ -62,17 +65,15 @@ struct ProtobufDesignSerializer
 			std::string key = get_name(param.first);
 
 
-			yosys::pb::Parameter pb_param;
+			yosys::pb::Parameter &pb_param = (*out)[key];
 
 			if ((param.second.flags & RTLIL::ConstFlags::CONST_FLAG_STRING) != 0) {
 				pb_param.set_str(param.second.decode_string());
-			} else if (GetSize(param.second.bits) > 64) {
+			} else if (GetSize(param.second) > 32 || !param.second.is_fully_def()) {
 				pb_param.set_str(param.second.as_string());
 			} else {
 				pb_param.set_int_(param.second.as_int());
 			}
-
-			(*out)[key] = pb_param;
 		}
 	}
 
@@ -113,28 +114,30 @@ struct ProtobufDesignSerializer
 			if (use_selection_ && !module_->selected(w))
 				continue;
 
-			yosys::pb::Module::Port pb_port;
+			yosys::pb::Module::Port &pb_port = (*out->mutable_port())[get_name(n)];
 			pb_port.set_direction(w->port_input ? w->port_output ?
 				yosys::pb::DIRECTION_INOUT : yosys::pb::DIRECTION_INPUT : yosys::pb::DIRECTION_OUTPUT);
+			pb_port.set_position(w->port_id);
 			get_bits(pb_port.mutable_bits(), w);
-			(*out->mutable_port())[get_name(n)] = pb_port;
 		}
 
 		for (auto c : module_->cells()) {
 			if (use_selection_ && !module_->selected(c))
 				continue;
 
-			yosys::pb::Module::Cell pb_cell;
-			pb_cell.set_hide_name(c->name[0] == '$');
-			pb_cell.set_type(get_name(c->type));
-
+			std::string model;
 			if (aig_mode_) {
 				Aig aig(c);
 				if (aig.name.empty())
 					continue;
-				pb_cell.set_model(aig.name);
+				model = aig.name;
 				aig_models_.insert(aig);
 			}
+
+			yosys::pb::Module::Cell &pb_cell = (*out->mutable_cell())[get_name(c->name)];
+			pb_cell.set_hide_name(c->name[0] == '$');
+			pb_cell.set_type(get_name(c->type));
+			pb_cell.set_model(model);
 			serialize_parameters(pb_cell.mutable_parameter(), c->parameters);
 			serialize_parameters(pb_cell.mutable_attribute(), c->attributes);
 
@@ -146,13 +149,8 @@ struct ProtobufDesignSerializer
 					(*pb_cell.mutable_port_direction())[get_name(conn.first)] = direction;
 				}
 			}
-			for (auto &conn : c->connections()) {
-				yosys::pb::BitVector vec;
-				get_bits(&vec, conn.second);
-				(*pb_cell.mutable_connection())[get_name(conn.first)] = vec;
-			}
-
-			(*out->mutable_cell())[get_name(c->name)] = pb_cell;
+			for (auto &conn : c->connections())
+				get_bits(&(*pb_cell.mutable_connection())[get_name(conn.first)], conn.second);
 		}
 
 		for (auto w : module_->wires()) {
@@ -161,6 +159,7 @@ struct ProtobufDesignSerializer
 
 			auto netname = out->add_netname();
 			netname->set_hide_name(w->name[0] == '$');
+			netname->set_name(get_name(w->name));
 			get_bits(netname->mutable_bits(), w);
 			serialize_parameters(netname->mutable_attributes(), w->attributes);
 		}
@@ -170,7 +169,7 @@ struct ProtobufDesignSerializer
 	void serialize_models(google::protobuf::Map<string, yosys::pb::Model> *models)
 	{
 		for (auto &aig : aig_models_) {
-			yosys::pb::Model pb_model;
+			yosys::pb::Model &pb_model = (*models)[aig.name];
 			for (auto &node : aig.nodes) {
 				auto pb_node = pb_model.add_node();
 				if (node.portbit >= 0) {
@@ -204,7 +203,6 @@ struct ProtobufDesignSerializer
 					pb_op->set_bit_index(op.second);
 				}
 			}
-			(*models)[aig.name] = pb_model;
 		}
 	}
 
@@ -218,14 +216,66 @@ struct ProtobufDesignSerializer
 		design_ = design;
 		design_->sort();
 
+		auto modules = use_selection_ ? design_->selected_modules() : design_->modules();
+		for (auto mod : modules)
+			serialize_module(&(*pb->mutable_modules())[mod->name.str()], mod);
+
+		serialize_models(pb_->mutable_models());
+	}
+
+	// Writes a map<string, ...> entry of the Design message. This produces the
+	// same encoding as serializing a Design with that single map entry.
+	static void write_map_entry(google::protobuf::io::CodedOutputStream *out, int field_number,
+			const std::string &key, const google::protobuf::MessageLite &value)
+	{
+		using google::protobuf::internal::WireFormatLite;
+
+		size_t value_size = value.ByteSizeLong();
+		if (value_size > INT_MAX)
+			log_error("Protobuf message for `%s' exceeds the 2GB size limit.\n", key.c_str());
+
+		size_t entry_size = 1 + WireFormatLite::StringSize(key) + 1 + WireFormatLite::LengthDelimitedSize(value_size);
+		out->WriteTag(WireFormatLite::MakeTag(field_number, WireFormatLite::WIRETYPE_LENGTH_DELIMITED));
+		out->WriteVarint64(entry_size);
+		WireFormatLite::WriteString(1, key, out);
+		out->WriteTag(WireFormatLite::MakeTag(2, WireFormatLite::WIRETYPE_LENGTH_DELIMITED));
+		out->WriteVarint32(value_size);
+		value.SerializeWithCachedSizes(out);
+	}
+
+	// Writes the binary Design message one module at a time, so that only a
+	// single module is held in memory (allocated in an arena that is dropped
+	// after the module is written).
+	void write_design(std::ostream *f, Design *design)
+	{
+		GOOGLE_PROTOBUF_VERIFY_VERSION;
+		using google::protobuf::internal::WireFormatLite;
+
+		design_ = design;
+		design_->sort();
+
+		google::protobuf::io::OstreamOutputStream zero_copy_stream(f);
+
+		{
+			google::protobuf::io::CodedOutputStream out(&zero_copy_stream);
+			WireFormatLite::WriteString(1, yosys_version_str, &out);
+		}
+
 		auto modules = use_selection_ ? design_->selected_modules() : design_->modules();
 		for (auto mod : modules) {
-			yosys::pb::Module pb_mod;
-			serialize_module(&pb_mod, mod);
-			(*pb->mutable_modules())[mod->name.str()] = pb_mod;
+			google::protobuf::Arena arena;
+			auto pb_mod = google::protobuf::Arena::CreateMessage<yosys::pb::Module>(&arena);
+			serialize_module(pb_mod, mod);
+			google::protobuf::io::CodedOutputStream out(&zero_copy_stream);
+			write_map_entry(&out, 2, mod->name.str(), *pb_mod);
 		}
 
-		serialize_models(pb_->mutable_models());
+		google::protobuf::Arena arena;
+		auto pb_models = google::protobuf::Arena::CreateMessage<yosys::pb::Design>(&arena);
+		serialize_models(pb_models->mutable_models());
+		google::protobuf::io::CodedOutputStream out(&zero_copy_stream);
+		for (auto &it : pb_models->models())
+			write_map_entry(&out, 3, it.first, it.second);
 	}
 };
 
@@ -237,7 +287,8 @@ struct ProtobufBackend : public Backend {
 		log("\n");
 		log("    write_protobuf [options] [filename]\n");
 		log("\n");
-		log("Write a JSON netlist of the current design.\n");
+		log("Write a Protocol Buffer netlist of the current design. The binary output is\n");
+		log("written one module at a time, and can be read back with 'read_protobuf'.\n");
 		log("\n");
 		log("    -aig\n");
 		log("        include AIG models for the different gate types\n");
@@ -245,7 +296,7 @@ struct ProtobufBackend : public Backend {
 		log("    -text\n");
 		log("        output protobuf in Text/ASCII representation\n");
 		log("\n");
-		log("The schema of the output Protocol Buffer is defined in misc/yosys.pb in the\n");
+		log("The schema of the output Protocol Buffer is defined in misc/yosys.proto in the\n");
 		log("Yosys source code distribution.\n");
 		log("\n");
 	}
@@ -270,16 +321,16 @@ struct ProtobufBackend : public Backend {
 
 		log_header(design, "Executing Protobuf backend.\n");
 
-		yosys::pb::Design pb;
 		ProtobufDesignSerializer serializer(false, aig_mode);
-		serializer.serialize_design(&pb, design);
 
 		if (text_mode) {
+			yosys::pb::Design pb;
+			serializer.serialize_design(&pb, design);
 			string out;
 			google::protobuf::TextFormat::PrintToString(pb, &out);
 			*f << out;
 		} else {
-			pb.SerializeToOstream(f);
+			serializer.write_design(f, design);
 		}
 	}
 } ProtobufBackend;
@@ -292,7 +343,7 @@ struct ProtobufPass : public Pass {
 		log("\n");
 		log("    protobuf [options] [selection]\n");
 		log("\n");
-		log("Write a JSON netlist of all selected objects.\n");
+		log("Write a Protocol Buffer netlist of all selected objects.\n");
 		log("\n");
 		log("    -o <filename>\n");
 		log("        write to the specified file.\n");
@@ -303,7 +354,7 @@ struct ProtobufPass : public Pass {
 		log("    -text\n");
 		log("        output protobuf in Text/ASCII representation\n");
 		log("\n");
-		log("The schema of the output Protocol Buffer is defined in misc/yosys.pb in the\n");
+		log("The schema of the output Protocol Buffer is defined in misc/yosys.proto in the\n");
 		log("Yosys source code distribution.\n");
 		log("\n");
 	}
@@ -348,16 +399,16 @@ struct ProtobufPass : public Pass {
 			f = &buf;
 		}
 
-		yosys::pb::Design pb;
 		ProtobufDesignSerializer serializer(true, aig_mode);
-		serializer.serialize_design(&pb, design);
 
 		if (text_mode) {
+			yosys::pb::Design pb;
+			serializer.serialize_design(&pb, design);
 			string out;
 			google::protobuf::TextFormat::PrintToString(pb, &out);
 			*f << out;
 		} else {
-			pb.SerializeToOstream(f);
+			serializer.write_design(f, design);
 		}
 
 		if (!filename.empty()) {
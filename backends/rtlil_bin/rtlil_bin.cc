@@ -0,0 +1,576 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *  ---
+ *
+ *  Writer and reader for the binary RTLIL format.
+ *
+ */
+
+#include "rtlil_bin.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// File layout: the 8 byte magic, then the number of modules and the modules.
+// All integers are LEB128 varints (signed values zigzag encoded). An IdString
+// is written as 0 followed by its length and characters the first time it
+// occurs, and as its (index+1) in the order of first occurrence afterwards. A
+// SigSpec is a list of chunks, each either (wire index+1, offset, width) or 0
+// followed by a constant. Constant bits are packed 8 per byte when they are
+// all 0 or 1, and 2 per byte otherwise.
+
+static const char rtlil_bin_magic[8] = { 'Y', 'S', 'R', 'T', 'L', 'B', 0, 1 };
+
+bool RTLIL_BIN::check_magic(const char *data, size_t size)
+{
+	return size >= sizeof(rtlil_bin_magic) && memcmp(data, rtlil_bin_magic, sizeof(rtlil_bin_magic)) == 0;
+}
+
+struct RtlilBinWriter
+{
+	std::ostream &f;
+	std::string buffer;
+	dict<RTLIL::IdString, int> id_index;
+	dict<const RTLIL::Wire*, int> wire_index;
+
+	RtlilBinWriter(std::ostream &f) : f(f) { }
+
+	void flush()
+	{
+		f.write(buffer.data(), buffer.size());
+		buffer.clear();
+	}
+
+	void write_uint(uint64_t value)
+	{
+		while (value >= 0x80) {
+			buffer += char(value | 0x80);
+			value >>= 7;
+		}
+		buffer += char(value);
+	}
+
+	void write_int(int64_t value)
+	{
+		write_uint((uint64_t(value) << 1) ^ uint64_t(value >> 63));
+	}
+
+	void write_id(RTLIL::IdString id)
+	{
+		auto it = id_index.find(id);
+		if (it != id_index.end()) {
+			write_uint(it->second + 1);
+			return;
+		}
+		int index = GetSize(id_index);
+		id_index[id] = index;
+		const std::string &str = id.str();
+		write_uint(0);
+		write_uint(str.size());
+		buffer += str;
+	}
+
+	void write_bits(const std::vector<RTLIL::State> &bits, int offset, int width)
+	{
+		bool binary = true;
+		for (int i = 0; i < width; i++)
+			if (bits[offset+i] != State::S0 && bits[offset+i] != State::S1) {
+				binary = false;
+				break;
+			}
+
+		write_uint((uint64_t(width) << 1) | (binary ? 0 : 1));
+		if (binary) {
+			for (int i = 0; i < width; i += 8) {
+				unsigned char byte = 0;
+				for (int j = 0; j < 8 && i+j < width; j++)
+					if (bits[offset+i+j] == State::S1)
+						byte |= 1 << j;
+				buffer += char(byte);
+			}
+		} else {
+			for (int i = 0; i < width; i += 2) {
+				unsigned char byte = bits[offset+i];
+				if (i+1 < width)
+					byte |= bits[offset+i+1] << 4;
+				buffer += char(byte);
+			}
+		}
+	}
+
+	void write_const(const RTLIL::Const &value)
+	{
+		buffer += char(value.flags);
+		write_bits(value.to_bits(), 0, GetSize(value));
+	}
+
+	void write_sig(const RTLIL::SigSpec &sig)
+	{
+		write_uint(GetSize(sig.chunks()));
+		for (auto &chunk : sig.chunks()) {
+			if (chunk.wire == nullptr) {
+				write_uint(0);
+				write_bits(chunk.data, 0, chunk.width);
+			} else {
+				write_uint(wire_index.at(chunk.wire) + 1);
+				write_uint(chunk.offset);
+				write_uint(chunk.width);
+			}
+		}
+	}
+
+	void write_attrs(const dict<RTLIL::IdString, RTLIL::Const> &attrs)
+	{
+		// dict iterates newest entry first, write the entries in insertion
+		// order so that the reader recreates the dict in the same order
+		std::vector<const std::pair<RTLIL::IdString, RTLIL::Const>*> entries;
+		entries.reserve(GetSize(attrs));
+		for (auto &it : attrs)
+			entries.push_back(&it);
+
+		write_uint(GetSize(entries));
+		for (int i = GetSize(entries)-1; i >= 0; i--) {
+			write_id(entries[i]->first);
+			write_const(entries[i]->second);
+		}
+	}
+
+	void write_actions(const std::vector<RTLIL::SigSig> &actions)
+	{
+		write_uint(GetSize(actions));
+		for (auto &it : actions) {
+			write_sig(it.first);
+			write_sig(it.second);
+		}
+	}
+
+	void write_case(const RTLIL::CaseRule *cs)
+	{
+		write_attrs(cs->attributes);
+		write_uint(GetSize(cs->compare));
+		for (auto &sig : cs->compare)
+			write_sig(sig);
+		write_actions(cs->actions);
+		write_uint(GetSize(cs->switches));
+		for (auto sw : cs->switches) {
+			write_attrs(sw->attributes);
+			write_sig(sw->signal);
+			write_uint(GetSize(sw->cases));
+			for (auto c : sw->cases)
+				write_case(c);
+		}
+	}
+
+	void write_module(RTLIL::Module *module)
+	{
+		write_id(module->name);
+		write_attrs(module->attributes);
+
+		write_uint(GetSize(module->avail_parameters));
+		for (auto &param : module->avail_parameters)
+			write_id(param);
+
+		wire_index.clear();
+		write_uint(GetSize(module->wires_));
+		for (auto &it : module->wires_) {
+			RTLIL::Wire *wire = it.second;
+			int index = GetSize(wire_index);
+			wire_index[wire] = index;
+			write_id(wire->name);
+			write_uint(wire->width);
+			write_int(wire->start_offset);
+			write_uint(wire->port_id);
+			buffer += char((wire->port_input ? 1 : 0) | (wire->port_output ? 2 : 0) | (wire->upto ? 4 : 0));
+			write_attrs(wire->attributes);
+		}
+
+		write_uint(GetSize(module->memories));
+		for (auto &it : module->memories) {
+			RTLIL::Memory *memory = it.second;
+			write_id(memory->name);
+			write_uint(memory->width);
+			write_int(memory->start_offset);
+			write_uint(memory->size);
+			write_attrs(memory->attributes);
+		}
+
+		write_uint(GetSize(module->cells_));
+		for (auto &it : module->cells_) {
+			RTLIL::Cell *cell = it.second;
+			write_id(cell->name);
+			write_id(cell->type);
+			write_attrs(cell->parameters);
+			write_attrs(cell->attributes);
+			write_uint(GetSize(cell->connections()));
+			for (auto &conn : cell->connections()) {
+				write_id(conn.first);
+				write_sig(conn.second);
+			}
+		}
+
+		write_actions(module->connections());
+
+		write_uint(GetSize(module->processes));
+		for (auto &it : module->processes) {
+			RTLIL::Process *proc = it.second;
+			write_id(proc->name);
+			write_attrs(proc->attributes);
+			write_case(&proc->root_case);
+			write_uint(GetSize(proc->syncs));
+			for (auto sync : proc->syncs) {
+				buffer += char(sync->type);
+				write_sig(sync->signal);
+				write_actions(sync->actions);
+			}
+		}
+
+		if (GetSize(buffer) >= (1 << 20))
+			flush();
+	}
+};
+
+void RTLIL_BIN::write_design(std::ostream &f, RTLIL::Design *design)
+{
+	RtlilBinWriter writer(f);
+	writer.buffer.append(rtlil_bin_magic, sizeof(rtlil_bin_magic));
+	writer.write_uint(GetSize(design->modules_));
+	for (auto &it : design->modules_)
+		writer.write_module(it.second);
+	writer.flush();
+}
+
+struct RtlilBinReader
+{
+	const unsigned char *ptr, *end;
+	std::vector<RTLIL::IdString> ids;
+	std::vector<RTLIL::Wire*> wires;
+
+	RtlilBinReader(const char *data, size_t size) :
+			ptr((const unsigned char*)data), end((const unsigned char*)data + size) { }
+
+	void need(size_t n)
+	{
+		if (size_t(end - ptr) < n)
+			log_error("Unexpected end of binary RTLIL data.\n");
+	}
+
+	unsigned char read_byte()
+	{
+		need(1);
+		return *(ptr++);
+	}
+
+	uint64_t read_uint()
+	{
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			unsigned char byte = read_byte();
+			value |= uint64_t(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+				return value;
+		}
+		log_error("Invalid integer in binary RTLIL data.\n");
+	}
+
+	int read_int()
+	{
+		uint64_t value = read_uint();
+		return int64_t(value >> 1) ^ -int64_t(value & 1);
+	}
+
+	int read_size()
+	{
+		uint64_t value = read_uint();
+		if (value > uint64_t(INT_MAX))
+			log_error("Invalid size in binary RTLIL data.\n");
+		return value;
+	}
+
+	// every counted item takes at least one byte
+	int read_count()
+	{
+		uint64_t value = read_uint();
+		if (value > uint64_t(end - ptr))
+			log_error("Invalid item count in binary RTLIL data.\n");
+		return value;
+	}
+
+	RTLIL::IdString read_id()
+	{
+		uint64_t index = read_uint();
+		if (index > 0) {
+			if (index > ids.size())
+				log_error("Invalid string reference in binary RTLIL data.\n");
+			return ids[index-1];
+		}
+		size_t len = read_size();
+		need(len);
+		ids.push_back(RTLIL::IdString(std::string((const char*)ptr, len)));
+		ptr += len;
+		return ids.back();
+	}
+
+	void read_bits(std::vector<RTLIL::State> &bits)
+	{
+		uint64_t header = read_uint();
+		int width = header >> 1;
+		bool binary = (header & 1) == 0;
+		need(binary ? (width + 7) / 8 : (width + 1) / 2);
+		bits.resize(width);
+		if (binary) {
+			for (int i = 0; i < width; i++)
+				bits[i] = (ptr[i / 8] >> (i % 8)) & 1 ? State::S1 : State::S0;
+			ptr += (width + 7) / 8;
+		} else {
+			for (int i = 0; i < width; i++) {
+				int state = (ptr[i / 2] >> (4 * (i % 2))) & 15;
+				if (state > State::Sm)
+					log_error("Invalid constant bit in binary RTLIL data.\n");
+				bits[i] = RTLIL::State(state);
+			}
+			ptr += (width + 1) / 2;
+		}
+	}
+
+	RTLIL::Const read_const()
+	{
+		RTLIL::Const value;
+		value.flags = read_byte();
+		read_bits(value.bits());
+		value.pack();
+		return value;
+	}
+
+	RTLIL::SigSpec read_sig()
+	{
+		RTLIL::SigSpec sig;
+		int num_chunks = read_count();
+		for (int i = 0; i < num_chunks; i++) {
+			uint64_t index = read_uint();
+			if (index == 0) {
+				RTLIL::Const value;
+				read_bits(value.bits());
+				sig.append(value);
+				continue;
+			}
+			if (index > wires.size())
+				log_error("Invalid wire reference in binary RTLIL data.\n");
+			RTLIL::Wire *wire = wires[index-1];
+			int offset = read_size();
+			int width = read_size();
+			if (int64_t(offset) + width > wire->width)
+				log_error("Invalid range of wire %s in binary RTLIL data.\n", log_id(wire));
+			sig.append(RTLIL::SigSpec(wire, offset, width));
+		}
+		return sig;
+	}
+
+	void read_attrs(dict<RTLIL::IdString, RTLIL::Const> &attrs)
+	{
+		int count = read_count();
+		for (int i = 0; i < count; i++) {
+			RTLIL::IdString key = read_id();
+			attrs[key] = read_const();
+		}
+	}
+
+	void read_actions(std::vector<RTLIL::SigSig> &actions)
+	{
+		int count = read_count();
+		actions.reserve(count);
+		for (int i = 0; i < count; i++) {
+			RTLIL::SigSpec lhs = read_sig();
+			RTLIL::SigSpec rhs = read_sig();
+			actions.push_back(RTLIL::SigSig(lhs, rhs));
+		}
+	}
+
+	void read_case(RTLIL::CaseRule *cs)
+	{
+		read_attrs(cs->attributes);
+		int num_compare = read_count();
+		for (int i = 0; i < num_compare; i++)
+			cs->compare.push_back(read_sig());
+		read_actions(cs->actions);
+		int num_switches = read_count();
+		for (int i = 0; i < num_switches; i++) {
+			RTLIL::SwitchRule *sw = new RTLIL::SwitchRule;
+			cs->switches.push_back(sw);
+			read_attrs(sw->attributes);
+			sw->signal = read_sig();
+			int num_cases = read_count();
+			for (int j = 0; j < num_cases; j++) {
+				RTLIL::CaseRule *c = new RTLIL::CaseRule;
+				sw->cases.push_back(c);
+				read_case(c);
+			}
+		}
+	}
+
+	void read_module(RTLIL::Design *design, bool overwrite)
+	{
+		RTLIL::IdString name = read_id();
+		RTLIL::Module *existing = design->module(name);
+		if (existing != nullptr) {
+			if (!overwrite)
+				log_error("Re-definition of module %s.\n", log_id(name));
+			log("Replacing existing module %s.\n", log_id(name));
+			design->remove(existing);
+		}
+
+		RTLIL::Module *module = new RTLIL::Module;
+		module->name = name;
+		design->add(module);
+
+		read_attrs(module->attributes);
+
+		int num_params = read_count();
+		for (int i = 0; i < num_params; i++)
+			module->avail_parameters.insert(read_id());
+
+		wires.clear();
+		int num_wires = read_count();
+		wires.reserve(num_wires);
+		for (int i = 0; i < num_wires; i++) {
+			RTLIL::IdString wire_name = read_id();
+			int width = read_size();
+			if (module->wire(wire_name) != nullptr)
+				log_error("Duplicate wire %s in module %s in binary RTLIL data.\n", log_id(wire_name), log_id(module));
+			RTLIL::Wire *wire = module->addWire(wire_name, width);
+			wire->start_offset = read_int();
+			wire->port_id = read_size();
+			unsigned char flags = read_byte();
+			wire->port_input = (flags & 1) != 0;
+			wire->port_output = (flags & 2) != 0;
+			wire->upto = (flags & 4) != 0;
+			read_attrs(wire->attributes);
+			wires.push_back(wire);
+		}
+
+		int num_memories = read_count();
+		for (int i = 0; i < num_memories; i++) {
+			RTLIL::Memory *memory = new RTLIL::Memory;
+			memory->name = read_id();
+			memory->width = read_size();
+			memory->start_offset = read_int();
+			memory->size = read_size();
+			read_attrs(memory->attributes);
+			module->memories[memory->name] = memory;
+		}
+
+		int num_cells = read_count();
+		for (int i = 0; i < num_cells; i++) {
+			RTLIL::IdString cell_name = read_id();
+			RTLIL::IdString cell_type = read_id();
+			if (module->cell(cell_name) != nullptr)
+				log_error("Duplicate cell %s in module %s in binary RTLIL data.\n", log_id(cell_name), log_id(module));
+			RTLIL::Cell *cell = module->addCell(cell_name, cell_type);
+			read_attrs(cell->parameters);
+			read_attrs(cell->attributes);
+			int num_conns = read_count();
+			for (int j = 0; j < num_conns; j++) {
+				RTLIL::IdString port = read_id();
+				cell->setPort(port, read_sig());
+			}
+		}
+
+		std::vector<RTLIL::SigSig> connections;
+		read_actions(connections);
+		for (auto &conn : connections)
+			module->connect(conn);
+
+		int num_processes = read_count();
+		for (int i = 0; i < num_processes; i++) {
+			RTLIL::Process *proc = new RTLIL::Process;
+			proc->name = read_id();
+			module->processes[proc->name] = proc;
+			read_attrs(proc->attributes);
+			read_case(&proc->root_case);
+			int num_syncs = read_count();
+			for (int j = 0; j < num_syncs; j++) {
+				RTLIL::SyncRule *sync = new RTLIL::SyncRule;
+				proc->syncs.push_back(sync);
+				unsigned char type = read_byte();
+				if (type > RTLIL::STi)
+					log_error("Invalid sync rule type in binary RTLIL data.\n");
+				sync->type = RTLIL::SyncType(type);
+				sync->signal = read_sig();
+				read_actions(sync->actions);
+			}
+		}
+
+		module->fixup_ports();
+	}
+};
+
+void RTLIL_BIN::read_design(const char *data, size_t size, RTLIL::Design *design, bool overwrite)
+{
+	if (!check_magic(data, size))
+		log_error("Not a binary RTLIL file (or unsupported format version).\n");
+
+	RtlilBinReader reader(data + sizeof(rtlil_bin_magic), size - sizeof(rtlil_bin_magic));
+	int num_modules = reader.read_count();
+	for (int i = 0; i < num_modules; i++)
+		reader.read_module(design, overwrite);
+}
+
+bool RTLIL_BIN::read_file(const std::string &filename, RTLIL::Design *design, bool overwrite)
+{
+	MappedFile file;
+	if (!file.open(filename) || !check_magic(file.data, file.size))
+		return false;
+
+	read_design(file.data, file.size, design, overwrite);
+	return true;
+}
+
+struct RtlilBinBackend : public Backend {
+	RtlilBinBackend() : Backend("rtlil_bin", "write design to binary RTLIL file") { }
+	void help() YS_OVERRIDE
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    write_rtlil_bin [filename]\n");
+		log("\n");
+		log("Write the current design to a file in a compact binary representation of\n");
+		log("RTLIL, that can be read back with 'read_rtlil_bin'. This is much faster to\n");
+		log("write and read than 'write_ilang'/'read_ilang' and meant for checkpoints\n");
+		log("between flow stages. The format may change between Yosys versions and is not\n");
+		log("meant for exchanging designs with other tools.\n");
+		log("\n");
+		log("Like 'write_ilang', this only writes RTLIL. The Verilog AST of modules is not\n");
+		log("kept, so parametric modules can not be derived from a design read back from a\n");
+		log("binary RTLIL file.\n");
+		log("\n");
+	}
+	void execute(std::ostream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
+	{
+		log_header(design, "Executing binary RTLIL backend.\n");
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++) {
+			// std::string arg = args[argidx];
+			break;
+		}
+		extra_args(f, filename, args, argidx, true);
+
+		log("Output filename: %s\n", filename.c_str());
+		RTLIL_BIN::write_design(*f, design);
+	}
+} RtlilBinBackend;
+
+YOSYS_NAMESPACE_END
@@ -0,0 +1,45 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *  ---
+ *
+ *  A compact binary representation of RTLIL designs, used for fast
+ *  checkpoints between flow stages ('write_rtlil_bin', 'read_rtlil_bin'
+ *  and 'design -save -file').
+ *
+ */
+
+#ifndef RTLIL_BIN_H
+#define RTLIL_BIN_H
+
+#include "kernel/yosys.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+namespace RTLIL_BIN {
+	// returns true if the data starts with the binary RTLIL magic
+	bool check_magic(const char *data, size_t size);
+	void write_design(std::ostream &f, RTLIL::Design *design);
+	void read_design(const char *data, size_t size, RTLIL::Design *design, bool overwrite = false);
+	// maps the file into memory (where supported) and reads it, returns false
+	// if the file could not be opened or is not a binary RTLIL file
+	bool read_file(const std::string &filename, RTLIL::Design *design, bool overwrite = false);
+}
+
+YOSYS_NAMESPACE_END
+
+#endif
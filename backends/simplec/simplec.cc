@@ -151,6 +151,7 @@ struct HierDirtyFlags
 struct SimplecWorker
 {
 	bool verbose = false;
+	bool api = false;
 	int max_uintsize = 32;
 
 	Design *design;
@@ -378,6 +379,12 @@ struct SimplecWorker
 
 	void eval_cell(HierDirtyFlags *work, Cell *cell)
 	{
+		if (cell->type.in("$_DFF_P_", "$_DFF_N_"))
+		{
+			// flip-flops only change their state in the tick function
+			return;
+		}
+
 		if (cell->type.in("$_BUF_", "$_NOT_"))
 		{
 			SigBit a = sigmaps.at(work->module)(cell->getPort("\\A"));
@@ -657,7 +664,7 @@ struct SimplecWorker
 			{
 				SigSpec sig = sigmaps.at(module)(w);
 				Const val = w->attributes.at("\\init");
-				val.bits.resize(GetSize(sig), State::Sx);
+				val.bits().resize(GetSize(sig), State::Sx);
 
 				for (int i = 0; i < GetSize(sig); i++)
 					if (val[i] == State::S0 || val[i] == State::S1) {
@@ -707,9 +714,119 @@ struct SimplecWorker
 		make_func(work, cid(work->module->name) + "_eval", preamble);
 	}
 
-	void make_tick_func(HierDirtyFlags* /* work */)
+	void collect_ffs(HierDirtyFlags *work, vector<pair<HierDirtyFlags*, Cell*>> &ffs)
 	{
-		// FIXME
+		for (Cell *cell : work->module->cells())
+			if (cell->type.in("$_DFF_P_", "$_DFF_N_"))
+				ffs.push_back(make_pair(work, cell));
+
+		for (auto &child : work->children)
+			collect_ffs(child.second, ffs);
+	}
+
+	void make_tick_func(HierDirtyFlags *work)
+	{
+		vector<pair<HierDirtyFlags*, Cell*>> ffs;
+		vector<string> preamble;
+
+		collect_ffs(work, ffs);
+
+		// all flip-flops sample their D input before any Q output is updated
+		for (int i = 0; i < GetSize(ffs); i++)
+		{
+			HierDirtyFlags *ffwork = ffs[i].first;
+			Cell *cell = ffs[i].second;
+			SigBit d = sigmaps.at(ffwork->module)(cell->getPort("\\D"));
+
+			string d_expr = d.wire ? util_get_bit(ffwork->prefix + cid(d.wire->name), d.wire->width, d.offset) : d.data ? "1" : "0";
+			preamble.push_back(stringf("  bool ff_next_%d = %s; // %s.%s (%s)", i, d_expr.c_str(),
+					ffwork->log_prefix.c_str(), log_id(cell), log_id(cell->type)));
+		}
+
+		for (int i = 0; i < GetSize(ffs); i++)
+		{
+			HierDirtyFlags *ffwork = ffs[i].first;
+			Cell *cell = ffs[i].second;
+			SigBit q = sigmaps.at(ffwork->module)(cell->getPort("\\Q"));
+
+			log_assert(q.wire);
+			preamble.push_back(util_set_bit(ffwork->prefix + cid(q.wire->name), q.wire->width, q.offset, stringf("ff_next_%d", i)));
+			ffwork->set_dirty(q);
+		}
+
+		make_func(work, cid(work->module->name) + "_tick", preamble);
+	}
+
+	void make_api_funcs(Module *mod)
+	{
+		SigMap &sigmap = sigmaps.at(mod);
+		string modname = cid(mod->name);
+		vector<string> get_lines, set_lines;
+		int wire_idx = 0;
+
+		log("Generating yosys_simplec_*() API functions for module %s.\n", log_id(mod));
+
+		for (Wire *w : mod->wires())
+		{
+			get_lines.push_back(stringf("  case %d: // %s", wire_idx, log_id(w)));
+			get_lines.push_back("    switch (bit) {");
+			set_lines.push_back(stringf("  case %d: // %s", wire_idx, log_id(w)));
+			set_lines.push_back("    switch (bit) {");
+
+			for (int i = 0; i < GetSize(w); i++)
+			{
+				SigBit bit = sigmap(SigBit(w, i));
+
+				if (bit.wire == nullptr) {
+					get_lines.push_back(stringf("    case %d: return %s;", i, bit.data == State::S1 ? "true" : "false"));
+					continue;
+				}
+
+				get_lines.push_back(stringf("    case %d: return %s;", i, util_get_bit("state->" + cid(bit.wire->name), bit.wire->width, bit.offset).c_str()));
+				set_lines.push_back(stringf("    case %d:%s break;", i, util_set_bit("state->" + cid(bit.wire->name), bit.wire->width, bit.offset, "value").c_str()));
+			}
+
+			get_lines.push_back("    }");
+			get_lines.push_back("    break;");
+			set_lines.push_back("    }");
+			set_lines.push_back("    break;");
+			wire_idx++;
+		}
+
+		funct_declarations.push_back("");
+		funct_declarations.push_back("size_t yosys_simplec_state_size(void)");
+		funct_declarations.push_back("{");
+		funct_declarations.push_back(stringf("  return sizeof(struct %s_state_t);", modname.c_str()));
+		funct_declarations.push_back("}");
+
+		for (auto func : {"init", "eval", "tick"}) {
+			funct_declarations.push_back("");
+			funct_declarations.push_back(stringf("void yosys_simplec_%s(void *state)", func));
+			funct_declarations.push_back("{");
+			funct_declarations.push_back(stringf("  %s_%s((struct %s_state_t *)state);", modname.c_str(), func, modname.c_str()));
+			funct_declarations.push_back("}");
+		}
+
+		funct_declarations.push_back("");
+		funct_declarations.push_back("bool yosys_simplec_get_bit(const void *state_p, int wire, int bit)");
+		funct_declarations.push_back("{");
+		funct_declarations.push_back(stringf("  const struct %s_state_t *state = (const struct %s_state_t *)state_p;", modname.c_str(), modname.c_str()));
+		funct_declarations.push_back("  switch (wire) {");
+		for (auto &line : get_lines)
+			funct_declarations.push_back(line);
+		funct_declarations.push_back("  }");
+		funct_declarations.push_back("  return false;");
+		funct_declarations.push_back("}");
+
+		funct_declarations.push_back("");
+		funct_declarations.push_back("void yosys_simplec_set_bit(void *state_p, int wire, int bit, bool value)");
+		funct_declarations.push_back("{");
+		funct_declarations.push_back(stringf("  struct %s_state_t *state = (struct %s_state_t *)state_p;", modname.c_str(), modname.c_str()));
+		funct_declarations.push_back("  switch (wire) {");
+		for (auto &line : set_lines)
+			funct_declarations.push_back(line);
+		funct_declarations.push_back("  }");
+		funct_declarations.push_back("}");
 	}
 
 	void run(Module *mod)
@@ -721,12 +838,17 @@ struct SimplecWorker
 		make_init_func(&work);
 		make_eval_func(&work);
 		make_tick_func(&work);
+
+		if (api)
+			make_api_funcs(mod);
 	}
 
 	void write(std::ostream &f)
 	{
 		f << "#include <stdint.h>" << std::endl;
 		f << "#include <stdbool.h>" << std::endl;
+		if (api)
+			f << "#include <stddef.h>" << std::endl;
 
 		for (auto &line : signal_declarations)
 			f << line << std::endl;
@@ -760,6 +882,20 @@ struct SimplecBackend : public Backend {
 		log("    -i8, -i16, -i32, -i64\n");
 		log("        set the maximum integer bit width to use in the generated code.\n");
 		log("\n");
+		log("    -api\n");
+		log("        also generate the extern functions yosys_simplec_state_size(),\n");
+		log("        yosys_simplec_init(), yosys_simplec_eval(), yosys_simplec_tick(),\n");
+		log("        yosys_simplec_get_bit() and yosys_simplec_set_bit() for the top module.\n");
+		log("        the last two access a bit of a top-level wire by wire index (in the\n");
+		log("        order of the wires in the module) and bit index. this is used by\n");
+		log("        \"sim -compiled\".\n");
+		log("\n");
+		log("For the top module the functions <top>_init(), <top>_eval() and <top>_tick()\n");
+		log("are generated. _init() must be called once after the inputs have been set and\n");
+		log("_eval() after every change of the inputs. _tick() updates all $_DFF_P_ and\n");
+		log("$_DFF_N_ flip-flops at once and propagates the new values, i.e. it simulates\n");
+		log("one active edge of a single clock.\n");
+		log("\n");
 		log("THIS COMMAND IS UNDER CONSTRUCTION\n");
 		log("\n");
 	}
@@ -779,6 +915,10 @@ struct SimplecBackend : public Backend {
 				worker.verbose = true;
 				continue;
 			}
+			if (args[argidx] == "-api") {
+				worker.api = true;
+				continue;
+			}
 			if (args[argidx] == "-i8") {
 				worker.max_uintsize = 8;
 				continue;
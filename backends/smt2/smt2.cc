@@ -22,20 +22,36 @@
 #include "kernel/sigtools.h"
 #include "kernel/celltypes.h"
 #include "kernel/log.h"
+#include "kernel/threadpool.h"
+#include "backends/ilang/ilang_backend.h"
 #include <string>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
+// SMT2 text of modules from earlier write_smt2 -incremental calls, by module name
+struct Smt2CachedModule
+{
+	uint64_t hash;
+	std::string text, id;
+	int statebv_width;
+	dict<IdString, pair<bool, bool>> clk_ports;
+};
+
+dict<IdString, Smt2CachedModule> smt2_module_cache;
+
 struct Smt2Worker
 {
 	CellTypes ct;
 	SigMap sigmap;
 	RTLIL::Module *module;
 	bool bvmode, memmode, wiresmode, verbose, statebv, statedt, forallmode;
-	dict<IdString, int> &mod_stbv_width;
+	const dict<IdString, int> &mod_stbv_width;
 	int idcounter = 0, statebv_width = 0;
 
+	// clock polarities of the input ports, merged into mod_clk_cache by the caller
+	dict<IdString, pair<bool, bool>> clk_ports;
+
 	std::vector<std::string> decls, trans, hier, dtmembers;
 	std::map<RTLIL::SigBit, RTLIL::Cell*> bit_driver;
 	std::set<RTLIL::Cell*> exported_cells, hiercells, hiercells_queue;
@@ -108,7 +124,7 @@ struct Smt2Worker
 	}
 
 	Smt2Worker(RTLIL::Module *module, bool bvmode, bool memmode, bool wiresmode, bool verbose, bool statebv, bool statedt, bool forallmode,
-			dict<IdString, int> &mod_stbv_width, dict<IdString, dict<IdString, pair<bool, bool>>> &mod_clk_cache) :
+			const dict<IdString, int> &mod_stbv_width, const dict<IdString, dict<IdString, pair<bool, bool>>> &mod_clk_cache) :
 			ct(module->design), sigmap(module), module(module), bvmode(bvmode), memmode(memmode), wiresmode(wiresmode),
 			verbose(verbose), statebv(statebv), statedt(statedt), forallmode(forallmode), mod_stbv_width(mod_stbv_width)
 	{
@@ -191,9 +207,9 @@ struct Smt2Worker
 				continue;
 			SigBit bit = sigmap(wire);
 			if (clock_posedge.count(bit))
-				mod_clk_cache[module->name][wire->name].first = true;
+				clk_ports[wire->name].first = true;
 			if (clock_negedge.count(bit))
-				mod_clk_cache[module->name][wire->name].second = true;
+				clk_ports[wire->name].second = true;
 		}
 	}
 
@@ -849,14 +865,14 @@ struct Smt2Worker
 			if (wire->attributes.count("\\init")) {
 				RTLIL::SigSpec sig = sigmap(wire);
 				Const val = wire->attributes.at("\\init");
-				val.bits.resize(GetSize(sig), State::Sx);
+				val.bits().resize(GetSize(sig), State::Sx);
 				if (bvmode && GetSize(sig) > 1) {
 					Const mask(State::S1, GetSize(sig));
 					bool use_mask = false;
 					for (int i = 0; i < GetSize(sig); i++)
 						if (val[i] != State::S0 && val[i] != State::S1) {
-							val[i] = State::S0;
-							mask[i] = State::S0;
+							val.bits()[i] = State::S0;
+							mask.bits()[i] = State::S0;
 							use_mask = true;
 						}
 					if (use_mask)
@@ -1111,10 +1127,10 @@ struct Smt2Worker
 						for (int k = 0; k < GetSize(initword); k++) {
 							if (initword[k] == State::S0 || initword[k] == State::S1) {
 								gen_init_constr = true;
-								initmask[k] = State::S1;
+								initmask.bits()[k] = State::S1;
 							} else {
-								initmask[k] = State::S0;
-								initword[k] = State::S0;
+								initmask.bits()[k] = State::S0;
+								initword.bits()[k] = State::S0;
 							}
 						}
 
@@ -1220,7 +1236,6 @@ struct Smt2Worker
 
 		if (statebv) {
 			f << stringf("(define-sort |%s_s| () (_ BitVec %d))\n", get_id(module), statebv_width);
-			mod_stbv_width[module->name] = statebv_width;
 		} else
 		if (statedt) {
 			f << stringf("(declare-datatype |%s_s| ((|%s_mk|\n", get_id(module), get_id(module));
@@ -1260,6 +1275,37 @@ struct Smt2Worker
 	}
 };
 
+// Hash of everything the SMT2 text of a module depends on: the module itself,
+// the options and what was exported for the modules it instantiates.
+uint64_t smt2_module_hash(RTLIL::Module *module, const std::string &options, const dict<IdString, int> &mod_stbv_width,
+		const dict<IdString, dict<IdString, pair<bool, bool>>> &mod_clk_cache)
+{
+	std::ostringstream buf;
+	buf << options << "\n";
+	ILANG_BACKEND::dump_module(buf, "", module, module->design, false);
+
+	std::set<IdString> submodules;
+	for (auto cell : module->cells())
+		if (module->design->module(cell->type) != nullptr)
+			submodules.insert(cell->type);
+	for (auto type : submodules) {
+		buf << type.str() << " " << (mod_stbv_width.count(type) ? mod_stbv_width.at(type) : -1);
+		if (mod_clk_cache.count(type))
+			for (auto &it : mod_clk_cache.at(type))
+				buf << " " << it.first.str() << " " << it.second.first << it.second.second;
+		buf << "\n";
+	}
+
+	// FNV-1a
+	std::string str = buf.str();
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (char c : str) {
+		hash ^= (unsigned char)c;
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
 struct Smt2Backend : public Backend {
 	Smt2Backend() : Backend("smt2", "write design to SMT-LIBv2 file") { }
 	void help() YS_OVERRIDE
@@ -1369,6 +1415,16 @@ struct Smt2Backend : public Backend {
 		log("        use the given template file. the line containing only the token '%%%%'\n");
 		log("        is replaced with the regular output of this command.\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        export up to N modules concurrently. modules are exported after the\n");
+		log("        modules they instantiate. the output is the same as with -j 1. the\n");
+		log("        default is the number of threads set with 'yosys -j'.\n");
+		log("\n");
+		log("    -incremental\n");
+		log("        keep the exported modules in memory and reuse them in later calls\n");
+		log("        with -incremental when the module, the options and the exported\n");
+		log("        submodules are unchanged. only the changed modules are exported again.\n");
+		log("\n");
 		log("[1] For more information on SMT-LIBv2 visit http://smt-lib.org/ or read David\n");
 		log("R. Cok's tutorial: http://www.grammatech.com/resources/smt/SMTLIBTutorial.pdf\n");
 		log("\n");
@@ -1422,7 +1478,8 @@ struct Smt2Backend : public Backend {
 	{
 		std::ifstream template_f;
 		bool bvmode = true, memmode = true, wiresmode = false, verbose = false, statebv = false, statedt = false;
-		bool forallmode = false;
+		bool forallmode = false, incremental = false;
+		int num_threads = yosys_threads;
 
 		log_header(design, "Executing SMT2 backend.\n");
 
@@ -1466,6 +1523,14 @@ struct Smt2Backend : public Backend {
 				verbose = true;
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
+			if (args[argidx] == "-incremental") {
+				incremental = true;
+				continue;
+			}
 			break;
 		}
 		extra_args(f, filename, args, argidx);
@@ -1497,6 +1562,7 @@ struct Smt2Backend : public Backend {
 			*f << stringf("; yosys-smt2-stdt\n");
 
 		std::vector<RTLIL::Module*> sorted_modules;
+		std::vector<int> level_begin;
 
 		// extract module dependencies
 		std::map<RTLIL::Module*, std::set<RTLIL::Module*>> module_deps;
@@ -1511,6 +1577,7 @@ struct Smt2Backend : public Backend {
 		// (O(n*m) on n elements and depth m)
 		while (module_deps.size() > 0) {
 			size_t sorted_modules_idx = sorted_modules.size();
+			level_begin.push_back(sorted_modules_idx);
 			for (auto &it : module_deps) {
 				for (auto &dep : it.second)
 					if (module_deps.count(dep) > 0)
@@ -1542,19 +1609,71 @@ struct Smt2Backend : public Backend {
 				log_error("Forall-exists problems are only supported in -stbv or -stdt mode.\n");
 		}
 
-		for (auto module : sorted_modules)
+		if (!incremental)
+			smt2_module_cache.clear();
+
+		std::string options = stringf("%d %d %d %d %d %d %d", bvmode, memmode, wiresmode, verbose, statebv, statedt, forallmode);
+
+		// Modules of the same level of the topological sort only depend on
+		// modules of earlier levels, so each level is exported concurrently.
+		level_begin.push_back(GetSize(sorted_modules));
+		for (int level = 0; level+1 < GetSize(level_begin); level++)
 		{
-			if (module->get_blackbox_attribute() || module->has_memories_warn() || module->has_processes_warn())
-				continue;
+			std::vector<RTLIL::Module*> modules;
+			for (int i = level_begin[level]; i < level_begin[level+1]; i++) {
+				RTLIL::Module *module = sorted_modules[i];
+				if (module->get_blackbox_attribute() || module->has_memories_warn() || module->has_processes_warn())
+					continue;
+				modules.push_back(module);
+			}
 
-			log("Creating SMT-LIBv2 representation of module %s.\n", log_id(module));
+			std::vector<Smt2CachedModule> results(GetSize(modules));
+			std::vector<bool> reused(GetSize(modules));
 
-			Smt2Worker worker(module, bvmode, memmode, wiresmode, verbose, statebv, statedt, forallmode, mod_stbv_width, mod_clk_cache);
-			worker.run();
-			worker.write(*f);
+			if (incremental) {
+				for (int i = 0; i < GetSize(modules); i++) {
+					results[i].hash = smt2_module_hash(modules[i], options, mod_stbv_width, mod_clk_cache);
+					auto it = smt2_module_cache.find(modules[i]->name);
+					if (it != smt2_module_cache.end() && it->second.hash == results[i].hash) {
+						results[i] = it->second;
+						reused[i] = true;
+					}
+				}
+			}
 
-			if (module == topmod)
-				topmod_id = worker.get_id(module);
+			auto export_module = [&](int i) {
+				if (reused[i]) {
+					log("Reusing SMT-LIBv2 representation of module %s.\n", log_id(modules[i]));
+					return;
+				}
+				log("Creating SMT-LIBv2 representation of module %s.\n", log_id(modules[i]));
+				Smt2Worker worker(modules[i], bvmode, memmode, wiresmode, verbose, statebv, statedt, forallmode, mod_stbv_width, mod_clk_cache);
+				worker.run();
+				std::ostringstream buf;
+				worker.write(buf);
+				results[i].text = buf.str();
+				results[i].id = worker.get_id(modules[i]);
+				results[i].statebv_width = worker.statebv_width;
+				results[i].clk_ports = worker.clk_ports;
+			};
+
+			parallel_for(GetSize(modules), export_module, num_threads);
+
+			for (int i = 0; i < GetSize(modules); i++)
+			{
+				RTLIL::Module *module = modules[i];
+				*f << results[i].text;
+
+				if (statebv)
+					mod_stbv_width[module->name] = results[i].statebv_width;
+				if (!results[i].clk_ports.empty())
+					mod_clk_cache[module->name] = results[i].clk_ports;
+				if (module == topmod)
+					topmod_id = results[i].id;
+
+				if (incremental)
+					smt2_module_cache[module->name] = std::move(results[i]);
+			}
 		}
 
 		if (topmod)
@@ -22,6 +22,7 @@
 #include "kernel/sigtools.h"
 #include "kernel/celltypes.h"
 #include "kernel/log.h"
+#include "kernel/emitter.h"
 #include <string>
 
 USING_YOSYS_NAMESPACE
@@ -32,7 +33,7 @@ struct SmvWorker
 	CellTypes ct;
 	SigMap sigmap;
 	RTLIL::Module *module;
-	std::ostream &f;
+	EmitBuffer &f;
 	bool verbose;
 
 	int idcounter;
@@ -87,7 +88,7 @@ struct SmvWorker
 		return idcache.at(id).c_str();
 	}
 
-	SmvWorker(RTLIL::Module *module, bool verbose, std::ostream &f) :
+	SmvWorker(RTLIL::Module *module, bool verbose, EmitBuffer &f) :
 			ct(module->design), sigmap(module), module(module), f(f), verbose(verbose), idcounter(0)
 	{
 		for (auto mod : module->design->modules())
@@ -716,6 +717,15 @@ struct SmvBackend : public Backend {
 		log("        use the given template file. the line containing only the token '%%%%'\n");
 		log("        is replaced with the regular output of this command.\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        write up to N modules concurrently. The output is the same as with\n");
+		log("        -j 1. The default is the number of threads set with 'yosys -j'.\n");
+		log("\n");
+		log("    -cache <dir>\n");
+		log("        keep the SMV text of every written module in the given directory and\n");
+		log("        reuse it in later calls, as long as the module, the names and ports\n");
+		log("        of all modules and the yosys version are unchanged.\n");
+		log("\n");
 		log("THIS COMMAND IS UNDER CONSTRUCTION\n");
 		log("\n");
 	}
@@ -723,6 +733,8 @@ struct SmvBackend : public Backend {
 	{
 		std::ifstream template_f;
 		bool verbose = false;
+		int num_threads = std::max(yosys_threads, 1);
+		std::string cache_dir;
 
 		log_header(design, "Executing SMV backend.\n");
 
@@ -739,6 +751,14 @@ struct SmvBackend : public Backend {
 				verbose = true;
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
+			if (args[argidx] == "-cache" && argidx+1 < args.size()) {
+				cache_dir = args[++argidx];
+				continue;
+			}
 			break;
 		}
 		extra_args(f, filename, args, argidx);
@@ -749,6 +769,43 @@ struct SmvBackend : public Backend {
 			if (!module->get_blackbox_attribute() && !module->has_memories_warn() && !module->has_processes_warn())
 				modules.insert(module);
 
+		EmitCache cache(cache_dir, ".smv");
+		std::string interface_key;
+
+		if (cache.enabled()) {
+			std::stringstream buf;
+			for (auto module : design->modules()) {
+				buf << module->name.str() << "\n";
+				for (auto port : module->ports) {
+					Wire *wire = module->wire(port);
+					buf << " " << port.str() << " " << wire->width << " " << wire->port_input << wire->port_output << "\n";
+				}
+			}
+			interface_key = EmitCache::key({buf.str()});
+		}
+
+		auto render = [&](EmitBuffer &buf, Module *module) {
+			std::string key;
+			if (cache.enabled()) {
+				key = EmitCache::key({module->name.str(), module->content_hash(), interface_key});
+				if (cache.load(key, buf)) {
+					log("Reusing SMV representation of module %s from the cache.\n", log_id(module));
+					return;
+				}
+			}
+			log("Creating SMV representation of module %s.\n", log_id(module));
+			if (!cache.enabled()) {
+				SmvWorker worker(module, verbose, buf);
+				worker.run();
+				return;
+			}
+			EmitBuffer module_buf;
+			SmvWorker worker(module, verbose, module_buf);
+			worker.run();
+			cache.store(key, module_buf.text);
+			buf << module_buf.text;
+		};
+
 		if (template_f.is_open())
 		{
 			std::string line;
@@ -775,9 +832,10 @@ struct SmvBackend : public Backend {
 
 						*f << stringf("-- SMV description generated by %s\n", yosys_version_str);
 
-						log("Creating SMV representation of module %s.\n", log_id(module));
-						SmvWorker worker(module, verbose, *f);
-						worker.run();
+						{
+							EmitBuffer buf(f);
+							render(buf, module);
+						}
 
 						*f << stringf("-- end of yosys output\n");
 						continue;
@@ -794,11 +852,7 @@ struct SmvBackend : public Backend {
 		{
 			*f << stringf("-- SMV description generated by %s\n", yosys_version_str);
 
-			for (auto module : modules) {
-				log("Creating SMV representation of module %s.\n", log_id(module));
-				SmvWorker worker(module, verbose, *f);
-				worker.run();
-			}
+			emit_modules(*f, std::vector<Module*>(modules.begin(), modules.end()), num_threads, render);
 
 			*f << stringf("-- end of yosys output\n");
 		}
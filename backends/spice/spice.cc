@@ -21,6 +21,7 @@
 #include "kernel/register.h"
 #include "kernel/sigtools.h"
 #include "kernel/celltypes.h"
+#include "kernel/emitter.h"
 #include "kernel/log.h"
 #include <string>
 
@@ -45,39 +46,59 @@ static string spice_id2str(IdString id, bool use_inames, idict<IdString, 1> &inu
 	return spice_id2str(id);
 }
 
-static void print_spice_net(std::ostream &f, RTLIL::SigBit s, std::string &neg, std::string &pos, std::string &ncpf, int &nc_counter, bool use_inames, idict<IdString, 1> &inums)
+static void print_spice_net(EmitBuffer &f, RTLIL::SigBit s, const std::string &neg, const std::string &pos, const std::string &ncpf, int &nc_counter, EmitNames<RTLIL::Wire*> &net_names)
 {
 	if (s.wire) {
-		if (s.wire->port_id)
-			use_inames = true;
+		f << ' ' << net_names(s.wire);
 		if (s.wire->width > 1)
-			f << stringf(" %s.%d", spice_id2str(s.wire->name, use_inames, inums).c_str(), s.offset);
-		else
-			f << stringf(" %s", spice_id2str(s.wire->name, use_inames, inums).c_str());
+			f << '.' << s.offset;
 	} else {
 		if (s == RTLIL::State::S0)
-			f << stringf(" %s", neg.c_str());
+			f << ' ' << neg;
 		else if (s == RTLIL::State::S1)
-			f << stringf(" %s", pos.c_str());
+			f << ' ' << pos;
 		else
-			f << stringf(" %s%d", ncpf.c_str(), nc_counter++);
+			f << ' ' << ncpf << nc_counter++;
 	}
 }
 
-static void print_spice_module(std::ostream &f, RTLIL::Module *module, RTLIL::Design *design, std::string &neg, std::string &pos, std::string &ncpf, bool big_endian, bool use_inames)
+static std::vector<RTLIL::Wire*> spice_ports(RTLIL::Module *module)
+{
+	std::vector<RTLIL::Wire*> ports;
+	for (auto wire_it : module->wires_) {
+		RTLIL::Wire *wire = wire_it.second;
+		if (wire->port_id == 0)
+			continue;
+		while (int(ports.size()) < wire->port_id)
+			ports.push_back(NULL);
+		ports.at(wire->port_id-1) = wire;
+	}
+	return ports;
+}
+
+static void print_spice_module(EmitBuffer &f, RTLIL::Module *module, const dict<RTLIL::IdString, std::vector<RTLIL::Wire*>> &module_ports,
+		const std::string &neg, const std::string &pos, const std::string &ncpf, bool big_endian, bool use_inames)
 {
 	SigMap sigmap(module);
 	idict<IdString, 1> inums;
 	int cell_counter = 0, conn_counter = 0, nc_counter = 0;
 
+	EmitNames<RTLIL::Wire*> net_names([&](RTLIL::Wire *const &wire) {
+		return spice_id2str(wire->name, use_inames || wire->port_id != 0, inums);
+	});
+	EmitNames<RTLIL::IdString> type_names([](const RTLIL::IdString &id) {
+		return spice_id2str(id);
+	});
+
 	for (auto &cell_it : module->cells_)
 	{
 		RTLIL::Cell *cell = cell_it.second;
-		f << stringf("X%d", cell_counter++);
+		f << 'X' << cell_counter++;
 
 		std::vector<RTLIL::SigSpec> port_sigs;
 
-		if (design->modules_.count(cell->type) == 0)
+		auto ports_it = module_ports.find(cell->type);
+		if (ports_it == module_ports.end())
 		{
 			log_warning("no (blackbox) module for cell type `%s' (%s.%s) found! Guessing order of ports.\n",
 					log_id(cell->type), log_id(module), log_id(cell));
@@ -88,19 +109,7 @@ static void print_spice_module(std::ostream &f, RTLIL::Module *module, RTLIL::De
 		}
 		else
 		{
-			RTLIL::Module *mod = design->modules_.at(cell->type);
-
-			std::vector<RTLIL::Wire*> ports;
-			for (auto wire_it : mod->wires_) {
-				RTLIL::Wire *wire = wire_it.second;
-				if (wire->port_id == 0)
-					continue;
-				while (int(ports.size()) < wire->port_id)
-					ports.push_back(NULL);
-				ports.at(wire->port_id-1) = wire;
-			}
-
-			for (RTLIL::Wire *wire : ports) {
+			for (RTLIL::Wire *wire : ports_it->second) {
 				log_assert(wire != NULL);
 				RTLIL::SigSpec sig(RTLIL::State::Sz, wire->width);
 				if (cell->hasPort(wire->name)) {
@@ -112,21 +121,19 @@ static void print_spice_module(std::ostream &f, RTLIL::Module *module, RTLIL::De
 		}
 
 		for (auto &sig : port_sigs) {
-			for (int i = 0; i < sig.size(); i++) {
-				RTLIL::SigSpec s = sig.extract(big_endian ? sig.size() - 1 - i : i, 1);
-				print_spice_net(f, s, neg, pos, ncpf, nc_counter, use_inames, inums);
-			}
+			for (int i = 0; i < sig.size(); i++)
+				print_spice_net(f, sig[big_endian ? sig.size() - 1 - i : i], neg, pos, ncpf, nc_counter, net_names);
 		}
 
-		f << stringf(" %s\n", spice_id2str(cell->type).c_str());
+		f << ' ' << type_names(cell->type) << '\n';
 	}
 
 	for (auto &conn : module->connections())
 	for (int i = 0; i < conn.first.size(); i++) {
-		f << stringf("V%d", conn_counter++);
-		print_spice_net(f, conn.first.extract(i, 1), neg, pos, ncpf, nc_counter, use_inames, inums);
-		print_spice_net(f, conn.second.extract(i, 1), neg, pos, ncpf, nc_counter, use_inames, inums);
-		f << stringf(" DC 0\n");
+		f << 'V' << conn_counter++;
+		print_spice_net(f, conn.first[i], neg, pos, ncpf, nc_counter, net_names);
+		print_spice_net(f, conn.second[i], neg, pos, ncpf, nc_counter, net_names);
+		f << " DC 0\n";
 	}
 }
 
@@ -160,6 +167,10 @@ struct SpiceBackend : public Backend {
 		log("    -top top_module\n");
 		log("        set the specified module as design top module\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        write up to N modules concurrently. The output is the same as with\n");
+		log("        -j 1. The default is the number of threads set with 'yosys -j'.\n");
+		log("\n");
 	}
 	void execute(std::ostream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
 	{
@@ -167,6 +178,7 @@ struct SpiceBackend : public Backend {
 		RTLIL::Module *top_module = NULL;
 		bool big_endian = false, use_inames = false;
 		std::string neg = "Vss", pos = "Vdd", ncpf = "_NC";
+		int num_threads = yosys_threads;
 
 		log_header(design, "Executing SPICE backend.\n");
 
@@ -197,6 +209,10 @@ struct SpiceBackend : public Backend {
 				top_module_name = args[++argidx];
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
 			break;
 		}
 		extra_args(f, filename, args, argidx);
@@ -209,6 +225,13 @@ struct SpiceBackend : public Backend {
 		*f << stringf("* SPICE netlist generated by %s\n", yosys_version_str);
 		*f << stringf("\n");
 
+		// the port order of every module, for the cells instantiating it
+		dict<RTLIL::IdString, std::vector<RTLIL::Wire*>> module_ports;
+		for (auto module_it : design->modules_)
+			module_ports[module_it.first] = spice_ports(module_it.second);
+
+		std::vector<RTLIL::Module*> mod_list;
+
 		for (auto module_it : design->modules_)
 		{
 			RTLIL::Module *module = module_it.second;
@@ -225,36 +248,37 @@ struct SpiceBackend : public Backend {
 				continue;
 			}
 
-			std::vector<RTLIL::Wire*> ports;
-			for (auto wire_it : module->wires_) {
-				RTLIL::Wire *wire = wire_it.second;
-				if (wire->port_id == 0)
-					continue;
-				while (int(ports.size()) < wire->port_id)
-					ports.push_back(NULL);
-				ports.at(wire->port_id-1) = wire;
+			mod_list.push_back(module);
+		}
+
+		if (!top_module_name.empty()) {
+			if (top_module == NULL)
+				log_error("Can't find top module `%s'!\n", top_module_name.c_str());
+			mod_list.push_back(top_module);
+		}
+
+		emit_modules(*f, mod_list, num_threads, [&](EmitBuffer &buffer, RTLIL::Module *module) {
+			if (module == top_module) {
+				print_spice_module(buffer, module, module_ports, neg, pos, ncpf, big_endian, use_inames);
+				buffer << '\n';
+				return;
 			}
 
-			*f << stringf(".SUBCKT %s", spice_id2str(module->name).c_str());
-			for (RTLIL::Wire *wire : ports) {
+			std::string module_name = spice_id2str(module->name);
+			buffer << ".SUBCKT " << module_name;
+			for (RTLIL::Wire *wire : module_ports.at(module->name)) {
 				log_assert(wire != NULL);
+				std::string wire_name = spice_id2str(wire->name);
 				if (wire->width > 1) {
 					for (int i = 0; i < wire->width; i++)
-						*f << stringf(" %s.%d", spice_id2str(wire->name).c_str(), big_endian ? wire->width - 1 - i : i);
+						buffer << ' ' << wire_name << '.' << (big_endian ? wire->width - 1 - i : i);
 				} else
-					*f << stringf(" %s", spice_id2str(wire->name).c_str());
+					buffer << ' ' << wire_name;
 			}
-			*f << stringf("\n");
-			print_spice_module(*f, module, design, neg, pos, ncpf, big_endian, use_inames);
-			*f << stringf(".ENDS %s\n\n", spice_id2str(module->name).c_str());
-		}
-
-		if (!top_module_name.empty()) {
-			if (top_module == NULL)
-				log_error("Can't find top module `%s'!\n", top_module_name.c_str());
-			print_spice_module(*f, top_module, design, neg, pos, ncpf, big_endian, use_inames);
-			*f << stringf("\n");
-		}
+			buffer << '\n';
+			print_spice_module(buffer, module, module_ports, neg, pos, ncpf, big_endian, use_inames);
+			buffer << ".ENDS " << module_name << "\n\n";
+		});
 
 		*f << stringf("************************\n");
 		*f << stringf("* end of SPICE netlist *\n");
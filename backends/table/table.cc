@@ -22,11 +22,133 @@
 #include "kernel/sigtools.h"
 #include "kernel/celltypes.h"
 #include "kernel/log.h"
+#include "kernel/emitter.h"
 #include <string>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
+static const char table_columnar_magic[8] = { 'Y', 'S', 'T', 'B', 'L', 0, 0, 1 };
+
+// Rows of one module for "write_table -columnar": every column holds indices
+// into the strings of the module, in the order of first occurrence.
+struct TableColumns
+{
+	dict<std::string, int> string_index;
+	std::vector<std::string> strings;
+	std::vector<uint32_t> columns[6];
+
+	void add(int column, const std::string &str)
+	{
+		auto it = string_index.find(str);
+		if (it == string_index.end()) {
+			it = string_index.insert(std::make_pair(str, GetSize(strings))).first;
+			strings.push_back(str);
+		}
+		columns[column].push_back(it->second);
+	}
+
+	static void write_u32(std::string &buf, uint32_t value)
+	{
+		for (int i = 0; i < 4; i++)
+			buf += char(value >> (8*i));
+	}
+
+	void write(EmitBuffer &f)
+	{
+		std::string buf;
+		uint32_t offset = 0;
+
+		write_u32(buf, GetSize(columns[0]));
+		write_u32(buf, GetSize(strings));
+		for (auto &str : strings) {
+			write_u32(buf, offset);
+			offset += str.size();
+		}
+		write_u32(buf, offset);
+		for (auto &str : strings)
+			buf += str;
+		while (buf.size() % 4 != 0)
+			buf += char(0);
+		for (auto &column : columns)
+			for (auto index : column)
+				write_u32(buf, index);
+
+		f << buf;
+	}
+};
+
+struct TableWorker
+{
+	RTLIL::Module *module;
+	SigMap sigmap;
+	EmitBuffer &f;
+	TableColumns *columnar;
+
+	TableWorker(RTLIL::Module *module, EmitBuffer &f, TableColumns *columnar) :
+			module(module), sigmap(module), f(f), columnar(columnar) { }
+
+	void row(const char *cell_name, const char *cell_type, const char *port, const char *direction, const char *signal)
+	{
+		if (columnar) {
+			columnar->add(0, log_id(module));
+			columnar->add(1, cell_name);
+			columnar->add(2, cell_type);
+			columnar->add(3, port);
+			columnar->add(4, direction);
+			columnar->add(5, signal);
+			return;
+		}
+
+		f << log_id(module) << "\t";
+		f << cell_name << "\t";
+		f << cell_type << "\t";
+		f << port << "\t";
+		f << direction << "\t";
+		f << signal << "\n";
+	}
+
+	void run()
+	{
+		for (auto wire : module->wires())
+		{
+			if (wire->port_id == 0)
+				continue;
+
+			const char *direction;
+			if (wire->port_input && wire->port_output)
+				direction = "pio";
+			else if (wire->port_input)
+				direction = "pi";
+			else if (wire->port_output)
+				direction = "po";
+			else
+				log_abort();
+
+			row(log_id(wire), "-", "-", direction, log_signal(sigmap(wire)));
+		}
+
+		for (auto cell : module->cells())
+		for (auto conn : cell->connections())
+		{
+			const char *direction;
+			if (cell->input(conn.first) && cell->output(conn.first))
+				direction = "inout";
+			else if (cell->input(conn.first))
+				direction = "in";
+			else if (cell->output(conn.first))
+				direction = "out";
+			else
+				direction = "unknown";
+
+			row(log_id(cell), log_id(cell->type), log_id(conn.first), direction, log_signal(sigmap(conn.second)));
+		}
+
+		if (columnar)
+			columnar->write(f);
+	}
+};
+
 struct TableBackend : public Backend {
 	TableBackend() : Backend("table", "write design as connectivity table") { }
 	void help() YS_OVERRIDE
@@ -47,73 +169,61 @@ struct TableBackend : public Backend {
 		log("\n");
 		log("module inputs and outputs are output using cell type and port '-' and with\n");
 		log("'pi' (primary input) or 'po' (primary output) or 'pio' as direction.\n");
+		log("\n");
+		log("    -columnar\n");
+		log("        write the same table in a binary columnar format, that can be loaded\n");
+		log("        e.g. with numpy without parsing text. The file starts with the 8 bytes\n");
+		log("        \"YSTBL\\0\\0\\1\", followed by one block per module. All integers are\n");
+		log("        32 bit little endian. A block consists of:\n");
+		log("          - the number of rows R and the number of strings S\n");
+		log("          - S+1 offsets of the strings into the string data\n");
+		log("          - the string data, padded with zeros to a multiple of 4 bytes\n");
+		log("          - the 6 columns in the order above, R string indices each\n");
+		log("        The strings of a block are unique, so they can be used directly as\n");
+		log("        the categories of a dictionary encoded column.\n");
+		log("\n");
+		log("    -j <N>\n");
+		log("        write up to N modules concurrently. The output is the same as with\n");
+		log("        -j 1. The default is the number of threads set with 'yosys -j'.\n");
+		log("\n");
 	}
 	void execute(std::ostream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
 	{
+		bool columnar = false;
+		int num_threads = std::max(yosys_threads, 1);
+
 		log_header(design, "Executing TABLE backend.\n");
 
 		size_t argidx;
 		for (argidx = 1; argidx < args.size(); argidx++)
 		{
-			// if (args[argidx] == "-top" && argidx+1 < args.size()) {
-			// 	top_module_name = args[++argidx];
-			// 	continue;
-			// }
+			if (args[argidx] == "-columnar") {
+				columnar = true;
+				continue;
+			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
 			break;
 		}
-		extra_args(f, filename, args, argidx);
+		extra_args(f, filename, args, argidx, columnar);
 
 		design->sort();
 
+		std::vector<RTLIL::Module*> modules;
 		for (auto module : design->modules())
-		{
-			if (module->get_blackbox_attribute())
-				continue;
-
-			SigMap sigmap(module);
+			if (!module->get_blackbox_attribute())
+				modules.push_back(module);
 
-			for (auto wire : module->wires())
-			{
-				if (wire->port_id == 0)
-					continue;
+		if (columnar)
+			f->write(table_columnar_magic, sizeof(table_columnar_magic));
 
-				*f << log_id(module) << "\t";
-				*f << log_id(wire) << "\t";
-				*f << "-" << "\t";
-				*f << "-" << "\t";
-
-				if (wire->port_input && wire->port_output)
-					*f << "pio" << "\t";
-				else if (wire->port_input)
-					*f << "pi" << "\t";
-				else if (wire->port_output)
-					*f << "po" << "\t";
-				else
-					log_abort();
-
-				*f << log_signal(sigmap(wire)) << "\n";
-			}
-
-			for (auto cell : module->cells())
-			for (auto conn : cell->connections())
-			{
-				*f << log_id(module) << "\t";
-				*f << log_id(cell) << "\t";
-				*f << log_id(cell->type) << "\t";
-				*f << log_id(conn.first) << "\t";
-
-				if (cell->input(conn.first) && cell->output(conn.first))
-					*f << "inout" << "\t";
-				else if (cell->input(conn.first))
-					*f << "in" << "\t";
-				else if (cell->output(conn.first))
-					*f << "out" << "\t";
-				else
-					*f << "unknown" << "\t";
-
-				*f << log_signal(sigmap(conn.second)) << "\n";
-			}
-		}
+		emit_modules(*f, modules, num_threads, [&](EmitBuffer &buf, RTLIL::Module *module) {
+			TableColumns columns;
+			TableWorker worker(module, buf, columnar ? &columns : nullptr);
+			worker.run();
+		});
 	}
 } TableBackend;
 
@@ -0,0 +1,29 @@
+#!/usr/bin/python3
+
+from pyosys import libyosys as ys
+
+import numpy as np
+
+design = ys.Design()
+ys.run_pass("read_verilog ../../tests/simple/fiedler-cooley.v", design);
+ys.run_pass("synth -run coarse; techmap; opt", design)
+
+for module in design.selected_whole_modules_warn():
+  print(ys.module_cell_type_counts(module))
+
+  # fanout of each net driven by the Y output of a gate
+  names, offsets, nets = ys.module_wire_nets(module)
+  num_nets = np.frombuffer(nets, dtype=np.int32).max() + 1
+  fanout = np.zeros(num_nets, dtype=np.int64)
+  drivers = []
+  for gate in ["$_AND_", "$_OR_", "$_XOR_"]:
+    _, width, a = ys.module_cell_nets(module, gate, "A")
+    _, width, b = ys.module_cell_nets(module, gate, "B")
+    _, width, y = ys.module_cell_nets(module, gate, "Y")
+    for inputs in (a, b):
+      inputs = np.frombuffer(inputs, dtype=np.int32)
+      np.add.at(fanout, inputs[inputs >= 0], 1)
+    drivers.append(np.frombuffer(y, dtype=np.int32))
+  y = np.concatenate(drivers)
+  y = y[y >= 0]
+  print("max. gate fanout:", fanout[y].max() if len(y) else 0)
@@ -208,6 +208,7 @@ eval_end:
 AigerReader::AigerReader(RTLIL::Design *design, std::istream &f, RTLIL::IdString module_name, RTLIL::IdString clk_name, std::string map_filename, bool wideports)
 	: design(design), f(f), clk_name(clk_name), map_filename(map_filename), wideports(wideports), aiger_autoidx(autoidx++)
 {
+	wire_prefix = stringf("$aiger%d$", aiger_autoidx);
 	module = new RTLIL::Module;
 	module->name = module_name;
 	if (design->module(module->name))
@@ -325,17 +326,28 @@ static uint32_t parse_xaiger_literal(std::istream &f)
 
 RTLIL::Wire* AigerReader::createWireIfNotExists(RTLIL::Module *module, unsigned literal)
 {
+	// Only this function creates wires with these names, and no wire is renamed
+	// before the symbol table is read, so a wire in literal_wires is the same
+	// wire that a lookup by name would return.
+	if (literal >= literal_wires.size())
+		literal_wires.resize(std::max<size_t>(literal+1, 2*(size_t(M)+1)));
+	if (literal_wires[literal])
+		return literal_wires[literal];
+
 	const unsigned variable = literal >> 1;
 	const bool invert = literal & 1;
-	RTLIL::IdString wire_name(stringf("$aiger%d$%d%s", aiger_autoidx, variable, invert ? "b" : ""));
+	RTLIL::IdString wire_name(wire_prefix + std::to_string(variable) + (invert ? "b" : ""));
 	RTLIL::Wire *wire = module->wire(wire_name);
-	if (wire) return wire;
+	if (wire) return literal_wires[literal] = wire;
 	log_debug2("Creating %s\n", wire_name.c_str());
 	wire = module->addWire(wire_name);
 	wire->port_input = wire->port_output = false;
+	literal_wires[literal] = wire;
 	if (!invert) return wire;
-	RTLIL::IdString wire_inv_name(stringf("$aiger%d$%d", aiger_autoidx, variable));
-	RTLIL::Wire *wire_inv = module->wire(wire_inv_name);
+	RTLIL::Wire *wire_inv = literal_wires[literal ^ 1];
+	RTLIL::IdString wire_inv_name = wire_inv ? wire_inv->name : RTLIL::IdString(wire_prefix + std::to_string(variable));
+	if (!wire_inv)
+		wire_inv = module->wire(wire_inv_name);
 	if (wire_inv) {
 		if (module->cell(wire_inv_name)) return wire;
 	}
@@ -343,10 +355,11 @@ RTLIL::Wire* AigerReader::createWireIfNotExists(RTLIL::Module *module, unsigned
 		log_debug2("Creating %s\n", wire_inv_name.c_str());
 		wire_inv = module->addWire(wire_inv_name);
 		wire_inv->port_input = wire_inv->port_output = false;
+		literal_wires[literal ^ 1] = wire_inv;
 	}
 
 	log_debug2("Creating %s = ~%s\n", wire_name.c_str(), wire_inv_name.c_str());
-	module->addNotGate(stringf("$not$aiger%d$%d", aiger_autoidx, variable), wire_inv, wire);
+	module->addNotGate("$not" + wire_inv_name.str(), wire_inv, wire);
 
 	return wire;
 }
@@ -435,7 +448,7 @@ void AigerReader::parse_xaiger()
 					bool success YS_ATTRIBUTE(unused) = ce.eval(o);
 					log_assert(success);
 					log_assert(o.wire == nullptr);
-					lut_mask[gray] = o.data;
+					lut_mask.bits()[gray] = o.data;
 				}
 				RTLIL::Cell *output_cell = module->cell(stringf("$and$aiger%d$%d", aiger_autoidx, rootNodeID));
 				log_assert(output_cell);
@@ -618,12 +631,20 @@ void AigerReader::parse_aiger_ascii()
 	std::getline(f, line); // Ignore up to start of next line
 }
 
-static unsigned parse_next_delta_literal(std::istream &f, unsigned ref)
+// reads from the stream buffer directly, std::istream::get() is comparatively
+// expensive for the two to ten bytes of each AND
+static unsigned parse_next_delta_literal(std::streambuf *sb, unsigned ref)
 {
 	unsigned x = 0, i = 0;
-	unsigned char ch;
-	while ((ch = f.get()) & 0x80)
+	int ch;
+	while (1) {
+		ch = sb->sbumpc();
+		if (ch == std::char_traits<char>::eof())
+			log_error("Unexpected EOF in AIGER AND section!\n");
+		if ((ch & 0x80) == 0)
+			break;
 		x |= (ch & 0x7f) << (7 * i++);
+	}
 	return ref - (x | (ch << (7 * i)));
 }
 
@@ -729,10 +750,13 @@ void AigerReader::parse_aiger_binary()
 		std::getline(f, line); // Ignore up to start of next line
 
 	// Parse AND
+	module->wires_.reserve(module->wires_.size() + A);
+	module->cells_.reserve(module->cells_.size() + A);
+	std::streambuf *sb = f.rdbuf();
 	l1 = (I+L+1) << 1;
 	for (unsigned i = 0; i < A; ++i, ++line_count, l1 += 2) {
-		l2 = parse_next_delta_literal(f, l1);
-		l3 = parse_next_delta_literal(f, l2);
+		l2 = parse_next_delta_literal(sb, l1);
+		l3 = parse_next_delta_literal(sb, l2);
 
 		log_debug2("%d %d %d is an AND\n", l1, l2, l3);
 		log_assert(!(l1 & 1));
@@ -938,6 +962,30 @@ void AigerReader::post_process()
 	}
 }
 
+// std::istream over a memory mapped file
+struct MemoryStreamBuf : std::streambuf
+{
+	MemoryStreamBuf(const char *data, size_t size)
+	{
+		char *p = const_cast<char*>(data);
+		setg(p, p, p + size);
+	}
+
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode) YS_OVERRIDE
+	{
+		char *p = dir == std::ios_base::beg ? eback() : dir == std::ios_base::end ? egptr() : gptr();
+		if (off < eback() - p || off > egptr() - p)
+			return pos_type(off_type(-1));
+		setg(eback(), p + off, egptr());
+		return pos_type(gptr() - eback());
+	}
+
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which) YS_OVERRIDE
+	{
+		return seekoff(off_type(pos), std::ios_base::beg, which);
+	}
+};
+
 struct AigerFrontend : public Frontend {
 	AigerFrontend() : Frontend("aiger", "read AIGER file") { }
 	void help() YS_OVERRIDE
@@ -1016,7 +1064,16 @@ struct AigerFrontend : public Frontend {
 #endif
 		}
 
-		AigerReader reader(design, *f, module_name, clk_name, map_filename, wideports);
+		// regular files are mapped into memory and read in place
+		MappedFile file;
+		std::unique_ptr<MemoryStreamBuf> file_buf;
+		std::unique_ptr<std::istream> file_stream;
+		if (filename != "<stdin>" && file.open(filename) && !file.is_compressed()) {
+			file_buf.reset(new MemoryStreamBuf(file.data, file.size));
+			file_stream.reset(new std::istream(file_buf.get()));
+		}
+
+		AigerReader reader(design, file_stream ? *file_stream : *f, module_name, clk_name, map_filename, wideports);
 		if (xaiger)
 			reader.parse_xaiger();
 		else
@@ -29,6 +29,7 @@
 
 #include "kernel/yosys.h"
 #include "libs/sha1/sha1.h"
+#include "backends/ilang/ilang_backend.h"
 #include "ast.h"
 
 YOSYS_NAMESPACE_BEGIN
@@ -47,6 +48,7 @@ namespace AST {
 namespace AST_INTERNAL {
 	bool flag_dump_ast1, flag_dump_ast2, flag_no_dump_ptr, flag_dump_vlog1, flag_dump_vlog2, flag_dump_rtlil, flag_nolatches, flag_nomeminit;
 	bool flag_nomem2reg, flag_mem2reg, flag_noblackbox, flag_lib, flag_nowb, flag_noopt, flag_icells, flag_pwires, flag_autowire;
+	std::string flag_derive_cache;
 	AstNode *current_ast, *current_ast_mod;
 	std::map<std::string, AstNode*> current_scope;
 	const dict<RTLIL::SigBit, RTLIL::SigBit> *genRTLIL_subst_ptr = NULL;
@@ -225,11 +227,88 @@ AstNode::AstNode(AstNodeType type, AstNode *child1, AstNode *child2, AstNode *ch
 		children.push_back(child3);
 }
 
+// AST nodes are created and deleted in large numbers by the parser and by
+// simplify(), so they are carved from chunks of fixed size slots instead of
+// being allocated one by one. Freed slots go to a free list and are reused.
+// When the last node is deleted all chunks but the first are released.
+namespace {
+struct AstNodePool
+{
+	static const int slots_per_chunk = 1024;
+
+	union Slot {
+		Slot *next;
+		alignas(AstNode) char data[sizeof(AstNode)];
+	};
+
+	std::vector<Slot*> chunks;
+	Slot *free_list = nullptr;
+	size_t live_nodes = 0;
+
+	void add_chunk(Slot *chunk)
+	{
+		for (int i = slots_per_chunk-1; i >= 0; i--) {
+			chunk[i].next = free_list;
+			free_list = &chunk[i];
+		}
+	}
+
+	void *alloc()
+	{
+		if (free_list == nullptr) {
+			chunks.push_back(static_cast<Slot*>(::operator new(sizeof(Slot) * slots_per_chunk)));
+			add_chunk(chunks.back());
+		}
+		Slot *slot = free_list;
+		free_list = slot->next;
+		live_nodes++;
+		return slot;
+	}
+
+	void free(void *ptr)
+	{
+		Slot *slot = static_cast<Slot*>(ptr);
+		slot->next = free_list;
+		free_list = slot;
+		if (--live_nodes == 0 && GetSize(chunks) > 1) {
+			for (int i = 1; i < GetSize(chunks); i++)
+				::operator delete(chunks[i]);
+			chunks.resize(1);
+			free_list = nullptr;
+			add_chunk(chunks.front());
+		}
+	}
+
+	static AstNodePool &get()
+	{
+		// never destroyed, nodes may still be deleted during static destruction
+		static AstNodePool *pool = new AstNodePool;
+		return *pool;
+	}
+};
+}
+
+void *AstNode::operator new(size_t size)
+{
+	if (size != sizeof(AstNode))
+		return ::operator new(size);
+	return AstNodePool::get().alloc();
+}
+
+void AstNode::operator delete(void *ptr, size_t size)
+{
+	if (ptr == nullptr)
+		return;
+	if (size != sizeof(AstNode))
+		::operator delete(ptr);
+	else
+		AstNodePool::get().free(ptr);
+}
+
 // create a (deep recursive) copy of a node
 AstNode *AstNode::clone() const
 {
-	AstNode *that = new AstNode;
-	*that = *this;
+	AstNode *that = new AstNode(*this);
 	for (auto &it : that->children)
 		it = it->clone();
 	for (auto &it : that->attributes)
@@ -248,6 +327,233 @@ void AstNode::cloneInto(AstNode *other) const
 	delete tmp;
 }
 
+// Packed ASTs start with a table of all strings (node strings, file names and
+// attribute names), followed by the nodes in pre-order. Numbers are stored as
+// LEB128 varints (zigzag encoded where they can be negative), strings as
+// indices into the table, and the node flags as one bit mask.
+namespace {
+enum : uint32_t {
+	PACK_FL_INPUT = 1 << 0, PACK_FL_OUTPUT = 1 << 1, PACK_FL_REG = 1 << 2, PACK_FL_LOGIC = 1 << 3,
+	PACK_FL_SIGNED = 1 << 4, PACK_FL_STRING = 1 << 5, PACK_FL_WAND = 1 << 6, PACK_FL_WOR = 1 << 7,
+	PACK_FL_RANGE_VALID = 1 << 8, PACK_FL_RANGE_SWAPPED = 1 << 9, PACK_FL_WAS_CHECKED = 1 << 10,
+	PACK_FL_UNSIZED = 1 << 11, PACK_FL_CUSTOM_TYPE = 1 << 12, PACK_FL_BASIC_PREP = 1 << 13,
+	// port_id, range_left, range_right and integer differ from their defaults
+	PACK_FL_NUMBERS = 1 << 14, PACK_FL_REAL = 1 << 15
+};
+
+struct AstPacker
+{
+	dict<std::string, int> string_index;
+	std::string strings, nodes;
+
+	static void put_uint(std::string &buf, uint64_t v) {
+		while (v >= 0x80) {
+			buf += char((v & 0x7f) | 0x80);
+			v >>= 7;
+		}
+		buf += char(v);
+	}
+
+	static void put_int(std::string &buf, int64_t v) {
+		put_uint(buf, (uint64_t(v) << 1) ^ uint64_t(v >> 63));
+	}
+
+	void put_string(const std::string &str) {
+		auto it = string_index.find(str);
+		if (it == string_index.end()) {
+			it = string_index.insert(std::make_pair(str, GetSize(string_index))).first;
+			put_uint(strings, str.size());
+			strings += str;
+		}
+		put_uint(nodes, it->second);
+	}
+
+	void put_node(const AstNode *node)
+	{
+		uint32_t flags = 0;
+		if (node->is_input) flags |= PACK_FL_INPUT;
+		if (node->is_output) flags |= PACK_FL_OUTPUT;
+		if (node->is_reg) flags |= PACK_FL_REG;
+		if (node->is_logic) flags |= PACK_FL_LOGIC;
+		if (node->is_signed) flags |= PACK_FL_SIGNED;
+		if (node->is_string) flags |= PACK_FL_STRING;
+		if (node->is_wand) flags |= PACK_FL_WAND;
+		if (node->is_wor) flags |= PACK_FL_WOR;
+		if (node->range_valid) flags |= PACK_FL_RANGE_VALID;
+		if (node->range_swapped) flags |= PACK_FL_RANGE_SWAPPED;
+		if (node->was_checked) flags |= PACK_FL_WAS_CHECKED;
+		if (node->is_unsized) flags |= PACK_FL_UNSIZED;
+		if (node->is_custom_type) flags |= PACK_FL_CUSTOM_TYPE;
+		if (node->basic_prep) flags |= PACK_FL_BASIC_PREP;
+		if (node->port_id != 0 || node->range_left != -1 || node->range_right != 0 || node->integer != 0)
+			flags |= PACK_FL_NUMBERS;
+		if (node->realvalue != 0)
+			flags |= PACK_FL_REAL;
+
+		put_uint(nodes, node->type);
+		put_uint(nodes, node->hashidx_);
+		put_uint(nodes, flags);
+		put_string(node->str);
+		put_string(node->filename);
+		put_int(nodes, node->linenum);
+
+		if (flags & PACK_FL_NUMBERS) {
+			put_int(nodes, node->port_id);
+			put_int(nodes, node->range_left);
+			put_int(nodes, node->range_right);
+			put_uint(nodes, node->integer);
+		}
+		if (flags & PACK_FL_REAL) {
+			char raw[sizeof(double)];
+			memcpy(raw, &node->realvalue, sizeof(double));
+			nodes.append(raw, sizeof(double));
+		}
+
+		// two states per byte
+		put_uint(nodes, node->bits.size());
+		for (size_t i = 0; i < node->bits.size(); i += 2)
+			nodes += char(int(node->bits[i]) | (i+1 < node->bits.size() ? int(node->bits[i+1]) << 4 : 0));
+
+		put_uint(nodes, node->multirange_dimensions.size());
+		for (int dim : node->multirange_dimensions)
+			put_int(nodes, dim);
+
+		put_uint(nodes, node->attributes.size());
+		for (auto &it : node->attributes) {
+			put_string(it.first.str());
+			put_node(it.second);
+		}
+
+		put_uint(nodes, node->children.size());
+		for (auto child : node->children)
+			put_node(child);
+	}
+};
+
+struct AstUnpacker
+{
+	const std::string &buf;
+	size_t pos = 0;
+	std::vector<std::string> strings;
+
+	AstUnpacker(const std::string &buf) : buf(buf) { }
+
+	uint64_t get_uint() {
+		uint64_t v = 0;
+		for (int shift = 0;; shift += 7) {
+			log_assert(pos < buf.size());
+			unsigned char c = buf[pos++];
+			v |= uint64_t(c & 0x7f) << shift;
+			if (!(c & 0x80))
+				return v;
+		}
+	}
+
+	int64_t get_int() {
+		uint64_t v = get_uint();
+		return int64_t(v >> 1) ^ -int64_t(v & 1);
+	}
+
+	const std::string &get_string() {
+		return strings.at(get_uint());
+	}
+
+	AstNode *get_node()
+	{
+		// copying does not advance the hash index sequence of new nodes, the
+		// unpacked nodes get the hash indices of the packed ones like clone()
+		static const AstNode blank;
+		AstNode *node = new AstNode(blank);
+
+		node->type = AstNodeType(get_uint());
+		node->hashidx_ = get_uint();
+		uint32_t flags = get_uint();
+		node->str = get_string();
+		node->filename = get_string();
+		node->linenum = get_int();
+
+		node->is_input = (flags & PACK_FL_INPUT) != 0;
+		node->is_output = (flags & PACK_FL_OUTPUT) != 0;
+		node->is_reg = (flags & PACK_FL_REG) != 0;
+		node->is_logic = (flags & PACK_FL_LOGIC) != 0;
+		node->is_signed = (flags & PACK_FL_SIGNED) != 0;
+		node->is_string = (flags & PACK_FL_STRING) != 0;
+		node->is_wand = (flags & PACK_FL_WAND) != 0;
+		node->is_wor = (flags & PACK_FL_WOR) != 0;
+		node->range_valid = (flags & PACK_FL_RANGE_VALID) != 0;
+		node->range_swapped = (flags & PACK_FL_RANGE_SWAPPED) != 0;
+		node->was_checked = (flags & PACK_FL_WAS_CHECKED) != 0;
+		node->is_unsized = (flags & PACK_FL_UNSIZED) != 0;
+		node->is_custom_type = (flags & PACK_FL_CUSTOM_TYPE) != 0;
+		node->basic_prep = (flags & PACK_FL_BASIC_PREP) != 0;
+
+		if (flags & PACK_FL_NUMBERS) {
+			node->port_id = get_int();
+			node->range_left = get_int();
+			node->range_right = get_int();
+			node->integer = get_uint();
+		}
+		if (flags & PACK_FL_REAL) {
+			log_assert(pos + sizeof(double) <= buf.size());
+			memcpy(&node->realvalue, buf.data() + pos, sizeof(double));
+			pos += sizeof(double);
+		}
+
+		node->bits.resize(get_uint());
+		for (size_t i = 0; i < node->bits.size(); i += 2) {
+			log_assert(pos < buf.size());
+			unsigned char c = buf[pos++];
+			node->bits[i] = RTLIL::State(c & 15);
+			if (i+1 < node->bits.size())
+				node->bits[i+1] = RTLIL::State(c >> 4);
+		}
+
+		node->multirange_dimensions.resize(get_uint());
+		for (auto &dim : node->multirange_dimensions)
+			dim = get_int();
+
+		for (size_t n = get_uint(); n > 0; n--) {
+			RTLIL::IdString id = get_string();
+			node->attributes[id] = get_node();
+		}
+
+		node->children.resize(get_uint());
+		for (auto &child : node->children)
+			child = get_node();
+
+		return node;
+	}
+};
+}
+
+std::string AstNode::pack() const
+{
+	AstPacker packer;
+	packer.put_node(this);
+
+	std::string buf;
+	AstPacker::put_uint(buf, packer.string_index.size());
+	buf += packer.strings;
+	buf += packer.nodes;
+	return buf;
+}
+
+AstNode *AstNode::unpack(const std::string &buf)
+{
+	AstUnpacker unpacker(buf);
+	unpacker.strings.resize(unpacker.get_uint());
+	for (auto &str : unpacker.strings) {
+		size_t len = unpacker.get_uint();
+		log_assert(unpacker.pos + len <= buf.size());
+		str = buf.substr(unpacker.pos, len);
+		unpacker.pos += len;
+	}
+
+	AstNode *node = unpacker.get_node();
+	log_assert(unpacker.pos == buf.size());
+	return node;
+}
+
 // delete all children in this node
 void AstNode::delete_children()
 {
@@ -825,8 +1131,7 @@ RTLIL::Const AstNode::asAttrConst()
 {
 	log_assert(type == AST_CONSTANT);
 
-	RTLIL::Const val;
-	val.bits = bits;
+	RTLIL::Const val(bits);
 
 	if (is_string) {
 		val.flags |= RTLIL::CONST_FLAG_STRING;
@@ -870,7 +1175,7 @@ uint64_t AstNode::asInt(bool is_signed)
 		uint64_t ret = 0;
 
 		for (int i = 0; i < 64; i++)
-			if (v.bits.at(i) == RTLIL::State::S1)
+			if (v[i] == RTLIL::State::S1)
 				ret |= uint64_t(1) << i;
 
 		return ret;
@@ -888,15 +1193,15 @@ double AstNode::asReal(bool is_signed)
 	{
 		RTLIL::Const val(bits);
 
-		bool is_negative = is_signed && !val.bits.empty() && val.bits.back() == RTLIL::State::S1;
+		bool is_negative = is_signed && !val.empty() && val.back() == RTLIL::State::S1;
 		if (is_negative)
-			val = const_neg(val, val, false, false, val.bits.size());
+			val = const_neg(val, val, false, false, val.size());
 
 		double v = 0;
-		for (size_t i = 0; i < val.bits.size(); i++)
+		for (int i = 0; i < val.size(); i++)
 			// IEEE Std 1800-2012 Par 6.12.2: Individual bits that are x or z in
 			// the net or the variable shall be treated as zero upon conversion.
-			if (val.bits.at(i) == RTLIL::State::S1)
+			if (val[i] == RTLIL::State::S1)
 				v += exp2(i);
 		if (is_negative)
 			v *= -1;
@@ -919,21 +1224,21 @@ RTLIL::Const AstNode::realAsConst(int width)
 #else
 	if (!std::isfinite(v)) {
 #endif
-		result.bits = std::vector<RTLIL::State>(width, RTLIL::State::Sx);
+		result = RTLIL::Const(RTLIL::State::Sx, width);
 	} else {
 		bool is_negative = v < 0;
 		if (is_negative)
 			v *= -1;
 		for (int i = 0; i < width; i++, v /= 2)
-			result.bits.push_back((fmod(floor(v), 2) != 0) ? RTLIL::State::S1 : RTLIL::State::S0);
+			result.bits().push_back((fmod(floor(v), 2) != 0) ? RTLIL::State::S1 : RTLIL::State::S0);
 		if (is_negative)
-			result = const_neg(result, result, false, false, result.bits.size());
+			result = const_neg(result, result, false, false, result.size());
 	}
 	return result;
 }
 
 // create a new AstModule from an AST_MODULE AST node
-static AstModule* process_module(AstNode *ast, bool defer, AstNode *original_ast = NULL)
+static AstModule* process_module(AstNode *ast, bool defer, const AstNode *original_ast = NULL)
 {
 	log_assert(ast->type == AST_MODULE || ast->type == AST_INTERFACE);
 
@@ -943,17 +1248,18 @@ static AstModule* process_module(AstNode *ast, bool defer, AstNode *original_ast
 		log("Generating RTLIL representation for module `%s'.\n", ast->str.c_str());
 
 	current_module = new AstModule;
-	current_module->ast = NULL;
 	current_module->name = ast->str;
-	current_module->attributes["\\src"] = stringf("%s:%d", ast->filename.c_str(), ast->linenum);
+	current_module->set_src_attribute(stringf("%s:%d", ast->filename.c_str(), ast->linenum));
 	current_module->set_bool_attribute("\\cells_not_processed");
 
+	// packed before simplify() changes the AST, for later derive() calls
+	const AstNode *ast_before_simplify = original_ast != NULL ? original_ast : ast;
+	current_module->packed_ast = ast_before_simplify->pack();
+	for (auto child : ast_before_simplify->children)
+		if (child->type == AST_PARAMETER)
+			current_module->ast_parameters.push_back(child->str);
+
 	current_ast_mod = ast;
-	AstNode *ast_before_simplify;
-	if (original_ast != NULL)
-		ast_before_simplify = original_ast;
-	else
-		ast_before_simplify = ast->clone();
 
 	if (flag_dump_ast1) {
 		log("Dumping AST before simplification:\n");
@@ -1117,7 +1423,6 @@ static AstModule* process_module(AstNode *ast, bool defer, AstNode *original_ast
 
 	if (ast->type == AST_INTERFACE)
 		current_module->set_bool_attribute("\\is_interface");
-	current_module->ast = ast_before_simplify;
 	current_module->nolatches = flag_nolatches;
 	current_module->nomeminit = flag_nomeminit;
 	current_module->nomem2reg = flag_nomem2reg;
@@ -1129,6 +1434,7 @@ static AstModule* process_module(AstNode *ast, bool defer, AstNode *original_ast
 	current_module->icells = flag_icells;
 	current_module->pwires = flag_pwires;
 	current_module->autowire = flag_autowire;
+	current_module->derive_cache = flag_derive_cache;
 	current_module->fixup_ports();
 
 	if (flag_dump_rtlil) {
@@ -1142,7 +1448,8 @@ static AstModule* process_module(AstNode *ast, bool defer, AstNode *original_ast
 
 // create AstModule instances for all modules in the AST tree and add them to 'design'
 void AST::process(RTLIL::Design *design, AstNode *ast, bool dump_ast1, bool dump_ast2, bool no_dump_ptr, bool dump_vlog1, bool dump_vlog2, bool dump_rtlil,
-		bool nolatches, bool nomeminit, bool nomem2reg, bool mem2reg, bool noblackbox, bool lib, bool nowb, bool noopt, bool icells, bool pwires, bool nooverwrite, bool overwrite, bool defer, bool autowire)
+		bool nolatches, bool nomeminit, bool nomem2reg, bool mem2reg, bool noblackbox, bool lib, bool nowb, bool noopt, bool icells, bool pwires, bool nooverwrite, bool overwrite, bool defer, bool autowire,
+		std::string derive_cache)
 {
 	current_ast = ast;
 	flag_dump_ast1 = dump_ast1;
@@ -1162,6 +1469,7 @@ void AST::process(RTLIL::Design *design, AstNode *ast, bool dump_ast1, bool dump
 	flag_icells = icells;
 	flag_pwires = pwires;
 	flag_autowire = autowire;
+	flag_derive_cache = derive_cache;
 
 	log_assert(current_ast->type == AST_DESIGN);
 	for (auto it = current_ast->children.begin(); it != current_ast->children.end(); it++)
@@ -1210,13 +1518,6 @@ void AST::process(RTLIL::Design *design, AstNode *ast, bool dump_ast1, bool dump
 	}
 }
 
-// AstModule destructor
-AstModule::~AstModule()
-{
-	if (ast != NULL)
-		delete ast;
-}
-
 
 // An interface port with modport is specified like this:
 //    <interface_name>.<modport_name>
@@ -1302,7 +1603,7 @@ void AstModule::reprocess_module(RTLIL::Design *design, dict<RTLIL::IdString, RT
 	loadconfig();
 
 	bool is_top = false;
-	AstNode *new_ast = ast->clone();
+	AstNode *new_ast = unpack_ast();
 	for (auto &intf : local_interfaces) {
 		std::string intfname = intf.first.str();
 		RTLIL::Module *intfmodule = intf.second;
@@ -1346,10 +1647,12 @@ void AstModule::reprocess_module(RTLIL::Design *design, dict<RTLIL::IdString, RT
 							                                                              // reprocess_module is called from the hierarchy pass) be
 							                                                              // present in design->modules_
 							AstModule *ast_module_of_interface = (AstModule*)intfmodule;
+							AstNode *ast_of_interface = ast_module_of_interface->unpack_ast();
 							std::string interface_modport_compare_str = "\\" + interface_modport;
-							AstNode *modport = find_modport(ast_module_of_interface->ast, interface_modport_compare_str); // modport == NULL if no modport
+							AstNode *modport = find_modport(ast_of_interface, interface_modport_compare_str); // modport == NULL if no modport
 							// Iterate over all wires in the interface and add them to the module:
 							explode_interface_port(new_ast, intfmodule, name_port, modport);
+							delete ast_of_interface;
 						}
 						break;
 					}
@@ -1374,6 +1677,7 @@ void AstModule::reprocess_module(RTLIL::Design *design, dict<RTLIL::IdString, RT
 	// Generate RTLIL from AST for the new module and add to the design:
 	AstModule *newmod = process_module(new_ast, false, ast_before_replacing_interface_ports);
 	delete(new_ast);
+	delete(ast_before_replacing_interface_ports);
 	design->add(newmod);
 	RTLIL::Module* mod = design->module(original_name);
 	if (is_top)
@@ -1383,6 +1687,92 @@ void AstModule::reprocess_module(RTLIL::Design *design, dict<RTLIL::IdString, RT
 	mod->set_bool_attribute("\\interfaces_replaced_in_module");
 }
 
+// serialize everything that can influence the elaboration of an AST node
+static void serialize_ast(const AstNode *node, std::string &buf)
+{
+	buf += stringf("(%d %s %s:%d ", int(node->type), node->str.c_str(), node->filename.c_str(), node->linenum);
+	for (auto bit : node->bits)
+		buf += char('0' + int(bit));
+	buf += stringf(" %d%d%d%d%d%d%d%d%d%d%d%d%d %d %d %d %u %.17g", node->is_input, node->is_output, node->is_reg, node->is_logic,
+			node->is_signed, node->is_string, node->is_wand, node->is_wor, node->range_valid, node->range_swapped, node->was_checked,
+			node->is_unsized, node->is_custom_type, node->port_id, node->range_left, node->range_right, node->integer, node->realvalue);
+	for (auto dim : node->multirange_dimensions)
+		buf += stringf(" %d", dim);
+	for (auto &it : node->attributes) {
+		buf += " " + it.first.str() + "=";
+		serialize_ast(it.second, buf);
+	}
+	for (auto child : node->children)
+		serialize_ast(child, buf);
+	buf += ")";
+}
+
+// modules that read other files or call DPI functions during elaboration are never cached,
+// neither are modules with interface ports (they are re-derived by the hierarchy pass)
+static bool ast_uses_external_data(const AstNode *node)
+{
+	if (node->type == AST_DPI_FUNCTION || node->type == AST_INTERFACEPORT)
+		return true;
+	if ((node->type == AST_FCALL || node->type == AST_TCALL) && node->str.compare(0, 9, "\\$readmem") == 0)
+		return true;
+	for (auto &it : node->attributes)
+		if (ast_uses_external_data(it.second))
+			return true;
+	for (auto child : node->children)
+		if (ast_uses_external_data(child))
+			return true;
+	return false;
+}
+
+// name of the file in the derive cache directory for the given (parameter-rewritten) module AST,
+// or an empty string if the module must not be cached
+std::string AstModule::derive_cache_filename(RTLIL::Design *design, AstNode *new_ast) const
+{
+	if (derive_cache.empty() || ast_uses_external_data(new_ast))
+		return std::string();
+
+	// cells of interface types are only resolved after the module has been derived
+	for (auto mod : design->modules())
+		if (mod->get_bool_attribute("\\is_interface"))
+			return std::string();
+
+	std::string buf = stringf("%s\n%d%d%d%d%d%d%d%d%d%d%d\n", yosys_version_str, nolatches, nomeminit, nomem2reg, mem2reg,
+			noblackbox, lib, nowb, noopt, icells, pwires, autowire);
+	serialize_ast(new_ast, buf);
+	return derive_cache + "/" + sha1(buf) + ".il";
+}
+
+static bool load_derived_module(RTLIL::Design *design, RTLIL::IdString modname, const std::string &filename)
+{
+	std::ifstream f(filename.c_str());
+	if (f.fail())
+		return false;
+
+	RTLIL::Design *cache_design = new RTLIL::Design;
+	Frontend::frontend_call(cache_design, &f, filename, "ilang");
+	RTLIL::Module *mod = cache_design->module(modname);
+	if (mod != nullptr)
+		design->add(mod->clone());
+	delete cache_design;
+
+	return mod != nullptr;
+}
+
+static void save_derived_module(RTLIL::Module *module, const std::string &filename)
+{
+	// write to a temporary file first, so that concurrent runs never see a partial file
+	std::string tmp_filename = make_temp_file(filename.substr(0, filename.rfind('/')) + "/yosys_derive_XXXXXX");
+	std::ofstream f(tmp_filename.c_str());
+	f << stringf("autoidx %d\n", int(autoidx));
+	ILANG_BACKEND::dump_module(f, "", module, module->design, false);
+	f.close();
+
+	if (f.fail() || rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+		log_warning("Can't write derive cache file `%s'.\n", filename.c_str());
+		remove(tmp_filename.c_str());
+	}
+}
+
 // create a new parametric module (when needed) and return the name of the generated module - WITH support for interfaces
 // This method is used to explode the interface when the interface is a port of the module (not instantiated inside)
 RTLIL::IdString AstModule::derive(RTLIL::Design *design, dict<RTLIL::IdString, RTLIL::Const> parameters, dict<RTLIL::IdString, RTLIL::Module*> interfaces, dict<RTLIL::IdString, RTLIL::IdString> modports, bool /*mayfail*/)
@@ -1409,50 +1799,60 @@ RTLIL::IdString AstModule::derive(RTLIL::Design *design, dict<RTLIL::IdString, R
 	if (!design->has(new_modname)) {
 		if (!new_ast) {
 			auto mod = dynamic_cast<AstModule*>(design->module(modname));
-			new_ast = mod->ast->clone();
+			new_ast = mod->unpack_ast();
 		}
 		modname = new_modname;
 		new_ast->str = modname;
 
-		// Iterate over all interfaces which are ports in this module:
-		for(auto &intf : interfaces) {
-			RTLIL::Module * intfmodule = intf.second;
-			std::string intfname = intf.first.str();
-			// Check if a modport applies for the interface port:
-			AstNode *modport = NULL;
-			if (modports.count(intfname) > 0) {
-				std::string interface_modport = modports.at(intfname).str();
-				AstModule *ast_module_of_interface = (AstModule*)intfmodule;
-				AstNode *ast_node_of_interface = ast_module_of_interface->ast;
-				modport = find_modport(ast_node_of_interface, interface_modport);
+		std::string cache_filename = has_interfaces ? std::string() : derive_cache_filename(design, new_ast);
+		if (!cache_filename.empty() && load_derived_module(design, modname, cache_filename)) {
+			log("Loaded RTLIL representation for module `%s' from derive cache file `%s'.\n", modname.c_str(), cache_filename.c_str());
+		} else {
+			// Iterate over all interfaces which are ports in this module:
+			for(auto &intf : interfaces) {
+				RTLIL::Module * intfmodule = intf.second;
+				std::string intfname = intf.first.str();
+				// Check if a modport applies for the interface port:
+				AstNode *modport = NULL;
+				AstNode *ast_node_of_interface = NULL;
+				if (modports.count(intfname) > 0) {
+					std::string interface_modport = modports.at(intfname).str();
+					AstModule *ast_module_of_interface = (AstModule*)intfmodule;
+					ast_node_of_interface = ast_module_of_interface->unpack_ast();
+					modport = find_modport(ast_node_of_interface, interface_modport);
+				}
+				// Iterate over all wires in the interface and add them to the module:
+				explode_interface_port(new_ast, intfmodule, intfname, modport);
+				delete ast_node_of_interface;
 			}
-			// Iterate over all wires in the interface and add them to the module:
-			explode_interface_port(new_ast, intfmodule, intfname, modport);
-		}
 
-		design->add(process_module(new_ast, false));
-		design->module(modname)->check();
+			design->add(process_module(new_ast, false));
+			design->module(modname)->check();
 
-		RTLIL::Module* mod = design->module(modname);
+			RTLIL::Module* mod = design->module(modname);
 
-		// Now that the interfaces have been exploded, we can delete the dummy port related to every interface.
-		for(auto &intf : interfaces) {
-			if(mod->wires_.count(intf.first)) {
-				mod->wires_.erase(intf.first);
-				mod->fixup_ports();
-				// We copy the cell of the interface to the sub-module such that it can further be found if it is propagated
-				// down to sub-sub-modules etc.
-				RTLIL::Cell * new_subcell = mod->addCell(intf.first, intf.second->name);
-				new_subcell->set_bool_attribute("\\is_interface");
+			// Now that the interfaces have been exploded, we can delete the dummy port related to every interface.
+			for(auto &intf : interfaces) {
+				if(mod->wires_.count(intf.first)) {
+					mod->wires_.erase(intf.first);
+					mod->fixup_ports();
+					// We copy the cell of the interface to the sub-module such that it can further be found if it is propagated
+					// down to sub-sub-modules etc.
+					RTLIL::Cell * new_subcell = mod->addCell(intf.first, intf.second->name);
+					new_subcell->set_bool_attribute("\\is_interface");
+				}
+				else {
+					log_error("No port with matching name found (%s) in %s. Stopping\n", log_id(intf.first), modname.c_str());
+				}
 			}
-			else {
-				log_error("No port with matching name found (%s) in %s. Stopping\n", log_id(intf.first), modname.c_str());
+
+			// If any interfaces were replaced, set the attribute 'interfaces_replaced_in_module':
+			if (interfaces.size() > 0) {
+				mod->set_bool_attribute("\\interfaces_replaced_in_module");
 			}
-		}
 
-		// If any interfaces were replaced, set the attribute 'interfaces_replaced_in_module':
-		if (interfaces.size() > 0) {
-			mod->set_bool_attribute("\\interfaces_replaced_in_module");
+			if (!cache_filename.empty())
+				save_derived_module(mod, cache_filename);
 		}
 
 	} else {
@@ -1471,8 +1871,15 @@ RTLIL::IdString AstModule::derive(RTLIL::Design *design, dict<RTLIL::IdString, R
 
 	if (!design->has(modname)) {
 		new_ast->str = modname;
-		design->add(process_module(new_ast, false));
-		design->module(modname)->check();
+		std::string cache_filename = derive_cache_filename(design, new_ast);
+		if (!cache_filename.empty() && load_derived_module(design, modname, cache_filename)) {
+			log("Loaded RTLIL representation for module `%s' from derive cache file `%s'.\n", modname.c_str(), cache_filename.c_str());
+		} else {
+			design->add(process_module(new_ast, false));
+			design->module(modname)->check();
+			if (!cache_filename.empty())
+				save_derived_module(design->module(modname), cache_filename);
+		}
 	} else {
 		log("Found cached RTLIL representation for module `%s'.\n", modname.c_str());
 	}
@@ -1492,20 +1899,18 @@ std::string AstModule::derive_common(RTLIL::Design *design, dict<RTLIL::IdString
 	std::string para_info;
 
 	int para_counter = 0;
-	for (const auto child : ast->children) {
-		if (child->type != AST_PARAMETER)
-			continue;
+	for (auto &para_name : ast_parameters) {
 		para_counter++;
-		std::string para_id = child->str;
+		std::string para_id = para_name;
 		if (parameters.count(para_id) > 0) {
-			log("Parameter %s = %s\n", child->str.c_str(), log_signal(RTLIL::SigSpec(parameters[child->str])));
-			para_info += stringf("%s=%s", child->str.c_str(), log_signal(RTLIL::SigSpec(parameters[para_id])));
+			log("Parameter %s = %s\n", para_name.c_str(), log_signal(RTLIL::SigSpec(parameters[para_name])));
+			para_info += stringf("%s=%s", para_name.c_str(), log_signal(RTLIL::SigSpec(parameters[para_id])));
 			continue;
 		}
 		para_id = stringf("$%d", para_counter);
 		if (parameters.count(para_id) > 0) {
-			log("Parameter %d (%s) = %s\n", para_counter, child->str.c_str(), log_signal(RTLIL::SigSpec(parameters[para_id])));
-			para_info += stringf("%s=%s", child->str.c_str(), log_signal(RTLIL::SigSpec(parameters[para_id])));
+			log("Parameter %d (%s) = %s\n", para_counter, para_name.c_str(), log_signal(RTLIL::SigSpec(parameters[para_id])));
+			para_info += stringf("%s=%s", para_name.c_str(), log_signal(RTLIL::SigSpec(parameters[para_id])));
 			continue;
 		}
 	}
@@ -1524,7 +1929,7 @@ std::string AstModule::derive_common(RTLIL::Design *design, dict<RTLIL::IdString
 	log_header(design, "Executing AST frontend in derive mode using pre-parsed AST for module `%s'.\n", stripped_name.c_str());
 	loadconfig();
 
-	AstNode *new_ast = ast->clone();
+	AstNode *new_ast = unpack_ast();
 	para_counter = 0;
 	for (auto child : new_ast->children) {
 		if (child->type != AST_PARAMETER)
@@ -1549,7 +1954,7 @@ std::string AstModule::derive_common(RTLIL::Design *design, dict<RTLIL::IdString
 		} else if ((parameters[para_id].flags & RTLIL::CONST_FLAG_STRING) != 0)
 			child->children[0] = AstNode::mkconst_str(parameters[para_id].decode_string());
 		else
-			child->children[0] = AstNode::mkconst_bits(parameters[para_id].bits, (parameters[para_id].flags & RTLIL::CONST_FLAG_SIGNED) != 0);
+			child->children[0] = AstNode::mkconst_bits(parameters[para_id].to_bits(), (parameters[para_id].flags & RTLIL::CONST_FLAG_SIGNED) != 0);
 		parameters.erase(para_id);
 	}
 
@@ -1559,7 +1964,7 @@ std::string AstModule::derive_common(RTLIL::Design *design, dict<RTLIL::IdString
 		if ((param.second.flags & RTLIL::CONST_FLAG_STRING) != 0)
 			defparam->children.push_back(AstNode::mkconst_str(param.second.decode_string()));
 		else
-			defparam->children.push_back(AstNode::mkconst_bits(param.second.bits, (param.second.flags & RTLIL::CONST_FLAG_SIGNED) != 0));
+			defparam->children.push_back(AstNode::mkconst_bits(param.second.to_bits(), (param.second.flags & RTLIL::CONST_FLAG_SIGNED) != 0));
 		new_ast->children.push_back(defparam);
 	}
 
@@ -1573,7 +1978,8 @@ RTLIL::Module *AstModule::clone() const
 	new_mod->name = name;
 	cloneInto(new_mod);
 
-	new_mod->ast = ast->clone();
+	new_mod->packed_ast = packed_ast;
+	new_mod->ast_parameters = ast_parameters;
 	new_mod->nolatches = nolatches;
 	new_mod->nomeminit = nomeminit;
 	new_mod->nomem2reg = nomem2reg;
@@ -1585,6 +1991,7 @@ RTLIL::Module *AstModule::clone() const
 	new_mod->icells = icells;
 	new_mod->pwires = pwires;
 	new_mod->autowire = autowire;
+	new_mod->derive_cache = derive_cache;
 
 	return new_mod;
 }
@@ -1607,6 +2014,7 @@ void AstModule::loadconfig() const
 	flag_icells = icells;
 	flag_pwires = pwires;
 	flag_autowire = autowire;
+	flag_derive_cache = derive_cache;
 	use_internal_line_num();
 }
 
@@ -47,10 +47,10 @@ static RTLIL::SigSpec uniop2rtlil(AstNode *that, std::string type, int result_wi
 	sstr << type << "$" << that->filename << ":" << that->linenum << "$" << (autoidx++);
 
 	RTLIL::Cell *cell = current_module->addCell(sstr.str(), type);
-	cell->attributes["\\src"] = stringf("%s:%d", that->filename.c_str(), that->linenum);
+	cell->set_src_attribute(stringf("%s:%d", that->filename.c_str(), that->linenum));
 
 	RTLIL::Wire *wire = current_module->addWire(cell->name.str() + "_Y", result_width);
-	wire->attributes["\\src"] = stringf("%s:%d", that->filename.c_str(), that->linenum);
+	wire->set_src_attribute(stringf("%s:%d", that->filename.c_str(), that->linenum));
 
 	if (gen_attributes)
 		for (auto &attr : that->attributes) {
@@ -80,10 +80,10 @@ static void widthExtend(AstNode *that, RTLIL::SigSpec &sig, int width, bool is_s
 	sstr << "$extend" << "$" << that->filename << ":" << that->linenum << "$" << (autoidx++);
 
 	RTLIL::Cell *cell = current_module->addCell(sstr.str(), "$pos");
-	cell->attributes["\\src"] = stringf("%s:%d", that->filename.c_str(), that->linenum);
+	cell->set_src_attribute(stringf("%s:%d", that->filename.c_str(), that->linenum));
 
 	RTLIL::Wire *wire = current_module->addWire(cell->name.str() + "_Y", width);
-	wire->attributes["\\src"] = stringf("%s:%d", that->filename.c_str(), that->linenum);
+	wire->set_src_attribute(stringf("%s:%d", that->filename.c_str(), that->linenum));
 
 	if (that != NULL)
 		for (auto &attr : that->attributes) {
@@ -108,10 +108,10 @@ static RTLIL::SigSpec binop2rtlil(AstNode *that, std::string type, int result_wi
 	sstr << type << "$" << that->filename << ":" << that->linenum << "$" << (autoidx++);
 
 	RTLIL::Cell *cell = current_module->addCell(sstr.str(), type);
-	cell->attributes["\\src"] = stringf("%s:%d", that->filename.c_str(), that->linenum);
+	cell->set_src_attribute(stringf("%s:%d", that->filename.c_str(), that->linenum));
 
 	RTLIL::Wire *wire = current_module->addWire(cell->name.str() + "_Y", result_width);
-	wire->attributes["\\src"] = stringf("%s:%d", that->filename.c_str(), that->linenum);
+	wire->set_src_attribute(stringf("%s:%d", that->filename.c_str(), that->linenum));
 
 	for (auto &attr : that->attributes) {
 		if (attr.second->type != AST_CONSTANT)
@@ -142,10 +142,10 @@ static RTLIL::SigSpec mux2rtlil(AstNode *that, const RTLIL::SigSpec &cond, const
 	sstr << "$ternary$" << that->filename << ":" << that->linenum << "$" << (autoidx++);
 
 	RTLIL::Cell *cell = current_module->addCell(sstr.str(), "$mux");
-	cell->attributes["\\src"] = stringf("%s:%d", that->filename.c_str(), that->linenum);
+	cell->set_src_attribute(stringf("%s:%d", that->filename.c_str(), that->linenum));
 
 	RTLIL::Wire *wire = current_module->addWire(cell->name.str() + "_Y", left.size());
-	wire->attributes["\\src"] = stringf("%s:%d", that->filename.c_str(), that->linenum);
+	wire->set_src_attribute(stringf("%s:%d", that->filename.c_str(), that->linenum));
 
 	for (auto &attr : that->attributes) {
 		if (attr.second->type != AST_CONSTANT)
@@ -195,11 +195,19 @@ struct AST_INTERNAL::ProcessGenerator
 	// Buffer for generating the init action
 	RTLIL::SigSpec init_lvalue, init_rvalue;
 
+	// The actions of all cases indexed by the wires they assign, so that an
+	// assignment only visits the earlier actions it overwrites. The cases are
+	// numbered in the order in which they are created. All cases that are
+	// created while a case is the current case are nested in that case.
+	std::vector<RTLIL::CaseRule*> case_list;
+	dict<RTLIL::CaseRule*, int, hash_ptr_ops> case_index;
+	dict<RTLIL::Wire*, std::vector<std::pair<int, int>>> action_index;
+
 	ProcessGenerator(AstNode *always, RTLIL::SigSpec initSyncSignalsArg = RTLIL::SigSpec()) : always(always), initSyncSignals(initSyncSignalsArg)
 	{
 		// generate process and simple root case
 		proc = new RTLIL::Process;
-		proc->attributes["\\src"] = stringf("%s:%d", always->filename.c_str(), always->linenum);
+		proc->set_src_attribute(stringf("%s:%d", always->filename.c_str(), always->linenum));
 		proc->name = stringf("$proc$%s:%d$%d", always->filename.c_str(), always->linenum, autoidx++);
 		for (auto &attr : always->attributes) {
 			if (attr.second->type != AST_CONSTANT)
@@ -209,6 +217,7 @@ struct AST_INTERNAL::ProcessGenerator
 		}
 		current_module->processes[proc->name] = proc;
 		current_case = &proc->root_case;
+		add_case(current_case);
 
 		// create initial temporary signal for all output registers
 		RTLIL::SigSpec subst_lvalue_from, subst_lvalue_to;
@@ -270,7 +279,7 @@ struct AST_INTERNAL::ProcessGenerator
 		if ((flag_nolatches || always->get_bool_attribute("\\nolatches") || current_module->get_bool_attribute("\\nolatches")) && !found_clocked_sync) {
 			subst_rvalue_map = subst_lvalue_from.to_sigbit_dict(RTLIL::SigSpec(RTLIL::State::Sx, GetSize(subst_lvalue_from)));
 		} else {
-			addChunkActions(current_case->actions, subst_lvalue_to, subst_lvalue_from);
+			addChunkActions(current_case, subst_lvalue_to, subst_lvalue_from);
 		}
 
 		// process the AST
@@ -335,7 +344,7 @@ struct AST_INTERNAL::ProcessGenerator
 			} while (current_module->wires_.count(wire_name) > 0);
 
 			RTLIL::Wire *wire = current_module->addWire(wire_name, chunk.width);
-			wire->attributes["\\src"] = stringf("%s:%d", always->filename.c_str(), always->linenum);
+			wire->set_src_attribute(stringf("%s:%d", always->filename.c_str(), always->linenum));
 
 			chunk.wire = wire;
 			chunk.offset = 0;
@@ -391,18 +400,51 @@ struct AST_INTERNAL::ProcessGenerator
 		}
 	}
 
+	void add_case(RTLIL::CaseRule *cs)
+	{
+		case_index[cs] = GetSize(case_list);
+		case_list.push_back(cs);
+	}
+
+	void add_case_action(RTLIL::CaseRule *cs, const RTLIL::SigSig &action)
+	{
+		std::pair<int, int> entry(case_index.at(cs), GetSize(cs->actions));
+		cs->actions.push_back(action);
+		for (auto &chunk : action.first.chunks()) {
+			if (chunk.wire == NULL)
+				continue;
+			std::vector<std::pair<int, int>> &entries = action_index[chunk.wire];
+			if (entries.empty() || entries.back() != entry)
+				entries.push_back(entry);
+		}
+	}
+
 	// remove all assignments to the given signal pattern in a case and all its children.
 	// e.g. when the last statement in the code "a = 23; if (b) a = 42; a = 0;" is processed this
 	// function is called to clean up the first two assignments as they are overwritten by
-	// the third assignment.
+	// the third assignment. cs must be the current case, so its children are the cases with
+	// a higher number.
 	void removeSignalFromCaseTree(const RTLIL::SigSpec &pattern, RTLIL::CaseRule *cs)
 	{
-		for (auto it = cs->actions.begin(); it != cs->actions.end(); it++)
-			it->first.remove2(pattern, &it->second);
+		int first_case = case_index.at(cs);
+		pool<RTLIL::Wire*> visited_wires;
+
+		for (auto &chunk : pattern.chunks())
+		{
+			if (chunk.wire == NULL || visited_wires.count(chunk.wire))
+				continue;
+			visited_wires.insert(chunk.wire);
 
-		for (auto it = cs->switches.begin(); it != cs->switches.end(); it++)
-			for (auto it2 = (*it)->cases.begin(); it2 != (*it)->cases.end(); it2++)
-				removeSignalFromCaseTree(pattern, *it2);
+			auto it = action_index.find(chunk.wire);
+			if (it == action_index.end())
+				continue;
+
+			for (auto &entry : it->second)
+				if (entry.first >= first_case) {
+					RTLIL::SigSig &action = case_list[entry.first]->actions[entry.second];
+					action.first.remove2(pattern, &action.second);
+				}
+		}
 	}
 
 	// add an assignment (aka "action") but split it up in chunks. this way huge assignments
@@ -428,6 +470,14 @@ struct AST_INTERNAL::ProcessGenerator
 		}
 	}
 
+	void addChunkActions(RTLIL::CaseRule *cs, RTLIL::SigSpec lvalue, RTLIL::SigSpec rvalue)
+	{
+		std::vector<RTLIL::SigSig> actions;
+		addChunkActions(actions, lvalue, rvalue);
+		for (auto &action : actions)
+			add_case_action(cs, action);
+	}
+
 	// recursively process the AST and fill the RTLIL::Process
 	void processAst(AstNode *ast)
 	{
@@ -463,14 +513,14 @@ struct AST_INTERNAL::ProcessGenerator
 
 				removeSignalFromCaseTree(lvalue, current_case);
 				remove_unwanted_lvalue_bits(lvalue, rvalue);
-				current_case->actions.push_back(RTLIL::SigSig(lvalue, rvalue));
+				add_case_action(current_case, RTLIL::SigSig(lvalue, rvalue));
 			}
 			break;
 
 		case AST_CASE:
 			{
 				RTLIL::SwitchRule *sw = new RTLIL::SwitchRule;
-				sw->attributes["\\src"] = stringf("%s:%d", ast->filename.c_str(), ast->linenum);
+				sw->set_src_attribute(stringf("%s:%d", ast->filename.c_str(), ast->linenum));
 				sw->signal = ast->children[0]->genWidthRTLIL(-1, &subst_rvalue_map.stdmap());
 				current_case->switches.push_back(sw);
 
@@ -490,6 +540,13 @@ struct AST_INTERNAL::ProcessGenerator
 
 				RTLIL::CaseRule *default_case = NULL;
 				RTLIL::CaseRule *last_generated_case = NULL;
+
+				// the lvalue substitution is the same for all cases, each case
+				// only undoes its own changes
+				subst_lvalue_map.save();
+				for (int i = 0; i < GetSize(this_case_eq_lvalue); i++)
+					subst_lvalue_map.set(this_case_eq_lvalue[i], this_case_eq_ltemp[i]);
+
 				for (auto child : ast->children)
 				{
 					if (child == ast->children[0])
@@ -499,14 +556,12 @@ struct AST_INTERNAL::ProcessGenerator
 					subst_lvalue_map.save();
 					subst_rvalue_map.save();
 
-					for (int i = 0; i < GetSize(this_case_eq_lvalue); i++)
-						subst_lvalue_map.set(this_case_eq_lvalue[i], this_case_eq_ltemp[i]);
-
 					RTLIL::CaseRule *backup_case = current_case;
 					current_case = new RTLIL::CaseRule;
-					current_case->attributes["\\src"] = stringf("%s:%d", child->filename.c_str(), child->linenum);
+					current_case->set_src_attribute(stringf("%s:%d", child->filename.c_str(), child->linenum));
+					add_case(current_case);
 					last_generated_case = current_case;
-					addChunkActions(current_case->actions, this_case_eq_ltemp, this_case_eq_rvalue);
+					addChunkActions(current_case, this_case_eq_ltemp, this_case_eq_rvalue);
 					for (auto node : child->children) {
 						if (node->type == AST_DEFAULT)
 							default_case = current_case;
@@ -525,6 +580,8 @@ struct AST_INTERNAL::ProcessGenerator
 					subst_rvalue_map.restore();
 				}
 
+				subst_lvalue_map.restore();
+
 				if (last_generated_case != NULL && ast->get_bool_attribute("\\full_case") && default_case == NULL) {
 			#if 0
 					// this is a valid transformation, but as optimization it is premature.
@@ -533,13 +590,15 @@ struct AST_INTERNAL::ProcessGenerator
 					last_generated_case->compare.clear();
 			#else
 					default_case = new RTLIL::CaseRule;
-					addChunkActions(default_case->actions, this_case_eq_ltemp, SigSpec(State::Sx, GetSize(this_case_eq_rvalue)));
+					add_case(default_case);
+					addChunkActions(default_case, this_case_eq_ltemp, SigSpec(State::Sx, GetSize(this_case_eq_rvalue)));
 					sw->cases.push_back(default_case);
 			#endif
 				} else {
 					if (default_case == NULL) {
 						default_case = new RTLIL::CaseRule;
-						addChunkActions(default_case->actions, this_case_eq_ltemp, this_case_eq_rvalue);
+						add_case(default_case);
+						addChunkActions(default_case, this_case_eq_ltemp, this_case_eq_rvalue);
 					}
 					sw->cases.push_back(default_case);
 				}
@@ -549,7 +608,7 @@ struct AST_INTERNAL::ProcessGenerator
 
 				this_case_eq_lvalue.replace(subst_lvalue_map.stdmap());
 				removeSignalFromCaseTree(this_case_eq_lvalue, current_case);
-				addChunkActions(current_case->actions, this_case_eq_lvalue, this_case_eq_ltemp);
+				addChunkActions(current_case, this_case_eq_lvalue, this_case_eq_ltemp);
 			}
 			break;
 
@@ -870,7 +929,7 @@ RTLIL::SigSpec AstNode::genRTLIL(int width_hint, bool sign_hint)
 		// This is used by the hierarchy pass to know when it can replace interface connection with the individual
 		// signals.
 		RTLIL::Wire *wire = current_module->addWire(str, 1);
-		wire->attributes["\\src"] = stringf("%s:%d", filename.c_str(), linenum);
+		wire->set_src_attribute(stringf("%s:%d", filename.c_str(), linenum));
 		wire->start_offset = 0;
 		wire->port_id = port_id;
 		wire->port_input = true;
@@ -907,7 +966,7 @@ RTLIL::SigSpec AstNode::genRTLIL(int width_hint, bool sign_hint)
 			RTLIL::Wire *wire = current_module->addWire(str, GetSize(val));
 			current_module->connect(wire, val);
 
-			wire->attributes["\\src"] = stringf("%s:%d", filename.c_str(), linenum);
+			wire->set_src_attribute(stringf("%s:%d", filename.c_str(), linenum));
 			wire->attributes[type == AST_PARAMETER ? "\\parameter" : "\\localparam"] = 1;
 
 			for (auto &attr : attributes) {
@@ -929,7 +988,7 @@ RTLIL::SigSpec AstNode::genRTLIL(int width_hint, bool sign_hint)
 				log_file_error(filename, linenum, "Signal `%s' with invalid width range %d!\n", str.c_str(), range_left - range_right + 1);
 
 			RTLIL::Wire *wire = current_module->addWire(str, range_left - range_right + 1);
-			wire->attributes["\\src"] = stringf("%s:%d", filename.c_str(), linenum);
+			wire->set_src_attribute(stringf("%s:%d", filename.c_str(), linenum));
 			wire->start_offset = range_right;
 			wire->port_id = port_id;
 			wire->port_input = is_input;
@@ -960,7 +1019,7 @@ RTLIL::SigSpec AstNode::genRTLIL(int width_hint, bool sign_hint)
 				log_file_error(filename, linenum, "Memory `%s' with non-constant width or size!\n", str.c_str());
 
 			RTLIL::Memory *memory = new RTLIL::Memory;
-			memory->attributes["\\src"] = stringf("%s:%d", filename.c_str(), linenum);
+			memory->set_src_attribute(stringf("%s:%d", filename.c_str(), linenum));
 			memory->name = str;
 			memory->width = children[0]->range_left - children[0]->range_right + 1;
 			if (children[1]->range_right < children[1]->range_left) {
@@ -1015,7 +1074,7 @@ RTLIL::SigSpec AstNode::genRTLIL(int width_hint, bool sign_hint)
 
 			if (id2ast && id2ast->type == AST_AUTOWIRE && current_module->wires_.count(str) == 0) {
 				RTLIL::Wire *wire = current_module->addWire(str);
-				wire->attributes["\\src"] = stringf("%s:%d", filename.c_str(), linenum);
+				wire->set_src_attribute(stringf("%s:%d", filename.c_str(), linenum));
 				wire->name = str;
 				if (flag_autowire)
 					log_file_warning(filename, linenum, "Identifier `%s' is implicitly declared.\n", str.c_str());
@@ -1359,10 +1418,10 @@ RTLIL::SigSpec AstNode::genRTLIL(int width_hint, bool sign_hint)
 			sstr << "$memrd$" << str << "$" << filename << ":" << linenum << "$" << (autoidx++);
 
 			RTLIL::Cell *cell = current_module->addCell(sstr.str(), "$memrd");
-			cell->attributes["\\src"] = stringf("%s:%d", filename.c_str(), linenum);
+			cell->set_src_attribute(stringf("%s:%d", filename.c_str(), linenum));
 
 			RTLIL::Wire *wire = current_module->addWire(cell->name.str() + "_DATA", current_module->memories[str]->width);
-			wire->attributes["\\src"] = stringf("%s:%d", filename.c_str(), linenum);
+			wire->set_src_attribute(stringf("%s:%d", filename.c_str(), linenum));
 
 			int mem_width, mem_size, addr_bits;
 			is_signed = id2ast->is_signed;
@@ -1397,7 +1456,7 @@ RTLIL::SigSpec AstNode::genRTLIL(int width_hint, bool sign_hint)
 			sstr << (type == AST_MEMWR ? "$memwr$" : "$meminit$") << str << "$" << filename << ":" << linenum << "$" << (autoidx++);
 
 			RTLIL::Cell *cell = current_module->addCell(sstr.str(), type == AST_MEMWR ? "$memwr" : "$meminit");
-			cell->attributes["\\src"] = stringf("%s:%d", filename.c_str(), linenum);
+			cell->set_src_attribute(stringf("%s:%d", filename.c_str(), linenum));
 
 			int mem_width, mem_size, addr_bits;
 			id2ast->meminfo(mem_width, mem_size, addr_bits);
@@ -1464,7 +1523,7 @@ RTLIL::SigSpec AstNode::genRTLIL(int width_hint, bool sign_hint)
 			}
 
 			RTLIL::Cell *cell = current_module->addCell(cellname, celltype);
-			cell->attributes["\\src"] = stringf("%s:%d", filename.c_str(), linenum);
+			cell->set_src_attribute(stringf("%s:%d", filename.c_str(), linenum));
 
 			for (auto &attr : attributes) {
 				if (attr.second->type != AST_CONSTANT)
@@ -1509,7 +1568,7 @@ RTLIL::SigSpec AstNode::genRTLIL(int width_hint, bool sign_hint)
 				log_file_error(filename, linenum, "Re-definition of cell `%s'!\n", str.c_str());
 
 			RTLIL::Cell *cell = current_module->addCell(str, "");
-			cell->attributes["\\src"] = stringf("%s:%d", filename.c_str(), linenum);
+			cell->set_src_attribute(stringf("%s:%d", filename.c_str(), linenum));
 			// Set attribute 'module_not_derived' which will be cleared again after the hierarchy pass
 			cell->set_bool_attribute("\\module_not_derived");
 
@@ -1648,7 +1707,7 @@ RTLIL::SigSpec AstNode::genRTLIL(int width_hint, bool sign_hint)
 					log_file_error(filename, linenum, "Failed to detect width of %s!\n", RTLIL::unescape_id(str).c_str());
 
 				Cell *cell = current_module->addCell(myid, str.substr(1));
-				cell->attributes["\\src"] = stringf("%s:%d", filename.c_str(), linenum);
+				cell->set_src_attribute(stringf("%s:%d", filename.c_str(), linenum));
 				cell->parameters["\\WIDTH"] = width;
 
 				if (attributes.count("\\reg")) {
@@ -1659,7 +1718,7 @@ RTLIL::SigSpec AstNode::genRTLIL(int width_hint, bool sign_hint)
 				}
 
 				Wire *wire = current_module->addWire(myid + "_wire", width);
-				wire->attributes["\\src"] = stringf("%s:%d", filename.c_str(), linenum);
+				wire->set_src_attribute(stringf("%s:%d", filename.c_str(), linenum));
 				cell->setPort("\\Y", wire);
 
 				is_signed = sign_hint;
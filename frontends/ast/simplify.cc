@@ -41,6 +41,12 @@ YOSYS_NAMESPACE_BEGIN
 using namespace AST;
 using namespace AST_INTERNAL;
 
+// results of constant function calls in the module that is currently being
+// simplified, keyed on the function declaration and the argument values
+typedef std::pair<std::vector<RTLIL::State>, bool> const_func_value_t;
+typedef std::tuple<AstNode*, std::string, std::vector<const_func_value_t>> const_func_key_t;
+static std::map<const_func_key_t, const_func_value_t> const_func_cache;
+
 // Process a format string and arguments for $display, $write, $sprintf, etc
 
 std::string AstNode::process_format_str(const std::string &sformat, int next_arg, int stage, int width_hint, bool sign_hint) {
@@ -146,6 +152,8 @@ std::string AstNode::process_format_str(const std::string &sformat, int next_arg
 // nodes that link to a different node using names and lexical scoping.
 bool AstNode::simplify(bool const_fold, bool at_zero, bool in_lvalue, int stage, int width_hint, bool sign_hint, bool in_param)
 {
+	YS_PROFILE_SCOPE("ast.simplify");
+
 	static int recursion_counter = 0;
 	static bool deep_recursion_warning = false;
 
@@ -257,14 +265,34 @@ bool AstNode::simplify(bool const_fold, bool at_zero, bool in_lvalue, int stage,
 				}
 			}
 
-			AstNode *async_block = NULL;
-			while (mem2reg_as_needed_pass2(mem2reg_set, this, NULL, async_block)) { }
+			if (!mem2reg_set.empty())
+			{
+				// Only the module items that were changed or added in the previous round
+				// (and the async block that collects the continuous assignments) need to
+				// be visited again. They are visited in the order of the module items.
+				AstNode *async_block = NULL;
+				pool<AstNode*> pending(children.begin(), children.end());
+				while (!pending.empty())
+				{
+					pool<AstNode*> changed;
+					size_t num_children = children.size();
+					auto children_list = children;
+					for (auto child : children_list)
+						if (pending.count(child) && child->mem2reg_as_needed_pass2(mem2reg_set, this, NULL, async_block))
+							changed.insert(child);
+
+					pending.clear();
+					for (size_t i = 0; i < children.size(); i++)
+						if (i >= num_children || changed.count(children[i]) || (!changed.empty() && children[i] == async_block))
+							pending.insert(children[i]);
+				}
 
-			vector<AstNode*> delnodes;
-			mem2reg_remove(mem2reg_set, delnodes);
+				vector<AstNode*> delnodes;
+				mem2reg_remove(mem2reg_set, delnodes);
 
-			for (auto node : delnodes)
-				delete node;
+				for (auto node : delnodes)
+					delete node;
+			}
 		}
 
 		while (simplify(const_fold, at_zero, in_lvalue, 2, width_hint, sign_hint, in_param)) { }
@@ -338,6 +366,7 @@ bool AstNode::simplify(bool const_fold, bool at_zero, bool in_lvalue, int stage,
 	// also merge multiple declarations for the same wire (e.g. "output foobar; reg foobar;")
 	if (type == AST_MODULE) {
 		current_scope.clear();
+		const_func_cache.clear();
 		std::map<std::string, AstNode*> this_wire_scope;
 		for (size_t i = 0; i < children.size(); i++) {
 			AstNode *node = children[i];
@@ -904,7 +933,7 @@ bool AstNode::simplify(bool const_fold, bool at_zero, bool in_lvalue, int stage,
 		if (children[1]->type != AST_CONSTANT)
 			log_file_error(filename, linenum, "Right operand of to_bits expression is not constant!\n");
 		RTLIL::Const new_value = children[1]->bitsAsConst(children[0]->bitsAsConst().as_int(), children[1]->is_signed);
-		newNode = mkconst_bits(new_value.bits, children[1]->is_signed);
+		newNode = mkconst_bits(new_value.to_bits(), children[1]->is_signed);
 		goto apply_newNode;
 	}
 
@@ -1020,7 +1049,7 @@ bool AstNode::simplify(bool const_fold, bool at_zero, bool in_lvalue, int stage,
 				log_file_warning(filename, linenum, "converting real value %e to binary %s.\n",
 						children[0]->realvalue, log_signal(constvalue));
 				delete children[0];
-				children[0] = mkconst_bits(constvalue.bits, sign_hint);
+				children[0] = mkconst_bits(constvalue.to_bits(), sign_hint);
 				did_something = true;
 			}
 			if (children[0]->type == AST_CONSTANT) {
@@ -1028,7 +1057,7 @@ bool AstNode::simplify(bool const_fold, bool at_zero, bool in_lvalue, int stage,
 					RTLIL::SigSpec sig(children[0]->bits);
 					sig.extend_u0(width, children[0]->is_signed);
 					AstNode *old_child_0 = children[0];
-					children[0] = mkconst_bits(sig.as_const().bits, is_signed);
+					children[0] = mkconst_bits(sig.as_const().to_bits(), is_signed);
 					delete old_child_0;
 				}
 				children[0]->is_signed = is_signed;
@@ -2099,8 +2128,8 @@ skip_dynamic_range_lvalue_expansion:;
 				delete buf;
 
 				uint32_t result = 0;
-				for (size_t i = 0; i < arg_value.bits.size(); i++)
-					if (arg_value.bits.at(i) == RTLIL::State::S1)
+				for (int i = 0; i < arg_value.size(); i++)
+					if (arg_value[i] == RTLIL::State::S1)
 						result = i + 1;
 
 				newNode = mkconst_int(result, true);
@@ -2385,9 +2414,21 @@ skip_dynamic_range_lvalue_expansion:;
 			}
 
 			if (all_args_const) {
-				AstNode *func_workspace = current_scope[str]->clone();
+				std::vector<const_func_value_t> args;
+				for (auto child : children)
+					args.push_back(const_func_value_t(child->bits, child->is_signed));
+				const_func_key_t key(decl, decl->str, args);
+
+				auto it = const_func_cache.find(key);
+				if (it != const_func_cache.end()) {
+					newNode = AstNode::mkconst_bits(it->second.first, it->second.second);
+					goto apply_newNode;
+				}
+
+				AstNode *func_workspace = decl->clone();
 				newNode = func_workspace->eval_const_function(this);
 				delete func_workspace;
+				const_func_cache[key] = const_func_value_t(newNode->bits, newNode->is_signed);
 				goto apply_newNode;
 			}
 
@@ -2639,14 +2680,14 @@ replace_fcall_later:;
 		case AST_BIT_NOT:
 			if (children[0]->type == AST_CONSTANT) {
 				RTLIL::Const y = RTLIL::const_not(children[0]->bitsAsConst(width_hint, sign_hint), dummy_arg, sign_hint, false, width_hint);
-				newNode = mkconst_bits(y.bits, sign_hint);
+				newNode = mkconst_bits(y.to_bits(), sign_hint);
 			}
 			break;
 		case AST_TO_SIGNED:
 		case AST_TO_UNSIGNED:
 			if (children[0]->type == AST_CONSTANT) {
 				RTLIL::Const y = children[0]->bitsAsConst(width_hint, sign_hint);
-				newNode = mkconst_bits(y.bits, type == AST_TO_SIGNED);
+				newNode = mkconst_bits(y.to_bits(), type == AST_TO_SIGNED);
 			}
 			break;
 		if (0) { case AST_BIT_AND:  const_func = RTLIL::const_and;  }
@@ -2656,7 +2697,7 @@ replace_fcall_later:;
 			if (children[0]->type == AST_CONSTANT && children[1]->type == AST_CONSTANT) {
 				RTLIL::Const y = const_func(children[0]->bitsAsConst(width_hint, sign_hint),
 						children[1]->bitsAsConst(width_hint, sign_hint), sign_hint, sign_hint, width_hint);
-				newNode = mkconst_bits(y.bits, sign_hint);
+				newNode = mkconst_bits(y.to_bits(), sign_hint);
 			}
 			break;
 		if (0) { case AST_REDUCE_AND:  const_func = RTLIL::const_reduce_and;  }
@@ -2666,13 +2707,13 @@ replace_fcall_later:;
 		if (0) { case AST_REDUCE_BOOL: const_func = RTLIL::const_reduce_bool; }
 			if (children[0]->type == AST_CONSTANT) {
 				RTLIL::Const y = const_func(RTLIL::Const(children[0]->bits), dummy_arg, false, false, -1);
-				newNode = mkconst_bits(y.bits, false);
+				newNode = mkconst_bits(y.to_bits(), false);
 			}
 			break;
 		case AST_LOGIC_NOT:
 			if (children[0]->type == AST_CONSTANT) {
 				RTLIL::Const y = RTLIL::const_logic_not(RTLIL::Const(children[0]->bits), dummy_arg, children[0]->is_signed, false, -1);
-				newNode = mkconst_bits(y.bits, false);
+				newNode = mkconst_bits(y.to_bits(), false);
 			} else
 			if (children[0]->isConst()) {
 				newNode = mkconst_int(children[0]->asReal(sign_hint) == 0, false, 1);
@@ -2683,7 +2724,7 @@ replace_fcall_later:;
 			if (children[0]->type == AST_CONSTANT && children[1]->type == AST_CONSTANT) {
 				RTLIL::Const y = const_func(RTLIL::Const(children[0]->bits), RTLIL::Const(children[1]->bits),
 						children[0]->is_signed, children[1]->is_signed, -1);
-				newNode = mkconst_bits(y.bits, false);
+				newNode = mkconst_bits(y.to_bits(), false);
 			} else
 			if (children[0]->isConst() && children[1]->isConst()) {
 				if (type == AST_LOGIC_AND)
@@ -2700,7 +2741,7 @@ replace_fcall_later:;
 			if (children[0]->type == AST_CONSTANT && children[1]->type == AST_CONSTANT) {
 				RTLIL::Const y = const_func(children[0]->bitsAsConst(width_hint, sign_hint),
 						RTLIL::Const(children[1]->bits), sign_hint, type == AST_POW ? children[1]->is_signed : false, width_hint);
-				newNode = mkconst_bits(y.bits, sign_hint);
+				newNode = mkconst_bits(y.to_bits(), sign_hint);
 			} else
 			if (type == AST_POW && children[0]->isConst() && children[1]->isConst()) {
 				newNode = new AstNode(AST_REALVALUE);
@@ -2720,7 +2761,7 @@ replace_fcall_later:;
 				bool cmp_signed = children[0]->is_signed && children[1]->is_signed;
 				RTLIL::Const y = const_func(children[0]->bitsAsConst(cmp_width, cmp_signed),
 						children[1]->bitsAsConst(cmp_width, cmp_signed), cmp_signed, cmp_signed, 1);
-				newNode = mkconst_bits(y.bits, false);
+				newNode = mkconst_bits(y.to_bits(), false);
 			} else
 			if (children[0]->isConst() && children[1]->isConst()) {
 				bool cmp_signed = (children[0]->type == AST_REALVALUE || children[0]->is_signed) && (children[1]->type == AST_REALVALUE || children[1]->is_signed);
@@ -2745,7 +2786,7 @@ replace_fcall_later:;
 			if (children[0]->type == AST_CONSTANT && children[1]->type == AST_CONSTANT) {
 				RTLIL::Const y = const_func(children[0]->bitsAsConst(width_hint, sign_hint),
 						children[1]->bitsAsConst(width_hint, sign_hint), sign_hint, sign_hint, width_hint);
-				newNode = mkconst_bits(y.bits, sign_hint);
+				newNode = mkconst_bits(y.to_bits(), sign_hint);
 			} else
 			if (children[0]->isConst() && children[1]->isConst()) {
 				newNode = new AstNode(AST_REALVALUE);
@@ -2763,7 +2804,7 @@ replace_fcall_later:;
 		if (0) { case AST_NEG: const_func = RTLIL::const_neg; }
 			if (children[0]->type == AST_CONSTANT) {
 				RTLIL::Const y = const_func(children[0]->bitsAsConst(width_hint, sign_hint), dummy_arg, sign_hint, false, width_hint);
-				newNode = mkconst_bits(y.bits, sign_hint);
+				newNode = mkconst_bits(y.to_bits(), sign_hint);
 			} else
 			if (children[0]->isConst()) {
 				newNode = new AstNode(AST_REALVALUE);
@@ -2806,10 +2847,10 @@ replace_fcall_later:;
 							newNode->realvalue = choice->asReal(sign_hint);
 						} else {
 							RTLIL::Const y = choice->bitsAsConst(width_hint, sign_hint);
-							if (choice->is_string && y.bits.size() % 8 == 0 && sign_hint == false)
-								newNode = mkconst_str(y.bits);
+							if (choice->is_string && y.size() % 8 == 0 && sign_hint == false)
+								newNode = mkconst_str(y.to_bits());
 							else
-								newNode = mkconst_bits(y.bits, sign_hint);
+								newNode = mkconst_bits(y.to_bits(), sign_hint);
 						}
 					} else
 					if (choice->isConst()) {
@@ -2818,11 +2859,11 @@ replace_fcall_later:;
 				} else if (children[1]->type == AST_CONSTANT && children[2]->type == AST_CONSTANT) {
 					RTLIL::Const a = children[1]->bitsAsConst(width_hint, sign_hint);
 					RTLIL::Const b = children[2]->bitsAsConst(width_hint, sign_hint);
-					log_assert(a.bits.size() == b.bits.size());
-					for (size_t i = 0; i < a.bits.size(); i++)
-						if (a.bits[i] != b.bits[i])
-							a.bits[i] = RTLIL::State::Sx;
-					newNode = mkconst_bits(a.bits, sign_hint);
+					log_assert(a.size() == b.size());
+					for (int i = 0; i < a.size(); i++)
+						if (a[i] != b[i])
+							a.bits()[i] = RTLIL::State::Sx;
+					newNode = mkconst_bits(a.to_bits(), sign_hint);
 				} else if (children[1]->isConst() && children[2]->isConst()) {
 					newNode = new AstNode(AST_REALVALUE);
 					if (children[1]->asReal(sign_hint) == children[2]->asReal(sign_hint))
@@ -2889,6 +2930,56 @@ static void replace_result_wire_name_in_function(AstNode *node, std::string &fro
 }
 
 // replace a readmem[bh] TCALL ast node with a block of memory assignments
+// parse one data word of a $readmemh/$readmemb file into a constant of the given
+// width, with the same rules as const2ast() for "<width>'h<word>" resp. "<width>'b<word>"
+static void readmem_parse_word(std::vector<RTLIL::State> &data, const char *word, int len, bool is_hex, int width,
+		const std::string &filename, int linenum)
+{
+	int bits_per_digit = is_hex ? 4 : 1;
+	data.clear();
+
+	for (int i = len-1; i >= 0; i--)
+	{
+		char ch = word[i];
+		int digit;
+
+		if ('0' <= ch && ch <= '9')
+			digit = ch - '0';
+		else if ('a' <= ch && ch <= 'f')
+			digit = 10 + ch - 'a';
+		else if ('A' <= ch && ch <= 'F')
+			digit = 10 + ch - 'A';
+		else if (ch == 'x' || ch == 'X') {
+			data.insert(data.end(), bits_per_digit, State::Sx);
+			continue;
+		} else if (ch == 'z' || ch == 'Z' || ch == '?') {
+			data.insert(data.end(), bits_per_digit, State::Sz);
+			continue;
+		} else
+			continue;
+
+		if (digit >= (1 << bits_per_digit))
+			log_file_error(filename, linenum, "Digit larger than %d used in in base-%d constant.\n",
+					(1 << bits_per_digit) - 1, 1 << bits_per_digit);
+
+		for (int j = 0; j < bits_per_digit; j++)
+			data.push_back(((digit >> j) & 1) ? State::S1 : State::S0);
+	}
+
+	RTLIL::State msb = data.empty() ? State::S0 : data.back();
+
+	int value_len = GetSize(data) - 1;
+	while (value_len >= 0 && data[value_len] != State::S1)
+		value_len--;
+	value_len += (msb == State::S0 || msb == State::S1) ? 1 : 2;
+
+	data.resize(width, (msb == State::S0 || msb == State::S1) ? State::S0 : msb);
+
+	if (value_len > width)
+		log_warning("Literal has a width of %d bit, but value requires %d bit. (%s:%d)\n",
+				width, value_len, filename.c_str(), linenum);
+}
+
 AstNode *AstNode::readmem(bool is_readmemh, std::string mem_filename, AstNode *memory, int start_addr, int finish_addr, bool unconditional_init)
 {
 	int mem_width, mem_size, addr_bits;
@@ -2932,9 +3023,11 @@ AstNode *AstNode::readmem(bool is_readmemh, std::string mem_filename, AstNode *m
 	int increment = start_addr <= finish_addr ? +1 : -1;
 	int cursor = start_addr;
 
+	std::string line;
+	std::vector<RTLIL::State> word;
+
 	while (!f.eof())
 	{
-		std::string line, token;
 		std::getline(f, line);
 
 		for (int i = 0; i < GetSize(line); i++) {
@@ -2950,14 +3043,18 @@ AstNode *AstNode::readmem(bool is_readmemh, std::string mem_filename, AstNode *m
 				line[i] = ' ';
 		}
 
+		size_t token_end = 0;
 		while (1)
 		{
-			token = next_token(line, " \t\r\n");
-			if (token.empty() || token.compare(0, 2, "//") == 0)
+			size_t token_begin = line.find_first_not_of(" \t\r\n", token_end);
+			if (token_begin == std::string::npos || line.compare(token_begin, 2, "//") == 0)
 				break;
+			token_end = line.find_first_of(" \t\r\n", token_begin);
+			if (token_end == std::string::npos)
+				token_end = line.size();
 
-			if (token[0] == '@') {
-				token = token.substr(1);
+			if (line[token_begin] == '@') {
+				std::string token = line.substr(token_begin+1, token_end-token_begin-1);
 				const char *nptr = token.c_str();
 				char *endptr;
 				cursor = strtol(nptr, &endptr, 16);
@@ -2966,7 +3063,7 @@ AstNode *AstNode::readmem(bool is_readmemh, std::string mem_filename, AstNode *m
 				continue;
 			}
 
-			AstNode *value = VERILOG_FRONTEND::const2ast(stringf("%d'%c", mem_width, is_readmemh ? 'h' : 'b') + token);
+			readmem_parse_word(word, line.c_str() + token_begin, token_end - token_begin, is_readmemh, mem_width, filename, linenum);
 
 			if (unconditional_init)
 			{
@@ -2992,11 +3089,11 @@ AstNode *AstNode::readmem(bool is_readmemh, std::string mem_filename, AstNode *m
 
 				meminit_size++;
 				next_meminit_cursor++;
-				meminit_bits.insert(meminit_bits.end(), value->bits.begin(), value->bits.end());
-				delete value;
+				meminit_bits.insert(meminit_bits.end(), word.begin(), word.end());
 			}
 			else
 			{
+				AstNode *value = AstNode::mkconst_bits(word, false);
 				block->children.push_back(new AstNode(AST_ASSIGN_EQ, new AstNode(AST_IDENTIFIER, new AstNode(AST_RANGE, AstNode::mkconst_int(cursor, false))), value));
 				block->children.back()->children[0]->str = memory->str;
 				block->children.back()->children[0]->id2ast = memory;
@@ -3286,6 +3383,10 @@ void AstNode::mem2reg_remove(pool<AstNode*> &mem2reg_set, vector<AstNode*> &deln
 }
 
 // actually replace memories with registers
+// the statement of the innermost block that contains the node visited by
+// mem2reg_as_needed_pass2, so reads do not have to be searched in the block
+static AstNode *mem2reg_block_child = NULL;
+
 bool AstNode::mem2reg_as_needed_pass2(pool<AstNode*> &mem2reg_set, AstNode *mod, AstNode *block, AstNode *&async_block)
 {
 	bool did_something = false;
@@ -3318,7 +3419,7 @@ bool AstNode::mem2reg_as_needed_pass2(pool<AstNode*> &mem2reg_set, AstNode *mod,
 			int wordsz = GetSize(data) / length;
 
 			for (int i = 0; i < length; i++) {
-				block->children.push_back(new AstNode(AST_ASSIGN_EQ, new AstNode(AST_IDENTIFIER, new AstNode(AST_RANGE, AstNode::mkconst_int(cursor+i, false))), mkconst_bits(data.extract(i*wordsz, wordsz).bits, false)));
+				block->children.push_back(new AstNode(AST_ASSIGN_EQ, new AstNode(AST_IDENTIFIER, new AstNode(AST_RANGE, AstNode::mkconst_int(cursor+i, false))), mkconst_bits(data.extract(i*wordsz, wordsz).to_bits(), false)));
 				block->children.back()->children[0]->str = str;
 				block->children.back()->children[0]->id2ast = id2ast;
 				block->children.back()->children[0]->was_checked = true;
@@ -3493,8 +3594,13 @@ bool AstNode::mem2reg_as_needed_pass2(pool<AstNode*> &mem2reg_set, AstNode *mod,
 			if (block)
 			{
 				size_t assign_idx = 0;
-				while (assign_idx < block->children.size() && !block->children[assign_idx]->contains(this))
+				while (assign_idx < block->children.size() && block->children[assign_idx] != mem2reg_block_child)
 					assign_idx++;
+				if (assign_idx == block->children.size()) {
+					assign_idx = 0;
+					while (assign_idx < block->children.size() && !block->children[assign_idx]->contains(this))
+						assign_idx++;
+				}
 				log_assert(assign_idx < block->children.size());
 				block->children.insert(block->children.begin()+assign_idx, case_node);
 				block->children.insert(block->children.begin()+assign_idx, assign_addr);
@@ -3522,9 +3628,14 @@ bool AstNode::mem2reg_as_needed_pass2(pool<AstNode*> &mem2reg_set, AstNode *mod,
 	log_assert(id2ast == NULL || mem2reg_set.count(id2ast) == 0);
 
 	auto children_list = children;
-	for (size_t i = 0; i < children_list.size(); i++)
+	AstNode *backup_block_child = mem2reg_block_child;
+	for (size_t i = 0; i < children_list.size(); i++) {
+		if (type == AST_BLOCK)
+			mem2reg_block_child = children_list[i];
 		if (children_list[i]->mem2reg_as_needed_pass2(mem2reg_set, mod, block, async_block))
 			did_something = true;
+	}
+	mem2reg_block_child = backup_block_child;
 
 	return did_something;
 }
@@ -3575,7 +3686,7 @@ bool AstNode::is_simple_const_expr()
 void AstNode::replace_variables(std::map<std::string, AstNode::varinfo_t> &variables, AstNode *fcall)
 {
 	if (type == AST_IDENTIFIER && variables.count(str)) {
-		int offset = variables.at(str).offset, width = variables.at(str).val.bits.size();
+		int offset = variables.at(str).offset, width = variables.at(str).val.size();
 		if (!children.empty()) {
 			if (children.size() != 1 || children.at(0)->type != AST_RANGE)
 				log_file_error(filename, linenum, "Memory access in constant function is not supported\n%s:%d: ...called from here.\n",
@@ -3589,7 +3700,7 @@ void AstNode::replace_variables(std::map<std::string, AstNode::varinfo_t> &varia
 			width = min(std::abs(children.at(0)->range_left - children.at(0)->range_right) + 1, width);
 		}
 		offset -= variables.at(str).offset;
-		std::vector<RTLIL::State> &var_bits = variables.at(str).val.bits;
+		std::vector<RTLIL::State> &var_bits = variables.at(str).val.bits();
 		std::vector<RTLIL::State> new_bits(var_bits.begin() + offset, var_bits.begin() + offset + width);
 		AstNode *newNode = mkconst_bits(new_bits, variables.at(str).is_signed);
 		newNode->cloneInto(this);
@@ -3621,7 +3732,7 @@ AstNode *AstNode::eval_const_function(AstNode *fcall)
 			variables[child->str].offset = min(child->range_left, child->range_right);
 			variables[child->str].is_signed = child->is_signed;
 			if (child->is_input && argidx < fcall->children.size())
-				variables[child->str].val = fcall->children.at(argidx++)->bitsAsConst(variables[child->str].val.bits.size());
+				variables[child->str].val = fcall->children.at(argidx++)->bitsAsConst(variables[child->str].val.size());
 			backup_scope[child->str] = current_scope[child->str];
 			current_scope[child->str] = child;
 			continue;
@@ -3667,7 +3778,7 @@ AstNode *AstNode::eval_const_function(AstNode *fcall)
 						fcall->filename.c_str(), fcall->linenum);
 
 			if (stmt->children.at(0)->children.empty()) {
-				variables[stmt->children.at(0)->str].val = stmt->children.at(1)->bitsAsConst(variables[stmt->children.at(0)->str].val.bits.size());
+				variables[stmt->children.at(0)->str].val = stmt->children.at(1)->bitsAsConst(variables[stmt->children.at(0)->str].val.size());
 			} else {
 				AstNode *range = stmt->children.at(0)->children.at(0);
 				if (!range->range_valid)
@@ -3676,9 +3787,9 @@ AstNode *AstNode::eval_const_function(AstNode *fcall)
 				int offset = min(range->range_left, range->range_right);
 				int width = std::abs(range->range_left - range->range_right) + 1;
 				varinfo_t &v = variables[stmt->children.at(0)->str];
-				RTLIL::Const r = stmt->children.at(1)->bitsAsConst(v.val.bits.size());
+				RTLIL::Const r = stmt->children.at(1)->bitsAsConst(v.val.size());
 				for (int i = 0; i < width; i++)
-					v.val.bits.at(i+offset-v.offset) = r.bits.at(i);
+					v.val.bits().at(i+offset-v.offset) = r[i];
 			}
 
 			delete block->children.front();
@@ -3805,7 +3916,7 @@ AstNode *AstNode::eval_const_function(AstNode *fcall)
 		else
 			current_scope[it.first] = it.second;
 
-	return AstNode::mkconst_bits(variables.at(str).val.bits, variables.at(str).is_signed);
+	return AstNode::mkconst_bits(variables.at(str).val.to_bits(), variables.at(str).is_signed);
 }
 
 YOSYS_NAMESPACE_END
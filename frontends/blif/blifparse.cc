@@ -18,43 +18,83 @@
  */
 
 #include "blifparse.h"
+#include "kernel/threadpool.h"
 
 YOSYS_NAMESPACE_BEGIN
 
-static bool read_next_line(char *&buffer, size_t &buffer_size, int &line_count, std::istream &f)
+struct BlifInput
+{
+	const char *ptr, *end;
+};
+
+static bool read_next_line(char *&buffer, size_t &buffer_size, int &line_count, BlifInput &f)
 {
-	string strbuf;
 	int buffer_len = 0;
 	buffer[0] = 0;
 
 	while (1)
 	{
-		buffer_len += strlen(buffer + buffer_len);
 		while (buffer_len > 0 && (buffer[buffer_len-1] == ' ' || buffer[buffer_len-1] == '\t' ||
 				buffer[buffer_len-1] == '\r' || buffer[buffer_len-1] == '\n'))
 			buffer[--buffer_len] = 0;
 
-		if (buffer_size-buffer_len < 4096) {
-			buffer_size *= 2;
-			buffer = (char*)realloc(buffer, buffer_size);
-		}
-
 		if (buffer_len == 0 || buffer[buffer_len-1] == '\\') {
 			if (buffer_len > 0 && buffer[buffer_len-1] == '\\')
 				buffer[--buffer_len] = 0;
 			line_count++;
-			if (!std::getline(f, strbuf))
+			if (f.ptr == f.end)
 				return false;
-			while (buffer_size-buffer_len < strbuf.size()+1) {
+			const char *eol = (const char*)memchr(f.ptr, '\n', f.end - f.ptr);
+			size_t len = (eol ? eol : f.end) - f.ptr;
+			while (buffer_size-buffer_len < len+1) {
 				buffer_size *= 2;
 				buffer = (char*)realloc(buffer, buffer_size);
 			}
-			strcpy(buffer+buffer_len, strbuf.c_str());
+			// a NUL character ends the line, like it did with std::getline() and strcpy()
+			const char *nul = (const char*)memchr(f.ptr, 0, len);
+			size_t copy_len = nul ? nul - f.ptr : len;
+			memcpy(buffer+buffer_len, f.ptr, copy_len);
+			buffer_len += copy_len;
+			buffer[buffer_len] = 0;
+			f.ptr = eol ? eol+1 : f.end;
 		} else
 			return true;
 	}
 }
 
+// Reentrant replacement for strtok(): returns the next token at or after
+// cursor and moves cursor behind it, or returns NULL at the end of the line.
+static char *next_blif_token(char *&cursor, const char *sep = " \t\r\n")
+{
+	if (cursor == nullptr)
+		return nullptr;
+
+	while (*cursor && strchr(sep, *cursor))
+		cursor++;
+
+	if (*cursor == 0) {
+		cursor = nullptr;
+		return nullptr;
+	}
+
+	char *token = cursor;
+	while (*cursor && !strchr(sep, *cursor))
+		cursor++;
+
+	if (*cursor)
+		*(cursor++) = 0;
+	else
+		cursor = nullptr;
+
+	return token;
+}
+
+static void raise_autoidx(int value)
+{
+	int current = autoidx.load();
+	while (current < value && !autoidx.compare_exchange_weak(current, value)) { }
+}
+
 static std::pair<RTLIL::IdString, int> wideports_split(std::string name)
 {
 	int pos = -1;
@@ -78,7 +118,7 @@ failed:
 	return std::pair<RTLIL::IdString, int>("\\" + name, 0);
 }
 
-void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool run_clean, bool sop_mode, bool wideports)
+static void parse_blif_models(RTLIL::Design *design, BlifInput &f, int line_count, IdString dff_name, bool run_clean, bool sop_mode, bool wideports)
 {
 	RTLIL::Module *module = nullptr;
 	RTLIL::Const *lutptr = NULL;
@@ -125,7 +165,7 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 
 	size_t buffer_size = 4096;
 	char *buffer = (char*)malloc(buffer_size);
-	int line_count = 0;
+	char *cursor = nullptr;
 
 	while (1)
 	{
@@ -143,7 +183,7 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 		if (buffer[0] == '.')
 		{
 			if (lutptr) {
-				for (auto &bit : lutptr->bits)
+				for (auto &bit : lutptr->bits())
 					if (bit == RTLIL::State::Sx)
 						bit = lut_default_state;
 				lutptr = NULL;
@@ -155,14 +195,15 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 				sopmode = -1;
 			}
 
-			char *cmd = strtok(buffer, " \t\r\n");
+			cursor = buffer;
+			char *cmd = next_blif_token(cursor);
 
 			if (!strcmp(cmd, ".model")) {
 				if (module != nullptr)
 					goto error;
 				module = new RTLIL::Module;
 				lastcell = nullptr;
-				module->name = RTLIL::escape_id(strtok(NULL, " \t\r\n"));
+				module->name = RTLIL::escape_id(next_blif_token(cursor));
 				obj_attributes = &module->attributes;
 				obj_parameters = nullptr;
 				if (design->module(module->name))
@@ -236,7 +277,7 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 					if (undef_wire != nullptr)
 						module->rename(undef_wire, stringf("$undef$%d", ++blif_maxnum));
 
-					autoidx = std::max(autoidx, blif_maxnum+1);
+					raise_autoidx(blif_maxnum+1);
 					blif_maxnum = 0;
 				}
 
@@ -250,7 +291,7 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 			if (!strcmp(cmd, ".inputs") || !strcmp(cmd, ".outputs"))
 			{
 				char *p;
-				while ((p = strtok(NULL, " \t\r\n")) != NULL)
+				while ((p = next_blif_token(cursor)) != NULL)
 				{
 					RTLIL::IdString wire_name(stringf("\\%s", p));
 					RTLIL::Wire *wire = module->wire(wire_name);
@@ -276,7 +317,7 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 
 			if (!strcmp(cmd, ".cname"))
 			{
-				char *p = strtok(NULL, " \t\r\n");
+				char *p = next_blif_token(cursor);
 				if (p == NULL)
 					goto error;
 
@@ -291,8 +332,8 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 			}
 
 			if (!strcmp(cmd, ".attr") || !strcmp(cmd, ".param")) {
-				char *n = strtok(NULL, " \t\r\n");
-				char *v = strtok(NULL, "\r\n");
+				char *n = next_blif_token(cursor);
+				char *v = next_blif_token(cursor, "\r\n");
 				IdString id_n = RTLIL::escape_id(n);
 				Const const_v;
 				if (v[0] == '"') {
@@ -302,9 +343,9 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 					const_v = Const(str);
 				} else {
 					int n = strlen(v);
-					const_v.bits.resize(n);
+					const_v.bits().resize(n);
 					for (int i = 0; i < n; i++)
-						const_v.bits[i] = v[n-i-1] != '0' ? State::S1 : State::S0;
+						const_v.bits()[i] = v[n-i-1] != '0' ? State::S1 : State::S0;
 				}
 				if (!strcmp(cmd, ".attr")) {
 					if (obj_attributes == nullptr) {
@@ -324,11 +365,11 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 
 			if (!strcmp(cmd, ".latch"))
 			{
-				char *d = strtok(NULL, " \t\r\n");
-				char *q = strtok(NULL, " \t\r\n");
-				char *edge = strtok(NULL, " \t\r\n");
-				char *clock = strtok(NULL, " \t\r\n");
-				char *init = strtok(NULL, " \t\r\n");
+				char *d = next_blif_token(cursor);
+				char *q = next_blif_token(cursor);
+				char *edge = next_blif_token(cursor);
+				char *clock = next_blif_token(cursor);
+				char *init = next_blif_token(cursor);
 				RTLIL::Cell *cell = nullptr;
 
 				if (clock == nullptr && edge != nullptr) {
@@ -369,7 +410,7 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 
 			if (!strcmp(cmd, ".gate") || !strcmp(cmd, ".subckt"))
 			{
-				char *p = strtok(NULL, " \t\r\n");
+				char *p = next_blif_token(cursor);
 				if (p == NULL)
 					goto error;
 
@@ -378,7 +419,7 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 
 				dict<RTLIL::IdString, dict<int, SigBit>> cell_wideports_cache;
 
-				while ((p = strtok(NULL, " \t\r\n")) != NULL)
+				while ((p = next_blif_token(cursor)) != NULL)
 				{
 					char *q = strchr(p, '=');
 					if (q == NULL || !q[0])
@@ -425,11 +466,11 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 
 			if (!strcmp(cmd, ".barbuf") || !strcmp(cmd, ".conn"))
 			{
-				char *p = strtok(NULL, " \t\r\n");
+				char *p = next_blif_token(cursor);
 				if (p == NULL)
 					goto error;
 
-				char *q = strtok(NULL, " \t\r\n");
+				char *q = next_blif_token(cursor);
 				if (q == NULL)
 					goto error;
 
@@ -441,7 +482,7 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 			{
 				char *p;
 				RTLIL::SigSpec input_sig, output_sig;
-				while ((p = strtok(NULL, " \t\r\n")) != NULL)
+				while ((p = next_blif_token(cursor)) != NULL)
 					input_sig.append(blif_wire(p));
 				output_sig = input_sig.extract(input_sig.size()-1, 1);
 				input_sig = input_sig.extract(0, input_sig.size()-1);
@@ -513,8 +554,9 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 		if (lutptr == NULL && sopcell == NULL)
 			goto error;
 
-		char *input = strtok(buffer, " \t\r\n");
-		char *output = strtok(NULL, " \t\r\n");
+		cursor = buffer;
+		char *input = next_blif_token(cursor);
+		char *output = next_blif_token(cursor);
 
 		if (input == NULL || output == NULL || (strcmp(output, "0") && strcmp(output, "1")))
 			goto error;
@@ -529,16 +571,16 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 			for (int i = 0; i < input_len; i++)
 				switch (input[i]) {
 					case '0':
-						sopcell->parameters["\\TABLE"].bits.push_back(State::S1);
-						sopcell->parameters["\\TABLE"].bits.push_back(State::S0);
+						sopcell->parameters["\\TABLE"].bits().push_back(State::S1);
+						sopcell->parameters["\\TABLE"].bits().push_back(State::S0);
 						break;
 					case '1':
-						sopcell->parameters["\\TABLE"].bits.push_back(State::S0);
-						sopcell->parameters["\\TABLE"].bits.push_back(State::S1);
+						sopcell->parameters["\\TABLE"].bits().push_back(State::S0);
+						sopcell->parameters["\\TABLE"].bits().push_back(State::S1);
 						break;
 					default:
-						sopcell->parameters["\\TABLE"].bits.push_back(State::S0);
-						sopcell->parameters["\\TABLE"].bits.push_back(State::S0);
+						sopcell->parameters["\\TABLE"].bits().push_back(State::S0);
+						sopcell->parameters["\\TABLE"].bits().push_back(State::S0);
 						break;
 				}
 
@@ -568,7 +610,7 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 							goto try_next_value;
 					}
 				}
-				lutptr->bits.at(i) = !strcmp(output, "0") ? RTLIL::State::S0 : RTLIL::State::S1;
+				lutptr->bits().at(i) = !strcmp(output, "0") ? RTLIL::State::S0 : RTLIL::State::S1;
 			try_next_value:;
 			}
 
@@ -584,6 +626,101 @@ error_with_reason:
 	log_error("Syntax error in line %d: %s\n", line_count, err_reason.c_str());
 }
 
+#ifdef YOSYS_ENABLE_THREADS
+// Parses the parts of the input on worker threads, each into a design of its
+// own, and then moves the modules to the target design in file order. Log
+// output is captured per part and replayed in order, like in ModulePass.
+static void parse_blif_parallel(RTLIL::Design *design, const BlifInput &input, const std::vector<const char*> &part_begin,
+		const std::vector<int> &part_line, IdString dff_name, bool run_clean, bool sop_mode, bool wideports, int num_threads)
+{
+	int num_parts = GetSize(part_begin);
+	std::vector<RTLIL::Design*> part_designs(num_parts);
+
+	for (int i = 0; i < num_parts; i++)
+		part_designs[i] = new RTLIL::Design;
+
+	TaskGroup group(std::min(num_threads, num_parts));
+	for (int i = 0; i < num_parts; i++)
+		group.run([&, i]() {
+			BlifInput part = { part_begin[i], i+1 < num_parts ? part_begin[i+1] : input.end };
+			parse_blif_models(part_designs[i], part, part_line[i], dff_name, run_clean, sop_mode, wideports);
+		});
+	group.join();
+
+	for (int i = 0; i < num_parts; i++)
+	{
+		try {
+			group.wait(i);
+		} catch (...) {
+			for (int j = i; j < num_parts; j++)
+				delete part_designs[j];
+			throw;
+		}
+
+		std::vector<RTLIL::Module*> modules;
+		for (auto &it : part_designs[i]->modules_)
+			modules.push_back(it.second);
+		part_designs[i]->modules_.clear();
+		delete part_designs[i];
+
+		for (auto module : modules) {
+			if (design->module(module->name))
+				log_error("Duplicate definition of module %s in line %d!\n", log_id(module->name), part_line[i]+1);
+			module->design = nullptr;
+			design->add(module);
+		}
+	}
+}
+#endif
+
+void parse_blif(RTLIL::Design *design, const char *data, size_t size, IdString dff_name, bool run_clean, bool sop_mode, bool wideports, int num_threads)
+{
+	BlifInput input = { data, data + size };
+
+#ifdef YOSYS_ENABLE_THREADS
+	if (num_threads > 1)
+	{
+		// Split the input at the .model lines. Everything before the second
+		// .model goes to the first part.
+		std::vector<const char*> part_begin;
+		std::vector<int> part_line;
+
+		bool continued = false;
+		int line = 0;
+		for (const char *p = data; p < input.end; line++)
+		{
+			const char *eol = (const char*)memchr(p, '\n', input.end - p);
+
+			if (!continued && input.end - p >= 6 && !memcmp(p, ".model", 6) && (p+6 == input.end || strchr(" \t\r\n", p[6]))) {
+				part_begin.push_back(part_begin.empty() ? data : p);
+				part_line.push_back(part_line.empty() ? 0 : line);
+			}
+
+			const char *last = eol ? eol : input.end;
+			while (last > p && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r'))
+				last--;
+			continued = last > p && last[-1] == '\\';
+			p = eol ? eol+1 : input.end;
+		}
+
+		if (GetSize(part_begin) > 1) {
+			parse_blif_parallel(design, input, part_begin, part_line, dff_name, run_clean, sop_mode, wideports, num_threads);
+			return;
+		}
+	}
+#endif
+
+	parse_blif_models(design, input, 0, dff_name, run_clean, sop_mode, wideports);
+}
+
+void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool run_clean, bool sop_mode, bool wideports, int num_threads)
+{
+	std::stringstream buffer;
+	buffer << f.rdbuf();
+	std::string data = buffer.str();
+	parse_blif(design, data.data(), data.size(), dff_name, run_clean, sop_mode, wideports, num_threads);
+}
+
 struct BlifFrontend : public Frontend {
 	BlifFrontend() : Frontend("blif", "read BLIF file") { }
 	void help() YS_OVERRIDE
@@ -601,11 +738,17 @@ struct BlifFrontend : public Frontend {
 		log("        Merge ports that match the pattern 'name[int]' into a single\n");
 		log("        multi-bit port 'name'.\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        parse the .model blocks of the file concurrently on up to N threads\n");
+		log("\n");
+		log("Regular files are mapped into memory and parsed in place.\n");
+		log("\n");
 	}
 	void execute(std::istream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
 	{
 		bool sop_mode = false;
 		bool wideports = false;
+		int num_threads = 1;
 
 		log_header(design, "Executing BLIF frontend.\n");
 
@@ -620,11 +763,19 @@ struct BlifFrontend : public Frontend {
 				wideports = true;
 				continue;
 			}
+			if (arg == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
 			break;
 		}
 		extra_args(f, filename, args, argidx);
 
-		parse_blif(design, *f, "", true, sop_mode, wideports);
+		MappedFile file;
+		if (filename != "<stdin>" && file.open(filename) && !file.is_compressed())
+			parse_blif(design, file.data, file.size, "", true, sop_mode, wideports, num_threads);
+		else
+			parse_blif(design, *f, "", true, sop_mode, wideports, num_threads);
 	}
 } BlifFrontend;
 
@@ -25,7 +25,12 @@
 YOSYS_NAMESPACE_BEGIN
 
 extern void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name,
-		bool run_clean = false, bool sop_mode = false, bool wideports = false);
+		bool run_clean = false, bool sop_mode = false, bool wideports = false, int num_threads = 1);
+
+// Parses BLIF data from memory. With num_threads > 1, the .model blocks are
+// parsed concurrently.
+extern void parse_blif(RTLIL::Design *design, const char *data, size_t size, IdString dff_name,
+		bool run_clean = false, bool sop_mode = false, bool wideports = false, int num_threads = 1);
 
 YOSYS_NAMESPACE_END
 
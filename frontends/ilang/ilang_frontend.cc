@@ -55,12 +55,29 @@ struct IlangFrontend : public Frontend {
 		log("    -lib\n");
 		log("        only create empty blackbox modules\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        parse the modules of the file concurrently on up to N threads\n");
+		log("\n");
+		log("    -top <module>\n");
+		log("        only load the specified module and the modules it instantiates\n");
+		log("        (directly or indirectly). the other modules are skipped without\n");
+		log("        parsing them, e.g. for looking at one part of a large design. this\n");
+		log("        option can be used multiple times.\n");
+		log("\n");
+		log("    -bison\n");
+		log("        use the old bison-generated parser instead of the hand-written one\n");
+		log("\n");
+		log("Regular files are mapped into memory and parsed in place.\n");
+		log("\n");
 	}
 	void execute(std::istream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
 	{
 		ILANG_FRONTEND::flag_nooverwrite = false;
 		ILANG_FRONTEND::flag_overwrite = false;
 		ILANG_FRONTEND::flag_lib = false;
+		bool flag_bison = false;
+		int num_threads = 1;
+		std::vector<std::string> tops;
 
 		log_header(design, "Executing ILANG frontend.\n");
 
@@ -81,12 +98,40 @@ struct IlangFrontend : public Frontend {
 				ILANG_FRONTEND::flag_lib = true;
 				continue;
 			}
+			if (arg == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
+			if (arg == "-top" && argidx+1 < args.size()) {
+				tops.push_back(args[++argidx]);
+				continue;
+			}
+			if (arg == "-bison") {
+				flag_bison = true;
+				continue;
+			}
 			break;
 		}
 		extra_args(f, filename, args, argidx);
 
 		log("Input filename: %s\n", filename.c_str());
 
+		if (!flag_bison) {
+			MappedFile file;
+			if (filename != "<stdin>" && file.open(filename) && !file.is_compressed()) {
+				ILANG_FRONTEND::read_design(file.data, file.size, design, num_threads, tops);
+			} else {
+				std::stringstream buffer;
+				buffer << f->rdbuf();
+				std::string data = buffer.str();
+				ILANG_FRONTEND::read_design(data.data(), data.size(), design, num_threads, tops);
+			}
+			return;
+		}
+
+		if (!tops.empty())
+			log_cmd_error("Option -top is not supported with -bison.\n");
+
 		ILANG_FRONTEND::lexin = f;
 		ILANG_FRONTEND::current_design = design;
 		rtlil_frontend_ilang_yydebug = false;
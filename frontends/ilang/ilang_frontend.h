@@ -35,6 +35,12 @@ namespace ILANG_FRONTEND {
 	extern bool flag_nooverwrite;
 	extern bool flag_overwrite;
 	extern bool flag_lib;
+
+	// hand-written parser, used unless read_ilang is called with -bison. with
+	// a non-empty list of top modules only these modules and the modules they
+	// use (directly or indirectly) are parsed, the others are skipped.
+	void read_design(const char *data, size_t size, RTLIL::Design *design, int num_threads,
+			const std::vector<std::string> &tops = std::vector<std::string>());
 }
 
 YOSYS_NAMESPACE_END
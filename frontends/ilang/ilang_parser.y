@@ -160,7 +160,7 @@ attr_stmt:
 
 autoidx_stmt:
 	TOK_AUTOIDX TOK_INT EOL {
-		autoidx = max(autoidx, $2);
+		autoidx = max(autoidx.load(), $2);
 	};
 
 wire_stmt:
@@ -382,7 +382,7 @@ constant:
 	TOK_VALUE {
 		char *ep;
 		int width = strtol($1, &ep, 10);
-		std::list<RTLIL::State> bits;
+		std::vector<RTLIL::State> bits;
 		while (*(++ep) != 0) {
 			RTLIL::State bit = RTLIL::Sx;
 			switch (*ep) {
@@ -393,7 +393,7 @@ constant:
 			case '-': bit = RTLIL::Sa; break;
 			case 'm': bit = RTLIL::Sm; break;
 			}
-			bits.push_front(bit);
+			bits.insert(bits.begin(), bit);
 		}
 		if (bits.size() == 0)
 			bits.push_back(RTLIL::Sx);
@@ -405,9 +405,7 @@ constant:
 		}
 		while ((int)bits.size() > width)
 			bits.pop_back();
-		$$ = new RTLIL::Const;
-		for (auto it = bits.begin(); it != bits.end(); it++)
-			$$->bits.push_back(*it);
+		$$ = new RTLIL::Const(bits);
 		free($1);
 	} |
 	TOK_INT {
@@ -0,0 +1,856 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *  ---
+ *
+ *  A hand-written recursive descent parser for the RTLIL text representation
+ *  that reads the same language as the bison/flex parser in this directory.
+ *  The input is first split into modules by looking at the first word of
+ *  each line only, then the modules are parsed (on worker threads if more
+ *  than one thread is used) and added to the design in the order of the file.
+ *
+ */
+
+#include "ilang_frontend.h"
+#include "kernel/threadpool.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+namespace {
+
+enum IlangToken {
+	TOK_EOF, TOK_EOL, TOK_ID, TOK_VALUE, TOK_INT, TOK_STRING, TOK_KEYWORD, TOK_CHAR
+};
+
+enum IlangKeyword {
+	KW_AUTOIDX, KW_MODULE, KW_ATTRIBUTE, KW_PARAMETER, KW_SIGNED, KW_REAL, KW_WIRE, KW_MEMORY,
+	KW_WIDTH, KW_UPTO, KW_OFFSET, KW_SIZE, KW_INPUT, KW_OUTPUT, KW_INOUT, KW_CELL, KW_CONNECT,
+	KW_SWITCH, KW_CASE, KW_ASSIGN, KW_SYNC, KW_LOW, KW_HIGH, KW_POSEDGE, KW_NEGEDGE, KW_EDGE,
+	KW_ALWAYS, KW_GLOBAL, KW_INIT, KW_UPDATE, KW_PROCESS, KW_END, KW_INVALID
+};
+
+const char *ilang_keywords[] = {
+	"autoidx", "module", "attribute", "parameter", "signed", "real", "wire", "memory",
+	"width", "upto", "offset", "size", "input", "output", "inout", "cell", "connect",
+	"switch", "case", "assign", "sync", "low", "high", "posedge", "negedge", "edge",
+	"always", "global", "init", "update", "process", "end"
+};
+
+struct IlangLexer
+{
+	const char *p, *end;
+	int line;
+
+	// the current token, str holds the text of identifiers, values and strings
+	IlangToken type = TOK_EOF;
+	IlangKeyword keyword = KW_INVALID;
+	int integer = 0;
+	char ch = 0;
+	std::string str;
+
+	IlangLexer(const char *begin, const char *end, int line) : p(begin), end(end), line(line) { }
+
+	void error(const std::string &message)
+	{
+		log_error("Parser error in line %d: %s\n", line, message.c_str());
+	}
+
+	static bool is_space(char c) {
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+	}
+
+	void read_string()
+	{
+		str.clear();
+		for (p++; p < end && *p != '"'; p++)
+		{
+			if (*p == '\n')
+				error("unterminated string");
+			if (*p != '\\' || p+1 == end) {
+				str.push_back(*p);
+				continue;
+			}
+			char c = *++p;
+			if (c == 'n')
+				str.push_back('\n');
+			else if (c == 't')
+				str.push_back('\t');
+			else if ('0' <= c && c <= '7') {
+				int value = c - '0';
+				for (int i = 0; i < 2 && p+1 < end && '0' <= p[1] && p[1] <= '7'; i++)
+					value = value * 8 + *++p - '0';
+				str.push_back(char(value));
+			} else
+				str.push_back(c);
+		}
+		if (p == end)
+			error("unterminated string");
+		p++;
+		type = TOK_STRING;
+	}
+
+	void next()
+	{
+		while (p < end && (*p == ' ' || *p == '\t'))
+			p++;
+		if (p < end && *p == '#')
+			while (p < end && *p != '\n' && *p != '\r')
+				p++;
+
+		if (p == end) {
+			type = TOK_EOF;
+			return;
+		}
+
+		const char *q = p;
+		char c = *q;
+
+		if (c == '\r' || c == '\n') {
+			// comments on the following lines are part of the line break
+			while (q < end) {
+				if (*q == '\n')
+					line++;
+				else if (*q != '\r' && *q != ' ' && *q != '\t')
+					break;
+				q++;
+				if (q < end && *q == '#')
+					while (q < end && *q != '\n' && *q != '\r')
+						q++;
+			}
+			p = q;
+			type = TOK_EOL;
+			return;
+		}
+
+		if (c == '\\' || c == '$' || (c == '.' && q+1 < end && '0' <= q[1] && q[1] <= '9')) {
+			while (q < end && !is_space(*q))
+				q++;
+			str.assign(p, q);
+			p = q;
+			type = TOK_ID;
+			return;
+		}
+
+		if (('0' <= c && c <= '9') || (c == '-' && q+1 < end && '0' <= q[1] && q[1] <= '9')) {
+			for (q++; q < end && '0' <= *q && *q <= '9'; q++) { }
+			if (c != '-' && q < end && *q == '\'') {
+				for (q++; q < end && *q != 0 && strchr("01xzm-", *q); q++) { }
+				str.assign(p, q);
+				p = q;
+				type = TOK_VALUE;
+				return;
+			}
+			integer = atoi(std::string(p, q).c_str());
+			p = q;
+			type = TOK_INT;
+			return;
+		}
+
+		if ('a' <= c && c <= 'z') {
+			while (q < end && 'a' <= *q && *q <= 'z')
+				q++;
+			keyword = KW_INVALID;
+			size_t len = q - p;
+			for (int i = 0; i < int(KW_INVALID); i++)
+				if (strlen(ilang_keywords[i]) == len && !strncmp(ilang_keywords[i], p, len)) {
+					keyword = IlangKeyword(i);
+					break;
+				}
+			p = q;
+			type = TOK_KEYWORD;
+			return;
+		}
+
+		if (c == '"') {
+			read_string();
+			return;
+		}
+
+		ch = c;
+		p++;
+		type = TOK_CHAR;
+	}
+
+	bool is_keyword(IlangKeyword kw) const {
+		return type == TOK_KEYWORD && keyword == kw;
+	}
+
+	bool is_char(char c) const {
+		return type == TOK_CHAR && ch == c;
+	}
+
+	void syntax_error() {
+		error("syntax error");
+	}
+
+	void expect_keyword(IlangKeyword kw) {
+		if (!is_keyword(kw))
+			syntax_error();
+		next();
+	}
+
+	void expect_char(char c) {
+		if (!is_char(c))
+			syntax_error();
+		next();
+	}
+
+	RTLIL::IdString expect_id() {
+		if (type != TOK_ID)
+			syntax_error();
+		RTLIL::IdString id = str;
+		next();
+		return id;
+	}
+
+	int expect_int() {
+		if (type != TOK_INT)
+			syntax_error();
+		int value = integer;
+		next();
+		return value;
+	}
+
+	// the end of the input is accepted as end of the last line
+	void expect_eol() {
+		if (type == TOK_EOF)
+			return;
+		if (type != TOK_EOL)
+			syntax_error();
+		next();
+	}
+};
+
+struct IlangModuleJob
+{
+	const char *begin, *end;
+	int line;
+	RTLIL::IdString name;
+	pool<RTLIL::IdString> cell_types;
+	dict<RTLIL::IdString, RTLIL::Const> attributes;
+	RTLIL::Module *module = nullptr;
+};
+
+struct IlangParser
+{
+	IlangLexer lex;
+	RTLIL::Module *module = nullptr;
+	RTLIL::Process *process = nullptr;
+	dict<RTLIL::IdString, RTLIL::Const> attrbuf;
+
+	IlangParser(const char *begin, const char *end, int line) : lex(begin, end, line) { }
+
+	void check_dangling_attributes() {
+		if (!attrbuf.empty())
+			lex.error("dangling attribute");
+	}
+
+	RTLIL::Const parse_constant()
+	{
+		if (lex.type == TOK_INT) {
+			RTLIL::Const value(lex.integer, 32);
+			lex.next();
+			return value;
+		}
+
+		if (lex.type == TOK_STRING) {
+			RTLIL::Const value(lex.str);
+			lex.next();
+			return value;
+		}
+
+		if (lex.type != TOK_VALUE)
+			lex.syntax_error();
+
+		size_t quote = lex.str.find('\'');
+		int width = atoi(lex.str.substr(0, quote).c_str());
+		int n = GetSize(lex.str) - int(quote) - 1;
+
+		// the digits are given MSB first, missing bits are filled with the
+		// most significant one, except for 1 which is extended with 0
+		std::vector<RTLIL::State> bits;
+		bits.reserve(std::max(width, n));
+		for (int i = 0; i < n; i++) {
+			RTLIL::State bit = RTLIL::Sx;
+			switch (lex.str[lex.str.size() - 1 - i]) {
+			case '0': bit = RTLIL::S0; break;
+			case '1': bit = RTLIL::S1; break;
+			case 'x': bit = RTLIL::Sx; break;
+			case 'z': bit = RTLIL::Sz; break;
+			case '-': bit = RTLIL::Sa; break;
+			case 'm': bit = RTLIL::Sm; break;
+			}
+			bits.push_back(bit);
+		}
+		if (bits.empty())
+			bits.push_back(RTLIL::Sx);
+		RTLIL::State fill = bits.back() == RTLIL::S1 ? RTLIL::S0 : bits.back();
+		if (GetSize(bits) < width)
+			bits.resize(width, fill);
+		if (GetSize(bits) > width)
+			bits.resize(width);
+		lex.next();
+		return RTLIL::Const(std::move(bits));
+	}
+
+	RTLIL::SigSpec parse_sigspec()
+	{
+		RTLIL::SigSpec sig;
+		RTLIL::Wire *wire = nullptr;
+
+		if (lex.type == TOK_ID) {
+			auto it = module->wires_.find(lex.str);
+			if (it == module->wires_.end())
+				lex.error(stringf("ilang error: wire %s not found", lex.str.c_str()));
+			wire = it->second;
+			sig = RTLIL::SigSpec(wire);
+			lex.next();
+		} else if (lex.is_char('{')) {
+			lex.next();
+			std::vector<RTLIL::SigSpec> parts;
+			while (!lex.is_char('}'))
+				parts.push_back(parse_sigspec());
+			lex.next();
+			for (auto it = parts.rbegin(); it != parts.rend(); ++it)
+				sig.append(*it);
+		} else {
+			sig = parse_constant();
+		}
+
+		while (lex.is_char('['))
+		{
+			lex.next();
+			int msb = lex.expect_int();
+			if (lex.is_char(']')) {
+				if (msb >= GetSize(sig) || msb < 0)
+					lex.error("bit index out of range");
+				lex.next();
+				// slice the wire directly, extract() unpacks the whole signal
+				sig = wire ? RTLIL::SigSpec(wire, msb, 1) : sig.extract(msb);
+				wire = nullptr;
+				continue;
+			}
+			lex.expect_char(':');
+			int lsb = lex.expect_int();
+			lex.expect_char(']');
+			if (msb >= GetSize(sig) || msb < 0 || lsb < 0 || msb < lsb)
+				lex.error("invalid slice");
+			sig = wire ? RTLIL::SigSpec(wire, lsb, msb - lsb + 1) : sig.extract(lsb, msb - lsb + 1);
+			wire = nullptr;
+		}
+
+		return sig;
+	}
+
+	void parse_attribute()
+	{
+		lex.next();
+		RTLIL::IdString name = lex.expect_id();
+		attrbuf[name] = parse_constant();
+		lex.expect_eol();
+	}
+
+	void parse_wire()
+	{
+		lex.next();
+
+		int width = 1, start_offset = 0, port_id = 0;
+		bool upto = false, port_input = false, port_output = false;
+		while (lex.type == TOK_KEYWORD)
+		{
+			IlangKeyword kw = lex.keyword;
+			lex.next();
+			switch (kw) {
+			case KW_WIDTH:
+				width = lex.expect_int();
+				break;
+			case KW_UPTO:
+				upto = true;
+				break;
+			case KW_OFFSET:
+				start_offset = lex.expect_int();
+				break;
+			case KW_INPUT:
+			case KW_OUTPUT:
+			case KW_INOUT:
+				port_id = lex.expect_int();
+				port_input = kw != KW_OUTPUT;
+				port_output = kw != KW_INPUT;
+				break;
+			default:
+				lex.syntax_error();
+			}
+		}
+
+		if (lex.type != TOK_ID)
+			lex.syntax_error();
+		if (module->wires_.count(lex.str) != 0)
+			lex.error(stringf("ilang error: redefinition of wire %s.", lex.str.c_str()));
+
+		RTLIL::Wire *wire = module->addWire(lex.str, width);
+		wire->start_offset = start_offset;
+		wire->upto = upto;
+		wire->port_id = port_id;
+		wire->port_input = port_input;
+		wire->port_output = port_output;
+		wire->attributes.swap(attrbuf);
+		attrbuf.clear();
+
+		lex.next();
+		lex.expect_eol();
+	}
+
+	void parse_memory()
+	{
+		lex.next();
+
+		RTLIL::Memory *memory = new RTLIL::Memory;
+		memory->attributes.swap(attrbuf);
+		attrbuf.clear();
+
+		while (lex.type == TOK_KEYWORD)
+		{
+			IlangKeyword kw = lex.keyword;
+			lex.next();
+			switch (kw) {
+			case KW_WIDTH:
+				memory->width = lex.expect_int();
+				break;
+			case KW_SIZE:
+				memory->size = lex.expect_int();
+				break;
+			case KW_OFFSET:
+				memory->start_offset = lex.expect_int();
+				break;
+			default:
+				lex.syntax_error();
+			}
+		}
+
+		if (lex.type != TOK_ID)
+			lex.syntax_error();
+		if (module->memories.count(lex.str) != 0)
+			lex.error(stringf("ilang error: redefinition of memory %s.", lex.str.c_str()));
+		memory->name = lex.str;
+		module->memories[memory->name] = memory;
+
+		lex.next();
+		lex.expect_eol();
+	}
+
+	void parse_cell()
+	{
+		lex.next();
+		RTLIL::IdString type = lex.expect_id();
+		if (lex.type != TOK_ID)
+			lex.syntax_error();
+		if (module->cells_.count(lex.str) != 0)
+			lex.error(stringf("ilang error: redefinition of cell %s.", lex.str.c_str()));
+		RTLIL::Cell *cell = module->addCell(lex.str, type);
+		cell->attributes.swap(attrbuf);
+		attrbuf.clear();
+		lex.next();
+		lex.expect_eol();
+
+		while (!lex.is_keyword(KW_END))
+		{
+			if (lex.is_keyword(KW_PARAMETER)) {
+				lex.next();
+				int flags = 0;
+				if (lex.is_keyword(KW_SIGNED)) {
+					flags = RTLIL::CONST_FLAG_SIGNED;
+					lex.next();
+				} else if (lex.is_keyword(KW_REAL)) {
+					flags = RTLIL::CONST_FLAG_REAL;
+					lex.next();
+				}
+				RTLIL::IdString name = lex.expect_id();
+				RTLIL::Const &value = cell->parameters[name];
+				value = parse_constant();
+				value.flags |= flags;
+				value.intern();
+				lex.expect_eol();
+				continue;
+			}
+			if (lex.is_keyword(KW_CONNECT)) {
+				lex.next();
+				RTLIL::IdString port = lex.expect_id();
+				if (cell->hasPort(port))
+					lex.error(stringf("ilang error: redefinition of cell port %s.", port.c_str()));
+				cell->setPort(port, parse_sigspec());
+				lex.expect_eol();
+				continue;
+			}
+			lex.syntax_error();
+		}
+		lex.next();
+		lex.expect_eol();
+	}
+
+	void parse_switch(std::vector<RTLIL::SwitchRule*> &switches)
+	{
+		lex.next();
+		RTLIL::SwitchRule *rule = new RTLIL::SwitchRule;
+		switches.push_back(rule);
+		rule->signal = parse_sigspec();
+		rule->attributes.swap(attrbuf);
+		attrbuf.clear();
+		lex.expect_eol();
+
+		while (lex.is_keyword(KW_ATTRIBUTE))
+			parse_attribute();
+
+		while (lex.is_keyword(KW_CASE))
+		{
+			lex.next();
+			RTLIL::CaseRule *case_rule = new RTLIL::CaseRule;
+			rule->cases.push_back(case_rule);
+			case_rule->attributes.swap(attrbuf);
+			attrbuf.clear();
+			if (lex.type != TOK_EOL && lex.type != TOK_EOF) {
+				case_rule->compare.push_back(parse_sigspec());
+				while (lex.is_char(',')) {
+					lex.next();
+					case_rule->compare.push_back(parse_sigspec());
+				}
+			}
+			lex.expect_eol();
+			parse_case_body(case_rule);
+		}
+
+		lex.expect_keyword(KW_END);
+		lex.expect_eol();
+	}
+
+	void parse_case_body(RTLIL::CaseRule *case_rule)
+	{
+		while (1)
+		{
+			if (lex.is_keyword(KW_ATTRIBUTE)) {
+				parse_attribute();
+				continue;
+			}
+			if (lex.is_keyword(KW_SWITCH)) {
+				parse_switch(case_rule->switches);
+				continue;
+			}
+			if (lex.is_keyword(KW_ASSIGN)) {
+				check_dangling_attributes();
+				lex.next();
+				RTLIL::SigSpec lhs = parse_sigspec();
+				RTLIL::SigSpec rhs = parse_sigspec();
+				case_rule->actions.push_back(RTLIL::SigSig(std::move(lhs), std::move(rhs)));
+				lex.expect_eol();
+				continue;
+			}
+			break;
+		}
+	}
+
+	void parse_process()
+	{
+		lex.next();
+		if (lex.type != TOK_ID)
+			lex.syntax_error();
+		if (module->processes.count(lex.str) != 0)
+			lex.error(stringf("ilang error: redefinition of process %s.", lex.str.c_str()));
+		process = new RTLIL::Process;
+		process->name = lex.str;
+		process->attributes.swap(attrbuf);
+		attrbuf.clear();
+		module->processes[process->name] = process;
+		lex.next();
+		lex.expect_eol();
+
+		parse_case_body(&process->root_case);
+
+		while (lex.is_keyword(KW_SYNC))
+		{
+			lex.next();
+			RTLIL::SyncRule *rule = new RTLIL::SyncRule;
+			process->syncs.push_back(rule);
+
+			IlangKeyword kw = lex.type == TOK_KEYWORD ? lex.keyword : KW_INVALID;
+			switch (kw) {
+			case KW_LOW: rule->type = RTLIL::ST0; break;
+			case KW_HIGH: rule->type = RTLIL::ST1; break;
+			case KW_POSEDGE: rule->type = RTLIL::STp; break;
+			case KW_NEGEDGE: rule->type = RTLIL::STn; break;
+			case KW_EDGE: rule->type = RTLIL::STe; break;
+			case KW_ALWAYS: rule->type = RTLIL::STa; break;
+			case KW_GLOBAL: rule->type = RTLIL::STg; break;
+			case KW_INIT: rule->type = RTLIL::STi; break;
+			default: lex.syntax_error();
+			}
+			lex.next();
+			if (kw != KW_ALWAYS && kw != KW_GLOBAL && kw != KW_INIT)
+				rule->signal = parse_sigspec();
+			lex.expect_eol();
+
+			while (lex.is_keyword(KW_UPDATE)) {
+				lex.next();
+				RTLIL::SigSpec lhs = parse_sigspec();
+				RTLIL::SigSpec rhs = parse_sigspec();
+				rule->actions.push_back(RTLIL::SigSig(std::move(lhs), std::move(rhs)));
+				lex.expect_eol();
+			}
+		}
+
+		lex.expect_keyword(KW_END);
+		lex.expect_eol();
+		process = nullptr;
+	}
+
+	void parse_module(IlangModuleJob &job)
+	{
+		lex.next();
+		lex.expect_keyword(KW_MODULE);
+		if (lex.type != TOK_ID)
+			lex.syntax_error();
+
+		module = new RTLIL::Module;
+		module->name = lex.str;
+		module->attributes.swap(job.attributes);
+		job.module = module;
+		lex.next();
+		lex.expect_eol();
+
+		while (!lex.is_keyword(KW_END))
+		{
+			if (lex.type != TOK_KEYWORD)
+				lex.syntax_error();
+
+			switch (lex.keyword) {
+			case KW_ATTRIBUTE:
+				parse_attribute();
+				break;
+			case KW_PARAMETER:
+				lex.next();
+				module->avail_parameters.insert(lex.expect_id());
+				lex.expect_eol();
+				break;
+			case KW_WIRE:
+				parse_wire();
+				break;
+			case KW_MEMORY:
+				parse_memory();
+				break;
+			case KW_CELL:
+				parse_cell();
+				break;
+			case KW_PROCESS:
+				parse_process();
+				break;
+			case KW_CONNECT: {
+				check_dangling_attributes();
+				lex.next();
+				RTLIL::SigSpec lhs = parse_sigspec();
+				RTLIL::SigSpec rhs = parse_sigspec();
+				module->connect(lhs, rhs);
+				lex.expect_eol();
+				break;
+			}
+			default:
+				lex.syntax_error();
+			}
+		}
+
+		check_dangling_attributes();
+		lex.next();
+		lex.expect_eol();
+		if (lex.type != TOK_EOF)
+			lex.syntax_error();
+
+		module->fixup_ports();
+	}
+};
+
+// Returns the end of the module that starts at p: the end of the line with
+// the 'end' that closes it. Only the first word of each line is looked at,
+// which is enough as strings can not span lines. The types of the cells are
+// added to cell_types if it is not null.
+const char *find_module_end(const char *p, const char *end, int &lines, pool<RTLIL::IdString> *cell_types)
+{
+	int depth = 0;
+	while (p < end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t'))
+			p++;
+		const char *word = p;
+		while (p < end && 'a' <= *p && *p <= 'z')
+			p++;
+		size_t len = p - word;
+
+		if ((len == 6 && (!strncmp(word, "module", 6) || !strncmp(word, "switch", 6))) ||
+				(len == 4 && !strncmp(word, "cell", 4)) || (len == 7 && !strncmp(word, "process", 7)))
+			depth++;
+		else if (len == 3 && !strncmp(word, "end", 3))
+			depth--;
+
+		if (cell_types != nullptr && len == 4 && !strncmp(word, "cell", 4)) {
+			while (p < end && (*p == ' ' || *p == '\t'))
+				p++;
+			const char *type = p;
+			while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+				p++;
+			if (p > type && (*type == '\\' || *type == '$'))
+				cell_types->insert(std::string(type, p));
+		}
+
+		while (p < end && *p != '\n')
+			p++;
+		if (p < end) {
+			p++;
+			lines++;
+		}
+		if (depth <= 0)
+			break;
+	}
+	return p;
+}
+
+void add_module(RTLIL::Design *design, RTLIL::Module *module, int line)
+{
+	bool delete_module = false;
+
+	if (design->has(module->name)) {
+		RTLIL::Module *existing_mod = design->module(module->name);
+		if (!ILANG_FRONTEND::flag_overwrite && (ILANG_FRONTEND::flag_lib || module->get_bool_attribute("\\blackbox"))) {
+			log("Ignoring blackbox re-definition of module %s.\n", module->name.c_str());
+			delete_module = true;
+		} else if (!ILANG_FRONTEND::flag_nooverwrite && !ILANG_FRONTEND::flag_overwrite && !existing_mod->get_bool_attribute("\\blackbox")) {
+			log_error("Parser error in line %d: ilang error: redefinition of module %s.\n", line, module->name.c_str());
+		} else if (ILANG_FRONTEND::flag_nooverwrite) {
+			log("Ignoring re-definition of module %s.\n", module->name.c_str());
+			delete_module = true;
+		} else {
+			log("Replacing existing%s module %s.\n", existing_mod->get_bool_attribute("\\blackbox") ? " blackbox" : "", module->name.c_str());
+			design->remove(existing_mod);
+		}
+	}
+
+	if (delete_module) {
+		delete module;
+		return;
+	}
+
+	design->add(module);
+	if (ILANG_FRONTEND::flag_lib)
+		module->makeblackbox();
+}
+
+}
+
+void ILANG_FRONTEND::read_design(const char *data, size_t size, RTLIL::Design *design, int num_threads, const std::vector<std::string> &tops)
+{
+	const char *end = data + size;
+	std::vector<IlangModuleJob> jobs;
+
+	// the statements outside of modules, module bodies are skipped
+	IlangParser top(data, end, 1);
+	IlangLexer &lex = top.lex;
+	lex.next();
+	if (lex.type == TOK_EOL)
+		lex.next();
+
+	while (lex.type != TOK_EOF)
+	{
+		if (lex.is_keyword(KW_ATTRIBUTE)) {
+			top.parse_attribute();
+			continue;
+		}
+		if (lex.is_keyword(KW_AUTOIDX)) {
+			lex.next();
+			int value = lex.expect_int();
+			autoidx = max(autoidx.load(), value);
+			lex.expect_eol();
+			continue;
+		}
+		if (!lex.is_keyword(KW_MODULE))
+			lex.syntax_error();
+
+		// the keyword is at the start of its line
+		const char *begin = lex.p - 6;
+		while (begin > data && begin[-1] != '\n')
+			begin--;
+
+		IlangModuleJob job;
+		job.begin = begin;
+		job.line = lex.line;
+		job.attributes.swap(top.attrbuf);
+		top.attrbuf.clear();
+		if (!tops.empty()) {
+			lex.next();
+			if (lex.type != TOK_ID)
+				lex.syntax_error();
+			job.name = lex.str;
+		}
+		job.end = find_module_end(begin, end, lex.line, tops.empty() ? nullptr : &job.cell_types);
+		jobs.push_back(std::move(job));
+
+		lex.p = jobs.back().end;
+		lex.next();
+		if (lex.type == TOK_EOL)
+			lex.next();
+	}
+	top.check_dangling_attributes();
+
+	// only parse the modules that are used by the top modules, the others
+	// have only been scanned for their end and their cell types
+	if (!tops.empty())
+	{
+		dict<RTLIL::IdString, std::vector<int>> jobs_by_name;
+		for (int i = 0; i < GetSize(jobs); i++)
+			jobs_by_name[jobs[i].name].push_back(i);
+
+		pool<RTLIL::IdString> used;
+		std::vector<RTLIL::IdString> queue;
+		for (auto &name : tops) {
+			RTLIL::IdString id = RTLIL::escape_id(name);
+			if (!jobs_by_name.count(id))
+				log_error("Module %s not found in the input.\n", log_id(id));
+			if (used.insert(id).second)
+				queue.push_back(id);
+		}
+		while (!queue.empty()) {
+			RTLIL::IdString id = queue.back();
+			queue.pop_back();
+			for (int i : jobs_by_name.at(id))
+				for (auto &type : jobs[i].cell_types)
+					if (jobs_by_name.count(type) && used.insert(type).second)
+						queue.push_back(type);
+		}
+
+		std::vector<IlangModuleJob> used_jobs;
+		for (auto &job : jobs)
+			if (used.count(job.name))
+				used_jobs.push_back(std::move(job));
+		log("Loading %d of %d modules, the others are not used by the top module%s.\n",
+				GetSize(used_jobs), GetSize(jobs), GetSize(tops) > 1 ? "s" : "");
+		jobs.swap(used_jobs);
+	}
+
+	for_each_ordered(GetSize(jobs), num_threads, [&](int i) {
+		IlangParser parser(jobs[i].begin, jobs[i].end, jobs[i].line);
+		parser.parse_module(jobs[i]);
+	}, [&](int i) {
+		add_module(design, jobs[i].module, jobs[i].line);
+		jobs[i].module = nullptr;
+	});
+}
+
+YOSYS_NAMESPACE_END
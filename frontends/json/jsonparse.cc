@@ -21,6 +21,50 @@
 
 YOSYS_NAMESPACE_BEGIN
 
+// Buffered character source for the JSON parser, std::istream::get() is
+// comparatively expensive when called for every character of a large netlist.
+struct JsonReader
+{
+	std::istream &f;
+	char buffer[64*1024];
+	size_t buffer_pos = 0, buffer_len = 0;
+
+	JsonReader(std::istream &f) : f(f) { }
+
+	int get()
+	{
+		if (buffer_pos == buffer_len) {
+			f.read(buffer, sizeof(buffer));
+			buffer_len = f.gcount();
+			buffer_pos = 0;
+			if (buffer_len == 0)
+				return EOF;
+		}
+		return (unsigned char)buffer[buffer_pos++];
+	}
+
+	void unget()
+	{
+		log_assert(buffer_pos > 0);
+		buffer_pos--;
+	}
+
+	// skip whitespace and the given separator characters, returns the next
+	// character without consuming it
+	int peek_after(const char *separators)
+	{
+		while (1) {
+			int ch = get();
+			if (ch == EOF)
+				log_error("Unexpected EOF in JSON file.\n");
+			if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' || strchr(separators, ch) != nullptr)
+				continue;
+			unget();
+			return ch;
+		}
+	}
+};
+
 struct JsonNode
 {
 	char type; // S=String, N=Number, A=Array, D=Dict
@@ -30,7 +74,7 @@ struct JsonNode
 	dict<string, JsonNode*> data_dict;
 	vector<string> data_dict_keys;
 
-	JsonNode(std::istream &f)
+	JsonNode(JsonReader &f)
 	{
 		type = 0;
 		data_number = 0;
@@ -521,12 +565,65 @@ void json_import(Design *design, string &modname, JsonNode *node)
 			if (cell_node->data_dict.count("attributes"))
 				json_parse_attr_param(cell->attributes, cell_node->data_dict.at("attributes"));
 
-			if (cell_node->data_dict.count("parameters"))
+			if (cell_node->data_dict.count("parameters")) {
 				json_parse_attr_param(cell->parameters, cell_node->data_dict.at("parameters"));
+				for (auto &it : cell->parameters)
+					it.second.intern();
+			}
 		}
 	}
 }
 
+// Imports the top modules and the modules they use (directly or indirectly),
+// the trees of the other modules are only looked at for the types of their
+// cells. Frees all trees.
+void json_import_used(Design *design, std::vector<std::pair<string, JsonNode*>> &modules, const std::vector<string> &tops)
+{
+	dict<IdString, std::vector<int>> modules_by_name;
+	for (int i = 0; i < GetSize(modules); i++)
+		modules_by_name[RTLIL::escape_id(modules[i].first)].push_back(i);
+
+	pool<IdString> used;
+	std::vector<IdString> queue;
+	for (auto &name : tops) {
+		IdString id = RTLIL::escape_id(name);
+		if (!modules_by_name.count(id))
+			log_error("Module %s not found in the input.\n", log_id(id));
+		if (used.insert(id).second)
+			queue.push_back(id);
+	}
+
+	while (!queue.empty()) {
+		IdString id = queue.back();
+		queue.pop_back();
+		for (int i : modules_by_name.at(id)) {
+			JsonNode *node = modules[i].second;
+			if (node->data_dict.count("cells") == 0 || node->data_dict.at("cells")->type != 'D')
+				continue;
+			for (auto &cell_it : node->data_dict.at("cells")->data_dict) {
+				JsonNode *cell_node = cell_it.second;
+				if (cell_node->type != 'D' || cell_node->data_dict.count("type") == 0 || cell_node->data_dict.at("type")->type != 'S')
+					continue;
+				IdString type = RTLIL::escape_id(cell_node->data_dict.at("type")->data_string);
+				if (modules_by_name.count(type) && used.insert(type).second)
+					queue.push_back(type);
+			}
+		}
+	}
+
+	int count = 0;
+	for (auto &it : modules) {
+		if (used.count(RTLIL::escape_id(it.first))) {
+			json_import(design, it.first, it.second);
+			count++;
+		}
+		delete it.second;
+		it.second = nullptr;
+	}
+	log("Imported %d of %d modules, the others are not used by the top module%s.\n",
+			count, GetSize(modules), GetSize(tops) > 1 ? "s" : "");
+}
+
 struct JsonFrontend : public Frontend {
 	JsonFrontend() : Frontend("json", "read JSON file") { }
 	void help() YS_OVERRIDE
@@ -538,37 +635,78 @@ struct JsonFrontend : public Frontend {
 		log("Load modules from a JSON file into the current design See \"help write_json\"\n");
 		log("for a description of the file format.\n");
 		log("\n");
+		log("    -top <module>\n");
+		log("        only import the specified module and the modules it instantiates\n");
+		log("        (directly or indirectly). the file is still parsed completely, but no\n");
+		log("        RTLIL modules are created for the other modules. this option can be\n");
+		log("        used multiple times.\n");
+		log("\n");
 	}
 	void execute(std::istream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
 	{
 		log_header(design, "Executing JSON frontend.\n");
 
+		std::vector<std::string> tops;
+
 		size_t argidx;
 		for (argidx = 1; argidx < args.size(); argidx++) {
-			// std::string arg = args[argidx];
-			// if (arg == "-sop") {
-			// 	sop_mode = true;
-			// 	continue;
-			// }
+			std::string arg = args[argidx];
+			if (arg == "-top" && argidx+1 < args.size()) {
+				tops.push_back(args[++argidx]);
+				continue;
+			}
 			break;
 		}
 		extra_args(f, filename, args, argidx);
 
-		JsonNode root(*f);
+		// The root dictionary and the "modules" dictionary are read key by key, and
+		// each module is imported and freed before the next one is parsed, so that
+		// only the JsonNode tree of one module is in memory at a time. With -top
+		// the trees are kept until the end of the file, when it is known which
+		// modules are used.
+		JsonReader reader(*f);
+		std::vector<std::pair<string, JsonNode*>> deferred_modules;
 
-		if (root.type != 'D')
+		if (reader.peek_after("") != '{')
 			log_error("JSON root node is not a dictionary.\n");
+		reader.get();
 
-		if (root.data_dict.count("modules") != 0)
+		while (reader.peek_after(",") != '}')
 		{
-			JsonNode *modules = root.data_dict.at("modules");
+			JsonNode key(reader);
+			if (key.type != 'S')
+				log_error("Unexpected non-string key in JSON dict.\n");
+			reader.peek_after(":");
+
+			if (key.data_string != "modules") {
+				JsonNode value(reader);
+				continue;
+			}
 
-			if (modules->type != 'D')
+			if (reader.peek_after("") != '{')
 				log_error("JSON modules node is not a dictionary.\n");
+			reader.get();
 
-			for (auto &it : modules->data_dict)
-				json_import(design, it.first, it.second);
+			while (reader.peek_after(",") != '}')
+			{
+				JsonNode modname(reader);
+				if (modname.type != 'S')
+					log_error("Unexpected non-string key in JSON dict.\n");
+				reader.peek_after(":");
+
+				if (!tops.empty()) {
+					deferred_modules.push_back(std::make_pair(modname.data_string, new JsonNode(reader)));
+					continue;
+				}
+
+				JsonNode module(reader);
+				json_import(design, modname.data_string, &module);
+			}
+			reader.get();
 		}
+
+		if (!tops.empty())
+			json_import_used(design, deferred_modules, tops);
 	}
 } JsonFrontend;
 
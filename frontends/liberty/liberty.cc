@@ -535,13 +535,22 @@ struct LibertyFrontend : public Frontend {
 		}
 		extra_args(f, filename, args, argidx);
 
-		LibertyParser parser(*f);
+		// files are parsed once per session and shared with dfflibmap and stat,
+		// only stdin and gzip compressed files are parsed from the stream
+		LibertyAst *libast = nullptr;
+		std::unique_ptr<LibertyParser> parser;
+		if (filename != "<stdin>")
+			libast = LibertyAstCache::instance.cached_ast(filename);
+		if (libast == nullptr) {
+			parser.reset(new LibertyParser(*f));
+			libast = parser->ast;
+		}
 		int cell_count = 0;
 
 		std::map<std::string, std::tuple<int, int, bool>> global_type_map;
-		parse_type_map(global_type_map, parser.ast);
+		parse_type_map(global_type_map, libast);
 
-		for (auto cell : parser.ast->children)
+		for (auto cell : libast->children)
 		{
 			if (cell->id != "cell" || cell->args.size() != 1)
 				continue;
@@ -0,0 +1,273 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/wire_format_lite.h>
+
+#include "kernel/yosys.h"
+#include "backends/protobuf/yosys.pb.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+using google::protobuf::internal::WireFormatLite;
+
+struct ProtobufImporter
+{
+	RTLIL::Design *design;
+	RTLIL::Module *module;
+	dict<int64_t, RTLIL::SigBit> signal_bits;
+
+	ProtobufImporter(RTLIL::Design *design) : design(design), module(nullptr) { }
+
+	static RTLIL::Const import_value(const yosys::pb::Parameter &param)
+	{
+		// same convention as the JSON frontend: strings of 0/1/x/z digits are
+		// bit vectors, other strings are string values
+		if (param.value_case() == yosys::pb::Parameter::kStr) {
+			const std::string &s = param.str();
+			if (s.find_first_not_of("01xz") == std::string::npos)
+				return RTLIL::Const::from_string(s);
+			return RTLIL::Const(s);
+		}
+
+		RTLIL::Const value(param.int_(), 32);
+		if (param.int_() < 0)
+			value.flags |= RTLIL::CONST_FLAG_SIGNED;
+		return value;
+	}
+
+	static void import_values(dict<RTLIL::IdString, RTLIL::Const> &results,
+			const google::protobuf::Map<std::string, yosys::pb::Parameter> &params)
+	{
+		for (auto &it : params)
+			results[RTLIL::escape_id(it.first)] = import_value(it.second);
+	}
+
+	RTLIL::SigBit import_bit(const yosys::pb::Signal &signal)
+	{
+		if (signal.type_case() == yosys::pb::Signal::kConstant) {
+			switch (signal.constant()) {
+				case yosys::pb::Signal::CONSTANT_DRIVER_LOW: return State::S0;
+				case yosys::pb::Signal::CONSTANT_DRIVER_HIGH: return State::S1;
+				case yosys::pb::Signal::CONSTANT_DRIVER_Z: return State::Sz;
+				default: return State::Sx;
+			}
+		}
+
+		auto it = signal_bits.find(signal.id());
+		if (it != signal_bits.end())
+			return it->second;
+
+		// a signal without a (selected) net
+		RTLIL::SigBit bit = module->addWire(NEW_ID);
+		signal_bits[signal.id()] = bit;
+		return bit;
+	}
+
+	RTLIL::SigSpec import_bits(const yosys::pb::BitVector &bits)
+	{
+		RTLIL::SigSpec sig;
+		for (auto &signal : bits.signal())
+			sig.append(import_bit(signal));
+		return sig;
+	}
+
+	// The first wire that carries a signal represents it, all other wires
+	// carrying the same signal are connected to that one.
+	RTLIL::Wire *import_wire(RTLIL::IdString name, const yosys::pb::BitVector &bits)
+	{
+		RTLIL::Wire *wire = module->addWire(name, bits.signal_size());
+
+		for (int i = 0; i < bits.signal_size(); i++) {
+			const yosys::pb::Signal &signal = bits.signal(i);
+			if (signal.type_case() == yosys::pb::Signal::kId && signal_bits.count(signal.id()) == 0)
+				signal_bits[signal.id()] = RTLIL::SigBit(wire, i);
+			else
+				module->connect(RTLIL::SigBit(wire, i), import_bit(signal));
+		}
+
+		return wire;
+	}
+
+	void import_module(const std::string &name, const yosys::pb::Module &pb_mod)
+	{
+		log("Importing module %s from protobuf.\n", RTLIL::unescape_id(name).c_str());
+
+		if (design->module(RTLIL::escape_id(name)))
+			log_error("Re-definition of module %s.\n", RTLIL::unescape_id(name).c_str());
+
+		module = design->addModule(RTLIL::escape_id(name));
+		signal_bits.clear();
+
+		import_values(module->attributes, pb_mod.attribute());
+
+		// ports first, so that they represent their signals
+		std::vector<std::pair<int64_t, std::string>> port_order;
+		for (auto &it : pb_mod.port())
+			port_order.push_back(std::make_pair(it.second.position() > 0 ? it.second.position() : INT64_MAX, it.first));
+		std::sort(port_order.begin(), port_order.end());
+
+		for (int i = 0; i < GetSize(port_order); i++) {
+			const yosys::pb::Module::Port &pb_port = pb_mod.port().at(port_order[i].second);
+			RTLIL::Wire *wire = import_wire(RTLIL::escape_id(port_order[i].second), pb_port.bits());
+			wire->port_id = i + 1;
+			wire->port_input = pb_port.direction() == yosys::pb::DIRECTION_INPUT || pb_port.direction() == yosys::pb::DIRECTION_INOUT;
+			wire->port_output = pb_port.direction() == yosys::pb::DIRECTION_OUTPUT || pb_port.direction() == yosys::pb::DIRECTION_INOUT;
+		}
+
+		for (auto &netname : pb_mod.netname()) {
+			RTLIL::Wire *wire = nullptr;
+			if (netname.name().empty())
+				wire = import_wire(NEW_ID, netname.bits());
+			else if (pb_mod.port().count(netname.name()))
+				wire = module->wire(RTLIL::escape_id(netname.name()));
+			else
+				wire = import_wire(RTLIL::escape_id(netname.name()), netname.bits());
+			import_values(wire->attributes, netname.attributes());
+		}
+
+		// the order of map entries is not defined, sort by name for a
+		// deterministic result
+		std::vector<const std::string*> cell_names;
+		cell_names.reserve(pb_mod.cell_size());
+		for (auto &it : pb_mod.cell())
+			cell_names.push_back(&it.first);
+		std::sort(cell_names.begin(), cell_names.end(), [](const std::string *a, const std::string *b) { return *a < *b; });
+
+		for (auto cell_name : cell_names) {
+			const yosys::pb::Module::Cell &pb_cell = pb_mod.cell().at(*cell_name);
+			RTLIL::Cell *cell = module->addCell(RTLIL::escape_id(*cell_name), RTLIL::escape_id(pb_cell.type()));
+			import_values(cell->parameters, pb_cell.parameter());
+			import_values(cell->attributes, pb_cell.attribute());
+			for (auto &conn : pb_cell.connection())
+				cell->setPort(RTLIL::escape_id(conn.first), import_bits(conn.second));
+		}
+
+		module->fixup_ports();
+		module = nullptr;
+	}
+
+	void read_error(const std::string &filename)
+	{
+		log_error("Can't parse protobuf file `%s'.\n", filename.c_str());
+	}
+
+	// Reads the top-level fields of the Design message one by one, and each
+	// module into an arena that is dropped after the module is imported. This
+	// way only one module is held in memory as a protobuf message, and the file
+	// may be larger than the protobuf message size limit of 2GB.
+	void read_design(std::istream *f, const std::string &filename)
+	{
+		GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+		google::protobuf::io::IstreamInputStream zero_copy_stream(f);
+
+		while (true)
+		{
+			google::protobuf::io::CodedInputStream in(&zero_copy_stream);
+
+			uint32_t tag = in.ReadTag();
+			if (tag == 0)
+				break;
+
+			int field_number = WireFormatLite::GetTagFieldNumber(tag);
+
+			if (field_number == 1 && WireFormatLite::GetTagWireType(tag) == WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+				std::string creator;
+				if (!WireFormatLite::ReadString(&in, &creator))
+					read_error(filename);
+				log("Creator: %s\n", creator.c_str());
+				continue;
+			}
+
+			if (field_number != 2 || WireFormatLite::GetTagWireType(tag) != WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+				// AIG models and unknown fields
+				if (!WireFormatLite::SkipField(&in, tag))
+					read_error(filename);
+				continue;
+			}
+
+			uint32_t entry_size;
+			if (!in.ReadVarint32(&entry_size))
+				read_error(filename);
+			auto entry_limit = in.PushLimit(entry_size);
+
+			google::protobuf::Arena arena;
+			auto pb_mod = google::protobuf::Arena::CreateMessage<yosys::pb::Module>(&arena);
+			std::string name;
+
+			while ((tag = in.ReadTag()) != 0) {
+				if (tag == WireFormatLite::MakeTag(1, WireFormatLite::WIRETYPE_LENGTH_DELIMITED)) {
+					if (!WireFormatLite::ReadString(&in, &name))
+						read_error(filename);
+				} else if (tag == WireFormatLite::MakeTag(2, WireFormatLite::WIRETYPE_LENGTH_DELIMITED)) {
+					uint32_t module_size;
+					if (!in.ReadVarint32(&module_size))
+						read_error(filename);
+					auto module_limit = in.PushLimit(module_size);
+					if (!pb_mod->ParseFromCodedStream(&in) || !in.ConsumedEntireMessage())
+						read_error(filename);
+					in.PopLimit(module_limit);
+				} else if (!WireFormatLite::SkipField(&in, tag))
+					read_error(filename);
+			}
+
+			if (!in.ConsumedEntireMessage())
+				read_error(filename);
+			in.PopLimit(entry_limit);
+
+			import_module(name, *pb_mod);
+		}
+	}
+};
+
+struct ProtobufFrontend : public Frontend {
+	ProtobufFrontend() : Frontend("protobuf", "read design from a Protocol Buffer file") { }
+	void help() YS_OVERRIDE
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    read_protobuf [filename]\n");
+		log("\n");
+		log("Load modules from a binary Protocol Buffer file, as written by 'write_protobuf'\n");
+		log("(see misc/yosys.proto for the schema).\n");
+		log("\n");
+		log("The file is read one module at a time. Each module must be below the 2GB size\n");
+		log("limit of protobuf messages, but the file as a whole may be larger.\n");
+		log("\n");
+		log("Integer parameter and attribute values are imported as 32 bit constants, and\n");
+		log("strings consisting only of 0, 1, x and z as bit vectors. AIG models are\n");
+		log("ignored. Files written by older versions of Yosys do not contain net names\n");
+		log("and the order of ports, the ports are then sorted by name.\n");
+		log("\n");
+	}
+	void execute(std::istream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
+	{
+		log_header(design, "Executing Protobuf frontend.\n");
+
+		size_t argidx = 1;
+		extra_args(f, filename, args, argidx, true);
+
+		ProtobufImporter importer(design);
+		importer.read_design(f, filename);
+	}
+} ProtobufFrontend;
+
+YOSYS_NAMESPACE_END
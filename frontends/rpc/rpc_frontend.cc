@@ -115,7 +115,8 @@ struct RpcServer {
 		return modules;
 	}
 
-	std::pair<std::string, std::string> derive_module(const std::string &module, const dict<RTLIL::IdString, RTLIL::Const> &parameters) {
+	// returns the frontend and either the source or the name of a file to read
+	std::tuple<std::string, std::string, std::string> derive_module(const std::string &module, const dict<RTLIL::IdString, RTLIL::Const> &parameters) {
 		Json::object json_parameters;
 		for (auto &param : parameters) {
 			std::string type, value;
@@ -141,16 +142,18 @@ struct RpcServer {
 			{ "parameters", json_parameters },
 		});
 		bool is_valid = true;
-		std::string frontend, source;
+		std::string frontend, source, file;
 		if (response["frontend"].is_string())
 			frontend = response["frontend"].string_value();
 		else is_valid = false;
-		if (response["source"].is_string())
+		if (response["source"].is_string() && response["file"].is_null())
 			source = response["source"].string_value();
+		else if (response["file"].is_string() && response["source"].is_null())
+			file = response["file"].string_value();
 		else is_valid = false;
 		if (!is_valid)
 			log_cmd_error("RPC frontend returned malformed response: %s\n", response.dump().c_str());
-		return std::make_pair(frontend, source);
+		return std::make_tuple(frontend, source, file);
 	}
 };
 
@@ -182,12 +185,18 @@ struct RpcModule : RTLIL::Module {
 		if (design->has(derived_name)) {
 			log("Found cached RTLIL representation for module `%s'.\n", derived_name.c_str());
 		} else {
-			std::string command, input;
-			std::tie(command, input) = server->derive_module(stripped_name.substr(1), parameters);
+			std::string command, input, file;
+			std::tie(command, input, file) = server->derive_module(stripped_name.substr(1), parameters);
 
-			std::istringstream input_stream(input);
 			RTLIL::Design *derived_design = new RTLIL::Design;
-			Frontend::frontend_call(derived_design, &input_stream, "<rpc>" + derived_name.substr(8), command);
+			if (file.empty()) {
+				std::istringstream input_stream(input);
+				Frontend::frontend_call(derived_design, &input_stream, "<rpc>" + derived_name.substr(8), command);
+			} else {
+				if (file == "-")
+					log_cmd_error("RPC frontend returned `-' as file name.\n");
+				Frontend::frontend_call(derived_design, nullptr, file, command);
+			}
 			derived_design->check();
 
 			dict<std::string, std::string> name_mangling;
@@ -387,6 +396,13 @@ struct RpcFrontend : public Pass {
 		log("        convenient representation of the module. the derived module is cached,\n");
 		log("        so the response should be the same whenever the same set of parameters\n");
 		log("        is provided.\n");
+		log("\n");
+		log("    <- {\"frontend\": \"[rtlil_bin|ilang|...]\", \"file\": \"<path>\"}\n");
+		log("        instead of the source, the frontend may return the name of a file for\n");
+		log("        <frontend> to read. for large modules, a binary RTLIL file (as written\n");
+		log("        by 'write_rtlil_bin') is the fastest choice: it is mapped into memory\n");
+		log("        and read without any text parsing. placing it on a memory-backed file\n");
+		log("        system (such as /dev/shm) avoids disk I/O. the file is not removed.\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
 	{
@@ -0,0 +1,76 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *
+ *  ---
+ *
+ *  Frontend for the binary RTLIL format written by 'write_rtlil_bin'.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "backends/rtlil_bin/rtlil_bin.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+struct RtlilBinFrontend : public Frontend {
+	RtlilBinFrontend() : Frontend("rtlil_bin", "read binary RTLIL file") { }
+	void help() YS_OVERRIDE
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    read_rtlil_bin [filename]\n");
+		log("\n");
+		log("Load modules from a binary RTLIL file (as written by 'write_rtlil_bin') into\n");
+		log("the current design. Regular files are mapped into memory and read in place.\n");
+		log("\n");
+		log("    -overwrite\n");
+		log("        replace modules that already exist in the design (default: error\n");
+		log("        on re-definition of a module)\n");
+		log("\n");
+	}
+	void execute(std::istream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
+	{
+		bool overwrite = false;
+
+		log_header(design, "Executing binary RTLIL frontend.\n");
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++) {
+			std::string arg = args[argidx];
+			if (arg == "-overwrite") {
+				overwrite = true;
+				continue;
+			}
+			break;
+		}
+		extra_args(f, filename, args, argidx, true);
+
+		log("Input filename: %s\n", filename.c_str());
+
+		if (filename != "<stdin>" && RTLIL_BIN::read_file(filename, design, overwrite))
+			return;
+
+		// stdin, gzip compressed files and platforms without mmap()
+		std::stringstream buffer;
+		buffer << f->rdbuf();
+		std::string data = buffer.str();
+		RTLIL_BIN::read_design(data.data(), data.size(), design, overwrite);
+	}
+} RtlilBinFrontend;
+
+YOSYS_NAMESPACE_END
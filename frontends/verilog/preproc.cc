@@ -37,45 +37,73 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 
 YOSYS_NAMESPACE_BEGIN
 using namespace VERILOG_FRONTEND;
 
-static std::list<std::string> output_code;
-static std::list<std::string> input_buffer;
+static std::string output_code;
+static std::string input_buffer;
 static size_t input_buffer_charp;
 
-static void return_char(char ch)
+// Unread input is input_buffer[input_buffer_charp...]. Input inserted in front
+// of the read position (macro expansions, returned characters, included files)
+// reuses the already consumed space before input_buffer_charp when it fits.
+
+struct IncludeFile
 {
-	if (input_buffer_charp == 0)
-		input_buffer.push_front(std::string() + ch);
-	else
-		input_buffer.front()[--input_buffer_charp] = ch;
+	int64_t size = -1;
+	time_t mtime = 0;
+	std::string content;
+	std::string guard;
+};
+
+static dict<std::string, IncludeFile> include_file_cache;
+
+static inline bool is_ident_char(char ch)
+{
+	return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') || ch == '_' || ch == '$';
+}
+
+static bool input_buffer_empty()
+{
+	return input_buffer_charp >= input_buffer.size();
 }
 
-static void insert_input(std::string str)
+static void insert_input(const std::string &str)
 {
-	if (input_buffer_charp != 0) {
-		input_buffer.front() = input_buffer.front().substr(input_buffer_charp);
-		input_buffer_charp = 0;
+	if (str.size() <= input_buffer_charp) {
+		input_buffer_charp -= str.size();
+		input_buffer.replace(input_buffer_charp, str.size(), str);
+		return;
 	}
-	input_buffer.push_front(str);
+
+	size_t gap = 4096;
+	std::string buffer;
+	buffer.reserve(gap + str.size() + input_buffer.size() - input_buffer_charp);
+	buffer.append(gap, ' ');
+	buffer += str;
+	buffer.append(input_buffer, input_buffer_charp, std::string::npos);
+	input_buffer.swap(buffer);
+	input_buffer_charp = gap;
+}
+
+static void return_char(char ch)
+{
+	if (input_buffer_charp == 0)
+		insert_input(std::string(1, ch));
+	else
+		input_buffer[--input_buffer_charp] = ch;
 }
 
 static char next_char()
 {
-	if (input_buffer.empty())
-		return 0;
-
-	log_assert(input_buffer_charp <= input_buffer.front().size());
-	if (input_buffer_charp == input_buffer.front().size()) {
-		input_buffer_charp = 0;
-		input_buffer.pop_front();
-		return next_char();
+	while (input_buffer_charp < input_buffer.size()) {
+		char ch = input_buffer[input_buffer_charp++];
+		if (ch != '\r')
+			return ch;
 	}
-
-	char ch = input_buffer.front()[input_buffer_charp++];
-	return ch == '\r' ? next_char() : ch;
+	return 0;
 }
 
 static std::string skip_spaces()
@@ -105,7 +133,7 @@ static std::string next_token(bool pass_newline = false)
 	token += ch;
 	if (ch == '\n') {
 		if (pass_newline) {
-			output_code.push_back(token);
+			output_code += token;
 			return "";
 		}
 		return token;
@@ -178,41 +206,142 @@ static std::string next_token(bool pass_newline = false)
 				return_char(ch);
 		}
 	}
-	else
+	else if (ch == '`' || is_ident_char(ch))
 	{
-		const char *ok = "abcdefghijklmnopqrstuvwxyz_ABCDEFGHIJKLMNOPQRSTUVWXYZ$0123456789";
-		if (ch == '`' || strchr(ok, ch) != NULL)
-		{
-			char first = ch;
-			ch = next_char();
-			if (first == '`' && (ch == '"' || ch == '`')) {
-				token += ch;
-			} else do {
-					if (strchr(ok, ch) == NULL) {
+		char first = ch;
+		ch = next_char();
+		if (first == '`' && (ch == '"' || ch == '`')) {
+			token += ch;
+		} else do {
+				if (!is_ident_char(ch)) {
+					if (ch != 0)
 						return_char(ch);
-						break;
-					}
-					token += ch;
-				} while ((ch = next_char()) != 0);
-		}
+					break;
+				}
+				token += ch;
+				// copy the rest of the identifier from the buffer in one go
+				size_t end = input_buffer_charp;
+				while (end < input_buffer.size() && is_ident_char(input_buffer[end]))
+					end++;
+				token.append(input_buffer, input_buffer_charp, end - input_buffer_charp);
+				input_buffer_charp = end;
+			} while ((ch = next_char()) != 0);
 	}
 	return token;
 }
 
-static void input_file(std::istream &f, std::string filename)
+static void input_file(const std::string &content, const std::string &filename)
 {
-	char buffer[513];
+	insert_input("`file_push \"" + filename + "\"\n" + content + "\n`file_pop\n");
+}
+
+static std::string read_file(std::istream &f)
+{
+	char buffer[4096];
 	int rc;
 
-	insert_input("");
-	auto it = input_buffer.begin();
+	std::string content;
+	while ((rc = readsome(f, buffer, sizeof(buffer))) > 0)
+		content.append(buffer, rc);
+
+	// next_char() skips all '\r' characters, remove them up front
+	content.erase(std::remove(content.begin(), content.end(), '\r'), content.end());
+	return content;
+}
+
+static size_t skip_spaces_and_comments(const std::string &content, size_t i)
+{
+	while (i < content.size()) {
+		char ch = content[i];
+		if (ch == ' ' || ch == '\t' || ch == '\n') {
+			i++;
+		} else if (content.compare(i, 2, "//") == 0) {
+			i = content.find('\n', i);
+			if (i == std::string::npos)
+				return content.size();
+		} else if (content.compare(i, 2, "/*") == 0) {
+			i = content.find("*/", i+2);
+			if (i == std::string::npos)
+				return content.size();
+			i += 2;
+		} else
+			break;
+	}
+	return i;
+}
 
-	input_buffer.insert(it, "`file_push \"" + filename + "\"\n");
-	while ((rc = readsome(f, buffer, sizeof(buffer)-1)) > 0) {
-		buffer[rc] = 0;
-		input_buffer.insert(it, buffer);
+// Returns the name of the macro that guards the whole file when the file is
+// of the form "`ifndef NAME ... `endif" (only whitespace and comments outside
+// of that block, and no `else or `elsif on its level), or "" otherwise. When
+// NAME is defined at an `include of such a file, the preprocessor would skip
+// all of its content, so the file does not need to be inserted at all.
+static std::string find_include_guard(const std::string &content)
+{
+	size_t i = skip_spaces_and_comments(content, 0);
+	if (content.compare(i, 7, "`ifndef") != 0)
+		return "";
+	i += 7;
+	if (i >= content.size() || (content[i] != ' ' && content[i] != '\t'))
+		return "";
+	while (i < content.size() && (content[i] == ' ' || content[i] == '\t'))
+		i++;
+
+	size_t name_begin = i;
+	while (i < content.size() && is_ident_char(content[i]))
+		i++;
+	std::string guard = content.substr(name_begin, i - name_begin);
+	if (guard.empty())
+		return "";
+
+	int depth = 0;
+	while (i < content.size())
+	{
+		char ch = content[i];
+		if (ch == '"') {
+			size_t begin = i++;
+			while (i < content.size() && content[i] != '"')
+				i += content[i] == '\\' ? 2 : 1;
+			i++;
+			if (i - begin == 2 && i < content.size() && content[i] == '"')
+				i++;
+		} else if (content.compare(i, 2, "//") == 0 || content.compare(i, 2, "/*") == 0) {
+			i = skip_spaces_and_comments(content, i);
+		} else if (ch == '`') {
+			size_t begin = i++;
+			if (i < content.size() && (content[i] == '"' || content[i] == '`')) {
+				i++;
+				continue;
+			}
+			while (i < content.size() && is_ident_char(content[i]))
+				i++;
+			std::string directive = content.substr(begin, i - begin);
+			if (directive == "`ifdef" || directive == "`ifndef")
+				depth++;
+			else if ((directive == "`else" || directive == "`elsif") && depth == 0)
+				return "";
+			else if (directive == "`endif" && depth-- == 0)
+				return skip_spaces_and_comments(content, i) == content.size() ? guard : "";
+		} else
+			i++;
 	}
-	input_buffer.insert(it, "\n`file_pop\n");
+	return "";
+}
+
+static const IncludeFile &read_include_file(std::istream &f, const std::string &filename)
+{
+	struct stat st;
+	bool stat_ok = stat(filename.c_str(), &st) == 0;
+
+	auto it = include_file_cache.find(filename);
+	if (stat_ok && it != include_file_cache.end() && it->second.size == int64_t(st.st_size) && it->second.mtime == st.st_mtime)
+		return it->second;
+
+	IncludeFile &file = include_file_cache[filename];
+	file.size = stat_ok ? int64_t(st.st_size) : -1;
+	file.mtime = stat_ok ? st.st_mtime : 0;
+	file.content = read_file(f);
+	file.guard = find_include_guard(file.content);
+	return file;
 }
 
 
@@ -224,7 +353,7 @@ static bool try_expand_macro(std::set<std::string> &defines_with_args,
 	if (tok == "`\"") {
 		std::string literal("\"");
 		// Expand string literal
-		while (!input_buffer.empty()) {
+		while (!input_buffer_empty()) {
 			std::string ntok = next_token();
 			if (ntok == "`\"") {
 				insert_input(literal+"\"");
@@ -285,7 +414,7 @@ std::string frontend_verilog_preproc(std::istream &f, std::string filename, cons
 	input_buffer.clear();
 	input_buffer_charp = 0;
 
-	input_file(f, filename);
+	input_file(read_file(f), filename);
 
 	defines_map["YOSYS"] = "1";
 	defines_map[formal_mode ? "FORMAL" : "SYNTHESIS"] = "1";
@@ -299,7 +428,7 @@ std::string frontend_verilog_preproc(std::istream &f, std::string filename, cons
 		defines_map[it.first] = it.second.first;
 	}
 
-	while (!input_buffer.empty())
+	while (!input_buffer_empty())
 	{
 		std::string tok = next_token();
 		// printf("token: >>%s<<\n", tok != "\n" ? tok.c_str() : "NEWLINE");
@@ -348,7 +477,7 @@ std::string frontend_verilog_preproc(std::istream &f, std::string filename, cons
 
 		if (ifdef_fail_level > 0) {
 			if (tok == "\n")
-				output_code.push_back(tok);
+				output_code += tok;
 			continue;
 		}
 
@@ -406,9 +535,14 @@ std::string frontend_verilog_preproc(std::istream &f, std::string filename, cons
 				}
 			}
 			if (ff.fail()) {
-				output_code.push_back("`file_notfound " + fn);
+				output_code += "`file_notfound " + fn;
 			} else {
-				input_file(ff, fixed_fn);
+				// included files are read once and kept in include_file_cache (until they
+				// change on disk), files with an include guard that is already defined are
+				// skipped without inserting their content
+				const IncludeFile &inc = read_include_file(ff, fixed_fn);
+				if (inc.guard.empty() || defines_map.count(inc.guard) == 0)
+					input_file(inc.content, fixed_fn);
 				yosys_input_files.insert(fixed_fn);
 			}
 			continue;
@@ -419,14 +553,14 @@ std::string frontend_verilog_preproc(std::istream &f, std::string filename, cons
 			std::string fn = next_token(true);
 			if (!fn.empty() && fn.front() == '"' && fn.back() == '"')
 				fn = fn.substr(1, fn.size()-2);
-			output_code.push_back(tok + " \"" + fn + "\"");
+			output_code += tok + " \"" + fn + "\"";
 			filename_stack.push_back(filename);
 			filename = fn;
 			continue;
 		}
 
 		if (tok == "`file_pop") {
-			output_code.push_back(tok);
+			output_code += tok;
 			filename = filename_stack.back();
 			filename_stack.pop_back();
 			continue;
@@ -534,14 +668,12 @@ std::string frontend_verilog_preproc(std::istream &f, std::string filename, cons
 		if (try_expand_macro(defines_with_args, defines_map, tok))
 			continue;
 
-		output_code.push_back(tok);
+		output_code += tok;
 	}
 
 	std::string output;
-	for (auto &str : output_code)
-		output += str;
+	output.swap(output_code);
 
-	output_code.clear();
 	input_buffer.clear();
 	input_buffer_charp = 0;
 
@@ -28,9 +28,17 @@
 
 #include "verilog_frontend.h"
 #include "kernel/yosys.h"
+#include "backends/rtlil_bin/rtlil_bin.h"
 #include "libs/sha1/sha1.h"
 #include <stdarg.h>
 
+#ifndef _WIN32
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
 YOSYS_NAMESPACE_BEGIN
 using namespace VERILOG_FRONTEND;
 
@@ -39,6 +47,43 @@ using namespace VERILOG_FRONTEND;
 static std::vector<std::string> verilog_defaults;
 static std::list<std::vector<std::string>> verilog_defaults_stack;
 
+// a read-only mapping of an input file, so the lexer can read it without
+// copying it into a stream buffer first (used with -nopp)
+struct MappedInputFile
+{
+	void *data = nullptr;
+	size_t size = 0;
+
+	bool map(const std::string &filename)
+	{
+#ifndef _WIN32
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+			void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p != MAP_FAILED) {
+				data = p;
+				size = st.st_size;
+			}
+		}
+		close(fd);
+#else
+		(void)filename;
+#endif
+		return data != nullptr;
+	}
+
+	~MappedInputFile()
+	{
+#ifndef _WIN32
+		if (data != nullptr)
+			munmap(data, size);
+#endif
+	}
+};
+
 static void error_on_dpi_function(AST::AstNode *node)
 {
 	if (node->type == AST::AST_DPI_FUNCTION)
@@ -47,6 +92,65 @@ static void error_on_dpi_function(AST::AstNode *node)
 		error_on_dpi_function(child);
 }
 
+// name of the file in the library cache directory for the given preprocessed input
+static std::string lib_cache_filename(const std::string &lib_cache, const std::string &filename,
+		const std::vector<std::string> &args, size_t argidx, const std::string &code)
+{
+	std::string buf = stringf("%s\n%s\n", yosys_version_str, filename.c_str());
+	for (size_t i = 1; i < argidx; i++)
+		buf += args[i] + "\n";
+	buf += code;
+	return lib_cache + "/" + sha1(buf) + ".yrb";
+}
+
+static bool load_lib_cache(RTLIL::Design *design, const std::string &filename)
+{
+	if (!check_file_exists(filename))
+		return false;
+
+	RTLIL::Design *cache_design = new RTLIL::Design;
+	if (!RTLIL_BIN::read_file(filename, cache_design)) {
+		delete cache_design;
+		return false;
+	}
+
+	// modules that already exist in the design need the re-definition handling of AST::process()
+	for (auto mod : cache_design->modules())
+		if (design->module(mod->name) != nullptr) {
+			delete cache_design;
+			return false;
+		}
+
+	std::vector<RTLIL::Module*> modules = cache_design->modules();
+	for (auto mod : modules) {
+		cache_design->modules_.erase(mod->name);
+		design->add(mod);
+	}
+	delete cache_design;
+
+	log("Loaded %d modules from library cache file `%s'.\n", GetSize(modules), filename.c_str());
+	return true;
+}
+
+static void save_lib_cache(const std::vector<RTLIL::Module*> &modules, const std::string &filename)
+{
+	RTLIL::Design *cache_design = new RTLIL::Design;
+	for (auto mod : modules)
+		cache_design->add(mod->clone());
+
+	// write to a temporary file first, so that concurrent runs never see a partial file
+	std::string tmp_filename = make_temp_file(filename.substr(0, filename.rfind('/')) + "/yosys_lib_XXXXXX");
+	std::ofstream f(tmp_filename.c_str(), std::ios::binary);
+	RTLIL_BIN::write_design(f, cache_design);
+	f.close();
+	delete cache_design;
+
+	if (f.fail() || rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+		log_warning("Can't write library cache file `%s'.\n", filename.c_str());
+		remove(tmp_filename.c_str());
+	}
+}
+
 struct VerilogFrontend : public Frontend {
 	VerilogFrontend() : Frontend("verilog", "read modules from Verilog file") { }
 	void help() YS_OVERRIDE
@@ -190,6 +294,41 @@ struct VerilogFrontend : public Frontend {
 		log("    -setattr <attribute_name>\n");
 		log("        set the specified attribute (to the value 1) on all loaded modules\n");
 		log("\n");
+		log("    -derive_cache <dir>\n");
+		log("        store the RTLIL representation of parametric modules derived by\n");
+		log("        the 'hierarchy' command in the given (existing) directory and reuse\n");
+		log("        it in later runs. The files are named after the SHA1 hash of the\n");
+		log("        module AST with the parameter values, the frontend options and the\n");
+		log("        Yosys version. Modules that use $readmemh/$readmemb or DPI functions\n");
+		log("        are not cached.\n");
+		log("\n");
+		log("    -lib_cache <dir>\n");
+		log("        together with -lib: store the blackbox modules read from the file\n");
+		log("        in the given (existing) directory and load them from there in later\n");
+		log("        runs instead of parsing the file again. The files are named after the\n");
+		log("        SHA1 hash of the preprocessed input, the file name, the frontend\n");
+		log("        options and the Yosys version. Files are only cached when reading\n");
+		log("        them adds one new module for each module in the file and none of\n");
+		log("        them needs to be derived by 'hierarchy'. Use 'verilog_defaults -add\n");
+		log("        -lib_cache <dir>' to enable the cache for the library files read by\n");
+		log("        the synth_* scripts.\n");
+		log("\n");
+		log("    -netlist\n");
+		log("        read modules that only contain port and wire declarations, continuous\n");
+		log("        assignments and module instances (e.g. gate-level netlists) directly\n");
+		log("        to RTLIL, without creating an AST for them. Only constant bit and part\n");
+		log("        selects, concatenations and constants are supported in expressions.\n");
+		log("        All other modules, and all modules after global declarations, are read\n");
+		log("        as usual. This has no effect together with -lib, -defer or the dump\n");
+		log("        options, or for files with includes, `default_nettype directives or\n");
+		log("        (synopsys|synthesis) comments.\n");
+		log("\n");
+		log("    -j <N>\n");
+		log("        when more than one file is given, read up to N of the following\n");
+		log("        files into memory on worker threads while the current file is\n");
+		log("        preprocessed and parsed. The files are still parsed one after the\n");
+		log("        other, in the order given on the command line.\n");
+		log("\n");
 		log("    -Dname[=definition]\n");
 		log("        define the preprocessor symbol 'name' and set its optional value\n");
 		log("        'definition'\n");
@@ -237,6 +376,10 @@ struct VerilogFrontend : public Frontend {
 		bool flag_defer = false;
 		bool flag_noblackbox = false;
 		bool flag_nowb = false;
+		bool flag_netlist = false;
+		int prefetch_files = 0;
+		std::string derive_cache;
+		std::string lib_cache;
 		std::map<std::string, std::string> defines_map;
 		std::list<std::string> include_dirs;
 		std::list<std::string> attributes;
@@ -398,6 +541,30 @@ struct VerilogFrontend : public Frontend {
 				attributes.push_back(RTLIL::escape_id(args[++argidx]));
 				continue;
 			}
+			if (arg == "-derive_cache" && argidx+1 < args.size()) {
+				derive_cache = args[++argidx];
+				if (derive_cache.size() > 1 && derive_cache.back() == '/')
+					derive_cache.pop_back();
+				if (!check_file_exists(derive_cache))
+					log_cmd_error("Derive cache directory `%s' does not exist.\n", derive_cache.c_str());
+				continue;
+			}
+			if (arg == "-lib_cache" && argidx+1 < args.size()) {
+				lib_cache = args[++argidx];
+				if (lib_cache.size() > 1 && lib_cache.back() == '/')
+					lib_cache.pop_back();
+				if (!check_file_exists(lib_cache))
+					log_cmd_error("Library cache directory `%s' does not exist.\n", lib_cache.c_str());
+				continue;
+			}
+			if (arg == "-netlist") {
+				flag_netlist = true;
+				continue;
+			}
+			if (arg == "-j" && argidx+1 < args.size()) {
+				prefetch_files = atoi(args[++argidx].c_str());
+				continue;
+			}
 			if (arg == "-D" && argidx+1 < args.size()) {
 				std::string name = args[++argidx], value;
 				size_t equal = name.find('=');
@@ -429,6 +596,9 @@ struct VerilogFrontend : public Frontend {
 		}
 		extra_args(f, filename, args, argidx);
 
+		if (prefetch_files > 0 && GetSize(next_args) > int(argidx))
+			prefetch_input_files(std::vector<std::string>(next_args.begin()+argidx, next_args.end()), prefetch_files);
+
 		log_header(design, "Executing Verilog-2005 frontend: %s\n", filename.c_str());
 
 		log("Parsing %s%s input from `%s' to AST representation.\n",
@@ -441,19 +611,62 @@ struct VerilogFrontend : public Frontend {
 		current_ast = new AST::AstNode(AST::AST_DESIGN);
 
 		lexin = f;
+		lexin_buffer = NULL;
+		lexin_buffer_size = 0;
+		lexin_buffer_pos = 0;
+
 		std::string code_after_preproc;
+		MappedInputFile mapped_input;
 
 		if (!flag_nopp) {
 			code_after_preproc = frontend_verilog_preproc(*f, filename, defines_map, design->verilog_defines, include_dirs);
 			if (flag_ppdump)
 				log("-- Verilog code after preprocessor --\n%s-- END OF DUMP --\n", code_after_preproc.c_str());
-			lexin = new std::istringstream(code_after_preproc);
+			lexin_buffer = code_after_preproc.data();
+			lexin_buffer_size = code_after_preproc.size();
+		} else if (dynamic_cast<std::ifstream*>(f) != nullptr && mapped_input.map(filename)) {
+			// plain files (not compressed, prefetched or here documents)
+			lexin_buffer = (const char*)mapped_input.data;
+			lexin_buffer_size = mapped_input.size;
+		}
+
+		std::string cache_filename;
+		if (!lib_cache.empty() && lib_mode && !flag_nopp && !flag_defer && !flag_dump_ast1 && !flag_dump_ast2 &&
+				!flag_dump_vlog1 && !flag_dump_vlog2 && !flag_dump_rtlil)
+			cache_filename = lib_cache_filename(lib_cache, filename, args, argidx, code_after_preproc);
+
+		if (!cache_filename.empty() && load_lib_cache(design, cache_filename)) {
+			lexin_buffer = NULL;
+			delete current_ast;
+			current_ast = NULL;
+			log("Successfully finished Verilog frontend.\n");
+			return;
+		}
+
+		std::string netlist_rest;
+		if (flag_netlist && !lib_mode && !flag_defer && !flag_dump_ast1 && !flag_dump_ast2 && !flag_dump_vlog1 && !flag_dump_vlog2 &&
+				!flag_dump_rtlil && design->verilog_globals.empty() && design->verilog_packages.empty())
+		{
+			if (lexin_buffer == NULL) {
+				code_after_preproc.assign(std::istreambuf_iterator<char>(*f), std::istreambuf_iterator<char>());
+				lexin_buffer = code_after_preproc.data();
+				lexin_buffer_size = code_after_preproc.size();
+			}
+			int num_netlist_modules = read_verilog_netlist(design, lexin_buffer, lexin_buffer_size, filename,
+					netlist_rest, attributes, flag_icells, default_nettype_wire);
+			if (num_netlist_modules >= 0) {
+				log("Read %d structural modules without AST, %s.\n", num_netlist_modules,
+						netlist_rest.empty() ? "nothing left to parse" : "parsing the rest of the file");
+				lexin_buffer = netlist_rest.data();
+				lexin_buffer_size = netlist_rest.size();
+			}
 		}
 
 		frontend_verilog_yyset_lineno(1);
 		frontend_verilog_yyrestart(NULL);
 		frontend_verilog_yyparse();
 		frontend_verilog_yylex_destroy();
+		lexin_buffer = NULL;
 
 		for (auto &child : current_ast->children) {
 			if (child->type == AST::AST_MODULE)
@@ -465,11 +678,40 @@ struct VerilogFrontend : public Frontend {
 		if (flag_nodpi)
 			error_on_dpi_function(current_ast);
 
-		AST::process(design, current_ast, flag_dump_ast1, flag_dump_ast2, flag_no_dump_ptr, flag_dump_vlog1, flag_dump_vlog2, flag_dump_rtlil, flag_nolatches,
-				flag_nomeminit, flag_nomem2reg, flag_mem2reg, flag_noblackbox, lib_mode, flag_nowb, flag_noopt, flag_icells, flag_pwires, flag_nooverwrite, flag_overwrite, flag_defer, default_nettype_wire);
+		int num_ast_modules = 0;
+		pool<RTLIL::Module*> old_modules;
+		size_t old_globals = design->verilog_globals.size(), old_packages = design->verilog_packages.size();
+		if (!cache_filename.empty()) {
+			for (auto child : current_ast->children)
+				if (child->type == AST::AST_MODULE || child->type == AST::AST_INTERFACE)
+					num_ast_modules++;
+			for (auto mod : design->modules())
+				old_modules.insert(mod);
+		}
 
-		if (!flag_nopp)
-			delete lexin;
+		AST::process(design, current_ast, flag_dump_ast1, flag_dump_ast2, flag_no_dump_ptr, flag_dump_vlog1, flag_dump_vlog2, flag_dump_rtlil, flag_nolatches,
+				flag_nomeminit, flag_nomem2reg, flag_mem2reg, flag_noblackbox, lib_mode, flag_nowb, flag_noopt, flag_icells, flag_pwires, flag_nooverwrite, flag_overwrite, flag_defer, default_nettype_wire,
+				derive_cache);
+
+		if (!cache_filename.empty() && design->verilog_globals.size() == old_globals && design->verilog_packages.size() == old_packages)
+		{
+			// only cache the file if it added exactly its own modules and replaced none of the existing ones
+			std::vector<RTLIL::Module*> new_modules;
+			int num_old_modules = 0;
+			bool cacheable = true;
+			for (auto mod : design->modules()) {
+				if (old_modules.count(mod)) {
+					num_old_modules++;
+					continue;
+				}
+				// blackboxes with dynamic ports are derived from their AST by 'hierarchy'
+				if (mod->get_bool_attribute(ID(dynports)) || mod->get_bool_attribute(ID(is_interface)))
+					cacheable = false;
+				new_modules.push_back(mod);
+			}
+			if (cacheable && num_old_modules == GetSize(old_modules) && GetSize(new_modules) == num_ast_modules)
+				save_lib_cache(new_modules, cache_filename);
+		}
 
 		delete current_ast;
 		current_ast = NULL;
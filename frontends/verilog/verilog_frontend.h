@@ -77,6 +77,17 @@ namespace VERILOG_FRONTEND
 
 	// lexer input stream
 	extern std::istream *lexin;
+
+	// lexer input buffer, used instead of lexin when not NULL
+	extern const char *lexin_buffer;
+	extern size_t lexin_buffer_size, lexin_buffer_pos;
+
+	// the fast path for structural netlists (-netlist): adds the modules that can be
+	// converted to RTLIL directly to the design and returns their number, rest is set
+	// to the input that is left for the regular parser. returns -1 and leaves the design
+	// unchanged if the whole input must be read by the regular parser.
+	int read_verilog_netlist(RTLIL::Design *design, const char *data, size_t size, const std::string &filename,
+			std::string &rest, const std::list<std::string> &attributes, bool flag_icells, bool autowire);
 }
 
 // the pre-processor
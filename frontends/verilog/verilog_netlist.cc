@@ -0,0 +1,833 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *  ---
+ *
+ *  A reader for structural Verilog netlists (read_verilog -netlist). Modules
+ *  that only contain port and wire declarations, continuous assignments of
+ *  plain signals and module instances are converted to RTLIL directly,
+ *  without creating an AST. All other modules are left to the regular
+ *  parser.
+ *
+ */
+
+#include "verilog_frontend.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+namespace {
+
+// keywords that must not be read as the cell type of a module instance
+const pool<std::string> &netlist_keywords()
+{
+	static pool<std::string> keywords = {
+		"always", "always_comb", "always_ff", "always_latch", "and", "assert", "assume", "automatic",
+		"begin", "bind", "bit", "buf", "bufif0", "bufif1", "byte", "case", "casex", "casez", "cell",
+		"checker", "class", "cmos", "config", "const", "cover", "deassign", "default", "defparam",
+		"design", "disable", "do", "else", "end", "endcase", "endfunction", "endgenerate",
+		"endmodule", "endspecify", "endtask", "enum", "event", "final", "for", "force", "forever",
+		"fork", "function", "generate", "genvar", "if", "import", "initial", "inout", "input",
+		"int", "integer", "interface", "localparam", "logic", "longint", "macromodule", "module",
+		"nand", "nmos", "nor", "not", "notif0", "notif1", "or", "output", "package", "parameter",
+		"pmos", "posedge", "negedge", "property", "pulldown", "pullup", "rcmos", "real", "realtime",
+		"reg", "release", "repeat", "restrict", "rnmos", "rpmos", "rtran", "rtranif0", "rtranif1",
+		"shortint", "signed", "specify", "specparam", "struct", "supply0", "supply1", "table",
+		"task", "time", "tran", "tranif0", "tranif1", "tri", "tri0", "tri1", "triand", "trior",
+		"trireg", "typedef", "union", "unique", "unsigned", "uwire", "var", "wand", "while", "wire",
+		"wor", "xnor", "xor",
+	};
+	return keywords;
+}
+
+struct NetlistLexer
+{
+	const char *data, *p, *end;
+	int line = 1;
+
+	// set for input the regular lexer treats in a special way (compiler
+	// directives, synopsys/synthesis comments), nothing is read directly then
+	bool unsupported = false;
+
+	// the current token: 'i' identifier, 'n' constant, 's' string, 'A' and
+	// 'Z' attribute begin and end, 'p' other punctuation, 'x' something else
+	// and 0 at the end of the input
+	char type = 0;
+	bool escaped = false;
+	std::string text;
+	const char *tok_begin = nullptr, *tok_end = nullptr;
+	int tok_line = 1;
+
+	NetlistLexer(const char *data, size_t size) : data(data), p(data), end(data + size) { }
+
+	static bool is_id_start(char c) {
+		return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || c == '_' || c == '$';
+	}
+
+	static bool is_id_char(char c) {
+		return is_id_start(c) || ('0' <= c && c <= '9');
+	}
+
+	static bool is_digit(char c) {
+		return '0' <= c && c <= '9';
+	}
+
+	static bool is_space(char c) {
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v';
+	}
+
+	void skip_space()
+	{
+		while (p < end)
+		{
+			if (*p == '\n') {
+				line++;
+				p++;
+				continue;
+			}
+			if (is_space(*p)) {
+				p++;
+				continue;
+			}
+			if (*p == '/' && p+1 < end && p[1] == '/') {
+				while (p < end && *p != '\n')
+					p++;
+				continue;
+			}
+			if (*p == '/' && p+1 < end && p[1] == '*') {
+				const char *q = p + 2;
+				while (q < end && (*q == ' ' || *q == '\t'))
+					q++;
+				if (end - q >= 8 && (!strncmp(q, "synopsys", 8) || !strncmp(q, "synthesis", 8)))
+					unsupported = true;
+				for (p += 2; p < end && !(*p == '*' && p+1 < end && p[1] == '/'); p++)
+					if (*p == '\n')
+						line++;
+				p = std::min(p + 2, end);
+				continue;
+			}
+			if (*p == '`') {
+				// the directives the regular lexer ignores
+				const char *q = p + 1;
+				while (q < end && is_id_char(*q))
+					q++;
+				std::string directive(p, q);
+				if (directive != "`timescale" && directive != "`celldefine" && directive != "`endcelldefine") {
+					unsupported = true;
+					return;
+				}
+				while (p < end && *p != '\n')
+					p++;
+				continue;
+			}
+			break;
+		}
+	}
+
+	void next()
+	{
+		skip_space();
+
+		text.clear();
+		escaped = false;
+		tok_begin = p;
+		tok_line = line;
+
+		if (p == end || unsupported) {
+			type = 0;
+			tok_end = p;
+			return;
+		}
+
+		const char *q = p;
+
+		if (is_id_start(*q)) {
+			while (q < end && is_id_char(*q))
+				q++;
+			type = 'i';
+			// hierarchical names
+			if (q < end && *q == '.' && q+1 < end && is_id_char(q[1])) {
+				while (q < end && (is_id_char(*q) || *q == '.'))
+					q++;
+				type = 'x';
+			}
+			text.assign(p, q);
+		}
+		else if (*q == '\\') {
+			while (q < end && !is_space(*q))
+				q++;
+			type = 'i';
+			escaped = true;
+			text.assign(p, q);
+		}
+		else if (is_digit(*q) || *q == '\'') {
+			// same forms as TOK_CONSTVAL and TOK_REALVAL in the regular lexer
+			const char *r = q;
+			while (r < end && is_digit(*r))
+				r++;
+			while (r < end && (*r == ' ' || *r == '\t'))
+				r++;
+			if (r < end && *r == '\'') {
+				r++;
+				if (r < end && (*r == 's' || *r == 'S'))
+					r++;
+				if (r < end && strchr("bodhBODH", *r))
+					r++;
+				int newlines = 0;
+				while (r < end && is_space(*r))
+					if (*r++ == '\n')
+						newlines++;
+				const char *digits = r;
+				while (r < end && (is_digit(*r) || strchr("abcdefABCDEFzxZX?_", *r)))
+					r++;
+				type = r == digits ? 'x' : 'n';
+				line += newlines;
+				q = r;
+			} else {
+				while (q < end && (is_digit(*q) || *q == '_'))
+					q++;
+				type = 'n';
+				if (q < end && (*q == '.' || *q == 'e' || *q == 'E')) {
+					while (q < end && (is_id_char(*q) || *q == '.' || *q == '+' || *q == '-'))
+						q++;
+					type = 'x';
+				}
+			}
+			text.assign(p, q);
+		}
+		else if (*q == '"') {
+			for (q++; q < end && *q != '"' && *q != '\\' && *q != '\n'; q++) { }
+			type = q < end && *q == '"' ? 's' : 'x';
+			text.assign(p+1, q);
+			if (q < end)
+				q++;
+		}
+		else if (*q == '(' && q+1 < end && q[1] == '*' && !(q+2 < end && q[2] == ')')) {
+			type = 'A';
+			q += 2;
+		}
+		else if (*q == '*' && q+1 < end && q[1] == ')') {
+			type = 'Z';
+			q += 2;
+		}
+		else {
+			type = 'p';
+			text.assign(q, q+1);
+			q++;
+		}
+
+		p = q;
+		tok_end = q;
+	}
+
+	bool is_punct(char c) const {
+		return type == 'p' && text[0] == c;
+	}
+
+	bool is_keyword(const char *keyword) const {
+		return type == 'i' && !escaped && text == keyword;
+	}
+
+	bool is_plain_id() const {
+		return type == 'i' && (escaped || !netlist_keywords().count(text));
+	}
+
+	RTLIL::IdString id() const {
+		return escaped ? RTLIL::IdString(text) : RTLIL::IdString("\\" + text);
+	}
+
+	// a decimal number without size, base or '_', as used in ranges and selects
+	bool is_index(int &value) const {
+		if (type != 'n' || text.size() > 9)
+			return false;
+		for (char c : text)
+			if (!is_digit(c))
+				return false;
+		value = atoi(text.c_str());
+		return true;
+	}
+};
+
+struct NetlistReader
+{
+	RTLIL::Design *design;
+	std::string filename;
+	const std::list<std::string> &attributes;
+	bool flag_icells, autowire;
+
+	NetlistLexer lex;
+	std::vector<RTLIL::Module*> modules;
+	pool<RTLIL::IdString> module_names;
+
+	RTLIL::Module *module = nullptr;
+	std::vector<RTLIL::IdString> port_names;
+	pool<RTLIL::Wire*> implicit_wires, signed_wires;
+	bool module_ended = false;
+
+	NetlistReader(RTLIL::Design *design, const char *data, size_t size, const std::string &filename,
+			const std::list<std::string> &attributes, bool flag_icells, bool autowire) :
+			design(design), filename(filename), attributes(attributes), flag_icells(flag_icells), autowire(autowire), lex(data, size) { }
+
+	std::string src(int line) {
+		return stringf("%s:%d", filename.c_str(), line);
+	}
+
+	bool expect(char c) {
+		if (!lex.is_punct(c))
+			return false;
+		lex.next();
+		return true;
+	}
+
+	// the end of a list, or a comma before the next element
+	bool list_separator(char close) {
+		if (lex.is_punct(close))
+			return true;
+		return expect(',') && !lex.is_punct(close);
+	}
+
+	bool read_range(bool &has_range, int &width, int &start_offset, bool &upto)
+	{
+		int msb, lsb;
+		has_range = lex.is_punct('[');
+		width = 1, start_offset = 0, upto = false;
+		if (!has_range)
+			return true;
+		lex.next();
+		if (!lex.is_index(msb))
+			return false;
+		lex.next();
+		if (!expect(':') || !lex.is_index(lsb))
+			return false;
+		lex.next();
+		if (!expect(']'))
+			return false;
+		upto = msb < lsb;
+		width = upto ? lsb - msb + 1 : msb - lsb + 1;
+		start_offset = upto ? msb : lsb;
+		return true;
+	}
+
+	bool declare_wire(RTLIL::IdString name, bool is_input, bool is_output, int width, int start_offset, bool upto, bool is_signed, int line)
+	{
+		if (module->cell(name) != nullptr)
+			return false;
+
+		RTLIL::Wire *wire = module->wire(name);
+		if (wire != nullptr && implicit_wires.count(wire)) {
+			if (width != 1 || start_offset != 0)
+				return false;
+			implicit_wires.erase(wire);
+		} else if (wire != nullptr) {
+			// a port that is declared again as wire, or the other way around
+			if (wire->width != width || wire->start_offset != start_offset || wire->upto != upto)
+				return false;
+			if ((wire->port_input || wire->port_output) == (is_input || is_output))
+				return false;
+		} else {
+			wire = module->addWire(name, width);
+			wire->start_offset = start_offset;
+			wire->upto = upto;
+		}
+
+		wire->set_src_attribute(src(line));
+		wire->port_input |= is_input;
+		wire->port_output |= is_output;
+		if (is_signed)
+			signed_wires.insert(wire);
+		return true;
+	}
+
+	RTLIL::Wire *get_wire(RTLIL::IdString name)
+	{
+		RTLIL::Wire *wire = module->wire(name);
+		if (wire == nullptr && module->cell(name) == nullptr) {
+			wire = module->addWire(name);
+			wire->set_src_attribute(src(lex.tok_line));
+			implicit_wires.insert(wire);
+		}
+		return wire;
+	}
+
+	// identifiers, constant bit and part selects, constants and concatenations of them
+	bool read_expr(RTLIL::SigSpec &sig, bool &is_signed)
+	{
+		is_signed = false;
+
+		if (lex.is_punct('{'))
+		{
+			lex.next();
+			std::vector<RTLIL::SigSpec> parts;
+			while (1) {
+				RTLIL::SigSpec part;
+				bool part_signed;
+				if (!read_expr(part, part_signed))
+					return false;
+				parts.push_back(part);
+				if (lex.is_punct('}'))
+					break;
+				if (!expect(','))
+					return false;
+			}
+			lex.next();
+			sig = RTLIL::SigSpec();
+			for (auto it = parts.rbegin(); it != parts.rend(); ++it)
+				sig.append(*it);
+			return true;
+		}
+
+		if (lex.type == 'n')
+		{
+			AST::AstNode *node = VERILOG_FRONTEND::const2ast(lex.text, 0, true);
+			if (node == nullptr)
+				return false;
+			bool ok = node->type == AST::AST_CONSTANT;
+			if (ok) {
+				sig = node->bitsAsConst();
+				is_signed = node->is_signed;
+			}
+			delete node;
+			lex.next();
+			return ok;
+		}
+
+		if (!lex.is_plain_id())
+			return false;
+
+		RTLIL::Wire *wire = get_wire(lex.id());
+		if (wire == nullptr)
+			return false;
+		lex.next();
+
+		if (!lex.is_punct('[')) {
+			sig = wire;
+			is_signed = signed_wires.count(wire) != 0;
+			return true;
+		}
+
+		if (implicit_wires.count(wire))
+			return false;
+
+		int msb, lsb;
+		lex.next();
+		if (!lex.is_index(msb))
+			return false;
+		lex.next();
+		lsb = msb;
+		if (lex.is_punct(':')) {
+			lex.next();
+			if (!lex.is_index(lsb))
+				return false;
+			lex.next();
+		}
+		if (!expect(']'))
+			return false;
+
+		// the same order as in the declaration, and within its range
+		if (wire->upto ? msb > lsb : msb < lsb)
+			return false;
+		int lo = std::min(msb, lsb) - wire->start_offset, hi = std::max(msb, lsb) - wire->start_offset;
+		if (lo < 0 || hi >= wire->width)
+			return false;
+		if (wire->upto)
+			sig = RTLIL::SigSpec(wire, wire->width - 1 - hi, hi - lo + 1);
+		else
+			sig = RTLIL::SigSpec(wire, lo, hi - lo + 1);
+		return true;
+	}
+
+	bool read_param_value(RTLIL::Const &value)
+	{
+		AST::AstNode *node = nullptr;
+		if (lex.type == 'n')
+			node = VERILOG_FRONTEND::const2ast(lex.text, 0, true);
+		else if (lex.type == 's')
+			node = AST::AstNode::mkconst_str(lex.text);
+		if (node == nullptr)
+			return false;
+		bool ok = node->type == AST::AST_CONSTANT;
+		if (ok)
+			value = node->asParaConst();
+		delete node;
+		lex.next();
+		return ok;
+	}
+
+	// input/output/inout/wire declarations in the module body
+	bool read_declaration()
+	{
+		int line = lex.tok_line;
+		bool is_input = lex.is_keyword("input") || lex.is_keyword("inout");
+		bool is_output = lex.is_keyword("output") || lex.is_keyword("inout");
+		bool is_wire = lex.is_keyword("wire");
+
+		lex.next();
+		if (!is_wire && lex.is_keyword("wire"))
+			lex.next();
+		bool is_signed = lex.is_keyword("signed");
+		if (is_signed)
+			lex.next();
+
+		bool has_range, upto;
+		int width, start_offset;
+		if (!read_range(has_range, width, start_offset, upto))
+			return false;
+
+		while (1) {
+			if (!lex.is_plain_id() || !declare_wire(lex.id(), is_input, is_output, width, start_offset, upto, is_signed, line))
+				return false;
+			lex.next();
+			if (lex.is_punct(';'))
+				break;
+			if (!expect(','))
+				return false;
+		}
+		lex.next();
+		return true;
+	}
+
+	bool read_assign()
+	{
+		lex.next();
+		while (1)
+		{
+			RTLIL::SigSpec lhs, rhs;
+			bool lhs_signed, rhs_signed;
+			if (!read_expr(lhs, lhs_signed) || lhs.has_const())
+				return false;
+			if (!expect('='))
+				return false;
+			if (!read_expr(rhs, rhs_signed))
+				return false;
+
+			if (GetSize(rhs) != GetSize(lhs)) {
+				if (rhs.is_fully_const() && !rhs.is_fully_def())
+					return false;
+				if (GetSize(rhs) < GetSize(lhs))
+					rhs.extend_u0(GetSize(lhs), rhs_signed);
+				else
+					rhs = rhs.extract(0, GetSize(lhs));
+			}
+			module->connect(lhs, rhs);
+
+			if (lex.is_punct(';'))
+				break;
+			if (!expect(','))
+				return false;
+		}
+		lex.next();
+		return true;
+	}
+
+	bool read_instances()
+	{
+		RTLIL::IdString type = lex.id();
+		if (flag_icells && type.begins_with("\\$"))
+			type = type.substr(1);
+		lex.next();
+
+		dict<RTLIL::IdString, RTLIL::Const> parameters;
+		if (lex.is_punct('#'))
+		{
+			lex.next();
+			if (!expect('('))
+				return false;
+			int para_counter = 0;
+			while (!lex.is_punct(')')) {
+				RTLIL::IdString name;
+				RTLIL::Const value;
+				if (lex.is_punct('.')) {
+					lex.next();
+					if (lex.type != 'i')
+						return false;
+					name = lex.id();
+					lex.next();
+					if (!expect('(') || !read_param_value(value) || !expect(')'))
+						return false;
+				} else {
+					name = stringf("$%d", ++para_counter);
+					if (!read_param_value(value))
+						return false;
+				}
+				parameters[name] = value;
+				if (!list_separator(')'))
+					return false;
+			}
+			lex.next();
+		}
+
+		while (1)
+		{
+			int line = lex.tok_line;
+			if (!lex.is_plain_id())
+				return false;
+			RTLIL::IdString name = lex.id();
+			if (module->count_id(name) != 0)
+				return false;
+			lex.next();
+			if (!expect('('))
+				return false;
+
+			RTLIL::Cell *cell = module->addCell(name, type);
+			cell->parameters = parameters;
+			cell->set_src_attribute(src(line));
+			cell->set_bool_attribute("\\module_not_derived");
+
+			int port_counter = 0;
+			bool named_ports = lex.is_punct('.');
+			while (!lex.is_punct(')'))
+			{
+				RTLIL::IdString port;
+				RTLIL::SigSpec sig;
+				bool is_signed;
+				if (named_ports) {
+					if (!expect('.') || lex.type != 'i')
+						return false;
+					port = lex.id();
+					lex.next();
+					if (!expect('('))
+						return false;
+					if (!lex.is_punct(')') && !read_expr(sig, is_signed))
+						return false;
+					if (!expect(')'))
+						return false;
+				} else {
+					port = stringf("$%d", ++port_counter);
+					if (!read_expr(sig, is_signed))
+						return false;
+				}
+				if (cell->hasPort(port))
+					return false;
+				cell->setPort(port, sig);
+				if (!list_separator(')'))
+					return false;
+			}
+			lex.next();
+
+			if (lex.is_punct(';'))
+				break;
+			if (!expect(','))
+				return false;
+		}
+		lex.next();
+		return true;
+	}
+
+	// the port list in the module header, with or without declarations
+	bool read_ports()
+	{
+		if (!lex.is_punct('('))
+			return true;
+		lex.next();
+
+		bool is_input = false, is_output = false, is_signed = false, has_range = false, upto = false;
+		int width = 1, start_offset = 0, line = lex.tok_line;
+		bool ansi = lex.is_keyword("input") || lex.is_keyword("output") || lex.is_keyword("inout");
+
+		while (!lex.is_punct(')'))
+		{
+			if (ansi && (lex.is_keyword("input") || lex.is_keyword("output") || lex.is_keyword("inout"))) {
+				line = lex.tok_line;
+				is_input = lex.is_keyword("input") || lex.is_keyword("inout");
+				is_output = lex.is_keyword("output") || lex.is_keyword("inout");
+				lex.next();
+				if (lex.is_keyword("wire"))
+					lex.next();
+				is_signed = lex.is_keyword("signed");
+				if (is_signed)
+					lex.next();
+				if (!read_range(has_range, width, start_offset, upto))
+					return false;
+			}
+			if (!lex.is_plain_id())
+				return false;
+			port_names.push_back(lex.id());
+			if (ansi && !declare_wire(lex.id(), is_input, is_output, width, start_offset, upto, is_signed, line))
+				return false;
+			lex.next();
+			if (!list_separator(')'))
+				return false;
+		}
+		lex.next();
+		return true;
+	}
+
+	bool read_module()
+	{
+		int line = lex.tok_line;
+		module_ended = false;
+		lex.next();
+
+		if (!lex.is_plain_id())
+			return false;
+		RTLIL::IdString name = lex.id();
+		if (design->module(name) != nullptr || module_names.count(name))
+			return false;
+		lex.next();
+
+		module = new RTLIL::Module;
+		module->name = name;
+		port_names.clear();
+		implicit_wires.clear();
+		signed_wires.clear();
+
+		if (!read_ports() || !expect(';'))
+			return false;
+
+		while (!lex.is_keyword("endmodule"))
+		{
+			bool ok;
+			if (lex.is_keyword("input") || lex.is_keyword("output") || lex.is_keyword("inout") || lex.is_keyword("wire"))
+				ok = read_declaration();
+			else if (lex.is_keyword("assign"))
+				ok = read_assign();
+			else if (lex.is_plain_id())
+				ok = read_instances();
+			else
+				ok = false;
+			if (!ok)
+				return false;
+		}
+
+		// empty modules may become blackboxes, and modules with undeclared
+		// signals may need an error message
+		if (module->cells_.empty() && module->connections().empty())
+			return false;
+		if (!autowire && !implicit_wires.empty())
+			return false;
+
+		int port_count = 0;
+		for (auto wire : module->wires())
+			if (wire->port_input || wire->port_output)
+				port_count++;
+		if (port_count != GetSize(port_names))
+			return false;
+		for (int i = 0; i < GetSize(port_names); i++) {
+			RTLIL::Wire *wire = module->wire(port_names[i]);
+			if (wire == nullptr || !(wire->port_input || wire->port_output) || wire->port_id != 0)
+				return false;
+			wire->port_id = i + 1;
+		}
+
+		lex.next();
+		module_ended = true;
+		if (lex.is_punct(':')) {
+			lex.next();
+			if (lex.type != 'i' || lex.id() != name)
+				return false;
+			lex.next();
+		}
+
+		module->set_src_attribute(src(line));
+		module->set_bool_attribute("\\cells_not_processed");
+		for (auto &attr : attributes)
+			module->attributes[attr] = RTLIL::Const(1);
+		module->fixup_ports();
+
+		modules.push_back(module);
+		module_names.insert(name);
+		module = nullptr;
+		return true;
+	}
+
+	// Returns false if the input must be read by the regular parser as a
+	// whole. Otherwise the text of all modules that were read is removed from
+	// rest, except for the line breaks.
+	bool read(std::string &rest)
+	{
+		std::vector<std::pair<const char*, const char*>> modules_text;
+		bool has_rest = false, has_attributes = false, has_globals = false;
+
+		lex.next();
+		while (lex.type != 0)
+		{
+			if (lex.type == 'A') {
+				has_rest = true;
+				has_attributes = true;
+				while (lex.type != 0 && lex.type != 'Z')
+					lex.next();
+				lex.next();
+				continue;
+			}
+
+			if (!lex.is_keyword("module")) {
+				// globals can be used in all following modules
+				has_rest = true;
+				has_globals = true;
+				lex.next();
+				continue;
+			}
+
+			const char *begin = lex.tok_begin;
+			if (!has_attributes && !has_globals && read_module()) {
+				modules_text.push_back(std::make_pair(begin, lex.tok_begin));
+				continue;
+			}
+
+			delete module;
+			module = nullptr;
+			has_rest = true;
+			has_attributes = false;
+			if (module_ended)
+				continue;
+			while (lex.type != 0 && !lex.is_keyword("endmodule"))
+				lex.next();
+			lex.next();
+			if (lex.is_punct(':')) {
+				lex.next();
+				lex.next();
+			}
+		}
+
+		if (lex.unsupported) {
+			for (auto mod : modules)
+				delete mod;
+			modules.clear();
+			return false;
+		}
+
+		rest.clear();
+		if (has_rest) {
+			const char *p = lex.data;
+			rest.reserve(lex.end - p);
+			for (auto &it : modules_text) {
+				rest.append(p, it.first);
+				for (p = it.first; p < it.second; p++)
+					if (*p == '\n')
+						rest.push_back('\n');
+			}
+			rest.append(p, lex.end);
+		}
+		return true;
+	}
+};
+
+}
+
+int VERILOG_FRONTEND::read_verilog_netlist(RTLIL::Design *design, const char *data, size_t size, const std::string &filename,
+		std::string &rest, const std::list<std::string> &attributes, bool flag_icells, bool autowire)
+{
+	NetlistReader reader(design, data, size, filename, attributes, flag_icells, autowire);
+	if (!reader.read(rest))
+		return -1;
+	for (auto module : reader.modules) {
+		log("Generating RTLIL representation for module `%s'.\n", module->name.c_str());
+		design->add(module);
+	}
+	return GetSize(reader.modules);
+}
+
+YOSYS_NAMESPACE_END
@@ -65,6 +65,8 @@ namespace VERILOG_FRONTEND {
 	bool current_wire_rand, current_wire_const;
 	bool current_modport_input, current_modport_output;
 	std::istream *lexin;
+	const char *lexin_buffer;
+	size_t lexin_buffer_size, lexin_buffer_pos;
 }
 YOSYS_NAMESPACE_END
 
@@ -30,13 +30,13 @@ static void extend_u0(RTLIL::Const &arg, int width, bool is_signed)
 {
 	RTLIL::State padding = RTLIL::State::S0;
 
-	if (arg.bits.size() > 0 && is_signed)
-		padding = arg.bits.back();
+	if (arg.size() > 0 && is_signed)
+		padding = arg.back();
 
-	while (int(arg.bits.size()) < width)
-		arg.bits.push_back(padding);
+	while (int(arg.size()) < width)
+		arg.bits().push_back(padding);
 
-	arg.bits.resize(width);
+	arg.bits().resize(width);
 }
 
 static BigInteger const2big(const RTLIL::Const &val, bool as_signed, int &undef_bit_pos)
@@ -45,17 +45,17 @@ static BigInteger const2big(const RTLIL::Const &val, bool as_signed, int &undef_
 
 	BigInteger::Sign sign = BigInteger::positive;
 	State inv_sign_bit = RTLIL::State::S1;
-	size_t num_bits = val.bits.size();
+	size_t num_bits = val.size();
 
-	if (as_signed && num_bits && val.bits[num_bits-1] == RTLIL::State::S1) {
+	if (as_signed && num_bits && val[num_bits-1] == RTLIL::State::S1) {
 		inv_sign_bit = RTLIL::State::S0;
 		sign = BigInteger::negative;
 		num_bits--;
 	}
 
 	for (size_t i = 0; i < num_bits; i++)
-		if (val.bits[i] == RTLIL::State::S0 || val.bits[i] == RTLIL::State::S1)
-			mag.setBit(i, val.bits[i] == inv_sign_bit);
+		if (val[i] == RTLIL::State::S0 || val[i] == RTLIL::State::S1)
+			mag.setBit(i, val[i] == inv_sign_bit);
 		else if (undef_bit_pos < 0)
 			undef_bit_pos = i;
 
@@ -79,24 +79,75 @@ static RTLIL::Const big2const(const BigInteger &val, int result_len, int undef_b
 		{
 			mag--;
 			for (int i = 0; i < result_len; i++)
-				result.bits[i] = mag.getBit(i) ? RTLIL::State::S0 : RTLIL::State::S1;
+				result.bits()[i] = mag.getBit(i) ? RTLIL::State::S0 : RTLIL::State::S1;
 		}
 		else
 		{
 			for (int i = 0; i < result_len; i++)
-				result.bits[i] = mag.getBit(i) ? RTLIL::State::S1 : RTLIL::State::S0;
+				result.bits()[i] = mag.getBit(i) ? RTLIL::State::S1 : RTLIL::State::S0;
 		}
 	}
 
 #if 0
 	if (undef_bit_pos >= 0)
 		for (int i = undef_bit_pos; i < result_len; i++)
-			result.bits[i] = RTLIL::State::Sx;
+			result.bits()[i] = RTLIL::State::Sx;
 #endif
 
 	return result;
 }
 
+// Fully defined operands that fit in a native word are computed with native
+// integer arithmetic, everything else goes through BigInteger. Results are
+// taken modulo 2^word_bits, which gives the same bits as the BigInteger code
+// for all result widths up to word_bits.
+#ifdef __SIZEOF_INT128__
+typedef unsigned __int128 word_t;
+typedef __int128 sword_t;
+#else
+typedef uint64_t word_t;
+typedef int64_t sword_t;
+#endif
+
+static const int word_bits = 8 * sizeof(word_t);
+
+static bool const2word(const RTLIL::Const &val, bool as_signed, word_t &word)
+{
+	int width = val.size();
+	if (width > word_bits || !val.is_fully_def())
+		return false;
+
+	word = 0;
+	for (int i = 0; i < width; i++)
+		if (val[i] == RTLIL::State::S1)
+			word |= word_t(1) << i;
+
+	if (as_signed && width > 0 && width < word_bits && val[width-1] == RTLIL::State::S1)
+		word |= ~word_t(0) << width;
+	return true;
+}
+
+// like const2word(), but only for operands narrow enough that their value
+// (signed or unsigned) is also representable as a signed word
+static bool const2sword(const RTLIL::Const &val, bool as_signed, sword_t &word)
+{
+	word_t w;
+	if (val.size() >= word_bits || !const2word(val, as_signed, w))
+		return false;
+	word = sword_t(w);
+	return true;
+}
+
+static RTLIL::Const word2const(word_t word, int result_len)
+{
+	log_assert(result_len <= word_bits);
+	RTLIL::Const result(RTLIL::State::S0, result_len);
+	for (int i = 0; i < result_len; i++)
+		if ((word >> i) & 1)
+			result.set(i, RTLIL::State::S1);
+	return result;
+}
+
 static RTLIL::State logic_and(RTLIL::State a, RTLIL::State b)
 {
 	if (a == RTLIL::State::S0) return RTLIL::State::S0;
@@ -132,19 +183,19 @@ static RTLIL::State logic_xnor(RTLIL::State a, RTLIL::State b)
 RTLIL::Const RTLIL::const_not(const RTLIL::Const &arg1, const RTLIL::Const&, bool signed1, bool, int result_len)
 {
 	if (result_len < 0)
-		result_len = arg1.bits.size();
+		result_len = arg1.size();
 
 	RTLIL::Const arg1_ext = arg1;
 	extend_u0(arg1_ext, result_len, signed1);
 
 	RTLIL::Const result(RTLIL::State::Sx, result_len);
-	for (size_t i = 0; i < size_t(result_len); i++) {
-		if (i >= arg1_ext.bits.size())
-			result.bits[i] = RTLIL::State::S0;
-		else if (arg1_ext.bits[i] == RTLIL::State::S0)
-			result.bits[i] = RTLIL::State::S1;
-		else if (arg1_ext.bits[i] == RTLIL::State::S1)
-			result.bits[i] = RTLIL::State::S0;
+	for (int i = 0; i < result_len; i++) {
+		if (i >= arg1_ext.size())
+			result.bits()[i] = RTLIL::State::S0;
+		else if (arg1_ext[i] == RTLIL::State::S0)
+			result.bits()[i] = RTLIL::State::S1;
+		else if (arg1_ext[i] == RTLIL::State::S1)
+			result.bits()[i] = RTLIL::State::S0;
 	}
 
 	return result;
@@ -154,16 +205,16 @@ static RTLIL::Const logic_wrapper(RTLIL::State(*logic_func)(RTLIL::State, RTLIL:
 		RTLIL::Const arg1, RTLIL::Const arg2, bool signed1, bool signed2, int result_len = -1)
 {
 	if (result_len < 0)
-		result_len = max(arg1.bits.size(), arg2.bits.size());
+		result_len = max(arg1.size(), arg2.size());
 
 	extend_u0(arg1, result_len, signed1);
 	extend_u0(arg2, result_len, signed2);
 
 	RTLIL::Const result(RTLIL::State::Sx, result_len);
-	for (size_t i = 0; i < size_t(result_len); i++) {
-		RTLIL::State a = i < arg1.bits.size() ? arg1.bits[i] : RTLIL::State::S0;
-		RTLIL::State b = i < arg2.bits.size() ? arg2.bits[i] : RTLIL::State::S0;
-		result.bits[i] = logic_func(a, b);
+	for (int i = 0; i < result_len; i++) {
+		RTLIL::State a = i < arg1.size() ? arg1[i] : RTLIL::State::S0;
+		RTLIL::State b = i < arg2.size() ? arg2[i] : RTLIL::State::S0;
+		result.bits()[i] = logic_func(a, b);
 	}
 
 	return result;
@@ -193,12 +244,12 @@ static RTLIL::Const logic_reduce_wrapper(RTLIL::State initial, RTLIL::State(*log
 {
 	RTLIL::State temp = initial;
 
-	for (size_t i = 0; i < arg1.bits.size(); i++)
-		temp = logic_func(temp, arg1.bits[i]);
+	for (int i = 0; i < arg1.size(); i++)
+		temp = logic_func(temp, arg1[i]);
 
 	RTLIL::Const result(temp);
-	while (int(result.bits.size()) < result_len)
-		result.bits.push_back(RTLIL::State::S0);
+	while (int(result.size()) < result_len)
+		result.bits().push_back(RTLIL::State::S0);
 	return result;
 }
 
@@ -220,11 +271,11 @@ RTLIL::Const RTLIL::const_reduce_xor(const RTLIL::Const &arg1, const RTLIL::Cons
 RTLIL::Const RTLIL::const_reduce_xnor(const RTLIL::Const &arg1, const RTLIL::Const&, bool, bool, int result_len)
 {
 	RTLIL::Const buffer = logic_reduce_wrapper(RTLIL::State::S0, logic_xor, arg1, result_len);
-	if (!buffer.bits.empty()) {
-		if (buffer.bits.front() == RTLIL::State::S0)
-			buffer.bits.front() = RTLIL::State::S1;
-		else if (buffer.bits.front() == RTLIL::State::S1)
-			buffer.bits.front() = RTLIL::State::S0;
+	if (!buffer.empty()) {
+		if (buffer.front() == RTLIL::State::S0)
+			buffer.bits().front() = RTLIL::State::S1;
+		else if (buffer.front() == RTLIL::State::S1)
+			buffer.bits().front() = RTLIL::State::S0;
 	}
 	return buffer;
 }
@@ -240,8 +291,8 @@ RTLIL::Const RTLIL::const_logic_not(const RTLIL::Const &arg1, const RTLIL::Const
 	BigInteger a = const2big(arg1, signed1, undef_bit_pos_a);
 	RTLIL::Const result(a.isZero() ? undef_bit_pos_a >= 0 ? RTLIL::State::Sx : RTLIL::State::S1 : RTLIL::State::S0);
 
-	while (int(result.bits.size()) < result_len)
-		result.bits.push_back(RTLIL::State::S0);
+	while (int(result.size()) < result_len)
+		result.bits().push_back(RTLIL::State::S0);
 	return result;
 }
 
@@ -255,8 +306,8 @@ RTLIL::Const RTLIL::const_logic_and(const RTLIL::Const &arg1, const RTLIL::Const
 	RTLIL::State bit_b = b.isZero() ? undef_bit_pos_b >= 0 ? RTLIL::State::Sx : RTLIL::State::S0 : RTLIL::State::S1;
 	RTLIL::Const result(logic_and(bit_a, bit_b));
 
-	while (int(result.bits.size()) < result_len)
-		result.bits.push_back(RTLIL::State::S0);
+	while (int(result.size()) < result_len)
+		result.bits().push_back(RTLIL::State::S0);
 	return result;
 }
 
@@ -270,19 +321,35 @@ RTLIL::Const RTLIL::const_logic_or(const RTLIL::Const &arg1, const RTLIL::Const
 	RTLIL::State bit_b = b.isZero() ? undef_bit_pos_b >= 0 ? RTLIL::State::Sx : RTLIL::State::S0 : RTLIL::State::S1;
 	RTLIL::Const result(logic_or(bit_a, bit_b));
 
-	while (int(result.bits.size()) < result_len)
-		result.bits.push_back(RTLIL::State::S0);
+	while (int(result.size()) < result_len)
+		result.bits().push_back(RTLIL::State::S0);
 	return result;
 }
 
 static RTLIL::Const const_shift_worker(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool sign_ext, int direction, int result_len)
 {
+	if (result_len < 0)
+		result_len = arg1.size();
+
+	word_t word;
+	if (arg2.size() <= 32 && const2word(arg2, false, word)) {
+		int64_t offset = int64_t(word) * direction;
+		std::vector<RTLIL::State> bits(result_len);
+		for (int i = 0; i < result_len; i++) {
+			int64_t pos = i + offset;
+			if (pos < 0)
+				bits[i] = RTLIL::State::S0;
+			else if (pos >= arg1.size())
+				bits[i] = sign_ext ? arg1.back() : RTLIL::State::S0;
+			else
+				bits[i] = arg1[pos];
+		}
+		return RTLIL::Const(bits);
+	}
+
 	int undef_bit_pos = -1;
 	BigInteger offset = const2big(arg2, false, undef_bit_pos) * direction;
 
-	if (result_len < 0)
-		result_len = arg1.bits.size();
-
 	RTLIL::Const result(RTLIL::State::Sx, result_len);
 	if (undef_bit_pos >= 0)
 		return result;
@@ -290,11 +357,11 @@ static RTLIL::Const const_shift_worker(const RTLIL::Const &arg1, const RTLIL::Co
 	for (int i = 0; i < result_len; i++) {
 		BigInteger pos = BigInteger(i) + offset;
 		if (pos < 0)
-			result.bits[i] = RTLIL::State::S0;
-		else if (pos >= BigInteger(int(arg1.bits.size())))
-			result.bits[i] = sign_ext ? arg1.bits.back() : RTLIL::State::S0;
+			result.bits()[i] = RTLIL::State::S0;
+		else if (pos >= BigInteger(int(arg1.size())))
+			result.bits()[i] = sign_ext ? arg1.back() : RTLIL::State::S0;
 		else
-			result.bits[i] = arg1.bits[pos.toInt()];
+			result.bits()[i] = arg1[pos.toInt()];
 	}
 
 	return result;
@@ -330,22 +397,36 @@ RTLIL::Const RTLIL::const_sshr(const RTLIL::Const &arg1, const RTLIL::Const &arg
 
 static RTLIL::Const const_shift_shiftx(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool, bool signed2, int result_len, RTLIL::State other_bits)
 {
+	if (result_len < 0)
+		result_len = arg1.size();
+
+	word_t word;
+	if (arg2.size() <= 32 && const2word(arg2, signed2, word)) {
+		int64_t offset = int64_t(sword_t(word));
+		std::vector<RTLIL::State> bits(result_len);
+		for (int i = 0; i < result_len; i++) {
+			int64_t pos = i + offset;
+			if (pos < 0 || pos >= arg1.size())
+				bits[i] = other_bits;
+			else
+				bits[i] = arg1[pos];
+		}
+		return RTLIL::Const(bits);
+	}
+
 	int undef_bit_pos = -1;
 	BigInteger offset = const2big(arg2, signed2, undef_bit_pos);
 
-	if (result_len < 0)
-		result_len = arg1.bits.size();
-
 	RTLIL::Const result(RTLIL::State::Sx, result_len);
 	if (undef_bit_pos >= 0)
 		return result;
 
 	for (int i = 0; i < result_len; i++) {
 		BigInteger pos = BigInteger(i) + offset;
-		if (pos < 0 || pos >= BigInteger(int(arg1.bits.size())))
-			result.bits[i] = other_bits;
+		if (pos < 0 || pos >= BigInteger(int(arg1.size())))
+			result.bits()[i] = other_bits;
 		else
-			result.bits[i] = arg1.bits[pos.toInt()];
+			result.bits()[i] = arg1[pos.toInt()];
 	}
 
 	return result;
@@ -364,22 +445,26 @@ RTLIL::Const RTLIL::const_shiftx(const RTLIL::Const &arg1, const RTLIL::Const &a
 RTLIL::Const RTLIL::const_lt(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
 	int undef_bit_pos = -1;
-	bool y = const2big(arg1, signed1, undef_bit_pos) < const2big(arg2, signed2, undef_bit_pos);
+	sword_t a, b;
+	bool y = const2sword(arg1, signed1, a) && const2sword(arg2, signed2, b) ? a < b :
+			const2big(arg1, signed1, undef_bit_pos) < const2big(arg2, signed2, undef_bit_pos);
 	RTLIL::Const result(undef_bit_pos >= 0 ? RTLIL::State::Sx : y ? RTLIL::State::S1 : RTLIL::State::S0);
 
-	while (int(result.bits.size()) < result_len)
-		result.bits.push_back(RTLIL::State::S0);
+	while (int(result.size()) < result_len)
+		result.bits().push_back(RTLIL::State::S0);
 	return result;
 }
 
 RTLIL::Const RTLIL::const_le(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
 	int undef_bit_pos = -1;
-	bool y = const2big(arg1, signed1, undef_bit_pos) <= const2big(arg2, signed2, undef_bit_pos);
+	sword_t a, b;
+	bool y = const2sword(arg1, signed1, a) && const2sword(arg2, signed2, b) ? a <= b :
+			const2big(arg1, signed1, undef_bit_pos) <= const2big(arg2, signed2, undef_bit_pos);
 	RTLIL::Const result(undef_bit_pos >= 0 ? RTLIL::State::Sx : y ? RTLIL::State::S1 : RTLIL::State::S0);
 
-	while (int(result.bits.size()) < result_len)
-		result.bits.push_back(RTLIL::State::S0);
+	while (int(result.size()) < result_len)
+		result.bits().push_back(RTLIL::State::S0);
 	return result;
 }
 
@@ -389,31 +474,31 @@ RTLIL::Const RTLIL::const_eq(const RTLIL::Const &arg1, const RTLIL::Const &arg2,
 	RTLIL::Const arg2_ext = arg2;
 	RTLIL::Const result(RTLIL::State::S0, result_len);
 
-	int width = max(arg1_ext.bits.size(), arg2_ext.bits.size());
+	int width = max(arg1_ext.size(), arg2_ext.size());
 	extend_u0(arg1_ext, width, signed1 && signed2);
 	extend_u0(arg2_ext, width, signed1 && signed2);
 
 	RTLIL::State matched_status = RTLIL::State::S1;
-	for (size_t i = 0; i < arg1_ext.bits.size(); i++) {
-		if (arg1_ext.bits.at(i) == RTLIL::State::S0 && arg2_ext.bits.at(i) == RTLIL::State::S1)
+	for (int i = 0; i < arg1_ext.size(); i++) {
+		if (arg1_ext[i] == RTLIL::State::S0 && arg2_ext[i] == RTLIL::State::S1)
 			return result;
-		if (arg1_ext.bits.at(i) == RTLIL::State::S1 && arg2_ext.bits.at(i) == RTLIL::State::S0)
+		if (arg1_ext[i] == RTLIL::State::S1 && arg2_ext[i] == RTLIL::State::S0)
 			return result;
-		if (arg1_ext.bits.at(i) > RTLIL::State::S1 || arg2_ext.bits.at(i) > RTLIL::State::S1)
+		if (arg1_ext[i] > RTLIL::State::S1 || arg2_ext[i] > RTLIL::State::S1)
 			matched_status = RTLIL::State::Sx;
 	}
 
-	result.bits.front() = matched_status;
+	result.bits().front() = matched_status;
 	return result;
 }
 
 RTLIL::Const RTLIL::const_ne(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
 	RTLIL::Const result = RTLIL::const_eq(arg1, arg2, signed1, signed2, result_len);
-	if (result.bits.front() == RTLIL::State::S0)
-		result.bits.front() = RTLIL::State::S1;
-	else if (result.bits.front() == RTLIL::State::S1)
-		result.bits.front() = RTLIL::State::S0;
+	if (result.front() == RTLIL::State::S0)
+		result.bits().front() = RTLIL::State::S1;
+	else if (result.front() == RTLIL::State::S1)
+		result.bits().front() = RTLIL::State::S0;
 	return result;
 }
 
@@ -423,74 +508,101 @@ RTLIL::Const RTLIL::const_eqx(const RTLIL::Const &arg1, const RTLIL::Const &arg2
 	RTLIL::Const arg2_ext = arg2;
 	RTLIL::Const result(RTLIL::State::S0, result_len);
 
-	int width = max(arg1_ext.bits.size(), arg2_ext.bits.size());
+	int width = max(arg1_ext.size(), arg2_ext.size());
 	extend_u0(arg1_ext, width, signed1 && signed2);
 	extend_u0(arg2_ext, width, signed1 && signed2);
 
-	for (size_t i = 0; i < arg1_ext.bits.size(); i++) {
-		if (arg1_ext.bits.at(i) != arg2_ext.bits.at(i))
+	for (int i = 0; i < arg1_ext.size(); i++) {
+		if (arg1_ext[i] != arg2_ext[i])
 			return result;
 	}
 
-	result.bits.front() = RTLIL::State::S1;
+	result.bits().front() = RTLIL::State::S1;
 	return result;
 }
 
 RTLIL::Const RTLIL::const_nex(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
 	RTLIL::Const result = RTLIL::const_eqx(arg1, arg2, signed1, signed2, result_len);
-	if (result.bits.front() == RTLIL::State::S0)
-		result.bits.front() = RTLIL::State::S1;
-	else if (result.bits.front() == RTLIL::State::S1)
-		result.bits.front() = RTLIL::State::S0;
+	if (result.front() == RTLIL::State::S0)
+		result.bits().front() = RTLIL::State::S1;
+	else if (result.front() == RTLIL::State::S1)
+		result.bits().front() = RTLIL::State::S0;
 	return result;
 }
 
 RTLIL::Const RTLIL::const_ge(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
 	int undef_bit_pos = -1;
-	bool y = const2big(arg1, signed1, undef_bit_pos) >= const2big(arg2, signed2, undef_bit_pos);
+	sword_t a, b;
+	bool y = const2sword(arg1, signed1, a) && const2sword(arg2, signed2, b) ? a >= b :
+			const2big(arg1, signed1, undef_bit_pos) >= const2big(arg2, signed2, undef_bit_pos);
 	RTLIL::Const result(undef_bit_pos >= 0 ? RTLIL::State::Sx : y ? RTLIL::State::S1 : RTLIL::State::S0);
 
-	while (int(result.bits.size()) < result_len)
-		result.bits.push_back(RTLIL::State::S0);
+	while (int(result.size()) < result_len)
+		result.bits().push_back(RTLIL::State::S0);
 	return result;
 }
 
 RTLIL::Const RTLIL::const_gt(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
 	int undef_bit_pos = -1;
-	bool y = const2big(arg1, signed1, undef_bit_pos) > const2big(arg2, signed2, undef_bit_pos);
+	sword_t a, b;
+	bool y = const2sword(arg1, signed1, a) && const2sword(arg2, signed2, b) ? a > b :
+			const2big(arg1, signed1, undef_bit_pos) > const2big(arg2, signed2, undef_bit_pos);
 	RTLIL::Const result(undef_bit_pos >= 0 ? RTLIL::State::Sx : y ? RTLIL::State::S1 : RTLIL::State::S0);
 
-	while (int(result.bits.size()) < result_len)
-		result.bits.push_back(RTLIL::State::S0);
+	while (int(result.size()) < result_len)
+		result.bits().push_back(RTLIL::State::S0);
 	return result;
 }
 
 RTLIL::Const RTLIL::const_add(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	int width = result_len >= 0 ? result_len : max(arg1.size(), arg2.size());
+	word_t a, b;
+	if (width <= word_bits && const2word(arg1, signed1, a) && const2word(arg2, signed2, b))
+		return word2const(a + b, width);
+
 	int undef_bit_pos = -1;
 	BigInteger y = const2big(arg1, signed1, undef_bit_pos) + const2big(arg2, signed2, undef_bit_pos);
-	return big2const(y, result_len >= 0 ? result_len : max(arg1.bits.size(), arg2.bits.size()), undef_bit_pos);
+	return big2const(y, width, undef_bit_pos);
 }
 
 RTLIL::Const RTLIL::const_sub(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	int width = result_len >= 0 ? result_len : max(arg1.size(), arg2.size());
+	word_t a, b;
+	if (width <= word_bits && const2word(arg1, signed1, a) && const2word(arg2, signed2, b))
+		return word2const(a - b, width);
+
 	int undef_bit_pos = -1;
 	BigInteger y = const2big(arg1, signed1, undef_bit_pos) - const2big(arg2, signed2, undef_bit_pos);
-	return big2const(y, result_len >= 0 ? result_len : max(arg1.bits.size(), arg2.bits.size()), undef_bit_pos);
+	return big2const(y, width, undef_bit_pos);
 }
 
 RTLIL::Const RTLIL::const_mul(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	int width = result_len >= 0 ? result_len : max(arg1.size(), arg2.size());
+	word_t a, b;
+	if (width <= word_bits && const2word(arg1, signed1, a) && const2word(arg2, signed2, b))
+		return word2const(a * b, width);
+
 	int undef_bit_pos = -1;
 	BigInteger y = const2big(arg1, signed1, undef_bit_pos) * const2big(arg2, signed2, undef_bit_pos);
-	return big2const(y, result_len >= 0 ? result_len : max(arg1.bits.size(), arg2.bits.size()), min(undef_bit_pos, 0));
+	return big2const(y, width, min(undef_bit_pos, 0));
 }
 
 RTLIL::Const RTLIL::const_div(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	int width = result_len >= 0 ? result_len : max(arg1.size(), arg2.size());
+	sword_t sa, sb;
+	if (width <= word_bits && const2sword(arg1, signed1, sa) && const2sword(arg2, signed2, sb)) {
+		if (sb == 0)
+			return RTLIL::Const(RTLIL::State::Sx, result_len);
+		return word2const(sa / sb, width);
+	}
+
 	int undef_bit_pos = -1;
 	BigInteger a = const2big(arg1, signed1, undef_bit_pos);
 	BigInteger b = const2big(arg2, signed2, undef_bit_pos);
@@ -499,11 +611,19 @@ RTLIL::Const RTLIL::const_div(const RTLIL::Const &arg1, const RTLIL::Const &arg2
 	bool result_neg = (a.getSign() == BigInteger::negative) != (b.getSign() == BigInteger::negative);
 	a = a.getSign() == BigInteger::negative ? -a : a;
 	b = b.getSign() == BigInteger::negative ? -b : b;
-	return big2const(result_neg ? -(a / b) : (a / b), result_len >= 0 ? result_len : max(arg1.bits.size(), arg2.bits.size()), min(undef_bit_pos, 0));
+	return big2const(result_neg ? -(a / b) : (a / b), width, min(undef_bit_pos, 0));
 }
 
 RTLIL::Const RTLIL::const_mod(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	int width = result_len >= 0 ? result_len : max(arg1.size(), arg2.size());
+	sword_t sa, sb;
+	if (width <= word_bits && const2sword(arg1, signed1, sa) && const2sword(arg2, signed2, sb)) {
+		if (sb == 0)
+			return RTLIL::Const(RTLIL::State::Sx, result_len);
+		return word2const(sa % sb, width);
+	}
+
 	int undef_bit_pos = -1;
 	BigInteger a = const2big(arg1, signed1, undef_bit_pos);
 	BigInteger b = const2big(arg2, signed2, undef_bit_pos);
@@ -512,11 +632,39 @@ RTLIL::Const RTLIL::const_mod(const RTLIL::Const &arg1, const RTLIL::Const &arg2
 	bool result_neg = a.getSign() == BigInteger::negative;
 	a = a.getSign() == BigInteger::negative ? -a : a;
 	b = b.getSign() == BigInteger::negative ? -b : b;
-	return big2const(result_neg ? -(a % b) : (a % b), result_len >= 0 ? result_len : max(arg1.bits.size(), arg2.bits.size()), min(undef_bit_pos, 0));
+	return big2const(result_neg ? -(a % b) : (a % b), width, min(undef_bit_pos, 0));
 }
 
 RTLIL::Const RTLIL::const_pow(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	int width = result_len >= 0 ? result_len : max(arg1.size(), arg2.size());
+	sword_t sa, sb;
+	if (width <= word_bits && const2sword(arg1, signed1, sa) && const2sword(arg2, signed2, sb))
+	{
+		if (sa == 0 && sb < 0)
+			return RTLIL::Const(RTLIL::State::Sx, result_len);
+
+		if (sa == 0 && sb > 0)
+			return RTLIL::Const(RTLIL::State::S0, result_len);
+
+		word_t y = 1;
+		if (sb < 0) {
+			if (sa < -1 || sa > 1)
+				y = 0;
+			if (sa == -1)
+				y = (-sb % 2) == 0 ? 1 : ~word_t(0);
+		}
+
+		// power-modulo with 2^word_bits as modulus
+		for (word_t a = sa, b = sb; sb > 0 && b > 0; b >>= 1) {
+			if (b & 1)
+				y *= a;
+			a *= a;
+		}
+
+		return word2const(y, width);
+	}
+
 	int undef_bit_pos = -1;
 
 	BigInteger a = const2big(arg1, signed1, undef_bit_pos);
@@ -563,7 +711,7 @@ RTLIL::Const RTLIL::const_pow(const RTLIL::Const &arg1, const RTLIL::Const &arg2
 			y *= -1;
 	}
 
-	return big2const(y, result_len >= 0 ? result_len : max(arg1.bits.size(), arg2.bits.size()), min(undef_bit_pos, 0));
+	return big2const(y, width, min(undef_bit_pos, 0));
 }
 
 RTLIL::Const RTLIL::const_pos(const RTLIL::Const &arg1, const RTLIL::Const&, bool signed1, bool, int result_len)
@@ -252,12 +252,18 @@ struct AigMaker
 	}
 };
 
+// Cells with the same name (type and parameters) have the same AIG, so each
+// AIG is only built once. Unsupported cells are cached with an empty name.
+static dict<string, pair<string, vector<AigNode>>> aig_cache;
+#ifdef YOSYS_ENABLE_THREADS
+static std::mutex aig_cache_lock;
+#endif
+
 Aig::Aig(Cell *cell)
 {
 	if (cell->type[0] != '$')
 		return;
 
-	AigMaker mk(this, cell);
 	name = cell->type.str();
 
 	string mkname_last;
@@ -290,6 +296,33 @@ Aig::Aig(Cell *cell)
 		}
 	}
 
+	string cache_key = name;
+	{
+#ifdef YOSYS_ENABLE_THREADS
+		std::lock_guard<std::mutex> lock(aig_cache_lock);
+#endif
+		auto it = aig_cache.find(cache_key);
+		if (it != aig_cache.end()) {
+			name = it->second.first;
+			nodes = it->second.second;
+			return;
+		}
+	}
+
+	build(cell);
+
+	{
+#ifdef YOSYS_ENABLE_THREADS
+		std::lock_guard<std::mutex> lock(aig_cache_lock);
+#endif
+		aig_cache[cache_key] = make_pair(name, nodes);
+	}
+}
+
+void Aig::build(Cell *cell)
+{
+	AigMaker mk(this, cell);
+
 	if (cell->type.in(ID($not), ID($_NOT_), ID($pos), ID($_BUF_)))
 	{
 		for (int i = 0; i < GetSize(cell->getPort(ID::Y)); i++) {
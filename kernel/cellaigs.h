@@ -42,6 +42,7 @@ struct Aig
 	string name;
 	vector<AigNode> nodes;
 	Aig(Cell *cell);
+	void build(Cell *cell);
 
 	bool operator==(const Aig &other) const;
 	unsigned int hash() const;
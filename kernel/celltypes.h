@@ -35,6 +35,17 @@ struct CellTypes
 {
 	dict<RTLIL::IdString, CellType> cell_types;
 
+	// Internal cell types are also kept in a table that is addressed by the
+	// index of the type IdString, with their ports as bitmasks over the
+	// port names of all internal cells (see port_bit()). This avoids hashing
+	// in cell_known() and cell_input()/cell_output() for the common case.
+	struct FastCellType {
+		uint64_t inputs, outputs;
+		bool is_evaluable;
+	};
+	std::vector<int> fast_index;
+	std::vector<FastCellType> fast_types;
+
 	CellTypes()
 	{
 	}
@@ -55,10 +66,81 @@ struct CellTypes
 		setup_stdcells_mem();
 	}
 
+	// Returns the bit of the port in the port bitmasks, or -1 for ports that
+	// no internal cell has.
+	static int port_bit(RTLIL::IdString port)
+	{
+		static const char *const port_names[] = {
+			"\\A", "\\B", "\\C", "\\D", "\\E", "\\F", "\\G", "\\H",
+			"\\I", "\\J", "\\K", "\\L", "\\M", "\\N", "\\O", "\\P",
+			"\\Q", "\\R", "\\S", "\\T", "\\U", "\\V", "\\X", "\\Y",
+			"\\BI", "\\CI", "\\CO", "\\EN", "\\SRC", "\\DST", "\\DAT", "\\EN_SRC", "\\EN_DST",
+			"\\SET", "\\CLR", "\\CLK", "\\ARST", "\\ADDR", "\\DATA",
+			"\\RD_CLK", "\\RD_EN", "\\RD_ADDR", "\\RD_DATA", "\\WR_CLK", "\\WR_EN", "\\WR_ADDR", "\\WR_DATA",
+			"\\CTRL_IN", "\\CTRL_OUT"
+		};
+		static_assert(sizeof(port_names) / sizeof(port_names[0]) <= 64, "too many internal cell ports");
+
+		// the IdStrings are kept so that their indices stay valid
+		static std::vector<RTLIL::IdString> port_ids;
+		static std::vector<int> bits = []() {
+			std::vector<int> bits;
+			for (auto name : port_names) {
+				port_ids.push_back(name);
+				int idx = port_ids.back().index_;
+				if (GetSize(bits) <= idx)
+					bits.resize(idx+1, -1);
+				bits[idx] = GetSize(port_ids)-1;
+			}
+			return bits;
+		}();
+
+		return port.index_ < GetSize(bits) ? bits[port.index_] : -1;
+	}
+
+	const FastCellType *fast_type(RTLIL::IdString type) const
+	{
+		if (type.index_ >= GetSize(fast_index) || fast_index[type.index_] < 0)
+			return nullptr;
+		return &fast_types[fast_index[type.index_]];
+	}
+
+	void setup_fast_type(const CellType &ct)
+	{
+		FastCellType fct = {0, 0, ct.is_evaluable};
+		bool ok = ct.type.begins_with("$");
+		for (auto port : ct.inputs) {
+			int bit = port_bit(port);
+			ok = ok && bit >= 0;
+			fct.inputs |= uint64_t(1) << (bit & 63);
+		}
+		for (auto port : ct.outputs) {
+			int bit = port_bit(port);
+			ok = ok && bit >= 0;
+			fct.outputs |= uint64_t(1) << (bit & 63);
+		}
+
+		int idx = ct.type.index_;
+		if (!ok) {
+			if (idx < GetSize(fast_index))
+				fast_index[idx] = -1;
+			return;
+		}
+
+		if (GetSize(fast_index) <= idx)
+			fast_index.resize(idx+1, -1);
+		if (fast_index[idx] < 0) {
+			fast_index[idx] = GetSize(fast_types);
+			fast_types.push_back(fct);
+		} else
+			fast_types[fast_index[idx]] = fct;
+	}
+
 	void setup_type(RTLIL::IdString type, const pool<RTLIL::IdString> &inputs, const pool<RTLIL::IdString> &outputs, bool is_evaluable = false)
 	{
 		CellType ct = {type, inputs, outputs, is_evaluable};
 		cell_types[ct.type] = ct;
+		setup_fast_type(ct);
 	}
 
 	void setup_module(RTLIL::Module *module)
@@ -71,7 +153,13 @@ struct CellTypes
 			if (wire->port_output)
 				outputs.insert(wire->name);
 		}
-		setup_type(module->name, inputs, outputs);
+
+		// module types (e.g. '$paramod' modules) can have large IdString
+		// indices, they are only kept in the dict
+		CellType ct = {module->name, inputs, outputs, false};
+		cell_types[ct.type] = ct;
+		if (ct.type.index_ < GetSize(fast_index))
+			fast_index[ct.type.index_] = -1;
 	}
 
 	void setup_design(RTLIL::Design *design)
@@ -251,37 +339,61 @@ struct CellTypes
 			setup_type(stringf("$_DLATCHSR_%c%c%c_", c1, c2, c3), {E, S, R, D}, {Q});
 	}
 
+	void remove_type(RTLIL::IdString type)
+	{
+		cell_types.erase(type);
+		if (type.index_ < GetSize(fast_index))
+			fast_index[type.index_] = -1;
+	}
+
 	void clear()
 	{
 		cell_types.clear();
+		fast_index.clear();
+		fast_types.clear();
 	}
 
 	bool cell_known(RTLIL::IdString type) const
 	{
+		if (fast_type(type) != nullptr)
+			return true;
 		return cell_types.count(type) != 0;
 	}
 
 	bool cell_output(RTLIL::IdString type, RTLIL::IdString port) const
 	{
+		const FastCellType *fct = fast_type(type);
+		if (fct != nullptr) {
+			int bit = port_bit(port);
+			return bit >= 0 && ((fct->outputs >> bit) & 1) != 0;
+		}
 		auto it = cell_types.find(type);
 		return it != cell_types.end() && it->second.outputs.count(port) != 0;
 	}
 
 	bool cell_input(RTLIL::IdString type, RTLIL::IdString port) const
 	{
+		const FastCellType *fct = fast_type(type);
+		if (fct != nullptr) {
+			int bit = port_bit(port);
+			return bit >= 0 && ((fct->inputs >> bit) & 1) != 0;
+		}
 		auto it = cell_types.find(type);
 		return it != cell_types.end() && it->second.inputs.count(port) != 0;
 	}
 
 	bool cell_evaluable(RTLIL::IdString type) const
 	{
+		const FastCellType *fct = fast_type(type);
+		if (fct != nullptr)
+			return fct->is_evaluable;
 		auto it = cell_types.find(type);
 		return it != cell_types.end() && it->second.is_evaluable;
 	}
 
 	static RTLIL::Const eval_not(RTLIL::Const v)
 	{
-		for (auto &bit : v.bits)
+		for (auto &bit : v.bits())
 			if (bit == State::S0) bit = State::S1;
 			else if (bit == State::S1) bit = State::S0;
 		return v;
@@ -370,16 +482,14 @@ struct CellTypes
 	static RTLIL::Const eval(RTLIL::Cell *cell, const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool *errp = nullptr)
 	{
 		if (cell->type == ID($slice)) {
-			RTLIL::Const ret;
 			int width = cell->parameters.at(ID(Y_WIDTH)).as_int();
 			int offset = cell->parameters.at(ID(OFFSET)).as_int();
-			ret.bits.insert(ret.bits.end(), arg1.bits.begin()+offset, arg1.bits.begin()+offset+width);
-			return ret;
+			return arg1.extract(offset, width);
 		}
 
 		if (cell->type == ID($concat)) {
 			RTLIL::Const ret = arg1;
-			ret.bits.insert(ret.bits.end(), arg2.bits.begin(), arg2.bits.end());
+			ret.bits().insert(ret.bits().end(), arg2.begin(), arg2.end());
 			return ret;
 		}
 
@@ -387,13 +497,13 @@ struct CellTypes
 		{
 			int width = cell->parameters.at(ID(WIDTH)).as_int();
 
-			std::vector<RTLIL::State> t = cell->parameters.at(ID(LUT)).bits;
+			std::vector<RTLIL::State> t = cell->parameters.at(ID(LUT)).to_bits();
 			while (GetSize(t) < (1 << width))
 				t.push_back(State::S0);
 			t.resize(1 << width);
 
 			for (int i = width-1; i >= 0; i--) {
-				RTLIL::State sel = arg1.bits.at(i);
+				RTLIL::State sel = arg1[i];
 				std::vector<RTLIL::State> new_t;
 				if (sel == State::S0)
 					new_t = std::vector<RTLIL::State>(t.begin(), t.begin() + GetSize(t)/2);
@@ -413,7 +523,7 @@ struct CellTypes
 		{
 			int width = cell->parameters.at(ID(WIDTH)).as_int();
 			int depth = cell->parameters.at(ID(DEPTH)).as_int();
-			std::vector<RTLIL::State> t = cell->parameters.at(ID(TABLE)).bits;
+			std::vector<RTLIL::State> t = cell->parameters.at(ID(TABLE)).to_bits();
 
 			while (GetSize(t) < width*depth*2)
 				t.push_back(State::S0);
@@ -426,7 +536,7 @@ struct CellTypes
 				bool match_x = true;
 
 				for (int j = 0; j < width; j++) {
-					RTLIL::State a = arg1.bits.at(j);
+					RTLIL::State a = arg1[j];
 					if (t.at(2*width*i + 2*j + 0) == State::S1) {
 						if (a == State::S1) match_x = false;
 						if (a != State::S0) match = false;
@@ -457,11 +567,9 @@ struct CellTypes
 	{
 		if (cell->type.in(ID($mux), ID($pmux), ID($_MUX_))) {
 			RTLIL::Const ret = arg1;
-			for (size_t i = 0; i < arg3.bits.size(); i++)
-				if (arg3.bits[i] == RTLIL::State::S1) {
-					std::vector<RTLIL::State> bits(arg2.bits.begin() + i*arg1.bits.size(), arg2.bits.begin() + (i+1)*arg1.bits.size());
-					ret = RTLIL::Const(bits);
-				}
+			for (int i = 0; i < arg3.size(); i++)
+				if (arg3[i] == RTLIL::State::S1)
+					ret = arg2.extract(i*arg1.size(), arg1.size());
 			return ret;
 		}
 
@@ -470,7 +578,7 @@ struct CellTypes
 		if (cell->type == ID($_OAI3_))
 			return eval_not(const_and(const_or(arg1, arg2, false, false, 1), arg3, false, false, 1));
 
-		log_assert(arg3.bits.size() == 0);
+		log_assert(arg3.size() == 0);
 		return eval(cell, arg1, arg2, errp);
 	}
 
@@ -481,7 +589,7 @@ struct CellTypes
 		if (cell->type == ID($_OAI4_))
 			return eval_not(const_and(const_or(arg1, arg2, false, false, 1), const_or(arg3, arg4, false, false, 1), false, false, 1));
 
-		log_assert(arg4.bits.size() == 0);
+		log_assert(arg4.size() == 0);
 		return eval(cell, arg1, arg2, arg3, errp);
 	}
 };
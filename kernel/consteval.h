@@ -76,7 +76,7 @@ struct ConstEval
 #ifndef NDEBUG
 		RTLIL::SigSpec current_val = values_map(sig);
 		for (int i = 0; i < GetSize(current_val); i++)
-			log_assert(current_val[i].wire != NULL || current_val[i] == value.bits[i]);
+			log_assert(current_val[i].wire != NULL || current_val[i] == value[i]);
 #endif
 		values_map.add(sig, RTLIL::SigSpec(value));
 	}
@@ -115,7 +115,7 @@ struct ConstEval
 
 				for (int i = 0; i < GetSize(coval); i++) {
 					carry = (sig_g[i] == State::S1) || (sig_p[i] == RTLIL::S1 && carry);
-					coval.bits[i] = carry ? State::S1 : State::S0;
+					coval.bits()[i] = carry ? State::S1 : State::S0;
 				}
 
 				set(sig_co, coval);
@@ -153,7 +153,7 @@ struct ConstEval
 
 			for (int i = 0; i < sig_s.size(); i++)
 			{
-				RTLIL::State s_bit = sig_s.extract(i, 1).as_const().bits.at(0);
+				RTLIL::State s_bit = sig_s.extract(i, 1).as_const()[0];
 				RTLIL::SigSpec b_slice = sig_b.extract(sig_y.size()*i, sig_y.size());
 
 				if (s_bit == RTLIL::State::Sx || s_bit == RTLIL::State::S1)
@@ -183,10 +183,10 @@ struct ConstEval
 
 			if (y_values.size() > 1)
 			{
-				std::vector<RTLIL::State> master_bits = y_values.at(0).bits;
+				std::vector<RTLIL::State> master_bits = y_values.at(0).to_bits();
 
 				for (size_t i = 1; i < y_values.size(); i++) {
-					std::vector<RTLIL::State> &slave_bits = y_values.at(i).bits;
+					std::vector<RTLIL::State> &slave_bits = y_values.at(i).bits();
 					log_assert(master_bits.size() == slave_bits.size());
 					for (size_t j = 0; j < master_bits.size(); j++)
 						if (master_bits[j] != slave_bits[j])
@@ -221,8 +221,8 @@ struct ConstEval
 			RTLIL::Const val_x = const_or(t2, t3, false, false, width);
 
 			for (int i = 0; i < GetSize(val_y); i++)
-				if (val_y.bits[i] == RTLIL::Sx)
-					val_x.bits[i] = RTLIL::Sx;
+				if (val_y[i] == RTLIL::Sx)
+					val_x.bits()[i] = RTLIL::Sx;
 
 			set(sig_y, val_y);
 			set(sig_x, val_x);
@@ -393,6 +393,481 @@ struct ConstEval
 	}
 };
 
+// Evaluates the logic between a fixed set of input signals and a fixed set of
+// output signals for 64 input assignments at once. Every net is a pair of 64
+// bit words, the values and a mask of the lanes in which the value is
+// defined. setup() sorts the cells between the inputs and the outputs once,
+// run() then evaluates them in that order without the per-assignment
+// hashing of ConstEval. The results are the same as ConstEval gives for
+// each lane, except that 'z' is treated as 'x'.
+//
+// Bitwise cells, muxes and reductions are evaluated for all lanes together,
+// the other cells CellTypes::eval() supports are evaluated lane by lane.
+// setup() fails if the outputs depend on a combinational loop or on a cell
+// that can not be evaluated (e.g. $alu or $macc), in that case ConstEval has
+// to be used. Nets the outputs depend on that are neither inputs nor driven
+// by a cell, or that are marked with stop(), are 'x' and are listed in
+// free_signals.
+
+struct ConstEvalBatch
+{
+	typedef uint64_t word_t;
+
+	enum cell_kind_t {
+		KIND_BUF, KIND_NOT, KIND_AND, KIND_OR, KIND_XOR, KIND_MUX,
+		KIND_REDUCE_AND, KIND_REDUCE_OR, KIND_REDUCE_XOR, KIND_LOGIC_AND, KIND_LOGIC_OR,
+		KIND_AOI3, KIND_OAI3, KIND_AOI4, KIND_OAI4, KIND_GENERIC
+	};
+
+	struct cell_entry_t {
+		RTLIL::Cell *cell;
+		cell_kind_t kind;
+		bool invert_y, invert_b;
+		std::vector<int> a, b, c, d, s, y;
+	};
+
+	RTLIL::Module *module;
+	SigMap assign_map;
+	CellTypes ct;
+	dict<RTLIL::SigBit, RTLIL::Cell*> sig2driver;
+	SigPool stop_signals;
+
+	dict<RTLIL::SigBit, int> slot_index;
+	std::vector<word_t> values, defined;
+	std::vector<cell_entry_t> order;
+	std::vector<int> input_slots, output_slots;
+	RTLIL::SigSpec free_signals;
+
+	// slots for the constants 0, 1 and x
+	enum { SLOT_S0 = 0, SLOT_S1 = 1, SLOT_SX = 2 };
+
+	ConstEvalBatch(RTLIL::Module *module) : module(module), assign_map(module)
+	{
+		ct.setup_internals();
+		ct.setup_stdcells();
+
+		for (auto cell : module->cells())
+			if (ct.cell_known(cell->type))
+				for (auto &conn : cell->connections())
+					if (ct.cell_output(cell->type, conn.first))
+						for (auto bit : assign_map(conn.second))
+							if (bit.wire != nullptr)
+								sig2driver[bit] = cell;
+	}
+
+	void stop(RTLIL::SigSpec sig)
+	{
+		assign_map.apply(sig);
+		stop_signals.add(sig);
+	}
+
+	// lane i has bit 'bit' of the number base+i, for enumerating assignments
+	static word_t count_pattern(int base, int bit)
+	{
+		word_t word = 0;
+		for (int lane = 0; lane < 64; lane++)
+			if (((base + lane) >> bit) & 1)
+				word |= word_t(1) << lane;
+		return word;
+	}
+
+	static bool cell_supported(RTLIL::IdString type)
+	{
+		if (type.in(ID($slice), ID($concat), ID($lut), ID($sop), ID($mux), ID($pmux), ID($_MUX_), ID($_NMUX_),
+				ID($_AOI3_), ID($_OAI3_), ID($_AOI4_), ID($_OAI4_)))
+			return true;
+		bool err = false;
+		CellTypes::eval(type, RTLIL::Const(State::S0, 1), RTLIL::Const(State::S0, 1), false, false, 1, &err);
+		return !err;
+	}
+
+	int slot(RTLIL::SigBit bit)
+	{
+		if (bit.wire == nullptr)
+			return bit.data == State::S0 ? SLOT_S0 : bit.data == State::S1 ? SLOT_S1 : SLOT_SX;
+		auto it = slot_index.find(bit);
+		if (it != slot_index.end())
+			return it->second;
+		int idx = GetSize(values);
+		slot_index[bit] = idx;
+		values.push_back(0);
+		defined.push_back(0);
+		return idx;
+	}
+
+	std::vector<int> slots(RTLIL::SigSpec sig)
+	{
+		std::vector<int> result;
+		for (auto bit : assign_map(sig))
+			result.push_back(slot(bit));
+		return result;
+	}
+
+	std::vector<int> port_slots(RTLIL::Cell *cell, RTLIL::IdString port, int width = -1, bool is_signed = false)
+	{
+		if (!cell->hasPort(port))
+			return std::vector<int>();
+		RTLIL::SigSpec sig = cell->getPort(port);
+		if (width >= 0)
+			sig.extend_u0(width, is_signed);
+		return slots(sig);
+	}
+
+	void add_cell(RTLIL::Cell *cell)
+	{
+		cell_entry_t entry;
+		entry.cell = cell;
+		entry.kind = KIND_GENERIC;
+		entry.invert_y = cell->type.in(ID($not), ID($_NOT_), ID($xnor), ID($_XNOR_), ID($_NAND_), ID($_NOR_), ID($_NMUX_),
+				ID($reduce_xnor), ID($logic_not));
+		entry.invert_b = cell->type.in(ID($_ANDNOT_), ID($_ORNOT_));
+
+		RTLIL::IdString type = cell->type;
+		int width = GetSize(cell->getPort(ID::Y));
+		bool signed_a = cell->parameters.count(ID(A_SIGNED)) && cell->parameters.at(ID(A_SIGNED)).as_bool();
+		bool signed_b = cell->parameters.count(ID(B_SIGNED)) && cell->parameters.at(ID(B_SIGNED)).as_bool();
+
+		if (type.in(ID($pos), ID($_BUF_)))
+			entry.kind = KIND_BUF;
+		if (type.in(ID($not), ID($_NOT_)))
+			entry.kind = KIND_NOT;
+		if (type.in(ID($and), ID($_AND_), ID($_NAND_), ID($_ANDNOT_)))
+			entry.kind = KIND_AND;
+		if (type.in(ID($or), ID($_OR_), ID($_NOR_), ID($_ORNOT_)))
+			entry.kind = KIND_OR;
+		if (type.in(ID($xor), ID($xnor), ID($_XOR_), ID($_XNOR_)))
+			entry.kind = KIND_XOR;
+		if (type.in(ID($mux), ID($pmux), ID($_MUX_), ID($_NMUX_)))
+			entry.kind = KIND_MUX;
+		if (type == ID($reduce_and))
+			entry.kind = KIND_REDUCE_AND;
+		if (type.in(ID($reduce_or), ID($reduce_bool), ID($logic_not)))
+			entry.kind = KIND_REDUCE_OR;
+		if (type.in(ID($reduce_xor), ID($reduce_xnor)))
+			entry.kind = KIND_REDUCE_XOR;
+		if (type == ID($logic_and))
+			entry.kind = KIND_LOGIC_AND;
+		if (type == ID($logic_or))
+			entry.kind = KIND_LOGIC_OR;
+		if (type == ID($_AOI3_))
+			entry.kind = KIND_AOI3;
+		if (type == ID($_OAI3_))
+			entry.kind = KIND_OAI3;
+		if (type == ID($_AOI4_))
+			entry.kind = KIND_AOI4;
+		if (type == ID($_OAI4_))
+			entry.kind = KIND_OAI4;
+
+		if (entry.kind == KIND_BUF || entry.kind == KIND_NOT || entry.kind == KIND_AND || entry.kind == KIND_OR || entry.kind == KIND_XOR) {
+			entry.a = port_slots(cell, ID::A, width, signed_a);
+			entry.b = port_slots(cell, ID::B, width, signed_b);
+		} else {
+			entry.a = port_slots(cell, ID::A);
+			entry.b = port_slots(cell, ID::B);
+			entry.c = port_slots(cell, ID(C));
+			entry.d = port_slots(cell, ID(D));
+			entry.s = port_slots(cell, ID(S));
+		}
+		entry.y = port_slots(cell, ID::Y);
+
+		order.push_back(entry);
+	}
+
+	// prepares the evaluation of the outputs from the inputs, returns false if
+	// this is not possible (see above)
+	bool setup(RTLIL::SigSpec inputs, RTLIL::SigSpec outputs)
+	{
+		slot_index.clear();
+		values = { 0, ~word_t(0), 0 };
+		defined = { ~word_t(0), ~word_t(0), 0 };
+		order.clear();
+		free_signals = RTLIL::SigSpec();
+
+		input_slots = slots(inputs);
+		output_slots = slots(outputs);
+
+		pool<RTLIL::SigBit> input_bits;
+		for (auto bit : assign_map(inputs))
+			input_bits.insert(bit);
+
+		// depth-first search from the outputs, cells are added to the
+		// order after all cells driving their inputs
+		dict<RTLIL::Cell*, bool> cell_done;
+		pool<RTLIL::SigBit> visited_bits;
+		std::vector<std::pair<RTLIL::Cell*, std::vector<RTLIL::SigBit>>> stack;
+
+		auto visit_bit = [&](RTLIL::SigBit bit) -> bool {
+			if (bit.wire == nullptr || input_bits.count(bit) || visited_bits.count(bit))
+				return true;
+			visited_bits.insert(bit);
+			auto it = sig2driver.find(bit);
+			if (it == sig2driver.end() || stop_signals.check(bit)) {
+				free_signals.append(bit);
+				return true;
+			}
+			RTLIL::Cell *cell = it->second;
+			if (cell_done.count(cell))
+				return cell_done.at(cell);
+			if (!cell->hasPort(ID::Y) || GetSize(cell->getPort(ID::Y)) == 0 || !cell_supported(cell->type))
+				return false;
+			std::vector<RTLIL::SigBit> cell_inputs;
+			for (auto &conn : cell->connections())
+				if (ct.cell_input(cell->type, conn.first))
+					for (auto b : assign_map(conn.second))
+						cell_inputs.push_back(b);
+			std::reverse(cell_inputs.begin(), cell_inputs.end());
+			cell_done[cell] = false;
+			stack.push_back(std::make_pair(cell, cell_inputs));
+			return true;
+		};
+
+		for (auto bit : assign_map(outputs))
+		{
+			if (!visit_bit(bit))
+				return false;
+
+			while (!stack.empty())
+			{
+				auto &top = stack.back();
+				if (top.second.empty()) {
+					RTLIL::Cell *cell = top.first;
+					stack.pop_back();
+					cell_done[cell] = true;
+					add_cell(cell);
+					continue;
+				}
+
+				RTLIL::SigBit next_bit = top.second.back();
+				top.second.pop_back();
+
+				// a cell that is visited but not done is on the stack (loop)
+				if (!visit_bit(next_bit))
+					return false;
+			}
+		}
+
+		free_signals.sort_and_unify();
+		return true;
+	}
+
+	void set_input(int idx, word_t value, word_t def = ~word_t(0))
+	{
+		int s = input_slots.at(idx);
+		values[s] = value & def;
+		defined[s] = def;
+	}
+
+	void get_output(int idx, word_t &value, word_t &def) const
+	{
+		int s = output_slots.at(idx);
+		value = values[s];
+		def = defined[s];
+	}
+
+	// lane by lane access to the inputs and outputs
+	void set_input_lane(int lane, const RTLIL::Const &value)
+	{
+		word_t mask = word_t(1) << lane;
+		for (int i = 0; i < GetSize(input_slots); i++) {
+			int s = input_slots[i];
+			RTLIL::State bit = i < GetSize(value) ? value[i] : State::S0;
+			values[s] = bit == State::S1 ? values[s] | mask : values[s] & ~mask;
+			defined[s] = bit == State::S0 || bit == State::S1 ? defined[s] | mask : defined[s] & ~mask;
+		}
+	}
+
+	RTLIL::Const get_output_lane(int lane) const
+	{
+		RTLIL::Const result(State::Sx, GetSize(output_slots));
+		for (int i = 0; i < GetSize(output_slots); i++) {
+			int s = output_slots[i];
+			if ((defined[s] >> lane) & 1)
+				result.bits()[i] = (values[s] >> lane) & 1 ? State::S1 : State::S0;
+		}
+		return result;
+	}
+
+	RTLIL::Const get_lane(const std::vector<int> &sig_slots, int lane) const
+	{
+		RTLIL::Const result(State::Sx, GetSize(sig_slots));
+		for (int i = 0; i < GetSize(sig_slots); i++) {
+			int s = sig_slots[i];
+			if ((defined[s] >> lane) & 1)
+				result.bits()[i] = (values[s] >> lane) & 1 ? State::S1 : State::S0;
+		}
+		return result;
+	}
+
+	void set_result(int s, word_t value, word_t def)
+	{
+		defined[s] = def;
+		values[s] = value & def;
+	}
+
+	// four-valued operations on (value, defined) pairs
+	static void op_and(word_t va, word_t da, word_t vb, word_t db, word_t &v, word_t &d)
+	{
+		d = (da & db) | (da & ~va) | (db & ~vb);
+		v = va & vb;
+	}
+
+	static void op_or(word_t va, word_t da, word_t vb, word_t db, word_t &v, word_t &d)
+	{
+		d = (da & db) | va | vb;
+		v = va | vb;
+	}
+
+	void reduce(const std::vector<int> &sig_slots, cell_kind_t kind, word_t &v, word_t &d) const
+	{
+		if (kind == KIND_REDUCE_AND)
+			v = ~word_t(0), d = ~word_t(0);
+		else
+			v = 0, d = ~word_t(0);
+		for (int s : sig_slots) {
+			if (kind == KIND_REDUCE_AND)
+				op_and(v, d, values[s], defined[s], v, d);
+			else if (kind == KIND_REDUCE_OR)
+				op_or(v, d, values[s], defined[s], v, d);
+			else
+				v ^= values[s], d &= defined[s];
+		}
+		v &= d;
+	}
+
+	void eval_cell(const cell_entry_t &entry)
+	{
+		word_t v = 0, d = 0, v2, d2;
+
+		switch (entry.kind)
+		{
+		case KIND_BUF:
+		case KIND_NOT:
+		case KIND_AND:
+		case KIND_OR:
+		case KIND_XOR:
+			for (int i = 0; i < GetSize(entry.y); i++) {
+				word_t va = values[entry.a[i]], da = defined[entry.a[i]];
+				if (entry.kind == KIND_BUF || entry.kind == KIND_NOT) {
+					v = va, d = da;
+				} else {
+					word_t vb = values[entry.b[i]], db = defined[entry.b[i]];
+					if (entry.invert_b)
+						vb = ~vb & db;
+					if (entry.kind == KIND_AND)
+						op_and(va, da, vb, db, v, d);
+					else if (entry.kind == KIND_OR)
+						op_or(va, da, vb, db, v, d);
+					else
+						v = va ^ vb, d = da & db;
+				}
+				set_result(entry.y[i], entry.invert_y ? ~v : v, d);
+			}
+			return;
+
+		case KIND_MUX:
+		{
+			// the inputs selected in a lane are the B inputs whose S bit is
+			// 1 or x and the A input unless an S bit is 1, the result is x
+			// where they differ
+			int width = GetSize(entry.y);
+			word_t any_s1 = 0;
+			for (int s : entry.s)
+				any_s1 |= values[s];
+			for (int i = 0; i < width; i++) {
+				word_t seen0 = 0, seen1 = 0, seenx = 0;
+				auto add_input = [&](word_t m, int s) {
+					seen0 |= m & defined[s] & ~values[s];
+					seen1 |= m & values[s];
+					seenx |= m & ~defined[s];
+				};
+				add_input(~any_s1, entry.a[i]);
+				for (int j = 0; j < GetSize(entry.s); j++) {
+					int s = entry.s[j];
+					add_input(values[s] | ~defined[s], entry.b[j*width + i]);
+				}
+				d = ~seenx & ~(seen0 & seen1);
+				v = seen1;
+				set_result(entry.y[i], entry.invert_y ? ~v : v, d);
+			}
+			return;
+		}
+
+		case KIND_REDUCE_AND:
+		case KIND_REDUCE_OR:
+		case KIND_REDUCE_XOR:
+			reduce(entry.a, entry.kind, v, d);
+			break;
+
+		case KIND_LOGIC_AND:
+		case KIND_LOGIC_OR:
+			reduce(entry.a, KIND_REDUCE_OR, v, d);
+			reduce(entry.b, KIND_REDUCE_OR, v2, d2);
+			if (entry.kind == KIND_LOGIC_AND)
+				op_and(v, d, v2, d2, v, d);
+			else
+				op_or(v, d, v2, d2, v, d);
+			break;
+
+		case KIND_AOI3:
+		case KIND_OAI3:
+		case KIND_AOI4:
+		case KIND_OAI4:
+		{
+			word_t va = values[entry.a[0]], da = defined[entry.a[0]];
+			word_t vb = values[entry.b[0]], db = defined[entry.b[0]];
+			word_t vc = values[entry.c[0]], dc = defined[entry.c[0]];
+			word_t vd = ~word_t(0), dd = ~word_t(0);
+			if (!entry.d.empty())
+				vd = values[entry.d[0]], dd = defined[entry.d[0]];
+			if (entry.kind == KIND_AOI3 || entry.kind == KIND_AOI4) {
+				op_and(va, da, vb, db, v, d);
+				if (entry.kind == KIND_AOI4)
+					op_and(vc, dc, vd, dd, vc, dc);
+				op_or(v, d, vc, dc, v, d);
+			} else {
+				op_or(va, da, vb, db, v, d);
+				if (entry.kind == KIND_OAI4)
+					op_or(vc, dc, vd, dd, vc, dc);
+				op_and(v, d, vc, dc, v, d);
+			}
+			set_result(entry.y[0], ~v, d);
+			return;
+		}
+
+		case KIND_GENERIC:
+		{
+			std::vector<word_t> y_values(GetSize(entry.y)), y_defined(GetSize(entry.y));
+			for (int lane = 0; lane < 64; lane++) {
+				bool err = false;
+				RTLIL::Const y = CellTypes::eval(entry.cell, get_lane(entry.a, lane), get_lane(entry.b, lane),
+						get_lane(entry.c, lane), get_lane(entry.d, lane), &err);
+				log_assert(!err);
+				for (int i = 0; i < GetSize(entry.y) && i < GetSize(y); i++) {
+					if (y[i] == State::S1)
+						y_values[i] |= word_t(1) << lane;
+					if (y[i] == State::S0 || y[i] == State::S1)
+						y_defined[i] |= word_t(1) << lane;
+				}
+			}
+			for (int i = 0; i < GetSize(entry.y); i++)
+				set_result(entry.y[i], y_values[i], y_defined[i]);
+			return;
+		}
+		}
+
+		// cells with a one bit result, the other bits of Y are zero
+		set_result(entry.y[0], entry.invert_y ? ~v : v, d);
+		for (int i = 1; i < GetSize(entry.y); i++)
+			set_result(entry.y[i], 0, ~word_t(0));
+	}
+
+	void run()
+	{
+		for (auto &entry : order)
+			eval_cell(entry);
+	}
+};
+
 YOSYS_NAMESPACE_END
 
 #endif
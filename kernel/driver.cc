@@ -189,11 +189,13 @@ int main(int argc, char **argv)
 	std::string output_filename = "";
 	std::string scriptfile = "";
 	std::string depsfile = "";
+	std::string perffile = "";
 	bool scriptfile_tcl = false;
 	bool got_output_filename = false;
 	bool print_banner = true;
 	bool print_stats = true;
 	bool call_abort = false;
+	bool async_log = false;
 	bool timing_details = false;
 	bool mode_v = false;
 	bool mode_q = false;
@@ -228,9 +230,20 @@ int main(int argc, char **argv)
 		printf("    -t\n");
 		printf("        annotate all log messages with a time stamp\n");
 		printf("\n");
+		printf("    -a\n");
+		printf("        write the log messages to the console and log files from a\n");
+		printf("        background thread, this makes passes that print many messages\n");
+		printf("        faster\n");
+		printf("\n");
 		printf("    -d\n");
 		printf("        print more detailed timing stats at exit\n");
 		printf("\n");
+		printf("    -B <perffile>\n");
+		printf("        write a profile of all commands to the specified file at exit. it\n");
+		printf("        has the run time, allocation count, peak memory growth and change\n");
+		printf("        in cell and wire count of every call, nested calls included, in\n");
+		printf("        the Chrome trace event format, and a summary for each command\n");
+		printf("\n");
 		printf("    -l logfile\n");
 		printf("        write log messages to the specified file\n");
 		printf("\n");
@@ -301,6 +314,12 @@ int main(int argc, char **argv)
 		printf("    -g\n");
 		printf("        globally enable debug log messages\n");
 		printf("\n");
+		printf("    -j <threads>\n");
+		printf("        use up to the specified number of threads for passes that run work\n");
+		printf("        concurrently, all passes share one pool of worker threads. the\n");
+		printf("        default is taken from the YOSYS_THREADS environment variable, or 1\n");
+		printf("        if it is not set\n");
+		printf("\n");
 		printf("    -V\n");
 		printf("        print version information and exit\n");
 		printf("\n");
@@ -326,8 +345,11 @@ int main(int argc, char **argv)
 		exit(0);
 	}
 
+	if (getenv("YOSYS_THREADS") != NULL)
+		yosys_threads = std::max(atoi(getenv("YOSYS_THREADS")), 1);
+
 	int opt;
-	while ((opt = getopt(argc, argv, "MXAQTVSgm:f:Hh:b:o:p:l:L:qv:tds:c:W:w:e:D:P:E:x:")) != -1)
+	while ((opt = getopt(argc, argv, "MXAQTVSagm:f:Hh:b:o:p:l:L:qv:tds:c:W:w:e:D:P:E:x:j:B:")) != -1)
 	{
 		switch (opt)
 		{
@@ -461,6 +483,20 @@ int main(int argc, char **argv)
 		case 'x':
 			log_experimentals_ignored.insert(optarg);
 			break;
+		case 'j':
+			yosys_threads = atoi(optarg);
+			if (yosys_threads < 1) {
+				fprintf(stderr, "Invalid number of threads for -j: %s\n", optarg);
+				exit(1);
+			}
+			break;
+		case 'B':
+			perffile = optarg;
+			pass_profile_on();
+			break;
+		case 'a':
+			async_log = true;
+			break;
 		default:
 			fprintf(stderr, "Run '%s -h' for help.\n", argv[0]);
 			exit(1);
@@ -472,6 +508,9 @@ int main(int argc, char **argv)
 		log_error_stderr = true;
 	}
 
+	if (async_log)
+		log_async_start();
+
 	if (print_banner)
 		yosys_banner();
 
@@ -637,6 +676,14 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (!perffile.empty())
+	{
+		std::ofstream f(perffile.c_str());
+		if (f.fail())
+			log_error("Can't open performance data file for writing: %s\n", strerror(errno));
+		pass_profile_write(f);
+	}
+
 #if defined(YOSYS_ENABLE_COVER) && (defined(__linux__) || defined(__FreeBSD__))
 	if (getenv("YOSYS_COVER_DIR") || getenv("YOSYS_COVER_FILE"))
 	{
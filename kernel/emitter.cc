@@ -0,0 +1,115 @@
+/* -*- c++ -*-
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "kernel/emitter.h"
+#include "kernel/threadpool.h"
+#include "libs/sha1/sha1.h"
+#include <sys/stat.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#  include <process.h>
+#else
+#  include <unistd.h>
+#endif
+
+YOSYS_NAMESPACE_BEGIN
+
+void emit_modules(std::ostream &f, const std::vector<RTLIL::Module*> &modules, int num_threads,
+		const std::function<void(EmitBuffer&, RTLIL::Module*)> &render)
+{
+	// the buffers must outlive the tasks
+	std::vector<EmitBuffer> buffers;
+	TaskGroup group(std::max(std::min(num_threads, GetSize(modules)), 1));
+
+	if (group.concurrent())
+	{
+		buffers.resize(GetSize(modules));
+		for (int i = 0; i < GetSize(modules); i++)
+			group.run([&, i]() { render(buffers[i], modules[i]); });
+
+		// write each buffer as soon as all modules up to it are done
+		for (int i = 0; i < GetSize(modules); i++) {
+			group.wait(i);
+			f.write(buffers[i].text.data(), buffers[i].text.size());
+			std::string().swap(buffers[i].text);
+		}
+		return;
+	}
+
+	for (auto module : modules) {
+		EmitBuffer buffer(&f);
+		render(buffer, module);
+	}
+}
+
+EmitCache::EmitCache(const std::string &dir, const std::string &suffix) : dir(dir), suffix(suffix)
+{
+	if (dir.empty())
+		return;
+
+	struct stat st;
+#ifdef _WIN32
+	if (stat(dir.c_str(), &st) != 0 && mkdir(dir.c_str()) != 0)
+#else
+	if (stat(dir.c_str(), &st) != 0 && mkdir(dir.c_str(), 0777) != 0)
+#endif
+		log_cmd_error("Can't create directory `%s': %s\n", dir.c_str(), strerror(errno));
+}
+
+std::string EmitCache::key(const std::vector<std::string> &inputs)
+{
+	std::string str = yosys_version_str;
+	for (auto &input : inputs) {
+		str += '\0';
+		str += input;
+	}
+	return sha1(str);
+}
+
+bool EmitCache::load(const std::string &key, EmitBuffer &buf) const
+{
+	std::ifstream f(dir + "/" + key + suffix, std::ifstream::binary);
+	if (f.fail())
+		return false;
+	std::stringstream text;
+	text << f.rdbuf();
+	if (f.bad())
+		return false;
+	buf << text.str();
+	return true;
+}
+
+void EmitCache::store(const std::string &key, const std::string &text) const
+{
+	// write to a temporary file first so that concurrent yosys processes
+	// never see a partially written file
+	std::string filename = dir + "/" + key + suffix;
+	std::string tmp_filename = stringf("%s.%d.tmp", filename.c_str(), int(getpid()));
+	std::ofstream f(tmp_filename.c_str(), std::ofstream::binary);
+	f.write(text.data(), text.size());
+	f.close();
+	if (f.fail() || rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+		log_warning("Can't write cache file `%s': %s\n", filename.c_str(), strerror(errno));
+		remove(tmp_filename.c_str());
+	}
+}
+
+YOSYS_NAMESPACE_END
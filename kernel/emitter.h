@@ -0,0 +1,154 @@
+/* -*- c++ -*-
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef EMITTER_H
+#define EMITTER_H
+
+#include "kernel/yosys.h"
+#include <deque>
+
+YOSYS_NAMESPACE_BEGIN
+
+// Text buffer for the backends that render modules one by one (write_blif,
+// write_edif, write_ilang, write_firrtl, ...).
+// With a sink, the text is handed to the stream in blocks of block_size bytes,
+// without one the buffer keeps all text, e.g. for rendering a module on a
+// worker thread.
+struct EmitBuffer
+{
+	std::ostream *sink;
+	std::string text;
+
+	static const size_t block_size = 1 << 16;
+
+	explicit EmitBuffer(std::ostream *sink = nullptr) : sink(sink)
+	{
+		if (sink)
+			text.reserve(block_size + 256);
+	}
+
+	~EmitBuffer()
+	{
+		flush();
+	}
+
+	void flush()
+	{
+		if (sink && !text.empty()) {
+			sink->write(text.data(), text.size());
+			text.clear();
+		}
+	}
+
+	void check_flush()
+	{
+		if (sink && text.size() >= block_size)
+			flush();
+	}
+
+	EmitBuffer &operator<<(const std::string &str)
+	{
+		text += str;
+		check_flush();
+		return *this;
+	}
+
+	EmitBuffer &operator<<(const char *str)
+	{
+		text += str;
+		check_flush();
+		return *this;
+	}
+
+	EmitBuffer &operator<<(char c)
+	{
+		text += c;
+		return *this;
+	}
+
+	EmitBuffer &operator<<(int x)
+	{
+		char digits[16];
+		int n = 0;
+		unsigned int v = x < 0 ? -(unsigned int)x : x;
+		do {
+			digits[n++] = '0' + v % 10;
+			v /= 10;
+		} while (v != 0);
+		if (x < 0)
+			text += '-';
+		while (n > 0)
+			text += digits[--n];
+		return *this;
+	}
+};
+
+// Escaped names, computed once per key. The strings are never moved, so the
+// references (and c_str() pointers) stay valid while more names are added.
+template<typename K>
+struct EmitNames
+{
+	std::function<std::string(const K&)> escape;
+	dict<K, int> index;
+	std::deque<std::string> names;
+
+	EmitNames(std::function<std::string(const K&)> escape) : escape(escape) { }
+
+	const std::string &operator()(const K &key)
+	{
+		auto it = index.find(key);
+		if (it != index.end())
+			return names[it->second];
+		names.push_back(escape(key));
+		index[key] = GetSize(names) - 1;
+		return names.back();
+	}
+};
+
+// Renders every module with render() and writes the text to f in the order
+// of the modules. With num_threads > 1 the modules are rendered into separate
+// buffers on worker threads, each buffer is written as soon as all modules
+// before it are done. Log output of render() is captured and replayed in
+// module order, like in ModulePass.
+void emit_modules(std::ostream &f, const std::vector<RTLIL::Module*> &modules, int num_threads,
+		const std::function<void(EmitBuffer&, RTLIL::Module*)> &render);
+
+// Directory with module text rendered by earlier runs, for the -cache option
+// of write_firrtl and write_smv. A file is named after the digest of all
+// inputs of the rendering, so it is never stale and the directory can be
+// shared between designs and yosys processes. Without a directory the cache
+// is disabled.
+struct EmitCache
+{
+	std::string dir, suffix;
+
+	EmitCache(const std::string &dir, const std::string &suffix);
+
+	bool enabled() const { return !dir.empty(); }
+
+	static std::string key(const std::vector<std::string> &inputs);
+
+	// append the cached text to buf, returns false if there is none
+	bool load(const std::string &key, EmitBuffer &buf) const;
+	void store(const std::string &key, const std::string &text) const;
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
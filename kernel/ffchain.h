@@ -0,0 +1,116 @@
+/* -*- c++ -*-
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef FFCHAIN_H
+#define FFCHAIN_H
+
+#include "kernel/yosys.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// Chains of single-bit flip-flops, where the Q output of each flip-flop drives
+// the D input of the next one. The flip-flops are numbered in the order in
+// which they are added, and the links are kept in dense arrays, so that all
+// chains can be walked in linear time without further SigMap or dict lookups.
+//
+// The D and Q bits passed to add() must already be mapped with the SigMap of
+// the module. After all flip-flops are added, link() connects them.
+struct FfChainIndex
+{
+	std::vector<RTLIL::Cell*> cells;
+	std::vector<RTLIL::SigBit> d_bits, q_bits;
+
+	// next[i] is the flip-flop whose D input is driven by flip-flop i, and
+	// prev[i] the flip-flop driving the D input of flip-flop i, or -1
+	std::vector<int> next, prev;
+
+	int add(RTLIL::Cell *cell, RTLIL::SigBit d_bit, RTLIL::SigBit q_bit)
+	{
+		cells.push_back(cell);
+		d_bits.push_back(d_bit);
+		q_bits.push_back(q_bit);
+		return GetSize(cells)-1;
+	}
+
+	// Links each flip-flop i to the first added flip-flop j reading its Q
+	// output, if can_link(i, j) is true. Flip-flops that share their D input
+	// with an earlier one are never linked to a predecessor, so they start
+	// chains of their own.
+	template<typename F>
+	void link(F can_link)
+	{
+		int n = GetSize(cells);
+		next.assign(n, -1);
+		prev.assign(n, -1);
+
+		dict<RTLIL::SigBit, int> first_reader;
+		first_reader.reserve(n);
+		for (int i = 0; i < n; i++)
+			first_reader.insert(std::make_pair(d_bits[i], i));
+
+		for (int i = 0; i < n; i++) {
+			auto it = first_reader.find(q_bits[i]);
+			if (it == first_reader.end())
+				continue;
+			int j = it->second;
+			if (prev[j] >= 0 || !can_link(i, j))
+				continue;
+			next[i] = j;
+			prev[j] = i;
+		}
+	}
+
+	// The flip-flops without a predecessor, in the order they were added.
+	// Flip-flops on a ring are not in any chain that starts here.
+	std::vector<int> chain_starts() const
+	{
+		std::vector<int> starts;
+		for (int i = 0; i < GetSize(cells); i++)
+			if (prev[i] < 0)
+				starts.push_back(i);
+		return starts;
+	}
+
+	// The flip-flops from start to the end of its chain, following next[]
+	// (or prev[] if backwards is set)
+	std::vector<int> chain(int start, bool backwards = false) const
+	{
+		const std::vector<int> &links = backwards ? prev : next;
+		std::vector<int> result;
+		for (int i = start; i >= 0; i = links[i]) {
+			result.push_back(i);
+			if (links[i] == start)
+				break;
+		}
+		return result;
+	}
+
+	void clear()
+	{
+		cells.clear();
+		d_bits.clear();
+		q_bits.clear();
+		next.clear();
+		prev.clear();
+	}
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
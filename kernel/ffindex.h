@@ -0,0 +1,199 @@
+/* -*- c++ -*-
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef FFINDEX_H
+#define FFINDEX_H
+
+#include "kernel/yosys.h"
+#include "kernel/sigtools.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// The lookups that the flip-flop passes (dff2dffe, opt_rmdff, dffsr2dff, zinit)
+// need about a module, built in one pass over its wires and cells: the init
+// values of all bits, the driver and the number of users of each bit, the
+// multiplexer driving each bit, and the list of flip-flop cells.
+//
+// All bits are mapped with sigmap. Passes that change the module must keep
+// the index up to date, using remove_cell() and remove_init().
+struct FfIndex
+{
+	RTLIL::Module *module = nullptr;
+	SigMap sigmap;
+
+	// flip-flops and latches (internal cell types only), in module order
+	std::vector<RTLIL::Cell*> ff_cells;
+
+	// defined init values, and the wire bits carrying the init attribute
+	dict<RTLIL::SigBit, RTLIL::State> init_bits;
+	dict<RTLIL::SigBit, pool<RTLIL::SigBit>> init_wirebits;
+
+	dict<RTLIL::SigBit, RTLIL::Cell*> bit2driver;
+	dict<RTLIL::SigBit, std::pair<RTLIL::Cell*, int>> bit2mux;
+
+	// the number of cell inputs and module outputs using each bit
+	dict<RTLIL::SigBit, int> bitusers;
+
+	static bool is_ff(RTLIL::IdString type)
+	{
+		static pool<RTLIL::IdString> ff_types = {
+			ID($ff), ID($dff), ID($dffe), ID($dffsr), ID($adff), ID($dlatch), ID($dlatchsr),
+			ID($_FF_), ID($_DFF_N_), ID($_DFF_P_),
+			ID($_DFF_NN0_), ID($_DFF_NN1_), ID($_DFF_NP0_), ID($_DFF_NP1_),
+			ID($_DFF_PN0_), ID($_DFF_PN1_), ID($_DFF_PP0_), ID($_DFF_PP1_),
+			ID($_DFFE_NN_), ID($_DFFE_NP_), ID($_DFFE_PN_), ID($_DFFE_PP_),
+			ID($_DFFSR_NNN_), ID($_DFFSR_NNP_), ID($_DFFSR_NPN_), ID($_DFFSR_NPP_),
+			ID($_DFFSR_PNN_), ID($_DFFSR_PNP_), ID($_DFFSR_PPN_), ID($_DFFSR_PPP_),
+			ID($_DLATCH_N_), ID($_DLATCH_P_),
+			ID($_DLATCHSR_NNN_), ID($_DLATCHSR_NNP_), ID($_DLATCHSR_NPN_), ID($_DLATCHSR_NPP_),
+			ID($_DLATCHSR_PNN_), ID($_DLATCHSR_PNP_), ID($_DLATCHSR_PPN_), ID($_DLATCHSR_PPP_)
+		};
+		return ff_types.count(type) != 0;
+	}
+
+	static bool is_latch(RTLIL::IdString type)
+	{
+		return type.in(ID($dlatch), ID($dlatchsr)) || type.begins_with("$_DLATCH");
+	}
+
+	FfIndex() { }
+
+	FfIndex(RTLIL::Module *module)
+	{
+		setup(module);
+	}
+
+	void clear()
+	{
+		module = nullptr;
+		sigmap.clear();
+		ff_cells.clear();
+		init_bits.clear();
+		init_wirebits.clear();
+		bit2driver.clear();
+		bit2mux.clear();
+		bitusers.clear();
+	}
+
+	void setup(RTLIL::Module *module)
+	{
+		clear();
+		this->module = module;
+		sigmap.set(module);
+
+		for (auto wire : module->wires())
+		{
+			auto it = wire->attributes.find(ID(init));
+			if (it != wire->attributes.end()) {
+				const RTLIL::Const &initval = it->second;
+				for (int i = 0; i < GetSize(wire); i++) {
+					RTLIL::SigBit wire_bit(wire, i), bit = sigmap(wire_bit);
+					if (bit.wire == nullptr)
+						continue;
+					init_wirebits[bit].insert(wire_bit);
+					if (i < GetSize(initval) && (initval[i] == RTLIL::State::S0 || initval[i] == RTLIL::State::S1))
+						init_bits[bit] = initval[i];
+				}
+			}
+
+			if (wire->port_output)
+				for (auto bit : sigmap(wire))
+					bitusers[bit]++;
+		}
+
+		for (auto cell : module->cells())
+		{
+			if (is_ff(cell->type))
+				ff_cells.push_back(cell);
+
+			if (cell->type.in(ID($mux), ID($pmux), ID($_MUX_))) {
+				RTLIL::SigSpec sig_y = sigmap(cell->getPort(ID::Y));
+				for (int i = 0; i < GetSize(sig_y); i++)
+					bit2mux[sig_y[i]] = std::make_pair(cell, i);
+			}
+
+			for (auto &conn : cell->connections()) {
+				bool is_output = cell->output(conn.first);
+				for (auto bit : sigmap(conn.second)) {
+					if (is_output)
+						bit2driver[bit] = cell;
+					else
+						bitusers[bit]++;
+				}
+			}
+		}
+	}
+
+	RTLIL::State init(RTLIL::SigBit bit) const
+	{
+		bit = sigmap(bit);
+		if (bit.wire == nullptr)
+			return bit.data;
+		auto it = init_bits.find(bit);
+		return it == init_bits.end() ? RTLIL::State::Sx : it->second;
+	}
+
+	RTLIL::Const init(const RTLIL::SigSpec &sig) const
+	{
+		RTLIL::Const result;
+		for (auto bit : sig)
+			result.bits().push_back(init(bit));
+		return result;
+	}
+
+	// sets the init attribute of all wire bits carrying the bits to x
+	void remove_init(const RTLIL::SigSpec &sig)
+	{
+		for (auto bit : sigmap(sig)) {
+			auto it = init_wirebits.find(bit);
+			if (it == init_wirebits.end())
+				continue;
+			for (auto wbit : it->second)
+				wbit.wire->attributes.at(ID(init)).bits()[wbit.offset] = RTLIL::State::Sx;
+			init_bits.erase(bit);
+		}
+	}
+
+	// removes the cell from the module and from the index
+	void remove_cell(RTLIL::Cell *cell)
+	{
+		for (auto &conn : cell->connections()) {
+			bool is_output = cell->output(conn.first);
+			for (auto bit : sigmap(conn.second)) {
+				if (is_output) {
+					auto it = bit2driver.find(bit);
+					if (it != bit2driver.end() && it->second == cell)
+						bit2driver.erase(it);
+					auto mux_it = bit2mux.find(bit);
+					if (mux_it != bit2mux.end() && mux_it->second.first == cell)
+						bit2mux.erase(mux_it);
+				} else {
+					auto it = bitusers.find(bit);
+					if (it != bitusers.end() && --it->second == 0)
+						bitusers.erase(it);
+				}
+			}
+		}
+		module->remove(cell);
+	}
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
@@ -16,12 +16,25 @@
 #include <algorithm>
 #include <string>
 #include <vector>
+#include <atomic>
+#ifdef HASHLIB_STATS
+#  include <cmath>
+#endif
+
+#if (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)) && !defined(HASHLIB_NO_SIMD)
+#  define HASHLIB_SSE2
+#  include <emmintrin.h>
+#endif
 
 namespace hashlib {
 
 const int hashtable_size_trigger = 2;
 const int hashtable_size_factor = 3;
 
+// dict<> does not allocate a hashtable for up to this many entries and looks
+// up keys with a linear search instead (e.g. cell ports and parameters)
+const int hashtable_linear_max = 8;
+
 // The XOR version of DJB2
 inline unsigned int mkhash(unsigned int a, unsigned int b) {
 	return ((a << 5) + a) ^ b;
@@ -50,6 +63,13 @@ inline unsigned int mkhash_xorshift(unsigned int a) {
 	return a;
 }
 
+// advance a shared xorshift state and return the new value (thread-safe)
+inline unsigned int mkhash_xorshift_next(std::atomic<unsigned int> &state) {
+	unsigned int a = state.load(std::memory_order_relaxed);
+	while (!state.compare_exchange_weak(a, mkhash_xorshift(a), std::memory_order_relaxed)) { }
+	return mkhash_xorshift(a);
+}
+
 template<typename T> struct hash_ops {
 	static inline bool cmp(const T &a, const T &b) {
 		return a == b;
@@ -191,10 +211,114 @@ inline int hashtable_size(int min_size)
 	throw std::length_error("hash table exceeded maximum size.");
 }
 
+#ifdef HASHLIB_STATS
+// Statistics of the hashtables of dict<>, pool<> and idict<> (counted with
+// the pool<> it uses), collected when built with HASHLIB_STATS (set by
+// ENABLE_HASHLIB_STATS=1 in the Yosys Makefile) and printed by the
+// 'debug_hashlib' command. All containers of the same type (e.g. all
+// dict<SigBit, int>) share one record, the records of all types used so far
+// form a list starting at first().
+struct hashtable_stats
+{
+	enum { num_size_buckets = 32 };
+
+	std::string name;
+	hashtable_stats *next;
+
+	// lookups in a hashtable and the number of entries compared, lookups in
+	// containers without a hashtable (up to hashtable_linear_max entries)
+	std::atomic<unsigned long long> lookups, probes, max_probes, linear_lookups;
+
+	// summed over all rehashes: entries, buckets, non-empty buckets and the
+	// expected number of non-empty buckets for a uniform hash function
+	std::atomic<unsigned long long> rehashes, rehash_entries, rehash_buckets, rehash_used, rehash_ideal, max_chain;
+
+	// containers by the size they had when destroyed (bucket i counts the sizes
+	// 2^(i-1) .. 2^i-1), empty ones are not counted
+	std::atomic<unsigned long long> sizes[num_size_buckets];
+
+	hashtable_stats(const std::string &name) : name(name) {
+		reset();
+		next = first().load();
+		while (!first().compare_exchange_weak(next, this)) { }
+	}
+
+	static std::atomic<hashtable_stats*> &first() {
+		static std::atomic<hashtable_stats*> head(nullptr);
+		return head;
+	}
+
+	static void update_max(std::atomic<unsigned long long> &value, unsigned long long v) {
+		unsigned long long old = value.load(std::memory_order_relaxed);
+		while (v > old && !value.compare_exchange_weak(old, v, std::memory_order_relaxed)) { }
+	}
+
+	void reset() {
+		lookups = probes = max_probes = linear_lookups = 0;
+		rehashes = rehash_entries = rehash_buckets = rehash_used = rehash_ideal = max_chain = 0;
+		for (auto &n : sizes)
+			n = 0;
+	}
+
+	void record_lookup(int num_probes) {
+		lookups.fetch_add(1, std::memory_order_relaxed);
+		probes.fetch_add(num_probes, std::memory_order_relaxed);
+		update_max(max_probes, num_probes);
+	}
+
+	void record_linear_lookup() {
+		linear_lookups.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	template<typename E>
+	void record_rehash(const std::vector<int> &hashtable, const std::vector<E> &entries) {
+		unsigned long long used = 0, longest = 0;
+		for (int index : hashtable) {
+			if (index < 0)
+				continue;
+			unsigned long long length = 0;
+			for (; index >= 0; index = entries[index].next)
+				length++;
+			used++;
+			longest = std::max(longest, length);
+		}
+		double n = entries.size(), m = hashtable.size();
+		rehashes.fetch_add(1, std::memory_order_relaxed);
+		rehash_entries.fetch_add(entries.size(), std::memory_order_relaxed);
+		rehash_buckets.fetch_add(hashtable.size(), std::memory_order_relaxed);
+		rehash_used.fetch_add(used, std::memory_order_relaxed);
+		rehash_ideal.fetch_add((unsigned long long)(m * -std::expm1(-n / m) + 0.5), std::memory_order_relaxed);
+		update_max(max_chain, longest);
+	}
+
+	void record_size(size_t size) {
+		if (size == 0)
+			return;
+		int bucket = 0;
+		while (bucket < num_size_buckets-1 && (size >> bucket) != 0)
+			bucket++;
+		sizes[bucket].fetch_add(1, std::memory_order_relaxed);
+	}
+};
+
+#ifdef _MSC_VER
+#  define HASHLIB_STATS_NAME __FUNCSIG__
+#else
+#  define HASHLIB_STATS_NAME __PRETTY_FUNCTION__
+#endif
+#  define HASHLIB_STAT(...) __VA_ARGS__
+#else
+#  define HASHLIB_STAT(...)
+#endif
+
 template<typename K, typename T, typename OPS = hash_ops<K>> class dict;
 template<typename K, int offset = 0, typename OPS = hash_ops<K>> class idict;
 template<typename K, typename OPS = hash_ops<K>> class pool;
 template<typename K, typename OPS = hash_ops<K>> class mfp;
+template<typename K, typename T, typename OPS = hash_ops<K>> class flat_dict;
+template<typename K, typename OPS = hash_ops<K>> class flat_pool;
+template<typename K, typename T, typename OPS = hash_ops<K>> class frozen_dict;
+template<typename K, typename OPS = hash_ops<K>> class frozen_pool;
 
 template<typename K, typename T, typename OPS>
 class dict
@@ -221,6 +345,14 @@ class dict
 	}
 #endif
 
+#ifdef HASHLIB_STATS
+	// never freed, containers with static storage use it until the very end
+	static hashtable_stats &stats() {
+		static hashtable_stats *record = new hashtable_stats(HASHLIB_STATS_NAME);
+		return *record;
+	}
+#endif
+
 	int do_hash(const K &key) const
 	{
 		unsigned int hash = 0;
@@ -231,6 +363,13 @@ class dict
 
 	void do_rehash()
 	{
+		if (int(entries.size()) <= hashtable_linear_max) {
+			std::vector<int>().swap(hashtable);
+			for (auto &e : entries)
+				e.next = -1;
+			return;
+		}
+
 		hashtable.clear();
 		hashtable.resize(hashtable_size(entries.capacity() * hashtable_size_factor), -1);
 
@@ -240,14 +379,22 @@ class dict
 			entries[i].next = hashtable[hash];
 			hashtable[hash] = i;
 		}
+		HASHLIB_STAT(stats().record_rehash(hashtable, entries);)
 	}
 
 	int do_erase(int index, int hash)
 	{
 		do_assert(index < int(entries.size()));
-		if (hashtable.empty() || index < 0)
+		if (index < 0)
 			return 0;
 
+		if (hashtable.empty()) {
+			if (index != int(entries.size())-1)
+				entries[index] = std::move(entries.back());
+			entries.pop_back();
+			return 1;
+		}
+
 		int k = hashtable[hash];
 		do_assert(0 <= k && k < int(entries.size()));
 
@@ -293,8 +440,13 @@ class dict
 
 	int do_lookup(const K &key, int &hash) const
 	{
-		if (hashtable.empty())
+		if (hashtable.empty()) {
+			HASHLIB_STAT(stats().record_linear_lookup();)
+			for (int index = 0; index < int(entries.size()); index++)
+				if (ops.cmp(entries[index].udata.first, key))
+					return index;
 			return -1;
+		}
 
 		if (entries.size() * hashtable_size_trigger > hashtable.size()) {
 			((dict*)this)->do_rehash();
@@ -302,12 +454,15 @@ class dict
 		}
 
 		int index = hashtable[hash];
+		HASHLIB_STAT(int num_probes = index >= 0;)
 
 		while (index >= 0 && !ops.cmp(entries[index].udata.first, key)) {
 			index = entries[index].next;
+			HASHLIB_STAT(num_probes += index >= 0;)
 			do_assert(-1 <= index && index < int(entries.size()));
 		}
 
+		HASHLIB_STAT(stats().record_lookup(num_probes);)
 		return index;
 	}
 
@@ -315,8 +470,10 @@ class dict
 	{
 		if (hashtable.empty()) {
 			entries.push_back(entry_t(std::pair<K, T>(key, T()), -1));
-			do_rehash();
-			hash = do_hash(key);
+			if (int(entries.size()) > hashtable_linear_max) {
+				do_rehash();
+				hash = do_hash(key);
+			}
 		} else {
 			entries.push_back(entry_t(std::pair<K, T>(key, T()), hashtable[hash]));
 			hashtable[hash] = entries.size() - 1;
@@ -328,8 +485,10 @@ class dict
 	{
 		if (hashtable.empty()) {
 			entries.push_back(entry_t(value, -1));
-			do_rehash();
-			hash = do_hash(value.first);
+			if (int(entries.size()) > hashtable_linear_max) {
+				do_rehash();
+				hash = do_hash(value.first);
+			}
 		} else {
 			entries.push_back(entry_t(value, hashtable[hash]));
 			hashtable[hash] = entries.size() - 1;
@@ -390,6 +549,13 @@ public:
 		swap(other);
 	}
 
+#ifdef HASHLIB_STATS
+	~dict()
+	{
+		stats().record_size(entries.size());
+	}
+#endif
+
 	dict &operator=(const dict &other) {
 		entries = other.entries;
 		do_rehash();
@@ -556,6 +722,9 @@ public:
 	bool empty() const { return entries.empty(); }
 	void clear() { hashtable.clear(); entries.clear(); }
 
+	// heap memory of the container itself, without memory owned by the elements
+	size_t memory_usage() const { return hashtable.capacity() * sizeof(int) + entries.capacity() * sizeof(entry_t); }
+
 	iterator begin() { return iterator(this, int(entries.size())-1); }
 	iterator element(int n) { return iterator(this, int(entries.size())-1-n); }
 	iterator end() { return iterator(nullptr, -1); }
@@ -592,6 +761,14 @@ protected:
 	}
 #endif
 
+#ifdef HASHLIB_STATS
+	// never freed, containers with static storage use it until the very end
+	static hashtable_stats &stats() {
+		static hashtable_stats *record = new hashtable_stats(HASHLIB_STATS_NAME);
+		return *record;
+	}
+#endif
+
 	int do_hash(const K &key) const
 	{
 		unsigned int hash = 0;
@@ -611,6 +788,7 @@ protected:
 			entries[i].next = hashtable[hash];
 			hashtable[hash] = i;
 		}
+		HASHLIB_STAT(stats().record_rehash(hashtable, entries);)
 	}
 
 	int do_erase(int index, int hash)
@@ -669,12 +847,15 @@ protected:
 		}
 
 		int index = hashtable[hash];
+		HASHLIB_STAT(int num_probes = index >= 0;)
 
 		while (index >= 0 && !ops.cmp(entries[index].udata, key)) {
 			index = entries[index].next;
+			HASHLIB_STAT(num_probes += index >= 0;)
 			do_assert(-1 <= index && index < int(entries.size()));
 		}
 
+		HASHLIB_STAT(stats().record_lookup(num_probes);)
 		return index;
 	}
 
@@ -742,6 +923,13 @@ public:
 		swap(other);
 	}
 
+#ifdef HASHLIB_STATS
+	~pool()
+	{
+		stats().record_size(entries.size());
+	}
+#endif
+
 	pool &operator=(const pool &other) {
 		entries = other.entries;
 		do_rehash();
@@ -882,6 +1070,9 @@ public:
 	bool empty() const { return entries.empty(); }
 	void clear() { hashtable.clear(); entries.clear(); }
 
+	// heap memory of the container itself, without memory owned by the elements
+	size_t memory_usage() const { return hashtable.capacity() * sizeof(int) + entries.capacity() * sizeof(entry_t); }
+
 	iterator begin() { return iterator(this, int(entries.size())-1); }
 	iterator element(int n) { return iterator(this, int(entries.size())-1-n); }
 	iterator end() { return iterator(nullptr, -1); }
@@ -1060,6 +1251,1206 @@ public:
 	const_iterator end() const { return database.end(); }
 };
 
+// Open-addressing variants of dict<> and pool<>
+//
+// The entries are kept in a dense vector exactly like in dict<> and pool<>, so
+// iteration order, element() and count(key, it) behave the same. Instead of the
+// chained hashtable they use a flat index of 16-slot groups with one control
+// byte per slot (a 7 bit hash tag, or one of the free markers below). A lookup
+// compares a whole group of control bytes at once (using SSE2 if available)
+// and only touches the entries whose tag matches, so that a hit usually costs
+// a single cache miss in the index and one in the entries vector.
+
+class flat_index
+{
+	template<typename, typename, typename> friend class flat_dict;
+	template<typename, typename> friend class flat_pool;
+
+	enum { group_size = 16 };
+	enum : unsigned char { ctrl_empty = 0x80, ctrl_deleted = 0xfe };
+
+	std::vector<unsigned char> ctrl;
+	std::vector<int> slots;
+	int used = 0; // full and deleted slots
+
+	static inline unsigned int mix(unsigned int hash) {
+		hash *= 0x9e3779b1;
+		return hash ^ (hash >> 16);
+	}
+
+	static inline unsigned char tag(unsigned int mixed) {
+		return (mixed >> 25) & 0x7f;
+	}
+
+	static inline int lowest_bit(unsigned int mask) {
+#if defined(__GNUC__) || defined(__clang__)
+		return __builtin_ctz(mask);
+#else
+		int i = 0;
+		while (!(mask & 1))
+			mask >>= 1, i++;
+		return i;
+#endif
+	}
+
+	// bitmask of the slots in the group at pos with control byte c
+	inline unsigned int match(int pos, unsigned char c) const {
+#ifdef HASHLIB_SSE2
+		__m128i g = _mm_loadu_si128((const __m128i*)(ctrl.data() + pos));
+		return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(char(c))));
+#else
+		unsigned int mask = 0;
+		for (int i = 0; i < group_size; i++)
+			if (ctrl[pos + i] == c)
+				mask |= 1 << i;
+		return mask;
+#endif
+	}
+
+	// bitmask of the empty and deleted slots in the group at pos
+	inline unsigned int match_free(int pos) const {
+#ifdef HASHLIB_SSE2
+		__m128i g = _mm_loadu_si128((const __m128i*)(ctrl.data() + pos));
+		return _mm_movemask_epi8(g);
+#else
+		unsigned int mask = 0;
+		for (int i = 0; i < group_size; i++)
+			if (ctrl[pos + i] & 0x80)
+				mask |= 1 << i;
+		return mask;
+#endif
+	}
+
+	// quadratic probing over groups, which visits every group because
+	// the number of groups is a power of two
+	template<typename Cmp>
+	int find_slot(unsigned int hash, Cmp cmp) const
+	{
+		if (ctrl.empty())
+			return -1;
+
+		unsigned int mixed = mix(hash), group_mask = ctrl.size() / group_size - 1;
+		unsigned char t = tag(mixed);
+
+		for (unsigned int g = mixed & group_mask, step = 1;; g = (g + step++) & group_mask) {
+			int pos = g * group_size;
+			for (unsigned int mask = match(pos, t); mask; mask &= mask - 1) {
+				int slot = pos + lowest_bit(mask);
+				if (cmp(slots[slot]))
+					return slot;
+			}
+			if (match(pos, ctrl_empty))
+				return -1;
+		}
+	}
+
+	void insert(unsigned int hash, int index)
+	{
+		unsigned int mixed = mix(hash), group_mask = ctrl.size() / group_size - 1;
+
+		for (unsigned int g = mixed & group_mask, step = 1;; g = (g + step++) & group_mask) {
+			int pos = g * group_size;
+			unsigned int mask = match_free(pos);
+			if (mask) {
+				int slot = pos + lowest_bit(mask);
+				if (ctrl[slot] == ctrl_empty)
+					used++;
+				ctrl[slot] = tag(mixed);
+				slots[slot] = index;
+				return;
+			}
+		}
+	}
+
+	void erase_slot(int slot)
+	{
+		// a lookup only continues past a group without empty slots, and a
+		// group without empty slots never gets one back (see below) until the
+		// next rebuild, so the slot can simply become empty again if its
+		// group still has an empty slot
+		if (match(slot - slot % group_size, ctrl_empty)) {
+			ctrl[slot] = ctrl_empty;
+			used--;
+		} else
+			ctrl[slot] = ctrl_deleted;
+	}
+
+	bool need_rebuild() const {
+		return 8 * (used + 1) > 7 * int(ctrl.size());
+	}
+
+	void reset(int min_entries)
+	{
+		size_t size = group_size;
+		while (size < 2 * size_t(min_entries))
+			size *= 2;
+		if (size > size_t(0x40000000))
+			throw std::length_error("hash table exceeded maximum size.");
+		ctrl.clear();
+		ctrl.resize(size, ctrl_empty);
+		slots.clear();
+		slots.resize(size, -1);
+		used = 0;
+	}
+
+	void clear()
+	{
+		ctrl.clear();
+		slots.clear();
+		used = 0;
+	}
+
+	void swap(flat_index &other)
+	{
+		ctrl.swap(other.ctrl);
+		slots.swap(other.slots);
+		std::swap(used, other.used);
+	}
+};
+
+template<typename K, typename T, typename OPS>
+class flat_dict
+{
+	struct entry_t
+	{
+		std::pair<K, T> udata;
+		unsigned int hash;
+
+		entry_t() { }
+		entry_t(const std::pair<K, T> &udata, unsigned int hash) : udata(udata), hash(hash) { }
+		entry_t(std::pair<K, T> &&udata, unsigned int hash) : udata(std::move(udata)), hash(hash) { }
+	};
+
+	flat_index index;
+	std::vector<entry_t> entries;
+	OPS ops;
+
+#ifdef NDEBUG
+	static inline void do_assert(bool) { }
+#else
+	static inline void do_assert(bool cond) {
+		if (!cond) throw std::runtime_error("flat_dict<> assert failed.");
+	}
+#endif
+
+	void do_rehash()
+	{
+		if (entries.empty()) {
+			index.clear();
+			return;
+		}
+		index.reset(entries.capacity());
+		for (int i = 0; i < int(entries.size()); i++)
+			index.insert(entries[i].hash, i);
+	}
+
+	int do_slot(const K &key, unsigned int hash) const
+	{
+		return index.find_slot(hash, [&](int i) {
+			return entries[i].hash == hash && ops.cmp(entries[i].udata.first, key);
+		});
+	}
+
+	int do_lookup(const K &key, unsigned int hash) const
+	{
+		int slot = do_slot(key, hash);
+		return slot < 0 ? -1 : index.slots[slot];
+	}
+
+	int do_erase(int i)
+	{
+		if (i < 0)
+			return 0;
+		do_assert(i < int(entries.size()));
+
+		int slot = do_slot(entries[i].udata.first, entries[i].hash);
+		do_assert(slot >= 0);
+		index.erase_slot(slot);
+
+		int back_idx = entries.size()-1;
+
+		if (i != back_idx)
+		{
+			int back_slot = do_slot(entries[back_idx].udata.first, entries[back_idx].hash);
+			do_assert(back_slot >= 0);
+			index.slots[back_slot] = i;
+			entries[i] = std::move(entries[back_idx]);
+		}
+
+		entries.pop_back();
+
+		if (entries.empty())
+			index.clear();
+
+		return 1;
+	}
+
+	int do_insert(std::pair<K, T> &&value, unsigned int hash)
+	{
+		entries.push_back(entry_t(std::move(value), hash));
+		if (index.need_rebuild())
+			do_rehash();
+		else
+			index.insert(hash, entries.size() - 1);
+		return entries.size() - 1;
+	}
+
+public:
+	class const_iterator : public std::iterator<std::forward_iterator_tag, std::pair<K, T>>
+	{
+		friend class flat_dict;
+	protected:
+		const flat_dict *ptr;
+		int index;
+		const_iterator(const flat_dict *ptr, int index) : ptr(ptr), index(index) { }
+	public:
+		const_iterator() { }
+		const_iterator operator++() { index--; return *this; }
+		bool operator<(const const_iterator &other) const { return index > other.index; }
+		bool operator==(const const_iterator &other) const { return index == other.index; }
+		bool operator!=(const const_iterator &other) const { return index != other.index; }
+		const std::pair<K, T> &operator*() const { return ptr->entries[index].udata; }
+		const std::pair<K, T> *operator->() const { return &ptr->entries[index].udata; }
+	};
+
+	class iterator : public std::iterator<std::forward_iterator_tag, std::pair<K, T>>
+	{
+		friend class flat_dict;
+	protected:
+		flat_dict *ptr;
+		int index;
+		iterator(flat_dict *ptr, int index) : ptr(ptr), index(index) { }
+	public:
+		iterator() { }
+		iterator operator++() { index--; return *this; }
+		bool operator<(const iterator &other) const { return index > other.index; }
+		bool operator==(const iterator &other) const { return index == other.index; }
+		bool operator!=(const iterator &other) const { return index != other.index; }
+		std::pair<K, T> &operator*() { return ptr->entries[index].udata; }
+		std::pair<K, T> *operator->() { return &ptr->entries[index].udata; }
+		const std::pair<K, T> &operator*() const { return ptr->entries[index].udata; }
+		const std::pair<K, T> *operator->() const { return &ptr->entries[index].udata; }
+		operator const_iterator() const { return const_iterator(ptr, index); }
+	};
+
+	flat_dict()
+	{
+	}
+
+	flat_dict(const flat_dict &other)
+	{
+		entries = other.entries;
+		do_rehash();
+	}
+
+	flat_dict(flat_dict &&other)
+	{
+		swap(other);
+	}
+
+	flat_dict &operator=(const flat_dict &other) {
+		entries = other.entries;
+		do_rehash();
+		return *this;
+	}
+
+	flat_dict &operator=(flat_dict &&other) {
+		clear();
+		swap(other);
+		return *this;
+	}
+
+	flat_dict(const std::initializer_list<std::pair<K, T>> &list)
+	{
+		for (auto &it : list)
+			insert(it);
+	}
+
+	template<class InputIterator>
+	flat_dict(InputIterator first, InputIterator last)
+	{
+		insert(first, last);
+	}
+
+	template<class InputIterator>
+	void insert(InputIterator first, InputIterator last)
+	{
+		for (; first != last; ++first)
+			insert(*first);
+	}
+
+	std::pair<iterator, bool> insert(const K &key)
+	{
+		unsigned int hash = ops.hash(key);
+		int i = do_lookup(key, hash);
+		if (i >= 0)
+			return std::pair<iterator, bool>(iterator(this, i), false);
+		i = do_insert(std::pair<K, T>(key, T()), hash);
+		return std::pair<iterator, bool>(iterator(this, i), true);
+	}
+
+	std::pair<iterator, bool> insert(const std::pair<K, T> &value)
+	{
+		unsigned int hash = ops.hash(value.first);
+		int i = do_lookup(value.first, hash);
+		if (i >= 0)
+			return std::pair<iterator, bool>(iterator(this, i), false);
+		i = do_insert(std::pair<K, T>(value), hash);
+		return std::pair<iterator, bool>(iterator(this, i), true);
+	}
+
+	int erase(const K &key)
+	{
+		return do_erase(do_lookup(key, ops.hash(key)));
+	}
+
+	iterator erase(iterator it)
+	{
+		do_erase(it.index);
+		return ++it;
+	}
+
+	int count(const K &key) const
+	{
+		int i = do_lookup(key, ops.hash(key));
+		return i < 0 ? 0 : 1;
+	}
+
+	int count(const K &key, const_iterator it) const
+	{
+		int i = do_lookup(key, ops.hash(key));
+		return i < 0 || i > it.index ? 0 : 1;
+	}
+
+	iterator find(const K &key)
+	{
+		int i = do_lookup(key, ops.hash(key));
+		if (i < 0)
+			return end();
+		return iterator(this, i);
+	}
+
+	const_iterator find(const K &key) const
+	{
+		int i = do_lookup(key, ops.hash(key));
+		if (i < 0)
+			return end();
+		return const_iterator(this, i);
+	}
+
+	T& at(const K &key)
+	{
+		int i = do_lookup(key, ops.hash(key));
+		if (i < 0)
+			throw std::out_of_range("flat_dict::at()");
+		return entries[i].udata.second;
+	}
+
+	const T& at(const K &key) const
+	{
+		int i = do_lookup(key, ops.hash(key));
+		if (i < 0)
+			throw std::out_of_range("flat_dict::at()");
+		return entries[i].udata.second;
+	}
+
+	T at(const K &key, const T &defval) const
+	{
+		int i = do_lookup(key, ops.hash(key));
+		if (i < 0)
+			return defval;
+		return entries[i].udata.second;
+	}
+
+	T& operator[](const K &key)
+	{
+		unsigned int hash = ops.hash(key);
+		int i = do_lookup(key, hash);
+		if (i < 0)
+			i = do_insert(std::pair<K, T>(key, T()), hash);
+		return entries[i].udata.second;
+	}
+
+	template<typename Compare = std::less<K>>
+	void sort(Compare comp = Compare())
+	{
+		std::sort(entries.begin(), entries.end(), [comp](const entry_t &a, const entry_t &b){ return comp(b.udata.first, a.udata.first); });
+		do_rehash();
+	}
+
+	void swap(flat_dict &other)
+	{
+		index.swap(other.index);
+		entries.swap(other.entries);
+	}
+
+	bool operator==(const flat_dict &other) const {
+		if (size() != other.size())
+			return false;
+		for (auto &it : entries) {
+			auto oit = other.find(it.udata.first);
+			if (oit == other.end() || !(oit->second == it.udata.second))
+				return false;
+		}
+		return true;
+	}
+
+	bool operator!=(const flat_dict &other) const {
+		return !operator==(other);
+	}
+
+	void reserve(size_t n) { entries.reserve(n); }
+	size_t size() const { return entries.size(); }
+	bool empty() const { return entries.empty(); }
+	void clear() { index.clear(); entries.clear(); }
+
+	iterator begin() { return iterator(this, int(entries.size())-1); }
+	iterator element(int n) { return iterator(this, int(entries.size())-1-n); }
+	iterator end() { return iterator(nullptr, -1); }
+
+	const_iterator begin() const { return const_iterator(this, int(entries.size())-1); }
+	const_iterator element(int n) const { return const_iterator(this, int(entries.size())-1-n); }
+	const_iterator end() const { return const_iterator(nullptr, -1); }
+};
+
+template<typename K, typename OPS>
+class flat_pool
+{
+	struct entry_t
+	{
+		K udata;
+		unsigned int hash;
+
+		entry_t() { }
+		entry_t(const K &udata, unsigned int hash) : udata(udata), hash(hash) { }
+		entry_t(K &&udata, unsigned int hash) : udata(std::move(udata)), hash(hash) { }
+	};
+
+	flat_index index;
+	std::vector<entry_t> entries;
+	OPS ops;
+
+#ifdef NDEBUG
+	static inline void do_assert(bool) { }
+#else
+	static inline void do_assert(bool cond) {
+		if (!cond) throw std::runtime_error("flat_pool<> assert failed.");
+	}
+#endif
+
+	void do_rehash()
+	{
+		if (entries.empty()) {
+			index.clear();
+			return;
+		}
+		index.reset(entries.capacity());
+		for (int i = 0; i < int(entries.size()); i++)
+			index.insert(entries[i].hash, i);
+	}
+
+	int do_slot(const K &key, unsigned int hash) const
+	{
+		return index.find_slot(hash, [&](int i) {
+			return entries[i].hash == hash && ops.cmp(entries[i].udata, key);
+		});
+	}
+
+	int do_lookup(const K &key, unsigned int hash) const
+	{
+		int slot = do_slot(key, hash);
+		return slot < 0 ? -1 : index.slots[slot];
+	}
+
+	int do_erase(int i)
+	{
+		if (i < 0)
+			return 0;
+		do_assert(i < int(entries.size()));
+
+		int slot = do_slot(entries[i].udata, entries[i].hash);
+		do_assert(slot >= 0);
+		index.erase_slot(slot);
+
+		int back_idx = entries.size()-1;
+
+		if (i != back_idx)
+		{
+			int back_slot = do_slot(entries[back_idx].udata, entries[back_idx].hash);
+			do_assert(back_slot >= 0);
+			index.slots[back_slot] = i;
+			entries[i] = std::move(entries[back_idx]);
+		}
+
+		entries.pop_back();
+
+		if (entries.empty())
+			index.clear();
+
+		return 1;
+	}
+
+	int do_insert(const K &value, unsigned int hash)
+	{
+		entries.push_back(entry_t(value, hash));
+		if (index.need_rebuild())
+			do_rehash();
+		else
+			index.insert(hash, entries.size() - 1);
+		return entries.size() - 1;
+	}
+
+public:
+	class const_iterator : public std::iterator<std::forward_iterator_tag, K>
+	{
+		friend class flat_pool;
+	protected:
+		const flat_pool *ptr;
+		int index;
+		const_iterator(const flat_pool *ptr, int index) : ptr(ptr), index(index) { }
+	public:
+		const_iterator() { }
+		const_iterator operator++() { index--; return *this; }
+		bool operator==(const const_iterator &other) const { return index == other.index; }
+		bool operator!=(const const_iterator &other) const { return index != other.index; }
+		const K &operator*() const { return ptr->entries[index].udata; }
+		const K *operator->() const { return &ptr->entries[index].udata; }
+	};
+
+	class iterator : public std::iterator<std::forward_iterator_tag, K>
+	{
+		friend class flat_pool;
+	protected:
+		flat_pool *ptr;
+		int index;
+		iterator(flat_pool *ptr, int index) : ptr(ptr), index(index) { }
+	public:
+		iterator() { }
+		iterator operator++() { index--; return *this; }
+		bool operator==(const iterator &other) const { return index == other.index; }
+		bool operator!=(const iterator &other) const { return index != other.index; }
+		K &operator*() { return ptr->entries[index].udata; }
+		K *operator->() { return &ptr->entries[index].udata; }
+		const K &operator*() const { return ptr->entries[index].udata; }
+		const K *operator->() const { return &ptr->entries[index].udata; }
+		operator const_iterator() const { return const_iterator(ptr, index); }
+	};
+
+	flat_pool()
+	{
+	}
+
+	flat_pool(const flat_pool &other)
+	{
+		entries = other.entries;
+		do_rehash();
+	}
+
+	flat_pool(flat_pool &&other)
+	{
+		swap(other);
+	}
+
+	flat_pool &operator=(const flat_pool &other) {
+		entries = other.entries;
+		do_rehash();
+		return *this;
+	}
+
+	flat_pool &operator=(flat_pool &&other) {
+		clear();
+		swap(other);
+		return *this;
+	}
+
+	flat_pool(const std::initializer_list<K> &list)
+	{
+		for (auto &it : list)
+			insert(it);
+	}
+
+	template<class InputIterator>
+	flat_pool(InputIterator first, InputIterator last)
+	{
+		insert(first, last);
+	}
+
+	template<class InputIterator>
+	void insert(InputIterator first, InputIterator last)
+	{
+		for (; first != last; ++first)
+			insert(*first);
+	}
+
+	std::pair<iterator, bool> insert(const K &value)
+	{
+		unsigned int hash = ops.hash(value);
+		int i = do_lookup(value, hash);
+		if (i >= 0)
+			return std::pair<iterator, bool>(iterator(this, i), false);
+		i = do_insert(value, hash);
+		return std::pair<iterator, bool>(iterator(this, i), true);
+	}
+
+	int erase(const K &key)
+	{
+		return do_erase(do_lookup(key, ops.hash(key)));
+	}
+
+	iterator erase(iterator it)
+	{
+		do_erase(it.index);
+		return ++it;
+	}
+
+	int count(const K &key) const
+	{
+		int i = do_lookup(key, ops.hash(key));
+		return i < 0 ? 0 : 1;
+	}
+
+	int count(const K &key, const_iterator it) const
+	{
+		int i = do_lookup(key, ops.hash(key));
+		return i < 0 || i > it.index ? 0 : 1;
+	}
+
+	iterator find(const K &key)
+	{
+		int i = do_lookup(key, ops.hash(key));
+		if (i < 0)
+			return end();
+		return iterator(this, i);
+	}
+
+	const_iterator find(const K &key) const
+	{
+		int i = do_lookup(key, ops.hash(key));
+		if (i < 0)
+			return end();
+		return const_iterator(this, i);
+	}
+
+	bool operator[](const K &key)
+	{
+		return count(key) != 0;
+	}
+
+	template<typename Compare = std::less<K>>
+	void sort(Compare comp = Compare())
+	{
+		std::sort(entries.begin(), entries.end(), [comp](const entry_t &a, const entry_t &b){ return comp(b.udata, a.udata); });
+		do_rehash();
+	}
+
+	K pop()
+	{
+		iterator it = begin();
+		K ret = *it;
+		erase(it);
+		return ret;
+	}
+
+	void swap(flat_pool &other)
+	{
+		index.swap(other.index);
+		entries.swap(other.entries);
+	}
+
+	bool operator==(const flat_pool &other) const {
+		if (size() != other.size())
+			return false;
+		for (auto &it : entries)
+			if (!other.count(it.udata))
+				return false;
+		return true;
+	}
+
+	bool operator!=(const flat_pool &other) const {
+		return !operator==(other);
+	}
+
+	unsigned int hash() const {
+		unsigned int hashval = mkhash_init;
+		for (auto &it : entries)
+			hashval ^= ops.hash(it.udata);
+		return hashval;
+	}
+
+	void reserve(size_t n) { entries.reserve(n); }
+	size_t size() const { return entries.size(); }
+	bool empty() const { return entries.empty(); }
+	void clear() { index.clear(); entries.clear(); }
+
+	iterator begin() { return iterator(this, int(entries.size())-1); }
+	iterator element(int n) { return iterator(this, int(entries.size())-1-n); }
+	iterator end() { return iterator(nullptr, -1); }
+
+	const_iterator begin() const { return const_iterator(this, int(entries.size())-1); }
+	const_iterator element(int n) const { return const_iterator(this, int(entries.size())-1-n); }
+	const_iterator end() const { return const_iterator(nullptr, -1); }
+};
+
+// Read-only variants of dict<> and pool<>
+//
+// A frozen_dict<> or frozen_pool<> is built once from a dict<>, pool<> (or any
+// other range of entries) and can not be modified afterwards, except for the
+// values of a frozen_dict<>. The keys are placed with a minimal perfect hash
+// function (hash and displace): the hash of a key selects a bucket, and the
+// displacement stored for that bucket selects the slot of the key in the dense
+// entries vector. A lookup thus reads one displacement and compares against a
+// single entry, hits and misses alike. Iteration visits the entries in the
+// order of the range the container was built from.
+
+class frozen_index
+{
+	template<typename, typename, typename> friend class frozen_dict;
+	template<typename, typename> friend class frozen_pool;
+
+	// displacement of each bucket: the seed of the slot hash, or -slot-1 for
+	// a bucket with a single key that is placed directly
+	std::vector<int> displace;
+
+	// number of entries placed by the hash function, entries with the same
+	// hash as an earlier entry are stored after them and searched linearly
+	int num_slots = 0;
+
+	enum { max_tries = 1 << 16 };
+
+	static inline unsigned int mix(unsigned int hash, unsigned int seed) {
+		hash ^= seed * 0x9e3779b9;
+		hash ^= hash >> 16;
+		hash *= 0x85ebca6b;
+		hash ^= hash >> 13;
+		hash *= 0xc2b2ae35;
+		return hash ^ (hash >> 16);
+	}
+
+	// maps x to 0 .. n-1 without a division
+	static inline int reduce(unsigned int x, int n) {
+		return int((uint64_t(x) * uint64_t(n)) >> 32);
+	}
+
+	inline int bucket(unsigned int hash) const {
+		return reduce(mix(hash, 0), int(displace.size()));
+	}
+
+	inline int slot(unsigned int hash) const {
+		int d = displace[bucket(hash)];
+		return d < 0 ? -d-1 : reduce(mix(hash, d+1), num_slots);
+	}
+
+	bool try_build(const std::vector<unsigned int> &hashes, const std::vector<int> &keys, int num_buckets, std::vector<int> &pos)
+	{
+		displace.assign(num_buckets, 0);
+
+		std::vector<std::vector<int>> buckets(num_buckets);
+		for (int i : keys)
+			buckets[bucket(hashes[i])].push_back(i);
+
+		// large buckets first, while most slots are still free
+		std::vector<int> order(num_buckets);
+		for (int b = 0; b < num_buckets; b++)
+			order[b] = b;
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return buckets[a].size() > buckets[b].size(); });
+
+		std::vector<bool> taken(num_slots);
+		std::vector<int> bucket_slots;
+		int next_free = 0;
+
+		for (int b : order)
+		{
+			std::vector<int> &bucket_keys = buckets[b];
+			if (bucket_keys.empty())
+				break;
+
+			if (bucket_keys.size() == 1) {
+				while (taken[next_free])
+					next_free++;
+				taken[next_free] = true;
+				pos[bucket_keys.front()] = next_free;
+				displace[b] = -next_free-1;
+				continue;
+			}
+
+			for (int d = 0;; d++)
+			{
+				if (d == max_tries)
+					return false;
+
+				bucket_slots.clear();
+				for (int i : bucket_keys) {
+					int s = reduce(mix(hashes[i], d+1), num_slots);
+					if (taken[s] || std::find(bucket_slots.begin(), bucket_slots.end(), s) != bucket_slots.end())
+						break;
+					bucket_slots.push_back(s);
+				}
+				if (bucket_slots.size() != bucket_keys.size())
+					continue;
+
+				displace[b] = d;
+				for (int k = 0; k < int(bucket_keys.size()); k++) {
+					taken[bucket_slots[k]] = true;
+					pos[bucket_keys[k]] = bucket_slots[k];
+				}
+				break;
+			}
+		}
+
+		return true;
+	}
+
+	// returns the position in the entries vector for each hash
+	std::vector<int> build(const std::vector<unsigned int> &hashes)
+	{
+		int n = hashes.size();
+		std::vector<int> pos(n, -1);
+
+		// no displacement can tell apart keys with the same hash
+		std::vector<int> by_hash(n), keys, overflow;
+		for (int i = 0; i < n; i++)
+			by_hash[i] = i;
+		std::stable_sort(by_hash.begin(), by_hash.end(), [&](int a, int b) { return hashes[a] < hashes[b]; });
+		for (int k = 0; k < n; k++) {
+			if (k > 0 && hashes[by_hash[k]] == hashes[by_hash[k-1]])
+				overflow.push_back(by_hash[k]);
+			else
+				keys.push_back(by_hash[k]);
+		}
+		std::sort(overflow.begin(), overflow.end());
+
+		num_slots = keys.size();
+		displace.clear();
+
+		// two keys per bucket on average, more buckets if a bucket can not
+		// be placed (with one key per bucket almost all are placed directly)
+		if (num_slots > 0)
+			for (int num_buckets = (num_slots + 1) / 2; !try_build(hashes, keys, num_buckets, pos); num_buckets *= 2) { }
+
+		int next = num_slots;
+		for (int i : overflow)
+			pos[i] = next++;
+
+		return pos;
+	}
+
+	void clear()
+	{
+		displace.clear();
+		num_slots = 0;
+	}
+
+	void swap(frozen_index &other)
+	{
+		displace.swap(other.displace);
+		std::swap(num_slots, other.num_slots);
+	}
+};
+
+template<typename K, typename T, typename OPS>
+class frozen_dict
+{
+	struct entry_t
+	{
+		std::pair<K, T> udata;
+		unsigned int hash;
+
+		entry_t() { }
+		entry_t(const std::pair<K, T> &udata, unsigned int hash) : udata(udata), hash(hash) { }
+	};
+
+	frozen_index index;
+	std::vector<entry_t> entries;
+	std::vector<int> order, rank; // iteration order to entry and back
+	OPS ops;
+
+	template<class InputIterator>
+	void do_build(InputIterator first, InputIterator last)
+	{
+		std::vector<std::pair<K, T>> items;
+		std::vector<unsigned int> hashes;
+		dict<K, int, OPS> seen;
+
+		for (; first != last; ++first)
+			if (seen.insert(std::pair<K, int>(first->first, 0)).second) {
+				items.push_back(*first);
+				hashes.push_back(ops.hash(first->first));
+			}
+
+		order = index.build(hashes);
+		rank.resize(items.size());
+		entries.resize(items.size());
+		for (int i = 0; i < int(items.size()); i++) {
+			entries[order[i]] = entry_t(std::move(items[i]), hashes[i]);
+			rank[order[i]] = i;
+		}
+	}
+
+	int do_lookup(const K &key, unsigned int hash) const
+	{
+		if (index.num_slots > 0) {
+			int i = index.slot(hash);
+			if (entries[i].hash == hash && ops.cmp(entries[i].udata.first, key))
+				return i;
+		}
+		for (int i = index.num_slots; i < int(entries.size()); i++)
+			if (entries[i].hash == hash && ops.cmp(entries[i].udata.first, key))
+				return i;
+		return -1;
+	}
+
+public:
+	class const_iterator : public std::iterator<std::forward_iterator_tag, std::pair<K, T>>
+	{
+		friend class frozen_dict;
+	protected:
+		const frozen_dict *ptr;
+		int index;
+		const_iterator(const frozen_dict *ptr, int index) : ptr(ptr), index(index) { }
+	public:
+		const_iterator() { }
+		const_iterator operator++() { index++; return *this; }
+		bool operator<(const const_iterator &other) const { return index < other.index; }
+		bool operator==(const const_iterator &other) const { return index == other.index; }
+		bool operator!=(const const_iterator &other) const { return index != other.index; }
+		const std::pair<K, T> &operator*() const { return ptr->entries[ptr->order[index]].udata; }
+		const std::pair<K, T> *operator->() const { return &ptr->entries[ptr->order[index]].udata; }
+	};
+
+	class iterator : public std::iterator<std::forward_iterator_tag, std::pair<K, T>>
+	{
+		friend class frozen_dict;
+	protected:
+		frozen_dict *ptr;
+		int index;
+		iterator(frozen_dict *ptr, int index) : ptr(ptr), index(index) { }
+	public:
+		iterator() { }
+		iterator operator++() { index++; return *this; }
+		bool operator<(const iterator &other) const { return index < other.index; }
+		bool operator==(const iterator &other) const { return index == other.index; }
+		bool operator!=(const iterator &other) const { return index != other.index; }
+		std::pair<K, T> &operator*() { return ptr->entries[ptr->order[index]].udata; }
+		std::pair<K, T> *operator->() { return &ptr->entries[ptr->order[index]].udata; }
+		const std::pair<K, T> &operator*() const { return ptr->entries[ptr->order[index]].udata; }
+		const std::pair<K, T> *operator->() const { return &ptr->entries[ptr->order[index]].udata; }
+		operator const_iterator() const { return const_iterator(ptr, index); }
+	};
+
+	frozen_dict()
+	{
+	}
+
+	frozen_dict(const dict<K, T, OPS> &other)
+	{
+		do_build(other.begin(), other.end());
+	}
+
+	frozen_dict(const std::initializer_list<std::pair<K, T>> &list)
+	{
+		do_build(list.begin(), list.end());
+	}
+
+	// for duplicate keys the first entry is used
+	template<class InputIterator>
+	frozen_dict(InputIterator first, InputIterator last)
+	{
+		do_build(first, last);
+	}
+
+	int count(const K &key) const
+	{
+		int i = do_lookup(key, ops.hash(key));
+		return i < 0 ? 0 : 1;
+	}
+
+	iterator find(const K &key)
+	{
+		int i = do_lookup(key, ops.hash(key));
+		if (i < 0)
+			return end();
+		return iterator(this, rank[i]);
+	}
+
+	const_iterator find(const K &key) const
+	{
+		int i = do_lookup(key, ops.hash(key));
+		if (i < 0)
+			return end();
+		return const_iterator(this, rank[i]);
+	}
+
+	// the values stay mutable, only the set of keys is frozen
+	T& at(const K &key)
+	{
+		int i = do_lookup(key, ops.hash(key));
+		if (i < 0)
+			throw std::out_of_range("frozen_dict::at()");
+		return entries[i].udata.second;
+	}
+
+	const T& at(const K &key) const
+	{
+		int i = do_lookup(key, ops.hash(key));
+		if (i < 0)
+			throw std::out_of_range("frozen_dict::at()");
+		return entries[i].udata.second;
+	}
+
+	T at(const K &key, const T &defval) const
+	{
+		int i = do_lookup(key, ops.hash(key));
+		if (i < 0)
+			return defval;
+		return entries[i].udata.second;
+	}
+
+	void swap(frozen_dict &other)
+	{
+		index.swap(other.index);
+		entries.swap(other.entries);
+		order.swap(other.order);
+		rank.swap(other.rank);
+	}
+
+	size_t size() const { return entries.size(); }
+	bool empty() const { return entries.empty(); }
+	void clear() { index.clear(); entries.clear(); order.clear(); rank.clear(); }
+
+	iterator begin() { return iterator(this, 0); }
+	iterator end() { return iterator(nullptr, int(order.size())); }
+
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(nullptr, int(order.size())); }
+};
+
+template<typename K, typename OPS>
+class frozen_pool
+{
+	struct entry_t
+	{
+		K udata;
+		unsigned int hash;
+
+		entry_t() { }
+		entry_t(const K &udata, unsigned int hash) : udata(udata), hash(hash) { }
+	};
+
+	frozen_index index;
+	std::vector<entry_t> entries;
+	std::vector<int> order, rank; // iteration order to entry and back
+	OPS ops;
+
+	template<class InputIterator>
+	void do_build(InputIterator first, InputIterator last)
+	{
+		std::vector<K> items;
+		std::vector<unsigned int> hashes;
+		pool<K, OPS> seen;
+
+		for (; first != last; ++first)
+			if (seen.insert(*first).second) {
+				items.push_back(*first);
+				hashes.push_back(ops.hash(*first));
+			}
+
+		order = index.build(hashes);
+		rank.resize(items.size());
+		entries.resize(items.size());
+		for (int i = 0; i < int(items.size()); i++) {
+			entries[order[i]] = entry_t(std::move(items[i]), hashes[i]);
+			rank[order[i]] = i;
+		}
+	}
+
+	int do_lookup(const K &key, unsigned int hash) const
+	{
+		if (index.num_slots > 0) {
+			int i = index.slot(hash);
+			if (entries[i].hash == hash && ops.cmp(entries[i].udata, key))
+				return i;
+		}
+		for (int i = index.num_slots; i < int(entries.size()); i++)
+			if (entries[i].hash == hash && ops.cmp(entries[i].udata, key))
+				return i;
+		return -1;
+	}
+
+public:
+	class const_iterator : public std::iterator<std::forward_iterator_tag, K>
+	{
+		friend class frozen_pool;
+	protected:
+		const frozen_pool *ptr;
+		int index;
+		const_iterator(const frozen_pool *ptr, int index) : ptr(ptr), index(index) { }
+	public:
+		const_iterator() { }
+		const_iterator operator++() { index++; return *this; }
+		bool operator<(const const_iterator &other) const { return index < other.index; }
+		bool operator==(const const_iterator &other) const { return index == other.index; }
+		bool operator!=(const const_iterator &other) const { return index != other.index; }
+		const K &operator*() const { return ptr->entries[ptr->order[index]].udata; }
+		const K *operator->() const { return &ptr->entries[ptr->order[index]].udata; }
+	};
+
+	typedef const_iterator iterator;
+
+	frozen_pool()
+	{
+	}
+
+	frozen_pool(const pool<K, OPS> &other)
+	{
+		do_build(other.begin(), other.end());
+	}
+
+	frozen_pool(const std::initializer_list<K> &list)
+	{
+		do_build(list.begin(), list.end());
+	}
+
+	template<class InputIterator>
+	frozen_pool(InputIterator first, InputIterator last)
+	{
+		do_build(first, last);
+	}
+
+	int count(const K &key) const
+	{
+		int i = do_lookup(key, ops.hash(key));
+		return i < 0 ? 0 : 1;
+	}
+
+	const_iterator find(const K &key) const
+	{
+		int i = do_lookup(key, ops.hash(key));
+		if (i < 0)
+			return end();
+		return const_iterator(this, rank[i]);
+	}
+
+	bool operator[](const K &key) const
+	{
+		return count(key) != 0;
+	}
+
+	void swap(frozen_pool &other)
+	{
+		index.swap(other.index);
+		entries.swap(other.entries);
+		order.swap(other.order);
+		rank.swap(other.rank);
+	}
+
+	size_t size() const { return entries.size(); }
+	bool empty() const { return entries.empty(); }
+	void clear() { index.clear(); entries.clear(); order.clear(); rank.clear(); }
+
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(nullptr, int(order.size())); }
+};
+
 } /* namespace hashlib */
 
 #endif
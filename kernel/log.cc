@@ -35,6 +35,7 @@
 #include <stdarg.h>
 #include <vector>
 #include <list>
+#include <chrono>
 
 YOSYS_NAMESPACE_BEGIN
 
@@ -58,22 +59,158 @@ void (*log_error_atexit)() = NULL;
 
 int log_make_debug = 0;
 int log_force_debug = 0;
-int log_debug_suppressed = 0;
+thread_local int log_debug_suppressed = 0;
 
 vector<int> header_count;
-vector<char*> log_id_cache;
-vector<shared_str> string_buf;
-int string_buf_index = -1;
+// log_id() and log_signal() return pointers that must stay valid until the
+// log call they are used in is done. The strings are kept in rings of the
+// last results, log_id() holds a reference to the id so that its name is not
+// freed.
+static const int log_id_cache_size = 1000;
+static const int string_buf_size = 100;
+thread_local vector<RTLIL::IdString> log_id_cache;
+thread_local int log_id_cache_index = -1;
+thread_local vector<shared_str> string_buf;
+thread_local int string_buf_index = -1;
 
 static struct timeval initial_tv = { 0, 0 };
 static bool next_print_log = false;
 static int log_newline_count = 0;
+static thread_local LogCapture *log_capture = nullptr;
 
 static void log_id_cache_clear()
 {
-	for (auto p : log_id_cache)
-		free(p);
 	log_id_cache.clear();
+	log_id_cache_index = -1;
+}
+
+#ifdef YOSYS_ENABLE_THREADS
+// Writer thread for the log files, see log_async_start(). Only the main thread
+// calls logv() (worker threads record their output with a LogCapture), so the
+// messages are passed to the writer through a lock-free single-producer
+// single-consumer ring buffer. Each record holds the list of log files at the
+// time of the message, followed by the text.
+struct LogAsyncWriter
+{
+	static const size_t buffer_size = 1 << 20;
+
+	struct record_t {
+		int num_files, length;
+	};
+
+	std::vector<char> buffer;
+	std::atomic<size_t> head, tail;
+	std::atomic<bool> running;
+	std::thread thread;
+
+	LogAsyncWriter() : buffer(buffer_size), head(0), tail(0), running(true) {
+		thread = std::thread([this](){ run(); });
+	}
+
+	void copy_in(size_t pos, const void *data, size_t len)
+	{
+		size_t offset = pos % buffer_size, first = std::min(len, buffer_size - offset);
+		memcpy(buffer.data() + offset, data, first);
+		memcpy(buffer.data(), (const char*)data + first, len - first);
+	}
+
+	void copy_out(size_t pos, void *data, size_t len)
+	{
+		size_t offset = pos % buffer_size, first = std::min(len, buffer_size - offset);
+		memcpy(data, buffer.data() + offset, first);
+		memcpy((char*)data + first, buffer.data(), len - first);
+	}
+
+	void write(const std::vector<FILE*> &files, const std::string &str)
+	{
+		record_t rec = { GetSize(files), GetSize(str) };
+		size_t files_len = files.size() * sizeof(FILE*);
+		size_t len = sizeof(record_t) + files_len + str.size();
+
+		if (len > buffer_size / 2) {
+			drain();
+			for (auto f : files)
+				fputs(str.c_str(), f);
+			return;
+		}
+
+		size_t pos = head.load(std::memory_order_relaxed);
+		while (pos + len - tail.load(std::memory_order_acquire) > buffer_size)
+			std::this_thread::yield();
+
+		copy_in(pos, &rec, sizeof(record_t));
+		copy_in(pos + sizeof(record_t), files.data(), files_len);
+		copy_in(pos + sizeof(record_t) + files_len, str.data(), str.size());
+		head.store(pos + len, std::memory_order_release);
+	}
+
+	void drain()
+	{
+		while (tail.load(std::memory_order_acquire) != head.load(std::memory_order_relaxed))
+			std::this_thread::yield();
+	}
+
+	void run()
+	{
+		std::vector<FILE*> files;
+		std::string str;
+		int idle_ms = 0;
+
+		while (1)
+		{
+			size_t pos = tail.load(std::memory_order_relaxed);
+			if (pos == head.load(std::memory_order_acquire)) {
+				if (!running.load(std::memory_order_acquire) && pos == head.load(std::memory_order_acquire))
+					break;
+				// back off up to 16 ms while there is no output
+				idle_ms = std::min(std::max(2*idle_ms, 1), 16);
+				std::this_thread::sleep_for(std::chrono::milliseconds(idle_ms));
+				continue;
+			}
+			idle_ms = 0;
+
+			record_t rec;
+			copy_out(pos, &rec, sizeof(record_t));
+			files.resize(rec.num_files);
+			str.resize(rec.length);
+			copy_out(pos + sizeof(record_t), files.data(), files.size() * sizeof(FILE*));
+			copy_out(pos + sizeof(record_t) + files.size() * sizeof(FILE*), &str[0], str.size());
+			tail.store(pos + sizeof(record_t) + files.size() * sizeof(FILE*) + str.size(), std::memory_order_release);
+
+			for (auto f : files)
+				fwrite(str.data(), 1, str.size(), f);
+		}
+	}
+
+	~LogAsyncWriter() {
+		running.store(false, std::memory_order_release);
+		thread.join();
+	}
+};
+
+static LogAsyncWriter *log_async_writer = nullptr;
+#endif
+
+void log_async_start()
+{
+#ifdef YOSYS_ENABLE_THREADS
+	if (log_async_writer != nullptr)
+		return;
+	static bool atexit_registered = false;
+	if (!atexit_registered) {
+		atexit(log_async_stop);
+		atexit_registered = true;
+	}
+	log_async_writer = new LogAsyncWriter;
+#endif
+}
+
+void log_async_stop()
+{
+#ifdef YOSYS_ENABLE_THREADS
+	delete log_async_writer;
+	log_async_writer = nullptr;
+#endif
 }
 
 #if defined(_WIN32) && !defined(__MINGW32__)
@@ -111,6 +248,11 @@ void logv(const char *format, va_list ap)
 	if (str.empty())
 		return;
 
+	if (log_capture) {
+		log_capture->entries.push_back({LogCapture::LOG, std::string(), str});
+		return;
+	}
+
 	size_t nnl_pos = str.find_last_not_of('\n');
 	if (nnl_pos == std::string::npos)
 		log_newline_count += GetSize(str);
@@ -142,13 +284,27 @@ void logv(const char *format, va_list ap)
 		if (format[0] && format[strlen(format)-1] == '\n')
 			next_print_log = true;
 
+#ifdef YOSYS_ENABLE_THREADS
+		if (log_async_writer == nullptr)
+#endif
 		for (auto f : log_files)
 			fputs(time_str.c_str(), f);
 
 		for (auto f : log_streams)
 			*f << time_str;
+
+#ifdef YOSYS_ENABLE_THREADS
+		if (log_async_writer != nullptr && !log_files.empty() && !time_str.empty())
+			log_async_writer->write(log_files, time_str);
+#endif
 	}
 
+#ifdef YOSYS_ENABLE_THREADS
+	if (log_async_writer != nullptr) {
+		if (!log_files.empty())
+			log_async_writer->write(log_files, str);
+	} else
+#endif
 	for (auto f : log_files)
 		fputs(str.c_str(), f);
 
@@ -227,6 +383,11 @@ static void logv_warning_with_prefix(const char *prefix,
 	std::string message = vstringf(format, ap);
 	bool suppressed = false;
 
+	if (log_capture) {
+		log_capture->entries.push_back({LogCapture::WARNING, prefix, message});
+		return;
+	}
+
 	for (auto &re : log_nowarn_regexes)
 		if (std::regex_search(message, re))
 			suppressed = true;
@@ -268,6 +429,14 @@ static void logv_warning_with_prefix(const char *prefix,
 	}
 }
 
+static void log_warning_with_prefix(const char *prefix, const char *format, ...)
+{
+	va_list ap;
+	va_start(ap, format);
+	logv_warning_with_prefix(prefix, format, ap);
+	va_end(ap);
+}
+
 void logv_warning(const char *format, va_list ap)
 {
 	logv_warning_with_prefix("Warning: ", format, ap);
@@ -304,6 +473,11 @@ YS_ATTRIBUTE(noreturn)
 static void logv_error_with_prefix(const char *prefix,
                                    const char *format, va_list ap)
 {
+	if (log_capture) {
+		log_capture->entries.push_back({LogCapture::ERROR, prefix, vstringf(format, ap)});
+		throw log_capture_error_exception();
+	}
+
 #ifdef EMSCRIPTEN
 	auto backup_log_files = log_files;
 #endif
@@ -338,6 +512,14 @@ static void logv_error_with_prefix(const char *prefix,
 #endif
 }
 
+YS_ATTRIBUTE(noreturn)
+static void log_error_with_prefix(const char *prefix, const char *format, ...)
+{
+	va_list ap;
+	va_start(ap, format);
+	logv_error_with_prefix(prefix, format, ap);
+}
+
 void logv_error(const char *format, va_list ap)
 {
 	logv_error_with_prefix("ERROR: ", format, ap);
@@ -410,6 +592,11 @@ void log_cmd_error(const char *format, ...)
 	va_list ap;
 	va_start(ap, format);
 
+	if (log_capture) {
+		log_capture->entries.push_back({LogCapture::CMD_ERROR, std::string(), vstringf(format, ap)});
+		throw log_capture_error_exception();
+	}
+
 	if (log_cmd_error_throw) {
 		log_last_error = vstringf(format, ap);
 		log("ERROR: %s", log_last_error.c_str());
@@ -422,10 +609,67 @@ void log_cmd_error(const char *format, ...)
 
 void log_spacer()
 {
+	if (log_capture) {
+		log_capture->entries.push_back({LogCapture::SPACER, std::string(), std::string()});
+		return;
+	}
+
 	if (log_newline_count < 2) log("\n");
 	if (log_newline_count < 2) log("\n");
 }
 
+void log_capture_begin(LogCapture *capture)
+{
+	capture->outer = log_capture;
+	capture->outer_debug_suppressed = log_debug_suppressed;
+	log_capture = capture;
+	log_debug_suppressed = 0;
+}
+
+void log_capture_end()
+{
+	LogCapture *capture = log_capture;
+	capture->debug_suppressed += log_debug_suppressed;
+	log_capture = capture->outer;
+	log_debug_suppressed = capture->outer_debug_suppressed;
+	capture->outer = nullptr;
+	if (log_capture == nullptr) {
+		log_id_cache_clear();
+		string_buf.clear();
+		string_buf_index = -1;
+	}
+}
+
+void LogCapture::replay()
+{
+	log_debug_suppressed += debug_suppressed;
+	debug_suppressed = 0;
+
+	for (auto &entry : entries)
+		switch (entry.kind)
+		{
+		case LOG:
+			// keep the trailing newline in the format string, log_time depends on it
+			if (!entry.text.empty() && entry.text.back() == '\n')
+				log("%s\n", entry.text.substr(0, GetSize(entry.text)-1).c_str());
+			else
+				log("%s", entry.text.c_str());
+			break;
+		case SPACER:
+			log_spacer();
+			break;
+		case WARNING:
+			log_warning_with_prefix(entry.prefix.c_str(), "%s", entry.text.c_str());
+			break;
+		case ERROR:
+			log_error_with_prefix(entry.prefix.c_str(), "%s", entry.text.c_str());
+		case CMD_ERROR:
+			log_cmd_error("%s", entry.text.c_str());
+		}
+
+	entries.clear();
+}
+
 void log_push()
 {
 	header_count.push_back(0);
@@ -549,6 +793,11 @@ void log_reset_stack()
 
 void log_flush()
 {
+#ifdef YOSYS_ENABLE_THREADS
+	if (log_async_writer != nullptr)
+		log_async_writer->drain();
+#endif
+
 	for (auto f : log_files)
 		fflush(f);
 
@@ -568,20 +817,23 @@ void log_dump_val_worker(RTLIL::State v) {
 	log("%s", log_signal(v));
 }
 
+static const char *log_string_buf(std::string &&str)
+{
+	if (GetSize(string_buf) < string_buf_size) {
+		string_buf.push_back(std::move(str));
+		return string_buf.back().c_str();
+	}
+	if (++string_buf_index == string_buf_size)
+		string_buf_index = 0;
+	string_buf[string_buf_index] = std::move(str);
+	return string_buf[string_buf_index].c_str();
+}
+
 const char *log_signal(const RTLIL::SigSpec &sig, bool autoint)
 {
 	std::stringstream buf;
 	ILANG_BACKEND::dump_sigspec(buf, sig, autoint);
-
-	if (string_buf.size() < 100) {
-		string_buf.push_back(buf.str());
-		return string_buf.back().c_str();
-	} else {
-		if (++string_buf_index == 100)
-			string_buf_index = 0;
-		string_buf[string_buf_index] = buf.str();
-		return string_buf[string_buf_index].c_str();
-	}
+	return log_string_buf(buf.str());
 }
 
 const char *log_const(const RTLIL::Const &value, bool autoint)
@@ -589,23 +841,19 @@ const char *log_const(const RTLIL::Const &value, bool autoint)
 	if ((value.flags & RTLIL::CONST_FLAG_STRING) == 0)
 		return log_signal(value, autoint);
 
-	std::string str = "\"" + value.decode_string() + "\"";
-
-	if (string_buf.size() < 100) {
-		string_buf.push_back(str);
-		return string_buf.back().c_str();
-	} else {
-		if (++string_buf_index == 100)
-			string_buf_index = 0;
-		string_buf[string_buf_index] = str;
-		return string_buf[string_buf_index].c_str();
-	}
+	return log_string_buf("\"" + value.decode_string() + "\"");
 }
 
 const char *log_id(RTLIL::IdString str)
 {
-	log_id_cache.push_back(strdup(str.c_str()));
-	const char *p = log_id_cache.back();
+	if (GetSize(log_id_cache) < log_id_cache_size)
+		log_id_cache.push_back(str);
+	else {
+		if (++log_id_cache_index == log_id_cache_size)
+			log_id_cache_index = 0;
+		log_id_cache[log_id_cache_index] = str;
+	}
+	const char *p = str.c_str();
 	if (p[0] != '\\')
 		return p;
 	if (p[1] == '$' || p[1] == '\\' || p[1] == 0)
@@ -636,6 +884,71 @@ void log_wire(RTLIL::Wire *wire, std::string indent)
 	log("%s", buf.str().c_str());
 }
 
+// ---------------------------------------------------
+// Named timing scopes (YS_PROFILE_SCOPE)
+// ---------------------------------------------------
+
+static std::vector<ProfileScopeData*> &profile_scope_list()
+{
+	static std::vector<ProfileScopeData*> list;
+	return list;
+}
+
+#ifdef YOSYS_ENABLE_THREADS
+static std::mutex profile_scope_list_lock;
+#endif
+
+static thread_local ProfileScope *profile_current_scope = nullptr;
+
+static int64_t profile_scope_time()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ProfileScopeData::ProfileScopeData(const char *name) : name(name), calls(0), total_ns(0), self_ns(0)
+{
+#ifdef YOSYS_ENABLE_THREADS
+	std::lock_guard<std::mutex> lock(profile_scope_list_lock);
+#endif
+	profile_scope_list().push_back(this);
+}
+
+std::vector<ProfileScopeData*> get_profile_scopes()
+{
+#ifdef YOSYS_ENABLE_THREADS
+	std::lock_guard<std::mutex> lock(profile_scope_list_lock);
+#endif
+	return profile_scope_list();
+}
+
+void reset_profile_scopes()
+{
+	for (auto data : get_profile_scopes()) {
+		data->calls = 0;
+		data->total_ns = 0;
+		data->self_ns = 0;
+	}
+}
+
+ProfileScope::ProfileScope(ProfileScopeData *data) : data(data), parent(profile_current_scope), child_ns(0)
+{
+	profile_current_scope = this;
+	begin_ns = profile_scope_time();
+}
+
+ProfileScope::~ProfileScope()
+{
+	int64_t time_ns = profile_scope_time() - begin_ns;
+	data->calls.fetch_add(1, std::memory_order_relaxed);
+	// only the outermost of directly recursive scopes counts towards the total
+	if (parent == nullptr || parent->data != data)
+		data->total_ns.fetch_add(time_ns, std::memory_order_relaxed);
+	data->self_ns.fetch_add(time_ns - child_ns, std::memory_order_relaxed);
+	if (parent != nullptr)
+		parent->child_ns += time_ns;
+	profile_current_scope = parent;
+}
+
 // ---------------------------------------------------
 // This is the magic behind the code coverage counters
 // ---------------------------------------------------
@@ -66,7 +66,7 @@ extern void (*log_error_atexit)();
 
 extern int log_make_debug;
 extern int log_force_debug;
-extern int log_debug_suppressed;
+extern thread_local int log_debug_suppressed;
 
 void logv(const char *format, va_list ap);
 void logv_header(RTLIL::Design *design, const char *format, va_list ap);
@@ -127,6 +127,40 @@ struct LogMakeDebugHdl {
 	}
 };
 
+// Per-thread capture of log output, used to run passes on worker threads (see
+// ModulePass in kernel/register.h). While a capture is active on a thread, all
+// messages, warnings and errors from that thread are recorded instead of being
+// printed. Errors terminate the worker with log_capture_error_exception. A
+// later call to replay() from the main thread reproduces the output exactly as
+// if the code had been running on the main thread in the first place.
+// Captures nest: a capture started while another one is active on the same
+// thread (e.g. for a task run by a thread waiting for a TaskGroup, see
+// kernel/threadpool.h) restores the outer one when it ends, and replay()
+// records the output in the capture that is active on the calling thread.
+
+struct log_capture_error_exception { };
+
+struct LogCapture
+{
+	enum entry_kind_t { LOG, SPACER, WARNING, ERROR, CMD_ERROR };
+
+	struct entry_t {
+		entry_kind_t kind;
+		std::string prefix, text;
+	};
+
+	std::vector<entry_t> entries;
+	int debug_suppressed = 0;
+
+	LogCapture *outer = nullptr;
+	int outer_debug_suppressed = 0;
+
+	void replay();
+};
+
+void log_capture_begin(LogCapture *capture);
+void log_capture_end();
+
 void log_spacer();
 void log_push();
 void log_pop();
@@ -135,6 +169,13 @@ void log_backtrace(const char *prefix, int levels);
 void log_reset_stack();
 void log_flush();
 
+// Write the log files from a background thread (yosys -a). Messages written
+// to log_streams are not affected. log_flush() waits until the writer thread
+// has caught up, it must be called before a log file is closed or written to
+// directly.
+void log_async_start();
+void log_async_stop();
+
 const char *log_signal(const RTLIL::SigSpec &sig, bool autoint = true);
 const char *log_const(const RTLIL::Const &value, bool autoint = true);
 const char *log_id(RTLIL::IdString id);
@@ -270,6 +311,42 @@ struct PerformanceTimer
 #endif
 };
 
+// Named timing scopes for the internals of passes. YS_PROFILE_SCOPE("abc.run")
+// measures the wall time until the end of the enclosing block and adds it to
+// the statistics of that name, which are printed by the "profile" command.
+// The time of a scope nested in another one counts towards the self time of
+// the inner scope only. The macro expands to nothing unless Yosys is built with
+// ENABLE_PROFILE=1 (YOSYS_ENABLE_PROFILE).
+
+struct ProfileScopeData
+{
+	const char *name;
+	std::atomic<int64_t> calls, total_ns, self_ns;
+	ProfileScopeData(const char *name);
+};
+
+std::vector<ProfileScopeData*> get_profile_scopes();
+void reset_profile_scopes();
+
+struct ProfileScope
+{
+	ProfileScopeData *data;
+	ProfileScope *parent;
+	int64_t begin_ns, child_ns;
+	ProfileScope(ProfileScopeData *data);
+	~ProfileScope();
+};
+
+#ifdef YOSYS_ENABLE_PROFILE
+#  define YS_PROFILE_CONCAT_(a, b) a ## b
+#  define YS_PROFILE_CONCAT(a, b) YS_PROFILE_CONCAT_(a, b)
+#  define YS_PROFILE_SCOPE(_name) \
+	static ProfileScopeData YS_PROFILE_CONCAT(ys_profile_data_, __LINE__)(_name); \
+	ProfileScope YS_PROFILE_CONCAT(ys_profile_scope_, __LINE__)(&YS_PROFILE_CONCAT(ys_profile_data_, __LINE__))
+#else
+#  define YS_PROFILE_SCOPE(_name) do { } while (0)
+#endif
+
 // simple API for quickly dumping values when debugging
 
 static inline void log_dump_val_worker(short v) { log("%d", v); }
@@ -104,7 +104,7 @@ struct Macc
 		ports.clear();
 		bit_ports = cell->getPort(ID::B);
 
-		std::vector<RTLIL::State> config_bits = cell->getParam(ID(CONFIG)).bits;
+		std::vector<RTLIL::State> config_bits = cell->getParam(ID(CONFIG)).to_bits();
 		int config_cursor = 0;
 
 #ifndef NDEBUG
@@ -201,7 +201,7 @@ struct Macc
 
 	bool eval(RTLIL::Const &result) const
 	{
-		for (auto &bit : result.bits)
+		for (auto &bit : result.bits())
 			bit = State::S0;
 
 		for (auto &port : ports)
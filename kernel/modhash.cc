@@ -0,0 +1,273 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "kernel/sigtools.h"
+#include "kernel/modhash.h"
+#include "backends/ilang/ilang_backend.h"
+#include "libs/sha1/sha1.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+namespace {
+
+// The digests must not depend on the order in which objects were added to
+// the module, so all dicts are written in the order of their keys.
+template<typename T>
+std::vector<std::pair<RTLIL::IdString, T>> sorted_items(const dict<RTLIL::IdString, T> &items)
+{
+	std::vector<std::pair<RTLIL::IdString, T>> result(items.begin(), items.end());
+	std::sort(result.begin(), result.end(), [](const std::pair<RTLIL::IdString, T> &a, const std::pair<RTLIL::IdString, T> &b) {
+		return a.first.str() < b.first.str();
+	});
+	return result;
+}
+
+void dump_const(std::ostream &f, const RTLIL::Const &value)
+{
+	if (value.flags & RTLIL::CONST_FLAG_STRING)
+		f << "\"" << value.decode_string() << "\"";
+	else
+		f << GetSize(value) << "'" << value.as_string();
+	if (value.flags & RTLIL::CONST_FLAG_SIGNED)
+		f << "s";
+}
+
+void dump_params(std::ostream &f, const char *kind, const dict<RTLIL::IdString, RTLIL::Const> &params)
+{
+	for (auto &it : sorted_items(params)) {
+		f << " " << kind << " " << it.first.str() << "=";
+		dump_const(f, it.second);
+	}
+}
+
+void dump_sig(std::ostream &f, const RTLIL::SigSpec &sig)
+{
+	for (auto &chunk : sig.chunks()) {
+		if (chunk.wire == nullptr)
+			f << " " << RTLIL::Const(chunk.data).as_string();
+		else
+			f << " " << chunk.wire->name.str() << "[" << chunk.offset << "+" << chunk.width << "]";
+	}
+}
+
+std::string named_hash(RTLIL::Module *module)
+{
+	std::stringstream f;
+
+	for (auto &it : sorted_items(module->wires_)) {
+		RTLIL::Wire *wire = it.second;
+		f << "wire " << wire->name.str() << " " << wire->width << " " << wire->start_offset << " " << wire->upto;
+		f << " " << wire->port_id << " " << wire->port_input << wire->port_output;
+		dump_params(f, "attr", wire->attributes);
+		f << "\n";
+	}
+
+	for (auto &it : sorted_items(module->memories)) {
+		RTLIL::Memory *mem = it.second;
+		f << "memory " << mem->name.str() << " " << mem->width << " " << mem->start_offset << " " << mem->size;
+		dump_params(f, "attr", mem->attributes);
+		f << "\n";
+	}
+
+	for (auto &it : sorted_items(module->cells_)) {
+		RTLIL::Cell *cell = it.second;
+		f << "cell " << cell->name.str() << " " << cell->type.str();
+		dump_params(f, "param", cell->parameters);
+		dump_params(f, "attr", cell->attributes);
+		for (auto &conn : sorted_items(cell->connections())) {
+			f << " port " << conn.first.str();
+			dump_sig(f, conn.second);
+		}
+		f << "\n";
+	}
+
+	std::vector<std::string> connections;
+	for (auto &conn : module->connections()) {
+		std::stringstream buf;
+		dump_sig(buf, conn.first);
+		buf << " =";
+		dump_sig(buf, conn.second);
+		connections.push_back(buf.str());
+	}
+	std::sort(connections.begin(), connections.end());
+	for (auto &conn : connections)
+		f << "connect" << conn << "\n";
+
+	for (auto &it : sorted_items(module->processes))
+		ILANG_BACKEND::dump_proc(f, "", it.second);
+
+	for (auto param : module->avail_parameters)
+		f << "parameter " << param.str() << "\n";
+
+	return sha1(f.str());
+}
+
+// 64 bit labels for the canonical digest
+uint64_t mix(uint64_t a, uint64_t b)
+{
+	uint64_t x = a ^ (b + 0x9e3779b97f4a7c15ull + (a << 6) + (a >> 2));
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ull;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebull;
+	x ^= x >> 31;
+	return x;
+}
+
+uint64_t string_label(const std::string &str)
+{
+	uint64_t h = 0xcbf29ce484222325ull;
+	for (char c : str)
+		h = (h ^ (unsigned char)c) * 0x100000001b3ull;
+	return h;
+}
+
+}
+
+uint64_t ModuleLabels::bit_label(RTLIL::SigBit bit) const
+{
+	bit = (*sigmap)(bit);
+	if (bit.wire == nullptr)
+		return mix(1, bit.data);
+	auto it = bit_labels.find(bit);
+	return it == bit_labels.end() ? 0 : it->second;
+}
+
+// Weisfeiler-Lehman style refinement: the label of each (mapped) signal bit
+// starts from the port it belongs to, and is then repeatedly combined with the
+// labels of the cells connected to it, which in turn depend on the cell type,
+// parameters and the labels of the connected bits. The names of wires and
+// cells are never used.
+void ModuleLabels::compute(RTLIL::Module *module, int rounds)
+{
+	sigmap = &module->sigmap();
+	bit_labels.clear();
+	cells.clear();
+	cell_labels.clear();
+
+	for (auto port : module->ports) {
+		RTLIL::Wire *wire = module->wire(port);
+		uint64_t port_label = mix(string_label(port.str()), wire->port_input + 2*wire->port_output);
+		for (int i = 0; i < wire->width; i++) {
+			RTLIL::SigBit bit = (*sigmap)(RTLIL::SigBit(wire, i));
+			if (bit.wire != nullptr)
+				bit_labels[bit] += mix(port_label, i);
+		}
+	}
+
+	std::vector<uint64_t> cell_static_labels;
+	for (auto cell : module->cells()) {
+		uint64_t label = string_label(cell->type.str());
+		for (auto &it : sorted_items(cell->parameters)) {
+			std::stringstream buf;
+			buf << it.first.str() << "=";
+			dump_const(buf, it.second);
+			label = mix(label, string_label(buf.str()));
+		}
+		cells.push_back(cell);
+		cell_static_labels.push_back(label);
+	}
+	cell_labels = cell_static_labels;
+
+	for (int round = 0; round < rounds; round++)
+	{
+		for (int i = 0; i < GetSize(cells); i++) {
+			uint64_t label = cell_static_labels[i];
+			for (auto &conn : sorted_items(cells[i]->connections())) {
+				label = mix(label, string_label(conn.first.str()));
+				for (auto bit : conn.second)
+					label = mix(label, bit_label(bit));
+			}
+			cell_labels[i] = label;
+		}
+
+		// the contributions of the cells are added up, so that the result
+		// does not depend on the order of the cells
+		dict<RTLIL::SigBit, uint64_t> next_labels;
+		for (int i = 0; i < GetSize(cells); i++)
+			for (auto &conn : cells[i]->connections()) {
+				uint64_t port_label = mix(cell_labels[i], string_label(conn.first.str()));
+				for (int j = 0; j < GetSize(conn.second); j++) {
+					RTLIL::SigBit bit = (*sigmap)(conn.second[j]);
+					if (bit.wire != nullptr)
+						next_labels[bit] += mix(port_label, j);
+				}
+			}
+		for (auto &it : next_labels)
+			it.second = mix(bit_label(it.first), it.second);
+		for (auto &it : bit_labels)
+			if (next_labels.count(it.first) == 0)
+				next_labels[it.first] = mix(it.second, 0);
+		bit_labels.swap(next_labels);
+	}
+}
+
+namespace {
+
+std::string canonical_hash(RTLIL::Module *module)
+{
+	ModuleLabels labels;
+	labels.compute(module);
+
+	std::vector<uint64_t> cell_labels = labels.cell_labels;
+	auto bit_label = [&](RTLIL::SigBit bit) { return labels.bit_label(bit); };
+
+	std::stringstream f;
+
+	for (auto port : module->ports) {
+		RTLIL::Wire *wire = module->wire(port);
+		f << "port " << port.str() << " " << wire->width << " " << wire->port_input << wire->port_output;
+		for (int i = 0; i < wire->width; i++)
+			f << " " << bit_label(RTLIL::SigBit(wire, i));
+		f << "\n";
+	}
+
+	std::sort(cell_labels.begin(), cell_labels.end());
+	for (auto label : cell_labels)
+		f << "cell " << label << "\n";
+
+	std::vector<std::string> memories;
+	for (auto &it : module->memories)
+		memories.push_back(stringf("memory %d %d %d\n", it.second->width, it.second->start_offset, it.second->size));
+	std::sort(memories.begin(), memories.end());
+	for (auto &mem : memories)
+		f << mem;
+
+	// processes are rare at the point where modules are compared, they are
+	// included with their names
+	for (auto &it : sorted_items(module->processes))
+		ILANG_BACKEND::dump_proc(f, "", it.second);
+
+	return sha1(f.str());
+}
+
+}
+
+std::string RTLIL::Module::content_hash(bool canonical)
+{
+	int idx = canonical ? 1 : 0;
+	if (content_hash_[idx].empty() || content_hash_generation_[idx] != generation) {
+		content_hash_[idx] = canonical ? canonical_hash(this) : named_hash(this);
+		content_hash_generation_[idx] = generation;
+	}
+	return content_hash_[idx];
+}
+
+YOSYS_NAMESPACE_END
@@ -0,0 +1,45 @@
+/* -*- c++ -*-
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef MODHASH_H
+#define MODHASH_H
+
+#include "kernel/yosys.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// Name-independent labels of the cells and signal bits of a module, as used
+// for Module::content_hash(true). Cells and bits that correspond to each other
+// in two isomorphic modules have the same labels.
+struct ModuleLabels
+{
+	const SigMap *sigmap = nullptr;
+	dict<RTLIL::SigBit, uint64_t> bit_labels;
+	std::vector<RTLIL::Cell*> cells;
+	std::vector<uint64_t> cell_labels;
+
+	void compute(RTLIL::Module *module, int rounds = 4);
+
+	// the label of the mapped bit, also for bits not connected to any cell
+	uint64_t bit_label(RTLIL::SigBit bit) const;
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
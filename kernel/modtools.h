@@ -74,7 +74,7 @@ struct ModIndex : public RTLIL::Monitor
 
 	SigMap sigmap;
 	RTLIL::Module *module;
-	std::map<RTLIL::SigBit, SigBitInfo> database;
+	flat_dict<RTLIL::SigBit, SigBitInfo> database;
 	int auto_reload_counter;
 	bool auto_reload_module;
 
@@ -214,10 +214,88 @@ struct ModIndex : public RTLIL::Monitor
 		}
 	}
 
-	void notify_connect(RTLIL::Module *mod YS_ATTRIBUTE(unused), const std::vector<RTLIL::SigSig>&) YS_OVERRIDE
+	// The module connections are replaced by new_conn. Connections that are
+	// only added are handled like connect(). When connections are removed, the
+	// SigMap is rebuilt and only the entries of the classes that contained a
+	// removed connection are split up again by looking at their ports, all
+	// other entries are moved to their (possibly new) representative.
+	void notify_connect(RTLIL::Module *mod YS_ATTRIBUTE(unused), const std::vector<RTLIL::SigSig> &new_conn) YS_OVERRIDE
 	{
 		log_assert(module == mod);
-		auto_reload_module = true;
+
+		if (auto_reload_module)
+			return;
+
+		dict<RTLIL::SigSig, int> old_count;
+		for (auto &conn : module->connections())
+			old_count[conn]++;
+
+		std::vector<RTLIL::SigSig> added;
+		for (auto &conn : new_conn) {
+			auto it = old_count.find(conn);
+			if (it != old_count.end() && it->second > 0)
+				it->second--;
+			else
+				added.push_back(conn);
+		}
+
+		// ports on bits that were driven by a constant are not in the database
+		pool<RTLIL::SigBit> affected;
+		for (auto &it : old_count)
+			if (it.second > 0)
+				for (auto &sig : {it.first.first, it.first.second})
+					for (auto bit : sigmap(sig)) {
+						if (bit.wire == nullptr) {
+							auto_reload_module = true;
+							return;
+						}
+						affected.insert(bit);
+					}
+
+		if (affected.empty()) {
+			for (auto &conn : added)
+				notify_connect(mod, conn);
+			return;
+		}
+
+		SigMap new_sigmap;
+		for (auto &conn : new_conn)
+			new_sigmap.add(conn.first, conn.second);
+
+		flat_dict<RTLIL::SigBit, SigBitInfo> new_database;
+		std::vector<PortInfo> split_ports;
+
+		for (auto &it : database) {
+			if (affected.count(it.first)) {
+				split_ports.insert(split_ports.end(), it.second.ports.begin(), it.second.ports.end());
+				continue;
+			}
+			RTLIL::SigBit bit = new_sigmap(it.first);
+			if (bit.wire)
+				new_database[bit].merge(it.second);
+		}
+
+		for (auto &port : split_ports) {
+			RTLIL::SigBit bit = new_sigmap(port.cell->getPort(port.port)[port.offset]);
+			if (bit.wire)
+				new_database[bit].ports.insert(port);
+		}
+
+		for (auto wire : module->wires())
+			if (wire->port_input || wire->port_output)
+				for (int i = 0; i < GetSize(wire); i++) {
+					RTLIL::SigBit bit(wire, i);
+					if (!affected.count(sigmap(bit)))
+						continue;
+					bit = new_sigmap(bit);
+					if (bit.wire && wire->port_input)
+						new_database[bit].is_input = true;
+					if (bit.wire && wire->port_output)
+						new_database[bit].is_output = true;
+				}
+
+		sigmap.swap(new_sigmap);
+		database.swap(new_database);
 	}
 
 	void notify_blackout(RTLIL::Module *mod YS_ATTRIBUTE(unused)) YS_OVERRIDE
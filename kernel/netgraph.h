@@ -0,0 +1,242 @@
+/* -*- c++ -*-
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+// Compact directed graphs over numbered netlist objects (cells or bits), stored
+// as arrays of successor indices, with graph algorithms that do not recurse and
+// therefore work on flattened netlists with millions of cells.
+
+#ifndef NETGRAPH_H
+#define NETGRAPH_H
+
+#include "kernel/yosys.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+struct CsrGraph
+{
+	struct Edge {
+		int src, dst, value;
+	};
+
+	// the successors of node i are succ[offsets[i] .. offsets[i+1]-1], and the
+	// value given for each edge (e.g. the index of a cell) is in values[]
+	std::vector<int> offsets, succ, values;
+
+	int size() const {
+		return GetSize(offsets) - 1;
+	}
+
+	// duplicate edges are removed, keeping the value of the first one
+	void build(int num_nodes, std::vector<Edge> &edges)
+	{
+		std::stable_sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) {
+			return a.src != b.src ? a.src < b.src : a.dst < b.dst;
+		});
+
+		offsets.assign(num_nodes+1, 0);
+		succ.clear();
+		values.clear();
+
+		for (int i = 0; i < GetSize(edges); i++) {
+			if (i > 0 && edges[i].src == edges[i-1].src && edges[i].dst == edges[i-1].dst)
+				continue;
+			offsets[edges[i].src+1]++;
+			succ.push_back(edges[i].dst);
+			values.push_back(edges[i].value);
+		}
+
+		for (int i = 0; i < num_nodes; i++)
+			offsets[i+1] += offsets[i];
+	}
+
+	bool has_edge(int src, int dst) const {
+		return std::binary_search(succ.begin() + offsets[src], succ.begin() + offsets[src+1], dst);
+	}
+
+	// Strongly connected components with more than one node (Tarjan's algorithm).
+	// The search starts at the nodes in index order. With max_depth >= 0, edges
+	// back to nodes more than max_depth levels up the search path do not close a
+	// loop, so that only loops of about that length are found.
+	std::vector<std::vector<int>> find_sccs(int max_depth = -1) const
+	{
+		int num_nodes = size();
+		std::vector<std::vector<int>> result;
+
+		std::vector<int> label(num_nodes, -1), lowlink(num_nodes), depth(num_nodes);
+		std::vector<bool> on_stack(num_nodes);
+		std::vector<int> scc_stack;
+		std::vector<std::pair<int, int>> search_stack;
+		int label_counter = 0;
+
+		for (int root = 0; root < num_nodes; root++)
+		{
+			if (label[root] >= 0)
+				continue;
+
+			search_stack.push_back(std::make_pair(root, offsets[root]));
+			label[root] = lowlink[root] = label_counter++;
+			depth[root] = 0;
+			scc_stack.push_back(root);
+			on_stack[root] = true;
+
+			while (!search_stack.empty())
+			{
+				int n = search_stack.back().first;
+				int edge_pos = search_stack.back().second;
+
+				if (edge_pos < offsets[n+1]) {
+					search_stack.back().second++;
+					int next = succ[edge_pos];
+					if (label[next] < 0) {
+						search_stack.push_back(std::make_pair(next, offsets[next]));
+						label[next] = lowlink[next] = label_counter++;
+						depth[next] = depth[n] + 1;
+						scc_stack.push_back(next);
+						on_stack[next] = true;
+					} else
+					if (on_stack[next] && (max_depth < 0 || depth[next] + max_depth > depth[n]))
+						lowlink[n] = std::min(lowlink[n], lowlink[next]);
+					continue;
+				}
+
+				search_stack.pop_back();
+				if (!search_stack.empty()) {
+					int parent = search_stack.back().first;
+					lowlink[parent] = std::min(lowlink[parent], lowlink[n]);
+				}
+
+				if (label[n] != lowlink[n])
+					continue;
+
+				std::vector<int> scc;
+				while (true) {
+					int m = scc_stack.back();
+					scc_stack.pop_back();
+					on_stack[m] = false;
+					scc.push_back(m);
+					if (m == n)
+						break;
+				}
+				if (GetSize(scc) > 1)
+					result.push_back(scc);
+			}
+		}
+
+		return result;
+	}
+
+	// For each node the length of the longest path ending there, and the index of
+	// the last edge on that path (or -1). Edges that close a loop are ignored and
+	// the nodes they lead to are returned in loop_nodes.
+	void longest_paths(std::vector<int> &level, std::vector<int> &via_edge, std::vector<int> &loop_nodes) const
+	{
+		int num_nodes = size();
+
+		// 0 = not visited, 1 = on the search stack, 2 = done
+		std::vector<char> state(num_nodes);
+		std::vector<bool> back_edge(GetSize(succ));
+		std::vector<int> postorder;
+		std::vector<std::pair<int, int>> search_stack;
+
+		postorder.reserve(num_nodes);
+		loop_nodes.clear();
+
+		for (int root = 0; root < num_nodes; root++)
+		{
+			if (state[root] != 0)
+				continue;
+
+			search_stack.push_back(std::make_pair(root, offsets[root]));
+			state[root] = 1;
+
+			while (!search_stack.empty())
+			{
+				int n = search_stack.back().first;
+				int edge_pos = search_stack.back().second;
+
+				if (edge_pos < offsets[n+1]) {
+					search_stack.back().second++;
+					int next = succ[edge_pos];
+					if (state[next] == 0) {
+						search_stack.push_back(std::make_pair(next, offsets[next]));
+						state[next] = 1;
+					} else if (state[next] == 1) {
+						back_edge[edge_pos] = true;
+						loop_nodes.push_back(next);
+					}
+					continue;
+				}
+
+				search_stack.pop_back();
+				state[n] = 2;
+				postorder.push_back(n);
+			}
+		}
+
+		level.assign(num_nodes, 0);
+		via_edge.assign(num_nodes, -1);
+
+		for (int i = num_nodes-1; i >= 0; i--) {
+			int n = postorder[i];
+			for (int e = offsets[n]; e < offsets[n+1]; e++)
+				if (!back_edge[e] && level[n] + 1 > level[succ[e]]) {
+					level[succ[e]] = level[n] + 1;
+					via_edge[succ[e]] = e;
+				}
+		}
+	}
+};
+
+// Collects the signal bits driven and used by numbered netlist objects and
+// builds the graph with an edge from each driver to each user of a bit. The
+// caller is expected to pass signals that are already mapped with a SigMap.
+struct NetGraphBuilder
+{
+	dict<RTLIL::SigBit, std::vector<int>> bit_drivers, bit_users;
+
+	void add_driver(int node, const RTLIL::SigSpec &sig) {
+		for (auto bit : sig)
+			if (bit.wire != nullptr)
+				bit_drivers[bit].push_back(node);
+	}
+
+	void add_user(int node, const RTLIL::SigSpec &sig) {
+		for (auto bit : sig)
+			if (bit.wire != nullptr)
+				bit_users[bit].push_back(node);
+	}
+
+	void build(CsrGraph &graph, int num_nodes) const
+	{
+		std::vector<CsrGraph::Edge> edges;
+		for (auto &it : bit_drivers) {
+			auto users = bit_users.find(it.first);
+			if (users == bit_users.end())
+				continue;
+			for (int driver : it.second)
+			for (int user : users->second)
+				edges.push_back(CsrGraph::Edge{driver, user, -1});
+		}
+		graph.build(num_nodes, edges);
+	}
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
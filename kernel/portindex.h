@@ -0,0 +1,118 @@
+/* -*- c++ -*-
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef PORTINDEX_H
+#define PORTINDEX_H
+
+#include "kernel/yosys.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// The lookups that the passes inserting pads and buffers (iopadmap, clkbufmap)
+// need about a module, built in one pass over its cells and connections: the
+// cells of each type, and the bits driven by cell outputs and by module
+// connections. Whether a port is an output is looked up once per cell type and
+// port name, not once per cell.
+//
+// Bits are not mapped with a SigMap. The index is not updated when the module
+// changes, passes build it before they insert cells.
+struct PortBitIndex
+{
+	RTLIL::Module *module = nullptr;
+
+	// cells of each type, in module order
+	dict<RTLIL::IdString, std::vector<RTLIL::Cell*>> type_cells;
+
+	// the number of cell outputs connected to each bit. The ports of cells of
+	// unknown type have no direction, their bits are in unknown_bits.
+	dict<RTLIL::SigBit, int> driver_count;
+	pool<RTLIL::SigBit> unknown_bits;
+
+	// bits on the left hand side of module connections, except those
+	// connected to 'z
+	pool<RTLIL::SigBit> assigned_bits;
+
+	void clear()
+	{
+		module = nullptr;
+		type_cells.clear();
+		driver_count.clear();
+		unknown_bits.clear();
+		assigned_bits.clear();
+	}
+
+	void setup(RTLIL::Module *module)
+	{
+		clear();
+		this->module = module;
+
+		dict<RTLIL::IdString, bool> known_types;
+		dict<std::pair<RTLIL::IdString, RTLIL::IdString>, bool> output_ports;
+
+		for (auto cell : module->cells())
+		{
+			type_cells[cell->type].push_back(cell);
+
+			auto known_it = known_types.find(cell->type);
+			if (known_it == known_types.end())
+				known_it = known_types.insert(std::make_pair(cell->type, cell->known())).first;
+
+			for (auto &conn : cell->connections()) {
+				if (!known_it->second) {
+					for (auto bit : conn.second)
+						unknown_bits.insert(bit);
+					continue;
+				}
+				auto key = std::make_pair(cell->type, conn.first);
+				auto output_it = output_ports.find(key);
+				if (output_it == output_ports.end())
+					output_it = output_ports.insert(std::make_pair(key, cell->output(conn.first))).first;
+				if (output_it->second)
+					for (auto bit : conn.second)
+						driver_count[bit]++;
+			}
+		}
+
+		for (auto &conn : module->connections())
+			for (int i = 0; i < GetSize(conn.first); i++) {
+				RTLIL::SigBit srcbit = conn.second[i];
+				if (srcbit.wire == nullptr && srcbit.data == RTLIL::State::Sz)
+					continue;
+				assigned_bits.insert(conn.first[i]);
+			}
+	}
+
+	// empty for types that have no cells in the module
+	const std::vector<RTLIL::Cell*> &cells(RTLIL::IdString type) const
+	{
+		static const std::vector<RTLIL::Cell*> empty;
+		auto it = type_cells.find(type);
+		return it == type_cells.end() ? empty : it->second;
+	}
+
+	int drivers(const RTLIL::SigBit &bit) const
+	{
+		auto it = driver_count.find(bit);
+		return it == driver_count.end() ? 0 : it->second;
+	}
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
@@ -0,0 +1,244 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef RANDSIM_H
+#define RANDSIM_H
+
+#include "kernel/rtlil.h"
+#include "kernel/sigtools.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// Bit-parallel random simulation, used to cheaply refute candidate
+// equivalences before they are handed to a SAT solver. Every net is simulated
+// as a 64 bit word, i.e. for 64 random input patterns at once, and values are
+// computed on demand from the cells registered with add_cell().
+//
+// Nets without a registered driver are free inputs and get a new random word
+// in every time step. Flip-flop outputs are free in time step 0 and take the
+// value of their D input in the previous time step after that. A net that
+// depends on a cell without a simulation model, on an undefined constant or
+// on a combinational loop is unknown and get() returns false for it.
+//
+// Two nets with different known values are different for some fully defined
+// assignment of the free inputs, so a SAT based check would find the same.
+
+struct RandomSim
+{
+	typedef uint64_t word_t;
+
+	const SigMap &sigmap;
+	dict<SigBit, pair<Cell*, int>> drivers;
+	vector<dict<SigBit, pair<bool, word_t>>> values;
+	uint64_t rng_state;
+
+	RandomSim(const SigMap &sigmap, uint64_t seed = 1) : sigmap(sigmap), rng_state(seed ? seed : 1)
+	{
+	}
+
+	void add_cell(Cell *cell)
+	{
+		for (auto &conn : cell->connections())
+			if (cell->output(conn.first)) {
+				SigSpec sig = sigmap(conn.second);
+				for (int i = 0; i < GetSize(sig); i++)
+					if (sig[i].wire != nullptr)
+						drivers[sig[i]] = make_pair(cell, i);
+			}
+	}
+
+	// forget all values, the next get() calls use new random inputs
+	void next_round()
+	{
+		values.clear();
+	}
+
+	word_t random_word()
+	{
+		rng_state ^= rng_state << 13;
+		rng_state ^= rng_state >> 7;
+		rng_state ^= rng_state << 17;
+		return rng_state;
+	}
+
+	bool get(SigBit bit, word_t &value, int step = 0)
+	{
+		bit = sigmap(bit);
+
+		if (bit.wire == nullptr) {
+			value = bit.data == State::S1 ? ~word_t(0) : 0;
+			return bit.data == State::S0 || bit.data == State::S1;
+		}
+
+		if (GetSize(values) <= step)
+			values.resize(step+1);
+
+		auto it = values[step].find(bit);
+		if (it != values[step].end()) {
+			value = it->second.second;
+			return it->second.first;
+		}
+
+		// marks the net as unknown while its cone is visited (loops)
+		values[step][bit] = make_pair(false, word_t(0));
+
+		bool known = true;
+		auto drv = drivers.find(bit);
+		if (drv == drivers.end())
+			value = random_word();
+		else
+			known = eval_cell(drv->second.first, drv->second.second, step, value);
+
+		values[step][bit] = make_pair(known, value);
+		return known;
+	}
+
+	bool get_port(Cell *cell, IdString port, int idx, int step, word_t &value)
+	{
+		SigSpec sig = cell->getPort(port);
+		if (idx >= GetSize(sig))
+			return false;
+		return get(sig[idx], value, step);
+	}
+
+	// the reductions of all bits of a port: OR, AND and XOR
+	bool get_reduce(Cell *cell, IdString port, int step, word_t &any, word_t &all, word_t &parity)
+	{
+		any = 0, all = ~word_t(0), parity = 0;
+		for (auto bit : cell->getPort(port)) {
+			word_t v;
+			if (!get(bit, v, step))
+				return false;
+			any |= v, all &= v, parity ^= v;
+		}
+		return true;
+	}
+
+	bool eval_cell(Cell *cell, int idx, int step, word_t &y)
+	{
+		IdString type = cell->type;
+		word_t a = 0, b = 0, c = 0, d = 0;
+
+		if (type.in(ID($_DFF_P_), ID($_DFF_N_), ID($_FF_), ID($dff), ID($ff))) {
+			if (step == 0) {
+				y = random_word();
+				return true;
+			}
+			return get_port(cell, ID(D), idx, step-1, y);
+		}
+
+		if (type.in(ID($_BUF_), ID($_NOT_), ID($equiv), ID($pos), ID($not))) {
+			if (type.in(ID($pos), ID($not)) && GetSize(cell->getPort(ID::A)) != GetSize(cell->getPort(ID::Y)))
+				return false;
+			if (!get_port(cell, ID::A, idx, step, a))
+				return false;
+			y = type.in(ID($_NOT_), ID($not)) ? ~a : a;
+			return true;
+		}
+
+		if (type.in(ID($and), ID($or), ID($xor), ID($xnor), ID($mux)) &&
+				(GetSize(cell->getPort(ID::A)) != GetSize(cell->getPort(ID::Y)) ||
+				 GetSize(cell->getPort(ID::B)) != GetSize(cell->getPort(ID::Y))))
+			return false;
+
+		if (type.in(ID($_AND_), ID($_NAND_), ID($_OR_), ID($_NOR_), ID($_XOR_), ID($_XNOR_), ID($_ANDNOT_), ID($_ORNOT_),
+				ID($and), ID($or), ID($xor), ID($xnor)))
+		{
+			if (!get_port(cell, ID::A, idx, step, a) || !get_port(cell, ID::B, idx, step, b))
+				return false;
+			if (type.in(ID($_AND_), ID($and)))     y = a & b;
+			if (type == ID($_NAND_))               y = ~(a & b);
+			if (type.in(ID($_OR_), ID($or)))       y = a | b;
+			if (type == ID($_NOR_))                y = ~(a | b);
+			if (type.in(ID($_XOR_), ID($xor)))     y = a ^ b;
+			if (type.in(ID($_XNOR_), ID($xnor)))   y = ~(a ^ b);
+			if (type == ID($_ANDNOT_))             y = a & ~b;
+			if (type == ID($_ORNOT_))              y = a | ~b;
+			return true;
+		}
+
+		if (type.in(ID($_MUX_), ID($_NMUX_), ID($mux)))
+		{
+			if (!get_port(cell, ID::A, idx, step, a) || !get_port(cell, ID::B, idx, step, b) || !get_port(cell, ID(S), 0, step, c))
+				return false;
+			y = (a & ~c) | (b & c);
+			if (type == ID($_NMUX_))
+				y = ~y;
+			return true;
+		}
+
+		if (type.in(ID($_AOI3_), ID($_OAI3_), ID($_AOI4_), ID($_OAI4_)))
+		{
+			if (!get_port(cell, ID::A, idx, step, a) || !get_port(cell, ID::B, idx, step, b) || !get_port(cell, ID(C), idx, step, c))
+				return false;
+			if (type.in(ID($_AOI4_), ID($_OAI4_)) && !get_port(cell, ID(D), idx, step, d))
+				return false;
+			if (type == ID($_AOI3_)) y = ~((a & b) | c);
+			if (type == ID($_OAI3_)) y = ~((a | b) & c);
+			if (type == ID($_AOI4_)) y = ~((a & b) | (c & d));
+			if (type == ID($_OAI4_)) y = ~((a | b) & (c | d));
+			return true;
+		}
+
+		// cells with a one bit result, the other bits of Y are zero
+		if (type.in(ID($reduce_and), ID($reduce_or), ID($reduce_xor), ID($reduce_xnor), ID($reduce_bool),
+				ID($logic_not), ID($logic_and), ID($logic_or), ID($eq), ID($ne)))
+		{
+			if (idx > 0) {
+				y = 0;
+				return true;
+			}
+
+			if (type.in(ID($eq), ID($ne))) {
+				SigSpec sig_a = cell->getPort(ID::A), sig_b = cell->getPort(ID::B);
+				if (GetSize(sig_a) != GetSize(sig_b))
+					return false;
+				word_t diff = 0;
+				for (int i = 0; i < GetSize(sig_a); i++) {
+					if (!get(sig_a[i], a, step) || !get(sig_b[i], b, step))
+						return false;
+					diff |= a ^ b;
+				}
+				y = type == ID($eq) ? ~diff : diff;
+				return true;
+			}
+
+			word_t any_a, all_a, parity_a, any_b, all_b, parity_b;
+			if (!get_reduce(cell, ID::A, step, any_a, all_a, parity_a))
+				return false;
+			if (type.in(ID($logic_and), ID($logic_or)) && !get_reduce(cell, ID::B, step, any_b, all_b, parity_b))
+				return false;
+
+			if (type == ID($reduce_and))                     y = all_a;
+			if (type.in(ID($reduce_or), ID($reduce_bool)))   y = any_a;
+			if (type == ID($reduce_xor))                     y = parity_a;
+			if (type == ID($reduce_xnor))                    y = ~parity_a;
+			if (type == ID($logic_not))                      y = ~any_a;
+			if (type == ID($logic_and))                      y = any_a & any_b;
+			if (type == ID($logic_or))                       y = any_a | any_b;
+			return true;
+		}
+
+		return false;
+	}
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
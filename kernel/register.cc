@@ -19,34 +19,239 @@
 
 #include "kernel/yosys.h"
 #include "kernel/satgen.h"
+#include "kernel/threadpool.h"
+#include "backends/rtlil_bin/rtlil_bin.h"
+#include "libs/sha1/sha1.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#ifdef YOSYS_ENABLE_THREADS
+#include <future>
+#endif
 
 #ifdef YOSYS_ENABLE_ZLIB
 #include <zlib.h>
+#endif
 
+#ifdef YOSYS_ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+#if defined(YOSYS_ENABLE_ZLIB) || defined(YOSYS_ENABLE_ZSTD)
+USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
-#define GZ_BUFFER_SIZE 8192
-void decompress_gzip(const std::string &filename, std::stringstream &out)
-{
-	char buffer[GZ_BUFFER_SIZE];
-	int bytes_read;
-	gzFile gzf = gzopen(filename.c_str(), "rb");
-	while(!gzeof(gzf)) {
-		bytes_read = gzread(gzf, reinterpret_cast<void *>(buffer), GZ_BUFFER_SIZE);
-		out.write(buffer, bytes_read);
+
+/*
+An input stream buffer that decompresses the file while the frontend reads it,
+so that the uncompressed data never has to be in memory as a whole. The last
+few bytes before the read position are kept for unget().
+*/
+class decompress_streambuf : public std::streambuf {
+public:
+	decompress_streambuf(const std::string &filename) : filename(filename), buffer(putback_size + buffer_size) { }
+protected:
+	static const size_t putback_size = 16;
+	static const size_t buffer_size = 256 * 1024;
+
+	std::string filename;
+	std::vector<char> buffer;
+
+	// reads up to size bytes of decompressed data, 0 at the end of the file
+	virtual size_t read_block(char *data, size_t size) = 0;
+
+	virtual int_type underflow() override
+	{
+		if (gptr() < egptr())
+			return traits_type::to_int_type(*gptr());
+
+		size_t keep = 0;
+		if (gptr() != nullptr) {
+			keep = std::min(size_t(gptr() - eback()), putback_size);
+			memmove(buffer.data() + putback_size - keep, gptr() - keep, keep);
+		}
+
+		size_t n = read_block(buffer.data() + putback_size, buffer_size);
+		if (n == 0)
+			return traits_type::eof();
+
+		setg(buffer.data() + putback_size - keep, buffer.data() + putback_size, buffer.data() + putback_size + n);
+		return traits_type::to_int_type(*gptr());
 	}
-	gzclose(gzf);
-}
+};
+
+class decompress_istream : public std::istream {
+public:
+	decompress_istream(decompress_streambuf *buf) : std::istream(buf), buf(buf) { }
+private:
+	std::unique_ptr<decompress_streambuf> buf;
+};
+
+#ifdef YOSYS_ENABLE_ZLIB
+class gzip_istreambuf : public decompress_streambuf {
+public:
+	gzip_istreambuf(const std::string &filename) : decompress_streambuf(filename)
+	{
+		gzf = gzopen(filename.c_str(), "rb");
+		if (gzf == nullptr)
+			log_cmd_error("Can't open input file `%s' for reading: %s\n", filename.c_str(), strerror(errno));
+		gzbuffer(gzf, buffer_size);
+	}
+	virtual ~gzip_istreambuf()
+	{
+		gzclose(gzf);
+	}
+private:
+	gzFile gzf;
+
+	size_t read_block(char *data, size_t size) override
+	{
+		int n = gzread(gzf, data, unsigned(size));
+		if (n < 0) {
+			int errnum;
+			log_error("Error while decompressing `%s': %s\n", filename.c_str(), gzerror(gzf, &errnum));
+		}
+		return n;
+	}
+};
 
 /*
-An output stream that uses a stringbuf to buffer data internally,
-using zlib to write gzip-compressed data every time the stream is flushed.
+An output stream buffer that writes a gzip file. The data is cut into blocks
+that are compressed as tasks of a TaskGroup while the backend keeps writing.
+Like in pigz, every block is compressed with the end of the previous block as
+dictionary and ends with a sync flush, so the blocks form one deflate stream
+and the result is a normal gzip file with almost the same size as from zlib.
+The compressed blocks are written in order as soon as they are done.
 */
-class gzip_ostream : public std::ostream  {
+class gzip_ostreambuf : public std::streambuf {
+public:
+	gzip_ostreambuf() : buffer(block_size)
+	{
+		setp(buffer.data(), buffer.data() + buffer.size());
+		max_pending = 2 * std::max(yosys_threads, 1);
+		crc = crc32(0, nullptr, 0);
+	}
+	bool open(const std::string &filename)
+	{
+		f.open(filename.c_str(), std::ofstream::trunc | std::ofstream::binary);
+		if (f.fail())
+			return false;
+		static const char header[10] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, 3};
+		f.write(header, sizeof(header));
+		return true;
+	}
+	virtual ~gzip_ostreambuf()
+	{
+		if (!f.is_open())
+			return;
+		submit_block(true);
+		while (!pending.empty())
+			write_block();
+		char trailer[8];
+		for (int i = 0; i < 4; i++) {
+			trailer[i] = (crc >> (8*i)) & 0xff;
+			trailer[4+i] = (total_size >> (8*i)) & 0xff;
+		}
+		f.write(trailer, sizeof(trailer));
+	}
+private:
+	static const size_t block_size = 1024 * 1024;
+	static const size_t dict_size = 32 * 1024;
+
+	struct Block {
+		std::string data, dict, out;
+		uLong crc = 0;
+		bool last = false;
+	};
+
+	std::ofstream f;
+	std::vector<char> buffer;
+	std::string dict;
+	std::unique_ptr<TaskGroup> tasks;
+	std::vector<std::shared_ptr<Block>> pending;
+	int pending_begin = 0, written_tasks = 0, max_pending;
+	uLong crc;
+	unsigned long long total_size = 0;
+
+	static void compress_block(Block &block)
+	{
+		z_stream zs;
+		memset(&zs, 0, sizeof(zs));
+		if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+			log_abort();
+		if (!block.dict.empty())
+			deflateSetDictionary(&zs, reinterpret_cast<const Bytef*>(block.dict.data()), block.dict.size());
+
+		block.out.resize(deflateBound(&zs, block.data.size()) + 16);
+		zs.next_in = reinterpret_cast<Bytef*>(&block.data[0]);
+		zs.avail_in = block.data.size();
+		while (1) {
+			zs.next_out = reinterpret_cast<Bytef*>(&block.out[zs.total_out]);
+			zs.avail_out = block.out.size() - zs.total_out;
+			deflate(&zs, block.last ? Z_FINISH : Z_SYNC_FLUSH);
+			if (zs.avail_out != 0)
+				break;
+			block.out.resize(2 * block.out.size());
+		}
+		block.out.resize(zs.total_out);
+		deflateEnd(&zs);
+
+		block.crc = crc32(0, reinterpret_cast<const Bytef*>(block.data.data()), block.data.size());
+	}
+
+	void submit_block(bool last)
+	{
+		auto block = std::make_shared<Block>();
+		block->data.assign(pbase(), pptr());
+		block->dict.swap(dict);
+		block->last = last;
+		setp(buffer.data(), buffer.data() + buffer.size());
+
+		size_t n = block->data.size();
+		dict = block->data.substr(n > dict_size ? n - dict_size : 0);
+
+		if (tasks == nullptr)
+			tasks.reset(new TaskGroup);
+		pending.push_back(block);
+		tasks->run([block]() { compress_block(*block); });
+
+		while (GetSize(pending) - pending_begin > max_pending)
+			write_block();
+	}
+
+	void write_block()
+	{
+		tasks->wait(written_tasks++);
+		std::shared_ptr<Block> block;
+		block.swap(pending[pending_begin++]);
+		f.write(block->out.data(), block->out.size());
+		crc = crc32_combine(crc, block->crc, block->data.size());
+		total_size += block->data.size();
+		if (pending_begin == GetSize(pending)) {
+			pending.clear();
+			pending_begin = 0;
+		}
+	}
+
+	virtual int_type overflow(int_type c) override
+	{
+		submit_block(false);
+		if (!traits_type::eq_int_type(c, traits_type::eof())) {
+			*pptr() = traits_type::to_char_type(c);
+			pbump(1);
+		}
+		return traits_type::not_eof(c);
+	}
+};
+
+class gzip_ostream : public std::ostream {
 public:
 	gzip_ostream() : std::ostream(nullptr)
 	{
@@ -57,31 +262,127 @@ public:
 		return outbuf.open(filename);
 	}
 private:
-	class gzip_streambuf : public std::stringbuf {
-	public:
-		gzip_streambuf() { };
-		bool open(const std::string &filename)
-		{
-			gzf = gzopen(filename.c_str(), "wb");
-			return gzf != nullptr;
+	gzip_ostreambuf outbuf;
+};
+#endif
+
+#ifdef YOSYS_ENABLE_ZSTD
+class zstd_istreambuf : public decompress_streambuf {
+public:
+	zstd_istreambuf(const std::string &filename) : decompress_streambuf(filename), in_buffer(ZSTD_DStreamInSize())
+	{
+		f = fopen(filename.c_str(), "rb");
+		if (f == nullptr)
+			log_cmd_error("Can't open input file `%s' for reading: %s\n", filename.c_str(), strerror(errno));
+		dctx = ZSTD_createDCtx();
+		input.src = in_buffer.data();
+		input.size = 0;
+		input.pos = 0;
+	}
+	virtual ~zstd_istreambuf()
+	{
+		ZSTD_freeDCtx(dctx);
+		fclose(f);
+	}
+private:
+	FILE *f;
+	ZSTD_DCtx *dctx;
+	std::vector<char> in_buffer;
+	ZSTD_inBuffer input;
+	size_t frame_remaining = 0;
+
+	size_t read_block(char *data, size_t size) override
+	{
+		ZSTD_outBuffer output = { data, size, 0 };
+		while (output.pos == 0) {
+			if (input.pos == input.size) {
+				input.size = fread(in_buffer.data(), 1, in_buffer.size(), f);
+				input.pos = 0;
+				if (input.size == 0) {
+					if (frame_remaining != 0)
+						log_error("Error while decompressing `%s': truncated input\n", filename.c_str());
+					return 0;
+				}
+			}
+			frame_remaining = ZSTD_decompressStream(dctx, &output, &input);
+			if (ZSTD_isError(frame_remaining))
+				log_error("Error while decompressing `%s': %s\n", filename.c_str(), ZSTD_getErrorName(frame_remaining));
 		}
-		virtual int sync() override
-		{
-			gzwrite(gzf, reinterpret_cast<const void *>(str().c_str()), unsigned(str().size()));
-			str("");
-			return 0;
+		return output.pos;
+	}
+};
+
+/*
+An output stream buffer that writes a zstd file. The compression runs on
+yosys_threads worker threads of libzstd, if it was built with thread support.
+*/
+class zstd_ostreambuf : public std::streambuf {
+public:
+	zstd_ostreambuf() : buffer(ZSTD_CStreamInSize()), out_buffer(ZSTD_CStreamOutSize())
+	{
+		setp(buffer.data(), buffer.data() + buffer.size());
+		cctx = ZSTD_createCCtx();
+		if (yosys_threads > 1)
+			ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, yosys_threads);
+	}
+	bool open(const std::string &filename)
+	{
+		f.open(filename.c_str(), std::ofstream::trunc | std::ofstream::binary);
+		return !f.fail();
+	}
+	virtual ~zstd_ostreambuf()
+	{
+		if (f.is_open())
+			compress(ZSTD_e_end);
+		ZSTD_freeCCtx(cctx);
+	}
+private:
+	std::ofstream f;
+	std::vector<char> buffer, out_buffer;
+	ZSTD_CCtx *cctx;
+
+	void compress(ZSTD_EndDirective mode)
+	{
+		ZSTD_inBuffer input = { pbase(), size_t(pptr() - pbase()), 0 };
+		while (1) {
+			ZSTD_outBuffer output = { out_buffer.data(), out_buffer.size(), 0 };
+			size_t remaining = ZSTD_compressStream2(cctx, &output, &input, mode);
+			if (ZSTD_isError(remaining))
+				log_error("Error while compressing output: %s\n", ZSTD_getErrorName(remaining));
+			f.write(out_buffer.data(), output.pos);
+			if (mode == ZSTD_e_end ? remaining == 0 : input.pos == input.size)
+				break;
 		}
-		virtual ~gzip_streambuf()
-		{
-			sync();
-			gzclose(gzf);
+		setp(buffer.data(), buffer.data() + buffer.size());
+	}
+
+	virtual int_type overflow(int_type c) override
+	{
+		compress(ZSTD_e_continue);
+		if (!traits_type::eq_int_type(c, traits_type::eof())) {
+			*pptr() = traits_type::to_char_type(c);
+			pbump(1);
 		}
-	private:
-		gzFile gzf = nullptr;
-	} outbuf;
+		return traits_type::not_eof(c);
+	}
 };
-PRIVATE_NAMESPACE_END
 
+class zstd_ostream : public std::ostream {
+public:
+	zstd_ostream() : std::ostream(nullptr)
+	{
+		rdbuf(&outbuf);
+	}
+	bool open(const std::string &filename)
+	{
+		return outbuf.open(filename);
+	}
+private:
+	zstd_ostreambuf outbuf;
+};
+#endif
+
+PRIVATE_NAMESPACE_END
 #endif
 
 YOSYS_NAMESPACE_BEGIN
@@ -147,9 +448,82 @@ Pass::~Pass()
 {
 }
 
+static bool profile_enabled = false;
+static std::vector<PassProfileEvent> profile_events;
+static std::vector<int> profile_stack;
+
+void pass_profile_on()
+{
+	profile_enabled = true;
+	alloc_counter_on();
+}
+
+bool pass_profile_active()
+{
+	return profile_enabled;
+}
+
+static int64_t profile_maxrss_kb()
+{
+#ifdef _WIN32
+	return 0;
+#else
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+#  ifdef __APPLE__
+	return ru.ru_maxrss / 1024;
+#  else
+	return ru.ru_maxrss;
+#  endif
+#endif
+}
+
+static void profile_count_objects(int &cells, int &wires)
+{
+	cells = 0, wires = 0;
+	if (yosys_design == nullptr)
+		return;
+	for (auto module : yosys_design->modules()) {
+		cells += GetSize(module->cells_);
+		wires += GetSize(module->wires_);
+	}
+}
+
+static void profile_begin(PassProfileEvent &ev)
+{
+	profile_count_objects(ev.begin_cells, ev.begin_wires);
+	ev.begin_maxrss_kb = profile_maxrss_kb();
+	ev.begin_allocs = alloc_counter_get();
+	ev.begin_ns = PerformanceTimer::query();
+	ev.end_ns = -1;
+}
+
+static void profile_end(PassProfileEvent &ev)
+{
+	ev.end_ns = PerformanceTimer::query();
+	ev.end_allocs = alloc_counter_get();
+	ev.end_maxrss_kb = profile_maxrss_kb();
+	profile_count_objects(ev.end_cells, ev.end_wires);
+}
+
 Pass::pre_post_exec_state_t Pass::pre_execute()
 {
 	pre_post_exec_state_t state;
+	state.profile_event = -1;
+
+	// Frontends and backends called via Pass::call() enter pre_execute()
+	// twice. Calls from ModulePass worker threads are part of their pass.
+	bool profile = profile_enabled && current_pass != this && !task_active();
+	if (profile) {
+		state.profile_event = GetSize(profile_events);
+		profile_events.push_back(PassProfileEvent());
+		PassProfileEvent &ev = profile_events.back();
+		ev.name = pass_name;
+		ev.depth = GetSize(profile_stack);
+		profile_stack.push_back(state.profile_event);
+		profile_begin(ev);
+	}
+
 	call_counter++;
 	state.begin_ns = PerformanceTimer::query();
 	state.parent_pass = current_pass;
@@ -168,6 +542,111 @@ void Pass::post_execute(Pass::pre_post_exec_state_t state)
 	current_pass = state.parent_pass;
 	if (current_pass)
 		current_pass->runtime_ns -= time_ns;
+
+	if (state.profile_event >= 0) {
+		// also closes events of nested calls that were left by an error
+		while (!profile_stack.empty() && profile_stack.back() >= state.profile_event) {
+			profile_end(profile_events[profile_stack.back()]);
+			profile_stack.pop_back();
+		}
+	}
+}
+
+static void profile_write_string(std::ostream &f, const std::string &str)
+{
+	f << "\"";
+	for (char c : str) {
+		if (c == '"' || c == '\\')
+			f << "\\" << c;
+		else if ((unsigned char)c < 0x20)
+			f << stringf("\\u%04x", c);
+		else
+			f << c;
+	}
+	f << "\"";
+}
+
+void pass_profile_write(std::ostream &f)
+{
+	std::vector<PassProfileEvent> events = profile_events;
+	for (auto &ev : events)
+		if (ev.end_ns < 0)
+			profile_end(ev);
+
+	struct summary_t {
+		int calls = 0;
+		int64_t total_ns = 0, self_ns = 0, self_allocs = 0, maxrss_delta_kb = 0;
+		int self_cells_delta = 0, self_wires_delta = 0;
+	};
+	std::map<std::string, summary_t> summary;
+
+	// events are stored in pre-order, so the parents of an event are the open
+	// events of lower depth before it
+	std::vector<int> parents;
+	for (int i = 0; i < GetSize(events); i++)
+	{
+		auto &ev = events[i];
+		parents.resize(std::min(GetSize(parents), ev.depth));
+
+		auto &s = summary[ev.name];
+		bool nested_in_same = false;
+		for (int p : parents)
+			if (events[p].name == ev.name)
+				nested_in_same = true;
+
+		int64_t dur_ns = ev.end_ns - ev.begin_ns;
+		int64_t allocs = ev.end_allocs - ev.begin_allocs;
+		int cells_delta = ev.end_cells - ev.begin_cells;
+		int wires_delta = ev.end_wires - ev.begin_wires;
+
+		s.calls++;
+		if (!nested_in_same)
+			s.total_ns += dur_ns;
+		s.self_ns += dur_ns;
+		s.self_allocs += allocs;
+		s.self_cells_delta += cells_delta;
+		s.self_wires_delta += wires_delta;
+		s.maxrss_delta_kb = std::max(s.maxrss_delta_kb, ev.end_maxrss_kb - ev.begin_maxrss_kb);
+
+		if (!parents.empty()) {
+			auto &ps = summary[events[parents.back()].name];
+			ps.self_ns -= dur_ns;
+			ps.self_allocs -= allocs;
+			ps.self_cells_delta -= cells_delta;
+			ps.self_wires_delta -= wires_delta;
+		}
+
+		parents.push_back(i);
+	}
+
+	int64_t base_ns = events.empty() ? 0 : events.front().begin_ns;
+
+	f << "{\n  \"traceEvents\": [";
+	for (int i = 0; i < GetSize(events); i++)
+	{
+		auto &ev = events[i];
+		f << (i ? ",\n" : "\n") << "    {\"name\": ";
+		profile_write_string(f, ev.name);
+		f << stringf(", \"cat\": \"pass\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": %.3f, \"dur\": %.3f, \"args\": {\"command\": ",
+				(ev.begin_ns - base_ns) / 1000.0, (ev.end_ns - ev.begin_ns) / 1000.0);
+		profile_write_string(f, ev.command);
+		f << stringf(", \"depth\": %d, \"allocations\": %lld, \"maxrss_delta_kb\": %lld, \"cells_delta\": %d, \"wires_delta\": %d}}",
+				ev.depth, (long long)(ev.end_allocs - ev.begin_allocs), (long long)(ev.end_maxrss_kb - ev.begin_maxrss_kb),
+				ev.end_cells - ev.begin_cells, ev.end_wires - ev.begin_wires);
+	}
+	f << "\n  ],\n  \"displayTimeUnit\": \"ms\",\n  \"passes\": {";
+
+	bool first = true;
+	for (auto &it : summary) {
+		auto &s = it.second;
+		f << (first ? "\n" : ",\n") << "    ";
+		profile_write_string(f, it.first);
+		f << stringf(": {\"calls\": %d, \"total_ns\": %lld, \"self_ns\": %lld, \"self_allocations\": %lld, \"maxrss_delta_kb\": %lld, \"self_cells_delta\": %d, \"self_wires_delta\": %d}",
+				s.calls, (long long)s.total_ns, (long long)s.self_ns, (long long)s.self_allocs, (long long)s.maxrss_delta_kb,
+				s.self_cells_delta, s.self_wires_delta);
+		first = false;
+	}
+	f << "\n  }\n}\n";
 }
 
 void Pass::help()
@@ -309,8 +788,15 @@ void Pass::call(RTLIL::Design *design, std::vector<std::string> args)
 
 	size_t orig_sel_stack_pos = design->selection_stack.size();
 	auto state = pass_register[args[0]]->pre_execute();
+	if (state.profile_event >= 0) {
+		std::string &command = profile_events[state.profile_event].command;
+		for (size_t i = 0; i < args.size(); i++)
+			command += (i ? " " : "") + args[i];
+	}
 	pass_register[args[0]]->execute(args, design);
 	pass_register[args[0]]->post_execute(state);
+	if (!pass_register[args[0]]->module_changes_tracked_flag)
+		design->touch();
 	while (design->selection_stack.size() > orig_sel_stack_pos)
 		design->selection_stack.pop_back();
 }
@@ -365,6 +851,42 @@ void Pass::call_on_module(RTLIL::Design *design, RTLIL::Module *module, std::vec
 	design->selected_active_module = backup_selected_active_module;
 }
 
+
+void ModulePass::execute_modules(RTLIL::Design *design)
+{
+	execute_modules(design->selected_modules());
+}
+
+void ModulePass::execute_modules(const std::vector<RTLIL::Module*> &modules)
+{
+	int num_threads = std::max(std::min(yosys_threads, GetSize(modules)), 1);
+
+	// design monitors are not prepared for concurrent notifications, and a
+	// pass called from execute_module() runs serially in its worker
+	for (auto module : modules)
+		if (module->design && !module->design->monitors.empty())
+			num_threads = 1;
+	if (task_active())
+		num_threads = 1;
+
+	// the names created with NEW_ID are numbered in module order, so that they
+	// do not depend on the number of threads or the scheduling
+	std::vector<NewIdScope> scopes;
+	for (auto module : modules)
+		scopes.emplace_back(module);
+
+	TaskGroup group(num_threads);
+	for (int i = 0; i < GetSize(modules); i++)
+		group.run([this, &modules, &scopes, i]() {
+			NewIdScope::Guard guard(&scopes[i]);
+			execute_module(modules[i]);
+		});
+	group.wait();
+
+	for (auto &scope : scopes)
+		scope.commit();
+}
+
 bool ScriptPass::check_label(std::string label, std::string info)
 {
 	if (active_design == nullptr) {
@@ -383,6 +905,8 @@ bool ScriptPass::check_label(std::string label, std::string info)
 			if (label == active_run_to)
 				block_active = false;
 		}
+		if (block_active && checkpoint_mode != CHECKPOINT_OFF)
+			checkpoint(label);
 		return block_active;
 	}
 }
@@ -395,11 +919,61 @@ void ScriptPass::run(std::string command, std::string info)
 		else
 			log("        %s    %s\n", command.c_str(), info.c_str());
 	} else {
+		if (checkpoint_mode != CHECKPOINT_OFF) {
+			checkpoint_key = sha1(checkpoint_key + "\n" + command);
+			if (checkpoint_mode != CHECKPOINT_ON)
+				return;
+		}
 		Pass::call(active_design, command);
 		active_design->check();
 	}
 }
 
+// Only the outermost script pass writes checkpoints, script passes called by
+// it (e.g. 'synth -run coarse' in synth_ice40) run their commands directly.
+static bool checkpoint_script_active = false;
+
+void ScriptPass::checkpoint(std::string label)
+{
+	// the key is the hash of the input design and all commands run so far,
+	// there is nothing to restore before the first command
+	if (checkpoint_key == checkpoint_input_key)
+		return;
+
+	std::string filename = stringf("%s/%s-%s-%s.yrb", checkpoint_dir.c_str(), pass_name.c_str(), label.c_str(), checkpoint_key.c_str());
+
+	if (checkpoint_mode == CHECKPOINT_SCAN) {
+		if (check_file_exists(filename))
+			checkpoint_resume_file = filename;
+		return;
+	}
+
+	if (checkpoint_mode == CHECKPOINT_SKIP) {
+		if (filename != checkpoint_resume_file)
+			return;
+		log("\nResuming %s at label `%s' from checkpoint `%s'.\n", pass_name.c_str(), label.c_str(), filename.c_str());
+		for (auto module : active_design->modules().to_vector())
+			active_design->remove(module);
+		if (!RTLIL_BIN::read_file(filename, active_design))
+			log_cmd_error("Can't read checkpoint `%s'.\n", filename.c_str());
+		checkpoint_mode = CHECKPOINT_ON;
+		return;
+	}
+
+	if (check_file_exists(filename))
+		return;
+
+	log("\nSaving checkpoint `%s'.\n", filename.c_str());
+	std::string temp_filename = filename + ".tmp";
+	std::ofstream f(temp_filename.c_str(), std::ofstream::binary);
+	if (f.fail())
+		log_cmd_error("Can't open file `%s' for writing: %s\n", temp_filename.c_str(), strerror(errno));
+	RTLIL_BIN::write_design(f, active_design);
+	f.close();
+	if (f.fail() || rename(temp_filename.c_str(), filename.c_str()) != 0)
+		log_cmd_error("Writing checkpoint `%s' failed.\n", filename.c_str());
+}
+
 void ScriptPass::run_script(RTLIL::Design *design, std::string run_from, std::string run_to)
 {
 	help_mode = false;
@@ -407,7 +981,65 @@ void ScriptPass::run_script(RTLIL::Design *design, std::string run_from, std::st
 	block_active = run_from.empty();
 	active_run_from = run_from;
 	active_run_to = run_to;
-	script();
+	checkpoint_mode = CHECKPOINT_OFF;
+
+	checkpoint_dir = design->scratchpad_get_string("script.checkpoint_dir");
+	if (checkpoint_dir.empty() || !run_from.empty() || checkpoint_script_active) {
+		script();
+		return;
+	}
+
+	// The key of the input design covers the modules and the scratchpad
+	// (which holds options for some passes), in a deterministic order.
+	std::stringstream buffer;
+	RTLIL_BIN::write_design(buffer, design);
+	std::vector<std::pair<std::string, std::string>> scratchpad(design->scratchpad.begin(), design->scratchpad.end());
+	std::sort(scratchpad.begin(), scratchpad.end());
+	for (auto &it : scratchpad)
+		buffer << it.first << "=" << it.second << "\n";
+	checkpoint_input_key = sha1(buffer.str());
+	buffer.str(std::string());
+
+	mkdir(checkpoint_dir.c_str()
+#ifndef _WIN32
+			, 0777
+#endif
+	);
+
+	checkpoint_script_active = true;
+	try {
+		// A dry run of the script finds the last label for which a checkpoint
+		// exists. Only the commands (and thus the options of the pass) before a
+		// label determine its key, later changes do not invalidate it.
+		checkpoint_mode = CHECKPOINT_SCAN;
+		checkpoint_key = checkpoint_input_key;
+		checkpoint_resume_file.clear();
+		script();
+
+		if (!checkpoint_resume_file.empty()) {
+			checkpoint_mode = CHECKPOINT_SKIP;
+			checkpoint_key = checkpoint_input_key;
+			block_active = true;
+			script();
+		}
+
+		// a script that depends on the state of the design may take a
+		// different path in the dry run and not reach the checkpoint again
+		if (checkpoint_mode != CHECKPOINT_ON) {
+			if (checkpoint_mode == CHECKPOINT_SKIP)
+				log_warning("Checkpoint `%s' not reached, running %s from the start.\n", checkpoint_resume_file.c_str(), pass_name.c_str());
+			checkpoint_mode = CHECKPOINT_ON;
+			checkpoint_key = checkpoint_input_key;
+			block_active = true;
+			script();
+		}
+	} catch (...) {
+		checkpoint_script_active = false;
+		checkpoint_mode = CHECKPOINT_OFF;
+		throw;
+	}
+	checkpoint_script_active = false;
+	checkpoint_mode = CHECKPOINT_OFF;
 }
 
 void ScriptPass::help_script()
@@ -506,37 +1138,47 @@ void Frontend::extra_args(std::istream *&f, std::string &filename, std::vector<s
 				next_args.insert(next_args.end(), args.begin(), args.begin()+argidx);
 				next_args.insert(next_args.end(), filenames.begin()+1, filenames.end());
 			}
-			std::ifstream *ff = new std::ifstream;
-			ff->open(filename.c_str(), bin_input ? std::ifstream::binary : std::ifstream::in);
+#ifdef YOSYS_ENABLE_THREADS
+			f = use_prefetched_input_file(filename);
+#endif
+			std::ifstream *ff = nullptr;
+			if (f == NULL) {
+				ff = new std::ifstream;
+				ff->open(filename.c_str(), bin_input ? std::ifstream::binary : std::ifstream::in);
+				if (ff->fail())
+					delete ff;
+				else
+					f = ff;
+			}
 			yosys_input_files.insert(filename);
-			if (ff->fail())
-				delete ff;
-			else
-				f = ff;
-			if (f != NULL) {
-				// Check for gzip magic
-				unsigned char magic[3];
-				int n = 0;
-				while (n < 3)
-				{
+			if (ff != NULL && f != NULL) {
+				// Check for gzip and zstd magic, compressed files are
+				// decompressed while the frontend reads them
+				unsigned char magic[4] = {0, 0, 0, 0};
+				for (int n = 0; n < 4; n++) {
 					int c = ff->get();
-					if (c != EOF) {
-						magic[n] = (unsigned char) c;
-					}
-					n++;
+					if (c == EOF)
+						break;
+					magic[n] = (unsigned char) c;
 				}
-				if (n == 3 && magic[0] == 0x1f && magic[1] == 0x8b) {
+				if (magic[0] == 0x1f && magic[1] == 0x8b) {
 	#ifdef YOSYS_ENABLE_ZLIB
 					log("Found gzip magic in file `%s', decompressing using zlib.\n", filename.c_str());
 					if (magic[2] != 8)
 						log_cmd_error("gzip file `%s' uses unsupported compression type %02x\n",
 							filename.c_str(), unsigned(magic[2]));
 					delete ff;
-					std::stringstream *df = new std::stringstream();
-					decompress_gzip(filename, *df);
-					f = df;
+					f = new decompress_istream(new gzip_istreambuf(filename));
 	#else
 					log_cmd_error("File `%s' is a gzip file, but Yosys is compiled without zlib.\n", filename.c_str());
+	#endif
+				} else if (magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+	#ifdef YOSYS_ENABLE_ZSTD
+					log("Found zstd magic in file `%s', decompressing using libzstd.\n", filename.c_str());
+					delete ff;
+					f = new decompress_istream(new zstd_istreambuf(filename));
+	#else
+					log_cmd_error("File `%s' is a zstd file, but Yosys is compiled without libzstd.\n", filename.c_str());
 	#endif
 				} else {
 					ff->clear();
@@ -568,6 +1210,84 @@ void Frontend::extra_args(std::istream *&f, std::string &filename, std::vector<s
 	// cmd_log_args(args);
 }
 
+#ifdef YOSYS_ENABLE_THREADS
+struct PrefetchedInputFile
+{
+	bool ok = false;
+	std::string data;
+	int64_t size = 0;
+	time_t mtime = 0;
+};
+
+static std::map<std::string, std::future<PrefetchedInputFile>> prefetched_input_files;
+
+static bool stat_input_file(const std::string &filename, int64_t &size, time_t &mtime)
+{
+	struct stat st;
+	if (stat(filename.c_str(), &st) != 0)
+		return false;
+	size = st.st_size;
+	mtime = st.st_mtime;
+	return true;
+}
+
+std::istream *Frontend::use_prefetched_input_file(const std::string &filename)
+{
+	auto it = prefetched_input_files.find(filename);
+	if (it == prefetched_input_files.end())
+		return nullptr;
+
+	PrefetchedInputFile file = it->second.get();
+	prefetched_input_files.erase(it);
+
+	// compressed files and files that changed since they were read take the normal path
+	int64_t size;
+	time_t mtime;
+	if (!file.ok || !stat_input_file(filename, size, mtime) || size != file.size || mtime != file.mtime)
+		return nullptr;
+	if (GetSize(file.data) >= 2 && (unsigned char)file.data[0] == 0x1f && (unsigned char)file.data[1] == 0x8b)
+		return nullptr;
+	if (GetSize(file.data) >= 4 && file.data.compare(0, 4, "\x28\xb5\x2f\xfd") == 0)
+		return nullptr;
+
+	return new std::istringstream(std::move(file.data));
+}
+#endif
+
+void Frontend::prefetch_input_files(const std::vector<std::string> &filenames, int num_files)
+{
+#ifdef YOSYS_ENABLE_THREADS
+	for (auto filename : filenames)
+	{
+		if (num_files-- <= 0)
+			break;
+		if (filename.compare(0, 2, "<<") == 0 || filename.compare(0, 1, "-") == 0)
+			continue;
+
+		rewrite_filename(filename);
+		if (filename.find_first_of("*?[") != std::string::npos || prefetched_input_files.count(filename))
+			continue;
+
+		prefetched_input_files[filename] = std::async(std::launch::async, [filename]() {
+			PrefetchedInputFile file;
+			if (!stat_input_file(filename, file.size, file.mtime))
+				return file;
+			std::ifstream f(filename.c_str(), std::ifstream::binary);
+			if (f.fail())
+				return file;
+			std::stringstream buffer;
+			buffer << f.rdbuf();
+			file.data = buffer.str();
+			file.ok = !f.bad() && GetSize(file.data) == file.size;
+			return file;
+		});
+	}
+#else
+	(void)filenames;
+	(void)num_files;
+#endif
+}
+
 void Frontend::frontend_call(RTLIL::Design *design, std::istream *f, std::string filename, std::string command)
 {
 	std::vector<std::string> args;
@@ -630,6 +1350,46 @@ void Backend::execute(std::vector<std::string> args, RTLIL::Design *design)
 		delete f;
 }
 
+std::ostream *open_output_file(const std::string &filename, bool bin_output)
+{
+	if (filename.size() > 3 && filename.compare(filename.size()-3, std::string::npos, ".gz") == 0) {
+#ifdef YOSYS_ENABLE_ZLIB
+		gzip_ostream *gf = new gzip_ostream;
+		if (!gf->open(filename)) {
+			delete gf;
+			log_cmd_error("Can't open output file `%s' for writing: %s\n", filename.c_str(), strerror(errno));
+		}
+		yosys_output_files.insert(filename);
+		return gf;
+#else
+		log_cmd_error("Yosys is compiled without zlib support, unable to write gzip output.\n");
+#endif
+	}
+
+	if (filename.size() > 4 && filename.compare(filename.size()-4, std::string::npos, ".zst") == 0) {
+#ifdef YOSYS_ENABLE_ZSTD
+		zstd_ostream *zf = new zstd_ostream;
+		if (!zf->open(filename)) {
+			delete zf;
+			log_cmd_error("Can't open output file `%s' for writing: %s\n", filename.c_str(), strerror(errno));
+		}
+		yosys_output_files.insert(filename);
+		return zf;
+#else
+		log_cmd_error("Yosys is compiled without libzstd support, unable to write zstd output.\n");
+#endif
+	}
+
+	std::ofstream *ff = new std::ofstream;
+	ff->open(filename.c_str(), bin_output ? (std::ofstream::trunc | std::ofstream::binary) : std::ofstream::trunc);
+	yosys_output_files.insert(filename);
+	if (ff->fail()) {
+		delete ff;
+		log_cmd_error("Can't open output file `%s' for writing: %s\n", filename.c_str(), strerror(errno));
+	}
+	return ff;
+}
+
 void Backend::extra_args(std::ostream *&f, std::string &filename, std::vector<std::string> args, size_t argidx, bool bin_output)
 {
 	bool called_with_fp = f != NULL;
@@ -651,28 +1411,7 @@ void Backend::extra_args(std::ostream *&f, std::string &filename, std::vector<st
 
 		filename = arg;
 		rewrite_filename(filename);
-		if (filename.size() > 3 && filename.compare(filename.size()-3, std::string::npos, ".gz") == 0) {
-#ifdef YOSYS_ENABLE_ZLIB
-			gzip_ostream *gf = new gzip_ostream;
-			if (!gf->open(filename)) {
-				delete gf;
-				log_cmd_error("Can't open output file `%s' for writing: %s\n", filename.c_str(), strerror(errno));
-			}
-			yosys_output_files.insert(filename);
-			f = gf;
-#else
-			log_cmd_error("Yosys is compiled without zlib support, unable to write gzip output.\n");
-#endif
-		} else {
-			std::ofstream *ff = new std::ofstream;
-			ff->open(filename.c_str(), bin_output ? (std::ofstream::trunc | std::ofstream::binary) : std::ofstream::trunc);
-			yosys_output_files.insert(filename);
-			if (ff->fail()) {
-				delete ff;
-				log_cmd_error("Can't open output file `%s' for writing: %s\n", filename.c_str(), strerror(errno));
-			}
-			f = ff;
-		}
+		f = open_output_file(filename, bin_output);
 	}
 
 	if (called_with_fp)
@@ -943,6 +1682,38 @@ struct EchoPass : public Pass {
 SatSolver *yosys_satsolver_list;
 SatSolver *yosys_satsolver;
 
+static ezSAT::SolverStats sat_stats;
+#ifdef YOSYS_ENABLE_THREADS
+static std::mutex sat_stats_lock;
+#endif
+
+void add_sat_stats(const ezSAT::SolverStats &stats)
+{
+#ifdef YOSYS_ENABLE_THREADS
+	std::lock_guard<std::mutex> lock(sat_stats_lock);
+#endif
+	sat_stats += stats;
+}
+
+ezSAT::SolverStats get_sat_stats()
+{
+#ifdef YOSYS_ENABLE_THREADS
+	std::lock_guard<std::mutex> lock(sat_stats_lock);
+#endif
+	return sat_stats;
+}
+
+void log_sat_stats(const ezSAT::SolverStats &stats)
+{
+	log("SAT solver statistics:\n");
+	log("  %12lld solver calls\n", stats.calls);
+	log("  %12lld conflicts\n", stats.conflicts);
+	log("  %12lld decisions\n", stats.decisions);
+	log("  %12lld propagations\n", stats.propagations);
+	log("  %12lld restarts\n", stats.restarts);
+	log("  %12lld variable eliminations (%lld eliminated variables)\n", stats.simplifications, stats.eliminatedVars);
+}
+
 struct MinisatSatSolver : public SatSolver {
 	MinisatSatSolver() : SatSolver("minisat") {
 		yosys_satsolver = this;
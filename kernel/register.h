@@ -42,9 +42,19 @@ struct Pass
 		experimental_flag = true;
 	}
 
+	// Set by passes that change modules only through the RTLIL API or call
+	// Module::touch() for other changes. After all other passes, Pass::call()
+	// marks every module of the design as changed (see Module::generation).
+	bool module_changes_tracked_flag = false;
+
+	void module_changes_tracked() {
+		module_changes_tracked_flag = true;
+	}
+
 	struct pre_post_exec_state_t {
 		Pass *parent_pass;
 		int64_t begin_ns;
+		int profile_event;
 	};
 
 	pre_post_exec_state_t pre_execute();
@@ -72,19 +82,47 @@ struct Pass
 	virtual void on_shutdown();
 };
 
+struct ModulePass : Pass
+{
+	ModulePass(std::string name, std::string short_help = "** document me **") : Pass(name, short_help) { }
+
+	// Called by execute_modules() for each module. When yosys_threads > 1 this
+	// is called concurrently for different modules: it may only modify the given
+	// module, and any other state it touches must be safe for concurrent access.
+	// The modules are tasks of one TaskGroup (see kernel/threadpool.h), log
+	// output is captured per module and printed in module order. NEW_ID gives
+	// provisional names (see NewIdScope), which are replaced by the final names
+	// in module order when all modules are done. Code that keeps the names of
+	// new objects must therefore keep pointers to the objects instead, and the
+	// log output shows the provisional names.
+	virtual void execute_module(RTLIL::Module *module) = 0;
+
+	void execute_modules(RTLIL::Design *design);
+	void execute_modules(const std::vector<RTLIL::Module*> &modules);
+};
+
 struct ScriptPass : Pass
 {
 	bool block_active, help_mode;
 	RTLIL::Design *active_design;
 	std::string active_run_from, active_run_to;
 
-	ScriptPass(std::string name, std::string short_help = "** document me **") : Pass(name, short_help) { }
+	// checkpoints of the design at the script labels, see run_script()
+	enum { CHECKPOINT_OFF, CHECKPOINT_SCAN, CHECKPOINT_SKIP, CHECKPOINT_ON } checkpoint_mode;
+	std::string checkpoint_dir, checkpoint_input_key, checkpoint_key, checkpoint_resume_file;
+
+	ScriptPass(std::string name, std::string short_help = "** document me **") : Pass(name, short_help), checkpoint_mode(CHECKPOINT_OFF) { }
 
 	virtual void script() = 0;
 
 	bool check_label(std::string label, std::string info = std::string());
 	void run(std::string command, std::string info = std::string());
 	void run_script(RTLIL::Design *design, std::string run_from = std::string(), std::string run_to = std::string());
+	void checkpoint(std::string label);
+
+	// false in the dry runs of the script used for checkpoints, in which run()
+	// does not execute the commands
+	bool commands_active() const { return checkpoint_mode == CHECKPOINT_OFF || checkpoint_mode == CHECKPOINT_ON; }
 	void help_script();
 };
 
@@ -104,6 +142,13 @@ struct Frontend : Pass
 	static std::vector<std::string> next_args;
 	void extra_args(std::istream *&f, std::string &filename, std::vector<std::string> args, size_t argidx, bool bin_input = false);
 
+	// read the given input files into memory on worker threads, so that a
+	// later extra_args() call for one of them does not wait for the disk
+	static void prefetch_input_files(const std::vector<std::string> &filenames, int num_files);
+#ifdef YOSYS_ENABLE_THREADS
+	static std::istream *use_prefetched_input_file(const std::string &filename);
+#endif
+
 	static void frontend_call(RTLIL::Design *design, std::istream *f, std::string filename, std::string command);
 	static void frontend_call(RTLIL::Design *design, std::istream *f, std::string filename, std::vector<std::string> args);
 };
@@ -123,6 +168,29 @@ struct Backend : Pass
 	static void backend_call(RTLIL::Design *design, std::ostream *f, std::string filename, std::vector<std::string> args);
 };
 
+// Profile of all pass calls, recorded when pass_profile_on() was called (see
+// "yosys -B"). Nested calls via Pass::call() are recorded as nested events.
+struct PassProfileEvent
+{
+	std::string name, command;
+	int depth;
+	int64_t begin_ns, end_ns;
+	int64_t begin_allocs, end_allocs;
+	int64_t begin_maxrss_kb, end_maxrss_kb;
+	int begin_cells, end_cells;
+	int begin_wires, end_wires;
+};
+
+void pass_profile_on();
+bool pass_profile_active();
+
+// writes the profile in the Chrome trace event format, with a summary per pass
+void pass_profile_write(std::ostream &f);
+
+// opens a file for writing, gzip-compressed if the name ends in ".gz" (on
+// multiple threads) and zstd-compressed if it ends in ".zst"
+extern std::ostream *open_output_file(const std::string &filename, bool bin_output = false);
+
 // implemented in passes/cmds/select.cc
 extern void handle_extra_select_args(Pass *pass, std::vector<std::string> args, size_t argidx, size_t args_size, RTLIL::Design *design);
 extern RTLIL::Selection eval_select_args(const vector<string> &args, RTLIL::Design *design);
@@ -20,6 +20,7 @@
 #include "kernel/yosys.h"
 #include "kernel/macc.h"
 #include "kernel/celltypes.h"
+#include "kernel/sigtools.h"
 #include "frontends/verilog/verilog_frontend.h"
 #include "backends/ilang/ilang_backend.h"
 
@@ -29,16 +30,25 @@
 YOSYS_NAMESPACE_BEGIN
 
 RTLIL::IdString::destruct_guard_t RTLIL::IdString::destruct_guard;
-std::vector<char*> RTLIL::IdString::global_id_storage_;
-dict<char*, int, hash_cstr_ops> RTLIL::IdString::global_id_index_;
+RTLIL::IdStorage<char*> RTLIL::IdString::global_id_storage_;
+dict<char*, int, hash_cstr_ops> RTLIL::IdString::global_id_index_[RTLIL::IdString::global_id_shards_];
 #ifndef YOSYS_NO_IDS_REFCNT
-std::vector<int> RTLIL::IdString::global_refcount_storage_;
+RTLIL::IdStorage<std::atomic<int>> RTLIL::IdString::global_refcount_storage_;
 std::vector<int> RTLIL::IdString::global_free_idx_list_;
+int RTLIL::IdString::global_compacted_free_count_;
+#endif
+bool RTLIL::IdString::global_concurrent_mode_;
+#ifdef YOSYS_ENABLE_THREADS
+std::mutex RTLIL::IdString::global_id_shard_lock_[RTLIL::IdString::global_id_shards_];
+std::mutex RTLIL::IdString::global_id_alloc_lock_;
 #endif
 #ifdef YOSYS_USE_STICKY_IDS
 int RTLIL::IdString::last_created_idx_[8];
 int RTLIL::IdString::last_created_idx_ptr_;
 #endif
+dict<int, RTLIL::IdString::lazy_name_t> RTLIL::IdString::global_lazy_names_;
+dict<int, int> RTLIL::IdString::global_lazy_autoidx_;
+int RTLIL::IdString::global_auto_max_;
 
 IdString RTLIL::ID::A;
 IdString RTLIL::ID::B;
@@ -48,28 +58,368 @@ IdString RTLIL::ID::whitebox;
 IdString RTLIL::ID::blackbox;
 dict<std::string, std::string> RTLIL::constpad;
 
+// The id strings are allocated from blocks of 64KB that are never returned
+// to the system, in slots of a multiple of 16 bytes. Freed slots are kept on
+// a free list per slot size and reused. Strings of more than 256 bytes are
+// allocated with malloc(). Strings are only allocated and freed under the
+// id allocation lock or while no other threads create ids.
+struct IdStringArena
+{
+	static const int granule = 16;
+	static const int max_len = 256;
+	static const int block_size = 65536;
+
+	void *free_lists[max_len / granule + 1] = {};
+	char *block = nullptr;
+	int block_used = block_size;
+
+	static IdStringArena &get()
+	{
+		static IdStringArena *arena = new IdStringArena;
+		return *arena;
+	}
+
+	char *alloc(const char *str)
+	{
+		int len = strlen(str) + 1;
+		if (len > max_len)
+			return strdup(str);
+
+		int slots = (len + granule - 1) / granule;
+		char *p = (char*)free_lists[slots];
+		if (p != nullptr) {
+			free_lists[slots] = *(void**)p;
+		} else {
+			if (block_used + slots * granule > block_size) {
+				block = (char*)malloc(block_size);
+				if (block == nullptr)
+					throw std::bad_alloc();
+				block_used = 0;
+			}
+			p = block + block_used;
+			block_used += slots * granule;
+		}
+		memcpy(p, str, len);
+		return p;
+	}
+
+	void free(char *p)
+	{
+		int len = strlen(p) + 1;
+		if (len > max_len) {
+			::free(p);
+			return;
+		}
+		int slots = (len + granule - 1) / granule;
+		*(void**)p = free_lists[slots];
+		free_lists[slots] = p;
+	}
+};
+
+char *RTLIL::IdString::alloc_str(const char *p)
+{
+	return IdStringArena::get().alloc(p);
+}
+
+void RTLIL::IdString::free_str(char *p)
+{
+	IdStringArena::get().free(p);
+}
+
+#ifndef YOSYS_NO_IDS_REFCNT
+void RTLIL::IdString::compact()
+{
+	if (global_concurrent_mode_)
+		return;
+
+	// the free list is used from the back
+	std::sort(global_free_idx_list_.begin(), global_free_idx_list_.end());
+	while (!global_free_idx_list_.empty() && global_free_idx_list_.back() == global_id_storage_.size()-1) {
+		global_free_idx_list_.pop_back();
+		global_id_storage_.pop_back();
+		global_refcount_storage_.pop_back();
+	}
+	std::reverse(global_free_idx_list_.begin(), global_free_idx_list_.end());
+	global_free_idx_list_.shrink_to_fit();
+	global_compacted_free_count_ = GetSize(global_free_idx_list_);
+
+	// drop the entries of freed ids from the hash tables
+	for (auto &index : global_id_index_) {
+		dict<char*, int, hash_cstr_ops> compacted(index);
+		index.swap(compacted);
+	}
+}
+#endif
+
+void RTLIL::IdString::set_concurrent(bool enable)
+{
+	if (global_concurrent_mode_ == enable)
+		return;
+
+	// worker threads may ask for the names of any ids
+	if (enable)
+		materialize_all();
+
+	global_concurrent_mode_ = enable;
+
+#ifndef YOSYS_NO_IDS_REFCNT
+	// free the ids that have been released while in concurrent mode
+	if (!enable)
+		for (int idx = 1; idx < global_id_storage_.size(); idx++)
+			if (global_id_storage_[idx] != nullptr && global_refcount_storage_[idx].load(std::memory_order_relaxed) == 0)
+				free_reference(idx);
+#endif
+}
+
+std::string RTLIL::IdString::lazy_name_t::str() const
+{
+#ifdef _WIN32
+	const char *file_sep = std::max(strrchr(file, '/'), strrchr(file, '\\'));
+#else
+	const char *file_sep = strrchr(file, '/');
+#endif
+	const char *func_sep = strrchr(func, ':');
+	return stringf("$auto$%s:%d:%s$%d", file_sep ? file_sep+1 : file, line, func_sep ? func_sep+1 : func, autoidx);
+}
+
+RTLIL::IdString RTLIL::IdString::new_lazy(const char *file, int line, const char *func, int autoidx)
+{
+	log_assert(destruct_guard.ok);
+	log_assert(!global_concurrent_mode_);
+
+	// the name may exist already (e.g. read from a file, or autoidx was set
+	// back), the id then is the one for that name, as for an eager NEW_ID
+	if (autoidx <= global_auto_max_)
+		return IdString(lazy_name_t{file, func, line, autoidx}.str());
+	global_auto_max_ = autoidx;
+
+	if (global_id_storage_.empty()) {
+	#ifndef YOSYS_NO_IDS_REFCNT
+		global_refcount_storage_.push_back(0);
+	#endif
+		global_id_storage_.push_back((char*)"");
+		global_id_index_[hash_cstr_ops::hash("") % global_id_shards_][global_id_storage_.back()] = 0;
+	}
+
+#ifndef YOSYS_NO_IDS_REFCNT
+	if (global_free_idx_list_.empty()) {
+		log_assert(global_id_storage_.size() < 0x40000000);
+		global_free_idx_list_.push_back(global_id_storage_.size());
+		global_id_storage_.push_back(nullptr);
+		global_refcount_storage_.push_back(0);
+	}
+
+	int idx = global_free_idx_list_.back();
+	global_free_idx_list_.pop_back();
+	refcount_inc(idx);
+#else
+	int idx = global_id_storage_.size();
+	global_id_storage_.push_back(nullptr);
+#endif
+
+	global_lazy_names_[idx] = {file, func, line, autoidx};
+	global_lazy_autoidx_[autoidx] = idx;
+
+	IdString id;
+	id.index_ = idx;
+	return id;
+}
+
+const char *RTLIL::IdString::materialize(int idx)
+{
+	log_assert(!global_concurrent_mode_);
+
+	auto it = global_lazy_names_.find(idx);
+	log_assert(it != global_lazy_names_.end());
+	std::string name = it->second.str();
+	global_lazy_autoidx_.erase(it->second.autoidx);
+	global_lazy_names_.erase(it);
+
+	// get_reference() gives this id for its name, and new_lazy() gives no
+	// lazy id a name that exists already
+	dict<char*, int, hash_cstr_ops> &index = global_id_index_[hash_cstr_ops::hash(name.c_str()) % global_id_shards_];
+	log_assert(index.count((char*)name.c_str()) == 0);
+
+	char *p = alloc_str(name.c_str());
+	global_id_storage_.at(idx) = p;
+	index[p] = idx;
+	return p;
+}
+
+void RTLIL::IdString::materialize_all()
+{
+	std::vector<int> lazy_ids;
+	for (auto &it : global_lazy_names_)
+		lazy_ids.push_back(it.first);
+	for (int idx : lazy_ids)
+		materialize(idx);
+}
+
+// called by get_reference() for a name that is not in the index: returns the
+// lazy id with this name, which gets its name now, or 0 after recording the
+// number of an "$auto$...$<n>" name for new_lazy()
+int RTLIL::IdString::find_lazy(const char *p)
+{
+	if (strncmp(p, "$auto$", 6) != 0)
+		return 0;
+
+	const char *q = strrchr(p, '$') + 1;
+	if (*q == 0 || strlen(q) > 9)
+		return 0;
+
+	int number = 0;
+	for (; *q; q++) {
+		if (*q < '0' || *q > '9')
+			return 0;
+		number = 10*number + (*q - '0');
+	}
+
+	auto it = global_lazy_autoidx_.find(number);
+	if (it != global_lazy_autoidx_.end() && global_lazy_names_.at(it->second).str() == p) {
+		int idx = it->second;
+		materialize(idx);
+		return idx;
+	}
+
+	global_auto_max_ = std::max(global_auto_max_, number);
+	return 0;
+}
+
+#define ONES_WORDS_8 ~uint64_t(0), ~uint64_t(0), ~uint64_t(0), ~uint64_t(0), ~uint64_t(0), ~uint64_t(0), ~uint64_t(0), ~uint64_t(0)
+uint64_t RTLIL::Const::packed_words_t::zero_page[RTLIL::Const::packed_words_t::page_words];
+uint64_t RTLIL::Const::packed_words_t::ones_page[RTLIL::Const::packed_words_t::page_words] = {
+	ONES_WORDS_8, ONES_WORDS_8, ONES_WORDS_8, ONES_WORDS_8, ONES_WORDS_8, ONES_WORDS_8, ONES_WORDS_8, ONES_WORDS_8
+};
+#undef ONES_WORDS_8
+
+uint64_t *RTLIL::Const::packed_words_t::copy_page(const uint64_t *page)
+{
+	uint64_t *copy = new uint64_t[page_words];
+	memcpy(copy, page, page_words * sizeof(uint64_t));
+	return copy;
+}
+
+void RTLIL::Const::packed_words_t::clear()
+{
+	if (block_ != nullptr && block_->refcount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		if (paged())
+			for (int i = 0; i < num_pages(); i++)
+				if (!shared_page(block_->pages[i]))
+					delete[] block_->pages[i];
+		block_->~block_t();
+		::operator delete(block_);
+	}
+	block_ = nullptr;
+}
+
+void RTLIL::Const::packed_words_t::assign(int n)
+{
+	clear();
+	if (n == 0)
+		return;
+	int entries = n > page_words ? (n + page_words - 1) >> page_bits : n;
+	void *mem = ::operator new(offsetof(block_t, data) + entries * sizeof(uint64_t));
+	block_ = new (mem) block_t;
+	block_->refcount.store(1, std::memory_order_relaxed);
+	block_->size = n;
+	if (paged())
+		for (int i = 0; i < entries; i++)
+			block_->pages[i] = zero_page;
+	else
+		memset(block_->data, 0, n * sizeof(uint64_t));
+}
+
+void RTLIL::Const::packed_words_t::resize(int n)
+{
+	packed_words_t old(std::move(*this));
+	assign(n);
+
+	int i = 0, len = std::min(n, old.size());
+	if (paged() && old.paged())
+		for (; i + page_words <= len; i += page_words) {
+			uint64_t *page = old.block_->pages[i >> page_bits];
+			block_->pages[i >> page_bits] = shared_page(page) ? page : copy_page(page);
+		}
+	for (; i < len; i++)
+		if (old[i] != 0)
+			word(i) = old[i];
+}
+
+void RTLIL::Const::packed_words_t::set_ones(int offset, int width)
+{
+	int i = offset, end = offset + (width >> 6);
+	for (; i < end; i++) {
+		if (paged() && (i & (page_words - 1)) == 0 && i + page_words <= end) {
+			uint64_t *&page = block_->pages[i >> page_bits];
+			if (!shared_page(page))
+				delete[] page;
+			page = ones_page;
+			i += page_words - 1;
+			continue;
+		}
+		word(i) = ~uint64_t(0);
+	}
+	if ((width & 63) != 0)
+		word(i) |= (uint64_t(1) << (width & 63)) - 1;
+}
+
+void RTLIL::Const::packed_words_t::compact()
+{
+	if (!paged())
+		return;
+	for (int i = 0; i < num_pages(); i++) {
+		uint64_t *&page = block_->pages[i];
+		if (shared_page(page))
+			continue;
+		for (auto shared : {zero_page, ones_page})
+			if (memcmp(page, shared, page_words * sizeof(uint64_t)) == 0) {
+				delete[] page;
+				page = shared;
+				break;
+			}
+	}
+}
+
+size_t RTLIL::Const::packed_words_t::memory_usage() const
+{
+	if (block_ == nullptr)
+		return 0;
+	size_t bytes = offsetof(block_t, data);
+	if (paged()) {
+		bytes += num_pages() * sizeof(uint64_t*);
+		for (int i = 0; i < num_pages(); i++)
+			if (!shared_page(block_->pages[i]))
+				bytes += page_words * sizeof(uint64_t);
+	} else
+		bytes += block_->size * sizeof(uint64_t);
+	return bytes / block_->refcount.load(std::memory_order_relaxed);
+}
+
 RTLIL::Const::Const()
 {
 	flags = RTLIL::CONST_FLAG_NONE;
+	packed_width_ = -1;
 }
 
 RTLIL::Const::Const(std::string str)
 {
 	flags = RTLIL::CONST_FLAG_STRING;
-	for (int i = str.size()-1; i >= 0; i--) {
-		unsigned char ch = str[i];
-		for (int j = 0; j < 8; j++) {
-			bits.push_back((ch & 1) != 0 ? State::S1 : State::S0);
-			ch = ch >> 1;
-		}
+	packed_width_ = 8 * GetSize(str);
+	packed_.assign(packed_words());
+	for (int i = 0; i < GetSize(str); i++) {
+		int offset = 8 * (GetSize(str) - 1 - i);
+		packed_.word(offset >> 6) |= uint64_t((unsigned char)str[i]) << (offset & 63);
 	}
 }
 
 RTLIL::Const::Const(int val, int width)
 {
 	flags = RTLIL::CONST_FLAG_NONE;
+	packed_width_ = width;
+	packed_.assign(packed_words());
 	for (int i = 0; i < width; i++) {
-		bits.push_back((val & 1) != 0 ? State::S1 : State::S0);
+		if ((val & 1) != 0)
+			packed_.word(i >> 6) |= uint64_t(1) << (i & 63);
 		val = val >> 1;
 	}
 }
@@ -77,48 +427,240 @@ RTLIL::Const::Const(int val, int width)
 RTLIL::Const::Const(RTLIL::State bit, int width)
 {
 	flags = RTLIL::CONST_FLAG_NONE;
-	for (int i = 0; i < width; i++)
-		bits.push_back(bit);
+	if (bit > RTLIL::State::Sz) {
+		packed_width_ = -1;
+		bits_.resize(width, bit);
+		return;
+	}
+	packed_width_ = width;
+	packed_.assign(bit == RTLIL::State::Sx || bit == RTLIL::State::Sz ? 2*packed_words() : packed_words());
+	if (bit == RTLIL::State::S1 || bit == RTLIL::State::Sz)
+		packed_.set_ones(0, width);
+	if (bit == RTLIL::State::Sx || bit == RTLIL::State::Sz)
+		packed_.set_ones(packed_words(), width);
+}
+
+RTLIL::Const::Const(const std::vector<RTLIL::State> &bits)
+{
+	flags = RTLIL::CONST_FLAG_NONE;
+	packed_width_ = -1;
+	pack_bits(bits);
 }
 
 RTLIL::Const::Const(const std::vector<bool> &bits)
 {
 	flags = RTLIL::CONST_FLAG_NONE;
-	for (auto b : bits)
-		this->bits.push_back(b ? State::S1 : State::S0);
+	packed_width_ = GetSize(bits);
+	packed_.assign(packed_words());
+	for (int i = 0; i < GetSize(bits); i++)
+		if (bits[i])
+			packed_.word(i >> 6) |= uint64_t(1) << (i & 63);
+}
+
+RTLIL::Const::Const(const RTLIL::Const &c) : flags(c.flags), packed_width_(c.packed_width_), packed_(c.packed_), bits_(c.bits_)
+{
+}
+
+RTLIL::Const::Const(RTLIL::Const &&c) : flags(c.flags), packed_width_(c.packed_width_), packed_(std::move(c.packed_)), bits_(std::move(c.bits_))
+{
+	c.packed_width_ = -1;
+	c.packed_.clear();
+	c.bits_.clear();
 }
 
-RTLIL::Const::Const(const RTLIL::Const &c)
+RTLIL::Const &RTLIL::Const::operator =(RTLIL::Const &&other)
 {
-	flags = c.flags;
-	for (auto b : c.bits)
-		this->bits.push_back(b);
+	if (this != &other) {
+		flags = other.flags;
+		packed_width_ = other.packed_width_;
+		packed_ = std::move(other.packed_);
+		bits_ = std::move(other.bits_);
+		other.packed_width_ = -1;
+		other.packed_.clear();
+		other.bits_.clear();
+	}
+	return *this;
+}
+
+void RTLIL::Const::pack_bits(const std::vector<RTLIL::State> &bits)
+{
+	bool has_undef = false;
+	for (auto bit : bits) {
+		if (bit > RTLIL::State::Sz) {
+			if (&bits != &bits_)
+				bits_ = bits;
+			packed_width_ = -1;
+			packed_.clear();
+			return;
+		}
+		if (bit == RTLIL::State::Sx || bit == RTLIL::State::Sz)
+			has_undef = true;
+	}
+
+	packed_width_ = GetSize(bits);
+	packed_.assign(has_undef ? 2*packed_words() : packed_words());
+	for (int i = 0; i < GetSize(bits); i++) {
+		if (bits[i] == RTLIL::State::S1 || bits[i] == RTLIL::State::Sz)
+			packed_.word(i >> 6) |= uint64_t(1) << (i & 63);
+		if (bits[i] == RTLIL::State::Sx || bits[i] == RTLIL::State::Sz)
+			packed_.word(packed_words() + (i >> 6)) |= uint64_t(1) << (i & 63);
+	}
+	packed_.compact();
+	std::vector<RTLIL::State>().swap(bits_);
+}
+
+void RTLIL::Const::unpack_bits()
+{
+	std::vector<RTLIL::State> bits;
+	bits.reserve(packed_width_);
+	for (int i = 0; i < packed_width_; i++)
+		bits.push_back(get_bit(i));
+	bits_.swap(bits);
+	packed_width_ = -1;
+	packed_.clear();
+}
+
+std::vector<RTLIL::State> RTLIL::Const::to_bits() const
+{
+	if (packed_width_ < 0)
+		return bits_;
+	std::vector<RTLIL::State> bits;
+	bits.reserve(packed_width_);
+	for (int i = 0; i < packed_width_; i++)
+		bits.push_back(get_bit(i));
+	return bits;
+}
+
+void RTLIL::Const::set(int index, RTLIL::State bit)
+{
+	log_assert(index >= 0 && index < size());
+
+	if (packed_width_ < 0 || bit > RTLIL::State::Sz) {
+		bits()[index] = bit;
+		return;
+	}
+
+	uint64_t mask = uint64_t(1) << (index & 63);
+	bool undef = bit == RTLIL::State::Sx || bit == RTLIL::State::Sz;
+	if (undef && GetSize(packed_) == packed_words())
+		packed_.resize(2*packed_words());
+	else
+		packed_.make_unique();
+
+	if (bit == RTLIL::State::S1 || bit == RTLIL::State::Sz)
+		packed_.word(index >> 6) |= mask;
+	else
+		packed_.word(index >> 6) &= ~mask;
+
+	if (GetSize(packed_) > packed_words()) {
+		if (undef)
+			packed_.word(packed_words() + (index >> 6)) |= mask;
+		else
+			packed_.word(packed_words() + (index >> 6)) &= ~mask;
+	}
+}
+
+void RTLIL::Const::pack()
+{
+	if (packed_width_ < 0) {
+		pack_bits(bits_);
+		return;
+	}
+
+	// drop the x/z words if set() has cleared all of them
+	for (int i = 0; i < packed_words(); i++)
+		if (packed_undef(i) != 0) {
+			if (!packed_.shared())
+				packed_.compact();
+			return;
+		}
+	packed_.resize(packed_words());
+}
+
+// Like the src attribute cache below: the interned constants are kept in a
+// pool, entries that are no longer shared with any other constant are dropped
+// whenever the pool doubles in size.
+static pool<RTLIL::Const> const_intern_cache;
+static int const_intern_cache_limit = 1024;
+#ifdef YOSYS_ENABLE_THREADS
+static std::mutex const_intern_cache_lock;
+#endif
+
+void RTLIL::Const::intern()
+{
+	pack();
+	if (packed_width_ <= 0 || packed_width_ > 4096)
+		return;
+
+#ifdef YOSYS_ENABLE_THREADS
+	std::lock_guard<std::mutex> lock(const_intern_cache_lock);
+#endif
+	auto it = const_intern_cache.find(*this);
+	if (it != const_intern_cache.end()) {
+		packed_ = it->packed_;
+		return;
+	}
+
+	if (GetSize(const_intern_cache) >= const_intern_cache_limit) {
+		pool<RTLIL::Const> used;
+		for (auto &it : const_intern_cache)
+			if (it.is_shared())
+				used.insert(it);
+		const_intern_cache.swap(used);
+		const_intern_cache_limit = std::max(1024, 2*GetSize(const_intern_cache));
+	}
+
+	const_intern_cache.insert(*this);
 }
 
 bool RTLIL::Const::operator <(const RTLIL::Const &other) const
 {
-	if (bits.size() != other.bits.size())
-		return bits.size() < other.bits.size();
-	for (size_t i = 0; i < bits.size(); i++)
-		if (bits[i] != other.bits[i])
-			return bits[i] < other.bits[i];
+	if (size() != other.size())
+		return size() < other.size();
+	for (int i = 0; i < size(); i++) {
+		RTLIL::State a = get_bit(i), b = other.get_bit(i);
+		if (a != b)
+			return a < b;
+	}
 	return false;
 }
 
 bool RTLIL::Const::operator ==(const RTLIL::Const &other) const
 {
-	return bits == other.bits;
+	if (size() != other.size())
+		return false;
+	if (packed_width_ >= 0 && packed_.shared_with(other.packed_))
+		return true;
+	if (packed_width_ >= 0 && other.packed_width_ >= 0) {
+		for (int i = 0; i < packed_words(); i++)
+			if (packed_[i] != other.packed_[i] || packed_undef(i) != other.packed_undef(i))
+				return false;
+		return true;
+	}
+	if (packed_width_ < 0 && other.packed_width_ < 0)
+		return bits_ == other.bits_;
+	for (int i = 0; i < size(); i++)
+		if (get_bit(i) != other.get_bit(i))
+			return false;
+	return true;
 }
 
 bool RTLIL::Const::operator !=(const RTLIL::Const &other) const
 {
-	return bits != other.bits;
+	return !(*this == other);
 }
 
 bool RTLIL::Const::as_bool() const
 {
-	for (size_t i = 0; i < bits.size(); i++)
-		if (bits[i] == State::S1)
+	if (packed_width_ >= 0) {
+		for (int i = 0; i < packed_words(); i++)
+			if ((packed_[i] & ~packed_undef(i)) != 0)
+				return true;
+		return false;
+	}
+
+	for (size_t i = 0; i < bits_.size(); i++)
+		if (bits_[i] == State::S1)
 			return true;
 	return false;
 }
@@ -126,11 +668,16 @@ bool RTLIL::Const::as_bool() const
 int RTLIL::Const::as_int(bool is_signed) const
 {
 	int32_t ret = 0;
-	for (size_t i = 0; i < bits.size() && i < 32; i++)
-		if (bits[i] == State::S1)
-			ret |= 1 << i;
-	if (is_signed && bits.back() == State::S1)
-		for (size_t i = bits.size(); i < 32; i++)
+	if (packed_width_ >= 0) {
+		if (packed_width_ > 0)
+			ret = uint32_t(packed_[0] & ~packed_undef(0));
+	} else {
+		for (size_t i = 0; i < bits_.size() && i < 32; i++)
+			if (bits_[i] == State::S1)
+				ret |= 1 << i;
+	}
+	if (is_signed && size() > 0 && get_bit(size()-1) == State::S1)
+		for (int i = size(); i < 32; i++)
 			ret |= 1 << i;
 	return ret;
 }
@@ -138,8 +685,9 @@ int RTLIL::Const::as_int(bool is_signed) const
 std::string RTLIL::Const::as_string() const
 {
 	std::string ret;
-	for (size_t i = bits.size(); i > 0; i--)
-		switch (bits[i-1]) {
+	ret.reserve(size());
+	for (int i = size(); i > 0; i--)
+		switch (get_bit(i-1)) {
 			case S0: ret += "0"; break;
 			case S1: ret += "1"; break;
 			case Sx: ret += "x"; break;
@@ -152,27 +700,28 @@ std::string RTLIL::Const::as_string() const
 
 RTLIL::Const RTLIL::Const::from_string(std::string str)
 {
-	Const c;
+	std::vector<RTLIL::State> bits;
+	bits.reserve(str.size());
 	for (auto it = str.rbegin(); it != str.rend(); it++)
 		switch (*it) {
-			case '0': c.bits.push_back(State::S0); break;
-			case '1': c.bits.push_back(State::S1); break;
-			case 'x': c.bits.push_back(State::Sx); break;
-			case 'z': c.bits.push_back(State::Sz); break;
-			case 'm': c.bits.push_back(State::Sm); break;
-			default: c.bits.push_back(State::Sa);
+			case '0': bits.push_back(State::S0); break;
+			case '1': bits.push_back(State::S1); break;
+			case 'x': bits.push_back(State::Sx); break;
+			case 'z': bits.push_back(State::Sz); break;
+			case 'm': bits.push_back(State::Sm); break;
+			default: bits.push_back(State::Sa);
 		}
-	return c;
+	return bits;
 }
 
 std::string RTLIL::Const::decode_string() const
 {
 	std::string string;
 	std::vector<char> string_chars;
-	for (int i = 0; i < int (bits.size()); i += 8) {
+	for (int i = 0; i < size(); i += 8) {
 		char ch = 0;
-		for (int j = 0; j < 8 && i + j < int (bits.size()); j++)
-			if (bits[i + j] == RTLIL::State::S1)
+		for (int j = 0; j < 8 && i + j < size(); j++)
+			if (get_bit(i + j) == RTLIL::State::S1)
 				ch |= 1 << j;
 		if (ch != 0)
 			string_chars.push_back(ch);
@@ -186,7 +735,14 @@ bool RTLIL::Const::is_fully_zero() const
 {
 	cover("kernel.rtlil.const.is_fully_zero");
 
-	for (auto bit : bits)
+	if (packed_width_ >= 0) {
+		for (int i = 0; i < packed_words(); i++)
+			if (packed_[i] != 0 || packed_undef(i) != 0)
+				return false;
+		return true;
+	}
+
+	for (auto bit : bits_)
 		if (bit != RTLIL::State::S0)
 			return false;
 
@@ -197,7 +753,16 @@ bool RTLIL::Const::is_fully_ones() const
 {
 	cover("kernel.rtlil.const.is_fully_ones");
 
-	for (auto bit : bits)
+	if (packed_width_ >= 0) {
+		for (int i = 0; i < packed_width_; i += 64) {
+			uint64_t mask = packed_width_ - i >= 64 ? ~uint64_t(0) : (uint64_t(1) << (packed_width_ - i)) - 1;
+			if (packed_[i >> 6] != mask || packed_undef(i >> 6) != 0)
+				return false;
+		}
+		return true;
+	}
+
+	for (auto bit : bits_)
 		if (bit != RTLIL::State::S1)
 			return false;
 
@@ -208,7 +773,14 @@ bool RTLIL::Const::is_fully_def() const
 {
 	cover("kernel.rtlil.const.is_fully_def");
 
-	for (auto bit : bits)
+	if (packed_width_ >= 0) {
+		for (int i = 0; i < packed_words(); i++)
+			if (packed_undef(i) != 0)
+				return false;
+		return true;
+	}
+
+	for (auto bit : bits_)
 		if (bit != RTLIL::State::S0 && bit != RTLIL::State::S1)
 			return false;
 
@@ -219,7 +791,16 @@ bool RTLIL::Const::is_fully_undef() const
 {
 	cover("kernel.rtlil.const.is_fully_undef");
 
-	for (auto bit : bits)
+	if (packed_width_ >= 0) {
+		for (int i = 0; i < packed_width_; i += 64) {
+			uint64_t mask = packed_width_ - i >= 64 ? ~uint64_t(0) : (uint64_t(1) << (packed_width_ - i)) - 1;
+			if (packed_undef(i >> 6) != mask)
+				return false;
+		}
+		return true;
+	}
+
+	for (auto bit : bits_)
 		if (bit != RTLIL::State::Sx && bit != RTLIL::State::Sz)
 			return false;
 
@@ -253,7 +834,10 @@ void RTLIL::AttrObject::set_strpool_attribute(RTLIL::IdString id, const pool<str
 			attrval += "|";
 		attrval += s;
 	}
-	attributes[id] = RTLIL::Const(attrval);
+	if (id == ID(src))
+		set_src_attribute(attrval);
+	else
+		attributes[id] = RTLIL::Const(attrval);
 }
 
 void RTLIL::AttrObject::add_strpool_attribute(RTLIL::IdString id, const pool<string> &data)
@@ -273,12 +857,42 @@ pool<string> RTLIL::AttrObject::get_strpool_attribute(RTLIL::IdString id) const
 	return data;
 }
 
+// The values of src attributes are interned, so that all objects with the same
+// source location share the storage of the attribute value. Entries that are
+// no longer used by any object are dropped whenever the cache doubles in size.
+static dict<std::string, RTLIL::Const> src_attribute_cache;
+static int src_attribute_cache_limit = 1024;
+#ifdef YOSYS_ENABLE_THREADS
+static std::mutex src_attribute_cache_lock;
+#endif
+
+static RTLIL::Const intern_src_attribute(const std::string &src)
+{
+#ifdef YOSYS_ENABLE_THREADS
+	std::lock_guard<std::mutex> lock(src_attribute_cache_lock);
+#endif
+	auto it = src_attribute_cache.find(src);
+	if (it != src_attribute_cache.end())
+		return it->second;
+
+	if (GetSize(src_attribute_cache) >= src_attribute_cache_limit) {
+		dict<std::string, RTLIL::Const> used;
+		for (auto &it : src_attribute_cache)
+			if (it.second.is_shared())
+				used.insert(std::move(it));
+		src_attribute_cache.swap(used);
+		src_attribute_cache_limit = std::max(1024, 2*GetSize(src_attribute_cache));
+	}
+
+	return src_attribute_cache[src] = RTLIL::Const(src);
+}
+
 void RTLIL::AttrObject::set_src_attribute(const std::string &src)
 {
 	if (src.empty())
 		attributes.erase(ID(src));
 	else
-		attributes[ID(src)] = src;
+		attributes[ID(src)] = intern_src_attribute(src);
 }
 
 std::string RTLIL::AttrObject::get_src_attribute() const
@@ -380,11 +994,11 @@ void RTLIL::Selection::optimize(RTLIL::Design *design)
 
 RTLIL::Design::Design()
 {
-	static unsigned int hashidx_count = 123456789;
-	hashidx_count = mkhash_xorshift(hashidx_count);
-	hashidx_ = hashidx_count;
+	static std::atomic<unsigned int> hashidx_count(123456789);
+	hashidx_ = mkhash_xorshift_next(hashidx_count);
 
 	refcount_modules_ = 0;
+	generation = 0;
 	selection_stack.push_back(RTLIL::Selection());
 
 #ifdef WITH_PYTHON
@@ -444,6 +1058,7 @@ void RTLIL::Design::add(RTLIL::Module *module)
 	log_assert(refcount_modules_ == 0);
 	modules_[module->name] = module;
 	module->design = this;
+	generation++;
 
 	for (auto mon : monitors)
 		mon->notify_module_add(module);
@@ -548,9 +1163,17 @@ void RTLIL::Design::remove(RTLIL::Module *module)
 
 	log_assert(modules_.at(module->name) == module);
 	modules_.erase(module->name);
+	generation++;
 	delete module;
 }
 
+void RTLIL::Design::touch()
+{
+	generation++;
+	for (auto &it : modules_)
+		it.second->touch();
+}
+
 void RTLIL::Design::rename(RTLIL::Module *module, RTLIL::IdString new_name)
 {
 	modules_.erase(module->name);
@@ -661,13 +1284,19 @@ std::vector<RTLIL::Module*> RTLIL::Design::selected_whole_modules_warn() const
 
 RTLIL::Module::Module()
 {
-	static unsigned int hashidx_count = 123456789;
-	hashidx_count = mkhash_xorshift(hashidx_count);
-	hashidx_ = hashidx_count;
+	static std::atomic<unsigned int> hashidx_count(123456789);
+	hashidx_ = mkhash_xorshift_next(hashidx_count);
 
 	design = nullptr;
 	refcount_wires_ = 0;
 	refcount_cells_ = 0;
+	generation = 0;
+	sigmap_ = nullptr;
+	content_hash_generation_[0] = 0;
+	content_hash_generation_[1] = 0;
+	batch_depth_ = 0;
+	batch_fixup_ports_ = false;
+	batch_notify_ = false;
 
 #ifdef WITH_PYTHON
 	RTLIL::Module::get_all_modules()->insert(std::pair<unsigned int, RTLIL::Module*>(hashidx_, this));
@@ -684,6 +1313,7 @@ RTLIL::Module::~Module()
 		delete it->second;
 	for (auto it = processes.begin(); it != processes.end(); ++it)
 		delete it->second;
+	delete sigmap_;
 #ifdef WITH_PYTHON
 	RTLIL::Module::get_all_modules()->erase(hashidx_);
 #endif
@@ -777,7 +1407,7 @@ namespace {
 		int param_bool(RTLIL::IdString name)
 		{
 			int v = param(name);
-			if (cell->parameters.at(name).bits.size() > 32)
+			if (cell->parameters.at(name).size() > 32)
 				error(__LINE__);
 			if (v != 0 && v != 1)
 				error(__LINE__);
@@ -795,7 +1425,7 @@ namespace {
 		void param_bits(RTLIL::IdString name, int width)
 		{
 			param(name);
-			if (int(cell->parameters.at(name).bits.size()) != width)
+			if (cell->parameters.at(name).size() != width)
 				error(__LINE__);
 		}
 
@@ -1458,6 +2088,20 @@ void RTLIL::Module::optimize()
 {
 }
 
+void RTLIL::Module::touch()
+{
+	generation++;
+	if (sigmap_)
+		sigmap_->invalidate();
+}
+
+const SigMap &RTLIL::Module::sigmap()
+{
+	if (sigmap_ == nullptr)
+		sigmap_ = new ModuleSigMap(this);
+	return sigmap_->get();
+}
+
 void RTLIL::Module::cloneInto(RTLIL::Module *new_mod) const
 {
 	log_assert(new_mod->refcount_wires_ == 0);
@@ -1561,6 +2205,7 @@ void RTLIL::Module::add(RTLIL::Wire *wire)
 	log_assert(refcount_wires_ == 0);
 	wires_[wire->name] = wire;
 	wire->module = this;
+	generation++;
 }
 
 void RTLIL::Module::add(RTLIL::Cell *cell)
@@ -1570,10 +2215,17 @@ void RTLIL::Module::add(RTLIL::Cell *cell)
 	log_assert(refcount_cells_ == 0);
 	cells_[cell->name] = cell;
 	cell->module = this;
+	generation++;
 }
 
 void RTLIL::Module::remove(const pool<RTLIL::Wire*> &wires)
 {
+	if (batch_depth_ > 0) {
+		for (auto wire : wires)
+			batch_removed_wires_.insert(wire);
+		return;
+	}
+
 	log_assert(refcount_wires_ == 0);
 
 	struct DeleteWireWorker
@@ -1619,6 +2271,9 @@ void RTLIL::Module::remove(const pool<RTLIL::Wire*> &wires)
 		wires_.erase(it->name);
 		delete it;
 	}
+
+	// the connections have been rewritten in place
+	touch();
 }
 
 void RTLIL::Module::remove(RTLIL::Cell *cell)
@@ -1629,9 +2284,56 @@ void RTLIL::Module::remove(RTLIL::Cell *cell)
 	log_assert(cells_.count(cell->name) != 0);
 	log_assert(refcount_cells_ == 0);
 	cells_.erase(cell->name);
+	generation++;
 	delete cell;
 }
 
+void RTLIL::Module::move_cells(RTLIL::Module *dest, const std::vector<RTLIL::Cell*> &cells, const dict<RTLIL::Wire*, RTLIL::Wire*> &wire_map)
+{
+	log_assert(refcount_cells_ == 0);
+	log_assert(dest->refcount_cells_ == 0);
+
+	for (auto cell : cells)
+	{
+		log_assert(cells_.count(cell->name) != 0);
+		log_assert(dest->count_id(cell->name) == 0);
+
+		// monitors see the ports disconnected here and connected in dest
+		RTLIL::SigSpec empty_sig;
+		if (!batch_defer_notify())
+			for (auto &conn : cell->connections_) {
+				for (auto mon : monitors)
+					mon->notify_connect(cell, conn.first, conn.second, empty_sig);
+				if (design)
+					for (auto mon : design->monitors)
+						mon->notify_connect(cell, conn.first, conn.second, empty_sig);
+			}
+
+		cells_.erase(cell->name);
+		dest->cells_[cell->name] = cell;
+		cell->module = dest;
+
+		for (auto &conn : cell->connections_) {
+			std::vector<RTLIL::SigChunk> chunks = conn.second.chunks();
+			for (auto &c : chunks)
+				if (c.wire != nullptr)
+					c.wire = wire_map.at(c.wire);
+			RTLIL::SigSpec new_sig = chunks;
+			if (!dest->batch_defer_notify()) {
+				for (auto mon : dest->monitors)
+					mon->notify_connect(cell, conn.first, empty_sig, new_sig);
+				if (dest->design)
+					for (auto mon : dest->design->monitors)
+						mon->notify_connect(cell, conn.first, empty_sig, new_sig);
+			}
+			conn.second = new_sig;
+		}
+	}
+
+	generation++;
+	dest->generation++;
+}
+
 void RTLIL::Module::rename(RTLIL::Wire *wire, RTLIL::IdString new_name)
 {
 	log_assert(wires_[wire->name] == wire);
@@ -1674,6 +2376,7 @@ void RTLIL::Module::swap_names(RTLIL::Wire *w1, RTLIL::Wire *w2)
 
 	wires_[w1->name] = w1;
 	wires_[w2->name] = w2;
+	generation++;
 }
 
 void RTLIL::Module::swap_names(RTLIL::Cell *c1, RTLIL::Cell *c2)
@@ -1689,6 +2392,7 @@ void RTLIL::Module::swap_names(RTLIL::Cell *c1, RTLIL::Cell *c2)
 
 	cells_[c1->name] = c1;
 	cells_[c2->name] = c2;
+	generation++;
 }
 
 RTLIL::IdString RTLIL::Module::uniquify(RTLIL::IdString name)
@@ -1727,13 +2431,15 @@ static bool fixup_ports_compare(const RTLIL::Wire *a, const RTLIL::Wire *b)
 
 void RTLIL::Module::connect(const RTLIL::SigSig &conn)
 {
-	for (auto mon : monitors)
-		mon->notify_connect(this, conn);
-
-	if (design)
-		for (auto mon : design->monitors)
+	if (!batch_defer_notify()) {
+		for (auto mon : monitors)
 			mon->notify_connect(this, conn);
 
+		if (design)
+			for (auto mon : design->monitors)
+				mon->notify_connect(this, conn);
+	}
+
 	// ignore all attempts to assign constants to other constants
 	if (conn.first.has_const()) {
 		RTLIL::SigSig new_conn;
@@ -1754,6 +2460,7 @@ void RTLIL::Module::connect(const RTLIL::SigSig &conn)
 
 	log_assert(GetSize(conn.first) == GetSize(conn.second));
 	connections_.push_back(conn);
+	generation++;
 }
 
 void RTLIL::Module::connect(const RTLIL::SigSpec &lhs, const RTLIL::SigSpec &rhs)
@@ -1763,13 +2470,15 @@ void RTLIL::Module::connect(const RTLIL::SigSpec &lhs, const RTLIL::SigSpec &rhs
 
 void RTLIL::Module::new_connections(const std::vector<RTLIL::SigSig> &new_conn)
 {
-	for (auto mon : monitors)
-		mon->notify_connect(this, new_conn);
-
-	if (design)
-		for (auto mon : design->monitors)
+	if (!batch_defer_notify()) {
+		for (auto mon : monitors)
 			mon->notify_connect(this, new_conn);
 
+		if (design)
+			for (auto mon : design->monitors)
+				mon->notify_connect(this, new_conn);
+	}
+
 	if (yosys_xtrace) {
 		log("#X# New connections vector in %s:\n", log_id(this));
 		for (auto &conn: new_conn)
@@ -1778,6 +2487,7 @@ void RTLIL::Module::new_connections(const std::vector<RTLIL::SigSig> &new_conn)
 	}
 
 	connections_ = new_conn;
+	generation++;
 }
 
 const std::vector<RTLIL::SigSig> &RTLIL::Module::connections() const
@@ -1787,6 +2497,11 @@ const std::vector<RTLIL::SigSig> &RTLIL::Module::connections() const
 
 void RTLIL::Module::fixup_ports()
 {
+	if (batch_depth_ > 0) {
+		batch_fixup_ports_ = true;
+		return;
+	}
+
 	std::vector<RTLIL::Wire*> all_ports;
 
 	for (auto &w : wires_)
@@ -1804,6 +2519,38 @@ void RTLIL::Module::fixup_ports()
 	}
 }
 
+void RTLIL::Module::begin_batch()
+{
+	batch_depth_++;
+}
+
+void RTLIL::Module::end_batch()
+{
+	log_assert(batch_depth_ > 0);
+	if (--batch_depth_ > 0)
+		return;
+
+	if (!batch_removed_wires_.empty()) {
+		pool<RTLIL::Wire*> wires;
+		wires.swap(batch_removed_wires_);
+		remove(wires);
+	}
+
+	if (batch_fixup_ports_) {
+		batch_fixup_ports_ = false;
+		fixup_ports();
+	}
+
+	if (batch_notify_) {
+		batch_notify_ = false;
+		for (auto mon : monitors)
+			mon->notify_blackout(this);
+		if (design)
+			for (auto mon : design->monitors)
+				mon->notify_blackout(this);
+	}
+}
+
 RTLIL::Wire *RTLIL::Module::addWire(RTLIL::IdString name, int width)
 {
 	RTLIL::Wire *wire = new RTLIL::Wire;
@@ -2392,11 +3139,148 @@ RTLIL::SigSpec RTLIL::Module::Initstate(RTLIL::IdString name, const std::string
 	return sig;
 }
 
+// Wires and cells are allocated in slabs of objects that are adjacent in
+// memory, instead of with one malloc() each. Freed objects are kept on a free
+// list of the thread and reused by it, so that module passes running on
+// several threads do not contend for a lock. When a thread exits, its free
+// list is handed over to the other threads, which take it before allocating a
+// new slab. The pools are shared by all modules, as cells can be moved between
+// modules (see Module::move_cells()). Slabs are never returned to the system,
+// and the pools are never destroyed, so that objects can still be freed during
+// static destruction.
+template<size_t object_size>
+struct SlabPool
+{
+	static const int slab_objects = 1024;
+	static const size_t slot_size = (object_size + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+	static thread_local void *free_list;
+	static thread_local bool thread_registered;
+
+	// free lists of the threads that have exited
+	static std::vector<void*> &orphaned_lists()
+	{
+		static std::vector<void*> *lists = new std::vector<void*>;
+		return *lists;
+	}
+
+#ifdef YOSYS_ENABLE_THREADS
+	static std::mutex &orphaned_lock()
+	{
+		static std::mutex *lock = new std::mutex;
+		return *lock;
+	}
+#endif
+
+	struct ThreadExit
+	{
+		~ThreadExit()
+		{
+			if (free_list == nullptr)
+				return;
+#ifdef YOSYS_ENABLE_THREADS
+			std::lock_guard<std::mutex> guard(orphaned_lock());
+#endif
+			orphaned_lists().push_back(free_list);
+			free_list = nullptr;
+		}
+	};
+
+	// the flag is never reset, so that the ThreadExit object is not touched
+	// again after it has been destroyed
+	static void register_thread()
+	{
+		if (thread_registered)
+			return;
+		thread_registered = true;
+		static thread_local ThreadExit thread_exit;
+		(void)thread_exit;
+	}
+
+	static void refill()
+	{
+		register_thread();
+
+		{
+#ifdef YOSYS_ENABLE_THREADS
+			std::lock_guard<std::mutex> guard(orphaned_lock());
+#endif
+			if (!orphaned_lists().empty()) {
+				free_list = orphaned_lists().back();
+				orphaned_lists().pop_back();
+				return;
+			}
+		}
+
+		char *slab = (char*)malloc(slot_size * slab_objects);
+		if (slab == nullptr)
+			throw std::bad_alloc();
+		// the objects of a new slab are handed out in address order
+		for (int i = slab_objects-1; i >= 0; i--) {
+			void *p = slab + i * slot_size;
+			*(void**)p = free_list;
+			free_list = p;
+		}
+	}
+
+	static void *alloc()
+	{
+		if (free_list == nullptr)
+			refill();
+		void *p = free_list;
+		free_list = *(void**)p;
+		return p;
+	}
+
+	static void free(void *p)
+	{
+		// a thread that only frees objects hands them over when it exits
+		register_thread();
+		*(void**)p = free_list;
+		free_list = p;
+	}
+};
+
+template<size_t object_size>
+thread_local void *SlabPool<object_size>::free_list = nullptr;
+
+template<size_t object_size>
+thread_local bool SlabPool<object_size>::thread_registered = false;
+
+void *RTLIL::Wire::operator new(size_t size)
+{
+	if (size != sizeof(RTLIL::Wire))
+		return ::operator new(size);
+	return SlabPool<sizeof(RTLIL::Wire)>::alloc();
+}
+
+void RTLIL::Wire::operator delete(void *ptr, size_t size)
+{
+	if (size != sizeof(RTLIL::Wire))
+		::operator delete(ptr);
+	else
+		SlabPool<sizeof(RTLIL::Wire)>::free(ptr);
+}
+
+void *RTLIL::Cell::operator new(size_t size)
+{
+	if (size != sizeof(RTLIL::Cell))
+		return ::operator new(size);
+	return SlabPool<sizeof(RTLIL::Cell)>::alloc();
+}
+
+void RTLIL::Cell::operator delete(void *ptr, size_t size)
+{
+	if (size != sizeof(RTLIL::Cell))
+		::operator delete(ptr);
+	else
+		SlabPool<sizeof(RTLIL::Cell)>::free(ptr);
+}
+
 RTLIL::Wire::Wire()
 {
-	static unsigned int hashidx_count = 123456789;
-	hashidx_count = mkhash_xorshift(hashidx_count);
-	hashidx_ = hashidx_count;
+	static std::atomic<unsigned int> hashidx_count(123456789);
+	hashidx_ = mkhash_xorshift_next(hashidx_count);
 
 	module = nullptr;
 	width = 1;
@@ -2428,9 +3312,8 @@ std::map<unsigned int, RTLIL::Wire*> *RTLIL::Wire::get_all_wires(void)
 
 RTLIL::Memory::Memory()
 {
-	static unsigned int hashidx_count = 123456789;
-	hashidx_count = mkhash_xorshift(hashidx_count);
-	hashidx_ = hashidx_count;
+	static std::atomic<unsigned int> hashidx_count(123456789);
+	hashidx_ = mkhash_xorshift_next(hashidx_count);
 
 	width = 1;
 	start_offset = 0;
@@ -2442,9 +3325,8 @@ RTLIL::Memory::Memory()
 
 RTLIL::Cell::Cell() : module(nullptr)
 {
-	static unsigned int hashidx_count = 123456789;
-	hashidx_count = mkhash_xorshift(hashidx_count);
-	hashidx_ = hashidx_count;
+	static std::atomic<unsigned int> hashidx_count(123456789);
+	hashidx_ = mkhash_xorshift_next(hashidx_count);
 
 	// log("#memtrace# %p\n", this);
 	memhasher();
@@ -2481,19 +3363,22 @@ void RTLIL::Cell::unsetPort(RTLIL::IdString portname)
 
 	if (conn_it != connections_.end())
 	{
-		for (auto mon : module->monitors)
-			mon->notify_connect(this, conn_it->first, conn_it->second, signal);
-
-		if (module->design)
-			for (auto mon : module->design->monitors)
+		if (!module->batch_defer_notify()) {
+			for (auto mon : module->monitors)
 				mon->notify_connect(this, conn_it->first, conn_it->second, signal);
 
+			if (module->design)
+				for (auto mon : module->design->monitors)
+					mon->notify_connect(this, conn_it->first, conn_it->second, signal);
+		}
+
 		if (yosys_xtrace) {
 			log("#X# Unconnect %s.%s.%s\n", log_id(this->module), log_id(this), log_id(portname));
 			log_backtrace("-X- ", yosys_xtrace-1);
 		}
 
 		connections_.erase(conn_it);
+		module->generation++;
 	}
 }
 
@@ -2509,19 +3394,22 @@ void RTLIL::Cell::setPort(RTLIL::IdString portname, RTLIL::SigSpec signal)
 	if (conn_it->second == signal)
 		return;
 
-	for (auto mon : module->monitors)
-		mon->notify_connect(this, conn_it->first, conn_it->second, signal);
-
-	if (module->design)
-		for (auto mon : module->design->monitors)
+	if (!module->batch_defer_notify()) {
+		for (auto mon : module->monitors)
 			mon->notify_connect(this, conn_it->first, conn_it->second, signal);
 
+		if (module->design)
+			for (auto mon : module->design->monitors)
+				mon->notify_connect(this, conn_it->first, conn_it->second, signal);
+	}
+
 	if (yosys_xtrace) {
 		log("#X# Connect %s.%s.%s = %s (%d)\n", log_id(this->module), log_id(this), log_id(portname), log_signal(signal), GetSize(signal));
 		log_backtrace("-X- ", yosys_xtrace-1);
 	}
 
 	conn_it->second = signal;
+	module->generation++;
 }
 
 const RTLIL::SigSpec &RTLIL::Cell::getPort(RTLIL::IdString portname) const
@@ -2575,11 +3463,17 @@ bool RTLIL::Cell::hasParam(RTLIL::IdString paramname) const
 void RTLIL::Cell::unsetParam(RTLIL::IdString paramname)
 {
 	parameters.erase(paramname);
+	if (module)
+		module->generation++;
 }
 
 void RTLIL::Cell::setParam(RTLIL::IdString paramname, RTLIL::Const value)
 {
-	parameters[paramname] = value;
+	RTLIL::Const &param = parameters[paramname];
+	param = std::move(value);
+	param.intern();
+	if (module)
+		module->generation++;
 }
 
 const RTLIL::Const &RTLIL::Cell::getParam(RTLIL::IdString paramname) const
@@ -2672,7 +3566,7 @@ RTLIL::SigChunk::SigChunk()
 RTLIL::SigChunk::SigChunk(const RTLIL::Const &value)
 {
 	wire = NULL;
-	data = value.bits;
+	data = value.to_bits();
 	width = GetSize(data);
 	offset = 0;
 }
@@ -2696,7 +3590,7 @@ RTLIL::SigChunk::SigChunk(RTLIL::Wire *wire, int offset, int width)
 RTLIL::SigChunk::SigChunk(const std::string &str)
 {
 	wire = NULL;
-	data = RTLIL::Const(str).bits;
+	data = RTLIL::Const(str).to_bits();
 	width = GetSize(data);
 	offset = 0;
 }
@@ -2704,7 +3598,7 @@ RTLIL::SigChunk::SigChunk(const std::string &str)
 RTLIL::SigChunk::SigChunk(int val, int width)
 {
 	wire = NULL;
-	data = RTLIL::Const(val, width).bits;
+	data = RTLIL::Const(val, width).to_bits();
 	this->width = GetSize(data);
 	offset = 0;
 }
@@ -2712,7 +3606,7 @@ RTLIL::SigChunk::SigChunk(int val, int width)
 RTLIL::SigChunk::SigChunk(RTLIL::State bit, int width)
 {
 	wire = NULL;
-	data = RTLIL::Const(bit, width).bits;
+	data = RTLIL::Const(bit, width).to_bits();
 	this->width = GetSize(data);
 	offset = 0;
 }
@@ -2722,7 +3616,7 @@ RTLIL::SigChunk::SigChunk(RTLIL::SigBit bit)
 	wire = bit.wire;
 	offset = 0;
 	if (wire == NULL)
-		data = RTLIL::Const(bit.data).bits;
+		data = RTLIL::Const(bit.data).to_bits();
 	else
 		offset = bit.offset;
 	width = 1;
@@ -2989,7 +3883,7 @@ void RTLIL::SigSpec::pack() const
 	cover("kernel.rtlil.sigspec.convert.pack");
 	log_assert(that->chunks_.empty());
 
-	std::vector<RTLIL::SigBit> old_bits;
+	small_vector<RTLIL::SigBit, 2> old_bits;
 	old_bits.swap(that->bits_);
 
 	RTLIL::SigChunk *last = NULL;
@@ -3059,6 +3953,14 @@ void RTLIL::SigSpec::updhash() const
 		that->hash_ = 1;
 }
 
+size_t RTLIL::SigSpec::memory_usage() const
+{
+	size_t bytes = chunks_.memory_usage() + bits_.memory_usage();
+	for (auto &c : chunks_)
+		bytes += c.data.capacity() * sizeof(RTLIL::State);
+	return bytes;
+}
+
 void RTLIL::SigSpec::sort()
 {
 	unpack();
@@ -3082,6 +3984,109 @@ void RTLIL::SigSpec::sort_and_unify()
 	*this = unique_bits;
 }
 
+// Helpers for the pattern based replace(), remove() and extract() below. They
+// work on the chunks of the signals, so that packed signals are not unpacked,
+// chunks that can not match are skipped as a whole, and the results are built
+// from chunks again.
+
+// Marks the bits of sig for which match_bit() is true, only calling it for the
+// chunks for which match_chunk() is true. Returns false if no bit matched.
+template<typename ChunkPred, typename BitPred>
+static bool sigspec_match(const RTLIL::SigSpec &sig, std::vector<bool> &mask, ChunkPred match_chunk, BitPred match_bit)
+{
+	bool found = false;
+	int pos = 0;
+	mask.assign(sig.size(), false);
+	for (auto &c : sig.chunks()) {
+		if (match_chunk(c))
+			for (int i = 0; i < c.width; i++)
+				if (match_bit(RTLIL::SigBit(c, i))) {
+					mask[pos + i] = true;
+					found = true;
+				}
+		pos += c.width;
+	}
+	return found;
+}
+
+// Returns the bits of sig for which the mask has the given value, with the
+// bits of repl (if given) in place of the others.
+static RTLIL::SigSpec sigspec_select(const RTLIL::SigSpec &sig, const std::vector<bool> &mask, bool value, const std::vector<RTLIL::SigBit> *repl = nullptr)
+{
+	RTLIL::SigSpec result;
+	int pos = 0;
+	for (auto &c : sig.chunks()) {
+		int i = 0;
+		while (i < c.width) {
+			if (mask[pos + i] != value) {
+				if (repl != nullptr)
+					result.append_bit(repl->at(pos + i));
+				i++;
+				continue;
+			}
+			int j = i;
+			while (j < c.width && mask[pos + j] == value)
+				j++;
+			result.append(i == 0 && j == c.width ? c : c.extract(i, j - i));
+			i = j;
+		}
+		pos += c.width;
+	}
+	return result;
+}
+
+template<typename T>
+static void sigspec_replace(const RTLIL::SigSpec &sig, const T &rules, RTLIL::SigSpec *other)
+{
+	std::vector<bool> mask;
+	if (!sigspec_match(sig, mask, [](const RTLIL::SigChunk&) { return true; },
+			[&](const RTLIL::SigBit &bit) { return rules.count(bit) != 0; }))
+		return;
+
+	std::vector<RTLIL::SigBit> repl(sig.size());
+	int pos = 0;
+	for (auto &c : sig.chunks()) {
+		for (int i = 0; i < c.width; i++)
+			if (mask[pos + i])
+				repl[pos + i] = rules.at(RTLIL::SigBit(c, i));
+		pos += c.width;
+	}
+
+	*other = sigspec_select(*other, mask, false, &repl);
+}
+
+// The pattern as offset ranges by wire, so that the chunks of wires that are
+// not in the pattern are skipped.
+struct SigSpecRanges
+{
+	dict<RTLIL::Wire*, std::vector<std::pair<int, int>>> ranges;
+	const std::vector<std::pair<int, int>> *current = nullptr;
+
+	SigSpecRanges(const RTLIL::SigSpec &pattern) {
+		for (auto &c : pattern.chunks())
+			if (c.wire != NULL)
+				ranges[c.wire].push_back(std::make_pair(c.offset, c.offset + c.width));
+	}
+
+	SigSpecRanges(const RTLIL::SigChunk &c) {
+		if (c.wire != NULL)
+			ranges[c.wire].push_back(std::make_pair(c.offset, c.offset + c.width));
+	}
+
+	bool match_chunk(const RTLIL::SigChunk &c) {
+		auto it = c.wire != NULL ? ranges.find(c.wire) : ranges.end();
+		current = it != ranges.end() ? &it->second : nullptr;
+		return current != nullptr;
+	}
+
+	bool match_bit(const RTLIL::SigBit &bit) const {
+		for (auto &r : *current)
+			if (bit.offset >= r.first && bit.offset < r.second)
+				return true;
+		return false;
+	}
+};
+
 void RTLIL::SigSpec::replace(const RTLIL::SigSpec &pattern, const RTLIL::SigSpec &with)
 {
 	replace(pattern, with, this);
@@ -3093,10 +4098,35 @@ void RTLIL::SigSpec::replace(const RTLIL::SigSpec &pattern, const RTLIL::SigSpec
 	log_assert(width_ == other->width_);
 	log_assert(pattern.width_ == with.width_);
 
+	// later bits of the pattern take precedence, unless the replacement is
+	// done in place, where the first replacement of a bit removes it
+	dict<RTLIL::SigBit, RTLIL::SigBit> rules;
+	for (int i = 0; i < pattern.width_; i++)
+		if (pattern[i].wire != NULL) {
+			if (other == this)
+				rules.insert(std::make_pair(pattern[i], with[i]));
+			else
+				rules[pattern[i]] = with[i];
+		}
+
+	// in place, bits replaced by a bit of the pattern are replaced again by
+	// the later bits of the pattern
+	bool chained = false;
+	if (other == this)
+		for (auto &it : rules)
+			if (rules.count(it.second))
+				chained = true;
+
+	if (!chained) {
+		if (!rules.empty())
+			sigspec_replace(*this, rules, other);
+		other->check();
+		return;
+	}
+
 	pattern.unpack();
 	with.unpack();
 	unpack();
-	other->unpack();
 
 	for (int i = 0; i < GetSize(pattern.bits_); i++) {
 		if (pattern.bits_[i].wire != NULL) {
@@ -3124,14 +4154,7 @@ void RTLIL::SigSpec::replace(const dict<RTLIL::SigBit, RTLIL::SigBit> &rules, RT
 	log_assert(width_ == other->width_);
 
 	if (rules.empty()) return;
-	unpack();
-	other->unpack();
-
-	for (int i = 0; i < GetSize(bits_); i++) {
-		auto it = rules.find(bits_[i]);
-		if (it != rules.end())
-			other->bits_[i] = it->second;
-	}
+	sigspec_replace(*this, rules, other);
 
 	other->check();
 }
@@ -3149,14 +4172,7 @@ void RTLIL::SigSpec::replace(const std::map<RTLIL::SigBit, RTLIL::SigBit> &rules
 	log_assert(width_ == other->width_);
 
 	if (rules.empty()) return;
-	unpack();
-	other->unpack();
-
-	for (int i = 0; i < GetSize(bits_); i++) {
-		auto it = rules.find(bits_[i]);
-		if (it != rules.end())
-			other->bits_[i] = it->second;
-	}
+	sigspec_replace(*this, rules, other);
 
 	other->check();
 }
@@ -3179,29 +4195,18 @@ void RTLIL::SigSpec::remove2(const RTLIL::SigSpec &pattern, RTLIL::SigSpec *othe
 	else
 		cover("kernel.rtlil.sigspec.remove");
 
-	unpack();
-	if (other != NULL) {
+	if (other != NULL)
 		log_assert(width_ == other->width_);
-		other->unpack();
-	}
 
-	for (int i = GetSize(bits_) - 1; i >= 0; i--)
-	{
-		if (bits_[i].wire == NULL) continue;
-
-		for (auto &pattern_chunk : pattern.chunks())
-			if (bits_[i].wire == pattern_chunk.wire &&
-				bits_[i].offset >= pattern_chunk.offset &&
-				bits_[i].offset < pattern_chunk.offset + pattern_chunk.width) {
-				bits_.erase(bits_.begin() + i);
-				width_--;
-				if (other != NULL) {
-					other->bits_.erase(other->bits_.begin() + i);
-					other->width_--;
-				}
-				break;
-			}
-	}
+	SigSpecRanges ranges(pattern);
+	std::vector<bool> mask;
+	if (!sigspec_match(*this, mask, [&](const RTLIL::SigChunk &c) { return ranges.match_chunk(c); },
+			[&](const RTLIL::SigBit &bit) { return ranges.match_bit(bit); }))
+		return;
+
+	if (other != NULL)
+		*other = sigspec_select(*other, mask, false);
+	*this = sigspec_select(*this, mask, false);
 
 	check();
 }
@@ -3224,23 +4229,17 @@ void RTLIL::SigSpec::remove2(const pool<RTLIL::SigBit> &pattern, RTLIL::SigSpec
 	else
 		cover("kernel.rtlil.sigspec.remove");
 
-	unpack();
-
-	if (other != NULL) {
+	if (other != NULL)
 		log_assert(width_ == other->width_);
-		other->unpack();
-	}
 
-	for (int i = GetSize(bits_) - 1; i >= 0; i--) {
-		if (bits_[i].wire != NULL && pattern.count(bits_[i])) {
-			bits_.erase(bits_.begin() + i);
-			width_--;
-			if (other != NULL) {
-				other->bits_.erase(other->bits_.begin() + i);
-				other->width_--;
-			}
-		}
-	}
+	std::vector<bool> mask;
+	if (pattern.empty() || !sigspec_match(*this, mask, [](const RTLIL::SigChunk &c) { return c.wire != NULL; },
+			[&](const RTLIL::SigBit &bit) { return pattern.count(bit) != 0; }))
+		return;
+
+	if (other != NULL)
+		*other = sigspec_select(*other, mask, false);
+	*this = sigspec_select(*this, mask, false);
 
 	check();
 }
@@ -3252,23 +4251,17 @@ void RTLIL::SigSpec::remove2(const std::set<RTLIL::SigBit> &pattern, RTLIL::SigS
 	else
 		cover("kernel.rtlil.sigspec.remove");
 
-	unpack();
-
-	if (other != NULL) {
+	if (other != NULL)
 		log_assert(width_ == other->width_);
-		other->unpack();
-	}
 
-	for (int i = GetSize(bits_) - 1; i >= 0; i--) {
-		if (bits_[i].wire != NULL && pattern.count(bits_[i])) {
-			bits_.erase(bits_.begin() + i);
-			width_--;
-			if (other != NULL) {
-				other->bits_.erase(other->bits_.begin() + i);
-				other->width_--;
-			}
-		}
-	}
+	std::vector<bool> mask;
+	if (pattern.empty() || !sigspec_match(*this, mask, [](const RTLIL::SigChunk &c) { return c.wire != NULL; },
+			[&](const RTLIL::SigBit &bit) { return pattern.count(bit) != 0; }))
+		return;
+
+	if (other != NULL)
+		*other = sigspec_select(*other, mask, false);
+	*this = sigspec_select(*this, mask, false);
 
 	check();
 }
@@ -3282,26 +4275,14 @@ RTLIL::SigSpec RTLIL::SigSpec::extract(const RTLIL::SigSpec &pattern, const RTLI
 
 	log_assert(other == NULL || width_ == other->width_);
 
+	// the result is ordered by the chunks of the pattern
 	RTLIL::SigSpec ret;
-	std::vector<RTLIL::SigBit> bits_match = to_sigbit_vector();
-
-	for (auto& pattern_chunk : pattern.chunks()) {
-		if (other) {
-			std::vector<RTLIL::SigBit> bits_other = other->to_sigbit_vector();
-			for (int i = 0; i < width_; i++)
-				if (bits_match[i].wire &&
-					bits_match[i].wire == pattern_chunk.wire &&
-					bits_match[i].offset >= pattern_chunk.offset &&
-					bits_match[i].offset < pattern_chunk.offset + pattern_chunk.width)
-					ret.append_bit(bits_other[i]);
-		} else {
-			for (int i = 0; i < width_; i++)
-				if (bits_match[i].wire &&
-					bits_match[i].wire == pattern_chunk.wire &&
-					bits_match[i].offset >= pattern_chunk.offset &&
-					bits_match[i].offset < pattern_chunk.offset + pattern_chunk.width)
-					ret.append_bit(bits_match[i]);
-		}
+	std::vector<bool> mask;
+	for (auto &pattern_chunk : pattern.chunks()) {
+		SigSpecRanges ranges(pattern_chunk);
+		if (sigspec_match(*this, mask, [&](const RTLIL::SigChunk &c) { return ranges.match_chunk(c); },
+				[&](const RTLIL::SigBit &bit) { return ranges.match_bit(bit); }))
+			ret.append(sigspec_select(other ? *other : *this, mask, true));
 	}
 
 	ret.check();
@@ -3317,19 +4298,11 @@ RTLIL::SigSpec RTLIL::SigSpec::extract(const pool<RTLIL::SigBit> &pattern, const
 
 	log_assert(other == NULL || width_ == other->width_);
 
-	std::vector<RTLIL::SigBit> bits_match = to_sigbit_vector();
 	RTLIL::SigSpec ret;
-
-	if (other) {
-		std::vector<RTLIL::SigBit> bits_other = other->to_sigbit_vector();
-		for (int i = 0; i < width_; i++)
-			if (bits_match[i].wire && pattern.count(bits_match[i]))
-				ret.append_bit(bits_other[i]);
-	} else {
-		for (int i = 0; i < width_; i++)
-			if (bits_match[i].wire && pattern.count(bits_match[i]))
-				ret.append_bit(bits_match[i]);
-	}
+	std::vector<bool> mask;
+	if (!pattern.empty() && sigspec_match(*this, mask, [](const RTLIL::SigChunk &c) { return c.wire != NULL; },
+			[&](const RTLIL::SigBit &bit) { return pattern.count(bit) != 0; }))
+		ret = sigspec_select(other ? *other : *this, mask, true);
 
 	ret.check();
 	return ret;
@@ -3358,7 +4331,7 @@ void RTLIL::SigSpec::remove_const()
 	{
 		cover("kernel.rtlil.sigspec.remove_const.packed");
 
-		std::vector<RTLIL::SigChunk> new_chunks;
+		small_vector<RTLIL::SigChunk, 1> new_chunks;
 		new_chunks.reserve(GetSize(chunks_));
 
 		width_ = 0;
@@ -3374,7 +4347,7 @@ void RTLIL::SigSpec::remove_const()
 	{
 		cover("kernel.rtlil.sigspec.remove_const.unpacked");
 
-		std::vector<RTLIL::SigBit> new_bits;
+		small_vector<RTLIL::SigBit, 2> new_bits;
 		new_bits.reserve(width_);
 
 		for (auto &bit : bits_)
@@ -24,6 +24,240 @@
 
 YOSYS_NAMESPACE_BEGIN
 
+struct SigMap;
+struct ModuleSigMap;
+
+// vector with inline storage for the first N elements: this is used for the
+// chunk and bit lists in RTLIL::SigSpec, so that signals made of a single
+// chunk or a few bits (the vast majority) do not need a heap allocation
+
+template<typename T, int N>
+struct small_vector
+{
+	typedef T value_type;
+	typedef T &reference;
+	typedef const T &const_reference;
+	typedef T *iterator;
+	typedef const T *const_iterator;
+	typedef std::reverse_iterator<iterator> reverse_iterator;
+	typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+private:
+	T *data_;
+	int size_, capacity_;
+	typename std::aligned_storage<sizeof(T), alignof(T)>::type inline_[N];
+
+	T *inline_data() { return reinterpret_cast<T*>(inline_); }
+	bool is_inline() const { return data_ == reinterpret_cast<const T*>(inline_); }
+
+	void grow(int min_capacity)
+	{
+		int new_capacity = std::max(min_capacity, 2*capacity_);
+		T *new_data = static_cast<T*>(::operator new(sizeof(T) * new_capacity));
+		for (int i = 0; i < size_; i++) {
+			new (new_data + i) T(std::move(data_[i]));
+			data_[i].~T();
+		}
+		if (!is_inline())
+			::operator delete(data_);
+		data_ = new_data;
+		capacity_ = new_capacity;
+	}
+
+	void release()
+	{
+		clear();
+		if (!is_inline())
+			::operator delete(data_);
+		data_ = inline_data();
+		capacity_ = N;
+	}
+
+	// *this must be empty and use its inline storage
+	void take(small_vector &other)
+	{
+		if (other.is_inline()) {
+			for (int i = 0; i < other.size_; i++)
+				new (data_ + i) T(std::move(other.data_[i]));
+			size_ = other.size_;
+			other.clear();
+		} else {
+			data_ = other.data_;
+			size_ = other.size_;
+			capacity_ = other.capacity_;
+			other.data_ = other.inline_data();
+			other.size_ = 0;
+			other.capacity_ = N;
+		}
+	}
+
+public:
+	small_vector() : data_(inline_data()), size_(0), capacity_(N) { }
+	small_vector(const small_vector &other) : small_vector() { insert(end(), other.begin(), other.end()); }
+	small_vector(small_vector &&other) : small_vector() { take(other); }
+	small_vector(const std::vector<T> &other) : small_vector() { insert(end(), other.begin(), other.end()); }
+
+	template<typename It>
+	small_vector(It first, It last) : small_vector() { insert(end(), first, last); }
+
+	~small_vector() { release(); }
+
+	small_vector &operator=(const small_vector &other) {
+		if (this != &other) {
+			clear();
+			insert(end(), other.begin(), other.end());
+		}
+		return *this;
+	}
+
+	small_vector &operator=(small_vector &&other) {
+		if (this != &other) {
+			release();
+			take(other);
+		}
+		return *this;
+	}
+
+	void swap(small_vector &other) {
+		small_vector tmp(std::move(other));
+		other = std::move(*this);
+		*this = std::move(tmp);
+	}
+
+	operator std::vector<T>() const { return std::vector<T>(begin(), end()); }
+
+	size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+	size_t capacity() const { return capacity_; }
+	size_t memory_usage() const { return is_inline() ? 0 : sizeof(T) * capacity_; }
+
+	T *data() { return data_; }
+	const T *data() const { return data_; }
+
+	iterator begin() { return data_; }
+	iterator end() { return data_ + size_; }
+	const_iterator begin() const { return data_; }
+	const_iterator end() const { return data_ + size_; }
+
+	reverse_iterator rbegin() { return reverse_iterator(end()); }
+	reverse_iterator rend() { return reverse_iterator(begin()); }
+	const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+	const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+	T &operator[](size_t index) { return data_[index]; }
+	const T &operator[](size_t index) const { return data_[index]; }
+
+	T &at(size_t index) {
+		if (index >= size())
+			throw std::out_of_range("small_vector::at()");
+		return data_[index];
+	}
+
+	const T &at(size_t index) const {
+		if (index >= size())
+			throw std::out_of_range("small_vector::at()");
+		return data_[index];
+	}
+
+	T &front() { return data_[0]; }
+	T &back() { return data_[size_-1]; }
+	const T &front() const { return data_[0]; }
+	const T &back() const { return data_[size_-1]; }
+
+	void reserve(size_t n) {
+		if (n > size_t(capacity_))
+			grow(n);
+	}
+
+	template<typename... Args>
+	void emplace_back(Args&&... args) {
+		if (size_ == capacity_) {
+			// the arguments may refer to an element of this vector
+			T value(std::forward<Args>(args)...);
+			grow(size_ + 1);
+			new (data_ + size_) T(std::move(value));
+		} else
+			new (data_ + size_) T(std::forward<Args>(args)...);
+		size_++;
+	}
+
+	void push_back(const T &value) { emplace_back(value); }
+	void push_back(T &&value) { emplace_back(std::move(value)); }
+
+	void pop_back() {
+		data_[--size_].~T();
+	}
+
+	void clear() {
+		while (size_ > 0)
+			pop_back();
+	}
+
+	void resize(size_t n, const T &value = T()) {
+		while (size() > n)
+			pop_back();
+		reserve(n);
+		while (size() < n)
+			emplace_back(value);
+	}
+
+	iterator erase(iterator pos) {
+		return erase(pos, pos + 1);
+	}
+
+	iterator erase(iterator first, iterator last) {
+		iterator new_end = std::move(last, end(), first);
+		while (end() != new_end)
+			pop_back();
+		return first;
+	}
+
+	template<typename It>
+	iterator insert(iterator pos, It first, It last) {
+		int index = pos - begin(), count = std::distance(first, last);
+		if (size_ + count > capacity_) {
+			// build the new buffer before releasing the old one, the range
+			// may refer to elements of this vector
+			int new_capacity = std::max(size_ + count, 2*capacity_);
+			T *new_data = static_cast<T*>(::operator new(sizeof(T) * new_capacity));
+			for (int i = 0; i < count; i++, ++first)
+				new (new_data + index + i) T(*first);
+			for (int i = 0; i < size_; i++) {
+				new (new_data + (i < index ? i : i + count)) T(std::move(data_[i]));
+				data_[i].~T();
+			}
+			if (!is_inline())
+				::operator delete(data_);
+			data_ = new_data;
+			size_ += count;
+			capacity_ = new_capacity;
+		} else {
+			int old_size = size_;
+			for (; first != last; ++first)
+				emplace_back(*first);
+			std::rotate(begin() + index, begin() + old_size, end());
+		}
+		return begin() + index;
+	}
+
+	iterator insert(iterator pos, const T &value) {
+		int index = pos - begin();
+		emplace_back(value);
+		std::rotate(begin() + index, end() - 1, end());
+		return begin() + index;
+	}
+
+	bool operator==(const small_vector &other) const {
+		return size_ == other.size_ && std::equal(begin(), end(), other.begin());
+	}
+
+	bool operator!=(const small_vector &other) const {
+		return !(*this == other);
+	}
+};
+
 namespace RTLIL
 {
 	enum State : unsigned char {
@@ -74,6 +308,59 @@ namespace RTLIL
 
 	typedef std::pair<SigSpec, SigSpec> SigSig;
 
+	// chunked array used for the global id string cache: chunks are never
+	// moved once allocated, so existing entries can be read without taking a
+	// lock while other threads append new entries (see IdString::set_concurrent)
+
+	template<typename T>
+	struct IdStorage
+	{
+		static const int chunk_bits = 16;
+		static const int chunk_size = 1 << chunk_bits;
+		static const int max_size = 0x40000000;
+
+		// POD, will be initialized to zero
+		T *chunks_[max_size >> chunk_bits];
+		std::atomic<int> size_;
+
+		inline int size() const { return size_.load(std::memory_order_relaxed); }
+		inline bool empty() const { return size() == 0; }
+
+		inline T &operator[](int idx) {
+			return chunks_[idx >> chunk_bits][idx & (chunk_size-1)];
+		}
+
+		inline T &at(int idx) {
+			log_assert(0 <= idx && idx < size());
+			return (*this)[idx];
+		}
+
+		inline T &back() {
+			return at(size()-1);
+		}
+
+		template<typename V>
+		void push_back(const V &value) {
+			int idx = size();
+			log_assert(idx < max_size);
+			if (chunks_[idx >> chunk_bits] == nullptr)
+				chunks_[idx >> chunk_bits] = new T[chunk_size]();
+			(*this)[idx] = value;
+			size_.store(idx+1, std::memory_order_release);
+		}
+
+		// only while no other thread reads the storage
+		void pop_back() {
+			int idx = size() - 1;
+			log_assert(idx >= 0);
+			size_.store(idx, std::memory_order_release);
+			if ((idx & (chunk_size-1)) == 0) {
+				delete[] chunks_[idx >> chunk_bits];
+				chunks_[idx >> chunk_bits] = nullptr;
+			}
+		}
+	};
+
 	struct IdString
 	{
 		#undef YOSYS_XTRACE_GET_PUT
@@ -89,11 +376,30 @@ namespace RTLIL
 			~destruct_guard_t() { ok = false; }
 		} destruct_guard;
 
-		static std::vector<char*> global_id_storage_;
-		static dict<char*, int, hash_cstr_ops> global_id_index_;
+		// the index is split in shards by string hash, so that threads that
+		// create ids in concurrent mode only contend when they hit the same shard
+		static const int global_id_shards_ = 16;
+
+		static IdStorage<char*> global_id_storage_;
+		static dict<char*, int, hash_cstr_ops> global_id_index_[global_id_shards_];
 	#ifndef YOSYS_NO_IDS_REFCNT
-		static std::vector<int> global_refcount_storage_;
+		static IdStorage<std::atomic<int>> global_refcount_storage_;
 		static std::vector<int> global_free_idx_list_;
+		static int global_compacted_free_count_;
+	#endif
+
+		// the strings are allocated from an arena with per-size free lists
+		// instead of with one strdup() each, see rtlil.cc
+		static char *alloc_str(const char *p);
+		static void free_str(char *p);
+
+		// in concurrent mode refcounts are updated atomically and ids are not
+		// freed when their refcount drops to zero. the unused ids are instead
+		// collected when concurrent mode is left again.
+		static bool global_concurrent_mode_;
+	#ifdef YOSYS_ENABLE_THREADS
+		static std::mutex global_id_shard_lock_[global_id_shards_];
+		static std::mutex global_id_alloc_lock_;
 	#endif
 
 	#ifdef YOSYS_USE_STICKY_IDS
@@ -101,6 +407,27 @@ namespace RTLIL
 		static int last_created_idx_[8];
 	#endif
 
+		// ids created with new_lazy() (see NEW_ID) only get their name when it is
+		// first asked for. until then their storage is nullptr and the parts of the
+		// name are kept here, and they are indexed by their autoidx. there are no
+		// such ids in concurrent mode. looking up the name of such an id gives that
+		// id, and new_lazy() gives the name right away if an "$auto$" name with the
+		// same or a larger number was created before (global_auto_max_), so that
+		// the name of a lazy id is never taken when it is needed.
+		struct lazy_name_t {
+			const char *file, *func;
+			int line, autoidx;
+			std::string str() const;
+		};
+		static dict<int, lazy_name_t> global_lazy_names_;
+		static dict<int, int> global_lazy_autoidx_;
+		static int global_auto_max_;
+
+		static IdString new_lazy(const char *file, int line, const char *func, int autoidx);
+		static const char *materialize(int idx);
+		static void materialize_all();
+		static int find_lazy(const char *p);
+
 		static inline void xtrace_db_dump()
 		{
 		#ifdef YOSYS_XTRACE_GET_PUT
@@ -109,7 +436,7 @@ namespace RTLIL
 				if (global_id_storage_.at(idx) == nullptr)
 					log("#X# DB-DUMP index %d: FREE\n", idx);
 				else
-					log("#X# DB-DUMP index %d: '%s' (ref %d)\n", idx, global_id_storage_.at(idx), global_refcount_storage_.at(idx));
+					log("#X# DB-DUMP index %d: '%s' (ref %d)\n", idx, global_id_storage_.at(idx), int(global_refcount_storage_.at(idx)));
 			}
 		#endif
 		}
@@ -127,17 +454,52 @@ namespace RTLIL
 		#ifdef YOSYS_SORT_ID_FREE_LIST
 			std::sort(global_free_idx_list_.begin(), global_free_idx_list_.end(), std::greater<int>());
 		#endif
+		#ifndef YOSYS_NO_IDS_REFCNT
+			if (2*GetSize(global_free_idx_list_) > global_id_storage_.size() &&
+					4*(GetSize(global_free_idx_list_) - global_compacted_free_count_) > global_id_storage_.size())
+				compact();
+		#endif
+		}
+
+		// reuses the free ids with the lowest indices first and releases the
+		// storage of the free ids at the end of the table, called from
+		// checkpoint() (i.e. after each pass) when less than half of the ids
+		// are in use and many ids have been freed since the last call
+		static void compact();
+
+		static void set_concurrent(bool enable);
+
+	#ifndef YOSYS_NO_IDS_REFCNT
+		static inline int refcount_inc(int idx)
+		{
+			std::atomic<int> &refcount = global_refcount_storage_[idx];
+			if (global_concurrent_mode_)
+				return refcount.fetch_add(1, std::memory_order_relaxed) + 1;
+			int value = refcount.load(std::memory_order_relaxed) + 1;
+			refcount.store(value, std::memory_order_relaxed);
+			return value;
 		}
 
+		static inline int refcount_dec(int idx)
+		{
+			std::atomic<int> &refcount = global_refcount_storage_[idx];
+			if (global_concurrent_mode_)
+				return refcount.fetch_sub(1, std::memory_order_relaxed) - 1;
+			int value = refcount.load(std::memory_order_relaxed) - 1;
+			refcount.store(value, std::memory_order_relaxed);
+			return value;
+		}
+	#endif
+
 		static inline int get_reference(int idx)
 		{
 			if (idx) {
 		#ifndef YOSYS_NO_IDS_REFCNT
-				global_refcount_storage_[idx]++;
+				refcount_inc(idx);
 		#endif
 		#ifdef YOSYS_XTRACE_GET_PUT
 				if (yosys_xtrace)
-					log("#X# GET-BY-INDEX '%s' (index %d, refcount %d)\n", global_id_storage_.at(idx), idx, global_refcount_storage_.at(idx));
+					log("#X# GET-BY-INDEX '%s' (index %d, refcount %d)\n", global_id_storage_.at(idx), idx, int(global_refcount_storage_.at(idx)));
 		#endif
 			}
 			return idx;
@@ -153,24 +515,46 @@ namespace RTLIL
 			log_assert(p[0] == '$' || p[0] == '\\');
 			log_assert(p[1] != 0);
 
-			auto it = global_id_index_.find((char*)p);
-			if (it != global_id_index_.end()) {
+			int shard = hash_cstr_ops::hash(p) % global_id_shards_;
+			dict<char*, int, hash_cstr_ops> &index = global_id_index_[shard];
+		#ifdef YOSYS_ENABLE_THREADS
+			std::unique_lock<std::mutex> shard_lock;
+			if (global_concurrent_mode_)
+				shard_lock = std::unique_lock<std::mutex>(global_id_shard_lock_[shard]);
+		#endif
+
+			auto it = index.find((char*)p);
+			if (it != index.end()) {
 		#ifndef YOSYS_NO_IDS_REFCNT
-				global_refcount_storage_.at(it->second)++;
+				refcount_inc(it->second);
 		#endif
 		#ifdef YOSYS_XTRACE_GET_PUT
 				if (yosys_xtrace)
-					log("#X# GET-BY-NAME '%s' (index %d, refcount %d)\n", global_id_storage_.at(it->second), it->second, global_refcount_storage_.at(it->second));
+					log("#X# GET-BY-NAME '%s' (index %d, refcount %d)\n", global_id_storage_.at(it->second), it->second, int(global_refcount_storage_.at(it->second)));
 		#endif
 				return it->second;
 			}
 
+		#ifdef YOSYS_ENABLE_THREADS
+			std::unique_lock<std::mutex> alloc_lock;
+			if (global_concurrent_mode_)
+				alloc_lock = std::unique_lock<std::mutex>(global_id_alloc_lock_);
+		#endif
+
+			int lazy_idx = find_lazy(p);
+			if (lazy_idx != 0) {
+		#ifndef YOSYS_NO_IDS_REFCNT
+				refcount_inc(lazy_idx);
+		#endif
+				return lazy_idx;
+			}
+
 		#ifndef YOSYS_NO_IDS_REFCNT
 			if (global_free_idx_list_.empty()) {
 				if (global_id_storage_.empty()) {
 					global_refcount_storage_.push_back(0);
 					global_id_storage_.push_back((char*)"");
-					global_id_index_[global_id_storage_.back()] = 0;
+					global_id_index_[hash_cstr_ops::hash("") % global_id_shards_][global_id_storage_.back()] = 0;
 				}
 				log_assert(global_id_storage_.size() < 0x40000000);
 				global_free_idx_list_.push_back(global_id_storage_.size());
@@ -180,17 +564,25 @@ namespace RTLIL
 
 			int idx = global_free_idx_list_.back();
 			global_free_idx_list_.pop_back();
-			global_id_storage_.at(idx) = strdup(p);
-			global_id_index_[global_id_storage_.at(idx)] = idx;
-			global_refcount_storage_.at(idx)++;
+			global_id_storage_.at(idx) = alloc_str(p);
+		#ifdef YOSYS_ENABLE_THREADS
+			if (alloc_lock.owns_lock())
+				alloc_lock.unlock();
+		#endif
+			index[global_id_storage_.at(idx)] = idx;
+			refcount_inc(idx);
 		#else
 			if (global_id_storage_.empty()) {
 				global_id_storage_.push_back((char*)"");
-				global_id_index_[global_id_storage_.back()] = 0;
+				global_id_index_[hash_cstr_ops::hash("") % global_id_shards_][global_id_storage_.back()] = 0;
 			}
 			int idx = global_id_storage_.size();
-			global_id_storage_.push_back(strdup(p));
-			global_id_index_[global_id_storage_.back()] = idx;
+			global_id_storage_.push_back(alloc_str(p));
+		#ifdef YOSYS_ENABLE_THREADS
+			if (alloc_lock.owns_lock())
+				alloc_lock.unlock();
+		#endif
+			index[global_id_storage_.at(idx)] = idx;
 		#endif
 
 			if (yosys_xtrace) {
@@ -200,7 +592,7 @@ namespace RTLIL
 
 		#ifdef YOSYS_XTRACE_GET_PUT
 			if (yosys_xtrace)
-				log("#X# GET-BY-NAME '%s' (index %d, refcount %d)\n", global_id_storage_.at(idx), idx, global_refcount_storage_.at(idx));
+				log("#X# GET-BY-NAME '%s' (index %d, refcount %d)\n", global_id_storage_.at(idx), idx, int(global_refcount_storage_.at(idx)));
 		#endif
 
 		#ifdef YOSYS_USE_STICKY_IDS
@@ -216,6 +608,26 @@ namespace RTLIL
 		}
 
 	#ifndef YOSYS_NO_IDS_REFCNT
+		static void free_reference(int idx)
+		{
+			if (global_id_storage_.at(idx) == nullptr) {
+				global_lazy_autoidx_.erase(global_lazy_names_.at(idx).autoidx);
+				global_lazy_names_.erase(idx);
+				global_free_idx_list_.push_back(idx);
+				return;
+			}
+
+			if (yosys_xtrace) {
+				log("#X# Removed IdString '%s' with index %d.\n", global_id_storage_.at(idx), idx);
+				log_backtrace("-X- ", yosys_xtrace-1);
+			}
+
+			global_id_index_[hash_cstr_ops::hash(global_id_storage_.at(idx)) % global_id_shards_].erase(global_id_storage_.at(idx));
+			free_str(global_id_storage_.at(idx));
+			global_id_storage_.at(idx) = nullptr;
+			global_free_idx_list_.push_back(idx);
+		}
+
 		static inline void put_reference(int idx)
 		{
 			// put_reference() may be called from destructors after the destructor of
@@ -225,26 +637,17 @@ namespace RTLIL
 
 		#ifdef YOSYS_XTRACE_GET_PUT
 			if (yosys_xtrace) {
-				log("#X# PUT '%s' (index %d, refcount %d)\n", global_id_storage_.at(idx), idx, global_refcount_storage_.at(idx));
+				log("#X# PUT '%s' (index %d, refcount %d)\n", global_id_storage_.at(idx), idx, int(global_refcount_storage_.at(idx)));
 			}
 		#endif
 
-			int &refcount = global_refcount_storage_[idx];
+			int refcount = refcount_dec(idx);
 
-			if (--refcount > 0)
+			if (refcount > 0 || global_concurrent_mode_)
 				return;
 
 			log_assert(refcount == 0);
-
-			if (yosys_xtrace) {
-				log("#X# Removed IdString '%s' with index %d.\n", global_id_storage_.at(idx), idx);
-				log_backtrace("-X- ", yosys_xtrace-1);
-			}
-
-			global_id_index_.erase(global_id_storage_.at(idx));
-			free(global_id_storage_.at(idx));
-			global_id_storage_.at(idx) = nullptr;
-			global_free_idx_list_.push_back(idx);
+			free_reference(idx);
 		}
 	#else
 		static inline void put_reference(int) { }
@@ -277,11 +680,12 @@ namespace RTLIL
 		}
 
 		inline const char *c_str() const {
-			return global_id_storage_.at(index_);
+			const char *p = global_id_storage_.at(index_);
+			return p != nullptr ? p : materialize(index_);
 		}
 
 		inline std::string str() const {
-			return std::string(global_id_storage_.at(index_));
+			return std::string(c_str());
 		}
 
 		inline bool operator<(const IdString &rhs) const {
@@ -300,6 +704,9 @@ namespace RTLIL
 		bool operator!=(const char *rhs) const { return strcmp(c_str(), rhs) != 0; }
 
 		char operator[](size_t i) const {
+			// all lazy names start with '$', checking that does not need the name
+			if (i == 0 && global_id_storage_.at(index_) == nullptr)
+				return '$';
 			const char *p = c_str();
 			for (; i != 0; i--, p++)
 				log_assert(*p != 0);
@@ -334,7 +741,8 @@ namespace RTLIL
 		}
 
 		bool empty() const {
-			return c_str()[0] == 0;
+			// only the empty string has index 0, all other ids start with '$' or '\\'
+			return index_ == 0;
 		}
 
 		void clear() {
@@ -588,21 +996,176 @@ namespace RTLIL
 struct RTLIL::Const
 {
 	int flags;
-	std::vector<RTLIL::State> bits;
 
+private:
+	// Constants that only contain 0, 1, x and z bits are stored packed into
+	// 64 bit words: First the value bits, then the x/z bits (only when the
+	// constant is not fully defined, after set() they may be all zero). A 0 is
+	// stored as 0/0, a 1 as 1/0, an x as 0/1 and a z as 1/1. All other
+	// constants and constants accessed through bits() are stored as a vector
+	// of states.
+	int packed_width_;
+
+	// The packed words are reference counted and shared by the copies of a
+	// constant until one of the copies is modified.
+	//
+	// Blocks of more than page_words words are split into pages. Pages that
+	// only contain 0 words or only all-ones words point to the shared
+	// zero_page or ones_page until they are written, so that large constants
+	// that are mostly 0 or mostly x (e.g. memory initialization values) only
+	// take memory for the other pages.
+	struct packed_words_t
+	{
+		static const int page_bits = 6;
+		static const int page_words = 1 << page_bits;
+		static uint64_t zero_page[page_words], ones_page[page_words];
+
+		struct block_t {
+			std::atomic<int> refcount;
+			int size;
+			union {
+				uint64_t data[1];
+				uint64_t *pages[1];
+			};
+		};
+
+		block_t *block_ = nullptr;
+
+		packed_words_t() { }
+		packed_words_t(const packed_words_t &other) : block_(other.block_) {
+			if (block_ != nullptr)
+				block_->refcount.fetch_add(1, std::memory_order_relaxed);
+		}
+		packed_words_t(packed_words_t &&other) : block_(other.block_) { other.block_ = nullptr; }
+		~packed_words_t() { clear(); }
+
+		packed_words_t &operator=(const packed_words_t &other) {
+			if (block_ != other.block_) {
+				clear();
+				block_ = other.block_;
+				if (block_ != nullptr)
+					block_->refcount.fetch_add(1, std::memory_order_relaxed);
+			}
+			return *this;
+		}
+
+		packed_words_t &operator=(packed_words_t &&other) {
+			if (this != &other) {
+				clear();
+				block_ = other.block_;
+				other.block_ = nullptr;
+			}
+			return *this;
+		}
+
+		inline int size() const { return block_ == nullptr ? 0 : block_->size; }
+		inline bool paged() const { return block_ != nullptr && block_->size > page_words; }
+		inline int num_pages() const { return (block_->size + page_words - 1) >> page_bits; }
+		static inline bool shared_page(const uint64_t *page) { return page == zero_page || page == ones_page; }
+
+		inline uint64_t operator[](int index) const {
+			if (block_->size <= page_words)
+				return block_->data[index];
+			return block_->pages[index >> page_bits][index & (page_words - 1)];
+		}
+		inline bool shared_with(const packed_words_t &other) const { return block_ != nullptr && block_ == other.block_; }
+		inline bool shared() const { return block_ != nullptr && block_->refcount.load(std::memory_order_relaxed) > 1; }
+
+		// only valid after assign(), resize() or make_unique()
+		inline uint64_t &word(int index) {
+			if (block_->size <= page_words)
+				return block_->data[index];
+			uint64_t *&page = block_->pages[index >> page_bits];
+			if (shared_page(page))
+				page = copy_page(page);
+			return page[index & (page_words - 1)];
+		}
+
+		static uint64_t *copy_page(const uint64_t *page);
+
+		void clear();
+		void assign(int n);
+		void resize(int n);
+
+		// sets the bits [0, width) of the words starting at word offset to
+		// one, same validity as word()
+		void set_ones(int offset, int width);
+
+		// replaces pages that only contain 0 or all-ones words by the
+		// shared pages, same validity as word()
+		void compact();
+		void make_unique() {
+			if (block_ != nullptr && block_->refcount.load(std::memory_order_acquire) > 1)
+				resize(block_->size);
+		}
+
+		size_t memory_usage() const;
+	};
+
+	packed_words_t packed_;
+	std::vector<RTLIL::State> bits_;
+
+	void pack_bits(const std::vector<RTLIL::State> &bits);
+	void unpack_bits();
+
+	inline int packed_words() const { return (packed_width_ + 63) >> 6; }
+
+	inline uint64_t packed_undef(int word) const {
+		return GetSize(packed_) > packed_words() ? packed_[packed_words() + word] : 0;
+	}
+
+	inline RTLIL::State get_bit(int index) const {
+		if (packed_width_ < 0)
+			return bits_[index];
+		int state = (packed_[index >> 6] >> (index & 63)) & 1;
+		state |= ((packed_undef(index >> 6) >> (index & 63)) & 1) << 1;
+		return RTLIL::State(state);
+	}
+
+public:
 	Const();
 	Const(std::string str);
 	Const(int val, int width = 32);
 	Const(RTLIL::State bit, int width = 1);
-	Const(const std::vector<RTLIL::State> &bits) : bits(bits) { flags = CONST_FLAG_NONE; }
+	Const(const std::vector<RTLIL::State> &bits);
 	Const(const std::vector<bool> &bits);
 	Const(const RTLIL::Const &c);
+	Const(RTLIL::Const &&c);
 	RTLIL::Const &operator =(const RTLIL::Const &other) = default;
+	RTLIL::Const &operator =(RTLIL::Const &&other);
 
 	bool operator <(const RTLIL::Const &other) const;
 	bool operator ==(const RTLIL::Const &other) const;
 	bool operator !=(const RTLIL::Const &other) const;
 
+	// Returns the bits as a vector of states that may be modified. This
+	// switches the constant to the unpacked representation.
+	inline std::vector<RTLIL::State> &bits() {
+		if (packed_width_ >= 0)
+			unpack_bits();
+		return bits_;
+	}
+	std::vector<RTLIL::State> to_bits() const;
+
+	// Sets a single bit, without unpacking the constant when the bit is 0, 1, x or z
+	void set(int index, RTLIL::State bit);
+
+	// Switches the constant to the packed representation if possible
+	void pack();
+
+	// Packs the constant and shares its words with an equal constant that
+	// has been interned before, for values that many objects have in common
+	// (e.g. cell parameters). Constants of more than 4096 bits are left alone.
+	void intern();
+	inline bool is_packed() const { return packed_width_ >= 0; }
+
+	// true if the packed words are shared with other copies of the constant
+	inline bool is_shared() const { return packed_.shared(); }
+
+	// heap memory used for the bits, words shared with other copies of the
+	// constant are divided between them
+	size_t memory_usage() const { return packed_.memory_usage() + bits_.capacity() * sizeof(RTLIL::State); }
+
 	bool as_bool() const;
 	int as_int(bool is_signed = false) const;
 	std::string as_string() const;
@@ -610,12 +1173,32 @@ struct RTLIL::Const
 
 	std::string decode_string() const;
 
-	inline int size() const { return bits.size(); }
-	inline bool empty() const { return bits.empty(); }
-	inline RTLIL::State &operator[](int index) { return bits.at(index); }
-	inline const RTLIL::State &operator[](int index) const { return bits.at(index); }
-	inline decltype(bits)::iterator begin() { return bits.begin(); }
-	inline decltype(bits)::iterator end() { return bits.end(); }
+	// Reading the bits does not change the representation, bits() must be
+	// used to modify them.
+	inline int size() const { return packed_width_ < 0 ? GetSize(bits_) : packed_width_; }
+	inline bool empty() const { return size() == 0; }
+	inline RTLIL::State operator[](int index) const { log_assert(index >= 0 && index < size()); return get_bit(index); }
+	inline RTLIL::State front() const { return (*this)[0]; }
+	inline RTLIL::State back() const { return (*this)[size()-1]; }
+
+	struct const_iterator {
+		typedef std::input_iterator_tag iterator_category;
+		typedef RTLIL::State value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const RTLIL::State *pointer;
+		typedef RTLIL::State reference;
+		const Const *parent;
+		int index;
+		const_iterator(const Const *parent, int index) : parent(parent), index(index) { }
+		inline RTLIL::State operator*() const { return parent->get_bit(index); }
+		inline const_iterator &operator++() { index++; return *this; }
+		inline const_iterator operator++(int) { const_iterator it = *this; index++; return it; }
+		inline bool operator==(const const_iterator &other) const { return index == other.index; }
+		inline bool operator!=(const const_iterator &other) const { return index != other.index; }
+	};
+
+	inline const_iterator begin() const { return const_iterator(this, 0); }
+	inline const_iterator end() const { return const_iterator(this, size()); }
 
 	bool is_fully_zero() const;
 	bool is_fully_ones() const;
@@ -623,25 +1206,26 @@ struct RTLIL::Const
 	bool is_fully_undef() const;
 
 	inline RTLIL::Const extract(int offset, int len = 1, RTLIL::State padding = RTLIL::State::S0) const {
-		RTLIL::Const ret;
-		ret.bits.reserve(len);
+		std::vector<RTLIL::State> ret;
+		ret.reserve(len);
 		for (int i = offset; i < offset + len; i++)
-			ret.bits.push_back(i < GetSize(bits) ? bits[i] : padding);
+			ret.push_back(i < size() ? get_bit(i) : padding);
 		return ret;
 	}
 
 	void extu(int width) {
-		bits.resize(width, RTLIL::State::S0);
+		bits().resize(width, RTLIL::State::S0);
 	}
 
 	void exts(int width) {
-		bits.resize(width, bits.empty() ? RTLIL::State::Sx : bits.back());
+		std::vector<RTLIL::State> &bv = bits();
+		bv.resize(width, bv.empty() ? RTLIL::State::Sx : bv.back());
 	}
 
 	inline unsigned int hash() const {
 		unsigned int h = mkhash_init;
-		for (auto b : bits)
-			mkhash(h, b);
+		for (int i = 0; i < size(); i++)
+			mkhash(h, get_bit(i));
 		return h;
 	}
 };
@@ -742,8 +1326,8 @@ struct RTLIL::SigSpec
 private:
 	int width_;
 	unsigned long hash_;
-	std::vector<RTLIL::SigChunk> chunks_; // LSB at index 0
-	std::vector<RTLIL::SigBit> bits_; // LSB at index 0
+	small_vector<RTLIL::SigChunk, 1> chunks_; // LSB at index 0
+	small_vector<RTLIL::SigBit, 2> bits_; // LSB at index 0
 
 	void pack() const;
 	void unpack() const;
@@ -798,8 +1382,11 @@ public:
 		return hash_;
 	}
 
-	inline const std::vector<RTLIL::SigChunk> &chunks() const { pack(); return chunks_; }
-	inline const std::vector<RTLIL::SigBit> &bits() const { inline_unpack(); return bits_; }
+	inline const small_vector<RTLIL::SigChunk, 1> &chunks() const { pack(); return chunks_; }
+	inline const small_vector<RTLIL::SigBit, 2> &bits() const { inline_unpack(); return bits_; }
+
+	// heap memory used for the chunks and bits, does not change the representation
+	size_t memory_usage() const;
 
 	inline int size() const { return width_; }
 	inline bool empty() const { return width_ == 0; }
@@ -938,9 +1525,8 @@ struct RTLIL::Monitor
 	unsigned int hash() const { return hashidx_; }
 
 	Monitor() {
-		static unsigned int hashidx_count = 123456789;
-		hashidx_count = mkhash_xorshift(hashidx_count);
-		hashidx_ = hashidx_count;
+		static std::atomic<unsigned int> hashidx_count(123456789);
+		hashidx_ = mkhash_xorshift_next(hashidx_count);
 	}
 
 	virtual ~Monitor() { }
@@ -962,6 +1548,9 @@ struct RTLIL::Design
 
 	int refcount_modules_;
 	dict<RTLIL::IdString, RTLIL::Module*> modules_;
+
+	// incremented when modules are added or removed, see touch()
+	unsigned int generation;
 	std::vector<AST::AstNode*> verilog_packages, verilog_globals;
 	dict<std::string, std::pair<std::string, bool>> verilog_defines;
 
@@ -983,6 +1572,9 @@ struct RTLIL::Design
 	void add(RTLIL::Module *module);
 	RTLIL::Module *addModule(RTLIL::IdString name);
 	void remove(RTLIL::Module *module);
+
+	// mark the design and all its modules as changed
+	void touch();
 	void rename(RTLIL::Module *module, RTLIL::IdString new_name);
 
 	void scratchpad_unset(std::string varname);
@@ -1058,6 +1650,27 @@ public:
 	int refcount_wires_;
 	int refcount_cells_;
 
+	// Incremented by the RTLIL API on every change to the wires, cells and
+	// connections of the module. Code that modifies the module behind the
+	// back of the API (e.g. by assigning cell->type or attributes directly)
+	// must call touch(), unless it runs in a pass that is not marked with
+	// Pass::module_changes_tracked (see Pass::call()).
+	unsigned int generation;
+	void touch();
+
+	// SigMap for the module connections that is built on first use and then
+	// kept up to date by the RTLIL API, see sigmap() and kernel/sigtools.h
+	ModuleSigMap *sigmap_;
+
+	// digests returned by content_hash(), valid while generation is unchanged
+	std::string content_hash_[2];
+	unsigned int content_hash_generation_[2];
+
+	// state of the edit transaction, see begin_batch()
+	int batch_depth_;
+	bool batch_fixup_ports_, batch_notify_;
+	pool<RTLIL::Wire*> batch_removed_wires_;
+
 	dict<RTLIL::IdString, RTLIL::Wire*> wires_;
 	dict<RTLIL::IdString, RTLIL::Cell*> cells_;
 	std::vector<RTLIL::SigSig> connections_;
@@ -1087,11 +1700,50 @@ public:
 	std::vector<RTLIL::IdString> ports;
 	void fixup_ports();
 
+	// Edit transactions for passes that make many changes in a row. Between
+	// begin_batch() and end_batch() (which can be nested) fixup_ports() and
+	// the removal of wires are deferred to end_batch(), and monitors are not
+	// notified of the individual changes. Instead they get one
+	// notify_blackout() at end_batch(). Code inside a batch must not rely on
+	// monitors (e.g. sigmap() or a ModIndex) being up to date, and removed
+	// wires stay in the module until end_batch().
+	void begin_batch();
+	void end_batch();
+	bool in_batch() const { return batch_depth_ > 0; }
+
+	// Runs begin_batch() and end_batch() for the lifetime of the object.
+	struct Batch {
+		RTLIL::Module *module;
+		Batch(RTLIL::Module *module) : module(module) { module->begin_batch(); }
+		~Batch() { module->end_batch(); }
+	};
+
+	// Returns true (and records the change for end_batch()) when monitors
+	// must not be notified now.
+	bool batch_defer_notify() {
+		if (batch_depth_ == 0)
+			return false;
+		batch_notify_ = true;
+		return true;
+	}
+
 	template<typename T> void rewrite_sigspecs(T &functor);
 	template<typename T> void rewrite_sigspecs2(T &functor);
 	void cloneInto(RTLIL::Module *new_mod) const;
 	virtual RTLIL::Module *clone() const;
 
+	// The returned reference stays valid for the lifetime of the module and
+	// follows all later connect() calls. Use a copy if the map is modified.
+	const SigMap &sigmap();
+
+	// SHA1 digest (as hex string) of the contents of the module, without the
+	// module name and attributes, see kernel/modhash.cc. With canonical=false
+	// modules have the same digest if they are identical including the names
+	// of all wires and cells. With canonical=true only the names of the ports
+	// are used, so isomorphic modules have the same digest (but modules with
+	// the same digest are not necessarily isomorphic).
+	std::string content_hash(bool canonical = false);
+
 	bool has_memories() const;
 	bool has_processes() const;
 
@@ -1115,6 +1767,11 @@ public:
 	void remove(const pool<RTLIL::Wire*> &wires);
 	void remove(RTLIL::Cell *cell);
 
+	// Moves the cells to the destination module without copying them, and
+	// connects their ports to the wires given by wire_map (which must contain
+	// all wires connected to the cells).
+	void move_cells(RTLIL::Module *dest, const std::vector<RTLIL::Cell*> &cells, const dict<RTLIL::Wire*, RTLIL::Wire*> &wire_map);
+
 	void rename(RTLIL::Wire *wire, RTLIL::IdString new_name);
 	void rename(RTLIL::Cell *cell, RTLIL::IdString new_name);
 	void rename(RTLIL::IdString old_name, RTLIL::IdString new_name);
@@ -1316,6 +1973,10 @@ protected:
 	Wire();
 	~Wire();
 
+	// allocated from a slab pool shared by all modules, see kernel/rtlil.cc
+	static void *operator new(size_t size);
+	static void operator delete(void *ptr, size_t size);
+
 public:
 	// do not simply copy wires
 	Wire(RTLIL::Wire &other) = delete;
@@ -1357,6 +2018,10 @@ protected:
 	Cell();
 	~Cell();
 
+	// allocated from a slab pool shared by all modules, see kernel/rtlil.cc
+	static void *operator new(size_t size);
+	static void operator delete(void *ptr, size_t size);
+
 public:
 	// do not simply copy cells
 	Cell(RTLIL::Cell &other) = delete;
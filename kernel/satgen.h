@@ -57,8 +57,18 @@ struct SatSolver
 	}
 };
 
+// solver statistics of all ezSatPtr instances destroyed so far (defined in
+// kernel/register.cc), passes log the difference of two snapshots
+void add_sat_stats(const ezSAT::SolverStats &stats);
+ezSAT::SolverStats get_sat_stats();
+void log_sat_stats(const ezSAT::SolverStats &stats);
+
 struct ezSatPtr : public std::unique_ptr<ezSAT> {
 	ezSatPtr() : unique_ptr<ezSAT>(yosys_satsolver->create()) { }
+	~ezSatPtr() {
+		if (get() != nullptr)
+			add_sat_stats(get()->solverStats);
+	}
 };
 
 struct SatGen
@@ -1021,7 +1031,7 @@ struct SatGen
 			std::vector<int> y = importDefSigSpec(cell->getPort(ID::Y), timestep);
 
 			std::vector<int> lut;
-			for (auto bit : cell->getParam(ID(LUT)).bits)
+			for (auto bit : cell->getParam(ID(LUT)))
 				lut.push_back(bit == State::S1 ? ez->CONST_TRUE : ez->CONST_FALSE);
 			while (GetSize(lut) < (1 << GetSize(a)))
 				lut.push_back(ez->CONST_FALSE);
@@ -1073,7 +1083,7 @@ struct SatGen
 			int width = cell->getParam(ID(WIDTH)).as_int();
 			int depth = cell->getParam(ID(DEPTH)).as_int();
 
-			vector<State> table_raw = cell->getParam(ID(TABLE)).bits;
+			vector<State> table_raw = cell->getParam(ID(TABLE)).to_bits();
 			while (GetSize(table_raw) < 2*width*depth)
 				table_raw.push_back(State::S0);
 
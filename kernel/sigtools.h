@@ -229,6 +229,342 @@ using sort_by_name_id_guard = typename std::enable_if<std::is_same<T,RTLIL::Cell
 template<typename T>
 class SigSet<T, sort_by_name_id_guard<T>> : public SigSet<T, RTLIL::sort_by_name_id<typename std::remove_pointer<T>::type>> {};
 
+// Assigns dense indices to the bits of the wires of a module, the bits of
+// each wire get a contiguous range. Wires that are not known yet (e.g. added
+// after set()) get a new range when they are first seen. Wires are identified
+// by their hashidx_, so a new wire that reuses the memory of a removed one
+// does not alias its bits.
+struct SigBitIndex
+{
+	dict<int, int> wire_offsets;
+	std::vector<std::pair<int, RTLIL::Wire*>> ranges;
+	unsigned int last_hashidx;
+	int last_offset;
+	int num_bits;
+
+	SigBitIndex()
+	{
+		clear();
+	}
+
+	SigBitIndex(RTLIL::Module *module)
+	{
+		set(module);
+	}
+
+	void clear()
+	{
+		wire_offsets.clear();
+		ranges.clear();
+		last_hashidx = 0;
+		last_offset = -1;
+		num_bits = 0;
+	}
+
+	void set(RTLIL::Module *module)
+	{
+		clear();
+		wire_offsets.reserve(GetSize(module->wires_));
+		for (auto &it : module->wires_)
+			wire_offset(it.second);
+	}
+
+	// the bits of a SigSpec chunk usually belong to the wire of the last lookup
+	int wire_offset(RTLIL::Wire *wire)
+	{
+		if (wire->hashidx_ == last_hashidx && last_offset >= 0)
+			return last_offset;
+
+		auto it = wire_offsets.find(int(wire->hashidx_));
+		if (it == wire_offsets.end()) {
+			it = wire_offsets.insert(std::make_pair(int(wire->hashidx_), num_bits)).first;
+			if (wire->width > 0)
+				ranges.push_back(std::make_pair(num_bits, wire));
+			num_bits += wire->width;
+		}
+
+		last_hashidx = wire->hashidx_;
+		last_offset = it->second;
+		return last_offset;
+	}
+
+	// returns -1 for constant bits
+	int operator()(const RTLIL::SigBit &bit)
+	{
+		if (bit.wire == NULL)
+			return -1;
+		return wire_offset(bit.wire) + bit.offset;
+	}
+
+	RTLIL::SigBit bit(int index) const
+	{
+		auto it = std::upper_bound(ranges.begin(), ranges.end(), index,
+				[](int i, const std::pair<int, RTLIL::Wire*> &range) { return i < range.first; });
+		log_assert(it != ranges.begin());
+		--it;
+		return RTLIL::SigBit(it->second, index - it->first);
+	}
+
+	// calls f(index) for each non-constant bit of sig
+	template<typename F>
+	void foreach_bit(const RTLIL::SigSpec &sig, F f)
+	{
+		for (auto &chunk : sig.chunks())
+			if (chunk.wire != NULL) {
+				int offset = wire_offset(chunk.wire) + chunk.offset;
+				for (int i = 0; i < chunk.width; i++)
+					f(offset + i);
+			}
+	}
+
+	// calls f(index) until it returns true, returns true if it did
+	template<typename F>
+	bool find_bit(const RTLIL::SigSpec &sig, F f)
+	{
+		for (auto &chunk : sig.chunks())
+			if (chunk.wire != NULL) {
+				int offset = wire_offset(chunk.wire) + chunk.offset;
+				for (int i = 0; i < chunk.width; i++)
+					if (f(offset + i))
+						return true;
+			}
+		return false;
+	}
+};
+
+// SigPool on the bit indices of a SigBitIndex. All pools that are combined
+// with add() or del() must use the same index.
+struct IndexedSigPool
+{
+	SigBitIndex *index;
+	std::vector<bool> bits;
+	int count;
+
+	IndexedSigPool(SigBitIndex &index) : index(&index), count(0) { }
+
+	void clear()
+	{
+		bits.clear();
+		count = 0;
+	}
+
+	bool get(int i) const
+	{
+		return i >= 0 && i < GetSize(bits) && bits[i];
+	}
+
+	void set(int i, bool value)
+	{
+		if (i >= GetSize(bits)) {
+			if (!value)
+				return;
+			bits.resize(std::max(i+1, index->num_bits));
+		}
+		if (bits[i] != value) {
+			bits[i] = value;
+			count += value ? 1 : -1;
+		}
+	}
+
+	void add(const RTLIL::SigSpec &sig)
+	{
+		index->foreach_bit(sig, [&](int i) { set(i, true); });
+	}
+
+	void add(const IndexedSigPool &other)
+	{
+		log_assert(index == other.index);
+		for (int i = 0; i < GetSize(other.bits); i++)
+			if (other.bits[i])
+				set(i, true);
+	}
+
+	void del(const RTLIL::SigSpec &sig)
+	{
+		index->foreach_bit(sig, [&](int i) { set(i, false); });
+	}
+
+	void del(const IndexedSigPool &other)
+	{
+		log_assert(index == other.index);
+		for (int i = 0; i < GetSize(other.bits); i++)
+			if (other.bits[i])
+				set(i, false);
+	}
+
+	void expand(const RTLIL::SigSpec &from, const RTLIL::SigSpec &to)
+	{
+		log_assert(GetSize(from) == GetSize(to));
+		for (int i = 0; i < GetSize(from); i++) {
+			int bit_from = (*index)(from[i]), bit_to = (*index)(to[i]);
+			if (bit_from >= 0 && bit_to >= 0 && get(bit_from))
+				set(bit_to, true);
+		}
+	}
+
+	RTLIL::SigSpec extract(const RTLIL::SigSpec &sig)
+	{
+		RTLIL::SigSpec result;
+		for (auto &bit : sig)
+			if (check(bit))
+				result.append_bit(bit);
+		return result;
+	}
+
+	RTLIL::SigSpec remove(const RTLIL::SigSpec &sig)
+	{
+		RTLIL::SigSpec result;
+		for (auto &bit : sig)
+			if (bit.wire != NULL && !check(bit))
+				result.append(bit);
+		return result;
+	}
+
+	bool check(const RTLIL::SigBit &bit)
+	{
+		return bit.wire != NULL && get((*index)(bit));
+	}
+
+	bool check_any(const RTLIL::SigSpec &sig)
+	{
+		return index->find_bit(sig, [&](int i) { return get(i); });
+	}
+
+	bool check_all(const RTLIL::SigSpec &sig)
+	{
+		return !index->find_bit(sig, [&](int i) { return !get(i); });
+	}
+
+	RTLIL::SigSpec export_one()
+	{
+		for (int i = 0; i < GetSize(bits); i++)
+			if (bits[i])
+				return index->bit(i);
+		return RTLIL::SigSpec();
+	}
+
+	RTLIL::SigSpec export_all()
+	{
+		RTLIL::SigSpec sig;
+		for (int i = 0; i < GetSize(bits); i++)
+			if (bits[i])
+				sig.append_bit(index->bit(i));
+		return sig;
+	}
+
+	size_t size() const
+	{
+		return count;
+	}
+};
+
+// SigSet on the bit indices of a SigBitIndex. The values of each bit are kept
+// in a small unsorted vector, so this is meant for sets with few values per bit.
+template <typename T, class Compare = std::less<T>>
+struct IndexedSigSet
+{
+	SigBitIndex *index;
+	std::vector<std::vector<T>> bits;
+
+	IndexedSigSet(SigBitIndex &index) : index(&index) { }
+
+	void clear()
+	{
+		bits.clear();
+	}
+
+	std::vector<T> &entry(int i)
+	{
+		if (i >= GetSize(bits))
+			bits.resize(std::max(i+1, index->num_bits));
+		return bits[i];
+	}
+
+	void insert_value(int i, const T &data)
+	{
+		std::vector<T> &values = entry(i);
+		if (std::find(values.begin(), values.end(), data) == values.end())
+			values.push_back(data);
+	}
+
+	void erase_value(int i, const T &data)
+	{
+		if (i >= GetSize(bits))
+			return;
+		std::vector<T> &values = bits[i];
+		auto it = std::find(values.begin(), values.end(), data);
+		if (it != values.end()) {
+			*it = values.back();
+			values.pop_back();
+		}
+	}
+
+	void insert(const RTLIL::SigSpec &sig, const T &data)
+	{
+		index->foreach_bit(sig, [&](int i) { insert_value(i, data); });
+	}
+
+	template<class C>
+	void insert(const RTLIL::SigSpec &sig, const std::set<T, C> &data)
+	{
+		index->foreach_bit(sig, [&](int i) {
+			for (auto &value : data)
+				insert_value(i, value);
+		});
+	}
+
+	void erase(const RTLIL::SigSpec &sig)
+	{
+		index->foreach_bit(sig, [&](int i) {
+			if (i < GetSize(bits))
+				bits[i].clear();
+		});
+	}
+
+	void erase(const RTLIL::SigSpec &sig, const T &data)
+	{
+		index->foreach_bit(sig, [&](int i) { erase_value(i, data); });
+	}
+
+	template<class C>
+	void erase(const RTLIL::SigSpec &sig, const std::set<T, C> &data)
+	{
+		index->foreach_bit(sig, [&](int i) {
+			for (auto &value : data)
+				erase_value(i, value);
+		});
+	}
+
+	template<class C>
+	void find(const RTLIL::SigSpec &sig, std::set<T, C> &result)
+	{
+		index->foreach_bit(sig, [&](int i) {
+			if (i < GetSize(bits))
+				result.insert(bits[i].begin(), bits[i].end());
+		});
+	}
+
+	void find(const RTLIL::SigSpec &sig, pool<T> &result)
+	{
+		index->foreach_bit(sig, [&](int i) {
+			if (i < GetSize(bits))
+				result.insert(bits[i].begin(), bits[i].end());
+		});
+	}
+
+	std::set<T, Compare> find(const RTLIL::SigSpec &sig)
+	{
+		std::set<T, Compare> result;
+		find(sig, result);
+		return result;
+	}
+
+	bool has(const RTLIL::SigSpec &sig)
+	{
+		return index->find_bit(sig, [&](int i) { return i < GetSize(bits) && !bits[i].empty(); });
+	}
+};
+
 struct SigMap
 {
 	mfp<SigBit> database;
@@ -336,6 +672,69 @@ struct SigMap
 	}
 };
 
+// The SigMap returned by RTLIL::Module::sigmap(). It is built on first use and
+// then updated through the monitor interface whenever a connection is added,
+// so that passes running one after another on an unchanged module do not each
+// build their own SigMap from scratch. Anything that can remove connections
+// (new_connections(), removing wires, or Module::touch(), which Pass::call()
+// uses after passes that do not track their changes) invalidates the map,
+// and it is rebuilt on the next use.
+struct ModuleSigMap : RTLIL::Monitor
+{
+	RTLIL::Module *module;
+	SigMap sigmap;
+	bool valid;
+
+	ModuleSigMap(RTLIL::Module *module) : module(module), valid(false)
+	{
+		module->monitors.insert(this);
+	}
+
+	~ModuleSigMap()
+	{
+		module->monitors.erase(this);
+	}
+
+	const SigMap &get()
+	{
+		if (!valid) {
+			sigmap.set(module);
+			valid = true;
+		}
+		return sigmap;
+	}
+
+	void invalidate()
+	{
+		if (valid) {
+			sigmap.clear();
+			valid = false;
+		}
+	}
+
+	void notify_connect(RTLIL::Module *mod YS_ATTRIBUTE(unused), const RTLIL::SigSig &sigsig) YS_OVERRIDE
+	{
+		log_assert(module == mod);
+
+		// Module::connect() drops assignments to constants and notifies
+		// again with the remaining bits
+		if (valid && !sigsig.first.has_const())
+			sigmap.add(sigsig.first, sigsig.second);
+	}
+
+	void notify_connect(RTLIL::Module *mod YS_ATTRIBUTE(unused), const std::vector<RTLIL::SigSig>&) YS_OVERRIDE
+	{
+		log_assert(module == mod);
+		invalidate();
+	}
+
+	void notify_blackout(RTLIL::Module *mod YS_ATTRIBUTE(unused)) YS_OVERRIDE
+	{
+		log_assert(module == mod);
+		invalidate();
+	}
+};
+
 YOSYS_NAMESPACE_END
 
 #endif /* SIGTOOLS_H */
@@ -0,0 +1,529 @@
+/* -*- c++ -*-
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "kernel/threadpool.h"
+
+#ifdef YOSYS_ENABLE_THREADS
+#  include <deque>
+#  include <mutex>
+#  include <condition_variable>
+#  include <thread>
+#  include <chrono>
+#endif
+
+YOSYS_NAMESPACE_BEGIN
+
+#ifdef YOSYS_ENABLE_THREADS
+
+struct TaskGroup::State
+{
+	struct task_t {
+		std::function<void()> func;
+		LogCapture capture;
+		std::exception_ptr error;
+		bool done = false;
+	};
+
+	// tasks, next_task, num_jobs and done flags are guarded by the mutex,
+	// a deque keeps the references to the tasks valid while more are added
+	std::mutex mutex;
+	std::deque<task_t> tasks;
+	int next_task = 0;
+	int num_jobs = 0, max_jobs = 0;
+
+	std::atomic<int> first_error;
+	std::atomic<bool> cancelled;
+
+	// only used by the thread that owns the TaskGroup
+	int num_waited = 0, num_replayed = 0;
+	bool concurrent_ids = false;
+
+	State() : first_error(INT_MAX), cancelled(false) { }
+
+	bool skip(int index) const {
+		return cancelled || index > first_error;
+	}
+};
+
+namespace {
+
+// A job in a worker queue runs tasks of its group until there are no more
+// tasks to hand out. A group has at most max_jobs jobs in the queues at any
+// time, which limits the number of its tasks that run at once.
+typedef std::shared_ptr<TaskGroup::State> job_t;
+
+struct WorkerQueue
+{
+	std::mutex mutex;
+	std::deque<job_t> jobs;
+};
+
+// The pool is never destroyed, the workers may still be waiting for jobs when
+// the process exits without yosys_shutdown() (e.g. from log_error()).
+struct ThreadPool
+{
+	// queues[0] is shared by all threads that are not pool workers
+	static const int max_queues = 256;
+	WorkerQueue *queues[max_queues];
+	std::atomic<int> num_queues;
+
+	std::mutex mutex;
+	std::vector<std::thread> workers;
+
+	// epoch counts all events a thread may be waiting for (new jobs and
+	// completed tasks), sleeping threads check it under sleep_mutex
+	std::mutex sleep_mutex;
+	std::condition_variable sleep_cond;
+	unsigned int epoch = 0;
+	bool stop = false;
+
+	ThreadPool() : num_queues(0) { }
+};
+
+ThreadPool &thread_pool = *new ThreadPool;
+
+thread_local int current_queue = 0;
+thread_local TaskGroup::State *current_group = nullptr;
+thread_local int current_task = -1;
+
+// seed set by threadpool_shuffle(), and a counter for varying the delays
+std::atomic<unsigned int> shuffle_seed(0), shuffle_counter(0);
+
+unsigned int shuffle_next(unsigned int seed)
+{
+	return mkhash_xorshift(mkhash(seed, shuffle_counter++));
+}
+
+// groups created outside of tasks that have unfinished tasks, the IdString
+// concurrent mode is on while there are any
+int outer_groups_active = 0;
+
+unsigned int pool_notify()
+{
+	unsigned int epoch;
+	{
+		std::lock_guard<std::mutex> lock(thread_pool.sleep_mutex);
+		epoch = ++thread_pool.epoch;
+	}
+	thread_pool.sleep_cond.notify_all();
+	return epoch;
+}
+
+unsigned int pool_current_epoch()
+{
+	std::lock_guard<std::mutex> lock(thread_pool.sleep_mutex);
+	return thread_pool.epoch;
+}
+
+void pool_sleep(unsigned int epoch)
+{
+	std::unique_lock<std::mutex> lock(thread_pool.sleep_mutex);
+	thread_pool.sleep_cond.wait(lock, [&]() { return thread_pool.epoch != epoch || thread_pool.stop; });
+}
+
+void push_job(const job_t &job)
+{
+	WorkerQueue *queue = thread_pool.queues[current_queue];
+	{
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		queue->jobs.push_back(job);
+	}
+	pool_notify();
+}
+
+// the newest job from our own queue, or the oldest job of another queue
+bool pop_job(job_t &job)
+{
+	int count = thread_pool.num_queues.load();
+	unsigned int seed = shuffle_seed;
+	int first = seed ? shuffle_next(seed) % count : current_queue;
+	for (int k = 0; k < count; k++) {
+		int index = (first + k) % count;
+		WorkerQueue *queue = thread_pool.queues[index];
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		if (queue->jobs.empty())
+			continue;
+		if (index == current_queue) {
+			job = std::move(queue->jobs.back());
+			queue->jobs.pop_back();
+		} else {
+			job = std::move(queue->jobs.front());
+			queue->jobs.pop_front();
+		}
+		return true;
+	}
+	return false;
+}
+
+void run_task(TaskGroup::State &state, int index)
+{
+	TaskGroup::State::task_t *task;
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		task = &state.tasks[index];
+	}
+
+	unsigned int seed = shuffle_seed;
+	if (seed != 0)
+		std::this_thread::sleep_for(std::chrono::microseconds(shuffle_next(seed) % 200));
+
+	if (!state.skip(index))
+	{
+		TaskGroup::State *outer_group = current_group;
+		int outer_task = current_task;
+		current_group = &state;
+		current_task = index;
+
+		// the thread may be waiting in another task, whose NewIdScope must
+		// not get the names created by this one
+		NewIdScope::Guard new_id_guard(nullptr);
+
+		log_capture_begin(&task->capture);
+		try {
+			task->func();
+		} catch (...) {
+			task->error = std::current_exception();
+			int first_error = state.first_error;
+			while (index < first_error && !state.first_error.compare_exchange_weak(first_error, index)) { }
+		}
+		log_capture_end();
+
+		current_group = outer_group;
+		current_task = outer_task;
+	}
+
+	task->func = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		task->done = true;
+	}
+	pool_notify();
+}
+
+// hands out the next task of the group, or returns -1
+int next_task(TaskGroup::State &state)
+{
+	std::lock_guard<std::mutex> lock(state.mutex);
+	if (state.next_task >= GetSize(state.tasks))
+		return -1;
+	return state.next_task++;
+}
+
+void run_job(const job_t &job)
+{
+	while (1) {
+		int index;
+		{
+			std::lock_guard<std::mutex> lock(job->mutex);
+			if (job->next_task >= GetSize(job->tasks)) {
+				job->num_jobs--;
+				return;
+			}
+			index = job->next_task++;
+		}
+		run_task(*job, index);
+	}
+}
+
+void worker_main(int queue)
+{
+	current_queue = queue;
+	while (1) {
+		unsigned int epoch = pool_current_epoch();
+		{
+			std::lock_guard<std::mutex> lock(thread_pool.sleep_mutex);
+			if (thread_pool.stop)
+				break;
+		}
+		job_t job;
+		if (pop_job(job))
+			run_job(job);
+		else
+			pool_sleep(epoch);
+	}
+}
+
+void pool_grow(int num_workers)
+{
+	std::lock_guard<std::mutex> lock(thread_pool.mutex);
+	num_workers = std::min(num_workers, ThreadPool::max_queues - 1);
+
+	if (thread_pool.num_queues == 0) {
+		thread_pool.queues[0] = new WorkerQueue;
+		thread_pool.num_queues = 1;
+	}
+
+	while (GetSize(thread_pool.workers) < num_workers) {
+		int queue = thread_pool.num_queues;
+		thread_pool.queues[queue] = new WorkerQueue;
+		thread_pool.num_queues = queue + 1;
+		thread_pool.workers.emplace_back(worker_main, queue);
+	}
+}
+
+// runs tasks and jobs on the calling thread until done() returns true
+template<typename F>
+void help_until(TaskGroup::State &state, F done)
+{
+	while (1) {
+		unsigned int epoch = pool_current_epoch();
+		if (done())
+			break;
+		int index = next_task(state);
+		if (index >= 0) {
+			run_task(state, index);
+			continue;
+		}
+		job_t job;
+		if (pop_job(job)) {
+			run_job(job);
+			continue;
+		}
+		pool_sleep(epoch);
+	}
+}
+
+bool tasks_done(TaskGroup::State &state, int begin, int end)
+{
+	std::lock_guard<std::mutex> lock(state.mutex);
+	while (begin < end && state.tasks[begin].done)
+		begin++;
+	return begin >= end;
+}
+
+void finish_group(TaskGroup::State &state)
+{
+	if (state.concurrent_ids && state.num_waited == GetSize(state.tasks)) {
+		state.concurrent_ids = false;
+		if (--outer_groups_active == 0)
+			IdString::set_concurrent(false);
+	}
+}
+
+}
+
+TaskGroup::TaskGroup(int num_threads)
+{
+	if (num_threads <= 0)
+		num_threads = yosys_threads;
+	if (num_threads <= 1)
+		return;
+
+	pool_grow(num_threads - 1);
+	state = std::make_shared<State>();
+	state->max_jobs = num_threads - 1;
+}
+
+TaskGroup::~TaskGroup()
+{
+	// the tasks may reference variables of the caller, so they must be done
+	// even when an exception is unwinding the stack
+	cancel();
+	join();
+}
+
+int TaskGroup::run(std::function<void()> task)
+{
+	if (state == nullptr) {
+		task();
+		return num_tasks++;
+	}
+
+	// the mode is left alone if the caller has enabled it for a longer stretch
+	if (!state->concurrent_ids && !task_active() && (outer_groups_active > 0 || !IdString::global_concurrent_mode_)) {
+		if (outer_groups_active++ == 0)
+			IdString::set_concurrent(true);
+		state->concurrent_ids = true;
+	}
+
+	bool new_job = false;
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+		state->tasks.emplace_back();
+		state->tasks.back().func = std::move(task);
+		if (state->num_jobs < state->max_jobs) {
+			state->num_jobs++;
+			new_job = true;
+		}
+	}
+
+	if (new_job)
+		push_job(state);
+	return num_tasks++;
+}
+
+void TaskGroup::wait(int index)
+{
+	if (state == nullptr)
+		return;
+
+	State &s = *state;
+	int end = (index < 0 || index >= num_tasks) ? num_tasks : index+1;
+	if (end <= s.num_replayed)
+		return;
+
+	// after an error all tasks must have stopped before the error is replayed
+	help_until(s, [&]() {
+		if (s.first_error < end)
+			return tasks_done(s, s.num_waited, num_tasks);
+		return tasks_done(s, s.num_waited, end);
+	});
+	s.num_waited = std::max(s.num_waited, s.first_error < end ? num_tasks : end);
+	finish_group(s);
+
+	// tasks are handed out in order, so every task before the first failed
+	// one has been completed and the output matches a serial run
+	while (s.num_replayed < end) {
+		State::task_t *task;
+		{
+			std::lock_guard<std::mutex> lock(s.mutex);
+			task = &s.tasks[s.num_replayed++];
+		}
+		task->capture.replay();
+		if (task->error) {
+			try {
+				std::rethrow_exception(task->error);
+			} catch (log_capture_error_exception&) {
+				log_abort();
+			}
+		}
+	}
+}
+
+void TaskGroup::join()
+{
+	if (state == nullptr)
+		return;
+
+	help_until(*state, [&]() { return tasks_done(*state, state->num_waited, num_tasks); });
+	state->num_waited = num_tasks;
+	finish_group(*state);
+}
+
+void TaskGroup::cancel()
+{
+	if (state != nullptr)
+		state->cancelled = true;
+}
+
+int TaskGroup::size() const
+{
+	return num_tasks;
+}
+
+bool task_active()
+{
+	return current_group != nullptr;
+}
+
+bool task_cancelled()
+{
+	return current_group != nullptr && current_group->skip(current_task);
+}
+
+void threadpool_shuffle(unsigned int seed)
+{
+	shuffle_seed = seed;
+}
+
+void threadpool_shutdown()
+{
+	std::lock_guard<std::mutex> lock(thread_pool.mutex);
+	{
+		std::lock_guard<std::mutex> sleep_lock(thread_pool.sleep_mutex);
+		thread_pool.stop = true;
+	}
+	thread_pool.sleep_cond.notify_all();
+
+	for (auto &t : thread_pool.workers)
+		t.join();
+	thread_pool.workers.clear();
+
+	for (int i = 0; i < thread_pool.num_queues; i++)
+		delete thread_pool.queues[i];
+	thread_pool.num_queues = 0;
+
+	std::lock_guard<std::mutex> sleep_lock(thread_pool.sleep_mutex);
+	thread_pool.stop = false;
+}
+
+#else
+
+struct TaskGroup::State { };
+
+TaskGroup::TaskGroup(int) { }
+TaskGroup::~TaskGroup() { }
+
+int TaskGroup::run(std::function<void()> task)
+{
+	task();
+	return num_tasks++;
+}
+
+void TaskGroup::wait(int) { }
+void TaskGroup::join() { }
+void TaskGroup::cancel() { }
+
+int TaskGroup::size() const
+{
+	return num_tasks;
+}
+
+bool task_active()
+{
+	return false;
+}
+
+bool task_cancelled()
+{
+	return false;
+}
+
+void threadpool_shuffle(unsigned int) { }
+void threadpool_shutdown() { }
+
+#endif
+
+void parallel_for(int n, const std::function<void(int)> &body, int num_threads)
+{
+	if (num_threads <= 0)
+		num_threads = yosys_threads;
+
+	TaskGroup group(std::max(std::min(num_threads, n), 1));
+	for (int i = 0; i < n; i++)
+		group.run([&body, i]() { body(i); });
+	group.wait();
+}
+
+void for_each_ordered(int n, int num_threads, const std::function<void(int)> &work, const std::function<void(int)> &finish)
+{
+	if (num_threads <= 0)
+		num_threads = yosys_threads;
+
+	TaskGroup group(std::max(std::min(num_threads, n), 1));
+	for (int i = 0; i < n; i++)
+		group.run([&work, i]() { work(i); });
+	for (int i = 0; i < n; i++) {
+		group.wait(i);
+		finish(i);
+	}
+}
+
+YOSYS_NAMESPACE_END
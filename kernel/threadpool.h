@@ -0,0 +1,121 @@
+/* -*- c++ -*-
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include "kernel/yosys.h"
+#include <functional>
+#include <memory>
+
+YOSYS_NAMESPACE_BEGIN
+
+// Shared task scheduler for code that runs on worker threads.
+//
+// Tasks are added to a TaskGroup and run by a process-wide pool of worker
+// threads, which is started on first use and grows to the largest number of
+// threads requested so far (yosys_threads by default, see 'yosys -j' and the
+// YOSYS_THREADS environment variable). Every worker has its own job queue,
+// idle workers steal jobs from the others. The thread that waits for a group
+// runs tasks as well, and tasks may create and wait for groups of their own:
+// waiting threads keep running queued tasks instead of blocking.
+//
+// The log output of each task is recorded in a LogCapture and replayed by
+// wait() in the order the tasks were added, so the output is the same as in a
+// serial run. When a task fails with log_error() (or any other exception), the
+// tasks added after it are cancelled, the tasks before it still complete, and
+// wait() replays their output and then the error.
+//
+// IdString::set_concurrent() is enabled while a group has unfinished tasks.
+// Code that runs many short groups in a row may enable it around all of them
+// instead, leaving the concurrent mode only costs a scan of all ids.
+//
+// With a single thread (or without YOSYS_ENABLE_THREADS) run() calls the task
+// right away on the calling thread.
+//
+// Only the thread that created a group adds tasks to it and waits for it.
+// Groups outside of tasks are created by the main thread.
+
+struct TaskGroup
+{
+	struct State;
+
+	// at most num_threads tasks of this group run at the same time,
+	// 0 stands for yosys_threads
+	explicit TaskGroup(int num_threads = 0);
+
+	// cancels the tasks that have not been started yet and waits for the
+	// others without replaying their output, for unwinding after an error
+	~TaskGroup();
+
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup &operator=(const TaskGroup&) = delete;
+
+	// adds a task and returns its index in the group
+	int run(std::function<void()> task);
+
+	// waits for the tasks up to index (all tasks for index < 0) and replays
+	// their log output, tasks after index keep running
+	void wait(int index = -1);
+
+	// waits for all tasks without replaying their output, for code that must
+	// not run concurrently with the tasks but replays the output with wait()
+	// later
+	void join();
+
+	// skips all tasks that have not been started yet
+	void cancel();
+
+	int size() const;
+
+	// false if run() calls the tasks right away
+	bool concurrent() const { return state != nullptr; }
+
+private:
+	std::shared_ptr<State> state;
+	int num_tasks = 0;
+};
+
+// true while this thread runs a task of a TaskGroup
+bool task_active();
+
+// true when the task running on this thread has been cancelled, because an
+// earlier task failed or the group was cancelled; long running tasks may poll
+// this and return early
+bool task_cancelled();
+
+// calls body(0) ... body(n-1) as tasks of one group and waits for them
+void parallel_for(int n, const std::function<void(int)> &body, int num_threads = 0);
+
+// calls work(i) for every index as tasks of one group, and finish(i) on the
+// calling thread in index order, each as soon as the tasks up to work(i) are
+// done (e.g. for writing the output of the tasks while later ones still run)
+void for_each_ordered(int n, int num_threads, const std::function<void(int)> &work, const std::function<void(int)> &finish);
+
+// With a non-zero seed every task is delayed by a pseudo-random amount and idle
+// threads steal jobs in a pseudo-random order, to shake out dependencies on the
+// order in which tasks complete (see 'check_determinism'). 0 turns it off.
+void threadpool_shuffle(unsigned int seed);
+
+// stops the worker threads, called from yosys_shutdown()
+void threadpool_shutdown();
+
+YOSYS_NAMESPACE_END
+
+#endif
@@ -0,0 +1,267 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef TRUTHTABLE_H
+#define TRUTHTABLE_H
+
+#include "kernel/yosys.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// The truth table of a boolean function of num_vars inputs, stored as 64-bit
+// words. Bit i of the table is the value for the input assignment i (input 0
+// is the LSB of i), as in the LUT parameter of $lut cells. Functions of less
+// than 6 inputs use the low bits of a single word, the other bits are zero.
+//
+// All operations work on whole words, which is fast for the LUT sizes of FPGA
+// architectures and fine for up to about 16 inputs.
+struct TruthTable
+{
+	int num_vars = 0;
+	std::vector<uint64_t> words;
+
+	static uint64_t var_mask(int var)
+	{
+		static const uint64_t masks[6] = {
+			0xaaaaaaaaaaaaaaaaull, 0xccccccccccccccccull, 0xf0f0f0f0f0f0f0f0ull,
+			0xff00ff00ff00ff00ull, 0xffff0000ffff0000ull, 0xffffffff00000000ull
+		};
+		return masks[var];
+	}
+
+	uint64_t word_mask() const {
+		return num_vars >= 6 ? ~uint64_t(0) : (uint64_t(1) << (1 << num_vars)) - 1;
+	}
+
+	int size() const {
+		return 1 << num_vars;
+	}
+
+	explicit TruthTable(int num_vars = 0, bool value = false) : num_vars(num_vars),
+			words(num_vars > 6 ? 1 << (num_vars - 6) : 1, value ? ~uint64_t(0) : 0)
+	{
+		words.back() &= word_mask();
+	}
+
+	// missing bits of the table are 0, bits other than 1 are 0 as well
+	TruthTable(const RTLIL::Const &table, int num_vars) : TruthTable(num_vars)
+	{
+		int n = std::min(GetSize(table), size());
+		for (int i = 0; i < n; i++)
+			if (table[i] == RTLIL::State::S1)
+				words[i >> 6] |= uint64_t(1) << (i & 63);
+	}
+
+	static TruthTable var(int num_vars, int var)
+	{
+		TruthTable tt(num_vars);
+		if (var < 6) {
+			for (auto &w : tt.words)
+				w = var_mask(var);
+			tt.words.back() &= tt.word_mask();
+		} else {
+			int stride = 1 << (var - 6);
+			for (int i = 0; i < GetSize(tt.words); i++)
+				if (i & stride)
+					tt.words[i] = ~uint64_t(0);
+		}
+		return tt;
+	}
+
+	RTLIL::Const as_const() const
+	{
+		RTLIL::Const table(RTLIL::State::S0, size());
+		for (int i = 0; i < size(); i++)
+			if (get(i))
+				table.set(i, RTLIL::State::S1);
+		return table;
+	}
+
+	bool get(int index) const {
+		return (words[index >> 6] >> (index & 63)) & 1;
+	}
+
+	void set(int index, bool value)
+	{
+		uint64_t bit = uint64_t(1) << (index & 63);
+		if (value)
+			words[index >> 6] |= bit;
+		else
+			words[index >> 6] &= ~bit;
+	}
+
+	bool is_const(bool value) const
+	{
+		uint64_t expected = value ? ~uint64_t(0) : 0;
+		for (int i = 0; i+1 < GetSize(words); i++)
+			if (words[i] != expected)
+				return false;
+		return words.back() == (expected & word_mask());
+	}
+
+	bool operator==(const TruthTable &other) const {
+		return num_vars == other.num_vars && words == other.words;
+	}
+
+	bool operator!=(const TruthTable &other) const {
+		return !(*this == other);
+	}
+
+	TruthTable operator~() const
+	{
+		TruthTable tt = *this;
+		for (auto &w : tt.words)
+			w = ~w;
+		tt.words.back() &= word_mask();
+		return tt;
+	}
+
+	TruthTable &operator&=(const TruthTable &other)
+	{
+		log_assert(num_vars == other.num_vars);
+		for (int i = 0; i < GetSize(words); i++)
+			words[i] &= other.words[i];
+		return *this;
+	}
+
+	TruthTable &operator|=(const TruthTable &other)
+	{
+		log_assert(num_vars == other.num_vars);
+		for (int i = 0; i < GetSize(words); i++)
+			words[i] |= other.words[i];
+		return *this;
+	}
+
+	TruthTable &operator^=(const TruthTable &other)
+	{
+		log_assert(num_vars == other.num_vars);
+		for (int i = 0; i < GetSize(words); i++)
+			words[i] ^= other.words[i];
+		return *this;
+	}
+
+	TruthTable operator&(const TruthTable &other) const { TruthTable tt = *this; return tt &= other; }
+	TruthTable operator|(const TruthTable &other) const { TruthTable tt = *this; return tt |= other; }
+	TruthTable operator^(const TruthTable &other) const { TruthTable tt = *this; return tt ^= other; }
+
+	// (sel ? hi : lo) for each input assignment
+	static TruthTable mux(const TruthTable &sel, const TruthTable &lo, const TruthTable &hi)
+	{
+		log_assert(sel.num_vars == lo.num_vars && sel.num_vars == hi.num_vars);
+		TruthTable tt(sel.num_vars);
+		for (int i = 0; i < GetSize(tt.words); i++)
+			tt.words[i] = (lo.words[i] & ~sel.words[i]) | (hi.words[i] & sel.words[i]);
+		return tt;
+	}
+
+	bool depends_on(int var) const
+	{
+		if (var < 6) {
+			int shift = 1 << var;
+			for (auto w : words)
+				if (((w >> shift) ^ w) & ~var_mask(var) & word_mask())
+					return true;
+			return false;
+		}
+		int stride = 1 << (var - 6);
+		for (int i = 0; i < GetSize(words); i++)
+			if ((i & stride) && words[i] != words[i ^ stride])
+				return true;
+		return false;
+	}
+
+	// The function with the input fixed to the value, the inputs above it
+	// move down by one.
+	TruthTable cofactor(int var, bool value) const
+	{
+		log_assert(0 <= var && var < num_vars);
+		TruthTable tt(num_vars - 1);
+
+		if (var >= 6) {
+			int stride = 1 << (var - 6), k = 0;
+			for (int i = 0; i < GetSize(words); i++)
+				if (bool(i & stride) == value)
+					tt.words[k++] = words[i];
+			return tt;
+		}
+
+		// each word gives 32 bits of the result
+		int block = 1 << var;
+		uint64_t block_mask = (uint64_t(1) << block) - 1;
+		for (int i = 0; i < GetSize(words); i++) {
+			uint64_t w = value ? words[i] >> block : words[i];
+			uint64_t r = 0;
+			for (int pos = 0, out = 0; pos < 64; pos += 2*block, out += block)
+				r |= ((w >> pos) & block_mask) << out;
+			tt.words[i >> 1] |= r << (32 * (i & 1));
+		}
+		tt.words.back() &= tt.word_mask();
+		return tt;
+	}
+
+	// The function of the inputs of the given functions, which all have the
+	// same number of inputs: f(inputs[0](x), inputs[1](x), ...). Used to
+	// rewire, permute or merge LUTs.
+	TruthTable compose(const std::vector<TruthTable> &inputs) const
+	{
+		log_assert(GetSize(inputs) == num_vars);
+		int n = inputs.empty() ? 0 : inputs.front().num_vars;
+		for (auto &input : inputs)
+			log_assert(input.num_vars == n);
+		return compose_block(inputs, n, num_vars, 0);
+	}
+
+private:
+	// constant value of the part of the table of the given size at offset,
+	// or -1 if it is not constant
+	int block_value(int offset, int block_size) const
+	{
+		if (block_size >= 64) {
+			uint64_t first = words[offset >> 6];
+			if (first != 0 && first != ~uint64_t(0))
+				return -1;
+			for (int i = 1; i < block_size >> 6; i++)
+				if (words[(offset >> 6) + i] != first)
+					return -1;
+			return first != 0;
+		}
+		uint64_t mask = (uint64_t(1) << block_size) - 1;
+		uint64_t bits = (words[offset >> 6] >> (offset & 63)) & mask;
+		if (bits == 0)
+			return 0;
+		if (bits == mask)
+			return 1;
+		return -1;
+	}
+
+	// Shannon expansion of the sub-function of the inputs below var
+	TruthTable compose_block(const std::vector<TruthTable> &inputs, int n, int var, int offset) const
+	{
+		int value = block_value(offset, 1 << var);
+		if (value >= 0)
+			return TruthTable(n, value != 0);
+		TruthTable lo = compose_block(inputs, n, var-1, offset);
+		TruthTable hi = compose_block(inputs, n, var-1, offset + (1 << (var-1)));
+		return mux(inputs[var-1], lo, hi);
+	}
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
@@ -128,67 +128,61 @@ public:
 // A simple class for topological sorting
 // ------------------------------------------------
 
+// The graph is stored as arrays of node indices and sorted with an iterative
+// depth-first search, so that large graphs neither need a tree node per edge
+// nor deep recursion. The resulting order is the post-order of a search that
+// visits the nodes and the predecessors of each node in the order given by C.
+// With analyze_loops set, the strongly connected components of the graph
+// (Tarjan's algorithm) are reported as loops.
+
 template<typename T, typename C = std::less<T>>
 struct TopoSort
 {
 	bool analyze_loops, found_loops;
-	std::map<T, std::set<T, C>, C> database;
 	std::set<std::set<T, C>> loops;
 	std::vector<T> sorted;
 
+	// nodes in the order they were added, and edges as (left, right) node indices
+	std::vector<T> nodes;
+	dict<T, int> node_to_index;
+	std::vector<std::pair<int, int>> edges;
+
+	// set up by sort(): node indices ordered by C, the position of each node in
+	// that order, and for each position the predecessor positions
+	// pred_list[pred_offsets[i] .. pred_offsets[i+1]-1]
+	std::vector<int> node_order, node_pos, pred_offsets, pred_list;
+
 	TopoSort()
 	{
 		analyze_loops = true;
 		found_loops = false;
 	}
 
-	void node(T n)
+	int node(T n)
 	{
-		if (database.count(n) == 0)
-			database[n] = std::set<T, C>();
+		auto it = node_to_index.find(n);
+		if (it != node_to_index.end())
+			return it->second;
+		int idx = GetSize(nodes);
+		node_to_index[n] = idx;
+		nodes.push_back(n);
+		return idx;
 	}
 
 	void edge(T left, T right)
 	{
-		node(left);
-		database[right].insert(left);
+		int left_idx = node(left);
+		edges.push_back(std::make_pair(left_idx, node(right)));
 	}
 
-	void sort_worker(const T &n, std::set<T, C> &marked_cells, std::set<T, C> &active_cells, std::vector<T> &active_stack)
+	// the left sides of all edges to the given node, valid after sort()
+	std::vector<T> get_predecessors(const T &n) const
 	{
-		if (active_cells.count(n)) {
-			found_loops = true;
-			if (analyze_loops) {
-				std::set<T, C> loop;
-				for (int i = GetSize(active_stack)-1; i >= 0; i--) {
-					loop.insert(active_stack[i]);
-					if (active_stack[i] == n)
-						break;
-				}
-				loops.insert(loop);
-			}
-			return;
-		}
-
-		if (marked_cells.count(n))
-			return;
-
-		if (!database.at(n).empty())
-		{
-			if (analyze_loops)
-				active_stack.push_back(n);
-			active_cells.insert(n);
-
-			for (auto &left_n : database.at(n))
-				sort_worker(left_n, marked_cells, active_cells, active_stack);
-
-			if (analyze_loops)
-				active_stack.pop_back();
-			active_cells.erase(n);
-		}
-
-		marked_cells.insert(n);
-		sorted.push_back(n);
+		std::vector<T> result;
+		int pos = node_pos[node_to_index.at(n)];
+		for (int i = pred_offsets[pos]; i < pred_offsets[pos+1]; i++)
+			result.push_back(nodes[node_order[pred_list[i]]]);
+		return result;
 	}
 
 	bool sort()
@@ -197,14 +191,122 @@ struct TopoSort
 		sorted.clear();
 		found_loops = false;
 
-		std::set<T, C> marked_cells;
-		std::set<T, C> active_cells;
-		std::vector<T> active_stack;
+		int num_nodes = GetSize(nodes);
+		C comp;
+
+		node_order.resize(num_nodes);
+		for (int i = 0; i < num_nodes; i++)
+			node_order[i] = i;
+		std::sort(node_order.begin(), node_order.end(), [&](int a, int b) { return comp(nodes[a], nodes[b]); });
+
+		node_pos.resize(num_nodes);
+		for (int i = 0; i < num_nodes; i++)
+			node_pos[node_order[i]] = i;
+
+		// predecessor lists in CSR form, sorted and without duplicate edges
+		pred_offsets.assign(num_nodes+1, 0);
+		for (auto &e : edges)
+			pred_offsets[node_pos[e.second]+1]++;
+		for (int i = 0; i < num_nodes; i++)
+			pred_offsets[i+1] += pred_offsets[i];
+
+		pred_list.resize(GetSize(edges));
+		std::vector<int> fill_pos(pred_offsets.begin(), pred_offsets.end()-1);
+		for (auto &e : edges)
+			pred_list[fill_pos[node_pos[e.second]]++] = node_pos[e.first];
+
+		int num_preds = 0;
+		for (int i = 0; i < num_nodes; i++) {
+			auto begin = pred_list.begin() + pred_offsets[i], end = pred_list.begin() + pred_offsets[i+1];
+			std::sort(begin, end);
+			end = std::unique(begin, end);
+			pred_offsets[i] = num_preds;
+			for (auto it = begin; it != end; it++)
+				pred_list[num_preds++] = *it;
+		}
+		pred_offsets[num_nodes] = num_preds;
+		pred_list.resize(num_preds);
+
+		// 0 = not visited, 1 = on the search stack, 2 = done
+		std::vector<char> state(num_nodes);
+		std::vector<std::pair<int, int>> stack;
+
+		// Tarjan's algorithm, only used when analyze_loops is set
+		std::vector<int> tarjan_index, tarjan_lowlink, scc_stack;
+		std::vector<bool> on_scc_stack;
+		int tarjan_counter = 0;
+		if (analyze_loops) {
+			tarjan_index.resize(num_nodes);
+			tarjan_lowlink.resize(num_nodes);
+			on_scc_stack.resize(num_nodes);
+		}
+
+		auto visit = [&](int n) {
+			state[n] = 1;
+			stack.push_back(std::make_pair(n, pred_offsets[n]));
+			if (analyze_loops) {
+				tarjan_index[n] = tarjan_lowlink[n] = tarjan_counter++;
+				scc_stack.push_back(n);
+				on_scc_stack[n] = true;
+			}
+		};
+
+		sorted.reserve(num_nodes);
+		for (int root = 0; root < num_nodes; root++)
+		{
+			if (state[root] != 0)
+				continue;
+
+			visit(root);
+			while (!stack.empty())
+			{
+				int n = stack.back().first;
+				int &edge_pos = stack.back().second;
+
+				if (edge_pos < pred_offsets[n+1]) {
+					int left_n = pred_list[edge_pos++];
+					if (state[left_n] == 0) {
+						visit(left_n);
+					} else {
+						if (state[left_n] == 1)
+							found_loops = true;
+						if (analyze_loops && on_scc_stack[left_n])
+							tarjan_lowlink[n] = std::min(tarjan_lowlink[n], tarjan_index[left_n]);
+					}
+					continue;
+				}
 
-		for (auto &it : database)
-			sort_worker(it.first, marked_cells, active_cells, active_stack);
+				stack.pop_back();
+				state[n] = 2;
+				sorted.push_back(nodes[node_order[n]]);
+
+				if (!analyze_loops)
+					continue;
+
+				if (!stack.empty()) {
+					int parent = stack.back().first;
+					tarjan_lowlink[parent] = std::min(tarjan_lowlink[parent], tarjan_lowlink[n]);
+				}
+
+				if (tarjan_lowlink[n] == tarjan_index[n])
+				{
+					std::set<T, C> loop;
+					while (true) {
+						int scc_n = scc_stack.back();
+						scc_stack.pop_back();
+						on_scc_stack[scc_n] = false;
+						loop.insert(nodes[node_order[scc_n]]);
+						if (scc_n == n)
+							break;
+					}
+					bool self_loop = std::binary_search(pred_list.begin() + pred_offsets[n], pred_list.begin() + pred_offsets[n+1], n);
+					if (GetSize(loop) > 1 || self_loop)
+						loops.insert(loop);
+				}
+			}
+		}
 
-		log_assert(GetSize(sorted) == GetSize(database));
+		log_assert(GetSize(sorted) == num_nodes);
 		return !found_loops;
 	}
 };
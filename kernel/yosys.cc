@@ -19,6 +19,7 @@
 
 #include "kernel/yosys.h"
 #include "kernel/celltypes.h"
+#include "kernel/threadpool.h"
 
 #ifdef YOSYS_ENABLE_READLINE
 #  include <readline/readline.h>
@@ -49,6 +50,11 @@
 #  include <sys/stat.h>
 #endif
 
+#ifndef _WIN32
+#  include <sys/mman.h>
+#  include <fcntl.h>
+#endif
+
 #if !defined(_WIN32) && defined(YOSYS_ENABLE_GLOB)
 #  include <glob.h>
 #endif
@@ -69,11 +75,13 @@
 
 #include <limits.h>
 #include <errno.h>
+#include <new>
 
 YOSYS_NAMESPACE_BEGIN
 
-int autoidx = 1;
+std::atomic<int> autoidx(1);
 int yosys_xtrace = 0;
+int yosys_threads = 1;
 RTLIL::Design *yosys_design = NULL;
 CellTypes yosys_celltypes;
 
@@ -122,6 +130,19 @@ void memhasher_do()
 	memhasher_store[index] = realloc(memhasher_store[index], size);
 }
 
+bool alloc_counter_active = false;
+std::atomic<int64_t> alloc_counter(0);
+
+void alloc_counter_on()
+{
+	alloc_counter_active = true;
+}
+
+int64_t alloc_counter_get()
+{
+	return alloc_counter.load(std::memory_order_relaxed);
+}
+
 void yosys_banner()
 {
 	log("\n");
@@ -365,6 +386,20 @@ int run_command(const std::string &command, std::function<void(const std::string
 #endif
 }
 
+ToolExecutor *yosys_tool_executor = nullptr;
+
+std::string tool_command(const std::string &command, const std::string &workdir)
+{
+	if (yosys_tool_executor == nullptr)
+		return command;
+	return yosys_tool_executor->command(command, workdir);
+}
+
+int run_tool_command(const std::string &command, const std::string &workdir, std::function<void(const std::string&)> process_line)
+{
+	return run_command(tool_command(command, workdir), process_line);
+}
+
 std::string make_temp_file(std::string template_str)
 {
 #ifdef _WIN32
@@ -451,6 +486,58 @@ bool check_file_exists(std::string filename, bool is_exec)
 }
 #endif
 
+bool MappedFile::open(const std::string &filename)
+{
+	close();
+
+#ifndef _WIN32
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+		::close(fd);
+		return false;
+	}
+
+	if (st.st_size > 0) {
+		void *ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (ptr != MAP_FAILED) {
+			::close(fd);
+			mapping = ptr;
+			data = (const char*)ptr;
+			size = st.st_size;
+			return true;
+		}
+	}
+	::close(fd);
+#endif
+
+	std::ifstream f(filename.c_str(), std::ifstream::binary);
+	if (f.fail())
+		return false;
+
+	std::stringstream ss;
+	ss << f.rdbuf();
+	buffer = ss.str();
+	data = buffer.data();
+	size = buffer.size();
+	return true;
+}
+
+void MappedFile::close()
+{
+#ifndef _WIN32
+	if (mapping != nullptr)
+		munmap(mapping, size);
+#endif
+	mapping = nullptr;
+	buffer.clear();
+	data = nullptr;
+	size = 0;
+}
+
 bool is_absolute_path(std::string filename)
 {
 #ifdef _WIN32
@@ -544,11 +631,13 @@ void yosys_shutdown()
 	already_shutdown = true;
 	log_pop();
 
+	threadpool_shutdown();
 	Pass::done_register();
 
 	delete yosys_design;
 	yosys_design = NULL;
 
+	log_async_stop();
 	for (auto f : log_files)
 		if (f != stderr)
 			fclose(f);
@@ -566,6 +655,8 @@ void yosys_shutdown()
 #endif
 
 #ifdef YOSYS_ENABLE_PLUGINS
+	// lazy ids point to the file and function names in the plugins
+	RTLIL::IdString::materialize_all();
 	for (auto &it : loaded_plugins)
 		dlclose(it.second);
 
@@ -595,9 +686,120 @@ RTLIL::IdString new_id(std::string file, int line, std::string func)
 	if (pos != std::string::npos)
 		func = func.substr(pos+1);
 
+	NewIdScope *scope = NewIdScope::current();
+	if (scope != nullptr)
+		return scope->new_name(stringf("$auto$%s:%d:%s$", file.c_str(), line, func.c_str()), scope->module);
+
 	return stringf("$auto$%s:%d:%s$%d", file.c_str(), line, func.c_str(), autoidx++);
 }
 
+// NEW_ID: the name is only formatted and interned when it is used
+RTLIL::IdString new_id(const char *file, int line, const char *func)
+{
+	if (RTLIL::IdString::global_concurrent_mode_ || yosys_xtrace || NewIdScope::current() != nullptr)
+		return new_id(std::string(file), line, std::string(func));
+	return RTLIL::IdString::new_lazy(file, line, func, autoidx++);
+}
+
+static thread_local NewIdScope *new_id_scope = nullptr;
+
+NewIdScope *NewIdScope::current()
+{
+	return new_id_scope;
+}
+
+NewIdScope::Guard::Guard(NewIdScope *scope) : outer(new_id_scope)
+{
+	new_id_scope = scope;
+}
+
+NewIdScope::Guard::~Guard()
+{
+	new_id_scope = outer;
+}
+
+// the provisional names end in "$+<n>", which NEW_ID never gives otherwise
+RTLIL::IdString NewIdScope::new_name(const std::string &stem, RTLIL::Module *module)
+{
+	RTLIL::IdString name = stringf("%s+%d", stem.c_str(), GetSize(names));
+	names.push_back({name, stem, module});
+	return name;
+}
+
+// only strings with the length of a provisional name are decoded
+static void rename_new_id_strings(dict<RTLIL::IdString, RTLIL::Const> &values,
+		const dict<std::string, RTLIL::IdString> &renames, const pool<int> &sizes)
+{
+	for (auto &it : values) {
+		if ((it.second.flags & RTLIL::CONST_FLAG_STRING) == 0 || sizes.count(it.second.size()) == 0)
+			continue;
+		auto rename = renames.find(it.second.decode_string());
+		if (rename != renames.end())
+			it.second = RTLIL::Const(rename->second.str());
+	}
+}
+
+void NewIdScope::commit()
+{
+	NewIdScope *outer = current();
+
+	dict<RTLIL::Module*, std::vector<std::pair<RTLIL::IdString, RTLIL::IdString>>> module_renames;
+	for (auto &it : names) {
+		RTLIL::IdString final_name = outer ? outer->new_name(it.stem, it.module) : RTLIL::IdString(stringf("%s%d", it.stem.c_str(), autoidx++));
+		module_renames[it.module].push_back({it.name, final_name});
+	}
+
+	for (auto &it : module_renames)
+	{
+		RTLIL::Module *module = it.first;
+		dict<std::string, RTLIL::IdString> string_renames;
+		pool<int> string_sizes;
+
+		for (auto &rename : it.second)
+		{
+			RTLIL::Wire *wire = module->wire(rename.first);
+			RTLIL::Cell *cell = module->cell(rename.first);
+			if (wire != nullptr)
+				module->rename(wire, rename.second);
+			if (cell != nullptr)
+				module->rename(cell, rename.second);
+
+			auto mem_it = module->memories.find(rename.first);
+			if (mem_it != module->memories.end()) {
+				RTLIL::Memory *memory = mem_it->second;
+				module->memories.erase(mem_it);
+				memory->name = rename.second;
+				module->memories[memory->name] = memory;
+			}
+
+			auto proc_it = module->processes.find(rename.first);
+			if (proc_it != module->processes.end()) {
+				RTLIL::Process *process = proc_it->second;
+				module->processes.erase(proc_it);
+				process->name = rename.second;
+				module->processes[process->name] = process;
+			}
+
+			string_renames[rename.first.str()] = rename.second;
+			string_sizes.insert(8 * GetSize(rename.first.str()));
+		}
+
+		rename_new_id_strings(module->attributes, string_renames, string_sizes);
+		for (auto wire : module->wires())
+			rename_new_id_strings(wire->attributes, string_renames, string_sizes);
+		for (auto cell : module->cells()) {
+			rename_new_id_strings(cell->parameters, string_renames, string_sizes);
+			rename_new_id_strings(cell->attributes, string_renames, string_sizes);
+		}
+		for (auto &mem : module->memories)
+			rename_new_id_strings(mem.second->attributes, string_renames, string_sizes);
+		for (auto &proc : module->processes)
+			rename_new_id_strings(proc.second->attributes, string_renames, string_sizes);
+	}
+
+	names.clear();
+}
+
 RTLIL::Design *yosys_get_design()
 {
 	return yosys_design;
@@ -898,6 +1100,8 @@ void run_frontend(std::string filename, std::string command, std::string *backen
 		std::string filename_trim = filename;
 		if (filename_trim.size() > 3 && filename_trim.compare(filename_trim.size()-3, std::string::npos, ".gz") == 0)
 			filename_trim.erase(filename_trim.size()-3);
+		else if (filename_trim.size() > 4 && filename_trim.compare(filename_trim.size()-4, std::string::npos, ".zst") == 0)
+			filename_trim.erase(filename_trim.size()-4);
 		if (filename_trim.size() > 2 && filename_trim.compare(filename_trim.size()-2, std::string::npos, ".v") == 0)
 			command = "verilog";
 		else if (filename_trim.size() > 2 && filename_trim.compare(filename_trim.size()-3, std::string::npos, ".sv") == 0)
@@ -1154,6 +1358,9 @@ void shell(RTLIL::Design *design)
 	rl_basic_word_break_characters = (char*)" \t\n";
 #endif
 
+	// the prompt is written directly to the console
+	log_flush();
+
 	char *command = NULL;
 #if defined(YOSYS_ENABLE_READLINE) || defined(YOSYS_ENABLE_EDITLINE)
 	while ((command = readline(create_prompt(design, recursion_counter))) != NULL)
@@ -1190,6 +1397,7 @@ void shell(RTLIL::Design *design)
 			log_reset_stack();
 		}
 		design->check();
+		log_flush();
 	}
 	if (command == NULL)
 		printf("exit\n");
@@ -1328,3 +1536,22 @@ struct ScriptCmdPass : public Pass {
 } ScriptCmdPass;
 
 YOSYS_NAMESPACE_END
+
+// Replaces the global operator new so that allocations can be counted for the
+// pass profile ("yosys -B"). Without profiling this is just a call to malloc().
+void *operator new(std::size_t size)
+{
+	if (Yosys::alloc_counter_active)
+		Yosys::alloc_counter.fetch_add(1, std::memory_order_relaxed);
+	if (size == 0)
+		size = 1;
+	while (1) {
+		void *p = malloc(size);
+		if (p != nullptr)
+			return p;
+		std::new_handler handler = std::get_new_handler();
+		if (handler == nullptr)
+			throw std::bad_alloc();
+		handler();
+	}
+}
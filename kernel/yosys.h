@@ -49,17 +49,29 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <initializer_list>
+#include <type_traits>
+#include <iterator>
 #include <stdexcept>
 #include <memory>
+#include <atomic>
 #include <cmath>
 #include <cstddef>
 
+#if (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)) && !defined(HASHLIB_NO_SIMD)
+#  include <emmintrin.h>
+#endif
+
 #include <sstream>
 #include <fstream>
 #include <istream>
 #include <ostream>
 #include <iostream>
 
+#ifdef YOSYS_ENABLE_THREADS
+#include <mutex>
+#include <thread>
+#endif
+
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
@@ -191,6 +203,7 @@ using hashlib::mkhash;
 using hashlib::mkhash_init;
 using hashlib::mkhash_add;
 using hashlib::mkhash_xorshift;
+using hashlib::mkhash_xorshift_next;
 using hashlib::hash_ops;
 using hashlib::hash_cstr_ops;
 using hashlib::hash_ptr_ops;
@@ -199,6 +212,10 @@ using hashlib::dict;
 using hashlib::idict;
 using hashlib::pool;
 using hashlib::mfp;
+using hashlib::flat_dict;
+using hashlib::flat_pool;
+using hashlib::frozen_dict;
+using hashlib::frozen_pool;
 
 namespace RTLIL {
 	struct IdString;
@@ -249,6 +266,10 @@ void memhasher_do();
 extern bool memhasher_active;
 inline void memhasher() { if (memhasher_active) memhasher_do(); }
 
+// number of calls of the global operator new since alloc_counter_on()
+void alloc_counter_on();
+int64_t alloc_counter_get();
+
 void yosys_banner();
 int ceil_log2(int x) YS_ATTRIBUTE(const);
 std::string stringf(const char *fmt, ...) YS_ATTRIBUTE(format(printf, 1, 2));
@@ -258,6 +279,22 @@ std::string next_token(std::string &text, const char *sep = " \t\r\n", bool long
 std::vector<std::string> split_tokens(const std::string &text, const char *sep = " \t\r\n");
 bool patmatch(const char *pattern, const char *string);
 int run_command(const std::string &command, std::function<void(const std::string&)> process_line = std::function<void(const std::string&)>());
+
+// Decides how an external tool (ABC, a bugpoint child, ...) is started. The
+// inputs and outputs of the tool are in workdir. The default runs the command
+// on the local host, an executor can wrap it e.g. to submit it to a job queue
+// and copy the workdir to and from the node running it.
+struct ToolExecutor
+{
+	virtual ~ToolExecutor() { }
+	virtual std::string command(const std::string &command, const std::string &workdir) = 0;
+};
+
+// nullptr for the local host, set by the 'executor' command or by plugins
+extern ToolExecutor *yosys_tool_executor;
+
+std::string tool_command(const std::string &command, const std::string &workdir);
+int run_tool_command(const std::string &command, const std::string &workdir, std::function<void(const std::string&)> process_line = std::function<void(const std::string&)>());
 std::string make_temp_file(std::string template_str = "/tmp/yosys_XXXXXX");
 std::string make_temp_dir(std::string template_str = "/tmp/yosys_XXXXXX");
 bool check_file_exists(std::string filename, bool is_exec = false);
@@ -265,11 +302,39 @@ bool is_absolute_path(std::string filename);
 void remove_directory(std::string dirname);
 std::string escape_filename_spaces(const std::string& filename);
 
+// Read-only view of the contents of a file. The file is mapped into memory
+// where mmap() is available and read into a buffer otherwise.
+struct MappedFile
+{
+	const char *data = nullptr;
+	size_t size = 0;
+
+	MappedFile() { }
+	~MappedFile() { close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile &operator=(const MappedFile&) = delete;
+
+	// returns false if the file can't be opened or is not a regular file
+	bool open(const std::string &filename);
+	void close();
+
+	// gzip or zstd files are read through the decompressing streams of Frontend::extra_args()
+	bool is_compressed() const {
+		return (size >= 2 && (unsigned char)data[0] == 0x1f && (unsigned char)data[1] == 0x8b) ||
+				(size >= 4 && memcmp(data, "\x28\xb5\x2f\xfd", 4) == 0);
+	}
+
+private:
+	void *mapping = nullptr;
+	std::string buffer;
+};
+
 template<typename T> int GetSize(const T &obj) { return obj.size(); }
 int GetSize(RTLIL::Wire *wire);
 
-extern int autoidx;
+extern std::atomic<int> autoidx;
 extern int yosys_xtrace;
+extern int yosys_threads;
 
 YOSYS_NAMESPACE_END
 
@@ -302,10 +367,47 @@ Tcl_Interp *yosys_get_tcl_interp();
 extern RTLIL::Design *yosys_design;
 
 RTLIL::IdString new_id(std::string file, int line, std::string func);
+RTLIL::IdString new_id(const char *file, int line, const char *func);
 
 #define NEW_ID \
 	YOSYS_NAMESPACE_PREFIX new_id(__FILE__, __LINE__, __FUNCTION__)
 
+// While a scope is active on a thread, NEW_ID on that thread gives provisional
+// names numbered from zero within the scope instead of taking numbers from the
+// global autoidx. Each name is recorded with the module of the scope. commit()
+// gives the final names, numbered from autoidx (or from the enclosing scope)
+// in creation order, and renames the wires, cells, memories and processes with
+// these names in their modules, as well as string parameters and attributes
+// (e.g. MEMID) that hold them. Scopes that are committed in a fixed order thus
+// give the same names as running their code one after the other, no matter
+// how the threads were scheduled (see ModulePass::execute_modules()). Tasks
+// that run concurrently start without a scope.
+struct NewIdScope
+{
+	struct Name {
+		RTLIL::IdString name;
+		std::string stem;
+		RTLIL::Module *module;
+	};
+
+	RTLIL::Module *module;
+	std::vector<Name> names;
+
+	NewIdScope(RTLIL::Module *module) : module(module) { }
+
+	RTLIL::IdString new_name(const std::string &stem, RTLIL::Module *module);
+	void commit();
+
+	static NewIdScope *current();
+
+	// activates the scope (or no scope) on this thread until destroyed
+	struct Guard {
+		NewIdScope *outer;
+		Guard(NewIdScope *scope);
+		~Guard();
+	};
+};
+
 // Create a statically allocated IdString object, using for example ID(A) or ID($add).
 //
 // Recipe for Converting old code that is using conversion of strings like "\\A" and
@@ -324,6 +426,7 @@ std::string proc_share_dirname();
 const char *create_prompt(RTLIL::Design *design, int recursion_counter);
 std::vector<std::string> glob_filename(const std::string &filename_pattern);
 void rewrite_filename(std::string &filename);
+bool fgetline(FILE *f, std::string &buffer);
 
 void run_pass(std::string command, RTLIL::Design *design = nullptr);
 void run_frontend(std::string filename, std::string command, std::string *backend_command, std::string *from_to_label = nullptr, RTLIL::Design *design = nullptr);
@@ -43,6 +43,9 @@ ezMiniSAT::ezMiniSAT() : minisatSolver(NULL)
 {
 	minisatSolver = NULL;
 	foundContradiction = false;
+#if EZMINISAT_SIMPSOLVER && EZMINISAT_INCREMENTAL
+	cnfClausesAtLastSimp = 0;
+#endif
 
 	freeze(CONST_TRUE);
 	freeze(CONST_FALSE);
@@ -54,14 +57,39 @@ ezMiniSAT::~ezMiniSAT()
 		delete minisatSolver;
 }
 
-void ezMiniSAT::clear()
+void ezMiniSAT::updateStats()
+{
+	SolverStats counters;
+	counters.conflicts = minisatSolver->conflicts;
+	counters.decisions = minisatSolver->decisions;
+	counters.propagations = minisatSolver->propagations;
+	counters.restarts = minisatSolver->starts;
+#if EZMINISAT_SIMPSOLVER
+	counters.eliminatedVars = minisatSolver->eliminated_vars;
+#endif
+	solverStats += counters;
+	solverStats -= minisatCounted;
+	minisatCounted = counters;
+}
+
+void ezMiniSAT::deleteSolver()
 {
 	if (minisatSolver != NULL) {
+		updateStats();
 		delete minisatSolver;
 		minisatSolver = NULL;
 	}
-	foundContradiction = false;
+	minisatCounted = SolverStats();
 	minisatVars.clear();
+#if EZMINISAT_SIMPSOLVER && EZMINISAT_INCREMENTAL
+	cnfClausesAtLastSimp = 0;
+#endif
+}
+
+void ezMiniSAT::clear()
+{
+	deleteSolver();
+	foundContradiction = false;
 #if EZMINISAT_SIMPSOLVER && EZMINISAT_INCREMENTAL
 	cnfFrozenVars.clear();
 #endif
@@ -106,9 +134,7 @@ bool ezMiniSAT::solver(const std::vector<int> &modelExpressions, std::vector<boo
 
 	if (0) {
 contradiction:
-		delete minisatSolver;
-		minisatSolver = NULL;
-		minisatVars.clear();
+		deleteSolver();
 		foundContradiction = true;
 		return false;
 	}
@@ -118,6 +144,8 @@ contradiction:
 		return false;
 	}
 
+	solverStats.calls++;
+
 	std::vector<int> extraClauses, modelIdx;
 
 	for (auto id : assumptions)
@@ -146,8 +174,9 @@ contradiction:
 	cnfFrozenVars.clear();
 #endif
 
+	Minisat::vec<Minisat::Lit> ps;
 	for (auto &clause : cnf) {
-		Minisat::vec<Minisat::Lit> ps;
+		ps.clear();
 		for (auto idx : clause) {
 			if (idx > 0)
 				ps.push(Minisat::mkLit(minisatVars.at(idx-1)));
@@ -200,7 +229,17 @@ contradiction:
 	}
 #endif
 
+#if EZMINISAT_SIMPSOLVER && EZMINISAT_INCREMENTAL
+	bool doSimp = numCnfClauses() >= 2*cnfClausesAtLastSimp;
+	if (doSimp) {
+		cnfClausesAtLastSimp = numCnfClauses();
+		solverStats.simplifications++;
+	}
+	bool foundSolution = minisatSolver->solve(assumps, doSimp);
+#else
 	bool foundSolution = minisatSolver->solve(assumps);
+#endif
+	updateStats();
 
 #ifndef _WIN32
 	if (solverTimeout > 0) {
@@ -214,9 +253,7 @@ contradiction:
 
 	if (!foundSolution) {
 #if !EZMINISAT_INCREMENTAL
-		delete minisatSolver;
-		minisatSolver = NULL;
-		minisatVars.clear();
+		deleteSolver();
 #endif
 		return false;
 	}
@@ -238,9 +275,7 @@ contradiction:
 	}
 
 #if !EZMINISAT_INCREMENTAL
-	delete minisatSolver;
-	minisatSolver = NULL;
-	minisatVars.clear();
+	deleteSolver();
 #endif
 	return true;
 }
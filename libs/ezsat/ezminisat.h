@@ -49,8 +49,21 @@ private:
 
 #if EZMINISAT_SIMPSOLVER && EZMINISAT_INCREMENTAL
 	std::set<int> cnfFrozenVars;
+
+	// Variable elimination removes variables that are not frozen, and an
+	// expression that uses an eliminated variable is encoded again with new
+	// variables when it is bound later. Incremental users (e.g. freduce) bind
+	// a few new expressions before every call, so eliminating on every call
+	// keeps re-encoding the same cones. Variables are only eliminated again
+	// when the CNF has doubled since the last elimination.
+	int cnfClausesAtLastSimp;
 #endif
 
+	// the counters of minisatSolver that are already in solverStats
+	SolverStats minisatCounted;
+	void updateStats();
+	void deleteSolver();
+
 #ifndef _WIN32
 	static ezMiniSAT *alarmHandlerThis;
 	static clock_t alarmHandlerTimeout;
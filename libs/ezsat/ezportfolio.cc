@@ -0,0 +1,335 @@
+/*
+ *  ezSAT -- A simple and easy to use CNF generator for SAT solvers
+ *
+ *  Copyright (C) 2013  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+// needed for MiniSAT headers (see Minisat Makefile)
+#ifndef __STDC_FORMAT_MACROS
+#define __STDC_FORMAT_MACROS
+#endif
+#ifndef __STDC_LIMIT_MACROS
+#define __STDC_LIMIT_MACROS
+#endif
+
+#include "ezportfolio.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <csignal>
+#include <cinttypes>
+#include <atomic>
+#include <thread>
+
+#ifndef _WIN32
+#  include <unistd.h>
+#endif
+
+#include "../minisat/Solver.h"
+#include "../minisat/SimpSolver.h"
+
+ezPortfolioSAT::ezPortfolioSAT(int numSolvers) : numSolvers(numSolvers < 1 ? 1 : numSolvers)
+{
+	foundContradiction = false;
+	cnfClausesAtLastSimp = 0;
+
+	freeze(CONST_TRUE);
+	freeze(CONST_FALSE);
+}
+
+ezPortfolioSAT::~ezPortfolioSAT()
+{
+	deleteSolvers();
+}
+
+void ezPortfolioSAT::createSolvers()
+{
+	for (int i = 0; i < numSolvers; i++)
+	{
+		Solver *s = new Solver;
+		s->verbosity = 0;
+
+		// instance 0 uses the MiniSAT defaults, the others vary the
+		// search heuristics and the random seed
+		if (i > 0) {
+			s->random_seed = 91648253 + 7919 * i;
+			s->rnd_init_act = true;
+			switch (i % 4) {
+			case 1:
+				s->luby_restart = false;
+				s->var_decay = 0.85;
+				break;
+			case 2:
+				s->phase_saving = 0;
+				s->ccmin_mode = 1;
+				break;
+			case 3:
+				s->random_var_freq = 0.05;
+				s->var_decay = 0.99;
+				break;
+			default:
+				s->rnd_pol = true;
+				s->random_var_freq = 0.02;
+				break;
+			}
+		}
+
+		minisatSolvers.push_back(s);
+	}
+
+	minisatCounted.assign(numSolvers, SolverStats());
+}
+
+void ezPortfolioSAT::deleteSolvers()
+{
+	if (!minisatSolvers.empty())
+		updateStats();
+	for (auto s : minisatSolvers)
+		delete s;
+	minisatSolvers.clear();
+	minisatCounted.clear();
+	minisatVars.clear();
+	cnfClausesAtLastSimp = 0;
+}
+
+// the counters are summed over all instances, including the work of the
+// instances that were interrupted
+void ezPortfolioSAT::updateStats()
+{
+	for (int i = 0; i < int(minisatSolvers.size()); i++) {
+		Solver *s = minisatSolvers[i];
+		SolverStats counters;
+		counters.conflicts = s->conflicts;
+		counters.decisions = s->decisions;
+		counters.propagations = s->propagations;
+		counters.restarts = s->starts;
+		counters.eliminatedVars = s->eliminated_vars;
+		solverStats += counters;
+		solverStats -= minisatCounted[i];
+		minisatCounted[i] = counters;
+	}
+}
+
+void ezPortfolioSAT::clear()
+{
+	deleteSolvers();
+	foundContradiction = false;
+	cnfFrozenVars.clear();
+	ezSAT::clear();
+}
+
+void ezPortfolioSAT::freeze(int id)
+{
+	if (!mode_non_incremental())
+		cnfFrozenVars.insert(bind(id));
+}
+
+bool ezPortfolioSAT::eliminated(int idx)
+{
+	// the instances do not necessarily eliminate the same variables
+	idx = idx < 0 ? -idx : idx;
+	if (idx > 0 && idx <= int(minisatVars.size()))
+		for (auto s : minisatSolvers)
+			if (s->isEliminated(minisatVars.at(idx-1)))
+				return true;
+	return false;
+}
+
+#ifndef _WIN32
+ezPortfolioSAT *ezPortfolioSAT::alarmHandlerThis = NULL;
+clock_t ezPortfolioSAT::alarmHandlerTimeout = 0;
+
+void ezPortfolioSAT::alarmHandler(int)
+{
+	if (clock() > alarmHandlerTimeout) {
+		for (auto s : alarmHandlerThis->minisatSolvers)
+			s->interrupt();
+		alarmHandlerTimeout = 0;
+	} else
+		alarm(1);
+}
+#endif
+
+bool ezPortfolioSAT::solver(const std::vector<int> &modelExpressions, std::vector<bool> &modelValues, const std::vector<int> &assumptions)
+{
+	preSolverCallback();
+
+	solverTimoutStatus = false;
+
+	if (0) {
+contradiction:
+		deleteSolvers();
+		foundContradiction = true;
+		return false;
+	}
+
+	if (foundContradiction) {
+		consumeCnf();
+		return false;
+	}
+
+	solverStats.calls++;
+
+	std::vector<int> extraClauses, modelIdx;
+
+	for (auto id : assumptions)
+		extraClauses.push_back(bind(id));
+	for (auto id : modelExpressions)
+		modelIdx.push_back(bind(id));
+
+	if (minisatSolvers.empty())
+		createSolvers();
+
+	std::vector<std::vector<int>> cnf;
+	consumeCnf(cnf);
+
+	while (int(minisatVars.size()) < numCnfVariables()) {
+		int var = minisatSolvers.front()->newVar();
+		for (size_t i = 1; i < minisatSolvers.size(); i++) {
+			int v = minisatSolvers[i]->newVar();
+			if (v != var) {
+				fprintf(stderr, "Assert in %s:%d failed! Solver instances are out of sync.\n", __FILE__, __LINE__);
+				abort();
+			}
+		}
+		minisatVars.push_back(var);
+	}
+
+	for (auto idx : cnfFrozenVars)
+		for (auto s : minisatSolvers)
+			s->setFrozen(minisatVars.at(idx > 0 ? idx-1 : -idx-1), true);
+	cnfFrozenVars.clear();
+
+	for (auto &clause : cnf) {
+		Minisat::vec<Minisat::Lit> ps;
+		for (auto idx : clause) {
+			if (idx > 0)
+				ps.push(Minisat::mkLit(minisatVars.at(idx-1)));
+			else
+				ps.push(Minisat::mkLit(minisatVars.at(-idx-1), true));
+			if (eliminated(idx)) {
+				fprintf(stderr, "Assert in %s:%d failed! Missing call to ezsat->freeze(): %s (lit=%d)\n",
+						__FILE__, __LINE__, cnfLiteralInfo(idx).c_str(), idx);
+				abort();
+			}
+		}
+		for (auto s : minisatSolvers) {
+			Minisat::vec<Minisat::Lit> ps_copy;
+			ps.copyTo(ps_copy);
+			if (!s->addClause(ps_copy))
+				goto contradiction;
+		}
+	}
+
+	if (cnf.size() > 0)
+		for (auto s : minisatSolvers)
+			if (!s->simplify())
+				goto contradiction;
+
+	Minisat::vec<Minisat::Lit> assumps;
+
+	for (auto idx : extraClauses) {
+		if (idx > 0)
+			assumps.push(Minisat::mkLit(minisatVars.at(idx-1)));
+		else
+			assumps.push(Minisat::mkLit(minisatVars.at(-idx-1), true));
+		if (eliminated(idx)) {
+			fprintf(stderr, "Assert in %s:%d failed! Missing call to ezsat->freeze(): %s\n", __FILE__, __LINE__, cnfLiteralInfo(idx).c_str());
+			abort();
+		}
+	}
+
+#ifndef _WIN32
+	struct sigaction sig_action;
+	struct sigaction old_sig_action;
+	int old_alarm_timeout = 0;
+
+	if (solverTimeout > 0) {
+		sig_action.sa_handler = alarmHandler;
+		sigemptyset(&sig_action.sa_mask);
+		sig_action.sa_flags = SA_RESTART;
+		alarmHandlerThis = this;
+		alarmHandlerTimeout = clock() + solverTimeout*CLOCKS_PER_SEC;
+		old_alarm_timeout = alarm(0);
+		sigaction(SIGALRM, &sig_action, &old_sig_action);
+		alarm(1);
+	}
+#endif
+
+	bool doSimp = numCnfClauses() >= 2*cnfClausesAtLastSimp;
+	if (doSimp) {
+		cnfClausesAtLastSimp = numCnfClauses();
+		solverStats.simplifications++;
+	}
+
+	// the first instance with a definite answer interrupts all others
+	std::atomic<int> winner(-1);
+	std::vector<Minisat::lbool> results(minisatSolvers.size());
+
+	auto run_solver = [&](int i) {
+		using namespace Minisat;
+		results[i] = minisatSolvers[i]->solveLimited(assumps, doSimp);
+		int expected = -1;
+		if (results[i] != l_Undef && winner.compare_exchange_strong(expected, i))
+			for (int k = 0; k < int(minisatSolvers.size()); k++)
+				if (k != i)
+					minisatSolvers[k]->interrupt();
+	};
+
+	std::vector<std::thread> threads;
+	for (int i = 1; i < int(minisatSolvers.size()); i++)
+		threads.emplace_back(run_solver, i);
+	run_solver(0);
+	for (auto &t : threads)
+		t.join();
+
+#ifndef _WIN32
+	if (solverTimeout > 0) {
+		if (alarmHandlerTimeout == 0)
+			solverTimoutStatus = true;
+		alarm(0);
+		sigaction(SIGALRM, &old_sig_action, NULL);
+		alarm(old_alarm_timeout);
+	}
+#endif
+
+	for (auto s : minisatSolvers)
+		s->clearInterrupt();
+	updateStats();
+
+	if (winner < 0 || results[winner] != Minisat::lbool(true))
+		return false;
+
+	Solver *s = minisatSolvers[winner];
+
+	modelValues.clear();
+	modelValues.resize(modelIdx.size());
+
+	for (size_t i = 0; i < modelIdx.size(); i++)
+	{
+		int idx = modelIdx[i];
+		bool refvalue = true;
+
+		if (idx < 0)
+			idx = -idx, refvalue = false;
+
+		using namespace Minisat;
+		lbool value = s->modelValue(minisatVars.at(idx-1));
+		modelValues[i] = (value == Minisat::lbool(refvalue));
+	}
+
+	return true;
+}
@@ -0,0 +1,75 @@
+/*
+ *  ezSAT -- A simple and easy to use CNF generator for SAT solvers
+ *
+ *  Copyright (C) 2013  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef EZPORTFOLIO_H
+#define EZPORTFOLIO_H
+
+#include "ezsat.h"
+#include <time.h>
+
+namespace Minisat {
+	class SimpSolver;
+}
+
+// A portfolio of differently configured MiniSAT instances. All instances see
+// the same (incremental) CNF, solver() runs them in parallel threads and uses
+// the answer of the first instance that finishes. The others are interrupted
+// and keep their learned clauses for the next call.
+//
+// The result of a solver() call is the same as with ezMiniSAT, but for a
+// satisfiable problem the returned model depends on which instance wins.
+
+class ezPortfolioSAT : public ezSAT
+{
+private:
+	typedef Minisat::SimpSolver Solver;
+	std::vector<Solver*> minisatSolvers;
+	std::vector<int> minisatVars;
+	bool foundContradiction;
+	int numSolvers;
+
+	std::set<int> cnfFrozenVars;
+
+	// as in ezMiniSAT, variables are only eliminated again when the CNF has
+	// doubled since the last elimination
+	int cnfClausesAtLastSimp;
+
+	// the counters of the instances that are already in solverStats
+	std::vector<SolverStats> minisatCounted;
+	void updateStats();
+
+#ifndef _WIN32
+	static ezPortfolioSAT *alarmHandlerThis;
+	static clock_t alarmHandlerTimeout;
+	static void alarmHandler(int);
+#endif
+
+	void createSolvers();
+	void deleteSolvers();
+
+public:
+	ezPortfolioSAT(int numSolvers = 4);
+	virtual ~ezPortfolioSAT();
+	virtual void clear();
+	virtual void freeze(int id);
+	virtual bool eliminated(int idx);
+	virtual bool solver(const std::vector<int> &modelExpressions, std::vector<bool> &modelValues, const std::vector<int> &assumptions);
+};
+
+#endif
@@ -56,6 +56,8 @@ ezSAT::ezSAT()
 	solverTimeout = 0;
 	solverTimoutStatus = false;
 
+	exprStart.push_back(0);
+
 	literal("CONST_TRUE");
 	literal("CONST_FALSE");
 
@@ -114,6 +116,33 @@ int ezSAT::expression(OpId op, int a, int b, int c, int d, int e, int f)
 	return expression(op, args);
 }
 
+int ezSAT::inverted_arg(int id) const
+{
+	if (id >= 0 || exprOps[-id-1] != OpNot)
+		return 0;
+	return exprArgs[exprStart[-id-1]];
+}
+
+unsigned int ezSAT::expression_hash(OpId op, const int *args, int numArgs)
+{
+	unsigned int h = 5381 + op;
+	for (int i = 0; i < numArgs; i++)
+		h = (h * 33) ^ (unsigned int)args[i];
+	return h ^ (h >> 15);
+}
+
+void ezSAT::rehash_expressions()
+{
+	exprTable.assign(exprTable.empty() ? 1024 : 2*exprTable.size(), 0);
+	unsigned int mask = exprTable.size() - 1;
+	for (int i = 0; i < int(exprOps.size()); i++) {
+		unsigned int slot = expression_hash(OpId(exprOps[i]), exprArgs.data() + exprStart[i], exprStart[i+1] - exprStart[i]) & mask;
+		while (exprTable[slot] != 0)
+			slot = (slot + 1) & mask;
+		exprTable[slot] = i + 1;
+	}
+}
+
 int ezSAT::expression(OpId op, const std::vector<int> &args)
 {
 	std::vector<int> myArgs;
@@ -152,6 +181,33 @@ int ezSAT::expression(OpId op, const std::vector<int> &args)
 		myArgs.resize(j+1);
 	}
 
+	// fold arguments that appear both plain and inverted: a&~a = 0, a|~a = 1
+	// and a^~a = 1. myArgs is sorted here and NOT(x) always has a smaller id
+	// than x, so the inverted argument is always seen first.
+	if (myArgs.size() > 1 && (op == OpAnd || op == OpOr || op == OpXor))
+	{
+		std::set<int> removed;
+		for (auto arg : myArgs) {
+			int inner = inverted_arg(arg);
+			if (inner == 0 || removed.count(arg) || !std::binary_search(myArgs.begin(), myArgs.end(), inner))
+				continue;
+			if (op == OpAnd)
+				return CONST_FALSE;
+			if (op == OpOr)
+				return CONST_TRUE;
+			removed.insert(arg);
+			removed.insert(inner);
+			xorRemovedOddTrues = !xorRemovedOddTrues;
+		}
+		if (!removed.empty()) {
+			std::vector<int> newArgs;
+			for (auto arg : myArgs)
+				if (!removed.count(arg))
+					newArgs.push_back(arg);
+			myArgs.swap(newArgs);
+		}
+	}
+
 	switch (op)
 	{
 	case OpNot:
@@ -160,6 +216,8 @@ int ezSAT::expression(OpId op, const std::vector<int> &args)
 			return CONST_FALSE;
 		if (myArgs[0] == CONST_FALSE)
 			return CONST_TRUE;
+		if (inverted_arg(myArgs[0]) != 0)
+			return inverted_arg(myArgs[0]);
 		break;
 
 	case OpAnd:
@@ -167,6 +225,8 @@ int ezSAT::expression(OpId op, const std::vector<int> &args)
 			return CONST_TRUE;
 		if (myArgs.size() == 1)
 			return myArgs[0];
+		if (std::binary_search(myArgs.begin(), myArgs.end(), CONST_FALSE))
+			return CONST_FALSE;
 		break;
 
 	case OpOr:
@@ -174,6 +234,8 @@ int ezSAT::expression(OpId op, const std::vector<int> &args)
 			return CONST_FALSE;
 		if (myArgs.size() == 1)
 			return myArgs[0];
+		if (std::binary_search(myArgs.begin(), myArgs.end(), CONST_TRUE))
+			return CONST_TRUE;
 		break;
 
 	case OpXor:
@@ -196,21 +258,46 @@ int ezSAT::expression(OpId op, const std::vector<int> &args)
 			return myArgs[1];
 		if (myArgs[0] == CONST_FALSE)
 			return myArgs[2];
+		if (myArgs[1] == myArgs[2])
+			return myArgs[1];
+		if (myArgs[1] == CONST_TRUE)
+			return OR(myArgs[0], myArgs[2]);
+		if (myArgs[1] == CONST_FALSE)
+			return AND(NOT(myArgs[0]), myArgs[2]);
+		if (myArgs[2] == CONST_TRUE)
+			return OR(NOT(myArgs[0]), myArgs[1]);
+		if (myArgs[2] == CONST_FALSE)
+			return AND(myArgs[0], myArgs[1]);
 		break;
 
 	default:
 		abort();
 	}
 
-	std::pair<OpId, std::vector<int>> myExpr(op, myArgs);
+	if (2*(exprOps.size() + 1) > exprTable.size())
+		rehash_expressions();
+
+	int numArgs = myArgs.size();
+	unsigned int mask = exprTable.size() - 1;
+	unsigned int slot = expression_hash(op, myArgs.data(), numArgs) & mask;
 	int id = 0;
 
-	if (expressionsCache.count(myExpr) > 0) {
-		id = expressionsCache.at(myExpr);
-	} else {
-		id = -(int(expressions.size()) + 1);
-		expressionsCache[myExpr] = id;
-		expressions.push_back(myExpr);
+	while (exprTable[slot] != 0) {
+		int i = exprTable[slot] - 1;
+		if (exprOps[i] == op && exprStart[i+1] - exprStart[i] == numArgs &&
+				std::equal(myArgs.begin(), myArgs.end(), exprArgs.begin() + exprStart[i])) {
+			id = -(i + 1);
+			break;
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	if (id == 0) {
+		exprTable[slot] = exprOps.size() + 1;
+		exprOps.push_back(op);
+		exprArgs.insert(exprArgs.end(), myArgs.begin(), myArgs.end());
+		exprStart.push_back(exprArgs.size());
+		id = -int(exprOps.size());
 	}
 
 	if (xorRemovedOddTrues)
@@ -236,16 +323,19 @@ const std::string &ezSAT::lookup_literal(int id) const
 
 void ezSAT::lookup_expression(int id, OpId &op, std::vector<int> &args) const
 {
-	assert(0 < -id && -id <= int(expressions.size()));
-	op = expressions[-id - 1].first;
-	args = expressions[-id - 1].second;
+	assert(0 < -id && -id <= int(exprOps.size()));
+	op = OpId(exprOps[-id - 1]);
+	args.assign(exprArgs.begin() + exprStart[-id - 1], exprArgs.begin() + exprStart[-id]);
 }
 
-const std::vector<int> &ezSAT::lookup_expression(int id, OpId &op) const
+ezSAT::ArgsView ezSAT::lookup_expression(int id, OpId &op) const
 {
-	assert(0 < -id && -id <= int(expressions.size()));
-	op = expressions[-id - 1].first;
-	return expressions[-id - 1].second;
+	assert(0 < -id && -id <= int(exprOps.size()));
+	op = OpId(exprOps[-id - 1]);
+	ArgsView view;
+	view.begin_ = exprArgs.data() + exprStart[-id - 1];
+	view.end_ = exprArgs.data() + exprStart[-id];
+	return view;
 }
 
 int ezSAT::parse_string(const std::string &)
@@ -318,7 +408,7 @@ int ezSAT::eval(int id, const std::vector<int> &values) const
 	}
 
 	OpId op;
-	const std::vector<int> &args = lookup_expression(id, op);
+	ArgsView args = lookup_expression(id, op);
 	int a, b;
 
 	switch (op)
@@ -395,6 +485,30 @@ void ezSAT::clear()
 	cnfClauses.clear();
 }
 
+ezSAT::SolverStats &ezSAT::SolverStats::operator+=(const SolverStats &other)
+{
+	calls += other.calls;
+	conflicts += other.conflicts;
+	decisions += other.decisions;
+	propagations += other.propagations;
+	restarts += other.restarts;
+	eliminatedVars += other.eliminatedVars;
+	simplifications += other.simplifications;
+	return *this;
+}
+
+ezSAT::SolverStats &ezSAT::SolverStats::operator-=(const SolverStats &other)
+{
+	calls -= other.calls;
+	conflicts -= other.conflicts;
+	decisions -= other.decisions;
+	propagations -= other.propagations;
+	restarts -= other.restarts;
+	eliminatedVars -= other.eliminatedVars;
+	simplifications -= other.simplifications;
+	return *this;
+}
+
 void ezSAT::freeze(int)
 {
 }
@@ -411,8 +525,8 @@ void ezSAT::assume(int id)
 
 	if (id < 0)
 	{
-		assert(0 < -id && -id <= int(expressions.size()));
-		cnfExpressionVariables.resize(expressions.size());
+		assert(0 < -id && -id <= int(exprOps.size()));
+		cnfExpressionVariables.resize(exprOps.size());
 
 		if (cnfExpressionVariables[-id-1] == 0)
 		{
@@ -566,8 +680,8 @@ int ezSAT::bind(int id, bool auto_freeze)
 		return cnfLiteralVariables[id-1];
 	}
 
-	assert(0 < -id && -id <= int(expressions.size()));
-	cnfExpressionVariables.resize(expressions.size());
+	assert(0 < -id && -id <= int(exprOps.size()));
+	cnfExpressionVariables.resize(exprOps.size());
 
 	if (eliminated(cnfExpressionVariables[-id-1]))
 	{
@@ -1256,30 +1370,32 @@ void ezSAT::printDIMACS(FILE *f, bool verbose) const
 		fprintf(f, "c\n");
 	}
 
-	std::vector<std::vector<int>> all_clauses;
-	getFullCnf(all_clauses);
-	assert(cnfClausesCount == int(all_clauses.size()));
+	// the clauses are printed from both buffers without copying them
+	const std::vector<std::vector<int>> *buffers[2] = { &cnfClausesBackup, &cnfClauses };
+	assert(cnfClausesCount == int(cnfClausesBackup.size() + cnfClauses.size()));
 
 	fprintf(f, "p cnf %d %d\n", cnfVariableCount, cnfClausesCount);
 	int maxClauseLen = 0;
-	for (auto &clause : all_clauses)
-		maxClauseLen = std::max(int(clause.size()), maxClauseLen);
+	for (auto buffer : buffers)
+		for (auto &clause : *buffer)
+			maxClauseLen = std::max(int(clause.size()), maxClauseLen);
 	if (!verbose)
 		maxClauseLen = std::min(maxClauseLen, 3);
-	for (auto &clause : all_clauses) {
-		for (auto idx : clause)
-			fprintf(f, " %*d", digits, idx);
-		if (maxClauseLen >= int(clause.size()))
-			fprintf(f, " %*d\n", (digits + 1)*int(maxClauseLen - clause.size()) + digits, 0);
-		else
-			fprintf(f, " %*d\n", digits, 0);
-	}
+	for (auto buffer : buffers)
+		for (auto &clause : *buffer) {
+			for (auto idx : clause)
+				fprintf(f, " %*d", digits, idx);
+			if (maxClauseLen >= int(clause.size()))
+				fprintf(f, " %*d\n", (digits + 1)*int(maxClauseLen - clause.size()) + digits, 0);
+			else
+				fprintf(f, " %*d\n", digits, 0);
+		}
 }
 
-static std::string expression2str(const std::pair<ezSAT::OpId, std::vector<int>> &data)
+static std::string expression2str(ezSAT::OpId op, const std::vector<int> &args)
 {
 	std::string text;
-	switch (data.first) {
+	switch (op) {
 #define X(op) case ezSAT::op: text += #op; break;
 		X(OpNot)
 		X(OpAnd)
@@ -1292,7 +1408,7 @@ static std::string expression2str(const std::pair<ezSAT::OpId, std::vector<int>>
 #undef X
 	}
 	text += ":";
-	for (auto it : data.second)
+	for (auto it : args)
 		text += " " + my_int_to_string(it);
 	return text;
 }
@@ -1309,13 +1425,13 @@ void ezSAT::printInternalState(FILE *f) const
 	for (int i = 0; i < int(literals.size()); i++)
 		fprintf(f, "    %d: `%s'\n", i+1, literals[i].c_str());
 
-	fprintf(f, "expressionsCache:\n");
-	for (auto &it : expressionsCache)
-		fprintf(f, "    `%s' -> %d\n", expression2str(it.first).c_str(), it.second);
-
 	fprintf(f, "expressions:\n");
-	for (int i = 0; i < int(expressions.size()); i++)
-		fprintf(f, "    %d: `%s'\n", -i-1, expression2str(expressions[i]).c_str());
+	for (int i = 0; i < int(exprOps.size()); i++) {
+		OpId op;
+		std::vector<int> args;
+		lookup_expression(-i-1, op, args);
+		fprintf(f, "    %d: `%s'\n", -i-1, expression2str(op, args).c_str());
+	}
 
 	fprintf(f, "cnfVariables (count=%d):\n", cnfVariableCount);
 	for (int i = 0; i < int(cnfLiteralVariables.size()); i++)
@@ -22,6 +22,7 @@
 
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include <stdio.h>
@@ -57,8 +58,16 @@ private:
 	std::map<std::string, int> literalsCache;
 	std::vector<std::string> literals;
 
-	std::map<std::pair<OpId, std::vector<int>>, int> expressionsCache;
-	std::vector<std::pair<OpId, std::vector<int>>> expressions;
+	// all expressions are stored in flat arrays: expression i has the operator
+	// exprOps[i] and the arguments exprArgs[exprStart[i]] to exprArgs[exprStart[i+1]-1].
+	// exprTable is an open addressing hash table (linear probing, at most half
+	// full) of expression indices plus one, with 0 for empty slots.
+	std::vector<unsigned char> exprOps;
+	std::vector<int> exprStart, exprArgs;
+	std::vector<int> exprTable;
+
+	static unsigned int expression_hash(OpId op, const int *args, int numArgs);
+	void rehash_expressions();
 
 	bool cnfConsumed;
 	int cnfVariableCount, cnfClausesCount;
@@ -69,6 +78,9 @@ private:
 	void add_clause(const std::vector<int> &args, bool argsPolarity, int a = 0, int b = 0, int c = 0);
 	void add_clause(int a, int b = 0, int c = 0);
 
+	// returns x if id is the expression NOT(x), otherwise 0
+	int inverted_arg(int id) const;
+
 	int bind_cnf_not(const std::vector<int> &args);
 	int bind_cnf_and(const std::vector<int> &args);
 	int bind_cnf_or(const std::vector<int> &args);
@@ -80,6 +92,15 @@ public:
 	int solverTimeout;
 	bool solverTimoutStatus;
 
+	// statistics of the solver backend, summed over all solver() calls
+	struct SolverStats {
+		long long calls = 0, conflicts = 0, decisions = 0, propagations = 0, restarts = 0;
+		long long eliminatedVars = 0, simplifications = 0;
+		SolverStats &operator+=(const SolverStats &other);
+		SolverStats &operator-=(const SolverStats &other);
+	};
+	SolverStats solverStats;
+
 	ezSAT();
 	virtual ~ezSAT();
 
@@ -105,14 +126,23 @@ public:
 	void lookup_literal(int id, std::string &name) const;
 	const std::string &lookup_literal(int id) const;
 
+	// the arguments of an expression, valid until the next expression is created
+	struct ArgsView {
+		const int *begin_, *end_;
+		const int *begin() const { return begin_; }
+		const int *end() const { return end_; }
+		size_t size() const { return end_ - begin_; }
+		int operator[](size_t i) const { return begin_[i]; }
+	};
+
 	void lookup_expression(int id, OpId &op, std::vector<int> &args) const;
-	const std::vector<int> &lookup_expression(int id, OpId &op) const;
+	ArgsView lookup_expression(int id, OpId &op) const;
 
 	int parse_string(const std::string &text);
 	std::string to_string(int id) const;
 
 	int numLiterals() const { return literals.size(); }
-	int numExpressions() const { return expressions.size(); }
+	int numExpressions() const { return exprOps.size(); }
 
 	int eval(int id, const std::vector<int> &values) const;
 
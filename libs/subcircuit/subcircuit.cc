@@ -23,8 +23,15 @@
 #include <algorithm>
 #include <assert.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 
+#ifdef YOSYS_ENABLE_THREADS
+#  include <atomic>
+#  include <exception>
+#  include <thread>
+#endif
+
 #ifdef _YOSYS_
 #  include "kernel/yosys.h"
 #  define my_printf YOSYS_NAMESPACE_PREFIX log
@@ -294,6 +301,7 @@ class SubCircuit::SolverWorker
 		std::string graphId;
 		Graph graph;
 		adjMatrix_t adjMatrix;
+		std::vector<std::vector<int>> predecessors;
 		std::vector<bool> usedNodes;
 	};
 
@@ -681,12 +689,19 @@ class SubCircuit::SolverWorker
 		}
 
 		bool compare(int needleEdge, int haystackEdge, const std::map<std::string, std::set<std::set<std::string>>> &swapPorts,
-				const std::map<std::string, std::set<std::map<std::string, std::string>>> &swapPermutations)
+				const std::map<std::string, std::set<std::map<std::string, std::string>>> &swapPermutations,
+				std::map<std::pair<int, int>, bool> &cache, const std::map<std::pair<int, int>, bool> *sharedCache = NULL) const
 		{
 			std::pair<int, int> key(needleEdge, haystackEdge);
-			if (!compareCache.count(key))
-				compareCache[key] = edgeTypes.at(needleEdge).compare(edgeTypes.at(haystackEdge), swapPorts, swapPermutations);
-			return compareCache[key];
+			if (sharedCache != NULL) {
+				auto shared_it = sharedCache->find(key);
+				if (shared_it != sharedCache->end())
+					return shared_it->second;
+			}
+			auto it = cache.find(key);
+			if (it == cache.end())
+				it = cache.insert(std::make_pair(key, edgeTypes.at(needleEdge).compare(edgeTypes.at(haystackEdge), swapPorts, swapPermutations))).first;
+			return it->second;
 		}
 
 		bool compare(int needleEdge, int haystackEdge, const std::map<std::string, std::string> &mapFromPorts, const std::map<std::string, std::set<std::set<std::string>>> &swapPorts,
@@ -707,6 +722,131 @@ class SubCircuit::SolverWorker
 		}
 	};
 
+	// bit matrix representation of the enumeration matrix: one row per needle node and
+	// one column per haystack node that is a candidate for at least one needle node
+
+	static inline int lowestBit(uint64_t word)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return __builtin_ctzll(word);
+#else
+		int i = 0;
+		while (!(word & 1))
+			word >>= 1, i++;
+		return i;
+#endif
+	}
+
+	struct CandidateColumns
+	{
+		std::vector<int> nodes;
+		std::vector<int> columns;
+	};
+
+	struct EnumerationMatrix
+	{
+		const CandidateColumns *cols;
+		int rowWords;
+		std::vector<uint64_t> bits;
+		std::vector<int> rowCounts;
+
+		EnumerationMatrix() : cols(NULL), rowWords(0) { }
+
+		void init(int rows, const CandidateColumns *columns)
+		{
+			cols = columns;
+			rowWords = (int(columns->nodes.size()) + 63) / 64;
+			bits.assign(size_t(rows) * rowWords, 0);
+			rowCounts.assign(rows, 0);
+		}
+
+		int size() const { return rowCounts.size(); }
+		int count(int row) const { return rowCounts[row]; }
+		uint64_t *rowData(int row) { return bits.data() + size_t(row) * rowWords; }
+		const uint64_t *rowData(int row) const { return bits.data() + size_t(row) * rowWords; }
+
+		bool has(int row, int node) const
+		{
+			int col = node < int(cols->columns.size()) ? cols->columns[node] : -1;
+			return col >= 0 && ((rowData(row)[col / 64] >> (col % 64)) & 1) != 0;
+		}
+
+		void insert(int row, int node)
+		{
+			int col = cols->columns[node];
+			uint64_t &word = rowData(row)[col / 64];
+			uint64_t mask = uint64_t(1) << (col % 64);
+			if ((word & mask) == 0)
+				word |= mask, rowCounts[row]++;
+		}
+
+		void erase(int node)
+		{
+			int col = cols->columns[node];
+			uint64_t mask = uint64_t(1) << (col % 64);
+			for (int row = 0; row < size(); row++) {
+				uint64_t &word = rowData(row)[col / 64];
+				if ((word & mask) != 0)
+					word &= ~mask, rowCounts[row]--;
+			}
+		}
+
+		void clearRow(int row)
+		{
+			std::fill(rowData(row), rowData(row) + rowWords, 0);
+			rowCounts[row] = 0;
+		}
+
+		int first(int row) const
+		{
+			const uint64_t *data = rowData(row);
+			for (int w = 0; w < rowWords; w++)
+				if (data[w] != 0)
+					return cols->nodes[w * 64 + lowestBit(data[w])];
+			return -1;
+		}
+
+		// calls f(node) for the nodes in the row in ascending order until f returns true
+		template<typename F>
+		bool any(const uint64_t *data, F f) const
+		{
+			for (int w = 0; w < rowWords; w++)
+				for (uint64_t word = data[w]; word != 0; word &= word - 1)
+					if (f(cols->nodes[w * 64 + lowestBit(word)]))
+						return true;
+			return false;
+		}
+
+		std::vector<int> nodes(int row) const
+		{
+			std::vector<int> result;
+			result.reserve(count(row));
+			any(rowData(row), [&](int node) { result.push_back(node); return false; });
+			return result;
+		}
+	};
+
+	// the overlap history and the edge compare cache used by a search, these are
+	// private copies when the search runs on a worker thread
+
+	struct SearchContext
+	{
+		std::vector<bool> *usedNodes;
+		std::map<std::pair<int, int>, bool> *compareCache;
+		const std::map<std::pair<int, int>, bool> *sharedCompareCache;
+		std::vector<std::vector<int>> *solutionNodes;
+
+		SearchContext(std::vector<bool> *usedNodes, std::map<std::pair<int, int>, bool> *compareCache) :
+				usedNodes(usedNodes), compareCache(compareCache), sharedCompareCache(NULL), solutionNodes(NULL) { }
+	};
+
+	struct SearchRoot
+	{
+		GraphData *haystack;
+		CandidateColumns columns;
+		EnumerationMatrix enumerationMatrix;
+	};
+
 	// solver state variables
 
 	Solver *userSolver;
@@ -717,6 +857,7 @@ class SubCircuit::SolverWorker
 	std::map<std::string, std::set<std::map<std::string, std::string>>> swapPermutations;
 	DiCache diCache;
 	bool verbose;
+	int numThreads;
 
 	// main solver functions
 
@@ -846,14 +987,13 @@ class SubCircuit::SolverWorker
 		return false;
 	}
 
-	void generateEnumerationMatrix(std::vector<std::set<int>> &enumerationMatrix, const GraphData &needle, const GraphData &haystack, const std::map<std::string, std::set<std::string>> &initialMappings) const
+	void generateEnumerationMatrix(SearchRoot &root, const GraphData &needle, const GraphData &haystack, const std::map<std::string, std::set<std::string>> &initialMappings) const
 	{
 		std::map<std::string, std::set<int>> haystackNodesByTypeId;
 		for (int i = 0; i < int(haystack.graph.nodes.size()); i++)
 			haystackNodesByTypeId[haystack.graph.nodes[i].typeId].insert(i);
 
-		enumerationMatrix.clear();
-		enumerationMatrix.resize(needle.graph.nodes.size());
+		std::vector<std::vector<int>> candidates(needle.graph.nodes.size());
 		for (int i = 0; i < int(needle.graph.nodes.size()); i++)
 		{
 			const Graph::Node &nn = needle.graph.nodes[i];
@@ -864,7 +1004,7 @@ class SubCircuit::SolverWorker
 					continue;
 				if (!matchNodes(needle, i, haystack, j))
 					continue;
-				enumerationMatrix[i].insert(j);
+				candidates[i].push_back(j);
 			}
 
 			if (compatibleTypes.count(nn.typeId) > 0)
@@ -875,71 +1015,149 @@ class SubCircuit::SolverWorker
 							continue;
 						if (!matchNodes(needle, i, haystack, j))
 							continue;
-						enumerationMatrix[i].insert(j);
+						candidates[i].push_back(j);
 					}
 		}
+
+		// columns are assigned in haystack node order, so that iterating over
+		// a row visits the candidates in ascending node order
+		CandidateColumns &columns = root.columns;
+		columns.nodes.clear();
+		columns.columns.assign(haystack.graph.nodes.size(), -1);
+		for (auto &row : candidates)
+			for (int j : row)
+				columns.columns[j] = 0;
+		for (int j = 0; j < int(columns.columns.size()); j++)
+			if (columns.columns[j] == 0) {
+				columns.columns[j] = columns.nodes.size();
+				columns.nodes.push_back(j);
+			}
+
+		root.enumerationMatrix.init(needle.graph.nodes.size(), &columns);
+		for (int i = 0; i < int(candidates.size()); i++)
+			for (int j : candidates[i])
+				root.enumerationMatrix.insert(i, j);
 	}
 
-	bool checkEnumerationMatrix(std::vector<std::set<int>> &enumerationMatrix, int i, int j, const GraphData &needle, const GraphData &haystack)
+	bool checkEnumerationMatrix(const EnumerationMatrix &enumerationMatrix, int i, int j, const GraphData &needle, const GraphData &haystack, SearchContext &ctx) const
 	{
+		const std::map<int, int> &haystackEdges = haystack.adjMatrix.at(j);
+
 		for (const auto &it_needle : needle.adjMatrix.at(i))
 		{
 			int needleNeighbour = it_needle.first;
 			int needleEdgeType = it_needle.second;
 
-			for (int haystackNeighbour : enumerationMatrix[needleNeighbour])
-				if (haystack.adjMatrix.at(j).count(haystackNeighbour) > 0) {
-					int haystackEdgeType = haystack.adjMatrix.at(j).at(haystackNeighbour);
-					if (diCache.compare(needleEdgeType, haystackEdgeType, swapPorts, swapPermutations)) {
-						const Graph::Node &needleFromNode = needle.graph.nodes[i];
-						const Graph::Node &needleToNode = needle.graph.nodes[needleNeighbour];
-						const Graph::Node &haystackFromNode = haystack.graph.nodes[j];
-						const Graph::Node &haystackToNode = haystack.graph.nodes[haystackNeighbour];
-						if (userSolver->userCompareEdge(needle.graphId, needleFromNode.nodeId,  needleFromNode.userData, needleToNode.nodeId,  needleToNode.userData,
-								haystack.graphId, haystackFromNode.nodeId, haystackFromNode.userData, haystackToNode.nodeId, haystackToNode.userData))
-							goto found_match;
+			auto checkEdge = [&](int haystackNeighbour, int haystackEdgeType) -> bool {
+				if (!diCache.compare(needleEdgeType, haystackEdgeType, swapPorts, swapPermutations, *ctx.compareCache, ctx.sharedCompareCache))
+					return false;
+				const Graph::Node &needleFromNode = needle.graph.nodes[i];
+				const Graph::Node &needleToNode = needle.graph.nodes[needleNeighbour];
+				const Graph::Node &haystackFromNode = haystack.graph.nodes[j];
+				const Graph::Node &haystackToNode = haystack.graph.nodes[haystackNeighbour];
+				return userSolver->userCompareEdge(needle.graphId, needleFromNode.nodeId,  needleFromNode.userData, needleToNode.nodeId,  needleToNode.userData,
+						haystack.graphId, haystackFromNode.nodeId, haystackFromNode.userData, haystackToNode.nodeId, haystackToNode.userData);
+			};
+
+			// walk the smaller one of the candidate row and the haystack adjacency list
+			bool found = false;
+			if (enumerationMatrix.count(needleNeighbour) < int(haystackEdges.size())) {
+				found = enumerationMatrix.any(enumerationMatrix.rowData(needleNeighbour), [&](int haystackNeighbour) {
+					auto it = haystackEdges.find(haystackNeighbour);
+					return it != haystackEdges.end() && checkEdge(haystackNeighbour, it->second);
+				});
+			} else {
+				for (const auto &it_haystack : haystackEdges)
+					if (enumerationMatrix.has(needleNeighbour, it_haystack.first) && checkEdge(it_haystack.first, it_haystack.second)) {
+						found = true;
+						break;
 					}
-				}
+			}
 
-			return false;
-		found_match:;
+			if (!found)
+				return false;
 		}
 
 		return true;
 	}
 
-	bool pruneEnumerationMatrix(std::vector<std::set<int>> &enumerationMatrix, const GraphData &needle, const GraphData &haystack, int &nextRow, bool allowOverlap)
+	// bit mask of the columns with an edge to any candidate in the given row
+	void predecessorColumns(const EnumerationMatrix &enumerationMatrix, int row, const GraphData &haystack, std::vector<uint64_t> &mask) const
+	{
+		const std::vector<int> &columns = enumerationMatrix.cols->columns;
+		mask.assign(enumerationMatrix.rowWords, 0);
+		enumerationMatrix.any(enumerationMatrix.rowData(row), [&](int node) {
+			for (int pred : haystack.predecessors[node]) {
+				int col = columns[pred];
+				if (col >= 0)
+					mask[col / 64] |= uint64_t(1) << (col % 64);
+			}
+			return false;
+		});
+	}
+
+	bool pruneEnumerationMatrix(EnumerationMatrix &enumerationMatrix, const GraphData &needle, const GraphData &haystack, int &nextRow, bool allowOverlap, SearchContext &ctx) const
 	{
+		int rowWords = enumerationMatrix.rowWords;
+		std::vector<uint64_t> newRow(rowWords);
+		std::vector<std::vector<uint64_t>> predMasks(enumerationMatrix.size());
+
 		bool didSomething = true;
 		while (didSomething)
 		{
 			nextRow = -1;
 			didSomething = false;
-			for (int i = 0; i < int(enumerationMatrix.size()); i++) {
-				std::set<int> newRow;
-				for (int j : enumerationMatrix[i]) {
-					if (!checkEnumerationMatrix(enumerationMatrix, i, j, needle, haystack))
-						didSomething = true;
-					else if (!allowOverlap && haystack.usedNodes[j])
-						didSomething = true;
-					else
-						newRow.insert(j);
+			for (auto &mask : predMasks)
+				mask.clear();
+
+			for (int i = 0; i < int(enumerationMatrix.size()); i++)
+			{
+				uint64_t *row = enumerationMatrix.rowData(i);
+				std::copy(row, row + rowWords, newRow.begin());
+
+				// a candidate for i must have an edge to a candidate of every needle neighbour of i,
+				// drop the candidates that don't with a few word operations before checking edge types
+				for (const auto &it_needle : needle.adjMatrix.at(i)) {
+					int needleNeighbour = it_needle.first;
+					if (enumerationMatrix.count(needleNeighbour) > enumerationMatrix.count(i))
+						continue;
+					std::vector<uint64_t> &mask = predMasks[needleNeighbour];
+					if (mask.empty())
+						predecessorColumns(enumerationMatrix, needleNeighbour, haystack, mask);
+					for (int w = 0; w < rowWords; w++)
+						newRow[w] &= mask[w];
 				}
-				if (newRow.size() == 0)
+
+				int newCount = 0;
+				for (int w = 0; w < rowWords; w++)
+					for (uint64_t word = newRow[w]; word != 0; word &= word - 1) {
+						int bit = lowestBit(word);
+						int j = enumerationMatrix.cols->nodes[w * 64 + bit];
+						if ((!allowOverlap && (*ctx.usedNodes)[j]) || !checkEnumerationMatrix(enumerationMatrix, i, j, needle, haystack, ctx))
+							newRow[w] &= ~(uint64_t(1) << bit);
+						else
+							newCount++;
+					}
+
+				if (newCount == 0)
 					return false;
-				if (newRow.size() >= 2 && (nextRow < 0 || needle.adjMatrix.at(nextRow).size() < needle.adjMatrix.at(i).size()))
+				if (newCount != enumerationMatrix.count(i)) {
+					std::copy(newRow.begin(), newRow.end(), row);
+					enumerationMatrix.rowCounts[i] = newCount;
+					didSomething = true;
+				}
+				if (newCount >= 2 && (nextRow < 0 || needle.adjMatrix.at(nextRow).size() < needle.adjMatrix.at(i).size()))
 					nextRow = i;
-				enumerationMatrix[i].swap(newRow);
 			}
 		}
 		return true;
 	}
 
-	void printEnumerationMatrix(const std::vector<std::set<int>> &enumerationMatrix, int maxHaystackNodeIdx = -1) const
+	void printEnumerationMatrix(const EnumerationMatrix &enumerationMatrix, int maxHaystackNodeIdx = -1) const
 	{
 		if (maxHaystackNodeIdx < 0) {
-			for (const auto &it : enumerationMatrix)
-				for (int idx : it)
+			for (int i = 0; i < int(enumerationMatrix.size()); i++)
+				for (int idx : enumerationMatrix.nodes(i))
 					maxHaystackNodeIdx = std::max(maxHaystackNodeIdx, idx);
 		}
 
@@ -954,16 +1172,16 @@ class SubCircuit::SolverWorker
 			for (int j = 0; j < maxHaystackNodeIdx; j++) {
 				if (j % 5 == 0)
 					my_printf(" ");
-				my_printf("%c", enumerationMatrix[i].count(j) > 0 ? '*' : '.');
+				my_printf("%c", enumerationMatrix.has(i, j) ? '*' : '.');
 			}
 			my_printf("\n");
 		}
 	}
 
-	bool checkPortmapCandidate(const std::vector<std::set<int>> &enumerationMatrix, const GraphData &needle,  const GraphData &haystack, int idx, const std::map<std::string, std::string> &currentCandidate)
+	bool checkPortmapCandidate(const EnumerationMatrix &enumerationMatrix, const GraphData &needle,  const GraphData &haystack, int idx, const std::map<std::string, std::string> &currentCandidate)
 	{
-		assert(enumerationMatrix[idx].size() == 1);
-		int idxHaystack = *enumerationMatrix[idx].begin();
+		assert(enumerationMatrix.count(idx) == 1);
+		int idxHaystack = enumerationMatrix.first(idx);
 
 		const Graph::Node &nn = needle.graph.nodes[idx];
 		const Graph::Node &hn = haystack.graph.nodes[idxHaystack];
@@ -977,8 +1195,8 @@ class SubCircuit::SolverWorker
 			int needleNeighbour = it_needle.first;
 			int needleEdgeType = it_needle.second;
 
-			assert(enumerationMatrix[needleNeighbour].size() == 1);
-			int haystackNeighbour = *enumerationMatrix[needleNeighbour].begin();
+			assert(enumerationMatrix.count(needleNeighbour) == 1);
+			int haystackNeighbour = enumerationMatrix.first(needleNeighbour);
 
 			assert(haystack.adjMatrix.at(idxHaystack).count(haystackNeighbour) > 0);
 			int haystackEdgeType = haystack.adjMatrix.at(idxHaystack).at(haystackNeighbour);
@@ -989,7 +1207,7 @@ class SubCircuit::SolverWorker
 		return true;
 	}
 
-	void generatePortmapCandidates(std::set<std::map<std::string, std::string>> &portmapCandidates, const std::vector<std::set<int>> &enumerationMatrix,
+	void generatePortmapCandidates(std::set<std::map<std::string, std::string>> &portmapCandidates, const EnumerationMatrix &enumerationMatrix,
 			const GraphData &needle, const GraphData &haystack, int idx)
 	{
 		std::map<std::string, std::string> currentCandidate;
@@ -1039,7 +1257,7 @@ class SubCircuit::SolverWorker
 		}
 	}
 
-	bool prunePortmapCandidates(std::vector<std::set<std::map<std::string, std::string>>> &portmapCandidates, std::vector<std::set<int>> enumerationMatrix, const GraphData &needle, const GraphData &haystack)
+	bool prunePortmapCandidates(std::vector<std::set<std::map<std::string, std::string>>> &portmapCandidates, const EnumerationMatrix &enumerationMatrix, const GraphData &needle, const GraphData &haystack)
 	{
 		bool didSomething = false;
 
@@ -1047,8 +1265,8 @@ class SubCircuit::SolverWorker
 
 		for (int i = 0; i < int(needle.graph.nodes.size()); i++)
 		{
-			assert(enumerationMatrix[i].size() == 1);
-			int j = *enumerationMatrix[i].begin();
+			assert(enumerationMatrix.count(i) == 1);
+			int j = enumerationMatrix.first(i);
 
 			std::set<std::map<std::string, std::string>> thisCandidates;
 			portmapCandidates[i].swap(thisCandidates);
@@ -1060,8 +1278,8 @@ class SubCircuit::SolverWorker
 					int needleNeighbour = it_needle.first;
 					int needleEdgeType = it_needle.second;
 
-					assert(enumerationMatrix[needleNeighbour].size() == 1);
-					int haystackNeighbour = *enumerationMatrix[needleNeighbour].begin();
+					assert(enumerationMatrix.count(needleNeighbour) == 1);
+					int haystackNeighbour = enumerationMatrix.first(needleNeighbour);
 
 					assert(haystack.adjMatrix.at(j).count(haystackNeighbour) > 0);
 					int haystackEdgeType = haystack.adjMatrix.at(j).at(haystackNeighbour);
@@ -1102,10 +1320,11 @@ class SubCircuit::SolverWorker
 		return false;
 	}
 
-	void ullmannRecursion(std::vector<Solver::Result> &results, std::vector<std::set<int>> &enumerationMatrix, int iter, const GraphData &needle, GraphData &haystack, bool allowOverlap, int limitResults)
+	void ullmannRecursion(std::vector<Solver::Result> &results, EnumerationMatrix &enumerationMatrix, int iter, const GraphData &needle, const GraphData &haystack,
+			bool allowOverlap, int limitResults, SearchContext &ctx)
 	{
 		int i = -1;
-		if (!pruneEnumerationMatrix(enumerationMatrix, needle, haystack, i, allowOverlap))
+		if (!pruneEnumerationMatrix(enumerationMatrix, needle, haystack, i, allowOverlap, ctx))
 			return;
 
 		if (i < 0)
@@ -1121,8 +1340,8 @@ class SubCircuit::SolverWorker
 				Solver::ResultNodeMapping mapping;
 				mapping.needleNodeId = needle.graph.nodes[j].nodeId;
 				mapping.needleUserData = needle.graph.nodes[j].userData;
-				mapping.haystackNodeId = haystack.graph.nodes[*enumerationMatrix[j].begin()].nodeId;
-				mapping.haystackUserData = haystack.graph.nodes[*enumerationMatrix[j].begin()].userData;
+				mapping.haystackNodeId = haystack.graph.nodes[enumerationMatrix.first(j)].nodeId;
+				mapping.haystackUserData = haystack.graph.nodes[enumerationMatrix.first(j)].userData;
 				generatePortmapCandidates(portmapCandidates[j], enumerationMatrix, needle, haystack, j);
 				result.mappings[needle.graph.nodes[j].nodeId] = mapping;
 			}
@@ -1163,9 +1382,14 @@ class SubCircuit::SolverWorker
 				return;
 			}
 
+			std::vector<int> solutionNodes;
 			for (int j = 0; j < int(enumerationMatrix.size()); j++)
-				if (!haystack.graph.nodes[*enumerationMatrix[j].begin()].shared)
-					haystack.usedNodes[*enumerationMatrix[j].begin()] = true;
+				if (!haystack.graph.nodes[enumerationMatrix.first(j)].shared) {
+					(*ctx.usedNodes)[enumerationMatrix.first(j)] = true;
+					solutionNodes.push_back(enumerationMatrix.first(j));
+				}
+			if (ctx.solutionNodes != NULL)
+				ctx.solutionNodes->push_back(solutionNodes);
 
 			if (verbose) {
 				my_printf("\nSolution:\n");
@@ -1182,8 +1406,8 @@ class SubCircuit::SolverWorker
 			printEnumerationMatrix(enumerationMatrix, haystack.graph.nodes.size());
 		}
 
-		std::set<int> activeRow;
-		enumerationMatrix[i].swap(activeRow);
+		std::vector<int> activeRow = enumerationMatrix.nodes(i);
+		enumerationMatrix.clearRow(i);
 
 		for (int j : activeRow)
 		{
@@ -1192,24 +1416,159 @@ class SubCircuit::SolverWorker
 				return;
 
 			// already used by other solution -> try next
-			if (!allowOverlap && haystack.usedNodes[j])
+			if (!allowOverlap && (*ctx.usedNodes)[j])
 				continue;
 
-			// create enumeration matrix for child in recursion tree
-			std::vector<std::set<int>> nextEnumerationMatrix = enumerationMatrix;
-			for (int k = 0; k < int(nextEnumerationMatrix.size()); k++)
-				nextEnumerationMatrix[k].erase(j);
-			nextEnumerationMatrix[i].insert(j);
-
 			// recursion
-			ullmannRecursion(results, nextEnumerationMatrix, iter+1, needle, haystack, allowOverlap, limitResults);
+			ullmannChild(results, enumerationMatrix, i, j, iter, needle, haystack, allowOverlap, limitResults, ctx);
 
 			// we just have found something -> unroll to top recursion level
-			if (!allowOverlap && haystack.usedNodes[j] && iter > 0)
+			if (!allowOverlap && (*ctx.usedNodes)[j] && iter > 0)
 				return;
 		}
 	}
 
+	void ullmannChild(std::vector<Solver::Result> &results, const EnumerationMatrix &enumerationMatrix, int i, int j, int iter, const GraphData &needle, const GraphData &haystack,
+			bool allowOverlap, int limitResults, SearchContext &ctx)
+	{
+		// create enumeration matrix for child in recursion tree
+		EnumerationMatrix nextEnumerationMatrix = enumerationMatrix;
+		nextEnumerationMatrix.erase(j);
+		nextEnumerationMatrix.insert(i, j);
+
+		ullmannRecursion(results, nextEnumerationMatrix, iter+1, needle, haystack, allowOverlap, limitResults, ctx);
+	}
+
+	// runs the search for each root like ullmannRecursion() does, but searches the subtrees below
+	// the candidates of the first branching row on multiple threads. the subtrees are committed in
+	// order, so the results do not depend on the number of threads. without overlapping the subtrees
+	// following a subtree that found a solution are searched again with the updated overlap history.
+
+	void searchRoots(std::vector<Solver::Result> &results, std::vector<SearchRoot> &roots, const GraphData &needle, bool allowOverlap, int limitResults)
+	{
+#ifdef YOSYS_ENABLE_THREADS
+		if (numThreads > 1 && !verbose)
+		{
+			struct SearchTask {
+				SearchRoot *root;
+				int row, node;
+				std::vector<Solver::Result> results;
+				std::vector<std::vector<int>> solutionNodes;
+				std::exception_ptr error;
+			};
+
+			std::vector<SearchTask> tasks;
+			for (auto &root : roots)
+			{
+				SearchContext ctx(&root.haystack->usedNodes, &diCache.compareCache);
+				int i = -1;
+				if (!pruneEnumerationMatrix(root.enumerationMatrix, needle, *root.haystack, i, allowOverlap, ctx))
+					continue;
+
+				SearchTask task;
+				task.root = &root;
+				task.row = i;
+				task.node = -1;
+				if (i < 0) {
+					tasks.push_back(task);
+					continue;
+				}
+
+				for (int j : root.enumerationMatrix.nodes(i)) {
+					task.node = j;
+					tasks.push_back(task);
+				}
+				root.enumerationMatrix.clearRow(i);
+			}
+
+			// the worker threads only read the shared compare cache and add new entries to their own
+			std::vector<std::map<std::pair<int, int>, bool>> threadCaches(numThreads);
+			int waveSize = allowOverlap ? int(tasks.size()) : 4 * numThreads;
+			int nextTask = 0;
+
+			while (nextTask < int(tasks.size()))
+			{
+				if (limitResults >= 0 && int(results.size()) >= limitResults)
+					break;
+
+				std::vector<int> wave;
+				while (nextTask < int(tasks.size()) && int(wave.size()) < waveSize) {
+					SearchTask &task = tasks[nextTask++];
+					if (!allowOverlap && task.node >= 0 && task.root->haystack->usedNodes[task.node])
+						continue;
+					wave.push_back(nextTask-1);
+				}
+
+				int taskLimit = limitResults >= 0 ? limitResults - int(results.size()) : -1;
+				std::atomic<int> nextIndex(0);
+
+				auto worker_thread = [&](int threadIdx) {
+					while (1) {
+						int k = nextIndex++;
+						if (k >= int(wave.size()))
+							break;
+						SearchTask &task = tasks[wave[k]];
+						std::vector<bool> usedNodes = task.root->haystack->usedNodes;
+						SearchContext ctx(&usedNodes, &threadCaches[threadIdx]);
+						ctx.sharedCompareCache = &diCache.compareCache;
+						ctx.solutionNodes = &task.solutionNodes;
+						task.error = nullptr;
+						try {
+							if (task.node < 0) {
+								EnumerationMatrix enumerationMatrix = task.root->enumerationMatrix;
+								ullmannRecursion(task.results, enumerationMatrix, 0, needle, *task.root->haystack, allowOverlap, taskLimit, ctx);
+							} else
+								ullmannChild(task.results, task.root->enumerationMatrix, task.row, task.node, 0, needle, *task.root->haystack, allowOverlap, taskLimit, ctx);
+						} catch (...) {
+							task.error = std::current_exception();
+						}
+					}
+				};
+
+				std::vector<std::thread> threads;
+				for (int t = 0; t < std::min(numThreads, int(wave.size())); t++)
+					threads.emplace_back(worker_thread, t);
+				for (auto &t : threads)
+					t.join();
+
+				for (int k = 0; k < int(wave.size()); k++)
+				{
+					SearchTask &task = tasks[wave[k]];
+					if (task.error)
+						std::rethrow_exception(task.error);
+
+					for (int r = 0; r < int(task.results.size()); r++) {
+						if (limitResults >= 0 && int(results.size()) >= limitResults)
+							break;
+						results.push_back(task.results[r]);
+						for (int node : task.solutionNodes[r])
+							task.root->haystack->usedNodes[node] = true;
+					}
+
+					if (!allowOverlap && !task.results.empty()) {
+						nextTask = wave[k] + 1;
+						break;
+					}
+				}
+
+				for (int k : wave) {
+					tasks[k].results.clear();
+					tasks[k].solutionNodes.clear();
+				}
+			}
+
+			for (auto &cache : threadCaches)
+				diCache.compareCache.insert(cache.begin(), cache.end());
+			return;
+		}
+#endif
+
+		for (auto &root : roots) {
+			SearchContext ctx(&root.haystack->usedNodes, &diCache.compareCache);
+			ullmannRecursion(results, root.enumerationMatrix, 0, needle, *root.haystack, allowOverlap, limitResults, ctx);
+		}
+	}
+
 	// additional data structes and functions for mining
 
 	struct NodeSet {
@@ -1263,18 +1622,23 @@ class SubCircuit::SolverWorker
 		bool backupVerbose = verbose;
 		verbose = false;
 
+		std::vector<SearchRoot> roots(graphData.size());
+		int rootIdx = 0;
+
 		for (auto &it : graphData)
 		{
 			GraphData &haystack = it.second;
+			SearchRoot &root = roots[rootIdx++];
 
-			std::vector<std::set<int>> enumerationMatrix;
 			std::map<std::string, std::set<std::string>> initialMappings;
-			generateEnumerationMatrix(enumerationMatrix, needle, haystack, initialMappings);
+			root.haystack = &haystack;
+			generateEnumerationMatrix(root, needle, haystack, initialMappings);
 
 			haystack.usedNodes.resize(haystack.graph.nodes.size());
-			ullmannRecursion(results, enumerationMatrix, 0, needle, haystack, true, -1);
 		}
 
+		searchRoots(results, roots, needle, true, -1);
+
 		verbose = backupVerbose;
 	}
 
@@ -1469,7 +1833,7 @@ class SubCircuit::SolverWorker
 	// interface to the public solver class
 
 protected:
-	SolverWorker(Solver *userSolver) : userSolver(userSolver), verbose(false)
+	SolverWorker(Solver *userSolver) : userSolver(userSolver), verbose(false), numThreads(1)
 	{
 	}
 
@@ -1478,6 +1842,11 @@ protected:
 		verbose = true;
 	}
 
+	void setThreads(int threads)
+	{
+		numThreads = std::max(1, threads);
+	}
+
 	void addGraph(std::string graphId, const Graph &graph)
 	{
 		assert(graphData.count(graphId) == 0);
@@ -1486,6 +1855,11 @@ protected:
 		gd.graphId = graphId;
 		gd.graph = graph;
 		diCache.add(gd.graph, gd.adjMatrix, graphId, userSolver);
+
+		gd.predecessors.resize(gd.graph.nodes.size());
+		for (int i = 0; i < int(gd.adjMatrix.size()); i++)
+			for (auto &it : gd.adjMatrix[i])
+				gd.predecessors[it.first].push_back(i);
 	}
 
 	void addCompatibleTypes(std::string needleTypeId, std::string haystackTypeId)
@@ -1519,8 +1893,10 @@ protected:
 		const GraphData &needle = graphData[needleGraphId];
 		GraphData &haystack = graphData[haystackGraphId];
 
-		std::vector<std::set<int>> enumerationMatrix;
-		generateEnumerationMatrix(enumerationMatrix, needle, haystack, initialMappings);
+		std::vector<SearchRoot> roots(1);
+		roots[0].haystack = &haystack;
+		generateEnumerationMatrix(roots[0], needle, haystack, initialMappings);
+		const EnumerationMatrix &enumerationMatrix = roots[0].enumerationMatrix;
 
 		if (verbose)
 		{
@@ -1552,7 +1928,7 @@ protected:
 		}
 
 		haystack.usedNodes.resize(haystack.graph.nodes.size());
-		ullmannRecursion(results, enumerationMatrix, 0, needle, haystack, allowOverlap, maxSolutions > 0 ? results.size() + maxSolutions : -1);
+		searchRoots(results, roots, needle, allowOverlap, maxSolutions > 0 ? results.size() + maxSolutions : -1);
 	}
 
 	void mine(std::vector<Solver::MineResult> &results, int minNodes, int maxNodes, int minMatches, int limitMatchesPerGraph)
@@ -1627,6 +2003,11 @@ void SubCircuit::Solver::setVerbose()
 	worker->setVerbose();
 }
 
+void SubCircuit::Solver::setThreads(int numThreads)
+{
+	worker->setThreads(numThreads);
+}
+
 void SubCircuit::Solver::addGraph(std::string graphId, const Graph &graph)
 {
 	worker->addGraph(graphId, graph);
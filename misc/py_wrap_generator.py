@@ -991,7 +991,7 @@ sources = [
 	Source("kernel/cost",[])
 	]
 
-blacklist_methods = ["YOSYS_NAMESPACE::Pass::run_register", "YOSYS_NAMESPACE::Module::Pow", "YOSYS_NAMESPACE::Module::Bu0", "YOSYS_NAMESPACE::CaseRule::optimize"]
+blacklist_methods = ["YOSYS_NAMESPACE::Pass::run_register", "YOSYS_NAMESPACE::Module::Pow", "YOSYS_NAMESPACE::Module::Bu0", "YOSYS_NAMESPACE::CaseRule::optimize", "YOSYS_NAMESPACE::Const::operator*"]
 
 enum_names = ["State","SyncType","ConstFlags"]
 
@@ -2389,6 +2389,119 @@ namespace YOSYS_PYTHON {
 		Yosys::log_streams.insert(Yosys::log_streams.begin(), output);
 	};
 
+	/// Bulk access to the netlist of a module, without creating a Python object
+	/// for each cell, wire or bit. Signal bits are given as net numbers: bits
+	/// that are connected (according to a SigMap of the module) have the same
+	/// number, assigned in the order of the wires and their bits, so that all
+	/// functions number the nets of an unchanged module the same way. Constant
+	/// bits are -1 (0), -2 (1), -3 (x) and -4 (z), and -5 pads ports that are
+	/// narrower than the array. Arrays are returned as bytes objects holding
+	/// native int32 values, e.g. for numpy.frombuffer(data, dtype=numpy.int32).
+	struct NetNumbering
+	{
+		Yosys::SigMap sigmap;
+		Yosys::dict<Yosys::RTLIL::SigBit, int> net_ids;
+
+		NetNumbering(Yosys::RTLIL::Module *module) : sigmap(module)
+		{
+			for (auto wire : module->wires())
+				for (auto bit : sigmap(wire))
+					if (bit.wire != nullptr && net_ids.count(bit) == 0) {
+						int id = Yosys::GetSize(net_ids);
+						net_ids[bit] = id;
+					}
+		}
+
+		int operator()(Yosys::RTLIL::SigBit bit) const
+		{
+			bit = sigmap(bit);
+			if (bit.wire != nullptr)
+				return net_ids.at(bit);
+			switch (bit.data) {
+				case Yosys::RTLIL::State::S0: return -1;
+				case Yosys::RTLIL::State::S1: return -2;
+				case Yosys::RTLIL::State::Sz: return -4;
+				default: return -3;
+			}
+		}
+	};
+
+	boost::python::object int32_bytes(const std::vector<int32_t> &data)
+	{
+		return boost::python::object(boost::python::handle<>(PyBytes_FromStringAndSize(
+				reinterpret_cast<const char*>(data.data()), data.size() * sizeof(int32_t))));
+	}
+
+	/// module_wire_nets(module) -> (names, offsets, nets)
+	/// The bits of wire i are nets[offsets[i]:offsets[i+1]].
+	boost::python::tuple module_wire_nets(Module *py_module)
+	{
+		Yosys::RTLIL::Module *module = py_module->get_cpp_obj();
+		NetNumbering numbering(module);
+
+		boost::python::list names;
+		std::vector<int32_t> offsets, nets;
+		offsets.push_back(0);
+		for (auto wire : module->wires()) {
+			names.append(wire->name.str());
+			for (auto bit : Yosys::RTLIL::SigSpec(wire))
+				nets.push_back(numbering(bit));
+			offsets.push_back(Yosys::GetSize(nets));
+		}
+
+		return boost::python::make_tuple(names, int32_bytes(offsets), int32_bytes(nets));
+	}
+
+	/// module_cell_nets(module, type, port) -> (names, width, nets)
+	/// The port of the i-th cell of that type is nets[i*width:(i+1)*width],
+	/// with width the widest connection of the port.
+	boost::python::tuple module_cell_nets(Module *py_module, std::string type, std::string port)
+	{
+		Yosys::RTLIL::Module *module = py_module->get_cpp_obj();
+		Yosys::RTLIL::IdString type_id = Yosys::RTLIL::escape_id(type);
+		Yosys::RTLIL::IdString port_id = Yosys::RTLIL::escape_id(port);
+		NetNumbering numbering(module);
+
+		std::vector<Yosys::RTLIL::Cell*> cells;
+		int width = 0;
+		for (auto cell : module->cells())
+			if (cell->type == type_id) {
+				cells.push_back(cell);
+				if (cell->hasPort(port_id))
+					width = std::max(width, Yosys::GetSize(cell->getPort(port_id)));
+			}
+
+		boost::python::list names;
+		std::vector<int32_t> nets;
+		nets.reserve(cells.size() * width);
+		for (auto cell : cells) {
+			names.append(cell->name.str());
+			int i = 0;
+			if (cell->hasPort(port_id))
+				for (auto bit : cell->getPort(port_id)) {
+					nets.push_back(numbering(bit));
+					i++;
+				}
+			for (; i < width; i++)
+				nets.push_back(-5);
+		}
+
+		return boost::python::make_tuple(names, width, int32_bytes(nets));
+	}
+
+	/// module_cell_type_counts(module) -> {type: count}
+	boost::python::dict module_cell_type_counts(Module *py_module)
+	{
+		Yosys::dict<Yosys::RTLIL::IdString, int> counts;
+		for (auto cell : py_module->get_cpp_obj()->cells())
+			counts[cell->type]++;
+
+		boost::python::dict result;
+		for (auto &it : counts)
+			result[it.first.str()] = it.second;
+		return result;
+	}
+
 
 	BOOST_PYTHON_MODULE(libyosys)
 	{
@@ -2398,6 +2511,9 @@ namespace YOSYS_PYTHON {
 		scope().attr("_hidden") = new Initializer();
 
 		def("log_to_stream", &log_to_stream);
+		def("module_wire_nets", &module_wire_nets);
+		def("module_cell_nets", &module_cell_nets);
+		def("module_cell_type_counts", &module_cell_type_counts);
 """)
 
 	for enum in enums:
@@ -18,77 +18,183 @@
  */
 
 #include "kernel/yosys.h"
+#include <queue>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
-int autoname_worker(Module *module)
+// A private cell is named after a public wire it is connected to, and a
+// private wire after a public cell. The score of a proposed name prefers
+// outputs, then wires with few connections, then short names. Proposals are
+// handed out in the order of their scores, and a rename only creates new
+// proposals for the neighbors of the renamed object.
+struct AutonameWorker
 {
-	dict<Cell*, pair<int, IdString>> proposed_cell_names;
-	dict<Wire*, pair<int, IdString>> proposed_wire_names;
+	struct entry_t {
+		int64_t score;
+		int seq;
+		Cell *cell;
+		Wire *wire;
+		string name;
+
+		bool operator<(const entry_t &other) const {
+			if (score != other.score)
+				return score > other.score;
+			return seq > other.seq;
+		}
+	};
+
+	Module *module;
 	dict<Wire*, int> wire_score;
-	int best_score = -1;
+	dict<Wire*, vector<pair<Cell*, IdString>>> wire_users;
+	dict<Cell*, pair<int64_t, int>> proposed_cell_names;
+	dict<Wire*, pair<int64_t, int>> proposed_wire_names;
+	dict<IdString, int> uniquify_index;
+	std::priority_queue<entry_t> queue;
+	int seq = 0;
 
-	for (auto cell : module->selected_cells())
-	for (auto &conn : cell->connections())
-	for (auto bit : conn.second)
-		if (bit.wire != nullptr)
-			wire_score[bit.wire]++;
+	AutonameWorker(Module *module) : module(module) { }
 
-	for (auto cell : module->selected_cells()) {
-		if (cell->name[0] == '$') {
-			for (auto &conn : cell->connections()) {
-				string suffix = stringf("_%s_%s", log_id(cell->type), log_id(conn.first));
-				for (auto bit : conn.second)
-					if (bit.wire != nullptr && bit.wire->name[0] != '$') {
-						IdString new_name(bit.wire->name.str() + suffix);
-						int score = wire_score.at(bit.wire);
-						if (cell->output(conn.first)) score = 0;
-						score = 10000*score + new_name.size();
-						if (!proposed_cell_names.count(cell) || score < proposed_cell_names.at(cell).first) {
-							if (best_score < 0 || score < best_score)
-								best_score = score;
-							proposed_cell_names[cell] = make_pair(score, new_name);
-						}
-					}
+	int64_t get_score(Wire *wire, Cell *cell, IdString port, const string &name)
+	{
+		int64_t score = cell->output(port) ? 0 : wire_score.at(wire);
+		return 10000*score + GetSize(name);
+	}
+
+	void propose_cell_name(Cell *cell, IdString port, Wire *wire)
+	{
+		string name = wire->name.str() + stringf("_%s_%s", log_id(cell->type), log_id(port));
+		int64_t score = get_score(wire, cell, port, name);
+		auto it = proposed_cell_names.find(cell);
+		if (it != proposed_cell_names.end() && score >= it->second.first)
+			return;
+		proposed_cell_names[cell] = make_pair(score, seq);
+		queue.push(entry_t{score, seq++, cell, nullptr, name});
+	}
+
+	void propose_wire_name(Wire *wire, Cell *cell, IdString port)
+	{
+		string name = cell->name.str() + stringf("_%s", log_id(port));
+		int64_t score = get_score(wire, cell, port, name);
+		auto it = proposed_wire_names.find(wire);
+		if (it != proposed_wire_names.end() && score >= it->second.first)
+			return;
+		proposed_wire_names[wire] = make_pair(score, seq);
+		queue.push(entry_t{score, seq++, nullptr, wire, name});
+	}
+
+	// proposals of a public cell for its private wires
+	void propose_from_cell(Cell *cell)
+	{
+		for (auto &conn : cell->connections()) {
+			Wire *last_wire = nullptr;
+			for (auto bit : conn.second)
+				if (bit.wire != nullptr && bit.wire != last_wire) {
+					last_wire = bit.wire;
+					if (bit.wire->name[0] == '$' && !bit.wire->port_id)
+						propose_wire_name(bit.wire, cell, conn.first);
+				}
+		}
+	}
+
+	// proposals of a public wire for its private cells
+	void propose_from_wire(Wire *wire)
+	{
+		auto it = wire_users.find(wire);
+		if (it == wire_users.end())
+			return;
+		for (auto &user : it->second)
+			if (user.first->name[0] == '$')
+				propose_cell_name(user.first, user.second, wire);
+	}
+
+	// proposals that have been replaced by better ones
+	bool is_stale(const entry_t &entry) const
+	{
+		if (entry.cell != nullptr)
+			return proposed_cell_names.at(entry.cell).second != entry.seq;
+		return proposed_wire_names.at(entry.wire).second != entry.seq;
+	}
+
+	int run()
+	{
+		vector<Cell*> cells = module->selected_cells();
+
+		for (auto cell : cells)
+		for (auto &conn : cell->connections()) {
+			Wire *last_wire = nullptr;
+			for (auto bit : conn.second)
+				if (bit.wire != nullptr) {
+					wire_score[bit.wire]++;
+					if (bit.wire != last_wire)
+						wire_users[bit.wire].push_back(make_pair(cell, conn.first));
+					last_wire = bit.wire;
+				}
+		}
+
+		for (auto cell : cells) {
+			if (cell->name[0] != '$') {
+				propose_from_cell(cell);
+				continue;
 			}
-		} else {
 			for (auto &conn : cell->connections()) {
-				string suffix = stringf("_%s", log_id(conn.first));
+				Wire *last_wire = nullptr;
 				for (auto bit : conn.second)
-					if (bit.wire != nullptr && bit.wire->name[0] == '$' && !bit.wire->port_id) {
-						IdString new_name(cell->name.str() + suffix);
-						int score = wire_score.at(bit.wire);
-						if (cell->output(conn.first)) score = 0;
-						score = 10000*score + new_name.size();
-						if (!proposed_wire_names.count(bit.wire) || score < proposed_wire_names.at(bit.wire).first) {
-							if (best_score < 0 || score < best_score)
-								best_score = score;
-							proposed_wire_names[bit.wire] = make_pair(score, new_name);
-						}
+					if (bit.wire != nullptr && bit.wire != last_wire) {
+						last_wire = bit.wire;
+						if (bit.wire->name[0] != '$')
+							propose_cell_name(cell, conn.first, bit.wire);
 					}
 			}
 		}
-	}
 
-	for (auto &it : proposed_cell_names) {
-		if (best_score*2 < it.second.first)
-			continue;
-		IdString n = module->uniquify(it.second.second);
-		log_debug("Rename cell %s in %s to %s.\n", log_id(it.first), log_id(module), log_id(n));
-		module->rename(it.first, n);
-	}
+		int count = 0;
 
-	for (auto &it : proposed_wire_names) {
-		if (best_score*2 < it.second.first)
-			continue;
-		IdString n = module->uniquify(it.second.second);
-		log_debug("Rename wire %s in %s to %s.\n", log_id(it.first), log_id(module), log_id(n));
-		module->rename(it.first, n);
-	}
+		while (1)
+		{
+			while (!queue.empty() && is_stale(queue.top()))
+				queue.pop();
+			if (queue.empty())
+				break;
 
-	return proposed_cell_names.size() + proposed_wire_names.size();
-}
+			// Like in a sweep over all objects, every proposal that is not
+			// much worse than the best one is used right away, and the new
+			// proposals of the renamed objects only compete in the next
+			// round. This names the objects after their nearest public
+			// neighbors instead of growing long chains of names.
+			int64_t limit = 2*queue.top().score;
+			vector<entry_t> renames;
+
+			while (!queue.empty() && queue.top().score <= limit) {
+				if (!is_stale(queue.top()))
+					renames.push_back(queue.top());
+				queue.pop();
+			}
+
+			for (auto &entry : renames) {
+				IdString n = module->uniquify(entry.name, uniquify_index[entry.name]);
+				if (entry.cell != nullptr) {
+					log_debug("Rename cell %s in %s to %s.\n", log_id(entry.cell), log_id(module), log_id(n));
+					module->rename(entry.cell, n);
+				} else {
+					log_debug("Rename wire %s in %s to %s.\n", log_id(entry.wire), log_id(module), log_id(n));
+					module->rename(entry.wire, n);
+				}
+			}
+
+			for (auto &entry : renames) {
+				if (entry.cell != nullptr)
+					propose_from_cell(entry.cell);
+				else
+					propose_from_wire(entry.wire);
+			}
+
+			count += GetSize(renames);
+		}
+
+		return count;
+	}
+};
 
 struct AutonamePass : public Pass {
 	AutonamePass() : Pass("autoname", "automatically assign names to objects") { }
@@ -118,15 +224,10 @@ struct AutonamePass : public Pass {
 
 		for (auto module : design->selected_modules())
 		{
-			int count = 0, iter = 0;
-			while (1) {
-				iter++;
-				int n = autoname_worker(module);
-				if (!n) break;
-				count += n;
-			}
+			AutonameWorker worker(module);
+			int count = worker.run();
 			if (count > 0)
-				log("Renamed %d objects in module %s (%d iterations).\n", count, log_id(module), iter);
+				log("Renamed %d objects in module %s.\n", count, log_id(module));
 		}
 	}
 } AutonamePass;
@@ -18,6 +18,7 @@
  */
 
 #include "kernel/yosys.h"
+#include "kernel/threadpool.h"
 #include "backends/ilang/ilang_backend.h"
 
 USING_YOSYS_NAMESPACE
@@ -55,6 +56,13 @@ struct BugpointPass : public Pass {
 		log("        faster, but produces larger testcases, and may fail to produce any\n");
 		log("        testcase at all if the crash is related to dangling wires.\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        evaluate up to N candidate testcases at the same time. each candidate\n");
+		log("        is run in its own working directory 'bugpoint_XXXXXX' (removed when\n");
+		log("        this command finishes), so relative -script and -yosys paths are\n");
+		log("        resolved from the parent directory. the result is the same as without\n");
+		log("        this option.\n");
+		log("\n");
 		log("    -clean\n");
 		log("        run `proc_clean; clean -purge` before checking testcase and after\n");
 		log("        finishing. produces smaller and more useful testcases, but may fail to\n");
@@ -67,7 +75,8 @@ struct BugpointPass : public Pass {
 		log("        try to remove module ports.\n");
 		log("\n");
 		log("    -cells\n");
-		log("        try to remove cells.\n");
+		log("        try to remove cells. before removing single cells, this first tries\n");
+		log("        to remove chunks of half, a quarter, etc. of all cells.\n");
 		log("\n");
 		log("    -connections\n");
 		log("        try to reconnect ports to 'x.\n");
@@ -80,24 +89,45 @@ struct BugpointPass : public Pass {
 		log("\n");
 	}
 
-	bool run_yosys(RTLIL::Design *design, string yosys_cmd, string script)
+	string yosys_cmd, script, grep;
+	bool fast, clean;
+	std::vector<string> worker_dirs;
+
+	string yosys_cmdline(const string &dir)
+	{
+		if (dir == ".")
+			return stringf("%s -qq -L bugpoint-case.log -s %s bugpoint-case.il", yosys_cmd.c_str(), script.c_str());
+
+		// the worker directories are subdirectories of the current directory
+		string dir_yosys_cmd = yosys_cmd, dir_script = script;
+		if (dir_yosys_cmd.find('/') != string::npos && dir_yosys_cmd[0] != '/')
+			dir_yosys_cmd = "../" + dir_yosys_cmd;
+		if (dir_script[0] != '/')
+			dir_script = "../" + dir_script;
+		return stringf("cd %s && %s -qq -L bugpoint-case.log -s %s bugpoint-case.il", dir.c_str(), dir_yosys_cmd.c_str(), dir_script.c_str());
+	}
+
+	void write_case(RTLIL::Design *design, const string &dir)
 	{
 		design->sort();
 
-		std::ofstream f("bugpoint-case.il");
+		std::ofstream f(dir + "/bugpoint-case.il");
 		ILANG_BACKEND::dump_design(f, design, /*only_selected=*/false, /*flag_m=*/true, /*flag_n=*/false);
 		f.close();
+	}
 
-		string yosys_cmdline = stringf("%s -qq -L bugpoint-case.log -s %s bugpoint-case.il", yosys_cmd.c_str(), script.c_str());
-		return run_command(yosys_cmdline) == 0;
+	bool run_yosys(RTLIL::Design *design)
+	{
+		write_case(design, ".");
+		return run_tool_command(yosys_cmdline("."), ".") == 0;
 	}
 
-	bool check_logfile(string grep)
+	bool check_logfile(const string &dir = ".")
 	{
 		if (grep.empty())
 			return true;
 
-		std::ifstream f("bugpoint-case.log");
+		std::ifstream f(dir + "/bugpoint-case.log");
 		while (!f.eof())
 		{
 			string line;
@@ -108,6 +138,41 @@ struct BugpointPass : public Pass {
 		return false;
 	}
 
+	// Runs all candidates (one per worker directory, at the same time) and returns the
+	// index of the first one that still crashes, or -1. The candidates are deleted,
+	// except for the returned one.
+	int try_candidates(std::vector<RTLIL::Design*> &candidates)
+	{
+		int count = GetSize(candidates);
+		std::vector<int> results(count);
+
+		for (int i = 0; i < count; i++) {
+			candidates[i] = clean_design(candidates[i], fast, /*do_delete=*/true);
+			RTLIL::Design *testcase = clean_design(candidates[i], clean);
+			write_case(testcase, worker_dirs[i]);
+			if (testcase != candidates[i])
+				delete testcase;
+		}
+
+		parallel_for(count, [&](int i) {
+			results[i] = run_tool_command(yosys_cmdline(worker_dirs[i]), worker_dirs[i]);
+		}, count);
+
+		int found = -1;
+		for (int i = 0; i < count; i++) {
+			if (found < 0 && results[i] != 0 && check_logfile(worker_dirs[i]))
+				found = i;
+			else
+				delete candidates[i];
+		}
+
+		if (found >= 0)
+			log("Testcase crashes.\n");
+		else
+			log("Testcase does not crash.\n");
+		return found;
+	}
+
 	RTLIL::Design *clean_design(RTLIL::Design *design, bool do_clean = true, bool do_delete = false)
 	{
 		if (!do_clean)
@@ -124,7 +189,46 @@ struct BugpointPass : public Pass {
 		return design_copy;
 	}
 
-	RTLIL::Design *simplify_something(RTLIL::Design *design, int &seed, bool stage2, bool modules, bool ports, bool cells, bool connections, bool assigns, bool updates)
+	int count_cells(RTLIL::Design *design)
+	{
+		int count = 0;
+		for (auto mod : design->modules())
+			if (!mod->get_blackbox_attribute())
+				count += GetSize(mod->cells_);
+		return count;
+	}
+
+	RTLIL::Design *remove_cell_chunk(RTLIL::Design *design, int seed, int chunk_size)
+	{
+		int begin = seed * chunk_size, end = begin + chunk_size;
+		if (end > count_cells(design))
+			return NULL;
+
+		RTLIL::Design *design_copy = new RTLIL::Design;
+		for (auto &it : design->modules_)
+			design_copy->add(it.second->clone());
+
+		log("Trying to remove cells %d to %d.\n", begin, end-1);
+
+		int index = 0;
+		for (auto mod : design_copy->modules())
+		{
+			if (mod->get_blackbox_attribute())
+				continue;
+
+			std::vector<RTLIL::Cell*> remove_cells;
+			for (auto &it : mod->cells_) {
+				if (index >= begin && index < end)
+					remove_cells.push_back(it.second);
+				index++;
+			}
+			for (auto cell : remove_cells)
+				mod->remove(cell);
+		}
+		return design_copy;
+	}
+
+	RTLIL::Design *simplify_something(RTLIL::Design *design, int seed, bool stage2, bool modules, bool ports, bool cells, bool connections, bool assigns, bool updates)
 	{
 		RTLIL::Design *design_copy = new RTLIL::Design;
 		for (auto &it : design->modules_)
@@ -290,8 +394,12 @@ struct BugpointPass : public Pass {
 
 	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
 	{
-		string yosys_cmd = "yosys", script, grep;
-		bool fast = false, clean = false;
+		yosys_cmd = "yosys";
+		script.clear();
+		grep.clear();
+		fast = false;
+		clean = false;
+		int jobs = 1;
 		bool modules = false, ports = false, cells = false, connections = false, assigns = false, updates = false, has_part = false;
 
 		size_t argidx;
@@ -309,6 +417,10 @@ struct BugpointPass : public Pass {
 				grep = args[++argidx];
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx + 1 < args.size()) {
+				jobs = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
 			if (args[argidx] == "-fast") {
 				fast = true;
 				continue;
@@ -368,45 +480,73 @@ struct BugpointPass : public Pass {
 			log_cmd_error("This command only operates on fully selected designs!\n");
 
 		RTLIL::Design *crashing_design = clean_design(design, clean);
-		if (run_yosys(crashing_design, yosys_cmd, script))
+		if (run_yosys(crashing_design))
 			log_cmd_error("The provided script file and Yosys binary do not crash on this design!\n");
-		if (!check_logfile(grep))
+		if (!check_logfile())
 			log_cmd_error("The provided grep string is not found in the log file!\n");
 
-		int seed = 0;
-		bool found_something = false, stage2 = false;
-		while (true)
+		worker_dirs.clear();
+		if (jobs == 1)
+			worker_dirs.push_back(".");
+		else
+			for (int i = 0; i < jobs; i++)
+				worker_dirs.push_back(make_temp_dir("bugpoint_XXXXXX"));
+
+		auto accept = [&](RTLIL::Design *simplified) {
+			if (crashing_design != design)
+				delete crashing_design;
+			crashing_design = simplified;
+		};
+
+		// remove chunks of half, a quarter, ... of the cells (as in delta debugging) before single cells
+		if (cells)
 		{
-			if (RTLIL::Design *simplified = simplify_something(crashing_design, seed, stage2, modules, ports, cells, connections, assigns, updates))
+			for (int chunk_size = count_cells(crashing_design) / 2; chunk_size >= 2; chunk_size /= 2)
 			{
-				simplified = clean_design(simplified, fast, /*do_delete=*/true);
-
-				bool crashes;
-				if (clean)
+				int seed = 0;
+				while (true)
 				{
-					RTLIL::Design *testcase = clean_design(simplified);
-					crashes = !run_yosys(testcase, yosys_cmd, script);
-					delete testcase;
+					std::vector<RTLIL::Design*> candidates;
+					for (int i = 0; i < jobs; i++)
+						if (RTLIL::Design *simplified = remove_cell_chunk(crashing_design, seed + i, chunk_size))
+							candidates.push_back(simplified);
+						else
+							break;
+					if (candidates.empty())
+						break;
+
+					int count = GetSize(candidates);
+					int found = try_candidates(candidates);
+					if (found >= 0) {
+						accept(candidates[found]);
+						seed += found;
+					} else
+						seed += count;
 				}
+			}
+		}
+
+		int seed = 0;
+		bool found_something = false, stage2 = false;
+		while (true)
+		{
+			std::vector<RTLIL::Design*> candidates;
+			for (int i = 0; i < jobs; i++)
+				if (RTLIL::Design *simplified = simplify_something(crashing_design, seed + i, stage2, modules, ports, cells, connections, assigns, updates))
+					candidates.push_back(simplified);
 				else
-				{
-					crashes = !run_yosys(simplified, yosys_cmd, script);
-				}
+					break;
 
-				if (crashes && check_logfile(grep))
-				{
-					log("Testcase crashes.\n");
-					if (crashing_design != design)
-						delete crashing_design;
-					crashing_design = simplified;
+			if (!candidates.empty())
+			{
+				int count = GetSize(candidates);
+				int found = try_candidates(candidates);
+				if (found >= 0) {
+					accept(candidates[found]);
+					seed += found;
 					found_something = true;
-				}
-				else
-				{
-					log("Testcase does not crash.\n");
-					delete simplified;
-					seed++;
-				}
+				} else
+					seed += count;
 			}
 			else
 			{
@@ -429,6 +569,11 @@ struct BugpointPass : public Pass {
 			}
 		}
 
+		for (auto &dir : worker_dirs)
+			if (dir != ".")
+				remove_directory(dir);
+		worker_dirs.clear();
+
 		if (crashing_design != design)
 		{
 			Pass::call(design, "design -reset");
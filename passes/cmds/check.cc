@@ -20,13 +20,224 @@
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
 #include "kernel/celltypes.h"
-#include "kernel/utils.h"
+#include "kernel/netgraph.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
-struct CheckPass : public Pass {
-	CheckPass() : Pass("check", "check for obvious problems in the design") { }
+struct CheckWorker
+{
+	RTLIL::Module *module;
+	SigMap sigmap;
+	int counter = 0;
+
+	// all (sigmapped) wire bits of the module get a dense index, so that the
+	// analysis works on arrays instead of dicts keyed by SigBit
+	dict<SigBit, int> bit_index;
+	std::vector<SigBit> index_bits;
+
+	CheckWorker(RTLIL::Module *module) : module(module), sigmap(module)
+	{
+		for (auto wire : module->wires())
+			for (auto bit : sigmap(wire))
+				if (bit.wire != nullptr && bit_index.count(bit) == 0) {
+					bit_index[bit] = GetSize(index_bits);
+					index_bits.push_back(bit);
+				}
+	}
+
+	// returns -1 for constants
+	int index_of(const SigBit &bit) const
+	{
+		if (bit.wire == nullptr)
+			return -1;
+		auto it = bit_index.find(bit);
+		return it != bit_index.end() ? it->second : -1;
+	}
+
+	void run(const pool<IdString> &fftypes, bool noinit, bool initdrv, bool mapped, bool allow_tbuf)
+	{
+		RTLIL::Design *design = module->design;
+		int num_bits = GetSize(index_bits);
+
+		// drivers: number of output-only cell ports and input-only module ports
+		// driving a bit, has_driver: also counting bidirectional ports
+		std::vector<int> drivers(num_bits);
+		std::vector<bool> has_driver(num_bits), used(num_bits), init(num_bits);
+
+		// logic graph: bits are nodes 0 .. num_bits-1, followed by one node
+		// for each evaluable cell
+		std::vector<RTLIL::Cell*> logic_cells;
+		std::vector<CsrGraph::Edge> edges;
+
+		for (auto cell : module->cells())
+		{
+			if (mapped && cell->type.begins_with("$") && design->module(cell->type) == nullptr) {
+				if (allow_tbuf && cell->type == ID($_TBUF_)) goto cell_allowed;
+				log_warning("Cell %s.%s is an unmapped internal cell of type %s.\n", log_id(module), log_id(cell), log_id(cell->type));
+				counter++;
+			cell_allowed:;
+			}
+
+			int cell_node = -1;
+			if (yosys_celltypes.cell_evaluable(cell->type)) {
+				cell_node = num_bits + GetSize(logic_cells);
+				logic_cells.push_back(cell);
+			}
+
+			for (auto &conn : cell->connections()) {
+				bool is_input = cell->input(conn.first);
+				bool is_output = cell->output(conn.first);
+				for (auto bit : sigmap(conn.second)) {
+					int index = index_of(bit);
+					if (index < 0)
+						continue;
+					if (is_input) {
+						if (cell_node >= 0)
+							edges.push_back(CsrGraph::Edge{index, cell_node, -1});
+						used[index] = true;
+					}
+					if (is_output) {
+						if (cell_node >= 0)
+							edges.push_back(CsrGraph::Edge{cell_node, index, -1});
+						has_driver[index] = true;
+						if (!is_input)
+							drivers[index]++;
+					}
+				}
+			}
+		}
+
+		for (auto wire : module->wires()) {
+			if (wire->port_input || wire->port_output)
+				for (auto bit : sigmap(wire)) {
+					int index = index_of(bit);
+					if (index < 0)
+						continue;
+					if (wire->port_input)
+						has_driver[index] = true;
+					if (wire->port_output)
+						used[index] = true;
+					if (wire->port_input && !wire->port_output)
+						drivers[index]++;
+				}
+			if (wire->attributes.count("\\init")) {
+				Const initval = wire->attributes.at("\\init");
+				for (int i = 0; i < GetSize(initval) && i < GetSize(wire); i++)
+					if (initval[i] == State::S0 || initval[i] == State::S1) {
+						int index = index_of(sigmap(SigBit(wire, i)));
+						if (index >= 0)
+							init[index] = true;
+					}
+				if (noinit) {
+					log_warning("Wire %s.%s has an unprocessed 'init' attribute.\n", log_id(module), log_id(wire));
+					counter++;
+				}
+			}
+		}
+
+		report_conflicts(drivers);
+
+		for (int i = 0; i < num_bits; i++)
+			if (used[i] && !has_driver[i]) {
+				log_warning("Wire %s.%s is used but has no driver.\n", log_id(module), log_signal(index_bits[i]));
+				counter++;
+			}
+
+		CsrGraph graph;
+		graph.build(num_bits + GetSize(logic_cells), edges);
+		for (auto &loop : graph.find_sccs()) {
+			string message = stringf("found logic loop in module %s:\n", log_id(module));
+			for (int node : loop) {
+				if (node < num_bits) {
+					message += stringf("    wire %s\n", log_signal(index_bits[node]));
+				} else {
+					RTLIL::Cell *cell = logic_cells[node - num_bits];
+					message += stringf("    cell %s (%s)\n", log_id(cell), log_id(cell->type));
+				}
+			}
+			log_warning("%s", message.c_str());
+			counter++;
+		}
+
+		if (initdrv)
+		{
+			for (auto cell : module->cells())
+			{
+				if (fftypes.count(cell->type) == 0)
+					continue;
+
+				for (auto bit : sigmap(cell->getPort("\\Q"))) {
+					int index = index_of(bit);
+					if (index >= 0)
+						init[index] = false;
+				}
+			}
+
+			SigSpec init_sig;
+			for (int i = 0; i < num_bits; i++)
+				if (init[i])
+					init_sig.append(index_bits[i]);
+			init_sig.sort_and_unify();
+
+			for (auto chunk : init_sig.chunks()) {
+				log_warning("Wire %s.%s has 'init' attribute and is not driven by an FF cell.\n", log_id(module), log_signal(chunk));
+				counter++;
+			}
+		}
+	}
+
+	// The driver descriptions are only collected for the bits with conflicts.
+	void report_conflicts(const std::vector<int> &drivers)
+	{
+		int num_bits = GetSize(index_bits);
+		dict<int, std::vector<string>> descriptions;
+
+		for (int i = 0; i < num_bits; i++)
+			if (drivers[i] > 1)
+				descriptions[i];
+
+		if (descriptions.empty())
+			return;
+
+		for (auto cell : module->cells())
+			for (auto &conn : cell->connections()) {
+				if (!cell->output(conn.first))
+					continue;
+				SigSpec sig = sigmap(conn.second);
+				for (int i = 0; i < GetSize(sig); i++) {
+					int index = index_of(sig[i]);
+					if (index >= 0 && descriptions.count(index))
+						descriptions.at(index).push_back(stringf("port %s[%d] of cell %s (%s)",
+								log_id(conn.first), i, log_id(cell), log_id(cell->type)));
+				}
+			}
+
+		for (auto wire : module->wires()) {
+			if (!wire->port_input)
+				continue;
+			SigSpec sig = sigmap(wire);
+			for (int i = 0; i < GetSize(sig); i++) {
+				int index = index_of(sig[i]);
+				if (index >= 0 && descriptions.count(index))
+					descriptions.at(index).push_back(stringf("module input %s[%d]", log_id(wire), i));
+			}
+		}
+
+		for (int i = 0; i < num_bits; i++) {
+			if (drivers[i] <= 1)
+				continue;
+			string message = stringf("multiple conflicting drivers for %s.%s:\n", log_id(module), log_signal(index_bits[i]));
+			for (auto &str : descriptions.at(i))
+				message += stringf("    %s\n", str.c_str());
+			log_warning("%s", message.c_str());
+			counter++;
+		}
+	}
+};
+
+struct CheckPass : public ModulePass {
+	CheckPass() : ModulePass("check", "check for obvious problems in the design") { module_changes_tracked(); }
 	void help() YS_OVERRIDE
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -61,13 +272,28 @@ struct CheckPass : public Pass {
 		log("    Produce a runtime error if any problems are found in the current design.\n");
 		log("\n");
 	}
+	pool<IdString> fftypes;
+	bool noinit, initdrv, mapped, allow_tbuf;
+	std::atomic<int> counter;
+
+	void execute_module(RTLIL::Module *module) YS_OVERRIDE
+	{
+		if (module->has_processes_warn())
+			return;
+
+		log("checking module %s..\n", log_id(module));
+
+		CheckWorker worker(module);
+		worker.run(fftypes, noinit, initdrv, mapped, allow_tbuf);
+		counter += worker.counter;
+	}
+
 	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
 	{
-		int counter = 0;
-		bool noinit = false;
-		bool initdrv = false;
-		bool mapped = false;
-		bool allow_tbuf = false;
+		noinit = false;
+		initdrv = false;
+		mapped = false;
+		allow_tbuf = false;
 		bool assert_mode = false;
 
 		size_t argidx;
@@ -98,7 +324,7 @@ struct CheckPass : public Pass {
 
 		log_header(design, "Executing CHECK pass (checking for obvious problems).\n");
 
-		pool<IdString> fftypes;
+		fftypes.clear();
 		fftypes.insert("$sr");
 		fftypes.insert("$ff");
 		fftypes.insert("$dff");
@@ -141,128 +367,13 @@ struct CheckPass : public Pass {
 		fftypes.insert("$_DLATCH_P_");
 		fftypes.insert("$_FF_");
 
-		for (auto module : design->selected_whole_modules_warn())
-		{
-			if (module->has_processes_warn())
-				continue;
-
-			log("checking module %s..\n", log_id(module));
-
-			SigMap sigmap(module);
-			dict<SigBit, vector<string>> wire_drivers;
-			dict<SigBit, int> wire_drivers_count;
-			pool<SigBit> used_wires;
-			TopoSort<string> topo;
-
-			for (auto cell : module->cells())
-			{
-				if (mapped && cell->type.begins_with("$") && design->module(cell->type) == nullptr) {
-					if (allow_tbuf && cell->type == ID($_TBUF_)) goto cell_allowed;
-					log_warning("Cell %s.%s is an unmapped internal cell of type %s.\n", log_id(module), log_id(cell), log_id(cell->type));
-					counter++;
-				cell_allowed:;
-				}
-				for (auto &conn : cell->connections()) {
-					SigSpec sig = sigmap(conn.second);
-					bool logic_cell = yosys_celltypes.cell_evaluable(cell->type);
-					if (cell->input(conn.first))
-						for (auto bit : sig)
-							if (bit.wire) {
-								if (logic_cell)
-									topo.edge(stringf("wire %s", log_signal(bit)),
-											stringf("cell %s (%s)", log_id(cell), log_id(cell->type)));
-								used_wires.insert(bit);
-							}
-					if (cell->output(conn.first))
-						for (int i = 0; i < GetSize(sig); i++) {
-							if (logic_cell)
-								topo.edge(stringf("cell %s (%s)", log_id(cell), log_id(cell->type)),
-										stringf("wire %s", log_signal(sig[i])));
-							if (sig[i].wire)
-								wire_drivers[sig[i]].push_back(stringf("port %s[%d] of cell %s (%s)",
-										log_id(conn.first), i, log_id(cell), log_id(cell->type)));
-						}
-					if (!cell->input(conn.first) && cell->output(conn.first))
-						for (auto bit : sig)
-							if (bit.wire) wire_drivers_count[bit]++;
-				}
-			}
-
-			pool<SigBit> init_bits;
-
-			for (auto wire : module->wires()) {
-				if (wire->port_input) {
-					SigSpec sig = sigmap(wire);
-					for (int i = 0; i < GetSize(sig); i++)
-						wire_drivers[sig[i]].push_back(stringf("module input %s[%d]", log_id(wire), i));
-				}
-				if (wire->port_output)
-					for (auto bit : sigmap(wire))
-						if (bit.wire) used_wires.insert(bit);
-				if (wire->port_input && !wire->port_output)
-					for (auto bit : sigmap(wire))
-						if (bit.wire) wire_drivers_count[bit]++;
-				if (wire->attributes.count("\\init")) {
-					Const initval = wire->attributes.at("\\init");
-					for (int i = 0; i < GetSize(initval) && i < GetSize(wire); i++)
-						if (initval[i] == State::S0 || initval[i] == State::S1)
-							init_bits.insert(sigmap(SigBit(wire, i)));
-					if (noinit) {
-						log_warning("Wire %s.%s has an unprocessed 'init' attribute.\n", log_id(module), log_id(wire));
-						counter++;
-					}
-				}
-			}
-
-			for (auto it : wire_drivers)
-				if (wire_drivers_count[it.first] > 1) {
-					string message = stringf("multiple conflicting drivers for %s.%s:\n", log_id(module), log_signal(it.first));
-					for (auto str : it.second)
-						message += stringf("    %s\n", str.c_str());
-					log_warning("%s", message.c_str());
-					counter++;
-				}
-
-			for (auto bit : used_wires)
-				if (!wire_drivers.count(bit)) {
-					log_warning("Wire %s.%s is used but has no driver.\n", log_id(module), log_signal(bit));
-					counter++;
-				}
-
-			topo.sort();
-			for (auto &loop : topo.loops) {
-				string message = stringf("found logic loop in module %s:\n", log_id(module));
-				for (auto &str : loop)
-					message += stringf("    %s\n", str.c_str());
-				log_warning("%s", message.c_str());
-				counter++;
-			}
-
-			if (initdrv)
-			{
-				for (auto cell : module->cells())
-				{
-					if (fftypes.count(cell->type) == 0)
-						continue;
-
-					for (auto bit : sigmap(cell->getPort("\\Q")))
-						init_bits.erase(bit);
-				}
-
-				SigSpec init_sig(init_bits);
-				init_sig.sort_and_unify();
-
-				for (auto chunk : init_sig.chunks()) {
-					log_warning("Wire %s.%s has 'init' attribute and is not driven by an FF cell.\n", log_id(module), log_signal(chunk));
-					counter++;
-				}
-			}
-		}
+		counter = 0;
+		execute_modules(design->selected_whole_modules_warn());
 
-		log("found and reported %d problems.\n", counter);
+		log("found and reported %d problems.\n", counter.load());
 
 		if (assert_mode && counter > 0)
-			log_error("Found %d problems in 'check -assert'.\n", counter);
+			log_error("Found %d problems in 'check -assert'.\n", counter.load());
 	}
 } CheckPass;
 
@@ -0,0 +1,365 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "kernel/threadpool.h"
+#include "backends/ilang/ilang_backend.h"
+#include <sstream>
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+// Module::clone() reverses the order of the objects in a module, so the runs
+// start from clones of a clone to see the objects in the original order.
+void clone_modules(RTLIL::Design *from, RTLIL::Design *to)
+{
+	for (auto &it : from->modules_)
+		to->add(it.second->clone());
+}
+
+// keeps the order of the modules
+void move_modules(RTLIL::Design *from, RTLIL::Design *to)
+{
+	std::vector<RTLIL::Module*> modules;
+	for (auto &it : from->modules_)
+		modules.push_back(it.second);
+	from->modules_.clear();
+	for (auto it = modules.rbegin(); it != modules.rend(); ++it)
+		to->add(*it);
+}
+
+void delete_modules(RTLIL::Design *design)
+{
+	for (auto &it : design->modules_)
+		delete it.second;
+	design->modules_.clear();
+}
+
+template<typename T>
+std::vector<RTLIL::IdString> sorted_names(const dict<RTLIL::IdString, T> &a, const dict<RTLIL::IdString, T> &b)
+{
+	std::vector<RTLIL::IdString> names;
+	for (auto &it : a)
+		names.push_back(it.first);
+	for (auto &it : b)
+		if (a.count(it.first) == 0)
+			names.push_back(it.first);
+	std::sort(names.begin(), names.end(), RTLIL::sort_by_id_str());
+	return names;
+}
+
+// the first line in which two dumps differ
+std::string first_difference(const std::string &ref, const std::string &run)
+{
+	std::istringstream ref_stream(ref), run_stream(run);
+	std::string ref_line, run_line;
+	while (1) {
+		bool ref_ok = bool(std::getline(ref_stream, ref_line));
+		bool run_ok = bool(std::getline(run_stream, run_line));
+		if (!ref_ok && !run_ok)
+			return "";
+		if (!ref_ok)
+			ref_line = "(end)";
+		if (!run_ok)
+			run_line = "(end)";
+		if (ref_line != run_line)
+			return stringf("    reference: %s\n    this run:  %s\n", ref_line.c_str(), run_line.c_str());
+	}
+}
+
+struct ModuleComparer
+{
+	RTLIL::Module *ref, *run;
+	std::string diff;
+
+	ModuleComparer(RTLIL::Module *ref, RTLIL::Module *run) : ref(ref), run(run) { }
+
+	template<typename T, typename F>
+	bool compare_objects(const char *kind, const dict<RTLIL::IdString, T*> &ref_objects, const dict<RTLIL::IdString, T*> &run_objects, F dump)
+	{
+		for (auto name : sorted_names(ref_objects, run_objects))
+		{
+			if (run_objects.count(name) == 0) {
+				diff = stringf("%s %s is missing.\n", kind, log_id(name));
+				return true;
+			}
+			if (ref_objects.count(name) == 0) {
+				diff = stringf("%s %s is not in the reference.\n", kind, log_id(name));
+				return true;
+			}
+
+			std::stringstream ref_buf, run_buf;
+			dump(ref_buf, ref_objects.at(name));
+			dump(run_buf, run_objects.at(name));
+			if (ref_buf.str() != run_buf.str()) {
+				diff = stringf("%s %s differs:\n%s", kind, log_id(name), first_difference(ref_buf.str(), run_buf.str()).c_str());
+				return true;
+			}
+		}
+		return false;
+	}
+
+	std::vector<std::string> sorted_connections(RTLIL::Module *module)
+	{
+		std::vector<std::string> result;
+		for (auto &conn : module->connections()) {
+			std::stringstream buf;
+			ILANG_BACKEND::dump_conn(buf, "", conn.first, conn.second);
+			result.push_back(buf.str());
+		}
+		std::sort(result.begin(), result.end());
+		return result;
+	}
+
+	// finds the first difference in the contents of the modules (in the order
+	// of the names) and then in the order of the objects
+	bool compare()
+	{
+		if (ref->content_hash() != run->content_hash())
+		{
+			if (compare_objects("Wire", ref->wires_, run->wires_, [](std::ostream &f, RTLIL::Wire *wire) { ILANG_BACKEND::dump_wire(f, "", wire); }))
+				return true;
+			if (compare_objects("Memory", ref->memories, run->memories, [](std::ostream &f, RTLIL::Memory *memory) { ILANG_BACKEND::dump_memory(f, "", memory); }))
+				return true;
+			if (compare_objects("Cell", ref->cells_, run->cells_, [](std::ostream &f, RTLIL::Cell *cell) { ILANG_BACKEND::dump_cell(f, "", cell); }))
+				return true;
+			if (compare_objects("Process", ref->processes, run->processes, [](std::ostream &f, RTLIL::Process *proc) { ILANG_BACKEND::dump_proc(f, "", proc); }))
+				return true;
+
+			std::vector<std::string> ref_conns = sorted_connections(ref), run_conns = sorted_connections(run);
+			for (int i = 0; i < std::max(GetSize(ref_conns), GetSize(run_conns)); i++)
+				if (i >= GetSize(ref_conns) || i >= GetSize(run_conns) || ref_conns[i] != run_conns[i]) {
+					diff = stringf("Connections differ:\n%s", first_difference(i < GetSize(ref_conns) ? ref_conns[i] : "",
+							i < GetSize(run_conns) ? run_conns[i] : "").c_str());
+					return true;
+				}
+		}
+
+		// same contents, but the order of the objects or the attributes of
+		// the module may still change the output of the backends
+		std::stringstream ref_buf, run_buf;
+		ILANG_BACKEND::dump_module(ref_buf, "", ref, ref->design, false);
+		ILANG_BACKEND::dump_module(run_buf, "", run, run->design, false);
+		if (ref_buf.str() != run_buf.str()) {
+			diff = stringf("Module differs in the order of its contents or its attributes:\n%s",
+					first_difference(ref_buf.str(), run_buf.str()).c_str());
+			return true;
+		}
+
+		return false;
+	}
+};
+
+// the first module (by name) that differs between the two designs, with a
+// description of the difference
+std::string compare_designs(RTLIL::Design *ref, RTLIL::Design *run)
+{
+	for (auto name : sorted_names(ref->modules_, run->modules_))
+	{
+		if (run->module(name) == nullptr)
+			return stringf("Module %s is missing.\n", log_id(name));
+		if (ref->module(name) == nullptr)
+			return stringf("Module %s is not in the reference.\n", log_id(name));
+
+		ModuleComparer comparer(ref->module(name), run->module(name));
+		if (comparer.compare())
+			return stringf("In module %s: %s", log_id(name), comparer.diff.c_str());
+	}
+
+	std::vector<RTLIL::IdString> ref_order, run_order;
+	for (auto &it : ref->modules_)
+		ref_order.push_back(it.first);
+	for (auto &it : run->modules_)
+		run_order.push_back(it.first);
+	if (ref_order != run_order)
+		return "The modules are in a different order.\n";
+
+	return "";
+}
+
+struct CheckDeterminismPass : public Pass {
+	CheckDeterminismPass() : Pass("check_determinism", "check that a command gives the same result with any number of threads") { module_changes_tracked(); }
+	void help() YS_OVERRIDE
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    check_determinism [options] <command>\n");
+		log("\n");
+		log("Execute the command once with a single thread and then several more times on\n");
+		log("copies of the original design with multiple threads, and check that all runs\n");
+		log("produce the same design. The modules are compared with their content digests\n");
+		log("(see 'hash') and their ilang representation, so differences in the order of\n");
+		log("wires, cells etc. are reported as well. The first differing module and object\n");
+		log("is reported as an error.\n");
+		log("\n");
+		log("The design is left as produced by the single threaded run, only the log output\n");
+		log("of that run is printed. All runs start with the same value of the counter for\n");
+		log("auto-generated names. Options of the command that set a number of threads\n");
+		log("(like '-j') take precedence over the settings used here.\n");
+		log("\n");
+		log("    -j <N>\n");
+		log("        number of threads for the checked runs. the default is the number\n");
+		log("        set with 'yosys -j' or 4 if that is 1.\n");
+		log("\n");
+		log("    -runs <N>\n");
+		log("        number of runs with multiple threads (default: 3). all runs but the\n");
+		log("        first one shuffle the scheduling of the tasks, see -seed.\n");
+		log("\n");
+		log("    -seed <N>\n");
+		log("        seed for shuffling the scheduling (default: 1). tasks are delayed by\n");
+		log("        pseudo-random amounts and idle threads pick up work in a pseudo-random\n");
+		log("        order.\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
+	{
+		int num_threads = yosys_threads > 1 ? yosys_threads : 4;
+		int num_runs = 3;
+		unsigned int seed = 1;
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-runs" && argidx+1 < args.size()) {
+				num_runs = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-seed" && argidx+1 < args.size()) {
+				seed = atoi(args[++argidx].c_str());
+				continue;
+			}
+			break;
+		}
+
+		if (argidx >= args.size())
+			log_cmd_error("Missing command.\n");
+		if (num_threads < 2)
+			log_cmd_error("The checked runs need at least 2 threads.\n");
+		if (num_runs < 1)
+			log_cmd_error("At least one checked run is needed.\n");
+
+		std::vector<std::string> command(args.begin() + argidx, args.end());
+		std::string command_str;
+		for (auto &arg : command)
+			command_str += (command_str.empty() ? "" : " ") + arg;
+
+		log_header(design, "Executing CHECK_DETERMINISM pass (running `%s' with 1 and %d threads).\n",
+				command_str.c_str(), num_threads);
+		log_push();
+
+		RTLIL::Design *input = new RTLIL::Design;
+		clone_modules(design, input);
+		input->selection_stack = design->selection_stack;
+		input->selection_vars = design->selection_vars;
+		input->selected_active_module = design->selected_active_module;
+
+		int saved_threads = yosys_threads;
+		int start_autoidx = autoidx, end_autoidx;
+
+		try {
+			yosys_threads = 1;
+			Pass::call(design, command);
+			yosys_threads = saved_threads;
+		} catch (...) {
+			yosys_threads = saved_threads;
+			delete input;
+			throw;
+		}
+		end_autoidx = autoidx;
+
+		// the reference is moved aside while the checked runs use the design
+		RTLIL::Design *reference = new RTLIL::Design;
+		move_modules(design, reference);
+		reference->selection_stack = design->selection_stack;
+		reference->selection_vars = design->selection_vars;
+		reference->selected_active_module = design->selected_active_module;
+
+		std::vector<FILE*> backup_log_files = log_files;
+		std::vector<std::ostream*> backup_log_streams = log_streams;
+		std::string diff;
+		int failed_run = 0;
+
+		auto restore = [&]() {
+			log_files = backup_log_files;
+			log_streams = backup_log_streams;
+			yosys_threads = saved_threads;
+			threadpool_shuffle(0);
+			autoidx = std::max(end_autoidx, autoidx.load());
+
+			delete_modules(design);
+			move_modules(reference, design);
+			design->selection_stack = reference->selection_stack;
+			design->selection_vars = reference->selection_vars;
+			design->selected_active_module = reference->selected_active_module;
+
+			delete reference;
+			delete input;
+		};
+
+		for (int run = 1; run <= num_runs && diff.empty(); run++)
+		{
+			unsigned int run_seed = run > 1 ? mkhash_xorshift(mkhash(seed, run)) | 1 : 0;
+			log("Checked run %d with %d threads%s.\n", run, num_threads, run_seed ? stringf(" (shuffle seed %u)", run_seed).c_str() : "");
+
+			delete_modules(design);
+			clone_modules(input, design);
+			design->selection_stack = input->selection_stack;
+			design->selection_vars = input->selection_vars;
+			design->selected_active_module = input->selected_active_module;
+
+			autoidx = start_autoidx;
+			yosys_threads = num_threads;
+			threadpool_shuffle(run_seed);
+			log_flush();
+			log_files.clear();
+			log_streams.clear();
+
+			try {
+				Pass::call(design, command);
+			} catch (...) {
+				restore();
+				throw;
+			}
+
+			log_flush();
+			log_files = backup_log_files;
+			log_streams = backup_log_streams;
+			yosys_threads = saved_threads;
+			threadpool_shuffle(0);
+			end_autoidx = std::max(end_autoidx, autoidx.load());
+
+			diff = compare_designs(reference, design);
+			failed_run = run;
+		}
+
+		restore();
+		log_pop();
+
+		if (!diff.empty())
+			log_error("Run %d with %d threads differs from the run with 1 thread:\n%s", failed_run, num_threads, diff.c_str());
+
+		log("All %d runs with %d threads match the run with 1 thread.\n", num_runs, num_threads);
+	}
+} CheckDeterminismPass;
+
+PRIVATE_NAMESPACE_END
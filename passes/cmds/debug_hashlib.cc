@@ -0,0 +1,179 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+#ifdef HASHLIB_STATS
+// The records are named after the function that creates them, e.g. (GCC)
+// "static hashlib::hashtable_stats& hashlib::dict<K, T, OPS>::stats() [with K = ...; ...]",
+// this turns it into "dict [K = ...; ...]".
+std::string short_name(const std::string &name)
+{
+	std::string kind = name.find("hashlib::dict<") != std::string::npos ? "dict" : "pool";
+
+	std::string args;
+	size_t pos = name.find("stats() [");
+	if (pos != std::string::npos) {
+		args = name.substr(pos + 9);
+		if (!args.empty() && args.back() == ']')
+			args.pop_back();
+		if (args.compare(0, 5, "with ") == 0)
+			args = args.substr(5);
+	}
+
+	for (auto prefix : {"Yosys::", "hashlib::"})
+		for (pos = args.find(prefix); pos != std::string::npos; pos = args.find(prefix, pos))
+			args.erase(pos, strlen(prefix));
+
+	return args.empty() ? kind : kind + " [" + args + "]";
+}
+#endif
+
+struct DebugHashlibPass : public Pass {
+	DebugHashlibPass() : Pass("debug_hashlib", "print statistics of the dict/pool hashtables") { }
+	void help() YS_OVERRIDE
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    debug_hashlib [options] [pattern]\n");
+		log("\n");
+		log("Print the statistics of the hashtables of dict<>, pool<> and idict<> (see\n");
+		log("kernel/hashlib.h) since the start or the last reset, one line per container\n");
+		log("type, sorted by the number of probes:\n");
+		log("\n");
+		log("    lookups    lookups in a hashtable\n");
+		log("    probes     average number of entries compared per lookup\n");
+		log("    max        largest number of entries compared in a single lookup\n");
+		log("    linear     lookups in small dicts without a hashtable\n");
+		log("    rehashes   number of times a hashtable was built (growing, copies)\n");
+		log("    chain      average length of the non-empty hash chains after a rehash\n");
+		log("    ideal      the same for a uniformly distributed hash function, a chain\n");
+		log("               length well above this points at a weak hash function\n");
+		log("    longest    longest hash chain after any rehash\n");
+		log("\n");
+		log("Only types with at least one lookup or rehash are printed. When one or more\n");
+		log("patterns (shell wildcards) are specified, then only types matching at least\n");
+		log("one pattern are printed, e.g. 'dict*SigBit*'.\n");
+		log("\n");
+		log("    -n <N>\n");
+		log("        print at most N types (default: 20, 0 for all)\n");
+		log("\n");
+		log("    -sizes\n");
+		log("        also print how many containers of each type were destroyed with\n");
+		log("        a size in each power-of-two range\n");
+		log("\n");
+		log("    -reset\n");
+		log("        reset all statistics after printing them\n");
+		log("\n");
+		log("The statistics are only collected when Yosys is built with\n");
+		log("ENABLE_HASHLIB_STATS=1, which slows down all lookups.\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
+	{
+		std::vector<std::string> patterns;
+		bool reset = false, sizes = false;
+		int max_types = 20;
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-reset") {
+				reset = true;
+				continue;
+			}
+			if (args[argidx] == "-sizes") {
+				sizes = true;
+				continue;
+			}
+			if (args[argidx] == "-n" && argidx+1 < args.size()) {
+				max_types = atoi(args[++argidx].c_str());
+				continue;
+			}
+			break;
+		}
+		while (argidx < args.size() && args[argidx].compare(0, 1, "-") != 0)
+			patterns.push_back(args[argidx++]);
+		extra_args(args, argidx, design, false);
+
+		log_header(design, "Printing hashtable statistics.\n");
+		log("\n");
+
+#ifndef HASHLIB_STATS
+		(void)reset, (void)sizes, (void)max_types;
+		log("Yosys was built without hashtable statistics (ENABLE_HASHLIB_STATS=1).\n");
+#else
+		std::vector<std::pair<std::string, hashlib::hashtable_stats*>> records;
+		for (auto data = hashlib::hashtable_stats::first().load(); data != nullptr; data = data->next) {
+			if (data->lookups == 0 && data->linear_lookups == 0 && data->rehashes == 0)
+				continue;
+			std::string name = short_name(data->name);
+			if (!patterns.empty()) {
+				for (auto &p : patterns)
+					if (patmatch(p.c_str(), name.c_str()))
+						goto pattern_match;
+				continue;
+			}
+		pattern_match:
+			records.push_back({name, data});
+		}
+
+		std::sort(records.begin(), records.end(), [](const std::pair<std::string, hashlib::hashtable_stats*> &a,
+				const std::pair<std::string, hashlib::hashtable_stats*> &b) {
+			return a.second->probes > b.second->probes;
+		});
+		if (max_types > 0 && GetSize(records) > max_types)
+			records.resize(max_types);
+
+		log("   %12s %7s %5s %12s %9s %7s %7s %7s   %s\n", "lookups", "probes", "max", "linear", "rehashes", "chain", "ideal", "longest", "type");
+		for (auto &it : records) {
+			hashlib::hashtable_stats &data = *it.second;
+			unsigned long long lookups = data.lookups, entries = data.rehash_entries;
+			log("   %12llu %7.2f %5llu %12llu %9llu %7.2f %7.2f %7llu   %s\n", lookups,
+					lookups ? double(data.probes) / lookups : 0.0, (unsigned long long)data.max_probes,
+					(unsigned long long)data.linear_lookups, (unsigned long long)data.rehashes,
+					data.rehash_used ? double(entries) / data.rehash_used : 0.0,
+					data.rehash_ideal ? double(entries) / data.rehash_ideal : 0.0,
+					(unsigned long long)data.max_chain, it.first.c_str());
+		}
+
+		if (sizes)
+			for (auto &it : records) {
+				hashlib::hashtable_stats &data = *it.second;
+				log("\nSizes of destroyed containers of type %s:\n", it.first.c_str());
+				for (int i = 0; i < hashlib::hashtable_stats::num_size_buckets; i++) {
+					unsigned long long count = data.sizes[i];
+					if (count == 0)
+						continue;
+					unsigned long long low = 1ULL << (i-1), high = (1ULL << i) - 1;
+					log("   %12llu .. %-12llu %12llu\n", low, high, count);
+				}
+			}
+
+		if (reset)
+			for (auto data = hashlib::hashtable_stats::first().load(); data != nullptr; data = data->next)
+				data->reset();
+#endif
+	}
+} DebugHashlibPass;
+
+PRIVATE_NAMESPACE_END
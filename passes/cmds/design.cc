@@ -19,14 +19,68 @@
 
 #include "kernel/yosys.h"
 #include "frontends/ast/ast.h"
+#include "backends/rtlil_bin/rtlil_bin.h"
+#include <errno.h>
 
 YOSYS_NAMESPACE_BEGIN
 
 std::map<std::string, RTLIL::Design*> saved_designs;
 std::vector<RTLIL::Design*> pushed_designs;
 
+// designs saved with "design -save <name> -file <filename>"
+static std::map<std::string, std::string> spilled_designs;
+
+static bool saved_design_exists(const std::string &name)
+{
+	return saved_designs.count(name) != 0 || spilled_designs.count(name) != 0;
+}
+
+// read a design saved to a file back into saved_designs
+static void unspill_design(const std::string &name)
+{
+	if (spilled_designs.count(name) == 0)
+		return;
+
+	RTLIL::Design *saved_design = new RTLIL::Design;
+	if (!RTLIL_BIN::read_file(spilled_designs.at(name), saved_design))
+		log_cmd_error("Can't read saved design '%s' from file `%s'.\n", name.c_str(), spilled_designs.at(name).c_str());
+
+	saved_designs[name] = saved_design;
+	spilled_designs.erase(name);
+}
+
+// Modules of the current design that are identical to a module of a saved
+// design, keyed by the saved module. Both modules are recorded with their
+// hashidx_ and generation at the time of the copy, so a module that has not
+// changed since does not need to be copied again by "design -save" or
+// "design -load".
+struct module_twin_t {
+	unsigned int hashidx, generation;
+	unsigned int saved_hashidx, saved_generation;
+};
+static dict<RTLIL::Module*, module_twin_t> module_twins;
+
+static void link_twins(RTLIL::Module *module, RTLIL::Module *saved_module)
+{
+	module_twins[saved_module] = {module->hashidx_, module->generation, saved_module->hashidx_, saved_module->generation};
+}
+
+static bool is_twin(RTLIL::Module *module, RTLIL::Module *saved_module)
+{
+	auto it = module_twins.find(saved_module);
+	return it != module_twins.end() && it->second.hashidx == module->hashidx_ && it->second.generation == module->generation &&
+			it->second.saved_hashidx == saved_module->hashidx_ && it->second.saved_generation == saved_module->generation;
+}
+
+static void delete_saved_design(RTLIL::Design *saved_design)
+{
+	for (auto &it : saved_design->modules_)
+		module_twins.erase(it.second);
+	delete saved_design;
+}
+
 struct DesignPass : public Pass {
-	DesignPass() : Pass("design", "save, restore and reset current design") { }
+	DesignPass() : Pass("design", "save, restore and reset current design") { module_changes_tracked(); }
 	~DesignPass() YS_OVERRIDE {
 		for (auto &it : saved_designs)
 			delete it.second;
@@ -44,12 +98,20 @@ struct DesignPass : public Pass {
 		log("Clear the current design.\n");
 		log("\n");
 		log("\n");
-		log("    design -save <name>\n");
+		log("    design -save <name> [-file <filename>]\n");
+		log("\n");
+		log("Save the current design under the given name. Modules that have not changed\n");
+		log("since they were last saved under this name or loaded from it are not copied\n");
+		log("again.\n");
 		log("\n");
-		log("Save the current design under the given name.\n");
+		log("With -file, the design is written to the given file in the binary RTLIL\n");
+		log("format (see 'write_rtlil_bin') instead of keeping a copy in memory, and read\n");
+		log("back from there when it is used. The selection is not saved in this case, and\n");
+		log("such a design can not be used with the '%%<name>' syntax of 'techmap -map'\n");
+		log("and 'extract -map'.\n");
 		log("\n");
 		log("\n");
-		log("    design -stash <name>\n");
+		log("    design -stash <name> [-file <filename>]\n");
 		log("\n");
 		log("Save the current design under the given name and then clear the current design.\n");
 		log("\n");
@@ -67,7 +129,8 @@ struct DesignPass : public Pass {
 		log("    design -load <name>\n");
 		log("\n");
 		log("Reset the current design and load the design previously saved under the given\n");
-		log("name.\n");
+		log("name. Modules of the current design that have not changed since they were saved\n");
+		log("under this name or loaded from it are kept instead of being copied again.\n");
 		log("\n");
 		log("\n");
 		log("    design -copy-from <name> [-as <new_mod_name>] <selection>\n");
@@ -103,7 +166,7 @@ struct DesignPass : public Pass {
 		bool pop_mode = false;
 		bool import_mode = false;
 		RTLIL::Design *copy_from_design = NULL, *copy_to_design = NULL;
-		std::string save_name, load_name, as_name;
+		std::string save_name, save_file, load_name, as_name;
 		std::vector<RTLIL::Module*> copy_src_modules;
 
 		size_t argidx;
@@ -144,21 +207,23 @@ struct DesignPass : public Pass {
 			if (!got_mode && args[argidx] == "-load" && argidx+1 < args.size()) {
 				got_mode = true;
 				load_name = args[++argidx];
-				if (saved_designs.count(load_name) == 0)
+				if (!saved_design_exists(load_name))
 					log_cmd_error("No saved design '%s' found!\n", load_name.c_str());
 				continue;
 			}
 			if (!got_mode && args[argidx] == "-copy-from" && argidx+1 < args.size()) {
 				got_mode = true;
-				if (saved_designs.count(args[++argidx]) == 0)
+				if (!saved_design_exists(args[++argidx]))
 					log_cmd_error("No saved design '%s' found!\n", args[argidx].c_str());
+				unspill_design(args[argidx]);
 				copy_from_design = saved_designs.at(args[argidx]);
 				copy_to_design = design;
 				continue;
 			}
 			if (!got_mode && args[argidx] == "-copy-to" && argidx+1 < args.size()) {
 				got_mode = true;
-				if (saved_designs.count(args[++argidx]) == 0)
+				unspill_design(args[++argidx]);
+				if (saved_designs.count(args[argidx]) == 0)
 					saved_designs[args[argidx]] = new RTLIL::Design;
 				copy_to_design = saved_designs.at(args[argidx]);
 				copy_from_design = design;
@@ -167,13 +232,18 @@ struct DesignPass : public Pass {
 			if (!got_mode && args[argidx] == "-import" && argidx+1 < args.size()) {
 				got_mode = true;
 				import_mode = true;
-				if (saved_designs.count(args[++argidx]) == 0)
+				if (!saved_design_exists(args[++argidx]))
 					log_cmd_error("No saved design '%s' found!\n", args[argidx].c_str());
+				unspill_design(args[argidx]);
 				copy_from_design = saved_designs.at(args[argidx]);
 				copy_to_design = design;
 				as_name = args[argidx];
 				continue;
 			}
+			if (!save_name.empty() && args[argidx] == "-file" && argidx+1 < args.size()) {
+				save_file = args[++argidx];
+				continue;
+			}
 			if (copy_from_design != NULL && args[argidx] == "-as" && argidx+1 < args.size()) {
 				as_name = args[++argidx];
 				continue;
@@ -303,19 +373,55 @@ struct DesignPass : public Pass {
 			}
 		}
 
-		if (!save_name.empty() || push_mode)
+		if (!save_file.empty())
+		{
+			std::ofstream f(save_file.c_str(), std::ofstream::binary);
+			if (f.fail())
+				log_cmd_error("Can't open file `%s' for writing: %s\n", save_file.c_str(), strerror(errno));
+			RTLIL_BIN::write_design(f, design);
+			f.close();
+			if (f.fail())
+				log_cmd_error("Writing design to file `%s' failed.\n", save_file.c_str());
+
+			if (saved_designs.count(save_name)) {
+				delete saved_designs.at(save_name);
+				saved_designs.erase(save_name);
+			}
+			spilled_designs[save_name] = save_file;
+		}
+		else if (!save_name.empty() || push_mode)
 		{
+			spilled_designs.erase(save_name);
+
 			RTLIL::Design *design_copy = new RTLIL::Design;
+			RTLIL::Design *old_copy = push_mode || saved_designs.count(save_name) == 0 ? nullptr : saved_designs.at(save_name);
 
-			for (auto &it : design->modules_)
-				design_copy->add(it.second->clone());
+			if (push_mode || reset_mode)
+			{
+				// the current design is cleared below, so the modules can be moved
+				for (auto &it : design->modules_)
+					design_copy->add(it.second);
+				design->modules_.clear();
+			}
+			else
+			{
+				for (auto &it : design->modules_) {
+					RTLIL::Module *saved_module = old_copy ? old_copy->module(it.first) : nullptr;
+					if (saved_module != nullptr && is_twin(it.second, saved_module))
+						old_copy->modules_.erase(it.first);
+					else
+						saved_module = it.second->clone();
+					design_copy->add(saved_module);
+					link_twins(it.second, saved_module);
+				}
+			}
 
 			design_copy->selection_stack = design->selection_stack;
 			design_copy->selection_vars = design->selection_vars;
 			design_copy->selected_active_module = design->selected_active_module;
 
-			if (saved_designs.count(save_name))
-				delete saved_designs.at(save_name);
+			if (old_copy != nullptr)
+				delete_saved_design(old_copy);
 
 			if (push_mode)
 				pushed_designs.push_back(design_copy);
@@ -323,8 +429,19 @@ struct DesignPass : public Pass {
 				saved_designs[save_name] = design_copy;
 		}
 
+		dict<RTLIL::IdString, RTLIL::Module*> kept_modules;
+
 		if (reset_mode || !load_name.empty() || push_mode || pop_mode)
 		{
+			if (!load_name.empty() && saved_designs.count(load_name))
+				for (auto &it : saved_designs.at(load_name)->modules_) {
+					RTLIL::Module *module = design->module(it.first);
+					if (module != nullptr && is_twin(module, it.second)) {
+						kept_modules[it.first] = module;
+						design->modules_.erase(it.first);
+					}
+				}
+
 			for (auto &it : design->modules_)
 				delete it.second;
 			design->modules_.clear();
@@ -349,12 +466,33 @@ struct DesignPass : public Pass {
 			design->verilog_defines.clear();
 		}
 
-		if (!load_name.empty() || pop_mode)
+		if (spilled_designs.count(load_name))
+		{
+			if (!RTLIL_BIN::read_file(spilled_designs.at(load_name), design))
+				log_cmd_error("Can't read saved design '%s' from file `%s'.\n", load_name.c_str(), spilled_designs.at(load_name).c_str());
+		}
+		else if (!load_name.empty() || pop_mode)
 		{
 			RTLIL::Design *saved_design = pop_mode ? pushed_designs.back() : saved_designs.at(load_name);
 
-			for (auto &it : saved_design->modules_)
-				design->add(it.second->clone());
+			if (pop_mode)
+			{
+				for (auto &it : saved_design->modules_)
+					design->add(it.second);
+				saved_design->modules_.clear();
+			}
+			else
+			{
+				for (auto &it : saved_design->modules_) {
+					if (kept_modules.count(it.first)) {
+						design->add(kept_modules.at(it.first));
+						continue;
+					}
+					RTLIL::Module *module = it.second->clone();
+					design->add(module);
+					link_twins(module, it.second);
+				}
+			}
 
 			design->selection_stack = saved_design->selection_stack;
 			design->selection_vars = saved_design->selection_vars;
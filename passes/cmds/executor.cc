@@ -0,0 +1,183 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *                2019  Nina Engelhardt <nak@symbioticeda.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#include "kernel/yosys.h"
+
+#ifndef _WIN32
+#  include <unistd.h>
+#endif
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+std::string shell_quote(const std::string &str)
+{
+	std::string result = "'";
+	for (char c : str) {
+		if (c == '\'')
+			result += "'\\''";
+		else
+			result += c;
+	}
+	return result + "'";
+}
+
+std::string current_dir()
+{
+#ifndef _WIN32
+	char buf[PATH_MAX];
+	if (getcwd(buf, sizeof(buf)) != nullptr)
+		return buf;
+#endif
+	return ".";
+}
+
+struct LauncherExecutor : ToolExecutor
+{
+	std::string launcher, stage_in, stage_out;
+
+	std::string expand(const std::string &pattern, const std::string &command, const std::string &workdir)
+	{
+		std::string dir = is_absolute_path(workdir) ? workdir : current_dir() + "/" + workdir;
+		std::string result;
+		for (size_t i = 0; i < pattern.size(); i++) {
+			if (pattern[i] != '%' || i+1 == pattern.size()) {
+				result += pattern[i];
+				continue;
+			}
+			switch (pattern[++i]) {
+				case 'c': result += shell_quote(command); break;
+				case 'd': result += shell_quote(dir); break;
+				case 'p': result += shell_quote(current_dir()); break;
+				default: result += pattern[i];
+			}
+		}
+		return result;
+	}
+
+	std::string command(const std::string &command, const std::string &workdir) YS_OVERRIDE
+	{
+		std::string result = launcher.empty() ? command : expand(launcher, command, workdir);
+		if (!stage_in.empty())
+			result = stringf("%s && %s", expand(stage_in, command, workdir).c_str(), result.c_str());
+		if (!stage_out.empty())
+			result = stringf("{ %s; }; ret=$?; %s; exit $ret", result.c_str(), expand(stage_out, command, workdir).c_str());
+		return result;
+	}
+};
+
+struct ExecutorPass : public Pass {
+	ExecutorPass() : Pass("executor", "configure how external tools are started") { }
+	void help() YS_OVERRIDE
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    executor [options]\n");
+		log("\n");
+		log("Configure how the external tools of 'abc', 'abc9_exe' and 'bugpoint' are\n");
+		log("started, e.g. to distribute the ABC jobs of 'abc -j' or 'abc -partition' over\n");
+		log("the nodes of a compute farm. Without options the current setting is printed.\n");
+		log("\n");
+		log("    -launcher <pattern>\n");
+		log("        run the command given by the pattern instead of the tool command.\n");
+		log("        the pattern is run by the shell and must block until the tool has\n");
+		log("        finished, and pass its output and return code on.\n");
+		log("\n");
+		log("    -stage-in <pattern>\n");
+		log("        run this command before the launcher, e.g. to copy the working\n");
+		log("        directory of the tool to the node that runs it\n");
+		log("\n");
+		log("    -stage-out <pattern>\n");
+		log("        run this command after the launcher, e.g. to copy the results back\n");
+		log("\n");
+		log("    -local\n");
+		log("        start the tools on the local host again (default)\n");
+		log("\n");
+		log("In the patterns, %%c is replaced by the tool command, %%d by the working\n");
+		log("directory of the tool and %%p by the current directory, each quoted for the\n");
+		log("shell. The tool command may use paths relative to the current directory and\n");
+		log("shell redirections, so it should be run with 'sh -c %%c' from %%p. Patterns that\n");
+		log("contain whitespace must be enclosed in double quotes. For example:\n");
+		log("\n");
+		log("    executor -launcher \"srun --chdir=%%p sh -c %%c\"\n");
+		log("\n");
+		log("The ABC co-process of 'abc -coproc' is always started on the local host.\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design*) YS_OVERRIDE
+	{
+		static LauncherExecutor executor;
+		bool local_mode = false, changed = false;
+
+		auto unquote = [](std::string value) {
+			if (value.size() >= 2 && value.front() == '\"' && value.back() == '\"')
+				value = value.substr(1, value.size() - 2);
+			return value;
+		};
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-launcher" && argidx+1 < args.size()) {
+				executor.launcher = unquote(args[++argidx]);
+				changed = true;
+				continue;
+			}
+			if (args[argidx] == "-stage-in" && argidx+1 < args.size()) {
+				executor.stage_in = unquote(args[++argidx]);
+				changed = true;
+				continue;
+			}
+			if (args[argidx] == "-stage-out" && argidx+1 < args.size()) {
+				executor.stage_out = unquote(args[++argidx]);
+				changed = true;
+				continue;
+			}
+			if (args[argidx] == "-local") {
+				local_mode = true;
+				continue;
+			}
+			break;
+		}
+		if (argidx != args.size())
+			cmd_error(args, argidx, "Unknown option or option in arguments.");
+
+		if (local_mode) {
+			executor = LauncherExecutor();
+			if (yosys_tool_executor == &executor)
+				yosys_tool_executor = nullptr;
+		} else if (changed) {
+			if (yosys_tool_executor != nullptr && yosys_tool_executor != &executor)
+				log_cmd_error("The tool executor was replaced by a plugin.\n");
+			yosys_tool_executor = &executor;
+		}
+
+		if (yosys_tool_executor == nullptr)
+			log("Tools are started on the local host.\n");
+		else if (yosys_tool_executor != &executor)
+			log("Tools are started by an executor from a plugin.\n");
+		else {
+			log("Launcher:  %s\n", executor.launcher.empty() ? "(none)" : executor.launcher.c_str());
+			log("Stage in:  %s\n", executor.stage_in.empty() ? "(none)" : executor.stage_in.c_str());
+			log("Stage out: %s\n", executor.stage_out.empty() ? "(none)" : executor.stage_out.c_str());
+		}
+	}
+} ExecutorPass;
+
+PRIVATE_NAMESPACE_END
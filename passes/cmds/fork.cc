@@ -0,0 +1,367 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "backends/rtlil_bin/rtlil_bin.h"
+
+#ifndef _WIN32
+#  include <sys/wait.h>
+#  include <unistd.h>
+#endif
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+struct ForkBranch
+{
+	std::string name;
+	std::vector<std::string> commands;
+
+	// results, filled in by the parent after the branch process finished
+	bool ok = false;
+	double metric = 0;
+	std::string metric_str;
+	std::string log_file, design_file, metric_file;
+};
+
+std::string unquote(const std::string &str)
+{
+	if (str.size() >= 2 && str.front() == '"' && str.back() == '"')
+		return str.substr(1, str.size()-2);
+	return str;
+}
+
+// Reads the branches of a script block up to the "join" line from the
+// script file that is currently executed.
+void read_script_block(std::vector<ForkBranch> &branches)
+{
+	if (Frontend::current_script_file == nullptr)
+		log_cmd_error("A fork block without -branch options is only possible in a script file.\n");
+
+	std::string command;
+	while (1) {
+		if (!fgetline(Frontend::current_script_file, command))
+			log_cmd_error("Unexpected end of file in fork block, missing 'join'.\n");
+		while (!command.empty() && command[command.size()-1] == '\\') {
+			std::string next_line;
+			if (!fgetline(Frontend::current_script_file, next_line))
+				break;
+			command.resize(command.size()-1);
+			command += next_line;
+		}
+
+		std::string buf = command;
+		std::string tok = next_token(buf, " \t\r\n");
+		if (tok.empty() || tok[0] == '#')
+			continue;
+		if (tok == "join")
+			break;
+		if (tok == "branch") {
+			ForkBranch branch;
+			branch.name = next_token(buf, " \t\r\n");
+			if (branch.name.empty())
+				branch.name = stringf("%d", GetSize(branches) + 1);
+			branches.push_back(branch);
+			continue;
+		}
+		if (branches.empty())
+			log_cmd_error("Command `%s' in fork block before the first 'branch' line.\n", command.c_str());
+		branches.back().commands.push_back(command);
+	}
+}
+
+#ifndef _WIN32
+
+// Runs in the forked process: executes the commands of the branch with the
+// log going to a file, then writes the metric and the resulting design.
+int run_branch(RTLIL::Design *design, const ForkBranch &branch, const std::string &stat_args, const std::string &metric)
+{
+	FILE *log_f = fopen(branch.log_file.c_str(), "w");
+	if (log_f == nullptr)
+		return 1;
+
+	log_files = std::vector<FILE*>{log_f};
+	log_streams.clear();
+	log_errfile = nullptr;
+	log_error_stderr = false;
+	log_cmd_error_throw = true;
+	Frontend::current_script_file = nullptr;
+
+	try {
+		for (auto &command : branch.commands) {
+			Pass::call(design, command);
+			design->check();
+		}
+		Pass::call(design, "stat " + stat_args);
+	} catch (log_cmd_error_exception) {
+		log_flush();
+		return 1;
+	}
+
+	std::string value = design->scratchpad_get_string("stat." + metric);
+	if (value.empty()) {
+		log("Metric `stat.%s' not found in the scratchpad.\n", metric.c_str());
+		log_flush();
+		return 1;
+	}
+
+	std::ofstream f(branch.design_file.c_str(), std::ofstream::binary);
+	RTLIL_BIN::write_design(f, design);
+	f.close();
+
+	std::ofstream mf(branch.metric_file.c_str());
+	mf << value << "\n";
+	mf.close();
+
+	log_flush();
+	return f.fail() || mf.fail() ? 1 : 0;
+}
+
+#endif
+
+struct ForkPass : public Pass {
+	ForkPass() : Pass("fork", "try alternative scripts concurrently and keep the best result") { }
+	void help() YS_OVERRIDE
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    fork [options]\n");
+		log("    branch <name>\n");
+		log("        <commands>\n");
+		log("    branch <name>\n");
+		log("        <commands>\n");
+		log("    ...\n");
+		log("    join\n");
+		log("\n");
+		log("    fork [options] -branch <name> \"<commands>\" -branch <name> \"<commands>\" ...\n");
+		log("\n");
+		log("Run each branch on its own copy of the current design and continue with the\n");
+		log("design of the branch with the best value of a 'stat' metric. This replaces\n");
+		log("running one yosys process per strategy that all read the design again. For\n");
+		log("example:\n");
+		log("\n");
+		log("    fork -metric area -stat \"-liberty cells.lib\"\n");
+		log("    branch dress\n");
+		log("        abc -dress -liberty cells.lib\n");
+		log("    branch delay\n");
+		log("        abc -D 1000 -liberty cells.lib\n");
+		log("    join\n");
+		log("\n");
+		log("The first form reads the branches from the following lines of the script\n");
+		log("file, up to the 'join' line. The second form can also be used with 'yosys\n");
+		log("-p', the commands of a branch are separated by semicolons.\n");
+		log("\n");
+		log("Each branch is run in a forked copy of the yosys process, which shares the\n");
+		log("memory of the design with the parent process until it modifies it. The\n");
+		log("branches run in parallel. After its commands, each branch runs 'stat' and\n");
+		log("reports the chosen total from the scratchpad (see 'help stat'). The design of\n");
+		log("the winning branch is then loaded, its name and metric are stored in the\n");
+		log("scratchpad as fork.winner and stat.<metric>, and its log output is printed.\n");
+		log("A branch that fails with an error does not take part in the selection.\n");
+		log("\n");
+		log("    -metric <name>\n");
+		log("        the 'stat' total to compare, e.g. num_cells, area or num_wires.\n");
+		log("        default: num_cells\n");
+		log("\n");
+		log("    -max\n");
+		log("        keep the branch with the largest value instead of the smallest.\n");
+		log("        of branches with equal values, the first one is kept.\n");
+		log("\n");
+		log("    -stat \"<options>\"\n");
+		log("        options for the 'stat' command, e.g. \"-liberty cells.lib\"\n");
+		log("\n");
+		log("    -j <N>\n");
+		log("        run at most N branches at the same time. default: all\n");
+		log("\n");
+		log("    -v\n");
+		log("        print the log output of all branches, not just of the winner.\n");
+		log("\n");
+		log("This command is not available on Windows.\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
+	{
+		std::vector<ForkBranch> branches;
+		std::string metric = "num_cells", stat_args;
+		bool max_mode = false, verbose = false;
+		int max_jobs = 0;
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-metric" && argidx+1 < args.size()) {
+				metric = args[++argidx];
+				continue;
+			}
+			if (args[argidx] == "-max") {
+				max_mode = true;
+				continue;
+			}
+			if (args[argidx] == "-stat" && argidx+1 < args.size()) {
+				stat_args = unquote(args[++argidx]);
+				continue;
+			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				max_jobs = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-v") {
+				verbose = true;
+				continue;
+			}
+			if (args[argidx] == "-branch" && argidx+2 < args.size()) {
+				ForkBranch branch;
+				branch.name = args[++argidx];
+				branch.commands.push_back(unquote(args[++argidx]));
+				branches.push_back(branch);
+				continue;
+			}
+			break;
+		}
+		extra_args(args, argidx, design, false);
+
+		bool script_block = branches.empty();
+		if (script_block)
+			read_script_block(branches);
+
+		log_header(design, "Running %d branches.\n", GetSize(branches));
+
+#ifdef _WIN32
+		log_cmd_error("The fork command is not available on Windows.\n");
+#else
+		if (branches.empty())
+			log_cmd_error("No branches in fork block.\n");
+		if (max_jobs <= 0)
+			max_jobs = GetSize(branches);
+
+		std::string tempdir_name = make_temp_dir("/tmp/yosys-fork-XXXXXX");
+		for (int i = 0; i < GetSize(branches); i++) {
+			auto &branch = branches[i];
+			branch.log_file = stringf("%s/%d.log", tempdir_name.c_str(), i);
+			branch.design_file = stringf("%s/%d.rtlil_bin", tempdir_name.c_str(), i);
+			branch.metric_file = stringf("%s/%d.metric", tempdir_name.c_str(), i);
+		}
+
+		// a forked branch has only the calling thread, so the log must not
+		// depend on the writer thread of 'yosys -a'
+		log_async_stop();
+
+		dict<int, int> running;
+		int next_branch = 0;
+
+		while (next_branch < GetSize(branches) || !running.empty())
+		{
+			if (next_branch < GetSize(branches) && GetSize(running) < max_jobs)
+			{
+				auto &branch = branches[next_branch];
+				log_flush();
+				pid_t pid = fork();
+				if (pid < 0) {
+					log_warning("Can't fork for branch `%s': %s\n", branch.name.c_str(), strerror(errno));
+				} else if (pid == 0) {
+					log_error_atexit = nullptr;
+					_exit(run_branch(design, branch, stat_args, metric));
+				} else {
+					log("Running branch `%s' in process %d.\n", branch.name.c_str(), int(pid));
+					running[pid] = next_branch;
+				}
+				next_branch++;
+				continue;
+			}
+
+			int wstatus;
+			pid_t pid = waitpid(-1, &wstatus, 0);
+			if (pid < 0) {
+				if (errno == EINTR)
+					continue;
+				log_error("Waiting for fork branches failed: %s\n", strerror(errno));
+			}
+			if (running.count(pid) == 0)
+				continue;
+
+			auto &branch = branches[running.at(pid)];
+			running.erase(pid);
+
+			std::ifstream mf(branch.metric_file.c_str());
+			std::string value;
+			if (WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0 && std::getline(mf, value) && !value.empty()) {
+				branch.ok = true;
+				branch.metric = atof(value.c_str());
+				branch.metric_str = value;
+			}
+		}
+
+		int winner = -1;
+		log("\n");
+		log("   %-20s %20s\n", "branch", ("stat." + metric).c_str());
+		for (int i = 0; i < GetSize(branches); i++) {
+			auto &branch = branches[i];
+			if (!branch.ok) {
+				log("   %-20s %20s\n", branch.name.c_str(), "failed");
+				continue;
+			}
+			log("   %-20s %20.17g\n", branch.name.c_str(), branch.metric);
+			if (winner < 0 || (max_mode ? branch.metric > branches[winner].metric : branch.metric < branches[winner].metric))
+				winner = i;
+		}
+		log("\n");
+
+		for (int i = 0; i < GetSize(branches); i++)
+		{
+			auto &branch = branches[i];
+			if (!verbose && i != winner && branch.ok)
+				continue;
+
+			std::ifstream lf(branch.log_file.c_str());
+			std::stringstream buffer;
+			buffer << lf.rdbuf();
+			log("-- Log output of branch `%s'%s --\n", branch.name.c_str(), i == winner ? " (winner)" : branch.ok ? "" : " (failed)");
+			log("%s", buffer.str().c_str());
+			log("-- End of branch `%s' --\n\n", branch.name.c_str());
+		}
+
+		if (winner < 0) {
+			remove_directory(tempdir_name);
+			log_cmd_error("All branches failed.\n");
+		}
+
+		auto &branch = branches[winner];
+		log("Continuing with the design of branch `%s'.\n", branch.name.c_str());
+
+		for (auto &it : design->modules_)
+			delete it.second;
+		design->modules_.clear();
+		design->selection_stack.clear();
+		design->selection_vars.clear();
+		design->selected_active_module.clear();
+		design->selection_stack.push_back(RTLIL::Selection());
+
+		if (!RTLIL_BIN::read_file(branch.design_file, design)) {
+			remove_directory(tempdir_name);
+			log_error("Can't read the design of branch `%s' from `%s'.\n", branch.name.c_str(), branch.design_file.c_str());
+		}
+		remove_directory(tempdir_name);
+
+		design->scratchpad_set_string("fork.winner", branch.name);
+		design->scratchpad_set_string("stat." + metric, branch.metric_str);
+#endif
+	}
+} ForkPass;
+
+PRIVATE_NAMESPACE_END
@@ -0,0 +1,126 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+struct HashPass : public Pass {
+	HashPass() : Pass("hash", "print content digests of modules and merge identical modules") { module_changes_tracked(); }
+	void help() YS_OVERRIDE
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    hash [options] [selection]\n");
+		log("\n");
+		log("Print two SHA1 digests of the contents of each selected module. The module\n");
+		log("name and the module attributes are not part of the digests.\n");
+		log("\n");
+		log("The first digest covers the names of all wires and cells, so modules with the\n");
+		log("same digest are identical up to their name (e.g. copies created by\n");
+		log("'uniquify' that were not changed since).\n");
+		log("\n");
+		log("The second digest only uses the names of the ports. Modules that are equal up\n");
+		log("to the names of their internal wires and cells have the same digest. The\n");
+		log("converse is not guaranteed, the digest is meant for finding candidates for\n");
+		log("e.g. 'equiv_*' or caching.\n");
+		log("\n");
+		log("The digests are kept with each module until it is changed, so repeated calls\n");
+		log("are cheap.\n");
+		log("\n");
+		log("    -merge\n");
+		log("        replace selected modules that are identical according to the first\n");
+		log("        digest by one of them, and remove the others. modules without the\n");
+		log("        'unique' attribute are kept in favour of those created by 'uniquify'.\n");
+		log("        blackboxes and the top module are not merged.\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
+	{
+		bool merge_mode = false;
+
+		log_header(design, "Executing HASH pass (computing module digests).\n");
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-merge") {
+				merge_mode = true;
+				continue;
+			}
+			break;
+		}
+		extra_args(args, argidx, design);
+
+		dict<std::string, std::vector<RTLIL::Module*>> groups;
+
+		log("\n");
+		for (auto module : design->selected_whole_modules_warn())
+		{
+			std::string digest = module->content_hash();
+			log("  %s %s %s\n", digest.c_str(), module->content_hash(true).c_str(), log_id(module));
+
+			if (module->get_blackbox_attribute() || module->get_bool_attribute(ID(top)))
+				continue;
+			groups[digest].push_back(module);
+		}
+
+		if (!merge_mode)
+			return;
+
+		log("\n");
+		dict<RTLIL::IdString, RTLIL::IdString> replaced;
+
+		for (auto &it : groups)
+		{
+			if (GetSize(it.second) < 2)
+				continue;
+
+			std::vector<RTLIL::Module*> &modules = it.second;
+			std::sort(modules.begin(), modules.end(), [](RTLIL::Module *a, RTLIL::Module *b) {
+				bool a_unique = a->get_bool_attribute(ID(unique)), b_unique = b->get_bool_attribute(ID(unique));
+				return a_unique != b_unique ? b_unique : a->name.str() < b->name.str();
+			});
+
+			for (int i = 1; i < GetSize(modules); i++) {
+				log("Merging module %s into %s.\n", log_id(modules[i]), log_id(modules[0]));
+				replaced[modules[i]->name] = modules[0]->name;
+			}
+		}
+
+		for (auto module : design->modules()) {
+			bool changed = false;
+			for (auto cell : module->cells())
+				if (replaced.count(cell->type)) {
+					cell->type = replaced.at(cell->type);
+					changed = true;
+				}
+			if (changed)
+				module->touch();
+		}
+
+		for (auto &it : replaced)
+			design->remove(design->module(it.first));
+
+		log("Merged %d modules.\n", GetSize(replaced));
+	}
+} HashPass;
+
+PRIVATE_NAMESPACE_END
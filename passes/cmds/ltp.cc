@@ -20,6 +20,7 @@
 #include "kernel/yosys.h"
 #include "kernel/celltypes.h"
 #include "kernel/sigtools.h"
+#include "kernel/netgraph.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -30,13 +31,13 @@ struct LtpWorker
 	RTLIL::Module *module;
 	SigMap sigmap;
 
-	dict<SigBit, tuple<int, SigBit, Cell*>> bits;
-	dict<SigBit, dict<SigBit, Cell*>> bit2bits;
+	// the graph nodes are the bits of the selected wires, each edge is labeled
+	// with the index of the cell it goes through
+	dict<SigBit, int> bit2node;
+	std::vector<SigBit> node2bit;
+	std::vector<Cell*> edge_cells;
 	dict<SigBit, tuple<SigBit, Cell*>> bit2ff;
-
-	int maxlvl;
-	SigBit maxbit;
-	pool<SigBit> busy;
+	CsrGraph graph;
 
 	LtpWorker(RTLIL::Module *module, bool noff) : design(module->design), module(module), sigmap(module)
 	{
@@ -49,7 +50,12 @@ struct LtpWorker
 
 		for (auto wire : module->selected_wires())
 			for (auto bit : sigmap(wire))
-				bits[bit] = tuple<int, SigBit, Cell*>(-1, State::Sx, nullptr);
+				if (bit2node.count(bit) == 0) {
+					bit2node[bit] = GetSize(node2bit);
+					node2bit.push_back(bit);
+				}
+
+		std::vector<CsrGraph::Edge> edges;
 
 		for (auto cell : module->selected_cells())
 		{
@@ -72,68 +78,64 @@ struct LtpWorker
 				continue;
 			}
 
-			for (auto s : src_bits)
-				for (auto d : dst_bits)
-					bit2bits[s][d] = cell;
+			int cell_idx = GetSize(edge_cells);
+			edge_cells.push_back(cell);
+
+			for (auto s : src_bits) {
+				auto s_node = bit2node.find(s);
+				if (s_node == bit2node.end())
+					continue;
+				for (auto d : dst_bits) {
+					auto d_node = bit2node.find(d);
+					if (d_node != bit2node.end())
+						edges.push_back(CsrGraph::Edge{s_node->second, d_node->second, cell_idx});
+				}
+			}
 		}
 
-		maxlvl = -1;
-		maxbit = State::Sx;
+		graph.build(GetSize(node2bit), edges);
 	}
 
-	void runner(SigBit bit, int level, SigBit from, Cell *via)
+	void run()
 	{
-		auto &bitinfo = bits.at(bit);
+		std::vector<int> level, via_edge, loop_nodes;
+		graph.longest_paths(level, via_edge, loop_nodes);
 
-		if (get<0>(bitinfo) >= level)
-			return;
+		for (int node : loop_nodes)
+			log_warning("Detected loop at %s in %s\n", log_signal(node2bit[node]), log_id(module));
 
-		if (busy.count(bit) > 0) {
-			log_warning("Detected loop at %s in %s\n", log_signal(bit), log_id(module));
-			return;
-		}
+		int maxlvl = -1, maxnode = -1;
+		for (int i = 0; i < GetSize(level); i++)
+			if (level[i] > maxlvl) {
+				maxlvl = level[i];
+				maxnode = i;
+			}
 
-		busy.insert(bit);
-		get<0>(bitinfo) = level;
-		get<1>(bitinfo) = from;
-		get<2>(bitinfo) = via;
+		log("\n");
+		log("Longest topological path in %s (length=%d):\n", log_id(module), maxlvl);
 
-		if (level > maxlvl) {
-			maxlvl = level;
-			maxbit = bit;
-		}
+		if (maxlvl < 0)
+			return;
 
-		if (bit2bits.count(bit)) {
-			for (auto &it : bit2bits.at(bit))
-				runner(it.first, level+1, bit, it.second);
+		std::vector<int> path;
+		for (int node = maxnode; node >= 0; ) {
+			path.push_back(node);
+			int e = via_edge[node];
+			if (e < 0)
+				break;
+			// find the source node of the edge
+			node = std::upper_bound(graph.offsets.begin(), graph.offsets.end(), e) - graph.offsets.begin() - 1;
 		}
 
-		busy.erase(bit);
-	}
-
-	void printpath(SigBit bit)
-	{
-		auto &bitinfo = bits.at(bit);
-		if (get<2>(bitinfo)) {
-			printpath(get<1>(bitinfo));
-			log("%5d: %s (via %s)\n", get<0>(bitinfo), log_signal(bit), log_id(get<2>(bitinfo)));
-		} else {
-			log("%5d: %s\n", get<0>(bitinfo), log_signal(bit));
+		for (int i = GetSize(path)-1; i >= 0; i--) {
+			int node = path[i];
+			if (via_edge[node] >= 0)
+				log("%5d: %s (via %s)\n", level[node], log_signal(node2bit[node]), log_id(edge_cells[graph.values[via_edge[node]]]));
+			else
+				log("%5d: %s\n", level[node], log_signal(node2bit[node]));
 		}
-	}
-
-	void run()
-	{
-		for (auto &it : bits)
-			if (get<0>(it.second) < 0)
-				runner(it.first, 0, State::Sx, nullptr);
-
-		log("\n");
-		log("Longest topological path in %s (length=%d):\n", log_id(module), maxlvl);
-
-		if (maxlvl >= 0)
-			printpath(maxbit);
 
+		SigBit maxbit = node2bit[maxnode];
 		if (bit2ff.count(maxbit))
 			log("%5s: %s (via %s)\n", "ff", log_signal(get<0>(bit2ff.at(maxbit))), log_id(get<1>(bit2ff.at(maxbit))));
 	}
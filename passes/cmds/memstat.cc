@@ -0,0 +1,284 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+struct memstat_t
+{
+	#define MEMSTAT_MEMBERS X(wires) X(cells) X(ports) X(params) X(attrs) X(src) X(consts) X(conns) X(memories) X(processes)
+
+	#define X(_name) size_t _name = 0;
+	MEMSTAT_MEMBERS
+	#undef X
+
+	// src and consts are broken-out parts of the other categories
+	size_t total() const {
+		return wires + cells + ports + params + attrs + conns + memories + processes;
+	}
+
+	memstat_t &operator+=(const memstat_t &other) {
+		#define X(_name) _name += other._name;
+		MEMSTAT_MEMBERS
+		#undef X
+		return *this;
+	}
+
+	void add_attrs(const RTLIL::AttrObject *obj)
+	{
+		attrs += obj->attributes.memory_usage();
+		for (auto &it : obj->attributes) {
+			size_t bytes = it.second.memory_usage();
+			attrs += bytes;
+			consts += bytes;
+			if (it.first == ID(src))
+				src += bytes;
+		}
+	}
+
+	size_t sigspec(const RTLIL::SigSpec &sig) {
+		return sig.memory_usage();
+	}
+
+	size_t sigsigs(const std::vector<RTLIL::SigSig> &actions)
+	{
+		size_t bytes = actions.capacity() * sizeof(RTLIL::SigSig);
+		for (auto &it : actions)
+			bytes += sigspec(it.first) + sigspec(it.second);
+		return bytes;
+	}
+
+	size_t case_rule(const RTLIL::CaseRule *cs)
+	{
+		add_attrs(cs);
+		size_t bytes = cs->compare.capacity() * sizeof(RTLIL::SigSpec) + sigsigs(cs->actions);
+		for (auto &sig : cs->compare)
+			bytes += sigspec(sig);
+		bytes += cs->switches.capacity() * sizeof(RTLIL::SwitchRule*);
+		for (auto sw : cs->switches) {
+			add_attrs(sw);
+			bytes += sizeof(RTLIL::SwitchRule) + sigspec(sw->signal);
+			bytes += sw->cases.capacity() * sizeof(RTLIL::CaseRule*);
+			for (auto c : sw->cases)
+				bytes += sizeof(RTLIL::CaseRule) + case_rule(c);
+		}
+		return bytes;
+	}
+
+	void add_module(const RTLIL::Module *module)
+	{
+		add_attrs(module);
+
+		wires += module->wires_.memory_usage();
+		for (auto &it : module->wires_) {
+			wires += sizeof(RTLIL::Wire);
+			add_attrs(it.second);
+		}
+
+		cells += module->cells_.memory_usage();
+		for (auto &it : module->cells_) {
+			const RTLIL::Cell *cell = it.second;
+			cells += sizeof(RTLIL::Cell);
+			add_attrs(cell);
+			ports += cell->connections().memory_usage();
+			for (auto &conn : cell->connections())
+				ports += sigspec(conn.second);
+			params += cell->parameters.memory_usage();
+			for (auto &param : cell->parameters) {
+				size_t bytes = param.second.memory_usage();
+				params += bytes;
+				consts += bytes;
+			}
+		}
+
+		conns += sigsigs(module->connections());
+
+		memories += module->memories.memory_usage();
+		for (auto &it : module->memories) {
+			memories += sizeof(RTLIL::Memory);
+			add_attrs(it.second);
+		}
+
+		processes += module->processes.memory_usage();
+		for (auto &it : module->processes) {
+			const RTLIL::Process *proc = it.second;
+			processes += sizeof(RTLIL::Process);
+			add_attrs(proc);
+			processes += case_rule(&proc->root_case);
+			processes += proc->syncs.capacity() * sizeof(RTLIL::SyncRule*);
+			for (auto sync : proc->syncs)
+				processes += sizeof(RTLIL::SyncRule) + sigspec(sync->signal) + sigsigs(sync->actions);
+		}
+	}
+};
+
+std::string memstr(size_t bytes)
+{
+	if (bytes < 10*1024)
+		return stringf("%zu", bytes);
+	if (bytes < size_t(10)*1024*1024)
+		return stringf("%.1fK", bytes / 1024.0);
+	if (bytes < size_t(10)*1024*1024*1024)
+		return stringf("%.1fM", bytes / (1024.0*1024.0));
+	return stringf("%.1fG", bytes / (1024.0*1024.0*1024.0));
+}
+
+void print_header()
+{
+	log("  %-30s", "");
+	#define X(_name) log(" %9s", #_name);
+	MEMSTAT_MEMBERS
+	#undef X
+	log(" %9s\n", "total");
+}
+
+void print_line(const std::string &name, const memstat_t &stat)
+{
+	log("  %-30s", name.c_str());
+	#define X(_name) log(" %9s", memstr(stat._name).c_str());
+	MEMSTAT_MEMBERS
+	#undef X
+	log(" %9s\n", memstr(stat.total()).c_str());
+}
+
+size_t idstring_table_usage(int &num_ids)
+{
+	size_t bytes = 0;
+	num_ids = 0;
+
+	auto &storage = RTLIL::IdString::global_id_storage_;
+	for (int idx = 0; idx < storage.size(); idx++) {
+		if (idx % storage.chunk_size == 0)
+			bytes += storage.chunk_size * sizeof(char*);
+		if (storage[idx] != nullptr) {
+			bytes += strlen(storage[idx]) + 1;
+			num_ids++;
+		}
+	}
+
+	for (auto &index : RTLIL::IdString::global_id_index_)
+		bytes += index.memory_usage();
+
+	bytes += RTLIL::IdString::global_lazy_names_.memory_usage();
+	num_ids += GetSize(RTLIL::IdString::global_lazy_names_);
+
+#ifndef YOSYS_NO_IDS_REFCNT
+	auto &refcounts = RTLIL::IdString::global_refcount_storage_;
+	for (int idx = 0; idx < refcounts.size(); idx += refcounts.chunk_size)
+		bytes += refcounts.chunk_size * sizeof(std::atomic<int>);
+	bytes += RTLIL::IdString::global_free_idx_list_.capacity() * sizeof(int);
+#endif
+
+	return bytes;
+}
+
+struct MemstatPass : public Pass {
+	MemstatPass() : Pass("memstat", "print memory usage of the design") { }
+	void help() YS_OVERRIDE
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    memstat [options] [selection]\n");
+		log("\n");
+		log("Print an estimate of the memory used by the selected modules, broken down into\n");
+		log("the following categories:\n");
+		log("\n");
+		log("    wires, cells, memories, processes\n");
+		log("        the objects and the module dicts holding them (processes include\n");
+		log("        the signals in their case and sync rules)\n");
+		log("\n");
+		log("    ports, params\n");
+		log("        the dicts of cell connections and parameters, including the SigSpec\n");
+		log("        and Const payloads\n");
+		log("\n");
+		log("    attrs\n");
+		log("        the attribute dicts of all objects, including the attribute values\n");
+		log("\n");
+		log("    conns\n");
+		log("        the module-level connections\n");
+		log("\n");
+		log("    src, consts\n");
+		log("        parts of the above: the values of 'src' attributes, and the payload\n");
+		log("        of all parameter and attribute values\n");
+		log("\n");
+		log("The memory used for the global IdString table, and the total memory of each\n");
+		log("design saved with 'design -save' or 'design -push', are printed as well.\n");
+		log("\n");
+		log("The numbers count the heap allocations of the RTLIL data structures (without\n");
+		log("allocator overhead) and are meant for comparing designs and the effects of\n");
+		log("memory optimizations, not as an exact account of the process memory.\n");
+		log("\n");
+		log("    -nosaved\n");
+		log("        do not report saved designs\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
+	{
+		bool saved_mode = true;
+
+		log_header(design, "Printing memory usage.\n");
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-nosaved") {
+				saved_mode = false;
+				continue;
+			}
+			break;
+		}
+		extra_args(args, argidx, design);
+
+		memstat_t total;
+
+		log("\n");
+		print_header();
+		for (auto module : design->selected_modules()) {
+			memstat_t stat;
+			stat.add_module(module);
+			print_line(log_id(module), stat);
+			total += stat;
+		}
+		print_line("(total)", total);
+
+		int num_ids = 0;
+		size_t id_bytes = idstring_table_usage(num_ids);
+		log("\n");
+		log("  IdString table: %s for %d ids\n", memstr(id_bytes).c_str(), num_ids);
+
+		if (saved_mode && (!saved_designs.empty() || !pushed_designs.empty()))
+		{
+			log("\n");
+			auto design_total = [](const RTLIL::Design *d) {
+				memstat_t stat;
+				for (auto &it : d->modules_)
+					stat.add_module(it.second);
+				return stat.total();
+			};
+			for (auto &it : saved_designs)
+				log("  saved design %-20s %9s\n", it.first.c_str(), memstr(design_total(it.second)).c_str());
+			for (int i = 0; i < GetSize(pushed_designs); i++)
+				log("  pushed design #%-18d %9s\n", i, memstr(design_total(pushed_designs[i])).c_str());
+		}
+	}
+} MemstatPass;
+
+PRIVATE_NAMESPACE_END
@@ -0,0 +1,101 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+struct ProfilePass : public Pass {
+	ProfilePass() : Pass("profile", "print timing statistics of pass internals") { }
+	void help() YS_OVERRIDE
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    profile [options] [pattern]\n");
+		log("\n");
+		log("Print the statistics collected by the timing scopes (YS_PROFILE_SCOPE) in the\n");
+		log("Yosys C++ code, such as 'abc.run' or 'ast.simplify'. For each scope the number\n");
+		log("of calls, the total wall time and the self time (not counting nested scopes)\n");
+		log("are printed.\n");
+		log("\n");
+		log("    -reset\n");
+		log("        reset all statistics after printing them\n");
+		log("\n");
+		log("When one or more pattern (shell wildcards) are specified, then only scopes\n");
+		log("matching at least one pattern are printed.\n");
+		log("\n");
+		log("Timing scopes are only available when Yosys is built with ENABLE_PROFILE=1.\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
+	{
+		std::vector<std::string> patterns;
+		bool reset = false;
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-reset") {
+				reset = true;
+				continue;
+			}
+			break;
+		}
+		while (argidx < args.size() && args[argidx].compare(0, 1, "-") != 0)
+			patterns.push_back(args[argidx++]);
+		extra_args(args, argidx, design, false);
+
+		log_header(design, "Printing timing scope statistics.\n");
+		log("\n");
+
+#ifndef YOSYS_ENABLE_PROFILE
+		log("Yosys was built without timing scopes (ENABLE_PROFILE=1).\n");
+#else
+		// the same name can be used by several scopes in the code
+		std::map<std::string, std::tuple<int64_t, int64_t, int64_t>> stats;
+		for (auto data : get_profile_scopes()) {
+			if (!patterns.empty()) {
+				for (auto &p : patterns)
+					if (patmatch(p.c_str(), data->name))
+						goto pattern_match;
+				continue;
+			}
+		pattern_match:
+			auto &s = stats[data->name];
+			std::get<0>(s) += data->calls;
+			std::get<1>(s) += data->total_ns;
+			std::get<2>(s) += data->self_ns;
+		}
+
+		log("   %10s %12s %12s   %s\n", "calls", "total [s]", "self [s]", "scope");
+		for (auto &it : stats) {
+			if (std::get<0>(it.second) == 0)
+				continue;
+			log("   %10lld %12.3f %12.3f   %s\n", (long long)std::get<0>(it.second), std::get<1>(it.second) * 1e-9,
+					std::get<2>(it.second) * 1e-9, it.first.c_str());
+		}
+#endif
+
+		if (reset)
+			reset_profile_scopes();
+	}
+} ProfilePass;
+
+PRIVATE_NAMESPACE_END
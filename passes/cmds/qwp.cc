@@ -42,6 +42,7 @@ struct QwpConfig
 	bool alpha;
 	bool verbose;
 	double grid;
+	int cluster_levels;
 
 	std::ofstream dump_file;
 
@@ -50,9 +51,196 @@ struct QwpConfig
 		alpha = false;
 		verbose = false;
 		grid = 1.0 / 16;
+		cluster_levels = 0;
 	}
 };
 
+struct SparseMatrix
+{
+	struct Entry {
+		int row, col;
+		double value;
+	};
+
+	// CSR format: the entries of row i are columns[offsets[i] .. offsets[i+1]-1]
+	// with the corresponding values[], sorted by column
+	int size = 0;
+	vector<int> offsets, columns;
+	vector<double> values, diagonal;
+
+	// entries for the same position are added up
+	void build(int num_rows, vector<Entry> &entries)
+	{
+		std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+			return a.row != b.row ? a.row < b.row : a.col < b.col;
+		});
+
+		size = num_rows;
+		offsets.assign(size+1, 0);
+		columns.clear();
+		values.clear();
+		diagonal.assign(size, 0.0);
+
+		for (int i = 0; i < GetSize(entries); i++) {
+			auto &e = entries[i];
+			if (i > 0 && e.row == entries[i-1].row && e.col == entries[i-1].col) {
+				values.back() += e.value;
+			} else {
+				offsets[e.row+1]++;
+				columns.push_back(e.col);
+				values.push_back(e.value);
+			}
+			if (e.row == e.col)
+				diagonal[e.row] += e.value;
+		}
+
+		for (int i = 0; i < size; i++)
+			offsets[i+1] += offsets[i];
+	}
+
+	double at(int row, int col) const
+	{
+		for (int k = offsets[row]; k < offsets[row+1]; k++)
+			if (columns[k] == col)
+				return values[k];
+		return 0.0;
+	}
+
+	void multiply(const vector<double> &x, vector<double> &y) const
+	{
+		for (int i = 0; i < size; i++) {
+			double sum = 0;
+			for (int k = offsets[i]; k < offsets[i+1]; k++)
+				sum += values[k] * x[columns[k]];
+			y[i] = sum;
+		}
+	}
+};
+
+// Conjugate gradient method with Jacobi preconditioner for a symmetric positive
+// definite matrix, starting at the given x. Stops when the correction that the
+// preconditioner derives from the residual is below 1e-7 for all rows. Returns
+// the number of iterations.
+static int solve_cg(const SparseMatrix &A, const vector<double> &b, vector<double> &x)
+{
+	int N = A.size;
+	vector<double> r(N), z(N), p(N), q(N);
+
+	A.multiply(x, q);
+	for (int i = 0; i < N; i++) {
+		r[i] = b[i] - q[i];
+		z[i] = r[i] / A.diagonal[i];
+		p[i] = z[i];
+	}
+
+	double rz = 0;
+	for (int i = 0; i < N; i++)
+		rz += r[i] * z[i];
+
+	int max_iterations = max(100, min(N, 10000));
+	int iter;
+
+	for (iter = 0; iter < max_iterations; iter++)
+	{
+		double max_correction = 0;
+		for (int i = 0; i < N; i++)
+			max_correction = max(max_correction, fabs(z[i]));
+		if (max_correction < 1e-7)
+			break;
+
+		A.multiply(p, q);
+
+		double pq = 0;
+		for (int i = 0; i < N; i++)
+			pq += p[i] * q[i];
+		if (pq <= 0)
+			break;
+
+		double alpha = rz / pq;
+		for (int i = 0; i < N; i++) {
+			x[i] += alpha * p[i];
+			r[i] -= alpha * q[i];
+			z[i] = r[i] / A.diagonal[i];
+		}
+
+		double new_rz = 0;
+		for (int i = 0; i < N; i++)
+			new_rz += r[i] * z[i];
+
+		double beta = new_rz / rz;
+		rz = new_rz;
+		for (int i = 0; i < N; i++)
+			p[i] = z[i] + beta * p[i];
+	}
+
+	return iter;
+}
+
+// Multilevel variant: nodes are paired with the neighbour they are most strongly
+// connected to (heavy-edge matching), the solution of the resulting smaller
+// system gives the starting point for the conjugate gradient method on this
+// level. Returns the number of iterations on this level.
+static int solve_multilevel(const SparseMatrix &A, const vector<double> &b, vector<double> &x, int levels)
+{
+	int N = A.size;
+
+	if (levels > 0 && N > 100)
+	{
+		vector<int> cluster(N, -1);
+		int num_clusters = 0;
+
+		for (int i = 0; i < N; i++)
+		{
+			if (cluster[i] >= 0)
+				continue;
+
+			int best = -1;
+			double best_weight = 0;
+			for (int k = A.offsets[i]; k < A.offsets[i+1]; k++) {
+				int j = A.columns[k];
+				if (j != i && cluster[j] < 0 && -A.values[k] > best_weight) {
+					best = j;
+					best_weight = -A.values[k];
+				}
+			}
+
+			cluster[i] = num_clusters;
+			if (best >= 0)
+				cluster[best] = num_clusters;
+			num_clusters++;
+		}
+
+		if (num_clusters < 0.9 * N)
+		{
+			vector<SparseMatrix::Entry> entries;
+			entries.reserve(GetSize(A.values));
+			for (int i = 0; i < N; i++)
+				for (int k = A.offsets[i]; k < A.offsets[i+1]; k++)
+					entries.push_back(SparseMatrix::Entry{cluster[i], cluster[A.columns[k]], A.values[k]});
+
+			SparseMatrix coarse_A;
+			coarse_A.build(num_clusters, entries);
+
+			vector<double> coarse_b(num_clusters), coarse_x(num_clusters);
+			vector<int> cluster_size(num_clusters);
+			for (int i = 0; i < N; i++) {
+				coarse_b[cluster[i]] += b[i];
+				coarse_x[cluster[i]] += x[i];
+				cluster_size[cluster[i]]++;
+			}
+			for (int c = 0; c < num_clusters; c++)
+				coarse_x[c] /= cluster_size[c];
+
+			solve_multilevel(coarse_A, coarse_b, coarse_x, levels-1);
+
+			for (int i = 0; i < N; i++)
+				x[i] = coarse_x[cluster[i]];
+		}
+	}
+
+	return solve_cg(A, b, x);
+}
+
 struct QwpWorker
 {
 	QwpConfig &config;
@@ -211,14 +399,15 @@ struct QwpWorker
 		// AA = A' * A
 		// Ay = A' * y
 		//
-		// M := [AA Ay]
+		// Solve "AA*x = Ay" (least squares fit for "A*x = y"). AA is sparse
+		// and symmetric positive definite.
 
 		if (config.verbose)
 			log("> System size: %d^2\n", GetSize(nodes));
 
-		// Row major order
-		int N = GetSize(nodes), N1 = N+1;
-		vector<double> M(N * N1);
+		int N = GetSize(nodes);
+		vector<SparseMatrix::Entry> entries;
+		vector<double> rhs_vector(N), x(N);
 
 		if (config.verbose)
 			log("> Edge constraints: %d\n", GetSize(edges));
@@ -233,11 +422,10 @@ struct QwpWorker
 			int idx2 = edge.first.second;
 			double weight = edge.second * (1.0 + xorshift32() * 1e-3);
 
-			M[idx1 + idx1*N1] += weight * weight;
-			M[idx2 + idx2*N1] += weight * weight;
-
-			M[idx1 + idx2*N1] += -weight * weight;
-			M[idx2 + idx1*N1] += -weight * weight;
+			entries.push_back(SparseMatrix::Entry{idx1, idx1, weight * weight});
+			entries.push_back(SparseMatrix::Entry{idx2, idx2, weight * weight});
+			entries.push_back(SparseMatrix::Entry{idx1, idx2, -weight * weight});
+			entries.push_back(SparseMatrix::Entry{idx2, idx1, -weight * weight});
 		}
 
 		if (config.verbose)
@@ -261,98 +449,30 @@ struct QwpWorker
 				weight = 1e3;
 			weight *= (1.0 + xorshift32() * 1e-3);
 
-			M[idx + idx*N1] += weight * weight;
-			M[N + idx*N1] += rhs * weight * weight;
+			entries.push_back(SparseMatrix::Entry{idx, idx, weight * weight});
+			rhs_vector[idx] = rhs * weight * weight;
+			x[idx] = rhs;
 		}
 
+		SparseMatrix AA;
+		AA.build(N, entries);
+
 #ifdef LOG_MATRICES
 		log("\n");
 		for (int i = 0; i < N; i++) {
-			for (int j = 0; j < N+1; j++)
-				log(" %10.2e", M[(N+1)*i + j]);
-			log("\n");
+			for (int j = 0; j < N; j++)
+				log(" %10.2e", AA.at(i, j));
+			log(" %10.2e\n", rhs_vector[i]);
 		}
 #endif
 
 		if (config.verbose)
-			log("> Solving\n");
-
-		// Solve "AA*x = Ay"
-		// (least squares fit for "A*x = y")
-		//
-		// Using gaussian elimination to get M := [Id x]
-
-		vector<int> pivot_cache;
-		vector<int> queue;
-
-		for (int i = 0; i < N; i++)
-			queue.push_back(i);
+			log("> Solving (%d nonzero entries)\n", GetSize(AA.values));
 
-		// gaussian elimination
-		for (int i = 0; i < N; i++)
-		{
-			if (config.verbose && N > 15 && ((i+1) % (N/15)) == 0)
-				log("> Solved %d%%: %d/%d\n", (100*(i+1))/N, i+1, N);
-
-			// find best row
-			int best_row = queue.front();
-			int best_row_queue_idx = 0;
-			double best_row_absval = 0;
-
-			for (int k = 0; k < GetSize(queue); k++) {
-				int row = queue[k];
-				double absval = fabs(M[i + row*N1]);
-				if (absval > best_row_absval) {
-					best_row = row;
-					best_row_queue_idx = k;
-					best_row_absval = absval;
-				}
-			}
-
-			int row = best_row;
-			pivot_cache.push_back(row);
-
-			queue[best_row_queue_idx] = queue.back();
-			queue.pop_back();
-
-			// normalize row
-			for (int k = i+1; k < N1; k++)
-				M[k + row*N1] /= M[i + row*N1];
-			M[i + row*N1] = 1.0;
-
-			// elimination
-			for (int other_row : queue) {
-				double d = M[i + other_row*N1];
-				for (int k = i+1; k < N1; k++)
-					M[k + other_row*N1] -= d*M[k + row*N1];
-				M[i + other_row*N1] = 0.0;
-			}
-		}
+		int iterations = solve_multilevel(AA, rhs_vector, x, config.cluster_levels);
 
 		if (config.verbose)
-			log("> Solved\n");
-
-		log_assert(queue.empty());
-		log_assert(GetSize(pivot_cache) == N);
-
-		// back substitution
-		for (int i = N-1; i >= 0; i--)
-		for (int j = i+1; j < N; j++)
-		{
-			int row = pivot_cache[i];
-			int other_row = pivot_cache[j];
-			M[N + row*N1] -= M[j + row*N1] * M[N + other_row*N1];
-			M[j + row*N1] = 0.0;
-		}
-
-#ifdef LOG_MATRICES
-		log("\n");
-		for (int i = 0; i < N; i++) {
-			for (int j = 0; j < N+1; j++)
-				log(" %10.2e", M[(N+1)*i + j]);
-			log("\n");
-		}
-#endif
+			log("> Solved after %d CG iterations\n", iterations);
 
 		if (config.verbose)
 			log("> Update nodes\n");
@@ -360,7 +480,7 @@ struct QwpWorker
 		// update node positions
 		for (int i = 0; i < N; i++)
 		{
-			double v = M[(N+1)*i + N];
+			double v = x[i];
 			double c = alt_mode ? alt_midpos : midpos;
 			double r = alt_mode ? alt_radius : radius;
 
@@ -801,11 +921,16 @@ struct QwpPass : public Pass {
 		log("    -dump <html_file_name>\n");
 		log("        Dump a protocol of the placement algorithm to the html file.\n");
 		log("\n");
+		log("    -cluster <levels>\n");
+		log("        Solve each system on up to <levels> coarser levels first, with pairs\n");
+		log("        of strongly connected nodes merged on each level, and start from the\n");
+		log("        coarse solution. This speeds up convergence on large modules.\n");
+		log("\n");
 		log("    -v\n");
 		log("        Verbose solver output for profiling or debugging\n");
 		log("\n");
-		log("Note: This implementation of a quadratic wirelength placer uses exact\n");
-		log("dense matrix operations. It is only a toy-placer for small circuits.\n");
+		log("The linear systems are solved with a preconditioned conjugate gradient method\n");
+		log("on sparse matrices.\n");
 		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
@@ -829,6 +954,10 @@ struct QwpPass : public Pass {
 				config.verbose = true;
 				continue;
 			}
+			if (args[argidx] == "-cluster" && argidx+1 < args.size()) {
+				config.cluster_levels = atoi(args[++argidx].c_str());
+				continue;
+			}
 			if (args[argidx] == "-grid" && argidx+1 < args.size()) {
 				config.grid = 1.0 / atoi(args[++argidx].c_str());
 				continue;
@@ -24,6 +24,7 @@
 #include "kernel/register.h"
 #include "kernel/celltypes.h"
 #include "kernel/sigtools.h"
+#include "kernel/netgraph.h"
 #include "kernel/log.h"
 #include <stdlib.h>
 #include <stdio.h>
@@ -39,65 +40,22 @@ struct SccWorker
 	SigMap sigmap;
 	CellTypes ct;
 
-	std::set<RTLIL::Cell*> workQueue;
-	std::map<RTLIL::Cell*, std::set<RTLIL::Cell*>> cellToNextCell;
-	std::map<RTLIL::Cell*, RTLIL::SigSpec> cellToPrevSig, cellToNextSig;
+	std::vector<RTLIL::Cell*> cells;
+	dict<RTLIL::Cell*, RTLIL::SigSpec> cellToPrevSig, cellToNextSig;
+	CsrGraph graph;
 
-	std::map<RTLIL::Cell*, std::pair<int, int>> cellLabels;
-	std::map<RTLIL::Cell*, int> cellDepth;
-	std::set<RTLIL::Cell*> cellsOnStack;
-	std::vector<RTLIL::Cell*> cellStack;
-	int labelCounter;
-
-	std::map<RTLIL::Cell*, int> cell2scc;
 	std::vector<std::set<RTLIL::Cell*>> sccList;
 
-	void run(RTLIL::Cell *cell, int depth, int maxDepth)
+	void add_scc(const std::vector<int> &nodes)
 	{
-		log_assert(workQueue.count(cell) > 0);
-
-		workQueue.erase(cell);
-		cellLabels[cell] = std::pair<int, int>(labelCounter, labelCounter);
-		labelCounter++;
-
-		cellsOnStack.insert(cell);
-		cellStack.push_back(cell);
-
-		if (maxDepth >= 0)
-			cellDepth[cell] = depth;
-
-		for (auto nextCell : cellToNextCell[cell])
-			if (cellLabels.count(nextCell) == 0) {
-				run(nextCell, depth+1, maxDepth);
-				cellLabels[cell].second = min(cellLabels[cell].second, cellLabels[nextCell].second);
-			} else
-			if (cellsOnStack.count(nextCell) > 0 && (maxDepth < 0 || cellDepth[nextCell] + maxDepth > depth)) {
-					cellLabels[cell].second = min(cellLabels[cell].second, cellLabels[nextCell].second);
-			}
-
-		if (cellLabels[cell].first == cellLabels[cell].second)
-		{
-			if (cellStack.back() == cell)
-			{
-				cellStack.pop_back();
-				cellsOnStack.erase(cell);
-			}
-			else
-			{
-				log("Found an SCC:");
-				std::set<RTLIL::Cell*> scc;
-				while (cellsOnStack.count(cell) > 0) {
-					RTLIL::Cell *c = cellStack.back();
-					cellStack.pop_back();
-					cellsOnStack.erase(c);
-					log(" %s", RTLIL::id2cstr(c->name));
-					cell2scc[c] = sccList.size();
-					scc.insert(c);
-				}
-				sccList.push_back(scc);
-				log("\n");
-			}
+		log("Found an SCC:");
+		std::set<RTLIL::Cell*> scc;
+		for (int node : nodes) {
+			log(" %s", RTLIL::id2cstr(cells[node]->name));
+			scc.insert(cells[node]);
 		}
+		sccList.push_back(scc);
+		log("\n");
 	}
 
 	SccWorker(RTLIL::Design *design, RTLIL::Module *module, bool nofeedbackMode, bool allCellTypes, int maxDepth) :
@@ -116,7 +74,7 @@ struct SccWorker
 		}
 
 		SigPool selectedSignals;
-		SigSet<RTLIL::Cell*> sigToNextCells;
+		NetGraphBuilder builder;
 
 		for (auto &it : module->wires_)
 			if (design->selected(module, it.second))
@@ -132,8 +90,6 @@ struct SccWorker
 			if (!allCellTypes && !ct.cell_known(cell->type))
 				continue;
 
-			workQueue.insert(cell);
-
 			RTLIL::SigSpec inputSignals, outputSignals;
 
 			for (auto &conn : cell->connections())
@@ -157,37 +113,22 @@ struct SccWorker
 			inputSignals.sort_and_unify();
 			outputSignals.sort_and_unify();
 
+			builder.add_user(GetSize(cells), inputSignals);
+			builder.add_driver(GetSize(cells), outputSignals);
 			cellToPrevSig[cell] = inputSignals;
 			cellToNextSig[cell] = outputSignals;
-			sigToNextCells.insert(inputSignals, cell);
+			cells.push_back(cell);
 		}
 
-		for (auto cell : workQueue)
-		{
-			cellToNextCell[cell] = sigToNextCells.find(cellToNextSig[cell]);
-
-			if (!nofeedbackMode && cellToNextCell[cell].count(cell)) {
-				log("Found an SCC:");
-				std::set<RTLIL::Cell*> scc;
-				log(" %s", RTLIL::id2cstr(cell->name));
-				cell2scc[cell] = sccList.size();
-				scc.insert(cell);
-				sccList.push_back(scc);
-				log("\n");
-			}
-		}
+		builder.build(graph, GetSize(cells));
 
-		labelCounter = 0;
-		cellLabels.clear();
+		if (!nofeedbackMode)
+			for (int i = 0; i < GetSize(cells); i++)
+				if (graph.has_edge(i, i))
+					add_scc(std::vector<int>{i});
 
-		while (!workQueue.empty())
-		{
-			RTLIL::Cell *cell = *workQueue.begin();
-			log_assert(cellStack.size() == 0);
-			cellDepth.clear();
-
-			run(cell, 0, maxDepth);
-		}
+		for (auto &scc : graph.find_sccs(maxDepth))
+			add_scc(scc);
 
 		log("Found %d SCCs in module %s.\n", int(sccList.size()), RTLIL::id2cstr(module->name));
 	}
@@ -61,6 +61,15 @@ struct ScratchpadPass : public Pass {
 		log("by the name of the pass that uses it, e.g. 'opt.did_something'. If the value\n");
 		log("contains whitespace, it must be enclosed in double quotes.\n");
 		log("\n");
+		log("When 'script.checkpoint_dir' is set, script passes such as 'synth' and the\n");
+		log("synth_* passes save the design in binary RTLIL format to that directory at each\n");
+		log("label of their script. The file name contains a hash of the input design, the\n");
+		log("scratchpad, and all commands run before the label. When the script is run\n");
+		log("again, it resumes from the last label whose checkpoint exists, e.g. after only\n");
+		log("an option that affects late commands was changed. Values that skipped commands\n");
+		log("would have stored in the scratchpad are not restored. Checkpoints are not used\n");
+		log("with -run <from_label> and are never deleted.\n");
+		log("\n");
 	}
 
 	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
@@ -427,74 +427,167 @@ static int parse_comma_list(std::set<RTLIL::IdString> &tokens, std::string str,
 	}
 }
 
-static int select_op_expand(RTLIL::Design *design, RTLIL::Selection &lhs, std::vector<expand_rule_t> &rules, std::set<RTLIL::IdString> &limits, int max_objects, char mode, CellTypes &ct, bool eval_only)
-{
-	int sel_objects = 0;
-	bool is_input, is_output;
-	for (auto &mod_it : design->modules_)
+namespace {
+	// The connectivity of a partially selected module for the expand operators,
+	// built once and then used for all levels of the expansion. Wires and cells
+	// are numbered by name, like in the selection. An edge is followed when its
+	// source is selected and not in the limits and its target is not selected
+	// yet. The edges are stored in the order in which the module is scanned, so
+	// that a limit on the number of objects cuts off at the same place.
+	struct expand_module_t
 	{
-		if (lhs.selected_whole_module(mod_it.first) || !lhs.selected_module(mod_it.first))
-			continue;
+		struct edge_t {
+			int src, dst;
+			bool via_cell;
+		};
 
-		RTLIL::Module *mod = mod_it.second;
-		std::set<RTLIL::Wire*> selected_wires;
-		auto selected_members = lhs.selected_members[mod->name];
+		RTLIL::Module *module;
+		dict<RTLIL::IdString, int> ids;
+		std::vector<RTLIL::IdString> names;
+		std::vector<bool> limited;
 
-		for (auto &it : mod->wires_)
-			if (lhs.selected_member(mod_it.first, it.first) && limits.count(it.first) == 0)
-				selected_wires.insert(it.second);
+		// level at which a name was selected, 0 for the initial selection
+		// and -1 for names that are not selected
+		std::vector<int> level;
+		std::vector<int> frontier;
 
-		for (auto &conn : mod->connections())
-		{
-			std::vector<RTLIL::SigBit> conn_lhs = conn.first.to_sigbit_vector();
-			std::vector<RTLIL::SigBit> conn_rhs = conn.second.to_sigbit_vector();
+		std::vector<edge_t> edges;
+		std::vector<int> out_begin, out_edges;
 
-			for (size_t i = 0; i < conn_lhs.size(); i++) {
-				if (conn_lhs[i].wire == NULL || conn_rhs[i].wire == NULL)
-					continue;
-				if (mode != 'i' && selected_wires.count(conn_rhs[i].wire) && selected_members.count(conn_lhs[i].wire->name) == 0)
-					lhs.selected_members[mod->name].insert(conn_lhs[i].wire->name), sel_objects++, max_objects--;
-				if (mode != 'o' && selected_wires.count(conn_lhs[i].wire) && selected_members.count(conn_rhs[i].wire->name) == 0)
-					lhs.selected_members[mod->name].insert(conn_rhs[i].wire->name), sel_objects++, max_objects--;
-			}
+		int id(RTLIL::IdString name)
+		{
+			auto it = ids.find(name);
+			if (it != ids.end())
+				return it->second;
+			int n = GetSize(names);
+			ids[name] = n;
+			names.push_back(name);
+			return n;
 		}
 
-		for (auto &cell : mod->cells_)
-		for (auto &conn : cell.second->connections())
+		expand_module_t(RTLIL::Module *mod, const RTLIL::Selection &lhs, const std::vector<expand_rule_t> &rules,
+				const std::set<RTLIL::IdString> &limits, char mode, CellTypes &ct, bool eval_only) : module(mod)
 		{
-			char last_mode = '-';
-			if (eval_only && !yosys_celltypes.cell_evaluable(cell.second->type))
-				goto exclude_match;
-			for (auto &rule : rules) {
-				last_mode = rule.mode;
-				if (rule.cell_types.size() > 0 && rule.cell_types.count(cell.second->type) == 0)
-					continue;
-				if (rule.port_names.size() > 0 && rule.port_names.count(conn.first) == 0)
-					continue;
-				if (rule.mode == '+')
-					goto include_match;
-				else
+			for (auto &it : mod->wires_)
+				id(it.first);
+			for (auto &it : mod->cells_)
+				id(it.first);
+
+			for (auto &conn : mod->connections())
+			{
+				std::vector<RTLIL::SigBit> conn_lhs = conn.first.to_sigbit_vector();
+				std::vector<RTLIL::SigBit> conn_rhs = conn.second.to_sigbit_vector();
+
+				for (size_t i = 0; i < conn_lhs.size(); i++) {
+					if (conn_lhs[i].wire == NULL || conn_rhs[i].wire == NULL)
+						continue;
+					if (mode != 'i')
+						edges.push_back({ids.at(conn_rhs[i].wire->name), ids.at(conn_lhs[i].wire->name), false});
+					if (mode != 'o')
+						edges.push_back({ids.at(conn_lhs[i].wire->name), ids.at(conn_rhs[i].wire->name), false});
+				}
+			}
+
+			for (auto &cell : mod->cells_)
+			for (auto &conn : cell.second->connections())
+			{
+				char last_mode = '-';
+				if (eval_only && !yosys_celltypes.cell_evaluable(cell.second->type))
 					goto exclude_match;
+				for (auto &rule : rules) {
+					last_mode = rule.mode;
+					if (rule.cell_types.size() > 0 && rule.cell_types.count(cell.second->type) == 0)
+						continue;
+					if (rule.port_names.size() > 0 && rule.port_names.count(conn.first) == 0)
+						continue;
+					if (rule.mode == '+')
+						goto include_match;
+					else
+						goto exclude_match;
+				}
+				if (last_mode == '+')
+					goto exclude_match;
+			include_match:
+				{
+					bool is_input = mode == 'x' || ct.cell_input(cell.second->type, conn.first);
+					bool is_output = mode == 'x' || ct.cell_output(cell.second->type, conn.first);
+					bool wire_to_cell = mode == 'x' || (mode == 'i' && is_output) || (mode == 'o' && is_input);
+					bool cell_to_wire = mode == 'x' || (mode == 'i' && is_input) || (mode == 'o' && is_output);
+					int cell_id = ids.at(cell.first);
+					for (auto &chunk : conn.second.chunks())
+						if (chunk.wire != NULL) {
+							int wire_id = ids.at(chunk.wire->name);
+							if (wire_to_cell)
+								edges.push_back({wire_id, cell_id, true});
+							if (cell_to_wire)
+								edges.push_back({cell_id, wire_id, true});
+						}
+				}
+			exclude_match:;
 			}
-			if (last_mode == '+')
-				goto exclude_match;
-		include_match:
-			is_input = mode == 'x' || ct.cell_input(cell.second->type, conn.first);
-			is_output = mode == 'x' || ct.cell_output(cell.second->type, conn.first);
-			for (auto &chunk : conn.second.chunks())
-				if (chunk.wire != NULL) {
-					if (max_objects != 0 && selected_wires.count(chunk.wire) > 0 && selected_members.count(cell.first) == 0)
-						if (mode == 'x' || (mode == 'i' && is_output) || (mode == 'o' && is_input))
-							lhs.selected_members[mod->name].insert(cell.first), sel_objects++, max_objects--;
-					if (max_objects != 0 && selected_members.count(cell.first) > 0 && limits.count(cell.first) == 0 && selected_members.count(chunk.wire->name) == 0)
-						if (mode == 'x' || (mode == 'i' && is_input) || (mode == 'o' && is_output))
-							lhs.selected_members[mod->name].insert(chunk.wire->name), sel_objects++, max_objects--;
+
+			out_begin.resize(GetSize(names) + 1);
+			for (auto &edge : edges)
+				out_begin[edge.src + 1]++;
+			for (int i = 0; i < GetSize(names); i++)
+				out_begin[i + 1] += out_begin[i];
+			out_edges.resize(GetSize(edges));
+			std::vector<int> out_pos(out_begin.begin(), out_begin.end() - 1);
+			for (int i = 0; i < GetSize(edges); i++)
+				out_edges[out_pos[edges[i].src]++] = i;
+
+			const pool<RTLIL::IdString> &selected_members = lhs.selected_members.at(mod->name);
+			limited.resize(GetSize(names));
+			level.resize(GetSize(names), -1);
+			for (int i = 0; i < GetSize(names); i++) {
+				limited[i] = limits.count(names[i]) != 0;
+				if (selected_members.count(names[i])) {
+					level[i] = 0;
+					frontier.push_back(i);
 				}
-		exclude_match:;
+			}
 		}
-	}
 
-	return sel_objects;
+		// Select the objects of the next level. Only the edges from the
+		// names selected in the previous level can add new names, unless
+		// the expansion was cut off by max_objects, so the other ones are
+		// only scanned with full_scan.
+		int expand(RTLIL::Selection &lhs, int this_level, int &max_objects, bool full_scan)
+		{
+			int sel_objects = 0;
+			std::vector<int> new_frontier;
+
+			auto follow = [&](const edge_t &edge) {
+				if (edge.via_cell && max_objects == 0)
+					return;
+				if (level[edge.src] < 0 || level[edge.src] == this_level || limited[edge.src])
+					return;
+				if (level[edge.dst] >= 0 && level[edge.dst] < this_level)
+					return;
+				if (level[edge.dst] < 0) {
+					level[edge.dst] = this_level;
+					new_frontier.push_back(edge.dst);
+				}
+				sel_objects++, max_objects--;
+			};
+
+			if (full_scan) {
+				for (auto &edge : edges)
+					follow(edge);
+			} else {
+				for (int n : frontier)
+					for (int i = out_begin[n]; i < out_begin[n + 1]; i++)
+						follow(edges[out_edges[i]]);
+			}
+
+			pool<RTLIL::IdString> &selected_members = lhs.selected_members[module->name];
+			for (int n : new_frontier)
+				selected_members.insert(names[n]);
+
+			frontier.swap(new_frontier);
+			return sel_objects;
+		}
+	};
 }
 
 static void select_op_expand(RTLIL::Design *design, std::string arg, char mode, bool eval_only)
@@ -590,8 +683,21 @@ static void select_op_expand(RTLIL::Design *design, std::string arg, char mode,
 	}
 #endif
 
-	while (levels-- > 0 && rem_objects != 0) {
-		int num_objects = select_op_expand(design, work_stack.back(), rules, limits, rem_objects, mode, ct, eval_only);
+	RTLIL::Selection &lhs = work_stack.back();
+	std::vector<expand_module_t> expand_modules;
+
+	for (auto &mod_it : design->modules_)
+		if (!lhs.selected_whole_module(mod_it.first) && lhs.selected_module(mod_it.first))
+			expand_modules.emplace_back(mod_it.second, lhs, rules, limits, mode, ct, eval_only);
+
+	// with a limit on the number of objects, all edges are scanned on every
+	// level to keep the order in which the limit is reached
+	bool full_scan = rem_objects >= 0;
+
+	for (int this_level = 1; levels-- > 0 && rem_objects != 0; this_level++) {
+		int num_objects = 0, max_objects = rem_objects;
+		for (auto &it : expand_modules)
+			num_objects += it.expand(lhs, this_level, max_objects, full_scan);
 		if (num_objects == 0)
 			break;
 		rem_objects -= num_objects;
@@ -972,7 +1078,7 @@ YOSYS_NAMESPACE_END
 PRIVATE_NAMESPACE_BEGIN
 
 struct SelectPass : public Pass {
-	SelectPass() : Pass("select", "modify and view the list of selected objects") { }
+	SelectPass() : Pass("select", "modify and view the list of selected objects") { module_changes_tracked(); }
 	void help() YS_OVERRIDE
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -1619,7 +1725,7 @@ static void log_matches(const char *title, Module *module, T list)
 }
 
 struct LsPass : public Pass {
-	LsPass() : Pass("ls", "list modules or objects in modules") { }
+	LsPass() : Pass("ls", "list modules or objects in modules") { module_changes_tracked(); }
 	void help() YS_OVERRIDE
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
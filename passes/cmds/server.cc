@@ -0,0 +1,270 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+
+#ifndef _WIN32
+#  include <sys/socket.h>
+#  include <sys/un.h>
+#  include <sys/wait.h>
+#  include <poll.h>
+#  include <unistd.h>
+#endif
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+#ifndef _WIN32
+
+// Runs the script read from the connection, with all log output going to the
+// connection. Returns the exit status reported to the client.
+int run_request(RTLIL::Design *design, int conn_fd)
+{
+	FILE *in = fdopen(dup(conn_fd), "r");
+	FILE *out = fdopen(dup(conn_fd), "w");
+	if (in == nullptr || out == nullptr)
+		return 1;
+
+	std::vector<FILE*> backup_log_files = log_files;
+	std::vector<std::ostream*> backup_log_streams = log_streams;
+	FILE *backup_log_errfile = log_errfile;
+	bool backup_log_error_stderr = log_error_stderr;
+	bool backup_log_cmd_error_throw = log_cmd_error_throw;
+	FILE *backup_script_file = Frontend::current_script_file;
+
+	log_flush();
+	log_files = std::vector<FILE*>{out};
+	log_streams.clear();
+	log_errfile = nullptr;
+	log_error_stderr = false;
+	log_cmd_error_throw = true;
+	Frontend::current_script_file = in;
+
+	int status = 0;
+	try {
+		std::string command;
+		while (fgetline(in, command)) {
+			while (!command.empty() && command[command.size()-1] == '\\') {
+				std::string next_line;
+				if (!fgetline(in, next_line))
+					break;
+				command.resize(command.size()-1);
+				command += next_line;
+			}
+			if (command[strspn(command.c_str(), " \t\r\n")] == 0)
+				continue;
+			log_assert(design->selection_stack.size() == 1);
+			Pass::call(design, command);
+			design->check();
+		}
+	} catch (log_cmd_error_exception) {
+		while (design->selection_stack.size() > 1)
+			design->selection_stack.pop_back();
+		log_reset_stack();
+		status = 1;
+	}
+
+	log_flush();
+	fclose(in);
+	fclose(out);
+
+	log_files = backup_log_files;
+	log_streams = backup_log_streams;
+	log_errfile = backup_log_errfile;
+	log_error_stderr = backup_log_error_stderr;
+	log_cmd_error_throw = backup_log_cmd_error_throw;
+	Frontend::current_script_file = backup_script_file;
+
+	return status;
+}
+
+void send_status(int conn_fd, int status)
+{
+	std::string line = stringf("yosys-server: exit %d\n", status);
+	if (write(conn_fd, line.c_str(), line.size()) < 0)
+		log_warning("Can't send status to client: %s\n", strerror(errno));
+	close(conn_fd);
+}
+
+#endif
+
+struct ServerPass : public Pass {
+	ServerPass() : Pass("server", "serve requests on a unix domain socket") { }
+	void help() YS_OVERRIDE
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    server -socket <path> [options]\n");
+		log("\n");
+		log("Listen on the specified unix domain socket and run the yosys commands sent by\n");
+		log("clients. This is meant to be called at the end of a script that loads the\n");
+		log("libraries and designs shared by many small jobs, so that each job starts from\n");
+		log("that state instead of parsing everything again. For example:\n");
+		log("\n");
+		log("    yosys -p 'read_verilog -lib cells.v; design -save lib; server -socket s'\n");
+		log("    socat - UNIX-CONNECT:s < job.ys\n");
+		log("\n");
+		log("A client sends the commands of one script and then closes its side of the\n");
+		log("connection (or shuts it down for writing). The log output of the commands is\n");
+		log("sent back, followed by a line 'yosys-server: exit <status>'. The status is 0\n");
+		log("on success and 1 when a command failed. If the connection is closed without\n");
+		log("that line, the request crashed.\n");
+		log("\n");
+		log("Each request is run in a forked copy of the server process. It sees the\n");
+		log("design (and all saved designs) as they were when 'server' was called, shares\n");
+		log("their memory with the server until it modifies them, and can not affect the\n");
+		log("server or other requests. Requests are run in parallel.\n");
+		log("\n");
+		log("    -socket <path>\n");
+		log("        the socket to listen on. An existing file with this name is removed.\n");
+		log("\n");
+		log("    -nofork\n");
+		log("        run the requests one after another in the server process. Changes\n");
+		log("        to the design are kept for the following requests, and a request\n");
+		log("        that fails with an error other than a command error ends the\n");
+		log("        server.\n");
+		log("\n");
+		log("    -n <N>\n");
+		log("        stop serving and continue with the script after N requests.\n");
+		log("\n");
+		log("This command is not available on Windows.\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
+	{
+		std::string socket_path;
+		bool nofork = false;
+		int max_requests = -1;
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-socket" && argidx+1 < args.size()) {
+				socket_path = args[++argidx];
+				continue;
+			}
+			if (args[argidx] == "-nofork") {
+				nofork = true;
+				continue;
+			}
+			if (args[argidx] == "-n" && argidx+1 < args.size()) {
+				max_requests = atoi(args[++argidx].c_str());
+				continue;
+			}
+			break;
+		}
+		extra_args(args, argidx, design);
+
+		if (socket_path.empty())
+			log_cmd_error("Missing -socket option.\n");
+
+#ifdef _WIN32
+		log_cmd_error("The server command is not available on Windows.\n");
+#else
+		log_header(design, "Serving requests on `%s'.\n", socket_path.c_str());
+
+		struct sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (socket_path.size() >= sizeof(addr.sun_path))
+			log_cmd_error("Socket path `%s' is too long.\n", socket_path.c_str());
+		strcpy(addr.sun_path, socket_path.c_str());
+
+		int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (listen_fd < 0)
+			log_cmd_error("Can't create socket: %s\n", strerror(errno));
+
+		unlink(socket_path.c_str());
+		if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, 16) < 0) {
+			close(listen_fd);
+			log_cmd_error("Can't listen on `%s': %s\n", socket_path.c_str(), strerror(errno));
+		}
+
+		// a forked request has only the calling thread, so the log must not
+		// depend on the writer thread of 'yosys -a'
+		log_async_stop();
+
+		dict<int, int> pending_requests;
+		int num_requests = 0;
+
+		while (max_requests < 0 || num_requests < max_requests || !pending_requests.empty())
+		{
+			if (!pending_requests.empty()) {
+				int wstatus;
+				pid_t pid;
+				while ((pid = waitpid(-1, &wstatus, WNOHANG)) > 0) {
+					if (pending_requests.count(pid) == 0)
+						continue;
+					int status = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 128 + WTERMSIG(wstatus);
+					log("Request in process %d finished with status %d.\n", int(pid), status);
+					send_status(pending_requests.at(pid), status);
+					pending_requests.erase(pid);
+				}
+			}
+
+			bool accepting = max_requests < 0 || num_requests < max_requests;
+			if (!accepting && pending_requests.empty())
+				break;
+
+			struct pollfd pfd;
+			pfd.fd = listen_fd;
+			pfd.events = accepting ? POLLIN : 0;
+			pfd.revents = 0;
+			if (poll(&pfd, 1, pending_requests.empty() ? -1 : 50) <= 0 || (pfd.revents & POLLIN) == 0)
+				continue;
+
+			int conn_fd = accept(listen_fd, nullptr, nullptr);
+			if (conn_fd < 0)
+				continue;
+			num_requests++;
+
+			if (nofork) {
+				log("Running request %d.\n", num_requests);
+				int status = run_request(design, conn_fd);
+				log("Request %d finished with status %d.\n", num_requests, status);
+				send_status(conn_fd, status);
+				continue;
+			}
+
+			log_flush();
+			pid_t pid = fork();
+			if (pid < 0) {
+				log_warning("Can't fork for request %d: %s\n", num_requests, strerror(errno));
+				send_status(conn_fd, 1);
+				continue;
+			}
+			if (pid == 0) {
+				close(listen_fd);
+				log_error_atexit = nullptr;
+				int status = run_request(design, conn_fd);
+				_exit(status);
+			}
+
+			log("Running request %d in process %d.\n", num_requests, int(pid));
+			pending_requests[pid] = conn_fd;
+		}
+
+		close(listen_fd);
+		unlink(socket_path.c_str());
+		log("Served %d requests.\n", num_requests);
+#endif
+	}
+} ServerPass;
+
+PRIVATE_NAMESPACE_END
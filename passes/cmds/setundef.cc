@@ -240,7 +240,7 @@ struct SetundefPass : public Pass {
 			{
 				for (auto *cell : module->selected_cells()) {
 					for (auto &parameter : cell->parameters) {
-						for (auto &bit : parameter.second.bits) {
+						for (auto &bit : parameter.second.bits()) {
 							if (bit > RTLIL::State::S1)
 								bit = worker.next_bit();
 						}
@@ -305,6 +305,8 @@ struct SetundefPass : public Pass {
 						if (!ct.cell_known(it.second->type) || ct.cell_output(it.second->type, conn.first))
 							undriven_signals.del(sigmap(conn.second));
 
+					// add_wire() calls fixup_ports() for each new port
+					RTLIL::Module::Batch batch(module);
 					RTLIL::SigSpec sig = undriven_signals.export_all();
 					for (auto &c : sig.chunks()) {
 						RTLIL::Wire * wire;
@@ -412,12 +414,12 @@ struct SetundefPass : public Pass {
 					for (auto wire : initwires)
 					{
 						Const &initval = wire->attributes["\\init"];
-						initval.bits.resize(GetSize(wire), State::Sx);
+						initval.bits().resize(GetSize(wire), State::Sx);
 
 						for (int i = 0; i < GetSize(wire); i++) {
 							SigBit bit = sigmap(SigBit(wire, i));
 							if (initval[i] == State::Sx && ffbits.count(bit)) {
-								initval[i] = worker.next_bit();
+								initval.bits()[i] = worker.next_bit();
 								ffbits.erase(bit);
 							}
 						}
@@ -443,7 +445,7 @@ struct SetundefPass : public Pass {
 								continue;
 
 							Const &initval = wire->attributes["\\init"];
-							initval.bits.resize(GetSize(wire), State::Sx);
+							initval.bits().resize(GetSize(wire), State::Sx);
 
 							if (initval.is_fully_undef()) {
 								wire->attributes.erase("\\init");
@@ -67,8 +67,14 @@ struct ShowWorker
 	bool enumerateIds;
 	bool abbreviateIds;
 	bool notitle;
+	bool collapseBuses;
+	bool collapseClusters;
+	int maxFanout;
 	int page_counter;
 
+	enum cluster_mode_t { CLUSTER_NONE, CLUSTER_HIER, CLUSTER_SRC } clusterMode;
+	dict<RTLIL::Cell*, int> cell_cluster;
+
 	const std::vector<std::pair<std::string, RTLIL::Selection>> &color_selections;
 	const std::vector<std::pair<std::string, RTLIL::Selection>> &label_selections;
 
@@ -230,8 +236,28 @@ struct ShowWorker
 		return std::string();
 	}
 
+	// With -buses, a cell port is connected to the nodes of the wires it uses
+	// instead of a box with the individual bits and slices of the signal.
+	void gen_bus_conns(std::string port, const RTLIL::SigSpec &sig, bool driver)
+	{
+		for (auto &c : sig.chunks()) {
+			std::string net = gen_signode_simple(c, false);
+			if (driver)
+				net_conn_map[net].in.insert(port);
+			else
+				net_conn_map[net].out.insert(port);
+			net_conn_map[net].bits = net[0] == 'n' ? c.wire->width : c.width;
+			net_conn_map[net].color = nextColor(c, net_conn_map[net].color);
+		}
+	}
+
 	std::string gen_portbox(std::string port, RTLIL::SigSpec sig, bool driver, std::string *node = NULL)
 	{
+		if (collapseBuses && node == NULL && !port.empty()) {
+			gen_bus_conns(port, sig, driver);
+			return std::string();
+		}
+
 		std::string code;
 		std::string net = gen_signode_simple(sig);
 		if (net.empty())
@@ -306,6 +332,119 @@ struct ShowWorker
 		return code;
 	}
 
+	// The cells of a cluster drawn as a single node are only connected to
+	// that node.
+	void handle_cell(RTLIL::Cell *cell)
+	{
+		if (collapseClusters && cell_cluster.count(cell)) {
+			std::string code, port = stringf("k%d", cell_cluster.at(cell));
+			for (auto &conn : cell->connections())
+				code += gen_portbox(port, conn.second, ct.cell_output(cell->type, conn.first));
+			fprintf(f, "%s", code.c_str());
+			dot_escape_store.clear();
+			return;
+		}
+
+		std::vector<RTLIL::IdString> in_ports, out_ports;
+
+		for (auto &conn : cell->connections()) {
+			if (!ct.cell_output(cell->type, conn.first))
+				in_ports.push_back(conn.first);
+			else
+				out_ports.push_back(conn.first);
+		}
+
+		std::sort(in_ports.begin(), in_ports.end(), RTLIL::sort_by_id_str());
+		std::sort(out_ports.begin(), out_ports.end(), RTLIL::sort_by_id_str());
+
+		std::string label_string = "{{";
+
+		for (auto &p : in_ports)
+			label_string += stringf("<p%d> %s%s|", id2num(p), escape(p.str()),
+					genSignedLabels && cell->hasParam(p.str() + "_SIGNED") &&
+					cell->getParam(p.str() + "_SIGNED").as_bool() ? "*" : "");
+		if (label_string[label_string.size()-1] == '|')
+			label_string = label_string.substr(0, label_string.size()-1);
+
+		label_string += stringf("}|%s\\n%s|{", findLabel(cell->name.str()), escape(cell->type.str()));
+
+		for (auto &p : out_ports)
+			label_string += stringf("<p%d> %s|", id2num(p), escape(p.str()));
+		if (label_string[label_string.size()-1] == '|')
+			label_string = label_string.substr(0, label_string.size()-1);
+
+		label_string += "}}";
+
+		std::string code;
+		for (auto &conn : cell->connections()) {
+			code += gen_portbox(stringf("c%d:p%d", id2num(cell->name), id2num(conn.first)),
+					conn.second, ct.cell_output(cell->type, conn.first));
+		}
+
+#ifdef CLUSTER_CELLS_AND_PORTBOXES
+		if (!code.empty())
+			fprintf(f, "subgraph cluster_c%d {\nc%d [ shape=record, label=\"%s\"%s ];\n%s}\n",
+					id2num(cell->name), id2num(cell->name), label_string.c_str(), findColor(cell->name.str()), code.c_str());
+		else
+#endif
+			fprintf(f, "c%d [ shape=record, label=\"%s\"%s ];\n%s",
+					id2num(cell->name), label_string.c_str(), findColor(cell->name.str()), code.c_str());
+		dot_escape_store.clear();
+	}
+
+	// a private net that only connects cells of the same collapsed cluster
+	static bool is_cluster_internal(const net_conn &conn)
+	{
+		if (conn.in.empty() || conn.in.begin()->compare(0, 1, "k") != 0)
+			return false;
+		const std::string &cluster = *conn.in.begin();
+		for (auto &it : conn.in)
+			if (it != cluster)
+				return false;
+		for (auto &it : conn.out)
+			if (it != cluster)
+				return false;
+		return true;
+	}
+
+	// The cluster of a cell is the hierarchical prefix of its name (for
+	// flattened designs) or the file name in its src attribute.
+	std::string cluster_name(RTLIL::Cell *cell)
+	{
+		if (clusterMode == CLUSTER_HIER) {
+			std::string name = cell->name.str();
+			if (name.compare(0, 9, "$techmap\\") == 0)
+				name = name.substr(8);
+			size_t end = name.find('$');
+			size_t pos = name.rfind('.', end == std::string::npos ? std::string::npos : end);
+			if (name[0] != '\\' || pos == std::string::npos)
+				return std::string();
+			return name.substr(1, pos-1);
+		}
+
+		std::string src = cell->get_src_attribute();
+		return src.substr(0, src.find_first_of(":|"));
+	}
+
+	void find_clusters(const std::vector<RTLIL::Cell*> &cells, std::vector<std::string> &cluster_names,
+			std::vector<std::vector<RTLIL::Cell*>> &cluster_cells)
+	{
+		std::map<std::string, std::vector<RTLIL::Cell*>> clusters;
+		for (auto cell : cells) {
+			std::string name = cluster_name(cell);
+			if (!name.empty())
+				clusters[name].push_back(cell);
+		}
+
+		cell_cluster.clear();
+		for (auto &it : clusters) {
+			for (auto cell : it.second)
+				cell_cluster[cell] = GetSize(cluster_names);
+			cluster_names.push_back(it.first);
+			cluster_cells.push_back(std::move(it.second));
+		}
+	}
+
 	void collect_proc_signals(std::vector<RTLIL::SigSpec> &obj, std::set<RTLIL::SigSpec> &signals)
 	{
 		for (auto &it : obj)
@@ -398,57 +537,35 @@ struct ShowWorker
 			fprintf(f, "}\n");
 		}
 
+		std::vector<RTLIL::Cell*> cells;
 		for (auto &it : module->cells_)
-		{
-			if (!design->selected_member(module->name, it.first))
-				continue;
-
-			std::vector<RTLIL::IdString> in_ports, out_ports;
-
-			for (auto &conn : it.second->connections()) {
-				if (!ct.cell_output(it.second->type, conn.first))
-					in_ports.push_back(conn.first);
-				else
-					out_ports.push_back(conn.first);
-			}
-
-			std::sort(in_ports.begin(), in_ports.end(), RTLIL::sort_by_id_str());
-			std::sort(out_ports.begin(), out_ports.end(), RTLIL::sort_by_id_str());
-
-			std::string label_string = "{{";
-
-			for (auto &p : in_ports)
-				label_string += stringf("<p%d> %s%s|", id2num(p), escape(p.str()),
-						genSignedLabels && it.second->hasParam(p.str() + "_SIGNED") &&
-						it.second->getParam(p.str() + "_SIGNED").as_bool() ? "*" : "");
-			if (label_string[label_string.size()-1] == '|')
-				label_string = label_string.substr(0, label_string.size()-1);
-
-			label_string += stringf("}|%s\\n%s|{", findLabel(it.first.str()), escape(it.second->type.str()));
-
-			for (auto &p : out_ports)
-				label_string += stringf("<p%d> %s|", id2num(p), escape(p.str()));
-			if (label_string[label_string.size()-1] == '|')
-				label_string = label_string.substr(0, label_string.size()-1);
+			if (design->selected_member(module->name, it.first))
+				cells.push_back(it.second);
 
-			label_string += "}}";
+		std::vector<std::string> cluster_names;
+		std::vector<std::vector<RTLIL::Cell*>> cluster_cells;
+		if (clusterMode != CLUSTER_NONE)
+			find_clusters(cells, cluster_names, cluster_cells);
 
-			std::string code;
-			for (auto &conn : it.second->connections()) {
-				code += gen_portbox(stringf("c%d:p%d", id2num(it.first), id2num(conn.first)),
-						conn.second, ct.cell_output(it.second->type, conn.first));
+		for (int i = 0; i < GetSize(cluster_names); i++)
+		{
+			if (collapseClusters) {
+				fprintf(f, "k%d [ shape=box3d, label=\"%s\\n%d cells\" ];\n", i, escape(cluster_names[i]), GetSize(cluster_cells[i]));
+				for (auto cell : cluster_cells[i])
+					handle_cell(cell);
+			} else {
+				fprintf(f, "subgraph cluster_k%d {\nlabel=\"%s\";\n", i, escape(cluster_names[i]));
+				for (auto cell : cluster_cells[i])
+					handle_cell(cell);
+				fprintf(f, "}\n");
 			}
-
-#ifdef CLUSTER_CELLS_AND_PORTBOXES
-			if (!code.empty())
-				fprintf(f, "subgraph cluster_c%d {\nc%d [ shape=record, label=\"%s\"%s ];\n%s}\n",
-						id2num(it.first), id2num(it.first), label_string.c_str(), findColor(it.first), code.c_str());
-			else
-#endif
-				fprintf(f, "c%d [ shape=record, label=\"%s\"%s ];\n%s",
-						id2num(it.first), label_string.c_str(), findColor(it.first.str()), code.c_str());
+			dot_escape_store.clear();
 		}
 
+		for (auto cell : cells)
+			if (!cell_cluster.count(cell))
+				handle_cell(cell);
+
 		for (auto &it : module->processes)
 		{
 			RTLIL::Process *proc = it.second;
@@ -485,6 +602,7 @@ struct ShowWorker
 			if (proc->attributes.count("\\src") > 0)
 				proc_src = proc->attributes.at("\\src").decode_string();
 			fprintf(f, "p%d [shape=box, style=rounded, label=\"PROC %s\\n%s\"];\n", pidx, findLabel(proc->name.str()), proc_src.c_str());
+			dot_escape_store.clear();
 		}
 
 		for (auto &conn : module->connections())
@@ -531,6 +649,8 @@ struct ShowWorker
 		{
 			currentColor = xorshift32(currentColor);
 			if (wires_on_demand.count(it.first) > 0) {
+				if (collapseClusters && is_cluster_internal(it.second))
+					continue;
 				if (it.second.in.size() == 1 && it.second.out.size() > 1 && it.second.in.begin()->compare(0, 1, "p") == 0)
 					it.second.out.erase(*it.second.in.begin());
 				if (it.second.in.size() == 1 && it.second.out.size() == 1) {
@@ -546,8 +666,16 @@ struct ShowWorker
 			}
 			for (auto &it2 : it.second.in)
 				fprintf(f, "%s:e -> %s:w [%s, %s];\n", it2.c_str(), it.first.c_str(), nextColor(it.second.color).c_str(), widthLabel(it.second.bits).c_str());
-			for (auto &it2 : it.second.out)
+			int fanout = 0;
+			for (auto &it2 : it.second.out) {
+				if (maxFanout > 0 && fanout++ == maxFanout) {
+					fprintf(f, "v%d [ shape=plaintext, label=\"%d more\" ];\n", single_idx_count, GetSize(it.second.out) - maxFanout);
+					fprintf(f, "%s:e -> v%d:w [%s, style=dashed];\n", it.first.c_str(), single_idx_count++, nextColor(it.second.color).c_str());
+					break;
+				}
 				fprintf(f, "%s:e -> %s:w [%s, %s];\n", it.first.c_str(), it2.c_str(), nextColor(it.second.color).c_str(), widthLabel(it.second.bits).c_str());
+			}
+			dot_escape_store.clear();
 		}
 
 		fprintf(f, "}\n");
@@ -555,11 +683,13 @@ struct ShowWorker
 
 	ShowWorker(FILE *f, RTLIL::Design *design, std::vector<RTLIL::Design*> &libs, uint32_t colorSeed, bool genWidthLabels,
 			bool genSignedLabels, bool stretchIO, bool enumerateIds, bool abbreviateIds, bool notitle,
+			bool collapseBuses, cluster_mode_t clusterMode, bool collapseClusters, int maxFanout,
 			const std::vector<std::pair<std::string, RTLIL::Selection>> &color_selections,
 			const std::vector<std::pair<std::string, RTLIL::Selection>> &label_selections, RTLIL::IdString colorattr) :
 			f(f), design(design), currentColor(colorSeed), genWidthLabels(genWidthLabels),
 			genSignedLabels(genSignedLabels), stretchIO(stretchIO), enumerateIds(enumerateIds), abbreviateIds(abbreviateIds),
-			notitle(notitle), color_selections(color_selections), label_selections(label_selections), colorattr(colorattr)
+			notitle(notitle), collapseBuses(collapseBuses), collapseClusters(collapseClusters), maxFanout(maxFanout),
+			clusterMode(clusterMode), color_selections(color_selections), label_selections(label_selections), colorattr(colorattr)
 	{
 		ct.setup_internals();
 		ct.setup_internals_mem();
@@ -672,6 +802,30 @@ struct ShowPass : public Pass {
 		log("        don't run viewer in the background, IE wait for the viewer tool to\n");
 		log("        exit before returning\n");
 		log("\n");
+		log("The following options reduce the level of detail for large designs:\n");
+		log("\n");
+		log("    -buses\n");
+		log("        connect the cell ports to the nodes of the wires they use instead of\n");
+		log("        drawing a box with the individual bits and slices of each signal.\n");
+		log("\n");
+		log("    -cluster {hier|src}\n");
+		log("        group the cells in clusters by the hierarchical prefix of their names\n");
+		log("        (as created by 'flatten') or by the file name in their src attribute.\n");
+		log("\n");
+		log("    -collapse\n");
+		log("        draw each cluster as a single node with the number of cells in it.\n");
+		log("        nets without a public name that only connect cells of the same\n");
+		log("        cluster are not drawn.\n");
+		log("\n");
+		log("    -maxfanout <N>\n");
+		log("        draw at most <N> edges from a net to its loads, the others are\n");
+		log("        replaced by a node with their number.\n");
+		log("\n");
+		log("The dot file is written while the module is traversed. Combined with a\n");
+		log("selection such as 'show -buses -maxfanout 8 %%ci3:+[A,B,Y] <cell>' this\n");
+		log("makes it possible to look at the neighborhood of a cell in a design with\n");
+		log("millions of cells.\n");
+		log("\n");
 		log("When no <format> is specified, 'dot' is used. When no <format> and <viewer> is\n");
 		log("specified, 'xdot' is used to display the schematic (POSIX systems only).\n");
 		log("\n");
@@ -710,6 +864,10 @@ struct ShowPass : public Pass {
 		bool flag_abbreviate = true;
 		bool flag_notitle = false;
 		bool custom_prefix = false;
+		bool flag_buses = false;
+		bool flag_collapse = false;
+		int max_fanout = 0;
+		ShowWorker::cluster_mode_t cluster_mode = ShowWorker::CLUSTER_NONE;
 		std::string background = "&";
 		RTLIL::IdString colorattr;
 
@@ -796,10 +954,35 @@ struct ShowPass : public Pass {
 				background= "";
 				continue;
 			}
+			if (arg == "-buses") {
+				flag_buses = true;
+				continue;
+			}
+			if (arg == "-cluster" && argidx+1 < args.size()) {
+				std::string mode = args[++argidx];
+				if (mode == "hier")
+					cluster_mode = ShowWorker::CLUSTER_HIER;
+				else if (mode == "src")
+					cluster_mode = ShowWorker::CLUSTER_SRC;
+				else
+					log_cmd_error("Unknown cluster mode '%s'.\n", mode.c_str());
+				continue;
+			}
+			if (arg == "-collapse") {
+				flag_collapse = true;
+				continue;
+			}
+			if (arg == "-maxfanout" && argidx+1 < args.size()) {
+				max_fanout = atoi(args[++argidx].c_str());
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
+		if (flag_collapse && cluster_mode == ShowWorker::CLUSTER_NONE)
+			log_cmd_error("The '-collapse' option requires '-cluster'.\n");
+
 		if (format != "ps" && format != "dot") {
 			int modcount = 0;
 			for (auto &mod_it : design->modules_) {
@@ -840,7 +1023,8 @@ struct ShowPass : public Pass {
 				delete lib;
 			log_cmd_error("Can't open dot file `%s' for writing.\n", dot_file.c_str());
 		}
-		ShowWorker worker(f, design, libs, colorSeed, flag_width, flag_signed, flag_stretch, flag_enum, flag_abbreviate, flag_notitle, color_selections, label_selections, colorattr);
+		ShowWorker worker(f, design, libs, colorSeed, flag_width, flag_signed, flag_stretch, flag_enum, flag_abbreviate, flag_notitle,
+				flag_buses, cluster_mode, flag_collapse, max_fanout, color_selections, label_selections, colorattr);
 		fclose(f);
 
 		for (auto lib : libs)
@@ -69,7 +69,7 @@ struct SplitnetsWorker
 		if (wire->attributes.count("\\init")) {
 			Const old_init = wire->attributes.at("\\init"), new_init;
 			for (int i = offset; i < offset+width; i++)
-				new_init.bits.push_back(i < GetSize(old_init) ? old_init.bits.at(i) : State::Sx);
+				new_init.bits().push_back(i < GetSize(old_init) ? old_init[i] : State::Sx);
 			new_wire->attributes["\\init"] = new_init;
 		}
 
@@ -141,6 +141,7 @@ struct SplitnetsPass : public Pass {
 
 		for (auto module : design->selected_modules())
 		{
+			RTLIL::Module::Batch batch(module);
 			SplitnetsWorker worker;
 
 			if (flag_ports)
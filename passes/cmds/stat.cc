@@ -21,6 +21,7 @@
 #include "kernel/celltypes.h"
 #include "passes/techmap/libparse.h"
 #include "kernel/cost.h"
+#include "libs/json11/json11.hpp"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -109,22 +110,22 @@ struct statdata_t
 
 			if (width_mode)
 			{
-				if (cell_type.in("$not", "$pos", "$neg",
-						"$logic_not", "$logic_and", "$logic_or",
-						"$reduce_and", "$reduce_or", "$reduce_xor", "$reduce_xnor", "$reduce_bool",
-						"$lut", "$and", "$or", "$xor", "$xnor",
-						"$shl", "$shr", "$sshl", "$sshr", "$shift", "$shiftx",
-						"$lt", "$le", "$eq", "$ne", "$eqx", "$nex", "$ge", "$gt",
-						"$add", "$sub", "$mul", "$div", "$mod", "$pow", "$alu")) {
-					int width_a = it.second->hasPort("\\A") ? GetSize(it.second->getPort("\\A")) : 0;
-					int width_b = it.second->hasPort("\\B") ? GetSize(it.second->getPort("\\B")) : 0;
-					int width_y = it.second->hasPort("\\Y") ? GetSize(it.second->getPort("\\Y")) : 0;
+				if (cell_type.in(ID($not), ID($pos), ID($neg),
+						ID($logic_not), ID($logic_and), ID($logic_or),
+						ID($reduce_and), ID($reduce_or), ID($reduce_xor), ID($reduce_xnor), ID($reduce_bool),
+						ID($lut), ID($and), ID($or), ID($xor), ID($xnor),
+						ID($shl), ID($shr), ID($sshl), ID($sshr), ID($shift), ID($shiftx),
+						ID($lt), ID($le), ID($eq), ID($ne), ID($eqx), ID($nex), ID($ge), ID($gt),
+						ID($add), ID($sub), ID($mul), ID($div), ID($mod), ID($pow), ID($alu))) {
+					int width_a = it.second->hasPort(ID::A) ? GetSize(it.second->getPort(ID::A)) : 0;
+					int width_b = it.second->hasPort(ID::B) ? GetSize(it.second->getPort(ID::B)) : 0;
+					int width_y = it.second->hasPort(ID::Y) ? GetSize(it.second->getPort(ID::Y)) : 0;
 					cell_type = stringf("%s_%d", cell_type.c_str(), max<int>({width_a, width_b, width_y}));
 				}
-				else if (cell_type.in("$mux", "$pmux"))
-					cell_type = stringf("%s_%d", cell_type.c_str(), GetSize(it.second->getPort("\\Y")));
-				else if (cell_type.in("$sr", "$dff", "$dffsr", "$adff", "$dlatch", "$dlatchsr"))
-					cell_type = stringf("%s_%d", cell_type.c_str(), GetSize(it.second->getPort("\\Q")));
+				else if (cell_type.in(ID($mux), ID($pmux)))
+					cell_type = stringf("%s_%d", cell_type.c_str(), GetSize(it.second->getPort(ID::Y)));
+				else if (cell_type.in(ID($sr), ID($dff), ID($dffsr), ID($adff), ID($dlatch), ID($dlatchsr)))
+					cell_type = stringf("%s_%d", cell_type.c_str(), GetSize(it.second->getPort(ID(Q))));
 			}
 
 			if (!cell_area.empty()) {
@@ -145,6 +146,84 @@ struct statdata_t
 		}
 	}
 
+	int num_cells_of_type(RTLIL::IdString type) const
+	{
+		auto it = num_cells_by_type.find(type);
+		return it == num_cells_by_type.end() ? 0 : it->second;
+	}
+
+	int estimate_xilinx_lc() const
+	{
+		int lut6_cnt = num_cells_of_type("\\LUT6");
+		int lut5_cnt = num_cells_of_type("\\LUT5");
+		int lut4_cnt = num_cells_of_type("\\LUT4");
+		int lut3_cnt = num_cells_of_type("\\LUT3");
+		int lut2_cnt = num_cells_of_type("\\LUT2");
+		int lut1_cnt = num_cells_of_type("\\LUT1");
+		int lc_cnt = 0;
+
+		lc_cnt += lut6_cnt;
+
+		lc_cnt += lut5_cnt;
+		if (lut1_cnt) {
+			int cnt = std::min(lut5_cnt, lut1_cnt);
+			lut5_cnt -= cnt;
+			lut1_cnt -= cnt;
+		}
+
+		lc_cnt += lut4_cnt;
+		if (lut1_cnt) {
+			int cnt = std::min(lut4_cnt, lut1_cnt);
+			lut4_cnt -= cnt;
+			lut1_cnt -= cnt;
+		}
+		if (lut2_cnt) {
+			int cnt = std::min(lut4_cnt, lut2_cnt);
+			lut4_cnt -= cnt;
+			lut2_cnt -= cnt;
+		}
+
+		lc_cnt += lut3_cnt;
+		if (lut1_cnt) {
+			int cnt = std::min(lut3_cnt, lut1_cnt);
+			lut3_cnt -= cnt;
+			lut1_cnt -= cnt;
+		}
+		if (lut2_cnt) {
+			int cnt = std::min(lut3_cnt, lut2_cnt);
+			lut3_cnt -= cnt;
+			lut2_cnt -= cnt;
+		}
+		if (lut3_cnt) {
+			int cnt = (lut3_cnt + 1) / 2;
+			lut3_cnt -= cnt;
+		}
+
+		lc_cnt += (lut2_cnt + lut1_cnt + 1) / 2;
+		return lc_cnt;
+	}
+
+	int estimate_cmos_transistors(bool &exact) const
+	{
+		int tran_cnt = 0;
+		auto &gate_costs = CellCosts::cmos_gate_cost();
+		exact = true;
+
+		for (auto it : num_cells_by_type) {
+			auto ctype = it.first;
+			auto cnum = it.second;
+
+			if (gate_costs.count(ctype))
+				tran_cnt += cnum * gate_costs.at(ctype);
+			else if (ctype.in("$_DFF_P_", "$_DFF_N_"))
+				tran_cnt += cnum * 16;
+			else
+				exact = false;
+		}
+
+		return tran_cnt;
+	}
+
 	void log_data(RTLIL::IdString mod_name, bool top_mod)
 	{
 		log("   Number of wires:             %6d\n", num_wires);
@@ -172,110 +251,97 @@ struct statdata_t
 
 		if (tech == "xilinx")
 		{
-			int lut6_cnt = num_cells_by_type["\\LUT6"];
-			int lut5_cnt = num_cells_by_type["\\LUT5"];
-			int lut4_cnt = num_cells_by_type["\\LUT4"];
-			int lut3_cnt = num_cells_by_type["\\LUT3"];
-			int lut2_cnt = num_cells_by_type["\\LUT2"];
-			int lut1_cnt = num_cells_by_type["\\LUT1"];
-			int lc_cnt = 0;
-
-			lc_cnt += lut6_cnt;
-
-			lc_cnt += lut5_cnt;
-			if (lut1_cnt) {
-				int cnt = std::min(lut5_cnt, lut1_cnt);
-				lut5_cnt -= cnt;
-				lut1_cnt -= cnt;
-			}
-
-			lc_cnt += lut4_cnt;
-			if (lut1_cnt) {
-				int cnt = std::min(lut4_cnt, lut1_cnt);
-				lut4_cnt -= cnt;
-				lut1_cnt -= cnt;
-			}
-			if (lut2_cnt) {
-				int cnt = std::min(lut4_cnt, lut2_cnt);
-				lut4_cnt -= cnt;
-				lut2_cnt -= cnt;
-			}
-
-			lc_cnt += lut3_cnt;
-			if (lut1_cnt) {
-				int cnt = std::min(lut3_cnt, lut1_cnt);
-				lut3_cnt -= cnt;
-				lut1_cnt -= cnt;
-			}
-			if (lut2_cnt) {
-				int cnt = std::min(lut3_cnt, lut2_cnt);
-				lut3_cnt -= cnt;
-				lut2_cnt -= cnt;
-			}
-			if (lut3_cnt) {
-				int cnt = (lut3_cnt + 1) / 2;
-				lut3_cnt -= cnt;
-			}
-
-			lc_cnt += (lut2_cnt + lut1_cnt + 1) / 2;
-
 			log("\n");
-			log("   Estimated number of LCs: %10d\n", lc_cnt);
+			log("   Estimated number of LCs: %10d\n", estimate_xilinx_lc());
 		}
 
 		if (tech == "cmos")
 		{
-			int tran_cnt = 0;
-			bool tran_cnt_exact = true;
-			auto &gate_costs = CellCosts::cmos_gate_cost();
-
-			for (auto it : num_cells_by_type) {
-				auto ctype = it.first;
-				auto cnum = it.second;
-
-				if (gate_costs.count(ctype))
-					tran_cnt += cnum * gate_costs.at(ctype);
-				else if (ctype.in("$_DFF_P_", "$_DFF_N_"))
-					tran_cnt += cnum * 16;
-				else
-					tran_cnt_exact = false;
-			}
+			bool tran_cnt_exact;
+			int tran_cnt = estimate_cmos_transistors(tran_cnt_exact);
 
 			log("\n");
 			log("   Estimated number of transistors: %10d%s\n", tran_cnt, tran_cnt_exact ? "" : "+");
 		}
 	}
+
+	// one member of a JSON object, the caller adds the separators
+	void log_data_json(const std::string &key)
+	{
+		log("      %s: {\n", json11::Json(key).dump().c_str());
+	#define X(_name) log("         \"" #_name "\": %d,\n", _name);
+		STAT_INT_MEMBERS
+	#undef X
+		if (area != 0)
+			log("         \"area\": %f,\n", area);
+		if (tech == "xilinx")
+			log("         \"estimated_num_lc\": %d,\n", estimate_xilinx_lc());
+		if (tech == "cmos") {
+			bool tran_cnt_exact;
+			int tran_cnt = estimate_cmos_transistors(tran_cnt_exact);
+			log("         \"estimated_num_transistors\": %d,\n", tran_cnt);
+			log("         \"estimated_num_transistors_exact\": %s,\n", tran_cnt_exact ? "true" : "false");
+		}
+		log("         \"num_cells_by_type\": {");
+		bool first = true;
+		for (auto &it : num_cells_by_type)
+			if (it.second) {
+				log("%s\n            %s: %d", first ? "" : ",", json11::Json(it.first.str()).dump().c_str(), it.second);
+				first = false;
+			}
+		log("%s}\n", first ? "" : "\n         ");
+		log("      }");
+	}
 };
 
-statdata_t hierarchy_worker(std::map<RTLIL::IdString, statdata_t> &mod_stat, RTLIL::IdString mod, int level)
+// The totals of every module are computed once, no matter how often the
+// module is instantiated in the hierarchy.
+const statdata_t &hierarchy_total(const std::map<RTLIL::IdString, statdata_t> &mod_stat,
+		std::map<RTLIL::IdString, statdata_t> &mod_totals, RTLIL::IdString mod)
 {
+	auto cached = mod_totals.find(mod);
+	if (cached != mod_totals.end())
+		return cached->second;
+
 	statdata_t mod_data = mod_stat.at(mod);
 	std::map<RTLIL::IdString, int, RTLIL::sort_by_id_str> num_cells_by_type;
 	num_cells_by_type.swap(mod_data.num_cells_by_type);
 
 	for (auto &it : num_cells_by_type)
 		if (mod_stat.count(it.first) > 0) {
-			log("     %*s%-*s %6d\n", 2*level, "", 26-2*level, RTLIL::id2cstr(it.first), it.second);
-			mod_data = mod_data + hierarchy_worker(mod_stat, it.first, level+1) * it.second;
+			mod_data = mod_data + hierarchy_total(mod_stat, mod_totals, it.first) * it.second;
 			mod_data.num_cells -= it.second;
 		} else {
 			mod_data.num_cells_by_type[it.first] += it.second;
 		}
 
-	return mod_data;
+	return mod_totals[mod] = mod_data;
+}
+
+void hierarchy_log(const std::map<RTLIL::IdString, statdata_t> &mod_stat, RTLIL::IdString mod, int level)
+{
+	for (auto &it : mod_stat.at(mod).num_cells_by_type)
+		if (mod_stat.count(it.first) > 0) {
+			log("     %*s%-*s %6d\n", 2*level, "", 26-2*level, RTLIL::id2cstr(it.first), it.second);
+			hierarchy_log(mod_stat, it.first, level+1);
+		}
 }
 
 void read_liberty_cellarea(dict<IdString, double> &cell_area, string liberty_file)
 {
-	std::ifstream f;
-	f.open(liberty_file.c_str());
-	yosys_input_files.insert(liberty_file);
-	if (f.fail())
-		log_cmd_error("Can't open liberty file `%s': %s\n", liberty_file.c_str(), strerror(errno));
-	LibertyParser libparser(f);
-	f.close();
-
-	for (auto cell : libparser.ast->children)
+	LibertyAst *libast = LibertyAstCache::instance.cached_ast(liberty_file);
+	std::unique_ptr<LibertyParser> libparser;
+	if (libast == nullptr) {
+		std::ifstream f;
+		f.open(liberty_file.c_str());
+		if (f.fail())
+			log_cmd_error("Can't open liberty file `%s': %s\n", liberty_file.c_str(), strerror(errno));
+		libparser.reset(new LibertyParser(f));
+		f.close();
+		libast = libparser->ast;
+	}
+
+	for (auto cell : libast->children)
 	{
 		if (cell->id != "cell" || cell->args.size() != 1)
 			continue;
@@ -286,8 +352,8 @@ void read_liberty_cellarea(dict<IdString, double> &cell_area, string liberty_fil
 	}
 }
 
-struct StatPass : public Pass {
-	StatPass() : Pass("stat", "print some statistics") { }
+struct StatPass : public ModulePass {
+	StatPass() : ModulePass("stat", "print some statistics") { module_changes_tracked(); }
 	void help() YS_OVERRIDE
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -313,16 +379,50 @@ struct StatPass : public Pass {
 		log("        annotate internal cell types with their word width.\n");
 		log("        e.g. $add_8 for an 8 bit wide $add cell.\n");
 		log("\n");
+		log("    -json\n");
+		log("        output the statistics in a machine-readable JSON format instead of\n");
+		log("        the text report. the totals of the design hierarchy are in the\n");
+		log("        \"design\" object. use 'tee -q -o <file> stat -json' to write them\n");
+		log("        to a file.\n");
+		log("\n");
+		log("The totals (of the design hierarchy, or of all selected modules if there is\n");
+		log("no top module) are also stored in the scratchpad as stat.num_cells,\n");
+		log("stat.area, stat.num_wires, etc. (see 'help scratchpad' and 'help fork').\n");
+		log("\n");
+		log("The statistics of the modules are collected concurrently when yosys is run\n");
+		log("with multiple threads (yosys -j).\n");
+		log("\n");
 	}
-	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
+
+	bool width_mode, json_mode;
+	dict<IdString, double> cell_area;
+	string techname;
+	std::map<RTLIL::IdString, statdata_t> mod_stat;
+
+	void execute_module(RTLIL::Module *mod) YS_OVERRIDE
 	{
-		log_header(design, "Printing statistics.\n");
+		RTLIL::Design *design = mod->design;
+		statdata_t data(design, mod, width_mode, cell_area, techname);
 
-		bool width_mode = false;
+		if (!json_mode) {
+			log("\n");
+			log("=== %s%s ===\n", RTLIL::id2cstr(mod->name), design->selected_whole_module(mod->name) ? "" : " (partially selected)");
+			log("\n");
+			data.log_data(mod->name, false);
+		}
+
+		mod_stat.at(mod->name) = data;
+	}
+
+	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
+	{
 		RTLIL::Module *top_mod = NULL;
-		std::map<RTLIL::IdString, statdata_t> mod_stat;
-		dict<IdString, double> cell_area;
-		string techname;
+
+		width_mode = false;
+		json_mode = false;
+		cell_area.clear();
+		techname.clear();
+		mod_stat.clear();
 
 		size_t argidx;
 		for (argidx = 1; argidx < args.size(); argidx++)
@@ -347,42 +447,92 @@ struct StatPass : public Pass {
 				top_mod = design->modules_.at(RTLIL::escape_id(args[++argidx]));
 				continue;
 			}
+			if (args[argidx] == "-json") {
+				json_mode = true;
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
+		if (!json_mode)
+			log_header(design, "Printing statistics.\n");
+
 		if (techname != "" && techname != "xilinx" && techname != "cmos")
 			log_cmd_error("Unsupported technology: '%s'\n", techname.c_str());
 
-		for (auto mod : design->selected_modules())
-		{
-			if (!top_mod && design->full_selection())
+		std::vector<RTLIL::Module*> modules = design->selected_modules();
+
+		if (!top_mod && design->full_selection())
+			for (auto mod : modules)
 				if (mod->get_bool_attribute("\\top"))
 					top_mod = mod;
 
-			statdata_t data(design, mod, width_mode, cell_area, techname);
-			mod_stat[mod->name] = data;
+		// the entries are created up front, so that the modules can store their
+		// statistics concurrently without changing the map
+		for (auto mod : modules)
+			mod_stat[mod->name] = statdata_t();
 
-			log("\n");
-			log("=== %s%s ===\n", RTLIL::id2cstr(mod->name), design->selected_whole_module(mod->name) ? "" : " (partially selected)");
-			log("\n");
-			data.log_data(mod->name, false);
+		execute_modules(modules);
+
+		bool hierarchy_mode = top_mod != NULL && GetSize(mod_stat) > 1 && mod_stat.count(top_mod->name);
+
+		statdata_t total;
+		if (hierarchy_mode) {
+			std::map<RTLIL::IdString, statdata_t> mod_totals;
+			total = hierarchy_total(mod_stat, mod_totals, top_mod->name);
+		} else {
+			for (auto mod : modules)
+				total = total + mod_stat.at(mod->name);
 		}
+	#define X(_name) design->scratchpad_set_int("stat." #_name, total._name);
+		STAT_INT_MEMBERS
+	#undef X
+		design->scratchpad_set_string("stat.area", stringf("%.17g", total.area));
 
-		if (top_mod != NULL && GetSize(mod_stat) > 1)
+		if (json_mode)
 		{
-			log("\n");
-			log("=== design hierarchy ===\n");
-			log("\n");
-
-			log("   %-28s %6d\n", RTLIL::id2cstr(top_mod->name), 1);
-			statdata_t data = hierarchy_worker(mod_stat, top_mod->name, 0);
+			string invocation = args[0];
+			for (size_t i = 1; i < args.size(); i++)
+				invocation += " " + args[i];
+
+			log("{\n");
+			log("   \"creator\": %s,\n", json11::Json(yosys_version_str).dump().c_str());
+			log("   \"invocation\": %s,\n", json11::Json(invocation).dump().c_str());
+			log("   \"modules\": {\n");
+			for (int i = 0; i < GetSize(modules); i++) {
+				mod_stat.at(modules[i]->name).log_data_json(modules[i]->name.str());
+				log("%s\n", i+1 < GetSize(modules) ? "," : "");
+			}
+			log("   }%s\n", hierarchy_mode ? "," : "");
+		}
 
-			log("\n");
-			data.log_data(top_mod->name, true);
+		if (hierarchy_mode)
+		{
+			statdata_t &data = total;
+
+			if (json_mode) {
+				log("   \"design\": {\n");
+				log("      \"top\": %s,\n", json11::Json(top_mod->name.str()).dump().c_str());
+				data.log_data_json("totals");
+				log("\n   }\n");
+			} else {
+				log("\n");
+				log("=== design hierarchy ===\n");
+				log("\n");
+
+				log("   %-28s %6d\n", RTLIL::id2cstr(top_mod->name), 1);
+				hierarchy_log(mod_stat, top_mod->name, 0);
+
+				log("\n");
+				data.log_data(top_mod->name, true);
+			}
 		}
 
-		log("\n");
+		if (json_mode)
+			log("}\n");
+		else
+			log("\n");
 	}
 } StatPass;
 
@@ -26,7 +26,7 @@ USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
 struct TeePass : public Pass {
-	TeePass() : Pass("tee", "redirect command output to file") { }
+	TeePass() : Pass("tee", "redirect command output to file") { module_changes_tracked(); }
 	void help() YS_OVERRIDE
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -89,6 +89,7 @@ struct TeePass : public Pass {
 			std::vector<std::string> new_args(args.begin() + argidx, args.end());
 			Pass::call(design, new_args);
 		} catch (...) {
+			log_flush();
 			for (auto cf : files_to_close)
 				fclose(cf);
 			log_files = backup_log_files;
@@ -96,6 +97,7 @@ struct TeePass : public Pass {
 			throw;
 		}
 
+		log_flush();
 		for (auto cf : files_to_close)
 			fclose(cf);
 
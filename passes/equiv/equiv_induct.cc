@@ -20,17 +20,18 @@
 #include "kernel/yosys.h"
 #include "kernel/satgen.h"
 #include "kernel/sigtools.h"
+#include "kernel/threadpool.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
 struct EquivInductWorker
 {
-	Module *module;
-	SigMap sigmap;
+	SigMap &sigmap;
 
 	vector<Cell*> cells;
 	pool<Cell*> workset;
+	vector<Cell*> proven_cells;
 
 	ezSatPtr ez;
 	SatGen satgen;
@@ -42,8 +43,8 @@ struct EquivInductWorker
 	pool<Cell*> cell_warn_cache;
 	SigPool undriven_signals;
 
-	EquivInductWorker(Module *module, const pool<Cell*> &unproven_equiv_cells, bool model_undef, int max_seq) : module(module), sigmap(module),
-			cells(module->selected_cells()), workset(unproven_equiv_cells),
+	EquivInductWorker(SigMap &sigmap, const vector<Cell*> &cells, const pool<Cell*> &unproven_equiv_cells, bool model_undef, int max_seq) :
+			sigmap(sigmap), cells(cells), workset(unproven_equiv_cells),
 			satgen(ez.get(), &sigmap), max_seq(max_seq), success_counter(0)
 	{
 		satgen.model_undef = model_undef;
@@ -81,10 +82,11 @@ struct EquivInductWorker
 		ez_step_is_consistent[step] = ez->expression(ez->OpAnd, ez_equal_terms);
 	}
 
+	// The proven cells are only collected here and marked as proven by the
+	// caller, so that the module is not modified while other groups may still
+	// be running on worker threads.
 	void run()
 	{
-		log("Found %d unproven $equiv cells in module %s:\n", GetSize(workset), log_id(module));
-
 		if (satgen.model_undef) {
 			for (auto cell : cells)
 				if (yosys_celltypes.cell_known(cell->type))
@@ -125,7 +127,7 @@ struct EquivInductWorker
 			if (!ez->solve(new_step_not_consistent)) {
 				log("  Proof for induction step holds. Entire workset of %d cells proven!\n", GetSize(workset));
 				for (auto cell : workset)
-					cell->setPort("\\B", cell->getPort("\\A"));
+					proven_cells.push_back(cell);
 				success_counter += GetSize(workset);
 				return;
 			}
@@ -135,13 +137,19 @@ struct EquivInductWorker
 
 		workset.sort();
 
+		// All remaining cells are checked with a single solver call: every cell
+		// that differs in the model is not provable, and when there is no model
+		// left all remaining cells are proven. The disjunction for each call is
+		// enabled by an activation literal that is retired after the call.
+		vector<Cell*> candidates;
+		dict<Cell*, int> ez_cell_differs;
+		pool<Cell*> failed_cells;
+
 		for (auto cell : workset)
 		{
 			SigBit bit_a = sigmap(cell->getPort("\\A")).as_bit();
 			SigBit bit_b = sigmap(cell->getPort("\\B")).as_bit();
 
-			log("  Trying to prove $equiv for %s:", log_signal(sigmap(cell->getPort("\\Y"))));
-
 			int ez_a = satgen.importSigBit(bit_a, max_seq+1);
 			int ez_b = satgen.importSigBit(bit_b, max_seq+1);
 			int cond = ez->XOR(ez_a, ez_b);
@@ -149,9 +157,42 @@ struct EquivInductWorker
 			if (satgen.model_undef)
 				cond = ez->AND(cond, ez->NOT(satgen.importUndefSigBit(bit_a, max_seq+1)));
 
-			if (!ez->solve(cond)) {
+			ez_cell_differs[cell] = cond;
+			candidates.push_back(cell);
+		}
+
+		while (!candidates.empty())
+		{
+			vector<int> ez_differs;
+			for (auto cell : candidates)
+				ez_differs.push_back(ez_cell_differs.at(cell));
+
+			int ez_active = ez->frozen_literal();
+			ez->assume(ez->OR(ez->NOT(ez_active), ez->expression(ezSAT::OpOr, ez_differs)));
+
+			vector<bool> model;
+			bool found_model = ez->solve(ez_differs, model, ez_active);
+			ez->assume(ez->NOT(ez_active));
+
+			if (!found_model)
+				break;
+
+			vector<Cell*> next_candidates;
+			for (int i = 0; i < GetSize(candidates); i++)
+				if (model[i])
+					failed_cells.insert(candidates[i]);
+				else
+					next_candidates.push_back(candidates[i]);
+			candidates.swap(next_candidates);
+		}
+
+		for (auto cell : workset)
+		{
+			log("  Trying to prove $equiv for %s:", log_signal(sigmap(cell->getPort("\\Y"))));
+
+			if (!failed_cells.count(cell)) {
 				log(" success!\n");
-				cell->setPort("\\B", cell->getPort("\\A"));
+				proven_cells.push_back(cell);
 				success_counter++;
 			} else {
 				log(" failed.\n");
@@ -160,6 +201,12 @@ struct EquivInductWorker
 	}
 };
 
+struct EquivInductGroup
+{
+	vector<Cell*> cells;
+	pool<Cell*> workset;
+};
+
 struct EquivInductPass : public Pass {
 	EquivInductPass() : Pass("equiv_induct", "proving $equiv cells using temporal induction") { }
 	void help() YS_OVERRIDE
@@ -179,6 +226,16 @@ struct EquivInductPass : public Pass {
 		log("    -seq <N>\n");
 		log("        the max. number of time steps to be considered (default = 4)\n");
 		log("\n");
+		log("    -j <num>\n");
+		log("        split the $equiv cells into groups whose input cones do not share any\n");
+		log("        cells and prove up to <num> groups concurrently, each with its own SAT\n");
+		log("        solver. the log output and the results are the same for all values of\n");
+		log("        <num>. because the groups are proven separately, a group that diverges\n");
+		log("        does not prevent proving the other groups.\n");
+		log("\n");
+		log("    -stats\n");
+		log("        print the statistics of the SAT solver at the end\n");
+		log("\n");
 		log("This command is very effective in proving complex sequential circuits, when\n");
 		log("the internal state of the circuit quickly propagates to $equiv cells.\n");
 		log("\n");
@@ -192,11 +249,76 @@ struct EquivInductPass : public Pass {
 		log("after reset.\n");
 		log("\n");
 	}
+	// The unproven $equiv cells are grouped by the cells in their input cones
+	// (across FFs). The SAT problems of two groups have no common variables,
+	// so every group can be proven on its own.
+	static vector<EquivInductGroup> split_cones(const SigMap &sigmap, const vector<Cell*> &cells, const pool<Cell*> &unproven_equiv_cells)
+	{
+		dict<SigBit, Cell*> bit2driver;
+		for (auto cell : cells)
+			for (auto &conn : cell->connections())
+				if (yosys_celltypes.cell_output(cell->type, conn.first))
+					for (auto bit : sigmap(conn.second))
+						bit2driver[bit] = cell;
+
+		vector<Cell*> equiv_cells(unproven_equiv_cells.begin(), unproven_equiv_cells.end());
+		std::sort(equiv_cells.begin(), equiv_cells.end(), RTLIL::sort_by_name_str<Cell>());
+
+		mfp<Cell*> cones;
+		pool<Cell*> visited;
+
+		for (auto equiv_cell : equiv_cells)
+		{
+			cones(equiv_cell);
+			if (!visited.insert(equiv_cell).second)
+				continue;
+
+			vector<Cell*> queue = {equiv_cell};
+			while (!queue.empty())
+			{
+				Cell *cell = queue.back();
+				queue.pop_back();
+
+				for (auto &conn : cell->connections()) {
+					if (!yosys_celltypes.cell_input(cell->type, conn.first))
+						continue;
+					for (auto bit : sigmap(conn.second)) {
+						Cell *driver = bit2driver.at(bit, nullptr);
+						if (driver == nullptr)
+							continue;
+						cones.merge(equiv_cell, driver);
+						if (visited.insert(driver).second)
+							queue.push_back(driver);
+					}
+				}
+			}
+		}
+
+		vector<EquivInductGroup> groups;
+		dict<Cell*, int> group_index;
+
+		for (auto equiv_cell : equiv_cells) {
+			Cell *root = cones.find(equiv_cell);
+			if (!group_index.count(root)) {
+				group_index[root] = GetSize(groups);
+				groups.emplace_back();
+			}
+			groups[group_index.at(root)].workset.insert(equiv_cell);
+		}
+
+		for (auto cell : cells)
+			if (visited.count(cell))
+				groups[group_index.at(cones.find(cell))].cells.push_back(cell);
+
+		return groups;
+	}
+
 	void execute(std::vector<std::string> args, Design *design) YS_OVERRIDE
 	{
 		int success_counter = 0;
-		bool model_undef = false;
+		bool model_undef = false, show_stats = false;
 		int max_seq = 4;
+		int num_threads = 0;
 
 		log_header(design, "Executing EQUIV_INDUCT pass.\n");
 
@@ -210,10 +332,20 @@ struct EquivInductPass : public Pass {
 				max_seq = atoi(args[++argidx].c_str());
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
+			if (args[argidx] == "-stats") {
+				show_stats = true;
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
+		ezSAT::SolverStats stats_before = get_sat_stats();
+
 		for (auto module : design->selected_modules())
 		{
 			pool<Cell*> unproven_equiv_cells;
@@ -229,12 +361,116 @@ struct EquivInductPass : public Pass {
 				continue;
 			}
 
-			EquivInductWorker worker(module, unproven_equiv_cells, model_undef, max_seq);
-			worker.run();
-			success_counter += worker.success_counter;
+			SigMap sigmap(module);
+			vector<Cell*> cells = module->selected_cells();
+
+			auto mark_proven = [&](const vector<Cell*> &proven_cells) {
+				for (auto cell : proven_cells)
+					cell->setPort("\\B", cell->getPort("\\A"));
+				success_counter += GetSize(proven_cells);
+			};
+
+			if (num_threads == 0) {
+				log("Found %d unproven $equiv cells in module %s:\n", GetSize(unproven_equiv_cells), log_id(module));
+				EquivInductWorker worker(sigmap, cells, unproven_equiv_cells, model_undef, max_seq);
+				worker.run();
+				mark_proven(worker.proven_cells);
+				continue;
+			}
+
+			// cells outside of the cones are not passed to any worker
+			for (auto cell : cells)
+				if (!yosys_celltypes.cell_known(cell->type))
+					log_warning("No SAT model available for cell %s (%s).\n", log_id(cell), log_id(cell->type));
+
+			vector<EquivInductGroup> groups = split_cones(sigmap, cells, unproven_equiv_cells);
+			vector<vector<Cell*>> proven_cells(GetSize(groups));
+
+			log("Found %d unproven $equiv cells (%d groups) in module %s:\n",
+					GetSize(unproven_equiv_cells), GetSize(groups), log_id(module));
+
+			auto run_group = [&](int i, SigMap &group_sigmap) {
+				log(" Proving group %d with %d $equiv cells over %d cells:\n", i+1,
+						GetSize(groups[i].workset), GetSize(groups[i].cells));
+				EquivInductWorker worker(group_sigmap, groups[i].cells, groups[i].workset, model_undef, max_seq);
+				worker.run();
+				proven_cells[i].swap(worker.proven_cells);
+			};
+
+#ifdef YOSYS_ENABLE_THREADS
+			int module_threads = std::min(num_threads, GetSize(groups));
+
+			if (module_threads > 1)
+			{
+				vector<LogCapture> captures(GetSize(groups));
+				vector<std::exception_ptr> errors(GetSize(groups));
+				std::atomic<int> next_index(0);
+				std::atomic<bool> abort(false);
+
+				// Large groups are handed out first in the order of the
+				// groups, so the threads do not wait for one last big group.
+				vector<int> order(GetSize(groups));
+				for (int i = 0; i < GetSize(groups); i++)
+					order[i] = i;
+				std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+					return GetSize(groups[a].cells) > GetSize(groups[b].cells);
+				});
+
+				// SigMap lookups compress paths, so every task uses its
+				// own copy.
+				auto worker_task = [&]() {
+					SigMap task_sigmap = sigmap;
+					while (!abort) {
+						int k = next_index++;
+						if (k >= GetSize(groups))
+							break;
+						int i = order[k];
+						log_capture_begin(&captures[i]);
+						try {
+							run_group(i, task_sigmap);
+						} catch (...) {
+							errors[i] = std::current_exception();
+							abort = true;
+						}
+						log_capture_end();
+					}
+				};
+
+				TaskGroup group(module_threads);
+				for (int i = 0; i < module_threads; i++)
+					group.run(worker_task);
+				group.wait();
+
+				// after an error some groups may not have been started, the
+				// output is replayed up to the first failed group
+				for (int i = 0; i < GetSize(groups); i++) {
+					captures[i].replay();
+					if (errors[i]) {
+						try {
+							std::rethrow_exception(errors[i]);
+						} catch (log_capture_error_exception&) {
+							log_abort();
+						}
+					}
+					mark_proven(proven_cells[i]);
+				}
+				continue;
+			}
+#endif
+
+			for (int i = 0; i < GetSize(groups); i++) {
+				run_group(i, sigmap);
+				mark_proven(proven_cells[i]);
+			}
 		}
 
 		log("Proved %d previously unproven $equiv cells.\n", success_counter);
+
+		if (show_stats) {
+			ezSAT::SolverStats stats = get_sat_stats();
+			stats -= stats_before;
+			log_sat_stats(stats);
+		}
 	}
 } EquivInductPass;
 
@@ -41,6 +41,7 @@ struct EquivMakeWorker
 	SigMap assign_map;
 
 	dict<SigBit, pool<Cell*>> bit2driven; // map: bit <--> and its driven cells
+	dict<pair<SigBit, SigBit>, bool> fanout_cache;
 
 	CellTypes comb_ct;
 
@@ -145,7 +146,7 @@ struct EquivMakeWorker
 
 	void find_same_wires()
 	{
-		SigMap assign_map(equiv_mod);
+		// assign_map is up to date, find_undriven_nets() has just run
 		SigMap rd_signal_map;
 
 		// list of cells without added $equiv cells
@@ -290,7 +291,6 @@ struct EquivMakeWorker
 
 		init_bit2driven();
 
-		pool<Cell*> visited_cells;
 		for (auto c : cells_list)
 		for (auto &conn : c->connections())
 			if (!ct.cell_output(c->type, conn.first)) {
@@ -302,8 +302,7 @@ struct EquivMakeWorker
 					for (int i = 0; i < GetSize(old_sig); i++) {
 						SigBit old_bit = old_sig[i], new_bit = new_sig[i];
 
-						visited_cells.clear();
-						if (check_signal_in_fanout(visited_cells, old_bit, new_bit))
+						if (check_signal_in_fanout(old_bit, new_bit))
 							continue;
 
 						log("Changing input %s of cell %s (%s): %s -> %s\n",
@@ -419,39 +418,50 @@ struct EquivMakeWorker
 		}
 	}
 
-	bool check_signal_in_fanout(pool<Cell*> & visited_cells, SigBit source_bit, SigBit target_bit)
+	// Is target_bit in the combinational fanout of source_bit? The results
+	// are cached, the inputs of the same bit are often changed in many cells.
+	bool check_signal_in_fanout(SigBit source_bit, SigBit target_bit)
 	{
-		if (source_bit == target_bit)
-			return true;
+		auto key = make_pair(source_bit, target_bit);
+		auto cache_it = fanout_cache.find(key);
+		if (cache_it != fanout_cache.end())
+			return cache_it->second;
 
-		if (bit2driven.count(source_bit) == 0)
-			return false;
+		pool<Cell*> visited_cells;
+		pool<SigBit> visited_bits;
+		vector<SigBit> stack = {source_bit};
+		bool found = false;
 
-		auto driven_cells = bit2driven.at(source_bit);
-		for (auto driven_cell: driven_cells)
+		while (!stack.empty() && !found)
 		{
-			bool is_comb = comb_ct.cell_known(driven_cell->type);
-			if (!is_comb)
-				continue;
+			SigBit bit = stack.back();
+			stack.pop_back();
 
-			if (visited_cells.count(driven_cell) > 0)
+			if (bit == target_bit) {
+				found = true;
+				break;
+			}
+
+			auto it = bit2driven.find(bit);
+			if (it == bit2driven.end() || !visited_bits.insert(bit).second)
 				continue;
-			visited_cells.insert(driven_cell);
 
-			for (auto &conn: driven_cell->connections())
+			for (auto driven_cell : it->second)
 			{
-				if (yosys_celltypes.cell_input(driven_cell->type, conn.first))
+				if (!comb_ct.cell_known(driven_cell->type))
+					continue;
+				if (!visited_cells.insert(driven_cell).second)
 					continue;
 
-				for (auto bit: conn.second) {
-					bool is_in_fanout = check_signal_in_fanout(visited_cells, bit, target_bit);
-					if (is_in_fanout == true)
-						return true;
-				}
+				for (auto &conn : driven_cell->connections())
+					if (!yosys_celltypes.cell_input(driven_cell->type, conn.first))
+						for (auto out_bit : conn.second)
+							stack.push_back(out_bit);
 			}
 		}
 
-		return false;
+		fanout_cache[key] = found;
+		return found;
 	}
 
 	void run()
@@ -60,12 +60,16 @@ struct EquivOptPass:public ScriptPass
 		log("    -undef\n");
 		log("        enable modelling of undef states during equiv_induct.\n");
 		log("\n");
+		log("    -j <num>\n");
+		log("        prove the $equiv cells in groups with independent input cones, using\n");
+		log("        up to <num> threads (passed to equiv_induct).\n");
+		log("\n");
 		log("The following commands are executed by this verification command:\n");
 		help_script();
 		log("\n");
 	}
 
-	std::string command, techmap_opts, make_opts;
+	std::string command, techmap_opts, make_opts, induct_opts;
 	bool assert, undef, multiclock, async2sync;
 
 	void clear_flags() YS_OVERRIDE
@@ -73,6 +77,7 @@ struct EquivOptPass:public ScriptPass
 		command = "";
 		techmap_opts = "";
 		make_opts = "";
+		induct_opts = "";
 		assert = false;
 		undef = false;
 		multiclock = false;
@@ -110,6 +115,10 @@ struct EquivOptPass:public ScriptPass
 				undef = true;
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx + 1 < args.size()) {
+				induct_opts += " -j " + args[++argidx];
+				continue;
+			}
 			if (args[argidx] == "-multiclock") {
 				multiclock = true;
 				continue;
@@ -186,11 +195,11 @@ struct EquivOptPass:public ScriptPass
 				opts = make_opts;
 			run("equiv_make" + opts + " gold gate equiv");
 			if (help_mode)
-				run("equiv_induct [-undef] equiv");
+				run("equiv_induct [-undef] [-j <num>] equiv");
 			else if (undef)
-				run("equiv_induct -undef equiv");
+				run("equiv_induct -undef" + induct_opts + " equiv");
 			else
-				run("equiv_induct equiv");
+				run("equiv_induct" + induct_opts + " equiv");
 			if (help_mode)
 				run("equiv_status [-assert] equiv");
 			else if (assert)
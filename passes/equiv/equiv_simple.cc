@@ -19,6 +19,8 @@
 
 #include "kernel/yosys.h"
 #include "kernel/satgen.h"
+#include "kernel/randsim.h"
+#include "kernel/threadpool.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -31,6 +33,7 @@ struct EquivSimpleWorker
 
 	SigMap &sigmap;
 	dict<SigBit, Cell*> &bit2driver;
+	const pool<Cell*> &refuted_cells;
 
 	ezSatPtr ez;
 	SatGen satgen;
@@ -39,10 +42,12 @@ struct EquivSimpleWorker
 	bool verbose;
 
 	pool<pair<Cell*, int>> imported_cells_cache;
+	vector<Cell*> proven_cells;
 
-	EquivSimpleWorker(const vector<Cell*> &equiv_cells, SigMap &sigmap, dict<SigBit, Cell*> &bit2driver, int max_seq, bool short_cones, bool verbose, bool model_undef) :
-			module(equiv_cells.front()->module), equiv_cells(equiv_cells), equiv_cell(nullptr),
-			sigmap(sigmap), bit2driver(bit2driver), satgen(ez.get(), &sigmap), max_seq(max_seq), short_cones(short_cones), verbose(verbose)
+	EquivSimpleWorker(const vector<Cell*> &equiv_cells, SigMap &sigmap, dict<SigBit, Cell*> &bit2driver, const pool<Cell*> &refuted_cells,
+			int max_seq, bool short_cones, bool verbose, bool model_undef) :
+			module(equiv_cells.front()->module), equiv_cells(equiv_cells), equiv_cell(nullptr), sigmap(sigmap), bit2driver(bit2driver),
+			refuted_cells(refuted_cells), satgen(ez.get(), &sigmap), max_seq(max_seq), short_cones(short_cones), verbose(verbose)
 	{
 		satgen.model_undef = model_undef;
 	}
@@ -199,7 +204,7 @@ struct EquivSimpleWorker
 
 			if (!ez->solve(ez_context)) {
 				log(verbose ? "    Proved equivalence! Marking $equiv cell as proven.\n" : " success!\n");
-				equiv_cell->setPort("\\B", equiv_cell->getPort("\\A"));
+				proven_cells.push_back(equiv_cell);
 				ez->assume(ez->NOT(ez_context));
 				return true;
 			}
@@ -251,7 +256,10 @@ struct EquivSimpleWorker
 		return false;
 	}
 
-	int run()
+	// The proven cells are only collected here and marked as proven by the
+	// caller, so that the module is not modified while other groups may still
+	// be running on worker threads.
+	void run()
 	{
 		if (GetSize(equiv_cells) > 1) {
 			SigSpec sig;
@@ -260,13 +268,17 @@ struct EquivSimpleWorker
 			log(" Grouping SAT models for %s:\n", log_signal(sig));
 		}
 
-		int counter = 0;
 		for (auto c : equiv_cells) {
+			if (refuted_cells.count(c)) {
+				if (verbose)
+					log("  Skipping $equiv cell %s: refuted by random simulation.\n", log_id(c));
+				else
+					log("  Skipping $equiv for %s: refuted by random simulation.\n", log_signal(c->getPort("\\Y")));
+				continue;
+			}
 			equiv_cell = c;
-			if (run_cell())
-				counter++;
+			run_cell();
 		}
-		return counter;
 	}
 
 };
@@ -297,12 +309,26 @@ struct EquivSimplePass : public Pass {
 		log("    -seq <N>\n");
 		log("        the max. number of time steps to be considered (default = 1)\n");
 		log("\n");
+		log("    -nosim\n");
+		log("        do not try to refute $equiv cells with a bit-parallel random simulation\n");
+		log("        before running the SAT solver on them.\n");
+		log("\n");
+		log("    -j <num>\n");
+		log("        prove up to <num> groups of $equiv cells concurrently, each with its\n");
+		log("        own SAT solver. the log output is the same as without this option.\n");
+		log("        (default: the number of threads given to 'yosys -j')\n");
+		log("\n");
+		log("    -stats\n");
+		log("        print the statistics of the SAT solver at the end\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, Design *design) YS_OVERRIDE
 	{
-		bool verbose = false, short_cones = false, model_undef = false, nogroup = false;
+		bool verbose = false, short_cones = false, model_undef = false, nogroup = false, nosim = false;
+		bool show_stats = false;
 		int success_counter = 0;
 		int max_seq = 1;
+		int num_threads YS_ATTRIBUTE(unused) = yosys_threads;
 
 		log_header(design, "Executing EQUIV_SIMPLE pass.\n");
 
@@ -328,10 +354,24 @@ struct EquivSimplePass : public Pass {
 				max_seq = atoi(args[++argidx].c_str());
 				continue;
 			}
+			if (args[argidx] == "-nosim") {
+				nosim = true;
+				continue;
+			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
+			if (args[argidx] == "-stats") {
+				show_stats = true;
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
+		ezSAT::SolverStats stats_before = get_sat_stats();
+
 		CellTypes ct;
 		ct.setup_internals();
 		ct.setup_stdcells();
@@ -359,6 +399,8 @@ struct EquivSimplePass : public Pass {
 			log("Found %d unproven $equiv cells (%d groups) in %s:\n",
 					unproven_cells_counter, GetSize(unproven_equiv_cells), log_id(module));
 
+			RandomSim sim(sigmap);
+
 			for (auto cell : module->cells()) {
 				if (!ct.cell_known(cell->type) && !cell->type.in("$dff", "$_DFF_P_", "$_DFF_N_", "$ff", "$_FF_"))
 					continue;
@@ -366,23 +408,122 @@ struct EquivSimplePass : public Pass {
 					if (yosys_celltypes.cell_output(cell->type, conn.first))
 						for (auto bit : sigmap(conn.second))
 							bit2driver[bit] = cell;
+				sim.add_cell(cell);
 			}
 
+			vector<vector<Cell*>> groups;
+
 			unproven_equiv_cells.sort();
 			for (auto it : unproven_equiv_cells)
 			{
 				it.second.sort();
 
-				vector<Cell*> cells;
+				groups.push_back(vector<Cell*>());
 				for (auto it2 : it.second)
-					cells.push_back(it2.second);
+					groups.back().push_back(it2.second);
+			}
 
-				EquivSimpleWorker worker(cells, sigmap, bit2driver, max_seq, short_cones, verbose, model_undef);
-				success_counter += worker.run();
+			// A and B are compared in the last time step of an unrolling over
+			// max_seq+1 steps, which is a valid assignment for the SAT problems
+			// of all sequence lengths. A difference refutes the cell for good.
+			pool<Cell*> refuted_cells;
+
+			if (!nosim)
+			{
+				for (int round = 0; round < 4; round++) {
+					sim.next_round();
+					for (auto &group : groups)
+						for (auto cell : group) {
+							RandomSim::word_t value_a, value_b;
+							if (refuted_cells.count(cell))
+								continue;
+							if (!sim.get(cell->getPort("\\A").as_bit(), value_a, max_seq) || !sim.get(cell->getPort("\\B").as_bit(), value_b, max_seq))
+								continue;
+							if (value_a != value_b)
+								refuted_cells.insert(cell);
+						}
+				}
+
+				log("Refuted %d $equiv cells by random simulation.\n", GetSize(refuted_cells));
+			}
+
+			vector<vector<Cell*>> proven_cells(GetSize(groups));
+
+			auto mark_proven = [&](int i) {
+				for (auto cell : proven_cells[i])
+					cell->setPort("\\B", cell->getPort("\\A"));
+				success_counter += GetSize(proven_cells[i]);
+			};
+
+#ifdef YOSYS_ENABLE_THREADS
+			int module_threads = std::min(num_threads, GetSize(groups));
+
+			if (module_threads > 1)
+			{
+				vector<LogCapture> captures(GetSize(groups));
+				vector<std::exception_ptr> errors(GetSize(groups));
+				std::atomic<int> next_index(0);
+				std::atomic<bool> abort(false);
+
+				// Idle threads take the next unstarted group, so a few groups
+				// with large cones do not hold up the rest. SigMap lookups
+				// compress paths, so every task uses its own copy.
+				auto worker_task = [&]() {
+					SigMap task_sigmap = sigmap;
+					while (!abort) {
+						int i = next_index++;
+						if (i >= GetSize(groups))
+							break;
+						log_capture_begin(&captures[i]);
+						try {
+							EquivSimpleWorker worker(groups[i], task_sigmap, bit2driver, refuted_cells, max_seq, short_cones, verbose, model_undef);
+							worker.run();
+							proven_cells[i].swap(worker.proven_cells);
+						} catch (...) {
+							errors[i] = std::current_exception();
+							abort = true;
+						}
+						log_capture_end();
+					}
+				};
+
+				TaskGroup group(module_threads);
+				for (int i = 0; i < module_threads; i++)
+					group.run(worker_task);
+				group.wait();
+
+				// groups are handed out in order, so all groups before the
+				// first failed one have been completed
+				for (int i = 0; i < GetSize(groups); i++) {
+					captures[i].replay();
+					if (errors[i]) {
+						try {
+							std::rethrow_exception(errors[i]);
+						} catch (log_capture_error_exception&) {
+							log_abort();
+						}
+					}
+					mark_proven(i);
+				}
+				continue;
+			}
+#endif
+
+			for (int i = 0; i < GetSize(groups); i++) {
+				EquivSimpleWorker worker(groups[i], sigmap, bit2driver, refuted_cells, max_seq, short_cones, verbose, model_undef);
+				worker.run();
+				proven_cells[i].swap(worker.proven_cells);
+				mark_proven(i);
 			}
 		}
 
 		log("Proved %d previously unproven $equiv cells.\n", success_counter);
+
+		if (show_stats) {
+			ezSAT::SolverStats stats = get_sat_stats();
+			stats -= stats_before;
+			log_sat_stats(stats);
+		}
 	}
 } EquivSimplePass;
 
@@ -23,6 +23,12 @@
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
+// The worker is kept over all iterations on a module. The first iteration
+// hashes all cells. As long as the forward sweeps merge cells, the following
+// iterations only rehash the cells whose inputs were changed by the merges
+// (found with an index of the cells that read each signal bit). When an
+// incremental sweep finds nothing, all cells are hashed again for the
+// backward sweep, so the result is a fixpoint of the full sweeps.
 struct EquivStructWorker
 {
 	Module *module;
@@ -55,8 +61,81 @@ struct EquivStructWorker
 		}
 	};
 
-	dict<merge_key_t, pool<IdString>> merge_cache;
-	pool<merge_key_t> fwd_merge_cache, bwd_merge_cache;
+	// forward keys of the cells, grouped, and the cells reading each bit
+	bool need_rebuild = true;
+	pool<IdString> cells;
+	dict<IdString, merge_key_t> cell_keys;
+	dict<merge_key_t, pool<IdString>> fwd_groups;
+	dict<SigBit, pool<IdString>> bit_readers;
+	pool<IdString> dirty_cells;
+
+	merge_key_t base_key(Cell *cell)
+	{
+		merge_key_t key;
+		key.type = cell->type;
+
+		for (auto &it : cell->parameters)
+			key.parameters.push_back(it);
+		std::sort(key.parameters.begin(), key.parameters.end());
+
+		for (auto &it : cell->connections())
+			key.port_sizes.push_back(make_pair(it.first, GetSize(it.second)));
+		std::sort(key.port_sizes.begin(), key.port_sizes.end());
+
+		return key;
+	}
+
+	void index_cell(IdString cell_name)
+	{
+		Cell *cell = module->cell(cell_name);
+		merge_key_t key = base_key(cell);
+
+		for (auto &conn : cell->connections())
+			if (cell->input(conn.first)) {
+				SigSpec sig = sigmap(conn.second);
+				for (int i = 0; i < GetSize(sig); i++) {
+					key.connections.push_back(make_tuple(conn.first, i, sig[i]));
+					if (sig[i].wire != nullptr)
+						bit_readers[sig[i]].insert(cell_name);
+				}
+			}
+		std::sort(key.connections.begin(), key.connections.end());
+
+		fwd_groups[key].insert(cell_name);
+		cell_keys[cell_name] = std::move(key);
+	}
+
+	void unindex_cell(IdString cell_name)
+	{
+		auto it = cell_keys.find(cell_name);
+		if (it == cell_keys.end())
+			return;
+
+		for (auto &conn : it->second.connections) {
+			SigBit bit = std::get<2>(conn);
+			auto rit = bit_readers.find(bit);
+			if (rit != bit_readers.end()) {
+				rit->second.erase(cell_name);
+				if (rit->second.empty())
+					bit_readers.erase(rit);
+			}
+		}
+
+		auto git = fwd_groups.find(it->second);
+		git->second.erase(cell_name);
+		if (git->second.empty())
+			fwd_groups.erase(git);
+		cell_keys.erase(it);
+	}
+
+	void mark_readers(const SigSpec &sig)
+	{
+		for (auto bit : sigmap(sig)) {
+			auto it = bit_readers.find(bit);
+			if (it != bit_readers.end())
+				dirty_cells.insert(it->second.begin(), it->second.end());
+		}
+	}
 
 	void merge_cell_pair(Cell *cell_a, Cell *cell_b)
 	{
@@ -88,9 +167,13 @@ struct EquivStructWorker
 			SigBit bit_y = module->addWire(NEW_ID);
 			log("        New $equiv for input %s: A: %s, B: %s, Y: %s\n",
 					input_names[i].c_str(), log_signal(bit_a), log_signal(bit_b), log_signal(bit_y));
-			module->addEquiv(NEW_ID, bit_a, bit_b, bit_y);
+			Cell *equiv = module->addEquiv(NEW_ID, bit_a, bit_b, bit_y);
 			merged_map.add(bit_a, bit_y);
 			merged_map.add(bit_b, bit_y);
+			if (module->design->selected(module, equiv)) {
+				cells.insert(equiv->name);
+				dirty_cells.insert(equiv->name);
+			}
 		}
 
 		std::vector<IdString> outport_names, inport_names;
@@ -107,23 +190,125 @@ struct EquivStructWorker
 		for (auto &pn : outport_names) {
 			SigSpec sig_a = cell_a->getPort(pn);
 			SigSpec sig_b = cell_b->getPort(pn);
+			mark_readers(sig_a);
+			mark_readers(sig_b);
 			module->connect(sig_b, sig_a);
+			sigmap.add(sig_b, sig_a);
 		}
 
 		auto merged_attr = cell_b->get_strpool_attribute("\\equiv_merged");
 		merged_attr.insert(log_id(cell_b));
 		cell_a->add_strpool_attribute("\\equiv_merged", merged_attr);
+		dirty_cells.insert(cell_a->name);
+		dirty_cells.insert(cell_b->name);
 		module->remove(cell_b);
 	}
 
-	EquivStructWorker(Module *module, bool mode_fwd, bool mode_icells, const pool<IdString> &fwonly_cells, int iter_num) :
-			module(module), sigmap(module), equiv_bits(module),
-			mode_fwd(mode_fwd), mode_icells(mode_icells), merge_count(0), fwonly_cells(fwonly_cells)
+	void merge_groups(int phase, const pool<merge_key_t> &queue, dict<merge_key_t, pool<IdString>> &groups)
 	{
-		log("  Starting iteration %d.\n", iter_num);
+		for (auto &key : queue)
+		{
+			const char *strategy = nullptr;
+			vector<Cell*> gold_cells, gate_cells, other_cells;
+			vector<pair<Cell*, Cell*>> cell_pairs;
+			IdString cells_type;
+
+			for (auto cell_name : groups[key]) {
+				Cell *c = module->cell(cell_name);
+				if (c != nullptr) {
+					string n = cell_name.str();
+					cells_type = c->type;
+					if (GetSize(n) > 5 && n.compare(GetSize(n)-5, std::string::npos, "_gold") == 0)
+						gold_cells.push_back(c);
+					else if (GetSize(n) > 5 && n.compare(GetSize(n)-5, std::string::npos, "_gate") == 0)
+						gate_cells.push_back(c);
+					else
+						other_cells.push_back(c);
+				}
+			}
+
+			if (phase && fwonly_cells.count(cells_type))
+				continue;
+
+			if (GetSize(gold_cells) > 1 || GetSize(gate_cells) > 1 || GetSize(other_cells) > 1)
+			{
+				strategy = "deduplicate";
+				for (int i = 0; i+1 < GetSize(gold_cells); i += 2)
+					cell_pairs.push_back(make_pair(gold_cells[i], gold_cells[i+1]));
+				for (int i = 0; i+1 < GetSize(gate_cells); i += 2)
+					cell_pairs.push_back(make_pair(gate_cells[i], gate_cells[i+1]));
+				for (int i = 0; i+1 < GetSize(other_cells); i += 2)
+					cell_pairs.push_back(make_pair(other_cells[i], other_cells[i+1]));
+				goto run_strategy;
+			}
+
+			if (GetSize(gold_cells) == 1 && GetSize(gate_cells) == 1)
+			{
+				strategy = "gold-gate-pairs";
+				cell_pairs.push_back(make_pair(gold_cells[0], gate_cells[0]));
+				goto run_strategy;
+			}
+
+			if (GetSize(gold_cells) == 1 && GetSize(other_cells) == 1)
+			{
+				strategy = "gold-guess";
+				cell_pairs.push_back(make_pair(gold_cells[0], other_cells[0]));
+				goto run_strategy;
+			}
+
+			if (GetSize(other_cells) == 1 && GetSize(gate_cells) == 1)
+			{
+				strategy = "gate-guess";
+				cell_pairs.push_back(make_pair(other_cells[0], gate_cells[0]));
+				goto run_strategy;
+			}
+
+			log_assert(GetSize(gold_cells) + GetSize(gate_cells) + GetSize(other_cells) < 2);
+			continue;
+
+		run_strategy:
+			int total_group_size = GetSize(gold_cells) + GetSize(gate_cells) + GetSize(other_cells);
+			log("    %s merging %d %s cells (from group of %d) using strategy %s:\n", phase ? "Bwd" : "Fwd",
+					2*GetSize(cell_pairs), log_id(cells_type), total_group_size, strategy);
+			for (auto it : cell_pairs) {
+				log("      Merging cells %s and %s.\n", log_id(it.first),  log_id(it.second));
+				merge_cell_pair(it.first, it.second);
+			}
+		}
+	}
+
+	// rehash the cells changed by the last merges, the groups that have more
+	// than one cell afterwards are merged by the next sweep
+	void update_dirty_cells(pool<merge_key_t> &queue)
+	{
+		for (auto cell_name : dirty_cells) {
+			unindex_cell(cell_name);
+			if (module->cell(cell_name) == nullptr) {
+				cells.erase(cell_name);
+				continue;
+			}
+			if (!cells.count(cell_name))
+				continue;
+			index_cell(cell_name);
+			auto &key = cell_keys.at(cell_name);
+			if (GetSize(fwd_groups.at(key)) > 1)
+				queue.insert(key);
+		}
+		dirty_cells.clear();
+	}
+
+	void full_sweep()
+	{
+		sigmap.set(module);
+		equiv_bits.set(module);
+		cells.clear();
+		cell_keys.clear();
+		fwd_groups.clear();
+		bit_readers.clear();
+		dirty_cells.clear();
+		need_rebuild = false;
 
 		pool<SigBit> equiv_inputs;
-		pool<IdString> cells;
 
 		for (auto cell : module->selected_cells())
 			if (cell->type == "$equiv") {
@@ -151,133 +336,72 @@ struct EquivStructWorker
 				}
 			}
 
-		if (merge_count > 0)
+		if (merge_count > 0) {
+			need_rebuild = true;
 			return;
+		}
+
+		dict<merge_key_t, pool<IdString>> bwd_groups;
+		pool<merge_key_t> fwd_queue, bwd_queue;
 
 		for (auto cell_name : cells)
 		{
-			merge_key_t key;
-			vector<tuple<IdString, int, SigBit>> fwd_connections;
+			index_cell(cell_name);
+			auto &fwd_key = cell_keys.at(cell_name);
+			if (GetSize(fwd_groups.at(fwd_key)) > 1)
+				fwd_queue.insert(fwd_key);
 
 			Cell *cell = module->cell(cell_name);
-			key.type = cell->type;
-
-			for (auto &it : cell->parameters)
-				key.parameters.push_back(it);
-			std::sort(key.parameters.begin(), key.parameters.end());
-
-			for (auto &it : cell->connections())
-				key.port_sizes.push_back(make_pair(it.first, GetSize(it.second)));
-			std::sort(key.port_sizes.begin(), key.port_sizes.end());
+			merge_key_t key = base_key(cell);
 
 			for (auto &conn : cell->connections())
-			{
-				if (cell->input(conn.first)) {
-					SigSpec sig = sigmap(conn.second);
-					for (int i = 0; i < GetSize(sig); i++)
-						fwd_connections.push_back(make_tuple(conn.first, i, sig[i]));
-				}
-
 				if (cell->output(conn.first)) {
 					SigSpec sig = equiv_bits(conn.second);
 					for (int i = 0; i < GetSize(sig); i++) {
 						key.connections.clear();
 						key.connections.push_back(make_tuple(conn.first, i, sig[i]));
 
-						if (merge_cache.count(key))
-							bwd_merge_cache.insert(key);
-						merge_cache[key].insert(cell_name);
+						if (bwd_groups.count(key))
+							bwd_queue.insert(key);
+						bwd_groups[key].insert(cell_name);
 					}
 				}
-			}
-
-			std::sort(fwd_connections.begin(), fwd_connections.end());
-			key.connections.swap(fwd_connections);
-
-			if (merge_cache.count(key))
-				fwd_merge_cache.insert(key);
-			merge_cache[key].insert(cell_name);
 		}
 
-		for (int phase = 0; phase < 2; phase++)
-		{
-			auto &queue = phase ? bwd_merge_cache : fwd_merge_cache;
-
-			for (auto &key : queue)
-			{
-				const char *strategy = nullptr;
-				vector<Cell*> gold_cells, gate_cells, other_cells;
-				vector<pair<Cell*, Cell*>> cell_pairs;
-				IdString cells_type;
-
-				for (auto cell_name : merge_cache[key]) {
-					Cell *c = module->cell(cell_name);
-					if (c != nullptr) {
-						string n = cell_name.str();
-						cells_type = c->type;
-						if (GetSize(n) > 5 && n.compare(GetSize(n)-5, std::string::npos, "_gold") == 0)
-							gold_cells.push_back(c);
-						else if (GetSize(n) > 5 && n.compare(GetSize(n)-5, std::string::npos, "_gate") == 0)
-							gate_cells.push_back(c);
-						else
-							other_cells.push_back(c);
-					}
-				}
-
-				if (phase && fwonly_cells.count(cells_type))
-					continue;
-
-				if (GetSize(gold_cells) > 1 || GetSize(gate_cells) > 1 || GetSize(other_cells) > 1)
-				{
-					strategy = "deduplicate";
-					for (int i = 0; i+1 < GetSize(gold_cells); i += 2)
-						cell_pairs.push_back(make_pair(gold_cells[i], gold_cells[i+1]));
-					for (int i = 0; i+1 < GetSize(gate_cells); i += 2)
-						cell_pairs.push_back(make_pair(gate_cells[i], gate_cells[i+1]));
-					for (int i = 0; i+1 < GetSize(other_cells); i += 2)
-						cell_pairs.push_back(make_pair(other_cells[i], other_cells[i+1]));
-					goto run_strategy;
-				}
-
-				if (GetSize(gold_cells) == 1 && GetSize(gate_cells) == 1)
-				{
-					strategy = "gold-gate-pairs";
-					cell_pairs.push_back(make_pair(gold_cells[0], gate_cells[0]));
-					goto run_strategy;
-				}
+		merge_groups(0, fwd_queue, fwd_groups);
+		if (merge_count > 0)
+			return;
 
-				if (GetSize(gold_cells) == 1 && GetSize(other_cells) == 1)
-				{
-					strategy = "gold-guess";
-					cell_pairs.push_back(make_pair(gold_cells[0], other_cells[0]));
-					goto run_strategy;
-				}
+		merge_groups(1, bwd_queue, bwd_groups);
+		if (merge_count > 0) {
+			need_rebuild = true;
+			return;
+		}
 
-				if (GetSize(other_cells) == 1 && GetSize(gate_cells) == 1)
-				{
-					strategy = "gate-guess";
-					cell_pairs.push_back(make_pair(other_cells[0], gate_cells[0]));
-					goto run_strategy;
-				}
+		log("    Nothing to merge.\n");
+	}
 
-				log_assert(GetSize(gold_cells) + GetSize(gate_cells) + GetSize(other_cells) < 2);
-				continue;
+	EquivStructWorker(Module *module, bool mode_fwd, bool mode_icells, const pool<IdString> &fwonly_cells) :
+			module(module), mode_fwd(mode_fwd), mode_icells(mode_icells), merge_count(0), fwonly_cells(fwonly_cells)
+	{
+	}
 
-			run_strategy:
-				int total_group_size = GetSize(gold_cells) + GetSize(gate_cells) + GetSize(other_cells);
-				log("    %s merging %d %s cells (from group of %d) using strategy %s:\n", phase ? "Bwd" : "Fwd",
-						2*GetSize(cell_pairs), log_id(cells_type), total_group_size, strategy);
-				for (auto it : cell_pairs) {
-					log("      Merging cells %s and %s.\n", log_id(it.first),  log_id(it.second));
-					merge_cell_pair(it.first, it.second);
-				}
-			}
+	// runs one iteration, returns the number of merges
+	int iterate(int iter_num)
+	{
+		log("  Starting iteration %d.\n", iter_num);
+		merge_count = 0;
 
+		if (!need_rebuild) {
+			pool<merge_key_t> queue;
+			update_dirty_cells(queue);
+			merge_groups(0, queue, fwd_groups);
 			if (merge_count > 0)
-				return;
+				return merge_count;
 		}
 
-		log("    Nothing to merge.\n");
+		full_sweep();
+		return merge_count;
 	}
 };
 
@@ -348,15 +472,16 @@ struct EquivStructPass : public Pass {
 		for (auto module : design->selected_modules()) {
 			int module_merge_count = 0;
 			log("Running equiv_struct on module %s:\n", log_id(module));
+			EquivStructWorker worker(module, mode_fwd, mode_icells, fwonly_cells);
 			for (int iter = 0;; iter++) {
 				if (iter == max_iter) {
 					log("  Reached iteration limit of %d.\n", iter);
 					break;
 				}
-				EquivStructWorker worker(module, mode_fwd, mode_icells, fwonly_cells, iter+1);
-				if (worker.merge_count == 0)
+				int merge_count = worker.iterate(iter+1);
+				if (merge_count == 0)
 					break;
-				module_merge_count += worker.merge_count;
+				module_merge_count += merge_count;
 			}
 			if (module_merge_count)
 				log("  Performed a total of %d merges in module %s.\n", module_merge_count, log_id(module));
@@ -30,9 +30,10 @@ PRIVATE_NAMESPACE_BEGIN
 static RTLIL::Module *module;
 static SigMap assign_map;
 typedef std::pair<RTLIL::Cell*, RTLIL::IdString> sig2driver_entry_t;
-static SigSet<sig2driver_entry_t> sig2driver, sig2user;
+static SigBitIndex sig_index;
+static IndexedSigSet<sig2driver_entry_t> sig2driver(sig_index), sig2user(sig_index);
 static std::set<RTLIL::Cell*> muxtree_cells;
-static SigPool sig_at_port;
+static IndexedSigPool sig_at_port(sig_index);
 
 static bool check_state_mux_tree(RTLIL::SigSpec old_sig, RTLIL::SigSpec sig, pool<Cell*> &recursion_monitor, dict<RTLIL::SigSpec, bool> &mux_tree_cache)
 {
@@ -291,6 +292,7 @@ struct FsmDetectPass : public Pass {
 
 			module = mod_it.second;
 			assign_map.set(module);
+			sig_index.set(module);
 
 			sig2driver.clear();
 			sig2user.clear();
@@ -321,6 +323,8 @@ struct FsmDetectPass : public Pass {
 		assign_map.clear();
 		sig2driver.clear();
 		sig2user.clear();
+		sig_at_port.clear();
+		sig_index.clear();
 		muxtree_cells.clear();
 	}
 } FsmDetectPass;
@@ -27,8 +27,14 @@
 #include "kernel/sigtools.h"
 #include "kernel/consteval.h"
 #include "kernel/celltypes.h"
+#include "kernel/satgen.h"
+#include "kernel/threadpool.h"
 #include "fsmdata.h"
 
+#ifdef YOSYS_ENABLE_THREADS
+#  include <mutex>
+#endif
+
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
@@ -37,6 +43,7 @@ static SigMap assign_map;
 typedef std::pair<RTLIL::IdString, RTLIL::IdString> sig2driver_entry_t;
 static SigSet<sig2driver_entry_t> sig2driver, sig2trigger;
 static std::map<RTLIL::SigBit, std::set<RTLIL::SigBit>> exclusive_ctrls;
+static int num_threads, sat_min_inputs;
 
 static bool find_states(RTLIL::SigSpec sig, const RTLIL::SigSpec &dff_out, RTLIL::SigSpec &ctrl, std::map<RTLIL::Const, int> &states, RTLIL::Const *reset_state = NULL)
 {
@@ -141,7 +148,128 @@ static RTLIL::Const sig2const(ConstEval &ce, RTLIL::SigSpec sig, RTLIL::State no
 	return sig.as_const();
 }
 
-static void find_transitions(ConstEval &ce, ConstEval &ce_nostop, FsmData &fsm_data, std::map<RTLIL::Const, int> &states, int state_in, RTLIL::SigSpec ctrl_in, RTLIL::SigSpec ctrl_out, RTLIL::SigSpec dff_in, RTLIL::SigSpec dont_care)
+// ConstEval can not tell that the FSM logic does not depend on a control input
+// when the input reconverges (e.g. "a & b | a & ~b"), so find_transitions()
+// would split on it. For FSMs with many control inputs this multiplies the
+// number of transitions, so such inputs are checked with SAT on two copies of
+// the logic that only differ in the input in question.
+struct FsmSatChecker
+{
+	ezSatPtr ez;
+	SatGen satgen;
+	dict<RTLIL::SigBit, int> ctrl_index;
+	std::vector<int> ctrl_a, ctrl_b, ctrl_eq, state_a;
+	int outputs_differ;
+	bool ok;
+
+	FsmSatChecker(ConstEval &ce, RTLIL::SigSpec ctrl_in, RTLIL::SigSpec dff_out, RTLIL::SigSpec outputs) :
+			satgen(ez.get(), &ce.assign_map), outputs_differ(0), ok(true)
+	{
+		ce.assign_map.apply(ctrl_in);
+		ce.assign_map.apply(dff_out);
+		ce.assign_map.apply(outputs);
+
+		pool<RTLIL::SigBit> visited, leaves;
+		for (auto bit : ctrl_in)
+			visited.insert(bit);
+		for (auto bit : dff_out)
+			visited.insert(bit), leaves.insert(bit);
+
+		std::vector<RTLIL::Cell*> cone;
+		pool<RTLIL::Cell*> cone_cells;
+		std::vector<RTLIL::SigBit> queue(outputs.begin(), outputs.end());
+
+		while (!queue.empty())
+		{
+			RTLIL::SigBit bit = queue.back();
+			queue.pop_back();
+
+			if (bit.wire == nullptr || visited.count(bit))
+				continue;
+			visited.insert(bit);
+
+			std::set<RTLIL::Cell*> drivers;
+			ce.sig2driver.find(bit, drivers);
+			if (drivers.empty())
+				leaves.insert(bit);
+
+			for (auto cell : drivers) {
+				if (cone_cells.count(cell))
+					continue;
+				cone_cells.insert(cell);
+				cone.push_back(cell);
+				for (auto &conn : cell->connections())
+					for (auto b : ce.assign_map(conn.second))
+						queue.push_back(b);
+			}
+		}
+
+		for (auto prefix : {"a", "b"}) {
+			satgen.setContext(&ce.assign_map, prefix);
+			for (auto cell : cone)
+				if (!satgen.importCell(cell)) {
+					ok = false;
+					return;
+				}
+		}
+
+		satgen.setContext(&ce.assign_map, "a");
+		std::vector<int> out_a = satgen.importSigSpec(outputs);
+		ctrl_a = satgen.importSigSpec(ctrl_in);
+		state_a = satgen.importSigSpec(dff_out);
+		std::vector<int> leaves_a = satgen.importSigSpec(SigSpec(leaves));
+
+		satgen.setContext(&ce.assign_map, "b");
+		std::vector<int> out_b = satgen.importSigSpec(outputs);
+		ctrl_b = satgen.importSigSpec(ctrl_in);
+		std::vector<int> leaves_b = satgen.importSigSpec(SigSpec(leaves));
+
+		ez->assume(ez->vec_eq(leaves_a, leaves_b));
+		outputs_differ = ez->vec_ne(out_a, out_b);
+
+		for (int i = 0; i < GetSize(ctrl_in); i++) {
+			ctrl_index[ctrl_in[i]] = i;
+			ctrl_eq.push_back(ez->IFF(ctrl_a[i], ctrl_b[i]));
+		}
+	}
+
+	// true if the outputs do not depend on the given control input in the
+	// current state with the control inputs that have values in ce
+	bool is_dont_care(ConstEval &ce, RTLIL::SigSpec ctrl_in, RTLIL::SigSpec dff_out, RTLIL::SigBit bit)
+	{
+		if (!ok || ctrl_index.count(bit) == 0)
+			return false;
+
+		int idx = ctrl_index.at(bit);
+		std::vector<int> assumptions = { outputs_differ, ez->NOT(ctrl_a[idx]), ctrl_b[idx] };
+
+		RTLIL::SigSpec ctrl_val = ce.values_map(ce.assign_map(ctrl_in));
+		for (int i = 0; i < GetSize(ctrl_val); i++) {
+			if (i == idx)
+				continue;
+			assumptions.push_back(ctrl_eq[i]);
+			if (ctrl_val[i] == State::S0)
+				assumptions.push_back(ez->NOT(ctrl_a[i]));
+			if (ctrl_val[i] == State::S1)
+				assumptions.push_back(ctrl_a[i]);
+		}
+
+		RTLIL::SigSpec state_val = ce.values_map(ce.assign_map(dff_out));
+		for (int i = 0; i < GetSize(state_val); i++) {
+			if (state_val[i] == State::S0)
+				assumptions.push_back(ez->NOT(state_a[i]));
+			if (state_val[i] == State::S1)
+				assumptions.push_back(state_a[i]);
+		}
+
+		std::vector<int> model_expressions;
+		std::vector<bool> model_values;
+		return !ez->solve(model_expressions, model_values, assumptions);
+	}
+};
+
+static void find_transitions(ConstEval &ce, ConstEval &ce_nostop, FsmSatChecker *sat, const FsmData &fsm_data, std::vector<FsmData::transition_t> &transitions,
+		const std::map<RTLIL::Const, int> &states, int state_in, RTLIL::SigSpec ctrl_in, RTLIL::SigSpec ctrl_out, RTLIL::SigSpec dff_in, RTLIL::SigSpec dff_out, RTLIL::SigSpec dont_care)
 {
 	bool undef_bit_in_next_state_mode = false;
 	RTLIL::SigSpec undef, constval;
@@ -168,10 +296,10 @@ undef_bit_in_next_state:
 			ctrl_in_bit_indices[ctrl_in[i]] = i;
 
 		for (auto &it : ctrl_in_bit_indices)
-			if (tr.ctrl_in.bits.at(it.second) == State::S1 && exclusive_ctrls.count(it.first) != 0)
+			if (tr.ctrl_in[it.second] == State::S1 && exclusive_ctrls.count(it.first) != 0)
 				for (auto &dc_bit : exclusive_ctrls.at(it.first))
 					if (ctrl_in_bit_indices.count(dc_bit))
-						tr.ctrl_in.bits.at(ctrl_in_bit_indices.at(dc_bit)) = RTLIL::State::Sa;
+						tr.ctrl_in.bits().at(ctrl_in_bit_indices.at(dc_bit)) = RTLIL::State::Sa;
 
 		RTLIL::Const log_state_in = RTLIL::Const(RTLIL::State::Sx, fsm_data.state_bits);
 		if (state_in >= 0)
@@ -189,7 +317,7 @@ undef_bit_in_next_state:
 		tr.state_out = states.at(ce.values_map(ce.assign_map(dff_in)).as_const());
 
 		if (dff_in.is_fully_def()) {
-			fsm_data.transition_table.push_back(tr);
+			transitions.push_back(tr);
 			log("  transition: %10s %s -> %10s %s\n",
 					log_signal(log_state_in), log_signal(tr.ctrl_in),
 					log_signal(fsm_data.state_table[tr.state_out]), log_signal(tr.ctrl_out));
@@ -211,7 +339,14 @@ undef_bit_in_next_state:
 	undef = undef.extract(0, 1);
 	constval = undef;
 
-	if (ce_nostop.eval(constval))
+	bool undef_is_const = ce_nostop.eval(constval);
+
+	if (!undef_is_const && sat && sat->is_dont_care(ce, ctrl_in, dff_out, undef[0])) {
+		constval = State::S0;
+		undef_is_const = true;
+	}
+
+	if (undef_is_const)
 	{
 		ce.push();
 		dont_care.append(undef);
@@ -224,7 +359,7 @@ undef_bit_in_next_state:
 				else
 					ce.set(bit, State::S0);
 			}
-		find_transitions(ce, ce_nostop, fsm_data, states, state_in, ctrl_in, ctrl_out, dff_in, dont_care);
+		find_transitions(ce, ce_nostop, sat, fsm_data, transitions, states, state_in, ctrl_in, ctrl_out, dff_in, dff_out, dont_care);
 	found_contradiction_1:
 		ce.pop();
 	}
@@ -233,7 +368,7 @@ undef_bit_in_next_state:
 		ce.push(), ce_nostop.push();
 		ce.set(undef, State::S0);
 		ce_nostop.set(undef, State::S0);
-		find_transitions(ce, ce_nostop, fsm_data, states, state_in, ctrl_in, ctrl_out, dff_in, dont_care);
+		find_transitions(ce, ce_nostop, sat, fsm_data, transitions, states, state_in, ctrl_in, ctrl_out, dff_in, dff_out, dont_care);
 		ce.pop(), ce_nostop.pop();
 
 		ce.push(), ce_nostop.push();
@@ -247,7 +382,7 @@ undef_bit_in_next_state:
 				else
 					ce.set(bit, State::S0), ce_nostop.set(bit, RTLIL::S0);
 			}
-		find_transitions(ce, ce_nostop, fsm_data, states, state_in, ctrl_in, ctrl_out, dff_in, dont_care);
+		find_transitions(ce, ce_nostop, sat, fsm_data, transitions, states, state_in, ctrl_in, ctrl_out, dff_in, dff_out, dont_care);
 	found_contradiction_2:
 		ce.pop(), ce_nostop.pop();
 	}
@@ -356,16 +491,76 @@ static void extract_fsm(RTLIL::Wire *wire)
 
 	// Create transition table
 
-	ConstEval ce(module), ce_nostop(module);
-	ce.stop(ctrl_in);
-	for (int state_idx = 0; state_idx < int(fsm_data.state_table.size()); state_idx++) {
+	// The states are independent, so their transitions can be found
+	// concurrently. Every thread has its own evaluators, the transitions
+	// and log messages are collected per state and added in order.
+
+	int num_states = GetSize(fsm_data.state_table);
+	bool use_sat = sat_min_inputs >= 0 && GetSize(ctrl_in) >= sat_min_inputs;
+	std::vector<std::vector<FsmData::transition_t>> state_transitions(num_states);
+
+	struct TransitionFinder {
+		ConstEval ce, ce_nostop;
+		std::unique_ptr<FsmSatChecker> sat;
+		TransitionFinder(RTLIL::Module *module) : ce(module), ce_nostop(module) { }
+	};
+
+	auto new_finder = [&]() {
+		TransitionFinder *finder = new TransitionFinder(module);
+		finder->ce.stop(ctrl_in);
+		if (use_sat)
+			finder->sat.reset(new FsmSatChecker(finder->ce, ctrl_in, dff_out, {dff_in, ctrl_out}));
+		return finder;
+	};
+
+	auto run_finder = [&](TransitionFinder *finder, int state_idx) {
+		ConstEval &ce = finder->ce, &ce_nostop = finder->ce_nostop;
 		ce.push(), ce_nostop.push();
 		ce.set(dff_out, fsm_data.state_table[state_idx]);
 		ce_nostop.set(dff_out, fsm_data.state_table[state_idx]);
-		find_transitions(ce, ce_nostop, fsm_data, states, state_idx, ctrl_in, ctrl_out, dff_in, RTLIL::SigSpec());
+		find_transitions(ce, ce_nostop, finder->sat.get(), fsm_data, state_transitions[state_idx],
+				states, state_idx, ctrl_in, ctrl_out, dff_in, dff_out, RTLIL::SigSpec());
 		ce.pop(), ce_nostop.pop();
+	};
+
+	TaskGroup group(std::max(std::min(num_threads, num_states), 1));
+
+#ifdef YOSYS_ENABLE_THREADS
+	if (group.concurrent())
+	{
+		// finders are reused by later tasks
+		std::mutex finders_mutex;
+		std::vector<std::unique_ptr<TransitionFinder>> finders;
+
+		for (int i = 0; i < num_states; i++)
+			group.run([&, i]() {
+				std::unique_ptr<TransitionFinder> finder;
+				{
+					std::lock_guard<std::mutex> lock(finders_mutex);
+					if (!finders.empty()) {
+						finder = std::move(finders.back());
+						finders.pop_back();
+					}
+				}
+				if (finder == nullptr)
+					finder.reset(new_finder());
+				run_finder(finder.get(), i);
+				std::lock_guard<std::mutex> lock(finders_mutex);
+				finders.push_back(std::move(finder));
+			});
+		group.wait();
+	}
+	else
+#endif
+	{
+		std::unique_ptr<TransitionFinder> finder(new_finder());
+		for (int state_idx = 0; state_idx < num_states; state_idx++)
+			run_finder(finder.get(), state_idx);
 	}
 
+	for (auto &transitions : state_transitions)
+		fsm_data.transition_table.insert(fsm_data.transition_table.end(), transitions.begin(), transitions.end());
+
 	// create fsm cell
 
 	RTLIL::Cell *fsm_cell = module->addCell(stringf("$fsm$%s$%d", wire->name.c_str(), autoidx++), "$fsm");
@@ -405,7 +600,7 @@ struct FsmExtractPass : public Pass {
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
 		log("\n");
-		log("    fsm_extract [selection]\n");
+		log("    fsm_extract [options] [selection]\n");
 		log("\n");
 		log("This pass operates on all signals marked as FSM state signals using the\n");
 		log("'fsm_encoding' attribute. It consumes the logic that creates the state signal\n");
@@ -416,11 +611,45 @@ struct FsmExtractPass : public Pass {
 		log("original encoding. The 'fsm_opt' pass can be used in combination with the\n");
 		log("'opt_clean' pass to eliminate this signal.\n");
 		log("\n");
+		log("    -j <num>\n");
+		log("        find the transitions of up to <num> states concurrently. they are\n");
+		log("        added to the FSM in state order, so the result and the log output are\n");
+		log("        the same as without this option.\n");
+		log("        (default: the number of threads given to 'yosys -j')\n");
+		log("\n");
+		log("    -sat <num>\n");
+		log("        for FSMs with at least this many control inputs (default: 8), use SAT\n");
+		log("        to find control inputs the next state and the control outputs do not\n");
+		log("        depend on, instead of enumerating both of their values.\n");
+		log("\n");
+		log("    -nosat\n");
+		log("        never use SAT to find such control inputs.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
 	{
+		num_threads = yosys_threads;
+		sat_min_inputs = 8;
+
 		log_header(design, "Executing FSM_EXTRACT pass (extracting FSM from design).\n");
-		extra_args(args, 1, design);
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++) {
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
+			if (args[argidx] == "-sat" && argidx+1 < args.size()) {
+				sat_min_inputs = std::max(atoi(args[++argidx].c_str()), 0);
+				continue;
+			}
+			if (args[argidx] == "-nosat") {
+				sat_min_inputs = -1;
+				continue;
+			}
+			break;
+		}
+		extra_args(args, argidx, design);
 
 		CellTypes ct;
 		ct.setup_internals();
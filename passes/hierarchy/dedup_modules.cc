@@ -0,0 +1,255 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "kernel/sigtools.h"
+#include "kernel/modhash.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+// Modules with the same canonical digest are only candidates. This checks that
+// the cells of the two modules can be paired up (by their labels, or by their
+// names where several cells share a label) such that all connections map to
+// each other, starting from the ports.
+struct ModuleMatcher
+{
+	RTLIL::Module *module_a, *module_b;
+	ModuleLabels labels_a, labels_b;
+	dict<RTLIL::SigBit, RTLIL::SigBit> map_ab, map_ba;
+
+	ModuleMatcher(RTLIL::Module *module_a, RTLIL::Module *module_b) : module_a(module_a), module_b(module_b)
+	{
+		labels_a.compute(module_a);
+		labels_b.compute(module_b);
+	}
+
+	bool match_bit(RTLIL::SigBit a, RTLIL::SigBit b)
+	{
+		a = (*labels_a.sigmap)(a);
+		b = (*labels_b.sigmap)(b);
+
+		if (a.wire == nullptr || b.wire == nullptr)
+			return a == b;
+
+		auto it_a = map_ab.find(a);
+		if (it_a != map_ab.end())
+			return it_a->second == b;
+		if (map_ba.count(b))
+			return false;
+
+		map_ab[a] = b;
+		map_ba[b] = a;
+		return true;
+	}
+
+	bool match_cell(RTLIL::Cell *a, RTLIL::Cell *b)
+	{
+		if (a->type != b->type || a->parameters != b->parameters)
+			return false;
+		if (GetSize(a->connections()) != GetSize(b->connections()))
+			return false;
+
+		for (auto &conn : a->connections()) {
+			if (!b->hasPort(conn.first))
+				return false;
+			const RTLIL::SigSpec &sig_b = b->getPort(conn.first);
+			if (GetSize(conn.second) != GetSize(sig_b))
+				return false;
+			for (int i = 0; i < GetSize(sig_b); i++)
+				if (!match_bit(conn.second[i], sig_b[i]))
+					return false;
+		}
+		return true;
+	}
+
+	bool match()
+	{
+		if (module_a->ports != module_b->ports)
+			return false;
+
+		for (auto port : module_a->ports) {
+			RTLIL::Wire *wire_a = module_a->wire(port), *wire_b = module_b->wire(port);
+			if (wire_a->width != wire_b->width || wire_a->port_input != wire_b->port_input || wire_a->port_output != wire_b->port_output)
+				return false;
+			for (int i = 0; i < wire_a->width; i++)
+				if (!match_bit(RTLIL::SigBit(wire_a, i), RTLIL::SigBit(wire_b, i)))
+					return false;
+		}
+
+		if (GetSize(labels_a.cells) != GetSize(labels_b.cells))
+			return false;
+
+		std::map<uint64_t, std::vector<RTLIL::Cell*>> cells_b;
+		for (int i = 0; i < GetSize(labels_b.cells); i++)
+			cells_b[labels_b.cell_labels[i]].push_back(labels_b.cells[i]);
+
+		std::map<uint64_t, std::vector<RTLIL::Cell*>> cells_a;
+		for (int i = 0; i < GetSize(labels_a.cells); i++)
+			cells_a[labels_a.cell_labels[i]].push_back(labels_a.cells[i]);
+
+		for (auto &it : cells_a)
+		{
+			auto it_b = cells_b.find(it.first);
+			if (it_b == cells_b.end() || GetSize(it_b->second) != GetSize(it.second))
+				return false;
+
+			if (GetSize(it.second) == 1) {
+				if (!match_cell(it.second.front(), it_b->second.front()))
+					return false;
+				continue;
+			}
+
+			// symmetric parts of the netlist, only matched by public names
+			for (auto cell_a : it.second) {
+				if (cell_a->name[0] != '\\')
+					return false;
+				RTLIL::Cell *cell_b = module_b->cell(cell_a->name);
+				if (cell_b == nullptr || std::find(it_b->second.begin(), it_b->second.end(), cell_b) == it_b->second.end())
+					return false;
+				if (!match_cell(cell_a, cell_b))
+					return false;
+			}
+		}
+
+		return true;
+	}
+};
+
+struct DedupModulesPass : public Pass {
+	DedupModulesPass() : Pass("dedup_modules", "merge structurally identical modules") { module_changes_tracked(); }
+	void help() YS_OVERRIDE
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    dedup_modules [options] [selection]\n");
+		log("\n");
+		log("Find selected modules that implement the same netlist, and replace all but one\n");
+		log("of them in all instances. The other modules are removed. This is meant to be\n");
+		log("run after 'hierarchy', where parametrizations of a module that only differ in\n");
+		log("unused parameters, or generated wrappers, result in identical '$paramod'\n");
+		log("modules. Later passes then process each of them only once.\n");
+		log("\n");
+		log("Modules are identical if they have the same ports and their cells can be\n");
+		log("paired up with the same types, parameters and connections. The names of\n");
+		log("internal wires and cells and all attributes are ignored, the kept module is\n");
+		log("the one with the shortest name. Candidates are found with the canonical\n");
+		log("digest of 'hash'. Merging is repeated for modules that became identical\n");
+		log("because their submodules were merged.\n");
+		log("\n");
+		log("Blackboxes, the top module, and modules with processes, memories or\n");
+		log("parameters that were not derived yet are not merged.\n");
+		log("\n");
+		log("    -dry\n");
+		log("        only report the modules that would be merged\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
+	{
+		bool dry_mode = false;
+
+		log_header(design, "Executing DEDUP_MODULES pass (merging identical modules).\n");
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-dry") {
+				dry_mode = true;
+				continue;
+			}
+			break;
+		}
+		extra_args(args, argidx, design);
+
+		int total_merged = 0;
+
+		while (1)
+		{
+			dict<std::string, std::vector<RTLIL::Module*>> candidates;
+			for (auto module : design->selected_whole_modules())
+			{
+				if (module->get_blackbox_attribute() || module->get_bool_attribute(ID(top)))
+					continue;
+				if (module->has_processes() || module->has_memories() || !module->avail_parameters.empty())
+					continue;
+				candidates[module->content_hash(true)].push_back(module);
+			}
+
+			dict<RTLIL::IdString, RTLIL::IdString> replaced;
+
+			for (auto &it : candidates)
+			{
+				std::vector<RTLIL::Module*> &modules = it.second;
+				if (GetSize(modules) < 2)
+					continue;
+
+				std::sort(modules.begin(), modules.end(), [](RTLIL::Module *a, RTLIL::Module *b) {
+					if (GetSize(a->name.str()) != GetSize(b->name.str()))
+						return GetSize(a->name.str()) < GetSize(b->name.str());
+					return a->name.str() < b->name.str();
+				});
+
+				// each module is merged into the first matching one
+				std::vector<RTLIL::Module*> kept;
+				for (auto module : modules) {
+					RTLIL::Module *target = nullptr;
+					for (auto candidate : kept)
+						if (ModuleMatcher(candidate, module).match()) {
+							target = candidate;
+							break;
+						}
+					if (target == nullptr) {
+						kept.push_back(module);
+						continue;
+					}
+					log("Merging module %s into %s.\n", log_id(module), log_id(target));
+					replaced[module->name] = target->name;
+				}
+			}
+
+			if (replaced.empty() || dry_mode) {
+				total_merged += GetSize(replaced);
+				break;
+			}
+
+			for (auto module : design->modules()) {
+				bool changed = false;
+				for (auto cell : module->cells())
+					if (replaced.count(cell->type)) {
+						cell->type = replaced.at(cell->type);
+						changed = true;
+					}
+				if (changed)
+					module->touch();
+			}
+
+			for (auto &it : replaced)
+				design->remove(design->module(it.first));
+
+			total_merged += GetSize(replaced);
+		}
+
+		if (dry_mode)
+			log("Found %d modules that can be merged.\n", total_merged);
+		else
+			log("Merged %d modules.\n", total_merged);
+	}
+} DedupModulesPass;
+
+PRIVATE_NAMESPACE_END
@@ -20,11 +20,14 @@
 
 #include "kernel/yosys.h"
 #include "frontends/verific/verific.h"
+#include "libs/sha1/sha1.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <set>
 
 #ifndef _WIN32
+#  include <sys/stat.h>
+#  include <dirent.h>
 #  include <unistd.h>
 #endif
 
@@ -157,7 +160,294 @@ std::string basic_cell_type(const std::string celltype, int pos[3] = nullptr) {
 	return basicType;
 }
 
-bool expand_module(RTLIL::Design *design, RTLIL::Module *module, bool flag_check, bool flag_simcheck, std::vector<std::string> &libdirs)
+// Derived module names by module and parameter values, so that the many
+// instances with the same parameters do not each call derive(). Only used for
+// cells without interface connections.
+struct DeriveMemo
+{
+	dict<std::string, RTLIL::IdString> derived;
+	int hits = 0;
+
+	RTLIL::IdString derive(RTLIL::Design *design, RTLIL::Module *mod, const dict<RTLIL::IdString, RTLIL::Const> &parameters)
+	{
+		std::vector<std::pair<std::string, const RTLIL::Const*>> sorted_params;
+		for (auto &it : parameters)
+			sorted_params.push_back(std::make_pair(it.first.str(), &it.second));
+		std::sort(sorted_params.begin(), sorted_params.end());
+
+		std::string key = mod->name.str();
+		for (auto &it : sorted_params)
+			key += stringf("\n%s=%d:%s", it.first.c_str(), it.second->flags, it.second->as_string().c_str());
+
+		auto it = derived.find(key);
+		if (it != derived.end() && design->module(it->second) != nullptr) {
+			hits++;
+			return it->second;
+		}
+
+		RTLIL::IdString name = mod->derive(design, parameters);
+		derived[key] = name;
+		return name;
+	}
+};
+
+static const vector<pair<string, string>> libdir_extensions =
+{
+	{".v", "verilog"},
+	{".sv", "verilog -sv"},
+	{".il", "ilang"}
+};
+
+// Adds the names of the modules declared in a Verilog or ilang file, as
+// found by a quick scan for "module" keywords outside of comments and strings.
+void scan_module_names(const char *data, size_t size, bool ilang, dict<std::string, int> &names, int file_idx)
+{
+	auto is_ident_char = [](char c) { return isalnum((unsigned char)c) || c == '_' || c == '$'; };
+	size_t i = 0;
+
+	auto read_name = [&]() -> std::string {
+		while (i < size && isspace((unsigned char)data[i]))
+			i++;
+		size_t begin = i;
+		if (i < size && (data[i] == '\\' || ilang))
+			while (i < size && !isspace((unsigned char)data[i]))
+				i++;
+		else
+			while (i < size && is_ident_char(data[i]))
+				i++;
+		std::string name(data + begin, i - begin);
+		if (name.empty() || ilang)
+			return name;
+		return name[0] == '\\' ? name : "\\" + name;
+	};
+
+	while (i < size)
+	{
+		char c = data[i];
+		if (!ilang && c == '/' && i+1 < size && data[i+1] == '/') {
+			while (i < size && data[i] != '\n')
+				i++;
+		} else if (!ilang && c == '/' && i+1 < size && data[i+1] == '*') {
+			i += 2;
+			while (i+1 < size && (data[i] != '*' || data[i+1] != '/'))
+				i++;
+			i += 2;
+		} else if (c == '"') {
+			for (i++; i < size && data[i] != '"' && data[i] != '\n'; i++)
+				if (data[i] == '\\')
+					i++;
+			i++;
+		} else if (ilang && c == '#') {
+			while (i < size && data[i] != '\n')
+				i++;
+		} else if (c == '\\') {
+			while (i < size && !isspace((unsigned char)data[i]))
+				i++;
+		} else if (is_ident_char(c) || c == '`') {
+			size_t begin = i++;
+			while (i < size && is_ident_char(data[i]))
+				i++;
+			size_t len = i - begin;
+			if ((len == 6 && !strncmp(data + begin, "module", 6)) || (!ilang && len == 11 && !strncmp(data + begin, "macromodule", 11))) {
+				std::string name = read_name();
+				if (!ilang && (name == "\\automatic" || name == "\\static"))
+					name = read_name();
+				if (!name.empty() && names.count(name) == 0)
+					names[name] = file_idx;
+			}
+		} else
+			i++;
+	}
+}
+
+// Index of the files in the -libdir directories. The directory listings and
+// the module declarations in the files are looked up once per session instead
+// of probing every directory with every file extension for each missing
+// module, which is slow on network file systems. A module <name> is first
+// looked up as a file <name>.v, <name>.sv or <name>.il in all directories (as
+// before), and only then in the module declarations of all files, which are
+// scanned on the first such lookup. The index of a directory is rebuilt when
+// its modification time changes, i.e. when files are added or removed. With
+// -libdir_cache, the index is also stored in a cache directory for later runs.
+struct LibdirIndex
+{
+	struct DirIndex {
+		time_t mtime = 0;
+		bool scanned = false;
+		std::vector<std::string> files;
+		// module name -> index into files
+		dict<std::string, int> by_filename, by_content;
+	};
+
+	static dict<std::string, DirIndex> session_indices;
+
+	std::vector<std::string> libdirs;
+	std::string cache_dir;
+
+	// directories whose modification time was checked by this hierarchy call
+	pool<std::string> checked_dirs;
+
+	std::string cache_filename(const std::string &dir) const
+	{
+		return cache_dir + "/" + sha1(stringf("%s\n%s\n", yosys_version_str, dir.c_str())) + ".ydx";
+	}
+
+	bool load_cache(const std::string &dir, DirIndex &index) const
+	{
+		std::ifstream f(cache_filename(dir).c_str());
+		std::string line;
+		if (f.fail() || !std::getline(f, line) || line != stringf("yosys-libdir-index %lld", (long long)index.mtime))
+			return false;
+		while (std::getline(f, line)) {
+			std::vector<std::string> fields = split_tokens(line, "\t");
+			if (GetSize(fields) == 1 && fields[0] == "scanned")
+				index.scanned = true;
+			else if (GetSize(fields) == 2 && fields[0] == "file")
+				index.files.push_back(fields[1]);
+			else if (GetSize(fields) == 3 && (fields[0] == "name" || fields[0] == "module")) {
+				int file_idx = atoi(fields[2].c_str());
+				if (file_idx < 0 || file_idx >= GetSize(index.files))
+					return false;
+				(fields[0] == "name" ? index.by_filename : index.by_content)[fields[1]] = file_idx;
+			} else
+				return false;
+		}
+		return true;
+	}
+
+	void save_cache(const std::string &dir, const DirIndex &index) const
+	{
+		std::string filename = cache_filename(dir);
+		std::string tmp_filename = make_temp_file(cache_dir + "/yosys_libdir_XXXXXX");
+		std::ofstream f(tmp_filename.c_str());
+		f << stringf("yosys-libdir-index %lld\n", (long long)index.mtime);
+		for (auto &file : index.files)
+			f << "file\t" << file << "\n";
+		for (auto &it : index.by_filename)
+			f << "name\t" << it.first << "\t" << it.second << "\n";
+		if (index.scanned)
+			f << "scanned\n";
+		for (auto &it : index.by_content)
+			f << "module\t" << it.first << "\t" << it.second << "\n";
+		f.close();
+
+		// concurrent runs never see a partial file
+		if (f.fail() || rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+			log_warning("Can't write libdir index cache file `%s'.\n", filename.c_str());
+			remove(tmp_filename.c_str());
+		}
+	}
+
+	DirIndex &dir_index(const std::string &dir)
+	{
+		DirIndex &index = session_indices[dir];
+#ifndef _WIN32
+		if (checked_dirs.count(dir))
+			return index;
+		checked_dirs.insert(dir);
+
+		struct stat st;
+		time_t mtime = stat(dir.c_str(), &st) == 0 ? st.st_mtime : 0;
+		if (mtime == index.mtime && mtime != 0)
+			return index;
+
+		index = DirIndex();
+		index.mtime = mtime;
+		if (mtime == 0 || (!cache_dir.empty() && load_cache(dir, index)))
+			return index;
+
+		struct dirent **namelist;
+		int n = scandir(dir.c_str(), &namelist, nullptr, alphasort);
+		for (int i = 0; i < n; i++) {
+			std::string name = namelist[i]->d_name;
+			free(namelist[i]);
+			for (auto &ext : libdir_extensions)
+				if (GetSize(name) > GetSize(ext.first) && name.compare(GetSize(name) - GetSize(ext.first), std::string::npos, ext.first) == 0)
+					index.files.push_back(name);
+		}
+		if (n >= 0)
+			free(namelist);
+
+		// for equal names the extensions are used in the order of the list
+		for (auto &ext : libdir_extensions)
+			for (int i = 0; i < GetSize(index.files); i++) {
+				const std::string &name = index.files[i];
+				int stem_len = GetSize(name) - GetSize(ext.first);
+				if (name.compare(stem_len, std::string::npos, ext.first) == 0 && index.by_filename.count(RTLIL::escape_id(name.substr(0, stem_len))) == 0)
+					index.by_filename[RTLIL::escape_id(name.substr(0, stem_len))] = i;
+			}
+
+		log("Indexed %d files in libdir `%s'.\n", GetSize(index.files), dir.c_str());
+		if (!cache_dir.empty())
+			save_cache(dir, index);
+#endif
+		return index;
+	}
+
+	void scan_files(const std::string &dir, DirIndex &index)
+	{
+		index.scanned = true;
+		for (int i = 0; i < GetSize(index.files); i++) {
+			MappedFile file;
+			if (!file.open(dir + "/" + index.files[i]) || file.is_compressed())
+				continue;
+			bool ilang = index.files[i].compare(index.files[i].size() - 3, std::string::npos, ".il") == 0;
+			scan_module_names(file.data, file.size, ilang, index.by_content, i);
+		}
+		log("Scanned %d files in libdir `%s' for module declarations, found %d modules.\n",
+				GetSize(index.files), dir.c_str(), GetSize(index.by_content));
+		if (!cache_dir.empty())
+			save_cache(dir, index);
+	}
+
+	static std::string frontend_command(const std::string &filename)
+	{
+		for (auto &ext : libdir_extensions)
+			if (GetSize(filename) > GetSize(ext.first) && filename.compare(GetSize(filename) - GetSize(ext.first), std::string::npos, ext.first) == 0)
+				return ext.second;
+		log_abort();
+	}
+
+	// finds the file for a module in the libdirs, returns false if there is none
+	bool find(RTLIL::IdString type, std::string &filename, std::string &command)
+	{
+#ifdef _WIN32
+		for (auto &dir : libdirs)
+			for (auto &ext : libdir_extensions) {
+				filename = dir + "/" + RTLIL::unescape_id(type) + ext.first;
+				command = ext.second;
+				if (check_file_exists(filename))
+					return true;
+			}
+#else
+		for (auto &dir : libdirs) {
+			DirIndex &index = dir_index(dir);
+			auto it = index.by_filename.find(type.str());
+			if (it != index.by_filename.end()) {
+				filename = dir + "/" + index.files[it->second];
+				command = frontend_command(filename);
+				return true;
+			}
+		}
+		for (auto &dir : libdirs) {
+			DirIndex &index = dir_index(dir);
+			if (!index.scanned)
+				scan_files(dir, index);
+			auto it = index.by_content.find(type.str());
+			if (it != index.by_content.end()) {
+				filename = dir + "/" + index.files[it->second];
+				command = frontend_command(filename);
+				return true;
+			}
+		}
+#endif
+		return false;
+	}
+};
+
+dict<std::string, LibdirIndex::DirIndex> LibdirIndex::session_indices;
+
+bool expand_module(RTLIL::Design *design, RTLIL::Module *module, bool flag_check, bool flag_simcheck, LibdirIndex &libdirs, DeriveMemo &memo)
 {
 	bool did_something = false;
 	std::map<RTLIL::Cell*, std::pair<int, int>> array_cells;
@@ -212,7 +502,7 @@ bool expand_module(RTLIL::Design *design, RTLIL::Module *module, bool flag_check
 		{
 			if (design->modules_.count("$abstract" + cell->type.str()))
 			{
-				cell->type = design->modules_.at("$abstract" + cell->type.str())->derive(design, cell->parameters);
+				cell->type = memo.derive(design, design->modules_.at("$abstract" + cell->type.str()), cell->parameters);
 				cell->parameters.clear();
 				did_something = true;
 				continue;
@@ -221,22 +511,11 @@ bool expand_module(RTLIL::Design *design, RTLIL::Module *module, bool flag_check
 			if (cell->type[0] == '$')
 				continue;
 
-			for (auto &dir : libdirs)
-			{
-				static const vector<pair<string, string>> extensions_list =
-				{
-					{".v", "verilog"},
-					{".sv", "verilog -sv"},
-					{".il", "ilang"}
-				};
-
-				for (auto &ext : extensions_list)
-				{
-					filename = dir + "/" + RTLIL::unescape_id(cell->type) + ext.first;
-					if (check_file_exists(filename)) {
-						Frontend::frontend_call(design, NULL, filename, ext.second);
-						goto loaded_module;
-					}
+			if (!libdirs.libdirs.empty()) {
+				std::string command;
+				if (libdirs.find(cell->type, filename, command)) {
+					Frontend::frontend_call(design, NULL, filename, command);
+					goto loaded_module;
 				}
 			}
 
@@ -379,7 +658,10 @@ bool expand_module(RTLIL::Design *design, RTLIL::Module *module, bool flag_check
 			continue;
 		}
 
-		cell->type = mod->derive(design, cell->parameters, interfaces_to_add_to_submodule, modports_used_in_submodule);
+		if (interfaces_to_add_to_submodule.empty() && modports_used_in_submodule.empty())
+			cell->type = memo.derive(design, mod, cell->parameters);
+		else
+			cell->type = mod->derive(design, cell->parameters, interfaces_to_add_to_submodule, modports_used_in_submodule);
 		cell->parameters.clear();
 		did_something = true;
 
@@ -444,6 +726,15 @@ bool expand_module(RTLIL::Design *design, RTLIL::Module *module, bool flag_check
 	return did_something;
 }
 
+// true if the module instantiates a module that is not (yet) in the design
+bool has_unresolved_cells(RTLIL::Design *design, RTLIL::Module *module)
+{
+	for (auto cell : module->cells())
+		if (cell->type[0] != '$' && design->module(cell->type) == nullptr)
+			return true;
+	return false;
+}
+
 void hierarchy_worker(RTLIL::Design *design, std::set<RTLIL::Module*, IdString::compare_ptr_by_name<Module>> &used, RTLIL::Module *mod, int indent)
 {
 	if (used.count(mod) > 0)
@@ -591,7 +882,14 @@ struct HierarchyPass : public Pass {
 		log("    -libdir <directory>\n");
 		log("        search for files named <module_name>.v in the specified directory\n");
 		log("        for unknown modules and automatically run read_verilog for each\n");
-		log("        unknown module.\n");
+		log("        unknown module. if there is no such file, the modules declared in\n");
+		log("        the .v, .sv and .il files in the directory are searched. the file\n");
+		log("        names and module declarations are indexed once per session.\n");
+		log("\n");
+		log("    -libdir_cache <directory>\n");
+		log("        store the index of each -libdir directory in the given cache\n");
+		log("        directory and use it in later runs, as long as the modification\n");
+		log("        time of the -libdir directory does not change.\n");
 		log("\n");
 		log("    -keep_positionals\n");
 		log("        per default this pass also converts positional arguments in cells\n");
@@ -653,7 +951,7 @@ struct HierarchyPass : public Pass {
 		bool purge_lib = false;
 		RTLIL::Module *top_mod = NULL;
 		std::string load_top_mod;
-		std::vector<std::string> libdirs;
+		LibdirIndex libdirs;
 
 		bool auto_top_mode = false;
 		bool generate_mode = false;
@@ -736,7 +1034,15 @@ struct HierarchyPass : public Pass {
 				continue;
 			}
 			if (args[argidx] == "-libdir" && argidx+1 < args.size()) {
-				libdirs.push_back(args[++argidx]);
+				libdirs.libdirs.push_back(args[++argidx]);
+				continue;
+			}
+			if (args[argidx] == "-libdir_cache" && argidx+1 < args.size()) {
+				libdirs.cache_dir = args[++argidx];
+				if (libdirs.cache_dir.size() > 1 && libdirs.cache_dir.back() == '/')
+					libdirs.cache_dir.pop_back();
+				if (!check_file_exists(libdirs.cache_dir))
+					log_cmd_error("Libdir cache directory `%s' does not exist.\n", libdirs.cache_dir.c_str());
 				continue;
 			}
 			if (args[argidx] == "-top") {
@@ -869,6 +1175,12 @@ struct HierarchyPass : public Pass {
 					mod_it.second->attributes.erase("\\initial_top");
 		}
 
+		// Modules for which expand_module() had nothing to do are not expanded
+		// again, unless they instantiate modules that were missing. They are
+		// identified by Module::hashidx_, which is never reused.
+		pool<int> expanded_modules;
+		DeriveMemo derive_memo;
+
 		bool did_something = true;
 		while (did_something)
 		{
@@ -884,8 +1196,12 @@ struct HierarchyPass : public Pass {
 			}
 
 			for (auto module : used_modules) {
-				if (expand_module(design, module, flag_check, flag_simcheck, libdirs))
+				if (expanded_modules.count(module->hashidx_))
+					continue;
+				if (expand_module(design, module, flag_check, flag_simcheck, libdirs, derive_memo))
 					did_something = true;
+				else if (!has_unresolved_cells(design, module))
+					expanded_modules.insert(module->hashidx_);
 			}
 
 
@@ -910,6 +1226,9 @@ struct HierarchyPass : public Pass {
 			}
 		}
 
+		if (derive_memo.hits > 0)
+			log("Reused %d derived modules for cells with the same parameters.\n", derive_memo.hits);
+
 
 		if (top_mod != NULL) {
 			log_header(design, "Analyzing design hierarchy..\n");
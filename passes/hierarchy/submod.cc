@@ -39,10 +39,18 @@ struct SubmodWorker
 	struct SubModule
 	{
 		std::string name, full_name;
-		std::set<RTLIL::Cell*> cells;
+		std::vector<RTLIL::Cell*> cells, unknown_cells;
+		pool<RTLIL::Wire*> wires;
 	};
 
-	std::map<std::string, SubModule> submodules;
+	std::vector<SubModule> submodules;
+
+	// The submodules driving and using each wire, found in a single pass over
+	// the cells of the module. Cells that are not moved are in group -1.
+	struct wire_usage_t {
+		std::vector<int> drivers, users;
+	};
+	dict<RTLIL::Wire*, wire_usage_t> wire_usage;
 
 	struct wire_flags_t {
 		RTLIL::Wire *new_wire;
@@ -50,61 +58,86 @@ struct SubmodWorker
 		wire_flags_t() : new_wire(NULL), is_int_driven(false), is_int_used(false), is_ext_driven(false), is_ext_used(false) { }
 	};
 	std::map<RTLIL::Wire*, wire_flags_t> wire_flags;
-	bool flag_found_something;
 
-	void flag_wire(RTLIL::Wire *wire, bool create, bool set_int_driven, bool set_int_used, bool set_ext_driven, bool set_ext_used)
+	static void add_group(std::vector<int> &groups, int group)
 	{
-		if (wire_flags.count(wire) == 0) {
-			if (!create)
-				return;
-			wire_flags[wire] = wire_flags_t();
-		}
-		if (set_int_driven)
-			wire_flags[wire].is_int_driven = true;
-		if (set_int_used)
-			wire_flags[wire].is_int_used = true;
-		if (set_ext_driven)
-			wire_flags[wire].is_ext_driven = true;
-		if (set_ext_used)
-			wire_flags[wire].is_ext_used = true;
-		flag_found_something = true;
+		if (std::find(groups.begin(), groups.end(), group) == groups.end())
+			groups.push_back(group);
 	}
 
-	void flag_signal(const RTLIL::SigSpec &sig, bool create, bool set_int_driven, bool set_int_used, bool set_ext_driven, bool set_ext_used)
+	void scan_cells(const dict<RTLIL::Cell*, int> &cell_groups)
 	{
-		for (auto &c : sig.chunks())
-			if (c.wire != NULL)
-				flag_wire(c.wire, create, set_int_driven, set_int_used, set_ext_driven, set_ext_used);
+		std::vector<RTLIL::Cell*> unknown_ext_cells;
+
+		for (auto &it : module->cells_)
+		{
+			RTLIL::Cell *cell = it.second;
+			auto group_it = cell_groups.find(cell);
+			int group = group_it == cell_groups.end() ? -1 : group_it->second;
+
+			bool known = ct.cell_known(cell->type);
+			if (!known) {
+				if (group >= 0)
+					submodules[group].unknown_cells.push_back(cell);
+				else
+					unknown_ext_cells.push_back(cell);
+			}
+
+			for (auto &conn : cell->connections()) {
+				bool driven = known ? ct.cell_output(cell->type, conn.first) : true;
+				bool used = known ? ct.cell_input(cell->type, conn.first) : true;
+				for (auto &c : conn.second.chunks()) {
+					if (c.wire == nullptr)
+						continue;
+					wire_usage_t &usage = wire_usage[c.wire];
+					if (driven)
+						add_group(usage.drivers, group);
+					if (used)
+						add_group(usage.users, group);
+					if (group >= 0)
+						submodules[group].wires.insert(c.wire);
+				}
+			}
+		}
+
+		for (auto cell : unknown_ext_cells) {
+			bool touches_submodule = false;
+			for (auto &conn : cell->connections())
+				for (auto &c : conn.second.chunks())
+					if (c.wire != nullptr) {
+						wire_usage_t &usage = wire_usage.at(c.wire);
+						for (int group : usage.drivers)
+							touches_submodule |= group >= 0;
+						for (int group : usage.users)
+							touches_submodule |= group >= 0;
+					}
+			if (touches_submodule)
+				log_warning("Port directions for cell %s (%s) are unknown. Assuming inout for all ports.\n", cell->name.c_str(), cell->type.c_str());
+		}
 	}
 
-	void handle_submodule(SubModule &submod)
+	void handle_submodule(SubModule &submod, int group)
 	{
 		log("Creating submodule %s (%s) of module %s.\n", submod.name.c_str(), submod.full_name.c_str(), module->name.c_str());
 
+		for (auto cell : submod.unknown_cells)
+			log_warning("Port directions for cell %s (%s) are unknown. Assuming inout for all ports.\n", cell->name.c_str(), cell->type.c_str());
+
 		wire_flags.clear();
-		for (RTLIL::Cell *cell : submod.cells) {
-			if (ct.cell_known(cell->type)) {
-				for (auto &conn : cell->connections())
-					flag_signal(conn.second, true, ct.cell_output(cell->type, conn.first), ct.cell_input(cell->type, conn.first), false, false);
-			} else {
-				log_warning("Port directions for cell %s (%s) are unknown. Assuming inout for all ports.\n", cell->name.c_str(), cell->type.c_str());
-				for (auto &conn : cell->connections())
-					flag_signal(conn.second, true, true, true, false, false);
+		for (auto wire : submod.wires) {
+			const wire_usage_t &usage = wire_usage.at(wire);
+			wire_flags_t &flags = wire_flags[wire];
+			for (int g : usage.drivers) {
+				if (g == group)
+					flags.is_int_driven = true;
+				else
+					flags.is_ext_driven = true;
 			}
-		}
-		for (auto &it : module->cells_) {
-			RTLIL::Cell *cell = it.second;
-			if (submod.cells.count(cell) > 0)
-				continue;
-			if (ct.cell_known(cell->type)) {
-				for (auto &conn : cell->connections())
-					flag_signal(conn.second, false, false, false, ct.cell_output(cell->type, conn.first), ct.cell_input(cell->type, conn.first));
-			} else {
-				flag_found_something = false;
-				for (auto &conn : cell->connections())
-					flag_signal(conn.second, false, false, false, true, true);
-				if (flag_found_something)
-					log_warning("Port directions for cell %s (%s) are unknown. Assuming inout for all ports.\n", cell->name.c_str(), cell->type.c_str());
+			for (int g : usage.users) {
+				if (g == group)
+					flags.is_int_used = true;
+				else
+					flags.is_ext_used = true;
 			}
 		}
 
@@ -118,6 +151,8 @@ struct SubmodWorker
 			all_wire_names.insert(it.first->name);
 		}
 
+		dict<RTLIL::Wire*, RTLIL::Wire*> wire_map;
+
 		for (auto &it : wire_flags)
 		{
 			RTLIL::Wire *wire = it.first;
@@ -166,22 +201,25 @@ struct SubmodWorker
 				log("  signal %s: internal\n", wire->name.c_str());
 
 			flags.new_wire = new_wire;
+			wire_map[wire] = new_wire;
 		}
 
 		new_mod->fixup_ports();
 		ct.setup_module(new_mod);
 
-		for (RTLIL::Cell *cell : submod.cells) {
-			RTLIL::Cell *new_cell = new_mod->addCell(cell->name, cell);
-			for (auto &conn : new_cell->connections_)
-				for (auto &bit : conn.second)
-					if (bit.wire != NULL) {
-						log_assert(wire_flags.count(bit.wire) > 0);
-						bit.wire = wire_flags[bit.wire].new_wire;
-					}
-			log("  cell %s (%s)\n", new_cell->name.c_str(), new_cell->type.c_str());
-			if (!copy_mode)
-				module->remove(cell);
+		for (RTLIL::Cell *cell : submod.cells)
+			log("  cell %s (%s)\n", cell->name.c_str(), cell->type.c_str());
+
+		if (copy_mode) {
+			for (RTLIL::Cell *cell : submod.cells) {
+				RTLIL::Cell *new_cell = new_mod->addCell(cell->name, cell);
+				for (auto &conn : new_cell->connections_)
+					for (auto &bit : conn.second)
+						if (bit.wire != NULL)
+							bit.wire = wire_map.at(bit.wire);
+			}
+		} else {
+			module->move_cells(new_mod, submod.cells, wire_map);
 		}
 		submod.cells.clear();
 
@@ -193,6 +231,13 @@ struct SubmodWorker
 				RTLIL::Wire *new_wire = it.second.new_wire;
 				if (new_wire->port_id > 0)
 					new_cell->setPort(new_wire->name, RTLIL::SigSpec(old_wire));
+
+				// the new cell drives and uses the wires like the moved cells
+				// did, plus both directions for inout ports
+				if (new_wire->port_output)
+					add_group(wire_usage.at(old_wire).drivers, group);
+				if (new_wire->port_input)
+					add_group(wire_usage.at(old_wire).users, group);
 			}
 		}
 	}
@@ -219,6 +264,10 @@ struct SubmodWorker
 		ct.setup_stdcells_mem();
 		ct.setup_design(design);
 
+		// cells are put into buckets by attribute value in one pass
+		std::map<std::string, int> submod_index;
+		dict<RTLIL::Cell*, int> cell_groups;
+
 		if (opt_name.empty())
 		{
 			for (auto &it : module->wires_)
@@ -227,7 +276,7 @@ struct SubmodWorker
 			for (auto &it : module->cells_)
 			{
 				RTLIL::Cell *cell = it.second;
-				if (cell->attributes.count("\\submod") == 0 || cell->attributes["\\submod"].bits.size() == 0) {
+				if (cell->attributes.count("\\submod") == 0 || cell->attributes["\\submod"].size() == 0) {
 					cell->attributes.erase("\\submod");
 					continue;
 				}
@@ -235,15 +284,20 @@ struct SubmodWorker
 				std::string submod_str = cell->attributes["\\submod"].decode_string();
 				cell->attributes.erase("\\submod");
 
-				if (submodules.count(submod_str) == 0) {
-					submodules[submod_str].name = submod_str;
-					submodules[submod_str].full_name = module->name.str() + "_" + submod_str;
-					while (design->modules_.count(submodules[submod_str].full_name) != 0 ||
-							module->count_id(submodules[submod_str].full_name) != 0)
-						submodules[submod_str].full_name += "_";
+				auto index_it = submod_index.find(submod_str);
+				if (index_it == submod_index.end()) {
+					SubModule submod;
+					submod.name = submod_str;
+					submod.full_name = module->name.str() + "_" + submod_str;
+					while (design->modules_.count(submod.full_name) != 0 ||
+							module->count_id(submod.full_name) != 0)
+						submod.full_name += "_";
+					index_it = submod_index.insert(std::make_pair(submod_str, GetSize(submodules))).first;
+					submodules.push_back(submod);
 				}
 
-				submodules[submod_str].cells.insert(cell);
+				submodules[index_it->second].cells.push_back(cell);
+				cell_groups[cell] = index_it->second;
 			}
 		}
 		else
@@ -253,17 +307,30 @@ struct SubmodWorker
 				RTLIL::Cell *cell = it.second;
 				if (!design->selected(module, cell))
 					continue;
-				submodules[opt_name].name = opt_name;
-				submodules[opt_name].full_name = RTLIL::escape_id(opt_name);
-				submodules[opt_name].cells.insert(cell);
+				if (submodules.empty()) {
+					SubModule submod;
+					submod.name = opt_name;
+					submod.full_name = RTLIL::escape_id(opt_name);
+					submodules.push_back(submod);
+				}
+				submodules.front().cells.push_back(cell);
+				cell_groups[cell] = 0;
 			}
 
 			if (submodules.size() == 0)
 				log("Nothing selected -> do nothing.\n");
 		}
 
-		for (auto &it : submodules)
-			handle_submodule(it.second);
+		if (submodules.empty())
+			return;
+
+		scan_cells(cell_groups);
+
+		// in the order of the attribute values, as before
+		for (auto &it : submod_index)
+			handle_submodule(submodules[it.second], it.second);
+		if (!opt_name.empty())
+			handle_submodule(submodules.front(), 0);
 	}
 };
 
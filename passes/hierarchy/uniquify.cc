@@ -18,10 +18,34 @@
  */
 
 #include "kernel/yosys.h"
+#include "kernel/threadpool.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
+struct UniquifyJob
+{
+	RTLIL::Cell *cell;
+	RTLIL::Module *tmod, *smod;
+	RTLIL::IdString newname;
+};
+
+// Creates the copies for one round. Cloning only reads the template modules
+// and writes to the new modules, so it is done on worker threads. The new
+// modules are added to the design afterwards, in the order of the jobs.
+void clone_modules(std::vector<UniquifyJob> &jobs)
+{
+#ifdef WITH_PYTHON
+	int num_threads = 1;
+#else
+	int num_threads = yosys_threads;
+#endif
+
+	parallel_for(GetSize(jobs), [&](int i) {
+		jobs[i].smod = jobs[i].tmod->clone();
+	}, num_threads);
+}
+
 struct UniquifyPass : public Pass {
 	UniquifyPass() : Pass("uniquify", "create unique copies of modules") { }
 	void help() YS_OVERRIDE
@@ -40,6 +64,9 @@ struct UniquifyPass : public Pass {
 		log("This commands only operates on modules that by themself have the 'unique'\n");
 		log("attribute set (the 'top' module is unique implicitly).\n");
 		log("\n");
+		log("With 'yosys -j <N>', the copies created in each round are cloned in\n");
+		log("parallel.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
 	{
@@ -62,6 +89,8 @@ struct UniquifyPass : public Pass {
 		{
 			did_something = false;
 
+			std::vector<UniquifyJob> jobs;
+
 			for (auto module : design->selected_modules())
 			{
 				if (!module->get_bool_attribute("\\unique") && !module->get_bool_attribute("\\top"))
@@ -81,19 +110,26 @@ struct UniquifyPass : public Pass {
 					if (tmod->get_bool_attribute("\\unique") && newname == tmod->name)
 						continue;
 
-					log("Creating module %s from %s.\n", log_id(newname), log_id(tmod));
+					jobs.push_back(UniquifyJob{cell, tmod, nullptr, newname});
+				}
+			}
 
-					auto smod = tmod->clone();
-					smod->name = newname;
-					cell->type = newname;
-					smod->set_bool_attribute("\\unique");
-					if (smod->attributes.count("\\hdlname") == 0)
-						smod->attributes["\\hdlname"] = string(log_id(tmod->name));
-					design->add(smod);
+			clone_modules(jobs);
 
-					did_something = true;
-					count++;
-				}
+			for (auto &job : jobs)
+			{
+				log("Creating module %s from %s.\n", log_id(job.newname), log_id(job.tmod));
+
+				auto smod = job.smod;
+				smod->name = job.newname;
+				job.cell->type = job.newname;
+				smod->set_bool_attribute("\\unique");
+				if (smod->attributes.count("\\hdlname") == 0)
+					smod->attributes["\\hdlname"] = string(log_id(job.tmod->name));
+				design->add(smod);
+
+				did_something = true;
+				count++;
 			}
 		}
 
@@ -18,6 +18,7 @@
  */
 
 #include "kernel/yosys.h"
+#include "kernel/threadpool.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -419,7 +420,7 @@ bool replace_cell(Cell *cell, const rules_t &rules, const rules_t::bram_t &bram,
 	int mem_width = cell->getParam("\\WIDTH").as_int();
 	// int mem_offset = cell->getParam("\\OFFSET").as_int();
 
-	bool cell_init = !SigSpec(cell->getParam("\\INIT")).is_fully_undef();
+	bool cell_init = !cell->getParam("\\INIT").is_fully_undef();
 	vector<Const> initdata;
 
 	if (cell_init) {
@@ -911,9 +912,9 @@ grow_read_ports:;
 					State padding = State::Sx;
 					for (int j = 0; j < bram.dbits; j++)
 						if (init_offset+i < GetSize(initdata) && init_shift+j < GetSize(initdata[init_offset+i]))
-							initparam[i*bram.dbits+j] = initdata[init_offset+i][init_shift+j];
+							initparam.bits()[i*bram.dbits+j] = initdata[init_offset+i][init_shift+j];
 						else
-							initparam[i*bram.dbits+j] = padding;
+							initparam.bits()[i*bram.dbits+j] = padding;
 				}
 				c->setParam("\\INIT", initparam);
 			}
@@ -1044,11 +1045,51 @@ grow_read_ports:;
 	return true;
 }
 
-void handle_cell(Cell *cell, const rules_t &rules)
+// Everything the rule selection depends on: the parameters except the
+// contents of INIT, the attributes used by the match rules, and which of the
+// clock and enable bits are constant or equal to each other. Memories with the
+// same shape select the same rule.
+std::string memory_shape_key(Cell *cell, const pool<IdString> &rule_attributes)
+{
+	std::string key;
+
+	for (auto &it : cell->parameters)
+		if (it.first != "\\INIT" && it.first != "\\MEMID")
+			key += it.first.str() + "=" + it.second.as_string() + " ";
+	key += cell->getParam("\\INIT").is_fully_undef() ? "noinit " : "init ";
+
+	for (auto attr : rule_attributes) {
+		auto it = cell->attributes.find(attr);
+		key += attr.str() + (it == cell->attributes.end() ? "" : "=" + it->second.as_string()) + " ";
+	}
+
+	dict<SigBit, int> bit_index;
+	for (auto port : { "\\WR_EN", "\\WR_CLK", "\\RD_CLK", "\\RD_EN" }) {
+		key += "|";
+		for (auto bit : cell->getPort(port)) {
+			if (bit.wire == nullptr) {
+				key += bit.data == State::S0 ? "0" : bit.data == State::S1 ? "1" : "x";
+				continue;
+			}
+			if (!bit_index.count(bit)) {
+				int idx = GetSize(bit_index);
+				bit_index[bit] = idx;
+			}
+			key += stringf(",%d", bit_index.at(bit));
+		}
+	}
+
+	return key;
+}
+
+// Tries the match rules in order on one memory, without changing the module.
+// Returns false if no rule is acceptable, otherwise the match rule and bram
+// variant to map the memory to.
+bool select_rule(Cell *cell, const rules_t &rules, pair<int, int> &selected_rule)
 {
 	log("Processing %s.%s:\n", log_id(cell->module), log_id(cell));
 
-	bool cell_init = !SigSpec(cell->getParam("\\INIT")).is_fully_undef();
+	bool cell_init = !cell->getParam("\\INIT").is_fully_undef();
 
 	dict<string, int> match_properties;
 	match_properties["words"]  = cell->getParam("\\SIZE").as_int();
@@ -1220,24 +1261,31 @@ void handle_cell(Cell *cell, const rules_t &rules)
 				}
 
 				log("    Selected rule %d.%d with efficiency %d.\n", best_rule.first+1, best_rule.second+1, std::get<0>(best_rule_cache[best_rule]));
-				best_rule_cache.clear();
-
-				auto &best_bram = rules.brams.at(rules.matches.at(best_rule.first).name).at(best_rule.second);
-				if (!replace_cell(cell, rules, best_bram, rules.matches.at(best_rule.first), match_properties, 2))
-					log_error("Mapping to bram type %s (variant %d) after pre-selection failed.\n", log_id(best_bram.name), best_bram.variant);
-				return;
+				selected_rule = best_rule;
+				return true;
 			}
 
-			if (!replace_cell(cell, rules, bram, match, match_properties, 0)) {
+			if (!replace_cell(cell, rules, bram, match, match_properties, 1)) {
 				log("    Mapping to bram type %s failed.\n", log_id(match.name));
 				failed_brams.insert(pair<IdString, int>(bram.name, bram.variant));
 				goto next_match_rule;
 			}
-			return;
+			selected_rule = pair<int, int>(i, vi);
+			return true;
 		}
 	}
 
 	log("  No acceptable bram resources found.\n");
+	return false;
+}
+
+void map_cell(Cell *cell, const rules_t &rules, pair<int, int> selected_rule)
+{
+	auto &match = rules.matches.at(selected_rule.first);
+	auto &bram = rules.brams.at(match.name).at(selected_rule.second);
+	dict<string, int> match_properties;
+	if (!replace_cell(cell, rules, bram, match, match_properties, 2))
+		log_error("Mapping to bram type %s (variant %d) after pre-selection failed.\n", log_id(bram.name), bram.variant);
 }
 
 struct MemoryBramPass : public Pass {
@@ -1338,10 +1386,20 @@ struct MemoryBramPass : public Pass {
 		log("A match containing the command 'shuffle_enable A' will re-organize\n");
 		log("the data bits to accommodate the enable pattern of port A.\n");
 		log("\n");
+		log("The rules are only tried on the first memory of each shape, i.e. with the\n");
+		log("same parameters, rule attributes and clock and enable structure. The other\n");
+		log("memories of that shape are mapped using the same rule.\n");
+		log("\n");
+		log("    -j <num>\n");
+		log("        try the rules on up to <num> memory shapes concurrently. the log output\n");
+		log("        is the same as without this option.\n");
+		log("        (default: the number of threads given to 'yosys -j')\n");
+		log("\n");
 	}
 	void execute(vector<string> args, Design *design) YS_OVERRIDE
 	{
 		rules_t rules;
+		int num_threads YS_ATTRIBUTE(unused) = yosys_threads;
 
 		log_header(design, "Executing MEMORY_BRAM pass (mapping $mem cells to block memories).\n");
 
@@ -1351,14 +1409,78 @@ struct MemoryBramPass : public Pass {
 				rules.parse(args[++argidx]);
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
+		pool<IdString> rule_attributes;
+		for (auto &match : rules.matches)
+			for (auto &sums : match.attributes)
+				for (auto &term : sums)
+					rule_attributes.insert(std::get<1>(term));
+
+		// The rule selection is only run for the first memory of each shape.
+		// It does not change the design, so with more than one thread it is
+		// run for all of them concurrently before any memory is mapped.
+
+		vector<Cell*> cells;
+		vector<int> cell_shape;
+		dict<std::string, int> shape_index;
+		vector<Cell*> shape_first_cell;
+
 		for (auto mod : design->selected_modules())
 		for (auto cell : mod->selected_cells())
-			if (cell->type == "$mem")
-				handle_cell(cell, rules);
+			if (cell->type == "$mem") {
+				std::string key = memory_shape_key(cell, rule_attributes);
+				if (!shape_index.count(key)) {
+					shape_index[key] = GetSize(shape_first_cell);
+					shape_first_cell.push_back(cell);
+				}
+				cells.push_back(cell);
+				cell_shape.push_back(shape_index.at(key));
+			}
+
+		int num_shapes = GetSize(shape_first_cell);
+		vector<pair<int, int>> shape_rule(num_shapes);
+		vector<char> shape_found(num_shapes);
+		vector<bool> shape_done(num_shapes);
+
+		// rules are selected for the shapes on worker threads, the cells are
+		// mapped afterwards and the output of the selection is replayed in the
+		// order of the first cell of each shape
+		TaskGroup group(std::max(std::min(num_threads, num_shapes), 1));
+		if (group.concurrent()) {
+			for (int i = 0; i < num_shapes; i++)
+				group.run([&, i]() { shape_found[i] = select_rule(shape_first_cell[i], rules, shape_rule[i]); });
+			group.join();
+		}
+
+		for (int i = 0; i < GetSize(cells); i++)
+		{
+			Cell *cell = cells[i];
+			int shape = cell_shape[i];
+
+			if (!shape_done[shape]) {
+				if (group.concurrent())
+					group.wait(shape);
+				else
+					shape_found[shape] = select_rule(cell, rules, shape_rule[shape]);
+				shape_done[shape] = true;
+			} else {
+				Cell *first_cell = shape_first_cell[shape];
+				log("Processing %s.%s:\n", log_id(cell->module), log_id(cell));
+				log("  Same shape as %s.%s, reusing its rule selection.\n", log_id(first_cell->module), log_id(first_cell));
+				if (!shape_found[shape])
+					log("  No acceptable bram resources found.\n");
+			}
+
+			if (shape_found[shape])
+				map_cell(cell, rules, shape_rule[shape]);
+		}
 	}
 } MemoryBramPass;
 
@@ -32,13 +32,12 @@ bool memcells_cmp(Cell *a, Cell *b)
 	return a->parameters.at("\\PRIORITY").as_int() < b->parameters.at("\\PRIORITY").as_int();
 }
 
-Cell *handle_memory(Module *module, RTLIL::Memory *memory)
+Cell *handle_memory(Module *module, SigMap &sigmap, RTLIL::Memory *memory, std::vector<Cell*> &memcells)
 {
 	log("Collecting $memrd, $memwr and $meminit for memory `%s' in module `%s':\n",
 			memory->name.c_str(), module->name.c_str());
 
 	Const init_data(State::Sx, memory->size * memory->width);
-	SigMap sigmap(module);
 
 	int wr_ports = 0;
 	SigSpec sig_wr_clk;
@@ -58,17 +57,12 @@ Cell *handle_memory(Module *module, RTLIL::Memory *memory)
 	SigSpec sig_rd_en;
 
 	int addr_bits = 0;
-	std::vector<Cell*> memcells;
 
-	for (auto &cell_it : module->cells_) {
-		Cell *cell = cell_it.second;
-		if (cell->type.in("$memrd", "$memwr", "$meminit") && memory->name == cell->parameters["\\MEMID"].decode_string()) {
-			SigSpec addr = sigmap(cell->getPort("\\ADDR"));
-			for (int i = 0; i < GetSize(addr); i++)
-				if (addr[i] != State::S0)
-					addr_bits = std::max(addr_bits, i+1);
-			memcells.push_back(cell);
-		}
+	for (auto cell : memcells) {
+		SigSpec addr = sigmap(cell->getPort("\\ADDR"));
+		for (int i = 0; i < GetSize(addr); i++)
+			if (addr[i] != State::S0)
+				addr_bits = std::max(addr_bits, i+1);
 	}
 
 	if (memory->start_offset == 0 && addr_bits < 30 && (1 << addr_bits) < memory->size)
@@ -107,7 +101,7 @@ Cell *handle_memory(Module *module, RTLIL::Memory *memory)
 
 			for (int i = 0; i < GetSize(data); i++)
 				if (0 <= i+offset && i+offset < GetSize(init_data))
-					init_data.bits[i+offset] = data[i].data;
+					init_data.set(i+offset, data[i].data);
 
 			continue;
 		}
@@ -184,6 +178,7 @@ Cell *handle_memory(Module *module, RTLIL::Memory *memory)
 	mem->parameters["\\OFFSET"] = Const(memory->start_offset);
 	mem->parameters["\\SIZE"] = Const(memory->size);
 	mem->parameters["\\ABITS"] = Const(addr_bits);
+	init_data.pack();
 	mem->parameters["\\INIT"] = init_data;
 
 	log_assert(sig_wr_clk.size() == wr_ports);
@@ -231,10 +226,20 @@ Cell *handle_memory(Module *module, RTLIL::Memory *memory)
 static void handle_module(Design *design, Module *module)
 {
 	std::vector<pair<Cell*, IdString>> finqueue;
+	SigMap sigmap(module);
+
+	// index the memory ports once instead of scanning all cells for every
+	// memory, handle_memory() only adds cells and removes the indexed ones
+	dict<IdString, std::vector<Cell*>> memcells;
+	for (auto &cell_it : module->cells_) {
+		Cell *cell = cell_it.second;
+		if (cell->type.in("$memrd", "$memwr", "$meminit"))
+			memcells[cell->parameters["\\MEMID"].decode_string()].push_back(cell);
+	}
 
 	for (auto &mem_it : module->memories)
 		if (design->selected(module, mem_it.second)) {
-			Cell *c = handle_memory(module, mem_it.second);
+			Cell *c = handle_memory(module, sigmap, mem_it.second, memcells[mem_it.first]);
 			finqueue.push_back(pair<Cell*, IdString>(c, mem_it.first));
 		}
 	for (auto &it : finqueue) {
@@ -30,6 +30,9 @@ struct MemoryDffWorker
 	SigMap sigmap;
 
 	vector<Cell*> dff_cells;
+	// sigmapped Q and D bits of dff_cells -> (index in dff_cells, bit
+	// position), sorted so that lookups see the cells in dff_cells order
+	dict<SigBit, vector<pair<int, int>>> dff_q_bits, dff_d_bits;
 	dict<SigBit, SigBit> invbits;
 	dict<SigBit, int> sigbit_users_count;
 	dict<SigSpec, Cell*> mux_cells_a, mux_cells_b;
@@ -49,6 +52,32 @@ struct MemoryDffWorker
 		}
 	}
 
+	void index_dff(int idx, IdString port, dict<SigBit, vector<pair<int, int>>> &index)
+	{
+		SigSpec sig = sigmap(dff_cells[idx]->getPort(port));
+		for (int i = 0; i < GetSize(sig); i++) {
+			if (sig[i].wire == NULL)
+				continue;
+			auto &entries = index[sig[i]];
+			auto entry = std::make_pair(idx, i);
+			entries.insert(std::lower_bound(entries.begin(), entries.end(), entry), entry);
+		}
+	}
+
+	void unindex_dff(int idx, IdString port, dict<SigBit, vector<pair<int, int>>> &index)
+	{
+		for (auto bit : sigmap(dff_cells[idx]->getPort(port))) {
+			auto it = index.find(bit);
+			if (it == index.end())
+				continue;
+			auto &entries = it->second;
+			entries.erase(std::remove_if(entries.begin(), entries.end(),
+					[&](const pair<int, int> &e) { return e.first == idx; }), entries.end());
+			if (entries.empty())
+				index.erase(it);
+		}
+	}
+
 	bool find_sig_before_dff(RTLIL::SigSpec &sig, RTLIL::SigSpec &clk, bool &clk_polarity, bool after = false)
 	{
 		sigmap.apply(sig);
@@ -61,8 +90,20 @@ struct MemoryDffWorker
 			if (!after && init_bits.count(sigmap(bit)))
 				return false;
 
-			for (auto cell : dff_cells)
+			auto &index = after ? dff_d_bits : dff_q_bits;
+			auto it = index.find(bit);
+			if (it == index.end())
+				return false;
+
+			const auto &entries = it->second;
+			for (int k = 0; k < GetSize(entries); k++)
 			{
+				// skip cells that have this bit at more than one position
+				int idx = entries[k].first;
+				if ((k > 0 && entries[k-1].first == idx) || (k+1 < GetSize(entries) && entries[k+1].first == idx))
+					continue;
+
+				Cell *cell = dff_cells[idx];
 				if (after && forward_merged_dffs.count(cell))
 					continue;
 
@@ -81,12 +122,7 @@ struct MemoryDffWorker
 						continue;
 				}
 
-				RTLIL::SigSpec q_norm = cell->getPort(after ? "\\D" : "\\Q");
-				sigmap.apply(q_norm);
-
-				RTLIL::SigSpec d = q_norm.extract(bit, &cell->getPort(after ? "\\Q" : "\\D"));
-				if (d.size() != 1)
-					continue;
+				SigBit d = cell->getPort(after ? "\\Q" : "\\D")[entries[k].second];
 
 				if (after && init_bits.count(d))
 					return false;
@@ -160,12 +196,24 @@ struct MemoryDffWorker
 
 		RTLIL::SigSpec new_sig = module->addWire(sstr.str(), sig.size());
 
-		for (auto cell : module->cells())
-			if (cell->type == "$dff") {
-				RTLIL::SigSpec new_q = cell->getPort("\\Q");
-				new_q.replace(sig, new_sig);
-				cell->setPort("\\Q", new_q);
-			}
+		std::set<int> dff_indices;
+		for (auto bit : sig) {
+			auto it = dff_q_bits.find(bit);
+			if (it != dff_q_bits.end())
+				for (auto &entry : it->second)
+					dff_indices.insert(entry.first);
+		}
+
+		for (int idx : dff_indices) {
+			Cell *cell = dff_cells[idx];
+			RTLIL::SigSpec new_q = cell->getPort("\\Q");
+			new_q.replace(sig, new_sig);
+			if (new_q == cell->getPort("\\Q"))
+				continue;
+			unindex_dff(idx, "\\Q", dff_q_bits);
+			cell->setPort("\\Q", new_q);
+			index_dff(idx, "\\Q", dff_q_bits);
+		}
 	}
 
 	void handle_rd_cell(RTLIL::Cell *cell)
@@ -278,6 +326,11 @@ struct MemoryDffWorker
 						sigbit_users_count[bit]++;
 		}
 
+		for (int i = 0; i < GetSize(dff_cells); i++) {
+			index_dff(i, "\\Q", dff_q_bits);
+			index_dff(i, "\\D", dff_d_bits);
+		}
+
 		for (auto cell : module->selected_cells())
 			if (cell->type == "$memwr" && !cell->parameters["\\CLK_ENABLE"].as_bool())
 				handle_wr_cell(cell);
@@ -30,6 +30,7 @@ struct MemoryMapWorker
 {
 	RTLIL::Design *design;
 	RTLIL::Module *module;
+	int max_cells;
 
 	std::map<std::pair<RTLIL::SigSpec, RTLIL::SigSpec>, RTLIL::SigBit> decoder_cache;
 
@@ -76,6 +77,33 @@ struct MemoryMapWorker
 		return bit.wire;
 	}
 
+	// the number of cells addr_decode() creates for the given addresses
+	static int64_t count_decoder_cells(int width, const std::vector<int> &addrs)
+	{
+		if (width < 2)
+			return GetSize(pool<int>(addrs.begin(), addrs.end()));
+
+		int split_at = width / 2;
+		std::vector<int> left, right;
+		pool<int> both;
+		for (int addr : addrs) {
+			left.push_back(split_at < 31 ? addr & ((1 << split_at) - 1) : addr);
+			right.push_back(split_at < 31 ? addr >> split_at : 0);
+			both.insert(addr);
+		}
+		return GetSize(both) + count_decoder_cells(split_at, left) + count_decoder_cells(width - split_at, right);
+	}
+
+	// the number of words whose read mux tree level has to be built, the
+	// subtrees for addresses beyond the end of the memory are left out
+	static int rd_level_size(int mem_size, int mem_abits, int level)
+	{
+		int shift = mem_abits - level;
+		if (shift >= 31)
+			return 1;
+		return int((int64_t(mem_size) + (int64_t(1) << shift) - 1) >> shift);
+	}
+
 	void handle_cell(RTLIL::Cell *cell)
 	{
 		std::set<int> static_ports;
@@ -102,8 +130,8 @@ struct MemoryMapWorker
 		RTLIL::SigSpec clocks = cell->getPort("\\WR_CLK");
 		RTLIL::Const clocks_pol = cell->parameters["\\WR_CLK_POLARITY"];
 		RTLIL::Const clocks_en = cell->parameters["\\WR_CLK_ENABLE"];
-		clocks_pol.bits.resize(wr_ports);
-		clocks_en.bits.resize(wr_ports);
+		clocks_pol.bits().resize(wr_ports);
+		clocks_en.bits().resize(wr_ports);
 		RTLIL::SigSpec refclock;
 		RTLIL::State refclock_pol = RTLIL::State::Sx;
 		for (int i = 0; i < clocks.size(); i++) {
@@ -112,7 +140,7 @@ struct MemoryMapWorker
 				static_ports.insert(i);
 				continue;
 			}
-			if (clocks_en.bits[i] != RTLIL::State::S1) {
+			if (clocks_en[i] != RTLIL::State::S1) {
 				RTLIL::SigSpec wr_addr = cell->getPort("\\WR_ADDR").extract(i*mem_abits, mem_abits);
 				RTLIL::SigSpec wr_data = cell->getPort("\\WR_DATA").extract(i*mem_width, mem_width);
 				if (wr_addr.is_fully_const()) {
@@ -129,16 +157,74 @@ struct MemoryMapWorker
 			}
 			if (refclock.size() == 0) {
 				refclock = clocks.extract(i, 1);
-				refclock_pol = clocks_pol.bits[i];
+				refclock_pol = clocks_pol[i];
 			}
-			if (clocks.extract(i, 1) != refclock || clocks_pol.bits[i] != refclock_pol) {
+			if (clocks.extract(i, 1) != refclock || clocks_pol[i] != refclock_pol) {
 				log("Not mapping memory cell %s in module %s (write clock %d is incompatible with other clocks).\n",
 						cell->name.c_str(), module->name.c_str(), i);
 				return;
 			}
 		}
 
+		// estimate the size of the result before creating anything
+
+		int64_t expected_dffs = 0, expected_rd_cells = 0, expected_wr_cells = 0;
+
+		for (int i = 0; i < mem_size; i++)
+			if (static_cells_map.count(i) == 0)
+				expected_dffs++;
+
+		std::set<RTLIL::SigSpec> expected_rd_addrs;
+		for (int i = 0; i < rd_ports; i++)
+		{
+			RTLIL::SigSpec rd_addr = cell->getPort("\\RD_ADDR").extract(i*mem_abits, mem_abits);
+			bool clocked = cell->parameters["\\RD_CLK_ENABLE"][i] == RTLIL::State::S1;
+			if (clocked)
+				expected_rd_cells += cell->getPort("\\RD_EN").extract(i) != State::S1 ? 2 : 1;
+			if (clocked && cell->parameters["\\RD_TRANSPARENT"][i] == RTLIL::State::S1)
+				rd_addr = RTLIL::SigSpec();
+			else if (expected_rd_addrs.count(rd_addr))
+				continue;
+			expected_rd_addrs.insert(rd_addr);
+			if (mem_offset)
+				expected_rd_cells++;
+			for (int j = 0; j < mem_abits; j++)
+				expected_rd_cells += rd_level_size(mem_size, mem_abits, j);
+		}
+
+		std::map<RTLIL::SigSpec, std::vector<int>> expected_wr_addrs;
+		for (int j = 0; j < wr_ports; j++)
+		{
+			if (static_ports.count(j))
+				continue;
+			RTLIL::SigSpec wr_addr = cell->getPort("\\WR_ADDR").extract(j*mem_abits, mem_abits);
+			RTLIL::SigSpec wr_en = cell->getPort("\\WR_EN").extract(j*mem_width, mem_width);
+			if (mem_offset)
+				expected_wr_cells++;
+			int wr_cells = 0;
+			for (int k = 0; k < GetSize(wr_en); k++)
+				if (k == 0 || wr_en[k] != wr_en[k-1])
+					wr_cells += wr_en[k] != State::S1 ? 2 : 1;
+			expected_wr_cells += wr_cells * expected_dffs;
+			if (expected_wr_addrs.count(wr_addr) == 0)
+				for (int i = 0; i < mem_size; i++)
+					if (static_cells_map.count(i) == 0)
+						expected_wr_addrs[wr_addr].push_back(i);
+		}
+		for (auto &it : expected_wr_addrs)
+			expected_wr_cells += count_decoder_cells(mem_abits, it.second);
+
+		int64_t expected_cells = expected_dffs + expected_rd_cells + expected_wr_cells;
+
+		if (max_cells >= 0 && expected_cells > max_cells) {
+			log("Not mapping memory cell %s in module %s (expected %lld cells, more than %d).\n",
+					cell->name.c_str(), module->name.c_str(), (long long)expected_cells, max_cells);
+			return;
+		}
+
 		log("Mapping memory cell %s in module %s:\n", cell->name.c_str(), module->name.c_str());
+		log("  expected cells: %lld $dff, %lld for the read interface, %lld for the write interface.\n",
+				(long long)expected_dffs, (long long)expected_rd_cells, (long long)expected_wr_cells);
 
 		std::vector<RTLIL::SigSpec> data_reg_in;
 		std::vector<RTLIL::SigSpec> data_reg_out;
@@ -157,8 +243,8 @@ struct MemoryMapWorker
 			{
 				RTLIL::Cell *c = module->addCell(genid(cell->name, "", i), "$dff");
 				c->parameters["\\WIDTH"] = cell->parameters["\\WIDTH"];
-				if (clocks_pol.bits.size() > 0) {
-					c->parameters["\\CLK_POLARITY"] = RTLIL::Const(clocks_pol.bits[0]);
+				if (clocks_pol.size() > 0) {
+					c->parameters["\\CLK_POLARITY"] = RTLIL::Const(clocks_pol[0]);
 					c->setPort("\\CLK", clocks.extract(0, 1));
 				} else {
 					c->parameters["\\CLK_POLARITY"] = RTLIL::Const(RTLIL::State::S1);
@@ -188,25 +274,35 @@ struct MemoryMapWorker
 
 		int count_dff = 0, count_mux = 0, count_wrmux = 0;
 
+		// subtract the memory offset only once for each address signal
+		std::map<RTLIL::SigSpec, RTLIL::SigSpec> offset_addr_cache;
+		auto offset_addr = [&](RTLIL::SigSpec addr) {
+			if (mem_offset == 0)
+				return addr;
+			if (offset_addr_cache.count(addr) == 0)
+				offset_addr_cache[addr] = module->Sub(NEW_ID, addr, SigSpec(mem_offset, GetSize(addr)));
+			return offset_addr_cache.at(addr);
+		};
+
+		// read ports with the same address share one mux tree
+		std::map<RTLIL::SigSpec, RTLIL::SigSpec> rd_tree_cache;
+
 		for (int i = 0; i < cell->parameters["\\RD_PORTS"].as_int(); i++)
 		{
-			RTLIL::SigSpec rd_addr = cell->getPort("\\RD_ADDR").extract(i*mem_abits, mem_abits);
-
-			if (mem_offset)
-				rd_addr = module->Sub(NEW_ID, rd_addr, SigSpec(mem_offset, GetSize(rd_addr)));
+			RTLIL::SigSpec rd_addr = offset_addr(cell->getPort("\\RD_ADDR").extract(i*mem_abits, mem_abits));
 
 			std::vector<RTLIL::SigSpec> rd_signals;
 			rd_signals.push_back(cell->getPort("\\RD_DATA").extract(i*mem_width, mem_width));
 
-			if (cell->parameters["\\RD_CLK_ENABLE"].bits[i] == RTLIL::State::S1)
+			if (cell->parameters["\\RD_CLK_ENABLE"][i] == RTLIL::State::S1)
 			{
 				RTLIL::Cell *dff_cell = nullptr;
 
-				if (cell->parameters["\\RD_TRANSPARENT"].bits[i] == RTLIL::State::S1)
+				if (cell->parameters["\\RD_TRANSPARENT"][i] == RTLIL::State::S1)
 				{
 					dff_cell = module->addCell(genid(cell->name, "$rdreg", i), "$dff");
 					dff_cell->parameters["\\WIDTH"] = RTLIL::Const(mem_abits);
-					dff_cell->parameters["\\CLK_POLARITY"] = RTLIL::Const(cell->parameters["\\RD_CLK_POLARITY"].bits[i]);
+					dff_cell->parameters["\\CLK_POLARITY"] = RTLIL::Const(cell->parameters["\\RD_CLK_POLARITY"][i]);
 					dff_cell->setPort("\\CLK", cell->getPort("\\RD_CLK").extract(i, 1));
 					dff_cell->setPort("\\D", rd_addr);
 					count_dff++;
@@ -220,7 +316,7 @@ struct MemoryMapWorker
 				{
 					dff_cell = module->addCell(genid(cell->name, "$rdreg", i), "$dff");
 					dff_cell->parameters["\\WIDTH"] = cell->parameters["\\WIDTH"];
-					dff_cell->parameters["\\CLK_POLARITY"] = RTLIL::Const(cell->parameters["\\RD_CLK_POLARITY"].bits[i]);
+					dff_cell->parameters["\\CLK_POLARITY"] = RTLIL::Const(cell->parameters["\\RD_CLK_POLARITY"][i]);
 					dff_cell->setPort("\\CLK", cell->getPort("\\RD_CLK").extract(i, 1));
 					dff_cell->setPort("\\Q", rd_signals.back());
 					count_dff++;
@@ -240,6 +336,12 @@ struct MemoryMapWorker
 				}
 			}
 
+			if (rd_tree_cache.count(rd_addr)) {
+				module->connect(RTLIL::SigSig(rd_signals.front(), rd_tree_cache.at(rd_addr)));
+				continue;
+			}
+			rd_tree_cache[rd_addr] = rd_signals.front();
+
 			for (int j = 0; j < mem_abits; j++)
 			{
 				std::vector<RTLIL::SigSpec> next_rd_signals;
@@ -259,6 +361,8 @@ struct MemoryMapWorker
 					next_rd_signals.push_back(c->getPort("\\B"));
 				}
 
+				// the inputs for addresses beyond the end of the memory stay undriven
+				next_rd_signals.resize(std::min(GetSize(next_rd_signals), rd_level_size(mem_size, mem_abits, j+1)));
 				next_rd_signals.swap(rd_signals);
 			}
 
@@ -268,6 +372,11 @@ struct MemoryMapWorker
 
 		log("  read interface: %d $dff and %d $mux cells.\n", count_dff, count_mux);
 
+		std::vector<RTLIL::SigSpec> wr_port_addrs;
+		for (int j = 0; j < cell->parameters["\\WR_PORTS"].as_int(); j++)
+			wr_port_addrs.push_back(static_ports.count(j) ? RTLIL::SigSpec() :
+					offset_addr(cell->getPort("\\WR_ADDR").extract(j*mem_abits, mem_abits)));
+
 		for (int i = 0; i < mem_size; i++)
 		{
 			if (static_cells_map.count(i) > 0)
@@ -277,13 +386,13 @@ struct MemoryMapWorker
 
 			for (int j = 0; j < cell->parameters["\\WR_PORTS"].as_int(); j++)
 			{
-				RTLIL::SigSpec wr_addr = cell->getPort("\\WR_ADDR").extract(j*mem_abits, mem_abits);
+				if (static_ports.count(j))
+					continue;
+
+				RTLIL::SigSpec wr_addr = wr_port_addrs[j];
 				RTLIL::SigSpec wr_data = cell->getPort("\\WR_DATA").extract(j*mem_width, mem_width);
 				RTLIL::SigSpec wr_en = cell->getPort("\\WR_EN").extract(j*mem_width, mem_width);
 
-				if (mem_offset)
-					wr_addr = module->Sub(NEW_ID, wr_addr, SigSpec(mem_offset, GetSize(wr_addr)));
-
 				RTLIL::Wire *w_seladdr = addr_decode(wr_addr, RTLIL::SigSpec(i, mem_abits));
 
 				int wr_offset = 0;
@@ -339,7 +448,7 @@ struct MemoryMapWorker
 		module->remove(cell);
 	}
 
-	MemoryMapWorker(RTLIL::Design *design, RTLIL::Module *module) : design(design), module(module)
+	MemoryMapWorker(RTLIL::Design *design, RTLIL::Module *module, int max_cells) : design(design), module(module), max_cells(max_cells)
 	{
 		std::vector<RTLIL::Cell*> cells;
 		for (auto cell : module->selected_cells())
@@ -356,17 +465,37 @@ struct MemoryMapPass : public Pass {
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
 		log("\n");
-		log("    memory_map [selection]\n");
+		log("    memory_map [options] [selection]\n");
 		log("\n");
 		log("This pass converts multiport memory cells as generated by the memory_collect\n");
 		log("pass to word-wide DFFs and address decoders.\n");
 		log("\n");
+		log("The number of cells the mapping will create is estimated and logged before\n");
+		log("anything is created. Read ports with the same address share one mux tree.\n");
+		log("\n");
+		log("    -max_cells <num>\n");
+		log("        do not map memories whose expected number of cells is larger than\n");
+		log("        the given limit. such memories are left as $mem cells, a flow can\n");
+		log("        check for them with 'select -assert-none t:$mem'.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE {
+		int max_cells = -1;
+
 		log_header(design, "Executing MEMORY_MAP pass (converting $mem cells to logic and flip-flops).\n");
-		extra_args(args, 1, design);
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++) {
+			if (args[argidx] == "-max_cells" && argidx+1 < args.size()) {
+				max_cells = atoi(args[++argidx].c_str());
+				continue;
+			}
+			break;
+		}
+		extra_args(args, argidx, design);
+
 		for (auto mod : design->selected_modules())
-			MemoryMapWorker(design, mod);
+			MemoryMapWorker(design, mod, max_cells);
 	}
 } MemoryMapPass;
 
@@ -104,8 +104,8 @@ struct MemoryNordffPass : public Pass {
 
 				rd_en[i] = State::S1;
 				rd_clk[i] = State::S0;
-				rd_clk_enable[i] = State::S0;
-				rd_clk_polarity[i] = State::S1;
+				rd_clk_enable.bits()[i] = State::S0;
+				rd_clk_polarity.bits()[i] = State::S1;
 			}
 
 			cell->setPort("\\RD_ADDR", rd_addr);
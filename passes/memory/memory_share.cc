@@ -21,6 +21,7 @@
 #include "kernel/satgen.h"
 #include "kernel/sigtools.h"
 #include "kernel/modtools.h"
+#include "kernel/randsim.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -45,6 +46,14 @@ struct MemoryShareWorker
 	std::map<RTLIL::SigBit, std::pair<RTLIL::Cell*, int>> sig_to_mux;
 	std::map<pair<std::set<std::map<SigBit, bool>>, SigBit>, SigBit> conditions_logic_cache;
 
+	// one SAT problem for the EN cones of all memories of the module, the
+	// cells and one-hot constraints are only imported when a port pair can
+	// not be decided without the solver
+	ezSatPtr ez;
+	std::unique_ptr<SatGen> satgen;
+	pool<RTLIL::Cell*> sat_imported_cells;
+	pool<RTLIL::Wire*> sat_one_hot_wires;
+
 
 	// -----------------------------------------------------------------
 	// Converting feedbacks to async read ports to proper enable signals
@@ -486,14 +495,52 @@ struct MemoryShareWorker
 	// Consolidate write ports using sat-based resource sharing
 	// --------------------------------------------------------
 
+	// Proves that two enable bits are never 1 at the same time from their
+	// drivers alone: one is the inverse of the other, or both compare the
+	// same signal with different constants.
+	bool structurally_exclusive(RTLIL::SigBit a, RTLIL::SigBit b)
+	{
+		auto single_driver = [&](RTLIL::SigBit bit) -> RTLIL::Cell* {
+			pool<ModWalker::PortBit> portbits;
+			modwalker.get_drivers(portbits, RTLIL::SigSpec(bit));
+			if (GetSize(portbits) != 1 || portbits.begin()->offset != 0)
+				return nullptr;
+			return portbits.begin()->cell;
+		};
+
+		RTLIL::Cell *cell_a = single_driver(a);
+		RTLIL::Cell *cell_b = single_driver(b);
+
+		for (auto it : { std::make_pair(cell_a, b), std::make_pair(cell_b, a) }) {
+			RTLIL::Cell *cell = it.first;
+			if (cell && cell->type.in("$not", "$_NOT_", "$logic_not") &&
+					GetSize(cell->getPort("\\A")) == 1 && modwalker.sigmap(cell->getPort("\\A")) == it.second)
+				return true;
+		}
+
+		if (cell_a == nullptr || cell_b == nullptr || cell_a->type != "$eq" || cell_b->type != "$eq")
+			return false;
+
+		// the compared signal and the constant it is compared with
+		auto split_eq = [&](RTLIL::Cell *cell, RTLIL::SigSpec &sig, RTLIL::SigSpec &value) {
+			sig = modwalker.sigmap(cell->getPort("\\A"));
+			value = modwalker.sigmap(cell->getPort("\\B"));
+			if (sig.is_fully_const())
+				std::swap(sig, value);
+			return GetSize(sig) == GetSize(value) && value.is_fully_def();
+		};
+
+		RTLIL::SigSpec sig_a, value_a, sig_b, value_b;
+		if (!split_eq(cell_a, sig_a, value_a) || !split_eq(cell_b, sig_b, value_b))
+			return false;
+		return sig_a == sig_b && value_a != value_b;
+	}
+
 	void consolidate_wr_using_sat(std::string memid, std::vector<RTLIL::Cell*> &wr_ports)
 	{
 		if (wr_ports.size() <= 1)
 			return;
 
-		ezSatPtr ez;
-		SatGen satgen(ez.get(), &modwalker.sigmap);
-
 		// find list of considered ports and port pairs
 
 		std::set<int> considered_ports;
@@ -544,18 +591,22 @@ struct MemoryShareWorker
 			return;
 		}
 
-		// create SAT representation of common input cone of all considered EN signals
+		// find the common input cone of all considered EN signals
 
 		pool<Wire*> one_hot_wires;
 		std::set<RTLIL::Cell*> sat_cells;
 		std::set<RTLIL::SigBit> bits_queue;
-		std::map<int, int> port_to_sat_variable;
+
+		// the original EN signals of the ports, and of the ports merged into them
+		std::map<int, std::vector<RTLIL::SigSpec>> port_en_sigs;
+		std::map<int, std::vector<int>> port_merged_from;
 
 		for (int i = 0; i < int(wr_ports.size()); i++)
 			if (considered_port_pairs.count(i) || considered_port_pairs.count(i+1))
 			{
 				RTLIL::SigSpec sig = modwalker.sigmap(wr_ports[i]->getPort("\\EN"));
-				port_to_sat_variable[i] = ez->expression(ez->OpOr, satgen.importSigSpec(sig));
+				port_en_sigs[i].push_back(sig);
+				port_merged_from[i].push_back(i);
 
 				std::vector<RTLIL::SigBit> bits = sig;
 				bits_queue.insert(bits.begin(), bits.end());
@@ -579,35 +630,140 @@ struct MemoryShareWorker
 				}
 		}
 
-		for (auto wire : one_hot_wires) {
-			log("  Adding one-hot constraint for wire %s.\n", log_id(wire));
-			vector<int> ez_wire_bits = satgen.importSigSpec(wire);
-			for (int i : ez_wire_bits)
-			for (int j : ez_wire_bits)
-				if (i != j) ez->assume(ez->NOT(i), j);
-		}
-
 		log("  Common input cone for all EN signals: %d cells.\n", int(sat_cells.size()));
 
-		for (auto cell : sat_cells)
-			satgen.importCell(cell);
+		// Simulate the cone with random inputs. A pattern for which two ports
+		// are both active shows that they can not be merged, without SAT. The
+		// patterns do not respect one-hot constraints, so this is skipped if
+		// there are any.
+
+		static const int sim_rounds = 4;
+		std::map<int, std::vector<std::pair<bool, RandomSim::word_t>>> port_sim_active;
+
+		if (one_hot_wires.empty())
+		{
+			RandomSim sim(modwalker.sigmap);
+			for (auto cell : sat_cells)
+				sim.add_cell(cell);
+
+			for (int round = 0; round < sim_rounds; round++) {
+				sim.next_round();
+				for (auto &it : port_en_sigs) {
+					bool known = true;
+					RandomSim::word_t active = 0, value;
+					for (auto bit : it.second.front())
+						if (sim.get(bit, value))
+							active |= value;
+						else
+							known = false;
+					port_sim_active[it.first].push_back(std::make_pair(known, active));
+				}
+			}
+		}
 
-		log("  Size of unconstrained SAT problem: %d variables, %d clauses\n", ez->numCnfVariables(), ez->numCnfClauses());
+		// returns true if the given ports (including the ports merged into
+		// them) are active at the same time for one of the simulated patterns
+		auto sim_both_active = [&](int i, int j) {
+			if (port_sim_active.empty())
+				return false;
+			for (int round = 0; round < sim_rounds; round++) {
+				RandomSim::word_t active_i = 0, active_j = 0;
+				for (int k : { i, j })
+				for (int port : port_merged_from[k]) {
+					auto &a = port_sim_active.at(port).at(round);
+					if (!a.first)
+						return false;
+					(k == i ? active_i : active_j) |= a.second;
+				}
+				if (active_i & active_j)
+					return true;
+			}
+			return false;
+		};
+
+		// the EN bit of a port if all of its EN bits are the same
+		auto single_en_bit = [&](int i, RTLIL::SigBit &bit) {
+			bool first = true;
+			for (auto &sig : port_en_sigs.at(i))
+				for (auto b : sig) {
+					if (!first && b != bit)
+						return false;
+					bit = b, first = false;
+				}
+			return !first;
+		};
+
+		auto sat_port_active = [&](int i) {
+			std::vector<int> en_bits;
+			for (auto &sig : port_en_sigs.at(i)) {
+				std::vector<int> bits = satgen->importSigSpec(sig);
+				en_bits.insert(en_bits.end(), bits.begin(), bits.end());
+			}
+			return ez->expression(ez->OpOr, en_bits);
+		};
 
 		// merge subsequent ports if possible
 
+		bool sat_ready = false;
+
 		for (int i = 0; i < int(wr_ports.size()); i++)
 		{
 			if (!considered_port_pairs.count(i))
 				continue;
 
-			if (ez->solve(port_to_sat_variable.at(i-1), port_to_sat_variable.at(i))) {
+			RTLIL::SigBit en_bit_a, en_bit_b;
+			if (single_en_bit(i-1, en_bit_a) && single_en_bit(i, en_bit_b) && structurally_exclusive(en_bit_a, en_bit_b)) {
+				log("  Enable signals of port %d and port %d are exclusive by construction.\n", i-1, i);
+				goto merge_ports;
+			}
+
+			if (sim_both_active(i-1, i)) {
+				log("  According to simulation sharing of port %d with port %d is not possible.\n", i-1, i);
+				continue;
+			}
+
+			if (!sat_ready)
+			{
+				if (satgen == nullptr)
+					satgen.reset(new SatGen(ez.get(), &modwalker.sigmap));
+
+				for (auto wire : one_hot_wires) {
+					if (sat_one_hot_wires.count(wire))
+						continue;
+					log("  Adding one-hot constraint for wire %s.\n", log_id(wire));
+					vector<int> ez_wire_bits = satgen->importSigSpec(wire);
+					for (int a : ez_wire_bits)
+					for (int b : ez_wire_bits)
+						if (a != b) ez->assume(ez->NOT(a), b);
+					sat_one_hot_wires.insert(wire);
+				}
+
+				int imported_cells = 0;
+				for (auto cell : sat_cells)
+					if (!sat_imported_cells.count(cell)) {
+						satgen->importCell(cell);
+						sat_imported_cells.insert(cell);
+						imported_cells++;
+					}
+
+				log("  Imported %d cells, size of SAT problem: %d variables, %d clauses\n",
+						imported_cells, ez->numCnfVariables(), ez->numCnfClauses());
+				sat_ready = true;
+			}
+
+			if (ez->solve(sat_port_active(i-1), sat_port_active(i))) {
 				log("  According to SAT solver sharing of port %d with port %d is not possible.\n", i-1, i);
 				continue;
 			}
 
+		merge_ports:
 			log("  Merging port %d into port %d.\n", i-1, i);
-			port_to_sat_variable.at(i) = ez->OR(port_to_sat_variable.at(i-1), port_to_sat_variable.at(i));
+
+			auto &en_sigs = port_en_sigs.at(i);
+			auto &last_en_sigs = port_en_sigs.at(i-1);
+			en_sigs.insert(en_sigs.end(), last_en_sigs.begin(), last_en_sigs.end());
+			auto &merged_from = port_merged_from[i];
+			merged_from.insert(merged_from.end(), port_merged_from[i-1].begin(), port_merged_from[i-1].end());
 
 			RTLIL::SigSpec last_addr = wr_ports[i-1]->getPort("\\ADDR");
 			RTLIL::SigSpec last_data = wr_ports[i-1]->getPort("\\DATA");
@@ -706,16 +862,16 @@ struct MemoryShareWorker
 		}
 
 		cone_ct.setup_internals();
-		cone_ct.cell_types.erase("$mul");
-		cone_ct.cell_types.erase("$mod");
-		cone_ct.cell_types.erase("$div");
-		cone_ct.cell_types.erase("$pow");
-		cone_ct.cell_types.erase("$shl");
-		cone_ct.cell_types.erase("$shr");
-		cone_ct.cell_types.erase("$sshl");
-		cone_ct.cell_types.erase("$sshr");
-		cone_ct.cell_types.erase("$shift");
-		cone_ct.cell_types.erase("$shiftx");
+		cone_ct.remove_type("$mul");
+		cone_ct.remove_type("$mod");
+		cone_ct.remove_type("$div");
+		cone_ct.remove_type("$pow");
+		cone_ct.remove_type("$shl");
+		cone_ct.remove_type("$shr");
+		cone_ct.remove_type("$sshl");
+		cone_ct.remove_type("$sshr");
+		cone_ct.remove_type("$shift");
+		cone_ct.remove_type("$shiftx");
 
 		modwalker.setup(design, module, &cone_ct);
 
@@ -745,7 +901,10 @@ struct MemorySharePass : public Pass {
 		log("\n");
 		log("  - When multiple write ports are never accessed at the same time (a SAT\n");
 		log("    solver is used to determine this), then the ports are merged into a single\n");
-		log("    write port.\n");
+		log("    write port. Simple cases, like enables that compare the same signal with\n");
+		log("    different constants, are decided from the netlist structure, and random\n");
+		log("    simulation is used to rule out ports that can be active together, before\n");
+		log("    the SAT solver is run.\n");
 		log("\n");
 		log("Note that in addition to the algorithms implemented in this pass, the $memrd\n");
 		log("and $memwr cells are also subject to generic resource sharing passes (and other\n");
@@ -84,7 +84,7 @@ void handle_memory(RTLIL::Module *module, RTLIL::Cell *memory)
 
 	for (int i = 0; i < GetSize(initval) && i/mem->width < (1 << abits); i += mem->width) {
 		Const val = initval.extract(i, mem->width, State::Sx);
-		for (auto bit : val.bits)
+		for (auto bit : val)
 			if (bit != State::Sx)
 				goto found_non_undef_initval;
 		continue;
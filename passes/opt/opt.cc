@@ -25,8 +25,80 @@
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
+// Tracks which modules an iteration of the opt loop has to visit. A module
+// that did not change in the previous iteration is at its fixpoint, unless a
+// module it instantiates changed (opt_clean looks at port directions and keep
+// attributes of submodules), so later iterations only visit the changed
+// modules and the modules above them.
+struct OptWorklist
+{
+	RTLIL::Design *design;
+	RTLIL::Selection selection;
+	dict<RTLIL::Module*, unsigned int> generations;
+	bool narrowed = false;
+
+	OptWorklist(RTLIL::Design *design) : design(design), selection(design->selection_stack.back()) { }
+
+	void begin_iteration()
+	{
+		generations.clear();
+		for (auto module : design->modules())
+			generations[module] = module->generation;
+
+		if (narrowed)
+			log("Visiting %d modules that changed in the last iteration or instantiate such modules.\n",
+					GetSize(selection.selected_modules) + GetSize(selection.selected_members));
+	}
+
+	// Returns false if no module has changed, otherwise narrows the selection
+	// for the next iteration.
+	bool end_iteration()
+	{
+		pool<RTLIL::Module*> dirty;
+		for (auto module : design->modules())
+			if (!generations.count(module) || generations.at(module) != module->generation)
+				dirty.insert(module);
+		if (dirty.empty())
+			return false;
+
+		dict<RTLIL::Module*, pool<RTLIL::Module*>> parents;
+		for (auto module : design->modules())
+			for (auto cell : module->cells()) {
+				RTLIL::Module *submodule = design->module(cell->type);
+				if (submodule != nullptr)
+					parents[submodule].insert(module);
+			}
+
+		std::vector<RTLIL::Module*> queue(dirty.begin(), dirty.end());
+		while (!queue.empty()) {
+			RTLIL::Module *module = queue.back();
+			queue.pop_back();
+			for (auto parent : parents[module])
+				if (dirty.insert(parent).second)
+					queue.push_back(parent);
+		}
+
+		const RTLIL::Selection &orig = design->selection_stack.back();
+		RTLIL::Selection new_selection(false);
+		for (auto module : dirty) {
+			if (orig.selected_whole_module(module->name))
+				new_selection.selected_modules.insert(module->name);
+			else if (orig.selected_members.count(module->name))
+				new_selection.selected_members[module->name] = orig.selected_members.at(module->name);
+		}
+		selection = new_selection;
+		narrowed = true;
+		return true;
+	}
+
+	void call(const std::string &command)
+	{
+		Pass::call_on_selection(design, selection, command);
+	}
+};
+
 struct OptPass : public Pass {
-	OptPass() : Pass("opt", "perform simple optimizations") { }
+	OptPass() : Pass("opt", "perform simple optimizations") { module_changes_tracked(); }
 	void help() YS_OVERRIDE
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -59,6 +131,12 @@ struct OptPass : public Pass {
 		log("        opt_clean [-purge]\n");
 		log("    while <changed design in opt_rmdff>\n");
 		log("\n");
+		log("After the first iteration, the passes in the loop only visit the modules that\n");
+		log("were changed in the previous iteration, and the modules that instantiate them.\n");
+		log("\n");
+		log("    -noincr\n");
+		log("        run every iteration of the loop on the whole selection.\n");
+		log("\n");
 		log("Note: Options in square brackets (such as [-keepdc]) are passed through to\n");
 		log("the opt_* commands when given to 'opt'.\n");
 		log("\n");
@@ -73,6 +151,7 @@ struct OptPass : public Pass {
 		std::string opt_rmdff_args;
 		bool opt_share = false;
 		bool fast_mode = false;
+		bool incr_mode = true;
 
 		log_header(design, "Executing OPT pass (performing simple optimizations).\n");
 		log_push();
@@ -127,20 +206,29 @@ struct OptPass : public Pass {
 				fast_mode = true;
 				continue;
 			}
+			if (args[argidx] == "-noincr") {
+				incr_mode = false;
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
+		OptWorklist worklist(design);
+
 		if (fast_mode)
 		{
 			while (1) {
-				Pass::call(design, "opt_expr" + opt_expr_args);
-				Pass::call(design, "opt_merge" + opt_merge_args);
+				worklist.begin_iteration();
+				worklist.call("opt_expr" + opt_expr_args);
+				worklist.call("opt_merge" + opt_merge_args);
 				design->scratchpad_unset("opt.did_something");
-				Pass::call(design, "opt_rmdff" + opt_rmdff_args);
+				worklist.call("opt_rmdff" + opt_rmdff_args);
 				if (design->scratchpad_get_bool("opt.did_something") == false)
 					break;
-				Pass::call(design, "opt_clean" + opt_clean_args);
+				worklist.call("opt_clean" + opt_clean_args);
+				if (incr_mode && !worklist.end_iteration())
+					break;
 				log_header(design, "Rerunning OPT passes. (Removed registers in this run.)\n");
 			}
 			Pass::call(design, "opt_clean" + opt_clean_args);
@@ -150,17 +238,20 @@ struct OptPass : public Pass {
 			Pass::call(design, "opt_expr" + opt_expr_args);
 			Pass::call(design, "opt_merge -nomux" + opt_merge_args);
 			while (1) {
+				worklist.begin_iteration();
 				design->scratchpad_unset("opt.did_something");
-				Pass::call(design, "opt_muxtree");
-				Pass::call(design, "opt_reduce" + opt_reduce_args);
-				Pass::call(design, "opt_merge" + opt_merge_args);
+				worklist.call("opt_muxtree");
+				worklist.call("opt_reduce" + opt_reduce_args);
+				worklist.call("opt_merge" + opt_merge_args);
 				if (opt_share)
-					Pass::call(design, "opt_share");
-				Pass::call(design, "opt_rmdff" + opt_rmdff_args);
-				Pass::call(design, "opt_clean" + opt_clean_args);
-				Pass::call(design, "opt_expr" + opt_expr_args);
+					worklist.call("opt_share");
+				worklist.call("opt_rmdff" + opt_rmdff_args);
+				worklist.call("opt_clean" + opt_clean_args);
+				worklist.call("opt_expr" + opt_expr_args);
 				if (design->scratchpad_get_bool("opt.did_something") == false)
 					break;
+				if (incr_mode && !worklist.end_iteration())
+					break;
 				log_header(design, "Rerunning OPT passes. (Maybe there is more to do..)\n");
 			}
 		}
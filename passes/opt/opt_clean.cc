@@ -182,7 +182,7 @@ int count_nontrivial_wire_attrs(RTLIL::Wire *w)
 	return count;
 }
 
-bool compare_signals(RTLIL::SigBit &s1, RTLIL::SigBit &s2, SigPool &regs, SigPool &conns, pool<RTLIL::Wire*> &direct_wires)
+bool compare_signals(RTLIL::SigBit &s1, RTLIL::SigBit &s2, IndexedSigPool &regs, IndexedSigPool &conns, pool<RTLIL::Wire*> &direct_wires)
 {
 	RTLIL::Wire *w1 = s1.wire;
 	RTLIL::Wire *w2 = s2.wire;
@@ -234,8 +234,10 @@ bool check_public_name(RTLIL::IdString id)
 
 bool rmunused_module_signals(RTLIL::Module *module, bool purge_mode, bool verbose)
 {
-	SigPool register_signals;
-	SigPool connected_signals;
+	// the wires of the module are not changed until the end of this function
+	SigBitIndex bit_index(module);
+	IndexedSigPool register_signals(bit_index);
+	IndexedSigPool connected_signals(bit_index);
 
 	if (!purge_mode)
 		for (auto &it : module->cells_) {
@@ -272,11 +274,13 @@ bool rmunused_module_signals(RTLIL::Module *module, bool purge_mode, bool verbos
 		}
 	}
 
+	// the connections are rebuilt below, also invalidates the module sigmap
 	module->connections_.clear();
+	module->touch();
 
-	SigPool used_signals;
-	SigPool raw_used_signals;
-	SigPool used_signals_nodrivers;
+	IndexedSigPool used_signals(bit_index);
+	IndexedSigPool raw_used_signals(bit_index);
+	IndexedSigPool used_signals_nodrivers(bit_index);
 	for (auto &it : module->cells_) {
 		RTLIL::Cell *cell = it.second;
 		for (auto &it2 : cell->connections_) {
@@ -314,7 +318,7 @@ bool rmunused_module_signals(RTLIL::Module *module, bool purge_mode, bool verbos
 		if (wire->attributes.count(ID(init)))
 			initval = wire->attributes.at(ID(init));
 		if (GetSize(initval) != GetSize(wire))
-			initval.bits.resize(GetSize(wire), State::Sx);
+			initval.bits().resize(GetSize(wire), State::Sx);
 		if (initval.is_fully_undef())
 			wire->attributes.erase(ID(init));
 
@@ -350,7 +354,7 @@ bool rmunused_module_signals(RTLIL::Module *module, bool purge_mode, bool verbos
 				if (s1[i] != s2[i]) {
 					if (s2[i] == State::Sx && (initval[i] == State::S0 || initval[i] == State::S1)) {
 						s2[i] = initval[i];
-						initval[i] = State::Sx;
+						initval.bits()[i] = State::Sx;
 					}
 					new_conn.first.append_bit(s1[i]);
 					new_conn.second.append_bit(s2[i]);
@@ -504,8 +508,80 @@ void rmunused_module(RTLIL::Module *module, bool purge_mode, bool verbose, bool
 		while (rmunused_module_signals(module, purge_mode, verbose)) { }
 }
 
+// Modules that have not changed since they were cleaned last are skipped. The
+// result of cleaning a module also depends on the modules it instantiates (for
+// port directions and keep attributes), so the generation of all of them is
+// recorded as well.
+struct clean_record_t
+{
+	unsigned int design_hashidx, design_generation;
+	bool purge_mode, rminit;
+	std::vector<std::tuple<RTLIL::IdString, unsigned int, unsigned int>> deps;
+};
+
+dict<unsigned int, clean_record_t, hash_ops<int>> clean_records;
+
+bool module_unchanged(RTLIL::Module *module, bool purge_mode, bool rminit)
+{
+	auto it = clean_records.find(module->hashidx_);
+	if (it == clean_records.end())
+		return false;
+
+	const clean_record_t &record = it->second;
+	if (record.design_hashidx != module->design->hashidx_ || record.design_generation != module->design->generation)
+		return false;
+	if ((purge_mode && !record.purge_mode) || (rminit && !record.rminit))
+		return false;
+
+	for (auto &dep : record.deps) {
+		RTLIL::Module *mod = module->design->module(std::get<0>(dep));
+		if (mod == nullptr || mod->hashidx_ != std::get<1>(dep) || mod->generation != std::get<2>(dep))
+			return false;
+	}
+
+	return true;
+}
+
+void record_clean_modules(RTLIL::Design *design, const std::vector<RTLIL::Module*> &modules, bool purge_mode, bool rminit)
+{
+	dict<RTLIL::Module*, pool<RTLIL::Module*>> submodules;
+
+	auto get_submodules = [&](RTLIL::Module *module) -> const pool<RTLIL::Module*>& {
+		auto it = submodules.find(module);
+		if (it != submodules.end())
+			return it->second;
+		pool<RTLIL::Module*> &result = submodules[module];
+		for (auto cell : module->cells())
+			if (design->module(cell->type) != nullptr)
+				result.insert(design->module(cell->type));
+		return result;
+	};
+
+	for (auto module : modules)
+	{
+		clean_record_t &record = clean_records[module->hashidx_];
+		record.design_hashidx = design->hashidx_;
+		record.design_generation = design->generation;
+		record.purge_mode = purge_mode;
+		record.rminit = rminit;
+		record.deps.clear();
+
+		pool<RTLIL::Module*> deps;
+		std::vector<RTLIL::Module*> queue = {module};
+		deps.insert(module);
+		while (!queue.empty()) {
+			RTLIL::Module *mod = queue.back();
+			queue.pop_back();
+			record.deps.emplace_back(mod->name, mod->hashidx_, mod->generation);
+			for (auto submod : get_submodules(mod))
+				if (deps.insert(submod).second)
+					queue.push_back(submod);
+		}
+	}
+}
+
 struct OptCleanPass : public Pass {
-	OptCleanPass() : Pass("opt_clean", "remove unused cells and wires") { }
+	OptCleanPass() : Pass("opt_clean", "remove unused cells and wires") { module_changes_tracked(); }
 	void help() YS_OVERRIDE
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -518,6 +594,7 @@ struct OptCleanPass : public Pass {
 		log("after the passes that do the actual work.\n");
 		log("\n");
 		log("This pass only operates on completely selected modules without processes.\n");
+		log("Modules that have not changed since the last run of this pass are skipped.\n");
 		log("\n");
 		log("    -purge\n");
 		log("        also remove internal nets if they have a public name\n");
@@ -550,11 +627,18 @@ struct OptCleanPass : public Pass {
 		count_rm_cells = 0;
 		count_rm_wires = 0;
 
+		std::vector<RTLIL::Module*> cleaned_modules;
 		for (auto module : design->selected_whole_modules_warn()) {
 			if (module->has_processes_warn())
 				continue;
+			if (module_unchanged(module, purge_mode, true)) {
+				log("Skipping module %s as it is unchanged since the last run.\n", module->name.c_str());
+				continue;
+			}
 			rmunused_module(module, purge_mode, true, true);
+			cleaned_modules.push_back(module);
 		}
+		record_clean_modules(design, cleaned_modules, purge_mode, true);
 
 		if (count_rm_cells > 0 || count_rm_wires > 0)
 			log("Removed %d unused cells and %d unused wires.\n", count_rm_cells, count_rm_wires);
@@ -571,7 +655,7 @@ struct OptCleanPass : public Pass {
 } OptCleanPass;
 
 struct CleanPass : public Pass {
-	CleanPass() : Pass("clean", "remove unused cells and wires") { }
+	CleanPass() : Pass("clean", "remove unused cells and wires") { module_changes_tracked(); }
 	void help() YS_OVERRIDE
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -612,11 +696,16 @@ struct CleanPass : public Pass {
 		count_rm_cells = 0;
 		count_rm_wires = 0;
 
+		std::vector<RTLIL::Module*> cleaned_modules;
 		for (auto module : design->selected_whole_modules()) {
 			if (module->has_processes())
 				continue;
+			if (module_unchanged(module, purge_mode, false))
+				continue;
 			rmunused_module(module, purge_mode, ys_debug(), false);
+			cleaned_modules.push_back(module);
 		}
+		record_clean_modules(design, cleaned_modules, purge_mode, false);
 
 		log_suppressed();
 		if (count_rm_cells > 0 || count_rm_wires > 0)
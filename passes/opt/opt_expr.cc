@@ -84,7 +84,7 @@ void replace_undriven(RTLIL::Design *design, RTLIL::Module *module)
 			auto cursor = initbits.find(bit);
 			if (cursor != initbits.end()) {
 				revisit_initwires.insert(cursor->second.first);
-				val[i] = cursor->second.second;
+				val.bits()[i] = cursor->second.second;
 			}
 		}
 
@@ -102,7 +102,7 @@ void replace_undriven(RTLIL::Design *design, RTLIL::Module *module)
 			Const initval = wire->attributes.at(ID(init));
 			for (int i = 0; i < GetSize(initval) && i < GetSize(wire); i++) {
 				if (SigBit(initval[i]) == sig[i])
-					initval[i] = State::Sx;
+					initval.bits()[i] = State::Sx;
 			}
 			if (initval.is_fully_undef()) {
 				log_debug("Removing init attribute from %s/%s.\n", log_id(module), log_id(wire));
@@ -285,21 +285,21 @@ bool is_one_or_minus_one(const Const &value, bool is_signed, bool &is_negative)
 	bool all_bits_one = true;
 	bool last_bit_one = true;
 
-	if (GetSize(value.bits) < 1)
+	if (GetSize(value) < 1)
 		return false;
 
-	if (GetSize(value.bits) == 1) {
-		if (value.bits[0] != State::S1)
+	if (GetSize(value) == 1) {
+		if (value[0] != State::S1)
 			return false;
 		if (is_signed)
 			is_negative = true;
 		return true;
 	}
 
-	for (int i = 0; i < GetSize(value.bits); i++) {
-		if (value.bits[i] != State::S1)
+	for (int i = 0; i < GetSize(value); i++) {
+		if (value[i] != State::S1)
 			all_bits_one = false;
-		if (value.bits[i] != (i ? State::S0 : State::S1))
+		if (value[i] != (i ? State::S0 : State::S1))
 			last_bit_one = false;
 	}
 
@@ -350,7 +350,160 @@ int get_onehot_bit_index(RTLIL::SigSpec signal)
 	return bit_index;
 }
 
-void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool consume_x, bool mux_undef, bool mux_bool, bool do_fine, bool keepdc, bool clkinv)
+// Work list for repeated calls of replace_const_cells() on one module. The
+// first call in each consume_x mode visits all cells, later calls only the
+// cells whose connections changed and the cells connected to signals whose
+// driver changed since the last call in that mode. The monitor keeps the
+// SigMap of the module and the index of the cells on each signal up to date.
+struct ConstCellsWorklist : RTLIL::Monitor
+{
+	RTLIL::Module *module;
+	CellTypes ct;
+	SigMap sigmap;
+	dict<RTLIL::SigBit, dict<RTLIL::Cell*, int>> bit_cells;
+	pool<RTLIL::IdString> dirty[2];
+	bool full[2] = { true, true };
+	bool valid = true;
+
+	ConstCellsWorklist(RTLIL::Module *module) : module(module), sigmap(module)
+	{
+		ct.setup_internals();
+		ct.setup_stdcells();
+
+		for (auto cell : module->cells())
+			for (auto &conn : cell->connections())
+				index_cell(cell, conn.second, 1);
+
+		module->monitors.insert(this);
+	}
+
+	~ConstCellsWorklist()
+	{
+		module->monitors.erase(this);
+	}
+
+	void index_cell(RTLIL::Cell *cell, const RTLIL::SigSpec &sig, int count)
+	{
+		for (auto bit : sigmap(sig)) {
+			if (bit.wire == nullptr)
+				continue;
+			auto &cells = bit_cells[bit];
+			if ((cells[cell] += count) == 0)
+				cells.erase(cell);
+		}
+	}
+
+	void mark_cell(RTLIL::Cell *cell)
+	{
+		dirty[0].insert(cell->name);
+		dirty[1].insert(cell->name);
+	}
+
+	// marks the cells connected to a signal whose value may have changed
+	void mark_signal(const RTLIL::SigSpec &sig)
+	{
+		for (auto bit : sigmap(sig)) {
+			auto it = bit_cells.find(bit);
+			if (it != bit_cells.end())
+				for (auto &it2 : it->second)
+					mark_cell(it2.first);
+		}
+	}
+
+	bool is_output(RTLIL::Cell *cell, RTLIL::IdString port)
+	{
+		return !ct.cell_known(cell->type) || ct.cell_output(cell->type, port);
+	}
+
+	// called for cells that were changed in place, e.g. by assigning the type
+	void cell_changed(RTLIL::IdString name)
+	{
+		RTLIL::Cell *cell = module->cell(name);
+		if (cell == nullptr)
+			return;
+		mark_cell(cell);
+		for (auto &conn : cell->connections())
+			if (is_output(cell, conn.first))
+				mark_signal(conn.second);
+	}
+
+	// returns the cells to visit, or an empty pool for a full run
+	pool<RTLIL::Cell*> take(bool consume_x, bool &full_run)
+	{
+		pool<RTLIL::Cell*> cells;
+		full_run = full[consume_x];
+		full[consume_x] = false;
+		if (!full_run)
+			for (auto name : dirty[consume_x]) {
+				RTLIL::Cell *cell = module->cell(name);
+				if (cell != nullptr)
+					cells.insert(cell);
+			}
+		dirty[consume_x].clear();
+		return cells;
+	}
+
+	void notify_connect(RTLIL::Cell *cell, const RTLIL::IdString &port, const RTLIL::SigSpec &old_sig, RTLIL::SigSpec &sig) YS_OVERRIDE
+	{
+		mark_cell(cell);
+		if (is_output(cell, port)) {
+			mark_signal(old_sig);
+			mark_signal(sig);
+		}
+		index_cell(cell, old_sig, -1);
+		index_cell(cell, sig, 1);
+	}
+
+	void notify_connect(RTLIL::Module*, const RTLIL::SigSig &sigsig) YS_OVERRIDE
+	{
+		// Module::connect() notifies again without the assignments to constants
+		if (sigsig.first.has_const())
+			return;
+
+		mark_signal(sigsig.first);
+		mark_signal(sigsig.second);
+
+		for (int i = 0; i < GetSize(sigsig.first); i++)
+		{
+			RTLIL::SigBit old_first = sigmap(sigsig.first[i]);
+			RTLIL::SigBit old_second = sigmap(sigsig.second[i]);
+			if (old_first == old_second)
+				continue;
+
+			sigmap.add(sigsig.first[i], sigsig.second[i]);
+			RTLIL::SigBit new_bit = sigmap(sigsig.first[i]);
+
+			// move the cells of the merged signals to the new representative,
+			// there is no need to track cells on constants
+			for (auto old_bit : { old_first, old_second }) {
+				if (old_bit == new_bit || old_bit.wire == nullptr)
+					continue;
+				auto it = bit_cells.find(old_bit);
+				if (it == bit_cells.end())
+					continue;
+				dict<RTLIL::Cell*, int> cells;
+				cells.swap(it->second);
+				bit_cells.erase(old_bit);
+				if (new_bit.wire != nullptr)
+					for (auto &it2 : cells)
+						bit_cells[new_bit][it2.first] += it2.second;
+			}
+		}
+	}
+
+	void notify_connect(RTLIL::Module*, const std::vector<RTLIL::SigSig>&) YS_OVERRIDE
+	{
+		valid = false;
+	}
+
+	void notify_blackout(RTLIL::Module*) YS_OVERRIDE
+	{
+		valid = false;
+	}
+};
+
+void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool consume_x, bool mux_undef, bool mux_bool, bool do_fine, bool keepdc, bool clkinv,
+		ConstCellsWorklist *worklist = nullptr)
 {
 	if (!design->selected(module))
 		return;
@@ -359,21 +512,50 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 	ct_combinational.setup_internals();
 	ct_combinational.setup_stdcells();
 
-	SigMap assign_map(module);
+	bool full_run = true;
+	pool<RTLIL::Cell*> worklist_cells;
+	if (worklist != nullptr)
+		worklist_cells = worklist->take(consume_x, full_run);
+
+	SigMap assign_map;
+	if (worklist != nullptr)
+		assign_map = worklist->sigmap;
+	else
+		assign_map.set(module);
+
 	dict<RTLIL::SigSpec, RTLIL::SigSpec> invert_map;
 
 	TopoSort<RTLIL::Cell*, RTLIL::IdString::compare_ptr_by_name<RTLIL::Cell>> cells;
 	dict<RTLIL::Cell*, std::set<RTLIL::SigBit>> cell_to_inbit;
 	dict<RTLIL::SigBit, std::set<RTLIL::Cell*>> outbit_to_cell;
 
+	auto add_inverter = [&](RTLIL::Cell *cell) {
+		if (!design->selected(module, cell) || cell->type[0] != '$')
+			return;
+		if (cell->type.in(ID($_NOT_), ID($not), ID($logic_not)) &&
+				GetSize(cell->getPort(ID::A)) == 1 && GetSize(cell->getPort(ID::Y)) == 1)
+			invert_map[assign_map(cell->getPort(ID::Y))] = assign_map(cell->getPort(ID::A));
+		if (cell->type.in(ID($mux), ID($_MUX_)) &&
+				cell->getPort(ID::A) == SigSpec(State::S1) && cell->getPort(ID::B) == SigSpec(State::S0))
+			invert_map[assign_map(cell->getPort(ID::Y))] = assign_map(cell->getPort(ID(S)));
+	};
+
+	// invert_map is only looked up for the inputs of visited cells, so in a
+	// work list run it only needs the inverters driving those
+	if (!full_run)
+		for (auto cell : worklist_cells)
+			for (auto &conn : cell->connections())
+				for (auto bit : assign_map(conn.second)) {
+					auto it = worklist->bit_cells.find(bit);
+					if (it != worklist->bit_cells.end())
+						for (auto &it2 : it->second)
+							add_inverter(it2.first);
+				}
+
 	for (auto cell : module->cells())
-		if (design->selected(module, cell) && cell->type[0] == '$') {
-			if (cell->type.in(ID($_NOT_), ID($not), ID($logic_not)) &&
-					GetSize(cell->getPort(ID::A)) == 1 && GetSize(cell->getPort(ID::Y)) == 1)
-				invert_map[assign_map(cell->getPort(ID::Y))] = assign_map(cell->getPort(ID::A));
-			if (cell->type.in(ID($mux), ID($_MUX_)) &&
-					cell->getPort(ID::A) == SigSpec(State::S1) && cell->getPort(ID::B) == SigSpec(State::S0))
-				invert_map[assign_map(cell->getPort(ID::Y))] = assign_map(cell->getPort(ID(S)));
+		if ((full_run || worklist_cells.count(cell)) && design->selected(module, cell) && cell->type[0] == '$') {
+			if (full_run)
+				add_inverter(cell);
 			if (ct_combinational.cell_known(cell->type))
 				for (auto &conn : cell->connections()) {
 					RTLIL::SigSpec sig = assign_map(conn.second);
@@ -396,6 +578,10 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 
 	for (auto cell : cells.sorted)
 	{
+		bool prev_did_something = did_something;
+		RTLIL::IdString cell_name = cell->name;
+		did_something = false;
+
 #define ACTION_DO(_p_, _s_) do { cover("opt.opt_expr.action_" S__LINE__); replace_cell(assign_map, module, cell, input.as_string(), _p_, _s_); goto next_cell; } while (0)
 #define ACTION_DO_Y(_v_) ACTION_DO(ID::Y, RTLIL::SigSpec(RTLIL::State::S ## _v_))
 
@@ -1644,7 +1830,10 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 			}
 		}
 
-	next_cell:;
+	next_cell:
+		if (did_something && worklist != nullptr)
+			worklist->cell_changed(cell_name);
+		did_something = did_something || prev_did_something;
 #undef ACTION_DO
 #undef ACTION_DO_Y
 #undef FOLD_1ARG_CELL
@@ -1653,7 +1842,7 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 }
 
 struct OptExprPass : public Pass {
-	OptExprPass() : Pass("opt_expr", "perform const folding and simple expression rewriting") { }
+	OptExprPass() : Pass("opt_expr", "perform const folding and simple expression rewriting") { module_changes_tracked(); }
 	void help() YS_OVERRIDE
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -1687,6 +1876,11 @@ struct OptExprPass : public Pass {
 		log("        all result bits to be set to x. this behavior changes when 'a+0' is\n");
 		log("        replaced by 'a'. the -keepdc option disables all such optimizations.\n");
 		log("\n");
+		log("    -noincr\n");
+		log("        visit all cells in every iteration. by default only the first iteration\n");
+		log("        visits all cells and later iterations only visit the cells whose inputs\n");
+		log("        or connections changed in the meantime.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
 	{
@@ -1696,6 +1890,7 @@ struct OptExprPass : public Pass {
 		bool clkinv = false;
 		bool do_fine = false;
 		bool keepdc = false;
+		bool noincr = false;
 
 		log_header(design, "Executing OPT_EXPR pass (perform const folding).\n");
 		log_push();
@@ -1733,6 +1928,10 @@ struct OptExprPass : public Pass {
 				keepdc = true;
 				continue;
 			}
+			if (args[argidx] == "-noincr") {
+				noincr = true;
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
@@ -1744,20 +1943,35 @@ struct OptExprPass : public Pass {
 			if (undriven) {
 				did_something = false;
 				replace_undriven(design, module);
-				if (did_something)
+				if (did_something) {
 					design->scratchpad_set_bool("opt.did_something", true);
+					module->touch();
+				}
 			}
 
+			std::unique_ptr<ConstCellsWorklist> worklist;
+			auto run_const_cells = [&](bool consume_x) {
+				if (worklist != nullptr && !worklist->valid)
+					worklist.reset();
+				if (worklist == nullptr && !noincr)
+					worklist.reset(new ConstCellsWorklist(module));
+				replace_const_cells(design, module, consume_x, mux_undef, mux_bool, do_fine, keepdc, clkinv, worklist.get());
+			};
+
 			do {
 				do {
 					did_something = false;
-					replace_const_cells(design, module, false, mux_undef, mux_bool, do_fine, keepdc, clkinv);
-					if (did_something)
+					run_const_cells(false);
+					if (did_something) {
 						design->scratchpad_set_bool("opt.did_something", true);
+						module->touch();
+					}
 				} while (did_something);
-				replace_const_cells(design, module, true, mux_undef, mux_bool, do_fine, keepdc, clkinv);
-				if (did_something)
+				run_const_cells(true);
+				if (did_something) {
 					design->scratchpad_set_bool("opt.did_something", true);
+					module->touch();
+				}
 			} while (did_something);
 
 			log_suppressed();
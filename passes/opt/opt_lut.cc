@@ -20,6 +20,7 @@
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
 #include "kernel/modtools.h"
+#include "kernel/truthtable.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -38,27 +39,25 @@ struct OptLutWorker
 
 	int eliminated_count = 0, combined_count = 0;
 
-	bool evaluate_lut(RTLIL::Cell *lut, dict<SigBit, bool> inputs)
+	// The function of the LUT with its inputs replaced by the given functions
+	// of num_vars variables, other inputs are constant.
+	TruthTable lut_function(RTLIL::Cell *lut, const dict<SigBit, TruthTable> &inputs, int num_vars)
 	{
 		SigSpec lut_input = sigmap(lut->getPort(ID::A));
 		int lut_width = lut->getParam(ID(WIDTH)).as_int();
-		Const lut_table = lut->getParam(ID(LUT));
-		int lut_index = 0;
 
+		std::vector<TruthTable> input_functions;
+		input_functions.reserve(lut_width);
 		for (int i = 0; i < lut_width; i++)
 		{
-			SigBit input = sigmap(lut_input[i]);
-			if (inputs.count(input))
-			{
-				lut_index |= inputs[input] << i;
-			}
+			auto it = inputs.find(lut_input[i]);
+			if (it != inputs.end())
+				input_functions.push_back(it->second);
 			else
-			{
-				lut_index |= SigSpec(lut_input[i]).as_bool() << i;
-			}
+				input_functions.push_back(TruthTable(num_vars, lut_input[i] == State::S1));
 		}
 
-		return lut_table.extract(lut_index).as_bool();
+		return TruthTable(lut->getParam(ID(LUT)), lut_width).compose(input_functions);
 	}
 
 	void show_stats_by_arity()
@@ -208,39 +207,23 @@ struct OptLutWorker
 			SigSpec lut_input = sigmap(lut->getPort(ID::A));
 			pool<int> &lut_dlogic_inputs = luts_dlogic_inputs[lut];
 
-			vector<SigBit> lut_inputs;
+			idict<SigBit> lut_inputs;
 			for (auto &bit : lut_input)
 			{
 				if (bit.wire)
-					lut_inputs.push_back(sigmap(bit));
+					lut_inputs(sigmap(bit));
 			}
 
-			bool const0_match = true;
-			bool const1_match = true;
-			vector<bool> input_matches;
-			for (size_t i = 0; i < lut_inputs.size(); i++)
-				input_matches.push_back(true);
-
-			for (int eval = 0; eval < 1 << lut_inputs.size(); eval++)
-			{
-				dict<SigBit, bool> eval_inputs;
-				for (size_t i = 0; i < lut_inputs.size(); i++)
-					eval_inputs[lut_inputs[i]] = (eval >> i) & 1;
-				bool value = evaluate_lut(lut, eval_inputs);
-				if (value != 0)
-					const0_match = false;
-				if (value != 1)
-					const1_match = false;
-				for (size_t i = 0; i < lut_inputs.size(); i++)
-				{
-					if (value != eval_inputs[lut_inputs[i]])
-						input_matches[i] = false;
-				}
-			}
+			dict<SigBit, TruthTable> eval_inputs;
+			for (int i = 0; i < GetSize(lut_inputs); i++)
+				eval_inputs[lut_inputs[i]] = TruthTable::var(GetSize(lut_inputs), i);
+			TruthTable lut_table = lut_function(lut, eval_inputs, GetSize(lut_inputs));
 
+			bool const0_match = lut_table.is_const(false);
+			bool const1_match = lut_table.is_const(true);
 			int input_match = -1;
-			for (size_t i = 0; i < lut_inputs.size(); i++)
-				if (input_matches[i])
+			for (int i = 0; i < GetSize(lut_inputs); i++)
+				if (lut_table == eval_inputs.at(lut_inputs[i]))
 					input_match = i;
 
 			if (const0_match || const1_match || input_match != -1)
@@ -470,17 +453,15 @@ struct OptLutWorker
 					}
 					log_assert(lutR_unique.size() == 0);
 
-					RTLIL::Const lutM_new_table(State::Sx, 1 << lutM_width);
-					for (int eval = 0; eval < 1 << lutM_width; eval++)
+					dict<SigBit, TruthTable> eval_inputs;
+					for (int i = 0; i < lutM_width; i++)
 					{
-						dict<SigBit, bool> eval_inputs;
-						for (size_t i = 0; i < lutM_new_inputs.size(); i++)
-						{
-							eval_inputs[lutM_new_inputs[i]] = (eval >> i) & 1;
-						}
-						eval_inputs[lutA_output] = evaluate_lut(lutA, eval_inputs);
-						lutM_new_table[eval] = (RTLIL::State) evaluate_lut(lutB, eval_inputs);
+						SigBit bit = sigmap(lutM_new_inputs[i]);
+						if (bit.wire && !eval_inputs.count(bit))
+							eval_inputs[bit] = TruthTable::var(lutM_width, i);
 					}
+					eval_inputs[lutA_output] = lut_function(lutA, eval_inputs, lutM_width);
+					RTLIL::Const lutM_new_table = lut_function(lutB, eval_inputs, lutM_width).as_const();
 
 					log_debug("  Cell A truth table: %s.\n", lutA->getParam(ID(LUT)).as_string().c_str());
 					log_debug("  Cell B truth table: %s.\n", lutB->getParam(ID(LUT)).as_string().c_str());
@@ -207,7 +207,7 @@ struct OptLutInsPass : public Pass {
 						}
 						lidx |= val << j;
 					}
-					new_lut[i] = lut[lidx];
+					new_lut.bits()[i] = lut[lidx];
 				}
 				// For ecp5, do not replace with a const driver — the nextpnr
 				// packer requires a complete set of LUTs for wide LUT muxes.
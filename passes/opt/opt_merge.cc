@@ -21,13 +21,10 @@
 #include "kernel/sigtools.h"
 #include "kernel/log.h"
 #include "kernel/celltypes.h"
-#include "libs/sha1/sha1.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <set>
 
-#define USE_CELL_HASH_CACHE
-
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
@@ -35,15 +32,21 @@ struct OptMergeWorker
 {
 	RTLIL::Design *design;
 	RTLIL::Module *module;
-	SigMap assign_map;
+	const SigMap &assign_map;
 	SigMap dff_init_map;
 	bool mode_share_all;
 
 	CellTypes ct;
 	int total_count;
-#ifdef USE_CELL_HASH_CACHE
-	dict<const RTLIL::Cell*, std::string> cell_hash_cache;
-#endif
+
+	// Structural hash index over the mergeable cells. Cells are only rehashed
+	// when one of their (sigmapped) inputs changes because two signals have
+	// been merged, so each candidate is looked up once instead of sorting all
+	// cells again for every round of merging.
+	dict<const RTLIL::Cell*, unsigned int> cell_hash;
+	dict<unsigned int, std::vector<RTLIL::Cell*>, hash_ops<int>> hash_buckets;
+	dict<RTLIL::SigBit, pool<RTLIL::Cell*>> bit_readers;
+	pool<RTLIL::Cell*> dirty_cells;
 
 	static void sort_pmux_conn(dict<RTLIL::IdString, RTLIL::SigSpec> &conn)
 	{
@@ -68,159 +71,67 @@ struct OptMergeWorker
 		}
 	}
 
-#ifdef USE_CELL_HASH_CACHE
-	std::string int_to_hash_string(unsigned int v)
-	{
-		if (v == 0)
-			return "0";
-		std::string str = "";
-		while (v > 0) {
-			str += 'a' + (v & 15);
-			v = v >> 4;
-		}
-		return str;
-	}
-
-	std::string hash_cell_parameters_and_connections(const RTLIL::Cell *cell)
+	dict<RTLIL::IdString, RTLIL::SigSpec> normalized_connections(const RTLIL::Cell *cell)
 	{
-		if (cell_hash_cache.count(cell) > 0)
-			return cell_hash_cache[cell];
+		dict<RTLIL::IdString, RTLIL::SigSpec> conn = cell->connections();
 
-		std::string hash_string = cell->type.str() + "\n";
-
-		for (auto &it : cell->parameters)
-			hash_string += "P " + it.first.str() + "=" + it.second.as_string() + "\n";
-
-		const dict<RTLIL::IdString, RTLIL::SigSpec> *conn = &cell->connections();
-		dict<RTLIL::IdString, RTLIL::SigSpec> alt_conn;
+		for (auto &it : conn) {
+			if (cell->output(it.first))
+				it.second = RTLIL::SigSpec();
+			else
+				assign_map.apply(it.second);
+		}
 
 		if (cell->type.in(ID($and), ID($or), ID($xor), ID($xnor), ID($add), ID($mul),
 				ID($logic_and), ID($logic_or), ID($_AND_), ID($_OR_), ID($_XOR_))) {
-			alt_conn = *conn;
-			if (assign_map(alt_conn.at(ID::A)) < assign_map(alt_conn.at(ID::B))) {
-				alt_conn[ID::A] = conn->at(ID::B);
-				alt_conn[ID::B] = conn->at(ID::A);
-			}
-			conn = &alt_conn;
+			if (conn.at(ID::A) < conn.at(ID::B))
+				std::swap(conn.at(ID::A), conn.at(ID::B));
 		} else
 		if (cell->type.in(ID($reduce_xor), ID($reduce_xnor))) {
-			alt_conn = *conn;
-			assign_map.apply(alt_conn.at(ID::A));
-			alt_conn.at(ID::A).sort();
-			conn = &alt_conn;
+			conn.at(ID::A).sort();
 		} else
 		if (cell->type.in(ID($reduce_and), ID($reduce_or), ID($reduce_bool))) {
-			alt_conn = *conn;
-			assign_map.apply(alt_conn.at(ID::A));
-			alt_conn.at(ID::A).sort_and_unify();
-			conn = &alt_conn;
+			conn.at(ID::A).sort_and_unify();
 		} else
 		if (cell->type == ID($pmux)) {
-			alt_conn = *conn;
-			assign_map.apply(alt_conn.at(ID::A));
-			assign_map.apply(alt_conn.at(ID::B));
-			assign_map.apply(alt_conn.at(ID(S)));
-			sort_pmux_conn(alt_conn);
-			conn = &alt_conn;
+			sort_pmux_conn(conn);
 		}
 
-		vector<string> hash_conn_strings;
+		return conn;
+	}
 
-		for (auto &it : *conn) {
-			if (cell->output(it.first))
-				continue;
-			RTLIL::SigSpec sig = it.second;
-			assign_map.apply(sig);
-			string s = "C " + it.first.str() + "=";
-			for (auto &chunk : sig.chunks()) {
-				if (chunk.wire)
-					s += "{" + chunk.wire->name.str() + " " +
-							int_to_hash_string(chunk.offset) + " " +
-							int_to_hash_string(chunk.width) + "}";
-				else
-					s += RTLIL::Const(chunk.data).as_string();
-			}
-			hash_conn_strings.push_back(s + "\n");
+	unsigned int hash_cell_parameters_and_connections(const RTLIL::Cell *cell)
+	{
+		// parameters and connections are combined with an order-independent
+		// sum, as dict comparison does not depend on the insertion order either
+		unsigned int hash_params = 0, hash_conn = 0;
+
+		for (auto &it : cell->parameters) {
+			unsigned int h = mkhash(it.first.hash(), GetSize(it.second));
+			for (auto bit : it.second)
+				h = mkhash(h, bit);
+			hash_params += h;
 		}
 
-		std::sort(hash_conn_strings.begin(), hash_conn_strings.end());
-
-		for (auto it : hash_conn_strings)
-			hash_string += it;
+		for (auto &it : normalized_connections(cell))
+			hash_conn += mkhash(it.first.hash(), it.second.hash());
 
-		cell_hash_cache[cell] = sha1(hash_string);
-		return cell_hash_cache[cell];
+		return mkhash(mkhash(cell->type.hash(), hash_params), hash_conn);
 	}
-#endif
 
-	bool compare_cell_parameters_and_connections(const RTLIL::Cell *cell1, const RTLIL::Cell *cell2, bool &lt)
+	bool compare_cell_parameters_and_connections(const RTLIL::Cell *cell1, const RTLIL::Cell *cell2)
 	{
-#ifdef USE_CELL_HASH_CACHE
-		std::string hash1 = hash_cell_parameters_and_connections(cell1);
-		std::string hash2 = hash_cell_parameters_and_connections(cell2);
+		if (cell1->type != cell2->type)
+			return false;
 
-		if (hash1 != hash2) {
-			lt = hash1 < hash2;
-			return true;
-		}
-#endif
+		if (cell1->parameters != cell2->parameters)
+			return false;
 
-		if (cell1->parameters != cell2->parameters) {
-			std::map<RTLIL::IdString, RTLIL::Const> p1(cell1->parameters.begin(), cell1->parameters.end());
-			std::map<RTLIL::IdString, RTLIL::Const> p2(cell2->parameters.begin(), cell2->parameters.end());
-			lt = p1 < p2;
-			return true;
-		}
+		dict<RTLIL::IdString, RTLIL::SigSpec> conn1 = normalized_connections(cell1);
+		dict<RTLIL::IdString, RTLIL::SigSpec> conn2 = normalized_connections(cell2);
 
-		dict<RTLIL::IdString, RTLIL::SigSpec> conn1 = cell1->connections();
-		dict<RTLIL::IdString, RTLIL::SigSpec> conn2 = cell2->connections();
-
-		for (auto &it : conn1) {
-			if (cell1->output(it.first))
-				it.second = RTLIL::SigSpec();
-			else
-				assign_map.apply(it.second);
-		}
-
-		for (auto &it : conn2) {
-			if (cell2->output(it.first))
-				it.second = RTLIL::SigSpec();
-			else
-				assign_map.apply(it.second);
-		}
-
-		if (cell1->type == ID($and) || cell1->type == ID($or) || cell1->type == ID($xor) || cell1->type == ID($xnor) || cell1->type == ID($add) || cell1->type == ID($mul) ||
-				cell1->type == ID($logic_and) || cell1->type == ID($logic_or) || cell1->type == ID($_AND_) || cell1->type == ID($_OR_) || cell1->type == ID($_XOR_)) {
-			if (conn1.at(ID::A) < conn1.at(ID::B)) {
-				RTLIL::SigSpec tmp = conn1[ID::A];
-				conn1[ID::A] = conn1[ID::B];
-				conn1[ID::B] = tmp;
-			}
-			if (conn2.at(ID::A) < conn2.at(ID::B)) {
-				RTLIL::SigSpec tmp = conn2[ID::A];
-				conn2[ID::A] = conn2[ID::B];
-				conn2[ID::B] = tmp;
-			}
-		} else
-		if (cell1->type == ID($reduce_xor) || cell1->type == ID($reduce_xnor)) {
-			conn1[ID::A].sort();
-			conn2[ID::A].sort();
-		} else
-		if (cell1->type == ID($reduce_and) || cell1->type == ID($reduce_or) || cell1->type == ID($reduce_bool)) {
-			conn1[ID::A].sort_and_unify();
-			conn2[ID::A].sort_and_unify();
-		} else
-		if (cell1->type == ID($pmux)) {
-			sort_pmux_conn(conn1);
-			sort_pmux_conn(conn2);
-		}
-
-		if (conn1 != conn2) {
-			std::map<RTLIL::IdString, RTLIL::SigSpec> c1(conn1.begin(), conn1.end());
-			std::map<RTLIL::IdString, RTLIL::SigSpec> c2(conn2.begin(), conn2.end());
-			lt = c1 < c2;
-			return true;
-		}
+		if (conn1 != conn2)
+			return false;
 
 		if (conn1.count(ID(Q)) != 0 && (cell1->type.begins_with("$dff") || cell1->type.begins_with("$dlatch") ||
 					cell1->type.begins_with("$_DFF") || cell1->type.begins_with("$_DLATCH") || cell1->type.begins_with("$_SR_") ||
@@ -228,43 +139,133 @@ struct OptMergeWorker
 			std::vector<RTLIL::SigBit> q1 = dff_init_map(cell1->getPort(ID(Q))).to_sigbit_vector();
 			std::vector<RTLIL::SigBit> q2 = dff_init_map(cell2->getPort(ID(Q))).to_sigbit_vector();
 			for (size_t i = 0; i < q1.size(); i++)
-				if ((q1.at(i).wire == NULL || q2.at(i).wire == NULL) && q1.at(i) != q2.at(i)) {
-					lt = q1.at(i) < q2.at(i);
-					return true;
-				}
+				if ((q1.at(i).wire == NULL || q2.at(i).wire == NULL) && q1.at(i) != q2.at(i))
+					return false;
 		}
 
-		return false;
+		return true;
 	}
 
-	bool compare_cells(const RTLIL::Cell *cell1, const RTLIL::Cell *cell2)
+	bool cell_mergeable(const RTLIL::Cell *cell)
 	{
-		if (cell1->type != cell2->type)
-			return cell1->type < cell2->type;
+		if (!design->selected(module, cell))
+			return false;
 
-		if ((!mode_share_all && !ct.cell_known(cell1->type)) || !cell1->known())
-			return cell1 < cell2;
+		if ((!mode_share_all && !ct.cell_known(cell->type)) || !cell->known())
+			return false;
 
-		if (cell1->has_keep_attr() || cell2->has_keep_attr())
-			return cell1 < cell2;
+		return !cell->has_keep_attr();
+	}
 
-		bool lt;
-		if (compare_cell_parameters_and_connections(cell1, cell2, lt))
-			return lt;
+	void index_cell(RTLIL::Cell *cell, unsigned int hash)
+	{
+		cell_hash[cell] = hash;
+		hash_buckets[hash].push_back(cell);
+
+		for (auto &it : cell->connections())
+			if (!cell->output(it.first))
+				for (auto bit : assign_map(it.second))
+					if (bit.wire != nullptr)
+						bit_readers[bit].insert(cell);
+	}
 
-		return false;
+	void unindex_cell(RTLIL::Cell *cell)
+	{
+		auto &bucket = hash_buckets.at(cell_hash.at(cell));
+		bucket.erase(std::find(bucket.begin(), bucket.end(), cell));
+		cell_hash.erase(cell);
+
+		for (auto &it : cell->connections())
+			if (!cell->output(it.first))
+				for (auto bit : assign_map(it.second))
+					if (bit.wire != nullptr)
+						bit_readers[bit].erase(cell);
 	}
 
-	struct CompareCells {
-		OptMergeWorker *that;
-		CompareCells(OptMergeWorker *that) : that(that) {}
-		bool operator()(const RTLIL::Cell *cell1, const RTLIL::Cell *cell2) const {
-			return that->compare_cells(cell1, cell2);
+	// Connect sig to other_sig and mark all indexed cells that read either
+	// of them as dirty, as the merge changes their sigmapped inputs.
+	void merge_signals(const RTLIL::SigSpec &sig, const RTLIL::SigSpec &other_sig)
+	{
+		std::vector<RTLIL::SigBit> old_bits;
+		for (auto bit : assign_map(sig))
+			old_bits.push_back(bit);
+		for (auto bit : assign_map(other_sig))
+			old_bits.push_back(bit);
+
+		// this also updates assign_map, which is the module sigmap
+		module->connect(RTLIL::SigSig(sig, other_sig));
+
+		for (auto bit : old_bits) {
+			auto it = bit_readers.find(bit);
+			if (it == bit_readers.end())
+				continue;
+			pool<RTLIL::Cell*> readers;
+			readers.swap(it->second);
+			bit_readers.erase(it);
+			for (auto cell : readers)
+				dirty_cells.insert(cell);
+			SigBit new_bit = assign_map(bit);
+			if (new_bit.wire != nullptr)
+				bit_readers[new_bit].insert(readers.begin(), readers.end());
 		}
-	};
+	}
+
+	void merge_cell(RTLIL::Cell *cell, RTLIL::Cell *other)
+	{
+		log_debug("  Cell `%s' is identical to cell `%s'.\n", cell->name.c_str(), other->name.c_str());
+
+		for (auto &it : cell->connections()) {
+			if (cell->output(it.first)) {
+				RTLIL::SigSpec other_sig = other->getPort(it.first);
+				log_debug("    Redirecting output %s: %s = %s\n", it.first.c_str(),
+						log_signal(it.second), log_signal(other_sig));
+				merge_signals(it.second, other_sig);
+
+				if (it.first == ID(Q) && (cell->type.begins_with("$dff") || cell->type.begins_with("$dlatch") ||
+							cell->type.begins_with("$_DFF") || cell->type.begins_with("$_DLATCH") || cell->type.begins_with("$_SR_") ||
+							cell->type.in("$adff", "$sr", "$ff", "$_FF_"))) {
+					for (auto c : it.second.chunks()) {
+						auto jt = c.wire->attributes.find(ID(init));
+						if (jt == c.wire->attributes.end())
+							continue;
+						for (int i = c.offset; i < c.offset + c.width; i++)
+							jt->second.bits()[i] = State::Sx;
+					}
+					dff_init_map.add(it.second, Const(State::Sx, GetSize(it.second)));
+				}
+			}
+		}
+
+		log_debug("    Removing %s cell `%s' from module `%s'.\n", cell->type.c_str(), cell->name.c_str(), module->name.c_str());
+		dirty_cells.erase(cell);
+		module->remove(cell);
+		total_count++;
+	}
+
+	// Look up a cell that is currently not indexed. It is either merged into
+	// an identical indexed cell and removed, or added to the index.
+	void process_cell(RTLIL::Cell *cell)
+	{
+		// equal interned parameters share their words, which makes comparing
+		// them a pointer compare
+		for (auto &it : cell->parameters)
+			it.second.intern();
+
+		unsigned int hash = hash_cell_parameters_and_connections(cell);
+
+		auto it = hash_buckets.find(hash);
+		if (it != hash_buckets.end())
+			for (auto other : it->second)
+				if (compare_cell_parameters_and_connections(cell, other)) {
+					merge_cell(cell, other);
+					return;
+				}
+
+		index_cell(cell, hash);
+	}
 
 	OptMergeWorker(RTLIL::Design *design, RTLIL::Module *module, bool mode_nomux, bool mode_share_all) :
-		design(design), module(module), assign_map(module), mode_share_all(mode_share_all)
+		design(design), module(module), assign_map(module->sigmap()), mode_share_all(mode_share_all)
 	{
 		total_count = 0;
 		ct.setup_internals();
@@ -273,19 +274,18 @@ struct OptMergeWorker
 		ct.setup_stdcells_mem();
 
 		if (mode_nomux) {
-			ct.cell_types.erase(ID($mux));
-			ct.cell_types.erase(ID($pmux));
+			ct.remove_type(ID($mux));
+			ct.remove_type(ID($pmux));
 		}
 
-		ct.cell_types.erase(ID($tribuf));
-		ct.cell_types.erase(ID($_TBUF_));
-		ct.cell_types.erase(ID($anyseq));
-		ct.cell_types.erase(ID($anyconst));
-		ct.cell_types.erase(ID($allseq));
-		ct.cell_types.erase(ID($allconst));
+		ct.remove_type(ID($tribuf));
+		ct.remove_type(ID($_TBUF_));
+		ct.remove_type(ID($anyseq));
+		ct.remove_type(ID($anyconst));
+		ct.remove_type(ID($allseq));
+		ct.remove_type(ID($allconst));
 
 		log("Finding identical cells in module `%s'.\n", module->name.c_str());
-		assign_map.set(module);
 
 		dff_init_map.set(module);
 		for (auto &it : module->wires_)
@@ -296,68 +296,33 @@ struct OptMergeWorker
 						dff_init_map.add(SigBit(it.second, i), initval[i]);
 			}
 
-		bool did_something = true;
-		while (did_something)
+		std::vector<RTLIL::Cell*> cells;
+		cells.reserve(module->cells_.size());
+		for (auto &it : module->cells_)
+			if (cell_mergeable(it.second))
+				cells.push_back(it.second);
+
+		for (auto cell : cells)
+			process_cell(cell);
+
+		while (!dirty_cells.empty())
 		{
-#ifdef USE_CELL_HASH_CACHE
-			cell_hash_cache.clear();
-#endif
-			std::vector<RTLIL::Cell*> cells;
-			cells.reserve(module->cells_.size());
-			for (auto &it : module->cells_) {
-				if (!design->selected(module, it.second))
-					continue;
-				if (ct.cell_known(it.second->type) || (mode_share_all && it.second->known()))
-					cells.push_back(it.second);
-			}
+			std::vector<RTLIL::Cell*> dirty(dirty_cells.begin(), dirty_cells.end());
+			dirty_cells.clear();
 
-			did_something = false;
-			std::map<RTLIL::Cell*, RTLIL::Cell*, CompareCells> sharemap(CompareCells(this));
-			for (auto cell : cells)
-			{
-				if (sharemap.count(cell) > 0) {
-					did_something = true;
-					log_debug("  Cell `%s' is identical to cell `%s'.\n", cell->name.c_str(), sharemap[cell]->name.c_str());
-					for (auto &it : cell->connections()) {
-						if (cell->output(it.first)) {
-							RTLIL::SigSpec other_sig = sharemap[cell]->getPort(it.first);
-							log_debug("    Redirecting output %s: %s = %s\n", it.first.c_str(),
-									log_signal(it.second), log_signal(other_sig));
-							module->connect(RTLIL::SigSig(it.second, other_sig));
-							assign_map.add(it.second, other_sig);
-
-							if (it.first == ID(Q) && (cell->type.begins_with("$dff") || cell->type.begins_with("$dlatch") ||
-										cell->type.begins_with("$_DFF") || cell->type.begins_with("$_DLATCH") || cell->type.begins_with("$_SR_") ||
-										cell->type.in("$adff", "$sr", "$ff", "$_FF_"))) {
-								for (auto c : it.second.chunks()) {
-									auto jt = c.wire->attributes.find(ID(init));
-									if (jt == c.wire->attributes.end())
-										continue;
-									for (int i = c.offset; i < c.offset + c.width; i++)
-										jt->second[i] = State::Sx;
-								}
-								dff_init_map.add(it.second, Const(State::Sx, GetSize(it.second)));
-							}
-						}
-					}
-					log_debug("    Removing %s cell `%s' from module `%s'.\n", cell->type.c_str(), cell->name.c_str(), module->name.c_str());
-#ifdef USE_CELL_HASH_CACHE
-					cell_hash_cache.erase(cell);
-#endif
-					module->remove(cell);
-					total_count++;
-				} else {
-					sharemap[cell] = cell;
-				}
-			}
+			for (auto cell : dirty)
+				unindex_cell(cell);
+
+			for (auto cell : dirty)
+				process_cell(cell);
 		}
 
 		log_suppressed();
 	}
 };
 
-struct OptMergePass : public Pass {
-	OptMergePass() : Pass("opt_merge", "consolidate identical cells") { }
+struct OptMergePass : public ModulePass {
+	OptMergePass() : ModulePass("opt_merge", "consolidate identical cells") { module_changes_tracked(); }
 	void help() YS_OVERRIDE
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -374,12 +339,24 @@ struct OptMergePass : public Pass {
 		log("        Operate on all cell types, not just built-in types.\n");
 		log("\n");
 	}
+	RTLIL::Design *design;
+	bool mode_nomux;
+	bool mode_share_all;
+	std::atomic<int> total_count;
+
+	void execute_module(RTLIL::Module *module) YS_OVERRIDE
+	{
+		OptMergeWorker worker(design, module, mode_nomux, mode_share_all);
+		total_count += worker.total_count;
+	}
+
 	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
 	{
 		log_header(design, "Executing OPT_MERGE pass (detect identical cells).\n");
 
-		bool mode_nomux = false;
-		bool mode_share_all = false;
+		this->design = design;
+		mode_nomux = false;
+		mode_share_all = false;
 
 		size_t argidx;
 		for (argidx = 1; argidx < args.size(); argidx++) {
@@ -396,15 +373,12 @@ struct OptMergePass : public Pass {
 		}
 		extra_args(args, argidx, design);
 
-		int total_count = 0;
-		for (auto module : design->selected_modules()) {
-			OptMergeWorker worker(design, module, mode_nomux, mode_share_all);
-			total_count += worker.total_count;
-		}
+		total_count = 0;
+		execute_modules(design);
 
 		if (total_count)
 			design->scratchpad_set_bool("opt.did_something", true);
-		log("Removed a total of %d cells.\n", total_count);
+		log("Removed a total of %d cells.\n", total_count.load());
 	}
 } OptMergePass;
 
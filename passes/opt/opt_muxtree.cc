@@ -34,9 +34,13 @@ struct OptMuxtreeWorker
 {
 	RTLIL::Design *design;
 	RTLIL::Module *module;
-	SigMap assign_map;
+	const SigMap &assign_map;
 	int removed_count;
-	int glob_abort_cnt = 100000;
+
+	// number of mux evaluations for one mux tree, after that all ports of
+	// the tree are kept
+	const int max_tree_evals = 100000;
+	int tree_abort_cnt = 0;
 
 	struct bitinfo_t {
 		bool seen_non_mux;
@@ -67,7 +71,7 @@ struct OptMuxtreeWorker
 	pool<int> root_mux_rerun;
 
 	OptMuxtreeWorker(RTLIL::Design *design, RTLIL::Module *module) :
-			design(design), module(module), assign_map(module), removed_count(0)
+			design(design), module(module), assign_map(module->sigmap()), removed_count(0)
 	{
 		log("Running muxtree optimizer on module %s..\n", module->name.c_str());
 
@@ -157,6 +161,10 @@ struct OptMuxtreeWorker
 					p.input_muxes.insert(k);
 		}
 
+		for (auto &mi : mux2info)
+		for (auto &p : mi.ports)
+			pool<int>().swap(p.input_sigs);
+
 		log("  Evaluating internal representation of mux trees.\n");
 
 		dict<int, pool<int>> mux_to_users;
@@ -184,10 +192,6 @@ struct OptMuxtreeWorker
 				log_debug("    Root of a mux tree: %s%s\n", log_id(mux2info[mux_idx].cell), root_enable_muxes.at(mux_idx) ? " (pure)" : "");
 				root_mux_rerun.erase(mux_idx);
 				eval_root_mux(mux_idx);
-				if (glob_abort_cnt == 0) {
-					log("  Giving up (too many iterations)\n");
-					return;
-				}
 			}
 
 		while (!root_mux_rerun.empty()) {
@@ -196,14 +200,9 @@ struct OptMuxtreeWorker
 			log_assert(root_enable_muxes.at(mux_idx));
 			root_mux_rerun.erase(mux_idx);
 			eval_root_mux(mux_idx);
-			if (glob_abort_cnt == 0) {
-				log("  Giving up (too many iterations)\n");
-				return;
-			}
 		}
 
 		log("  Analyzing evaluation results.\n");
-		log_assert(glob_abort_cnt > 0);
 
 		for (auto &mi : mux2info)
 		{
@@ -299,61 +298,213 @@ struct OptMuxtreeWorker
 		// this is just used to keep track of visited muxes in order to prohibit
 		// endless recursion in mux loops
 		vector<bool> visited_muxes;
+
+		// the changes to the databases, undone when leaving a mux port:
+		// ~bit for known_inactive, bit for known_active and the mux index
+		// in visited_log
+		vector<int> undo_log;
+		vector<int> visited_log;
+
+		void add_inactive(int bit) {
+			known_inactive[bit]++;
+			undo_log.push_back(~bit);
+		}
+
+		void add_active(int bit) {
+			known_active[bit]++;
+			undo_log.push_back(bit);
+		}
+
+		void visit(int mux_idx) {
+			visited_muxes[mux_idx] = true;
+			visited_log.push_back(mux_idx);
+		}
+
+		void undo(int undo_mark, int visited_mark)
+		{
+			while (GetSize(undo_log) > undo_mark) {
+				int bit = undo_log.back();
+				undo_log.pop_back();
+				if (bit < 0)
+					known_inactive[~bit]--;
+				else
+					known_active[bit]--;
+			}
+			while (GetSize(visited_log) > visited_mark) {
+				visited_muxes[visited_log.back()] = false;
+				visited_log.pop_back();
+			}
+		}
 	};
 
-	void eval_mux_port(knowledge_t &knowledge, int mux_idx, int port_idx, bool do_replace_known, bool do_enable_ports, int abort_count)
+	// allocated once and reused for all mux trees, the databases are empty
+	// between the trees
+	knowledge_t knowledge;
+
+	// A mux with a list of ports to evaluate, or a port with a list of input
+	// muxes to evaluate. The mux trees are walked with a stack of these
+	// instead of recursion, deep mux chains would overflow the call stack.
+	struct eval_frame_t
 	{
-		if (glob_abort_cnt == 0)
-			return;
+		int mux_idx, port_idx;
+		bool do_replace_known, do_enable_ports;
+		int abort_count;
+		vector<int> todo;
+		int next = 0;
+		int undo_mark = 0, visited_mark = 0;
+	};
 
+	vector<eval_frame_t> eval_stack;
+
+	void push_eval_mux_port(int mux_idx, int port_idx, bool do_replace_known, bool do_enable_ports, int abort_count)
+	{
 		muxinfo_t &muxinfo = mux2info[mux_idx];
 
 		if (do_enable_ports)
 			muxinfo.ports[port_idx].enabled = true;
 
+		eval_frame_t frame;
+		frame.mux_idx = mux_idx;
+		frame.port_idx = port_idx;
+		frame.do_replace_known = do_replace_known;
+		frame.do_enable_ports = do_enable_ports;
+		frame.abort_count = abort_count;
+		frame.undo_mark = GetSize(knowledge.undo_log);
+		frame.visited_mark = GetSize(knowledge.visited_log);
+
 		for (int i = 0; i < GetSize(muxinfo.ports); i++) {
 			if (i == port_idx)
 				continue;
 			if (muxinfo.ports[i].ctrl_sig >= 0)
-				knowledge.known_inactive.at(muxinfo.ports[i].ctrl_sig)++;
+				knowledge.add_inactive(muxinfo.ports[i].ctrl_sig);
 		}
 
 		if (port_idx < GetSize(muxinfo.ports)-1 && !muxinfo.ports[port_idx].const_activated)
-			knowledge.known_active.at(muxinfo.ports[port_idx].ctrl_sig)++;
+			knowledge.add_active(muxinfo.ports[port_idx].ctrl_sig);
 
-		vector<int> parent_muxes;
 		for (int m : muxinfo.ports[port_idx].input_muxes) {
 			if (knowledge.visited_muxes[m])
 				continue;
-			knowledge.visited_muxes[m] = true;
-			parent_muxes.push_back(m);
+			knowledge.visit(m);
+			frame.todo.push_back(m);
 		}
-		for (int m : parent_muxes) {
+
+		eval_stack.push_back(std::move(frame));
+	}
+
+	void push_eval_mux(int mux_idx, bool do_replace_known, bool do_enable_ports, int abort_count)
+	{
+		tree_abort_cnt--;
+
+		muxinfo_t &muxinfo = mux2info[mux_idx];
+
+		eval_frame_t frame;
+		frame.mux_idx = mux_idx;
+		frame.port_idx = -1;
+		frame.do_replace_known = do_replace_known;
+		frame.do_enable_ports = do_enable_ports;
+		frame.abort_count = abort_count;
+
+		// set input ports to constants if we find known active or inactive signals
+		if (do_replace_known) {
+			replace_known(knowledge, muxinfo, ID::A);
+			replace_known(knowledge, muxinfo, ID::B);
+		}
+
+		// if there is a constant activated port we just use it
+		for (int port_idx = 0; port_idx < GetSize(muxinfo.ports) && frame.todo.empty(); port_idx++)
+		{
+			portinfo_t &portinfo = muxinfo.ports[port_idx];
+			if (portinfo.const_activated)
+				frame.todo.push_back(port_idx);
+		}
+
+		// compare ports with known_active signals. if we find a match, only this
+		// port can be active. do not include the last port (its the default port
+		// that has no control signals).
+		for (int port_idx = 0; port_idx < GetSize(muxinfo.ports)-1 && frame.todo.empty(); port_idx++)
+		{
+			portinfo_t &portinfo = muxinfo.ports[port_idx];
+			if (portinfo.const_deactivated)
+				continue;
+			if (knowledge.known_active.at(portinfo.ctrl_sig))
+				frame.todo.push_back(port_idx);
+		}
+
+		// eval all ports that could be activated (control signal is not in
+		// known_inactive or const_deactivated).
+		if (frame.todo.empty())
+			for (int port_idx = 0; port_idx < GetSize(muxinfo.ports); port_idx++)
+			{
+				portinfo_t &portinfo = muxinfo.ports[port_idx];
+				if (portinfo.const_deactivated)
+					continue;
+				if (port_idx < GetSize(muxinfo.ports)-1)
+					if (knowledge.known_inactive.at(portinfo.ctrl_sig))
+						continue;
+				frame.todo.push_back(port_idx);
+			}
+
+		eval_stack.push_back(std::move(frame));
+	}
+
+	// returns false if the walk was aborted
+	bool eval_mux_tree()
+	{
+		while (!eval_stack.empty())
+		{
+			if (tree_abort_cnt <= 0)
+				return false;
+
+			eval_frame_t &frame = eval_stack.back();
+
+			if (frame.next == GetSize(frame.todo)) {
+				if (frame.port_idx >= 0)
+					knowledge.undo(frame.undo_mark, frame.visited_mark);
+				eval_stack.pop_back();
+				continue;
+			}
+
+			int item = frame.todo[frame.next++];
+
+			if (frame.port_idx < 0) {
+				push_eval_mux_port(frame.mux_idx, item, frame.do_replace_known, frame.do_enable_ports, frame.abort_count);
+				continue;
+			}
+
+			int m = item;
 			if (root_enable_muxes.at(m))
 				continue;
 			else if (root_muxes.at(m)) {
-				if (abort_count == 0) {
+				if (frame.abort_count == 0) {
 					root_mux_rerun.insert(m);
 					root_enable_muxes.at(m) = true;
 					log_debug("      Removing pure flag from root mux %s.\n", log_id(mux2info[m].cell));
 				} else
-					eval_mux(knowledge, m, false, do_enable_ports, abort_count - 1);
+					push_eval_mux(m, false, frame.do_enable_ports, frame.abort_count - 1);
 			} else
-				eval_mux(knowledge, m, do_replace_known, do_enable_ports, abort_count);
-			if (glob_abort_cnt == 0)
-				return;
+				push_eval_mux(m, frame.do_replace_known, frame.do_enable_ports, frame.abort_count);
 		}
-		for (int m : parent_muxes)
-			knowledge.visited_muxes[m] = false;
+		return true;
+	}
 
-		if (port_idx < GetSize(muxinfo.ports)-1 && !muxinfo.ports[port_idx].const_activated)
-			knowledge.known_active.at(muxinfo.ports[port_idx].ctrl_sig)--;
+	// keeps all ports of the mux tree, used when the walk was aborted
+	void enable_mux_tree(int root_idx)
+	{
+		pool<int> visited = {root_idx};
+		vector<int> worklist = {root_idx};
 
-		for (int i = 0; i < GetSize(muxinfo.ports); i++) {
-			if (i == port_idx)
-				continue;
-			if (muxinfo.ports[i].ctrl_sig >= 0)
-				knowledge.known_inactive.at(muxinfo.ports[i].ctrl_sig)--;
+		while (!worklist.empty())
+		{
+			int mux_idx = worklist.back();
+			worklist.pop_back();
+
+			for (auto &portinfo : mux2info[mux_idx].ports) {
+				portinfo.enabled = true;
+				for (int m : portinfo.input_muxes)
+					if (!root_enable_muxes.at(m) && visited.insert(m).second)
+						worklist.push_back(m);
+			}
 		}
 	}
 
@@ -404,75 +555,29 @@ struct OptMuxtreeWorker
 		}
 	}
 
-	void eval_mux(knowledge_t &knowledge, int mux_idx, bool do_replace_known, bool do_enable_ports, int abort_count)
-	{
-		if (glob_abort_cnt == 0)
-			return;
-		glob_abort_cnt--;
-
-		muxinfo_t &muxinfo = mux2info[mux_idx];
-
-		// set input ports to constants if we find known active or inactive signals
-		if (do_replace_known) {
-			replace_known(knowledge, muxinfo, ID::A);
-			replace_known(knowledge, muxinfo, ID::B);
-		}
-
-		// if there is a constant activated port we just use it
-		for (int port_idx = 0; port_idx < GetSize(muxinfo.ports); port_idx++)
-		{
-			portinfo_t &portinfo = muxinfo.ports[port_idx];
-			if (portinfo.const_activated) {
-				eval_mux_port(knowledge, mux_idx, port_idx, do_replace_known, do_enable_ports, abort_count);
-				return;
-			}
-		}
-
-		// compare ports with known_active signals. if we find a match, only this
-		// port can be active. do not include the last port (its the default port
-		// that has no control signals).
-		for (int port_idx = 0; port_idx < GetSize(muxinfo.ports)-1; port_idx++)
-		{
-			portinfo_t &portinfo = muxinfo.ports[port_idx];
-			if (portinfo.const_deactivated)
-				continue;
-			if (knowledge.known_active.at(portinfo.ctrl_sig)) {
-				eval_mux_port(knowledge, mux_idx, port_idx, do_replace_known, do_enable_ports, abort_count);
-				return;
-			}
-		}
-
-		// eval all ports that could be activated (control signal is not in
-		// known_inactive or const_deactivated).
-		for (int port_idx = 0; port_idx < GetSize(muxinfo.ports); port_idx++)
-		{
-			portinfo_t &portinfo = muxinfo.ports[port_idx];
-			if (portinfo.const_deactivated)
-				continue;
-			if (port_idx < GetSize(muxinfo.ports)-1)
-				if (knowledge.known_inactive.at(portinfo.ctrl_sig))
-					continue;
-			eval_mux_port(knowledge, mux_idx, port_idx, do_replace_known, do_enable_ports, abort_count);
-
-			if (glob_abort_cnt == 0)
-				return;
-		}
-	}
-
 	void eval_root_mux(int mux_idx)
 	{
-		log_assert(glob_abort_cnt > 0);
-		knowledge_t knowledge;
 		knowledge.known_inactive.resize(GetSize(bit2info));
 		knowledge.known_active.resize(GetSize(bit2info));
 		knowledge.visited_muxes.resize(GetSize(mux2info));
-		knowledge.visited_muxes[mux_idx] = true;
-		eval_mux(knowledge, mux_idx, true, root_enable_muxes.at(mux_idx), 3);
+
+		tree_abort_cnt = max_tree_evals;
+		knowledge.visit(mux_idx);
+		push_eval_mux(mux_idx, true, root_enable_muxes.at(mux_idx), 3);
+
+		if (!eval_mux_tree()) {
+			log("  Giving up on mux tree %s (too many iterations), keeping all its ports.\n", log_id(mux2info[mux_idx].cell));
+			if (root_enable_muxes.at(mux_idx))
+				enable_mux_tree(mux_idx);
+			eval_stack.clear();
+		}
+
+		knowledge.undo(0, 0);
 	}
 };
 
 struct OptMuxtreePass : public Pass {
-	OptMuxtreePass() : Pass("opt_muxtree", "eliminate dead trees in multiplexer trees") { }
+	OptMuxtreePass() : Pass("opt_muxtree", "eliminate dead trees in multiplexer trees") { module_changes_tracked(); }
 	void help() YS_OVERRIDE
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -497,6 +602,8 @@ struct OptMuxtreePass : public Pass {
 				continue;
 			OptMuxtreeWorker worker(design, module);
 			total_count += worker.removed_count;
+			if (worker.removed_count)
+				module->touch();
 		}
 		if (total_count)
 			design->scratchpad_set_bool("opt.did_something", true);
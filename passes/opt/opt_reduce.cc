@@ -330,8 +330,8 @@ struct OptReduceWorker
 	}
 };
 
-struct OptReducePass : public Pass {
-	OptReducePass() : Pass("opt_reduce", "simplify large MUXes and AND/OR gates") { }
+struct OptReducePass : public ModulePass {
+	OptReducePass() : ModulePass("opt_reduce", "simplify large MUXes and AND/OR gates") { module_changes_tracked(); }
 	void help() YS_OVERRIDE
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -346,6 +346,9 @@ struct OptReducePass : public Pass {
 		log("2. it identifies duplicated inputs to MUXes and replaces them with a single\n");
 		log("input with the original control signals OR'ed together.\n");
 		log("\n");
+		log("The modules are processed concurrently when yosys is run with multiple threads\n");
+		log("(yosys -j).\n");
+		log("\n");
 		log("    -fine\n");
 		log("      perform fine-grain optimizations\n");
 		log("\n");
@@ -353,9 +356,25 @@ struct OptReducePass : public Pass {
 		log("      alias for -fine\n");
 		log("\n");
 	}
+	RTLIL::Design *design;
+	bool do_fine;
+	std::atomic<int> total_count;
+
+	void execute_module(RTLIL::Module *module) YS_OVERRIDE
+	{
+		while (1) {
+			OptReduceWorker worker(design, module, do_fine);
+			total_count += worker.total_count;
+			if (worker.total_count == 0)
+				break;
+			module->touch();
+		}
+	}
+
 	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
 	{
-		bool do_fine = false;
+		this->design = design;
+		do_fine = false;
 
 		log_header(design, "Executing OPT_REDUCE pass (consolidate $*mux and $reduce_* inputs).\n");
 
@@ -373,18 +392,12 @@ struct OptReducePass : public Pass {
 		}
 		extra_args(args, argidx, design);
 
-		int total_count = 0;
-		for (auto module : design->selected_modules())
-			while (1) {
-				OptReduceWorker worker(design, module, do_fine);
-				total_count += worker.total_count;
-				if (worker.total_count == 0)
-					break;
-			}
+		total_count = 0;
+		execute_modules(design);
 
 		if (total_count)
 			design->scratchpad_set_bool("opt.did_something", true);
-		log("Performed a total of %d changes.\n", total_count);
+		log("Performed a total of %d changes.\n", total_count.load());
 	}
 } OptReducePass;
 
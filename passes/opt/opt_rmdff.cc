@@ -22,28 +22,19 @@
 #include "kernel/rtlil.h"
 #include "kernel/satgen.h"
 #include "kernel/sigtools.h"
+#include "kernel/ffindex.h"
 #include <stdio.h>
 #include <stdlib.h>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
-SigMap assign_map, dff_init_map;
-SigSet<RTLIL::Cell*> mux_drivers;
-dict<SigBit, RTLIL::Cell*> bit2driver;
-dict<SigBit, pool<SigBit>> init_attributes;
+FfIndex ff_index;
+SigMap &assign_map = ff_index.sigmap;
 
 bool keepdc;
 bool sat;
 
-void remove_init_attr(SigSpec sig)
-{
-	for (auto bit : assign_map(sig))
-		if (init_attributes.count(bit))
-			for (auto wbit : init_attributes.at(bit))
-				wbit.wire->attributes.at(ID(init))[wbit.offset] = State::Sx;
-}
-
 bool handle_dffsr(RTLIL::Module *mod, RTLIL::Cell *cell)
 {
 	SigSpec sig_set, sig_clr;
@@ -104,7 +95,7 @@ bool handle_dffsr(RTLIL::Module *mod, RTLIL::Cell *cell)
 					s == pol_set ? "set" : "cleared", log_signal(sig_q[i]),
 					log_id(cell), log_id(cell->type), log_id(mod));
 
-			remove_init_attr(sig_q[i]);
+			ff_index.remove_init(sig_q[i]);
 			mod->connect(sig_q[i], s == pol_set ? State::S1 : State::S0);
 			sig_set.remove(i);
 			sig_clr.remove(i);
@@ -122,7 +113,7 @@ bool handle_dffsr(RTLIL::Module *mod, RTLIL::Cell *cell)
 		if ((s.wire == nullptr) != (c.wire == nullptr)) {
 			if (s.wire != nullptr) used_pol_set = true;
 			if (c.wire != nullptr) used_pol_clr = true;
-			reset_val.bits.push_back(c.wire == nullptr ? State::S1 : State::S0);
+			reset_val.bits().push_back(c.wire == nullptr ? State::S1 : State::S0);
 		} else
 			proper_sr = true;
 	}
@@ -133,7 +124,7 @@ bool handle_dffsr(RTLIL::Module *mod, RTLIL::Cell *cell)
 	if (GetSize(sig_set) == 0)
 	{
 		log("Removing %s (%s) from module %s.\n", log_id(cell), log_id(cell->type), log_id(mod));
-		mod->remove(cell);
+		ff_index.remove_cell(cell);
 		return true;
 	}
 
@@ -241,10 +232,7 @@ bool handle_dlatch(RTLIL::Module *mod, RTLIL::Cell *dlatch)
 
 	if (sig_e == off_state)
 	{
-		RTLIL::Const val_init;
-		for (auto bit : dff_init_map(dlatch->getPort(ID(Q))))
-			val_init.bits.push_back(bit.wire == NULL ? bit.data : State::Sx);
-		mod->connect(dlatch->getPort(ID(Q)), val_init);
+		mod->connect(dlatch->getPort(ID(Q)), ff_index.init(dlatch->getPort(ID(Q))));
 		goto delete_dlatch;
 	}
 
@@ -258,8 +246,8 @@ bool handle_dlatch(RTLIL::Module *mod, RTLIL::Cell *dlatch)
 
 delete_dlatch:
 	log("Removing %s (%s) from module %s.\n", log_id(dlatch), log_id(dlatch->type), log_id(mod));
-	remove_init_attr(dlatch->getPort(ID(Q)));
-	mod->remove(dlatch);
+	ff_index.remove_init(dlatch->getPort(ID(Q)));
+	ff_index.remove_cell(dlatch);
 	return true;
 }
 
@@ -337,15 +325,23 @@ bool handle_dff(RTLIL::Module *mod, RTLIL::Cell *dff)
 
 	bool has_init = false;
 	RTLIL::Const val_init;
-	for (auto bit : dff_init_map(sig_q).to_sigbit_vector()) {
-		if (bit.wire == NULL || keepdc)
+	for (auto bit : sig_q) {
+		State val = ff_index.init(bit);
+		if (bit.wire == NULL || val != State::Sx || keepdc)
 			has_init = true;
-		val_init.bits.push_back(bit.wire == NULL ? bit.data : RTLIL::State::Sx);
+		val_init.bits().push_back(val);
 	}
 
-	if (dff->type.in(ID($ff), ID($dff)) && mux_drivers.has(sig_d)) {
+	if (dff->type.in(ID($ff), ID($dff))) {
 		std::set<RTLIL::Cell*> muxes;
-		mux_drivers.find(sig_d, muxes);
+		for (auto bit : sig_d) {
+			auto it = ff_index.bit2mux.find(bit);
+			if (it == ff_index.bit2mux.end())
+				continue;
+			RTLIL::Cell *mux = it->second.first;
+			if (mux->type.in(ID($mux), ID($pmux)) && mux->getPort(ID::A).size() == mux->getPort(ID::B).size())
+				muxes.insert(mux);
+		}
 		for (auto mux : muxes) {
 			RTLIL::SigSpec sig_a = assign_map(mux->getPort(ID::A));
 			RTLIL::SigSpec sig_b = assign_map(mux->getPort(ID::B));
@@ -364,7 +360,7 @@ bool handle_dff(RTLIL::Module *mod, RTLIL::Cell *dff)
 	//                                      (ii) Q has no initial value
 	//                                      (iii) initial value is same as reset value
 	if (!sig_c.empty() && sig_c.is_fully_const() && (!sig_r.size() || !has_init || val_init == val_rv)) {
-		if (val_rv.bits.size() == 0)
+		if (val_rv.size() == 0)
 			val_rv = val_init;
 		// Q is permanently reset value or initial value
 		mod->connect(sig_q, val_rv);
@@ -474,8 +470,8 @@ bool handle_dff(RTLIL::Module *mod, RTLIL::Cell *dff)
 				if (!c->input(conn.first))
 					continue;
 				for (auto bit : assign_map(conn.second))
-					if (bit2driver.count(bit))
-						sat_import_cell(bit2driver.at(bit));
+					if (ff_index.bit2driver.count(bit))
+						sat_import_cell(ff_index.bit2driver.at(bit));
 			}
 		};
 
@@ -487,10 +483,10 @@ bool handle_dff(RTLIL::Module *mod, RTLIL::Cell *dff)
 			if ((!q_sigbit.wire) || (!d_sigbit.wire))
 				continue;
 
-			if (!bit2driver.count(d_sigbit))
+			if (!ff_index.bit2driver.count(d_sigbit))
 				continue;
 
-			sat_import_cell(bit2driver.at(d_sigbit));
+			sat_import_cell(ff_index.bit2driver.at(d_sigbit));
 
 			RTLIL::State sigbit_init_val = val_init[position];
 			if (sigbit_init_val != State::S0 && sigbit_init_val != State::S1)
@@ -528,18 +524,13 @@ bool handle_dff(RTLIL::Module *mod, RTLIL::Cell *dff)
 
 delete_dff:
 	log("Removing %s (%s) from module %s.\n", log_id(dff), log_id(dff->type), log_id(mod));
-	remove_init_attr(dff->getPort(ID(Q)));
-	mod->remove(dff);
-
-	for (auto &entry : bit2driver)
-		if (entry.second == dff)
-			bit2driver.erase(entry.first);
-
+	ff_index.remove_init(dff->getPort(ID(Q)));
+	ff_index.remove_cell(dff);
 	return true;
 }
 
 struct OptRmdffPass : public Pass {
-	OptRmdffPass() : Pass("opt_rmdff", "remove DFFs with constant inputs") { }
+	OptRmdffPass() : Pass("opt_rmdff", "remove DFFs with constant inputs") { module_changes_tracked(); }
 	void help() YS_OVERRIDE
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -577,59 +568,30 @@ struct OptRmdffPass : public Pass {
 		extra_args(args, argidx, design);
 
 		for (auto module : design->selected_modules()) {
-			pool<SigBit> driven_bits;
-			dict<SigBit, State> init_bits;
+			int count_before = total_count + total_initdrv;
 
-			assign_map.set(module);
-			dff_init_map.set(module);
-			mux_drivers.clear();
-			bit2driver.clear();
-			init_attributes.clear();
+			ff_index.setup(module);
 
+			// the bits that are driven by anything, to find undriven bits
+			// with an init attribute
+			pool<SigBit> driven_bits;
+			for (auto &it : ff_index.bit2driver)
+				driven_bits.insert(it.first);
 			for (auto wire : module->wires())
-			{
-				if (wire->attributes.count(ID(init)) != 0) {
-					Const initval = wire->attributes.at(ID(init));
-					for (int i = 0; i < GetSize(initval) && i < GetSize(wire); i++)
-						if (initval[i] == State::S0 || initval[i] == State::S1)
-							dff_init_map.add(SigBit(wire, i), initval[i]);
-					for (int i = 0; i < GetSize(wire); i++) {
-						SigBit wire_bit(wire, i), mapped_bit = assign_map(wire_bit);
-						if (mapped_bit.wire) {
-							init_attributes[mapped_bit].insert(wire_bit);
-							if (i < GetSize(initval))
-								init_bits[mapped_bit] = initval[i];
-						}
-					}
-				}
-
-				if (wire->port_input) {
+				if (wire->port_input)
 					for (auto bit : assign_map(wire))
 						driven_bits.insert(bit);
-				}
-			}
+			for (auto cell : module->cells())
+				if (!cell->known())
+					for (auto &conn : cell->connections())
+						for (auto bit : assign_map(conn.second))
+							driven_bits.insert(bit);
 
 			std::vector<RTLIL::IdString> dff_list;
 			std::vector<RTLIL::IdString> dffsr_list;
 			std::vector<RTLIL::IdString> dlatch_list;
-			for (auto cell : module->cells())
+			for (auto cell : ff_index.ff_cells)
 			{
-				for (auto &conn : cell->connections()) {
-					bool is_output = cell->output(conn.first);
-					if (is_output || !cell->known())
-						for (auto bit : assign_map(conn.second)) {
-							if (is_output)
-								bit2driver[bit] = cell;
-							driven_bits.insert(bit);
-						}
-				}
-
-				if (cell->type.in(ID($mux), ID($pmux))) {
-					if (cell->getPort(ID::A).size() == cell->getPort(ID::B).size())
-						mux_drivers.insert(assign_map(cell->getPort(ID::Y)), cell);
-					continue;
-				}
-
 				if (!design->selected(module, cell))
 					continue;
 
@@ -670,7 +632,7 @@ struct OptRmdffPass : public Pass {
 
 			SigSpec const_init_sigs;
 
-			for (auto bit : init_bits)
+			for (auto bit : ff_index.init_bits)
 				if (!driven_bits.count(bit.first))
 					const_init_sigs.append(bit.first);
 
@@ -681,21 +643,21 @@ struct OptRmdffPass : public Pass {
 				Const val;
 
 				for (auto bit : sig)
-					val.bits.push_back(init_bits.at(bit));
+					val.bits().push_back(ff_index.init_bits.at(bit));
 
 				log("Promoting init spec %s = %s to constant driver in module %s.\n",
 						log_signal(sig), log_signal(val), log_id(module));
 
 				module->connect(sig, val);
-				remove_init_attr(sig);
+				ff_index.remove_init(sig);
 				total_initdrv++;
 			}
+
+			if (total_count + total_initdrv != count_before)
+				module->touch();
 		}
 
-		assign_map.clear();
-		mux_drivers.clear();
-		bit2driver.clear();
-		init_attributes.clear();
+		ff_index.clear();
 
 		if (total_count || total_initdrv)
 			design->scratchpad_set_bool("opt.did_something", true);
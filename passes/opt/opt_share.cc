@@ -22,6 +22,7 @@
 #include "kernel/register.h"
 #include "kernel/rtlil.h"
 #include "kernel/sigtools.h"
+#include "kernel/threadpool.h"
 #include <algorithm>
 
 #include <stdio.h>
@@ -30,8 +31,6 @@
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
-SigMap assign_map;
-
 struct OpMuxConn {
 	RTLIL::SigSpec sig;
 	RTLIL::Cell *mux;
@@ -110,22 +109,13 @@ bool cell_supported(RTLIL::Cell *cell)
 	return false;
 }
 
-std::map<IdString, IdString> mergeable_type_map;
-
-bool mergeable(RTLIL::Cell *a, RTLIL::Cell *b)
+// $sub cells are merged with $add cells by negating the muxed operand
+RTLIL::IdString merge_type(RTLIL::Cell *cell)
 {
-	if (mergeable_type_map.empty()) {
-		mergeable_type_map.insert({ID($sub), ID($add)});
-	}
-	auto a_type = a->type;
-	if (mergeable_type_map.count(a_type))
-		a_type = mergeable_type_map.at(a_type);
+	if (cell->type == ID($sub))
+		return ID($add);
 
-	auto b_type = b->type;
-	if (mergeable_type_map.count(b_type))
-		b_type = mergeable_type_map.at(b_type);
-
-	return a_type == b_type;
+	return cell->type;
 }
 
 RTLIL::IdString decode_port_semantics(RTLIL::Cell *cell, RTLIL::IdString port_name)
@@ -169,475 +159,517 @@ ExtSigSpec decode_port(RTLIL::Cell *cell, RTLIL::IdString port_name, SigMap *sig
 	return ExtSigSpec(sig, sign, is_signed, semantics);
 }
 
-void merge_operators(RTLIL::Module *module, RTLIL::Cell *mux, const std::vector<OpMuxConn> &ports, const ExtSigSpec &operand)
-{
-	std::vector<ExtSigSpec> muxed_operands;
-	int max_width = 0;
-	for (const auto& p : ports) {
-		auto op = p.op;
+// Operands of a supported operator cell, decoded once when the module is indexed
+struct OpInfo {
+	RTLIL::IdString merge_type;
+	ExtSigSpec port_a;
+	ExtSigSpec port_b;
 
-		RTLIL::IdString muxed_port_name = ID::A;
-		if (decode_port(op, ID::A, &assign_map) == operand)
-			muxed_port_name = ID::B;
+	const ExtSigSpec &port(RTLIL::IdString port_name) const { return port_name == ID::A ? port_a : port_b; }
+};
 
-		auto operand = decode_port(op, muxed_port_name, &assign_map);
-		if (operand.sig.size() > max_width)
-			max_width = operand.sig.size();
+typedef struct {
+	RTLIL::Cell *mux;
+	std::vector<OpMuxConn> ports;
+	ExtSigSpec shared_operand;
+} merged_op_t;
 
-		muxed_operands.push_back(operand);
-	}
 
-	auto shared_op = ports[0].op;
+template <typename T> void remove_val(std::vector<T> &v, const std::vector<T> &vals)
+{
+	auto val_iter = vals.rbegin();
+	for (auto i = v.rbegin(); i != v.rend(); ++i)
+		if ((val_iter != vals.rend()) && (*i == *val_iter)) {
+			v.erase(i.base() - 1);
+			++val_iter;
+		}
+}
+
+struct OptShareWorker
+{
+	RTLIL::Module *module;
+	SigMap assign_map;
 
-	if (std::any_of(muxed_operands.begin(), muxed_operands.end(), [&](ExtSigSpec &op) { return op.sign != muxed_operands[0].sign; }))
-        max_width = std::max(max_width, shared_op->getParam(ID(Y_WIDTH)).as_int());
+	// Index of the supported operator cells. It is built once per module and
+	// kept up to date by merge_operators(), so the ports of the operators are
+	// not decoded again for every mux and every merger.
+	dict<RTLIL::Cell*, OpInfo> op_index;
+	std::map<ExtSigSpec, std::set<RTLIL::Cell *>> operand_to_users;
+	bool any_shared_operands = false;
 
+	dict<RTLIL::SigSpec, RTLIL::Cell *> outsig_to_operator;
+	dict<RTLIL::SigBit, RTLIL::SigSpec> op_outbit_to_outsig;
+	dict<RTLIL::SigBit, RTLIL::SigSpec> op_aux_to_outsig;
 
-	for (auto &operand : muxed_operands)
-		operand.sig.extend_u0(max_width, operand.is_signed);
+	int merge_count = 0;
 
-	for (const auto& p : ports) {
-		auto op = p.op;
-		if (op == shared_op)
-			continue;
-		module->remove(op);
+	void index_operator(RTLIL::Cell *cell)
+	{
+		OpInfo &info = op_index[cell];
+		info.merge_type = merge_type(cell);
+		info.port_a = decode_port(cell, ID::A, &assign_map);
+		info.port_b = decode_port(cell, ID::B, &assign_map);
+
+		for (auto op_insig : {&info.port_a, &info.port_b}) {
+			auto &users = operand_to_users[*op_insig];
+			users.insert(cell);
+			if (users.size() > 1)
+				any_shared_operands = true;
+		}
 	}
 
-	for (auto &muxed_op : muxed_operands)
-		if (muxed_op.sign != muxed_operands[0].sign)
-			muxed_op = ExtSigSpec(module->Neg(NEW_ID, muxed_op.sig, muxed_op.is_signed));
+	void unindex_operator(RTLIL::Cell *cell)
+	{
+		auto it = op_index.find(cell);
+		if (it == op_index.end())
+			return;
+
+		for (auto op_insig : {&it->second.port_a, &it->second.port_b}) {
+			auto users = operand_to_users.find(*op_insig);
+			if (users == operand_to_users.end())
+				continue;
+			users->second.erase(cell);
+			if (users->second.empty())
+				operand_to_users.erase(users);
+		}
 
-	RTLIL::SigSpec mux_y = mux->getPort(ID::Y);
-	RTLIL::SigSpec mux_a = mux->getPort(ID::A);
-	RTLIL::SigSpec mux_b = mux->getPort(ID::B);
-	RTLIL::SigSpec mux_s = mux->getPort(ID(S));
+		op_index.erase(it);
+	}
 
-	RTLIL::SigSpec shared_pmux_a = RTLIL::Const(RTLIL::State::Sx, max_width);
-	RTLIL::SigSpec shared_pmux_b;
-	RTLIL::SigSpec shared_pmux_s;
+	bool mergeable(RTLIL::Cell *a, RTLIL::Cell *b) const
+	{
+		return op_index.at(a).merge_type == op_index.at(b).merge_type;
+	}
 
-	int conn_width = ports[0].sig.size();
-	int conn_offset = ports[0].mux_port_offset;
+	void merge_operators(RTLIL::Cell *mux, const std::vector<OpMuxConn> &ports, const ExtSigSpec &operand)
+	{
+		std::vector<ExtSigSpec> muxed_operands;
+		int max_width = 0;
+		for (const auto& p : ports) {
+			auto &info = op_index.at(p.op);
 
-	shared_op->setPort(ID::Y, shared_op->getPort(ID::Y).extract(0, conn_width));
+			RTLIL::IdString muxed_port_name = ID::A;
+			if (info.port_a == operand)
+				muxed_port_name = ID::B;
 
-	if (mux->type == ID($pmux)) {
-		shared_pmux_s = RTLIL::SigSpec();
+			auto operand = info.port(muxed_port_name);
+			if (operand.sig.size() > max_width)
+				max_width = operand.sig.size();
 
-		for (const auto &p : ports) {
-			shared_pmux_s.append(mux_s[p.mux_port_id]);
-			mux_b.replace(p.mux_port_id * mux_a.size() + conn_offset, shared_op->getPort(ID::Y));
+			muxed_operands.push_back(operand);
 		}
-	} else {
-		shared_pmux_s = RTLIL::SigSpec{mux_s, module->Not(NEW_ID, mux_s)};
-		mux_a.replace(conn_offset, shared_op->getPort(ID::Y));
-		mux_b.replace(conn_offset, shared_op->getPort(ID::Y));
-	}
 
-	mux->setPort(ID::A, mux_a);
-	mux->setPort(ID::B, mux_b);
-	mux->setPort(ID::Y, mux_y);
-	mux->setPort(ID(S), mux_s);
+		auto shared_op = ports[0].op;
+		bool shared_is_port_a = op_index.at(shared_op).port_a == operand;
 
-	for (const auto &op : muxed_operands)
-		shared_pmux_b.append(op.sig);
+		if (std::any_of(muxed_operands.begin(), muxed_operands.end(), [&](ExtSigSpec &op) { return op.sign != muxed_operands[0].sign; }))
+			max_width = std::max(max_width, shared_op->getParam(ID(Y_WIDTH)).as_int());
 
-	auto mux_to_oper = module->Pmux(NEW_ID, shared_pmux_a, shared_pmux_b, shared_pmux_s);
 
-	if (shared_op->type.in(ID($alu))) {
-		RTLIL::SigSpec alu_x = shared_op->getPort(ID(X));
-		RTLIL::SigSpec alu_co = shared_op->getPort(ID(CO));
+		for (auto &operand : muxed_operands)
+			operand.sig.extend_u0(max_width, operand.is_signed);
 
-		shared_op->setPort(ID(X), alu_x.extract(0, conn_width));
-		shared_op->setPort(ID(CO), alu_co.extract(0, conn_width));
-	}
+		for (const auto& p : ports) {
+			auto op = p.op;
+			if (op == shared_op)
+				continue;
+			unindex_operator(op);
+			module->remove(op);
+		}
 
-	bool is_fine = shared_op->type.in(FINE_BITWISE_OPS);
+		for (auto &muxed_op : muxed_operands)
+			if (muxed_op.sign != muxed_operands[0].sign)
+				muxed_op = ExtSigSpec(module->Neg(NEW_ID, muxed_op.sig, muxed_op.is_signed));
 
-	if (!is_fine)
-		shared_op->setParam(ID(Y_WIDTH), conn_width);
+		RTLIL::SigSpec mux_y = mux->getPort(ID::Y);
+		RTLIL::SigSpec mux_a = mux->getPort(ID::A);
+		RTLIL::SigSpec mux_b = mux->getPort(ID::B);
+		RTLIL::SigSpec mux_s = mux->getPort(ID(S));
 
-	if (decode_port(shared_op, ID::A, &assign_map) == operand) {
-		shared_op->setPort(ID::B, mux_to_oper);
-		if (!is_fine)
-			shared_op->setParam(ID(B_WIDTH), max_width);
-	} else {
-		shared_op->setPort(ID::A, mux_to_oper);
-		if (!is_fine)
-			shared_op->setParam(ID(A_WIDTH), max_width);
-	}
-}
+		RTLIL::SigSpec shared_pmux_a = RTLIL::Const(RTLIL::State::Sx, max_width);
+		RTLIL::SigSpec shared_pmux_b;
+		RTLIL::SigSpec shared_pmux_s;
 
-typedef struct {
-	RTLIL::Cell *mux;
-	std::vector<OpMuxConn> ports;
-	ExtSigSpec shared_operand;
-} merged_op_t;
+		int conn_width = ports[0].sig.size();
+		int conn_offset = ports[0].mux_port_offset;
 
+		shared_op->setPort(ID::Y, shared_op->getPort(ID::Y).extract(0, conn_width));
 
-template <typename T> void remove_val(std::vector<T> &v, const std::vector<T> &vals)
-{
-	auto val_iter = vals.rbegin();
-	for (auto i = v.rbegin(); i != v.rend(); ++i)
-		if ((val_iter != vals.rend()) && (*i == *val_iter)) {
-			v.erase(i.base() - 1);
-			++val_iter;
+		if (mux->type == ID($pmux)) {
+			shared_pmux_s = RTLIL::SigSpec();
+
+			for (const auto &p : ports) {
+				shared_pmux_s.append(mux_s[p.mux_port_id]);
+				mux_b.replace(p.mux_port_id * mux_a.size() + conn_offset, shared_op->getPort(ID::Y));
+			}
+		} else {
+			shared_pmux_s = RTLIL::SigSpec{mux_s, module->Not(NEW_ID, mux_s)};
+			mux_a.replace(conn_offset, shared_op->getPort(ID::Y));
+			mux_b.replace(conn_offset, shared_op->getPort(ID::Y));
 		}
-}
 
-void check_muxed_operands(std::vector<const OpMuxConn *> &ports, const ExtSigSpec &shared_operand)
-{
-	auto it = ports.begin();
-	ExtSigSpec seed;
+		mux->setPort(ID::A, mux_a);
+		mux->setPort(ID::B, mux_b);
+		mux->setPort(ID::Y, mux_y);
+		mux->setPort(ID(S), mux_s);
 
-	while (it != ports.end()) {
-		auto p = *it;
-		auto op = p->op;
+		for (const auto &op : muxed_operands)
+			shared_pmux_b.append(op.sig);
 
-		RTLIL::IdString muxed_port_name = ID::A;
-		if (decode_port(op, ID::A, &assign_map) == shared_operand) {
-			muxed_port_name = ID::B;
+		auto mux_to_oper = module->Pmux(NEW_ID, shared_pmux_a, shared_pmux_b, shared_pmux_s);
+
+		if (shared_op->type.in(ID($alu))) {
+			RTLIL::SigSpec alu_x = shared_op->getPort(ID(X));
+			RTLIL::SigSpec alu_co = shared_op->getPort(ID(CO));
+
+			shared_op->setPort(ID(X), alu_x.extract(0, conn_width));
+			shared_op->setPort(ID(CO), alu_co.extract(0, conn_width));
 		}
 
-		auto operand = decode_port(op, muxed_port_name, &assign_map);
+		bool is_fine = shared_op->type.in(FINE_BITWISE_OPS);
 
-		if (seed.empty())
-			seed = operand;
+		if (!is_fine)
+			shared_op->setParam(ID(Y_WIDTH), conn_width);
 
-		if (operand.is_signed != seed.is_signed) {
-			ports.erase(it);
+		if (shared_is_port_a) {
+			shared_op->setPort(ID::B, mux_to_oper);
+			if (!is_fine)
+				shared_op->setParam(ID(B_WIDTH), max_width);
 		} else {
-			++it;
+			shared_op->setPort(ID::A, mux_to_oper);
+			if (!is_fine)
+				shared_op->setParam(ID(A_WIDTH), max_width);
 		}
-	}
-}
 
-ExtSigSpec find_shared_operand(const OpMuxConn* seed, std::vector<const OpMuxConn *> &ports, const std::map<ExtSigSpec, std::set<RTLIL::Cell *>> &operand_to_users)
-{
-	std::set<RTLIL::Cell *> ops_using_operand;
-	std::set<RTLIL::Cell *> ops_set;
-	for(const auto& p: ports)
-		ops_set.insert(p->op);
+		unindex_operator(shared_op);
+		index_operator(shared_op);
+	}
 
-	ExtSigSpec oper;
+	void check_muxed_operands(std::vector<const OpMuxConn *> &ports, const ExtSigSpec &shared_operand) const
+	{
+		auto it = ports.begin();
+		ExtSigSpec seed;
 
-	auto op_a = seed->op;
+		while (it != ports.end()) {
+			auto p = *it;
+			auto &info = op_index.at(p->op);
 
-	for (RTLIL::IdString port_name : {ID::A, ID::B}) {
-		oper = decode_port(op_a, port_name, &assign_map);
-		auto operand_users = operand_to_users.at(oper);
+			RTLIL::IdString muxed_port_name = ID::A;
+			if (info.port_a == shared_operand) {
+				muxed_port_name = ID::B;
+			}
 
-		if (operand_users.size() == 1)
-			continue;
+			auto &operand = info.port(muxed_port_name);
 
-		ops_using_operand.clear();
-		for (auto mux_ops: ops_set)
-			if (operand_users.count(mux_ops))
-				ops_using_operand.insert(mux_ops);
+			if (seed.empty())
+				seed = operand;
 
-		if (ops_using_operand.size() > 1) {
-			ports.erase(std::remove_if(ports.begin(), ports.end(), [&](const OpMuxConn *p) { return !ops_using_operand.count(p->op); }),
-						ports.end());
-			return oper;
+			if (operand.is_signed != seed.is_signed) {
+				it = ports.erase(it);
+			} else {
+				++it;
+			}
 		}
 	}
 
-	return ExtSigSpec();
-}
+	ExtSigSpec find_shared_operand(const OpMuxConn* seed, std::vector<const OpMuxConn *> &ports) const
+	{
+		std::set<RTLIL::Cell *> ops_using_operand;
+		std::set<RTLIL::Cell *> ops_set;
+		for(const auto& p: ports)
+			ops_set.insert(p->op);
 
-dict<RTLIL::SigSpec, OpMuxConn> find_valid_op_mux_conns(RTLIL::Module *module, dict<RTLIL::SigBit, RTLIL::SigSpec> &op_outbit_to_outsig,
-							dict<RTLIL::SigSpec, RTLIL::Cell *> outsig_to_operator,
-							dict<RTLIL::SigBit, RTLIL::SigSpec> &op_aux_to_outsig)
-{
-	dict<RTLIL::SigSpec, int> op_outsig_user_track;
-	dict<RTLIL::SigSpec, OpMuxConn> op_mux_conn_map;
-
-	std::function<void(RTLIL::SigSpec)> remove_outsig = [&](RTLIL::SigSpec outsig) {
-		for (auto op_outbit : outsig)
-			op_outbit_to_outsig.erase(op_outbit);
-
-		if (op_mux_conn_map.count(outsig))
-			op_mux_conn_map.erase(outsig);
-	};
-
-	std::function<void(RTLIL::SigBit)> remove_outsig_from_aux_bit = [&](RTLIL::SigBit auxbit) {
-		auto aux_outsig = op_aux_to_outsig.at(auxbit);
-		auto op = outsig_to_operator.at(aux_outsig);
-		auto op_outsig = assign_map(op->getPort(ID::Y));
-		remove_outsig(op_outsig);
-
-		for (auto aux_outbit : aux_outsig)
-			op_aux_to_outsig.erase(aux_outbit);
-	};
-
-	std::function<void(RTLIL::Cell *)> find_op_mux_conns = [&](RTLIL::Cell *mux) {
-		RTLIL::SigSpec sig;
-		int mux_port_size;
-
-		if (mux->type.in(ID($mux), ID($_MUX_))) {
-			mux_port_size = mux->getPort(ID::A).size();
-			sig = RTLIL::SigSpec{mux->getPort(ID::B), mux->getPort(ID::A)};
-		} else {
-			mux_port_size = mux->getPort(ID::A).size();
-			sig = mux->getPort(ID::B);
-		}
+		ExtSigSpec oper;
 
-		auto mux_insig = assign_map(sig);
+		auto &info = op_index.at(seed->op);
 
-		for (int i = 0; i < mux_insig.size(); ++i) {
-			if (op_aux_to_outsig.count(mux_insig[i])) {
-				remove_outsig_from_aux_bit(mux_insig[i]);
-				continue;
-			}
+		for (RTLIL::IdString port_name : {ID::A, ID::B}) {
+			oper = info.port(port_name);
+			auto &operand_users = operand_to_users.at(oper);
 
-			if (!op_outbit_to_outsig.count(mux_insig[i]))
+			if (operand_users.size() == 1)
 				continue;
 
-			auto op_outsig = op_outbit_to_outsig.at(mux_insig[i]);
+			ops_using_operand.clear();
+			for (auto mux_ops: ops_set)
+				if (operand_users.count(mux_ops))
+					ops_using_operand.insert(mux_ops);
 
-			if (op_mux_conn_map.count(op_outsig)) {
-				remove_outsig(op_outsig);
-				continue;
+			if (ops_using_operand.size() > 1) {
+				ports.erase(std::remove_if(ports.begin(), ports.end(), [&](const OpMuxConn *p) { return !ops_using_operand.count(p->op); }),
+							ports.end());
+				return oper;
 			}
+		}
+
+		return ExtSigSpec();
+	}
 
-			int mux_port_id = i / mux_port_size;
-			int mux_port_offset = i % mux_port_size;
+	dict<RTLIL::SigSpec, OpMuxConn> find_valid_op_mux_conns()
+	{
+		dict<RTLIL::SigSpec, int> op_outsig_user_track;
+		dict<RTLIL::SigSpec, OpMuxConn> op_mux_conn_map;
+
+		std::function<void(RTLIL::SigSpec)> remove_outsig = [&](RTLIL::SigSpec outsig) {
+			for (auto op_outbit : outsig)
+				op_outbit_to_outsig.erase(op_outbit);
+
+			if (op_mux_conn_map.count(outsig))
+				op_mux_conn_map.erase(outsig);
+		};
+
+		std::function<void(RTLIL::SigBit)> remove_outsig_from_aux_bit = [&](RTLIL::SigBit auxbit) {
+			auto aux_outsig = op_aux_to_outsig.at(auxbit);
+			auto op = outsig_to_operator.at(aux_outsig);
+			auto op_outsig = assign_map(op->getPort(ID::Y));
+			remove_outsig(op_outsig);
+
+			for (auto aux_outbit : aux_outsig)
+				op_aux_to_outsig.erase(aux_outbit);
+		};
+
+		std::function<void(RTLIL::Cell *)> find_op_mux_conns = [&](RTLIL::Cell *mux) {
+			RTLIL::SigSpec sig;
+			int mux_port_size;
+
+			if (mux->type.in(ID($mux), ID($_MUX_))) {
+				mux_port_size = mux->getPort(ID::A).size();
+				sig = RTLIL::SigSpec{mux->getPort(ID::B), mux->getPort(ID::A)};
+			} else {
+				mux_port_size = mux->getPort(ID::A).size();
+				sig = mux->getPort(ID::B);
+			}
 
-			int op_outsig_offset;
-			for (op_outsig_offset = 0; op_outsig[op_outsig_offset] != mux_insig[i]; ++op_outsig_offset)
-				;
+			auto mux_insig = assign_map(sig);
+
+			for (int i = 0; i < mux_insig.size(); ++i) {
+				if (op_aux_to_outsig.count(mux_insig[i])) {
+					remove_outsig_from_aux_bit(mux_insig[i]);
+					continue;
+				}
 
-			int j = op_outsig_offset;
-			do {
 				if (!op_outbit_to_outsig.count(mux_insig[i]))
-					break;
+					continue;
 
-				if (op_outbit_to_outsig.at(mux_insig[i]) != op_outsig)
-					break;
+				auto op_outsig = op_outbit_to_outsig.at(mux_insig[i]);
 
-				++i;
-				++j;
-			} while ((i / mux_port_size == mux_port_id) && (j < op_outsig.size()));
+				if (op_mux_conn_map.count(op_outsig)) {
+					remove_outsig(op_outsig);
+					continue;
+				}
 
-			int op_conn_width = j - op_outsig_offset;
-			OpMuxConn inp = {
-				op_outsig.extract(op_outsig_offset, op_conn_width),
-				mux,
-				outsig_to_operator.at(op_outsig),
-				mux_port_id,
-				mux_port_offset,
-				op_outsig_offset,
-			};
+				int mux_port_id = i / mux_port_size;
+				int mux_port_offset = i % mux_port_size;
 
-			op_mux_conn_map[op_outsig] = inp;
+				int op_outsig_offset;
+				for (op_outsig_offset = 0; op_outsig[op_outsig_offset] != mux_insig[i]; ++op_outsig_offset)
+					;
 
-			--i;
-		}
-	};
+				int j = op_outsig_offset;
+				do {
+					if (!op_outbit_to_outsig.count(mux_insig[i]))
+						break;
 
-	std::function<void(RTLIL::SigSpec)> remove_connected_ops = [&](RTLIL::SigSpec sig) {
-		auto mux_insig = assign_map(sig);
-		for (auto outbit : mux_insig) {
-			if (op_aux_to_outsig.count(outbit)) {
-				remove_outsig_from_aux_bit(outbit);
-				continue;
+					if (op_outbit_to_outsig.at(mux_insig[i]) != op_outsig)
+						break;
+
+					++i;
+					++j;
+				} while ((i / mux_port_size == mux_port_id) && (j < op_outsig.size()));
+
+				int op_conn_width = j - op_outsig_offset;
+				OpMuxConn inp = {
+					op_outsig.extract(op_outsig_offset, op_conn_width),
+					mux,
+					outsig_to_operator.at(op_outsig),
+					mux_port_id,
+					mux_port_offset,
+					op_outsig_offset,
+				};
+
+				op_mux_conn_map[op_outsig] = inp;
+
+				--i;
 			}
+		};
 
-			if (!op_outbit_to_outsig.count(outbit))
-				continue;
+		std::function<void(RTLIL::SigSpec)> remove_connected_ops = [&](RTLIL::SigSpec sig) {
+			auto mux_insig = assign_map(sig);
+			for (auto outbit : mux_insig) {
+				if (op_aux_to_outsig.count(outbit)) {
+					remove_outsig_from_aux_bit(outbit);
+					continue;
+				}
 
-			remove_outsig(op_outbit_to_outsig.at(outbit));
-		}
-	};
+				if (!op_outbit_to_outsig.count(outbit))
+					continue;
 
-	for (auto cell : module->cells()) {
-		if (cell->type.in(ID($mux), ID($_MUX_), ID($pmux))) {
-			remove_connected_ops(cell->getPort(ID(S)));
-			find_op_mux_conns(cell);
-		} else {
-			for (auto &conn : cell->connections())
-				if (cell->input(conn.first))
-					remove_connected_ops(conn.second);
+				remove_outsig(op_outbit_to_outsig.at(outbit));
+			}
+		};
+
+		for (auto cell : module->cells()) {
+			if (cell->type.in(ID($mux), ID($_MUX_), ID($pmux))) {
+				remove_connected_ops(cell->getPort(ID(S)));
+				find_op_mux_conns(cell);
+			} else {
+				for (auto &conn : cell->connections())
+					if (cell->input(conn.first))
+						remove_connected_ops(conn.second);
+			}
 		}
-	}
 
-	for (auto w : module->wires()) {
-		if (!w->port_output)
-			continue;
+		for (auto w : module->wires()) {
+			if (!w->port_output)
+				continue;
 
-		remove_connected_ops(w);
-	}
+			remove_connected_ops(w);
+		}
 
-	return op_mux_conn_map;
-}
+		return op_mux_conn_map;
+	}
 
-struct OptSharePass : public Pass {
-	OptSharePass() : Pass("opt_share", "merge mutually exclusive cells of the same type that share an input signal") {}
-	void help() YS_OVERRIDE
+	// Only reads the operator index and the connections of the given mux, so
+	// it is safe to run concurrently for different muxes.
+	void find_mergers(RTLIL::Cell *cell, std::vector<std::set<OpMuxConn>> &mux_port_conns, std::vector<merged_op_t> &merged_ops) const
 	{
-		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
-		log("\n");
-		log("    opt_share [selection]\n");
-		log("\n");
+		const OpMuxConn *seed = NULL;
 
-		log("This pass identifies mutually exclusive cells of the same type that:\n");
-		log("    (a) share an input signal,\n");
-		log("    (b) drive the same $mux, $_MUX_, or $pmux multiplexing cell,\n");
-		log("\n");
-		log("allowing the cell to be merged and the multiplexer to be moved from\n");
-		log("multiplexing its output to multiplexing the non-shared input signals.\n");
-		log("\n");
-	}
-	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
-	{
+		// Look through the bits of the $mux inputs and see which of them are connected to the operator
+		// results. Operator results can be concatenated with other signals before led to the $mux.
+		while (true) {
 
-		log_header(design, "Executing OPT_SHARE pass.\n");
+			// Remove either the merged ports from the last iteration or the seed that failed to yield a merger
+			if (seed != NULL) {
+				mux_port_conns[seed->mux_port_id].erase(*seed);
+				seed = NULL;
+			}
 
-		extra_args(args, 1, design);
-		for (auto module : design->selected_modules()) {
-			assign_map.clear();
-			assign_map.set(module);
-
-			std::map<ExtSigSpec, std::set<RTLIL::Cell *>> operand_to_users;
-			dict<RTLIL::SigSpec, RTLIL::Cell *> outsig_to_operator;
-			dict<RTLIL::SigBit, RTLIL::SigSpec> op_outbit_to_outsig;
-			dict<RTLIL::SigBit, RTLIL::SigSpec> op_aux_to_outsig;
-			bool any_shared_operands = false;
-			std::vector<ExtSigSpec> op_insigs;
-
-			for (auto cell : module->cells()) {
-				if (!cell_supported(cell))
+			// For a new merger, find the seed op connection that starts at lowest port offset among port connections
+			for (auto &port_conns : mux_port_conns) {
+				if (!port_conns.size())
 					continue;
 
-				if (cell->type == ID($alu)) {
-					for (RTLIL::IdString port_name : {ID(X), ID(CO)}) {
-						auto mux_insig = assign_map(cell->getPort(port_name));
-						outsig_to_operator[mux_insig] = cell;
-						for (auto outbit : mux_insig)
-							op_aux_to_outsig[outbit] = mux_insig;
-					}
-				}
+				const OpMuxConn *next_p = &(*port_conns.begin());
 
-				auto mux_insig = assign_map(cell->getPort(ID::Y));
-				outsig_to_operator[mux_insig] = cell;
-				for (auto outbit : mux_insig)
-					op_outbit_to_outsig[outbit] = mux_insig;
-
-				for (RTLIL::IdString port_name : {ID::A, ID::B}) {
-					auto op_insig = decode_port(cell, port_name, &assign_map);
-					op_insigs.push_back(op_insig);
-					operand_to_users[op_insig].insert(cell);
-					if (operand_to_users[op_insig].size() > 1)
-						any_shared_operands = true;
-				}
+				if ((seed == NULL) || (seed->mux_port_offset > next_p->mux_port_offset))
+					seed = next_p;
 			}
 
-			if (!any_shared_operands)
-				continue;
-
-			// Operator outputs need to be exclusively connected to the $mux inputs in order to be mergeable. Hence we count to
-			// how many points are operator output bits connected.
-			dict<RTLIL::SigSpec, OpMuxConn> op_mux_conn_map =
-			  find_valid_op_mux_conns(module, op_outbit_to_outsig, outsig_to_operator, op_aux_to_outsig);
-
-			// Group op connections connected to same ports of the same $mux. Sort them in ascending order of their port offset
-			dict<RTLIL::Cell*, std::vector<std::set<OpMuxConn>>> mux_port_op_conns;
-			for (auto& val: op_mux_conn_map) {
-				OpMuxConn p = val.second;
-				auto& mux_port_conns = mux_port_op_conns[p.mux];
-
-				if (mux_port_conns.size() == 0) {
-					int mux_port_num;
+			// Cannot find the seed -> nothing to do for this $mux anymore
+			if (seed == NULL)
+				break;
 
-					if (p.mux->type.in(ID($mux), ID($_MUX_)))
-						mux_port_num = 2;
-					else
-						mux_port_num = p.mux->getPort(ID(S)).size();
+			// Find all other op connections that start from the same port offset, and whose ops can be merged with the seed op
+			std::vector<const OpMuxConn *> mergeable_conns;
+			for (auto &port_conns : mux_port_conns) {
+				if (!port_conns.size())
+					continue;
 
-					mux_port_conns.resize(mux_port_num);
-				}
+				const OpMuxConn *next_p = &(*port_conns.begin());
 
-				mux_port_conns[p.mux_port_id].insert(p);
+				if ((next_p->op_outsig_offset == seed->op_outsig_offset) &&
+				    (next_p->mux_port_offset == seed->mux_port_offset) && mergeable(next_p->op, seed->op) &&
+				    next_p->sig.size() == seed->sig.size())
+					mergeable_conns.push_back(next_p);
 			}
 
-			std::vector<merged_op_t> merged_ops;
-			for (auto& val: mux_port_op_conns) {
+			// We need at least two mergeable connections for the merger
+			if (mergeable_conns.size() < 2)
+				continue;
 
-				RTLIL::Cell* cell = val.first;
-				auto &mux_port_conns = val.second;
+			// Filter mergeable connections whose ops share an operand with seed connection's op
+			auto shared_operand = find_shared_operand(seed, mergeable_conns);
 
-				const OpMuxConn *seed = NULL;
+			if (shared_operand.empty())
+				continue;
 
-				// Look through the bits of the $mux inputs and see which of them are connected to the operator
-				// results. Operator results can be concatenated with other signals before led to the $mux.
-				while (true) {
+			check_muxed_operands(mergeable_conns, shared_operand);
 
-					// Remove either the merged ports from the last iteration or the seed that failed to yield a merger
-					if (seed != NULL) {
-						mux_port_conns[seed->mux_port_id].erase(*seed);
-						seed = NULL;
-					}
+			if (mergeable_conns.size() < 2)
+				continue;
 
-					// For a new merger, find the seed op connection that starts at lowest port offset among port connections
-					for (auto &port_conns : mux_port_conns) {
-						if (!port_conns.size())
-							continue;
+			// Remember the combination for the merger
+			std::vector<OpMuxConn> merged_ports;
+			for (auto p : mergeable_conns) {
+				merged_ports.push_back(*p);
+				mux_port_conns[p->mux_port_id].erase(*p);
+			}
 
-						const OpMuxConn *next_p = &(*port_conns.begin());
+			seed = NULL;
 
-						if ((seed == NULL) || (seed->mux_port_offset > next_p->mux_port_offset))
-							seed = next_p;
-					}
+			merged_ops.push_back(merged_op_t{cell, merged_ports, shared_operand});
+		}
+	}
 
-					// Cannot find the seed -> nothing to do for this $mux anymore
-					if (seed == NULL)
-						break;
+	OptShareWorker(RTLIL::Module *module) : module(module), assign_map(module)
+	{
+		for (auto cell : module->cells()) {
+			if (!cell_supported(cell))
+				continue;
 
-					// Find all other op connections that start from the same port offset, and whose ops can be merged with the seed op
-					std::vector<const OpMuxConn *> mergeable_conns;
-					for (auto &port_conns : mux_port_conns) {
-						if (!port_conns.size())
-							continue;
+			if (cell->type == ID($alu)) {
+				for (RTLIL::IdString port_name : {ID(X), ID(CO)}) {
+					auto mux_insig = assign_map(cell->getPort(port_name));
+					outsig_to_operator[mux_insig] = cell;
+					for (auto outbit : mux_insig)
+						op_aux_to_outsig[outbit] = mux_insig;
+				}
+			}
 
-						const OpMuxConn *next_p = &(*port_conns.begin());
+			auto mux_insig = assign_map(cell->getPort(ID::Y));
+			outsig_to_operator[mux_insig] = cell;
+			for (auto outbit : mux_insig)
+				op_outbit_to_outsig[outbit] = mux_insig;
 
-						if ((next_p->op_outsig_offset == seed->op_outsig_offset) &&
-						    (next_p->mux_port_offset == seed->mux_port_offset) && mergeable(next_p->op, seed->op) &&
-						    next_p->sig.size() == seed->sig.size())
-							mergeable_conns.push_back(next_p);
-					}
+			index_operator(cell);
+		}
 
-					// We need at least two mergeable connections for the merger
-					if (mergeable_conns.size() < 2)
-						continue;
+		if (!any_shared_operands)
+			return;
 
-					// Filter mergeable connections whose ops share an operand with seed connection's op
-					auto shared_operand = find_shared_operand(seed, mergeable_conns, operand_to_users);
+		// Operator outputs need to be exclusively connected to the $mux inputs in order to be mergeable. Hence we count to
+		// how many points are operator output bits connected.
+		dict<RTLIL::SigSpec, OpMuxConn> op_mux_conn_map = find_valid_op_mux_conns();
 
-					if (shared_operand.empty())
-						continue;
+		// Group op connections connected to same ports of the same $mux. Sort them in ascending order of their port offset
+		dict<RTLIL::Cell*, std::vector<std::set<OpMuxConn>>> mux_port_op_conns;
+		for (auto& val: op_mux_conn_map) {
+			OpMuxConn p = val.second;
+			auto& mux_port_conns = mux_port_op_conns[p.mux];
 
-					check_muxed_operands(mergeable_conns, shared_operand);
+			if (mux_port_conns.size() == 0) {
+				int mux_port_num;
 
-					if (mergeable_conns.size() < 2)
-						continue;
+				if (p.mux->type.in(ID($mux), ID($_MUX_)))
+					mux_port_num = 2;
+				else
+					mux_port_num = p.mux->getPort(ID(S)).size();
 
-					// Remember the combination for the merger
-					std::vector<OpMuxConn> merged_ports;
-					for (auto p : mergeable_conns) {
-						merged_ports.push_back(*p);
-						mux_port_conns[p->mux_port_id].erase(*p);
-					}
+				mux_port_conns.resize(mux_port_num);
+			}
 
-					seed = NULL;
+			mux_port_conns[p.mux_port_id].insert(p);
+		}
 
-					merged_ops.push_back(merged_op_t{cell, merged_ports, shared_operand});
+		// Every operator drives at most one $mux, so the muxes do not share any
+		// connections and are searched for mergers concurrently, in chunks of
+		// consecutive muxes. The mergers are applied in mux order afterwards.
+		std::vector<std::pair<RTLIL::Cell*, std::vector<std::set<OpMuxConn>>>*> muxes;
+		for (auto &val : mux_port_op_conns)
+			muxes.push_back(&val);
 
-					design->scratchpad_set_bool("opt.did_something", true);
-				}
+		int num_chunks = std::min(GetSize(muxes), 4 * std::max(yosys_threads, 1));
+		std::vector<std::vector<merged_op_t>> chunk_merged_ops(num_chunks);
 
-			}
+		parallel_for(num_chunks, [&](int i) {
+			int begin = int(int64_t(GetSize(muxes)) * i / num_chunks);
+			int end = int(int64_t(GetSize(muxes)) * (i + 1) / num_chunks);
+			for (int k = begin; k < end; k++)
+				find_mergers(muxes[k]->first, muxes[k]->second, chunk_merged_ops[i]);
+		});
 
+		for (auto &merged_ops : chunk_merged_ops)
 			for (auto &shared : merged_ops) {
 				log("    Found cells that share an operand and can be merged by moving the %s %s in front "
 				    "of "
@@ -647,9 +679,52 @@ struct OptSharePass : public Pass {
 					log("        %s\n", log_id(op.op));
 				log("\n");
 
-				merge_operators(module, shared.mux, shared.ports, shared.shared_operand);
+				merge_operators(shared.mux, shared.ports, shared.shared_operand);
+				merge_count++;
 			}
-		}
+	}
+};
+
+struct OptSharePass : public ModulePass {
+	OptSharePass() : ModulePass("opt_share", "merge mutually exclusive cells of the same type that share an input signal") { module_changes_tracked(); }
+	void help() YS_OVERRIDE
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    opt_share [selection]\n");
+		log("\n");
+
+		log("This pass identifies mutually exclusive cells of the same type that:\n");
+		log("    (a) share an input signal,\n");
+		log("    (b) drive the same $mux, $_MUX_, or $pmux multiplexing cell,\n");
+		log("\n");
+		log("allowing the cell to be merged and the multiplexer to be moved from\n");
+		log("multiplexing its output to multiplexing the non-shared input signals.\n");
+		log("\n");
+		log("The modules, and the multiplexers within a module, are searched concurrently\n");
+		log("when yosys is run with multiple threads (yosys -j).\n");
+		log("\n");
+	}
+	std::atomic<int> total_count;
+
+	void execute_module(RTLIL::Module *module) YS_OVERRIDE
+	{
+		OptShareWorker worker(module);
+		total_count += worker.merge_count;
+	}
+
+	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
+	{
+
+		log_header(design, "Executing OPT_SHARE pass.\n");
+
+		extra_args(args, 1, design);
+
+		total_count = 0;
+		execute_modules(design);
+
+		if (total_count)
+			design->scratchpad_set_bool("opt.did_something", true);
 	}
 
 } OptSharePass;
@@ -23,6 +23,8 @@
 #include "kernel/modtools.h"
 #include "kernel/utils.h"
 #include "kernel/macc.h"
+#include "kernel/threadpool.h"
+#include <atomic>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -33,6 +35,8 @@ typedef std::pair<RTLIL::SigSpec, RTLIL::Const> ssc_pair_t;
 struct ShareWorkerConfig
 {
 	int limit;
+	int sat_limit;
+	int num_threads;
 	bool opt_force;
 	bool opt_aggressive;
 	bool opt_fast;
@@ -348,6 +352,23 @@ struct ShareWorker
 
 	pool<RTLIL::Cell*> shareable_cells;
 
+	// the shareable cells by type, only cells of the same type can be shared
+	dict<RTLIL::IdString, pool<RTLIL::Cell*>> shareable_cells_by_type;
+
+	void add_shareable(RTLIL::Cell *cell)
+	{
+		shareable_cells.insert(cell);
+		shareable_cells_by_type[cell->type].insert(cell);
+	}
+
+	void remove_shareable(RTLIL::Cell *cell)
+	{
+		shareable_cells.erase(cell);
+		auto it = shareable_cells_by_type.find(cell->type);
+		if (it != shareable_cells_by_type.end())
+			it->second.erase(cell);
+	}
+
 	void find_shareable_cells()
 	{
 		for (auto cell : module->cells())
@@ -364,7 +385,7 @@ struct ShareWorker
 				continue;
 
 			if (config.opt_force) {
-				shareable_cells.insert(cell);
+				add_shareable(cell);
 				continue;
 			}
 
@@ -372,25 +393,25 @@ struct ShareWorker
 				if (cell->parameters.at(ID(CLK_ENABLE)).as_bool())
 					continue;
 				if (config.opt_aggressive || !modwalker.sigmap(cell->getPort(ID(ADDR))).is_fully_const())
-					shareable_cells.insert(cell);
+					add_shareable(cell);
 				continue;
 			}
 
 			if (cell->type.in(ID($mul), ID($div), ID($mod))) {
 				if (config.opt_aggressive || cell->parameters.at(ID(Y_WIDTH)).as_int() >= 4)
-					shareable_cells.insert(cell);
+					add_shareable(cell);
 				continue;
 			}
 
 			if (cell->type.in(ID($shl), ID($shr), ID($sshl), ID($sshr))) {
 				if (config.opt_aggressive || cell->parameters.at(ID(Y_WIDTH)).as_int() >= 8)
-					shareable_cells.insert(cell);
+					add_shareable(cell);
 				continue;
 			}
 
 			if (generic_ops.count(cell->type)) {
 				if (config.opt_aggressive)
-					shareable_cells.insert(cell);
+					add_shareable(cell);
 				continue;
 			}
 		}
@@ -494,7 +515,10 @@ struct ShareWorker
 	void find_shareable_partners(std::vector<RTLIL::Cell*> &results, RTLIL::Cell *cell)
 	{
 		results.clear();
-		for (auto c : shareable_cells)
+		auto it = shareable_cells_by_type.find(cell->type);
+		if (it == shareable_cells_by_type.end())
+			return;
+		for (auto c : it->second)
 			if (c != cell && is_shareable_pair(c, cell))
 				results.push_back(c);
 	}
@@ -780,18 +804,18 @@ struct ShareWorker
 		std::vector<RTLIL::SigBit> p_first_bits = p.first;
 		for (int i = 0; i < GetSize(p_first_bits); i++) {
 			RTLIL::SigBit b = p_first_bits[i];
-			RTLIL::State v = p.second.bits[i];
+			RTLIL::State v = p.second[i];
 			if (p_bits.count(b) && p_bits.at(b) != v)
 				return false;
 			p_bits[b] = v;
 		}
 
 		p.first = RTLIL::SigSpec();
-		p.second.bits.clear();
+		p.second.bits().clear();
 
 		for (auto &it : p_bits) {
 			p.first.append_bit(it.first);
-			p.second.bits.push_back(it.second);
+			p.second.bits().push_back(it.second);
 		}
 
 		return true;
@@ -814,10 +838,10 @@ struct ShareWorker
 			{
 				auto otherval = val;
 
-				if (otherval.bits[i] == State::S0)
-					otherval.bits[i] = State::S1;
-				else if (otherval.bits[i] == State::S1)
-					otherval.bits[i] = State::S0;
+				if (otherval[i] == State::S0)
+					otherval.bits()[i] = State::S1;
+				else if (otherval[i] == State::S1)
+					otherval.bits()[i] = State::S0;
 				else
 					continue;
 
@@ -827,7 +851,7 @@ struct ShareWorker
 					newsig.remove(i);
 
 					auto newval = val;
-					newval.bits.erase(newval.bits.begin() + i);
+					newval.bits().erase(newval.bits().begin() + i);
 
 					db[newsig].insert(newval);
 					db[sig].erase(otherval);
@@ -906,14 +930,14 @@ struct ShareWorker
 			if (used_in_a)
 				for (auto p : c_patterns) {
 					for (int i = 0; i < GetSize(sig_s); i++)
-						p.first.append_bit(sig_s[i]), p.second.bits.push_back(RTLIL::State::S0);
+						p.first.append_bit(sig_s[i]), p.second.bits().push_back(RTLIL::State::S0);
 					if (sort_check_activation_pattern(p))
 						activation_patterns_cache[cell].insert(p);
 				}
 
 			for (int idx : used_in_b_parts)
 				for (auto p : c_patterns) {
-					p.first.append_bit(sig_s[idx]), p.second.bits.push_back(RTLIL::State::S1);
+					p.first.append_bit(sig_s[idx]), p.second.bits().push_back(RTLIL::State::S1);
 					if (sort_check_activation_pattern(p))
 						activation_patterns_cache[cell].insert(p);
 				}
@@ -964,7 +988,7 @@ struct ShareWorker
 			for (int i = 0; i < GetSize(p_first); i++)
 				if (filter_bits.count(p_first[i]) == 0) {
 					new_p.first.append_bit(p_first[i]);
-					new_p.second.bits.push_back(p.second.bits.at(i));
+					new_p.second.bits().push_back(p.second[i]);
 				}
 
 			out.insert(new_p);
@@ -989,6 +1013,244 @@ struct ShareWorker
 	}
 
 
+	// ---------------------------------------------------------
+	// Checking if the activation patterns of two cells overlap
+	// ---------------------------------------------------------
+
+	// The check for one pair of cells. It is prepared on the main thread, the
+	// SAT problem can then be solved on a worker thread, and the result is
+	// used on the main thread again.
+	struct PairCheck
+	{
+		enum mode_t { CHECK_NONE, CHECK_EXCLUSIVE, CHECK_OVERLAP, CHECK_NO_BUDGET, CHECK_SAT };
+
+		RTLIL::Cell *other_cell = nullptr;
+		LogCapture patterns_log;
+		pool<ssc_pair_t> other_patterns;
+		std::set<RTLIL::SigBit> forbidden_controls;
+		pool<ssc_pair_t> filtered_cell_patterns, filtered_other_patterns;
+		RTLIL::SigSpec all_ctrl_signals, cone_signals;
+		mode_t mode = CHECK_NONE;
+		ssc_pair_t overlap;
+
+		std::vector<std::pair<RTLIL::SigBit, RTLIL::SigBit>> sat_exclusive_bits;
+		bool cell_never_active = false, other_never_active = false, can_share = false;
+		int sat_cells = 0, sat_variables = 0, sat_clauses = 0;
+		std::vector<bool> sat_model_values;
+	};
+
+	// control bits that are not driven by logic the SAT problem would contain
+	bool is_free_ctrl_bit(RTLIL::SigBit bit)
+	{
+		if (bit.wire == nullptr)
+			return false;
+		pool<ModWalker::PortBit> portbits;
+		modwalker.get_drivers(portbits, RTLIL::SigSpec(bit));
+		for (auto &pbit : portbits)
+			if (cone_ct.cell_known(pbit.cell->type))
+				return false;
+		return true;
+	}
+
+	// Decides the pair without SAT if possible: if every activation pattern
+	// of one cell contradicts every pattern of the other cell, the cells are
+	// never active at the same time. If two patterns only assign free control
+	// signals and agree on them, both cells are active for this assignment.
+	void classify_pair_check(PairCheck &check)
+	{
+		bool all_contradict = true;
+
+		for (auto &p1 : check.filtered_cell_patterns)
+		for (auto &p2 : check.filtered_other_patterns)
+		{
+			dict<RTLIL::SigBit, RTLIL::State> assignment;
+			bool contradict = false;
+
+			for (int i = 0; i < GetSize(p1.first); i++)
+				assignment[p1.first[i]] = p1.second[i];
+			for (int i = 0; i < GetSize(p2.first) && !contradict; i++) {
+				auto it = assignment.find(p2.first[i]);
+				if (it != assignment.end() && it->second != p2.second[i])
+					contradict = true;
+				assignment[p2.first[i]] = p2.second[i];
+			}
+
+			if (contradict)
+				continue;
+			all_contradict = false;
+
+			bool all_free = true;
+			for (auto &it : assignment)
+				if (!is_free_ctrl_bit(it.first))
+					all_free = false;
+			for (auto &it : exclusive_ctrls)
+				if (assignment.count(it.first) && assignment.count(it.second) &&
+						assignment.at(it.first) == State::S1 && assignment.at(it.second) == State::S1)
+					all_free = false;
+
+			if (all_free) {
+				check.mode = PairCheck::CHECK_OVERLAP;
+				assignment.sort();
+				for (auto &it : assignment) {
+					check.overlap.first.append(it.first);
+					check.overlap.second.bits().push_back(it.second);
+				}
+				return;
+			}
+		}
+
+		check.mode = all_contradict ? PairCheck::CHECK_EXCLUSIVE : PairCheck::CHECK_SAT;
+	}
+
+	void prepare_pair_check(PairCheck &check, RTLIL::Cell *cell, const pool<ssc_pair_t> &cell_patterns,
+			const RTLIL::SigSpec &cell_signals, RTLIL::Cell *other_cell, int &sat_budget)
+	{
+		check.other_cell = other_cell;
+
+		log_capture_begin(&check.patterns_log);
+		check.other_patterns = find_cell_activation_patterns(other_cell, "      ");
+		log_capture_end();
+
+		if (check.other_patterns.empty() || check.other_patterns.count(ssc_pair_t()))
+			return;
+
+		const pool<RTLIL::SigBit> &cell_forbidden_controls = find_forbidden_controls(cell);
+		const pool<RTLIL::SigBit> &other_cell_forbidden_controls = find_forbidden_controls(other_cell);
+		check.forbidden_controls.insert(cell_forbidden_controls.begin(), cell_forbidden_controls.end());
+		check.forbidden_controls.insert(other_cell_forbidden_controls.begin(), other_cell_forbidden_controls.end());
+
+		filter_activation_patterns(check.filtered_cell_patterns, cell_patterns, check.forbidden_controls);
+		filter_activation_patterns(check.filtered_other_patterns, check.other_patterns, check.forbidden_controls);
+
+		optimize_activation_patterns(check.filtered_cell_patterns);
+		optimize_activation_patterns(check.filtered_other_patterns);
+
+		for (auto &p : check.filtered_cell_patterns)
+			check.all_ctrl_signals.append(p.first);
+		for (auto &p : check.filtered_other_patterns)
+			check.all_ctrl_signals.append(p.first);
+		check.all_ctrl_signals.sort_and_unify();
+
+		check.cone_signals = cell_signals;
+		check.cone_signals.append(bits_from_activation_patterns(check.other_patterns));
+
+		classify_pair_check(check);
+
+		if (check.mode == PairCheck::CHECK_SAT) {
+			if (sat_budget == 0)
+				check.mode = PairCheck::CHECK_NO_BUDGET;
+			else if (sat_budget > 0)
+				sat_budget--;
+		}
+	}
+
+	// solves the SAT problem for a check, only reads the module and the worker
+	void run_sat_check(PairCheck &check, SigMap &sigmap)
+	{
+		ezSatPtr ez;
+		SatGen satgen(ez.get(), &sigmap);
+
+		pool<RTLIL::Cell*> sat_cells;
+		std::set<RTLIL::SigBit> bits_queue;
+
+		std::vector<int> cell_active, other_cell_active;
+
+		for (auto &p : check.filtered_cell_patterns)
+			cell_active.push_back(ez->vec_eq(satgen.importSigSpec(p.first), satgen.importSigSpec(p.second)));
+
+		for (auto &p : check.filtered_other_patterns)
+			other_cell_active.push_back(ez->vec_eq(satgen.importSigSpec(p.first), satgen.importSigSpec(p.second)));
+
+		for (auto &bit : check.cone_signals.to_sigbit_vector())
+			bits_queue.insert(bit);
+
+		while (!bits_queue.empty())
+		{
+			pool<ModWalker::PortBit> portbits;
+			modwalker.get_drivers(portbits, bits_queue);
+			bits_queue.clear();
+
+			for (auto &pbit : portbits)
+				if (sat_cells.count(pbit.cell) == 0 && cone_ct.cell_known(pbit.cell->type)) {
+					if (config.opt_fast && modwalker.cell_outputs.at(pbit.cell).size() >= 4)
+						continue;
+					const pool<RTLIL::SigBit> &inputs = modwalker.cell_inputs.at(pbit.cell);
+					bits_queue.insert(inputs.begin(), inputs.end());
+					satgen.importCell(pbit.cell);
+					sat_cells.insert(pbit.cell);
+				}
+
+			if (config.opt_fast && sat_cells.size() > 100)
+				break;
+		}
+
+		for (auto it : exclusive_ctrls)
+			if (satgen.importedSigBit(it.first) && satgen.importedSigBit(it.second)) {
+				check.sat_exclusive_bits.push_back(it);
+				int sub1 = satgen.importSigBit(it.first);
+				int sub2 = satgen.importSigBit(it.second);
+				ez->assume(ez->NOT(ez->AND(sub1, sub2)));
+			}
+
+		if (!ez->solve(ez->expression(ez->OpOr, cell_active))) {
+			check.cell_never_active = true;
+			return;
+		}
+
+		if (!ez->solve(ez->expression(ez->OpOr, other_cell_active))) {
+			check.other_never_active = true;
+			return;
+		}
+
+		ez->non_incremental();
+
+		std::vector<int> sat_model = satgen.importSigSpec(check.all_ctrl_signals);
+
+		int sub1 = ez->expression(ez->OpOr, cell_active);
+		int sub2 = ez->expression(ez->OpOr, other_cell_active);
+		ez->assume(ez->AND(sub1, sub2));
+
+		check.sat_cells = GetSize(sat_cells);
+		check.sat_variables = ez->numCnfVariables();
+		check.sat_clauses = ez->numCnfClauses();
+
+		check.can_share = !ez->solve(sat_model, check.sat_model_values);
+	}
+
+	void run_pair_checks(std::vector<PairCheck> &checks)
+	{
+		std::vector<int> sat_checks;
+		for (int i = 0; i < GetSize(checks); i++)
+			if (checks[i].mode == PairCheck::CHECK_SAT)
+				sat_checks.push_back(i);
+
+		TaskGroup group(std::max(std::min(config.num_threads, GetSize(sat_checks)), 1));
+
+		if (group.concurrent())
+		{
+			std::atomic<int> next_index(0);
+
+			// SigMap lookups compress paths, so every task uses its own copy
+			// for a share of the checks
+			for (int k = 0; k < std::min(config.num_threads, GetSize(sat_checks)); k++)
+				group.run([&]() {
+					SigMap task_sigmap = modwalker.sigmap;
+					while (1) {
+						int i = next_index++;
+						if (i >= GetSize(sat_checks))
+							break;
+						run_sat_check(checks[sat_checks[i]], task_sigmap);
+					}
+				});
+			group.wait();
+			return;
+		}
+
+		for (int i : sat_checks)
+			run_sat_check(checks[i], modwalker.sigmap);
+	}
+
+
 	// -------------------------------------------------------------------------------------
 	// Helper functions used to make sure that this pass does not introduce new logic loops.
 	// -------------------------------------------------------------------------------------
@@ -1004,6 +1266,7 @@ struct ShareWorker
 
 		topo_sigmap.set(module);
 		topo_bit_drivers.clear();
+		topo_cell_drivers.clear();
 
 		dict<RTLIL::Cell*, pool<RTLIL::SigBit>> cell_to_bits;
 		dict<RTLIL::SigBit, pool<RTLIL::Cell*>> bit_to_cells;
@@ -1026,12 +1289,13 @@ struct ShareWorker
 			RTLIL::Cell *c1 = it.first;
 
 			for (auto bit : it.second)
-			for (auto c2 : bit_to_cells[bit])
+			for (auto c2 : bit_to_cells[bit]) {
 				toposort.edge(c1, c2);
+				topo_cell_drivers[c2].insert(c1);
+			}
 		}
 
 		bool found_scc = !toposort.sort();
-		topo_cell_drivers = std::move(toposort.database);
 
 		if (found_scc && toposort.analyze_loops)
 			for (auto &loop : toposort.loops) {
@@ -1111,7 +1375,7 @@ struct ShareWorker
 
 	void remove_cell(Cell *cell)
 	{
-		shareable_cells.erase(cell);
+		remove_shareable(cell);
 		forbidden_controls_cache.erase(cell);
 		activation_patterns_cache.erase(cell);
 		module->remove(cell);
@@ -1132,14 +1396,14 @@ struct ShareWorker
 		fwd_ct.setup_internals();
 
 		cone_ct.setup_internals();
-		cone_ct.cell_types.erase(ID($mul));
-		cone_ct.cell_types.erase(ID($mod));
-		cone_ct.cell_types.erase(ID($div));
-		cone_ct.cell_types.erase(ID($pow));
-		cone_ct.cell_types.erase(ID($shl));
-		cone_ct.cell_types.erase(ID($shr));
-		cone_ct.cell_types.erase(ID($sshl));
-		cone_ct.cell_types.erase(ID($sshr));
+		cone_ct.remove_type(ID($mul));
+		cone_ct.remove_type(ID($mod));
+		cone_ct.remove_type(ID($div));
+		cone_ct.remove_type(ID($pow));
+		cone_ct.remove_type(ID($shl));
+		cone_ct.remove_type(ID($shr));
+		cone_ct.remove_type(ID($sshl));
+		cone_ct.remove_type(ID($sshr));
 
 		modwalker.setup(design, module);
 
@@ -1159,10 +1423,12 @@ struct ShareWorker
 					if (bit < other_bit)
 						exclusive_ctrls.push_back(std::pair<RTLIL::SigBit, RTLIL::SigBit>(bit, other_bit));
 
+		int sat_budget = config.sat_limit;
+
 		while (!shareable_cells.empty() && config.limit != 0)
 		{
 			RTLIL::Cell *cell = *shareable_cells.begin();
-			shareable_cells.erase(cell);
+			remove_shareable(cell);
 
 			log("  Analyzing resource sharing options for %s (%s):\n", log_id(cell), log_id(cell->type));
 
@@ -1195,214 +1461,184 @@ struct ShareWorker
 				log(" %s", log_id(c));
 			log("\n");
 
-			for (auto other_cell : candidates)
-			{
-				log("    Analyzing resource sharing with %s (%s):\n", log_id(other_cell), log_id(other_cell->type));
-
-				const pool<ssc_pair_t> &other_cell_activation_patterns = find_cell_activation_patterns(other_cell, "      ");
-				RTLIL::SigSpec other_cell_activation_signals = bits_from_activation_patterns(other_cell_activation_patterns);
-
-				if (other_cell_activation_patterns.empty()) {
-					log("      Cell is never active. Sharing is pointless, we simply remove it.\n");
-					shareable_cells.erase(other_cell);
-					cells_to_remove.insert(other_cell);
-					continue;
-				}
+			// The candidates are checked in waves of one candidate per thread.
+			// The SAT problems of a wave are solved concurrently and the
+			// results are used in candidate order, as if they were solved one
+			// after another.
 
-				if (other_cell_activation_patterns.count(ssc_pair_t())) {
-					log("      Cell is always active. Therefore no sharing is possible.\n");
-					shareable_cells.erase(other_cell);
-					continue;
-				}
+			bool cell_done = false;
 
-				log("      Found %d activation_patterns using ctrl signal %s.\n",
-						GetSize(other_cell_activation_patterns), log_signal(other_cell_activation_signals));
+			for (int wave_begin = 0; wave_begin < GetSize(candidates) && !cell_done; wave_begin += config.num_threads)
+			{
+				int wave_end = std::min(wave_begin + config.num_threads, GetSize(candidates));
+				std::vector<PairCheck> checks(wave_end - wave_begin);
 
-				const pool<RTLIL::SigBit> &cell_forbidden_controls = find_forbidden_controls(cell);
-				const pool<RTLIL::SigBit> &other_cell_forbidden_controls = find_forbidden_controls(other_cell);
+				int wave_budget = sat_budget;
+				for (int i = wave_begin; i < wave_end; i++)
+					prepare_pair_check(checks[i - wave_begin], cell, cell_activation_patterns, cell_activation_signals, candidates[i], wave_budget);
 
-				std::set<RTLIL::SigBit> union_forbidden_controls;
-				union_forbidden_controls.insert(cell_forbidden_controls.begin(), cell_forbidden_controls.end());
-				union_forbidden_controls.insert(other_cell_forbidden_controls.begin(), other_cell_forbidden_controls.end());
+				run_pair_checks(checks);
 
-				if (!union_forbidden_controls.empty())
-					log("      Forbidden control signals for this pair of cells: %s\n", log_signal(union_forbidden_controls));
+				for (auto &check : checks)
+				{
+					RTLIL::Cell *other_cell = check.other_cell;
 
-				pool<ssc_pair_t> filtered_cell_activation_patterns;
-				pool<ssc_pair_t> filtered_other_cell_activation_patterns;
+					log("    Analyzing resource sharing with %s (%s):\n", log_id(other_cell), log_id(other_cell->type));
+					check.patterns_log.replay();
 
-				filter_activation_patterns(filtered_cell_activation_patterns, cell_activation_patterns, union_forbidden_controls);
-				filter_activation_patterns(filtered_other_cell_activation_patterns, other_cell_activation_patterns, union_forbidden_controls);
+					if (check.other_patterns.empty()) {
+						log("      Cell is never active. Sharing is pointless, we simply remove it.\n");
+						remove_shareable(other_cell);
+						cells_to_remove.insert(other_cell);
+						continue;
+					}
 
-				optimize_activation_patterns(filtered_cell_activation_patterns);
-				optimize_activation_patterns(filtered_other_cell_activation_patterns);
+					if (check.other_patterns.count(ssc_pair_t())) {
+						log("      Cell is always active. Therefore no sharing is possible.\n");
+						remove_shareable(other_cell);
+						continue;
+					}
 
-				ezSatPtr ez;
-				SatGen satgen(ez.get(), &modwalker.sigmap);
+					log("      Found %d activation_patterns using ctrl signal %s.\n",
+							GetSize(check.other_patterns), log_signal(bits_from_activation_patterns(check.other_patterns)));
 
-				pool<RTLIL::Cell*> sat_cells;
-				std::set<RTLIL::SigBit> bits_queue;
+					if (!check.forbidden_controls.empty())
+						log("      Forbidden control signals for this pair of cells: %s\n", log_signal(check.forbidden_controls));
 
-				std::vector<int> cell_active, other_cell_active;
-				RTLIL::SigSpec all_ctrl_signals;
+					for (auto &p : check.filtered_cell_patterns)
+						log("      Activation pattern for cell %s: %s = %s\n", log_id(cell), log_signal(p.first), log_signal(p.second));
 
-				for (auto &p : filtered_cell_activation_patterns) {
-					log("      Activation pattern for cell %s: %s = %s\n", log_id(cell), log_signal(p.first), log_signal(p.second));
-					cell_active.push_back(ez->vec_eq(satgen.importSigSpec(p.first), satgen.importSigSpec(p.second)));
-					all_ctrl_signals.append(p.first);
-				}
+					for (auto &p : check.filtered_other_patterns)
+						log("      Activation pattern for cell %s: %s = %s\n", log_id(other_cell), log_signal(p.first), log_signal(p.second));
 
-				for (auto &p : filtered_other_cell_activation_patterns) {
-					log("      Activation pattern for cell %s: %s = %s\n", log_id(other_cell), log_signal(p.first), log_signal(p.second));
-					other_cell_active.push_back(ez->vec_eq(satgen.importSigSpec(p.first), satgen.importSigSpec(p.second)));
-					all_ctrl_signals.append(p.first);
-				}
+					if (check.mode == PairCheck::CHECK_EXCLUSIVE)
+					{
+						log("      The activation patterns of the two cells contradict each other, this pair of cells can be shared.\n");
+					}
+					else if (check.mode == PairCheck::CHECK_OVERLAP)
+					{
+						log("      Both cells are active for %s = %s (free control signals), this pair of cells can not be shared.\n",
+								log_signal(check.overlap.first), log_signal(check.overlap.second));
+						continue;
+					}
+					else if (check.mode == PairCheck::CHECK_NO_BUDGET)
+					{
+						log("      SAT limit reached, not checking this pair of cells.\n");
+						continue;
+					}
+					else
+					{
+						if (sat_budget > 0)
+							sat_budget--;
+
+						for (auto &it : check.sat_exclusive_bits)
+							log("      Adding exclusive control bits: %s vs. %s\n", log_signal(it.first), log_signal(it.second));
+
+						if (check.cell_never_active) {
+							log("      According to the SAT solver the cell %s is never active. Sharing is pointless, we simply remove it.\n", log_id(cell));
+							cells_to_remove.insert(cell);
+							cell_done = true;
+							break;
+						}
 
-				for (auto &bit : cell_activation_signals.to_sigbit_vector())
-					bits_queue.insert(bit);
+						if (check.other_never_active) {
+							log("      According to the SAT solver the cell %s is never active. Sharing is pointless, we simply remove it.\n", log_id(other_cell));
+							cells_to_remove.insert(other_cell);
+							remove_shareable(other_cell);
+							continue;
+						}
 
-				for (auto &bit : other_cell_activation_signals.to_sigbit_vector())
-					bits_queue.insert(bit);
+						log("      Size of SAT problem: %d cells, %d variables, %d clauses\n",
+								check.sat_cells, check.sat_variables, check.sat_clauses);
 
-				while (!bits_queue.empty())
-				{
-					pool<ModWalker::PortBit> portbits;
-					modwalker.get_drivers(portbits, bits_queue);
-					bits_queue.clear();
-
-					for (auto &pbit : portbits)
-						if (sat_cells.count(pbit.cell) == 0 && cone_ct.cell_known(pbit.cell->type)) {
-							if (config.opt_fast && modwalker.cell_outputs[pbit.cell].size() >= 4)
-								continue;
-							// log("      Adding cell %s (%s) to SAT problem.\n", log_id(pbit.cell), log_id(pbit.cell->type));
-							bits_queue.insert(modwalker.cell_inputs[pbit.cell].begin(), modwalker.cell_inputs[pbit.cell].end());
-							satgen.importCell(pbit.cell);
-							sat_cells.insert(pbit.cell);
+						if (!check.can_share) {
+							log("      According to the SAT solver this pair of cells can not be shared.\n");
+							log("      Model from SAT solver: %s = %d'", log_signal(check.all_ctrl_signals), GetSize(check.sat_model_values));
+							for (int i = GetSize(check.sat_model_values)-1; i >= 0; i--)
+								log("%c", check.sat_model_values[i] ? '1' : '0');
+							log("\n");
+							continue;
 						}
 
-					if (config.opt_fast && sat_cells.size() > 100)
-						break;
-				}
-
-				for (auto it : exclusive_ctrls)
-					if (satgen.importedSigBit(it.first) && satgen.importedSigBit(it.second)) {
-						log("      Adding exclusive control bits: %s vs. %s\n", log_signal(it.first), log_signal(it.second));
-						int sub1 = satgen.importSigBit(it.first);
-						int sub2 = satgen.importSigBit(it.second);
-						ez->assume(ez->NOT(ez->AND(sub1, sub2)));
+						log("      According to the SAT solver this pair of cells can be shared.\n");
 					}
 
-				if (!ez->solve(ez->expression(ez->OpOr, cell_active))) {
-					log("      According to the SAT solver the cell %s is never active. Sharing is pointless, we simply remove it.\n", log_id(cell));
-					cells_to_remove.insert(cell);
-					break;
-				}
-
-				if (!ez->solve(ez->expression(ez->OpOr, other_cell_active))) {
-					log("      According to the SAT solver the cell %s is never active. Sharing is pointless, we simply remove it.\n", log_id(other_cell));
-					cells_to_remove.insert(other_cell);
-					shareable_cells.erase(other_cell);
-					continue;
-				}
+					if (find_in_input_cone(cell, other_cell)) {
+						log("      Sharing not possible: %s is in input cone of %s.\n", log_id(other_cell), log_id(cell));
+						continue;
+					}
 
-				ez->non_incremental();
+					if (find_in_input_cone(other_cell, cell)) {
+						log("      Sharing not possible: %s is in input cone of %s.\n", log_id(cell), log_id(other_cell));
+						continue;
+					}
 
-				all_ctrl_signals.sort_and_unify();
-				std::vector<int> sat_model = satgen.importSigSpec(all_ctrl_signals);
-				std::vector<bool> sat_model_values;
+					remove_shareable(other_cell);
 
-				int sub1 = ez->expression(ez->OpOr, cell_active);
-				int sub2 = ez->expression(ez->OpOr, other_cell_active);
-				ez->assume(ez->AND(sub1, sub2));
+					int cell_select_score = 0;
+					int other_cell_select_score = 0;
 
-				log("      Size of SAT problem: %d cells, %d variables, %d clauses\n",
-						GetSize(sat_cells), ez->numCnfVariables(), ez->numCnfClauses());
+					for (auto &p : check.filtered_cell_patterns)
+						cell_select_score += p.first.size();
 
-				if (ez->solve(sat_model, sat_model_values)) {
-					log("      According to the SAT solver this pair of cells can not be shared.\n");
-					log("      Model from SAT solver: %s = %d'", log_signal(all_ctrl_signals), GetSize(sat_model_values));
-					for (int i = GetSize(sat_model_values)-1; i >= 0; i--)
-						log("%c", sat_model_values[i] ? '1' : '0');
-					log("\n");
-					continue;
-				}
+					for (auto &p : check.filtered_other_patterns)
+						other_cell_select_score += p.first.size();
 
-				log("      According to the SAT solver this pair of cells can be shared.\n");
+					RTLIL::Cell *supercell;
+					pool<RTLIL::Cell*> supercell_aux;
+					if (cell_select_score <= other_cell_select_score) {
+						RTLIL::SigSpec act = make_cell_activation_logic(check.filtered_cell_patterns, supercell_aux);
+						supercell = make_supercell(cell, other_cell, act, supercell_aux);
+						log("      Activation signal for %s: %s\n", log_id(cell), log_signal(act));
+					} else {
+						RTLIL::SigSpec act = make_cell_activation_logic(check.filtered_other_patterns, supercell_aux);
+						supercell = make_supercell(other_cell, cell, act, supercell_aux);
+						log("      Activation signal for %s: %s\n", log_id(other_cell), log_signal(act));
+					}
 
-				if (find_in_input_cone(cell, other_cell)) {
-					log("      Sharing not possible: %s is in input cone of %s.\n", log_id(other_cell), log_id(cell));
-					continue;
-				}
+					log("      New cell: %s (%s)\n", log_id(supercell), log_id(supercell->type));
 
-				if (find_in_input_cone(other_cell, cell)) {
-					log("      Sharing not possible: %s is in input cone of %s.\n", log_id(cell), log_id(other_cell));
-					continue;
-				}
+					cells_to_remove.insert(cell);
+					cells_to_remove.insert(other_cell);
 
-				shareable_cells.erase(other_cell);
+					for (auto c : supercell_aux)
+						if (is_part_of_scc(c))
+							goto do_rollback;
+
+					if (0) {
+				do_rollback:
+						log("      New topology contains loops! Rolling back..\n");
+						cells_to_remove.erase(cell);
+						cells_to_remove.erase(other_cell);
+						add_shareable(other_cell);
+						for (auto cc : supercell_aux)
+							remove_cell(cc);
+						continue;
+					}
 
-				int cell_select_score = 0;
-				int other_cell_select_score = 0;
+					pool<ssc_pair_t> supercell_activation_patterns;
+					supercell_activation_patterns.insert(check.filtered_cell_patterns.begin(), check.filtered_cell_patterns.end());
+					supercell_activation_patterns.insert(check.filtered_other_patterns.begin(), check.filtered_other_patterns.end());
+					optimize_activation_patterns(supercell_activation_patterns);
+					activation_patterns_cache[supercell] = supercell_activation_patterns;
+					add_shareable(supercell);
 
-				for (auto &p : filtered_cell_activation_patterns)
-					cell_select_score += p.first.size();
+					for (auto bit : topo_sigmap(check.all_ctrl_signals))
+						for (auto c : topo_bit_drivers[bit])
+							topo_cell_drivers[supercell].insert(c);
 
-				for (auto &p : filtered_other_cell_activation_patterns)
-					other_cell_select_score += p.first.size();
+					topo_cell_drivers[supercell].insert(topo_cell_drivers[cell].begin(), topo_cell_drivers[cell].end());
+					topo_cell_drivers[supercell].insert(topo_cell_drivers[other_cell].begin(), topo_cell_drivers[other_cell].end());
 
-				RTLIL::Cell *supercell;
-				pool<RTLIL::Cell*> supercell_aux;
-				if (cell_select_score <= other_cell_select_score) {
-					RTLIL::SigSpec act = make_cell_activation_logic(filtered_cell_activation_patterns, supercell_aux);
-					supercell = make_supercell(cell, other_cell, act, supercell_aux);
-					log("      Activation signal for %s: %s\n", log_id(cell), log_signal(act));
-				} else {
-					RTLIL::SigSpec act = make_cell_activation_logic(filtered_other_cell_activation_patterns, supercell_aux);
-					supercell = make_supercell(other_cell, cell, act, supercell_aux);
-					log("      Activation signal for %s: %s\n", log_id(other_cell), log_signal(act));
-				}
+					topo_cell_drivers[cell] = { supercell };
+					topo_cell_drivers[other_cell] = { supercell };
 
-				log("      New cell: %s (%s)\n", log_id(supercell), log_id(supercell->type));
+					if (config.limit > 0)
+						config.limit--;
 
-				cells_to_remove.insert(cell);
-				cells_to_remove.insert(other_cell);
-
-				for (auto c : supercell_aux)
-					if (is_part_of_scc(c))
-						goto do_rollback;
-
-				if (0) {
-			do_rollback:
-					log("      New topology contains loops! Rolling back..\n");
-					cells_to_remove.erase(cell);
-					cells_to_remove.erase(other_cell);
-					shareable_cells.insert(other_cell);
-					for (auto cc : supercell_aux)
-						remove_cell(cc);
-					continue;
+					cell_done = true;
+					break;
 				}
-
-				pool<ssc_pair_t> supercell_activation_patterns;
-				supercell_activation_patterns.insert(filtered_cell_activation_patterns.begin(), filtered_cell_activation_patterns.end());
-				supercell_activation_patterns.insert(filtered_other_cell_activation_patterns.begin(), filtered_other_cell_activation_patterns.end());
-				optimize_activation_patterns(supercell_activation_patterns);
-				activation_patterns_cache[supercell] = supercell_activation_patterns;
-				shareable_cells.insert(supercell);
-
-				for (auto bit : topo_sigmap(all_ctrl_signals))
-					for (auto c : topo_bit_drivers[bit])
-						topo_cell_drivers[supercell].insert(c);
-
-				topo_cell_drivers[supercell].insert(topo_cell_drivers[cell].begin(), topo_cell_drivers[cell].end());
-				topo_cell_drivers[supercell].insert(topo_cell_drivers[other_cell].begin(), topo_cell_drivers[other_cell].end());
-
-				topo_cell_drivers[cell] = { supercell };
-				topo_cell_drivers[other_cell] = { supercell };
-
-				if (config.limit > 0)
-					config.limit--;
-
-				break;
 			}
 		}
 
@@ -1456,12 +1692,23 @@ struct SharePass : public Pass {
 		log("  -limit N\n");
 		log("    Only perform the first N merges, then stop. This is useful for debugging.\n");
 		log("\n");
+		log("  -sat_limit N\n");
+		log("    Solve at most N SAT problems. Pairs of cells that can not be decided by\n");
+		log("    comparing their activation patterns are not shared once the limit is\n");
+		log("    reached.\n");
+		log("\n");
+		log("  -j N\n");
+		log("    Solve the SAT problems for up to N candidate pairs concurrently. The\n");
+		log("    result does not depend on this option. (default: the global -j value)\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
 	{
 		ShareWorkerConfig config;
 
 		config.limit = -1;
+		config.sat_limit = -1;
+		config.num_threads = yosys_threads;
 		config.opt_force = false;
 		config.opt_aggressive = false;
 		config.opt_fast = false;
@@ -1524,6 +1771,14 @@ struct SharePass : public Pass {
 				config.limit = atoi(args[++argidx].c_str());
 				continue;
 			}
+			if (args[argidx] == "-sat_limit" && argidx+1 < args.size()) {
+				config.sat_limit = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				config.num_threads = std::max(1, atoi(args[++argidx].c_str()));
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
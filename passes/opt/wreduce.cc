@@ -56,9 +56,132 @@ struct WreduceWorker
 	dict<SigBit, State> init_bits;
 	pool<SigBit> remove_init_bits;
 
+	// Bits that are zero for all input values. The facts are found by a
+	// forward propagation from the constant zero bits, and they stay valid
+	// because wreduce never changes the value of a signal. Cells are only
+	// re-evaluated when a bit they are connected to has changed.
+	pool<SigBit> known_zero_bits;
+	pool<Cell*> known_zero_queue;
+
 	WreduceWorker(WreduceConfig *config, Module *module) :
 			config(config), module(module), mi(module) { }
 
+	bool is_known_zero(SigBit bit)
+	{
+		bit = mi.sigmap(bit);
+		if (bit.wire == nullptr)
+			return bit == State::S0;
+		return known_zero_bits.count(bit) != 0;
+	}
+
+	// bit of an input port, extended to the requested index
+	SigBit get_port_bit(Cell *cell, IdString port, int index, bool is_signed)
+	{
+		const SigSpec &sig = cell->getPort(port);
+		if (index < GetSize(sig))
+			return sig[index];
+		if (is_signed && GetSize(sig) > 0)
+			return sig[GetSize(sig)-1];
+		return State::S0;
+	}
+
+	// number of bits of an unsigned input port below the known zero top bits
+	int get_known_width(Cell *cell, IdString port)
+	{
+		const SigSpec &sig = cell->getPort(port);
+		int width = GetSize(sig);
+		while (width > 0 && is_known_zero(sig[width-1]))
+			width--;
+		return width;
+	}
+
+	bool eval_known_zero(Cell *cell, int index)
+	{
+		if (cell->type.in(ID($and), ID($or), ID($xor), ID($pos)))
+		{
+			bool a_zero = is_known_zero(get_port_bit(cell, ID::A, index, cell->getParam(ID(A_SIGNED)).as_bool()));
+			if (cell->type == ID($pos))
+				return a_zero;
+
+			bool b_zero = is_known_zero(get_port_bit(cell, ID::B, index, cell->getParam(ID(B_SIGNED)).as_bool()));
+			if (cell->type == ID($and))
+				return a_zero || b_zero;
+			return a_zero && b_zero;
+		}
+
+		if (cell->type.in(ID($mux), ID($pmux)))
+		{
+			int width = GetSize(cell->getPort(ID::Y));
+			const SigSpec &sig_b = cell->getPort(ID::B);
+
+			if (!is_known_zero(cell->getPort(ID::A)[index]))
+				return false;
+			for (int k = index; k < GetSize(sig_b); k += width)
+				if (!is_known_zero(sig_b[k]))
+					return false;
+			return true;
+		}
+
+		if (cell->type.in(ID($dff), ID($adff)))
+		{
+			SigBit q = mi.sigmap(cell->getPort(ID(Q))[index]);
+			if (init_bits.count(q) && init_bits.at(q) != State::S0 && init_bits.at(q) != State::Sx)
+				return false;
+			if (cell->type == ID($adff)) {
+				Const arst_value = cell->getParam(ID(ARST_VALUE));
+				if (index < GetSize(arst_value) && arst_value[index] != State::S0 && arst_value[index] != State::Sx)
+					return false;
+			}
+			return is_known_zero(cell->getPort(ID(D))[index]);
+		}
+
+		return false;
+	}
+
+	void update_known_zero(Cell *cell)
+	{
+		IdString port = cell->type.in(ID($dff), ID($adff)) ? ID(Q) : ID::Y;
+		if (!cell->hasPort(port))
+			return;
+
+		// all bits from this index on are known zero
+		int zero_index = GetSize(cell->getPort(port));
+
+		if (cell->type.in(ID($lt), ID($le), ID($eq), ID($ne), ID($eqx), ID($nex), ID($ge), ID($gt),
+				ID($logic_not), ID($logic_and), ID($logic_or), ID($reduce_and), ID($reduce_or),
+				ID($reduce_xor), ID($reduce_xnor), ID($reduce_bool)))
+			zero_index = 1;
+
+		if (cell->type.in(ID($add), ID($mul)) && !cell->getParam(ID(A_SIGNED)).as_bool() && !cell->getParam(ID(B_SIGNED)).as_bool()) {
+			int a_width = get_known_width(cell, ID::A), b_width = get_known_width(cell, ID::B);
+			zero_index = cell->type == ID($add) ? max(a_width, b_width) + 1 : a_width + b_width;
+		}
+
+		if (cell->type.in(ID($shr), ID($sshr)) && !cell->getParam(ID(A_SIGNED)).as_bool())
+			zero_index = get_known_width(cell, ID::A);
+
+		SigSpec sig = mi.sigmap(cell->getPort(port));
+		for (int i = 0; i < GetSize(sig); i++)
+		{
+			SigBit bit = sig[i];
+			if (bit.wire == nullptr || known_zero_bits.count(bit))
+				continue;
+			if (i < zero_index && !eval_known_zero(cell, i))
+				continue;
+
+			known_zero_bits.insert(bit);
+			work_queue_bits.insert(bit);
+			for (auto &port_info : mi.query_ports(bit))
+				known_zero_queue.insert(port_info.cell);
+		}
+	}
+
+	void propagate_known_zero()
+	{
+		while (!known_zero_queue.empty())
+			update_known_zero(known_zero_queue.pop());
+	}
+
 	void run_cell_mux(Cell *cell)
 	{
 		// Reduce size of MUX if inputs agree on a value for a bit or a output bit is unused
@@ -80,6 +203,14 @@ struct WreduceWorker
 				continue;
 			}
 
+			bool all_zero = is_known_zero(sig_a[i]);
+			for (int k = 0; k < GetSize(sig_s) && all_zero; k++)
+				all_zero = is_known_zero(sig_b[k*GetSize(sig_a) + i]);
+			if (all_zero) {
+				bits_removed.push_back(State::S0);
+				continue;
+			}
+
 			SigBit ref = sig_a[i];
 			for (int k = 0; k < GetSize(sig_s); k++) {
 				if ((config->keepdc || (ref != State::Sx && sig_b[k*GetSize(sig_a) + i] != State::Sx)) && ref != sig_b[k*GetSize(sig_a) + i])
@@ -155,20 +286,20 @@ struct WreduceWorker
 			arst_value = cell->parameters[ID(ARST_VALUE)];
 		}
 
-		bool zero_ext = sig_d[GetSize(sig_d)-1] == State::S0;
+		bool zero_ext = is_known_zero(sig_d[GetSize(sig_d)-1]);
 		bool sign_ext = !zero_ext;
 
 		for (int i = 0; i < GetSize(sig_q); i++) {
 			SigBit bit = sig_q[i];
 			if (init_bits.count(bit))
-				initval.bits.push_back(init_bits.at(bit));
+				initval.bits().push_back(init_bits.at(bit));
 			else
-				initval.bits.push_back(State::Sx);
+				initval.bits().push_back(State::Sx);
 		}
 
 		for (int i = GetSize(sig_q)-1; i >= 0; i--)
 		{
-			if (zero_ext && sig_d[i] == State::S0 && (initval[i] == State::S0 || initval[i] == State::Sx) &&
+			if (zero_ext && is_known_zero(sig_d[i]) && (initval[i] == State::S0 || initval[i] == State::Sx) &&
 					(!is_adff || i >= GetSize(arst_value) || arst_value[i] == State::S0 || arst_value[i] == State::Sx)) {
 				module->connect(sig_q[i], State::S0);
 				remove_init_bits.insert(sig_q[i]);
@@ -221,7 +352,7 @@ struct WreduceWorker
 
 		// Narrow ARST_VALUE parameter to new size.
 		if (cell->parameters.count(ID(ARST_VALUE))) {
-			arst_value.bits.resize(GetSize(sig_q));
+			arst_value.bits().resize(GetSize(sig_q));
 			cell->setParam(ID(ARST_VALUE), arst_value);
 		}
 
@@ -247,10 +378,11 @@ struct WreduceWorker
 		}
 
 		if (port_signed) {
-			while (GetSize(sig) > 1 && sig[GetSize(sig)-1] == sig[GetSize(sig)-2])
+			while (GetSize(sig) > 1 && (sig[GetSize(sig)-1] == sig[GetSize(sig)-2] ||
+					(is_known_zero(sig[GetSize(sig)-1]) && is_known_zero(sig[GetSize(sig)-2]))))
 				work_queue_bits.insert(sig[GetSize(sig)-1]), sig.remove(GetSize(sig)-1), bits_removed++;
 		} else {
-			while (GetSize(sig) > 1 && sig[GetSize(sig)-1] == State::S0)
+			while (GetSize(sig) > 1 && is_known_zero(sig[GetSize(sig)-1]))
 				work_queue_bits.insert(sig[GetSize(sig)-1]), sig.remove(GetSize(sig)-1), bits_removed++;
 		}
 
@@ -302,8 +434,8 @@ struct WreduceWorker
 
 		if (cell->hasPort(ID::A) && cell->hasPort(ID::B) && port_a_signed && port_b_signed) {
 			SigSpec sig_a = mi.sigmap(cell->getPort(ID::A)), sig_b = mi.sigmap(cell->getPort(ID::B));
-			if (GetSize(sig_a) > 0 && sig_a[GetSize(sig_a)-1] == State::S0 &&
-					GetSize(sig_b) > 0 && sig_b[GetSize(sig_b)-1] == State::S0) {
+			if (GetSize(sig_a) > 0 && is_known_zero(sig_a[GetSize(sig_a)-1]) &&
+					GetSize(sig_b) > 0 && is_known_zero(sig_b[GetSize(sig_b)-1])) {
 				log("Converting cell %s.%s (%s) from signed to unsigned.\n",
 						log_id(module), log_id(cell), log_id(cell->type));
 				cell->setParam(ID(A_SIGNED), 0);
@@ -316,7 +448,7 @@ struct WreduceWorker
 
 		if (cell->hasPort(ID::A) && !cell->hasPort(ID::B) && port_a_signed) {
 			SigSpec sig_a = mi.sigmap(cell->getPort(ID::A));
-			if (GetSize(sig_a) > 0 && sig_a[GetSize(sig_a)-1] == State::S0) {
+			if (GetSize(sig_a) > 0 && is_known_zero(sig_a[GetSize(sig_a)-1])) {
 				log("Converting cell %s.%s (%s) from signed to unsigned.\n",
 						log_id(module), log_id(cell), log_id(cell->type));
 				cell->setParam(ID(A_SIGNED), 0);
@@ -365,6 +497,14 @@ struct WreduceWorker
 
 			while (GetSize(sig) > 1 && GetSize(sig) > max_y_size) {
 				module->connect(sig[GetSize(sig)-1], is_signed ? sig[GetSize(sig)-2] : State::S0);
+				work_queue_bits.insert(sig[GetSize(sig)-1]);
+				sig.remove(GetSize(sig)-1);
+				bits_removed++;
+			}
+
+			while (GetSize(sig) > 1 && is_known_zero(sig[GetSize(sig)-1])) {
+				module->connect(sig[GetSize(sig)-1], State::S0);
+				work_queue_bits.insert(sig[GetSize(sig)-1]);
 				sig.remove(GetSize(sig)-1);
 				bits_removed++;
 			}
@@ -418,12 +558,22 @@ struct WreduceWorker
 		for (auto c : module->selected_cells())
 			work_queue_cells.insert(c);
 
+		for (auto c : module->cells())
+			known_zero_queue.insert(c);
+		propagate_known_zero();
+
 		while (!work_queue_cells.empty())
 		{
 			work_queue_bits.clear();
 			for (auto c : work_queue_cells)
 				run_cell(c);
 
+			// cells on changed bits may now drive more known zero bits
+			for (auto bit : work_queue_bits)
+			for (auto port : mi.query_ports(bit))
+				known_zero_queue.insert(port.cell);
+			propagate_known_zero();
+
 			work_queue_cells.clear();
 			for (auto bit : work_queue_bits)
 			for (auto port : mi.query_ports(bit))
@@ -471,7 +621,7 @@ struct WreduceWorker
 					int width = std::min(GetSize(initval), GetSize(initsig));
 					for (int i = 0; i < width; i++) {
 						if (!remove_init_bits.count(initsig[i]))
-							new_initval[i] = initval[i];
+							new_initval.bits()[i] = initval[i];
 					}
 					w->attributes.at(ID(init)) = new_initval;
 				}
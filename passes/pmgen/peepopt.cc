@@ -76,6 +76,7 @@ struct PeepoptPass : public Pass {
 
 		for (auto module : design->selected_modules())
 		{
+			peepopt_pm pm(module, module->selected_cells());
 			did_something = true;
 
 			while (did_something)
@@ -84,8 +85,6 @@ struct PeepoptPass : public Pass {
 				initbits.clear();
 				rminitbits.clear();
 
-				peepopt_pm pm(module);
-
 				for (auto w : module->wires()) {
 					auto it = w->attributes.find(ID(init));
 					if (it != w->attributes.end()) {
@@ -102,8 +101,6 @@ struct PeepoptPass : public Pass {
 					}
 				}
 
-				pm.setup(module->selected_cells());
-
 				pm.run_shiftmul();
 				pm.run_muldiv();
 				pm.run_dffmux();
@@ -116,13 +113,16 @@ struct PeepoptPass : public Pass {
 						int len = std::min(GetSize(sig), GetSize(val));
 						for (int i = 0; i < len; i++) {
 							if (rminitbits.count(sig[i]))
-								val[i] = State::Sx;
+								val.bits()[i] = State::Sx;
 						}
 					}
 				}
 
 				initbits.clear();
 				rminitbits.clear();
+
+				if (did_something)
+					pm.update(module->selected_cells());
 			}
 		}
 	}
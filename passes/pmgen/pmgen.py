@@ -107,6 +107,34 @@ def rewrite_cpp(s):
 
     return "".join(t)
 
+interned_index_types = {"SigSpec": "index_sigspecs", "SigBit": "index_sigbits", "Cell*": "index_cellptrs"}
+packed_index_types = set(interned_index_types.keys()) | {"IdString", "int", "bool"}
+
+def index_key_mode(block):
+    types = [entry[0].replace(" ", "") for entry in block["index"]]
+    if len(types) == 0 or any(t not in packed_index_types for t in types):
+        return "tuple"
+    return "packed" if len(types) <= 2 else "ints"
+
+def index_key_field(t, expr, lookup):
+    t = t.replace(" ", "")
+    if t in interned_index_types:
+        if lookup:
+            return "{}.at({}, -1)".format(interned_index_types[t], expr)
+        return "{}({})".format(interned_index_types[t], expr)
+    if t == "IdString":
+        return "IdString({}).index_".format(expr)
+    if t == "bool":
+        return "int(bool({}))".format(expr)
+    return "int({})".format(expr)
+
+def index_key_value(index, mode, fields):
+    if mode == "packed" and len(fields) == 1:
+        return fields[0]
+    if mode == "packed":
+        return "index_pack({}, {})".format(fields[0], fields[1])
+    return "index_{}_key_type({})".format(index, ", ".join(fields))
+
 def process_pmgfile(f, filename):
     linenr = 0
     global current_pattern
@@ -390,9 +418,21 @@ with open(outfile, "w") as f:
                     value_types.append(entry[1])
                 if entry[0] == "define":
                     value_types.append(entry[1])
-            print("  typedef std::tuple<{}> index_{}_key_type;".format(", ".join(index_types), index), file=f)
+            value_types.append("int")
+            key_mode = index_key_mode(block)
+            if key_mode == "packed":
+                print("  typedef int64_t index_{}_key_type;".format(index), file=f)
+            elif key_mode == "ints":
+                print("  typedef std::tuple<{}> index_{}_key_type;".format(", ".join(["int"] * len(index_types)), index), file=f)
+            else:
+                print("  typedef std::tuple<{}> index_{}_key_type;".format(", ".join(index_types), index), file=f)
             print("  typedef std::tuple<{}> index_{}_value_type;".format(", ".join(value_types), index), file=f)
             print("  dict<index_{}_key_type, vector<index_{}_value_type>> index_{};".format(index, index, index), file=f)
+    print("  idict<SigSpec> index_sigspecs;", file=f)
+    print("  idict<SigBit> index_sigbits;", file=f)
+    print("  idict<Cell*> index_cellptrs;", file=f)
+    print("  dict<Cell*, std::pair<int, int>> index_cells;", file=f)
+    print("  int index_stamp, index_live_entries, index_stale_entries;", file=f)
     print("  dict<SigBit, pool<Cell*>> sigusers;", file=f)
     print("  pool<Cell*> blacklist_cells;", file=f)
     print("  pool<Cell*> autoremove_cells;", file=f)
@@ -400,6 +440,22 @@ with open(outfile, "w") as f:
     print("  int rollback;", file=f)
     print("", file=f)
 
+    print("  struct monitor_t : public RTLIL::Monitor {", file=f)
+    print("    {}_pm *pm;".format(prefix), file=f)
+    print("    monitor_t({}_pm *pm) : pm(pm) {{ }}".format(prefix), file=f)
+    print("    void notify_connect(RTLIL::Cell *cell, const RTLIL::IdString&, const RTLIL::SigSpec &old_sig, RTLIL::SigSpec&) YS_OVERRIDE {", file=f)
+    print("      if (!pm->dirty_all)", file=f)
+    print("        pm->dirty_cells[cell].append(old_sig);", file=f)
+    print("    }", file=f)
+    print("    void notify_connect(RTLIL::Module*, const RTLIL::SigSig&) YS_OVERRIDE { pm->dirty_all = true; }", file=f)
+    print("    void notify_connect(RTLIL::Module*, const std::vector<RTLIL::SigSig>&) YS_OVERRIDE { pm->dirty_all = true; }", file=f)
+    print("    void notify_blackout(RTLIL::Module*) YS_OVERRIDE { pm->dirty_all = true; }", file=f)
+    print("  };", file=f)
+    print("  monitor_t *monitor;", file=f)
+    print("  dict<Cell*, SigSpec> dirty_cells;", file=f)
+    print("  bool dirty_all;", file=f)
+    print("", file=f)
+
     for current_pattern in sorted(patterns.keys()):
         print("  struct state_{}_t {{".format(current_pattern), file=f)
         for s, t in sorted(state_types[current_pattern].items()):
@@ -477,18 +533,60 @@ with open(outfile, "w") as f:
     print("  }", file=f)
     print("", file=f)
 
+    print("  static int64_t index_pack(int a, int b) {", file=f)
+    print("    return int64_t((uint64_t(uint32_t(a)) << 32) | uint32_t(b));", file=f)
+    print("  }", file=f)
+    print("", file=f)
+
+    print("  int index_stamp_of(Cell *cell) {", file=f)
+    print("    auto it = index_cells.find(cell);", file=f)
+    print("    return it == index_cells.end() ? -1 : it->second.first;", file=f)
+    print("  }", file=f)
+    print("", file=f)
+
     print("  {}_pm(Module *module, const vector<Cell*> &cells) :".format(prefix), file=f)
-    print("      module(module), sigmap(module), setup_done(false), generate_mode(false), rngseed(12345678) {", file=f)
+    print("      module(module), sigmap(module), setup_done(false), generate_mode(false), rngseed(12345678),", file=f)
+    print("      index_stamp(0), index_live_entries(0), index_stale_entries(0), monitor(nullptr), dirty_all(false) {", file=f)
     print("    setup(cells);", file=f)
     print("  }", file=f)
     print("", file=f)
 
     print("  {}_pm(Module *module) :".format(prefix), file=f)
-    print("      module(module), sigmap(module), setup_done(false), generate_mode(false), rngseed(12345678) {", file=f)
+    print("      module(module), sigmap(module), setup_done(false), generate_mode(false), rngseed(12345678),", file=f)
+    print("      index_stamp(0), index_live_entries(0), index_stale_entries(0), monitor(nullptr), dirty_all(false) {", file=f)
     print("  }", file=f)
     print("", file=f)
 
+    print("  template <typename other_pm>", file=f)
+    print("  {}_pm(Module *module, const vector<Cell*> &cells, other_pm &other) :".format(prefix), file=f)
+    print("      module(module), setup_done(false), generate_mode(false), rngseed(12345678),", file=f)
+    print("      index_stamp(0), index_live_entries(0), index_stale_entries(0), monitor(nullptr), dirty_all(false) {", file=f)
+    print("    log_assert(other.module == module);", file=f)
+    print("    pool<Cell*> removed_cells;", file=f)
+    print("    other.update_sigusers(removed_cells, nullptr);", file=f)
+    print("    sigmap.swap(other.sigmap);", file=f)
+    print("    sigusers.swap(other.sigusers);", file=f)
+    print("    other.dirty_all = true;", file=f)
+    print("    setup_begin();", file=f)
+    print("    for (auto cell : cells)", file=f)
+    print("      if (!removed_cells.count(cell))", file=f)
+    print("        index_cell(cell);", file=f)
+    print("  }", file=f)
+    print("", file=f)
+
+    print("  {}_pm(const {}_pm&) = delete;".format(prefix, prefix), file=f)
+    print("  {}_pm &operator=(const {}_pm&) = delete;".format(prefix, prefix), file=f)
+    print("", file=f)
+
     print("  void setup(const vector<Cell*> &cells) {", file=f)
+    print("    setup_begin();", file=f)
+    print("    setup_sigusers();", file=f)
+    print("    for (auto cell : cells)", file=f)
+    print("      index_cell(cell);", file=f)
+    print("  }", file=f)
+    print("", file=f)
+
+    print("  void setup_begin() {", file=f)
     for current_pattern in sorted(patterns.keys()):
         for s, t in sorted(udata_types[current_pattern].items()):
             if t.endswith("*"):
@@ -498,53 +596,180 @@ with open(outfile, "w") as f:
     current_pattern = None
     print("    log_assert(!setup_done);", file=f)
     print("    setup_done = true;", file=f)
+    print("    monitor = new monitor_t(this);", file=f)
+    print("    module->monitors.insert(monitor);", file=f)
+    print("  }", file=f)
+    print("", file=f)
+
+    print("  void setup_sigusers() {", file=f)
     print("    for (auto port : module->ports)", file=f)
     print("      add_siguser(module->wire(port), nullptr);", file=f)
     print("    for (auto cell : module->cells())", file=f)
     print("      for (auto &conn : cell->connections())", file=f)
     print("        add_siguser(conn.second, cell);", file=f)
-    print("    for (auto cell : cells) {", file=f)
+    print("  }", file=f)
+    print("", file=f)
+
+    print("  void index_cell(Cell *cell) {", file=f)
+    print("    int stamp = ++index_stamp;", file=f)
+    print("    int entries = 0;", file=f)
 
     for index in range(len(blocks)):
         block = blocks[index]
         if block["type"] == "match":
-            print("      do {", file=f)
-            print("        Cell *{} = cell;".format(block["cell"]), file=f)
-            print("        index_{}_value_type value;".format(index), file=f)
-            print("        std::get<0>(value) = cell;", file=f)
+            print("    do {", file=f)
+            print("      Cell *{} = cell;".format(block["cell"]), file=f)
+            print("      index_{}_value_type value;".format(index), file=f)
+            print("      std::get<0>(value) = cell;", file=f)
             loopcnt = 0
             valueidx = 1
             for item in block["setup"]:
                 if item[0] == "select":
-                    print("        if (!({})) continue;".format(item[1]), file=f)
+                    print("      if (!({})) continue;".format(item[1]), file=f)
                 if item[0] == "slice":
-                    print("        int &{} = std::get<{}>(value);".format(item[1], valueidx), file=f)
-                    print("        for ({} = 0; {} < {}; {}++) {{".format(item[1], item[1], item[2], item[1]), file=f)
+                    print("      int &{} = std::get<{}>(value);".format(item[1], valueidx), file=f)
+                    print("      for ({} = 0; {} < {}; {}++) {{".format(item[1], item[1], item[2], item[1]), file=f)
                     valueidx += 1
                     loopcnt += 1
                 if item[0] == "choice":
-                    print("        vector<{}> _pmg_choices_{} = {};".format(item[1], item[2], item[3]), file=f)
-                    print("        for (const {} &{} : _pmg_choices_{}) {{".format(item[1], item[2], item[2]), file=f)
-                    print("        std::get<{}>(value) = {};".format(valueidx, item[2]), file=f)
+                    print("      vector<{}> _pmg_choices_{} = {};".format(item[1], item[2], item[3]), file=f)
+                    print("      for (const {} &{} : _pmg_choices_{}) {{".format(item[1], item[2], item[2]), file=f)
+                    print("      std::get<{}>(value) = {};".format(valueidx, item[2]), file=f)
                     valueidx += 1
                     loopcnt += 1
                 if item[0] == "define":
-                    print("        {} &{} = std::get<{}>(value);".format(item[1], item[2], valueidx), file=f)
-                    print("        {} = {};".format(item[2], item[3]), file=f)
+                    print("      {} &{} = std::get<{}>(value);".format(item[1], item[2], valueidx), file=f)
+                    print("      {} = {};".format(item[2], item[3]), file=f)
                     valueidx += 1
-            print("        index_{}_key_type key;".format(index), file=f)
-            for field, entry in enumerate(block["index"]):
-                print("        std::get<{}>(key) = {};".format(field, entry[1]), file=f)
-            print("        index_{}[key].push_back(value);".format(index), file=f)
+            print("      std::get<{}>(value) = stamp;".format(valueidx), file=f)
+            key_mode = index_key_mode(block)
+            if key_mode == "tuple":
+                print("      index_{}_key_type key;".format(index), file=f)
+                for field, entry in enumerate(block["index"]):
+                    print("      std::get<{}>(key) = {};".format(field, entry[1]), file=f)
+            else:
+                fields = [index_key_field(entry[0], entry[1], False) for entry in block["index"]]
+                print("      index_{}_key_type key = {};".format(index, index_key_value(index, key_mode, fields)), file=f)
+            print("      index_{}[key].push_back(value);".format(index), file=f)
+            print("      entries++;", file=f)
             for i in range(loopcnt):
-                print("        }", file=f)
-            print("      } while (0);", file=f)
+                print("      }", file=f)
+            print("    } while (0);", file=f)
+
+    print("    index_cells[cell] = std::make_pair(stamp, entries);", file=f)
+    print("    index_live_entries += entries;", file=f)
+    print("  }", file=f)
+    print("", file=f)
+
+    print("  void unindex_cell(Cell *cell) {", file=f)
+    print("    auto it = index_cells.find(cell);", file=f)
+    print("    if (it == index_cells.end()) return;", file=f)
+    print("    index_live_entries -= it->second.second;", file=f)
+    print("    index_stale_entries += it->second.second;", file=f)
+    print("    index_cells.erase(it);", file=f)
+    print("  }", file=f)
+    print("", file=f)
+
+    print("  void clear_indices() {", file=f)
+    for index in range(len(blocks)):
+        if blocks[index]["type"] == "match":
+            print("    index_{}.clear();".format(index), file=f)
+    print("    index_sigspecs.clear();", file=f)
+    print("    index_sigbits.clear();", file=f)
+    print("    index_cellptrs.clear();", file=f)
+    print("    index_cells.clear();", file=f)
+    print("    index_live_entries = 0;", file=f)
+    print("    index_stale_entries = 0;", file=f)
+    print("  }", file=f)
+    print("", file=f)
+
+    print("  bool update_sigusers(pool<Cell*> &removed_cells, pool<Cell*> *changed_cells) {", file=f)
+    print("    for (auto cell : autoremove_cells) {", file=f)
+    print("      removed_cells.insert(cell);", file=f)
+    print("      module->remove(cell);", file=f)
+    print("    }", file=f)
+    print("    autoremove_cells.clear();", file=f)
+    print("    blacklist_cells.clear();", file=f)
+    print("", file=f)
+    print("    if (dirty_all) {", file=f)
+    print("      dirty_all = false;", file=f)
+    print("      dirty_cells.clear();", file=f)
+    print("      sigmap.set(module);", file=f)
+    print("      sigusers.clear();", file=f)
+    print("      setup_sigusers();", file=f)
+    print("      return false;", file=f)
+    print("    }", file=f)
+    print("", file=f)
+    print("    if (!dirty_cells.empty()) {", file=f)
+    print("      pool<Cell*> live_cells;", file=f)
+    print("      for (auto cell : module->cells())", file=f)
+    print("        live_cells.insert(cell);", file=f)
+    print("      for (auto &it : dirty_cells) {", file=f)
+    print("        if (changed_cells) changed_cells->insert(it.first);", file=f)
+    print("        for (auto bit : sigmap(it.second)) {", file=f)
+    print("          auto users = sigusers.find(bit);", file=f)
+    print("          if (users == sigusers.end()) continue;", file=f)
+    print("          users->second.erase(it.first);", file=f)
+    print("          if (changed_cells)", file=f)
+    print("            for (auto user : users->second)", file=f)
+    print("              if (user != nullptr) changed_cells->insert(user);", file=f)
+    print("        }", file=f)
+    print("      }", file=f)
+    print("      for (auto &it : dirty_cells) {", file=f)
+    print("        if (!live_cells.count(it.first)) continue;", file=f)
+    print("        for (auto &conn : it.first->connections()) {", file=f)
+    print("          add_siguser(conn.second, it.first);", file=f)
+    print("          if (changed_cells == nullptr) continue;", file=f)
+    print("          for (auto bit : sigmap(conn.second)) {", file=f)
+    print("            if (bit.wire == nullptr) continue;", file=f)
+    print("            for (auto user : sigusers.at(bit))", file=f)
+    print("              if (user != nullptr) changed_cells->insert(user);", file=f)
+    print("          }", file=f)
+    print("        }", file=f)
+    print("      }", file=f)
+    print("      dirty_cells.clear();", file=f)
+    print("    }", file=f)
+    print("    return true;", file=f)
+    print("  }", file=f)
+    print("", file=f)
 
+    print("  void update(const vector<Cell*> &cells) {", file=f)
+    print("    log_assert(setup_done);", file=f)
+    print("    pool<Cell*> removed_cells, changed_cells;", file=f)
+    print("    if (!update_sigusers(removed_cells, &changed_cells)) {", file=f)
+    print("      clear_indices();", file=f)
+    print("      for (auto cell : cells)", file=f)
+    print("        if (!removed_cells.count(cell))", file=f)
+    print("          index_cell(cell);", file=f)
+    print("      return;", file=f)
     print("    }", file=f)
+    print("    for (auto cell : changed_cells)", file=f)
+    print("      unindex_cell(cell);", file=f)
+    print("", file=f)
+    print("    pool<Cell*> cell_set;", file=f)
+    print("    for (auto cell : cells)", file=f)
+    print("      if (!removed_cells.count(cell))", file=f)
+    print("        cell_set.insert(cell);", file=f)
+    print("    vector<Cell*> old_cells;", file=f)
+    print("    for (auto &it : index_cells)", file=f)
+    print("      if (!cell_set.count(it.first))", file=f)
+    print("        old_cells.push_back(it.first);", file=f)
+    print("    for (auto cell : old_cells)", file=f)
+    print("      unindex_cell(cell);", file=f)
+    print("", file=f)
+    print("    if (index_stale_entries > index_live_entries)", file=f)
+    print("      clear_indices();", file=f)
+    print("    for (auto cell : cells)", file=f)
+    print("      if (cell_set.count(cell) && !index_cells.count(cell))", file=f)
+    print("        index_cell(cell);", file=f)
     print("  }", file=f)
     print("", file=f)
 
     print("  ~{}_pm() {{".format(prefix), file=f)
+    print("    if (monitor != nullptr) {", file=f)
+    print("      module->monitors.erase(monitor);", file=f)
+    print("      delete monitor;", file=f)
+    print("    }", file=f)
     print("    for (auto cell : autoremove_cells)", file=f)
     print("      module->remove(cell);", file=f)
     print("  }", file=f)
@@ -717,10 +942,25 @@ with open(outfile, "w") as f:
                     print("    }", file=f)
 
             print("", file=f)
-            print("    index_{}_key_type key;".format(index), file=f)
-            for field, entry in enumerate(block["index"]):
-                print("    std::get<{}>(key) = {};".format(field, entry[2]), file=f)
-            print("    auto cells_ptr = index_{}.find(key);".format(index), file=f)
+            key_mode = index_key_mode(block)
+            if key_mode == "tuple":
+                print("    index_{}_key_type key;".format(index), file=f)
+                for field, entry in enumerate(block["index"]):
+                    print("    std::get<{}>(key) = {};".format(field, entry[2]), file=f)
+                print("    auto cells_ptr = index_{}.find(key);".format(index), file=f)
+            else:
+                fields = list()
+                interned = list()
+                for field, entry in enumerate(block["index"]):
+                    print("    int _pmg_key_{} = {};".format(field, index_key_field(entry[0], entry[2], True)), file=f)
+                    fields.append("_pmg_key_{}".format(field))
+                    if entry[0].replace(" ", "") in interned_index_types:
+                        interned.append("_pmg_key_{} >= 0".format(field))
+                key = index_key_value(index, key_mode, fields)
+                if len(interned):
+                    print("    auto cells_ptr = {} ? index_{}.find({}) : index_{}.end();".format(" && ".join(interned), index, key, index), file=f)
+                else:
+                    print("    auto cells_ptr = index_{}.find({});".format(index, key), file=f)
 
             if block["semioptional"] or block["genargs"] is not None:
                 print("    bool found_any_match = false;", file=f)
@@ -741,6 +981,7 @@ with open(outfile, "w") as f:
                 if item[0] == "define":
                     print("        const {} &{} YS_ATTRIBUTE(unused) = std::get<{}>(cells[_pmg_idx]);".format(item[1], item[2], valueidx), file=f)
                     valueidx += 1
+            print("        if (index_stale_entries && std::get<{}>(cells[_pmg_idx]) != index_stamp_of({})) continue;".format(valueidx, block["cell"]), file=f)
             print("        if (blacklist_cells.count({})) continue;".format(block["cell"]), file=f)
             for expr in block["filter"]:
                 print("        if (!({})) continue;".format(expr), file=f)
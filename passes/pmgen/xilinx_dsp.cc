@@ -338,11 +338,11 @@ void xilinx_dsp_pack(xilinx_dsp_pm &pm)
 
 		if (st.overflow->type == ID($ge)) {
 			Const B = st.overflow->getPort(ID(B)).as_const();
-			log_assert(std::count(B.bits.begin(), B.bits.end(), State::S1) == 1);
+			log_assert(std::count(B.begin(), B.end(), State::S1) == 1);
 			// Since B is an exact power of 2, subtract 1
 			//   by inverting all bits up until hitting
 			//   that one hi bit
-			for (auto &b : B.bits)
+			for (auto &b : B.bits())
 				if (b == State::S0) b = State::S1;
 				else if (b == State::S1) {
 					b = State::S0;
@@ -397,7 +397,7 @@ void xilinx_dsp_pack(xilinx_dsp_pm &pm)
 					continue;
 				for (int i = c.offset; i < c.offset+c.width; i++) {
 					log_assert(it->second[i] == State::S0 || it->second[i] == State::Sx);
-					it->second[i] = State::Sx;
+					it->second.bits()[i] = State::Sx;
 				}
 			}
 		};
@@ -442,13 +442,17 @@ void xilinx_dsp_pack(xilinx_dsp_pm &pm)
 		if (st.ffM) {
 			SigSpec M; // unused
 			f(M, st.ffM, st.ffMcemux, st.ffMcepol, ID(CEM), st.ffMrstmux, st.ffMrstpol, ID(RSTM));
-			st.ffM->connections_.at(ID(Q)).replace(st.sigM, pm.module->addWire(NEW_ID, GetSize(st.sigM)));
+			SigSpec Q = st.ffM->getPort(ID(Q));
+			Q.replace(st.sigM, pm.module->addWire(NEW_ID, GetSize(st.sigM)));
+			st.ffM->setPort(ID(Q), Q);
 			cell->setParam(ID(MREG), State::S1);
 		}
 		if (st.ffP) {
 			SigSpec P; // unused
 			f(P, st.ffP, st.ffPcemux, st.ffPcepol, ID(CEP), st.ffPrstmux, st.ffPrstpol, ID(RSTP));
-			st.ffP->connections_.at(ID(Q)).replace(st.sigP, pm.module->addWire(NEW_ID, GetSize(st.sigP)));
+			SigSpec Q = st.ffP->getPort(ID(Q));
+			Q.replace(st.sigP, pm.module->addWire(NEW_ID, GetSize(st.sigP)));
+			st.ffP->setPort(ID(Q), Q);
 			cell->setParam(ID(PREG), State::S1);
 		}
 
@@ -590,7 +594,7 @@ void xilinx_dsp48a_pack(xilinx_dsp48a_pm &pm)
 					continue;
 				for (int i = c.offset; i < c.offset+c.width; i++) {
 					log_assert(it->second[i] == State::S0 || it->second[i] == State::Sx);
-					it->second[i] = State::Sx;
+					it->second.bits()[i] = State::Sx;
 				}
 			}
 		};
@@ -631,13 +635,17 @@ void xilinx_dsp48a_pack(xilinx_dsp48a_pm &pm)
 		if (st.ffM) {
 			SigSpec M; // unused
 			f(M, st.ffM, st.ffMcemux, st.ffMcepol, ID(CEM), st.ffMrstmux, st.ffMrstpol, ID(RSTM));
-			st.ffM->connections_.at(ID(Q)).replace(st.sigM, pm.module->addWire(NEW_ID, GetSize(st.sigM)));
+			SigSpec Q = st.ffM->getPort(ID(Q));
+			Q.replace(st.sigM, pm.module->addWire(NEW_ID, GetSize(st.sigM)));
+			st.ffM->setPort(ID(Q), Q);
 			cell->setParam(ID(MREG), State::S1);
 		}
 		if (st.ffP) {
 			SigSpec P; // unused
 			f(P, st.ffP, st.ffPcemux, st.ffPcepol, ID(CEP), st.ffPrstmux, st.ffPrstpol, ID(RSTP));
-			st.ffP->connections_.at(ID(Q)).replace(st.sigP, pm.module->addWire(NEW_ID, GetSize(st.sigP)));
+			SigSpec Q = st.ffP->getPort(ID(Q));
+			Q.replace(st.sigP, pm.module->addWire(NEW_ID, GetSize(st.sigP)));
+			st.ffP->setPort(ID(Q), Q);
 			cell->setParam(ID(PREG), State::S1);
 		}
 
@@ -719,7 +727,7 @@ void xilinx_dsp_packC(xilinx_dsp_CREG_pm &pm)
 					continue;
 				for (int i = c.offset; i < c.offset+c.width; i++) {
 					log_assert(it->second[i] == State::S0 || it->second[i] == State::Sx);
-					it->second[i] = State::Sx;
+					it->second.bits()[i] = State::Sx;
 				}
 			}
 		};
@@ -742,6 +750,31 @@ void xilinx_dsp_packC(xilinx_dsp_CREG_pm &pm)
 	pm.blacklist(cell);
 }
 
+// Separating out CREG packing is necessary since there is no guarantee that
+//   the cell ordering corresponds to the "expected" case (i.e. the order in
+//   which they appear in the source) thus the possiblity existed that a
+//   register got packed as a CREG into a downstream DSP that should have
+//   otherwise been a PREG of an upstream DSP that had not been visited yet
+//
+// Each matcher takes over the SigMap and signal users of the previous one,
+//   which only need updating for the cells the previous matcher changed
+void xilinx_dsp_packC_cascade(xilinx_dsp_CREG_pm &pm)
+{
+	pm.run_xilinx_dsp_packC(xilinx_dsp_packC);
+
+	// Lastly, identify and utilise PCOUT -> PCIN, ACOUT -> ACIN, and
+	//   BCOUT-> BCIN dedicated cascade chains
+	xilinx_dsp_cascade_pm cascade_pm(pm.module, pm.module->selected_cells(), pm);
+	cascade_pm.run_xilinx_dsp_cascade();
+}
+
+template<typename pm_t>
+void xilinx_dsp_pack_packC_cascade(pm_t &pack_pm)
+{
+	xilinx_dsp_CREG_pm pm(pack_pm.module, pack_pm.module->selected_cells(), pack_pm);
+	xilinx_dsp_packC_cascade(pm);
+}
+
 struct XilinxDspPass : public Pass {
 	XilinxDspPass() : Pass("xilinx_dsp", "Xilinx: pack resources into DSPs") { }
 	void help() YS_OVERRIDE
@@ -823,28 +856,14 @@ struct XilinxDspPass : public Pass {
 			if (family == "xc7") {
 				xilinx_dsp_pm pm(module, module->selected_cells());
 				pm.run_xilinx_dsp_pack(xilinx_dsp_pack);
+				xilinx_dsp_pack_packC_cascade(pm);
 			} else if (family == "xc6s" || family == "xc3sda") {
 				xilinx_dsp48a_pm pm(module, module->selected_cells());
 				pm.run_xilinx_dsp48a_pack(xilinx_dsp48a_pack);
-			}
-			// Separating out CREG packing is necessary since there
-			//   is no guarantee that the cell ordering corresponds
-			//   to the "expected" case (i.e. the order in which
-			//   they appear in the source) thus the possiblity
-			//   existed that a register got packed as a CREG into a
-			//   downstream DSP that should have otherwise been a
-			//   PREG of an upstream DSP that had not been visited
-			//   yet
-			{
+				xilinx_dsp_pack_packC_cascade(pm);
+			} else {
 				xilinx_dsp_CREG_pm pm(module, module->selected_cells());
-				pm.run_xilinx_dsp_packC(xilinx_dsp_packC);
-			}
-			// Lastly, identify and utilise PCOUT -> PCIN,
-			//   ACOUT -> ACIN, and BCOUT-> BCIN dedicated cascade
-			//   chains
-			{
-				xilinx_dsp_cascade_pm pm(module, module->selected_cells());
-				pm.run_xilinx_dsp_cascade();
+				xilinx_dsp_packC_cascade(pm);
 			}
 		}
 	}
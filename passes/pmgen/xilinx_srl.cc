@@ -20,27 +20,28 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
+#include "kernel/ffchain.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
 #include "passes/pmgen/xilinx_srl_pm.h"
 
-void run_fixed(xilinx_srl_pm &pm)
+// The chain is in the order of the 'fixed' pattern, from the last flop of the
+// shift register to the first.
+void convert_fixed_chain(Module *module, const vector<Cell*> &chain)
 {
-	auto &st = pm.st_fixed;
-	auto &ud = pm.ud_fixed;
-	log("Found fixed chain of length %d (%s):\n", GetSize(ud.longest_chain), log_id(st.first->type));
+	log("Found fixed chain of length %d (%s):\n", GetSize(chain), log_id(chain.front()->type));
 
 	SigSpec initval;
-	for (auto cell : ud.longest_chain) {
+	for (auto cell : chain) {
 		log_debug("    %s\n", log_id(cell));
 		if (cell->type.in(ID($_DFF_N_), ID($_DFF_P_), ID($_DFFE_NN_), ID($_DFFE_NP_), ID($_DFFE_PN_), ID($_DFFE_PP_))) {
 			SigBit Q = cell->getPort(ID(Q));
 			log_assert(Q.wire);
 			auto it = Q.wire->attributes.find(ID(init));
 			if (it != Q.wire->attributes.end()) {
-				auto &i = it->second[Q.offset];
+				auto &i = it->second.bits()[Q.offset];
 				initval.append(i);
 				i = State::Sx;
 			}
@@ -55,16 +56,15 @@ void run_fixed(xilinx_srl_pm &pm)
 		}
 		else
 			log_abort();
-		pm.autoremove(cell);
 	}
 
-	auto first_cell = ud.longest_chain.back();
-	auto last_cell = ud.longest_chain.front();
-	Cell *c = pm.module->addCell(NEW_ID, ID($__XILINX_SHREG_));
-	pm.module->swap_names(c, first_cell);
+	auto first_cell = chain.back();
+	auto last_cell = chain.front();
+	Cell *c = module->addCell(NEW_ID, ID($__XILINX_SHREG_));
+	module->swap_names(c, first_cell);
 
 	if (first_cell->type.in(ID($_DFF_N_), ID($_DFF_P_), ID($_DFFE_NN_), ID($_DFFE_NP_), ID($_DFFE_PN_), ID($_DFFE_PP_), ID(FDRE), ID(FDRE_1))) {
-		c->setParam(ID(DEPTH), GetSize(ud.longest_chain));
+		c->setParam(ID(DEPTH), GetSize(chain));
 		c->setParam(ID(INIT), initval.as_const());
 		if (first_cell->type.in(ID($_DFF_P_), ID($_DFFE_PN_), ID($_DFFE_PP_)))
 			c->setParam(ID(CLKPOL), 1);
@@ -88,7 +88,7 @@ void run_fixed(xilinx_srl_pm &pm)
 		c->setPort(ID(C), first_cell->getPort(ID(C)));
 		c->setPort(ID(D), first_cell->getPort(ID(D)));
 		c->setPort(ID(Q), last_cell->getPort(ID(Q)));
-		c->setPort(ID(L), GetSize(ud.longest_chain)-1);
+		c->setPort(ID(L), GetSize(chain)-1);
 		if (first_cell->type.in(ID($_DFF_N_), ID($_DFF_P_)))
 			c->setPort(ID(E), State::S1);
 		else if (first_cell->type.in(ID($_DFFE_NN_), ID($_DFFE_NP_), ID($_DFFE_PN_), ID($_DFFE_PP_)))
@@ -101,9 +101,89 @@ void run_fixed(xilinx_srl_pm &pm)
 	else
 		log_abort();
 
+	for (auto cell : chain)
+		module->remove(cell);
+
 	log("    -> %s (%s)\n", log_id(c), log_id(c->type));
 }
 
+// Finds the same chains as the 'fixed' pattern in xilinx_srl.pmg, which walks
+// each chain with one level of recursion per flop. Here all flops are linked
+// once with an FfChainIndex, and the chains are read from it.
+void run_fixed(Module *module, int minlen)
+{
+	SigMap sigmap(module);
+
+	// as nusers() in the pattern: the number of cells and module ports
+	// connected to each bit
+	dict<SigBit, int> bit_users;
+	for (auto port : module->ports)
+		for (auto bit : sigmap(module->wire(port)))
+			if (bit.wire != nullptr)
+				bit_users[bit]++;
+	for (auto cell : module->cells()) {
+		pool<SigBit> cell_bits;
+		for (auto &conn : cell->connections())
+			for (auto bit : sigmap(conn.second))
+				if (bit.wire != nullptr)
+					cell_bits.insert(bit);
+		for (auto bit : cell_bits)
+			bit_users[bit]++;
+	}
+
+	FfChainIndex ff_chains;
+	for (auto cell : module->selected_cells())
+	{
+		if (!cell->type.in(ID($_DFF_N_), ID($_DFF_P_), ID($_DFFE_NN_), ID($_DFFE_NP_), ID($_DFFE_PN_), ID($_DFFE_PP_), ID(FDRE), ID(FDRE_1)))
+			continue;
+		if (cell->has_keep_attr())
+			continue;
+		if (cell->type == ID(FDRE) && (cell->parameters.at(ID(IS_R_INVERTED), State::S0).as_bool() ||
+				cell->parameters.at(ID(IS_D_INVERTED), State::S0).as_bool()))
+			continue;
+		if (cell->type.in(ID(FDRE), ID(FDRE_1)) && !sigmap(cell->connections_.at(ID(R), State::S0)).is_fully_zero())
+			continue;
+		ff_chains.add(cell, sigmap(cell->getPort(ID(D))).as_bit(), sigmap(cell->getPort(ID(Q))).as_bit());
+	}
+
+	// i is the 'next' cell of the pattern, driving the D input of j
+	ff_chains.link([&](int i, int j) {
+		Cell *next = ff_chains.cells[i];
+		Cell *prev = ff_chains.cells[j];
+		SigBit d_bit = ff_chains.d_bits[i];
+		if (next->type != prev->type)
+			return false;
+		if (d_bit.wire == nullptr || d_bit.wire->get_bool_attribute(ID::keep))
+			return false;
+		if (bit_users.at(ff_chains.q_bits[i], 0) != 2)
+			return false;
+		if (sigmap(next->getPort(ID(C))) != sigmap(prev->getPort(ID(C))))
+			return false;
+		IdString en_port = next->type.in(ID(FDRE), ID(FDRE_1)) ? ID(CE) : next->type.begins_with("$_DFFE_") ? ID(E) : IdString();
+		if (en_port != IdString() && sigmap(next->getPort(en_port)) != sigmap(prev->getPort(en_port)))
+			return false;
+		if (next->type == ID(FDRE) && next->parameters.at(ID(IS_C_INVERTED), State::S0).as_bool() !=
+				prev->parameters.at(ID(IS_C_INVERTED), State::S0).as_bool())
+			return false;
+		return true;
+	});
+
+	vector<vector<Cell*>> chains;
+	for (int i = 0; i < GetSize(ff_chains.cells); i++) {
+		if (ff_chains.next[i] >= 0)
+			continue;
+		vector<int> chain = ff_chains.chain(i, true);
+		if (GetSize(chain) < minlen)
+			continue;
+		chains.emplace_back();
+		for (int j : chain)
+			chains.back().push_back(ff_chains.cells[j]);
+	}
+
+	for (auto &chain : chains)
+		convert_fixed_chain(module, chain);
+}
+
 void run_variable(xilinx_srl_pm &pm)
 {
 	auto &st = pm.st_variable;
@@ -121,7 +201,7 @@ void run_variable(xilinx_srl_pm &pm)
 			log_assert(Q.wire);
 			auto it = Q.wire->attributes.find(ID(init));
 			if (it != Q.wire->attributes.end()) {
-				auto &i = it->second[Q.offset];
+				auto &i = it->second.bits()[Q.offset];
 				initval.append(i);
 				i = State::Sx;
 			}
@@ -243,14 +323,13 @@ struct XilinxSrlPass : public Pass {
 			log_cmd_error("'-fixed' and/or '-variable' must be specified.\n");
 
 		for (auto module : design->selected_modules()) {
-			auto pm = xilinx_srl_pm(module, module->selected_cells());
-			pm.ud_fixed.minlen = minlen;
-			pm.ud_variable.minlen = minlen;
-
 			if (fixed)
-				pm.run_fixed(run_fixed);
-			if (variable)
+				run_fixed(module, minlen);
+			if (variable) {
+				xilinx_srl_pm pm(module, module->selected_cells());
+				pm.ud_variable.minlen = minlen;
 				pm.run_variable(run_variable);
+			}
 		}
 	}
 } XilinxSrlPass;
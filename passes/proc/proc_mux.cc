@@ -20,6 +20,7 @@
 #include "kernel/register.h"
 #include "kernel/bitpattern.h"
 #include "kernel/log.h"
+#include "kernel/threadpool.h"
 #include <sstream>
 #include <stdlib.h>
 #include <stdio.h>
@@ -106,20 +107,35 @@ struct SigSnippets
 	}
 };
 
+// For each switch and each case the snippets assigned somewhere below it, so
+// that the switches and cases not assigning the current snippet are skipped
+// without walking them. This keeps wide case statements with many snippets
+// from being scanned once for every snippet.
 struct SnippetSwCache
 {
 	dict<RTLIL::SwitchRule*, pool<RTLIL::SigBit>, hash_ptr_ops> full_case_bits_cache;
+	dict<RTLIL::SwitchRule*, std::vector<int>, hash_ptr_ops> pgroups_cache;
 	dict<RTLIL::SwitchRule*, pool<int>, hash_ptr_ops> cache;
+	dict<const RTLIL::CaseRule*, pool<int>, hash_ptr_ops> case_cache;
 	const SigSnippets *snippets;
 	int current_snippet;
 
 	bool check(RTLIL::SwitchRule *sw)
 	{
-		return cache[sw].count(current_snippet) != 0;
+		auto it = cache.find(sw);
+		return it != cache.end() && it->second.count(current_snippet) != 0;
 	}
 
-	void insert(const RTLIL::CaseRule *cs, vector<RTLIL::SwitchRule*> &sw_stack)
+	bool check(const RTLIL::CaseRule *cs)
 	{
+		auto it = case_cache.find(cs);
+		return it != case_cache.end() && it->second.count(current_snippet) != 0;
+	}
+
+	void insert(const RTLIL::CaseRule *cs, vector<RTLIL::SwitchRule*> &sw_stack, vector<const RTLIL::CaseRule*> &cs_stack)
+	{
+		cs_stack.push_back(cs);
+
 		for (auto &action : cs->actions)
 		for (auto bit : action.first) {
 			int sn = snippets->bit2snippet.at(bit, -1);
@@ -127,20 +143,128 @@ struct SnippetSwCache
 				continue;
 			for (auto sw : sw_stack)
 				cache[sw].insert(sn);
+			for (auto cs2 : cs_stack)
+				case_cache[cs2].insert(sn);
 		}
 
 		for (auto sw : cs->switches) {
 			sw_stack.push_back(sw);
 			for (auto cs2 : sw->cases)
-				insert(cs2, sw_stack);
+				insert(cs2, sw_stack, cs_stack);
 			sw_stack.pop_back();
 		}
+
+		cs_stack.pop_back();
 	}
 
 	void insert(const RTLIL::CaseRule *cs)
 	{
 		vector<RTLIL::SwitchRule*> sw_stack;
-		insert(cs, sw_stack);
+		vector<const RTLIL::CaseRule*> cs_stack;
+		insert(cs, sw_stack, cs_stack);
+	}
+};
+
+// The mux trees of one process. They are generated into a scratch module, with
+// names numbered from zero, so that different processes can be converted
+// concurrently. commit() then copies them into the module in creation order,
+// with the names renumbered from autoidx, which gives the same result as
+// generating them in the module directly.
+struct ProcMuxJob
+{
+	RTLIL::Module *mod;
+	RTLIL::Process *proc;
+	std::unique_ptr<RTLIL::Module> scratch;
+	std::vector<RTLIL::Wire*> wires;
+	std::vector<RTLIL::Cell*> cells;
+	int num_ids = 0;
+
+	// the compare logic of each case, shared by the mux trees of all snippets
+	dict<RTLIL::CaseRule*, RTLIL::SigSpec, hash_ptr_ops> cmp_cache;
+
+	// memories for the ROMs extracted from constant tables, see gen_rom()
+	struct Rom {
+		RTLIL::IdString name;
+		int width, size;
+	};
+	bool rom_mode = false;
+	std::vector<Rom> roms;
+
+	ProcMuxJob(RTLIL::Module *mod, RTLIL::Process *proc) : mod(mod), proc(proc), scratch(new RTLIL::Module) { }
+
+	std::string new_name()
+	{
+		return stringf("$procmux$%d", num_ids++);
+	}
+
+	RTLIL::Wire *addWire(RTLIL::IdString name, int width = 1)
+	{
+		RTLIL::Wire *wire = scratch->addWire(name, width);
+		wires.push_back(wire);
+		return wire;
+	}
+
+	RTLIL::Cell *addCell(RTLIL::IdString name, RTLIL::IdString type)
+	{
+		RTLIL::Cell *cell = scratch->addCell(name, type);
+		cells.push_back(cell);
+		return cell;
+	}
+
+	void connect(const RTLIL::SigSig &conn)
+	{
+		scratch->connect(conn);
+	}
+
+	void commit()
+	{
+		int base = autoidx;
+		autoidx += num_ids;
+
+		auto global_name = [&](RTLIL::IdString name) {
+			const std::string &str = name.str();
+			size_t prefix_len = strlen("$procmux$");
+			size_t end = str.find_first_not_of("0123456789", prefix_len);
+			int idx = atoi(str.substr(prefix_len, end - prefix_len).c_str());
+			return stringf("$procmux$%d", base + idx) + (end == std::string::npos ? "" : str.substr(end));
+		};
+
+		for (auto &rom : roms) {
+			RTLIL::Memory *memory = new RTLIL::Memory;
+			memory->name = global_name(rom.name);
+			memory->width = rom.width;
+			memory->size = rom.size;
+			mod->memories[memory->name] = memory;
+		}
+
+		dict<RTLIL::Wire*, RTLIL::Wire*> wire_map;
+		for (auto wire : wires)
+			wire_map[wire] = mod->addWire(global_name(wire->name), wire);
+
+		auto map_sig = [&](const RTLIL::SigSpec &sig) {
+			RTLIL::SigSpec new_sig;
+			for (auto chunk : sig.chunks()) {
+				if (chunk.wire != nullptr && wire_map.count(chunk.wire))
+					chunk.wire = wire_map.at(chunk.wire);
+				new_sig.append(chunk);
+			}
+			return new_sig;
+		};
+
+		for (auto cell : cells) {
+			RTLIL::Cell *new_cell = mod->addCell(global_name(cell->name), cell->type);
+			new_cell->parameters = cell->parameters;
+			new_cell->attributes = cell->attributes;
+			if (new_cell->parameters.count("\\MEMID"))
+				new_cell->parameters["\\MEMID"] = RTLIL::Const(global_name(cell->parameters.at("\\MEMID").decode_string()));
+			for (auto &conn : cell->connections())
+				new_cell->setPort(conn.first, map_sig(conn.second));
+		}
+
+		for (auto &conn : scratch->connections())
+			mod->connect(map_sig(conn.first), map_sig(conn.second));
+
+		scratch.reset();
 	}
 };
 
@@ -150,12 +274,16 @@ void apply_attrs(RTLIL::Cell *cell, const RTLIL::SwitchRule *sw, const RTLIL::Ca
 	cell->add_strpool_attribute("\\src", cs->get_strpool_attribute("\\src"));
 }
 
-RTLIL::SigSpec gen_cmp(RTLIL::Module *mod, const RTLIL::SigSpec &signal, const std::vector<RTLIL::SigSpec> &compare, RTLIL::SwitchRule *sw, RTLIL::CaseRule *cs, bool ifxmode)
+RTLIL::SigSpec gen_cmp(ProcMuxJob &job, const RTLIL::SigSpec &signal, const std::vector<RTLIL::SigSpec> &compare, RTLIL::SwitchRule *sw, RTLIL::CaseRule *cs, bool ifxmode)
 {
-	std::stringstream sstr;
-	sstr << "$procmux$" << (autoidx++);
+	auto it = job.cmp_cache.find(cs);
+	if (it != job.cmp_cache.end())
+		return it->second;
 
-	RTLIL::Wire *cmp_wire = mod->addWire(sstr.str() + "_CMP", 0);
+	RTLIL::SigSpec &ctrl_sig = job.cmp_cache[cs];
+	std::string name = job.new_name();
+
+	RTLIL::Wire *cmp_wire = job.addWire(name + "_CMP", 0);
 
 	for (auto comp : compare)
 	{
@@ -169,16 +297,16 @@ RTLIL::SigSpec gen_cmp(RTLIL::Module *mod, const RTLIL::SigSpec &signal, const s
 				comp.remove(i--);
 			}
 		if (comp.size() == 0)
-			return RTLIL::SigSpec();
+			return ctrl_sig;
 
 		if (sig.size() == 1 && comp == RTLIL::SigSpec(1,1) && !ifxmode)
 		{
-			mod->connect(RTLIL::SigSig(RTLIL::SigSpec(cmp_wire, cmp_wire->width++), sig));
+			job.connect(RTLIL::SigSig(RTLIL::SigSpec(cmp_wire, cmp_wire->width++), sig));
 		}
 		else
 		{
 			// create compare cell
-			RTLIL::Cell *eq_cell = mod->addCell(stringf("%s_CMP%d", sstr.str().c_str(), cmp_wire->width), ifxmode ? "$eqx" : "$eq");
+			RTLIL::Cell *eq_cell = job.addCell(stringf("%s_CMP%d", name.c_str(), cmp_wire->width), ifxmode ? "$eqx" : "$eq");
 			apply_attrs(eq_cell, sw, cs);
 
 			eq_cell->parameters["\\A_SIGNED"] = RTLIL::Const(0);
@@ -201,10 +329,10 @@ RTLIL::SigSpec gen_cmp(RTLIL::Module *mod, const RTLIL::SigSpec &signal, const s
 	}
 	else
 	{
-		ctrl_wire = mod->addWire(sstr.str() + "_CTRL");
+		ctrl_wire = job.addWire(name + "_CTRL");
 
 		// reduce cmp vector to one logic signal
-		RTLIL::Cell *any_cell = mod->addCell(sstr.str() + "_ANY", "$reduce_or");
+		RTLIL::Cell *any_cell = job.addCell(name + "_ANY", "$reduce_or");
 		apply_attrs(any_cell, sw, cs);
 
 		any_cell->parameters["\\A_SIGNED"] = RTLIL::Const(0);
@@ -215,31 +343,31 @@ RTLIL::SigSpec gen_cmp(RTLIL::Module *mod, const RTLIL::SigSpec &signal, const s
 		any_cell->setPort("\\Y", RTLIL::SigSpec(ctrl_wire));
 	}
 
-	return RTLIL::SigSpec(ctrl_wire);
+	ctrl_sig = RTLIL::SigSpec(ctrl_wire);
+	return ctrl_sig;
 }
 
-RTLIL::SigSpec gen_mux(RTLIL::Module *mod, const RTLIL::SigSpec &signal, const std::vector<RTLIL::SigSpec> &compare, RTLIL::SigSpec when_signal, RTLIL::SigSpec else_signal, RTLIL::Cell *&last_mux_cell, RTLIL::SwitchRule *sw, RTLIL::CaseRule *cs, bool ifxmode)
+RTLIL::SigSpec gen_mux(ProcMuxJob &job, const RTLIL::SigSpec &signal, const std::vector<RTLIL::SigSpec> &compare, RTLIL::SigSpec when_signal, RTLIL::SigSpec else_signal, RTLIL::Cell *&last_mux_cell, RTLIL::SwitchRule *sw, RTLIL::CaseRule *cs, bool ifxmode)
 {
 	log_assert(when_signal.size() == else_signal.size());
 
-	std::stringstream sstr;
-	sstr << "$procmux$" << (autoidx++);
+	std::string name = job.new_name();
 
 	// the trivial cases
 	if (compare.size() == 0 || when_signal == else_signal)
 		return when_signal;
 
 	// compare results
-	RTLIL::SigSpec ctrl_sig = gen_cmp(mod, signal, compare, sw, cs, ifxmode);
+	RTLIL::SigSpec ctrl_sig = gen_cmp(job, signal, compare, sw, cs, ifxmode);
 	if (ctrl_sig.size() == 0)
 		return when_signal;
 	log_assert(ctrl_sig.size() == 1);
 
 	// prepare multiplexer output signal
-	RTLIL::Wire *result_wire = mod->addWire(sstr.str() + "_Y", when_signal.size());
+	RTLIL::Wire *result_wire = job.addWire(name + "_Y", when_signal.size());
 
 	// create the multiplexer itself
-	RTLIL::Cell *mux_cell = mod->addCell(sstr.str(), "$mux");
+	RTLIL::Cell *mux_cell = job.addCell(name, "$mux");
 	apply_attrs(mux_cell, sw, cs);
 
 	mux_cell->parameters["\\WIDTH"] = RTLIL::Const(when_signal.size());
@@ -252,7 +380,7 @@ RTLIL::SigSpec gen_mux(RTLIL::Module *mod, const RTLIL::SigSpec &signal, const s
 	return RTLIL::SigSpec(result_wire);
 }
 
-void append_pmux(RTLIL::Module *mod, const RTLIL::SigSpec &signal, const std::vector<RTLIL::SigSpec> &compare, RTLIL::SigSpec when_signal, RTLIL::Cell *last_mux_cell, RTLIL::SwitchRule *sw, RTLIL::CaseRule *cs, bool ifxmode)
+void append_pmux(ProcMuxJob &job, const RTLIL::SigSpec &signal, const std::vector<RTLIL::SigSpec> &compare, RTLIL::SigSpec when_signal, RTLIL::Cell *last_mux_cell, RTLIL::SwitchRule *sw, RTLIL::CaseRule *cs, bool ifxmode)
 {
 	log_assert(last_mux_cell != NULL);
 	log_assert(when_signal.size() == last_mux_cell->getPort("\\A").size());
@@ -260,7 +388,7 @@ void append_pmux(RTLIL::Module *mod, const RTLIL::SigSpec &signal, const std::ve
 	if (when_signal == last_mux_cell->getPort("\\A"))
 		return;
 
-	RTLIL::SigSpec ctrl_sig = gen_cmp(mod, signal, compare, sw, cs, ifxmode);
+	RTLIL::SigSpec ctrl_sig = gen_cmp(job, signal, compare, sw, cs, ifxmode);
 	log_assert(ctrl_sig.size() == 1);
 	last_mux_cell->type = "$pmux";
 
@@ -318,46 +446,30 @@ const pool<SigBit> &get_full_case_bits(SnippetSwCache &swcache, RTLIL::SwitchRul
 	return swcache.full_case_bits_cache.at(sw);
 }
 
-RTLIL::SigSpec signal_to_mux_tree(RTLIL::Module *mod, SnippetSwCache &swcache, dict<RTLIL::SwitchRule*, bool, hash_ptr_ops> &swpara,
-		RTLIL::CaseRule *cs, const RTLIL::SigSpec &sig, const RTLIL::SigSpec &defval, bool ifxmode)
+const std::vector<int> &get_pgroups(SnippetSwCache &swcache, RTLIL::SwitchRule *sw, bool ifxmode)
 {
-	RTLIL::SigSpec result = defval;
-
-	for (auto &action : cs->actions) {
-		sig.replace(action.first, action.second, &result);
-		action.first.remove2(sig, &action.second);
-	}
-
-	for (auto sw : cs->switches)
+	if (!swcache.pgroups_cache.count(sw))
 	{
-		if (!swcache.check(sw))
-			continue;
-
 		// detect groups of parallel cases
 		std::vector<int> pgroups(sw->cases.size());
 		bool is_simple_parallel_case = true;
 
 		if (!sw->get_bool_attribute("\\parallel_case")) {
-			if (!swpara.count(sw)) {
-				pool<Const> case_values;
-				for (size_t i = 0; i < sw->cases.size(); i++) {
-					RTLIL::CaseRule *cs2 = sw->cases[i];
-					for (auto pat : cs2->compare) {
-						if (!pat.is_fully_def())
-							goto not_simple_parallel_case;
-						Const cpat = pat.as_const();
-						if (case_values.count(cpat))
-							goto not_simple_parallel_case;
-						case_values.insert(cpat);
-					}
+			pool<Const> case_values;
+			for (size_t i = 0; i < sw->cases.size(); i++) {
+				RTLIL::CaseRule *cs2 = sw->cases[i];
+				for (auto pat : cs2->compare) {
+					if (!pat.is_fully_def())
+						goto not_simple_parallel_case;
+					Const cpat = pat.as_const();
+					if (case_values.count(cpat))
+						goto not_simple_parallel_case;
+					case_values.insert(cpat);
 				}
-				if (0)
-			not_simple_parallel_case:
-					is_simple_parallel_case = false;
-				swpara[sw] = is_simple_parallel_case;
-			} else {
-				is_simple_parallel_case = swpara.at(sw);
 			}
+			if (0)
+		not_simple_parallel_case:
+				is_simple_parallel_case = false;
 		}
 
 		if (!is_simple_parallel_case) {
@@ -387,32 +499,168 @@ RTLIL::SigSpec signal_to_mux_tree(RTLIL::Module *mod, SnippetSwCache &swcache, d
 			}
 		}
 
+		pgroups.swap(swcache.pgroups_cache[sw]);
+	}
+
+	return swcache.pgroups_cache.at(sw);
+}
+
+// A switch over a narrow signal whose cases only assign constants to the
+// snippet (with a default case or a constant default value) is a lookup table. It is mapped to
+// a ROM, i.e. a memory with a $meminit and an asynchronous $memrd cell,
+// instead of a tree of compare cells and multiplexers. Returns false without
+// changing anything if the switch is not such a table.
+bool gen_rom(ProcMuxJob &job, SnippetSwCache &swcache, RTLIL::SwitchRule *sw, const RTLIL::SigSpec &sig,
+		const RTLIL::SigSpec &defval, RTLIL::SigSpec &result)
+{
+	int abits = GetSize(sw->signal);
+	if (abits == 0 || abits > 16 || sw->signal.is_fully_const())
+		return false;
+
+	bool has_default = false;
+	for (auto cs : sw->cases)
+		if (cs->compare.empty())
+			has_default = true;
+	if (!has_default && !defval.is_fully_const())
+		return false;
+
+	int num_patterns = 0;
+	std::vector<RTLIL::SigSpec> values;
+	for (auto cs : sw->cases)
+	{
+		for (auto &pat : cs->compare)
+			if (!pat.is_fully_def())
+				return false;
+		for (auto sw2 : cs->switches)
+			if (swcache.check(sw2))
+				return false;
+
+		RTLIL::SigSpec value = defval;
+		for (auto &action : cs->actions)
+			sig.replace(action.first, action.second, &value);
+		if (!value.is_fully_const())
+			return false;
+
+		num_patterns += GetSize(cs->compare);
+		values.push_back(value);
+	}
+
+	// only worth it for tables that fill a good part of the address space
+	int size = 1 << abits;
+	if (num_patterns < 8 || size > 4 * num_patterns)
+		return false;
+
+	// fill in reverse order, so that the first matching case wins
+	int width = GetSize(sig);
+	std::vector<RTLIL::State> data;
+	if (has_default)
+		data.resize(size*width, RTLIL::State::Sx);
+	else
+		for (int i = 0; i < size; i++)
+			for (auto bit : defval.as_const())
+				data.push_back(bit);
+	for (int i = GetSize(sw->cases)-1; i >= 0; i--) {
+		RTLIL::CaseRule *cs = sw->cases[i];
+		const std::vector<RTLIL::State> bits = values[i].as_const().to_bits();
+		if (cs->compare.empty()) {
+			for (int addr = 0; addr < size; addr++)
+				std::copy(bits.begin(), bits.end(), data.begin() + addr*width);
+		}
+		for (auto &pat : cs->compare) {
+			int addr = pat.as_const().as_int();
+			std::copy(bits.begin(), bits.end(), data.begin() + addr*width);
+		}
+	}
+
+	// the assignments to the snippet are consumed like in signal_to_mux_tree()
+	for (auto cs : sw->cases)
+		for (auto &action : cs->actions)
+			action.first.remove2(sig, &action.second);
+
+	std::string name = job.new_name();
+	RTLIL::IdString memid = name + "_ROM";
+	job.roms.push_back({memid, width, size});
+
+	RTLIL::Cell *init_cell = job.addCell(name + "_INIT", "$meminit");
+	init_cell->attributes = sw->attributes;
+	init_cell->parameters["\\MEMID"] = RTLIL::Const(memid.str());
+	init_cell->parameters["\\ABITS"] = RTLIL::Const(abits);
+	init_cell->parameters["\\WIDTH"] = RTLIL::Const(width);
+	init_cell->parameters["\\WORDS"] = RTLIL::Const(size);
+	init_cell->parameters["\\PRIORITY"] = RTLIL::Const(0);
+	init_cell->setPort("\\ADDR", RTLIL::SigSpec(0, abits));
+	init_cell->setPort("\\DATA", RTLIL::Const(data));
+
+	RTLIL::Wire *data_wire = job.addWire(name + "_DATA", width);
+
+	RTLIL::Cell *rd_cell = job.addCell(name + "_RD", "$memrd");
+	rd_cell->attributes = sw->attributes;
+	rd_cell->parameters["\\MEMID"] = RTLIL::Const(memid.str());
+	rd_cell->parameters["\\ABITS"] = RTLIL::Const(abits);
+	rd_cell->parameters["\\WIDTH"] = RTLIL::Const(width);
+	rd_cell->parameters["\\CLK_ENABLE"] = RTLIL::Const(0);
+	rd_cell->parameters["\\CLK_POLARITY"] = RTLIL::Const(0);
+	rd_cell->parameters["\\TRANSPARENT"] = RTLIL::Const(0);
+	rd_cell->setPort("\\CLK", RTLIL::SigSpec(RTLIL::State::Sx, 1));
+	rd_cell->setPort("\\EN", RTLIL::SigSpec(RTLIL::State::Sx, 1));
+	rd_cell->setPort("\\ADDR", sw->signal);
+	rd_cell->setPort("\\DATA", data_wire);
+
+	log("        mapped %d cases on %s to a %dx%d ROM.\n", GetSize(sw->cases), log_signal(sw->signal), size, width);
+
+	result = data_wire;
+	return true;
+}
+
+RTLIL::SigSpec signal_to_mux_tree(ProcMuxJob &job, SnippetSwCache &swcache, RTLIL::CaseRule *cs,
+		const RTLIL::SigSpec &sig, const RTLIL::SigSpec &defval, bool ifxmode)
+{
+	RTLIL::SigSpec result = defval;
+
+	for (auto &action : cs->actions) {
+		sig.replace(action.first, action.second, &result);
+		action.first.remove2(sig, &action.second);
+	}
+
+	for (auto sw : cs->switches)
+	{
+		if (!swcache.check(sw))
+			continue;
+
+		const std::vector<int> &pgroups = get_pgroups(swcache, sw, ifxmode);
+
 		// mask default bits that are irrelevant because the output is driven by a full case
 		const pool<SigBit> &full_case_bits = get_full_case_bits(swcache, sw);
 		for (int i = 0; i < GetSize(sig); i++)
 			if (full_case_bits.count(sig[i]))
 				result[i] = State::Sx;
 
-		// evaluate in reverse order to give the first entry the top priority
 		RTLIL::SigSpec initial_val = result;
+		if (job.rom_mode && !ifxmode && gen_rom(job, swcache, sw, sig, initial_val, result))
+			continue;
+
+		// evaluate in reverse order to give the first entry the top priority
 		RTLIL::Cell *last_mux_cell = NULL;
 		for (size_t i = 0; i < sw->cases.size(); i++) {
 			int case_idx = sw->cases.size() - i - 1;
 			RTLIL::CaseRule *cs2 = sw->cases[case_idx];
-			RTLIL::SigSpec value = signal_to_mux_tree(mod, swcache, swpara, cs2, sig, initial_val, ifxmode);
+			RTLIL::SigSpec value = initial_val;
+			if (swcache.check(cs2))
+				value = signal_to_mux_tree(job, swcache, cs2, sig, initial_val, ifxmode);
 			if (last_mux_cell && pgroups[case_idx] == pgroups[case_idx+1])
-				append_pmux(mod, sw->signal, cs2->compare, value, last_mux_cell, sw, cs2, ifxmode);
+				append_pmux(job, sw->signal, cs2->compare, value, last_mux_cell, sw, cs2, ifxmode);
 			else
-				result = gen_mux(mod, sw->signal, cs2->compare, value, result, last_mux_cell, sw, cs2, ifxmode);
+				result = gen_mux(job, sw->signal, cs2->compare, value, result, last_mux_cell, sw, cs2, ifxmode);
 		}
 	}
 
 	return result;
 }
 
-void proc_mux(RTLIL::Module *mod, RTLIL::Process *proc, bool ifxmode)
+void proc_mux(ProcMuxJob &job, bool ifxmode)
 {
-	log("Creating decoders for process `%s.%s'.\n", mod->name.c_str(), proc->name.c_str());
+	RTLIL::Process *proc = job.proc;
+	log("Creating decoders for process `%s.%s'.\n", job.mod->name.c_str(), proc->name.c_str());
 
 	SigSnippets sigsnip;
 	sigsnip.insert(&proc->root_case);
@@ -421,8 +669,6 @@ void proc_mux(RTLIL::Module *mod, RTLIL::Process *proc, bool ifxmode)
 	swcache.snippets = &sigsnip;
 	swcache.insert(&proc->root_case);
 
-	dict<RTLIL::SwitchRule*, bool, hash_ptr_ops> swpara;
-
 	int cnt = 0;
 	for (int idx : sigsnip.snippets)
 	{
@@ -431,8 +677,8 @@ void proc_mux(RTLIL::Module *mod, RTLIL::Process *proc, bool ifxmode)
 
 		log("%6d/%d: %s\n", ++cnt, GetSize(sigsnip.snippets), log_signal(sig));
 
-		RTLIL::SigSpec value = signal_to_mux_tree(mod, swcache, swpara, &proc->root_case, sig, RTLIL::SigSpec(RTLIL::State::Sx, sig.size()), ifxmode);
-		mod->connect(RTLIL::SigSig(sig, value));
+		RTLIL::SigSpec value = signal_to_mux_tree(job, swcache, &proc->root_case, sig, RTLIL::SigSpec(RTLIL::State::Sx, sig.size()), ifxmode);
+		job.connect(RTLIL::SigSig(sig, value));
 	}
 }
 
@@ -451,10 +697,24 @@ struct ProcMuxPass : public Pass {
 		log("        Use Verilog simulation behavior with respect to undef values in\n");
 		log("        'case' expressions and 'if' conditions.\n");
 		log("\n");
+		log("    -rom\n");
+		log("        map case statements over signals of up to 16 bits that only assign\n");
+		log("        constants to lookup tables in ROMs ($memrd cells with $meminit) instead\n");
+		log("        of multiplexer trees, if the case items cover at least a quarter of the\n");
+		log("        address space. the ROMs can be mapped with the memory_* passes.\n");
+		log("\n");
+		log("    -j <num>\n");
+		log("        convert up to <num> processes concurrently. the cells are added to the\n");
+		log("        modules in process order, so the result and the log output are the\n");
+		log("        same as without this option.\n");
+		log("        (default: the number of threads given to 'yosys -j')\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
 	{
 		bool ifxmode = false;
+		bool rom_mode = false;
+		int num_threads YS_ATTRIBUTE(unused) = yosys_threads;
 		log_header(design, "Executing PROC_MUX pass (convert decision trees to multiplexers).\n");
 
 		size_t argidx;
@@ -464,15 +724,52 @@ struct ProcMuxPass : public Pass {
 				ifxmode = true;
 				continue;
 			}
+			if (args[argidx] == "-rom") {
+				rom_mode = true;
+				continue;
+			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
+		std::vector<std::unique_ptr<ProcMuxJob>> jobs;
 		for (auto mod : design->modules())
 			if (design->selected(mod))
 				for (auto &proc_it : mod->processes)
 					if (design->selected(mod, proc_it.second))
-						proc_mux(mod, proc_it.second, ifxmode);
+					{
+						jobs.emplace_back(new ProcMuxJob(mod, proc_it.second));
+						jobs.back()->rom_mode = rom_mode;
+					}
+
+		TaskGroup group(std::max(std::min(num_threads, GetSize(jobs)), 1));
+
+		if (group.concurrent())
+		{
+			// Each process only reads the wires of its module and writes to
+			// its own scratch module, nothing is added to the design until
+			// all jobs are done.
+			for (auto &job : jobs) {
+				ProcMuxJob *j = job.get();
+				group.run([j, ifxmode]() { proc_mux(*j, ifxmode); });
+			}
+			group.join();
+
+			for (int i = 0; i < GetSize(jobs); i++) {
+				group.wait(i);
+				jobs[i]->commit();
+			}
+			return;
+		}
+
+		for (auto &job : jobs) {
+			proc_mux(*job, ifxmode);
+			job->commit();
+		}
 	}
 } ProcMuxPass;
 
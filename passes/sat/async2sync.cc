@@ -96,7 +96,7 @@ struct Async2syncPass : public Pass {
 					Const init_val;
 					for (int i = 0; i < GetSize(sig_q); i++) {
 						SigBit bit = sigmap(sig_q[i]);
-						init_val.bits.push_back(initbits.count(bit) ? initbits.at(bit) : State::Sx);
+						init_val.bits().push_back(initbits.count(bit) ? initbits.at(bit) : State::Sx);
 						del_initbits.insert(bit);
 					}
 
@@ -140,7 +140,7 @@ struct Async2syncPass : public Pass {
 					Const init_val;
 					for (int i = 0; i < GetSize(sig_q); i++) {
 						SigBit bit = sigmap(sig_q[i]);
-						init_val.bits.push_back(initbits.count(bit) ? initbits.at(bit) : State::Sx);
+						init_val.bits().push_back(initbits.count(bit) ? initbits.at(bit) : State::Sx);
 						del_initbits.insert(bit);
 					}
 
@@ -185,7 +185,7 @@ struct Async2syncPass : public Pass {
 					Const init_val;
 					for (int i = 0; i < GetSize(sig_q); i++) {
 						SigBit bit = sigmap(sig_q[i]);
-						init_val.bits.push_back(initbits.count(bit) ? initbits.at(bit) : State::Sx);
+						init_val.bits().push_back(initbits.count(bit) ? initbits.at(bit) : State::Sx);
 						del_initbits.insert(bit);
 					}
 
@@ -216,7 +216,7 @@ struct Async2syncPass : public Pass {
 
 					for (int i = 0; i < GetSize(initval) && i < GetSize(initsig); i++)
 						if (del_initbits.count(initsig[i]) > 0)
-							initval[i] = State::Sx;
+							initval.bits()[i] = State::Sx;
 						else if (initval[i] != State::Sx)
 							delete_initattr = false;
 
@@ -140,8 +140,8 @@ struct Clk2fflogicPass : public Pass {
 						wr_addr_port.replace(wport*abits, addr_q);
 						wr_data_port.replace(wport*width, data_q);
 
-						wr_clk_en_param[wport] = State::S0;
-						wr_clk_pol_param[wport] = State::S0;
+						wr_clk_en_param.bits()[wport] = State::S0;
+						wr_clk_pol_param.bits()[wport] = State::S0;
 					}
 
 					cell->setParam("\\WR_CLK_ENABLE", wr_clk_en_param);
@@ -199,11 +199,11 @@ struct Clk2fflogicPass : public Pass {
 					for (int i = 0; i < GetSize(sig_d); i++) {
 						SigBit qbit = sigmap(sig_q[i]);
 						if (initbits.count(qbit)) {
-							initval.bits.push_back(initbits.at(qbit));
+							initval.bits().push_back(initbits.at(qbit));
 							del_initbits.insert(qbit);
 						} else
-							initval.bits.push_back(State::Sx);
-						if (initval.bits.back() != State::Sx)
+							initval.bits().push_back(State::Sx);
+						if (initval.back() != State::Sx)
 							assign_initval = true;
 					}
 
@@ -362,11 +362,11 @@ struct Clk2fflogicPass : public Pass {
 					for (int i = 0; i < GetSize(sig_d); i++) {
 						SigBit qbit = sigmap(sig_q[i]);
 						if (initbits.count(qbit)) {
-							initval.bits.push_back(initbits.at(qbit));
+							initval.bits().push_back(initbits.at(qbit));
 							del_initbits.insert(qbit);
 						} else
-							initval.bits.push_back(State::Sx);
-						if (initval.bits.back() != State::Sx)
+							initval.bits().push_back(State::Sx);
+						if (initval.back() != State::Sx)
 							assign_initval = true;
 					}
 
@@ -389,7 +389,7 @@ struct Clk2fflogicPass : public Pass {
 
 					for (int i = 0; i < GetSize(initval) && i < GetSize(initsig); i++)
 						if (del_initbits.count(initsig[i]) > 0)
-							initval[i] = State::Sx;
+							initval.bits()[i] = State::Sx;
 						else if (initval[i] != State::Sx)
 							delete_initattr = false;
 
@@ -26,37 +26,177 @@
 #include "kernel/sigtools.h"
 #include "kernel/satgen.h"
 #include "kernel/log.h"
+#include "kernel/threadpool.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <algorithm>
+#include <atomic>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
 /* this should only be used for regression testing of ConstEval -- see vloghammer */
+// Evaluates a module that only contains fine-grained gates for 64 input
+// assignments at once, each net is a word with one lane per assignment.
+struct BitParallelEval
+{
+	enum gate_type_t {
+		G_BUF, G_NOT, G_AND, G_NAND, G_OR, G_NOR, G_XOR, G_XNOR, G_ANDNOT, G_ORNOT,
+		G_MUX, G_NMUX, G_AOI3, G_OAI3, G_AOI4, G_OAI4
+	};
+
+	struct gate_t
+	{
+		gate_type_t type;
+		int y, a, b, c, d;
+	};
+
+	// nets 0 and 1 are the constants 0 and 1
+	int num_nets = 2;
+	std::vector<gate_t> gates;
+	std::vector<int> input_nets, output_nets;
+
+	// Returns false if the module has other cells, undriven or undefined
+	// signals or loops, these modules are checked with ConstEval.
+	bool init(RTLIL::Module *module, const RTLIL::SigSpec &inputs, const RTLIL::SigSpec &outputs)
+	{
+		static const dict<RTLIL::IdString, gate_type_t> gate_types = {
+			{ID($_BUF_), G_BUF}, {ID($_NOT_), G_NOT}, {ID($_AND_), G_AND}, {ID($_NAND_), G_NAND},
+			{ID($_OR_), G_OR}, {ID($_NOR_), G_NOR}, {ID($_XOR_), G_XOR}, {ID($_XNOR_), G_XNOR},
+			{ID($_ANDNOT_), G_ANDNOT}, {ID($_ORNOT_), G_ORNOT}, {ID($_MUX_), G_MUX}, {ID($_NMUX_), G_NMUX},
+			{ID($_AOI3_), G_AOI3}, {ID($_OAI3_), G_OAI3}, {ID($_AOI4_), G_AOI4}, {ID($_OAI4_), G_OAI4}
+		};
+
+		SigMap sigmap(module);
+		dict<RTLIL::SigBit, int> net_index;
+
+		for (auto bit : sigmap(inputs)) {
+			if (bit.wire == nullptr || net_index.count(bit))
+				return false;
+			net_index[bit] = num_nets++;
+			input_nets.push_back(net_index.at(bit));
+		}
+
+		std::vector<std::pair<RTLIL::Cell*, gate_type_t>> cells;
+		for (auto cell : module->cells()) {
+			auto it = gate_types.find(cell->type);
+			if (it == gate_types.end())
+				return false;
+			RTLIL::SigBit y = sigmap(cell->getPort(ID::Y));
+			if (y.wire == nullptr || net_index.count(y))
+				return false;
+			net_index[y] = num_nets++;
+			cells.push_back(std::make_pair(cell, it->second));
+		}
+
+		auto net = [&](const RTLIL::SigSpec &sig) {
+			RTLIL::SigBit bit = sigmap(sig);
+			if (bit == RTLIL::State::S0)
+				return 0;
+			if (bit == RTLIL::State::S1)
+				return 1;
+			auto it = net_index.find(bit);
+			return it == net_index.end() ? -1 : it->second;
+		};
+
+		// levelize (Kahn's algorithm)
+		std::vector<gate_t> unsorted;
+		dict<int, int> driver;
+		for (auto &it : cells) {
+			RTLIL::Cell *cell = it.first;
+			gate_t g;
+			g.type = it.second;
+			g.y = net(cell->getPort(ID::Y));
+			g.a = net(cell->getPort(ID::A));
+			g.b = cell->hasPort(ID::B) ? net(cell->getPort(ID::B)) : 0;
+			g.c = cell->hasPort(ID(C)) ? net(cell->getPort(ID(C))) : cell->hasPort(ID(S)) ? net(cell->getPort(ID(S))) : 0;
+			g.d = cell->hasPort(ID(D)) ? net(cell->getPort(ID(D))) : 0;
+			if (g.a < 0 || g.b < 0 || g.c < 0 || g.d < 0)
+				return false;
+			driver[g.y] = GetSize(unsorted);
+			unsorted.push_back(g);
+		}
+
+		std::vector<int> pending(GetSize(unsorted)), queue;
+		dict<int, std::vector<int>> readers;
+		for (int i = 0; i < GetSize(unsorted); i++) {
+			const gate_t &g = unsorted[i];
+			for (int n : {g.a, g.b, g.c, g.d})
+				if (driver.count(n)) {
+					readers[n].push_back(i);
+					pending[i]++;
+				}
+			if (pending[i] == 0)
+				queue.push_back(i);
+		}
+		for (int k = 0; k < GetSize(queue); k++) {
+			gates.push_back(unsorted[queue[k]]);
+			auto it = readers.find(unsorted[queue[k]].y);
+			if (it != readers.end())
+				for (int i : it->second)
+					if (--pending[i] == 0)
+						queue.push_back(i);
+		}
+		if (GetSize(gates) != GetSize(unsorted))
+			return false;
+
+		for (auto bit : outputs) {
+			int n = net(bit);
+			if (n < 0)
+				return false;
+			output_nets.push_back(n);
+		}
+		return true;
+	}
+
+	void eval(std::vector<uint64_t> &nets) const
+	{
+		uint64_t *n = nets.data();
+		for (auto &g : gates)
+		{
+			uint64_t y;
+			switch (g.type)
+			{
+				case G_BUF:    y = n[g.a]; break;
+				case G_NOT:    y = ~n[g.a]; break;
+				case G_AND:    y = n[g.a] & n[g.b]; break;
+				case G_NAND:   y = ~(n[g.a] & n[g.b]); break;
+				case G_OR:     y = n[g.a] | n[g.b]; break;
+				case G_NOR:    y = ~(n[g.a] | n[g.b]); break;
+				case G_XOR:    y = n[g.a] ^ n[g.b]; break;
+				case G_XNOR:   y = ~(n[g.a] ^ n[g.b]); break;
+				case G_ANDNOT: y = n[g.a] & ~n[g.b]; break;
+				case G_ORNOT:  y = n[g.a] | ~n[g.b]; break;
+				case G_MUX:    y = (n[g.a] & ~n[g.c]) | (n[g.b] & n[g.c]); break;
+				case G_NMUX:   y = ~((n[g.a] & ~n[g.c]) | (n[g.b] & n[g.c])); break;
+				case G_AOI3:   y = ~((n[g.a] & n[g.b]) | n[g.c]); break;
+				case G_OAI3:   y = ~((n[g.a] | n[g.b]) & n[g.c]); break;
+				case G_AOI4:   y = ~((n[g.a] & n[g.b]) | (n[g.c] & n[g.d])); break;
+				case G_OAI4:   y = ~((n[g.a] | n[g.b]) & (n[g.c] | n[g.d])); break;
+				default:       log_abort();
+			}
+			n[g.y] = y;
+		}
+	}
+};
+
 struct BruteForceEquivChecker
 {
 	RTLIL::Module *mod1, *mod2;
 	RTLIL::SigSpec mod1_inputs, mod1_outputs;
 	RTLIL::SigSpec mod2_inputs, mod2_outputs;
-	int counter, errors;
+	int64_t counter, errors;
 	bool ignore_x_mod1;
 
-	void run_checker(RTLIL::SigSpec &inputs)
-	{
-		if (inputs.size() < mod1_inputs.size()) {
-			RTLIL::SigSpec inputs0 = inputs, inputs1 = inputs;
-			inputs0.append(State::S0);
-			inputs1.append(State::S1);
-			run_checker(inputs0);
-			run_checker(inputs1);
-			return;
-		}
+	// maximum number of counter-examples shown by the bit-parallel check
+	static const int max_shown = 10;
 
+	bool check_inputs(const RTLIL::Const &inputs)
+	{
 		ConstEval ce1(mod1), ce2(mod2);
-		ce1.set(mod1_inputs, inputs.as_const());
-		ce2.set(mod2_inputs, inputs.as_const());
+		ce1.set(mod1_inputs, inputs);
+		ce2.set(mod2_inputs, inputs);
 
 		RTLIL::SigSpec sig1 = mod1_outputs, undef1;
 		RTLIL::SigSpec sig2 = mod2_outputs, undef2;
@@ -78,12 +218,110 @@ struct BruteForceEquivChecker
 			log("Found counter-example (ignore_x_mod1 = %s):\n", ignore_x_mod1 ? "active" : "inactive");
 			log("  Module 1:  %s = %s  =>  %s = %s\n", log_signal(mod1_inputs), log_signal(inputs), log_signal(mod1_outputs), log_signal(sig1));
 			log("  Module 2:  %s = %s  =>  %s = %s\n", log_signal(mod2_inputs), log_signal(inputs), log_signal(mod2_outputs), log_signal(sig2));
-			errors++;
+			return false;
+		}
+		return true;
+	}
+
+	void run_checker(RTLIL::SigSpec &inputs)
+	{
+		if (inputs.size() < mod1_inputs.size()) {
+			RTLIL::SigSpec inputs0 = inputs, inputs1 = inputs;
+			inputs0.append(State::S0);
+			inputs1.append(State::S1);
+			run_checker(inputs0);
+			run_checker(inputs1);
+			return;
 		}
 
+		if (!check_inputs(inputs.as_const()))
+			errors++;
 		counter++;
 	}
 
+	// Checks 64 assignments per evaluation: the lanes of a word enumerate the
+	// values of the first 6 input bits, the other bits are the word index.
+	// The words are split in chunks that are checked by up to yosys_threads
+	// threads. The first counter-examples are shown with ConstEval.
+	void run_parallel(const BitParallelEval &eval1, const BitParallelEval &eval2)
+	{
+		static const uint64_t var_masks[6] = {
+			0xaaaaaaaaaaaaaaaaull, 0xccccccccccccccccull, 0xf0f0f0f0f0f0f0f0ull,
+			0xff00ff00ff00ff00ull, 0xffff0000ffff0000ull, 0xffffffff00000000ull
+		};
+
+		int num_inputs = GetSize(mod1_inputs);
+		int64_t num_words = num_inputs > 6 ? int64_t(1) << (num_inputs - 6) : 1;
+		uint64_t lane_mask = num_inputs >= 6 ? ~uint64_t(0) : (uint64_t(1) << (1 << num_inputs)) - 1;
+		const int64_t chunk_size = 1024;
+		int64_t num_chunks = (num_words + chunk_size - 1) / chunk_size;
+
+		struct result_t {
+			int64_t errors = 0;
+			std::vector<int64_t> examples;
+		};
+
+		auto check_chunks = [&](std::atomic<int64_t> &next_chunk, result_t &result) {
+			std::vector<uint64_t> nets1(eval1.num_nets), nets2(eval2.num_nets);
+			nets1[1] = nets2[1] = ~uint64_t(0);
+			while (1) {
+				int64_t chunk = next_chunk++;
+				if (chunk >= num_chunks)
+					break;
+				for (int64_t w = chunk * chunk_size; w < std::min(num_words, (chunk + 1) * chunk_size); w++) {
+					for (int i = 0; i < num_inputs; i++) {
+						uint64_t value = i < 6 ? var_masks[i] : ((w >> (i - 6)) & 1) ? ~uint64_t(0) : 0;
+						nets1[eval1.input_nets[i]] = value;
+						nets2[eval2.input_nets[i]] = value;
+					}
+					eval1.eval(nets1);
+					eval2.eval(nets2);
+					uint64_t diff = 0;
+					for (int i = 0; i < GetSize(eval1.output_nets); i++)
+						diff |= nets1[eval1.output_nets[i]] ^ nets2[eval2.output_nets[i]];
+					for (diff &= lane_mask; diff; diff &= diff - 1) {
+						int lane = 0;
+						while (!((diff >> lane) & 1))
+							lane++;
+						if (GetSize(result.examples) < max_shown)
+							result.examples.push_back((w << 6) | lane);
+						result.errors++;
+					}
+				}
+			}
+		};
+
+		int num_threads = std::max<int64_t>(1, std::min<int64_t>(yosys_threads, num_chunks));
+		std::vector<result_t> results(num_threads);
+		std::atomic<int64_t> next_chunk(0);
+		parallel_for(num_threads, [&](int i) { check_chunks(next_chunk, results[i]); }, num_threads);
+
+		// each task checks its chunks in ascending order, so the smallest
+		// counter-examples of all tasks are among the ones recorded
+		std::vector<int64_t> examples;
+		for (auto &result : results) {
+			errors += result.errors;
+			examples.insert(examples.end(), result.examples.begin(), result.examples.end());
+		}
+		std::sort(examples.begin(), examples.end());
+		if (GetSize(examples) > max_shown)
+			examples.resize(max_shown);
+
+		for (auto index : examples) {
+			RTLIL::Const inputs(State::S0, num_inputs);
+			for (int i = 0; i < num_inputs; i++)
+				if ((index >> i) & 1)
+					inputs.set(i, State::S1);
+			if (check_inputs(inputs))
+				log("Bit-parallel evaluation found a difference for %s = %s that ConstEval does not confirm.\n",
+						log_signal(mod1_inputs), log_signal(inputs));
+		}
+		if (errors > GetSize(examples))
+			log("Found %lld more counter-examples.\n", (long long)(errors - GetSize(examples)));
+
+		counter += int64_t(1) << num_inputs;
+	}
+
 	BruteForceEquivChecker(RTLIL::Module *mod1, RTLIL::Module *mod2, bool ignore_x_mod1) :
 			mod1(mod1), mod2(mod2), counter(0), errors(0), ignore_x_mod1(ignore_x_mod1)
 	{
@@ -110,6 +348,15 @@ struct BruteForceEquivChecker
 			}
 		}
 
+		// modules of fine-grained gates are checked bit-parallel, they have
+		// no undefined values
+		BitParallelEval eval1, eval2;
+		if (GetSize(mod1_inputs) < 63 && eval1.init(mod1, mod1_inputs, mod1_outputs) && eval2.init(mod2, mod2_inputs, mod2_outputs)) {
+			log("Using bit-parallel evaluation of %d gates.\n", GetSize(eval1.gates) + GetSize(eval2.gates));
+			run_parallel(eval1, eval2);
+			return;
+		}
+
 		RTLIL::SigSpec inputs;
 		run_checker(inputs);
 	}
@@ -251,13 +498,13 @@ struct VlogHammerReporter
 				std::string module_name = module_names[mod].c_str();
 				ConstEval ce(module);
 
-				std::vector<RTLIL::State> bits(patterns[idx].bits.begin(), patterns[idx].bits.begin() + total_input_width);
+				std::vector<RTLIL::State> bits(patterns[idx].bits().begin(), patterns[idx].bits().begin() + total_input_width);
 				for (int i = 0; i < int(inputs.size()); i++) {
 					RTLIL::Wire *wire = module->wires_.at(inputs[i]);
 					for (int j = input_widths[i]-1; j >= 0; j--) {
 						ce.set(RTLIL::SigSpec(wire, j), bits.back());
 						recorded_set_vars.append(RTLIL::SigSpec(wire, j));
-						recorded_set_vals.bits.push_back(bits.back());
+						recorded_set_vals.bits().push_back(bits.back());
 						bits.pop_back();
 					}
 					if (module == modules.front()) {
@@ -347,7 +594,7 @@ struct VlogHammerReporter
 				log_error("Pattern %s is to short!\n", pattern.c_str());
 			patterns.push_back(sig.as_const());
 			if (invert_pattern) {
-				for (auto &bit : patterns.back().bits)
+				for (auto &bit : patterns.back().bits())
 					if (bit == RTLIL::State::S0)
 						bit = RTLIL::State::S1;
 					else if (bit == RTLIL::State::S1)
@@ -422,8 +669,8 @@ struct EvalPass : public Pass {
 				BruteForceEquivChecker checker(design->modules_.at(mod1_name), design->modules_.at(mod2_name), args[argidx-2] == "-brute_force_equiv_checker_x");
 				if (checker.errors > 0)
 					log_cmd_error("Modules are not equivalent!\n");
-				log("Verified %s = %s (using brute-force check on %d cases).\n",
-						mod1_name.c_str(), mod2_name.c_str(), checker.counter);
+				log("Verified %s = %s (using brute-force check on %lld cases).\n",
+						mod1_name.c_str(), mod2_name.c_str(), (long long)checker.counter);
 				return;
 			}
 			if (args[argidx] == "-vloghammer_report" && argidx+5 == args.size()) {
@@ -452,6 +699,7 @@ struct EvalPass : public Pass {
 			log_cmd_error("Can't perform EVAL on an empty selection!\n");
 
 		ConstEval ce(module);
+		RTLIL::SigSpec set_sig, set_val;
 
 		for (auto &it : sets) {
 			RTLIL::SigSpec lhs, rhs;
@@ -465,6 +713,8 @@ struct EvalPass : public Pass {
 				log_cmd_error("Set expression with different lhs and rhs sizes: %s (%s, %d bits) vs. %s (%s, %d bits)\n",
 						it.first.c_str(), log_signal(lhs), lhs.size(), it.second.c_str(), log_signal(rhs), rhs.size());
 			ce.set(lhs, rhs.as_const());
+			set_sig.append(lhs);
+			set_val.append(rhs);
 		}
 
 		if (shows.size() == 0) {
@@ -524,44 +774,75 @@ struct EvalPass : public Pass {
 			tab.push_back(tab_line);
 			tab_line.clear();
 
-			RTLIL::Const tabvals(0, tabsigs.size());
-			do
+			auto add_row = [&](const RTLIL::Const &row_tabvals, const RTLIL::SigSpec &row_value)
 			{
-				ce.push();
-				ce.set(tabsigs, tabvals);
-				value = signal;
-
-				RTLIL::SigSpec this_undef;
-				while (!ce.eval(value, this_undef)) {
-					if (!set_undef) {
-						log("Failed to evaluate signal %s at %s = %s: Missing value for %s.\n", log_signal(signal),
-								log_signal(tabsigs), log_signal(tabvals), log_signal(this_undef));
-						return;
-					}
-					ce.set(this_undef, RTLIL::Const(RTLIL::State::Sx, this_undef.size()));
-					undef.append(this_undef);
-					this_undef = RTLIL::SigSpec();
-				}
-
 				int pos = 0;
 				for (auto &c : tabsigs.chunks()) {
-					tab_line.push_back(log_signal(RTLIL::SigSpec(tabvals).extract(pos, c.width)));
+					tab_line.push_back(log_signal(RTLIL::SigSpec(row_tabvals).extract(pos, c.width)));
 					pos += c.width;
 				}
 
 				pos = 0;
 				for (auto &c : signal.chunks()) {
-					tab_line.push_back(log_signal(value.extract(pos, c.width)));
+					tab_line.push_back(log_signal(row_value.extract(pos, c.width)));
 					pos += c.width;
 				}
 
 				tab.push_back(tab_line);
 				tab_line.clear();
-				ce.pop();
+			};
 
-				tabvals = RTLIL::const_add(tabvals, RTLIL::Const(1), false, false, tabvals.bits.size());
+			// evaluate 64 rows at once if the signals only depend on the
+			// table and set signals and on cells ConstEvalBatch supports
+			ConstEvalBatch batch(module);
+			if (GetSize(tabsigs) <= 30 && batch.setup({tabsigs, set_sig}, signal) && batch.free_signals.empty())
+			{
+				for (int i = 0; i < GetSize(set_val); i++) {
+					RTLIL::State bit = set_val[i].data;
+					batch.set_input(GetSize(tabsigs) + i, bit == State::S1 ? ~ConstEvalBatch::word_t(0) : 0,
+							bit == State::S0 || bit == State::S1 ? ~ConstEvalBatch::word_t(0) : 0);
+				}
+
+				int num_rows = 1 << GetSize(tabsigs);
+				for (int base = 0; base < num_rows; base += 64)
+				{
+					for (int i = 0; i < GetSize(tabsigs); i++)
+						batch.set_input(i, ConstEvalBatch::count_pattern(base, i));
+
+					batch.run();
+
+					for (int lane = 0; lane < 64 && base + lane < num_rows; lane++)
+						add_row(RTLIL::Const(base + lane, GetSize(tabsigs)), batch.get_output_lane(lane));
+				}
+			}
+			else
+			{
+				RTLIL::Const tabvals(0, tabsigs.size());
+				do
+				{
+					ce.push();
+					ce.set(tabsigs, tabvals);
+					value = signal;
+
+					RTLIL::SigSpec this_undef;
+					while (!ce.eval(value, this_undef)) {
+						if (!set_undef) {
+							log("Failed to evaluate signal %s at %s = %s: Missing value for %s.\n", log_signal(signal),
+									log_signal(tabsigs), log_signal(tabvals), log_signal(this_undef));
+							return;
+						}
+						ce.set(this_undef, RTLIL::Const(RTLIL::State::Sx, this_undef.size()));
+						undef.append(this_undef);
+						this_undef = RTLIL::SigSpec();
+					}
+
+					add_row(tabvals, value);
+					ce.pop();
+
+					tabvals = RTLIL::const_add(tabvals, RTLIL::Const(1), false, false, tabvals.size());
+				}
+				while (tabvals.as_bool());
 			}
-			while (tabvals.as_bool());
 
 			std::vector<int> tab_column_width;
 			for (auto &row : tab) {
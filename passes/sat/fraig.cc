@@ -0,0 +1,385 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+// [[CITE]] FRAIGs: A Unifying Representation for Logic Synthesis and Verification
+// Alan Mishchenko, Satrajit Chatterjee, Roland Jiang, Robert Brayton (2005)
+// https://people.eecs.berkeley.edu/~alanmi/publications/2005/tech05_fraigs.pdf
+
+#include "kernel/yosys.h"
+#include "kernel/sigtools.h"
+#include "kernel/satgen.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+struct FraigWorker
+{
+	RTLIL::Module *module;
+	SigMap sigmap;
+	int num_words;
+	bool verbose;
+
+	// AIG nodes in topological order. node 0 is constant zero, inputs (all
+	// signals not driven by selected $_AND_ and $_NOT_ cells) have no cell.
+	struct node_t {
+		RTLIL::Cell *cell;
+		RTLIL::SigBit bit;
+		int a, b;
+	};
+
+	std::vector<node_t> nodes;
+	dict<RTLIL::SigBit, int> node_index;
+	dict<RTLIL::SigBit, RTLIL::Cell*> drivers;
+
+	// simulation values, num_words words per node
+	std::vector<uint64_t> sim;
+	std::vector<std::vector<uint64_t>> input_patterns;
+	uint64_t rng_state;
+
+	ezSatPtr ez;
+	SatGen satgen;
+	std::vector<int> literals;
+
+	// merged nodes: the representative and whether it is inverted
+	std::vector<int> merged_into;
+	std::vector<bool> merged_inverted;
+
+	FraigWorker(RTLIL::Module *module, int num_words, bool verbose) :
+			module(module), sigmap(module), num_words(num_words), verbose(verbose), rng_state(88172645463325252ULL), satgen(ez.get(), &sigmap)
+	{
+	}
+
+	bool is_input(int i) const
+	{
+		return nodes[i].cell == nullptr && nodes[i].bit != State::S0 && nodes[i].bit != State::S1;
+	}
+
+	uint64_t xorshift64()
+	{
+		rng_state ^= rng_state << 13;
+		rng_state ^= rng_state >> 7;
+		rng_state ^= rng_state << 17;
+		return rng_state;
+	}
+
+	int add_node(RTLIL::SigBit bit)
+	{
+		auto it = node_index.find(bit);
+		if (it != node_index.end())
+			return it->second;
+
+		// iterative DFS, a bit on the stack that is seen again closes a loop
+		// and is used as an input
+		std::vector<std::pair<RTLIL::SigBit, int>> stack;
+		pool<RTLIL::SigBit> on_stack;
+		stack.push_back(std::make_pair(bit, 0));
+		on_stack.insert(bit);
+
+		while (!stack.empty())
+		{
+			RTLIL::SigBit current = stack.back().first;
+			int &state = stack.back().second;
+			RTLIL::Cell *cell = current.wire && drivers.count(current) ? drivers.at(current) : nullptr;
+
+			if (cell != nullptr && state < (cell->type == ID($_AND_) ? 2 : 1)) {
+				RTLIL::SigBit in = sigmap(cell->getPort(state == 0 ? ID::A : ID::B));
+				state++;
+				if (!node_index.count(in) && !on_stack.count(in)) {
+					stack.push_back(std::make_pair(in, 0));
+					on_stack.insert(in);
+				}
+				continue;
+			}
+
+			node_t node;
+			node.cell = nullptr;
+			node.bit = current;
+			node.a = node.b = -1;
+			if (cell != nullptr) {
+				RTLIL::SigBit in_a = sigmap(cell->getPort(ID::A));
+				RTLIL::SigBit in_b = cell->type == ID($_AND_) ? sigmap(cell->getPort(ID::B)).as_bit() : RTLIL::SigBit();
+				if (node_index.count(in_a) && (cell->type != ID($_AND_) || node_index.count(in_b))) {
+					node.cell = cell;
+					node.a = node_index.at(in_a);
+					node.b = cell->type == ID($_AND_) ? node_index.at(in_b) : -1;
+				} else
+					log_warning("Found a logic loop at %s, it is cut there.\n", log_signal(current));
+			}
+
+			node_index[current] = GetSize(nodes);
+			nodes.push_back(node);
+			on_stack.erase(current);
+			stack.pop_back();
+		}
+
+		return node_index.at(bit);
+	}
+
+	void simulate()
+	{
+		sim.assign(GetSize(nodes) * num_words, 0);
+		int input_idx = 0;
+		for (int i = 0; i < GetSize(nodes); i++)
+		{
+			uint64_t *y = &sim[i * num_words];
+			const node_t &node = nodes[i];
+			if (node.cell == nullptr) {
+				if (!is_input(i)) {
+					if (node.bit == State::S1)
+						for (int w = 0; w < num_words; w++)
+							y[w] = ~uint64_t(0);
+					continue;
+				}
+				while (GetSize(input_patterns) <= input_idx) {
+					input_patterns.push_back(std::vector<uint64_t>());
+					for (int w = 0; w < num_words; w++)
+						input_patterns.back().push_back(xorshift64());
+				}
+				const std::vector<uint64_t> &pattern = input_patterns[input_idx++];
+				for (int w = 0; w < num_words; w++)
+					y[w] = pattern[w];
+				continue;
+			}
+			const uint64_t *a = &sim[node.a * num_words];
+			if (node.b < 0) {
+				for (int w = 0; w < num_words; w++)
+					y[w] = ~a[w];
+			} else {
+				const uint64_t *b = &sim[node.b * num_words];
+				for (int w = 0; w < num_words; w++)
+					y[w] = a[w] & b[w];
+			}
+		}
+	}
+
+	// the signature of a node, inverted so that the first pattern is zero
+	std::vector<uint64_t> signature(int i) const
+	{
+		const uint64_t *y = &sim[i * num_words];
+		uint64_t mask = (y[0] & 1) ? ~uint64_t(0) : 0;
+		std::vector<uint64_t> sig(num_words);
+		for (int w = 0; w < num_words; w++)
+			sig[w] = y[w] ^ mask;
+		return sig;
+	}
+
+	int run()
+	{
+		for (auto cell : module->selected_cells())
+			if (cell->type.in(ID($_AND_), ID($_NOT_)))
+				drivers[sigmap(cell->getPort(ID::Y))] = cell;
+
+		// node 0 is the constant, it is the representative of its class
+		add_node(State::S0);
+		std::vector<RTLIL::SigBit> outputs;
+		for (auto &it : drivers)
+			outputs.push_back(it.first);
+		std::sort(outputs.begin(), outputs.end());
+		for (auto bit : outputs)
+			add_node(bit);
+
+		int num_gates = 0;
+		for (auto &node : nodes) {
+			if (node.cell != nullptr && node.b >= 0)
+				num_gates++;
+			if (node.cell != nullptr)
+				satgen.importCell(node.cell);
+			literals.push_back(satgen.importSigSpec(node.bit).at(0));
+		}
+		log("  Found %d nodes with %d AND gates.\n", GetSize(nodes), num_gates);
+
+		merged_into.assign(GetSize(nodes), -1);
+		merged_inverted.assign(GetSize(nodes), false);
+		int num_merged = 0, num_refuted = 0, num_rounds = 0;
+
+		std::vector<int> model_expr;
+		for (int i = 0; i < GetSize(nodes); i++)
+			if (is_input(i))
+				model_expr.push_back(literals[i]);
+
+		while (1)
+		{
+			simulate();
+			num_rounds++;
+
+			std::map<std::vector<uint64_t>, std::vector<int>> classes;
+			for (int i = 0; i < GetSize(nodes); i++)
+				if (merged_into[i] < 0)
+					classes[signature(i)].push_back(i);
+
+			// counterexamples of this round, one bit per input pattern
+			std::vector<std::vector<bool>> cex;
+
+			for (auto &it : classes)
+			{
+				// the representative is the constant or an input if the class
+				// has one, and the topologically first node otherwise
+				std::vector<int> &members = it.second;
+				int rep = members.front();
+				for (int m : members)
+					if (nodes[rep].cell != nullptr && nodes[m].cell == nullptr)
+						rep = m;
+
+				for (int m : members)
+				{
+					if (m == rep || nodes[m].cell == nullptr)
+						continue;
+
+					bool inverted = (sim[m * num_words] & 1) != (sim[rep * num_words] & 1);
+					int differ = ez->XOR(literals[m], literals[rep]);
+					if (inverted)
+						differ = ez->NOT(differ);
+
+					std::vector<bool> model;
+					if (ez->solve(model_expr, model, differ)) {
+						num_refuted++;
+						cex.push_back(model);
+						break;
+					}
+
+					if (verbose)
+						log("    Merging %s into %s%s.\n", log_signal(nodes[m].bit), inverted ? "~" : "", log_signal(nodes[rep].bit));
+					ez->assume(ez->NOT(differ));
+					merged_into[m] = rep;
+					merged_inverted[m] = inverted;
+					num_merged++;
+				}
+
+				if (GetSize(cex) == 64)
+					break;
+			}
+
+			if (cex.empty())
+				break;
+
+			// the counterexamples are added as one more word of patterns, so
+			// each round splits all refuted classes
+			for (int i = 0; i < GetSize(input_patterns); i++) {
+				uint64_t word = 0;
+				for (int j = 0; j < 64; j++)
+					if (cex[j % GetSize(cex)][i])
+						word |= uint64_t(1) << j;
+				input_patterns[i].push_back(word);
+			}
+			num_words++;
+		}
+
+		log("  Merged %d nodes, %d candidate pairs refuted in %d simulation rounds.\n", num_merged, num_refuted, num_rounds);
+
+		for (int i = 0; i < GetSize(nodes); i++)
+		{
+			int rep = merged_into[i];
+			if (rep < 0)
+				continue;
+
+			RTLIL::Cell *cell = nodes[i].cell;
+			RTLIL::SigBit y = cell->getPort(ID::Y);
+			module->remove(cell);
+
+			if (nodes[rep].cell == nullptr && !is_input(rep))
+				module->connect(y, (nodes[rep].bit == State::S1) != merged_inverted[i] ? State::S1 : State::S0);
+			else if (merged_inverted[i])
+				module->addNotGate(NEW_ID, nodes[rep].bit, y);
+			else
+				module->connect(y, nodes[rep].bit);
+		}
+
+		return num_merged;
+	}
+};
+
+struct FraigPass : public Pass {
+	FraigPass() : Pass("fraig", "merge functionally equivalent AIG nodes") { }
+	void help() YS_OVERRIDE
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    fraig [options] [selection]\n");
+		log("\n");
+		log("This pass maps the selected logic to $_AND_ and $_NOT_ cells using 'aigmap',\n");
+		log("finds nodes that are functionally equivalent (or equivalent to the inverse\n");
+		log("of each other, or constant), and merges them. Registers and all other cells\n");
+		log("are treated as inputs of the combinational logic.\n");
+		log("\n");
+		log("Candidates are found with bit-parallel random simulation and proven with\n");
+		log("one incremental SAT solver. Counterexamples are fed back into the simulation\n");
+		log("to split the remaining candidate classes. This is a quick way to shrink\n");
+		log("a miter of two similar circuits before proving it with 'sat', as the logic\n");
+		log("that is shared by both sides is merged and the remaining SAT problem only\n");
+		log("covers the actual differences.\n");
+		log("\n");
+		log("    -nomap\n");
+		log("        do not run 'aigmap' first, only existing $_AND_ and $_NOT_ cells\n");
+		log("        are considered\n");
+		log("\n");
+		log("    -words <N>\n");
+		log("        simulate <N> 64-bit words of random patterns per node (default: 8)\n");
+		log("\n");
+		log("    -v\n");
+		log("        log every merged node\n");
+		log("\n");
+		log("The merged logic is removed with 'opt_clean' afterwards.\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
+	{
+		bool nomap = false, verbose = false;
+		int num_words = 8;
+
+		log_header(design, "Executing FRAIG pass (merging equivalent AIG nodes).\n");
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-nomap") {
+				nomap = true;
+				continue;
+			}
+			if (args[argidx] == "-words" && argidx+1 < args.size()) {
+				num_words = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
+			if (args[argidx] == "-v") {
+				verbose = true;
+				continue;
+			}
+			break;
+		}
+		extra_args(args, argidx, design);
+
+		int total_merged = 0;
+		for (auto module : design->selected_modules())
+		{
+			if (!nomap)
+				Pass::call_on_module(design, module, "aigmap");
+
+			log("Running SAT sweeping on module %s:\n", log_id(module));
+			FraigWorker worker(module, num_words, verbose);
+			int merged = worker.run();
+			total_merged += merged;
+
+			if (merged > 0)
+				Pass::call_on_module(design, module, "opt_clean");
+		}
+
+		log("Merged %d nodes in total.\n", total_merged);
+	}
+} FraigPass;
+
+PRIVATE_NAMESPACE_END
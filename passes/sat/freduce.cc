@@ -23,17 +23,22 @@
 #include "kernel/sigtools.h"
 #include "kernel/log.h"
 #include "kernel/satgen.h"
+#include "kernel/randsim.h"
+#include "kernel/threadpool.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <algorithm>
+#include <limits>
+#include <functional>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
-bool inv_mode;
-int verbose_level, reduce_counter, reduce_stop_at;
+bool inv_mode, nosim_mode;
+int verbose_level, reduce_counter, reduce_stop_at, num_threads;
 typedef std::map<RTLIL::SigBit, std::pair<RTLIL::Cell*, std::set<RTLIL::SigBit>>> drivers_t;
+typedef dict<RTLIL::SigBit, std::vector<RandomSim::word_t>> signatures_t;
 std::string dump_prefix;
 
 struct equiv_bit_t
@@ -229,6 +234,7 @@ struct PerformReduction
 	SigMap &sigmap;
 	drivers_t &drivers;
 	std::set<std::pair<RTLIL::SigBit, RTLIL::SigBit>> &inv_pairs;
+	const signatures_t *signatures;
 	pool<SigBit> recursion_guard;
 
 	ezSatPtr ez;
@@ -278,8 +284,8 @@ struct PerformReduction
 		return sigdepth.at(out);
 	}
 
-	PerformReduction(SigMap &sigmap, drivers_t &drivers, std::set<std::pair<RTLIL::SigBit, RTLIL::SigBit>> &inv_pairs, std::vector<RTLIL::SigBit> &bits, int cone_size) :
-			sigmap(sigmap), drivers(drivers), inv_pairs(inv_pairs), satgen(ez.get(), &sigmap), out_bits(bits), cone_size(cone_size)
+	PerformReduction(SigMap &sigmap, drivers_t &drivers, std::set<std::pair<RTLIL::SigBit, RTLIL::SigBit>> &inv_pairs, const signatures_t *signatures, std::vector<RTLIL::SigBit> &bits, int cone_size) :
+			sigmap(sigmap), drivers(drivers), inv_pairs(inv_pairs), signatures(signatures), satgen(ez.get(), &sigmap), out_bits(bits), cone_size(cone_size)
 	{
 		satgen.model_undef = true;
 
@@ -487,15 +493,66 @@ struct PerformReduction
 		}
 	}
 
+	// Splits the bucket into classes of signals with the same values in a
+	// bit-parallel random simulation, so that the SAT solver only has to
+	// shatter the classes. Signals with unknown simulation values are added
+	// to all classes, like signals that are undefined in a SAT model.
+	void simulate_bucket(std::vector<int> &bucket, std::vector<std::vector<int>> &classes)
+	{
+		std::vector<std::vector<RandomSim::word_t>> bucket_signatures(bucket.size());
+		std::vector<bool> known(bucket.size(), true);
+
+		for (size_t i = 0; i < bucket.size(); i++) {
+			auto it = signatures->find(out_bits[bucket[i]]);
+			if (it == signatures->end()) {
+				known[i] = false;
+				continue;
+			}
+			for (auto value : it->second)
+				bucket_signatures[i].push_back(out_inverted[bucket[i]] ? ~value : value);
+		}
+
+		std::map<std::vector<RandomSim::word_t>, int> signature_class;
+		std::vector<int> unknown;
+
+		for (size_t i = 0; i < bucket.size(); i++) {
+			if (!known[i]) {
+				unknown.push_back(bucket[i]);
+				continue;
+			}
+			if (signature_class.count(bucket_signatures[i]) == 0) {
+				signature_class[bucket_signatures[i]] = classes.size();
+				classes.push_back(std::vector<int>());
+			}
+			classes[signature_class.at(bucket_signatures[i])].push_back(bucket[i]);
+		}
+
+		if (classes.empty())
+			classes.push_back(std::vector<int>());
+		for (auto &cls : classes)
+			cls.insert(cls.end(), unknown.begin(), unknown.end());
+
+		if (verbose_level >= 1)
+			log("  Random simulation split bucket with %d signals into %d classes (%d signals unknown).\n",
+					int(bucket.size()), int(classes.size()), int(unknown.size()));
+	}
+
 	void analyze(std::vector<std::vector<equiv_bit_t>> &results, int perc)
 	{
 		std::vector<int> bucket;
 		for (size_t i = 0; i < sat_out.size(); i++)
 			bucket.push_back(i);
 
+		std::vector<std::vector<int>> classes;
+		if (signatures != nullptr)
+			simulate_bucket(bucket, classes);
+		else
+			classes.push_back(bucket);
+
 		std::vector<std::set<int>> results_buf;
 		std::map<int, int> results_map;
-		analyze(results_buf, results_map, bucket, stringf("[%2d%%] %d ", perc, cone_size), "");
+		for (auto &cls : classes)
+			analyze(results_buf, results_map, cls, stringf("[%2d%%] %d ", perc, cone_size), "");
 
 		for (auto &r : results_buf)
 		{
@@ -597,6 +654,64 @@ struct FreduceWorker
 		return find_bit_in_cone(celldone, needle, haystack);
 	}
 
+	// Calls task(i, sigmap) for all i < n, on up to num_threads threads. Idle
+	// threads take the next unstarted index and the log output is replayed in
+	// index order, so it is the same as in a serial run. SigMap lookups
+	// compress paths, so every thread uses its own copy.
+	void run_tasks(int n, const std::function<void(int, SigMap&)> &task)
+	{
+#ifdef YOSYS_ENABLE_THREADS
+		int task_threads = std::min(num_threads, n);
+
+		if (task_threads > 1)
+		{
+			std::vector<LogCapture> captures(n);
+			std::vector<std::exception_ptr> errors(n);
+			std::atomic<int> next_index(0);
+			std::atomic<bool> abort(false);
+
+			auto worker_task = [&]() {
+				SigMap task_sigmap = sigmap;
+				while (!abort) {
+					int i = next_index++;
+					if (i >= n)
+						break;
+					log_capture_begin(&captures[i]);
+					try {
+						task(i, task_sigmap);
+					} catch (...) {
+						errors[i] = std::current_exception();
+						abort = true;
+					}
+					log_capture_end();
+				}
+			};
+
+			TaskGroup group(task_threads);
+			for (int i = 0; i < task_threads; i++)
+				group.run(worker_task);
+			group.wait();
+
+			// indices are handed out in order, so all tasks before the
+			// first failed one have been completed
+			for (int i = 0; i < n; i++) {
+				captures[i].replay();
+				if (errors[i]) {
+					try {
+						std::rethrow_exception(errors[i]);
+					} catch (log_capture_error_exception&) {
+						log_abort();
+					}
+				}
+			}
+			return;
+		}
+#endif
+
+		for (int i = 0; i < n; i++)
+			task(i, sigmap);
+	}
+
 	void dump()
 	{
 		std::string filename = stringf("%s_%s_%05d.il", dump_prefix.c_str(), RTLIL::id2cstr(module->name), reduce_counter);
@@ -612,6 +727,8 @@ struct FreduceWorker
 		ct.setup_internals();
 		ct.setup_stdcells();
 
+		RandomSim sim(sigmap);
+
 		int bits_full_total = 0;
 		std::vector<std::set<RTLIL::SigBit>> batches;
 		for (auto &it : module->wires_)
@@ -632,6 +749,7 @@ struct FreduceWorker
 				std::pair<RTLIL::Cell*, std::set<RTLIL::SigBit>> drv(it.second, inputs);
 				for (auto &bit : outputs)
 					drivers[bit] = drv;
+				sim.add_cell(it.second);
 				batches.push_back(outputs);
 				bits_full_total += outputs.size();
 			}
@@ -639,53 +757,104 @@ struct FreduceWorker
 				inv_pairs.insert(std::pair<RTLIL::SigBit, RTLIL::SigBit>(sigmap(it.second->getPort("\\A")), sigmap(it.second->getPort("\\Y"))));
 		}
 
+		// The reduced input cones of the signal batches are independent of
+		// each other, every batch gets its own SAT instance.
 		int bits_count = 0;
 		int bits_full_count = 0;
-		std::map<std::vector<RTLIL::SigBit>, std::vector<RTLIL::SigBit>> buckets;
-		for (auto &batch : batches)
+		std::vector<int> selected_batches, batch_progress;
+		for (int i = 0; i < GetSize(batches); i++)
 		{
-			for (auto &bit : batch)
+			for (auto &bit : batches[i])
 				if (bit.wire != NULL && design->selected(module, bit.wire))
 					goto found_selected_wire;
-			bits_full_count += batch.size();
+			bits_full_count += batches[i].size();
 			continue;
 
 		found_selected_wire:
+			selected_batches.push_back(i);
+			batch_progress.push_back(bits_full_count);
+			bits_full_count += batches[i].size();
+			bits_count += batches[i].size();
+		}
+
+		std::vector<std::vector<std::vector<RTLIL::SigBit>>> batch_inputs(selected_batches.size());
+		run_tasks(GetSize(selected_batches), [&](int i, SigMap &task_sigmap) {
+			std::set<RTLIL::SigBit> &batch = batches[selected_batches[i]];
 			log("  Finding reduced input cone for signal batch %s%c\n",
 					log_signal(batch), verbose_level ? ':' : '.');
 
-			FindReducedInputs infinder(sigmap, drivers);
+			FindReducedInputs infinder(task_sigmap, drivers);
+			int progress = batch_progress[i];
 			for (auto &bit : batch) {
-				std::vector<RTLIL::SigBit> inputs;
-				infinder.analyze(inputs, bit, 100 * bits_full_count / bits_full_total);
-				buckets[inputs].push_back(bit);
-				bits_full_count++;
-				bits_count++;
+				batch_inputs[i].push_back(std::vector<RTLIL::SigBit>());
+				infinder.analyze(batch_inputs[i].back(), bit, 100 * progress++ / bits_full_total);
 			}
+		});
+
+		std::map<std::vector<RTLIL::SigBit>, std::vector<RTLIL::SigBit>> buckets;
+		for (int i = 0; i < GetSize(selected_batches); i++) {
+			int j = 0;
+			for (auto &bit : batches[selected_batches[i]])
+				buckets[batch_inputs[i][j++]].push_back(bit);
 		}
+		batch_inputs.clear();
 		log("  Sorted %d signal bits into %d buckets.\n", bits_count, int(buckets.size()));
 
+		std::vector<std::pair<const std::vector<RTLIL::SigBit>*, std::vector<RTLIL::SigBit>*>> shatter_buckets;
+		std::vector<int> shatter_progress;
 		int bucket_count = 0;
-		std::vector<std::vector<equiv_bit_t>> equiv;
-		for (auto &bucket : buckets)
-		{
+		for (auto &bucket : buckets) {
 			bucket_count++;
-
 			if (bucket.second.size() == 1)
 				continue;
+			shatter_buckets.push_back(std::make_pair(&bucket.first, &bucket.second));
+			shatter_progress.push_back(100 * bucket_count / (buckets.size() + 1));
+		}
 
-			if (bucket.first.size() == 0) {
-				log("  Finding const values for bucket %s%c\n", log_signal(bucket.second), verbose_level ? ':' : '.');
-				PerformReduction worker(sigmap, drivers, inv_pairs, bucket.second, bucket.first.size());
-				for (size_t idx = 0; idx < bucket.second.size(); idx++)
-					worker.analyze_const(equiv, idx);
-			} else {
-				log("  Trying to shatter bucket %s%c\n", log_signal(bucket.second), verbose_level ? ':' : '.');
-				PerformReduction worker(sigmap, drivers, inv_pairs, bucket.second, bucket.first.size());
-				worker.analyze(equiv, 100 * bucket_count / (buckets.size() + 1));
+		// Simulate once for all buckets here, RandomSim can not be shared
+		// by the threads that shatter the buckets.
+		signatures_t signatures;
+		if (!nosim_mode) {
+			pool<RTLIL::SigBit> unknown_bits;
+			for (int round = 0; round < 4; round++) {
+				sim.next_round();
+				for (auto &bucket : shatter_buckets) {
+					if (bucket.first->empty())
+						continue;
+					for (auto &bit : *bucket.second) {
+						RandomSim::word_t value;
+						if (!sim.get(bit, value))
+							unknown_bits.insert(bit);
+						signatures[bit].push_back(value);
+					}
+				}
 			}
+			for (auto &bit : unknown_bits)
+				signatures.erase(bit);
 		}
 
+		// Buckets with different input cones are shattered with separate SAT
+		// instances, the results are collected in bucket order.
+		std::vector<std::vector<std::vector<equiv_bit_t>>> bucket_equiv(shatter_buckets.size());
+		run_tasks(GetSize(shatter_buckets), [&](int i, SigMap &task_sigmap) {
+			const std::vector<RTLIL::SigBit> &inputs = *shatter_buckets[i].first;
+			std::vector<RTLIL::SigBit> &bits = *shatter_buckets[i].second;
+			if (inputs.size() == 0) {
+				log("  Finding const values for bucket %s%c\n", log_signal(bits), verbose_level ? ':' : '.');
+				PerformReduction worker(task_sigmap, drivers, inv_pairs, nullptr, bits, inputs.size());
+				for (size_t idx = 0; idx < bits.size(); idx++)
+					worker.analyze_const(bucket_equiv[i], idx);
+			} else {
+				log("  Trying to shatter bucket %s%c\n", log_signal(bits), verbose_level ? ':' : '.');
+				PerformReduction worker(task_sigmap, drivers, inv_pairs, nosim_mode ? nullptr : &signatures, bits, inputs.size());
+				worker.analyze(bucket_equiv[i], shatter_progress[i]);
+			}
+		});
+
+		std::vector<std::vector<equiv_bit_t>> equiv;
+		for (auto &it : bucket_equiv)
+			equiv.insert(equiv.end(), it.begin(), it.end());
+
 		std::map<RTLIL::SigBit, int> bitusage;
 		CountBitUsage bitusage_worker(sigmap, bitusage);
 		module->rewrite_sigspecs(bitusage_worker);
@@ -776,6 +945,16 @@ struct FreducePass : public Pass {
 		log("    -inv\n");
 		log("        enable explicit handling of inverted signals\n");
 		log("\n");
+		log("    -nosim\n");
+		log("        do not pre-partition the candidate signals with a bit-parallel random\n");
+		log("        simulation before shattering them with the SAT solver.\n");
+		log("\n");
+		log("    -j <num>\n");
+		log("        analyze up to <num> input cones and buckets of candidate signals\n");
+		log("        concurrently, each with its own SAT solver. the log output is the\n");
+		log("        same as without this option.\n");
+		log("        (default: the number of threads given to 'yosys -j')\n");
+		log("\n");
 		log("    -stop <n>\n");
 		log("        stop after <n> reduction operations. this is mostly used for\n");
 		log("        debugging the freduce command itself.\n");
@@ -784,6 +963,9 @@ struct FreducePass : public Pass {
 		log("        dump the design to <prefix>_<module>_<num>.il after each reduction\n");
 		log("        operation. this is mostly used for debugging the freduce command.\n");
 		log("\n");
+		log("    -stats\n");
+		log("        print the statistics of the SAT solver at the end\n");
+		log("\n");
 		log("This pass is undef-aware, i.e. it considers don't-care values for detecting\n");
 		log("equivalent nodes.\n");
 		log("\n");
@@ -797,7 +979,10 @@ struct FreducePass : public Pass {
 		reduce_stop_at = 0;
 		verbose_level = 0;
 		inv_mode = false;
+		nosim_mode = false;
+		num_threads = yosys_threads;
 		dump_prefix = std::string();
+		bool show_stats = false;
 
 		log_header(design, "Executing FREDUCE pass (perform functional reduction).\n");
 
@@ -815,6 +1000,14 @@ struct FreducePass : public Pass {
 				inv_mode = true;
 				continue;
 			}
+			if (args[argidx] == "-nosim") {
+				nosim_mode = true;
+				continue;
+			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
 			if (args[argidx] == "-stop" && argidx+1 < args.size()) {
 				reduce_stop_at = atoi(args[++argidx].c_str());
 				continue;
@@ -823,10 +1016,16 @@ struct FreducePass : public Pass {
 				dump_prefix = args[++argidx];
 				continue;
 			}
+			if (args[argidx] == "-stats") {
+				show_stats = true;
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
+		ezSAT::SolverStats stats_before = get_sat_stats();
+
 		int bitcount = 0;
 		for (auto &mod_it : design->modules_) {
 			RTLIL::Module *module = mod_it.second;
@@ -835,6 +1034,12 @@ struct FreducePass : public Pass {
 		}
 
 		log("Rewired a total of %d signal bits.\n", bitcount);
+
+		if (show_stats) {
+			ezSAT::SolverStats stats = get_sat_stats();
+			stats -= stats_before;
+			log_sat_stats(stats);
+		}
 	}
 } FreducePass;
 
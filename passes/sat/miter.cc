@@ -31,6 +31,7 @@ void create_miter_equiv(struct Pass *that, std::vector<std::string> args, RTLIL:
 	bool flag_make_outcmp = false;
 	bool flag_make_assert = false;
 	bool flag_flatten = false;
+	bool flag_nomerge = false;
 
 	log_header(design, "Executing MITER pass (creating miter circuit).\n");
 
@@ -57,6 +58,10 @@ void create_miter_equiv(struct Pass *that, std::vector<std::string> args, RTLIL:
 			flag_flatten = true;
 			continue;
 		}
+		if (args[argidx] == "-nomerge") {
+			flag_nomerge = true;
+			continue;
+		}
 		break;
 	}
 	if (argidx+3 != args.size() || args[argidx].compare(0, 1, "-") == 0)
@@ -254,7 +259,23 @@ void create_miter_equiv(struct Pass *that, std::vector<std::string> args, RTLIL:
 
 	if (flag_flatten) {
 		log_push();
-		Pass::call_on_module(design, miter_module, "flatten -wb; opt_expr -keepdc -undriven;;");
+		Pass::call_on_module(design, miter_module, "flatten -wb; opt_expr -keepdc -undriven");
+		log_pop();
+
+		// Logic that gold and gate share verbatim is driven by the same
+		// in_* wires after flattening. opt_merge merges such cells and then
+		// revisits their readers, so whole shared cones collapse into one
+		// copy before the miter is handed to sat or equiv_*.
+		if (!flag_nomerge) {
+			int cells_before = GetSize(miter_module->cells_);
+			log_push();
+			Pass::call_on_module(design, miter_module, "opt_merge");
+			log_pop();
+			log("Merged %d structurally identical cells in gold and gate.\n", cells_before - GetSize(miter_module->cells_));
+		}
+
+		log_push();
+		Pass::call_on_module(design, miter_module, "clean");
 		log_pop();
 	}
 }
@@ -386,6 +407,12 @@ struct MiterPass : public Pass {
 		log("\n");
 		log("    -flatten\n");
 		log("        call 'flatten -wb; opt_expr -keepdc -undriven;;' on the miter circuit.\n");
+		log("        Identical gold and gate cells driven by the same (already merged)\n");
+		log("        signals are then merged with 'opt_merge', so logic the two modules\n");
+		log("        share verbatim only appears once in the miter.\n");
+		log("\n");
+		log("    -nomerge\n");
+		log("        do not merge identical gold and gate cells after flattening.\n");
 		log("\n");
 		log("\n");
 		log("    miter -assert [options] module [miter_name]\n");
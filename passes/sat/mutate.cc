@@ -424,7 +424,7 @@ void database_reduce(std::vector<mutate_t> &database, const mutate_opts_t &opts,
 	log("Covered %d/%d wire bits (%.2f%%).\n", covered_wirebit_cnt, GetSize(coverdb.wirebit_db), 100.0 * covered_wirebit_cnt / GetSize(coverdb.wirebit_db));
 }
 
-void mutate_list(Design *design, const mutate_opts_t &opts, const string &filename, const string &srcsfile, int N)
+std::vector<mutate_t> mutate_database(Design *design, const mutate_opts_t &opts, const string &srcsfile, int N)
 {
 	pool<string> sources;
 	std::vector<mutate_t> database;
@@ -542,6 +542,38 @@ void mutate_list(Design *design, const mutate_opts_t &opts, const string &filena
 			sout << s << std::endl;
 	}
 
+	return database;
+}
+
+string mutate_command(const mutate_t &entry, const mutate_opts_t &opts, int ctrl_value)
+{
+	string str = "mutate";
+	if (!opts.ctrl_name.empty())
+		str += stringf(" -ctrl %s %d %d", log_id(opts.ctrl_name), opts.ctrl_width, ctrl_value);
+	str += stringf(" -mode %s", entry.mode.c_str());
+	if (!entry.module.empty())
+		str += stringf(" -module %s", log_id(entry.module));
+	if (!entry.cell.empty())
+		str += stringf(" -cell %s", log_id(entry.cell));
+	if (!entry.port.empty())
+		str += stringf(" -port %s", log_id(entry.port));
+	if (entry.portbit >= 0)
+		str += stringf(" -portbit %d", entry.portbit);
+	if (entry.ctrlbit >= 0)
+		str += stringf(" -ctrlbit %d", entry.ctrlbit);
+	if (!entry.wire.empty())
+		str += stringf(" -wire %s", log_id(entry.wire));
+	if (entry.wirebit >= 0)
+		str += stringf(" -wirebit %d", entry.wirebit);
+	for (auto &s : entry.src)
+		str += stringf(" -src %s", s.c_str());
+	return str;
+}
+
+void mutate_list(Design *design, const mutate_opts_t &opts, const string &filename, const string &srcsfile, int N)
+{
+	std::vector<mutate_t> database = mutate_database(design, opts, srcsfile, N);
+
 	std::ofstream fout;
 
 	if (!filename.empty()) {
@@ -564,26 +596,7 @@ void mutate_list(Design *design, const mutate_opts_t &opts, const string &filena
 	}
 
 	for (auto &entry : database) {
-		string str = "mutate";
-		if (!opts.ctrl_name.empty())
-			str += stringf(" -ctrl %s %d %d", log_id(opts.ctrl_name), opts.ctrl_width, ctrl_value++);
-		str += stringf(" -mode %s", entry.mode.c_str());
-		if (!entry.module.empty())
-			str += stringf(" -module %s", log_id(entry.module));
-		if (!entry.cell.empty())
-			str += stringf(" -cell %s", log_id(entry.cell));
-		if (!entry.port.empty())
-			str += stringf(" -port %s", log_id(entry.port));
-		if (entry.portbit >= 0)
-			str += stringf(" -portbit %d", entry.portbit);
-		if (entry.ctrlbit >= 0)
-			str += stringf(" -ctrlbit %d", entry.ctrlbit);
-		if (!entry.wire.empty())
-			str += stringf(" -wire %s", log_id(entry.wire));
-		if (entry.wirebit >= 0)
-			str += stringf(" -wirebit %d", entry.wirebit);
-		for (auto &s : entry.src)
-			str += stringf(" -src %s", s.c_str());
+		string str = mutate_command(entry, opts, ctrl_value++);
 		if (filename.empty())
 			log("%s\n", str.c_str());
 		else
@@ -724,6 +737,85 @@ void mutate_cnot(Design *design, const mutate_opts_t &opts, bool one)
 	cell->setPort(opts.port, s);
 }
 
+void mutate_eval(Design *design, const mutate_opts_t &opts, const string &filename, int N, int cycles, const string &sim_ports)
+{
+	std::vector<mutate_t> database = mutate_database(design, opts, "", N);
+	int count = GetSize(database);
+
+	if (count == 0) {
+		log("No mutations to evaluate.\n");
+		return;
+	}
+
+	// apply all mutations to a copy of the design, each one enabled by its own
+	// value of the ctrl input, and evaluate them with the bit-parallel simulator
+	IdString ctrl_name = opts.ctrl_name.empty() ? IdString("\\mutate_sel") : opts.ctrl_name;
+	int ctrl_width = ceil_log2(count + 1);
+
+	RTLIL::Design *eval_design = new RTLIL::Design;
+	for (auto mod : design->modules())
+		eval_design->add(mod->clone());
+
+	if (eval_design->top_module() == nullptr) {
+		delete eval_design;
+		log_cmd_error("Design has no top module, use the 'hierarchy' command to specify one.\n");
+	}
+
+	log_push();
+	for (int i = 0; i < count; i++)
+	{
+		const mutate_t &entry = database[i];
+		mutate_opts_t entry_opts;
+		entry_opts.module = entry.module;
+		entry_opts.cell = entry.cell;
+		entry_opts.port = entry.port;
+		entry_opts.portbit = entry.portbit;
+		entry_opts.ctrlbit = entry.ctrlbit;
+		entry_opts.ctrl_name = ctrl_name;
+		entry_opts.ctrl_width = ctrl_width;
+		entry_opts.ctrl_value = i + 1;
+
+		if (entry.mode == "inv")
+			mutate_inv(eval_design, entry_opts);
+		else if (entry.mode == "const0" || entry.mode == "const1")
+			mutate_const(eval_design, entry_opts, entry.mode == "const1");
+		else
+			mutate_cnot(eval_design, entry_opts, entry.mode == "cnot1");
+	}
+
+	Pass::call(eval_design, "proc");
+	Pass::call(eval_design, "flatten");
+	Pass::call(eval_design, "techmap");
+	Pass::call(eval_design, "opt_clean");
+	Pass::call(eval_design, stringf("sim -mutants %s %d -n %d -seed %d%s", log_id(ctrl_name), count, cycles, opts.seed + 1, sim_ports.c_str()));
+	log_pop();
+
+	int detected = eval_design->scratchpad_get_int("sim.mutants_detected");
+	std::vector<string> undetected = split_tokens(eval_design->scratchpad_get_string("sim.mutants_undetected"));
+	delete eval_design;
+
+	log("Detected %d of %d mutants (%.1f%%).\n", detected, count, 100.0 * detected / count);
+
+	std::ofstream fout;
+	if (!filename.empty()) {
+		fout.open(filename, std::ios::out | std::ios::trunc);
+		if (!fout.is_open())
+			log_error("Could not open file \"%s\" with write access.\n", filename.c_str());
+	}
+
+	if (!undetected.empty() && filename.empty())
+		log("Undetected mutations:\n");
+
+	mutate_opts_t list_opts;
+	for (auto &idx : undetected) {
+		string str = mutate_command(database.at(atoi(idx.c_str()) - 1), list_opts, 0);
+		if (filename.empty())
+			log("  %s\n", str.c_str());
+		else
+			fout << str << std::endl;
+	}
+}
+
 struct MutatePass : public Pass {
 	MutatePass() : Pass("mutate", "generate or apply design mutations") { }
 	void help() YS_OVERRIDE
@@ -769,6 +861,28 @@ struct MutatePass : public Pass {
 		log("          weight_cover pick_cover_prcnt\n");
 		log("\n");
 		log("\n");
+		log("    mutate -eval N [options] [selection]\n");
+		log("\n");
+		log("Create a list of N mutations like -list and evaluate how many of them change\n");
+		log("the outputs of the top module under random stimulus. All mutations are applied\n");
+		log("to a copy of the design, each one enabled by a value of a new ctrl input, and\n");
+		log("the copy is flattened, mapped to gates and simulated with 'sim -mutants', which\n");
+		log("evaluates 63 mutants at a time in the lanes of the bit-parallel simulator.\n");
+		log("The undetected mutations are printed. The -seed, -ctrl (only the name is used)\n");
+		log("and filter options of -list can be used, as well as:\n");
+		log("\n");
+		log("    -o filename\n");
+		log("        Write the undetected mutations to this file instead of console output\n");
+		log("\n");
+		log("    -cycles N\n");
+		log("        Number of clock cycles to simulate (default: 20)\n");
+		log("\n");
+		log("    -clock name\n");
+		log("    -reset name\n");
+		log("    -resetn name\n");
+		log("        Clock and reset inputs of the top module, passed on to 'sim'\n");
+		log("\n");
+		log("\n");
 		log("    mutate -mode MODE [options]\n");
 		log("\n");
 		log("Apply the given mutation.\n");
@@ -795,7 +909,8 @@ struct MutatePass : public Pass {
 		mutate_opts_t opts;
 		string filename;
 		string srcsfile;
-		int N = -1;
+		string sim_ports;
+		int N = -1, eval_N = -1, cycles = 20;
 
 		log_header(design, "Executing MUTATE pass.\n");
 
@@ -806,6 +921,19 @@ struct MutatePass : public Pass {
 				N = atoi(args[++argidx].c_str());
 				continue;
 			}
+			if (args[argidx] == "-eval" && argidx+1 < args.size()) {
+				eval_N = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-cycles" && argidx+1 < args.size()) {
+				cycles = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if ((args[argidx] == "-clock" || args[argidx] == "-reset" || args[argidx] == "-resetn") && argidx+1 < args.size()) {
+				sim_ports += " " + args[argidx] + " " + args[argidx+1];
+				argidx++;
+				continue;
+			}
 			if (args[argidx] == "-o" && argidx+1 < args.size()) {
 				filename = args[++argidx];
 				continue;
@@ -925,6 +1053,11 @@ struct MutatePass : public Pass {
 			return;
 		}
 
+		if (eval_N >= 0) {
+			mutate_eval(design, opts, filename, eval_N, cycles, sim_ports);
+			return;
+		}
+
 		if (opts.mode == "none") {
 			if (!opts.ctrl_name.empty()) {
 				Module *topmod = opts.module.empty() ? design->top_module() : design->module(opts.module);
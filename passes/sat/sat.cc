@@ -27,15 +27,371 @@
 #include "kernel/sigtools.h"
 #include "kernel/log.h"
 #include "kernel/satgen.h"
+#include "kernel/threadpool.h"
+#ifdef YOSYS_ENABLE_THREADS
+#  include "libs/ezsat/ezportfolio.h"
+#endif
 #include <stdlib.h>
 #include <stdio.h>
 #include <algorithm>
+#include <queue>
 #include <errno.h>
 #include <string.h>
 
+#ifndef _WIN32
+#  include <sys/socket.h>
+#  include <sys/wait.h>
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <signal.h>
+#  include <unistd.h>
+#  include <chrono>
+#  include <thread>
+#endif
+
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
+#ifdef YOSYS_ENABLE_THREADS
+struct PortfolioSatSolver : public SatSolver
+{
+	int num_solvers;
+	SatSolver *old_satsolver;
+
+	PortfolioSatSolver(int num_solvers) : SatSolver("portfolio"), num_solvers(num_solvers) {
+		old_satsolver = yosys_satsolver;
+		yosys_satsolver = this;
+	}
+
+	~PortfolioSatSolver() {
+		yosys_satsolver = old_satsolver;
+	}
+
+	ezSAT *create() YS_OVERRIDE {
+		return new ezPortfolioSAT(num_solvers);
+	}
+};
+#endif
+
+#if !defined(_WIN32) && defined(YOSYS_ENABLE_THREADS)
+struct ExternalSatSolver : public SatSolver
+{
+	std::vector<std::string> commands;
+	SatSolver *old_satsolver;
+
+	// number of solver() calls answered by each command
+	std::mutex wins_mutex;
+	std::vector<int> wins;
+
+	ExternalSatSolver(const std::vector<std::string> &commands) : SatSolver("external"), commands(commands), wins(GetSize(commands)) {
+		old_satsolver = yosys_satsolver;
+		yosys_satsolver = this;
+	}
+
+	~ExternalSatSolver() {
+		yosys_satsolver = old_satsolver;
+	}
+
+	ezSAT *create() YS_OVERRIDE;
+};
+
+// Solves with external DIMACS solvers such as kissat or cadical. They are not
+// incremental, so every solver() call starts the commands again and streams
+// all clauses generated so far to their stdin, with the assumptions as unit
+// clauses. The clauses are written on one thread per command while the
+// answers are read, so no DIMACS text of the whole problem is built. With
+// several commands the first definite answer is used and the other solvers
+// are killed.
+struct ezExternalSAT : public ezSAT
+{
+	ExternalSatSolver *owner;
+	std::vector<std::vector<int>> clauses;
+
+	struct Process {
+		pid_t pid = -1;
+		int in_fd = -1, out_fd = -1;
+		std::string buffer;
+		std::vector<signed char> model;
+		bool done = false, answered = false, sat = false, model_done = false;
+	};
+
+	ezExternalSAT(ExternalSatSolver *owner) : owner(owner) { }
+
+	void clear() YS_OVERRIDE
+	{
+		clauses.clear();
+		ezSAT::clear();
+	}
+
+	// stdin is a socket so that writing to a solver that was killed fails
+	// with an error instead of raising SIGPIPE
+	static bool start_process(const std::string &command, Process &proc)
+	{
+		int in_fds[2], out_fds[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, in_fds) < 0)
+			return false;
+		if (pipe(out_fds) < 0) {
+			close(in_fds[0]);
+			close(in_fds[1]);
+			return false;
+		}
+		fcntl(in_fds[1], F_SETFD, FD_CLOEXEC);
+		fcntl(out_fds[0], F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+		int one = 1;
+		setsockopt(in_fds[1], SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+		proc.pid = fork();
+		if (proc.pid == 0) {
+			setpgid(0, 0);
+			dup2(in_fds[0], 0);
+			dup2(out_fds[1], 1);
+			close(in_fds[0]);
+			close(in_fds[1]);
+			close(out_fds[0]);
+			close(out_fds[1]);
+			execl("/bin/sh", "sh", "-c", command.c_str(), (char*)nullptr);
+			_exit(127);
+		}
+
+		close(in_fds[0]);
+		close(out_fds[1]);
+		if (proc.pid < 0) {
+			close(in_fds[1]);
+			close(out_fds[0]);
+			return false;
+		}
+		proc.in_fd = in_fds[1];
+		proc.out_fd = out_fds[0];
+		return true;
+	}
+
+	static bool send_all(int fd, const std::string &data)
+	{
+#ifdef MSG_NOSIGNAL
+		int flags = MSG_NOSIGNAL;
+#else
+		int flags = 0;
+#endif
+		for (size_t pos = 0; pos < data.size();) {
+			ssize_t n = send(fd, data.data() + pos, data.size() - pos, flags);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				return false;
+			pos += n;
+		}
+		return true;
+	}
+
+	void write_dimacs(int fd, const std::vector<int> &units) const
+	{
+		std::string buffer = stringf("p cnf %d %d\n", numCnfVariables(), GetSize(clauses) + GetSize(units));
+		for (auto &clause : clauses) {
+			for (auto idx : clause) {
+				buffer += std::to_string(idx);
+				buffer += ' ';
+			}
+			buffer += "0\n";
+			if (buffer.size() >= 65536) {
+				if (!send_all(fd, buffer))
+					return;
+				buffer.clear();
+			}
+		}
+		for (auto idx : units)
+			buffer += std::to_string(idx) + " 0\n";
+		send_all(fd, buffer);
+	}
+
+	// parses the complete lines of the solver output, "s" lines give the
+	// answer and "v" lines the model
+	void parse_output(Process &proc, bool eof)
+	{
+		size_t begin = 0;
+		while (1) {
+			size_t end = proc.buffer.find('\n', begin);
+			if (end == std::string::npos) {
+				if (!eof || begin == proc.buffer.size())
+					break;
+				end = proc.buffer.size();
+			}
+			const char *line = proc.buffer.c_str() + begin;
+			if (!strncmp(line, "s SATISFIABLE", 13))
+				proc.answered = true, proc.sat = true;
+			else if (!strncmp(line, "s UNSATISFIABLE", 15))
+				proc.answered = true, proc.sat = false;
+			else if (line[0] == 'v') {
+				const char *p = line + 1;
+				while (p < proc.buffer.c_str() + end) {
+					char *q;
+					long lit = strtol(p, &q, 10);
+					if (q == p)
+						break;
+					p = q;
+					if (lit == 0)
+						proc.model_done = true;
+					else if (labs(lit) < GetSize(proc.model))
+						proc.model[labs(lit)] = lit > 0 ? 1 : -1;
+				}
+			}
+			begin = end + 1;
+		}
+		proc.buffer.erase(0, std::min(begin, proc.buffer.size()));
+		if (eof || (proc.answered && (!proc.sat || proc.model_done)))
+			proc.done = true;
+	}
+
+	bool solver(const std::vector<int> &modelExpressions, std::vector<bool> &modelValues, const std::vector<int> &assumptions) YS_OVERRIDE
+	{
+		preSolverCallback();
+		solverTimoutStatus = false;
+		solverStats.calls++;
+
+		std::vector<int> units, modelIdx;
+		for (auto id : assumptions)
+			units.push_back(bind(id));
+		for (auto id : modelExpressions)
+			modelIdx.push_back(bind(id));
+
+		std::vector<std::vector<int>> cnf;
+		consumeCnf(cnf);
+		if (clauses.empty())
+			clauses.swap(cnf);
+		else
+			for (auto &clause : cnf)
+				clauses.push_back(std::move(clause));
+
+		int num_procs = GetSize(owner->commands);
+		std::vector<Process> procs(num_procs);
+		std::vector<std::thread> writers;
+
+		for (int i = 0; i < num_procs; i++) {
+			if (start_process(owner->commands[i], procs[i]))
+				continue;
+			int error = errno;
+			for (int k = 0; k < i; k++) {
+				kill(-procs[k].pid, SIGKILL);
+				kill(procs[k].pid, SIGKILL);
+				waitpid(procs[k].pid, nullptr, 0);
+			}
+			log_error("Can't start external SAT solver `%s': %s\n", owner->commands[i].c_str(), strerror(error));
+		}
+
+		for (int i = 0; i < num_procs; i++) {
+			procs[i].model.resize(numCnfVariables() + 1);
+			int fd = procs[i].in_fd;
+			writers.emplace_back([this, fd, &units]() {
+				write_dimacs(fd, units);
+				close(fd);
+			});
+		}
+
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(solverTimeout);
+		int winner = -1;
+
+		while (winner < 0)
+		{
+			std::vector<struct pollfd> pfds;
+			std::vector<int> pfd_procs;
+			for (int i = 0; i < num_procs; i++)
+				if (!procs[i].done) {
+					struct pollfd pfd;
+					pfd.fd = procs[i].out_fd;
+					pfd.events = POLLIN;
+					pfd.revents = 0;
+					pfds.push_back(pfd);
+					pfd_procs.push_back(i);
+				}
+			if (pfds.empty())
+				break;
+
+			int poll_timeout = -1;
+			if (solverTimeout > 0) {
+				auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+				if (remaining <= 0) {
+					solverTimoutStatus = true;
+					break;
+				}
+				poll_timeout = int(std::min<long long>(remaining, INT_MAX));
+			}
+
+			if (poll(pfds.data(), pfds.size(), poll_timeout) < 0) {
+				if (errno == EINTR)
+					continue;
+				log_error("Waiting for external SAT solvers failed: %s\n", strerror(errno));
+			}
+
+			for (int k = 0; k < GetSize(pfds); k++) {
+				if (pfds[k].revents == 0)
+					continue;
+				Process &proc = procs[pfd_procs[k]];
+				char block[65536];
+				ssize_t n = read(proc.out_fd, block, sizeof(block));
+				if (n < 0 && errno == EINTR)
+					continue;
+				if (n > 0)
+					proc.buffer.append(block, n);
+				parse_output(proc, n <= 0);
+				if (proc.done && proc.answered && winner < 0)
+					winner = pfd_procs[k];
+			}
+		}
+
+		for (auto &proc : procs) {
+			kill(-proc.pid, SIGKILL);
+			kill(proc.pid, SIGKILL);
+		}
+		for (auto &writer : writers)
+			writer.join();
+		for (auto &proc : procs) {
+			close(proc.out_fd);
+			while (waitpid(proc.pid, nullptr, 0) < 0 && errno == EINTR) { }
+		}
+
+		if (solverTimoutStatus)
+			return false;
+
+		if (winner < 0) {
+			std::string names;
+			for (auto &command : owner->commands)
+				names += (names.empty() ? "`" : ", `") + command + "'";
+			log_error("External SAT solver %s did not report a result.\n", names.c_str());
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(owner->wins_mutex);
+			owner->wins[winner]++;
+		}
+
+		if (!procs[winner].sat)
+			return false;
+
+		modelValues.clear();
+		modelValues.resize(modelIdx.size());
+
+		for (size_t i = 0; i < modelIdx.size(); i++)
+		{
+			int idx = modelIdx[i];
+			bool refvalue = true;
+
+			if (idx < 0)
+				idx = -idx, refvalue = false;
+
+			modelValues[i] = ((procs[winner].model.at(idx) > 0) == refvalue);
+		}
+
+		return true;
+	}
+};
+
+ezSAT *ExternalSatSolver::create()
+{
+	return new ezExternalSAT(this);
+}
+#endif
+
 struct SatHelper
 {
 	RTLIL::Design *design;
@@ -252,97 +608,106 @@ struct SatHelper
 			ez->assume(satgen.importAssumes(timestep));
 		}
 
-		if (initstate)
-		{
-			RTLIL::SigSpec big_lhs, big_rhs;
-
-			for (auto &it : module->wires_)
-			{
-				if (it.second->attributes.count("\\init") == 0)
-					continue;
+		if (initstate) {
+			int init = setup_init(timestep);
+			if (init != ez->CONST_TRUE)
+				ez->assume(init);
+		}
+	}
 
-				RTLIL::SigSpec lhs = sigmap(it.second);
-				RTLIL::SigSpec rhs = it.second->attributes.at("\\init");
-				log_assert(lhs.size() == rhs.size());
-
-				RTLIL::SigSpec removed_bits;
-				for (int i = 0; i < lhs.size(); i++) {
-					RTLIL::SigSpec bit = lhs.extract(i, 1);
-					if (rhs[i] == State::Sx || !satgen.initial_state.check_all(bit)) {
-						if (rhs[i] != State::Sx)
-							removed_bits.append(bit);
-						lhs.remove(i, 1);
-						rhs.remove(i, 1);
-						i--;
-					}
-				}
+	// returns the constraints for the initial state, the registers must have
+	// been imported for the time step already
+	int setup_init(int timestep)
+	{
+		int init = ez->CONST_TRUE;
+		RTLIL::SigSpec big_lhs, big_rhs;
 
-				if (removed_bits.size())
-					log_warning("ignoring initial value on non-register: %s\n", log_signal(removed_bits));
+		for (auto &it : module->wires_)
+		{
+			if (it.second->attributes.count("\\init") == 0)
+				continue;
 
-				if (lhs.size()) {
-					log("Import set-constraint from init attribute: %s = %s\n", log_signal(lhs), log_signal(rhs));
-					big_lhs.remove2(lhs, &big_rhs);
-					big_lhs.append(lhs);
-					big_rhs.append(rhs);
+			RTLIL::SigSpec lhs = sigmap(it.second);
+			RTLIL::SigSpec rhs = it.second->attributes.at("\\init");
+			log_assert(lhs.size() == rhs.size());
+
+			RTLIL::SigSpec removed_bits;
+			for (int i = 0; i < lhs.size(); i++) {
+				RTLIL::SigSpec bit = lhs.extract(i, 1);
+				if (rhs[i] == State::Sx || !satgen.initial_state.check_all(bit)) {
+					if (rhs[i] != State::Sx)
+						removed_bits.append(bit);
+					lhs.remove(i, 1);
+					rhs.remove(i, 1);
+					i--;
 				}
 			}
 
-			for (auto &s : sets_init)
-			{
-				RTLIL::SigSpec lhs, rhs;
-
-				if (!RTLIL::SigSpec::parse_sel(lhs, design, module, s.first))
-					log_cmd_error("Failed to parse lhs set expression `%s'.\n", s.first.c_str());
-				if (!RTLIL::SigSpec::parse_rhs(lhs, rhs, module, s.second))
-					log_cmd_error("Failed to parse rhs set expression `%s'.\n", s.second.c_str());
-				show_signal_pool.add(sigmap(lhs));
-				show_signal_pool.add(sigmap(rhs));
+			if (removed_bits.size())
+				log_warning("ignoring initial value on non-register: %s\n", log_signal(removed_bits));
 
-				if (lhs.size() != rhs.size())
-					log_cmd_error("Set expression with different lhs and rhs sizes: %s (%s, %d bits) vs. %s (%s, %d bits)\n",
-						s.first.c_str(), log_signal(lhs), lhs.size(), s.second.c_str(), log_signal(rhs), rhs.size());
-
-				log("Import init set-constraint: %s = %s\n", log_signal(lhs), log_signal(rhs));
+			if (lhs.size()) {
+				log("Import set-constraint from init attribute: %s = %s\n", log_signal(lhs), log_signal(rhs));
 				big_lhs.remove2(lhs, &big_rhs);
 				big_lhs.append(lhs);
 				big_rhs.append(rhs);
 			}
+		}
 
-			if (!satgen.initial_state.check_all(big_lhs)) {
-				RTLIL::SigSpec rem = satgen.initial_state.remove(big_lhs);
-				log_cmd_error("Found -set-init bits that are not part of the initial_state: %s\n", log_signal(rem));
-			}
+		for (auto &s : sets_init)
+		{
+			RTLIL::SigSpec lhs, rhs;
 
-			if (set_init_def) {
-				RTLIL::SigSpec rem = satgen.initial_state.export_all();
-				std::vector<int> undef_rem = satgen.importUndefSigSpec(rem, 1);
-				ez->assume(ez->NOT(ez->expression(ezSAT::OpOr, undef_rem)));
-			}
+			if (!RTLIL::SigSpec::parse_sel(lhs, design, module, s.first))
+				log_cmd_error("Failed to parse lhs set expression `%s'.\n", s.first.c_str());
+			if (!RTLIL::SigSpec::parse_rhs(lhs, rhs, module, s.second))
+				log_cmd_error("Failed to parse rhs set expression `%s'.\n", s.second.c_str());
+			show_signal_pool.add(sigmap(lhs));
+			show_signal_pool.add(sigmap(rhs));
 
-			if (set_init_undef) {
-				RTLIL::SigSpec rem = satgen.initial_state.export_all();
-				rem.remove(big_lhs);
-				big_lhs.append(rem);
-				big_rhs.append(RTLIL::SigSpec(RTLIL::State::Sx, rem.size()));
-			}
+			if (lhs.size() != rhs.size())
+				log_cmd_error("Set expression with different lhs and rhs sizes: %s (%s, %d bits) vs. %s (%s, %d bits)\n",
+					s.first.c_str(), log_signal(lhs), lhs.size(), s.second.c_str(), log_signal(rhs), rhs.size());
 
-			if (set_init_zero) {
-				RTLIL::SigSpec rem = satgen.initial_state.export_all();
-				rem.remove(big_lhs);
-				big_lhs.append(rem);
-				big_rhs.append(RTLIL::SigSpec(RTLIL::State::S0, rem.size()));
-			}
+			log("Import init set-constraint: %s = %s\n", log_signal(lhs), log_signal(rhs));
+			big_lhs.remove2(lhs, &big_rhs);
+			big_lhs.append(lhs);
+			big_rhs.append(rhs);
+		}
 
-			if (big_lhs.size() == 0) {
-				log("No constraints for initial state found.\n\n");
-				return;
-			}
+		if (!satgen.initial_state.check_all(big_lhs)) {
+			RTLIL::SigSpec rem = satgen.initial_state.remove(big_lhs);
+			log_cmd_error("Found -set-init bits that are not part of the initial_state: %s\n", log_signal(rem));
+		}
 
-			log("Final init constraint equation: %s = %s\n", log_signal(big_lhs), log_signal(big_rhs));
-			check_undef_enabled(big_lhs), check_undef_enabled(big_rhs);
-			ez->assume(satgen.signals_eq(big_lhs, big_rhs, timestep));
+		if (set_init_def) {
+			RTLIL::SigSpec rem = satgen.initial_state.export_all();
+			std::vector<int> undef_rem = satgen.importUndefSigSpec(rem, 1);
+			init = ez->NOT(ez->expression(ezSAT::OpOr, undef_rem));
+		}
+
+		if (set_init_undef) {
+			RTLIL::SigSpec rem = satgen.initial_state.export_all();
+			rem.remove(big_lhs);
+			big_lhs.append(rem);
+			big_rhs.append(RTLIL::SigSpec(RTLIL::State::Sx, rem.size()));
 		}
+
+		if (set_init_zero) {
+			RTLIL::SigSpec rem = satgen.initial_state.export_all();
+			rem.remove(big_lhs);
+			big_lhs.append(rem);
+			big_rhs.append(RTLIL::SigSpec(RTLIL::State::S0, rem.size()));
+		}
+
+		if (big_lhs.size() == 0) {
+			log("No constraints for initial state found.\n\n");
+			return init;
+		}
+
+		log("Final init constraint equation: %s = %s\n", log_signal(big_lhs), log_signal(big_rhs));
+		check_undef_enabled(big_lhs), check_undef_enabled(big_rhs);
+		return ez->AND(init, satgen.signals_eq(big_lhs, big_rhs, timestep));
 	}
 
 	int setup_proof(int timestep = -1)
@@ -621,9 +986,9 @@ struct SatHelper
 			bool found_undef = false;
 
 			for (int i = 0; i < info.width; i++) {
-				value.bits.push_back(modelValues.at(info.offset+i) ? RTLIL::State::S1 : RTLIL::State::S0);
+				value.bits().push_back(modelValues.at(info.offset+i) ? RTLIL::State::S1 : RTLIL::State::S0);
 				if (enable_undef && modelValues.at(modelExpressions.size()/2 + info.offset + i))
-					value.bits.back() = RTLIL::State::Sx, found_undef = true;
+					value.bits().back() = RTLIL::State::Sx, found_undef = true;
 			}
 
 			if (info.timestep != last_timestep) {
@@ -732,9 +1097,9 @@ struct SatHelper
 			RTLIL::Const value;
 
 			for (int i = 0; i < info.width; i++) {
-				value.bits.push_back(modelValues.at(info.offset+i) ? RTLIL::State::S1 : RTLIL::State::S0);
+				value.bits().push_back(modelValues.at(info.offset+i) ? RTLIL::State::S1 : RTLIL::State::S0);
 				if (enable_undef && modelValues.at(modelExpressions.size()/2 + info.offset + i))
-					value.bits.back() = RTLIL::State::Sx;
+					value.bits().back() = RTLIL::State::Sx;
 			}
 
 			if (info.timestep != last_timestep) {
@@ -746,11 +1111,11 @@ struct SatHelper
 			}
 
 			if(info.width == 1) {
-				fprintf(f, "%c%s\n", bitvals[value.bits[0]], vcdnames[info.description].c_str());
+				fprintf(f, "%c%s\n", bitvals[value[0]], vcdnames[info.description].c_str());
 			} else {
 				fprintf(f, "b");
 				for(int k=info.width-1; k >= 0; k --)	//need to flip bit ordering for VCD
-					fprintf(f, "%c", bitvals[value.bits[k]]);
+					fprintf(f, "%c", bitvals[value[k]]);
 				fprintf(f, " %s\n", vcdnames[info.description].c_str());
 			}
 		}
@@ -777,9 +1142,9 @@ struct SatHelper
 		{
 			Const value;
 			for (int i = 0; i < info.width; i++) {
-				value.bits.push_back(modelValues.at(info.offset+i) ? RTLIL::State::S1 : RTLIL::State::S0);
+				value.bits().push_back(modelValues.at(info.offset+i) ? RTLIL::State::S1 : RTLIL::State::S0);
 				if (enable_undef && modelValues.at(modelExpressions.size()/2 + info.offset + i))
-					value.bits.back() = RTLIL::State::Sx;
+					value.bits().back() = RTLIL::State::Sx;
 			}
 
 			wavedata[info.description].first = info.width;
@@ -853,6 +1218,327 @@ struct SatHelper
 	}
 };
 
+// [[CITE]] SAT-Based Model Checking without Unrolling
+// Aaron R. Bradley (2011)
+// https://doi.org/10.1007/978-3-642-18275-4_7
+//
+// [[CITE]] Efficient implementation of property directed reachability
+// Niklas Een, Alan Mishchenko, Robert Brayton (2011)
+// https://ieeexplore.ieee.org/document/6148886
+
+// Property directed reachability on one incremental SAT instance that holds
+// the circuit for time step 1 and the registers for time step 2. Frame i is
+// the set of clauses blocked in frames >= i, each clause is enabled by the
+// activation literal of the frame it was added for.
+struct SatPdr
+{
+	// cubes over the state bits, +(i+1) for bit i set and -(i+1) for unset
+	typedef std::vector<int> Cube;
+
+	struct Obligation {
+		int level, depth;
+		Cube cube;
+		bool operator<(const Obligation &other) const {
+			return level > other.level;
+		}
+	};
+
+	struct Timeout { };
+
+	SatHelper &helper;
+	ezSAT *ez;
+	std::vector<int> state[2];
+	int init_act, property;
+	std::vector<int> frame_acts;
+	std::vector<std::vector<Cube>> frames;
+	int num_queries;
+
+	SatPdr(SatHelper &helper) : helper(helper), ez(helper.ez.get()), num_queries(0)
+	{
+		RTLIL::Design *design = helper.design;
+		RTLIL::Module *module = helper.module;
+
+		helper.setup(1);
+		property = helper.setup_proof(1);
+		init_act = ez->frozen_literal();
+		ez->assume(ez->OR(ez->NOT(init_act), helper.setup_init(1)));
+
+		// $anyconst outputs keep their value and are part of the state
+		RTLIL::SigSpec state_sig = helper.satgen.initial_state.export_all();
+		for (auto cell : module->cells())
+			if (design->selected(module, cell) && cell->type == ID($anyconst))
+				state_sig.append(helper.sigmap(cell->getPort(ID::Y)));
+		state_sig.sort_and_unify();
+
+		for (auto cell : module->cells())
+			if (design->selected(module, cell) && cell->type.in(ID($ff), ID($dff), ID($_FF_), ID($_DFF_N_), ID($_DFF_P_), ID($anyconst)))
+				helper.satgen.importCell(cell, 2);
+
+		state[0] = helper.satgen.importDefSigSpec(state_sig, 1);
+		state[1] = helper.satgen.importDefSigSpec(state_sig, 2);
+		log("\nUsing %d state bits: %s\n", GetSize(state_sig), log_signal(state_sig));
+
+		frame_acts.push_back(0);
+		frames.push_back(std::vector<Cube>());
+	}
+
+	int depth() const
+	{
+		return GetSize(frames) - 1;
+	}
+
+	std::vector<int> cube_literals(const Cube &cube, int timestep) const
+	{
+		std::vector<int> literals;
+		for (int lit : cube) {
+			int bit = state[timestep-1].at(abs(lit)-1);
+			literals.push_back(lit > 0 ? bit : ez->NOT(bit));
+		}
+		return literals;
+	}
+
+	std::vector<int> frame_assumptions(int level) const
+	{
+		if (level == 0)
+			return std::vector<int>(1, init_act);
+		return std::vector<int>(frame_acts.begin() + level, frame_acts.end());
+	}
+
+	bool query(const std::vector<int> &assumptions, Cube *model = nullptr)
+	{
+		std::vector<bool> values;
+		num_queries++;
+		ez->setSolverTimeout(helper.timeout);
+		bool sat = ez->solve(model ? state[0] : std::vector<int>(), values, assumptions);
+		if (ez->getSolverTimoutStatus())
+			throw Timeout();
+		if (sat && model) {
+			model->clear();
+			for (int i = 0; i < GetSize(values); i++)
+				model->push_back(values[i] ? i+1 : -(i+1));
+		}
+		return sat;
+	}
+
+	// true if cube@2 can be reached from frame level-1 without going through cube@1
+	bool query_relative(const Cube &cube, int level, Cube *model = nullptr)
+	{
+		int act = ez->frozen_literal();
+		std::vector<int> clause = ez->vec_not(cube_literals(cube, 1));
+		clause.push_back(ez->NOT(act));
+		ez->assume(ez->expression(ezSAT::OpOr, clause));
+
+		std::vector<int> assumptions = frame_assumptions(level-1);
+		assumptions.push_back(act);
+		for (int lit : cube_literals(cube, 2))
+			assumptions.push_back(lit);
+		bool sat = query(assumptions, model);
+
+		ez->assume(ez->NOT(act));
+		return sat;
+	}
+
+	void add_frame()
+	{
+		frame_acts.push_back(ez->frozen_literal());
+		frames.push_back(std::vector<Cube>());
+	}
+
+	void add_blocked(const Cube &cube, int level)
+	{
+		std::vector<int> clause = ez->vec_not(cube_literals(cube, 1));
+		clause.push_back(ez->NOT(frame_acts.at(level)));
+		ez->assume(ez->expression(ezSAT::OpOr, clause));
+		frames.at(level).push_back(cube);
+	}
+
+	// drop literals as long as the cube stays disjoint from the initial states
+	// and blocked relative to the previous frame
+	Cube generalize(Cube cube, int level)
+	{
+		for (int i = 0; i < GetSize(cube) && GetSize(cube) > 1; i++)
+		{
+			Cube candidate = cube;
+			candidate.erase(candidate.begin() + i);
+
+			std::vector<int> assumptions = cube_literals(candidate, 1);
+			assumptions.push_back(init_act);
+			if (query(assumptions) || query_relative(candidate, level))
+				continue;
+
+			cube.swap(candidate);
+			i--;
+		}
+		return cube;
+	}
+
+	// returns the length of a counterexample, or 0 when the cube was blocked
+	int block(const Cube &bad)
+	{
+		std::priority_queue<Obligation> obligations;
+		obligations.push(Obligation{depth(), 1, bad});
+
+		while (!obligations.empty())
+		{
+			Obligation ob = obligations.top();
+
+			std::vector<int> assumptions = frame_assumptions(ob.level);
+			for (int lit : cube_literals(ob.cube, 1))
+				assumptions.push_back(lit);
+			if (!query(assumptions)) {
+				obligations.pop();
+				continue;
+			}
+
+			Cube pred;
+			if (query_relative(ob.cube, ob.level, &pred)) {
+				if (ob.level == 1)
+					return ob.depth + 1;
+				obligations.push(Obligation{ob.level-1, ob.depth+1, pred});
+				continue;
+			}
+
+			obligations.pop();
+			Cube cube = generalize(ob.cube, ob.level);
+			int level = ob.level;
+			while (level < depth() && !query_relative(cube, level+1))
+				level++;
+			add_blocked(cube, level);
+		}
+
+		return 0;
+	}
+
+	// returns 0 if the property holds, the length of a counterexample if it
+	// fails and -1 if the frame limit was reached
+	int run(int maxframes)
+	{
+		log("\n[pdr] Checking initial states..\n");
+		log_flush();
+		if (query(std::vector<int>{init_act, ez->NOT(property)}))
+			return 1;
+
+		add_frame();
+		while (1)
+		{
+			while (1) {
+				Cube bad;
+				std::vector<int> assumptions = frame_assumptions(depth());
+				assumptions.push_back(ez->NOT(property));
+				if (!query(assumptions, &bad))
+					break;
+				int length = block(bad);
+				if (length > 0)
+					return length;
+			}
+
+			if (maxframes > 0 && depth() >= maxframes)
+				return -1;
+
+			add_frame();
+			for (int level = 1; level < depth(); level++)
+			{
+				std::vector<Cube> cubes;
+				cubes.swap(frames[level]);
+				for (auto &cube : cubes) {
+					std::vector<int> assumptions = frame_assumptions(level);
+					for (int lit : cube_literals(cube, 2))
+						assumptions.push_back(lit);
+					if (query(assumptions))
+						frames[level].push_back(cube);
+					else
+						add_blocked(cube, level+1);
+				}
+
+				if (frames[level].empty()) {
+					int num_clauses = 0;
+					for (int i = level+1; i <= depth(); i++)
+						num_clauses += GetSize(frames[i]);
+					log("[pdr] Frame %d is inductive, invariant with %d clauses found after %d queries.\n",
+							level, num_clauses, num_queries);
+					return 0;
+				}
+			}
+
+			log("[pdr] Frame %d:", depth());
+			for (int level = 1; level <= depth(); level++)
+				log(" %d", GetSize(frames[level]));
+			log(" clauses, %d queries so far.\n", num_queries);
+			log_flush();
+		}
+	}
+};
+
+// Splits the $assert cells into groups with overlapping input cones, so that
+// each group can be checked by its own solver without importing much of the
+// logic more than once. The groups have at most ceil(n/num_groups) asserts.
+std::vector<std::vector<RTLIL::Cell*>> group_asserts(RTLIL::Design *design, RTLIL::Module *module, const std::vector<RTLIL::Cell*> &asserts, int num_groups)
+{
+	SigMap sigmap(module);
+	CellTypes ct(design);
+
+	dict<RTLIL::SigBit, RTLIL::Cell*> drivers;
+	for (auto cell : module->selected_cells())
+		for (auto &conn : cell->connections())
+			if (ct.cell_output(cell->type, conn.first))
+				for (auto bit : sigmap(conn.second))
+					drivers[bit] = cell;
+
+	std::vector<pool<RTLIL::Cell*>> cones;
+	for (auto cell : asserts) {
+		pool<RTLIL::Cell*> cone;
+		std::vector<RTLIL::Cell*> queue(1, cell);
+		while (!queue.empty()) {
+			RTLIL::Cell *c = queue.back();
+			queue.pop_back();
+			if (!cone.insert(c).second)
+				continue;
+			for (auto &conn : c->connections())
+				if (!ct.cell_output(c->type, conn.first))
+					for (auto bit : sigmap(conn.second)) {
+						auto it = drivers.find(bit);
+						if (it != drivers.end() && !cone.count(it->second))
+							queue.push_back(it->second);
+					}
+		}
+		cones.push_back(cone);
+	}
+
+	// the largest cones are placed first, each into the group it shares the
+	// most cells with, or the smallest group
+	std::vector<int> order;
+	for (int i = 0; i < GetSize(asserts); i++)
+		order.push_back(i);
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return GetSize(cones[a]) > GetSize(cones[b]); });
+
+	int max_size = (GetSize(asserts) + num_groups - 1) / num_groups;
+	std::vector<std::vector<RTLIL::Cell*>> groups(num_groups);
+	std::vector<pool<RTLIL::Cell*>> group_cells(num_groups);
+
+	for (int i : order) {
+		int best = -1, best_overlap = -1;
+		for (int g = 0; g < num_groups; g++) {
+			if (GetSize(groups[g]) >= max_size)
+				continue;
+			int overlap = 0;
+			for (auto c : cones[i])
+				if (group_cells[g].count(c))
+					overlap++;
+			if (overlap > best_overlap || (overlap == best_overlap && GetSize(group_cells[g]) < GetSize(group_cells[best])))
+				best = g, best_overlap = overlap;
+		}
+		groups[best].push_back(asserts[i]);
+		for (auto c : cones[i])
+			group_cells[best].insert(c);
+	}
+
+	std::vector<std::vector<RTLIL::Cell*>> result;
+	for (auto &group : groups)
+		if (!group.empty())
+			result.push_back(group);
+	return result;
+}
+
 void print_proof_failed()
 {
 	log("\n");
@@ -1010,6 +1696,21 @@ struct SatPass : public Pass {
 		log("    -tempinduct-inductonly\n");
 		log("        Run only the induction half of temporal induction\n");
 		log("\n");
+		log("    -tempinduct-parallel\n");
+		log("        Perform a temporal induction proof, unrolling the base case and the\n");
+		log("        induction step on two threads that each advance their own length.\n");
+		log("        The result is the same as with -tempinduct, but the log output of the\n");
+		log("        two halves is printed one after the other.\n");
+		log("\n");
+		log("    -pdr\n");
+		log("        Prove that the -prove and -prove-asserts conditions hold in all\n");
+		log("        reachable states with property directed reachability (IC3). Unlike\n");
+		log("        temporal induction this needs no induction length or invariants, the\n");
+		log("        inductive invariant is built from clauses over the registers. With\n");
+		log("        -maxsteps the number of frames is limited. -set, -set-assumes and\n");
+		log("        -set-init* are applied to all time steps, undef modeling, -seq and the\n");
+		log("        *-at options are not supported.\n");
+		log("\n");
 		log("    -tempinduct-skip <N>\n");
 		log("        Skip the first <N> steps of the induction proof.\n");
 		log("\n");
@@ -1028,6 +1729,14 @@ struct SatPass : public Pass {
 		log("    -prove-asserts\n");
 		log("        Prove that all asserts in the design hold.\n");
 		log("\n");
+		log("    -assert-groups <N>\n");
+		log("        Like -prove-asserts, but check each $assert cell on its own and report\n");
+		log("        the first time step in which it fails. The asserts are split into <N>\n");
+		log("        groups with overlapping input cones, each group is checked with its\n");
+		log("        own solver on its own thread. Asserts that hold in a time step are\n");
+		log("        assumed for the later ones. This can't be combined with -tempinduct,\n");
+		log("        -pdr, -prove, -prove-x or the -dump_* options.\n");
+		log("\n");
 		log("    -prove-skip <N>\n");
 		log("        Do not enforce the prove-condition for the first <N> time steps.\n");
 		log("\n");
@@ -1047,6 +1756,25 @@ struct SatPass : public Pass {
 		log("    -timeout <N>\n");
 		log("        Maximum number of seconds a single SAT instance may take.\n");
 		log("\n");
+		log("    -portfolio <N>\n");
+		log("        Run <N> differently configured MiniSAT instances in parallel threads\n");
+		log("        and use the answer of the first one to finish. This can help with\n");
+		log("        hard -prove and -tempinduct problems. The proof result does not\n");
+		log("        depend on <N>, but the counter-examples that are found may differ\n");
+		log("        from run to run.\n");
+		log("\n");
+		log("    -solver-cmd <command>\n");
+		log("        Solve with an external SAT solver that reads DIMACS CNF from stdin\n");
+		log("        and prints the result in the SAT competition format, for example\n");
+		log("        -solver-cmd kissat or -solver-cmd \"cadical -q\". The clauses are\n");
+		log("        streamed to the solver, which is started again for every SAT call.\n");
+		log("        When this option is given more than once, the solvers run in\n");
+		log("        parallel and the first answer is used. (not on Windows)\n");
+		log("\n");
+		log("    -stats\n");
+		log("        Print the statistics of the SAT solver (calls, conflicts, decisions,\n");
+		log("        propagations, restarts and variable eliminations) at the end.\n");
+		log("\n");
 		log("    -verify\n");
 		log("        Return an error and stop the synthesis script if the proof fails.\n");
 		log("\n");
@@ -1065,15 +1793,17 @@ struct SatPass : public Pass {
 		std::vector<std::pair<std::string, std::string>> sets, sets_init, prove, prove_x;
 		std::map<int, std::vector<std::pair<std::string, std::string>>> sets_at;
 		std::map<int, std::vector<std::string>> unsets_at, sets_def_at, sets_any_undef_at, sets_all_undef_at;
-		std::vector<std::string> shows, sets_def, sets_any_undef, sets_all_undef;
-		int loopcount = 0, seq_len = 0, maxsteps = 0, initsteps = 0, timeout = 0, prove_skip = 0;
+		std::vector<std::string> shows, sets_def, sets_any_undef, sets_all_undef, solver_cmds;
+		int loopcount = 0, seq_len = 0, maxsteps = 0, initsteps = 0, timeout = 0, prove_skip = 0, portfolio = 0;
 		bool verify = false, fail_on_timeout = false, enable_undef = false, set_def_inputs = false;
 		bool ignore_div_by_zero = false, set_init_undef = false, set_init_zero = false, max_undef = false;
 		bool tempinduct = false, prove_asserts = false, show_inputs = false, show_outputs = false;
 		bool show_regs = false, show_public = false, show_all = false;
 		bool ignore_unknown_cells = false, falsify = false, tempinduct_def = false, set_init_def = false;
-		bool tempinduct_baseonly = false, tempinduct_inductonly = false, set_assumes = false;
+		bool tempinduct_baseonly = false, tempinduct_inductonly = false, tempinduct_parallel = false, set_assumes = false;
 		int tempinduct_skip = 0, stepsize = 1;
+		bool pdr = false, show_stats = false;
+		int assert_groups = 0;
 		std::string vcd_file_name, json_file_name, cnf_file_name;
 
 		log_header(design, "Executing SAT pass (solving SAT problems in the circuit).\n");
@@ -1106,6 +1836,21 @@ struct SatPass : public Pass {
 				timeout = atoi(args[++argidx].c_str());
 				continue;
 			}
+			if (args[argidx] == "-portfolio" && argidx+1 < args.size()) {
+				portfolio = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-solver-cmd" && argidx+1 < args.size()) {
+				std::string command = args[++argidx];
+				if (command.size() >= 2 && command.front() == '"' && command.back() == '"')
+					command = command.substr(1, command.size()-2);
+				solver_cmds.push_back(command);
+				continue;
+			}
+			if (args[argidx] == "-stats") {
+				show_stats = true;
+				continue;
+			}
 			if (args[argidx] == "-max" && argidx+1 < args.size()) {
 				loopcount = atoi(args[++argidx].c_str());
 				continue;
@@ -1185,10 +1930,19 @@ struct SatPass : public Pass {
 				tempinduct_inductonly = true;
 				continue;
 			}
+			if (args[argidx] == "-tempinduct-parallel") {
+				tempinduct = true;
+				tempinduct_parallel = true;
+				continue;
+			}
 			if (args[argidx] == "-tempinduct-skip" && argidx+1 < args.size()) {
 				tempinduct_skip = atoi(args[++argidx].c_str());
 				continue;
 			}
+			if (args[argidx] == "-pdr") {
+				pdr = true;
+				continue;
+			}
 			if (args[argidx] == "-prove" && argidx+2 < args.size()) {
 				std::string lhs = args[++argidx];
 				std::string rhs = args[++argidx];
@@ -1206,6 +1960,11 @@ struct SatPass : public Pass {
 				prove_asserts = true;
 				continue;
 			}
+			if (args[argidx] == "-assert-groups" && argidx+1 < args.size()) {
+				assert_groups = std::max(atoi(args[++argidx].c_str()), 1);
+				prove_asserts = true;
+				continue;
+			}
 			if (args[argidx] == "-prove-skip" && argidx+1 < args.size()) {
 				prove_skip = atoi(args[++argidx].c_str());
 				continue;
@@ -1312,6 +2071,37 @@ struct SatPass : public Pass {
 		}
 		extra_args(args, argidx, design);
 
+		ezSAT::SolverStats stats_before = get_sat_stats();
+
+#ifdef YOSYS_ENABLE_THREADS
+		std::unique_ptr<PortfolioSatSolver> portfolio_solver;
+		if (portfolio > 1) {
+			log("Using a portfolio of %d SAT solvers.\n", portfolio);
+			portfolio_solver.reset(new PortfolioSatSolver(portfolio));
+		}
+#else
+		if (portfolio > 1)
+			log_cmd_error("This version of Yosys is built without thread support, -portfolio is not available.\n");
+#endif
+
+		if (portfolio > 1 && !solver_cmds.empty())
+			log_cmd_error("Options -portfolio and -solver-cmd can't be combined.\n");
+
+#if !defined(_WIN32) && defined(YOSYS_ENABLE_THREADS)
+		std::unique_ptr<ExternalSatSolver> external_solver;
+		if (!solver_cmds.empty()) {
+			for (auto &command : solver_cmds)
+				log("Using external SAT solver `%s'.\n", command.c_str());
+			external_solver.reset(new ExternalSatSolver(solver_cmds));
+		}
+#elif defined(_WIN32)
+		if (!solver_cmds.empty())
+			log_cmd_error("Option -solver-cmd is not available on Windows.\n");
+#else
+		if (!solver_cmds.empty())
+			log_cmd_error("This version of Yosys is built without thread support, -solver-cmd is not available.\n");
+#endif
+
 		RTLIL::Module *module = NULL;
 		for (auto mod : design->selected_modules()) {
 			if (module)
@@ -1324,6 +2114,41 @@ struct SatPass : public Pass {
 		if (!prove.size() && !prove_x.size() && !prove_asserts && tempinduct)
 			log_cmd_error("Got -tempinduct but nothing to prove!\n");
 
+		if (assert_groups > 0) {
+			if (tempinduct || pdr || prove.size() || prove_x.size())
+				log_cmd_error("Option -assert-groups can't be combined with -tempinduct*, -pdr, -prove or -prove-x.\n");
+			if (loopcount > 0 || max_undef)
+				log_cmd_error("The options -max, -all, and -max_undef are not supported with -assert-groups!\n");
+			if (!vcd_file_name.empty() || !json_file_name.empty() || !cnf_file_name.empty())
+				log_cmd_error("The -dump_* options are not supported with -assert-groups.\n");
+		}
+
+		if (pdr) {
+			if (!prove.size() && !prove_asserts)
+				log_cmd_error("Got -pdr but nothing to prove!\n");
+			if (tempinduct || seq_len > 0 || prove_skip > 0)
+				log_cmd_error("Option -pdr can't be combined with -tempinduct*, -seq or -prove-skip.\n");
+			if (loopcount > 0 || max_undef)
+				log_cmd_error("The options -max, -all, and -max_undef are not supported for -pdr proofs!\n");
+			if (enable_undef || prove_x.size())
+				log_cmd_error("Undef modeling (-enable_undef, -set-def*, -set-*-undef*, -prove-x) is not supported with -pdr.\n");
+			if (!sets_at.empty() || !unsets_at.empty())
+				log_cmd_error("The options -set-at and -unset-at are not supported with -pdr.\n");
+			for (auto cell : module->selected_cells())
+				if (cell->type == ID($initstate))
+					log_cmd_error("Found $initstate cell %s, which is not supported with -pdr.\n", log_id(cell));
+		}
+
+		if (tempinduct_parallel) {
+#ifndef YOSYS_ENABLE_THREADS
+			log_cmd_error("This version of Yosys is built without thread support, -tempinduct-parallel is not available.\n");
+#endif
+			if (tempinduct_baseonly || tempinduct_inductonly)
+				log_cmd_error("Option -tempinduct-parallel can't be combined with -tempinduct-baseonly or -tempinduct-inductonly.\n");
+			if (timeout)
+				log_cmd_error("Option -tempinduct-parallel can't be combined with -timeout.\n");
+		}
+
 		if (prove_skip && tempinduct)
 			log_cmd_error("Options -prove-skip and -tempinduct don't work with each other. Use -seq instead of -prove-skip.\n");
 
@@ -1374,7 +2199,211 @@ struct SatPass : public Pass {
 				shows.push_back(wire->name.str());
 		}
 
-		if (tempinduct)
+		if (assert_groups > 0)
+		{
+			std::vector<RTLIL::Cell*> asserts;
+			for (auto cell : module->selected_cells())
+				if (cell->type == ID($assert))
+					asserts.push_back(cell);
+			if (asserts.empty())
+				log_cmd_error("Got -assert-groups but there are no $assert cells!\n");
+
+			std::vector<std::vector<RTLIL::Cell*>> groups = group_asserts(design, module, asserts, assert_groups);
+			int num_steps = std::max(seq_len, 1);
+			log("Checking %d asserts in %d groups for %d time steps.\n", GetSize(asserts), GetSize(groups), num_steps);
+
+			// per assert: 0 = holds, > 0 = first failing time step, -1 = timeout
+			std::vector<std::vector<int>> results(GetSize(groups));
+
+			auto check_group = [&](int g)
+			{
+				const std::vector<RTLIL::Cell*> &group = groups[g];
+				std::vector<int> &result = results[g];
+				result.assign(GetSize(group), 0);
+
+				SatHelper helper(design, module, enable_undef);
+				helper.sets = sets;
+				helper.set_assumes = set_assumes;
+				helper.sets_at = sets_at;
+				helper.unsets_at = unsets_at;
+				helper.shows = shows;
+				helper.timeout = timeout;
+				helper.sets_def = sets_def;
+				helper.sets_any_undef = sets_any_undef;
+				helper.sets_all_undef = sets_all_undef;
+				helper.sets_def_at = sets_def_at;
+				helper.sets_any_undef_at = sets_any_undef_at;
+				helper.sets_all_undef_at = sets_all_undef_at;
+				helper.sets_init = sets_init;
+				helper.set_init_def = set_init_def;
+				helper.set_init_undef = set_init_undef;
+				helper.set_init_zero = set_init_zero;
+				helper.satgen.ignore_div_by_zero = ignore_div_by_zero;
+				helper.ignore_unknown_cells = ignore_unknown_cells;
+				for (auto cell : group) {
+					helper.show_signal_pool.add(helper.sigmap(cell->getPort(ID::A)));
+					helper.show_signal_pool.add(helper.sigmap(cell->getPort(ID(EN))));
+				}
+
+				log("\n** Checking assert group %d with %d asserts **\n", g+1, GetSize(group));
+
+				for (int step = 1; step <= num_steps; step++)
+				{
+					int timestep = seq_len > 0 ? step : -1;
+					helper.setup(timestep, timestep == 1);
+
+					std::vector<int> pending, checks;
+					for (int i = 0; i < GetSize(group); i++) {
+						if (result[i] != 0)
+							continue;
+						SigSpec sig_a = group[i]->getPort(ID::A), sig_en = group[i]->getPort(ID(EN));
+						int a = helper.satgen.importDefSigSpec(sig_a, timestep).at(0);
+						int en = helper.satgen.importDefSigSpec(sig_en, timestep).at(0);
+						if (enable_undef) {
+							a = helper.ez->AND(a, helper.ez->NOT(helper.satgen.importUndefSigSpec(sig_a, timestep).at(0)));
+							en = helper.ez->AND(en, helper.ez->NOT(helper.satgen.importUndefSigSpec(sig_en, timestep).at(0)));
+						}
+						pending.push_back(i);
+						checks.push_back(helper.ez->OR(a, helper.ez->NOT(en)));
+					}
+					if (pending.empty() || step <= prove_skip)
+						continue;
+
+					helper.generate_model();
+					log("\n[group %d, step %d] Solving problem with %d variables and %d clauses..\n",
+							g+1, step, helper.ez->numCnfVariables(), helper.ez->numCnfClauses());
+					log_flush();
+
+					if (helper.solve(helper.ez->NOT(helper.ez->expression(ezSAT::OpAnd, checks))))
+						for (int j = 0; j < GetSize(pending); j++) {
+							if (!helper.solve(helper.ez->NOT(checks[j]))) {
+								if (helper.gotTimeout)
+									break;
+								continue;
+							}
+							result[pending[j]] = step;
+							log("\nAssert %s fails in step %d:\n", log_id(group[pending[j]]), step);
+							helper.print_model();
+						}
+
+					if (helper.gotTimeout) {
+						for (int i : pending)
+							if (result[i] == 0)
+								result[i] = -1;
+						log("\n[group %d, step %d] Interrupted SAT solver: TIMEOUT!\n", g+1, step);
+						return;
+					}
+
+					for (int j = 0; j < GetSize(pending); j++)
+						if (result[pending[j]] == 0)
+							helper.ez->assume(checks[j]);
+				}
+			};
+
+			TaskGroup group(GetSize(groups));
+			for (int g = 0; g < GetSize(groups); g++)
+				group.run([&, g]() { check_group(g); });
+			group.wait();
+
+			int num_failed = 0, num_timeout = 0;
+			log("\nResults for %d asserts:\n", GetSize(asserts));
+			for (int g = 0; g < GetSize(groups); g++)
+				for (int i = 0; i < GetSize(groups[g]); i++) {
+					int result = results[g][i];
+					if (result > 0)
+						log("  [group %d] %s: FAIL in step %d\n", g+1, log_id(groups[g][i]), result), num_failed++;
+					else if (result < 0)
+						log("  [group %d] %s: TIMEOUT\n", g+1, log_id(groups[g][i])), num_timeout++;
+					else
+						log("  [group %d] %s: PASS for %d steps\n", g+1, log_id(groups[g][i]), num_steps);
+				}
+
+			if (num_failed > 0) {
+				log("\nSAT proof finished - %d of %d asserts failed: FAIL!\n", num_failed, GetSize(asserts));
+				print_proof_failed();
+				if (verify) {
+					log("\n");
+					log_error("Called with -verify and proof did fail!\n");
+				}
+			} else if (num_timeout > 0) {
+				goto timeout;
+			} else {
+				log("\nSAT proof finished - all asserts hold: SUCCESS!\n");
+				print_qed();
+				if (falsify) {
+					log("\n");
+					log_error("Called with -falsify and proof did succeed!\n");
+				}
+			}
+		}
+		else if (pdr)
+		{
+			SatHelper pdrhelper(design, module, false);
+			auto configure = [&](SatHelper &helper) {
+				helper.sets = sets;
+				helper.set_assumes = set_assumes;
+				helper.prove = prove;
+				helper.prove_asserts = prove_asserts;
+				helper.shows = shows;
+				helper.timeout = timeout;
+				helper.sets_init = sets_init;
+				helper.set_init_zero = set_init_zero;
+				helper.satgen.ignore_div_by_zero = ignore_div_by_zero;
+				helper.ignore_unknown_cells = ignore_unknown_cells;
+			};
+			configure(pdrhelper);
+
+			int result;
+			try {
+				SatPdr engine(pdrhelper);
+				result = engine.run(maxsteps);
+			} catch (SatPdr::Timeout&) {
+				goto timeout;
+			}
+
+			if (result > 0)
+			{
+				log("\nSAT PDR proof finished - counterexample with %d time steps found: FAIL!\n", result);
+
+				// the counterexample is reproduced by unrolling, for the model output
+				SatHelper cexhelper(design, module, false);
+				configure(cexhelper);
+				cexhelper.timeout = 0;
+				for (int timestep = 1; timestep <= result; timestep++)
+					cexhelper.setup(timestep, timestep == 1);
+				int property = cexhelper.setup_proof(result);
+				cexhelper.generate_model();
+				if (!cexhelper.solve(cexhelper.ez->NOT(property)))
+					log_error("Failed to reproduce the counterexample found by PDR.\n");
+
+				print_proof_failed();
+				cexhelper.print_model();
+				if(!vcd_file_name.empty())
+					cexhelper.dump_model_to_vcd(vcd_file_name);
+				if(!json_file_name.empty())
+					cexhelper.dump_model_to_json(json_file_name);
+			}
+			else if (result < 0)
+			{
+				log("\nReached maximum number of frames -> proof failed.\n");
+				print_proof_failed();
+			}
+			else
+			{
+				log("\nInductive invariant found: SUCCESS!\n");
+				print_qed();
+				if (falsify) {
+					log("\n");
+					log_error("Called with -falsify and proof did succeed!\n");
+				}
+			}
+
+			if (result != 0 && verify) {
+				log("\n");
+				log_error("Called with -verify and proof did fail!\n");
+			}
+		}
+		else if (tempinduct)
 		{
 			if (loopcount > 0 || max_undef)
 				log_cmd_error("The options -max, -all, and -max_undef are not supported for temporal induction proofs!\n");
@@ -1431,28 +2460,192 @@ struct SatPass : public Pass {
 				inductstep.ez->assume(inductstep.ez->NOT(inductstep.ez->expression(ezSAT::OpOr, undef_state)));
 			}
 
-			for (int inductlen = 1; inductlen <= maxsteps || maxsteps == 0; inductlen++)
+			// returns true if a model for the base case has been found
+			auto solve_basecase = [&](int inductlen) -> bool
 			{
-				log("\n** Trying induction with length %d **\n", inductlen);
+				basecase.setup(seq_len + inductlen, seq_len + inductlen == 1);
+				int property = basecase.setup_proof(seq_len + inductlen);
+				basecase.generate_model();
 
-				// phase 1: proving base case
+				if (inductlen > 1)
+					basecase.force_unique_state(seq_len + 1, seq_len + inductlen);
 
-				if (!tempinduct_inductonly)
+				if (tempinduct_skip < inductlen)
 				{
-					basecase.setup(seq_len + inductlen, seq_len + inductlen == 1);
-					int property = basecase.setup_proof(seq_len + inductlen);
-					basecase.generate_model();
+					log("\n[base case %d] Solving problem with %d variables and %d clauses..\n",
+							inductlen, basecase.ez->numCnfVariables(), basecase.ez->numCnfClauses());
+					log_flush();
 
-					if (inductlen > 1)
-						basecase.force_unique_state(seq_len + 1, seq_len + inductlen);
+					if (basecase.solve(basecase.ez->NOT(property)))
+						return true;
 
-					if (tempinduct_skip < inductlen)
-					{
-						log("\n[base case %d] Solving problem with %d variables and %d clauses..\n",
-								inductlen, basecase.ez->numCnfVariables(), basecase.ez->numCnfClauses());
-						log_flush();
+					if (basecase.gotTimeout)
+						return false;
+
+					log("Base case for induction length %d proven.\n", inductlen);
+				}
+				else
+				{
+					log("\n[base case %d] Skipping prove for this step (-tempinduct-skip %d).",
+							inductlen, tempinduct_skip);
+					log("\n[base case %d] Problem size so far: %d variables and %d clauses.\n",
+							inductlen, basecase.ez->numCnfVariables(), basecase.ez->numCnfClauses());
+				}
+				basecase.ez->assume(property);
+				return false;
+			};
+
+			// returns true if the induction step has been proven
+			auto solve_inductstep = [&](int inductlen) -> bool
+			{
+				inductstep.setup(inductlen + 1);
+				int property = inductstep.setup_proof(inductlen + 1);
+				inductstep.generate_model();
+
+				if (inductlen > 1)
+					inductstep.force_unique_state(1, inductlen + 1);
+
+				if (inductlen <= tempinduct_skip || inductlen <= initsteps || inductlen % stepsize != 0)
+				{
+					if (inductlen < tempinduct_skip)
+						log("\n[induction step %d] Skipping prove for this step (-tempinduct-skip %d).",
+								inductlen, tempinduct_skip);
+					if (inductlen < initsteps)
+						log("\n[induction step %d] Skipping prove for this step (-initsteps %d).",
+								inductlen, tempinduct_skip);
+					if (inductlen % stepsize != 0)
+						log("\n[induction step %d] Skipping prove for this step (-stepsize %d).",
+								inductlen, stepsize);
+					log("\n[induction step %d] Problem size so far: %d variables and %d clauses.\n",
+							inductlen, inductstep.ez->numCnfVariables(), inductstep.ez->numCnfClauses());
+					inductstep.ez->assume(property);
+					return false;
+				}
 
-						if (basecase.solve(basecase.ez->NOT(property))) {
+				if (!cnf_file_name.empty())
+				{
+					rewrite_filename(cnf_file_name);
+					FILE *f = fopen(cnf_file_name.c_str(), "w");
+					if (!f)
+						log_cmd_error("Can't open output file `%s' for writing: %s\n", cnf_file_name.c_str(), strerror(errno));
+
+					log("Dumping CNF to file `%s'.\n", cnf_file_name.c_str());
+					cnf_file_name.clear();
+
+					inductstep.ez->printDIMACS(f, false);
+					fclose(f);
+				}
+
+				log("\n[induction step %d] Solving problem with %d variables and %d clauses..\n",
+						inductlen, inductstep.ez->numCnfVariables(), inductstep.ez->numCnfClauses());
+				log_flush();
+
+				if (!inductstep.solve(inductstep.ez->NOT(property)))
+					return !inductstep.gotTimeout;
+
+				log("Induction step failed. Incrementing induction length.\n");
+				inductstep.ez->assume(property);
+				inductstep.print_model();
+				return false;
+			};
+
+			if (tempinduct_parallel)
+			{
+#ifdef YOSYS_ENABLE_THREADS
+				// The base case and the induction step are unrolled on their own
+				// threads. The sequential loop below would report the first length
+				// at which either the base case fails or the induction step is
+				// proven, with the base case checked first, so each thread stops
+				// once it is past the shortest conclusion of the other.
+				std::atomic<int> basecase_failed(0), inductstep_proven(0);
+				LogCapture basecase_log, inductstep_log;
+				std::exception_ptr basecase_error, inductstep_error;
+
+				auto basecase_worker = [&]() {
+					log_capture_begin(&basecase_log);
+					try {
+						for (int inductlen = 1; inductlen <= maxsteps || maxsteps == 0; inductlen++) {
+							if (inductstep_proven && inductlen > inductstep_proven)
+								break;
+							log("\n** Trying base case with length %d **\n", inductlen);
+							if (solve_basecase(inductlen)) {
+								basecase_failed = inductlen;
+								break;
+							}
+						}
+					} catch (...) {
+						basecase_error = std::current_exception();
+						basecase_failed = -1;
+					}
+					log_capture_end();
+				};
+
+				auto inductstep_worker = [&]() {
+					log_capture_begin(&inductstep_log);
+					try {
+						for (int inductlen = 1; inductlen <= maxsteps || maxsteps == 0; inductlen++) {
+							if (basecase_failed && inductlen >= basecase_failed)
+								break;
+							log("\n** Trying induction step with length %d **\n", inductlen);
+							if (solve_inductstep(inductlen)) {
+								inductstep_proven = inductlen;
+								break;
+							}
+						}
+					} catch (...) {
+						inductstep_error = std::current_exception();
+						inductstep_proven = -1;
+					}
+					log_capture_end();
+				};
+
+				IdString::set_concurrent(true);
+				std::thread basecase_thread(basecase_worker);
+				inductstep_worker();
+				basecase_thread.join();
+				IdString::set_concurrent(false);
+
+				basecase_log.replay();
+				inductstep_log.replay();
+
+				for (auto &error : {basecase_error, inductstep_error})
+					if (error) {
+						try {
+							std::rethrow_exception(error);
+						} catch (log_capture_error_exception&) {
+							log_abort();
+						}
+					}
+
+				if (basecase_failed > 0 && (inductstep_proven == 0 || basecase_failed <= inductstep_proven)) {
+					log("\nSAT temporal induction proof finished - model found for base case %d: FAIL!\n", int(basecase_failed));
+					print_proof_failed();
+					basecase.print_model();
+					if(!vcd_file_name.empty())
+						basecase.dump_model_to_vcd(vcd_file_name);
+					if(!json_file_name.empty())
+						basecase.dump_model_to_json(json_file_name);
+					goto tip_failed;
+				}
+
+				if (inductstep_proven > 0) {
+					log("\nInduction step proven for length %d, base case proven up to that length: SUCCESS!\n", int(inductstep_proven));
+					print_qed();
+					goto tip_success;
+				}
+#endif
+			}
+			else
+			{
+				for (int inductlen = 1; inductlen <= maxsteps || maxsteps == 0; inductlen++)
+				{
+					log("\n** Trying induction with length %d **\n", inductlen);
+
+					// phase 1: proving base case
+
+					if (!tempinduct_inductonly)
+					{
+						if (solve_basecase(inductlen)) {
 							log("SAT temporal induction proof finished - model found for base case: FAIL!\n");
 							print_proof_failed();
 							basecase.print_model();
@@ -1465,76 +2658,20 @@ struct SatPass : public Pass {
 
 						if (basecase.gotTimeout)
 							goto timeout;
-
-						log("Base case for induction length %d proven.\n", inductlen);
-					}
-					else
-					{
-						log("\n[base case %d] Skipping prove for this step (-tempinduct-skip %d).",
-								inductlen, tempinduct_skip);
-						log("\n[base case %d] Problem size so far: %d variables and %d clauses.\n",
-								inductlen, basecase.ez->numCnfVariables(), basecase.ez->numCnfClauses());
 					}
-					basecase.ez->assume(property);
-				}
 
-				// phase 2: proving induction step
+					// phase 2: proving induction step
 
-				if (!tempinduct_baseonly)
-				{
-					inductstep.setup(inductlen + 1);
-					int property = inductstep.setup_proof(inductlen + 1);
-					inductstep.generate_model();
-
-					if (inductlen > 1)
-						inductstep.force_unique_state(1, inductlen + 1);
-
-					if (inductlen <= tempinduct_skip || inductlen <= initsteps || inductlen % stepsize != 0)
-					{
-						if (inductlen < tempinduct_skip)
-							log("\n[induction step %d] Skipping prove for this step (-tempinduct-skip %d).",
-									inductlen, tempinduct_skip);
-						if (inductlen < initsteps)
-							log("\n[induction step %d] Skipping prove for this step (-initsteps %d).",
-									inductlen, tempinduct_skip);
-						if (inductlen % stepsize != 0)
-							log("\n[induction step %d] Skipping prove for this step (-stepsize %d).",
-									inductlen, stepsize);
-						log("\n[induction step %d] Problem size so far: %d variables and %d clauses.\n",
-								inductlen, inductstep.ez->numCnfVariables(), inductstep.ez->numCnfClauses());
-						inductstep.ez->assume(property);
-					}
-					else
+					if (!tempinduct_baseonly)
 					{
-						if (!cnf_file_name.empty())
-						{
-							rewrite_filename(cnf_file_name);
-							FILE *f = fopen(cnf_file_name.c_str(), "w");
-							if (!f)
-								log_cmd_error("Can't open output file `%s' for writing: %s\n", cnf_file_name.c_str(), strerror(errno));
-
-							log("Dumping CNF to file `%s'.\n", cnf_file_name.c_str());
-							cnf_file_name.clear();
-
-							inductstep.ez->printDIMACS(f, false);
-							fclose(f);
-						}
-
-						log("\n[induction step %d] Solving problem with %d variables and %d clauses..\n",
-								inductlen, inductstep.ez->numCnfVariables(), inductstep.ez->numCnfClauses());
-						log_flush();
-
-						if (!inductstep.solve(inductstep.ez->NOT(property))) {
-							if (inductstep.gotTimeout)
-								goto timeout;
+						if (solve_inductstep(inductlen)) {
 							log("Induction step proven: SUCCESS!\n");
 							print_qed();
 							goto tip_success;
 						}
 
-						log("Induction step failed. Incrementing induction length.\n");
-						inductstep.ez->assume(property);
-						inductstep.print_model();
+						if (inductstep.gotTimeout)
+							goto timeout;
 					}
 				}
 			}
@@ -1712,6 +2849,18 @@ struct SatPass : public Pass {
 			if (fail_on_timeout)
 				log_error("Called with -verify and proof did time out!\n");
 		}
+
+		if (show_stats) {
+			ezSAT::SolverStats stats = get_sat_stats();
+			stats -= stats_before;
+			log("\n");
+			log_sat_stats(stats);
+#if !defined(_WIN32) && defined(YOSYS_ENABLE_THREADS)
+			if (external_solver != nullptr && GetSize(solver_cmds) > 1)
+				for (int i = 0; i < GetSize(solver_cmds); i++)
+					log("SAT calls answered by `%s': %d\n", solver_cmds[i].c_str(), external_solver->wins[i]);
+#endif
+		}
 	}
 } SatPass;
 
@@ -20,6 +20,17 @@
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
 #include "kernel/celltypes.h"
+#include "kernel/utils.h"
+#include "libs/sha1/sha1.h"
+
+#ifdef YOSYS_ENABLE_PLUGINS
+#  include <dlfcn.h>
+#endif
+
+#ifdef YOSYS_ENABLE_THREADS
+#  include <atomic>
+#  include <thread>
+#endif
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -33,6 +44,261 @@ struct SimShared
 	int rstlen = 1;
 };
 
+// Buffered VCD output. Value changes are collected in a string and handed to
+// the output stream in large blocks. Compressed output (file names ending in
+// ".gz" or ".zst", see open_output_file()) is compressed while it is written,
+// so the uncompressed trace is never held in memory as a whole.
+struct VcdWriter
+{
+	std::ostream *f = nullptr;
+	std::string buffer;
+
+	~VcdWriter()
+	{
+		close();
+	}
+
+	bool is_open() const
+	{
+		return f != nullptr;
+	}
+
+	void open(const std::string &filename)
+	{
+		close();
+		f = open_output_file(filename);
+	}
+
+	void flush()
+	{
+		if (f != nullptr) {
+			f->write(buffer.data(), buffer.size());
+			f->flush();
+		}
+		buffer.clear();
+	}
+
+	void close()
+	{
+		if (f != nullptr) {
+			flush();
+			delete f;
+			f = nullptr;
+		}
+	}
+
+	VcdWriter &operator<<(const std::string &str)
+	{
+		buffer += str;
+		if (GetSize(buffer) >= (1 << 20))
+			flush();
+		return *this;
+	}
+};
+
+// Streaming VCD input for "sim -r". The header is read once, after that the
+// value changes are read one time step at a time, so the trace never has to
+// fit in memory.
+struct VcdReader
+{
+	struct var_t
+	{
+		std::string scope, name, id;
+		int width, msb, lsb;
+	};
+
+	std::string filename;
+	std::ifstream f;
+	vector<var_t> vars;
+	dict<std::string, int> id_widths;
+	int64_t time = 0, next_time = 0;
+
+	void open(const std::string &filename)
+	{
+		this->filename = filename;
+		f.open(filename);
+		if (f.fail())
+			log_cmd_error("Can't open VCD file `%s' for reading: %s\n", filename.c_str(), strerror(errno));
+	}
+
+	bool next_token(std::string &tok)
+	{
+		return bool(f >> tok);
+	}
+
+	std::string expect_token()
+	{
+		std::string tok;
+		if (!next_token(tok))
+			log_error("Unexpected end of VCD file `%s'.\n", filename.c_str());
+		return tok;
+	}
+
+	void skip_to_end()
+	{
+		while (expect_token() != "$end") { }
+	}
+
+	// "[7:0]" or "[3]", msb and lsb stay -1 if the token is not a range
+	static void parse_range(const std::string &tok, int &msb, int &lsb)
+	{
+		if (tok.size() < 3 || tok.front() != '[' || tok.back() != ']')
+			return;
+		char *p;
+		msb = lsb = strtol(tok.c_str() + 1, &p, 10);
+		if (*p == ':')
+			lsb = strtol(p + 1, &p, 10);
+	}
+
+	void read_header()
+	{
+		vector<std::string> scopes;
+		while (1)
+		{
+			std::string tok = expect_token();
+
+			if (tok == "$enddefinitions") {
+				skip_to_end();
+				break;
+			}
+
+			if (tok == "$scope") {
+				expect_token();
+				scopes.push_back(expect_token());
+				skip_to_end();
+				continue;
+			}
+
+			if (tok == "$upscope") {
+				if (!scopes.empty())
+					scopes.pop_back();
+				skip_to_end();
+				continue;
+			}
+
+			if (tok == "$var") {
+				var_t var;
+				expect_token();
+				var.width = atoi(expect_token().c_str());
+				var.id = expect_token();
+				var.name = expect_token();
+				var.msb = var.lsb = -1;
+				for (tok = expect_token(); tok != "$end"; tok = expect_token())
+					parse_range(tok, var.msb, var.lsb);
+				// a range can also be part of the name
+				size_t pos = var.name.find('[');
+				if (var.msb < 0 && pos != std::string::npos && pos > 0 && var.name.back() == ']') {
+					parse_range(var.name.substr(pos), var.msb, var.lsb);
+					var.name = var.name.substr(0, pos);
+				}
+				for (int i = 0; i < GetSize(scopes); i++)
+					var.scope += (i ? "." : "") + scopes[i];
+				id_widths[var.id] = var.width;
+				vars.push_back(var);
+				continue;
+			}
+
+			if (tok[0] == '$') {
+				skip_to_end();
+				continue;
+			}
+
+			log_error("Unexpected token `%s' in header of VCD file `%s'.\n", tok.c_str(), filename.c_str());
+		}
+	}
+
+	// the value of a vector change, extended to the width of the variable
+	Const parse_vector(const std::string &bits, int width)
+	{
+		Const value(State::Sx, width);
+		int len = GetSize(bits) - 1;
+		for (int i = 0; i < width; i++) {
+			char c = i < len ? bits[len - i] : (bits[1] == 'x' || bits[1] == 'z' || bits[1] == 'X' || bits[1] == 'Z' ? bits[1] : '0');
+			switch (c) {
+				case '0': value.set(i, State::S0); break;
+				case '1': value.set(i, State::S1); break;
+				case 'z': case 'Z': value.set(i, State::Sz); break;
+			}
+		}
+		return value;
+	}
+
+	// Reads the value changes of the next time step, calls the function for
+	// each change of a variable and sets "time". Steps without changes are
+	// skipped. Returns false at the end of the file.
+	bool read_step(const std::function<void(const std::string&, const Const&)> &apply)
+	{
+		bool changed = false;
+		std::string tok;
+		time = next_time;
+
+		while (next_token(tok))
+		{
+			char c = tok[0];
+
+			if (c == '#') {
+				int64_t t = strtoll(tok.c_str() + 1, nullptr, 10);
+				if (t < time)
+					log_error("Time going backwards (#%lld after #%lld) in VCD file `%s'.\n",
+							(long long)t, (long long)time, filename.c_str());
+				next_time = t;
+				if (changed)
+					return true;
+				time = t;
+				continue;
+			}
+
+			if (c == '$') {
+				if (tok == "$comment")
+					skip_to_end();
+				continue;
+			}
+
+			if (c == 'b' || c == 'B') {
+				std::string id = expect_token();
+				auto it = id_widths.find(id);
+				if (it != id_widths.end())
+					apply(id, parse_vector(tok, it->second));
+				changed = true;
+				continue;
+			}
+
+			if (c == 'r' || c == 'R') {
+				expect_token();
+				continue;
+			}
+
+			if (GetSize(tok) >= 2 && strchr("01xXzZ", c)) {
+				std::string id = tok.substr(1);
+				auto it = id_widths.find(id);
+				if (it != id_widths.end())
+					apply(id, parse_vector("b" + tok.substr(0, 1), it->second));
+				changed = true;
+				continue;
+			}
+
+			log_error("Unexpected token `%s' in VCD file `%s'.\n", tok.c_str(), filename.c_str());
+		}
+
+		return changed;
+	}
+};
+
+void write_vcd_value(VcdWriter &f, int id, const Const &value)
+{
+	std::string line = "b";
+	for (int i = GetSize(value)-1; i >= 0; i--) {
+		switch (value[i]) {
+			case State::S0: line += '0'; break;
+			case State::S1: line += '1'; break;
+			case State::Sx: line += 'x'; break;
+			default: line += 'z';
+		}
+	}
+	line += " n" + std::to_string(id) + "\n";
+	f << line;
+}
+
 void zinit(State &v)
 {
 	if (v != State::S1)
@@ -41,7 +307,7 @@ void zinit(State &v)
 
 void zinit(Const &v)
 {
-	for (auto &bit : v.bits)
+	for (auto &bit : v.bits())
 		zinit(bit);
 }
 
@@ -64,6 +330,12 @@ struct SimInstance
 	pool<Cell*> dirty_cells;
 	pool<SimInstance*, hash_ptr_ops> dirty_children;
 
+	// topological level of each cell, used to evaluate every combinational
+	// cell at most once per delta cycle (only if the module has no loops)
+	bool levelized = false;
+	dict<Cell*, int> cell_level;
+	int max_level = 0;
+
 	struct ff_state_t
 	{
 		State past_clock;
@@ -84,6 +356,8 @@ struct SimInstance
 	pool<Cell*> formal_database;
 
 	dict<Wire*, pair<int, Const>> vcd_database;
+	dict<SigBit, vector<Wire*>> vcd_bitmap;
+	pool<Wire*> vcd_dirty;
 
 	SimInstance(SimShared *shared, Module *module, Cell *instance = nullptr, SimInstance *parent = nullptr) :
 			shared(shared), module(module), instance(instance), parent(parent), sigmap(module)
@@ -151,11 +425,8 @@ struct SimInstance
 				mem.data = cell->getParam("\\INIT");
 				int sz = cell->getParam("\\SIZE").as_int() * cell->getParam("\\WIDTH").as_int();
 
-				if (GetSize(mem.data) > sz)
-					mem.data.bits.resize(sz);
-
-				while (GetSize(mem.data) < sz)
-					mem.data.bits.push_back(State::Sx);
+				if (GetSize(mem.data) != sz)
+					mem.data = mem.data.extract(0, sz, State::Sx);
 
 				mem_database[cell] = mem;
 			}
@@ -165,6 +436,8 @@ struct SimInstance
 			}
 		}
 
+		levelize();
+
 		if (shared->zinit)
 		{
 			for (auto &it : ff_database)
@@ -187,6 +460,52 @@ struct SimInstance
 		}
 	}
 
+	void levelize()
+	{
+		dict<SigBit, Cell*> bit_drivers;
+		TopoSort<Cell*, RTLIL::sort_by_name_id<RTLIL::Cell>> toposort;
+
+		for (auto cell : module->cells())
+		{
+			toposort.node(cell);
+
+			if (ff_database.count(cell) || formal_database.count(cell) || children.count(cell))
+				continue;
+
+			for (auto &port : cell->connections())
+				if (cell->output(port.first))
+					for (auto bit : sigmap(port.second))
+						if (bit.wire != nullptr)
+							bit_drivers[bit] = cell;
+		}
+
+		for (auto cell : module->cells())
+			for (auto &port : cell->connections())
+				if (cell->input(port.first))
+					for (auto bit : sigmap(port.second)) {
+						auto it = bit_drivers.find(bit);
+						if (it != bit_drivers.end())
+							toposort.edge(it->second, cell);
+					}
+
+		toposort.analyze_loops = false;
+		if (!toposort.sort()) {
+			if (shared->debug)
+				log("[%s] combinational loop found, not using a levelized schedule\n", hiername().c_str());
+			return;
+		}
+
+		for (auto cell : toposort.sorted) {
+			int level = 0;
+			for (auto pred : toposort.get_predecessors(cell))
+				level = std::max(level, cell_level.at(pred) + 1);
+			cell_level[cell] = level;
+			max_level = std::max(max_level, level);
+		}
+
+		levelized = true;
+	}
+
 	~SimInstance()
 	{
 		for (auto child : children)
@@ -214,11 +533,11 @@ struct SimInstance
 
 		for (auto bit : sigmap(sig))
 			if (bit.wire == nullptr)
-				value.bits.push_back(bit.data);
+				value.bits().push_back(bit.data);
 			else if (state_nets.count(bit))
-				value.bits.push_back(state_nets.at(bit));
+				value.bits().push_back(state_nets.at(bit));
 			else
-				value.bits.push_back(State::Sz);
+				value.bits().push_back(State::Sz);
 
 		if (shared->debug)
 			log("[%s] get %s: %s\n", hiername().c_str(), log_signal(sig), log_signal(value));
@@ -237,6 +556,10 @@ struct SimInstance
 				state_nets.at(sig[i]) = value[i];
 				dirty_bits.insert(sig[i]);
 				did_something = true;
+				auto it = vcd_bitmap.find(sig[i]);
+				if (it != vcd_bitmap.end())
+					for (auto wire : it->second)
+						vcd_dirty.insert(wire);
 			}
 
 		if (shared->debug)
@@ -367,6 +690,46 @@ struct SimInstance
 
 			dirty_bits.clear();
 
+			if (!queue_cells.empty() && levelized)
+			{
+				vector<vector<Cell*>> level_queue(max_level+1);
+				pool<Cell*> next_queue_cells;
+
+				for (auto cell : queue_cells)
+					level_queue[cell_level.at(cell)].push_back(cell);
+				queue_cells.clear();
+
+				for (int level = 0; level <= max_level; level++)
+					for (int i = 0; i < GetSize(level_queue[level]); i++)
+					{
+						update_cell(level_queue[level][i]);
+
+						for (auto bit : dirty_bits)
+						{
+							if (upd_cells.count(bit))
+								for (auto cell : upd_cells.at(bit)) {
+									int l = cell_level.at(cell);
+									if (l <= level)
+										next_queue_cells.insert(cell);
+									else if (queue_cells.insert(cell).second)
+										level_queue[l].push_back(cell);
+								}
+
+							if (upd_outports.count(bit) && parent != nullptr)
+								for (auto wire : upd_outports.at(bit))
+									queue_outports.insert(wire);
+						}
+
+						dirty_bits.clear();
+					}
+
+				// only cells that are not part of the combinational logic
+				// (e.g. flip-flops) are left for another delta cycle
+				queue_cells.swap(next_queue_cells);
+				if (!queue_cells.empty())
+					continue;
+			}
+
 			if (!queue_cells.empty())
 			{
 				for (auto cell : queue_cells)
@@ -460,8 +823,8 @@ struct SimInstance
 					int index = addr.as_int() - offset;
 					if (index >= 0 && index < size)
 						for (int i = 0; i < width; i++)
-							if (enable[i] == State::S1 && mem.data.bits.at(index*width+i) != data[i]) {
-								mem.data.bits.at(index*width+i) = data[i];
+							if (enable[i] == State::S1 && mem.data[index*width+i] != data[i]) {
+								mem.data.set(index*width+i, data[i]);
 								dirty_cells.insert(cell);
 								did_something = true;
 							}
@@ -548,7 +911,7 @@ struct SimInstance
 				if (w->attributes.count("\\init") == 0)
 					w->attributes["\\init"] = Const(State::Sx, GetSize(w));
 
-				w->attributes["\\init"][sig_q[i].offset] = initval[i];
+				w->attributes["\\init"].bits()[sig_q[i].offset] = initval[i];
 			}
 		}
 
@@ -561,7 +924,7 @@ struct SimInstance
 			while (GetSize(initval) >= 2) {
 				if (initval[GetSize(initval)-1] != State::Sx) break;
 				if (initval[GetSize(initval)-2] != State::Sx) break;
-				initval.bits.pop_back();
+				initval.bits().pop_back();
 			}
 
 			cell->setParam("\\INIT", initval);
@@ -571,7 +934,7 @@ struct SimInstance
 			it.second->writeback(wbmods);
 	}
 
-	void write_vcd_header(std::ofstream &f, int &id)
+	void write_vcd_header(VcdWriter &f, int &id)
 	{
 		f << stringf("$scope module %s $end\n", log_id(name()));
 
@@ -582,6 +945,13 @@ struct SimInstance
 
 			f << stringf("$var wire %d n%d %s%s $end\n", GetSize(wire), id, wire->name[0] == '$' ? "\\" : "", log_id(wire));
 			vcd_database[wire] = make_pair(id++, Const());
+			vcd_dirty.insert(wire);
+
+			for (auto bit : sigmap(wire)) {
+				vector<Wire*> &wires = vcd_bitmap[bit];
+				if (wires.empty() || wires.back() != wire)
+					wires.push_back(wire);
+			}
 		}
 
 		for (auto child : children)
@@ -590,30 +960,25 @@ struct SimInstance
 		f << stringf("$upscope $end\n");
 	}
 
-	void write_vcd_step(std::ofstream &f)
+	void write_vcd_step(VcdWriter &f)
 	{
-		for (auto &it : vcd_database)
+		// only wires with bits that changed since the last step are visited
+		vector<pair<int, Wire*>> changed;
+		for (auto wire : vcd_dirty)
+			changed.push_back(make_pair(vcd_database.at(wire).first, wire));
+		std::sort(changed.begin(), changed.end());
+		vcd_dirty.clear();
+
+		for (auto &it : changed)
 		{
-			Wire *wire = it.first;
-			Const value = get_state(wire);
-			int id = it.second.first;
+			Const value = get_state(it.second);
+			Const &last_value = vcd_database.at(it.second).second;
 
-			if (it.second.second == value)
+			if (last_value == value)
 				continue;
 
-			it.second.second = value;
-
-			f << "b";
-			for (int i = GetSize(value)-1; i >= 0; i--) {
-				switch (value[i]) {
-					case State::S0: f << "0"; break;
-					case State::S1: f << "1"; break;
-					case State::Sx: f << "x"; break;
-					default: f << "z";
-				}
-			}
-
-			f << stringf(" n%d\n", id);
+			last_value = value;
+			write_vcd_value(f, it.first, value);
 		}
 
 		for (auto child : children)
@@ -621,110 +986,875 @@ struct SimInstance
 	}
 };
 
-struct SimWorker : SimShared
+// Bit-parallel simulation engine for "sim -parallel". Every net of the (flat,
+// fine-grained) top module is stored as a 64 bit word that holds its value in
+// 64 independent simulation runs ("lanes"). The combinational cells are
+// levelized once, so that each settle step is a single pass over an array of
+// gates that are evaluated with plain bitwise operations.
+
+struct BitSimInstance
 {
-	SimInstance *top = nullptr;
-	std::ofstream vcdfile;
-	pool<IdString> clock, clockn, reset, resetn;
+	typedef uint64_t word_t;
+	static const int num_lanes = 64;
 
-	~SimWorker()
+	enum gate_type_t {
+		G_BUF, G_NOT, G_AND, G_NAND, G_OR, G_NOR, G_XOR, G_XNOR, G_ANDNOT, G_ORNOT,
+		G_MUX, G_NMUX, G_AOI3, G_OAI3, G_AOI4, G_OAI4
+	};
+
+	struct gate_t
 	{
-		delete top;
-	}
+		gate_type_t type;
+		int y, a, b, c, d;
+	};
 
-	void write_vcd_header()
+	struct ff_t
 	{
-		if (!vcdfile.is_open())
-			return;
+		Cell *cell;
+		SigBit sig_q;
+		int q, d, clk, en;
+		bool clkpol, enpol;
+		word_t past_clock, past_d, past_en;
+	};
 
-		int id = 1;
-		top->write_vcd_header(vcdfile, id);
+	struct formal_t
+	{
+		Cell *cell;
+		int a, en;
+		string label;
+	};
 
-		vcdfile << stringf("$enddefinitions $end\n");
-	}
+	SimShared *shared;
+	Module *module;
+	SigMap sigmap;
 
-	void write_vcd_step(int t)
+	// nets 0 and 1 are the constants 0 and 1 (undefined bits are simulated as 0)
+	idict<SigBit, 2> net_index;
+	vector<word_t> nets;
+
+	vector<gate_t> gates;
+	vector<ff_t> ffs;
+	vector<formal_t> formals;
+	vector<int> random_inputs;
+	uint64_t rng_state;
+
+	// the gates are sorted by level, level_start[i] is the first gate of
+	// level i (the last entry is the number of gates)
+	vector<int> level_start;
+
+#ifdef YOSYS_ENABLE_THREADS
+	// Multi-threaded evaluation (see start_threads()): the levels with many
+	// gates are split in one slab per thread, runs of small levels are
+	// evaluated by the first thread alone. The threads wait for each other
+	// after each segment of the schedule.
+	struct segment_t
 	{
-		if (!vcdfile.is_open())
-			return;
+		int begin, end;
+		bool split;
+	};
 
-		vcdfile << stringf("#%d\n", t);
-		top->write_vcd_step(vcdfile);
+	vector<segment_t> schedule;
+	vector<std::thread> threads;
+	std::atomic<int> barrier_count, barrier_gen, start_gen;
+	std::atomic<bool> stop_threads;
+#endif
+
+	dict<Wire*, pair<int, Const>> vcd_database;
+	dict<int, vector<Wire*>> vcd_netmap;
+	dict<int, bool> vcd_netvals;
+
+	int net(SigBit bit)
+	{
+		bit = sigmap(bit);
+		if (bit.wire == nullptr)
+			return bit == State::S1 ? 1 : 0;
+		return net_index(bit);
 	}
 
-	void update()
+	int port_net(Cell *cell, IdString port)
 	{
-		while (1)
-		{
-			if (debug)
-				log("\n-- ph1 --\n");
+		SigSpec sig = cell->getPort(port);
+		if (GetSize(sig) != 1)
+			log_error("Port %s of cell %s (%s) in module %s is not 1 bit wide.\n", log_id(port), log_id(cell), log_id(cell->type), log_id(module));
+		return net(sig);
+	}
 
-			top->update_ph1();
+	BitSimInstance(SimShared *shared, Module *module, uint64_t seed, bool verbose = true) :
+			shared(shared), module(module), sigmap(module), rng_state(seed ? seed : 1)
+	{
+		static const dict<IdString, gate_type_t> gate_types = {
+			{ID($_BUF_), G_BUF}, {ID($_NOT_), G_NOT}, {ID($_AND_), G_AND}, {ID($_NAND_), G_NAND},
+			{ID($_OR_), G_OR}, {ID($_NOR_), G_NOR}, {ID($_XOR_), G_XOR}, {ID($_XNOR_), G_XNOR},
+			{ID($_ANDNOT_), G_ANDNOT}, {ID($_ORNOT_), G_ORNOT}, {ID($_MUX_), G_MUX}, {ID($_NMUX_), G_NMUX},
+			{ID($_AOI3_), G_AOI3}, {ID($_OAI3_), G_OAI3}, {ID($_AOI4_), G_AOI4}, {ID($_OAI4_), G_OAI4}
+		};
 
-			if (debug)
-				log("\n-- ph2 --\n");
+		vector<gate_t> unsorted_gates;
+		dict<int, Cell*> drivers;
 
-			if (!top->update_ph2())
-				break;
-		}
+		for (auto cell : module->cells())
+		{
+			if (module->design->module(cell->type) != nullptr)
+				log_error("Module %s contains an instance of module %s, the parallel engine needs a flat design (run 'flatten').\n",
+						log_id(module), log_id(cell->type));
 
-		if (debug)
-			log("\n-- ph3 --\n");
+			auto it = gate_types.find(cell->type);
+			if (it != gate_types.end())
+			{
+				gate_t gate;
+				gate.type = it->second;
+				gate.y = port_net(cell, ID::Y);
+				gate.a = port_net(cell, ID::A);
+				gate.b = cell->hasPort(ID::B) ? port_net(cell, ID::B) : 0;
+				gate.c = cell->hasPort(ID(C)) ? port_net(cell, ID(C)) : 0;
+				gate.d = cell->hasPort(ID(D)) ? port_net(cell, ID(D)) : 0;
+				if (gate.type == G_MUX || gate.type == G_NMUX)
+					gate.c = port_net(cell, ID(S));
+
+				if (gate.y < 2 || drivers.count(gate.y))
+					log_error("Output of cell %s (%s) in module %s is a constant or has multiple drivers.\n",
+							log_id(cell), log_id(cell->type), log_id(module));
+				drivers[gate.y] = cell;
+				unsorted_gates.push_back(gate);
+				continue;
+			}
 
-		top->update_ph3();
-	}
+			if (cell->type.in(ID($_DFF_P_), ID($_DFF_N_), ID($_DFFE_PP_), ID($_DFFE_PN_), ID($_DFFE_NP_), ID($_DFFE_NN_), ID($dff)))
+			{
+				bool coarse = cell->type == ID($dff);
+				SigSpec sig_q = cell->getPort(ID(Q)), sig_d = cell->getPort(ID(D));
+				SigSpec sig_clk = cell->getPort(coarse ? ID(CLK) : ID(C));
 
-	void set_inports(pool<IdString> ports, State value)
-	{
-		for (auto portname : ports)
-		{
-			Wire *w = top->module->wire(portname);
+				for (int i = 0; i < GetSize(sig_q); i++)
+				{
+					ff_t ff;
+					ff.cell = cell;
+					ff.sig_q = sig_q[i];
+					ff.q = net(sig_q[i]);
+					ff.d = net(sig_d[i]);
+					ff.clk = net(sig_clk[0]);
+					ff.en = cell->hasPort(ID(E)) ? port_net(cell, ID(E)) : -1;
+					ff.clkpol = coarse ? cell->getParam(ID(CLK_POLARITY)).as_bool() : cell->type.str()[ff.en < 0 ? 6 : 7] == 'P';
+					ff.enpol = ff.en < 0 || cell->type.str()[8] == 'P';
+					ff.past_clock = ff.past_d = ff.past_en = 0;
+
+					if (ff.q < 2 || drivers.count(ff.q))
+						log_error("Output of cell %s (%s) in module %s is a constant or has multiple drivers.\n",
+								log_id(cell), log_id(cell->type), log_id(module));
+					drivers[ff.q] = cell;
+					ffs.push_back(ff);
+				}
+				continue;
+			}
 
-			if (w == nullptr)
-				log_error("Can't find port %s on module %s.\n", log_id(portname), log_id(top->module));
+			if (cell->type.in(ID($assert), ID($assume), ID($cover)))
+			{
+				formal_t f;
+				f.cell = cell;
+				f.a = port_net(cell, ID::A);
+				f.en = port_net(cell, ID(EN));
+				f.label = log_id(cell);
+				if (cell->attributes.count(ID(src)))
+					f.label = cell->attributes.at(ID(src)).decode_string();
+				formals.push_back(f);
+				continue;
+			}
 
-			top->set_state(w, value);
+			log_error("Cell %s of type %s in module %s is not supported by the parallel engine (run 'techmap' first).\n",
+					log_id(cell), log_id(cell->type), log_id(module));
 		}
-	}
 
-	void run(Module *topmod, int numcycles)
-	{
-		log_assert(top == nullptr);
-		top = new SimInstance(this, topmod);
+		// levelize the combinational gates (Kahn's algorithm)
+		dict<int, vector<int>> readers;
+		vector<int> pending(GetSize(unsorted_gates));
+		dict<int, int> gate_driver;
+		for (int i = 0; i < GetSize(unsorted_gates); i++)
+			gate_driver[unsorted_gates[i].y] = i;
+
+		for (int i = 0; i < GetSize(unsorted_gates); i++) {
+			const gate_t &g = unsorted_gates[i];
+			for (int n : {g.a, g.b, g.c, g.d})
+				if (gate_driver.count(n)) {
+					readers[n].push_back(i);
+					pending[i]++;
+				}
+		}
 
-		if (debug)
-			log("\n===== 0 =====\n");
-		else
-			log("Simulating cycle 0.\n");
+		vector<int> queue, gate_level(GetSize(unsorted_gates));
+		for (int i = 0; i < GetSize(unsorted_gates); i++)
+			if (pending[i] == 0)
+				queue.push_back(i);
+
+		int num_levels = 0;
+		for (int k = 0; k < GetSize(queue); k++) {
+			const gate_t &g = unsorted_gates[queue[k]];
+			num_levels = max(num_levels, gate_level[queue[k]] + 1);
+			auto it = readers.find(g.y);
+			if (it != readers.end())
+				for (int i : it->second) {
+					gate_level[i] = max(gate_level[i], gate_level[queue[k]] + 1);
+					if (--pending[i] == 0)
+						queue.push_back(i);
+				}
+		}
 
-		set_inports(reset, State::S1);
-		set_inports(resetn, State::S0);
+		level_start.resize(num_levels + 1);
+		for (int i : queue)
+			level_start[gate_level[i] + 1]++;
+		for (int i = 0; i < num_levels; i++)
+			level_start[i + 1] += level_start[i];
+		gates.resize(GetSize(queue));
+		vector<int> level_pos(level_start.begin(), level_start.end() - 1);
+		for (int i : queue)
+			gates[level_pos[gate_level[i]]++] = unsorted_gates[i];
+
+		if (GetSize(queue) != GetSize(unsorted_gates))
+			for (int i = 0; i < GetSize(unsorted_gates); i++)
+				if (pending[i] != 0)
+					log_error("Found a combinational loop through cell %s in module %s.\n",
+							log_id(drivers.at(unsorted_gates[i].y)), log_id(module));
 
-		set_inports(clock, State::Sx);
-		set_inports(clockn, State::Sx);
+		for (auto wire : module->wires())
+			for (auto bit : SigSpec(wire))
+				net(bit);
 
-		update();
+		nets.resize(GetSize(net_index) + 2);
+		nets[1] = ~word_t(0);
 
-		write_vcd_header();
-		write_vcd_step(0);
+		// registers start with their init value, or 0 if it is undefined
+		for (auto wire : module->wires())
+			if (wire->attributes.count(ID(init))) {
+				Const initval = wire->attributes.at(ID(init));
+				for (int i = 0; i < GetSize(wire) && i < GetSize(initval); i++)
+					if (initval[i] == State::S1)
+						nets[net(SigBit(wire, i))] = ~word_t(0);
+			}
 
-		for (int cycle = 0; cycle < numcycles; cycle++)
-		{
-			if (debug)
-				log("\n===== %d =====\n", 10*cycle + 5);
+		if (verbose)
+			log("Parallel engine: %d nets, %d gates (%d levels) in %d lanes, %d flip-flops.\n",
+					GetSize(nets), GetSize(gates), num_levels, num_lanes, GetSize(ffs));
+	}
 
-			set_inports(clock, State::S0);
-			set_inports(clockn, State::S1);
+	~BitSimInstance()
+	{
+#ifdef YOSYS_ENABLE_THREADS
+		if (!threads.empty()) {
+			stop_threads = true;
+			start_gen++;
+			for (auto &t : threads)
+				t.join();
+		}
+#endif
+	}
 
-			update();
-			write_vcd_step(10*cycle + 5);
+	// Evaluate the gates with the given number of threads. Only levels of at
+	// least min_slab gates per thread are split, if there are none the
+	// threads are not started.
+	void start_threads(int num_threads, int min_slab = 1024)
+	{
+#ifdef YOSYS_ENABLE_THREADS
+		log_assert(threads.empty());
+		if (num_threads <= 1)
+			return;
 
-			if (debug)
-				log("\n===== %d =====\n", 10*cycle + 10);
+		int num_split = 0;
+		for (int i = 0; i+1 < GetSize(level_start); i++) {
+			int begin = level_start[i], end = level_start[i+1];
+			bool split = end - begin >= min_slab * num_threads;
+			if (!split && !schedule.empty() && !schedule.back().split)
+				schedule.back().end = end;
 			else
-				log("Simulating cycle %d.\n", cycle+1);
+				schedule.push_back({begin, end, split});
+			num_split += split;
+		}
 
-			set_inports(clock, State::S1);
+		if (num_split == 0) {
+			schedule.clear();
+			return;
+		}
+
+		log("Parallel engine: evaluating %d of %d levels with %d threads.\n",
+				num_split, GetSize(level_start) - 1, num_threads);
+
+		barrier_count = 0;
+		barrier_gen = 0;
+		start_gen = 0;
+		stop_threads = false;
+		for (int i = 1; i < num_threads; i++)
+			threads.emplace_back([this, i]() {
+				int gen = 0;
+				while (1) {
+					while (start_gen == gen)
+						std::this_thread::yield();
+					gen = start_gen;
+					if (stop_threads)
+						break;
+					eval_schedule(i);
+				}
+			});
+#else
+		(void)num_threads;
+		(void)min_slab;
+#endif
+	}
+
+	word_t random_word()
+	{
+		// xorshift64
+		rng_state ^= rng_state << 13;
+		rng_state ^= rng_state >> 7;
+		rng_state ^= rng_state << 17;
+		return rng_state;
+	}
+
+	void set_inport(Wire *wire, word_t value)
+	{
+		for (auto bit : SigSpec(wire))
+			nets[net(bit)] = value;
+	}
+
+	void randomize_inputs(const pool<IdString> &exclude)
+	{
+		for (auto wire : module->wires())
+			if (wire->port_input && !exclude.count(wire->name))
+				for (auto bit : SigSpec(wire))
+					nets[net(bit)] = random_word();
+	}
+
+	// the same random values in all lanes
+	void randomize_inputs_shared(const pool<IdString> &exclude)
+	{
+		for (auto wire : module->wires())
+			if (wire->port_input && !exclude.count(wire->name))
+				for (auto bit : SigSpec(wire))
+					nets[net(bit)] = (random_word() & 1) ? ~word_t(0) : 0;
+	}
+
+	// the lanes in which any output differs from lane 0
+	word_t outputs_diff_lane0()
+	{
+		word_t diff = 0;
+		for (auto wire : module->wires())
+			if (wire->port_output)
+				for (auto bit : SigSpec(wire)) {
+					word_t w = nets[net(bit)];
+					diff |= w ^ (word_t(0) - (w & 1));
+				}
+		return diff;
+	}
+
+#ifdef YOSYS_ENABLE_THREADS
+	void barrier()
+	{
+		int gen = barrier_gen;
+		if (++barrier_count == GetSize(threads) + 1) {
+			barrier_count = 0;
+			barrier_gen++;
+		} else {
+			while (barrier_gen == gen)
+				std::this_thread::yield();
+		}
+	}
+
+	void eval_schedule(int thread_idx)
+	{
+		int num_threads = GetSize(threads) + 1;
+		for (auto &seg : schedule) {
+			if (seg.split) {
+				int size = seg.end - seg.begin;
+				eval_gates(seg.begin + int64_t(size) * thread_idx / num_threads,
+						seg.begin + int64_t(size) * (thread_idx + 1) / num_threads);
+			} else if (thread_idx == 0)
+				eval_gates(seg.begin, seg.end);
+			barrier();
+		}
+	}
+#endif
+
+	void eval_gates()
+	{
+#ifdef YOSYS_ENABLE_THREADS
+		if (!threads.empty()) {
+			start_gen++;
+			eval_schedule(0);
+			return;
+		}
+#endif
+		eval_gates(0, GetSize(gates));
+	}
+
+	void eval_gates(int begin, int end)
+	{
+		word_t *n = nets.data();
+		for (int i = begin; i < end; i++)
+		{
+			const gate_t &g = gates[i];
+			word_t y;
+			switch (g.type)
+			{
+				case G_BUF:    y = n[g.a]; break;
+				case G_NOT:    y = ~n[g.a]; break;
+				case G_AND:    y = n[g.a] & n[g.b]; break;
+				case G_NAND:   y = ~(n[g.a] & n[g.b]); break;
+				case G_OR:     y = n[g.a] | n[g.b]; break;
+				case G_NOR:    y = ~(n[g.a] | n[g.b]); break;
+				case G_XOR:    y = n[g.a] ^ n[g.b]; break;
+				case G_XNOR:   y = ~(n[g.a] ^ n[g.b]); break;
+				case G_ANDNOT: y = n[g.a] & ~n[g.b]; break;
+				case G_ORNOT:  y = n[g.a] | ~n[g.b]; break;
+				case G_MUX:    y = (n[g.a] & ~n[g.c]) | (n[g.b] & n[g.c]); break;
+				case G_NMUX:   y = ~((n[g.a] & ~n[g.c]) | (n[g.b] & n[g.c])); break;
+				case G_AOI3:   y = ~((n[g.a] & n[g.b]) | n[g.c]); break;
+				case G_OAI3:   y = ~((n[g.a] | n[g.b]) & n[g.c]); break;
+				case G_AOI4:   y = ~((n[g.a] & n[g.b]) | (n[g.c] & n[g.d])); break;
+				case G_OAI4:   y = ~((n[g.a] | n[g.b]) & (n[g.c] | n[g.d])); break;
+				default:       log_abort();
+			}
+			n[g.y] = y;
+		}
+	}
+
+	// same phases as SimInstance: fire the flip-flops (in the lanes with a
+	// clock edge) until nothing changes, then sample the new clocks and data
+	bool update_ffs()
+	{
+		bool did_something = false;
+
+		for (auto &ff : ffs)
+		{
+			word_t clk = nets[ff.clk];
+			word_t edge = ff.clkpol ? ~ff.past_clock & clk : ff.past_clock & ~clk;
+			if (ff.en >= 0)
+				edge &= ff.enpol ? ff.past_en : ~ff.past_en;
+
+			word_t q = (nets[ff.q] & ~edge) | (ff.past_d & edge);
+			if (q != nets[ff.q]) {
+				nets[ff.q] = q;
+				did_something = true;
+			}
+		}
+
+		return did_something;
+	}
+
+	void update()
+	{
+		do
+			eval_gates();
+		while (update_ffs());
+
+		for (auto &ff : ffs) {
+			ff.past_clock = nets[ff.clk];
+			ff.past_d = nets[ff.d];
+			if (ff.en >= 0)
+				ff.past_en = nets[ff.en];
+		}
+	}
+
+	static int count_lanes(word_t w)
+	{
+		int count = 0;
+		for (; w; w &= w - 1)
+			count++;
+		return count;
+	}
+
+	static int first_lane(word_t w)
+	{
+		int lane = 0;
+		while (!(w & 1))
+			w >>= 1, lane++;
+		return lane;
+	}
+
+	void check_formal(int t)
+	{
+		for (auto &f : formals)
+		{
+			word_t hit = nets[f.en] & ~nets[f.a];
+			if (!hit)
+				continue;
+
+			if (f.cell->type == ID($cover))
+				log("Cover %s.%s (%s) reached at time %d in %d lanes.\n", log_id(module), log_id(f.cell), f.label.c_str(), t, count_lanes(hit));
+
+			if (f.cell->type == ID($assume))
+				log("Assumption %s.%s (%s) failed at time %d in %d lanes.\n", log_id(module), log_id(f.cell), f.label.c_str(), t, count_lanes(hit));
+
+			if (f.cell->type == ID($assert))
+				log_warning("Assert %s.%s (%s) failed at time %d in %d lanes (first failing lane: %d).\n", log_id(module),
+						log_id(f.cell), f.label.c_str(), t, count_lanes(hit), first_lane(hit));
+		}
+	}
+
+	State lane0_state(SigBit bit)
+	{
+		bit = sigmap(bit);
+		if (bit.wire == nullptr)
+			return bit.data;
+		return (nets[net(bit)] & 1) ? State::S1 : State::S0;
+	}
+
+	void writeback()
+	{
+		for (auto wire : module->wires())
+			wire->attributes.erase(ID(init));
+
+		for (auto &ff : ffs)
+		{
+			Wire *w = ff.sig_q.wire;
+			if (w->attributes.count(ID(init)) == 0)
+				w->attributes[ID(init)] = Const(State::Sx, GetSize(w));
+			w->attributes[ID(init)].bits()[ff.sig_q.offset] = lane0_state(ff.sig_q);
+		}
+	}
+
+	void write_vcd_header(VcdWriter &f, int &id)
+	{
+		f << stringf("$scope module %s $end\n", log_id(module));
+
+		for (auto wire : module->wires())
+		{
+			if (shared->hide_internal && wire->name[0] == '$')
+				continue;
+
+			f << stringf("$var wire %d n%d %s%s $end\n", GetSize(wire), id, wire->name[0] == '$' ? "\\" : "", log_id(wire));
+			vcd_database[wire] = make_pair(id++, Const());
+
+			for (auto bit : SigSpec(wire)) {
+				vector<Wire*> &wires = vcd_netmap[net(bit)];
+				if (wires.empty() || wires.back() != wire)
+					wires.push_back(wire);
+			}
+		}
+
+		f << stringf("$upscope $end\n");
+	}
+
+	void write_vcd_step(VcdWriter &f)
+	{
+		// compare lane 0 of all traced nets and only visit wires that changed
+		pool<Wire*> dirty;
+		for (auto &it : vcd_netmap)
+		{
+			bool value = (nets[it.first] & 1) != 0;
+			auto vit = vcd_netvals.find(it.first);
+			if (vit != vcd_netvals.end() && vit->second == value)
+				continue;
+			vcd_netvals[it.first] = value;
+			for (auto wire : it.second)
+				dirty.insert(wire);
+		}
+
+		vector<pair<int, Wire*>> changed;
+		for (auto wire : dirty)
+			changed.push_back(make_pair(vcd_database.at(wire).first, wire));
+		std::sort(changed.begin(), changed.end());
+
+		for (auto &it : changed)
+		{
+			Const value;
+			for (auto bit : SigSpec(it.second))
+				value.bits().push_back(lane0_state(bit));
+
+			Const &last_value = vcd_database.at(it.second).second;
+			if (last_value == value)
+				continue;
+
+			last_value = value;
+			write_vcd_value(f, it.first, value);
+		}
+	}
+};
+
+#ifdef YOSYS_ENABLE_PLUGINS
+// Compiled simulation engine for "sim -compiled". The (flat, fine-grained) top
+// module is converted to C with "write_simplec -api", compiled to a shared
+// object with the host C compiler and loaded with dlopen(). The shared objects
+// are cached in /tmp under the SHA1 of the generated code, so a
+// second run on the same design does not invoke the compiler again. Like the
+// bit-parallel engine this uses two-valued logic.
+struct CompiledSimInstance
+{
+	typedef size_t (*size_func_t)();
+	typedef void (*state_func_t)(void*);
+	typedef bool (*get_bit_func_t)(const void*, int, int);
+	typedef void (*set_bit_func_t)(void*, int, int, bool);
+
+	SimShared *shared;
+	Module *module;
+	void *handle = nullptr;
+	vector<uint64_t> state;
+
+	state_func_t init_func, eval_func, tick_func;
+	get_bit_func_t get_bit_func;
+	set_bit_func_t set_bit_func;
+
+	dict<Wire*, int> wire_index;
+	dict<Wire*, pair<int, Const>> vcd_database;
+
+	void *lookup(const char *name)
+	{
+		void *sym = dlsym(handle, name);
+		if (sym == nullptr)
+			log_error("Can't find symbol %s in compiled simulation model: %s\n", name, dlerror());
+		return sym;
+	}
+
+	CompiledSimInstance(SimShared *shared, Module *module, const std::string &cc_command) : shared(shared), module(module)
+	{
+		for (auto wire : module->wires()) {
+			int idx = GetSize(wire_index);
+			wire_index[wire] = idx;
+		}
+
+		std::stringstream buf;
+		Backend::backend_call(module->design, &buf, "<sim>", "simplec -i64 -api");
+		std::string code = buf.str();
+
+		std::string so_filename = stringf("/tmp/yosys-sim-%s.so", sha1(cc_command + "\n" + code).c_str());
+
+		if (check_file_exists(so_filename)) {
+			log("Using cached simulation model %s.\n", so_filename.c_str());
+		} else {
+			std::string tempdir_name = make_temp_dir("/tmp/yosys-sim-XXXXXX");
+			std::string c_filename = tempdir_name + "/model.c";
+			std::string tmp_so_filename = tempdir_name + "/model.so";
+
+			std::ofstream f(c_filename.c_str());
+			f << code;
+			f.close();
+			if (f.fail())
+				log_error("Can't write simulation model source file `%s'.\n", c_filename.c_str());
+
+			std::string command = stringf("%s -shared -fPIC -o %s %s", cc_command.c_str(), tmp_so_filename.c_str(), c_filename.c_str());
+			log("Compiling simulation model: %s\n", command.c_str());
+			if (run_command(command) != 0)
+				log_error("C compiler returned non-zero exit status for `%s'.\n", command.c_str());
+
+			if (rename(tmp_so_filename.c_str(), so_filename.c_str()) != 0)
+				log_error("Can't move compiled simulation model to `%s': %s\n", so_filename.c_str(), strerror(errno));
+			remove_directory(tempdir_name);
+		}
+
+		handle = dlopen(so_filename.c_str(), RTLD_NOW|RTLD_LOCAL);
+		if (handle == nullptr)
+			log_error("Can't load compiled simulation model `%s': %s\n", so_filename.c_str(), dlerror());
+
+		size_func_t size_func = (size_func_t)lookup("yosys_simplec_state_size");
+		init_func = (state_func_t)lookup("yosys_simplec_init");
+		eval_func = (state_func_t)lookup("yosys_simplec_eval");
+		tick_func = (state_func_t)lookup("yosys_simplec_tick");
+		get_bit_func = (get_bit_func_t)lookup("yosys_simplec_get_bit");
+		set_bit_func = (set_bit_func_t)lookup("yosys_simplec_set_bit");
+
+		state.resize((size_func() + 7) / 8);
+	}
+
+	~CompiledSimInstance()
+	{
+		if (handle != nullptr)
+			dlclose(handle);
+	}
+
+	State get_state(SigBit bit)
+	{
+		if (bit.wire == nullptr)
+			return bit.data;
+		return get_bit_func(state.data(), wire_index.at(bit.wire), bit.offset) ? State::S1 : State::S0;
+	}
+
+	void set_inport(Wire *wire, State value)
+	{
+		for (int i = 0; i < GetSize(wire); i++)
+			set_bit_func(state.data(), wire_index.at(wire), i, value == State::S1);
+	}
+
+	void init()
+	{
+		init_func(state.data());
+	}
+
+	void eval()
+	{
+		eval_func(state.data());
+	}
+
+	void tick()
+	{
+		tick_func(state.data());
+	}
+
+	void writeback()
+	{
+		for (auto wire : module->wires())
+			wire->attributes.erase(ID(init));
+
+		for (auto cell : module->cells())
+		{
+			if (!cell->type.in(ID($_DFF_P_), ID($_DFF_N_)))
+				continue;
+
+			SigBit q = cell->getPort(ID(Q));
+			Wire *w = q.wire;
+			if (w->attributes.count(ID(init)) == 0)
+				w->attributes[ID(init)] = Const(State::Sx, GetSize(w));
+			w->attributes[ID(init)][q.offset] = get_state(q);
+		}
+	}
+
+	void write_vcd_header(VcdWriter &f, int &id)
+	{
+		f << stringf("$scope module %s $end\n", log_id(module));
+
+		for (auto wire : module->wires())
+		{
+			if (shared->hide_internal && wire->name[0] == '$')
+				continue;
+
+			f << stringf("$var wire %d n%d %s%s $end\n", GetSize(wire), id, wire->name[0] == '$' ? "\\" : "", log_id(wire));
+			vcd_database[wire] = make_pair(id++, Const());
+		}
+
+		f << stringf("$upscope $end\n");
+	}
+
+	void write_vcd_step(VcdWriter &f)
+	{
+		vector<pair<int, Wire*>> traced;
+		for (auto &it : vcd_database)
+			traced.push_back(make_pair(it.second.first, it.first));
+		std::sort(traced.begin(), traced.end());
+
+		for (auto &it : traced)
+		{
+			Const value;
+			for (auto bit : SigSpec(it.second))
+				value.bits().push_back(get_state(bit));
+
+			Const &last_value = vcd_database.at(it.second).second;
+			if (last_value == value)
+				continue;
+
+			last_value = value;
+			write_vcd_value(f, it.first, value);
+		}
+	}
+};
+#endif
+
+struct SimWorker : SimShared
+{
+	SimInstance *top = nullptr;
+	VcdWriter vcdfile;
+	pool<IdString> clock, clockn, reset, resetn;
+	bool parallel = false;
+	bool compiled = false;
+	IdString mutants_port;
+	int num_mutants = 0;
+	std::string cc_command = "cc -O2";
+	uint64_t seed = 1;
+	int num_threads = 1;
+	std::string replay_filename, replay_scope;
+
+	~SimWorker()
+	{
+		delete top;
+	}
+
+	void write_vcd_header()
+	{
+		if (!vcdfile.is_open())
+			return;
+
+		int id = 1;
+		top->write_vcd_header(vcdfile, id);
+
+		vcdfile << stringf("$enddefinitions $end\n");
+	}
+
+	void write_vcd_step(int64_t t)
+	{
+		if (!vcdfile.is_open())
+			return;
+
+		vcdfile << stringf("#%lld\n", (long long)t);
+		top->write_vcd_step(vcdfile);
+	}
+
+	void update()
+	{
+		while (1)
+		{
+			if (debug)
+				log("\n-- ph1 --\n");
+
+			top->update_ph1();
+
+			if (debug)
+				log("\n-- ph2 --\n");
+
+			if (!top->update_ph2())
+				break;
+		}
+
+		if (debug)
+			log("\n-- ph3 --\n");
+
+		top->update_ph3();
+	}
+
+	void set_inports(pool<IdString> ports, State value)
+	{
+		for (auto portname : ports)
+		{
+			Wire *w = top->module->wire(portname);
+
+			if (w == nullptr)
+				log_error("Can't find port %s on module %s.\n", log_id(portname), log_id(top->module));
+
+			top->set_state(w, value);
+		}
+	}
+
+	void run(Module *topmod, int numcycles)
+	{
+		log_assert(top == nullptr);
+		top = new SimInstance(this, topmod);
+
+		if (debug)
+			log("\n===== 0 =====\n");
+		else
+			log("Simulating cycle 0.\n");
+
+		set_inports(reset, State::S1);
+		set_inports(resetn, State::S0);
+
+		set_inports(clock, State::Sx);
+		set_inports(clockn, State::Sx);
+
+		update();
+
+		write_vcd_header();
+		write_vcd_step(0);
+
+		for (int cycle = 0; cycle < numcycles; cycle++)
+		{
+			if (debug)
+				log("\n===== %d =====\n", 10*cycle + 5);
+
+			set_inports(clock, State::S0);
+			set_inports(clockn, State::S1);
+
+			update();
+			write_vcd_step(10*cycle + 5);
+
+			if (debug)
+				log("\n===== %d =====\n", 10*cycle + 10);
+			else
+				log("Simulating cycle %d.\n", cycle+1);
+
+			set_inports(clock, State::S1);
 			set_inports(clockn, State::S0);
 
 			if (cycle+1 == rstlen) {
@@ -743,6 +1873,398 @@ struct SimWorker : SimShared
 			top->writeback(wbmods);
 		}
 	}
+
+	// the part of the top-level input port for a variable of the VCD file, or
+	// an empty signal if the variable does not belong to an input port
+	SigSpec replay_port(const VcdReader::var_t &var)
+	{
+		std::string name = var.name;
+		if (name[0] == '\\')
+			name = name.substr(1);
+		Wire *wire = top->module->wire(RTLIL::escape_id(name));
+		if (wire == nullptr || !wire->port_input)
+			return SigSpec();
+
+		int width = GetSize(wire);
+		int offset = 0;
+		if (var.msb >= 0) {
+			int msb = wire->upto ? width - 1 - (var.msb - wire->start_offset) : var.msb - wire->start_offset;
+			int lsb = wire->upto ? width - 1 - (var.lsb - wire->start_offset) : var.lsb - wire->start_offset;
+			if (msb < lsb || lsb < 0 || msb >= width) {
+				log_warning("Ignoring VCD variable %s%s for port %s, the range does not match the port.\n",
+						var.name.c_str(), var.msb == var.lsb ? stringf("[%d]", var.msb).c_str() :
+						stringf("[%d:%d]", var.msb, var.lsb).c_str(), log_id(wire));
+				return SigSpec();
+			}
+			offset = lsb;
+			width = msb - lsb + 1;
+		}
+
+		if (width != var.width) {
+			log_warning("Ignoring VCD variable %s for port %s, it has %d bits instead of %d.\n",
+					var.name.c_str(), log_id(wire), var.width, width);
+			return SigSpec();
+		}
+		return SigSpec(wire, offset, width);
+	}
+
+	void run_replay(Module *topmod)
+	{
+		log_assert(top == nullptr);
+		top = new SimInstance(this, topmod);
+
+		VcdReader reader;
+		reader.open(replay_filename);
+		reader.read_header();
+
+		std::string scope = replay_scope.empty() ? log_id(topmod) : replay_scope;
+		dict<std::string, vector<SigSpec>> id_ports;
+		pool<Wire*> driven;
+		for (auto &var : reader.vars) {
+			if (var.scope != scope)
+				continue;
+			SigSpec sig = replay_port(var);
+			if (sig.empty())
+				continue;
+			id_ports[var.id].push_back(sig);
+			driven.insert(sig.as_chunk().wire);
+		}
+
+		if (id_ports.empty())
+			log_error("VCD file `%s' has no variables for the inputs of module %s in scope `%s'.\n",
+					replay_filename.c_str(), log_id(topmod), scope.c_str());
+
+		for (auto wire : topmod->wires())
+			if (wire->port_input && !driven.count(wire))
+				log_warning("Input port %s is not driven by the VCD file.\n", log_id(wire));
+
+		log("Replaying %d input ports from VCD file `%s' (scope `%s').\n",
+				GetSize(driven), replay_filename.c_str(), scope.c_str());
+
+		auto apply = [&](const std::string &id, const Const &value) {
+			auto it = id_ports.find(id);
+			if (it != id_ports.end())
+				for (auto &sig : it->second)
+					top->set_state(sig, value);
+		};
+
+		int steps = 0;
+		int64_t last_time = 0;
+		bool header = false;
+		while (reader.read_step(apply))
+		{
+			if (debug)
+				log("\n===== %lld =====\n", (long long)reader.time);
+
+			update();
+			steps++;
+			last_time = reader.time;
+
+			if (!header) {
+				write_vcd_header();
+				header = true;
+			}
+			write_vcd_step(reader.time);
+		}
+
+		log("Replayed %d time steps, the last one at time %lld.\n", steps, (long long)last_time);
+
+		if (writeback) {
+			pool<Module*> wbmods;
+			top->writeback(wbmods);
+		}
+	}
+
+	void set_inports(BitSimInstance &inst, pool<IdString> ports, State value)
+	{
+		for (auto portname : ports)
+		{
+			Wire *w = inst.module->wire(portname);
+
+			if (w == nullptr)
+				log_error("Can't find port %s on module %s.\n", log_id(portname), log_id(inst.module));
+
+			inst.set_inport(w, value == State::S1 ? ~BitSimInstance::word_t(0) : 0);
+		}
+	}
+
+	void run_parallel(Module *topmod, int numcycles)
+	{
+		BitSimInstance inst(this, topmod, seed);
+		inst.start_threads(num_threads);
+		int id = 1;
+
+		pool<IdString> fixed_inports;
+		for (auto ports : {clock, clockn, reset, resetn})
+			fixed_inports.insert(ports.begin(), ports.end());
+
+		// in every cycle all other inputs get new random values just
+		// before the inactive clock edge
+		inst.randomize_inputs(fixed_inports);
+
+		set_inports(inst, reset, State::S1);
+		set_inports(inst, resetn, State::S0);
+
+		set_inports(inst, clock, State::S0);
+		set_inports(inst, clockn, State::S1);
+
+		inst.update();
+		inst.check_formal(0);
+
+		if (vcdfile.is_open()) {
+			inst.write_vcd_header(vcdfile, id);
+			vcdfile << stringf("$enddefinitions $end\n");
+			vcdfile << stringf("#0\n");
+			inst.write_vcd_step(vcdfile);
+		}
+
+		for (int cycle = 0; cycle < numcycles; cycle++)
+		{
+			inst.randomize_inputs(fixed_inports);
+
+			set_inports(inst, clock, State::S0);
+			set_inports(inst, clockn, State::S1);
+
+			inst.update();
+			inst.check_formal(10*cycle + 5);
+
+			if (vcdfile.is_open()) {
+				vcdfile << stringf("#%d\n", 10*cycle + 5);
+				inst.write_vcd_step(vcdfile);
+			}
+
+			set_inports(inst, clock, State::S1);
+			set_inports(inst, clockn, State::S0);
+
+			if (cycle+1 == rstlen) {
+				set_inports(inst, reset, State::S0);
+				set_inports(inst, resetn, State::S1);
+			}
+
+			inst.update();
+			inst.check_formal(10*cycle + 10);
+
+			if (vcdfile.is_open()) {
+				vcdfile << stringf("#%d\n", 10*cycle + 10);
+				inst.write_vcd_step(vcdfile);
+			}
+		}
+
+		if (vcdfile.is_open()) {
+			vcdfile << stringf("#%d\n", 10*numcycles + 2);
+			inst.write_vcd_step(vcdfile);
+		}
+
+		log("Simulated %d cycles in %d parallel lanes.\n", numcycles, BitSimInstance::num_lanes);
+
+		if (writeback)
+			inst.writeback();
+	}
+
+	// Lane 0 runs with the mutants port set to 0 and every other lane with the
+	// number of one mutant, all lanes get the same random inputs. A mutant is
+	// detected when an output of its lane differs from lane 0.
+	void run_mutants(Module *topmod, int numcycles)
+	{
+		Wire *ctrl = topmod->wire(mutants_port);
+		if (ctrl == nullptr || !ctrl->port_input)
+			log_error("Can't find input port %s on module %s.\n", log_id(mutants_port), log_id(topmod));
+
+		pool<IdString> fixed_inports;
+		for (auto ports : {clock, clockn, reset, resetn})
+			fixed_inports.insert(ports.begin(), ports.end());
+		fixed_inports.insert(mutants_port);
+
+		dict<int, int> detected;
+		int lanes_per_run = BitSimInstance::num_lanes - 1;
+
+		for (int first = 1; first <= num_mutants; first += lanes_per_run)
+		{
+			BitSimInstance inst(this, topmod, seed, first == 1);
+			int count = std::min(lanes_per_run, num_mutants - first + 1);
+
+			for (int i = 0; i < GetSize(ctrl); i++) {
+				BitSimInstance::word_t w = 0;
+				for (int lane = 1; lane <= count; lane++)
+					if (((first + lane - 1) >> i) & 1)
+						w |= BitSimInstance::word_t(1) << lane;
+				inst.nets[inst.net(SigBit(ctrl, i))] = w;
+			}
+
+			BitSimInstance::word_t found = 0;
+			auto check = [&](int t) {
+				BitSimInstance::word_t diff = inst.outputs_diff_lane0() & ~found;
+				for (int lane = 1; lane <= count; lane++)
+					if ((diff >> lane) & 1)
+						detected[first + lane - 1] = t;
+				found |= diff;
+			};
+
+			inst.randomize_inputs_shared(fixed_inports);
+
+			set_inports(inst, reset, State::S1);
+			set_inports(inst, resetn, State::S0);
+
+			set_inports(inst, clock, State::S0);
+			set_inports(inst, clockn, State::S1);
+
+			inst.update();
+			check(0);
+
+			for (int cycle = 0; cycle < numcycles; cycle++)
+			{
+				inst.randomize_inputs_shared(fixed_inports);
+
+				set_inports(inst, clock, State::S0);
+				set_inports(inst, clockn, State::S1);
+
+				inst.update();
+				check(10*cycle + 5);
+
+				set_inports(inst, clock, State::S1);
+				set_inports(inst, clockn, State::S0);
+
+				if (cycle+1 == rstlen) {
+					set_inports(inst, reset, State::S0);
+					set_inports(inst, resetn, State::S1);
+				}
+
+				inst.update();
+				check(10*cycle + 10);
+			}
+		}
+
+		std::string undetected;
+		for (int i = 1; i <= num_mutants; i++) {
+			if (detected.count(i)) {
+				if (debug)
+					log("Mutant %d detected at time %d.\n", i, detected.at(i));
+				continue;
+			}
+			undetected += stringf("%s%d", undetected.empty() ? "" : " ", i);
+		}
+
+		log("Simulated %d cycles for %d mutants in %d runs.\n", numcycles, num_mutants, (num_mutants + lanes_per_run - 1) / lanes_per_run);
+		log("Detected %d of %d mutants.\n", GetSize(detected), num_mutants);
+		if (!undetected.empty())
+			log("Undetected mutants: %s\n", undetected.c_str());
+
+		topmod->design->scratchpad_set_int("sim.mutants_detected", GetSize(detected));
+		topmod->design->scratchpad_set_string("sim.mutants_undetected", undetected);
+	}
+
+#ifdef YOSYS_ENABLE_PLUGINS
+	void set_inports(CompiledSimInstance &inst, pool<IdString> ports, State value)
+	{
+		for (auto portname : ports)
+		{
+			Wire *w = inst.module->wire(portname);
+
+			if (w == nullptr)
+				log_error("Can't find port %s on module %s.\n", log_id(portname), log_id(inst.module));
+
+			inst.set_inport(w, value);
+		}
+	}
+
+	void run_compiled(Module *topmod, int numcycles)
+	{
+		SigMap sigmap(topmod);
+		CellTypes ct;
+		ct.setup_internals_mem();
+		ct.setup_stdcells_mem();
+
+		if (topmod != topmod->design->top_module())
+			log_error("The -compiled engine can only simulate the top module of the design.\n");
+
+		for (auto cell : topmod->cells())
+		{
+			if (topmod->design->module(cell->type))
+				log_error("The -compiled engine needs a flat design, but cell %s in module %s is an instance of module %s.\n",
+						log_id(cell), log_id(topmod), log_id(cell->type));
+
+			if (cell->type.in(ID($_DFF_P_), ID($_DFF_N_))) {
+				SigBit c = sigmap(cell->getPort(ID(C)));
+				const pool<IdString> &clk_ports = cell->type == ID($_DFF_P_) ? clock : clockn;
+				if (c.wire == nullptr || !c.wire->port_input || clk_ports.count(c.wire->name) == 0)
+					log_error("Flip-flop %s (%s) in module %s is not clocked by a %s port, the -compiled engine only supports a single clock edge.\n",
+							log_id(cell), log_id(cell->type), log_id(topmod), cell->type == ID($_DFF_P_) ? "-clock" : "-clockn");
+				continue;
+			}
+
+			if (ct.cell_known(cell->type))
+				log_error("Cell %s (%s) in module %s is not supported by the -compiled engine, only $_DFF_P_ and $_DFF_N_ flip-flops are.\n",
+						log_id(cell), log_id(cell->type), log_id(topmod));
+		}
+
+		CompiledSimInstance inst(this, topmod, cc_command);
+		int id = 1;
+
+		log("Simulating cycle 0.\n");
+
+		set_inports(inst, reset, State::S1);
+		set_inports(inst, resetn, State::S0);
+
+		set_inports(inst, clock, State::S0);
+		set_inports(inst, clockn, State::S1);
+
+		inst.init();
+
+		if (vcdfile.is_open()) {
+			inst.write_vcd_header(vcdfile, id);
+			vcdfile << stringf("$enddefinitions $end\n");
+			vcdfile << stringf("#0\n");
+			inst.write_vcd_step(vcdfile);
+		}
+
+		for (int cycle = 0; cycle < numcycles; cycle++)
+		{
+			set_inports(inst, clock, State::S0);
+			set_inports(inst, clockn, State::S1);
+
+			inst.eval();
+
+			if (vcdfile.is_open()) {
+				vcdfile << stringf("#%d\n", 10*cycle + 5);
+				inst.write_vcd_step(vcdfile);
+			}
+
+			set_inports(inst, clock, State::S1);
+			set_inports(inst, clockn, State::S0);
+
+			// like in the event-driven engine the flip-flops sample the
+			// values from before the inputs that change with the clock
+			inst.tick();
+
+			if (cycle+1 == rstlen) {
+				set_inports(inst, reset, State::S0);
+				set_inports(inst, resetn, State::S1);
+			}
+
+			inst.eval();
+
+			if (vcdfile.is_open()) {
+				vcdfile << stringf("#%d\n", 10*cycle + 10);
+				inst.write_vcd_step(vcdfile);
+			}
+		}
+
+		log("Simulated %d cycles.\n", numcycles);
+
+		if (vcdfile.is_open()) {
+			vcdfile << stringf("#%d\n", 10*numcycles + 2);
+			inst.write_vcd_step(vcdfile);
+		}
+
+		if (writeback)
+			inst.writeback();
+	}
+#else
+	void run_compiled(Module*, int)
+	{
+		log_error("This version of yosys is built without plugin support, which is needed for the -compiled engine.\n");
+	}
+#endif
 };
 
 struct SimPass : public Pass {
@@ -756,7 +2278,9 @@ struct SimPass : public Pass {
 		log("This command simulates the circuit using the given top-level module.\n");
 		log("\n");
 		log("    -vcd <filename>\n");
-		log("        write the simulation results to the given VCD file\n");
+		log("        write the simulation results to the given VCD file. the file is\n");
+		log("        written gzip-compressed if the file name ends in \".gz\" and\n");
+		log("        zstd-compressed if it ends in \".zst\".\n");
 		log("\n");
 		log("    -clock <portname>\n");
 		log("        name of top-level clock input\n");
@@ -779,6 +2303,18 @@ struct SimPass : public Pass {
 		log("    -n <integer>\n");
 		log("        number of cycles to simulate (default: 20)\n");
 		log("\n");
+		log("    -r <filename>\n");
+		log("        drive the top-level inputs from the given (uncompressed) VCD file\n");
+		log("        instead of using -clock and -reset. the file is read one time step\n");
+		log("        at a time and the circuit is simulated until the end of the file,\n");
+		log("        the steps of the -vcd output have the times of the input file.\n");
+		log("        the variables are matched to the input ports by name, either for\n");
+		log("        whole ports or for single bits or ranges of a port.\n");
+		log("\n");
+		log("    -scope <name>\n");
+		log("        scope of the top-level module in the -r file, as dot-separated list\n");
+		log("        of the VCD scopes, e.g. \"tb.dut\" (default: name of the top module)\n");
+		log("\n");
 		log("    -a\n");
 		log("        include all nets in VCD output, not just those with public names\n");
 		log("\n");
@@ -788,10 +2324,53 @@ struct SimPass : public Pass {
 		log("    -d\n");
 		log("        enable debug output\n");
 		log("\n");
+		log("    -parallel\n");
+		log("        use the bit-parallel engine: simulate 64 independent runs at once,\n");
+		log("        driving all top-level inputs except the clock and reset inputs\n");
+		log("        with new random values in every cycle. Assert, assume and cover\n");
+		log("        cells are checked in all runs, the VCD file and the writeback\n");
+		log("        state are taken from the first run. This engine only supports\n");
+		log("        flat designs with fine-grained cells (as created by 'techmap')\n");
+		log("        and $dff cells, and uses two-valued logic: undefined bits and\n");
+		log("        uninitialized registers are simulated as 0.\n");
+		log("\n");
+		log("    -j <N>\n");
+		log("        evaluate the gates of the -parallel engine with up to N threads.\n");
+		log("        the gates of each logic level with enough gates are split among\n");
+		log("        the threads, which synchronize after each level. the results do\n");
+		log("        not depend on the number of threads. if not specified, defaults\n");
+		log("        to the global -j value.\n");
+		log("\n");
+		log("    -seed <integer>\n");
+		log("        seed for the random input values in -parallel mode (default: 1)\n");
+		log("\n");
+		log("    -mutants <portname> <N>\n");
+		log("        evaluate the mutants of a design created with 'mutate -ctrl <portname>'\n");
+		log("        (see also 'mutate -eval'): run the bit-parallel engine with the given\n");
+		log("        input set to 0 in the first lane and to the numbers 1 to N in the other\n");
+		log("        lanes (63 mutants per run), and the same random values on all other\n");
+		log("        inputs in all lanes. a mutant is detected if a top-level output differs\n");
+		log("        from the first lane. the number of detected mutants and the list of\n");
+		log("        undetected ones are also stored in the scratchpad variables\n");
+		log("        sim.mutants_detected and sim.mutants_undetected.\n");
+		log("\n");
+		log("    -compiled\n");
+		log("        convert the top module to C with 'write_simplec -api', compile it\n");
+		log("        to a shared object and run the simulation on the compiled model.\n");
+		log("        the shared object is cached in /tmp under the hash of the generated\n");
+		log("        code. this engine only supports flat designs with fine-grained\n");
+		log("        cells and $_DFF_P_ (on -clock) or $_DFF_N_ (on -clockn) flip-flops,\n");
+		log("        and uses two-valued logic: undefined bits, uninitialized registers\n");
+		log("        and inputs without a value are simulated as 0.\n");
+		log("\n");
+		log("    -cc <command>\n");
+		log("        C compiler command used by -compiled (default: \"cc -O2\")\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
 	{
 		SimWorker worker;
+		worker.num_threads = yosys_threads;
 		int numcycles = 20;
 
 		log_header(design, "Executing SIM pass (simulate the circuit).\n");
@@ -799,13 +2378,24 @@ struct SimPass : public Pass {
 		size_t argidx;
 		for (argidx = 1; argidx < args.size(); argidx++) {
 			if (args[argidx] == "-vcd" && argidx+1 < args.size()) {
-				worker.vcdfile.open(args[++argidx].c_str());
+				std::string vcd_filename = args[++argidx];
+				rewrite_filename(vcd_filename);
+				worker.vcdfile.open(vcd_filename);
 				continue;
 			}
 			if (args[argidx] == "-n" && argidx+1 < args.size()) {
 				numcycles = atoi(args[++argidx].c_str());
 				continue;
 			}
+			if (args[argidx] == "-r" && argidx+1 < args.size()) {
+				worker.replay_filename = args[++argidx];
+				rewrite_filename(worker.replay_filename);
+				continue;
+			}
+			if (args[argidx] == "-scope" && argidx+1 < args.size()) {
+				worker.replay_scope = args[++argidx];
+				continue;
+			}
 			if (args[argidx] == "-rstlen" && argidx+1 < args.size()) {
 				worker.rstlen = atoi(args[++argidx].c_str());
 				continue;
@@ -842,6 +2432,31 @@ struct SimPass : public Pass {
 				worker.zinit = true;
 				continue;
 			}
+			if (args[argidx] == "-parallel") {
+				worker.parallel = true;
+				continue;
+			}
+			if (args[argidx] == "-compiled") {
+				worker.compiled = true;
+				continue;
+			}
+			if (args[argidx] == "-cc" && argidx+1 < args.size()) {
+				worker.cc_command = args[++argidx];
+				continue;
+			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				worker.num_threads = max(1, atoi(args[++argidx].c_str()));
+				continue;
+			}
+			if (args[argidx] == "-seed" && argidx+1 < args.size()) {
+				worker.seed = strtoull(args[++argidx].c_str(), nullptr, 0);
+				continue;
+			}
+			if (args[argidx] == "-mutants" && argidx+2 < args.size()) {
+				worker.mutants_port = RTLIL::escape_id(args[++argidx]);
+				worker.num_mutants = atoi(args[++argidx].c_str());
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
@@ -860,7 +2475,29 @@ struct SimPass : public Pass {
 			top_mod = mods.front();
 		}
 
-		worker.run(top_mod, numcycles);
+		if (worker.parallel && worker.compiled)
+			log_cmd_error("The options -parallel and -compiled are exclusive.\n");
+
+		if (!worker.mutants_port.empty() && worker.compiled)
+			log_cmd_error("The options -mutants and -compiled are exclusive.\n");
+
+		if (!worker.replay_filename.empty()) {
+			if (worker.parallel || worker.compiled || !worker.mutants_port.empty())
+				log_cmd_error("The option -r can't be used with -parallel, -compiled or -mutants.\n");
+			if (!worker.clock.empty() || !worker.clockn.empty() || !worker.reset.empty() || !worker.resetn.empty())
+				log_cmd_error("The option -r can't be used with -clock, -clockn, -reset or -resetn.\n");
+		}
+
+		if (!worker.replay_filename.empty())
+			worker.run_replay(top_mod);
+		else if (!worker.mutants_port.empty())
+			worker.run_mutants(top_mod, numcycles);
+		else if (worker.parallel)
+			worker.run_parallel(top_mod, numcycles);
+		else if (worker.compiled)
+			worker.run_compiled(top_mod, numcycles);
+		else
+			worker.run(top_mod, numcycles);
 	}
 } SimPass;
 
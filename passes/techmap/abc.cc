@@ -45,6 +45,7 @@
 #include "kernel/sigtools.h"
 #include "kernel/celltypes.h"
 #include "kernel/cost.h"
+#include "kernel/ffindex.h"
 #include "kernel/log.h"
 #include <stdlib.h>
 #include <stdio.h>
@@ -53,6 +54,8 @@
 #include <cerrno>
 #include <sstream>
 #include <climits>
+#include <queue>
+#include <sys/stat.h>
 
 #ifndef _WIN32
 #  include <unistd.h>
@@ -60,6 +63,8 @@
 #endif
 
 #include "frontends/blif/blifparse.h"
+#include "passes/techmap/abc_coproc.h"
+#include "passes/techmap/libparse.h"
 
 #ifdef YOSYS_LINK_ABC
 extern "C" int Abc_RealMain(int argc, char *argv[]);
@@ -101,434 +106,15 @@ struct gate_t
 	RTLIL::State init;
 };
 
+
 bool map_mux4;
 bool map_mux8;
 bool map_mux16;
 
 bool markgroups;
-int map_autoidx;
-SigMap assign_map;
-RTLIL::Module *module;
-std::vector<gate_t> signal_list;
-std::map<RTLIL::SigBit, int> signal_map;
-std::map<RTLIL::SigBit, RTLIL::State> signal_init;
+bool coproc_mode;
 pool<std::string> enabled_gates;
-bool recover_init, cmos_cost;
-
-bool clk_polarity, en_polarity;
-RTLIL::SigSpec clk_sig, en_sig;
-dict<int, std::string> pi_map, po_map;
-
-int map_signal(RTLIL::SigBit bit, gate_type_t gate_type = G(NONE), int in1 = -1, int in2 = -1, int in3 = -1, int in4 = -1)
-{
-	assign_map.apply(bit);
-
-	if (signal_map.count(bit) == 0) {
-		gate_t gate;
-		gate.id = signal_list.size();
-		gate.type = G(NONE);
-		gate.in1 = -1;
-		gate.in2 = -1;
-		gate.in3 = -1;
-		gate.in4 = -1;
-		gate.is_port = false;
-		gate.bit = bit;
-		if (signal_init.count(bit))
-			gate.init = signal_init.at(bit);
-		else
-			gate.init = State::Sx;
-		signal_list.push_back(gate);
-		signal_map[bit] = gate.id;
-	}
-
-	gate_t &gate = signal_list[signal_map[bit]];
-
-	if (gate_type != G(NONE))
-		gate.type = gate_type;
-	if (in1 >= 0)
-		gate.in1 = in1;
-	if (in2 >= 0)
-		gate.in2 = in2;
-	if (in3 >= 0)
-		gate.in3 = in3;
-	if (in4 >= 0)
-		gate.in4 = in4;
-
-	return gate.id;
-}
-
-void mark_port(RTLIL::SigSpec sig)
-{
-	for (auto &bit : assign_map(sig))
-		if (bit.wire != NULL && signal_map.count(bit) > 0)
-			signal_list[signal_map[bit]].is_port = true;
-}
-
-void extract_cell(RTLIL::Cell *cell, bool keepff)
-{
-	if (cell->type.in(ID($_DFF_N_), ID($_DFF_P_)))
-	{
-		if (clk_polarity != (cell->type == ID($_DFF_P_)))
-			return;
-		if (clk_sig != assign_map(cell->getPort(ID(C))))
-			return;
-		if (GetSize(en_sig) != 0)
-			return;
-		goto matching_dff;
-	}
-
-	if (cell->type.in(ID($_DFFE_NN_), ID($_DFFE_NP_), ID($_DFFE_PN_), ID($_DFFE_PP_)))
-	{
-		if (clk_polarity != cell->type.in(ID($_DFFE_PN_), ID($_DFFE_PP_)))
-			return;
-		if (en_polarity != cell->type.in(ID($_DFFE_NP_), ID($_DFFE_PP_)))
-			return;
-		if (clk_sig != assign_map(cell->getPort(ID(C))))
-			return;
-		if (en_sig != assign_map(cell->getPort(ID(E))))
-			return;
-		goto matching_dff;
-	}
-
-	if (0) {
-	matching_dff:
-		RTLIL::SigSpec sig_d = cell->getPort(ID(D));
-		RTLIL::SigSpec sig_q = cell->getPort(ID(Q));
-
-		if (keepff)
-			for (auto &c : sig_q.chunks())
-				if (c.wire != NULL)
-					c.wire->attributes[ID::keep] = 1;
-
-		assign_map.apply(sig_d);
-		assign_map.apply(sig_q);
-
-		map_signal(sig_q, G(FF), map_signal(sig_d));
-
-		module->remove(cell);
-		return;
-	}
-
-	if (cell->type.in(ID($_BUF_), ID($_NOT_)))
-	{
-		RTLIL::SigSpec sig_a = cell->getPort(ID::A);
-		RTLIL::SigSpec sig_y = cell->getPort(ID::Y);
-
-		assign_map.apply(sig_a);
-		assign_map.apply(sig_y);
-
-		map_signal(sig_y, cell->type == ID($_BUF_) ? G(BUF) : G(NOT), map_signal(sig_a));
-
-		module->remove(cell);
-		return;
-	}
-
-	if (cell->type.in(ID($_AND_), ID($_NAND_), ID($_OR_), ID($_NOR_), ID($_XOR_), ID($_XNOR_), ID($_ANDNOT_), ID($_ORNOT_)))
-	{
-		RTLIL::SigSpec sig_a = cell->getPort(ID::A);
-		RTLIL::SigSpec sig_b = cell->getPort(ID::B);
-		RTLIL::SigSpec sig_y = cell->getPort(ID::Y);
-
-		assign_map.apply(sig_a);
-		assign_map.apply(sig_b);
-		assign_map.apply(sig_y);
-
-		int mapped_a = map_signal(sig_a);
-		int mapped_b = map_signal(sig_b);
-
-		if (cell->type == ID($_AND_))
-			map_signal(sig_y, G(AND), mapped_a, mapped_b);
-		else if (cell->type == ID($_NAND_))
-			map_signal(sig_y, G(NAND), mapped_a, mapped_b);
-		else if (cell->type == ID($_OR_))
-			map_signal(sig_y, G(OR), mapped_a, mapped_b);
-		else if (cell->type == ID($_NOR_))
-			map_signal(sig_y, G(NOR), mapped_a, mapped_b);
-		else if (cell->type == ID($_XOR_))
-			map_signal(sig_y, G(XOR), mapped_a, mapped_b);
-		else if (cell->type == ID($_XNOR_))
-			map_signal(sig_y, G(XNOR), mapped_a, mapped_b);
-		else if (cell->type == ID($_ANDNOT_))
-			map_signal(sig_y, G(ANDNOT), mapped_a, mapped_b);
-		else if (cell->type == ID($_ORNOT_))
-			map_signal(sig_y, G(ORNOT), mapped_a, mapped_b);
-		else
-			log_abort();
-
-		module->remove(cell);
-		return;
-	}
-
-	if (cell->type.in(ID($_MUX_), ID($_NMUX_)))
-	{
-		RTLIL::SigSpec sig_a = cell->getPort(ID::A);
-		RTLIL::SigSpec sig_b = cell->getPort(ID::B);
-		RTLIL::SigSpec sig_s = cell->getPort(ID(S));
-		RTLIL::SigSpec sig_y = cell->getPort(ID::Y);
-
-		assign_map.apply(sig_a);
-		assign_map.apply(sig_b);
-		assign_map.apply(sig_s);
-		assign_map.apply(sig_y);
-
-		int mapped_a = map_signal(sig_a);
-		int mapped_b = map_signal(sig_b);
-		int mapped_s = map_signal(sig_s);
-
-		map_signal(sig_y, cell->type == ID($_MUX_) ? G(MUX) : G(NMUX), mapped_a, mapped_b, mapped_s);
-
-		module->remove(cell);
-		return;
-	}
-
-	if (cell->type.in(ID($_AOI3_), ID($_OAI3_)))
-	{
-		RTLIL::SigSpec sig_a = cell->getPort(ID::A);
-		RTLIL::SigSpec sig_b = cell->getPort(ID::B);
-		RTLIL::SigSpec sig_c = cell->getPort(ID(C));
-		RTLIL::SigSpec sig_y = cell->getPort(ID::Y);
-
-		assign_map.apply(sig_a);
-		assign_map.apply(sig_b);
-		assign_map.apply(sig_c);
-		assign_map.apply(sig_y);
-
-		int mapped_a = map_signal(sig_a);
-		int mapped_b = map_signal(sig_b);
-		int mapped_c = map_signal(sig_c);
-
-		map_signal(sig_y, cell->type == ID($_AOI3_) ? G(AOI3) : G(OAI3), mapped_a, mapped_b, mapped_c);
-
-		module->remove(cell);
-		return;
-	}
-
-	if (cell->type.in(ID($_AOI4_), ID($_OAI4_)))
-	{
-		RTLIL::SigSpec sig_a = cell->getPort(ID::A);
-		RTLIL::SigSpec sig_b = cell->getPort(ID::B);
-		RTLIL::SigSpec sig_c = cell->getPort(ID(C));
-		RTLIL::SigSpec sig_d = cell->getPort(ID(D));
-		RTLIL::SigSpec sig_y = cell->getPort(ID::Y);
-
-		assign_map.apply(sig_a);
-		assign_map.apply(sig_b);
-		assign_map.apply(sig_c);
-		assign_map.apply(sig_d);
-		assign_map.apply(sig_y);
-
-		int mapped_a = map_signal(sig_a);
-		int mapped_b = map_signal(sig_b);
-		int mapped_c = map_signal(sig_c);
-		int mapped_d = map_signal(sig_d);
-
-		map_signal(sig_y, cell->type == ID($_AOI4_) ? G(AOI4) : G(OAI4), mapped_a, mapped_b, mapped_c, mapped_d);
-
-		module->remove(cell);
-		return;
-	}
-}
-
-std::string remap_name(RTLIL::IdString abc_name, RTLIL::Wire **orig_wire = nullptr)
-{
-	std::string abc_sname = abc_name.substr(1);
-	bool isnew = false;
-	if (abc_sname.compare(0, 4, "new_") == 0)
-	{
-		abc_sname.erase(0, 4);
-		isnew = true;
-	}
-	if (abc_sname.compare(0, 5, "ys__n") == 0)
-	{
-		abc_sname.erase(0, 5);
-		if (std::isdigit(abc_sname.at(0)))
-		{
-			int sid = std::atoi(abc_sname.c_str());
-			size_t postfix_start = abc_sname.find_first_not_of("0123456789");
-			std::string postfix = postfix_start != std::string::npos ? abc_sname.substr(postfix_start) : "";
-
-			if (sid < GetSize(signal_list))
-			{
-				auto sig = signal_list.at(sid);
-				if (sig.bit.wire != nullptr)
-				{
-					std::string s = stringf("$abc$%d$%s", map_autoidx, sig.bit.wire->name.c_str()+1);
-					if (sig.bit.wire->width != 1)
-						s += stringf("[%d]", sig.bit.offset);
-					if (isnew)
-						s += "_new";
-					s += postfix;
-					if (orig_wire != nullptr)
-						*orig_wire = sig.bit.wire;
-					return s;
-				}
-			}
-		}
-	}
-	return stringf("$abc$%d$%s", map_autoidx, abc_name.c_str()+1);
-}
-
-void dump_loop_graph(FILE *f, int &nr, std::map<int, std::set<int>> &edges, std::set<int> &workpool, std::vector<int> &in_counts)
-{
-	if (f == NULL)
-		return;
-
-	log("Dumping loop state graph to slide %d.\n", ++nr);
-
-	fprintf(f, "digraph \"slide%d\" {\n", nr);
-	fprintf(f, "  label=\"slide%d\";\n", nr);
-	fprintf(f, "  rankdir=\"TD\";\n");
-
-	std::set<int> nodes;
-	for (auto &e : edges) {
-		nodes.insert(e.first);
-		for (auto n : e.second)
-			nodes.insert(n);
-	}
-
-	for (auto n : nodes)
-		fprintf(f, "  ys__n%d [label=\"%s\\nid=%d, count=%d\"%s];\n", n, log_signal(signal_list[n].bit),
-				n, in_counts[n], workpool.count(n) ? ", shape=box" : "");
-
-	for (auto &e : edges)
-	for (auto n : e.second)
-		fprintf(f, "  ys__n%d -> ys__n%d;\n", e.first, n);
-
-	fprintf(f, "}\n");
-}
-
-void handle_loops()
-{
-	// http://en.wikipedia.org/wiki/Topological_sorting
-	// (Kahn, Arthur B. (1962), "Topological sorting of large networks")
-
-	std::map<int, std::set<int>> edges;
-	std::vector<int> in_edges_count(signal_list.size());
-	std::set<int> workpool;
-
-	FILE *dot_f = NULL;
-	int dot_nr = 0;
-
-	// uncomment for troubleshooting the loop detection code
-	// dot_f = fopen("test.dot", "w");
-
-	for (auto &g : signal_list) {
-		if (g.type == G(NONE) || g.type == G(FF)) {
-			workpool.insert(g.id);
-		} else {
-			if (g.in1 >= 0) {
-				edges[g.in1].insert(g.id);
-				in_edges_count[g.id]++;
-			}
-			if (g.in2 >= 0 && g.in2 != g.in1) {
-				edges[g.in2].insert(g.id);
-				in_edges_count[g.id]++;
-			}
-			if (g.in3 >= 0 && g.in3 != g.in2 && g.in3 != g.in1) {
-				edges[g.in3].insert(g.id);
-				in_edges_count[g.id]++;
-			}
-			if (g.in4 >= 0 && g.in4 != g.in3 && g.in4 != g.in2 && g.in4 != g.in1) {
-				edges[g.in4].insert(g.id);
-				in_edges_count[g.id]++;
-			}
-		}
-	}
-
-	dump_loop_graph(dot_f, dot_nr, edges, workpool, in_edges_count);
-
-	while (workpool.size() > 0)
-	{
-		int id = *workpool.begin();
-		workpool.erase(id);
-
-		// log("Removing non-loop node %d from graph: %s\n", id, log_signal(signal_list[id].bit));
-
-		for (int id2 : edges[id]) {
-			log_assert(in_edges_count[id2] > 0);
-			if (--in_edges_count[id2] == 0)
-				workpool.insert(id2);
-		}
-		edges.erase(id);
-
-		dump_loop_graph(dot_f, dot_nr, edges, workpool, in_edges_count);
-
-		while (workpool.size() == 0)
-		{
-			if (edges.size() == 0)
-				break;
-
-			int id1 = edges.begin()->first;
-
-			for (auto &edge_it : edges) {
-				int id2 = edge_it.first;
-				RTLIL::Wire *w1 = signal_list[id1].bit.wire;
-				RTLIL::Wire *w2 = signal_list[id2].bit.wire;
-				if (w1 == NULL)
-					id1 = id2;
-				else if (w2 == NULL)
-					continue;
-				else if (w1->name[0] == '$' && w2->name[0] == '\\')
-					id1 = id2;
-				else if (w1->name[0] == '\\' && w2->name[0] == '$')
-					continue;
-				else if (edges[id1].size() < edges[id2].size())
-					id1 = id2;
-				else if (edges[id1].size() > edges[id2].size())
-					continue;
-				else if (w2->name.str() < w1->name.str())
-					id1 = id2;
-			}
-
-			if (edges[id1].size() == 0) {
-				edges.erase(id1);
-				continue;
-			}
-
-			log_assert(signal_list[id1].bit.wire != NULL);
-
-			std::stringstream sstr;
-			sstr << "$abcloop$" << (autoidx++);
-			RTLIL::Wire *wire = module->addWire(sstr.str());
-
-			bool first_line = true;
-			for (int id2 : edges[id1]) {
-				if (first_line)
-					log("Breaking loop using new signal %s: %s -> %s\n", log_signal(RTLIL::SigSpec(wire)),
-							log_signal(signal_list[id1].bit), log_signal(signal_list[id2].bit));
-				else
-					log("                               %*s  %s -> %s\n", int(strlen(log_signal(RTLIL::SigSpec(wire)))), "",
-							log_signal(signal_list[id1].bit), log_signal(signal_list[id2].bit));
-				first_line = false;
-			}
-
-			int id3 = map_signal(RTLIL::SigSpec(wire));
-			signal_list[id1].is_port = true;
-			signal_list[id3].is_port = true;
-			log_assert(id3 == int(in_edges_count.size()));
-			in_edges_count.push_back(0);
-			workpool.insert(id3);
-
-			for (int id2 : edges[id1]) {
-				if (signal_list[id2].in1 == id1)
-					signal_list[id2].in1 = id3;
-				if (signal_list[id2].in2 == id1)
-					signal_list[id2].in2 = id3;
-				if (signal_list[id2].in3 == id1)
-					signal_list[id2].in3 = id3;
-				if (signal_list[id2].in4 == id1)
-					signal_list[id2].in4 = id3;
-			}
-			edges[id1].swap(edges[id3]);
-
-			module->connect(RTLIL::SigSig(signal_list[id3].bit, signal_list[id1].bit));
-			dump_loop_graph(dot_f, dot_nr, edges, workpool, in_edges_count);
-		}
-	}
-
-	if (dot_f != NULL)
-		fclose(dot_f);
-}
+bool cmos_cost;
 
 std::string add_echos_to_abc_cmd(std::string str)
 {
@@ -603,8 +189,10 @@ struct abc_output_filter
 	std::string linebuf;
 	std::string tempdir_name;
 	bool show_tempdir;
+	const dict<int, std::string> &pi_map, &po_map;
 
-	abc_output_filter(std::string tempdir_name, bool show_tempdir) : tempdir_name(tempdir_name), show_tempdir(show_tempdir)
+	abc_output_filter(std::string tempdir_name, bool show_tempdir, const dict<int, std::string> &pi_map, const dict<int, std::string> &po_map) :
+			tempdir_name(tempdir_name), show_tempdir(show_tempdir), pi_map(pi_map), po_map(po_map)
 	{
 		got_cr = false;
 		escape_seq_state = 0;
@@ -655,516 +243,1092 @@ struct abc_output_filter
 	}
 };
 
-void abc_module(RTLIL::Design *design, RTLIL::Module *current_module, std::string script_file, std::string exe_file,
-		std::string liberty_file, std::string constr_file, bool cleanup, vector<int> lut_costs, bool dff_mode, std::string clk_str,
-		bool keepff, std::string delay_target, std::string sop_inputs, std::string sop_products, std::string lutin_shared, bool fast_mode,
-		const std::vector<RTLIL::Cell*> &cells, bool show_tempdir, bool sop_mode, bool abc_dress)
+// The state of one ABC run on (a part of) a module. The netlist is extracted
+// into signal_list by extract(), and mapped and re-integrated by finish().
+// Workers do not share any state, except for the SigMap and the init values
+// of the module, which are only used by extract().
+struct AbcWorker
 {
-	module = current_module;
-	map_autoidx = autoidx++;
+	RTLIL::Design *design;
+	RTLIL::Module *module;
+	const SigMap &assign_map;
+	const dict<RTLIL::SigBit, RTLIL::State> &signal_init;
+	int map_autoidx;
+
+	std::vector<gate_t> signal_list;
+	dict<RTLIL::SigBit, int> signal_map;
+	dict<int, std::string> pi_map, po_map;
+	bool recover_init = false;
+
+	bool clk_polarity = true, en_polarity = true;
+	RTLIL::SigSpec clk_sig, en_sig;
+
+	std::string tempdir_name, exe_file, abc_command;
+	bool run_abc = false, builtin_lib = false, cleanup = true, show_tempdir = false, sop_mode = false;
+	FILE *abc_proc = nullptr;
+
+	AbcCoprocess *coproc = nullptr;
+	std::string lib_command, lib_file;
+	bool lib_in_tempdir = false;
+
+	AbcWorker(RTLIL::Design *design, RTLIL::Module *module, const SigMap &assign_map, const dict<RTLIL::SigBit, RTLIL::State> &signal_init) :
+			design(design), module(module), assign_map(assign_map), signal_init(signal_init), map_autoidx(0) { }
+
+	int map_signal(RTLIL::SigBit bit, gate_type_t gate_type = G(NONE), int in1 = -1, int in2 = -1, int in3 = -1, int in4 = -1)
+	{
+		assign_map.apply(bit);
+
+		auto it = signal_map.find(bit);
+		if (it == signal_map.end()) {
+			gate_t gate;
+			gate.id = signal_list.size();
+			gate.type = G(NONE);
+			gate.in1 = -1;
+			gate.in2 = -1;
+			gate.in3 = -1;
+			gate.in4 = -1;
+			gate.is_port = false;
+			gate.bit = bit;
+			if (signal_init.count(bit))
+				gate.init = signal_init.at(bit);
+			else
+				gate.init = State::Sx;
+			signal_list.push_back(gate);
+			it = signal_map.insert(std::make_pair(bit, gate.id)).first;
+		}
+
+		gate_t &gate = signal_list[it->second];
+
+		if (gate_type != G(NONE))
+			gate.type = gate_type;
+		if (in1 >= 0)
+			gate.in1 = in1;
+		if (in2 >= 0)
+			gate.in2 = in2;
+		if (in3 >= 0)
+			gate.in3 = in3;
+		if (in4 >= 0)
+			gate.in4 = in4;
+
+		return gate.id;
+	}
+
+	void mark_port(RTLIL::SigSpec sig)
+	{
+		for (auto &bit : assign_map(sig)) {
+			if (bit.wire == NULL)
+				continue;
+			auto it = signal_map.find(bit);
+			if (it != signal_map.end())
+				signal_list[it->second].is_port = true;
+		}
+	}
+
+	void extract_cell(RTLIL::Cell *cell, bool keepff)
+	{
+		if (cell->type.in(ID($_DFF_N_), ID($_DFF_P_)))
+		{
+			if (clk_polarity != (cell->type == ID($_DFF_P_)))
+				return;
+			if (clk_sig != assign_map(cell->getPort(ID(C))))
+				return;
+			if (GetSize(en_sig) != 0)
+				return;
+			goto matching_dff;
+		}
+
+		if (cell->type.in(ID($_DFFE_NN_), ID($_DFFE_NP_), ID($_DFFE_PN_), ID($_DFFE_PP_)))
+		{
+			if (clk_polarity != cell->type.in(ID($_DFFE_PN_), ID($_DFFE_PP_)))
+				return;
+			if (en_polarity != cell->type.in(ID($_DFFE_NP_), ID($_DFFE_PP_)))
+				return;
+			if (clk_sig != assign_map(cell->getPort(ID(C))))
+				return;
+			if (en_sig != assign_map(cell->getPort(ID(E))))
+				return;
+			goto matching_dff;
+		}
+
+		if (0) {
+		matching_dff:
+			RTLIL::SigSpec sig_d = cell->getPort(ID(D));
+			RTLIL::SigSpec sig_q = cell->getPort(ID(Q));
+
+			if (keepff)
+				for (auto &c : sig_q.chunks())
+					if (c.wire != NULL)
+						c.wire->attributes[ID::keep] = 1;
+
+			assign_map.apply(sig_d);
+			assign_map.apply(sig_q);
+
+			map_signal(sig_q, G(FF), map_signal(sig_d));
+
+			module->remove(cell);
+			return;
+		}
+
+		if (cell->type.in(ID($_BUF_), ID($_NOT_)))
+		{
+			RTLIL::SigSpec sig_a = cell->getPort(ID::A);
+			RTLIL::SigSpec sig_y = cell->getPort(ID::Y);
+
+			assign_map.apply(sig_a);
+			assign_map.apply(sig_y);
+
+			map_signal(sig_y, cell->type == ID($_BUF_) ? G(BUF) : G(NOT), map_signal(sig_a));
+
+			module->remove(cell);
+			return;
+		}
+
+		if (cell->type.in(ID($_AND_), ID($_NAND_), ID($_OR_), ID($_NOR_), ID($_XOR_), ID($_XNOR_), ID($_ANDNOT_), ID($_ORNOT_)))
+		{
+			RTLIL::SigSpec sig_a = cell->getPort(ID::A);
+			RTLIL::SigSpec sig_b = cell->getPort(ID::B);
+			RTLIL::SigSpec sig_y = cell->getPort(ID::Y);
+
+			assign_map.apply(sig_a);
+			assign_map.apply(sig_b);
+			assign_map.apply(sig_y);
+
+			int mapped_a = map_signal(sig_a);
+			int mapped_b = map_signal(sig_b);
+
+			if (cell->type == ID($_AND_))
+				map_signal(sig_y, G(AND), mapped_a, mapped_b);
+			else if (cell->type == ID($_NAND_))
+				map_signal(sig_y, G(NAND), mapped_a, mapped_b);
+			else if (cell->type == ID($_OR_))
+				map_signal(sig_y, G(OR), mapped_a, mapped_b);
+			else if (cell->type == ID($_NOR_))
+				map_signal(sig_y, G(NOR), mapped_a, mapped_b);
+			else if (cell->type == ID($_XOR_))
+				map_signal(sig_y, G(XOR), mapped_a, mapped_b);
+			else if (cell->type == ID($_XNOR_))
+				map_signal(sig_y, G(XNOR), mapped_a, mapped_b);
+			else if (cell->type == ID($_ANDNOT_))
+				map_signal(sig_y, G(ANDNOT), mapped_a, mapped_b);
+			else if (cell->type == ID($_ORNOT_))
+				map_signal(sig_y, G(ORNOT), mapped_a, mapped_b);
+			else
+				log_abort();
+
+			module->remove(cell);
+			return;
+		}
+
+		if (cell->type.in(ID($_MUX_), ID($_NMUX_)))
+		{
+			RTLIL::SigSpec sig_a = cell->getPort(ID::A);
+			RTLIL::SigSpec sig_b = cell->getPort(ID::B);
+			RTLIL::SigSpec sig_s = cell->getPort(ID(S));
+			RTLIL::SigSpec sig_y = cell->getPort(ID::Y);
+
+			assign_map.apply(sig_a);
+			assign_map.apply(sig_b);
+			assign_map.apply(sig_s);
+			assign_map.apply(sig_y);
+
+			int mapped_a = map_signal(sig_a);
+			int mapped_b = map_signal(sig_b);
+			int mapped_s = map_signal(sig_s);
+
+			map_signal(sig_y, cell->type == ID($_MUX_) ? G(MUX) : G(NMUX), mapped_a, mapped_b, mapped_s);
+
+			module->remove(cell);
+			return;
+		}
+
+		if (cell->type.in(ID($_AOI3_), ID($_OAI3_)))
+		{
+			RTLIL::SigSpec sig_a = cell->getPort(ID::A);
+			RTLIL::SigSpec sig_b = cell->getPort(ID::B);
+			RTLIL::SigSpec sig_c = cell->getPort(ID(C));
+			RTLIL::SigSpec sig_y = cell->getPort(ID::Y);
+
+			assign_map.apply(sig_a);
+			assign_map.apply(sig_b);
+			assign_map.apply(sig_c);
+			assign_map.apply(sig_y);
+
+			int mapped_a = map_signal(sig_a);
+			int mapped_b = map_signal(sig_b);
+			int mapped_c = map_signal(sig_c);
+
+			map_signal(sig_y, cell->type == ID($_AOI3_) ? G(AOI3) : G(OAI3), mapped_a, mapped_b, mapped_c);
+
+			module->remove(cell);
+			return;
+		}
+
+		if (cell->type.in(ID($_AOI4_), ID($_OAI4_)))
+		{
+			RTLIL::SigSpec sig_a = cell->getPort(ID::A);
+			RTLIL::SigSpec sig_b = cell->getPort(ID::B);
+			RTLIL::SigSpec sig_c = cell->getPort(ID(C));
+			RTLIL::SigSpec sig_d = cell->getPort(ID(D));
+			RTLIL::SigSpec sig_y = cell->getPort(ID::Y);
+
+			assign_map.apply(sig_a);
+			assign_map.apply(sig_b);
+			assign_map.apply(sig_c);
+			assign_map.apply(sig_d);
+			assign_map.apply(sig_y);
+
+			int mapped_a = map_signal(sig_a);
+			int mapped_b = map_signal(sig_b);
+			int mapped_c = map_signal(sig_c);
+			int mapped_d = map_signal(sig_d);
+
+			map_signal(sig_y, cell->type == ID($_AOI4_) ? G(AOI4) : G(OAI4), mapped_a, mapped_b, mapped_c, mapped_d);
+
+			module->remove(cell);
+			return;
+		}
+	}
 
-	signal_map.clear();
-	signal_list.clear();
-	pi_map.clear();
-	po_map.clear();
-	recover_init = false;
+	std::string remap_name(RTLIL::IdString abc_name, RTLIL::Wire **orig_wire = nullptr)
+	{
+		std::string abc_sname = abc_name.substr(1);
+		bool isnew = false;
+		if (abc_sname.compare(0, 4, "new_") == 0)
+		{
+			abc_sname.erase(0, 4);
+			isnew = true;
+		}
+		if (abc_sname.compare(0, 5, "ys__n") == 0)
+		{
+			abc_sname.erase(0, 5);
+			if (std::isdigit(abc_sname.at(0)))
+			{
+				int sid = std::atoi(abc_sname.c_str());
+				size_t postfix_start = abc_sname.find_first_not_of("0123456789");
+				std::string postfix = postfix_start != std::string::npos ? abc_sname.substr(postfix_start) : "";
 
-	if (clk_str != "$")
+				if (sid < GetSize(signal_list))
+				{
+					auto sig = signal_list.at(sid);
+					if (sig.bit.wire != nullptr)
+					{
+						std::string s = stringf("$abc$%d$%s", map_autoidx, sig.bit.wire->name.c_str()+1);
+						if (sig.bit.wire->width != 1)
+							s += stringf("[%d]", sig.bit.offset);
+						if (isnew)
+							s += "_new";
+						s += postfix;
+						if (orig_wire != nullptr)
+							*orig_wire = sig.bit.wire;
+						return s;
+					}
+				}
+			}
+		}
+		return stringf("$abc$%d$%s", map_autoidx, abc_name.c_str()+1);
+	}
+
+	void dump_loop_graph(FILE *f, int &nr, const std::vector<std::vector<int>> &edges, const std::vector<bool> &has_edges, const std::vector<int> &in_counts)
 	{
-		clk_polarity = true;
-		clk_sig = RTLIL::SigSpec();
+		if (f == NULL)
+			return;
+
+		log("Dumping loop state graph to slide %d.\n", ++nr);
 
-		en_polarity = true;
-		en_sig = RTLIL::SigSpec();
+		fprintf(f, "digraph \"slide%d\" {\n", nr);
+		fprintf(f, "  label=\"slide%d\";\n", nr);
+		fprintf(f, "  rankdir=\"TD\";\n");
+
+		std::set<int> nodes;
+		for (int id = 0; id < GetSize(edges); id++) {
+			if (!has_edges[id])
+				continue;
+			nodes.insert(id);
+			for (auto n : edges[id])
+				nodes.insert(n);
+		}
+
+		// nodes without remaining inputs are drawn as boxes
+		for (auto n : nodes)
+			fprintf(f, "  ys__n%d [label=\"%s\\nid=%d, count=%d\"%s];\n", n, log_signal(signal_list[n].bit),
+					n, in_counts[n], in_counts[n] == 0 ? ", shape=box" : "");
+
+		for (int id = 0; id < GetSize(edges); id++)
+			if (has_edges[id])
+				for (auto n : edges[id])
+					fprintf(f, "  ys__n%d -> ys__n%d;\n", id, n);
+
+		fprintf(f, "}\n");
 	}
 
-	if (!clk_str.empty() && clk_str != "$")
+	void handle_loops()
 	{
-		if (clk_str.find(',') != std::string::npos) {
-			int pos = clk_str.find(',');
-			std::string en_str = clk_str.substr(pos+1);
-			clk_str = clk_str.substr(0, pos);
-			if (en_str[0] == '!') {
-				en_polarity = false;
-				en_str = en_str.substr(1);
+		// http://en.wikipedia.org/wiki/Topological_sorting
+		// (Kahn, Arthur B. (1962), "Topological sorting of large networks")
+
+		// edges[id] are the gates driven by signal id in ascending order, and
+		// has_edges[id] is cleared when the signal is removed from the graph
+		std::vector<std::vector<int>> edges(signal_list.size());
+		std::vector<bool> has_edges(signal_list.size());
+		std::vector<int> in_edges_count(signal_list.size());
+		std::priority_queue<int, std::vector<int>, std::greater<int>> workpool;
+		int num_has_edges = 0;
+
+		FILE *dot_f = NULL;
+		int dot_nr = 0;
+
+		// uncomment for troubleshooting the loop detection code
+		// dot_f = fopen("test.dot", "w");
+
+		auto add_edge = [&](int from, int to) {
+			if (!has_edges[from])
+				has_edges[from] = true, num_has_edges++;
+			edges[from].push_back(to);
+			in_edges_count[to]++;
+		};
+
+		auto remove_edges = [&](int id) {
+			if (has_edges[id])
+				has_edges[id] = false, num_has_edges--;
+			edges[id].clear();
+		};
+
+		for (auto &g : signal_list) {
+			if (g.type == G(NONE) || g.type == G(FF)) {
+				workpool.push(g.id);
+			} else {
+				if (g.in1 >= 0)
+					add_edge(g.in1, g.id);
+				if (g.in2 >= 0 && g.in2 != g.in1)
+					add_edge(g.in2, g.id);
+				if (g.in3 >= 0 && g.in3 != g.in2 && g.in3 != g.in1)
+					add_edge(g.in3, g.id);
+				if (g.in4 >= 0 && g.in4 != g.in3 && g.in4 != g.in2 && g.in4 != g.in1)
+					add_edge(g.in4, g.id);
+			}
+		}
+
+		dump_loop_graph(dot_f, dot_nr, edges, has_edges, in_edges_count);
+
+		while (!workpool.empty())
+		{
+			int id = workpool.top();
+			workpool.pop();
+
+			// log("Removing non-loop node %d from graph: %s\n", id, log_signal(signal_list[id].bit));
+
+			for (int id2 : edges[id]) {
+				log_assert(in_edges_count[id2] > 0);
+				if (--in_edges_count[id2] == 0)
+					workpool.push(id2);
+			}
+			remove_edges(id);
+
+			dump_loop_graph(dot_f, dot_nr, edges, has_edges, in_edges_count);
+
+			while (workpool.empty())
+			{
+				if (num_has_edges == 0)
+					break;
+
+				int id1 = 0;
+				while (!has_edges[id1])
+					id1++;
+
+				for (int id2 = id1+1; id2 < GetSize(edges); id2++) {
+					if (!has_edges[id2])
+						continue;
+					RTLIL::Wire *w1 = signal_list[id1].bit.wire;
+					RTLIL::Wire *w2 = signal_list[id2].bit.wire;
+					if (w1 == NULL)
+						id1 = id2;
+					else if (w2 == NULL)
+						continue;
+					else if (w1->name[0] == '$' && w2->name[0] == '\\')
+						id1 = id2;
+					else if (w1->name[0] == '\\' && w2->name[0] == '$')
+						continue;
+					else if (edges[id1].size() < edges[id2].size())
+						id1 = id2;
+					else if (edges[id1].size() > edges[id2].size())
+						continue;
+					else if (w2->name.str() < w1->name.str())
+						id1 = id2;
+				}
+
+				if (edges[id1].size() == 0) {
+					remove_edges(id1);
+					continue;
+				}
+
+				log_assert(signal_list[id1].bit.wire != NULL);
+
+				std::stringstream sstr;
+				sstr << "$abcloop$" << (autoidx++);
+				RTLIL::Wire *wire = module->addWire(sstr.str());
+
+				bool first_line = true;
+				for (int id2 : edges[id1]) {
+					if (first_line)
+						log("Breaking loop using new signal %s: %s -> %s\n", log_signal(RTLIL::SigSpec(wire)),
+								log_signal(signal_list[id1].bit), log_signal(signal_list[id2].bit));
+					else
+						log("                               %*s  %s -> %s\n", int(strlen(log_signal(RTLIL::SigSpec(wire)))), "",
+								log_signal(signal_list[id1].bit), log_signal(signal_list[id2].bit));
+					first_line = false;
+				}
+
+				int id3 = map_signal(RTLIL::SigSpec(wire));
+				signal_list[id1].is_port = true;
+				signal_list[id3].is_port = true;
+				log_assert(id3 == int(in_edges_count.size()));
+				in_edges_count.push_back(0);
+				edges.emplace_back();
+				has_edges.push_back(false);
+				workpool.push(id3);
+
+				for (int id2 : edges[id1]) {
+					if (signal_list[id2].in1 == id1)
+						signal_list[id2].in1 = id3;
+					if (signal_list[id2].in2 == id1)
+						signal_list[id2].in2 = id3;
+					if (signal_list[id2].in3 == id1)
+						signal_list[id2].in3 = id3;
+					if (signal_list[id2].in4 == id1)
+						signal_list[id2].in4 = id3;
+				}
+				edges[id1].swap(edges[id3]);
+				has_edges[id3] = true, num_has_edges++;
+
+				module->connect(RTLIL::SigSig(signal_list[id3].bit, signal_list[id1].bit));
+				dump_loop_graph(dot_f, dot_nr, edges, has_edges, in_edges_count);
+			}
+		}
+
+		if (dot_f != NULL)
+			fclose(dot_f);
+	}
+
+	void extract(std::string script_file, std::string exe_file, std::string liberty_file, std::string constr_file, bool cleanup,
+			vector<int> lut_costs, bool dff_mode, std::string clk_str, bool keepff, std::string delay_target, std::string sop_inputs,
+			std::string sop_products, std::string lutin_shared, bool fast_mode, const std::vector<RTLIL::Cell*> &cells, bool show_tempdir,
+			bool sop_mode, bool abc_dress, std::vector<RTLIL::SigSpec> *pending_ports = nullptr)
+	{
+		YS_PROFILE_SCOPE("abc.extract");
+
+		map_autoidx = autoidx++;
+
+		if (clk_str != "$")
+		{
+			clk_polarity = true;
+			clk_sig = RTLIL::SigSpec();
+
+			en_polarity = true;
+			en_sig = RTLIL::SigSpec();
+		}
+
+		if (!clk_str.empty() && clk_str != "$")
+		{
+			if (clk_str.find(',') != std::string::npos) {
+				int pos = clk_str.find(',');
+				std::string en_str = clk_str.substr(pos+1);
+				clk_str = clk_str.substr(0, pos);
+				if (en_str[0] == '!') {
+					en_polarity = false;
+					en_str = en_str.substr(1);
+				}
+				if (module->wires_.count(RTLIL::escape_id(en_str)) != 0)
+					en_sig = assign_map(RTLIL::SigSpec(module->wires_.at(RTLIL::escape_id(en_str)), 0));
 			}
-			if (module->wires_.count(RTLIL::escape_id(en_str)) != 0)
-				en_sig = assign_map(RTLIL::SigSpec(module->wires_.at(RTLIL::escape_id(en_str)), 0));
-		}
-		if (clk_str[0] == '!') {
-			clk_polarity = false;
-			clk_str = clk_str.substr(1);
+			if (clk_str[0] == '!') {
+				clk_polarity = false;
+				clk_str = clk_str.substr(1);
+			}
+			if (module->wires_.count(RTLIL::escape_id(clk_str)) != 0)
+				clk_sig = assign_map(RTLIL::SigSpec(module->wires_.at(RTLIL::escape_id(clk_str)), 0));
 		}
-		if (module->wires_.count(RTLIL::escape_id(clk_str)) != 0)
-			clk_sig = assign_map(RTLIL::SigSpec(module->wires_.at(RTLIL::escape_id(clk_str)), 0));
-	}
 
-	if (dff_mode && clk_sig.empty())
-		log_cmd_error("Clock domain %s not found.\n", clk_str.c_str());
+		if (dff_mode && clk_sig.empty())
+			log_cmd_error("Clock domain %s not found.\n", clk_str.c_str());
 
-	std::string tempdir_name = "/tmp/yosys-abc-XXXXXX";
-	if (!cleanup)
-		tempdir_name[0] = tempdir_name[4] = '_';
-	tempdir_name = make_temp_dir(tempdir_name);
-	log_header(design, "Extracting gate netlist of module `%s' to `%s/input.blif'..\n",
-			module->name.c_str(), replace_tempdir(tempdir_name, tempdir_name, show_tempdir).c_str());
+		tempdir_name = "/tmp/yosys-abc-XXXXXX";
+		if (!cleanup)
+			tempdir_name[0] = tempdir_name[4] = '_';
+		tempdir_name = make_temp_dir(tempdir_name);
+		log_header(design, "Extracting gate netlist of module `%s' to `%s/input.blif'..\n",
+				module->name.c_str(), replace_tempdir(tempdir_name, tempdir_name, show_tempdir).c_str());
 
-	std::string abc_script = stringf("read_blif %s/input.blif; ", tempdir_name.c_str());
+		std::string abc_script = stringf("read_blif %s/input.blif; ", tempdir_name.c_str());
 
-	if (!liberty_file.empty()) {
-		abc_script += stringf("read_lib -w %s; ", liberty_file.c_str());
-		if (!constr_file.empty())
-			abc_script += stringf("read_constr -v %s; ", constr_file.c_str());
-	} else
-	if (!lut_costs.empty())
-		abc_script += stringf("read_lut %s/lutdefs.txt; ", tempdir_name.c_str());
-	else
-		abc_script += stringf("read_library %s/stdcells.genlib; ", tempdir_name.c_str());
-
-	if (!script_file.empty()) {
-		if (script_file[0] == '+') {
-			for (size_t i = 1; i < script_file.size(); i++)
-				if (script_file[i] == '\'')
-					abc_script += "'\\''";
-				else if (script_file[i] == ',')
-					abc_script += " ";
-				else
-					abc_script += script_file[i];
+		lib_in_tempdir = true;
+		if (!liberty_file.empty()) {
+			lib_file = liberty_file;
+			lib_command = stringf("read_lib -w %s", lib_file.c_str());
+			lib_in_tempdir = false;
 		} else
-			abc_script += stringf("source %s", script_file.c_str());
-	} else if (!lut_costs.empty()) {
-		bool all_luts_cost_same = true;
-		for (int this_cost : lut_costs)
-			if (this_cost != lut_costs.front())
-				all_luts_cost_same = false;
-		abc_script += fast_mode ? ABC_FAST_COMMAND_LUT : ABC_COMMAND_LUT;
-		if (all_luts_cost_same && !fast_mode)
-			abc_script += "; lutpack {S}";
-	} else if (!liberty_file.empty())
-		abc_script += constr_file.empty() ? (fast_mode ? ABC_FAST_COMMAND_LIB : ABC_COMMAND_LIB) : (fast_mode ? ABC_FAST_COMMAND_CTR : ABC_COMMAND_CTR);
-	else if (sop_mode)
-		abc_script += fast_mode ? ABC_FAST_COMMAND_SOP : ABC_COMMAND_SOP;
-	else
-		abc_script += fast_mode ? ABC_FAST_COMMAND_DFL : ABC_COMMAND_DFL;
-
-	if (script_file.empty() && !delay_target.empty())
-		for (size_t pos = abc_script.find("dretime;"); pos != std::string::npos; pos = abc_script.find("dretime;", pos+1))
-			abc_script = abc_script.substr(0, pos) + "dretime; retime -o {D};" + abc_script.substr(pos+8);
-
-	for (size_t pos = abc_script.find("{D}"); pos != std::string::npos; pos = abc_script.find("{D}", pos))
-		abc_script = abc_script.substr(0, pos) + delay_target + abc_script.substr(pos+3);
-
-	for (size_t pos = abc_script.find("{I}"); pos != std::string::npos; pos = abc_script.find("{D}", pos))
-		abc_script = abc_script.substr(0, pos) + sop_inputs + abc_script.substr(pos+3);
-
-	for (size_t pos = abc_script.find("{P}"); pos != std::string::npos; pos = abc_script.find("{D}", pos))
-		abc_script = abc_script.substr(0, pos) + sop_products + abc_script.substr(pos+3);
-
-	for (size_t pos = abc_script.find("{S}"); pos != std::string::npos; pos = abc_script.find("{S}", pos))
-		abc_script = abc_script.substr(0, pos) + lutin_shared + abc_script.substr(pos+3);
-	if (abc_dress)
-		abc_script += "; dress";
-	abc_script += stringf("; write_blif %s/output.blif", tempdir_name.c_str());
-	abc_script = add_echos_to_abc_cmd(abc_script);
-
-	for (size_t i = 0; i+1 < abc_script.size(); i++)
-		if (abc_script[i] == ';' && abc_script[i+1] == ' ')
-			abc_script[i+1] = '\n';
-
-	FILE *f = fopen(stringf("%s/abc.script", tempdir_name.c_str()).c_str(), "wt");
-	fprintf(f, "%s\n", abc_script.c_str());
-	fclose(f);
-
-	if (dff_mode || !clk_str.empty())
-	{
-		if (clk_sig.size() == 0)
-			log("No%s clock domain found. Not extracting any FF cells.\n", clk_str.empty() ? "" : " matching");
-		else {
-			log("Found%s %s clock domain: %s", clk_str.empty() ? "" : " matching", clk_polarity ? "posedge" : "negedge", log_signal(clk_sig));
-			if (en_sig.size() != 0)
-				log(", enabled by %s%s", en_polarity ? "" : "!", log_signal(en_sig));
-			log("\n");
+		if (!lut_costs.empty()) {
+			lib_file = stringf("%s/lutdefs.txt", tempdir_name.c_str());
+			lib_command = stringf("read_lut %s", lib_file.c_str());
+		} else {
+			lib_file = stringf("%s/stdcells.genlib", tempdir_name.c_str());
+			lib_command = stringf("read_library %s", lib_file.c_str());
 		}
-	}
 
-	for (auto c : cells)
-		extract_cell(c, keepff);
+		// the co-process reads the library only when it changed
+		coproc = nullptr;
+#ifndef YOSYS_LINK_ABC
+		if (coproc_mode)
+			coproc = AbcCoprocess::get(exe_file);
+#endif
+		if (coproc == nullptr)
+			abc_script += lib_command + "; ";
+		if (!liberty_file.empty() && !constr_file.empty())
+			abc_script += stringf("read_constr -v %s; ", constr_file.c_str());
 
-	for (auto &wire_it : module->wires_) {
-		if (wire_it.second->port_id > 0 || wire_it.second->get_bool_attribute(ID::keep))
-			mark_port(RTLIL::SigSpec(wire_it.second));
-	}
+		if (!script_file.empty()) {
+			if (script_file[0] == '+') {
+				for (size_t i = 1; i < script_file.size(); i++)
+					if (script_file[i] == '\'')
+						abc_script += "'\\''";
+					else if (script_file[i] == ',')
+						abc_script += " ";
+					else
+						abc_script += script_file[i];
+			} else
+				abc_script += stringf("source %s", script_file.c_str());
+		} else if (!lut_costs.empty()) {
+			bool all_luts_cost_same = true;
+			for (int this_cost : lut_costs)
+				if (this_cost != lut_costs.front())
+					all_luts_cost_same = false;
+			abc_script += fast_mode ? ABC_FAST_COMMAND_LUT : ABC_COMMAND_LUT;
+			if (all_luts_cost_same && !fast_mode)
+				abc_script += "; lutpack {S}";
+		} else if (!liberty_file.empty())
+			abc_script += constr_file.empty() ? (fast_mode ? ABC_FAST_COMMAND_LIB : ABC_COMMAND_LIB) : (fast_mode ? ABC_FAST_COMMAND_CTR : ABC_COMMAND_CTR);
+		else if (sop_mode)
+			abc_script += fast_mode ? ABC_FAST_COMMAND_SOP : ABC_COMMAND_SOP;
+		else
+			abc_script += fast_mode ? ABC_FAST_COMMAND_DFL : ABC_COMMAND_DFL;
 
-	for (auto &cell_it : module->cells_)
-	for (auto &port_it : cell_it.second->connections())
-		mark_port(port_it.second);
+		if (script_file.empty() && !delay_target.empty())
+			for (size_t pos = abc_script.find("dretime;"); pos != std::string::npos; pos = abc_script.find("dretime;", pos+1))
+				abc_script = abc_script.substr(0, pos) + "dretime; retime -o {D};" + abc_script.substr(pos+8);
 
-	if (clk_sig.size() != 0)
-		mark_port(clk_sig);
+		for (size_t pos = abc_script.find("{D}"); pos != std::string::npos; pos = abc_script.find("{D}", pos))
+			abc_script = abc_script.substr(0, pos) + delay_target + abc_script.substr(pos+3);
 
-	if (en_sig.size() != 0)
-		mark_port(en_sig);
+		for (size_t pos = abc_script.find("{I}"); pos != std::string::npos; pos = abc_script.find("{D}", pos))
+			abc_script = abc_script.substr(0, pos) + sop_inputs + abc_script.substr(pos+3);
 
-	handle_loops();
+		for (size_t pos = abc_script.find("{P}"); pos != std::string::npos; pos = abc_script.find("{D}", pos))
+			abc_script = abc_script.substr(0, pos) + sop_products + abc_script.substr(pos+3);
 
-	std::string buffer = stringf("%s/input.blif", tempdir_name.c_str());
-	f = fopen(buffer.c_str(), "wt");
-	if (f == NULL)
-		log_error("Opening %s for writing failed: %s\n", buffer.c_str(), strerror(errno));
+		for (size_t pos = abc_script.find("{S}"); pos != std::string::npos; pos = abc_script.find("{S}", pos))
+			abc_script = abc_script.substr(0, pos) + lutin_shared + abc_script.substr(pos+3);
+		if (abc_dress)
+			abc_script += "; dress";
+		abc_script += stringf("; write_blif %s/output.blif", tempdir_name.c_str());
+		abc_script = add_echos_to_abc_cmd(abc_script);
 
-	fprintf(f, ".model netlist\n");
+		for (size_t i = 0; i+1 < abc_script.size(); i++)
+			if (abc_script[i] == ';' && abc_script[i+1] == ' ')
+				abc_script[i+1] = '\n';
 
-	int count_input = 0;
-	fprintf(f, ".inputs");
-	for (auto &si : signal_list) {
-		if (!si.is_port || si.type != G(NONE))
-			continue;
-		fprintf(f, " ys__n%d", si.id);
-		pi_map[count_input++] = log_signal(si.bit);
-	}
-	if (count_input == 0)
-		fprintf(f, " dummy_input\n");
-	fprintf(f, "\n");
-
-	int count_output = 0;
-	fprintf(f, ".outputs");
-	for (auto &si : signal_list) {
-		if (!si.is_port || si.type == G(NONE))
-			continue;
-		fprintf(f, " ys__n%d", si.id);
-		po_map[count_output++] = log_signal(si.bit);
-	}
-	fprintf(f, "\n");
+		FILE *f = fopen(stringf("%s/abc.script", tempdir_name.c_str()).c_str(), "wt");
+		fprintf(f, "%s\n", abc_script.c_str());
+		fclose(f);
+
+		if (dff_mode || !clk_str.empty())
+		{
+			if (clk_sig.size() == 0)
+				log("No%s clock domain found. Not extracting any FF cells.\n", clk_str.empty() ? "" : " matching");
+			else {
+				log("Found%s %s clock domain: %s", clk_str.empty() ? "" : " matching", clk_polarity ? "posedge" : "negedge", log_signal(clk_sig));
+				if (en_sig.size() != 0)
+					log(", enabled by %s%s", en_polarity ? "" : "!", log_signal(en_sig));
+				log("\n");
+			}
+		}
 
-	for (auto &si : signal_list)
-		fprintf(f, "# ys__n%-5d %s\n", si.id, log_signal(si.bit));
+		// cells extracted by jobs that have not been re-integrated yet are no
+		// longer in the module, but their connections still need to be ports
+		if (pending_ports != nullptr)
+			for (auto c : cells)
+			for (auto &conn : c->connections())
+				pending_ports->push_back(conn.second);
 
-	for (auto &si : signal_list) {
-		if (si.bit.wire == NULL) {
-			fprintf(f, ".names ys__n%d\n", si.id);
-			if (si.bit == RTLIL::State::S1)
-				fprintf(f, "1\n");
+		for (auto c : cells)
+			extract_cell(c, keepff);
+
+		for (auto &wire_it : module->wires_) {
+			if (wire_it.second->port_id > 0 || wire_it.second->get_bool_attribute(ID::keep))
+				mark_port(RTLIL::SigSpec(wire_it.second));
 		}
-	}
 
-	int count_gates = 0;
-	for (auto &si : signal_list) {
-		if (si.type == G(BUF)) {
-			fprintf(f, ".names ys__n%d ys__n%d\n", si.in1, si.id);
-			fprintf(f, "1 1\n");
-		} else if (si.type == G(NOT)) {
-			fprintf(f, ".names ys__n%d ys__n%d\n", si.in1, si.id);
-			fprintf(f, "0 1\n");
-		} else if (si.type == G(AND)) {
-			fprintf(f, ".names ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.id);
-			fprintf(f, "11 1\n");
-		} else if (si.type == G(NAND)) {
-			fprintf(f, ".names ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.id);
-			fprintf(f, "0- 1\n");
-			fprintf(f, "-0 1\n");
-		} else if (si.type == G(OR)) {
-			fprintf(f, ".names ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.id);
-			fprintf(f, "-1 1\n");
-			fprintf(f, "1- 1\n");
-		} else if (si.type == G(NOR)) {
-			fprintf(f, ".names ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.id);
-			fprintf(f, "00 1\n");
-		} else if (si.type == G(XOR)) {
-			fprintf(f, ".names ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.id);
-			fprintf(f, "01 1\n");
-			fprintf(f, "10 1\n");
-		} else if (si.type == G(XNOR)) {
-			fprintf(f, ".names ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.id);
-			fprintf(f, "00 1\n");
-			fprintf(f, "11 1\n");
-		} else if (si.type == G(ANDNOT)) {
-			fprintf(f, ".names ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.id);
-			fprintf(f, "10 1\n");
-		} else if (si.type == G(ORNOT)) {
-			fprintf(f, ".names ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.id);
-			fprintf(f, "1- 1\n");
-			fprintf(f, "-0 1\n");
-		} else if (si.type == G(MUX)) {
-			fprintf(f, ".names ys__n%d ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.in3, si.id);
-			fprintf(f, "1-0 1\n");
-			fprintf(f, "-11 1\n");
-		} else if (si.type == G(NMUX)) {
-			fprintf(f, ".names ys__n%d ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.in3, si.id);
-			fprintf(f, "0-0 1\n");
-			fprintf(f, "-01 1\n");
-		} else if (si.type == G(AOI3)) {
-			fprintf(f, ".names ys__n%d ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.in3, si.id);
-			fprintf(f, "-00 1\n");
-			fprintf(f, "0-0 1\n");
-		} else if (si.type == G(OAI3)) {
-			fprintf(f, ".names ys__n%d ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.in3, si.id);
-			fprintf(f, "00- 1\n");
-			fprintf(f, "--0 1\n");
-		} else if (si.type == G(AOI4)) {
-			fprintf(f, ".names ys__n%d ys__n%d ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.in3, si.in4, si.id);
-			fprintf(f, "-0-0 1\n");
-			fprintf(f, "-00- 1\n");
-			fprintf(f, "0--0 1\n");
-			fprintf(f, "0-0- 1\n");
-		} else if (si.type == G(OAI4)) {
-			fprintf(f, ".names ys__n%d ys__n%d ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.in3, si.in4, si.id);
-			fprintf(f, "00-- 1\n");
-			fprintf(f, "--00 1\n");
-		} else if (si.type == G(FF)) {
-			if (si.init == State::S0 || si.init == State::S1) {
-				fprintf(f, ".latch ys__n%d ys__n%d %d\n", si.in1, si.id, si.init == State::S1 ? 1 : 0);
-				recover_init = true;
-			} else
-				fprintf(f, ".latch ys__n%d ys__n%d 2\n", si.in1, si.id);
-		} else if (si.type != G(NONE))
-			log_abort();
-		if (si.type != G(NONE))
-			count_gates++;
-	}
+		for (auto &cell_it : module->cells_)
+		for (auto &port_it : cell_it.second->connections())
+			mark_port(port_it.second);
 
-	fprintf(f, ".end\n");
-	fclose(f);
+		if (clk_sig.size() != 0)
+			mark_port(clk_sig);
 
-	log("Extracted %d gates and %d wires to a netlist network with %d inputs and %d outputs.\n",
-			count_gates, GetSize(signal_list), count_input, count_output);
-	log_push();
-	if (count_output > 0)
-	{
-		log_header(design, "Executing ABC.\n");
+		if (en_sig.size() != 0)
+			mark_port(en_sig);
 
-		auto &cell_cost = cmos_cost ? CellCosts::cmos_gate_cost() : CellCosts::default_gate_cost();
+		if (pending_ports != nullptr)
+			for (auto &sig : *pending_ports)
+				mark_port(sig);
 
-		buffer = stringf("%s/stdcells.genlib", tempdir_name.c_str());
+		handle_loops();
+
+		std::string buffer = stringf("%s/input.blif", tempdir_name.c_str());
 		f = fopen(buffer.c_str(), "wt");
 		if (f == NULL)
 			log_error("Opening %s for writing failed: %s\n", buffer.c_str(), strerror(errno));
-		fprintf(f, "GATE ZERO    1 Y=CONST0;\n");
-		fprintf(f, "GATE ONE     1 Y=CONST1;\n");
-		fprintf(f, "GATE BUF    %d Y=A;                  PIN * NONINV  1 999 1 0 1 0\n", cell_cost.at(ID($_BUF_)));
-		fprintf(f, "GATE NOT    %d Y=!A;                 PIN * INV     1 999 1 0 1 0\n", cell_cost.at(ID($_NOT_)));
-		if (enabled_gates.count("AND"))
-			fprintf(f, "GATE AND    %d Y=A*B;                PIN * NONINV  1 999 1 0 1 0\n", cell_cost.at(ID($_AND_)));
-		if (enabled_gates.count("NAND"))
-			fprintf(f, "GATE NAND   %d Y=!(A*B);             PIN * INV     1 999 1 0 1 0\n", cell_cost.at(ID($_NAND_)));
-		if (enabled_gates.count("OR"))
-			fprintf(f, "GATE OR     %d Y=A+B;                PIN * NONINV  1 999 1 0 1 0\n", cell_cost.at(ID($_OR_)));
-		if (enabled_gates.count("NOR"))
-			fprintf(f, "GATE NOR    %d Y=!(A+B);             PIN * INV     1 999 1 0 1 0\n", cell_cost.at(ID($_NOR_)));
-		if (enabled_gates.count("XOR"))
-			fprintf(f, "GATE XOR    %d Y=(A*!B)+(!A*B);      PIN * UNKNOWN 1 999 1 0 1 0\n", cell_cost.at(ID($_XOR_)));
-		if (enabled_gates.count("XNOR"))
-			fprintf(f, "GATE XNOR   %d Y=(A*B)+(!A*!B);      PIN * UNKNOWN 1 999 1 0 1 0\n", cell_cost.at(ID($_XNOR_)));
-		if (enabled_gates.count("ANDNOT"))
-			fprintf(f, "GATE ANDNOT %d Y=A*!B;               PIN * UNKNOWN 1 999 1 0 1 0\n", cell_cost.at(ID($_ANDNOT_)));
-		if (enabled_gates.count("ORNOT"))
-			fprintf(f, "GATE ORNOT  %d Y=A+!B;               PIN * UNKNOWN 1 999 1 0 1 0\n", cell_cost.at(ID($_ORNOT_)));
-		if (enabled_gates.count("AOI3"))
-			fprintf(f, "GATE AOI3   %d Y=!((A*B)+C);         PIN * INV     1 999 1 0 1 0\n", cell_cost.at(ID($_AOI3_)));
-		if (enabled_gates.count("OAI3"))
-			fprintf(f, "GATE OAI3   %d Y=!((A+B)*C);         PIN * INV     1 999 1 0 1 0\n", cell_cost.at(ID($_OAI3_)));
-		if (enabled_gates.count("AOI4"))
-			fprintf(f, "GATE AOI4   %d Y=!((A*B)+(C*D));     PIN * INV     1 999 1 0 1 0\n", cell_cost.at(ID($_AOI4_)));
-		if (enabled_gates.count("OAI4"))
-			fprintf(f, "GATE OAI4   %d Y=!((A+B)*(C+D));     PIN * INV     1 999 1 0 1 0\n", cell_cost.at(ID($_OAI4_)));
-		if (enabled_gates.count("MUX"))
-			fprintf(f, "GATE MUX    %d Y=(A*B)+(S*B)+(!S*A); PIN * UNKNOWN 1 999 1 0 1 0\n", cell_cost.at(ID($_MUX_)));
-		if (enabled_gates.count("NMUX"))
-			fprintf(f, "GATE NMUX   %d Y=!((A*B)+(S*B)+(!S*A)); PIN * UNKNOWN 1 999 1 0 1 0\n", cell_cost.at(ID($_NMUX_)));
-		if (map_mux4)
-			fprintf(f, "GATE MUX4   %d Y=(!S*!T*A)+(S*!T*B)+(!S*T*C)+(S*T*D); PIN * UNKNOWN 1 999 1 0 1 0\n", 2*cell_cost.at(ID($_MUX_)));
-		if (map_mux8)
-			fprintf(f, "GATE MUX8   %d Y=(!S*!T*!U*A)+(S*!T*!U*B)+(!S*T*!U*C)+(S*T*!U*D)+(!S*!T*U*E)+(S*!T*U*F)+(!S*T*U*G)+(S*T*U*H); PIN * UNKNOWN 1 999 1 0 1 0\n", 4*cell_cost.at(ID($_MUX_)));
-		if (map_mux16)
-			fprintf(f, "GATE MUX16  %d Y=(!S*!T*!U*!V*A)+(S*!T*!U*!V*B)+(!S*T*!U*!V*C)+(S*T*!U*!V*D)+(!S*!T*U*!V*E)+(S*!T*U*!V*F)+(!S*T*U*!V*G)+(S*T*U*!V*H)+(!S*!T*!U*V*I)+(S*!T*!U*V*J)+(!S*T*!U*V*K)+(S*T*!U*V*L)+(!S*!T*U*V*M)+(S*!T*U*V*N)+(!S*T*U*V*O)+(S*T*U*V*P); PIN * UNKNOWN 1 999 1 0 1 0\n", 8*cell_cost.at(ID($_MUX_)));
+
+		fprintf(f, ".model netlist\n");
+
+		int count_input = 0;
+		fprintf(f, ".inputs");
+		for (auto &si : signal_list) {
+			if (!si.is_port || si.type != G(NONE))
+				continue;
+			fprintf(f, " ys__n%d", si.id);
+			pi_map[count_input++] = log_signal(si.bit);
+		}
+		if (count_input == 0)
+			fprintf(f, " dummy_input\n");
+		fprintf(f, "\n");
+
+		int count_output = 0;
+		fprintf(f, ".outputs");
+		for (auto &si : signal_list) {
+			if (!si.is_port || si.type == G(NONE))
+				continue;
+			fprintf(f, " ys__n%d", si.id);
+			po_map[count_output++] = log_signal(si.bit);
+		}
+		fprintf(f, "\n");
+
+		for (auto &si : signal_list)
+			fprintf(f, "# ys__n%-5d %s\n", si.id, log_signal(si.bit));
+
+		for (auto &si : signal_list) {
+			if (si.bit.wire == NULL) {
+				fprintf(f, ".names ys__n%d\n", si.id);
+				if (si.bit == RTLIL::State::S1)
+					fprintf(f, "1\n");
+			}
+		}
+
+		int count_gates = 0;
+		for (auto &si : signal_list) {
+			if (si.type == G(BUF)) {
+				fprintf(f, ".names ys__n%d ys__n%d\n", si.in1, si.id);
+				fprintf(f, "1 1\n");
+			} else if (si.type == G(NOT)) {
+				fprintf(f, ".names ys__n%d ys__n%d\n", si.in1, si.id);
+				fprintf(f, "0 1\n");
+			} else if (si.type == G(AND)) {
+				fprintf(f, ".names ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.id);
+				fprintf(f, "11 1\n");
+			} else if (si.type == G(NAND)) {
+				fprintf(f, ".names ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.id);
+				fprintf(f, "0- 1\n");
+				fprintf(f, "-0 1\n");
+			} else if (si.type == G(OR)) {
+				fprintf(f, ".names ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.id);
+				fprintf(f, "-1 1\n");
+				fprintf(f, "1- 1\n");
+			} else if (si.type == G(NOR)) {
+				fprintf(f, ".names ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.id);
+				fprintf(f, "00 1\n");
+			} else if (si.type == G(XOR)) {
+				fprintf(f, ".names ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.id);
+				fprintf(f, "01 1\n");
+				fprintf(f, "10 1\n");
+			} else if (si.type == G(XNOR)) {
+				fprintf(f, ".names ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.id);
+				fprintf(f, "00 1\n");
+				fprintf(f, "11 1\n");
+			} else if (si.type == G(ANDNOT)) {
+				fprintf(f, ".names ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.id);
+				fprintf(f, "10 1\n");
+			} else if (si.type == G(ORNOT)) {
+				fprintf(f, ".names ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.id);
+				fprintf(f, "1- 1\n");
+				fprintf(f, "-0 1\n");
+			} else if (si.type == G(MUX)) {
+				fprintf(f, ".names ys__n%d ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.in3, si.id);
+				fprintf(f, "1-0 1\n");
+				fprintf(f, "-11 1\n");
+			} else if (si.type == G(NMUX)) {
+				fprintf(f, ".names ys__n%d ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.in3, si.id);
+				fprintf(f, "0-0 1\n");
+				fprintf(f, "-01 1\n");
+			} else if (si.type == G(AOI3)) {
+				fprintf(f, ".names ys__n%d ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.in3, si.id);
+				fprintf(f, "-00 1\n");
+				fprintf(f, "0-0 1\n");
+			} else if (si.type == G(OAI3)) {
+				fprintf(f, ".names ys__n%d ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.in3, si.id);
+				fprintf(f, "00- 1\n");
+				fprintf(f, "--0 1\n");
+			} else if (si.type == G(AOI4)) {
+				fprintf(f, ".names ys__n%d ys__n%d ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.in3, si.in4, si.id);
+				fprintf(f, "-0-0 1\n");
+				fprintf(f, "-00- 1\n");
+				fprintf(f, "0--0 1\n");
+				fprintf(f, "0-0- 1\n");
+			} else if (si.type == G(OAI4)) {
+				fprintf(f, ".names ys__n%d ys__n%d ys__n%d ys__n%d ys__n%d\n", si.in1, si.in2, si.in3, si.in4, si.id);
+				fprintf(f, "00-- 1\n");
+				fprintf(f, "--00 1\n");
+			} else if (si.type == G(FF)) {
+				if (si.init == State::S0 || si.init == State::S1) {
+					fprintf(f, ".latch ys__n%d ys__n%d %d\n", si.in1, si.id, si.init == State::S1 ? 1 : 0);
+					recover_init = true;
+				} else
+					fprintf(f, ".latch ys__n%d ys__n%d 2\n", si.in1, si.id);
+			} else if (si.type != G(NONE))
+				log_abort();
+			if (si.type != G(NONE))
+				count_gates++;
+		}
+
+		fprintf(f, ".end\n");
 		fclose(f);
 
-		if (!lut_costs.empty()) {
-			buffer = stringf("%s/lutdefs.txt", tempdir_name.c_str());
+		log("Extracted %d gates and %d wires to a netlist network with %d inputs and %d outputs.\n",
+				count_gates, GetSize(signal_list), count_input, count_output);
+
+		this->exe_file = exe_file;
+		run_abc = count_output > 0;
+		builtin_lib = liberty_file.empty();
+		this->cleanup = cleanup;
+		this->show_tempdir = show_tempdir;
+		this->sop_mode = sop_mode;
+
+		if (run_abc)
+		{
+			auto &cell_cost = cmos_cost ? CellCosts::cmos_gate_cost() : CellCosts::default_gate_cost();
+
+			buffer = stringf("%s/stdcells.genlib", tempdir_name.c_str());
 			f = fopen(buffer.c_str(), "wt");
 			if (f == NULL)
 				log_error("Opening %s for writing failed: %s\n", buffer.c_str(), strerror(errno));
-			for (int i = 0; i < GetSize(lut_costs); i++)
-				fprintf(f, "%d %d.00 1.00\n", i+1, lut_costs.at(i));
+			fprintf(f, "GATE ZERO    1 Y=CONST0;\n");
+			fprintf(f, "GATE ONE     1 Y=CONST1;\n");
+			fprintf(f, "GATE BUF    %d Y=A;                  PIN * NONINV  1 999 1 0 1 0\n", cell_cost.at(ID($_BUF_)));
+			fprintf(f, "GATE NOT    %d Y=!A;                 PIN * INV     1 999 1 0 1 0\n", cell_cost.at(ID($_NOT_)));
+			if (enabled_gates.count("AND"))
+				fprintf(f, "GATE AND    %d Y=A*B;                PIN * NONINV  1 999 1 0 1 0\n", cell_cost.at(ID($_AND_)));
+			if (enabled_gates.count("NAND"))
+				fprintf(f, "GATE NAND   %d Y=!(A*B);             PIN * INV     1 999 1 0 1 0\n", cell_cost.at(ID($_NAND_)));
+			if (enabled_gates.count("OR"))
+				fprintf(f, "GATE OR     %d Y=A+B;                PIN * NONINV  1 999 1 0 1 0\n", cell_cost.at(ID($_OR_)));
+			if (enabled_gates.count("NOR"))
+				fprintf(f, "GATE NOR    %d Y=!(A+B);             PIN * INV     1 999 1 0 1 0\n", cell_cost.at(ID($_NOR_)));
+			if (enabled_gates.count("XOR"))
+				fprintf(f, "GATE XOR    %d Y=(A*!B)+(!A*B);      PIN * UNKNOWN 1 999 1 0 1 0\n", cell_cost.at(ID($_XOR_)));
+			if (enabled_gates.count("XNOR"))
+				fprintf(f, "GATE XNOR   %d Y=(A*B)+(!A*!B);      PIN * UNKNOWN 1 999 1 0 1 0\n", cell_cost.at(ID($_XNOR_)));
+			if (enabled_gates.count("ANDNOT"))
+				fprintf(f, "GATE ANDNOT %d Y=A*!B;               PIN * UNKNOWN 1 999 1 0 1 0\n", cell_cost.at(ID($_ANDNOT_)));
+			if (enabled_gates.count("ORNOT"))
+				fprintf(f, "GATE ORNOT  %d Y=A+!B;               PIN * UNKNOWN 1 999 1 0 1 0\n", cell_cost.at(ID($_ORNOT_)));
+			if (enabled_gates.count("AOI3"))
+				fprintf(f, "GATE AOI3   %d Y=!((A*B)+C);         PIN * INV     1 999 1 0 1 0\n", cell_cost.at(ID($_AOI3_)));
+			if (enabled_gates.count("OAI3"))
+				fprintf(f, "GATE OAI3   %d Y=!((A+B)*C);         PIN * INV     1 999 1 0 1 0\n", cell_cost.at(ID($_OAI3_)));
+			if (enabled_gates.count("AOI4"))
+				fprintf(f, "GATE AOI4   %d Y=!((A*B)+(C*D));     PIN * INV     1 999 1 0 1 0\n", cell_cost.at(ID($_AOI4_)));
+			if (enabled_gates.count("OAI4"))
+				fprintf(f, "GATE OAI4   %d Y=!((A+B)*(C+D));     PIN * INV     1 999 1 0 1 0\n", cell_cost.at(ID($_OAI4_)));
+			if (enabled_gates.count("MUX"))
+				fprintf(f, "GATE MUX    %d Y=(A*B)+(S*B)+(!S*A); PIN * UNKNOWN 1 999 1 0 1 0\n", cell_cost.at(ID($_MUX_)));
+			if (enabled_gates.count("NMUX"))
+				fprintf(f, "GATE NMUX   %d Y=!((A*B)+(S*B)+(!S*A)); PIN * UNKNOWN 1 999 1 0 1 0\n", cell_cost.at(ID($_NMUX_)));
+			if (map_mux4)
+				fprintf(f, "GATE MUX4   %d Y=(!S*!T*A)+(S*!T*B)+(!S*T*C)+(S*T*D); PIN * UNKNOWN 1 999 1 0 1 0\n", 2*cell_cost.at(ID($_MUX_)));
+			if (map_mux8)
+				fprintf(f, "GATE MUX8   %d Y=(!S*!T*!U*A)+(S*!T*!U*B)+(!S*T*!U*C)+(S*T*!U*D)+(!S*!T*U*E)+(S*!T*U*F)+(!S*T*U*G)+(S*T*U*H); PIN * UNKNOWN 1 999 1 0 1 0\n", 4*cell_cost.at(ID($_MUX_)));
+			if (map_mux16)
+				fprintf(f, "GATE MUX16  %d Y=(!S*!T*!U*!V*A)+(S*!T*!U*!V*B)+(!S*T*!U*!V*C)+(S*T*!U*!V*D)+(!S*!T*U*!V*E)+(S*!T*U*!V*F)+(!S*T*U*!V*G)+(S*T*U*!V*H)+(!S*!T*!U*V*I)+(S*!T*!U*V*J)+(!S*T*!U*V*K)+(S*T*!U*V*L)+(!S*!T*U*V*M)+(S*!T*U*V*N)+(!S*T*U*V*O)+(S*T*U*V*P); PIN * UNKNOWN 1 999 1 0 1 0\n", 8*cell_cost.at(ID($_MUX_)));
 			fclose(f);
+
+			if (!lut_costs.empty()) {
+				buffer = stringf("%s/lutdefs.txt", tempdir_name.c_str());
+				f = fopen(buffer.c_str(), "wt");
+				if (f == NULL)
+					log_error("Opening %s for writing failed: %s\n", buffer.c_str(), strerror(errno));
+				for (int i = 0; i < GetSize(lut_costs); i++)
+					fprintf(f, "%d %d.00 1.00\n", i+1, lut_costs.at(i));
+				fclose(f);
+			}
+
+			if (coproc != nullptr)
+				abc_command = stringf("source %s/abc.script", tempdir_name.c_str());
+			else
+				abc_command = tool_command(stringf("%s -s -f %s/abc.script 2>&1", exe_file.c_str(), tempdir_name.c_str()), tempdir_name);
 		}
+	}
+
+	void start()
+	{
+#ifndef YOSYS_LINK_ABC
+		// the co-process runs one script at a time, in finish()
+		if (!run_abc || coproc != nullptr)
+			return;
+
+		// ABC output is collected in the temp dir and replayed into the log when
+		// the job is re-integrated, so that the log does not depend on timing
+		std::string command = tool_command(stringf("%s -s -f %s/abc.script > %s/abc.log 2>&1", exe_file.c_str(),
+				tempdir_name.c_str(), tempdir_name.c_str()), tempdir_name);
+		abc_proc = popen(command.c_str(), "r");
+		if (abc_proc == nullptr)
+			log_error("ABC: starting command \"%s\" failed: %s.\n", command.c_str(), strerror(errno));
+#endif
+	}
 
-		buffer = stringf("%s -s -f %s/abc.script 2>&1", exe_file.c_str(), tempdir_name.c_str());
-		log("Running ABC command: %s\n", replace_tempdir(buffer, tempdir_name, show_tempdir).c_str());
+	void finish()
+	{
+		std::string buffer;
+
+		log_push();
+		if (run_abc)
+		{
+			{
+				YS_PROFILE_SCOPE("abc.run");
+
+				log_header(design, "Executing ABC.\n");
+
+				buffer = abc_command;
+				log("Running ABC command: %s\n", replace_tempdir(buffer, tempdir_name, show_tempdir).c_str());
 
 #ifndef YOSYS_LINK_ABC
-		abc_output_filter filt(tempdir_name, show_tempdir);
-		int ret = run_command(buffer, std::bind(&abc_output_filter::next_line, filt, std::placeholders::_1));
+				abc_output_filter filt(tempdir_name, show_tempdir, pi_map, po_map);
+				int ret;
+				if (coproc != nullptr) {
+					coproc->load_library("abc", AbcCoprocess::file_key(lib_file, lib_in_tempdir), lib_command);
+					ret = coproc->run(stringf("%s/abc.script", tempdir_name.c_str()),
+							std::bind(&abc_output_filter::next_line, filt, std::placeholders::_1));
+				} else if (abc_proc != nullptr) {
+					ret = pclose(abc_proc);
+					abc_proc = nullptr;
+#ifndef _WIN32
+					if (ret >= 0)
+						ret = WEXITSTATUS(ret);
+#endif
+					std::ifstream logf(stringf("%s/abc.log", tempdir_name.c_str()));
+					std::string line;
+					while (std::getline(logf, line))
+						filt.next_line(line + "\n");
+				} else
+					ret = run_command(buffer, std::bind(&abc_output_filter::next_line, filt, std::placeholders::_1));
 #else
-		// These needs to be mutable, supposedly due to getopt
-		char *abc_argv[5];
-		string tmp_script_name = stringf("%s/abc.script", tempdir_name.c_str());
-		abc_argv[0] = strdup(exe_file.c_str());
-		abc_argv[1] = strdup("-s");
-		abc_argv[2] = strdup("-f");
-		abc_argv[3] = strdup(tmp_script_name.c_str());
-		abc_argv[4] = 0;
-		int ret = Abc_RealMain(4, abc_argv);
-		free(abc_argv[0]);
-		free(abc_argv[1]);
-		free(abc_argv[2]);
-		free(abc_argv[3]);
+				// These needs to be mutable, supposedly due to getopt
+				char *abc_argv[5];
+				string tmp_script_name = stringf("%s/abc.script", tempdir_name.c_str());
+				abc_argv[0] = strdup(exe_file.c_str());
+				abc_argv[1] = strdup("-s");
+				abc_argv[2] = strdup("-f");
+				abc_argv[3] = strdup(tmp_script_name.c_str());
+				abc_argv[4] = 0;
+				int ret = Abc_RealMain(4, abc_argv);
+				free(abc_argv[0]);
+				free(abc_argv[1]);
+				free(abc_argv[2]);
+				free(abc_argv[3]);
 #endif
-		if (ret != 0)
-			log_error("ABC: execution of command \"%s\" failed: return code %d.\n", buffer.c_str(), ret);
-
-		buffer = stringf("%s/%s", tempdir_name.c_str(), "output.blif");
-		std::ifstream ifs;
-		ifs.open(buffer);
-		if (ifs.fail())
-			log_error("Can't open ABC output file `%s'.\n", buffer.c_str());
-
-		bool builtin_lib = liberty_file.empty();
-		RTLIL::Design *mapped_design = new RTLIL::Design;
-		parse_blif(mapped_design, ifs, builtin_lib ? ID(DFF) : ID(_dff_), false, sop_mode);
-
-		ifs.close();
-
-		log_header(design, "Re-integrating ABC results.\n");
-		RTLIL::Module *mapped_mod = mapped_design->modules_[ID(netlist)];
-		if (mapped_mod == NULL)
-			log_error("ABC output file does not contain a module `netlist'.\n");
-		for (auto &it : mapped_mod->wires_) {
-			RTLIL::Wire *w = it.second;
-			RTLIL::Wire *orig_wire = nullptr;
-			RTLIL::Wire *wire = module->addWire(remap_name(w->name, &orig_wire));
-			if (orig_wire != nullptr && orig_wire->attributes.count(ID(src)))
-				wire->attributes[ID(src)] = orig_wire->attributes[ID(src)];
-			if (markgroups) wire->attributes[ID(abcgroup)] = map_autoidx;
-			design->select(module, wire);
-		}
+				if (ret != 0)
+					log_error("ABC: execution of command \"%s\" failed: return code %d.\n", buffer.c_str(), ret);
+			}
 
-		std::map<std::string, int> cell_stats;
-		for (auto c : mapped_mod->cells())
-		{
-			if (builtin_lib)
+			YS_PROFILE_SCOPE("abc.reintegrate");
+
+			buffer = stringf("%s/%s", tempdir_name.c_str(), "output.blif");
+			MappedFile mapped_file;
+			if (!mapped_file.open(buffer))
+				log_error("Can't open ABC output file `%s'.\n", buffer.c_str());
+
+			RTLIL::Design *mapped_design = new RTLIL::Design;
+			parse_blif(mapped_design, mapped_file.data, mapped_file.size, builtin_lib ? ID(DFF) : ID(_dff_), false, sop_mode);
+			RTLIL::Module::Batch batch(module);
+
+			mapped_file.close();
+
+			log_header(design, "Re-integrating ABC results.\n");
+			RTLIL::Module *mapped_mod = mapped_design->modules_[ID(netlist)];
+			if (mapped_mod == NULL)
+				log_error("ABC output file does not contain a module `netlist'.\n");
+			for (auto &it : mapped_mod->wires_) {
+				RTLIL::Wire *w = it.second;
+				RTLIL::Wire *orig_wire = nullptr;
+				RTLIL::Wire *wire = module->addWire(remap_name(w->name, &orig_wire));
+				if (orig_wire != nullptr && orig_wire->attributes.count(ID(src)))
+					wire->attributes[ID(src)] = orig_wire->attributes[ID(src)];
+				if (markgroups) wire->attributes[ID(abcgroup)] = map_autoidx;
+				design->select(module, wire);
+			}
+
+			std::map<std::string, int> cell_stats;
+			for (auto c : mapped_mod->cells())
 			{
-				cell_stats[RTLIL::unescape_id(c->type)]++;
-				if (c->type.in(ID(ZERO), ID(ONE))) {
-					RTLIL::SigSig conn;
-					conn.first = RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::Y).as_wire()->name)]);
-					conn.second = RTLIL::SigSpec(c->type == ID(ZERO) ? 0 : 1, 1);
-					module->connect(conn);
-					continue;
+				if (builtin_lib)
+				{
+					cell_stats[RTLIL::unescape_id(c->type)]++;
+					if (c->type.in(ID(ZERO), ID(ONE))) {
+						RTLIL::SigSig conn;
+						conn.first = RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::Y).as_wire()->name)]);
+						conn.second = RTLIL::SigSpec(c->type == ID(ZERO) ? 0 : 1, 1);
+						module->connect(conn);
+						continue;
+					}
+					if (c->type == ID(BUF)) {
+						RTLIL::SigSig conn;
+						conn.first = RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::Y).as_wire()->name)]);
+						conn.second = RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::A).as_wire()->name)]);
+						module->connect(conn);
+						continue;
+					}
+					if (c->type == ID(NOT)) {
+						RTLIL::Cell *cell = module->addCell(remap_name(c->name), ID($_NOT_));
+						if (markgroups) cell->attributes[ID(abcgroup)] = map_autoidx;
+						cell->setPort(ID::A, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::A).as_wire()->name)]));
+						cell->setPort(ID::Y, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::Y).as_wire()->name)]));
+						design->select(module, cell);
+						continue;
+					}
+					if (c->type.in(ID(AND), ID(OR), ID(XOR), ID(NAND), ID(NOR), ID(XNOR), ID(ANDNOT), ID(ORNOT))) {
+						RTLIL::Cell *cell = module->addCell(remap_name(c->name), stringf("$_%s_", c->type.c_str()+1));
+						if (markgroups) cell->attributes[ID(abcgroup)] = map_autoidx;
+						cell->setPort(ID::A, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::A).as_wire()->name)]));
+						cell->setPort(ID::B, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::B).as_wire()->name)]));
+						cell->setPort(ID::Y, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::Y).as_wire()->name)]));
+						design->select(module, cell);
+						continue;
+					}
+					if (c->type.in(ID(MUX), ID(NMUX))) {
+						RTLIL::Cell *cell = module->addCell(remap_name(c->name), stringf("$_%s_", c->type.c_str()+1));
+						if (markgroups) cell->attributes[ID(abcgroup)] = map_autoidx;
+						cell->setPort(ID::A, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::A).as_wire()->name)]));
+						cell->setPort(ID::B, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::B).as_wire()->name)]));
+						cell->setPort(ID(S), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(S)).as_wire()->name)]));
+						cell->setPort(ID::Y, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::Y).as_wire()->name)]));
+						design->select(module, cell);
+						continue;
+					}
+					if (c->type == ID(MUX4)) {
+						RTLIL::Cell *cell = module->addCell(remap_name(c->name), ID($_MUX4_));
+						if (markgroups) cell->attributes[ID(abcgroup)] = map_autoidx;
+						cell->setPort(ID::A, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::A).as_wire()->name)]));
+						cell->setPort(ID::B, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::B).as_wire()->name)]));
+						cell->setPort(ID(C), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(C)).as_wire()->name)]));
+						cell->setPort(ID(D), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(D)).as_wire()->name)]));
+						cell->setPort(ID(S), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(S)).as_wire()->name)]));
+						cell->setPort(ID(T), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(T)).as_wire()->name)]));
+						cell->setPort(ID::Y, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::Y).as_wire()->name)]));
+						design->select(module, cell);
+						continue;
+					}
+					if (c->type == ID(MUX8)) {
+						RTLIL::Cell *cell = module->addCell(remap_name(c->name), ID($_MUX8_));
+						if (markgroups) cell->attributes[ID(abcgroup)] = map_autoidx;
+						cell->setPort(ID::A, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::A).as_wire()->name)]));
+						cell->setPort(ID::B, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::B).as_wire()->name)]));
+						cell->setPort(ID(C), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(C)).as_wire()->name)]));
+						cell->setPort(ID(D), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(D)).as_wire()->name)]));
+						cell->setPort(ID(E), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(E)).as_wire()->name)]));
+						cell->setPort(ID(F), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(F)).as_wire()->name)]));
+						cell->setPort(ID(G), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(G)).as_wire()->name)]));
+						cell->setPort(ID(H), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(H)).as_wire()->name)]));
+						cell->setPort(ID(S), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(S)).as_wire()->name)]));
+						cell->setPort(ID(T), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(T)).as_wire()->name)]));
+						cell->setPort(ID(U), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(U)).as_wire()->name)]));
+						cell->setPort(ID::Y, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::Y).as_wire()->name)]));
+						design->select(module, cell);
+						continue;
+					}
+					if (c->type == ID(MUX16)) {
+						RTLIL::Cell *cell = module->addCell(remap_name(c->name), ID($_MUX16_));
+						if (markgroups) cell->attributes[ID(abcgroup)] = map_autoidx;
+						cell->setPort(ID::A, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::A).as_wire()->name)]));
+						cell->setPort(ID::B, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::B).as_wire()->name)]));
+						cell->setPort(ID(C), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(C)).as_wire()->name)]));
+						cell->setPort(ID(D), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(D)).as_wire()->name)]));
+						cell->setPort(ID(E), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(E)).as_wire()->name)]));
+						cell->setPort(ID(F), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(F)).as_wire()->name)]));
+						cell->setPort(ID(G), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(G)).as_wire()->name)]));
+						cell->setPort(ID(H), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(H)).as_wire()->name)]));
+						cell->setPort(ID(I), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(I)).as_wire()->name)]));
+						cell->setPort(ID(J), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(J)).as_wire()->name)]));
+						cell->setPort(ID(K), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(K)).as_wire()->name)]));
+						cell->setPort(ID(L), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(L)).as_wire()->name)]));
+						cell->setPort(ID(M), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(M)).as_wire()->name)]));
+						cell->setPort(ID(N), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(N)).as_wire()->name)]));
+						cell->setPort(ID(O), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(O)).as_wire()->name)]));
+						cell->setPort(ID(P), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(P)).as_wire()->name)]));
+						cell->setPort(ID(S), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(S)).as_wire()->name)]));
+						cell->setPort(ID(T), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(T)).as_wire()->name)]));
+						cell->setPort(ID(U), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(U)).as_wire()->name)]));
+						cell->setPort(ID(V), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(V)).as_wire()->name)]));
+						cell->setPort(ID::Y, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::Y).as_wire()->name)]));
+						design->select(module, cell);
+						continue;
+					}
+					if (c->type.in(ID(AOI3), ID(OAI3))) {
+						RTLIL::Cell *cell = module->addCell(remap_name(c->name), stringf("$_%s_", c->type.c_str()+1));
+						if (markgroups) cell->attributes[ID(abcgroup)] = map_autoidx;
+						cell->setPort(ID::A, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::A).as_wire()->name)]));
+						cell->setPort(ID::B, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::B).as_wire()->name)]));
+						cell->setPort(ID(C), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(C)).as_wire()->name)]));
+						cell->setPort(ID::Y, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::Y).as_wire()->name)]));
+						design->select(module, cell);
+						continue;
+					}
+					if (c->type.in(ID(AOI4), ID(OAI4))) {
+						RTLIL::Cell *cell = module->addCell(remap_name(c->name), stringf("$_%s_", c->type.c_str()+1));
+						if (markgroups) cell->attributes[ID(abcgroup)] = map_autoidx;
+						cell->setPort(ID::A, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::A).as_wire()->name)]));
+						cell->setPort(ID::B, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::B).as_wire()->name)]));
+						cell->setPort(ID(C), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(C)).as_wire()->name)]));
+						cell->setPort(ID(D), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(D)).as_wire()->name)]));
+						cell->setPort(ID::Y, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::Y).as_wire()->name)]));
+						design->select(module, cell);
+						continue;
+					}
+					if (c->type == ID(DFF)) {
+						log_assert(clk_sig.size() == 1);
+						RTLIL::Cell *cell;
+						if (en_sig.size() == 0) {
+							cell = module->addCell(remap_name(c->name), clk_polarity ? ID($_DFF_P_) : ID($_DFF_N_));
+						} else {
+							log_assert(en_sig.size() == 1);
+							cell = module->addCell(remap_name(c->name), stringf("$_DFFE_%c%c_", clk_polarity ? 'P' : 'N', en_polarity ? 'P' : 'N'));
+							cell->setPort(ID(E), en_sig);
+						}
+						if (markgroups) cell->attributes[ID(abcgroup)] = map_autoidx;
+						cell->setPort(ID(D), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(D)).as_wire()->name)]));
+						cell->setPort(ID(Q), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(Q)).as_wire()->name)]));
+						cell->setPort(ID(C), clk_sig);
+						design->select(module, cell);
+						continue;
+					}
 				}
-				if (c->type == ID(BUF)) {
+				else
+					cell_stats[RTLIL::unescape_id(c->type)]++;
+
+				if (c->type.in(ID(_const0_), ID(_const1_))) {
 					RTLIL::SigSig conn;
-					conn.first = RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::Y).as_wire()->name)]);
-					conn.second = RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::A).as_wire()->name)]);
+					conn.first = RTLIL::SigSpec(module->wires_[remap_name(c->connections().begin()->second.as_wire()->name)]);
+					conn.second = RTLIL::SigSpec(c->type == ID(_const0_) ? 0 : 1, 1);
 					module->connect(conn);
 					continue;
 				}
-				if (c->type == ID(NOT)) {
-					RTLIL::Cell *cell = module->addCell(remap_name(c->name), ID($_NOT_));
-					if (markgroups) cell->attributes[ID(abcgroup)] = map_autoidx;
-					cell->setPort(ID::A, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::A).as_wire()->name)]));
-					cell->setPort(ID::Y, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::Y).as_wire()->name)]));
-					design->select(module, cell);
-					continue;
-				}
-				if (c->type.in(ID(AND), ID(OR), ID(XOR), ID(NAND), ID(NOR), ID(XNOR), ID(ANDNOT), ID(ORNOT))) {
-					RTLIL::Cell *cell = module->addCell(remap_name(c->name), stringf("$_%s_", c->type.c_str()+1));
-					if (markgroups) cell->attributes[ID(abcgroup)] = map_autoidx;
-					cell->setPort(ID::A, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::A).as_wire()->name)]));
-					cell->setPort(ID::B, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::B).as_wire()->name)]));
-					cell->setPort(ID::Y, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::Y).as_wire()->name)]));
-					design->select(module, cell);
-					continue;
-				}
-				if (c->type.in(ID(MUX), ID(NMUX))) {
-					RTLIL::Cell *cell = module->addCell(remap_name(c->name), stringf("$_%s_", c->type.c_str()+1));
-					if (markgroups) cell->attributes[ID(abcgroup)] = map_autoidx;
-					cell->setPort(ID::A, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::A).as_wire()->name)]));
-					cell->setPort(ID::B, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::B).as_wire()->name)]));
-					cell->setPort(ID(S), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(S)).as_wire()->name)]));
-					cell->setPort(ID::Y, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::Y).as_wire()->name)]));
-					design->select(module, cell);
-					continue;
-				}
-				if (c->type == ID(MUX4)) {
-					RTLIL::Cell *cell = module->addCell(remap_name(c->name), ID($_MUX4_));
-					if (markgroups) cell->attributes[ID(abcgroup)] = map_autoidx;
-					cell->setPort(ID::A, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::A).as_wire()->name)]));
-					cell->setPort(ID::B, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::B).as_wire()->name)]));
-					cell->setPort(ID(C), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(C)).as_wire()->name)]));
-					cell->setPort(ID(D), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(D)).as_wire()->name)]));
-					cell->setPort(ID(S), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(S)).as_wire()->name)]));
-					cell->setPort(ID(T), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(T)).as_wire()->name)]));
-					cell->setPort(ID::Y, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::Y).as_wire()->name)]));
-					design->select(module, cell);
-					continue;
-				}
-				if (c->type == ID(MUX8)) {
-					RTLIL::Cell *cell = module->addCell(remap_name(c->name), ID($_MUX8_));
-					if (markgroups) cell->attributes[ID(abcgroup)] = map_autoidx;
-					cell->setPort(ID::A, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::A).as_wire()->name)]));
-					cell->setPort(ID::B, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::B).as_wire()->name)]));
-					cell->setPort(ID(C), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(C)).as_wire()->name)]));
-					cell->setPort(ID(D), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(D)).as_wire()->name)]));
-					cell->setPort(ID(E), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(E)).as_wire()->name)]));
-					cell->setPort(ID(F), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(F)).as_wire()->name)]));
-					cell->setPort(ID(G), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(G)).as_wire()->name)]));
-					cell->setPort(ID(H), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(H)).as_wire()->name)]));
-					cell->setPort(ID(S), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(S)).as_wire()->name)]));
-					cell->setPort(ID(T), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(T)).as_wire()->name)]));
-					cell->setPort(ID(U), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(U)).as_wire()->name)]));
-					cell->setPort(ID::Y, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::Y).as_wire()->name)]));
-					design->select(module, cell);
-					continue;
-				}
-				if (c->type == ID(MUX16)) {
-					RTLIL::Cell *cell = module->addCell(remap_name(c->name), ID($_MUX16_));
-					if (markgroups) cell->attributes[ID(abcgroup)] = map_autoidx;
-					cell->setPort(ID::A, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::A).as_wire()->name)]));
-					cell->setPort(ID::B, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::B).as_wire()->name)]));
-					cell->setPort(ID(C), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(C)).as_wire()->name)]));
-					cell->setPort(ID(D), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(D)).as_wire()->name)]));
-					cell->setPort(ID(E), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(E)).as_wire()->name)]));
-					cell->setPort(ID(F), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(F)).as_wire()->name)]));
-					cell->setPort(ID(G), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(G)).as_wire()->name)]));
-					cell->setPort(ID(H), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(H)).as_wire()->name)]));
-					cell->setPort(ID(I), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(I)).as_wire()->name)]));
-					cell->setPort(ID(J), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(J)).as_wire()->name)]));
-					cell->setPort(ID(K), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(K)).as_wire()->name)]));
-					cell->setPort(ID(L), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(L)).as_wire()->name)]));
-					cell->setPort(ID(M), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(M)).as_wire()->name)]));
-					cell->setPort(ID(N), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(N)).as_wire()->name)]));
-					cell->setPort(ID(O), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(O)).as_wire()->name)]));
-					cell->setPort(ID(P), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(P)).as_wire()->name)]));
-					cell->setPort(ID(S), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(S)).as_wire()->name)]));
-					cell->setPort(ID(T), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(T)).as_wire()->name)]));
-					cell->setPort(ID(U), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(U)).as_wire()->name)]));
-					cell->setPort(ID(V), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(V)).as_wire()->name)]));
-					cell->setPort(ID::Y, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::Y).as_wire()->name)]));
-					design->select(module, cell);
-					continue;
-				}
-				if (c->type.in(ID(AOI3), ID(OAI3))) {
-					RTLIL::Cell *cell = module->addCell(remap_name(c->name), stringf("$_%s_", c->type.c_str()+1));
-					if (markgroups) cell->attributes[ID(abcgroup)] = map_autoidx;
-					cell->setPort(ID::A, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::A).as_wire()->name)]));
-					cell->setPort(ID::B, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::B).as_wire()->name)]));
-					cell->setPort(ID(C), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(C)).as_wire()->name)]));
-					cell->setPort(ID::Y, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::Y).as_wire()->name)]));
-					design->select(module, cell);
-					continue;
-				}
-				if (c->type.in(ID(AOI4), ID(OAI4))) {
-					RTLIL::Cell *cell = module->addCell(remap_name(c->name), stringf("$_%s_", c->type.c_str()+1));
-					if (markgroups) cell->attributes[ID(abcgroup)] = map_autoidx;
-					cell->setPort(ID::A, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::A).as_wire()->name)]));
-					cell->setPort(ID::B, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::B).as_wire()->name)]));
-					cell->setPort(ID(C), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(C)).as_wire()->name)]));
-					cell->setPort(ID(D), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(D)).as_wire()->name)]));
-					cell->setPort(ID::Y, RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID::Y).as_wire()->name)]));
-					design->select(module, cell);
-					continue;
-				}
-				if (c->type == ID(DFF)) {
+
+				if (c->type == ID(_dff_)) {
 					log_assert(clk_sig.size() == 1);
 					RTLIL::Cell *cell;
 					if (en_sig.size() == 0) {
@@ -1181,113 +1345,308 @@ void abc_module(RTLIL::Design *design, RTLIL::Module *current_module, std::strin
 					design->select(module, cell);
 					continue;
 				}
-			}
-			else
-				cell_stats[RTLIL::unescape_id(c->type)]++;
-
-			if (c->type.in(ID(_const0_), ID(_const1_))) {
-				RTLIL::SigSig conn;
-				conn.first = RTLIL::SigSpec(module->wires_[remap_name(c->connections().begin()->second.as_wire()->name)]);
-				conn.second = RTLIL::SigSpec(c->type == ID(_const0_) ? 0 : 1, 1);
-				module->connect(conn);
-				continue;
-			}
 
-			if (c->type == ID(_dff_)) {
-				log_assert(clk_sig.size() == 1);
-				RTLIL::Cell *cell;
-				if (en_sig.size() == 0) {
-					cell = module->addCell(remap_name(c->name), clk_polarity ? ID($_DFF_P_) : ID($_DFF_N_));
-				} else {
-					log_assert(en_sig.size() == 1);
-					cell = module->addCell(remap_name(c->name), stringf("$_DFFE_%c%c_", clk_polarity ? 'P' : 'N', en_polarity ? 'P' : 'N'));
-					cell->setPort(ID(E), en_sig);
+				if (c->type == ID($lut) && GetSize(c->getPort(ID::A)) == 1 && c->getParam(ID(LUT)).as_int() == 2) {
+					SigSpec my_a = module->wires_[remap_name(c->getPort(ID::A).as_wire()->name)];
+					SigSpec my_y = module->wires_[remap_name(c->getPort(ID::Y).as_wire()->name)];
+					module->connect(my_y, my_a);
+					continue;
 				}
+
+				RTLIL::Cell *cell = module->addCell(remap_name(c->name), c->type);
 				if (markgroups) cell->attributes[ID(abcgroup)] = map_autoidx;
-				cell->setPort(ID(D), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(D)).as_wire()->name)]));
-				cell->setPort(ID(Q), RTLIL::SigSpec(module->wires_[remap_name(c->getPort(ID(Q)).as_wire()->name)]));
-				cell->setPort(ID(C), clk_sig);
+				cell->parameters = c->parameters;
+				for (auto &conn : c->connections()) {
+					RTLIL::SigSpec newsig;
+					for (auto &c : conn.second.chunks()) {
+						if (c.width == 0)
+							continue;
+						log_assert(c.width == 1);
+						newsig.append(module->wires_[remap_name(c.wire->name)]);
+					}
+					cell->setPort(conn.first, newsig);
+				}
 				design->select(module, cell);
-				continue;
 			}
 
-			if (c->type == ID($lut) && GetSize(c->getPort(ID::A)) == 1 && c->getParam(ID(LUT)).as_int() == 2) {
-				SigSpec my_a = module->wires_[remap_name(c->getPort(ID::A).as_wire()->name)];
-				SigSpec my_y = module->wires_[remap_name(c->getPort(ID::Y).as_wire()->name)];
-				module->connect(my_y, my_a);
-				continue;
+			for (auto conn : mapped_mod->connections()) {
+				if (!conn.first.is_fully_const())
+					conn.first = RTLIL::SigSpec(module->wires_[remap_name(conn.first.as_wire()->name)]);
+				if (!conn.second.is_fully_const())
+					conn.second = RTLIL::SigSpec(module->wires_[remap_name(conn.second.as_wire()->name)]);
+				module->connect(conn);
 			}
 
-			RTLIL::Cell *cell = module->addCell(remap_name(c->name), c->type);
-			if (markgroups) cell->attributes[ID(abcgroup)] = map_autoidx;
-			cell->parameters = c->parameters;
-			for (auto &conn : c->connections()) {
-				RTLIL::SigSpec newsig;
-				for (auto &c : conn.second.chunks()) {
-					if (c.width == 0)
-						continue;
-					log_assert(c.width == 1);
-					newsig.append(module->wires_[remap_name(c.wire->name)]);
+			if (recover_init)
+				for (auto wire : mapped_mod->wires()) {
+					if (wire->attributes.count(ID(init))) {
+						Wire *w = module->wires_[remap_name(wire->name)];
+						log_assert(w->attributes.count(ID(init)) == 0);
+						w->attributes[ID(init)] = wire->attributes.at(ID(init));
+					}
 				}
-				cell->setPort(conn.first, newsig);
-			}
-			design->select(module, cell);
+
+			for (auto &it : cell_stats)
+				log("ABC RESULTS:   %15s cells: %8d\n", it.first.c_str(), it.second);
+			int in_wires = 0, out_wires = 0;
+			for (auto &si : signal_list)
+				if (si.is_port) {
+					char buffer[100];
+					snprintf(buffer, 100, "\\ys__n%d", si.id);
+					RTLIL::SigSig conn;
+					if (si.type != G(NONE)) {
+						conn.first = si.bit;
+						conn.second = RTLIL::SigSpec(module->wires_[remap_name(buffer)]);
+						out_wires++;
+					} else {
+						conn.first = RTLIL::SigSpec(module->wires_[remap_name(buffer)]);
+						conn.second = si.bit;
+						in_wires++;
+					}
+					module->connect(conn);
+				}
+			log("ABC RESULTS:        internal signals: %8d\n", int(signal_list.size()) - in_wires - out_wires);
+			log("ABC RESULTS:           input signals: %8d\n", in_wires);
+			log("ABC RESULTS:          output signals: %8d\n", out_wires);
+
+			delete mapped_design;
+		}
+		else
+		{
+			log("Don't call ABC as there is nothing to map.\n");
 		}
 
-		for (auto conn : mapped_mod->connections()) {
-			if (!conn.first.is_fully_const())
-				conn.first = RTLIL::SigSpec(module->wires_[remap_name(conn.first.as_wire()->name)]);
-			if (!conn.second.is_fully_const())
-				conn.second = RTLIL::SigSpec(module->wires_[remap_name(conn.second.as_wire()->name)]);
-			module->connect(conn);
+		if (cleanup)
+		{
+			log("Removing temp directory.\n");
+			remove_directory(tempdir_name);
 		}
 
-		if (recover_init)
-			for (auto wire : mapped_mod->wires()) {
-				if (wire->attributes.count(ID(init))) {
-					Wire *w = module->wires_[remap_name(wire->name)];
-					log_assert(w->attributes.count(ID(init)) == 0);
-					w->attributes[ID(init)] = wire->attributes.at(ID(init));
-				}
-			}
+		log_pop();
+	}
+};
 
-		for (auto &it : cell_stats)
-			log("ABC RESULTS:   %15s cells: %8d\n", it.first.c_str(), it.second);
-		int in_wires = 0, out_wires = 0;
-		for (auto &si : signal_list)
-			if (si.is_port) {
-				char buffer[100];
-				snprintf(buffer, 100, "\\ys__n%d", si.id);
-				RTLIL::SigSig conn;
-				if (si.type != G(NONE)) {
-					conn.first = si.bit;
-					conn.second = RTLIL::SigSpec(module->wires_[remap_name(buffer)]);
-					out_wires++;
-				} else {
-					conn.first = RTLIL::SigSpec(module->wires_[remap_name(buffer)]);
-					conn.second = si.bit;
-					in_wires++;
+// Splits the cells into about num_parts parts of similar size for separate
+// ABC runs. The parts are grown from the fan-in cones of the cells whose
+// outputs are not used by other cells in the set, or that are flip-flops, so
+// that cones shared by several outputs mostly end up in the same part. The
+// signals between the parts become ports of the extracted netlists.
+std::vector<std::vector<RTLIL::Cell*>> partition_cells(const SigMap &assign_map, const std::vector<RTLIL::Cell*> &cells, int num_parts)
+{
+	dict<RTLIL::SigBit, RTLIL::Cell*> bit_driver;
+	dict<RTLIL::Cell*, int> fanout;
+	for (auto cell : cells) {
+		fanout[cell] = 0;
+		for (auto &conn : cell->connections())
+			if (cell->output(conn.first))
+				for (auto bit : assign_map(conn.second))
+					bit_driver[bit] = cell;
+	}
+
+	for (auto cell : cells)
+		for (auto &conn : cell->connections())
+			if (!cell->output(conn.first))
+				for (auto bit : assign_map(conn.second)) {
+					auto it = bit_driver.find(bit);
+					if (it != bit_driver.end())
+						fanout[it->second]++;
 				}
-				module->connect(conn);
-			}
-		log("ABC RESULTS:        internal signals: %8d\n", int(signal_list.size()) - in_wires - out_wires);
-		log("ABC RESULTS:           input signals: %8d\n", in_wires);
-		log("ABC RESULTS:          output signals: %8d\n", out_wires);
 
-		delete mapped_design;
-	}
-	else
+	// cells that are only used inside a loop are reached by the second pass
+	std::vector<RTLIL::Cell*> roots;
+	for (auto cell : cells)
+		if (fanout.at(cell) == 0 || FfIndex::is_ff(cell->type))
+			roots.push_back(cell);
+	roots.insert(roots.end(), cells.begin(), cells.end());
+
+	int bound = (GetSize(cells) + num_parts - 1) / num_parts;
+	std::vector<std::vector<RTLIL::Cell*>> parts(1);
+	pool<RTLIL::Cell*> assigned;
+	std::vector<RTLIL::Cell*> stack;
+
+	for (auto root : roots)
 	{
-		log("Don't call ABC as there is nothing to map.\n");
+		if (assigned.count(root))
+			continue;
+
+		stack.push_back(root);
+		assigned.insert(root);
+		while (!stack.empty())
+		{
+			RTLIL::Cell *cell = stack.back();
+			stack.pop_back();
+
+			// a single cone much larger than the bound is split as well
+			if (GetSize(parts.back()) >= 2*bound)
+				parts.emplace_back();
+			parts.back().push_back(cell);
+
+			if (cell != root && FfIndex::is_ff(cell->type))
+				continue;
+			for (auto &conn : cell->connections())
+				if (!cell->output(conn.first))
+					for (auto bit : assign_map(conn.second)) {
+						auto it = bit_driver.find(bit);
+						if (it != bit_driver.end() && !FfIndex::is_ff(it->second->type) && !assigned.count(it->second)) {
+							assigned.insert(it->second);
+							stack.push_back(it->second);
+						}
+					}
+		}
+
+		if (GetSize(parts.back()) >= bound)
+			parts.emplace_back();
 	}
 
-	if (cleanup)
-	{
-		log("Removing temp directory.\n");
-		remove_directory(tempdir_name);
+	if (parts.back().empty())
+		parts.pop_back();
+	return parts;
+}
+
+// Liberty files reduced to the cells ABC can use, written once per session for
+// each library (and driving cell) and removed when Yosys exits.
+struct PrunedLibertyFiles
+{
+	struct Entry {
+		std::string filename;
+		int64_t size, mtime;
+	};
+
+	std::string dir;
+	dict<std::string, Entry> entries;
+
+	~PrunedLibertyFiles() {
+		if (!dir.empty())
+			remove_directory(dir);
+	}
+} pruned_liberty_files;
+
+// statements in the kept cells that ABC does not read
+const pool<std::string> liberty_prune_ids = {
+	"internal_power", "leakage_power", "leakage_current", "dynamic_current", "pg_pin",
+	"receiver_capacitance", "output_current_rise", "output_current_fall",
+	"ccsn_first_stage", "ccsn_last_stage", "intrinsic_parasitic"
+};
+
+// the strings are unquoted by LibertyParser
+std::string liberty_token(const std::string &str)
+{
+	bool simple = !str.empty();
+	for (char c : str)
+		if (!isalnum((unsigned char)c) && c != '_' && c != '.' && c != '+' && c != '-')
+			simple = false;
+	return simple ? str : "\"" + str + "\"";
+}
+
+void write_liberty_ast(std::ostream &f, LibertyAst *ast, const std::string &indent)
+{
+	if (liberty_prune_ids.count(ast->id))
+		return;
+	f << indent << ast->id;
+	if (!ast->args.empty() || !ast->children.empty()) {
+		f << "(";
+		for (size_t i = 0; i < ast->args.size(); i++)
+			f << (i > 0 ? ", " : "") << liberty_token(ast->args[i]);
+		f << ")";
+	}
+	if (!ast->value.empty())
+		f << " : " << liberty_token(ast->value);
+	if (!ast->children.empty()) {
+		f << " {\n";
+		for (auto child : ast->children)
+			write_liberty_ast(f, child, indent + "  ");
+		f << indent << "}\n";
+	} else
+		f << " ;\n";
+}
+
+// ABC only maps to combinational cells that are not marked dont_use and have
+// an output with a function
+bool abc_usable_cell(LibertyAst *cell)
+{
+	LibertyAst *dont_use = cell->find("dont_use");
+	if (dont_use != nullptr && dont_use->value == "true")
+		return false;
+
+	bool has_function = false;
+	for (auto child : cell->children) {
+		if (child->id == "ff" || child->id == "latch" || child->id == "ff_bank" || child->id == "latch_bank" ||
+				child->id == "statetable" || child->id == "test_cell")
+			return false;
+		if (child->id == "pin" && child->find("function") != nullptr) {
+			LibertyAst *dir = child->find("direction");
+			if (dir != nullptr && dir->value == "output")
+				has_function = true;
+		}
+	}
+	return has_function;
+}
+
+// Returns a liberty file with only the cells ABC can use (and the driving cell
+// from the -constr file), so that ABC does not parse the whole vendor library
+// on every call. The library level statements such as units and table
+// templates are kept. Returns the original file if it can not be parsed here.
+std::string pruned_liberty_file(const std::string &liberty_file, const std::string &constr_file)
+{
+	std::string driving_cell;
+	if (!constr_file.empty()) {
+		std::ifstream f(constr_file.c_str());
+		std::string line;
+		while (std::getline(f, line)) {
+			std::vector<std::string> tokens = split_tokens(line);
+			if (GetSize(tokens) >= 2 && tokens[0] == "set_driving_cell")
+				driving_cell = tokens[1];
+		}
+	}
+
+	struct stat st;
+	if (stat(liberty_file.c_str(), &st) != 0)
+		return liberty_file;
+
+	std::string key = liberty_file + "\n" + driving_cell;
+	auto it = pruned_liberty_files.entries.find(key);
+	if (it != pruned_liberty_files.entries.end() && it->second.size == st.st_size && it->second.mtime == st.st_mtime)
+		return it->second.filename;
+
+	LibertyAst *ast = LibertyAstCache::instance.cached_ast(liberty_file);
+	if (ast == nullptr)
+		return liberty_file;
+
+	if (pruned_liberty_files.dir.empty())
+		pruned_liberty_files.dir = make_temp_dir("/tmp/yosys-abc-lib-XXXXXX");
+
+	PrunedLibertyFiles::Entry &entry = pruned_liberty_files.entries[key];
+	entry.filename = stringf("%s/%d.lib", pruned_liberty_files.dir.c_str(), GetSize(pruned_liberty_files.entries));
+	entry.size = st.st_size;
+	entry.mtime = st.st_mtime;
+
+	int num_cells = 0, kept_cells = 0;
+	std::ofstream f(entry.filename.c_str());
+	f << ast->id << "(";
+	for (size_t i = 0; i < ast->args.size(); i++)
+		f << (i > 0 ? ", " : "") << liberty_token(ast->args[i]);
+	f << ") {\n";
+	for (auto child : ast->children) {
+		if (child->id == "cell" && GetSize(child->args) == 1) {
+			num_cells++;
+			if (child->args[0] != driving_cell && !abc_usable_cell(child))
+				continue;
+			kept_cells++;
+		}
+		write_liberty_ast(f, child, "  ");
+	}
+	f << "}\n";
+	f.close();
+
+	if (f.fail()) {
+		log_warning("Can't write pruned liberty file `%s', passing `%s' to ABC.\n", entry.filename.c_str(), liberty_file.c_str());
+		pruned_liberty_files.entries.erase(key);
+		return liberty_file;
 	}
 
-	log_pop();
+	log("Pruned liberty file `%s' for ABC: kept %d of %d cells in `%s'.\n",
+			liberty_file.c_str(), kept_cells, num_cells, entry.filename.c_str());
+	return entry.filename;
 }
 
 struct AbcPass : public Pass {
@@ -1358,7 +1717,12 @@ struct AbcPass : public Pass {
 		log("\n");
 		log("    -liberty <file>\n");
 		log("        generate netlists for the specified cell library (using the liberty\n");
-		log("        file format).\n");
+		log("        file format). ABC is given a copy of the library that only contains\n");
+		log("        the combinational cells without dont_use (and without the power and\n");
+		log("        noise data that ABC ignores). the copy is made once per session.\n");
+		log("\n");
+		log("    -full_liberty\n");
+		log("        pass the liberty file to ABC as it is.\n");
 		log("\n");
 		log("    -constr <file>\n");
 		log("        pass this file with timing constraints to ABC. use with -liberty.\n");
@@ -1458,6 +1822,28 @@ struct AbcPass : public Pass {
 		log("        this attribute is a unique integer for each ABC process started. This\n");
 		log("        is useful for debugging the partitioning of clock domains.\n");
 		log("\n");
+		log("    -j <num>\n");
+		log("        run up to <num> ABC processes concurrently. the netlists for all selected\n");
+		log("        modules (and clock domains with -dff) are extracted up front and the\n");
+		log("        results are re-integrated in the same order as without this option.\n");
+		log("\n");
+		log("    -partition <num>\n");
+		log("        split the logic of each module (and clock domain with -dff) into about\n");
+		log("        <num> parts of similar size and pass each part through ABC separately.\n");
+		log("        the parts are built from the fan-in cones of flip-flops and of signals\n");
+		log("        that leave the logic, and the signals between the parts are kept.\n");
+		log("        this is meant for very large flat modules, where it allows running\n");
+		log("        ABC in parallel at the cost of some optimization across the parts.\n");
+		log("        the parts are mapped by <num> concurrent ABC processes unless -j is\n");
+		log("        specified.\n");
+		log("\n");
+		log("    -coproc\n");
+		log("        instead of starting ABC for each module and clock domain, keep one ABC\n");
+		log("        process running for the rest of the session and send it the scripts.\n");
+		log("        the library is only read again when it changed. this saves the startup\n");
+		log("        time in flows with many small ABC calls. the scripts are run one after\n");
+		log("        another, so -j has no effect. not available on Windows.\n");
+		log("\n");
 		log("    -dress\n");
 		log("        run the 'dress' command after all other ABC commands. This aims to\n");
 		log("        preserve naming by an equivalence check between the original and post-ABC\n");
@@ -1481,13 +1867,6 @@ struct AbcPass : public Pass {
 		log_header(design, "Executing ABC pass (technology mapping using ABC).\n");
 		log_push();
 
-		assign_map.clear();
-		signal_list.clear();
-		signal_map.clear();
-		signal_init.clear();
-		pi_map.clear();
-		po_map.clear();
-
 #ifdef ABCEXTERNAL
 		std::string exe_file = ABCEXTERNAL;
 #else
@@ -1497,9 +1876,12 @@ struct AbcPass : public Pass {
 		std::string delay_target, sop_inputs, sop_products, lutin_shared = "-S 1";
 		bool fast_mode = false, dff_mode = false, keepff = false, cleanup = true;
 		bool show_tempdir = false, sop_mode = false;
-		bool abc_dress = false;
+		bool abc_dress = false, full_liberty = false;
+		int max_jobs = 1, num_parts = 1;
+		bool max_jobs_set = false;
 		vector<int> lut_costs;
 		markgroups = false;
+		coproc_mode = false;
 
 		map_mux4 = false;
 		map_mux8 = false;
@@ -1539,6 +1921,8 @@ struct AbcPass : public Pass {
 		map_mux8 = design->scratchpad_get_bool("abc.mux8", map_mux8);
 		map_mux16 = design->scratchpad_get_bool("abc.mux16", map_mux16);
 		abc_dress = design->scratchpad_get_bool("abc.dress", abc_dress);
+		coproc_mode = design->scratchpad_get_bool("abc.coproc", coproc_mode);
+		full_liberty = design->scratchpad_get_bool("abc.full_liberty", full_liberty);
 		g_arg = design->scratchpad_get_string("abc.g", g_arg);
 
 		fast_mode = design->scratchpad_get_bool("abc.fast", fast_mode);
@@ -1622,6 +2006,27 @@ struct AbcPass : public Pass {
 				abc_dress = true;
 				continue;
 			}
+			if (arg == "-full_liberty") {
+				full_liberty = true;
+				continue;
+			}
+			if (arg == "-coproc") {
+				coproc_mode = true;
+				continue;
+			}
+			if (arg == "-j" && argidx+1 < args.size()) {
+				max_jobs = atoi(args[++argidx].c_str());
+				if (max_jobs < 1)
+					log_cmd_error("Invalid number of jobs for -j: %s\n", args[argidx].c_str());
+				max_jobs_set = true;
+				continue;
+			}
+			if (arg == "-partition" && argidx+1 < args.size()) {
+				num_parts = atoi(args[++argidx].c_str());
+				if (num_parts < 1)
+					log_cmd_error("Invalid number of partitions for -partition: %s\n", args[argidx].c_str());
+				continue;
+			}
 			if (arg == "-g" && argidx+1 < args.size()) {
 				if (g_arg_from_cmd)
 					log_cmd_error("Can only use -g once. Please combine.");
@@ -1836,6 +2241,9 @@ struct AbcPass : public Pass {
 		if (!constr_file.empty() && liberty_file.empty())
 			log_cmd_error("Got -constr but no -liberty!\n");
 
+		if (!liberty_file.empty() && !full_liberty)
+			liberty_file = pruned_liberty_file(liberty_file, constr_file);
+
 		if (enabled_gates.empty()) {
 			enabled_gates.insert("AND");
 			enabled_gates.insert("NAND");
@@ -1853,6 +2261,58 @@ struct AbcPass : public Pass {
 			// enabled_gates.insert("NMUX");
 		}
 
+		std::deque<AbcWorker*> running_jobs;
+		std::vector<RTLIL::SigSpec> pending_ports;
+
+		SigMap assign_map;
+		dict<RTLIL::SigBit, RTLIL::State> signal_init;
+		bool clk_polarity = true, en_polarity = true;
+		RTLIL::SigSpec clk_sig, en_sig;
+
+		if (num_parts > 1 && !max_jobs_set)
+			max_jobs = num_parts;
+
+		auto run_abc_part = [&](RTLIL::Module *mod, const std::vector<RTLIL::Cell*> &cells, bool job_dff_mode, std::string job_clk_str)
+		{
+			AbcWorker *worker = new AbcWorker(design, mod, assign_map, signal_init);
+			worker->clk_polarity = clk_polarity;
+			worker->en_polarity = en_polarity;
+			worker->clk_sig = clk_sig;
+			worker->en_sig = en_sig;
+
+			if (max_jobs == 1) {
+				worker->extract(script_file, exe_file, liberty_file, constr_file, cleanup, lut_costs, job_dff_mode, job_clk_str,
+						keepff, delay_target, sop_inputs, sop_products, lutin_shared, fast_mode, cells, show_tempdir, sop_mode, abc_dress);
+				worker->finish();
+				delete worker;
+				return;
+			}
+			worker->extract(script_file, exe_file, liberty_file, constr_file, cleanup, lut_costs, job_dff_mode, job_clk_str,
+					keepff, delay_target, sop_inputs, sop_products, lutin_shared, fast_mode, cells, show_tempdir, sop_mode, abc_dress,
+					&pending_ports);
+			if (GetSize(running_jobs) >= max_jobs) {
+				running_jobs.front()->finish();
+				delete running_jobs.front();
+				running_jobs.pop_front();
+			}
+			worker->start();
+			running_jobs.push_back(worker);
+		};
+
+		auto run_abc_job = [&](RTLIL::Module *mod, const std::vector<RTLIL::Cell*> &cells, bool job_dff_mode, std::string job_clk_str)
+		{
+			if (num_parts == 1 || GetSize(cells) < 2) {
+				run_abc_part(mod, cells, job_dff_mode, job_clk_str);
+				return;
+			}
+			std::vector<std::vector<RTLIL::Cell*>> parts = partition_cells(assign_map, cells, num_parts);
+			log("Partitioned %d cells of module %s into %d parts.\n", GetSize(cells), log_id(mod), GetSize(parts));
+			for (auto &part : parts) {
+				run_abc_part(mod, part, job_dff_mode, job_clk_str);
+				assign_map.set(mod);
+			}
+		};
+
 		for (auto mod : design->selected_modules())
 		{
 			if (mod->processes.size() > 0) {
@@ -1860,6 +2320,8 @@ struct AbcPass : public Pass {
 				continue;
 			}
 
+			pending_ports.clear();
+
 			assign_map.set(mod);
 			signal_init.clear();
 
@@ -1881,8 +2343,7 @@ struct AbcPass : public Pass {
 				}
 
 			if (!dff_mode || !clk_str.empty()) {
-				abc_module(design, mod, script_file, exe_file, liberty_file, constr_file, cleanup, lut_costs, dff_mode, clk_str, keepff,
-						delay_target, sop_inputs, sop_products, lutin_shared, fast_mode, mod->selected_cells(), show_tempdir, sop_mode, abc_dress);
+				run_abc_job(mod, mod->selected_cells(), dff_mode, clk_str);
 				continue;
 			}
 
@@ -2026,18 +2487,16 @@ struct AbcPass : public Pass {
 				clk_sig = assign_map(std::get<1>(it.first));
 				en_polarity = std::get<2>(it.first);
 				en_sig = assign_map(std::get<3>(it.first));
-				abc_module(design, mod, script_file, exe_file, liberty_file, constr_file, cleanup, lut_costs, !clk_sig.empty(), "$",
-						keepff, delay_target, sop_inputs, sop_products, lutin_shared, fast_mode, it.second, show_tempdir, sop_mode, abc_dress);
+				run_abc_job(mod, it.second, !clk_sig.empty(), "$");
 				assign_map.set(mod);
 			}
 		}
 
-		assign_map.clear();
-		signal_list.clear();
-		signal_map.clear();
-		signal_init.clear();
-		pi_map.clear();
-		po_map.clear();
+		while (!running_jobs.empty()) {
+			running_jobs.front()->finish();
+			delete running_jobs.front();
+			running_jobs.pop_front();
+		}
 
 		log_pop();
 	}
@@ -160,6 +160,19 @@ struct Abc9Pass : public ScriptPass
 		log("    -box <file>\n");
 		log("        pass this file with box library to ABC.\n");
 		log("\n");
+		log("    -j <num>\n");
+		log("        run up to <num> ABC processes concurrently. for each module the netlist\n");
+		log("        is written as before and 'abc9_exe -start' launches ABC in the\n");
+		log("        background. when <num> processes are running (and after the last\n");
+		log("        module), the oldest one is collected with 'abc9_exe -wait', which\n");
+		log("        prints its output, and its result is re-integrated. this keeps the\n");
+		log("        modules and the log in the same order as without -j.\n");
+		log("\n");
+		log("    -coproc\n");
+		log("        pass the scripts to an ABC process that is kept running for the rest\n");
+		log("        of the session instead of starting ABC for each module (see 'help\n");
+		log("        abc9_exe'). -j has no effect then.\n");
+		log("\n");
 		log("Note that this is a logic optimization pass within Yosys that is calling ABC\n");
 		log("internally. This is not going to \"run ABC on your design\". It will instead run\n");
 		log("ABC on logic snippets extracted from your design. You will not get any useful\n");
@@ -174,8 +187,9 @@ struct Abc9Pass : public ScriptPass
 	}
 
 	std::stringstream exe_cmd;
-	bool dff_mode, cleanup;
+	bool dff_mode, cleanup, show_tempdir;
 	std::string box_file;
+	int max_jobs;
 
 	void clear_flags() YS_OVERRIDE
 	{
@@ -183,7 +197,9 @@ struct Abc9Pass : public ScriptPass
 		exe_cmd << "abc9_exe";
 		dff_mode = false;
 		cleanup = true;
+		show_tempdir = false;
 		box_file.clear();
+		max_jobs = 1;
 	}
 
 	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
@@ -197,6 +213,7 @@ struct Abc9Pass : public ScriptPass
 
 		if (design->scratchpad_get_bool("abc9.debug")) {
 			cleanup = false;
+			show_tempdir = true;
 			exe_cmd << " -showtmp";
 		}
 
@@ -211,10 +228,18 @@ struct Abc9Pass : public ScriptPass
 				continue;
 			}
 			if (arg == "-fast" || /* arg == "-dff" || */
-					/* arg == "-nocleanup" || */ arg == "-showtmp") {
+					/* arg == "-nocleanup" || */ arg == "-showtmp" || arg == "-coproc") {
+				if (arg == "-showtmp")
+					show_tempdir = true;
 				exe_cmd << " " << arg;
 				continue;
 			}
+			if (arg == "-j" && argidx+1 < args.size()) {
+				max_jobs = atoi(args[++argidx].c_str());
+				if (max_jobs < 1)
+					log_cmd_error("Invalid number of jobs for -j: %s\n", args[argidx].c_str());
+				continue;
+			}
 			if (arg == "-dff") {
 				dff_mode = true;
 				exe_cmd << " " << arg;
@@ -278,14 +303,43 @@ struct Abc9Pass : public ScriptPass
 				run("foreach module in selection");
 				run("    abc9_ops -write_box [<value from -box>|(null)] <abc-temp-dir>/input.box");
 				run("    write_xaiger -map <abc-temp-dir>/input.sym <abc-temp-dir>/input.xaig");
-				run("    abc9_exe [options] -cwd <abc-temp-dir> -box <abc-temp-dir>/input.box");
-				run("    read_aiger -xaiger -wideports -module_name <module-name>$abc9 -map <abc-temp-dir>/input.sym <abc-temp-dir>/output.aig");
-				run("    abc9_ops -reintegrate");
+				run("    abc9_exe [options] -cwd <abc-temp-dir> -box <abc-temp-dir>/input.box", "(without -j)");
+				run("    read_aiger -xaiger -wideports -module_name <module-name>$abc9 -map <abc-temp-dir>/input.sym <abc-temp-dir>/output.aig", "(without -j)");
+				run("    abc9_ops -reintegrate", "(without -j)");
+				run("    abc9_exe [options] -start -cwd <abc-temp-dir> -box <abc-temp-dir>/input.box", "(with -j)");
+				run("    if <num> processes are running (and for all of them after the last module)", "(with -j)");
+				run("        abc9_exe -wait -cwd <abc-temp-dir-of-oldest-process>");
+				run("        read_aiger -xaiger -wideports -module_name <module-name>$abc9 -map <abc-temp-dir>/input.sym <abc-temp-dir>/output.aig");
+				run("        abc9_ops -reintegrate");
 			}
 			else {
 				auto selected_modules = active_design->selected_modules();
 				active_design->selection_stack.emplace_back(false);
 
+				// modules (and their temp dirs) with an ABC process running in the background
+				std::deque<std::pair<RTLIL::Module*, std::string>> running_jobs;
+
+				auto finish_job = [&]() {
+					RTLIL::Module *mod = running_jobs.front().first;
+					std::string tempdir_name = running_jobs.front().second;
+					running_jobs.pop_front();
+
+					log_push();
+					active_design->selection().select(mod);
+
+					run(stringf("abc9_exe -wait%s -cwd %s", show_tempdir ? " -showtmp" : "", tempdir_name.c_str()));
+					run(stringf("read_aiger -xaiger -wideports -module_name %s$abc9 -map %s/input.sym %s/output.aig", log_id(mod), tempdir_name.c_str(), tempdir_name.c_str()));
+					run("abc9_ops -reintegrate");
+
+					if (cleanup) {
+						log("Removing temp directory.\n");
+						remove_directory(tempdir_name);
+					}
+
+					active_design->selection().selected_modules.clear();
+					log_pop();
+				};
+
 				for (auto mod : selected_modules) {
 					if (mod->processes.size() > 0) {
 						log("Skipping module %s as it contains processes.\n", log_id(mod));
@@ -318,7 +372,16 @@ struct Abc9Pass : public ScriptPass
 							log_id(mod),
 							active_design->scratchpad_get_int("write_xaiger.num_inputs"),
 							num_outputs);
-					if (num_outputs) {
+					if (num_outputs && max_jobs > 1) {
+						run(stringf("%s -start -cwd %s -box %s/input.box", exe_cmd.str().c_str(), tempdir_name.c_str(), tempdir_name.c_str()));
+						active_design->selection().selected_modules.clear();
+						log_pop();
+						running_jobs.emplace_back(mod, tempdir_name);
+						if (GetSize(running_jobs) >= max_jobs)
+							finish_job();
+						continue;
+					}
+					else if (num_outputs) {
 						run(stringf("%s -cwd %s -box %s/input.box", exe_cmd.str().c_str(), tempdir_name.c_str(), tempdir_name.c_str()));
 						run(stringf("read_aiger -xaiger -wideports -module_name %s$abc9 -map %s/input.sym %s/output.aig", log_id(mod), tempdir_name.c_str(), tempdir_name.c_str()));
 						run("abc9_ops -reintegrate");
@@ -335,6 +398,9 @@ struct Abc9Pass : public ScriptPass
 					log_pop();
 				}
 
+				while (!running_jobs.empty())
+					finish_job();
+
 				active_design->selection_stack.pop_back();
 			}
 		}
@@ -24,6 +24,7 @@
 
 #include "kernel/register.h"
 #include "kernel/log.h"
+#include "passes/techmap/abc_coproc.h"
 
 #ifndef _WIN32
 #  include <unistd.h>
@@ -162,23 +163,65 @@ struct abc9_output_filter
 	}
 };
 
+// ABC processes started with 'abc9_exe -start', indexed by their working directory
+dict<std::string, FILE*> abc9_background_procs;
+
+void abc9_wait(std::string tempdir_name, bool show_tempdir)
+{
+	if (abc9_background_procs.count(tempdir_name) == 0)
+		log_cmd_error("No ABC process was started in `%s'.\n", replace_tempdir(tempdir_name, tempdir_name, show_tempdir).c_str());
+
+	log("Waiting for ABC process in %s.\n", replace_tempdir(tempdir_name, tempdir_name, show_tempdir).c_str());
+
+	// scripts run by the co-process are already done
+	FILE *proc = abc9_background_procs.at(tempdir_name);
+	int ret = proc != nullptr ? pclose(proc) : 0;
+	abc9_background_procs.erase(tempdir_name);
+#ifndef _WIN32
+	if (proc != nullptr && ret >= 0)
+		ret = WEXITSTATUS(ret);
+#endif
+
+	abc9_output_filter filt(tempdir_name, show_tempdir);
+	std::ifstream logf(stringf("%s/abc.log", tempdir_name.c_str()));
+	std::string line;
+	while (std::getline(logf, line))
+		filt.next_line(line + "\n");
+
+	if (ret != 0)
+		log_error("ABC: execution in %s failed: return code %d.\n", replace_tempdir(tempdir_name, tempdir_name, show_tempdir).c_str(), ret);
+}
+
 void abc9_module(RTLIL::Design *design, std::string script_file, std::string exe_file,
 		vector<int> lut_costs, bool dff_mode, std::string delay_target, std::string /*lutin_shared*/, bool fast_mode,
 		bool show_tempdir, std::string box_file, std::string lut_file,
-		std::string wire_delay, std::string tempdir_name
+		std::string wire_delay, std::string tempdir_name, bool background, bool coproc_mode
 )
 {
 	std::string abc9_script;
 
+	AbcCoprocess *coproc = nullptr;
+#ifndef YOSYS_LINK_ABC
+	if (coproc_mode)
+		coproc = AbcCoprocess::get(exe_file);
+#else
+	(void)coproc_mode;
+#endif
+
+	std::string lut_command;
 	if (!lut_costs.empty())
-		abc9_script += stringf("read_lut %s/lutdefs.txt; ", tempdir_name.c_str());
+		lut_command = stringf("read_lut %s/lutdefs.txt", tempdir_name.c_str());
 	else if (!lut_file.empty())
-		abc9_script += stringf("read_lut %s; ", lut_file.c_str());
+		lut_command = stringf("read_lut %s", lut_file.c_str());
 	else
 		log_abort();
 
 	log_assert(!box_file.empty());
-	abc9_script += stringf("read_box %s; ", box_file.c_str());
+	std::string box_command = stringf("read_box %s", box_file.c_str());
+
+	// the co-process reads the libraries only when they changed
+	if (coproc == nullptr)
+		abc9_script += lut_command + "; " + box_command + "; ";
 	abc9_script += stringf("&read %s/input.xaig; &ps; ", tempdir_name.c_str());
 
 	if (!script_file.empty()) {
@@ -251,13 +294,59 @@ void abc9_module(RTLIL::Design *design, std::string script_file, std::string exe
 		fclose(f);
 	}
 
-	buffer = stringf("%s -s -f %s/abc.script 2>&1", exe_file.c_str(), tempdir_name.c_str());
+#ifndef YOSYS_LINK_ABC
+	if (coproc != nullptr) {
+		if (background && abc9_background_procs.count(tempdir_name))
+			log_cmd_error("An ABC process is already running in `%s'.\n", replace_tempdir(tempdir_name, tempdir_name, show_tempdir).c_str());
+
+		if (!lut_costs.empty())
+			coproc->load_library("abc9.lut", AbcCoprocess::file_key(stringf("%s/lutdefs.txt", tempdir_name.c_str()), true), lut_command);
+		else
+			coproc->load_library("abc9.lut", AbcCoprocess::file_key(lut_file, false), lut_command);
+		coproc->load_library("abc9.box", AbcCoprocess::file_key(box_file, true), box_command);
+
+		buffer = stringf("source %s/abc.script", tempdir_name.c_str());
+		log("Running ABC command: %s\n", replace_tempdir(buffer, tempdir_name, show_tempdir).c_str());
+
+		// with -start, the output is kept for 'abc9_exe -wait' as if ABC
+		// was running in the background
+		int ret;
+		if (background) {
+			std::ofstream logf(stringf("%s/abc.log", tempdir_name.c_str()));
+			ret = coproc->run(stringf("%s/abc.script", tempdir_name.c_str()), [&](const std::string &line) { logf << line; });
+			abc9_background_procs[tempdir_name] = nullptr;
+		} else {
+			abc9_output_filter filt(tempdir_name, show_tempdir);
+			ret = coproc->run(stringf("%s/abc.script", tempdir_name.c_str()), std::bind(&abc9_output_filter::next_line, filt, std::placeholders::_1));
+		}
+		if (ret != 0)
+			log_error("ABC: execution of command \"%s\" failed: return code %d.\n", buffer.c_str(), ret);
+		return;
+	}
+
+	if (background) {
+		if (abc9_background_procs.count(tempdir_name))
+			log_cmd_error("An ABC process is already running in `%s'.\n", replace_tempdir(tempdir_name, tempdir_name, show_tempdir).c_str());
+		buffer = tool_command(stringf("%s -s -f %s/abc.script > %s/abc.log 2>&1", exe_file.c_str(), tempdir_name.c_str(), tempdir_name.c_str()), tempdir_name);
+		log("Starting ABC command: %s\n", replace_tempdir(buffer, tempdir_name, show_tempdir).c_str());
+		FILE *proc = popen(buffer.c_str(), "r");
+		if (proc == nullptr)
+			log_error("ABC: starting command \"%s\" failed: %s.\n", buffer.c_str(), strerror(errno));
+		abc9_background_procs[tempdir_name] = proc;
+		return;
+	}
+#endif
+
+	buffer = tool_command(stringf("%s -s -f %s/abc.script 2>&1", exe_file.c_str(), tempdir_name.c_str()), tempdir_name);
 	log("Running ABC command: %s\n", replace_tempdir(buffer, tempdir_name, show_tempdir).c_str());
 
 #ifndef YOSYS_LINK_ABC
 	abc9_output_filter filt(tempdir_name, show_tempdir);
 	int ret = run_command(buffer, std::bind(&abc9_output_filter::next_line, filt, std::placeholders::_1));
 #else
+	// simply run in the foreground when ABC is linked into Yosys
+	if (background)
+		abc9_background_procs[tempdir_name] = nullptr;
 	// These needs to be mutable, supposedly due to getopt
 	char *abc9_argv[5];
 	string tmp_script_name = stringf("%s/abc.script", tempdir_name.c_str());
@@ -350,6 +439,21 @@ struct Abc9ExePass : public Pass {
 		log("        file is expected. temporary files will be created in this directory, and\n");
 		log("        the mapped result will be written to 'output.aig'.\n");
 		log("\n");
+		log("    -start\n");
+		log("        start ABC in the background and return immediately. the output of ABC\n");
+		log("        is written to 'abc.log' in the directory given by -cwd.\n");
+		log("\n");
+		log("    -wait\n");
+		log("        wait for the ABC process started with -start in the directory given by\n");
+		log("        -cwd to finish and print its output. all other options except -showtmp\n");
+		log("        are ignored.\n");
+		log("\n");
+		log("    -coproc\n");
+		log("        run the script in an ABC process that is kept running for the rest of\n");
+		log("        the session (see 'help abc'). the LUT and box libraries are only read\n");
+		log("        again when they changed. with -start, the script is run before\n");
+		log("        returning.\n");
+		log("\n");
 		log("Note that this is a logic optimization pass within Yosys that is calling ABC\n");
 		log("internally. This is not going to \"run ABC on your design\". It will instead run\n");
 		log("ABC on logic snippets extracted from your design. You will not get any useful\n");
@@ -373,7 +477,7 @@ struct Abc9ExePass : public Pass {
 		std::string delay_target, lutin_shared = "-S 1", wire_delay;
 		std::string tempdir_name;
 		bool fast_mode = false, dff_mode = false;
-		bool show_tempdir = false;
+		bool show_tempdir = false, start_mode = false, wait_mode = false, coproc_mode = false;
 		vector<int> lut_costs;
 
 #if 0
@@ -399,6 +503,7 @@ struct Abc9ExePass : public Pass {
 		fast_mode = design->scratchpad_get_bool("abc9.fast", fast_mode);
 		dff_mode = design->scratchpad_get_bool("abc9.dff", dff_mode);
 		show_tempdir = design->scratchpad_get_bool("abc9.showtmp", show_tempdir);
+		coproc_mode = design->scratchpad_get_bool("abc9.coproc", coproc_mode);
 		box_file = design->scratchpad_get_string("abc9.box", box_file);
 		if (design->scratchpad.count("abc9.W")) {
 			wire_delay = "-W " + design->scratchpad_get_string("abc9.W");
@@ -460,10 +565,36 @@ struct Abc9ExePass : public Pass {
 				tempdir_name = args[++argidx];
 				continue;
 			}
+			if (arg == "-start") {
+				start_mode = true;
+				continue;
+			}
+			if (arg == "-wait") {
+				wait_mode = true;
+				continue;
+			}
+			if (arg == "-coproc") {
+				coproc_mode = true;
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
+		if (start_mode && wait_mode)
+			log_cmd_error("Options -start and -wait are exclusive.\n");
+
+		if (wait_mode) {
+			if (tempdir_name.empty())
+				log_cmd_error("abc9_exe '-cwd' option is mandatory.\n");
+#ifndef YOSYS_LINK_ABC
+			abc9_wait(tempdir_name, show_tempdir);
+#else
+			abc9_background_procs.erase(tempdir_name);
+#endif
+			return;
+		}
+
 		rewrite_filename(script_file);
 		if (!script_file.empty() && !is_absolute_path(script_file) && script_file[0] != '+')
 			script_file = std::string(pwd) + "/" + script_file;
@@ -523,7 +654,7 @@ struct Abc9ExePass : public Pass {
 
 		abc9_module(design, script_file, exe_file, lut_costs, dff_mode,
 				delay_target, lutin_shared, fast_mode, show_tempdir,
-				box_file, lut_file, wire_delay, tempdir_name);
+				box_file, lut_file, wire_delay, tempdir_name, start_mode, coproc_mode);
 	}
 } Abc9ExePass;
 
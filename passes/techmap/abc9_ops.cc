@@ -23,6 +23,8 @@
 #include "kernel/utils.h"
 #include "kernel/celltypes.h"
 
+#include <sys/stat.h>
+
 #define ABC9_FLOPS_BASE_ID 8000
 #define ABC9_DELAY_BASE_ID 9000
 
@@ -435,6 +437,9 @@ void prep_delays(RTLIL::Design *design)
 	pool<Module*> flops;
 	std::vector<Cell*> cells;
 	dict<IdString,dict<IdString,std::vector<int>>> requireds_cache;
+	// flop cells of the same type share few parametrisations, derive()
+	// builds the name of the derived module every time it is called
+	dict<IdString,std::vector<std::pair<dict<IdString,Const>,Module*>>> derived_cache;
 	for (auto module : design->selected_modules()) {
 		if (module->processes.size() > 0) {
 			log("Skipping module %s as it contains processes.\n", log_id(module));
@@ -452,9 +457,18 @@ void prep_delays(RTLIL::Design *design)
 			if (!inst_module->get_blackbox_attribute())
 				continue;
 			if (inst_module->get_bool_attribute(ID(abc9_flop))) {
-				IdString derived_type = inst_module->derive(design, cell->parameters);
-				inst_module = design->module(derived_type);
-				log_assert(inst_module);
+				auto &derived = derived_cache[cell->type];
+				auto it = std::find_if(derived.begin(), derived.end(), [cell](const std::pair<dict<IdString,Const>,Module*> &d) {
+					return d.first == cell->parameters;
+				});
+				if (it != derived.end())
+					inst_module = it->second;
+				else {
+					IdString derived_type = inst_module->derive(design, cell->parameters);
+					inst_module = design->module(derived_type);
+					log_assert(inst_module);
+					derived.emplace_back(cell->parameters, inst_module);
+				}
 				flops.insert(inst_module);
 				continue; // because all flop required times
 				          //   will be captured in the flop box
@@ -562,17 +576,42 @@ void prep_delays(RTLIL::Design *design)
 	design->scratchpad_set_string("abc9_ops.box.flops", ss.str());
 }
 
+// The box library of the techlib is the same for all modules and all abc9
+// calls of a session, it is only read again when the file was changed.
+struct BoxSource {
+	int64_t mtime = 0;
+	int64_t size = -1;
+	std::string contents;
+};
+std::map<std::string, BoxSource> box_source_cache;
+
+const std::string &read_box_source(const std::string &src)
+{
+	BoxSource &entry = box_source_cache[src];
+	struct stat st;
+	if (stat(src.c_str(), &st) != 0) {
+		entry = BoxSource();
+		return entry.contents;
+	}
+	if (entry.size != int64_t(st.st_size) || entry.mtime != int64_t(st.st_mtime)) {
+		std::ifstream ifs(src);
+		std::stringstream buf;
+		buf << ifs.rdbuf();
+		entry.contents = buf.str();
+		entry.mtime = st.st_mtime;
+		entry.size = st.st_size;
+	}
+	return entry.contents;
+}
+
 void write_box(RTLIL::Module *module, const std::string &src, const std::string &dst) {
 	std::ofstream ofs(dst);
 	log_assert(ofs.is_open());
 
 	// Since ABC can only accept one box file, we have to copy
 	//   over the existing box file
-	if (src != "(null)") {
-		std::ifstream ifs(src);
-		ofs << ifs.rdbuf() << std::endl;
-		ifs.close();
-	}
+	if (src != "(null)")
+		ofs << read_box_source(src) << std::endl;
 
 	ofs << module->design->scratchpad_get_string("abc9_ops.box.flops");
 
@@ -826,13 +865,13 @@ void reintegrate(RTLIL::Module *module)
 	// Copy connections (and rename) from mapped_mod to module
 	for (auto conn : mapped_mod->connections()) {
 		if (!conn.first.is_fully_const()) {
-			auto chunks = conn.first.chunks();
+			std::vector<RTLIL::SigChunk> chunks = conn.first.chunks();
 			for (auto &c : chunks)
 				c.wire = module->wires_.at(remap_name(c.wire->name));
 			conn.first = std::move(chunks);
 		}
 		if (!conn.second.is_fully_const()) {
-			auto chunks = conn.second.chunks();
+			std::vector<RTLIL::SigChunk> chunks = conn.second.chunks();
 			for (auto &c : chunks)
 				if (c.wire)
 					c.wire = module->wires_.at(remap_name(c.wire->name));
@@ -928,7 +967,7 @@ void reintegrate(RTLIL::Module *module)
 			int i = 0;
 			while (i < GetSize(mask)) {
 				for (int j = 0; j < (1 << index); j++)
-					std::swap(mask[i+j], mask[i+j+(1 << index)]);
+					std::swap(mask.bits()[i+j], mask.bits()[i+j+(1 << index)]);
 				i += 1 << (index+1);
 			}
 			A[index] = y_bit;
@@ -943,7 +982,7 @@ void reintegrate(RTLIL::Module *module)
 		// and get cleaned away
 clone_lut:
 		driver_mask = driver_lut->getParam(ID(LUT));
-		for (auto &b : driver_mask.bits) {
+		for (auto &b : driver_mask.bits()) {
 			if (b == RTLIL::State::S0) b = RTLIL::State::S1;
 			else if (b == RTLIL::State::S1) b = RTLIL::State::S0;
 		}
@@ -1006,7 +1045,8 @@ struct Abc9OpsPass : public Pass {
 		log("\n");
 		log("    -write_box (<src>|(null)) <dst>\n");
 		log("        copy the existing box file from <src> (skip if '(null)') and append any\n");
-		log("        new box definitions.\n");
+		log("        new box definitions. the contents of <src> are kept for the session\n");
+		log("        and only read again when the file changes.\n");
 		log("\n");
 		log("    -reintegrate\n");
 		log("        for each selected module, re-intergrate the module '<module-name>$abc9'\n");
@@ -0,0 +1,209 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "passes/techmap/abc_coproc.h"
+
+#include <sys/stat.h>
+#ifndef _WIN32
+#  include <sys/socket.h>
+#  include <sys/wait.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#  define MSG_NOSIGNAL 0
+#endif
+
+YOSYS_NAMESPACE_BEGIN
+
+AbcCoprocess *AbcCoprocess::get(const std::string &exe_file)
+{
+#ifdef _WIN32
+	(void)exe_file;
+	return nullptr;
+#else
+	// std::map does not move its entries, the processes are stopped when
+	// Yosys exits
+	static std::map<std::string, AbcCoprocess> coprocs;
+	AbcCoprocess &coproc = coprocs[exe_file];
+	coproc.exe_file = exe_file;
+
+	// a process started by the parent of a forked 'server' request belongs
+	// to the parent
+	if (coproc.pid >= 0 && coproc.owner != getpid()) {
+		close(coproc.fd);
+		coproc.pid = coproc.owner = -1;
+		coproc.fd = -1;
+		coproc.buffer.clear();
+		coproc.loaded_libs.clear();
+	}
+	return &coproc;
+#endif
+}
+
+std::string AbcCoprocess::file_key(const std::string &filename, bool by_contents)
+{
+	if (by_contents) {
+		std::ifstream f(filename);
+		std::stringstream buf;
+		buf << f.rdbuf();
+		return buf.str();
+	}
+
+	struct stat st;
+	if (stat(filename.c_str(), &st) != 0)
+		return filename;
+	return stringf("%s %lld %lld", filename.c_str(), (long long)st.st_size, (long long)st.st_mtime);
+}
+
+bool AbcCoprocess::start()
+{
+#ifdef _WIN32
+	return false;
+#else
+	// one socket is used for stdin, stdout and stderr of ABC, unlike a pipe
+	// it can be written with MSG_NOSIGNAL when ABC has died
+	int sv[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+		log_warning("Can't create socket for ABC co-process: %s\n", strerror(errno));
+		return false;
+	}
+
+	log_flush();
+	int child = fork();
+	if (child < 0) {
+		log_warning("Can't fork for ABC co-process: %s\n", strerror(errno));
+		close(sv[0]);
+		close(sv[1]);
+		return false;
+	}
+	if (child == 0) {
+		close(sv[0]);
+		dup2(sv[1], 0);
+		dup2(sv[1], 1);
+		dup2(sv[1], 2);
+		if (sv[1] > 2)
+			close(sv[1]);
+		std::string command = stringf("exec %s -s", exe_file.c_str());
+		execl("/bin/sh", "sh", "-c", command.c_str(), (char*)nullptr);
+		_exit(127);
+	}
+
+	close(sv[1]);
+	fcntl(sv[0], F_SETFD, FD_CLOEXEC);
+	pid = child;
+	owner = getpid();
+	fd = sv[0];
+	buffer.clear();
+	loaded_libs.clear();
+	log("Started ABC co-process %d: %s -s\n", pid, exe_file.c_str());
+	return true;
+#endif
+}
+
+void AbcCoprocess::stop()
+{
+#ifndef _WIN32
+	if (pid < 0)
+		return;
+	close(fd);
+	if (owner == getpid())
+		waitpid(pid, nullptr, 0);
+	pid = owner = -1;
+	fd = -1;
+	buffer.clear();
+	loaded_libs.clear();
+#endif
+}
+
+void AbcCoprocess::load_library(const std::string &slot, const std::string &key, const std::string &command)
+{
+	if (pid < 0 && !start())
+		return;
+
+	auto it = loaded_libs.find(slot);
+	if (it != loaded_libs.end() && it->second == key)
+		return;
+
+	std::string line = command + "\n";
+#ifndef _WIN32
+	if (send(fd, line.data(), line.size(), MSG_NOSIGNAL) != ssize_t(line.size())) {
+		stop();
+		return;
+	}
+#endif
+	loaded_libs[slot] = key;
+}
+
+int AbcCoprocess::run(const std::string &script_file, const std::function<void(const std::string&)> &process_line)
+{
+#ifdef _WIN32
+	(void)script_file;
+	(void)process_line;
+	return 1;
+#else
+	if (pid < 0 && !start())
+		return 1;
+
+	std::string marker = stringf("yosys_abc_done_%d", ++serial);
+	std::string commands = stringf("source %s\n%s\n", script_file.c_str(), marker.c_str());
+	if (send(fd, commands.data(), commands.size(), MSG_NOSIGNAL) != ssize_t(commands.size())) {
+		stop();
+		return 1;
+	}
+
+	while (1)
+	{
+		size_t pos;
+		while ((pos = buffer.find('\n')) != std::string::npos)
+		{
+			std::string line = buffer.substr(0, pos+1);
+			buffer.erase(0, pos+1);
+
+			// the prompts are not terminated by a newline
+			while (line.compare(0, 4, "abc ") == 0) {
+				size_t end = line.find("> ");
+				if (end == std::string::npos || line.find_first_not_of("0123456789", 4) != end)
+					break;
+				line = line.substr(end+2);
+			}
+
+			if (line.find(marker) != std::string::npos)
+				return 0;
+			process_line(line);
+		}
+
+		char buf[4096];
+		ssize_t n = read(fd, buf, sizeof(buf));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		buffer.append(buf, n);
+	}
+
+	if (!buffer.empty())
+		process_line(buffer + "\n");
+	stop();
+	return 1;
+#endif
+}
+
+YOSYS_NAMESPACE_END
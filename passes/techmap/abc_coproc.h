@@ -0,0 +1,67 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef ABC_COPROC_H
+#define ABC_COPROC_H
+
+#include "kernel/yosys.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// An interactive ABC process that is kept running for the rest of the session
+// and executes the scripts of all 'abc' and 'abc9_exe' calls with -coproc
+// that use the same executable. Libraries are kept loaded between the calls.
+//
+// The end of a script is detected by sending an unknown command after it,
+// the error message for it is written to the unbuffered stderr of ABC. The
+// regular output of ABC is buffered, so parts of it can show up in the log
+// of the following call.
+struct AbcCoprocess
+{
+	std::string exe_file;
+	int pid = -1, owner = -1;
+	int fd = -1;
+	int serial = 0;
+	std::string buffer;
+	dict<std::string, std::string> loaded_libs;
+
+	// Returns the process for the executable, or nullptr when co-processes
+	// are not supported on this platform.
+	static AbcCoprocess *get(const std::string &exe_file);
+
+	// Files written to the temp dir of a call are identified by their
+	// contents, all other files by their name, size and mtime.
+	static std::string file_key(const std::string &filename, bool by_contents);
+
+	// Sends the command unless a library with the same key was already
+	// loaded into the slot.
+	void load_library(const std::string &slot, const std::string &key, const std::string &command);
+
+	// Runs the ABC script and passes the output of ABC to process_line.
+	// Returns 0 on success, and 1 when the process ended.
+	int run(const std::string &script_file, const std::function<void(const std::string&)> &process_line);
+
+	bool start();
+	void stop();
+	~AbcCoprocess() { stop(); }
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
@@ -23,8 +23,8 @@
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
-struct AigmapPass : public Pass {
-	AigmapPass() : Pass("aigmap", "map logic to and-inverter-graph circuit") { }
+struct AigmapPass : public ModulePass {
+	AigmapPass() : ModulePass("aigmap", "map logic to and-inverter-graph circuit") { }
 	void help() YS_OVERRIDE
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -40,143 +40,186 @@ struct AigmapPass : public Pass {
 		log("    -select\n");
 		log("        Overwrite replaced cells in the current selection with new $_AND_,\n");
 		log("        $_NOT_, and $_NAND_, cells\n");
-
+		log("\n");
+		log("The modules are mapped concurrently when yosys is run with multiple threads\n");
+		log("(yosys -j). The gates of a module are added in one batch, with room for them\n");
+		log("reserved up front.\n");
 		log("\n");
 	}
-	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
+	RTLIL::Design *design;
+	bool nand_mode, select_mode;
+	std::map<IdString, pool<Cell*>> new_selections;
+
+	void execute_module(RTLIL::Module *module) YS_OVERRIDE
 	{
-		bool nand_mode = false, select_mode = false;
+		vector<Cell*> replaced_cells;
+		int not_replaced_count = 0;
+		dict<IdString, int> stat_replaced;
+		dict<IdString, int> stat_not_replaced;
+		int orig_num_cells = GetSize(module->cells());
+
+		std::vector<Cell*> cells = module->selected_cells();
+		std::vector<Aig> aigs;
+		int num_nodes = 0;
+		for (auto cell : cells) {
+			aigs.emplace_back(cell);
+			num_nodes += GetSize(aigs.back().nodes);
+		}
 
-		log_header(design, "Executing AIGMAP pass (map logic to AIG).\n");
+		// make room for the gates up front, there is at most about one gate and
+		// one wire per AIG node
+		module->cells_.reserve(GetSize(module->cells_) + num_nodes);
+		module->wires_.reserve(GetSize(module->wires_) + num_nodes);
 
-		size_t argidx;
-		for (argidx = 1; argidx < args.size(); argidx++)
-		{
-			if (args[argidx] == "-nand") {
-				nand_mode = true;
-				continue;
-			}
-			if (args[argidx] == "-select") {
-				select_mode = true;
-				continue;
-			}
-			break;
-		}
-		extra_args(args, argidx, design);
+		RTLIL::Module::Batch batch(module);
 
-		for (auto module : design->selected_modules())
+		pool<Cell*> new_sel;
+		for (int i = 0; i < GetSize(cells); i++)
 		{
-			vector<Cell*> replaced_cells;
-			int not_replaced_count = 0;
-			dict<IdString, int> stat_replaced;
-			dict<IdString, int> stat_not_replaced;
-			int orig_num_cells = GetSize(module->cells());
-
-			pool<IdString> new_sel;
-			for (auto cell : module->selected_cells())
-			{
-				Aig aig(cell);
+			Cell *cell = cells[i];
+			Aig &aig = aigs[i];
 
-				if (cell->type.in(ID($_AND_), ID($_NOT_)))
-					aig.name.clear();
+			if (cell->type.in(ID($_AND_), ID($_NOT_)))
+				aig.name.clear();
 
-				if (nand_mode && cell->type == ID($_NAND_))
-					aig.name.clear();
+			if (nand_mode && cell->type == ID($_NAND_))
+				aig.name.clear();
 
-				if (aig.name.empty()) {
-					not_replaced_count++;
-					stat_not_replaced[cell->type]++;
-					if (select_mode)
-						new_sel.insert(cell->name);
-					continue;
-				}
+			if (aig.name.empty()) {
+				not_replaced_count++;
+				stat_not_replaced[cell->type]++;
+				if (select_mode)
+					new_sel.insert(cell);
+				continue;
+			}
 
-				vector<SigBit> sigs;
-				dict<pair<int, int>, SigBit> and_cache;
+			vector<SigBit> sigs;
+			dict<pair<int, int>, SigBit> and_cache;
 
-				for (int node_idx = 0; node_idx < GetSize(aig.nodes); node_idx++)
-				{
-					SigBit bit;
-					auto &node = aig.nodes[node_idx];
+			for (int node_idx = 0; node_idx < GetSize(aig.nodes); node_idx++)
+			{
+				SigBit bit;
+				auto &node = aig.nodes[node_idx];
+
+				if (node.portbit >= 0) {
+					bit = cell->getPort(node.portname)[node.portbit];
+				} else if (node.left_parent < 0 && node.right_parent < 0) {
+					bit = node.inverter ? State::S1 : State::S0;
+					goto skip_inverter;
+				} else {
+					SigBit A = sigs.at(node.left_parent);
+					SigBit B = sigs.at(node.right_parent);
+					if (nand_mode && node.inverter) {
+						bit = module->addWire(NEW_ID);
+						auto gate = module->addNandGate(NEW_ID, A, B, bit);
+						if (select_mode)
+							new_sel.insert(gate);
 
-					if (node.portbit >= 0) {
-						bit = cell->getPort(node.portname)[node.portbit];
-					} else if (node.left_parent < 0 && node.right_parent < 0) {
-						bit = node.inverter ? State::S1 : State::S0;
 						goto skip_inverter;
 					} else {
-						SigBit A = sigs.at(node.left_parent);
-						SigBit B = sigs.at(node.right_parent);
-						if (nand_mode && node.inverter) {
+						pair<int, int> key(node.left_parent, node.right_parent);
+						if (and_cache.count(key))
+							bit = and_cache.at(key);
+						else {
 							bit = module->addWire(NEW_ID);
-							auto gate = module->addNandGate(NEW_ID, A, B, bit);
+							auto gate = module->addAndGate(NEW_ID, A, B, bit);
 							if (select_mode)
-								new_sel.insert(gate->name);
-
-							goto skip_inverter;
-						} else {
-							pair<int, int> key(node.left_parent, node.right_parent);
-							if (and_cache.count(key))
-								bit = and_cache.at(key);
-							else {
-								bit = module->addWire(NEW_ID);
-								auto gate = module->addAndGate(NEW_ID, A, B, bit);
-								if (select_mode)
-									new_sel.insert(gate->name);
-							}
+								new_sel.insert(gate);
 						}
 					}
+				}
 
-					if (node.inverter) {
-						SigBit new_bit = module->addWire(NEW_ID);
-						auto gate = module->addNotGate(NEW_ID, bit, new_bit);
-						bit = new_bit;
-						if (select_mode)
-							new_sel.insert(gate->name);
-
-					}
-
-				skip_inverter:
-					for (auto &op : node.outports)
-						module->connect(cell->getPort(op.first)[op.second], bit);
+				if (node.inverter) {
+					SigBit new_bit = module->addWire(NEW_ID);
+					auto gate = module->addNotGate(NEW_ID, bit, new_bit);
+					bit = new_bit;
+					if (select_mode)
+						new_sel.insert(gate);
 
-					sigs.push_back(bit);
 				}
 
-				replaced_cells.push_back(cell);
-				stat_replaced[cell->type]++;
+			skip_inverter:
+				for (auto &op : node.outports)
+					module->connect(cell->getPort(op.first)[op.second], bit);
+
+				sigs.push_back(bit);
 			}
 
-			if (not_replaced_count == 0 && replaced_cells.empty())
-				continue;
+			replaced_cells.push_back(cell);
+			stat_replaced[cell->type]++;
+		}
 
-			log("Module %s: replaced %d cells with %d new cells, skipped %d cells.\n", log_id(module),
-					GetSize(replaced_cells), GetSize(module->cells()) - orig_num_cells, not_replaced_count);
+		if (not_replaced_count == 0 && replaced_cells.empty())
+			return;
 
-			if (!stat_replaced.empty()) {
-				stat_replaced.sort();
-				log("  replaced %d cell types:\n", GetSize(stat_replaced));
-				for (auto &it : stat_replaced)
-					log("%8d %s\n", it.second, log_id(it.first));
-			}
+		log("Module %s: replaced %d cells with %d new cells, skipped %d cells.\n", log_id(module),
+				GetSize(replaced_cells), GetSize(module->cells()) - orig_num_cells, not_replaced_count);
 
-			if (!stat_not_replaced.empty()) {
-				stat_not_replaced.sort();
-				log("  not replaced %d cell types:\n", GetSize(stat_not_replaced));
-				for (auto &it : stat_not_replaced)
-					log("%8d %s\n", it.second, log_id(it.first));
-			}
+		if (!stat_replaced.empty()) {
+			stat_replaced.sort();
+			log("  replaced %d cell types:\n", GetSize(stat_replaced));
+			for (auto &it : stat_replaced)
+				log("%8d %s\n", it.second, log_id(it.first));
+		}
 
-			for (auto cell : replaced_cells)
-				module->remove(cell);
+		if (!stat_not_replaced.empty()) {
+			stat_not_replaced.sort();
+			log("  not replaced %d cell types:\n", GetSize(stat_not_replaced));
+			for (auto &it : stat_not_replaced)
+				log("%8d %s\n", it.second, log_id(it.first));
+		}
+
+		for (auto cell : replaced_cells)
+			module->remove(cell);
+
+		if (select_mode)
+			new_selections.at(module->name) = std::move(new_sel);
+	}
 
-			if (select_mode) {
-				log_assert(!design->selection_stack.empty());
-				RTLIL::Selection& sel = design->selection_stack.back();
-				sel.selected_members[module->name] = std::move(new_sel);
+	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
+	{
+		this->design = design;
+		nand_mode = false;
+		select_mode = false;
+
+		log_header(design, "Executing AIGMAP pass (map logic to AIG).\n");
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-nand") {
+				nand_mode = true;
+				continue;
 			}
+			if (args[argidx] == "-select") {
+				select_mode = true;
+				continue;
+			}
+			break;
+		}
+		extra_args(args, argidx, design);
 
+		// the selection is only changed after all modules are done, as it is
+		// read by the workers, and the new gates only get their final names
+		// at that point. the entries are created up front, so that the
+		// modules can store their gates concurrently without changing the map
+		new_selections.clear();
+		if (select_mode)
+			for (auto module : design->selected_modules())
+				new_selections[module->name];
+		execute_modules(design);
+
+		if (select_mode) {
+			log_assert(!design->selection_stack.empty());
+			RTLIL::Selection& sel = design->selection_stack.back();
+			for (auto &it : new_selections) {
+				pool<IdString> &members = sel.selected_members[it.first];
+				members.clear();
+				for (auto cell : it.second)
+					members.insert(cell->name);
+			}
 		}
+		new_selections.clear();
 	}
 } AigmapPass;
 
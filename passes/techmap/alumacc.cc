@@ -222,58 +222,164 @@ struct AlumaccWorker
 		return acc_shift > width;
 	}
 
-	void merge_macc()
+	// Flattens the ports of a node and the nodes merged into it, with the
+	// subtract flags relative to the node.
+	void get_merged_ports(std::vector<Macc::port_t> &ports, const std::vector<maccnode_t*> &nodes,
+			const std::vector<std::vector<int>> &port_nodes, const std::vector<int> &merged_into, int index, bool do_subtract)
 	{
-		while (1)
+		std::vector<std::pair<int, bool>> queue;
+		queue.push_back(std::make_pair(index, do_subtract));
+
+		while (!queue.empty())
 		{
-			pool<maccnode_t*, hash_ptr_ops> delete_nodes;
+			int node = queue.back().first;
+			bool invert = queue.back().second;
+			queue.pop_back();
+
+			for (int i = 0; i < GetSize(nodes[node]->macc.ports); i++) {
+				auto &port = nodes[node]->macc.ports[i];
+				int child = port_nodes[node][i];
+				if (child >= 0 && merged_into[child] == node) {
+					queue.push_back(std::make_pair(child, invert != port.do_subtract));
+					continue;
+				}
+				ports.push_back(port);
+				if (invert)
+					ports.back().do_subtract = !ports.back().do_subtract;
+			}
+		}
+	}
 
-			for (auto &it : sig_macc)
-			{
-				auto n = it.second;
+	void merge_macc()
+	{
+		// Index the nodes and find the node driving each port. A node with
+		// a single user is merged into that user. The merge decisions are
+		// made bottom-up, so the overflow check sees the final ports of the
+		// node being merged, and then the ports of each remaining node are
+		// collected top-down. Each port is only moved once.
+
+		std::vector<maccnode_t*> nodes;
+		dict<maccnode_t*, int, hash_ptr_ops> node_index;
+
+		for (auto &it : sig_macc) {
+			node_index[it.second] = GetSize(nodes);
+			nodes.push_back(it.second);
+		}
 
-				if (delete_nodes.count(n))
-					continue;
+		std::vector<std::vector<int>> port_nodes(GetSize(nodes));
 
-				for (int i = 0; i < GetSize(n->macc.ports); i++)
-				{
-					auto &port = n->macc.ports[i];
+		for (int k = 0; k < GetSize(nodes); k++)
+			for (auto &port : nodes[k]->macc.ports) {
+				int child = -1;
+				if (GetSize(port.in_b) == 0) {
+					auto it = sig_macc.find(port.in_a);
+					if (it != sig_macc.end() && it->second->users <= 1)
+						child = node_index.at(it->second);
+				}
+				port_nodes[k].push_back(child);
+			}
 
-					if (GetSize(port.in_b) > 0 || sig_macc.count(port.in_a) == 0)
-						continue;
+		std::vector<int> merged_into(GetSize(nodes), -1);
+		std::vector<int> state(GetSize(nodes), 0);
 
-					auto other_n = sig_macc.at(port.in_a);
+		for (int root = 0; root < GetSize(nodes); root++)
+		{
+			if (state[root] != 0)
+				continue;
 
-					if (other_n->users > 1)
-						continue;
+			// iterative post-order walk, state 1 marks nodes on the stack
+			std::vector<std::pair<int, int>> stack;
+			stack.push_back(std::make_pair(root, 0));
+			state[root] = 1;
 
-					if (GetSize(other_n->y) != GetSize(n->y) && macc_may_overflow(other_n->macc, GetSize(other_n->y), port.is_signed))
+			while (!stack.empty())
+			{
+				int k = stack.back().first;
+				int &next_port = stack.back().second;
+
+				if (next_port < GetSize(port_nodes[k])) {
+					int child = port_nodes[k][next_port++];
+					if (child >= 0 && state[child] == 0) {
+						state[child] = 1;
+						stack.push_back(std::make_pair(child, 0));
+					}
+					continue;
+				}
+
+				maccnode_t *n = nodes[k];
+
+				for (int i = 0; i < GetSize(port_nodes[k]); i++)
+				{
+					int child = port_nodes[k][i];
+
+					if (child < 0 || state[child] != 2 || merged_into[child] >= 0)
 						continue;
 
-					log("  merging $macc model for %s into %s.\n", log_id(other_n->cell), log_id(n->cell));
+					maccnode_t *other_n = nodes[child];
 
-					bool do_subtract = port.do_subtract;
-					for (int j = 0; j < GetSize(other_n->macc.ports); j++) {
-						if (do_subtract)
-							other_n->macc.ports[j].do_subtract = !other_n->macc.ports[j].do_subtract;
-						if (j == 0)
-							n->macc.ports[i--] = other_n->macc.ports[j];
-						else
-							n->macc.ports.push_back(other_n->macc.ports[j]);
+					if (GetSize(other_n->y) != GetSize(n->y)) {
+						Macc merged_macc;
+						get_merged_ports(merged_macc.ports, nodes, port_nodes, merged_into, child, false);
+						if (macc_may_overflow(merged_macc, GetSize(other_n->y), n->macc.ports[i].is_signed))
+							continue;
 					}
 
-					delete_nodes.insert(other_n);
+					merged_into[child] = k;
 				}
+
+				state[k] = 2;
+				stack.pop_back();
 			}
+		}
+
+		for (int k = 0; k < GetSize(nodes); k++)
+		{
+			if (merged_into[k] >= 0)
+				continue;
+
+			maccnode_t *n = nodes[k];
+			auto &ports = n->macc.ports;
+			std::vector<int> children;
+
+			for (int child : port_nodes[k])
+				children.push_back(child >= 0 && merged_into[child] == k ? child : -1);
+
+			for (int i = 0; i < GetSize(ports); i++)
+			{
+				int child = children[i];
+				if (child < 0)
+					continue;
 
-			if (delete_nodes.empty())
-				break;
+				maccnode_t *other_n = nodes[child];
+				log("  merging $macc model for %s into %s.\n", log_id(other_n->cell), log_id(n->cell));
+
+				bool do_subtract = ports[i].do_subtract;
+				for (int j = 0; j < GetSize(other_n->macc.ports); j++) {
+					Macc::port_t port = std::move(other_n->macc.ports[j]);
+					int grandchild = port_nodes[child][j];
+					if (grandchild >= 0 && merged_into[grandchild] != child)
+						grandchild = -1;
+					if (do_subtract)
+						port.do_subtract = !port.do_subtract;
+					if (j == 0) {
+						ports[i] = std::move(port);
+						children[i] = grandchild;
+					} else {
+						ports.push_back(std::move(port));
+						children.push_back(grandchild);
+					}
+				}
 
-			for (auto n : delete_nodes) {
-				sig_macc.erase(n->y);
-				delete n;
+				// check the port at this position again
+				i--;
 			}
 		}
+
+		for (int k = 0; k < GetSize(nodes); k++)
+			if (merged_into[k] >= 0) {
+				sig_macc.erase(nodes[k]->y);
+				delete nodes[k];
+			}
 	}
 
 	void macc_to_alu()
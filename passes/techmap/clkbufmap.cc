@@ -20,6 +20,7 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
+#include "kernel/portindex.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -112,12 +113,19 @@ struct ClkbufmapPass : public Pass {
 		if (buf_celltype.empty())
 			log_error("The -buf option is required.\n");
 
+		auto id = [](const std::string &name) -> IdString { return name.empty() ? IdString() : RTLIL::escape_id(name); };
+		IdString buf_type = id(buf_celltype), buf_port = id(buf_portname), buf_port2 = id(buf_portname2);
+		IdString inpad_type = id(inpad_celltype), inpad_port = id(inpad_portname), inpad_port2 = id(inpad_portname2);
+
 		// Cell type, port name, bit index.
 		pool<pair<IdString, pair<IdString, int>>> sink_ports;
 		pool<pair<IdString, pair<IdString, int>>> buf_ports;
 		dict<pair<IdString, pair<IdString, int>>, pair<IdString, int>> inv_ports_out;
 		dict<pair<IdString, pair<IdString, int>>, pair<IdString, int>> inv_ports_in;
 
+		// Cell types with entries in the tables above.
+		pool<IdString> clkbuf_types, inv_types;
+
 		// Process submodules before module using them.
 		std::vector<Module *> modules_sorted;
 		pool<Module *> modules_processed;
@@ -126,6 +134,9 @@ struct ClkbufmapPass : public Pass {
 
 		for (auto module : modules_sorted)
 		{
+			// Ports of this module may become sinks or buffers below.
+			clkbuf_types.insert(module->name);
+
 			if (module->get_blackbox_attribute()) {
 				for (auto port : module->ports) {
 					auto wire = module->wire(port);
@@ -138,6 +149,7 @@ struct ClkbufmapPass : public Pass {
 					auto it = wire->attributes.find("\\clkbuf_inv");
 					if (it != wire->attributes.end()) {
 						IdString in_name = RTLIL::escape_id(it->second.decode_string());
+						inv_types.insert(module->name);
 						for (int i = 0; i < GetSize(wire); i++) {
 							inv_ports_out[make_pair(module->name, make_pair(wire->name, i))] = make_pair(in_name, i);
 							inv_ports_in[make_pair(module->name, make_pair(in_name, i))] = make_pair(wire->name, i);
@@ -146,32 +158,42 @@ struct ClkbufmapPass : public Pass {
 				}
 				continue;
 			}
+			RTLIL::Module::Batch batch(module);
+			PortBitIndex index;
+			index.setup(module);
 			pool<SigBit> sink_wire_bits;
 			pool<SigBit> buf_wire_bits;
-			pool<SigBit> driven_wire_bits;
 			SigMap sigmap(module);
 			// bit -> (buffer, buffer's input)
 			dict<SigBit, pair<Cell *, Wire *>> buffered_bits;
 
-			// First, collect nets that could use a clock buffer.
-			for (auto cell : module->cells())
-			for (auto port : cell->connections())
-			for (int i = 0; i < port.second.size(); i++)
-				if (sink_ports.count(make_pair(cell->type, make_pair(port.first, i))))
-					sink_wire_bits.insert(sigmap(port.second[i]));
+			// Only cells of the types that have sink, buffer or inverter
+			// ports need to be looked at.
+			std::vector<Cell *> clkbuf_cells, inv_cells;
+			for (auto &it : index.type_cells) {
+				if (clkbuf_types.count(it.first))
+					clkbuf_cells.insert(clkbuf_cells.end(), it.second.begin(), it.second.end());
+				if (inv_types.count(it.first))
+					inv_cells.insert(inv_cells.end(), it.second.begin(), it.second.end());
+			}
 
+			// First, collect nets that could use a clock buffer.
 			// Second, collect ones that already have a clock buffer.
-			for (auto cell : module->cells())
+			for (auto cell : clkbuf_cells)
 			for (auto port : cell->connections())
-			for (int i = 0; i < port.second.size(); i++)
-				if (buf_ports.count(make_pair(cell->type, make_pair(port.first, i))))
+			for (int i = 0; i < port.second.size(); i++) {
+				auto key = make_pair(cell->type, make_pair(port.first, i));
+				if (sink_ports.count(key))
+					sink_wire_bits.insert(sigmap(port.second[i]));
+				if (buf_ports.count(key))
 					buf_wire_bits.insert(sigmap(port.second[i]));
+			}
 
 			// Third, propagate tags through inverters.
 			bool retry = true;
 			while (retry) {
 				retry = false;
-				for (auto cell : module->cells())
+				for (auto cell : inv_cells)
 				for (auto port : cell->connections())
 				for (int i = 0; i < port.second.size(); i++) {
 					auto it = inv_ports_out.find(make_pair(cell->type, make_pair(port.first, i)));
@@ -198,13 +220,6 @@ struct ClkbufmapPass : public Pass {
 				}
 			};
 
-			// Collect all driven bits.
-			for (auto cell : module->cells())
-			for (auto port : cell->connections())
-				if (cell->output(port.first))
-					for (int i = 0; i < port.second.size(); i++)
-						driven_wire_bits.insert(port.second[i]);
-
 			// Insert buffers.
 			std::vector<pair<Wire *, Wire *>> input_queue;
 			// Copy current wire list, as we will be adding new ones during iteration.
@@ -238,21 +253,21 @@ struct ClkbufmapPass : public Pass {
 							buf_ports.insert(make_pair(module->name, make_pair(wire->name, i)));
 					} else if (!sink_wire_bits.count(mapped_wire_bit)) {
 						// Nothing to do.
-					} else if (driven_wire_bits.count(wire_bit) || (wire->port_input && module->get_bool_attribute("\\top"))) {
+					} else if (index.drivers(wire_bit) || (wire->port_input && module->get_bool_attribute("\\top"))) {
 						// Clock network not yet buffered, driven by one of
 						// our cells or a top-level input -- buffer it.
 
 						log("Inserting %s on %s.%s[%d].\n", buf_celltype.c_str(), log_id(module), log_id(wire), i);
-						RTLIL::Cell *cell = module->addCell(NEW_ID, RTLIL::escape_id(buf_celltype));
+						RTLIL::Cell *cell = module->addCell(NEW_ID, buf_type);
 						Wire *iwire = module->addWire(NEW_ID);
-						cell->setPort(RTLIL::escape_id(buf_portname), mapped_wire_bit);
-						cell->setPort(RTLIL::escape_id(buf_portname2), iwire);
+						cell->setPort(buf_port, mapped_wire_bit);
+						cell->setPort(buf_port2, iwire);
 						if (wire->port_input && !inpad_celltype.empty() && module->get_bool_attribute("\\top")) {
 							log("Inserting %s on %s.%s[%d].\n", inpad_celltype.c_str(), log_id(module), log_id(wire), i);
-							RTLIL::Cell *cell2 = module->addCell(NEW_ID, RTLIL::escape_id(inpad_celltype));
-							cell2->setPort(RTLIL::escape_id(inpad_portname), iwire);
+							RTLIL::Cell *cell2 = module->addCell(NEW_ID, inpad_type);
+							cell2->setPort(inpad_port, iwire);
 							iwire = module->addWire(NEW_ID);
-							cell2->setPort(RTLIL::escape_id(inpad_portname2), iwire);
+							cell2->setPort(inpad_port2, iwire);
 						}
 						buffered_bits[mapped_wire_bit] = make_pair(cell, iwire);
 
@@ -270,18 +285,18 @@ struct ClkbufmapPass : public Pass {
 					// This is an input port and some buffers were inserted -- we need
 					// to create a new input wire and transfer attributes.
 					Wire *new_wire = module->addWire(NEW_ID, wire);
+					SigSpec lhs;
 
 					for (int i = 0; i < wire->width; i++) {
 						SigBit wire_bit(wire, i);
 						SigBit mapped_wire_bit = sigmap(wire_bit);
 						auto it = buffered_bits.find(mapped_wire_bit);
-						if (it != buffered_bits.end()) {
-
-							module->connect(it->second.second, SigSpec(new_wire, i));
-						} else {
-							module->connect(SigSpec(wire, i), SigSpec(new_wire, i));
-						}
+						if (it != buffered_bits.end())
+							lhs.append(it->second.second);
+						else
+							lhs.append(wire_bit);
 					}
+					module->connect(lhs, new_wire);
 					input_queue.push_back(make_pair(wire, new_wire));
 				}
 			}
@@ -19,7 +19,7 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
-#include "kernel/celltypes.h"
+#include "kernel/ffindex.h"
 #include "passes/techmap/simplemap.h"
 
 USING_YOSYS_NAMESPACE
@@ -30,46 +30,29 @@ struct Dff2dffeWorker
 	const dict<IdString, IdString> &direct_dict;
 
 	RTLIL::Module *module;
-	SigMap sigmap;
-	CellTypes ct;
+	FfIndex ff_index;
+	SigMap &sigmap;
 
 	typedef std::pair<RTLIL::Cell*, int> cell_int_t;
-	std::map<RTLIL::SigBit, cell_int_t> bit2mux;
 	std::vector<RTLIL::Cell*> dff_cells;
-	std::map<RTLIL::SigBit, int> bitusers;
 
 	typedef std::map<RTLIL::SigBit, bool> pattern_t;
 	typedef std::set<pattern_t> patterns_t;
 
 
 	Dff2dffeWorker(RTLIL::Module *module, const dict<IdString, IdString> &direct_dict) :
-			direct_dict(direct_dict), module(module), sigmap(module), ct(module->design)
+			direct_dict(direct_dict), module(module), ff_index(module), sigmap(ff_index.sigmap)
 	{
-		for (auto wire : module->wires()) {
-			if (wire->port_output)
-				for (auto bit : sigmap(wire))
-					bitusers[bit]++;
-		}
-
-		for (auto cell : module->cells()) {
-			if (cell->type.in(ID($mux), ID($pmux), ID($_MUX_))) {
-				RTLIL::SigSpec sig_y = sigmap(cell->getPort(ID::Y));
-				for (int i = 0; i < GetSize(sig_y); i++)
-					bit2mux[sig_y[i]] = cell_int_t(cell, i);
-			}
-			if (direct_dict.empty()) {
+		if (direct_dict.empty()) {
+			for (auto cell : ff_index.ff_cells)
 				if (cell->type.in(ID($dff), ID($_DFF_N_), ID($_DFF_P_)))
 					dff_cells.push_back(cell);
-			} else {
+		} else {
+			// -direct-match also accepts $__DFFS_* cells, which are not
+			// internal flip-flop types
+			for (auto cell : module->cells())
 				if (direct_dict.count(cell->type))
 					dff_cells.push_back(cell);
-			}
-			for (auto conn : cell->connections()) {
-				if (ct.cell_output(cell->type, conn.first))
-					continue;
-				for (auto bit : sigmap(conn.second))
-					bitusers[bit]++;
-			}
 		}
 	}
 
@@ -82,10 +65,10 @@ struct Dff2dffeWorker
 			return ret;
 		}
 
-		if (bit2mux.count(d) == 0 || bitusers[d] > 1)
+		if (ff_index.bit2mux.count(d) == 0 || ff_index.bitusers.at(d, 0) > 1)
 			return ret;
 
-		cell_int_t mux_cell_int = bit2mux.at(d);
+		cell_int_t mux_cell_int = ff_index.bit2mux.at(d);
 		RTLIL::SigSpec sig_a = sigmap(mux_cell_int.first->getPort(ID::A));
 		RTLIL::SigSpec sig_b = sigmap(mux_cell_int.first->getPort(ID::B));
 		RTLIL::SigSpec sig_s = sigmap(mux_cell_int.first->getPort(ID(S)));
@@ -354,19 +337,22 @@ struct Dff2dffePass : public Pass {
 			{
 				if (unmap_mode) {
 					SigMap sigmap(mod);
+
+					// the number of cells of each type using each enable signal,
+					// counted once instead of for every cell
+					dict<std::pair<IdString, SigSpec>, int> ce_use;
+					if (min_ce_use >= 0)
+						for (auto cell : mod->selected_cells()) {
+							if (cell->type == ID($dffe))
+								ce_use[std::make_pair(cell->type, sigmap(cell->getPort(ID(EN))))]++;
+							else if (cell->type.begins_with("$_DFFE_"))
+								ce_use[std::make_pair(cell->type, sigmap(cell->getPort(ID(E))))]++;
+						}
+
 					for (auto cell : mod->selected_cells()) {
 						if (cell->type == ID($dffe)) {
-							if (min_ce_use >= 0) {
-								int ce_use = 0;
-								for (auto cell_other : mod->selected_cells()) {
-									if (cell_other->type != cell->type)
-										continue;
-									if (sigmap(cell->getPort(ID(EN))) == sigmap(cell_other->getPort(ID(EN))))
-										ce_use++;
-								}
-								if (ce_use >= min_ce_use)
-									continue;
-							}
+							if (min_ce_use >= 0 && ce_use.at(std::make_pair(cell->type, sigmap(cell->getPort(ID(EN))))) >= min_ce_use)
+								continue;
 
 							RTLIL::SigSpec tmp = mod->addWire(NEW_ID, GetSize(cell->getPort(ID(D))));
 							mod->addDff(NEW_ID, cell->getPort(ID(CLK)), tmp, cell->getPort(ID(Q)), cell->getParam(ID(CLK_POLARITY)).as_bool());
@@ -378,17 +364,8 @@ struct Dff2dffePass : public Pass {
 							continue;
 						}
 						if (cell->type.begins_with("$_DFFE_")) {
-							if (min_ce_use >= 0) {
-								int ce_use = 0;
-								for (auto cell_other : mod->selected_cells()) {
-									if (cell_other->type != cell->type)
-										continue;
-									if (sigmap(cell->getPort(ID(E))) == sigmap(cell_other->getPort(ID(E))))
-										ce_use++;
-								}
-								if (ce_use >= min_ce_use)
-									continue;
-							}
+							if (min_ce_use >= 0 && ce_use.at(std::make_pair(cell->type, sigmap(cell->getPort(ID(E))))) >= min_ce_use)
+								continue;
 
 							bool clk_pol = cell->type.compare(7, 1, "P") == 0;
 							bool en_pol = cell->type.compare(8, 1, "P") == 0;
@@ -134,13 +134,13 @@ struct DffinitPass : public Pass {
 					for (int i = 0; i < GetSize(sig); i++) {
 						if (init_bits.count(sig[i]) == 0)
 							continue;
-						while (GetSize(value.bits) <= i)
-							value.bits.push_back(State::S0);
-						if (noreinit && value.bits[i] != State::Sx && value.bits[i] != init_bits.at(sig[i]))
+						while (GetSize(value) <= i)
+							value.bits().push_back(State::S0);
+						if (noreinit && value[i] != State::Sx && value[i] != init_bits.at(sig[i]))
 							log_error("Trying to assign a different init value for %s.%s.%s which technically "
 									"have a conflicted init value.\n",
 									log_id(module), log_id(cell), log_id(it.second));
-						value.bits[i] = init_bits.at(sig[i]);
+						value.bits()[i] = init_bits.at(sig[i]);
 						cleanup_bits.insert(sig[i]);
 					}
 
@@ -167,7 +167,7 @@ struct DffinitPass : public Pass {
 					for (int i = 0; i < min(GetSize(value), GetSize(wire)); i++) {
 						SigBit bit = sigmap(SigBit(wire, i));
 						if (cleanup_bits.count(bit) || !used_bits.count(bit))
-							value[i] = State::Sx;
+							value.bits()[i] = State::Sx;
 						else if (value[i] != State::Sx)
 							do_cleanup = false;
 					}
@@ -32,6 +32,46 @@ struct cell_mapping {
 };
 static std::map<RTLIL::IdString, cell_mapping> cell_mappings;
 
+// The final cell_mappings with the port names resolved to IdStrings, so that
+// the cells can be mapped without any string operations. The set of mapped
+// types does not change while mapping, only the counts do.
+struct compiled_port {
+	IdString name, source;
+	char kind;
+};
+struct compiled_mapping {
+	IdString cell_name;
+	std::vector<compiled_port> ports;
+	bool has_q, has_qn;
+	int count;
+};
+static frozen_dict<RTLIL::IdString, compiled_mapping> compiled_mappings;
+
+static void compile_mappings()
+{
+	dict<RTLIL::IdString, compiled_mapping> mappings;
+	for (auto &it : cell_mappings) {
+		compiled_mapping &cm = mappings[it.first];
+		cm.cell_name = it.second.cell_name;
+		cm.has_q = false;
+		cm.has_qn = false;
+		cm.count = 0;
+		for (auto &port : it.second.ports) {
+			compiled_port cp;
+			cp.name = "\\" + port.first;
+			cp.kind = port.second;
+			if ('A' <= port.second && port.second <= 'Z')
+				cp.source = std::string("\\") + port.second;
+			if ('a' <= port.second && port.second <= 'z')
+				cp.source = std::string("\\") + char(port.second - ('a' - 'A'));
+			if (port.second == 'Q') cm.has_q = true;
+			if (port.second == 'q') cm.has_qn = true;
+			cm.ports.push_back(cp);
+		}
+	}
+	compiled_mappings = frozen_dict<RTLIL::IdString, compiled_mapping>(mappings);
+}
+
 static void logmap(IdString dff)
 {
 	if (cell_mappings.count(dff) == 0) {
@@ -473,7 +513,7 @@ static void map_adff_to_dff(IdString from, IdString to)
 	}
 }
 
-static void dfflibmap(RTLIL::Design *design, RTLIL::Module *module, bool prepare_mode)
+static void dfflibmap(RTLIL::Design *design, RTLIL::Module *module)
 {
 	log("Mapping DFF cells in module `%s':\n", module->name.c_str());
 
@@ -481,43 +521,50 @@ static void dfflibmap(RTLIL::Design *design, RTLIL::Module *module, bool prepare
 	SigMap sigmap(module);
 
 	std::vector<RTLIL::Cell*> cell_list;
+	cell_list.reserve(GetSize(module->cells_));
 	for (auto &it : module->cells_) {
-		if (design->selected(module, it.second) && cell_mappings.count(it.second->type) > 0)
+		if (design->selected(module, it.second) && compiled_mappings.count(it.second->type) > 0)
 			cell_list.push_back(it.second);
 		if (it.second->type == ID($_NOT_))
 			notmap[sigmap(it.second->getPort(ID::A))].insert(it.second);
 	}
 
-	std::map<std::string, int> stats;
+	// The cells are converted in place: the type is changed and the ports are
+	// reconnected, so the cell objects, their names and the signals of the
+	// ports that are kept are reused.
+	std::vector<std::pair<IdString, RTLIL::SigSpec>> old_connections;
 	for (auto cell : cell_list)
 	{
-		auto cell_type = cell->type;
-		auto cell_name = cell->name;
-		auto cell_connections = cell->connections();
-		std::string src = cell->get_src_attribute();
-
-		module->remove(cell);
+		compiled_mapping &cm = compiled_mappings.at(cell->type);
 
-		cell_mapping &cm = cell_mappings[cell_type];
-		RTLIL::Cell *new_cell = module->addCell(cell_name, prepare_mode ? cm.cell_name : cm.cell_name);
+		old_connections.clear();
+		for (auto &conn : cell->connections())
+			old_connections.push_back(conn);
+		for (auto &conn : old_connections)
+			cell->unsetPort(conn.first);
 
-		new_cell->set_src_attribute(src);
+		auto old_port = [&](IdString name) -> RTLIL::SigSpec {
+			for (auto &conn : old_connections)
+				if (conn.first == name)
+					return conn.second;
+			return RTLIL::SigSpec();
+		};
 
-		bool has_q = false, has_qn = false;
-		for (auto &port : cm.ports) {
-			if (port.second == 'Q') has_q = true;
-			if (port.second == 'q') has_qn = true;
-		}
+		std::string src = cell->get_src_attribute();
+		cell->attributes.clear();
+		cell->parameters.clear();
+		cell->set_src_attribute(src);
+		cell->type = cm.cell_name;
 
 		for (auto &port : cm.ports) {
 			RTLIL::SigSpec sig;
-			if ('A' <= port.second && port.second <= 'Z') {
-				sig = cell_connections[std::string("\\") + port.second];
+			if ('A' <= port.kind && port.kind <= 'Z') {
+				sig = old_port(port.source);
 			} else
-			if (port.second == 'q') {
-				RTLIL::SigSpec old_sig = cell_connections[std::string("\\") + char(port.second - ('a' - 'A'))];
+			if (port.kind == 'q') {
+				RTLIL::SigSpec old_sig = old_port(port.source);
 				sig = module->addWire(NEW_ID, GetSize(old_sig));
-				if (has_q && has_qn) {
+				if (cm.has_q && cm.has_qn) {
 					for (auto &it : notmap[sigmap(old_sig)]) {
 						module->connect(it->getPort(ID::Y), sig);
 						it->setPort(ID::Y, module->addWire(NEW_ID, GetSize(old_sig)));
@@ -526,23 +573,29 @@ static void dfflibmap(RTLIL::Design *design, RTLIL::Module *module, bool prepare
 					module->addNotGate(NEW_ID, sig, old_sig);
 				}
 			} else
-			if ('a' <= port.second && port.second <= 'z') {
-				sig = cell_connections[std::string("\\") + char(port.second - ('a' - 'A'))];
-				sig = module->NotGate(NEW_ID, sig);
+			if ('a' <= port.kind && port.kind <= 'z') {
+				sig = module->NotGate(NEW_ID, old_port(port.source));
 			} else
-			if (port.second == '0' || port.second == '1') {
-				sig = RTLIL::SigSpec(port.second == '0' ? 0 : 1, 1);
+			if (port.kind == '0' || port.kind == '1') {
+				sig = RTLIL::SigSpec(port.kind == '0' ? 0 : 1, 1);
 			} else
-			if (port.second == 0) {
+			if (port.kind == 0) {
 				sig = module->addWire(NEW_ID);
 			} else
 				log_abort();
-			new_cell->setPort("\\" + port.first, sig);
+			cell->setPort(port.name, std::move(sig));
 		}
 
-		stats[stringf("  mapped %%d %s cells to %s cells.\n", cell_type.c_str(), new_cell->type.c_str())]++;
+		cm.count++;
 	}
 
+	std::map<std::string, int> stats;
+	for (auto &it : compiled_mappings)
+		if (it.second.count > 0) {
+			stats[stringf("  mapped %%d %s cells to %s cells.\n", it.first.c_str(), it.second.cell_name.c_str())] = it.second.count;
+			it.second.count = 0;
+		}
+
 	for (auto &stat: stats)
 		log(stat.first.c_str(), stat.second);
 }
@@ -592,33 +645,46 @@ struct DfflibmapPass : public Pass {
 		if (liberty_file.empty())
 			log_cmd_error("Missing `-liberty liberty_file' option!\n");
 
-		std::ifstream f;
-		f.open(liberty_file.c_str());
-		if (f.fail())
-			log_cmd_error("Can't open liberty file `%s': %s\n", liberty_file.c_str(), strerror(errno));
-		LibertyParser libparser(f);
-		f.close();
-
-		find_cell(libparser.ast, ID($_DFF_N_), false, false, false, false, prepare_mode);
-		find_cell(libparser.ast, ID($_DFF_P_), true, false, false, false, prepare_mode);
-
-		find_cell(libparser.ast, ID($_DFF_NN0_), false, true, false, false, prepare_mode);
-		find_cell(libparser.ast, ID($_DFF_NN1_), false, true, false, true, prepare_mode);
-		find_cell(libparser.ast, ID($_DFF_NP0_), false, true, true, false, prepare_mode);
-		find_cell(libparser.ast, ID($_DFF_NP1_), false, true, true, true, prepare_mode);
-		find_cell(libparser.ast, ID($_DFF_PN0_), true, true, false, false, prepare_mode);
-		find_cell(libparser.ast, ID($_DFF_PN1_), true, true, false, true, prepare_mode);
-		find_cell(libparser.ast, ID($_DFF_PP0_), true, true, true, false, prepare_mode);
-		find_cell(libparser.ast, ID($_DFF_PP1_), true, true, true, true, prepare_mode);
-
-		find_cell_sr(libparser.ast, ID($_DFFSR_NNN_), false, false, false, prepare_mode);
-		find_cell_sr(libparser.ast, ID($_DFFSR_NNP_), false, false, true, prepare_mode);
-		find_cell_sr(libparser.ast, ID($_DFFSR_NPN_), false, true, false, prepare_mode);
-		find_cell_sr(libparser.ast, ID($_DFFSR_NPP_), false, true, true, prepare_mode);
-		find_cell_sr(libparser.ast, ID($_DFFSR_PNN_), true, false, false, prepare_mode);
-		find_cell_sr(libparser.ast, ID($_DFFSR_PNP_), true, false, true, prepare_mode);
-		find_cell_sr(libparser.ast, ID($_DFFSR_PPN_), true, true, false, prepare_mode);
-		find_cell_sr(libparser.ast, ID($_DFFSR_PPP_), true, true, true, prepare_mode);
+		// only the groups looked at by find_cell() and find_cell_sr() are parsed,
+		// timing and power tables are skipped
+		static const std::set<std::string> whitelist = {
+			"/library", "/library/cell", "/library/cell/area", "/library/cell/dont_use",
+			"/library/cell/ff", "/library/cell/ff/*", "/library/cell/pin",
+			"/library/cell/pin/direction", "/library/cell/pin/function"
+		};
+
+		LibertyAst *libast = LibertyAstCache::instance.cached_ast(liberty_file, whitelist);
+		std::unique_ptr<LibertyParser> libparser;
+		if (libast == nullptr) {
+			std::ifstream f;
+			f.open(liberty_file.c_str());
+			if (f.fail())
+				log_cmd_error("Can't open liberty file `%s': %s\n", liberty_file.c_str(), strerror(errno));
+			libparser.reset(new LibertyParser(f, whitelist));
+			f.close();
+			libast = libparser->ast;
+		}
+
+		find_cell(libast, ID($_DFF_N_), false, false, false, false, prepare_mode);
+		find_cell(libast, ID($_DFF_P_), true, false, false, false, prepare_mode);
+
+		find_cell(libast, ID($_DFF_NN0_), false, true, false, false, prepare_mode);
+		find_cell(libast, ID($_DFF_NN1_), false, true, false, true, prepare_mode);
+		find_cell(libast, ID($_DFF_NP0_), false, true, true, false, prepare_mode);
+		find_cell(libast, ID($_DFF_NP1_), false, true, true, true, prepare_mode);
+		find_cell(libast, ID($_DFF_PN0_), true, true, false, false, prepare_mode);
+		find_cell(libast, ID($_DFF_PN1_), true, true, false, true, prepare_mode);
+		find_cell(libast, ID($_DFF_PP0_), true, true, true, false, prepare_mode);
+		find_cell(libast, ID($_DFF_PP1_), true, true, true, true, prepare_mode);
+
+		find_cell_sr(libast, ID($_DFFSR_NNN_), false, false, false, prepare_mode);
+		find_cell_sr(libast, ID($_DFFSR_NNP_), false, false, true, prepare_mode);
+		find_cell_sr(libast, ID($_DFFSR_NPN_), false, true, false, prepare_mode);
+		find_cell_sr(libast, ID($_DFFSR_NPP_), false, true, true, prepare_mode);
+		find_cell_sr(libast, ID($_DFFSR_PNN_), true, false, false, prepare_mode);
+		find_cell_sr(libast, ID($_DFFSR_PNP_), true, false, true, prepare_mode);
+		find_cell_sr(libast, ID($_DFFSR_PPN_), true, true, false, prepare_mode);
+		find_cell_sr(libast, ID($_DFFSR_PPP_), true, true, true, prepare_mode);
 
 		// try to implement as many cells as possible just by inverting
 		// the SET and RESET pins. If necessary, implement cell types
@@ -663,11 +729,14 @@ struct DfflibmapPass : public Pass {
 		log("  final dff cell mappings:\n");
 		logmap_all();
 
+		compile_mappings();
+
 		for (auto &it : design->modules_)
 			if (design->selected(it.second) && !it.second->get_blackbox_attribute())
-				dfflibmap(design, it.second, prepare_mode);
+				dfflibmap(design, it.second);
 
 		cell_mappings.clear();
+		compiled_mappings.clear();
 	}
 } DfflibmapPass;
 
@@ -19,6 +19,7 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
+#include "kernel/ffindex.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -46,13 +47,13 @@ void dffsr_worker(SigMap &sigmap, Module *module, Cell *cell)
 
 			if (setbit == setunused) {
 				clrctrl.append(clrbit);
-				reset_val.bits.push_back(State::S0);
+				reset_val.bits().push_back(State::S0);
 				continue;
 			}
 
 			if (clrbit == clrunused) {
 				setctrl.append(setbit);
-				reset_val.bits.push_back(State::S1);
+				reset_val.bits().push_back(State::S1);
 				continue;
 			}
 
@@ -201,10 +202,12 @@ struct Dffsr2dffPass : public Pass {
 		extra_args(args, argidx, design);
 
 		for (auto module : design->selected_modules()) {
-			SigMap sigmap(module);
-			for (auto cell : module->selected_cells()) {
-				dffsr_worker(sigmap, module, cell);
-				adff_worker(sigmap, module, cell);
+			FfIndex ff_index(module);
+			for (auto cell : ff_index.ff_cells) {
+				if (!design->selected(module, cell))
+					continue;
+				dffsr_worker(ff_index.sigmap, module, cell);
+				adff_worker(ff_index.sigmap, module, cell);
 			}
 		}
 	}
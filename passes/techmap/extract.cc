@@ -42,6 +42,16 @@ public:
 	{
 	}
 
+	// the callbacks below copy IdStrings, which requires the concurrent mode
+	// while the solver runs them on multiple threads
+	void useThreads(int num_threads)
+	{
+		setThreads(num_threads);
+#ifdef YOSYS_ENABLE_THREADS
+		IdString::set_concurrent(num_threads > 1);
+#endif
+	}
+
 	bool compareAttributes(const std::set<RTLIL::IdString> &attr, const dict<RTLIL::IdString, RTLIL::Const> &needleAttr, const dict<RTLIL::IdString, RTLIL::Const> &haystackAttr)
 	{
 		for (auto &it : attr) {
@@ -374,6 +384,12 @@ struct ExtractPass : public Pass {
 		log("    -verbose\n");
 		log("        print debug output while analyzing\n");
 		log("\n");
+		log("    -j <num>\n");
+		log("        search the subtrees below the candidates for the first needle cell\n");
+		log("        using up to <num> threads. the result does not depend on the number\n");
+		log("        of threads. if not specified, defaults to the global -j value. the\n");
+		log("        search is single-threaded with -verbose.\n");
+		log("\n");
 		log("    -constports\n");
 		log("        also find instances with constant drivers. this may be much\n");
 		log("        slower than the normal operation.\n");
@@ -459,6 +475,7 @@ struct ExtractPass : public Pass {
 		int mine_limit_mod = -1;
 		int mine_max_fanout = -1;
 		std::set<std::pair<RTLIL::IdString, RTLIL::IdString>> mine_split;
+		int num_threads = yosys_threads;
 
 		size_t argidx;
 		for (argidx = 1; argidx < args.size(); argidx++) {
@@ -501,6 +518,10 @@ struct ExtractPass : public Pass {
 				solver.setVerbose();
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = max(1, atoi(args[++argidx].c_str()));
+				continue;
+			}
 			if (args[argidx] == "-constports") {
 				constports = true;
 				continue;
@@ -658,11 +679,13 @@ struct ExtractPass : public Pass {
 
 			std::sort(needle_list.begin(), needle_list.end(), compareSortNeedleList);
 
+			solver.useThreads(num_threads);
 			for (auto needle : needle_list)
 			for (auto &haystack_it : haystack_map) {
 				log("Solving for %s in %s.\n", ("needle_" + RTLIL::unescape_id(needle->name)).c_str(), haystack_it.first.c_str());
 				solver.solve(results, "needle_" + RTLIL::unescape_id(needle->name), haystack_it.first, false);
 			}
+			solver.useThreads(1);
 			log("Found %d matches.\n", GetSize(results));
 
 			if (results.size() > 0)
@@ -689,7 +712,9 @@ struct ExtractPass : public Pass {
 			std::vector<SubCircuit::Solver::MineResult> results;
 
 			log_header(design, "Running miner from SubCircuit library.\n");
+			solver.useThreads(num_threads);
 			solver.mine(results, mine_cells_min, mine_cells_max, mine_min_freq, mine_limit_mod);
+			solver.useThreads(1);
 
 			map = new RTLIL::Design;
 
@@ -19,7 +19,6 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
-#include "kernel/consteval.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -51,12 +50,24 @@ struct ExtractFaWorker
 {
 	const ExtractFaConfig &config;
 	Module *module;
-	ConstEval ce;
-	SigMap &sigmap;
+	SigMap sigmap;
 
 	dict<SigBit, Cell*> driver;
 	pool<SigBit> handled_bits;
 
+	// A cut of a node: a set of up to three leaves that separates the node
+	// from the inputs, with the function of the node as 8-bit truth table of
+	// the leaves (leaf i is input i, unused inputs do not affect it). The
+	// leaves are sorted.
+	struct cut_t {
+		int size = 0;
+		SigBit leaves[3];
+		uint8_t func = 0;
+		int depth = 0;
+	};
+
+	dict<SigBit, std::vector<cut_t>> cuts;
+
 	const int xor2_func = 0x6, xnor2_func = 0x9;
 	const int xor3_func = 0x96, xnor3_func = 0x69;
 
@@ -81,7 +92,7 @@ struct ExtractFaWorker
 	dict<int, func3_maj_info_t> func3_maj_info;
 
 	ExtractFaWorker(const ExtractFaConfig &config, Module *module) :
-			config(config), module(module), ce(module), sigmap(ce.assign_map)
+			config(config), module(module), sigmap(module)
 	{
 		for (auto cell : module->selected_cells())
 		{
@@ -153,38 +164,193 @@ struct ExtractFaWorker
 		}
 	}
 
-	void check_partition(SigBit root, pool<SigBit> &leaves)
+	static std::vector<IdString> gate_inputs(Cell *cell)
 	{
-		if (config.enable_ha && GetSize(leaves) == 2)
-		{
-			leaves.sort();
+		std::vector<IdString> ports;
+		for (auto port : {ID::A, ID::B, ID(C), ID(D), ID(S)})
+			if (cell->hasPort(port))
+				ports.push_back(port);
+		return ports;
+	}
 
-			SigBit A = SigSpec(leaves)[0];
-			SigBit B = SigSpec(leaves)[1];
+	// evaluates the gate on the truth tables of its inputs
+	static uint8_t eval_gate(IdString type, const uint8_t *in)
+	{
+		if (type == ID($_BUF_))    return in[0];
+		if (type == ID($_NOT_))    return ~in[0];
+		if (type == ID($_AND_))    return in[0] & in[1];
+		if (type == ID($_NAND_))   return ~(in[0] & in[1]);
+		if (type == ID($_OR_))     return in[0] | in[1];
+		if (type == ID($_NOR_))    return ~(in[0] | in[1]);
+		if (type == ID($_XOR_))    return in[0] ^ in[1];
+		if (type == ID($_XNOR_))   return ~(in[0] ^ in[1]);
+		if (type == ID($_ANDNOT_)) return in[0] & ~in[1];
+		if (type == ID($_ORNOT_))  return in[0] | ~in[1];
+		if (type == ID($_MUX_))    return (in[0] & ~in[2]) | (in[1] & in[2]);
+		if (type == ID($_NMUX_))   return ~((in[0] & ~in[2]) | (in[1] & in[2]));
+		if (type == ID($_AOI3_))   return ~((in[0] & in[1]) | in[2]);
+		if (type == ID($_OAI3_))   return ~((in[0] | in[1]) & in[2]);
+		if (type == ID($_AOI4_))   return ~((in[0] & in[1]) | (in[2] & in[3]));
+		if (type == ID($_OAI4_))   return ~((in[0] | in[1]) & (in[2] | in[3]));
+		log_abort();
+	}
 
-			int func = 0;
-			for (int i = 0; i < 4; i++)
-			{
-				bool a_value = (i & 1) != 0;
-				bool b_value = (i & 2) != 0;
+	// the function of the cut with its leaves moved to their position in the
+	// leaves of the target cut
+	static uint8_t remap_func(const cut_t &cut, const cut_t &target)
+	{
+		if (cut.size == 0)
+			return cut.func;
+
+		int pos[3];
+		for (int j = 0; j < cut.size; j++)
+			pos[j] = std::find(target.leaves, target.leaves + target.size, cut.leaves[j]) - target.leaves;
+
+		uint8_t func = 0;
+		for (int u = 0; u < 8; u++) {
+			int index = 0;
+			for (int j = 0; j < cut.size; j++)
+				index |= ((u >> pos[j]) & 1) << j;
+			func |= ((cut.func >> index) & 1) << u;
+		}
+		return func;
+	}
 
-				ce.push();
-				ce.set(A, a_value ? State::S1 : State::S0);
-				ce.set(B, b_value ? State::S1 : State::S0);
+	// adds the leaves of the cut to the sorted leaves of target, returns false
+	// if the result has more than max_size leaves
+	static bool merge_leaves(cut_t &target, const cut_t &cut, int max_size)
+	{
+		for (int j = 0; j < cut.size; j++) {
+			SigBit *end = target.leaves + target.size;
+			SigBit *it = std::lower_bound(target.leaves, end, cut.leaves[j]);
+			if (it != end && *it == cut.leaves[j])
+				continue;
+			if (target.size == max_size)
+				return false;
+			std::move_backward(it, end, end + 1);
+			*it = cut.leaves[j];
+			target.size++;
+		}
+		return true;
+	}
 
-				SigSpec sig = root;
+	std::vector<cut_t> fanin_cuts(SigBit bit)
+	{
+		cut_t cut;
+		if (bit.wire == nullptr) {
+			cut.func = bit == State::S1 ? 0xff : 0x00;
+			return {cut};
+		}
+		auto it = cuts.find(bit);
+		if (it != cuts.end())
+			return it->second;
+		cut.size = 1;
+		cut.leaves[0] = bit;
+		cut.func = 0xaa;
+		return {cut};
+	}
 
-				if (!ce.eval(sig)) {
-					ce.pop();
-					return;
-				}
+	void compute_node_cuts(SigBit bit)
+	{
+		Cell *cell = driver.at(bit);
+		int max_size = std::min(config.maxbreadth, 3);
+
+		std::vector<std::vector<cut_t>> input_cuts;
+		for (auto port : gate_inputs(cell))
+			input_cuts.push_back(fanin_cuts(sigmap(SigBit(cell->getPort(port)))));
+
+		std::vector<cut_t> &node_cuts = cuts[bit];
+		node_cuts.emplace_back();
+		node_cuts.back().size = 1;
+		node_cuts.back().leaves[0] = bit;
+		node_cuts.back().func = 0xaa;
+
+		// all combinations of one cut per input with few enough leaves
+		int n = GetSize(input_cuts);
+		std::vector<int> choice(n);
+		std::vector<cut_t> partial(n+1);
+		int k = 0;
+		while (k >= 0)
+		{
+			if (k == n) {
+				cut_t cut = partial[n];
+				uint8_t in[5];
+				for (int i = 0; i < n; i++)
+					in[i] = remap_func(input_cuts[i][choice[i]], cut);
+				cut.func = eval_gate(cell->type, in);
+				bool found = false;
+				for (auto &other : node_cuts)
+					if (other.size == cut.size && std::equal(cut.leaves, cut.leaves + cut.size, other.leaves)) {
+						found = true;
+						break;
+					}
+				if (!found)
+					node_cuts.push_back(cut);
+				k--;
+				if (k >= 0)
+					choice[k]++;
+				continue;
+			}
+			if (choice[k] == GetSize(input_cuts[k])) {
+				choice[k] = 0;
+				k--;
+				if (k >= 0)
+					choice[k]++;
+				continue;
+			}
+			const cut_t &input_cut = input_cuts[k][choice[k]];
+			partial[k+1] = partial[k];
+			partial[k+1].depth = max(partial[k].depth, input_cut.depth + 1);
+			if (partial[k+1].depth > config.maxdepth || !merge_leaves(partial[k+1], input_cut, max_size)) {
+				choice[k]++;
+				continue;
+			}
+			k++;
+		}
+	}
 
-				if (sig == State::S1)
-					func |= 1 << i;
+	// computes the cuts of all nodes in the fanin cone before the node itself,
+	// nodes on combinational loops are used as leaves
+	void compute_cuts(SigBit root)
+	{
+		pool<SigBit> visiting;
+		std::vector<std::pair<SigBit, bool>> stack = {{root, false}};
 
-				ce.pop();
+		while (!stack.empty())
+		{
+			SigBit bit = stack.back().first;
+			bool inputs_done = stack.back().second;
+			stack.pop_back();
+
+			if (inputs_done) {
+				compute_node_cuts(bit);
+				visiting.erase(bit);
+				continue;
 			}
 
+			if (cuts.count(bit) || visiting.count(bit))
+				continue;
+
+			visiting.insert(bit);
+			stack.push_back({bit, true});
+
+			Cell *cell = driver.at(bit);
+			for (auto port : gate_inputs(cell)) {
+				SigBit input = sigmap(SigBit(cell->getPort(port)));
+				if (driver.count(input) && !cuts.count(input) && !visiting.count(input))
+					stack.push_back({input, false});
+			}
+		}
+	}
+
+	void check_cut(SigBit root, const cut_t &cut)
+	{
+		if (config.enable_ha && cut.size == 2)
+		{
+			SigBit A = cut.leaves[0];
+			SigBit B = cut.leaves[1];
+			int func = cut.func & 15;
+
 			// log("%04d %s %s -> %s\n", bindec(func), log_signal(A), log_signal(B), log_signal(root));
 
 			if (func == xor2_func || func == xnor2_func)
@@ -194,38 +360,12 @@ struct ExtractFaWorker
 			func2[tuple<SigBit, SigBit>(A, B)][func].insert(root);
 		}
 
-		if (config.enable_fa && GetSize(leaves) == 3)
+		if (config.enable_fa && cut.size == 3)
 		{
-			leaves.sort();
-
-			SigBit A = SigSpec(leaves)[0];
-			SigBit B = SigSpec(leaves)[1];
-			SigBit C = SigSpec(leaves)[2];
-
-			int func = 0;
-			for (int i = 0; i < 8; i++)
-			{
-				bool a_value = (i & 1) != 0;
-				bool b_value = (i & 2) != 0;
-				bool c_value = (i & 4) != 0;
-
-				ce.push();
-				ce.set(A, a_value ? State::S1 : State::S0);
-				ce.set(B, b_value ? State::S1 : State::S0);
-				ce.set(C, c_value ? State::S1 : State::S0);
-
-				SigSpec sig = root;
-
-				if (!ce.eval(sig)) {
-					ce.pop();
-					return;
-				}
-
-				if (sig == State::S1)
-					func |= 1 << i;
-
-				ce.pop();
-			}
+			SigBit A = cut.leaves[0];
+			SigBit B = cut.leaves[1];
+			SigBit C = cut.leaves[2];
+			int func = cut.func;
 
 			// log("%08d %s %s %s -> %s\n", bindec(func), log_signal(A), log_signal(B), log_signal(C), log_signal(root));
 
@@ -237,47 +377,6 @@ struct ExtractFaWorker
 		}
 	}
 
-	void find_partitions(SigBit root, pool<SigBit> &leaves, pool<pool<SigBit>> &cache, int maxdepth, int maxbreadth)
-	{
-		if (cache.count(leaves))
-			return;
-
-		// log("%*s[%d] %s:", 20-maxdepth, "", maxdepth, log_signal(root));
-		// for (auto bit : leaves)
-		// 	log(" %s", log_signal(bit));
-		// log("\n");
-
-		cache.insert(leaves);
-		check_partition(root, leaves);
-
-		if (maxdepth == 0)
-			return;
-
-		for (SigBit bit : leaves)
-		{
-			if (driver.count(bit) == 0)
-				continue;
-
-			Cell *cell = driver.at(bit);
-			pool<SigBit> new_leaves = leaves;
-
-			new_leaves.erase(bit);
-			for (auto port : {ID::A, ID::B, ID(C), ID(D)}) {
-				if (!cell->hasPort(port))
-					continue;
-				auto bit = sigmap(SigBit(cell->getPort(port)));
-				if (!bit.wire)
-					continue;
-				new_leaves.insert(bit);
-			}
-
-			if (GetSize(new_leaves) > maxbreadth)
-				continue;
-
-			find_partitions(root, new_leaves, cache, maxdepth-1, maxbreadth);
-		}
-	}
-
 	void assign_new_driver(SigBit bit, SigBit new_driver)
 	{
 		Cell *cell = driver.at(bit);
@@ -291,14 +390,15 @@ struct ExtractFaWorker
 	{
 		log("Extracting full/half adders from %s:\n", log_id(module));
 
+		for (auto it : driver)
+			compute_cuts(it.first);
+
 		for (auto it : driver)
 		{
 			if (it.second->type.in(ID($_BUF_), ID($_NOT_)))
 				continue;
 
 			SigBit root = it.first;
-			pool<SigBit> leaves = { root };
-			pool<pool<SigBit>> cache;
 
 			if (config.verbose)
 				log("  checking %s\n", log_signal(it.first));
@@ -306,7 +406,8 @@ struct ExtractFaWorker
 			count_func2 = 0;
 			count_func3 = 0;
 
-			find_partitions(root, leaves, cache, config.maxdepth, config.maxbreadth);
+			for (auto &cut : cuts.at(root))
+				check_cut(root, cut);
 
 			if (config.verbose && count_func2 > 0)
 				log("    extracted %d two-input functions\n", count_func2);
@@ -412,14 +513,17 @@ struct ExtractFaWorker
 					facache[fakey] = make_tuple(X, Y, cell);
 				}
 
+				// the sum of the cell is inverted by each inverted input
+				bool invert_y = invert_xy != (f3i.inv_a != (f3i.inv_b != f3i.inv_c));
+
 				if (func3.at(key).count(xor3_func)) {
-					SigBit YY = invert_xy ? module->NotGate(NEW_ID, Y) : Y;
+					SigBit YY = invert_y ? module->NotGate(NEW_ID, Y) : Y;
 					for (auto bit : func3.at(key).at(xor3_func))
 						assign_new_driver(bit, YY);
 				}
 
 				if (func3.at(key).count(xnor3_func)) {
-					SigBit YY = invert_xy ? Y : module->NotGate(NEW_ID, Y);
+					SigBit YY = invert_y ? Y : module->NotGate(NEW_ID, Y);
 					for (auto bit : func3.at(key).at(xnor3_func))
 						assign_new_driver(bit, YY);
 				}
@@ -555,7 +659,9 @@ struct ExtractFaPass : public Pass {
 		log("        Set maximum depth for extracted logic cones (default=20)\n");
 		log("\n");
 		log("    -b <int>\n");
-		log("        Set maximum breadth for extracted logic cones (default=6)\n");
+		log("        Set maximum breadth for extracted logic cones (default=6). The cones\n");
+		log("        are found by enumerating cuts with up to 3 leaves, so only values\n");
+		log("        below 3 have an effect.\n");
 		log("\n");
 		log("    -v\n");
 		log("        Verbose output\n");
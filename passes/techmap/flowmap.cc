@@ -52,7 +52,7 @@
 //
 // 2. The FlowMap paper introduces three networks: Nt, Nt', and Nt''. The network Nt is directly represented by a subgraph of RTLIL graph,
 // which is parsed into an equivalent but easier to traverse representation in FlowmapWorker. The network Nt' is built explicitly
-// from a subgraph of Nt, and uses a similar representation in FlowGraph. The network Nt'' is implicit in FlowGraph, which is possible
+// from a subgraph of Nt, and uses an array-based representation in FlowGraph. The network Nt'' is implicit in FlowGraph, which is possible
 // because of the following observation: each Nt' node corresponds to an Nt'' edge of capacity 1, and each Nt' edge corresponds to
 // an Nt'' edge of capacity ∞. Therefore, we only need to explicitly record flow for Nt' edges and through Nt' nodes.
 //
@@ -99,6 +99,8 @@
 #include "kernel/sigtools.h"
 #include "kernel/modtools.h"
 #include "kernel/consteval.h"
+#include "kernel/threadpool.h"
+#include <atomic>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -190,35 +192,91 @@ static void dump_dot_graph(string filename,
 
 struct FlowGraph
 {
-	const RTLIL::SigBit source;
-	RTLIL::SigBit sink;
-	pool<RTLIL::SigBit> nodes = {source};
-	dict<RTLIL::SigBit, pool<RTLIL::SigBit>> edges_fw, edges_bw;
-
+	// The nodes are numbered densely, with the source and the sink first, and gate IR nodes are referred to by their index in
+	// FlowmapWorker. A graph is cleared and rebuilt for every sink examined by a thread, which keeps the allocations around.
+	enum { source = 0, sink = 1 };
 	const int MAX_NODE_FLOW = 1;
-	dict<RTLIL::SigBit, int> node_flow;
-	dict<pair<RTLIL::SigBit, RTLIL::SigBit>, int> edge_flow;
 
-	dict<RTLIL::SigBit, pool<RTLIL::SigBit>> collapsed;
+	struct Edge
+	{
+		int from, to;
+		int flow;
+	};
+
+	std::vector<int> node_gates;
+	std::vector<int> collapsed;
+	std::vector<Edge> edges;
+	std::vector<std::vector<int>> edges_fw, edges_bw;
+	std::vector<int> node_flow;
+
+	void clear()
+	{
+		node_gates.clear();
+		collapsed.clear();
+		edges.clear();
+		for (auto &node_edges : edges_fw)
+			node_edges.clear();
+		for (auto &node_edges : edges_bw)
+			node_edges.clear();
+		node_flow.clear();
+	}
+
+	int add_node(int gate)
+	{
+		int node = GetSize(node_gates);
+		node_gates.push_back(gate);
+		node_flow.push_back(0);
+		if (GetSize(edges_fw) <= node) {
+			edges_fw.emplace_back();
+			edges_bw.emplace_back();
+		}
+		return node;
+	}
+
+	void add_edge(int from, int to)
+	{
+		edges_fw[from].push_back(GetSize(edges));
+		edges_bw[to].push_back(GetSize(edges));
+		edges.push_back(Edge{from, to, 0});
+	}
 
-	void dump_dot_graph(string filename)
+	void dump_dot_graph(string filename, const std::vector<RTLIL::SigBit> &gate_bits)
 	{
+		auto node_bit = [&](int node) {
+			return node == source ? RTLIL::SigBit() : gate_bits[node_gates[node]];
+		};
+
+		pool<RTLIL::SigBit> nodes;
+		dict<RTLIL::SigBit, pool<RTLIL::SigBit>> edges_dict;
+		dict<RTLIL::SigBit, int> node_flow_dict;
+		dict<pair<RTLIL::SigBit, RTLIL::SigBit>, int> edge_flow_dict;
+
+		for (int node = 0; node < GetSize(node_gates); node++) {
+			nodes.insert(node_bit(node));
+			node_flow_dict[node_bit(node)] = node_flow[node];
+		}
+		for (auto &edge : edges) {
+			edges_dict[node_bit(edge.from)].insert(node_bit(edge.to));
+			edge_flow_dict[{node_bit(edge.from), node_bit(edge.to)}] = edge.flow;
+		}
+
 		auto node_style = [&](RTLIL::SigBit node) {
-			string label = (node == source) ? "(source)" : log_signal(node);
-			for (auto collapsed_node : collapsed[node])
-				label += stringf(" %s", log_signal(collapsed_node));
-			int flow = node_flow[node];
-			if (node != source && node != sink)
+			string label = (node == node_bit(source)) ? "(source)" : log_signal(node);
+			if (node == node_bit(sink))
+				for (int gate : collapsed)
+					label += stringf(" %s", log_signal(gate_bits[gate]));
+			int flow = node_flow_dict[node];
+			if (node != node_bit(source) && node != node_bit(sink))
 				label += stringf("\n%d/%d", flow, MAX_NODE_FLOW);
 			else
 				label += stringf("\n%d/∞", flow);
 			return GraphStyle{label, flow < MAX_NODE_FLOW ? "green" : "black"};
 		};
 		auto edge_style = [&](RTLIL::SigBit source, RTLIL::SigBit sink) {
-			int flow = edge_flow[{source, sink}];
+			int flow = edge_flow_dict[{source, sink}];
 			return GraphStyle{stringf("%d/∞", flow), flow > 0 ? "blue" : "black"};
 		};
-		::dump_dot_graph(filename, nodes, edges_fw, {source}, {sink}, node_style, edge_style);
+		::dump_dot_graph(filename, nodes, edges_dict, {node_bit(source)}, {node_bit(sink)}, node_style, edge_style);
 	}
 
 	// Here, we are working on the Nt'' network, but our representation is the Nt' network.
@@ -232,79 +290,49 @@ struct FlowGraph
 	//
 	// To address this, we split each node v into two nodes, v't and v'b. This representation is virtual,
 	// in the sense that nodes v't and v'b are overlaid on top of the original node v, and only exist
-	// in paths and worklists.
-
-	struct NodePrime
-	{
-		RTLIL::SigBit node;
-		bool is_bottom;
-
-		NodePrime(RTLIL::SigBit node, bool is_bottom) :
-			node(node), is_bottom(is_bottom) {}
-
-		bool operator==(const NodePrime &other) const
-		{
-			return node == other.node && is_bottom == other.is_bottom;
-		}
-		bool operator!=(const NodePrime &other) const
-		{
-			return !(*this == other);
-		}
-		unsigned int hash() const
-		{
-			return hash_ops<pair<RTLIL::SigBit, int>>::hash({node, is_bottom});
-		}
-
-		static NodePrime top(RTLIL::SigBit node)
-		{
-			return NodePrime(node, /*is_bottom=*/false);
-		}
+	// in paths and worklists, where v't is 2*v and v'b is 2*v+1.
 
-		static NodePrime bottom(RTLIL::SigBit node)
-		{
-			return NodePrime(node, /*is_bottom=*/true);
-		}
-
-		NodePrime as_top() const
-		{
-			log_assert(is_bottom);
-			return top(node);
-		}
+	static int top(int node) { return 2 * node; }
+	static int bottom(int node) { return 2 * node + 1; }
+	static bool is_bottom(int node_prime) { return node_prime & 1; }
 
-		NodePrime as_bottom() const
-		{
-			log_assert(!is_bottom);
-			return bottom(node);
-		}
-	};
+	std::vector<int> path, path_edges;
+	std::vector<bool> visited;
 
 	bool find_augmenting_path(bool commit)
 	{
-		NodePrime source_prime = {source, true};
-		NodePrime sink_prime = {sink, false};
-		vector<NodePrime> path = {source_prime};
-		pool<NodePrime> visited = {};
+		int source_prime = bottom(source);
+		int sink_prime = top(sink);
+
+		// the edge used to reach each path entry, or -1 when moving between v't and v'b
+		path.assign(1, source_prime);
+		path_edges.assign(1, -1);
+		visited.assign(2 * GetSize(node_gates), false);
+
 		bool found;
 		do {
 			found = false;
 
-			auto node_prime = path.back();
-			visited.insert(node_prime);
+			int node_prime = path.back();
+			int node = node_prime / 2;
+			visited[node_prime] = true;
 
-			if (!node_prime.is_bottom) // vt
+			if (!is_bottom(node_prime)) // vt
 			{
-				if (!visited[node_prime.as_bottom()] && node_flow[node_prime.node] < MAX_NODE_FLOW)
+				if (!visited[bottom(node)] && node_flow[node] < MAX_NODE_FLOW)
 				{
-					path.push_back(node_prime.as_bottom());
+					path.push_back(bottom(node));
+					path_edges.push_back(-1);
 					found = true;
 				}
 				else
 				{
-					for (auto node_pred : edges_bw[node_prime.node])
+					for (int edge : edges_bw[node])
 					{
-						if (!visited[NodePrime::bottom(node_pred)] && edge_flow[{node_pred, node_prime.node}] > 0)
+						if (!visited[bottom(edges[edge].from)] && edges[edge].flow > 0)
 						{
-							path.push_back(NodePrime::bottom(node_pred));
+							path.push_back(bottom(edges[edge].from));
+							path_edges.push_back(edge);
 							found = true;
 							break;
 						}
@@ -313,18 +341,20 @@ struct FlowGraph
 			}
 			else // vb
 			{
-				if (!visited[node_prime.as_top()] && node_flow[node_prime.node] > 0)
+				if (!visited[top(node)] && node_flow[node] > 0)
 				{
-					path.push_back(node_prime.as_top());
+					path.push_back(top(node));
+					path_edges.push_back(-1);
 					found = true;
 				}
 				else
 				{
-					for (auto node_succ : edges_fw[node_prime.node])
+					for (int edge : edges_fw[node])
 					{
-						if (!visited[NodePrime::top(node_succ)] /* && edge_flow[...] < ∞ */)
+						if (!visited[top(edges[edge].to)] /* && edge flow < ∞ */)
 						{
-							path.push_back(NodePrime::top(node_succ));
+							path.push_back(top(edges[edge].to));
+							path_edges.push_back(edge);
 							found = true;
 							break;
 						}
@@ -335,23 +365,22 @@ struct FlowGraph
 			if (!found && path.size() > 1)
 			{
 				path.pop_back();
+				path_edges.pop_back();
 				found = true;
 			}
 		} while(path.back() != sink_prime && found);
 
 		if (commit && path.back() == sink_prime)
 		{
-			auto prev_prime = path.front();
-			for (auto node_prime : path)
+			for (int i = 1; i < GetSize(path); i++)
 			{
-				if (node_prime == source_prime)
-					continue;
+				int prev_prime = path[i-1], node_prime = path[i];
 
-				log_assert(prev_prime.is_bottom ^ node_prime.is_bottom);
-				if (prev_prime.node == node_prime.node)
+				log_assert(is_bottom(prev_prime) ^ is_bottom(node_prime));
+				if (path_edges[i] < 0)
 				{
-					auto node = node_prime.node;
-					if (!prev_prime.is_bottom && node_prime.is_bottom)
+					int node = node_prime / 2;
+					if (!is_bottom(prev_prime) && is_bottom(node_prime))
 					{
 						log_assert(node_flow[node] == 0);
 						node_flow[node]++;
@@ -364,18 +393,18 @@ struct FlowGraph
 				}
 				else
 				{
-					if (prev_prime.is_bottom && !node_prime.is_bottom)
+					Edge &edge = edges[path_edges[i]];
+					if (is_bottom(prev_prime) && !is_bottom(node_prime))
 					{
-						log_assert(true /* edge_flow[...] < ∞ */);
-						edge_flow[{prev_prime.node, node_prime.node}]++;
+						log_assert(true /* edge flow < ∞ */);
+						edge.flow++;
 					}
 					else
 					{
-						log_assert((edge_flow[{node_prime.node, prev_prime.node}] > 0));
-						edge_flow[{node_prime.node, prev_prime.node}]--;
+						log_assert(edge.flow > 0);
+						edge.flow--;
 					}
 				}
-				prev_prime = node_prime;
 			}
 
 			node_flow[source]++;
@@ -392,54 +421,48 @@ struct FlowGraph
 		return flow + find_augmenting_path(/*commit=*/false);
 	}
 
-	pair<pool<RTLIL::SigBit>, pool<RTLIL::SigBit>> edge_cut()
+	// Returns for each node whether it is in X (X in the paper), all other nodes and the nodes collapsed into the sink are in X̅.
+	std::vector<bool> edge_cut()
 	{
-		pool<RTLIL::SigBit> x = {source}, xi; // X and X̅ in the paper
+		std::vector<bool> x(GetSize(node_gates), false);
+		x[source] = true;
 
-		NodePrime source_prime = {source, true};
-		pool<NodePrime> visited;
-		vector<NodePrime> worklist = {source_prime};
+		visited.assign(2 * GetSize(node_gates), false);
+		std::vector<int> worklist = {bottom(source)};
 		while (!worklist.empty())
 		{
-			auto node_prime = worklist.back();
+			int node_prime = worklist.back();
+			int node = node_prime / 2;
 			worklist.pop_back();
 			if (visited[node_prime])
 				continue;
-			visited.insert(node_prime);
+			visited[node_prime] = true;
 
-			if (!node_prime.is_bottom)
-				x.insert(node_prime.node);
+			if (!is_bottom(node_prime))
+				x[node] = true;
 
 			// Mincut is constructed by traversing a graph in an undirected way along forward edges that aren't full, or backward edges
 			// that aren't empty.
-			if (!node_prime.is_bottom) // top
+			if (!is_bottom(node_prime)) // top
 			{
-				if (node_flow[node_prime.node] < MAX_NODE_FLOW)
-					worklist.push_back(node_prime.as_bottom());
-				for (auto node_pred : edges_bw[node_prime.node])
-					if (edge_flow[{node_pred, node_prime.node}] > 0)
-						worklist.push_back(NodePrime::bottom(node_pred));
+				if (node_flow[node] < MAX_NODE_FLOW)
+					worklist.push_back(bottom(node));
+				for (int edge : edges_bw[node])
+					if (edges[edge].flow > 0)
+						worklist.push_back(bottom(edges[edge].from));
 			}
 			else // bottom
 			{
-				if (node_flow[node_prime.node] > 0)
-					worklist.push_back(node_prime.as_top());
-				for (auto node_succ : edges_fw[node_prime.node])
-					if (true /* edge_flow[...] < ∞ */)
-						worklist.push_back(NodePrime::top(node_succ));
+				if (node_flow[node] > 0)
+					worklist.push_back(top(node));
+				for (int edge : edges_fw[node])
+					if (true /* edge flow < ∞ */)
+						worklist.push_back(top(edges[edge].to));
 			}
 		}
 
-		for (auto node : nodes)
-			if (!x[node])
-				xi.insert(node);
-
-		for (auto collapsed_node : collapsed[sink])
-			xi.insert(collapsed_node);
-
-		log_assert(x[source] && !xi[source]);
-		log_assert(!x[sink] && xi[sink]);
-		return {x, xi};
+		log_assert(x[source] && !x[sink]);
+		return x;
 	}
 };
 
@@ -448,6 +471,7 @@ struct FlowmapWorker
 	int order;
 	int r_alpha, r_beta, r_gamma;
 	bool debug, debug_relax;
+	int num_threads;
 
 	RTLIL::Module *module;
 	SigMap sigmap;
@@ -532,62 +556,6 @@ struct FlowmapWorker
 		dump_dot_graph(filename, mode, lut_and_input_nodes, lut_edges_fw, lut_gates);
 	}
 
-	pool<RTLIL::SigBit> find_subgraph(RTLIL::SigBit sink)
-	{
-		pool<RTLIL::SigBit> subgraph;
-		pool<RTLIL::SigBit> worklist = {sink};
-		while (!worklist.empty())
-		{
-			auto node = worklist.pop();
-			subgraph.insert(node);
-			for (auto source : edges_bw[node])
-			{
-				if (!subgraph[source])
-					worklist.insert(source);
-			}
-		}
-		return subgraph;
-	}
-
-	FlowGraph build_flow_graph(RTLIL::SigBit sink, int p)
-	{
-		FlowGraph flow_graph;
-		flow_graph.sink = sink;
-
-		pool<RTLIL::SigBit> worklist = {sink}, visited;
-		while (!worklist.empty())
-		{
-			auto node = worklist.pop();
-			visited.insert(node);
-
-			auto collapsed_node = labels[node] == p ? sink : node;
-			if (node != collapsed_node)
-				flow_graph.collapsed[collapsed_node].insert(node);
-			flow_graph.nodes.insert(collapsed_node);
-
-			for (auto node_pred : edges_bw[node])
-			{
-				auto collapsed_node_pred = labels[node_pred] == p ? sink : node_pred;
-				if (node_pred != collapsed_node_pred)
-					flow_graph.collapsed[collapsed_node_pred].insert(node_pred);
-				if (collapsed_node != collapsed_node_pred)
-				{
-					flow_graph.edges_bw[collapsed_node].insert(collapsed_node_pred);
-					flow_graph.edges_fw[collapsed_node_pred].insert(collapsed_node);
-				}
-				if (inputs[node_pred])
-				{
-					flow_graph.edges_bw[collapsed_node_pred].insert(flow_graph.source);
-					flow_graph.edges_fw[flow_graph.source].insert(collapsed_node_pred);
-				}
-
-				if (!visited[node_pred])
-					worklist.insert(node_pred);
-			}
-		}
-		return flow_graph;
-	}
-
 	void discover_nodes(pool<IdString> cell_types)
 	{
 		for (auto cell : module->selected_cells())
@@ -666,8 +634,174 @@ struct FlowmapWorker
 		}
 	}
 
+	// Compact copy of the gate IR used for labeling, the nodes are numbered in the order of `nodes`.
+	std::vector<RTLIL::SigBit> gate_bits;
+	dict<RTLIL::SigBit, int> gate_index;
+	std::vector<std::vector<int>> gate_preds, gate_succs;
+	std::vector<char> gate_is_input;
+	std::vector<int> gate_labels;
+
+	struct LabelScratch
+	{
+		FlowGraph flow_graph;
+		std::vector<int> subgraph, local_node;
+		std::vector<char> in_subgraph;
+		std::vector<pair<int, int>> flow_edges;
+	};
+
+	struct LabelResult
+	{
+		int label = -1, flow = 0;
+		std::vector<int> lut_gates, lut_inputs;
+	};
+
+	void build_gate_index()
+	{
+		for (auto node : nodes) {
+			gate_index[node] = GetSize(gate_bits);
+			gate_bits.push_back(node);
+		}
+
+		gate_preds.resize(GetSize(gate_bits));
+		gate_succs.resize(GetSize(gate_bits));
+		gate_is_input.resize(GetSize(gate_bits));
+		gate_labels.resize(GetSize(gate_bits), -1);
+
+		for (int gate = 0; gate < GetSize(gate_bits); gate++) {
+			RTLIL::SigBit node = gate_bits[gate];
+			gate_is_input[gate] = inputs[node];
+			if (edges_bw.count(node))
+				for (auto node_pred : edges_bw.at(node))
+					gate_preds[gate].push_back(gate_index.at(node_pred));
+			if (edges_fw.count(node))
+				for (auto node_succ : edges_fw.at(node))
+					gate_succs[gate].push_back(gate_index.at(node_succ));
+		}
+	}
+
+	// Computes the label and the cut of a node whose predecessors are all labeled. Only reads the compact gate IR and the labels of
+	// the predecessors, so nodes of the same level can be examined concurrently, each thread with its own scratch space.
+	void label_node(int sink, LabelScratch &scratch, LabelResult &result, int debug_num)
+	{
+		auto &subgraph = scratch.subgraph;
+		auto &local_node = scratch.local_node;
+		auto &in_subgraph = scratch.in_subgraph;
+		if (GetSize(in_subgraph) < GetSize(gate_bits)) {
+			in_subgraph.resize(GetSize(gate_bits), false);
+			local_node.resize(GetSize(gate_bits), -1);
+		}
+
+		subgraph.clear();
+		subgraph.push_back(sink);
+		in_subgraph[sink] = true;
+		for (int i = 0; i < GetSize(subgraph); i++)
+			for (int gate_pred : gate_preds[subgraph[i]])
+				if (!in_subgraph[gate_pred]) {
+					in_subgraph[gate_pred] = true;
+					subgraph.push_back(gate_pred);
+				}
+
+		int p = 1;
+		for (int gate : subgraph)
+			p = max(p, gate_labels[gate]);
+
+		FlowGraph &flow_graph = scratch.flow_graph;
+		flow_graph.clear();
+		flow_graph.add_node(-1);
+		flow_graph.add_node(sink);
+
+		for (int gate : subgraph)
+		{
+			if (gate == sink)
+				local_node[gate] = FlowGraph::sink;
+			else if (gate_labels[gate] == p) {
+				local_node[gate] = FlowGraph::sink;
+				flow_graph.collapsed.push_back(gate);
+			} else
+				local_node[gate] = flow_graph.add_node(gate);
+		}
+
+		auto &flow_edges = scratch.flow_edges;
+		flow_edges.clear();
+		for (int gate : subgraph)
+			for (int gate_pred : gate_preds[gate])
+			{
+				if (local_node[gate_pred] != local_node[gate])
+					flow_edges.push_back({local_node[gate_pred], local_node[gate]});
+				if (gate_is_input[gate_pred])
+					flow_edges.push_back({FlowGraph::source, local_node[gate_pred]});
+			}
+		std::sort(flow_edges.begin(), flow_edges.end());
+		flow_edges.erase(std::unique(flow_edges.begin(), flow_edges.end()), flow_edges.end());
+		for (auto &edge : flow_edges)
+			flow_graph.add_edge(edge.first, edge.second);
+
+		result.flow = flow_graph.maximum_flow(order);
+		result.lut_gates.clear();
+		result.lut_inputs.clear();
+
+		if (result.flow <= order)
+		{
+			result.label = p;
+			std::vector<bool> x = flow_graph.edge_cut();
+			for (int node = 0; node < GetSize(x); node++)
+				if (!x[node])
+					result.lut_gates.push_back(flow_graph.node_gates[node]);
+			result.lut_gates.insert(result.lut_gates.end(), flow_graph.collapsed.begin(), flow_graph.collapsed.end());
+
+			for (int gate : result.lut_gates)
+				for (int gate_pred : gate_preds[gate])
+					if (local_node[gate_pred] != FlowGraph::sink && x[local_node[gate_pred]])
+						result.lut_inputs.push_back(gate_pred);
+		}
+		else
+		{
+			result.label = p + 1;
+			result.lut_gates.push_back(sink);
+			result.lut_inputs = gate_preds[sink];
+		}
+
+		std::sort(result.lut_gates.begin(), result.lut_gates.end());
+		std::sort(result.lut_inputs.begin(), result.lut_inputs.end());
+		result.lut_inputs.erase(std::unique(result.lut_inputs.begin(), result.lut_inputs.end()), result.lut_inputs.end());
+		log_assert(GetSize(result.lut_inputs) <= order);
+
+		if (debug)
+		{
+			pool<RTLIL::SigBit> subgraph_nodes, x, xi;
+			for (int gate : subgraph)
+				subgraph_nodes.insert(gate_bits[gate]);
+			for (int gate : result.lut_gates)
+				xi.insert(gate_bits[gate]);
+			for (auto node : subgraph_nodes)
+				if (!xi[node])
+					x.insert(node);
+
+			log("  Maximum flow: %d. Assigned label %d.\n", result.flow, result.label);
+			dump_dot_graph(stringf("flowmap-%d-sub.dot", debug_num), GraphMode::Cut, subgraph_nodes, {}, {}, {x, xi});
+			log("  Dumped subgraph to `flowmap-%d-sub.dot`.\n", debug_num);
+			flow_graph.dump_dot_graph(stringf("flowmap-%d-flow.dot", debug_num), gate_bits);
+			log("  Dumped flow graph to `flowmap-%d-flow.dot`.\n", debug_num);
+			log("    LUT inputs:");
+			for (int gate : result.lut_inputs)
+				log(" %s", log_signal(gate_bits[gate]));
+			log(".\n");
+			log("    LUT packed gates:");
+			for (int gate : result.lut_gates)
+				log(" %s", log_signal(gate_bits[gate]));
+			log(".\n");
+		}
+
+		for (int gate : subgraph) {
+			in_subgraph[gate] = false;
+			local_node[gate] = -1;
+		}
+	}
+
 	void label_nodes()
 	{
+		build_gate_index();
+
 		for (auto node : nodes)
 			labels[node] = -1;
 		for (auto input : inputs)
@@ -676,92 +810,98 @@ struct FlowmapWorker
 				labels[input] = input.wire->attributes[ID($flowmap_level)].as_int();
 			else
 				labels[input] = 0;
+			gate_labels[gate_index.at(input)] = labels[input];
 		}
 
-		pool<RTLIL::SigBit> worklist = nodes;
-		int debug_num = 0;
-		while (!worklist.empty())
+		// The nodes are examined level by level, a node is in the level after the last level of its predecessors. Nodes on
+		// combinational loops are never examined and keep the label -1.
+		std::vector<int> pending_preds(GetSize(gate_bits));
+		std::vector<int> level;
+		for (int gate = 0; gate < GetSize(gate_bits); gate++)
 		{
-			auto sink = worklist.pop();
-			if (labels[sink] != -1)
+			if (gate_is_input[gate])
 				continue;
+			for (int gate_pred : gate_preds[gate])
+				if (!gate_is_input[gate_pred])
+					pending_preds[gate]++;
+			if (pending_preds[gate] == 0)
+				level.push_back(gate);
+		}
 
-			bool inputs_have_labels = true;
-			for (auto sink_input : edges_bw[sink])
-			{
-				if (labels[sink_input] == -1)
-				{
-					inputs_have_labels = false;
-					break;
-				}
-			}
-			if (!inputs_have_labels)
-				continue;
+		int level_threads = debug ? 1 : num_threads;
+		std::vector<LabelScratch> scratch(level_threads);
+		std::vector<LabelResult> results;
+		int debug_num = 0;
 
-			if (debug)
-			{
-				debug_num++;
-				log("Examining subgraph %d rooted in %s.\n", debug_num, log_signal(sink));
-			}
+		// one group per level, the IdString concurrent mode is kept for all
+		if (level_threads > 1)
+			IdString::set_concurrent(true);
 
-			pool<RTLIL::SigBit> subgraph = find_subgraph(sink);
+		while (!level.empty())
+		{
+			results.resize(GetSize(level));
 
-			int p = 1;
-			for (auto subgraph_node : subgraph)
-				p = max(p, labels[subgraph_node]);
+			auto run_node = [&](int i, LabelScratch &thread_scratch) {
+				if (debug)
+					log("Examining subgraph %d rooted in %s.\n", debug_num + i + 1, log_signal(gate_bits[level[i]]));
+				label_node(level[i], thread_scratch, results[i], debug_num + i + 1);
+			};
 
-			FlowGraph flow_graph = build_flow_graph(sink, p);
-			int flow = flow_graph.maximum_flow(order);
-			pool<RTLIL::SigBit> x, xi;
-			if (flow <= order)
+			TaskGroup group(std::max(std::min(level_threads, GetSize(level)), 1));
+			if (group.concurrent())
 			{
-				labels[sink] = p;
-				auto cut = flow_graph.edge_cut();
-				x = cut.first;
-				xi = cut.second;
+				// every task uses its own scratch for a share of the level
+				std::atomic<int> next_index(0);
+				for (int k = 0; k < std::min(level_threads, GetSize(level)); k++)
+					group.run([&, k]() {
+						while (1) {
+							int i = next_index++;
+							if (i >= GetSize(level))
+								break;
+							run_node(i, scratch[k]);
+						}
+					});
+				group.wait();
 			}
 			else
 			{
-				labels[sink] = p + 1;
-				x = subgraph;
-				x.erase(sink);
-				xi.insert(sink);
+				for (int i = 0; i < GetSize(level); i++)
+					run_node(i, scratch[0]);
 			}
-			lut_gates[sink] = xi;
 
-			pool<RTLIL::SigBit> k;
-			for (auto xi_node : xi)
+			std::vector<int> next_level;
+			for (int i = 0; i < GetSize(level); i++)
 			{
-				for (auto xi_node_pred : edges_bw[xi_node])
-					if (x[xi_node_pred])
-						k.insert(xi_node_pred);
-			}
-			log_assert((int)k.size() <= order);
-			lut_edges_bw[sink] = k;
-			for (auto k_node : k)
-				lut_edges_fw[k_node].insert(sink);
+				int gate = level[i];
+				RTLIL::SigBit sink = gate_bits[gate];
+				LabelResult &result = results[i];
 
-			if (debug)
-			{
-				log("  Maximum flow: %d. Assigned label %d.\n", flow, labels[sink]);
-				dump_dot_graph(stringf("flowmap-%d-sub.dot", debug_num), GraphMode::Cut, subgraph, {}, {}, {x, xi});
-				log("  Dumped subgraph to `flowmap-%d-sub.dot`.\n", debug_num);
-				flow_graph.dump_dot_graph(stringf("flowmap-%d-flow.dot", debug_num));
-				log("  Dumped flow graph to `flowmap-%d-flow.dot`.\n", debug_num);
-				log("    LUT inputs:");
-				for (auto k_node : k)
-					log(" %s", log_signal(k_node));
-				log(".\n");
-				log("    LUT packed gates:");
-				for (auto xi_node : xi)
-					log(" %s", log_signal(xi_node));
-				log(".\n");
+				gate_labels[gate] = result.label;
+				labels[sink] = result.label;
+
+				pool<RTLIL::SigBit> &xi = lut_gates[sink];
+				for (int lut_gate : result.lut_gates)
+					xi.insert(gate_bits[lut_gate]);
+
+				pool<RTLIL::SigBit> &k = lut_edges_bw[sink];
+				for (int lut_input : result.lut_inputs) {
+					k.insert(gate_bits[lut_input]);
+					lut_edges_fw[gate_bits[lut_input]].insert(sink);
+				}
+
+				for (int gate_succ : gate_succs[gate])
+					if (--pending_preds[gate_succ] == 0)
+						next_level.push_back(gate_succ);
 			}
 
-			for (auto sink_succ : edges_fw[sink])
-				worklist.insert(sink_succ);
+			std::sort(next_level.begin(), next_level.end());
+			debug_num += GetSize(level);
+			level.swap(next_level);
 		}
 
+		if (level_threads > 1)
+			IdString::set_concurrent(false);
+
 		if (debug)
 		{
 			dump_dot_graph("flowmap-labeled.dot", GraphMode::Label);
@@ -1343,8 +1483,11 @@ struct FlowmapWorker
 	void pack_cells(int minlut)
 	{
 		ConstEval ce(module);
-		for (auto input_node : inputs)
+		ConstEvalBatch batch(module);
+		for (auto input_node : inputs) {
 			ce.stop(input_node);
+			batch.stop(input_node);
+		}
 
 		pool<RTLIL::SigBit> mapped_nodes;
 		for (auto node : lut_nodes)
@@ -1383,24 +1526,41 @@ struct FlowmapWorker
 			vector<RTLIL::SigBit> input_nodes(lut_edges_bw[node].begin(), lut_edges_bw[node].end());
 			RTLIL::Const lut_table(State::Sx, max(1 << input_nodes.size(), 1 << minlut));
 			unsigned const mask = 1 << input_nodes.size();
-			for (unsigned i = 0; i < mask; i++)
+			if (batch.setup(RTLIL::SigSpec(input_nodes), node) && batch.free_signals.empty())
 			{
-				ce.push();
-				for (size_t n = 0; n < input_nodes.size(); n++)
-					ce.set(input_nodes[n], ((i >> n) & 1) ? State::S1 : State::S0);
-
-				RTLIL::SigSpec value = node, undef;
-				if (!ce.eval(value, undef))
+				for (unsigned base = 0; base < mask; base += 64)
 				{
-					string env;
-					for (auto input_node : input_nodes)
-						env += stringf("  %s = %s\n", log_signal(input_node), log_signal(ce.values_map(input_node)));
-					log_error("Cannot evaluate %s because %s is not defined.\nEvaluation environment:\n%s",
-					          log_signal(node), log_signal(undef), env.c_str());
+					for (size_t n = 0; n < input_nodes.size(); n++)
+						batch.set_input(n, ConstEvalBatch::count_pattern(base, n));
+					batch.run();
+
+					ConstEvalBatch::word_t value, defined;
+					batch.get_output(0, value, defined);
+					for (unsigned lane = 0; lane < 64 && base + lane < mask; lane++)
+						lut_table.bits()[base + lane] = ((value >> lane) & 1) ? State::S1 : State::S0;
 				}
+			}
+			else
+			{
+				for (unsigned i = 0; i < mask; i++)
+				{
+					ce.push();
+					for (size_t n = 0; n < input_nodes.size(); n++)
+						ce.set(input_nodes[n], ((i >> n) & 1) ? State::S1 : State::S0);
 
-				lut_table[i] = value.as_bool() ? State::S1 : State::S0;
-				ce.pop();
+					RTLIL::SigSpec value = node, undef;
+					if (!ce.eval(value, undef))
+					{
+						string env;
+						for (auto input_node : input_nodes)
+							env += stringf("  %s = %s\n", log_signal(input_node), log_signal(ce.values_map(input_node)));
+						log_error("Cannot evaluate %s because %s is not defined.\nEvaluation environment:\n%s",
+						          log_signal(node), log_signal(undef), env.c_str());
+					}
+
+					lut_table.bits()[i] = value.as_bool() ? State::S1 : State::S0;
+					ce.pop();
+				}
 			}
 
 			RTLIL::SigSpec lut_a, lut_y = node;
@@ -1435,10 +1595,10 @@ struct FlowmapWorker
 	}
 
 	FlowmapWorker(int order, int minlut, pool<IdString> cell_types, int r_alpha, int r_beta, int r_gamma,
-	              bool relax, int optarea, bool debug, bool debug_relax,
+	              bool relax, int optarea, bool debug, bool debug_relax, int num_threads,
 	              RTLIL::Module *module) :
 		order(order), r_alpha(r_alpha), r_beta(r_beta), r_gamma(r_gamma), debug(debug), debug_relax(debug_relax),
-		module(module), sigmap(module), index(module)
+		num_threads(num_threads), module(module), sigmap(module), index(module)
 	{
 		log("Labeling cells.\n");
 		discover_nodes(cell_types);
@@ -1504,6 +1664,11 @@ struct FlowmapPass : public Pass {
 		log("        n may be zero, to optimize for area without increasing depth.\n");
 		log("        implies -relax.\n");
 		log("\n");
+		log("    -j <num>\n");
+		log("        label the nodes of each logic level using up to <num> threads. the\n");
+		log("        result does not depend on the number of threads. if not specified,\n");
+		log("        defaults to the global -j value.\n");
+		log("\n");
 		log("    -debug\n");
 		log("        dump intermediate graphs.\n");
 		log("\n");
@@ -1520,6 +1685,7 @@ struct FlowmapPass : public Pass {
 		int r_alpha = 8, r_beta = 2, r_gamma = 1;
 		int optarea = 0;
 		bool debug = false, debug_relax = false;
+		int num_threads = yosys_threads;
 
 		size_t argidx;
 		for (argidx = 1; argidx < args.size(); argidx++)
@@ -1565,6 +1731,11 @@ struct FlowmapPass : public Pass {
 				optarea = atoi(args[++argidx].c_str());
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx + 1 < args.size())
+			{
+				num_threads = max(1, atoi(args[++argidx].c_str()));
+				continue;
+			}
 			if (args[argidx] == "-debug")
 			{
 				debug = true;
@@ -1597,7 +1768,7 @@ struct FlowmapPass : public Pass {
 		int gate_area = 0, lut_area = 0;
 		for (auto module : design->selected_modules())
 		{
-			FlowmapWorker worker(order, minlut, cell_types, r_alpha, r_beta, r_gamma, relax, optarea, debug, debug_relax, module);
+			FlowmapWorker worker(order, minlut, cell_types, r_alpha, r_beta, r_gamma, relax, optarea, debug, debug_relax, num_threads, module);
 			gate_count += worker.gate_count;
 			lut_count += worker.lut_count;
 			packed_count += worker.packed_count;
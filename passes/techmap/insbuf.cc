@@ -57,10 +57,19 @@ struct InsbufPass : public Pass {
 		}
 		extra_args(args, argidx, design);
 
+		IdString celltype_id = RTLIL::escape_id(celltype);
+		IdString in_port = RTLIL::escape_id(in_portname), out_port = RTLIL::escape_id(out_portname);
+
 		for (auto module : design->selected_modules())
 		{
+			RTLIL::Module::Batch batch(module);
 			std::vector<RTLIL::SigSig> new_connections;
 
+			int num_bits = 0;
+			for (auto &conn : module->connections())
+				num_bits += GetSize(conn.first);
+			module->cells_.reserve(GetSize(module->cells_) + num_bits);
+
 			for (auto &conn : module->connections())
 			{
 				RTLIL::SigSig new_conn;
@@ -76,9 +85,9 @@ struct InsbufPass : public Pass {
 						continue;
 					}
 
-					Cell *cell = module->addCell(NEW_ID, RTLIL::escape_id(celltype));
-					cell->setPort(RTLIL::escape_id(in_portname), rhs);
-					cell->setPort(RTLIL::escape_id(out_portname), lhs);
+					Cell *cell = module->addCell(NEW_ID, celltype_id);
+					cell->setPort(in_port, rhs);
+					cell->setPort(out_port, lhs);
 					log("Added %s.%s: %s -> %s\n", log_id(module), log_id(cell), log_signal(rhs), log_signal(lhs));
 				}
 
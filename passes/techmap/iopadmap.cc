@@ -19,6 +19,7 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
+#include "kernel/portindex.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -178,43 +179,47 @@ struct IopadmapPass : public Pass {
 					if (wire->get_bool_attribute("\\iopad_external_pin"))
 						ignore.insert(make_pair(module->name, wire->name));
 
+		auto id = [](const std::string &name) -> IdString { return name.empty() ? IdString() : RTLIL::escape_id(name); };
+		IdString toutpad_type = id(toutpad_celltype), toutpad_oe = id(toutpad_portname_oe);
+		IdString toutpad_i = id(toutpad_portname_i), toutpad_pad = id(toutpad_portname_pad);
+		IdString tinoutpad_type = id(tinoutpad_celltype), tinoutpad_oe = id(tinoutpad_portname_oe);
+		IdString tinoutpad_o = id(tinoutpad_portname_o), tinoutpad_i = id(tinoutpad_portname_i);
+		IdString tinoutpad_pad = id(tinoutpad_portname_pad);
+		IdString widthparam_id = id(widthparam), nameparam_id = id(nameparam);
+
+		pool<IdString> ignore_types;
+		for (auto &it : ignore)
+			ignore_types.insert(it.first);
+
 		for (auto module : design->selected_modules())
 		{
+			RTLIL::Module::Batch batch(module);
+			PortBitIndex index;
+			index.setup(module);
 			pool<SigBit> skip_wire_bits;
 			dict<Wire *, dict<int, pair<Cell *, IdString>>> rewrite_bits;
 
-			for (auto cell : module->cells())
-			for (auto port : cell->connections())
-				if (ignore.count(make_pair(cell->type, port.first)))
-					for (auto bit : port.second)
-						skip_wire_bits.insert(bit);
+			for (auto &it : index.type_cells) {
+				if (!ignore_types.count(it.first))
+					continue;
+				for (auto cell : it.second)
+				for (auto port : cell->connections())
+					if (ignore.count(make_pair(cell->type, port.first)))
+						for (auto bit : port.second)
+							skip_wire_bits.insert(bit);
+			}
 
 			if (!toutpad_celltype.empty() || !tinoutpad_celltype.empty())
 			{
 				dict<SigBit, Cell *> tbuf_bits;
-				pool<SigBit> driven_bits;
 
-				// Gather tristate buffers and always-on drivers.
-				for (auto cell : module->cells())
-					if (cell->type == ID($_TBUF_)) {
-						SigBit bit = cell->getPort(ID::Y).as_bit();
-						tbuf_bits[bit] = cell;
-					} else {
-						for (auto port : cell->connections())
-							if (!cell->known() || cell->output(port.first))
-								for (auto bit : port.second)
-									driven_bits.insert(bit);
-					}
-
-				// If a wire is a target of an assignment, it is driven, unless the source is 'z.
-				for (auto &conn : module->connections())
-					for (int i = 0; i < GetSize(conn.first); i++) {
-						SigBit dstbit = conn.first[i];
-						SigBit srcbit = conn.second[i];
-						if (!srcbit.wire && srcbit.data == State::Sz)
-							continue;
-						driven_bits.insert(dstbit);
-					}
+				// Gather tristate buffers. Bits without one are driven
+				// by any other cell output, by any port of a cell of
+				// unknown type, and by assignments unless the source is 'z.
+				for (auto cell : index.cells(ID($_TBUF_))) {
+					SigBit bit = cell->getPort(ID::Y).as_bit();
+					tbuf_bits[bit] = cell;
+				}
 
 				for (auto wire : module->selected_wires())
 				{
@@ -242,7 +247,8 @@ struct IopadmapPass : public Pass {
 
 						SigBit en_sig;
 						SigBit data_sig;
-						bool is_driven = driven_bits.count(wire_bit);
+						bool is_driven = index.drivers(wire_bit) || index.unknown_bits.count(wire_bit) ||
+								index.assigned_bits.count(wire_bit);
 
 						if (tbuf_cell != nullptr) {
 							// Found a tristate buffer — use it.
@@ -267,31 +273,31 @@ struct IopadmapPass : public Pass {
 						{
 							log("Mapping port %s.%s[%d] using %s.\n", log_id(module), log_id(wire), i, tinoutpad_celltype.c_str());
 
-							Cell *cell = module->addCell(NEW_ID, RTLIL::escape_id(tinoutpad_celltype));
+							Cell *cell = module->addCell(NEW_ID, tinoutpad_type);
 
-							cell->setPort(RTLIL::escape_id(tinoutpad_portname_oe), en_sig);
+							cell->setPort(tinoutpad_oe, en_sig);
 							cell->attributes[ID::keep] = RTLIL::Const(1);
 
 							if (tbuf_cell) {
 								module->remove(tbuf_cell);
-								cell->setPort(RTLIL::escape_id(tinoutpad_portname_o), wire_bit);
-								cell->setPort(RTLIL::escape_id(tinoutpad_portname_i), data_sig);
+								cell->setPort(tinoutpad_o, wire_bit);
+								cell->setPort(tinoutpad_i, data_sig);
 							} else if (is_driven) {
-								cell->setPort(RTLIL::escape_id(tinoutpad_portname_i), wire_bit);
+								cell->setPort(tinoutpad_i, wire_bit);
 							} else {
-								cell->setPort(RTLIL::escape_id(tinoutpad_portname_o), wire_bit);
-								cell->setPort(RTLIL::escape_id(tinoutpad_portname_i), data_sig);
+								cell->setPort(tinoutpad_o, wire_bit);
+								cell->setPort(tinoutpad_i, data_sig);
 							}
 							skip_wire_bits.insert(wire_bit);
 							if (!tinoutpad_portname_pad.empty())
-								rewrite_bits[wire][i] = make_pair(cell, RTLIL::escape_id(tinoutpad_portname_pad));
+								rewrite_bits[wire][i] = make_pair(cell, tinoutpad_pad);
 						} else {
 							log("Mapping port %s.%s[%d] using %s.\n", log_id(module), log_id(wire), i, toutpad_celltype.c_str());
 
-							Cell *cell = module->addCell(NEW_ID, RTLIL::escape_id(toutpad_celltype));
+							Cell *cell = module->addCell(NEW_ID, toutpad_type);
 
-							cell->setPort(RTLIL::escape_id(toutpad_portname_oe), en_sig);
-							cell->setPort(RTLIL::escape_id(toutpad_portname_i), data_sig);
+							cell->setPort(toutpad_oe, en_sig);
+							cell->setPort(toutpad_i, data_sig);
 							cell->attributes[ID::keep] = RTLIL::Const(1);
 
 							if (tbuf_cell) {
@@ -300,7 +306,7 @@ struct IopadmapPass : public Pass {
 							}
 							skip_wire_bits.insert(wire_bit);
 							if (!toutpad_portname_pad.empty())
-								rewrite_bits[wire][i] = make_pair(cell, RTLIL::escape_id(toutpad_portname_pad));
+								rewrite_bits[wire][i] = make_pair(cell, toutpad_pad);
 						}
 					}
 				}
@@ -357,6 +363,8 @@ struct IopadmapPass : public Pass {
 
 				log("Mapping port %s.%s using %s.\n", RTLIL::id2cstr(module->name), RTLIL::id2cstr(wire->name), celltype.c_str());
 
+				IdString celltype_id = id(celltype), port_int = id(portname_int), port_pad = id(portname_pad);
+
 				if (flag_bits)
 				{
 					for (int i = 0; i < wire->width; i++)
@@ -366,34 +374,34 @@ struct IopadmapPass : public Pass {
 
 						SigBit wire_bit(wire, i);
 
-						RTLIL::Cell *cell = module->addCell(NEW_ID, RTLIL::escape_id(celltype));
-						cell->setPort(RTLIL::escape_id(portname_int), wire_bit);
+						RTLIL::Cell *cell = module->addCell(NEW_ID, celltype_id);
+						cell->setPort(port_int, wire_bit);
 
 						if (!portname_pad.empty())
-							rewrite_bits[wire][i] = make_pair(cell, RTLIL::escape_id(portname_pad));
+							rewrite_bits[wire][i] = make_pair(cell, port_pad);
 						if (!widthparam.empty())
-							cell->parameters[RTLIL::escape_id(widthparam)] = RTLIL::Const(1);
+							cell->parameters[widthparam_id] = RTLIL::Const(1);
 						if (!nameparam.empty())
-							cell->parameters[RTLIL::escape_id(nameparam)] = RTLIL::Const(stringf("%s[%d]", RTLIL::id2cstr(wire->name), i));
+							cell->parameters[nameparam_id] = RTLIL::Const(stringf("%s[%d]", RTLIL::id2cstr(wire->name), i));
 						cell->attributes[ID::keep] = RTLIL::Const(1);
 					}
 				}
 				else
 				{
-					RTLIL::Cell *cell = module->addCell(NEW_ID, RTLIL::escape_id(celltype));
-					cell->setPort(RTLIL::escape_id(portname_int), RTLIL::SigSpec(wire));
+					RTLIL::Cell *cell = module->addCell(NEW_ID, celltype_id);
+					cell->setPort(port_int, RTLIL::SigSpec(wire));
 
 					if (!portname_pad.empty()) {
 						RTLIL::Wire *new_wire = NULL;
 						new_wire = module->addWire(NEW_ID, wire);
 						module->swap_names(new_wire, wire);
 						wire->attributes.clear();
-						cell->setPort(RTLIL::escape_id(portname_pad), RTLIL::SigSpec(new_wire));
+						cell->setPort(port_pad, RTLIL::SigSpec(new_wire));
 					}
 					if (!widthparam.empty())
-						cell->parameters[RTLIL::escape_id(widthparam)] = RTLIL::Const(wire->width);
+						cell->parameters[widthparam_id] = RTLIL::Const(wire->width);
 					if (!nameparam.empty())
-						cell->parameters[RTLIL::escape_id(nameparam)] = RTLIL::Const(RTLIL::id2cstr(wire->name));
+						cell->parameters[nameparam_id] = RTLIL::Const(RTLIL::id2cstr(wire->name));
 					cell->attributes[ID::keep] = RTLIL::Const(1);
 				}
 
@@ -409,19 +417,19 @@ struct IopadmapPass : public Pass {
 				RTLIL::Wire *new_wire = module->addWire(NEW_ID, wire);
 				module->swap_names(new_wire, wire);
 				wire->attributes.clear();
+				SigSig new_conn;
 				for (int i = 0; i < wire->width; i++)
 				{
-					SigBit wire_bit(wire, i);
 					if (!it.second.count(i)) {
-						if (wire->port_output)
-							module->connect(SigSpec(new_wire, i), SigSpec(wire, i));
-						else
-							module->connect(SigSpec(wire, i), SigSpec(new_wire, i));
+						new_conn.first.append(SigBit(wire->port_output ? new_wire : wire, i));
+						new_conn.second.append(SigBit(wire->port_output ? wire : new_wire, i));
 					} else {
-						auto &new_conn = it.second.at(i);
-						new_conn.first->setPort(new_conn.second, RTLIL::SigSpec(new_wire, i));
+						auto &pad_port = it.second.at(i);
+						pad_port.first->setPort(pad_port.second, RTLIL::SigSpec(new_wire, i));
 					}
 				}
+				if (GetSize(new_conn.first))
+					module->connect(new_conn);
 
 				if (wire->port_output) {
 					auto jt = new_wire->attributes.find(ID(init));
@@ -0,0 +1,397 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "passes/techmap/libparse.h"
+#include <sys/stat.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#  include <process.h>
+#else
+#  include <unistd.h>
+#endif
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+// Compiled library files start with the 8 byte magic and the 64 bit hash of
+// the liberty file they were compiled from (and of the whitelist it was
+// filtered with, if any), followed by the root node. A node
+// is its id, value, the number of args and the args, then the number of
+// children and the children. Integers are LEB128 varints. A string is written
+// as 0 followed by its length and characters the first time it occurs, and as
+// its (index+1) in the order of first occurrence afterwards.
+
+static const char libcache_magic[8] = { 'Y', 'S', 'L', 'I', 'B', 'C', 0, 1 };
+
+static uint64_t hash_file_data(const char *data, size_t size, uint64_t hash = 0xcbf29ce484222325ull)
+{
+	// FNV-1a
+	for (size_t i = 0; i < size; i++) {
+		hash ^= (unsigned char)data[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+struct LibCacheWriter
+{
+	std::string buffer;
+	dict<std::string, int> string_index;
+
+	void write_uint(uint64_t value)
+	{
+		while (value >= 0x80) {
+			buffer += char(value | 0x80);
+			value >>= 7;
+		}
+		buffer += char(value);
+	}
+
+	void write_string(const std::string &str)
+	{
+		auto it = string_index.find(str);
+		if (it != string_index.end()) {
+			write_uint(it->second + 1);
+			return;
+		}
+		int index = GetSize(string_index);
+		string_index[str] = index;
+		write_uint(0);
+		write_uint(str.size());
+		buffer += str;
+	}
+
+	void write_node(const LibertyAst *ast)
+	{
+		write_string(ast->id);
+		write_string(ast->value);
+		write_uint(ast->args.size());
+		for (auto &arg : ast->args)
+			write_string(arg);
+		write_uint(ast->children.size());
+		for (auto child : ast->children)
+			write_node(child);
+	}
+};
+
+struct LibCacheReader
+{
+	// a stale or truncated cache file is not an error, the library is simply parsed again
+	struct FormatError { };
+
+	const unsigned char *ptr, *end;
+	std::vector<std::string> strings;
+
+	LibCacheReader(const char *data, size_t size) :
+			ptr((const unsigned char*)data), end((const unsigned char*)data + size) { }
+
+	void need(size_t n)
+	{
+		if (size_t(end - ptr) < n)
+			throw FormatError();
+	}
+
+	uint64_t read_uint()
+	{
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			need(1);
+			unsigned char byte = *(ptr++);
+			value |= uint64_t(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+				return value;
+		}
+		throw FormatError();
+	}
+
+	// every counted item takes at least one byte
+	size_t read_count()
+	{
+		uint64_t value = read_uint();
+		if (value > uint64_t(end - ptr))
+			throw FormatError();
+		return value;
+	}
+
+	void read_string(std::string &str)
+	{
+		uint64_t index = read_uint();
+		if (index > 0) {
+			if (index > strings.size())
+				throw FormatError();
+			str = strings[index-1];
+			return;
+		}
+		size_t len = read_count();
+		need(len);
+		str.assign((const char*)ptr, len);
+		ptr += len;
+		strings.push_back(str);
+	}
+
+	void read_node(LibertyAst *ast)
+	{
+		read_string(ast->id);
+		read_string(ast->value);
+		ast->args.resize(read_count());
+		for (auto &arg : ast->args)
+			read_string(arg);
+		size_t num_children = read_count();
+		ast->children.reserve(num_children);
+		for (size_t i = 0; i < num_children; i++) {
+			ast->children.push_back(new LibertyAst);
+			read_node(ast->children.back());
+		}
+	}
+};
+
+static std::string compiled_filename(const std::string &cache_dir, uint64_t hash)
+{
+	return cache_dir + "/" + stringf("%016llx.ylib", (unsigned long long)hash);
+}
+
+static LibertyAst *read_compiled(const std::string &filename, uint64_t hash)
+{
+	MappedFile file;
+	if (!file.open(filename))
+		return nullptr;
+
+	LibCacheReader reader(file.data, file.size);
+	LibertyAst *ast = new LibertyAst;
+	try {
+		reader.need(sizeof(libcache_magic) + 8);
+		if (memcmp(reader.ptr, libcache_magic, sizeof(libcache_magic)) != 0)
+			throw LibCacheReader::FormatError();
+		reader.ptr += sizeof(libcache_magic);
+		uint64_t file_hash = 0;
+		for (int i = 0; i < 8; i++)
+			file_hash |= uint64_t(*(reader.ptr++)) << (8*i);
+		if (file_hash != hash)
+			throw LibCacheReader::FormatError();
+		reader.read_node(ast);
+	} catch (LibCacheReader::FormatError&) {
+		log_warning("Ignoring invalid compiled liberty file `%s'.\n", filename.c_str());
+		delete ast;
+		return nullptr;
+	}
+	return ast;
+}
+
+static void write_compiled(const std::string &filename, uint64_t hash, const LibertyAst *ast)
+{
+	LibCacheWriter writer;
+	writer.buffer.append(libcache_magic, sizeof(libcache_magic));
+	for (int i = 0; i < 8; i++)
+		writer.buffer += char(hash >> (8*i));
+	writer.write_node(ast);
+
+	// write to a temporary file first so that concurrent yosys processes
+	// never see a partially written cache file
+	std::string tmp_filename = stringf("%s.%d.tmp", filename.c_str(), int(getpid()));
+	std::ofstream f(tmp_filename.c_str(), std::ofstream::binary);
+	f.write(writer.buffer.data(), writer.buffer.size());
+	f.close();
+	if (f.fail() || rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+		log_warning("Can't write compiled liberty file `%s': %s\n", filename.c_str(), strerror(errno));
+		remove(tmp_filename.c_str());
+	}
+}
+
+PRIVATE_NAMESPACE_END
+
+YOSYS_NAMESPACE_BEGIN
+
+LibertyAstCache LibertyAstCache::instance;
+
+struct LibertyAstCache::Entry
+{
+	std::string filename;
+	bool filtered;
+	int64_t size;
+	int64_t mtime;
+	LibertyAst *ast;
+};
+
+LibertyAstCache::~LibertyAstCache()
+{
+	clear();
+}
+
+void LibertyAstCache::clear()
+{
+	for (auto &it : entries) {
+		delete it.second->ast;
+		delete it.second;
+	}
+	entries.clear();
+}
+
+LibertyAst *LibertyAstCache::cached_ast(const std::string &filename, const std::set<std::string> &whitelist)
+{
+	struct stat st;
+	if (stat(filename.c_str(), &st) != 0)
+		log_cmd_error("Can't open liberty file `%s': %s\n", filename.c_str(), strerror(errno));
+	yosys_input_files.insert(filename);
+
+	std::string filter_key;
+	for (auto &path : whitelist)
+		filter_key += "\n" + path;
+
+	// a complete library also serves requests for a filtered one
+	for (auto &key : { filename, filename + filter_key }) {
+		auto it = entries.find(key);
+		if (it == entries.end())
+			continue;
+		if (it->second->size == int64_t(st.st_size) && it->second->mtime == int64_t(st.st_mtime)) {
+			log("Using liberty file `%s' parsed earlier in this session.\n", filename.c_str());
+			return it->second->ast;
+		}
+		delete it->second->ast;
+		delete it->second;
+		entries.erase(it);
+	}
+
+	MappedFile file;
+	if (!file.open(filename))
+		log_cmd_error("Can't open liberty file `%s': %s\n", filename.c_str(), strerror(errno));
+	if (file.is_compressed())
+		return nullptr;
+
+	LibertyAst *ast = nullptr;
+	uint64_t hash = 0;
+	if (!cache_dir.empty()) {
+		hash = hash_file_data(file.data, file.size);
+		if (!filter_key.empty())
+			hash = hash_file_data(filter_key.data(), filter_key.size(), hash);
+		ast = read_compiled(compiled_filename(cache_dir, hash), hash);
+		if (ast != nullptr)
+			log("Loaded compiled liberty file for `%s' from `%s'.\n", filename.c_str(), cache_dir.c_str());
+	}
+	file.close();
+
+	if (ast == nullptr) {
+		std::ifstream f;
+		f.open(filename.c_str());
+		if (f.fail())
+			log_cmd_error("Can't open liberty file `%s': %s\n", filename.c_str(), strerror(errno));
+		LibertyParser parser(f, whitelist);
+		ast = parser.ast;
+		parser.ast = nullptr;
+		if (ast == nullptr)
+			log_cmd_error("Liberty file `%s' is empty.\n", filename.c_str());
+		if (!cache_dir.empty())
+			write_compiled(compiled_filename(cache_dir, hash), hash, ast);
+	}
+
+	Entry *entry = new Entry;
+	entry->filename = filename;
+	entry->filtered = !filter_key.empty();
+	entry->size = st.st_size;
+	entry->mtime = st.st_mtime;
+	entry->ast = ast;
+	entries[filename + filter_key] = entry;
+	return ast;
+}
+
+YOSYS_NAMESPACE_END
+
+PRIVATE_NAMESPACE_BEGIN
+
+struct LibertyCachePass : public Pass {
+	LibertyCachePass() : Pass("liberty_cache", "configure the cache of parsed liberty files") { }
+	void help() YS_OVERRIDE
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    liberty_cache [options]\n");
+		log("\n");
+		log("Liberty files read by 'read_liberty', 'dfflibmap' and 'stat -liberty' are parsed\n");
+		log("once per session and the parsed library is shared by all later commands, as long\n");
+		log("as the size and modification time of the file do not change. Gzip compressed\n");
+		log("files are not cached. This command configures that cache.\n");
+		log("\n");
+		log("    -dir <directory>\n");
+		log("        also store parsed libraries in a compiled binary form in this directory\n");
+		log("        and load them from there in later sessions. Compiled files are named\n");
+		log("        after a hash of the liberty file contents, so the same directory can be\n");
+		log("        shared by different libraries and yosys processes.\n");
+		log("\n");
+		log("    -nodir\n");
+		log("        stop using a directory for compiled libraries.\n");
+		log("\n");
+		log("    -clear\n");
+		log("        free all libraries held in memory.\n");
+		log("\n");
+		log("    -list\n");
+		log("        list the libraries held in memory.\n");
+		log("\n");
+		log("Note that 'abc -liberty' passes the liberty file to ABC, which parses it on its\n");
+		log("own and does not use this cache.\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design*) YS_OVERRIDE
+	{
+		LibertyAstCache &cache = LibertyAstCache::instance;
+		bool flag_list = false;
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-dir" && argidx+1 < args.size()) {
+				std::string dir = args[++argidx];
+				rewrite_filename(dir);
+				struct stat st;
+#ifdef _WIN32
+				if (stat(dir.c_str(), &st) != 0 && mkdir(dir.c_str()) != 0)
+#else
+				if (stat(dir.c_str(), &st) != 0 && mkdir(dir.c_str(), 0777) != 0)
+#endif
+					log_cmd_error("Can't create directory `%s': %s\n", dir.c_str(), strerror(errno));
+				cache.cache_dir = dir;
+				continue;
+			}
+			if (args[argidx] == "-nodir") {
+				cache.cache_dir.clear();
+				continue;
+			}
+			if (args[argidx] == "-clear") {
+				cache.clear();
+				continue;
+			}
+			if (args[argidx] == "-list") {
+				flag_list = true;
+				continue;
+			}
+			break;
+		}
+		if (argidx != args.size())
+			cmd_error(args, argidx, "Extra argument.");
+
+		if (flag_list) {
+			for (auto &it : cache.entries)
+				log("%s%s\n", it.second->filename.c_str(), it.second->filtered ? " (filtered)" : "");
+			if (!cache.cache_dir.empty())
+				log("Compiled libraries are stored in `%s'.\n", cache.cache_dir.c_str());
+		}
+	}
+} LibertyCachePass;
+
+PRIVATE_NAMESPACE_END
@@ -182,22 +182,110 @@ int LibertyParser::lexer(std::string &str)
 	return c;
 }
 
-LibertyAst *LibertyParser::parse()
+bool LibertyParser::filtered(const std::string &path, const std::string &id, bool path_ok) const
 {
-	std::string str;
+	if (blacklist.count(id) > 0 || blacklist.count(path) > 0)
+		return true;
+	return whitelist.size() > 0 && whitelist.count(id) == 0 && whitelist.count(path) == 0 && !path_ok;
+}
 
-	int tok = lexer(str);
+void LibertyParser::skip_statement()
+{
+	// Consumes the rest of a statement, including a { ... } group, without
+	// tokenizing it. Strings, comments and line continuations are handled
+	// like in lexer(), so that the statement ends where parse() would end it.
+	std::streambuf *sb = f.rdbuf();
+	int depth = 0;
+	while (1) {
+		int c = sb->sbumpc();
+		if (c == EOF)
+			return;
+		if (c == '"') {
+			while ((c = sb->sbumpc()) != EOF && c != '"')
+				if (c == '\n')
+					line++;
+			continue;
+		}
+		if (c == '/') {
+			c = sb->sgetc();
+			if (c == '*') {
+				int last_c = 0;
+				while (c != EOF && (last_c != '*' || c != '/')) {
+					last_c = c;
+					c = sb->snextc();
+					if (c == '\n')
+						line++;
+				}
+				sb->sbumpc();
+			} else if (c == '/') {
+				while (c != EOF && c != '\n')
+					c = sb->snextc();
+				sb->sbumpc();
+				line++;
+			}
+			continue;
+		}
+		if (c == '\\') {
+			c = sb->sgetc();
+			if (c == '\r')
+				c = sb->snextc();
+			if (c == '\n') {
+				sb->sbumpc();
+				line++;
+			}
+			continue;
+		}
+		if (c == '\n') {
+			line++;
+			if (depth == 0)
+				return;
+			continue;
+		}
+		if (c == ';' && depth == 0)
+			return;
+		if (c == '{')
+			depth++;
+		if (c == '}') {
+			if (depth == 0) {
+				// leave the end of the enclosing group to the caller
+				sb->sungetc();
+				return;
+			}
+			if (--depth == 0)
+				return;
+		}
+	}
+}
 
-	// there are liberty files in the wild that
-	// have superfluous ';' at the end of
-	// a  { ... }. We simply ignore a ';' here.
-	// and get to the next statement.
+LibertyAst *LibertyParser::parse(const std::string &parent_path, bool parent_ok)
+{
+	std::string str, path;
+	bool path_ok = parent_ok || whitelist.count(parent_path + "/*") > 0;
 
-	while ((tok == 'n') || (tok == ';'))
+	int tok;
+	while (1)
+	{
 		tok = lexer(str);
 
-	if (tok == '}' || tok < 0)
-		return NULL;
+		// there are liberty files in the wild that
+		// have superfluous ';' at the end of
+		// a  { ... }. We simply ignore a ';' here.
+		// and get to the next statement.
+
+		while ((tok == 'n') || (tok == ';'))
+			tok = lexer(str);
+
+		if (tok == '}' || tok < 0)
+			return NULL;
+
+		if (tok != 'v' || (whitelist.empty() && blacklist.empty()))
+			break;
+
+		path = parent_path + "/" + str;
+		if (!filtered(path, str, path_ok))
+			break;
+		skip_statement();
+	}
 
 	if (tok != 'v') {
 		std::string eReport;
@@ -337,8 +425,10 @@ LibertyAst *LibertyParser::parse()
 		}
 
 		if (tok == '{') {
+			if (path.empty())
+				path = parent_path + "/" + ast->id;
 			while (1) {
-				LibertyAst *child = parse();
+				LibertyAst *child = parse(path, path_ok);
 				if (child == NULL)
 					break;
 				ast->children.push_back(child);
@@ -760,13 +850,21 @@ int main(int argc, char **argv)
 		f = ff;
 	}
 
-	LibertyParser parser(*f);
-	if (parser.ast) {
+	// -verilogsim only looks at whitelisted groups, so everything else is skipped
+	// while parsing. dump() filters on its own, because it reports the entries it
+	// adds to the blacklist and prints groups whose children were all removed.
+	LibertyParser *parser;
+	if (flag_verilogsim)
+		parser = new LibertyParser(*f, LibertyAst::whitelist, LibertyAst::blacklist);
+	else
+		parser = new LibertyParser(*f);
+	if (parser->ast) {
 		if (flag_verilogsim)
-			gen_verilogsim(parser.ast);
+			gen_verilogsim(parser->ast);
 		else
-			parser.ast->dump(stdout);
+			parser->ast->dump(stdout);
 	}
+	delete parser;
 
 	if (argc == 3)
 		delete f;
@@ -24,6 +24,7 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <map>
 
 namespace Yosys
 {
@@ -43,8 +44,17 @@ namespace Yosys
 	{
 		std::istream &f;
 		int line;
+
+		// Statements are skipped while parsing, without building an AST for them,
+		// if their id or path (e.g. "/library/cell/pin") is in the blacklist, or
+		// if the whitelist is not empty and contains neither of them nor the parent
+		// path followed by "/*". This is the same filter as in LibertyAst::dump().
+		std::set<std::string> whitelist, blacklist;
+
 		LibertyAst *ast;
 		LibertyParser(std::istream &f) : f(f), line(1), ast(parse()) {}
+		LibertyParser(std::istream &f, const std::set<std::string> &whitelist, const std::set<std::string> &blacklist = std::set<std::string>()) :
+				f(f), line(1), whitelist(whitelist), blacklist(blacklist), ast(parse()) {}
 		~LibertyParser() { if (ast) delete ast; }
         
         /* lexer return values:
@@ -54,10 +64,34 @@ namespace Yosys
         */
 		int lexer(std::string &str);
 		
-        LibertyAst *parse();
+        LibertyAst *parse(const std::string &parent_path = std::string(), bool parent_ok = false);
+		bool filtered(const std::string &path, const std::string &id, bool path_ok) const;
+		void skip_statement();
 		void error();
         void error(const std::string &str);
 	};
+
+#ifndef FILTERLIB
+	// Parsed liberty files shared by all commands in a session, see 'help liberty_cache'
+	struct LibertyAstCache
+	{
+		struct Entry;
+
+		// directory for compiled libraries, empty if not used
+		std::string cache_dir;
+		std::map<std::string, Entry*> entries;
+
+		~LibertyAstCache();
+		void clear();
+
+		// Returns the parsed library, which is owned by the cache and must not be
+		// modified. Returns NULL for gzip compressed files, which are not cached.
+		// With a whitelist, see LibertyParser, the library may be a filtered one.
+		LibertyAst *cached_ast(const std::string &filename, const std::set<std::string> &whitelist = std::set<std::string>());
+
+		static LibertyAstCache instance;
+	};
+#endif
 }
 
 #endif
@@ -23,32 +23,36 @@
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
-int lut2mux(Cell *cell)
+// Builds the mux tree for the part of the LUT table at the offset that is
+// selected by the inputs below width, returns the number of muxes
+int lut2mux(Module *module, const SigSpec &sig_a, const Const &lut, int offset, int width, SigBit sig_y)
 {
-	SigSpec sig_a = cell->getPort(ID::A);
-	SigSpec sig_y = cell->getPort(ID::Y);
-	Const lut = cell->getParam(ID(LUT));
-	int count = 1;
-
-	if (GetSize(sig_a) == 1)
+	if (width == 1)
 	{
-		cell->module->addMuxGate(NEW_ID, lut.extract(0)[0], lut.extract(1)[0], sig_a, sig_y);
+		SigBit lut0 = offset < GetSize(lut) ? lut[offset] : State::S0;
+		SigBit lut1 = offset+1 < GetSize(lut) ? lut[offset+1] : State::S0;
+		module->addMuxGate(NEW_ID, lut0, lut1, sig_a[0], sig_y);
+		return 1;
 	}
-	else
-	{
-		SigSpec sig_a_hi = sig_a[GetSize(sig_a)-1];
-		SigSpec sig_a_lo = sig_a.extract(0, GetSize(sig_a)-1);
-		SigSpec sig_y1 = cell->module->addWire(NEW_ID);
-		SigSpec sig_y2 = cell->module->addWire(NEW_ID);
 
-		Const lut1 = lut.extract(0, GetSize(lut)/2);
-		Const lut2 = lut.extract(GetSize(lut)/2, GetSize(lut)/2);
+	SigBit sig_y1 = module->addWire(NEW_ID);
+	SigBit sig_y2 = module->addWire(NEW_ID);
 
-		count += lut2mux(cell->module->addLut(NEW_ID, sig_a_lo, sig_y1, lut1));
-		count += lut2mux(cell->module->addLut(NEW_ID, sig_a_lo, sig_y2, lut2));
+	int count = 1;
+	count += lut2mux(module, sig_a, lut, offset, width-1, sig_y1);
+	count += lut2mux(module, sig_a, lut, offset + (1 << (width-1)), width-1, sig_y2);
 
-		cell->module->addMuxGate(NEW_ID, sig_y1, sig_y2, sig_a_hi, sig_y);
-	}
+	module->addMuxGate(NEW_ID, sig_y1, sig_y2, sig_a[width-1], sig_y);
+	return count;
+}
+
+int lut2mux(Cell *cell)
+{
+	SigSpec sig_a = cell->getPort(ID::A);
+	SigSpec sig_y = cell->getPort(ID::Y);
+	Const lut = cell->getParam(ID(LUT));
+
+	int count = lut2mux(cell->module, sig_a, lut, 0, GetSize(sig_a), sig_y);
 
 	cell->module->remove(cell);
 	return count;
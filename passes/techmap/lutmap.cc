@@ -0,0 +1,711 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "kernel/sigtools.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+// [[CITE]] Priority cuts
+// Alan Mishchenko, Sungmin Cho, Satrajit Chatterjee, Robert Brayton, "Combinational and Sequential Mapping
+// with Priority Cuts", Proceedings of ICCAD 2007, pp. 354-361.
+
+// Truth tables are 64 bit words over up to 6 variables. A function of fewer variables does not depend on the
+// remaining ones, i.e. its truth table is repeated to fill the word.
+
+static const uint64_t lutmap_var_tt[6] = {
+	0xAAAAAAAAAAAAAAAAULL,
+	0xCCCCCCCCCCCCCCCCULL,
+	0xF0F0F0F0F0F0F0F0ULL,
+	0xFF00FF00FF00FF00ULL,
+	0xFFFF0000FFFF0000ULL,
+	0xFFFFFFFF00000000ULL
+};
+
+// swap the variables i and i+1
+static uint64_t lutmap_tt_swap(uint64_t tt, int i)
+{
+	uint64_t m1 = lutmap_var_tt[i] & ~lutmap_var_tt[i+1];
+	uint64_t m2 = ~lutmap_var_tt[i] & lutmap_var_tt[i+1];
+	int shift = 1 << i;
+	return (tt & ~(m1 | m2)) | ((tt & m1) << shift) | ((tt & m2) >> shift);
+}
+
+static bool lutmap_tt_depends_on(uint64_t tt, int i)
+{
+	return ((tt & lutmap_var_tt[i]) >> (1 << i)) != (tt & ~lutmap_var_tt[i]);
+}
+
+struct LutmapCut
+{
+	int size;
+	int leaves[6];
+	uint64_t truth;
+	int depth;
+	float area_flow;
+};
+
+struct LutmapWorker
+{
+	RTLIL::Module *module;
+	SigMap sigmap;
+	int lut_size, max_cuts;
+	bool opt_recover;
+
+	// AIG with node 0 as constant zero. Literals are 2*node+inverted.
+	enum node_type_t { NODE_CONST, NODE_INPUT, NODE_AND };
+	std::vector<node_type_t> node_types;
+	std::vector<RTLIL::SigBit> node_bits;
+	std::vector<int> node_fanin0, node_fanin1;
+	std::vector<int> node_fanouts;
+
+	// nodes are created in topological order, so AND nodes appear after their fanins
+	std::vector<int> and_nodes;
+	std::vector<pair<RTLIL::SigBit, int>> outputs;
+
+	// cuts are kept in an array with max_cuts slots per node, sorted by priority
+	std::vector<LutmapCut> cuts;
+	std::vector<int> num_cuts, best_cut;
+	std::vector<int> node_depth, node_required, node_refs;
+	std::vector<float> node_area_flow;
+
+	std::vector<RTLIL::Cell*> aig_cells;
+
+	LutmapWorker(RTLIL::Module *module, int lut_size, int max_cuts, bool opt_recover) :
+			module(module), sigmap(module), lut_size(lut_size), max_cuts(max_cuts), opt_recover(opt_recover) { }
+
+	int add_node(node_type_t type, RTLIL::SigBit bit)
+	{
+		node_types.push_back(type);
+		node_bits.push_back(bit);
+		node_fanin0.push_back(-1);
+		node_fanin1.push_back(-1);
+		node_fanouts.push_back(0);
+		return GetSize(node_types) - 1;
+	}
+
+	bool build_aig()
+	{
+		dict<RTLIL::SigBit, RTLIL::Cell*> and_drivers, not_drivers;
+
+		for (auto cell : module->selected_cells()) {
+			if (cell->type == ID($_AND_))
+				and_drivers[sigmap(cell->getPort(ID::Y))] = cell;
+			else if (cell->type == ID($_NOT_))
+				not_drivers[sigmap(cell->getPort(ID::Y))] = cell;
+			else
+				continue;
+			aig_cells.push_back(cell);
+		}
+
+		if (and_drivers.empty())
+			return false;
+
+		add_node(NODE_CONST, State::S0);
+
+		dict<RTLIL::SigBit, int> bit_nodes;
+
+		auto strip_nots = [&](RTLIL::SigBit bit, bool &inverted) {
+			inverted = false;
+			bit = sigmap(bit);
+			for (int i = 0; not_drivers.count(bit); i++) {
+				if (i > GetSize(not_drivers))
+					log_error("Found a loop of $_NOT_ cells driving %s in module %s.\n", log_signal(bit), log_id(module));
+				inverted = !inverted;
+				bit = sigmap(not_drivers.at(bit)->getPort(ID::A));
+			}
+			return bit;
+		};
+
+		auto get_literal = [&](RTLIL::SigBit bit) {
+			bool inverted;
+			bit = strip_nots(bit, inverted);
+			if (bit.wire == nullptr)
+				return (bit == State::S1) != inverted ? 1 : 0;
+			auto it = bit_nodes.find(bit);
+			if (it == bit_nodes.end()) {
+				log_assert(and_drivers.count(bit) == 0);
+				int node = add_node(NODE_INPUT, bit);
+				it = bit_nodes.insert(std::make_pair(bit, node)).first;
+			}
+			return 2 * it->second + (inverted ? 1 : 0);
+		};
+
+		// create the AND nodes in post-order
+		dict<RTLIL::Cell*, int> states;
+		std::vector<RTLIL::Cell*> stack;
+
+		for (auto &it : and_drivers)
+		{
+			if (states[it.second] != 0)
+				continue;
+
+			stack.push_back(it.second);
+			while (!stack.empty())
+			{
+				RTLIL::Cell *cell = stack.back();
+				states[cell] = 1;
+
+				bool ready = true;
+				for (auto port : {ID::A, ID::B}) {
+					bool inverted;
+					RTLIL::SigBit bit = strip_nots(cell->getPort(port), inverted);
+					if (!and_drivers.count(bit))
+						continue;
+					RTLIL::Cell *driver = and_drivers.at(bit);
+					if (states[driver] == 1)
+						log_error("Found a combinational loop through %s in module %s.\n", log_id(driver), log_id(module));
+					if (states[driver] == 0) {
+						stack.push_back(driver);
+						ready = false;
+						break;
+					}
+				}
+
+				if (!ready)
+					continue;
+
+				stack.pop_back();
+				states[cell] = 2;
+
+				int fanin0 = get_literal(cell->getPort(ID::A));
+				int fanin1 = get_literal(cell->getPort(ID::B));
+				int node = add_node(NODE_AND, sigmap(cell->getPort(ID::Y)));
+				node_fanin0[node] = fanin0;
+				node_fanin1[node] = fanin1;
+				node_fanouts[fanin0 / 2]++;
+				node_fanouts[fanin1 / 2]++;
+				bit_nodes[node_bits[node]] = node;
+				and_nodes.push_back(node);
+			}
+		}
+
+		// AIG signals that are used by anything but the AIG cells are outputs
+		pool<RTLIL::Cell*> aig_cell_set(aig_cells.begin(), aig_cells.end());
+		pool<RTLIL::SigBit> used_bits;
+
+		for (auto cell : module->cells()) {
+			if (aig_cell_set.count(cell))
+				continue;
+			for (auto &conn : cell->connections())
+				if (!cell->known() || cell->input(conn.first))
+					for (auto bit : sigmap(conn.second))
+						used_bits.insert(bit);
+		}
+
+		for (auto wire : module->wires())
+			if (wire->port_output || wire->get_bool_attribute(ID::keep))
+				for (auto bit : sigmap(wire))
+					used_bits.insert(bit);
+
+		for (auto cell : aig_cells) {
+			RTLIL::SigBit bit = sigmap(cell->getPort(ID::Y));
+			if (!used_bits.count(bit))
+				continue;
+			int literal = get_literal(bit);
+			outputs.push_back(std::make_pair(bit, literal));
+			node_fanouts[literal / 2]++;
+		}
+
+		log("Found %d AND nodes, %d inputs and %d outputs.\n", GetSize(and_nodes),
+				GetSize(node_types) - GetSize(and_nodes) - 1, GetSize(outputs));
+		return true;
+	}
+
+	LutmapCut *node_cuts(int node)
+	{
+		return &cuts[node * max_cuts];
+	}
+
+	void eval_cut(LutmapCut &cut)
+	{
+		// a cut without leaves is a constant and needs no LUT
+		cut.depth = 0;
+		cut.area_flow = 0;
+		if (cut.size == 0)
+			return;
+
+		for (int i = 0; i < cut.size; i++) {
+			int leaf = cut.leaves[i];
+			cut.depth = max(cut.depth, node_depth[leaf]);
+			cut.area_flow += node_area_flow[leaf];
+		}
+		cut.depth++;
+		cut.area_flow++;
+	}
+
+	static bool cut_better_depth(const LutmapCut &a, const LutmapCut &b)
+	{
+		if (a.depth != b.depth)
+			return a.depth < b.depth;
+		if (a.size != b.size)
+			return a.size < b.size;
+		return a.area_flow < b.area_flow;
+	}
+
+	static bool cut_better_area(const LutmapCut &a, const LutmapCut &b)
+	{
+		if (a.area_flow != b.area_flow)
+			return a.area_flow < b.area_flow;
+		if (a.depth != b.depth)
+			return a.depth < b.depth;
+		return a.size < b.size;
+	}
+
+	static bool cut_dominates(const LutmapCut &a, const LutmapCut &b)
+	{
+		// all leaves of a are leaves of b, leaves are sorted
+		if (a.size > b.size)
+			return false;
+		for (int i = 0, j = 0; i < a.size; i++, j++) {
+			while (j < b.size && b.leaves[j] < a.leaves[i])
+				j++;
+			if (j == b.size || b.leaves[j] != a.leaves[i])
+				return false;
+		}
+		return true;
+	}
+
+	bool merge_cuts(const LutmapCut &a, const LutmapCut &b, LutmapCut &cut)
+	{
+		int i = 0, j = 0;
+		cut.size = 0;
+		while (i < a.size || j < b.size) {
+			if (cut.size == lut_size)
+				return false;
+			if (j == b.size || (i < a.size && a.leaves[i] < b.leaves[j]))
+				cut.leaves[cut.size++] = a.leaves[i++];
+			else if (i == a.size || b.leaves[j] < a.leaves[i])
+				cut.leaves[cut.size++] = b.leaves[j++];
+			else
+				cut.leaves[cut.size++] = a.leaves[i++], j++;
+		}
+		return true;
+	}
+
+	// moves the variables of a cut's truth table to their positions in a larger cut
+	static uint64_t stretch_truth(const LutmapCut &from, const LutmapCut &to)
+	{
+		uint64_t tt = from.truth;
+		int pos[6];
+		for (int i = 0, j = 0; i < from.size; i++) {
+			while (to.leaves[j] != from.leaves[i])
+				j++;
+			pos[i] = j;
+		}
+		for (int i = from.size-1; i >= 0; i--)
+			for (int j = i; j < pos[i]; j++)
+				tt = lutmap_tt_swap(tt, j);
+		return tt;
+	}
+
+	// removes the leaves the function does not depend on
+	static void minimize_cut(LutmapCut &cut)
+	{
+		for (int i = cut.size-1; i >= 0; i--) {
+			if (lutmap_tt_depends_on(cut.truth, i))
+				continue;
+			for (int j = i; j < cut.size-1; j++) {
+				cut.truth = lutmap_tt_swap(cut.truth, j);
+				cut.leaves[j] = cut.leaves[j+1];
+			}
+			cut.size--;
+		}
+	}
+
+	void fanin_cuts(std::vector<LutmapCut> &result, int literal)
+	{
+		int node = literal / 2;
+		result.clear();
+
+		LutmapCut trivial;
+		if (node_types[node] == NODE_CONST) {
+			trivial.size = 0;
+			trivial.truth = 0;
+		} else {
+			trivial.size = 1;
+			trivial.leaves[0] = node;
+			trivial.truth = lutmap_var_tt[0];
+		}
+		result.push_back(trivial);
+
+		if (node_types[node] == NODE_AND)
+			result.insert(result.end(), node_cuts(node), node_cuts(node) + num_cuts[node]);
+
+		if (literal & 1)
+			for (auto &cut : result)
+				cut.truth = ~cut.truth;
+	}
+
+	void insert_cut(int node, const LutmapCut &cut)
+	{
+		LutmapCut *node_cut_list = node_cuts(node);
+		int &count = num_cuts[node];
+
+		for (int i = 0; i < count; i++)
+			if (cut_dominates(node_cut_list[i], cut))
+				return;
+
+		int k = 0;
+		for (int i = 0; i < count; i++)
+			if (!cut_dominates(cut, node_cut_list[i]))
+				node_cut_list[k++] = node_cut_list[i];
+		count = k;
+
+		int pos = count;
+		while (pos > 0 && cut_better_depth(cut, node_cut_list[pos-1]))
+			pos--;
+		if (pos == max_cuts)
+			return;
+
+		if (count == max_cuts)
+			count--;
+		for (int i = count; i > pos; i--)
+			node_cut_list[i] = node_cut_list[i-1];
+		node_cut_list[pos] = cut;
+		count++;
+	}
+
+	void enumerate_cuts()
+	{
+		int num_nodes = GetSize(node_types);
+		cuts.resize(num_nodes * max_cuts);
+		num_cuts.assign(num_nodes, 0);
+		best_cut.assign(num_nodes, 0);
+		node_depth.assign(num_nodes, 0);
+		node_area_flow.assign(num_nodes, 0);
+
+		std::vector<LutmapCut> cuts0, cuts1;
+
+		for (int node : and_nodes)
+		{
+			fanin_cuts(cuts0, node_fanin0[node]);
+			fanin_cuts(cuts1, node_fanin1[node]);
+
+			for (auto &cut0 : cuts0)
+			for (auto &cut1 : cuts1)
+			{
+				LutmapCut cut;
+				if (!merge_cuts(cut0, cut1, cut))
+					continue;
+				cut.truth = stretch_truth(cut0, cut) & stretch_truth(cut1, cut);
+				minimize_cut(cut);
+				eval_cut(cut);
+				insert_cut(node, cut);
+			}
+
+			log_assert(num_cuts[node] > 0);
+			update_node(node, 0);
+		}
+	}
+
+	void update_node(int node, int cut_index)
+	{
+		const LutmapCut &cut = node_cuts(node)[cut_index];
+		best_cut[node] = cut_index;
+		node_depth[node] = cut.depth;
+		node_area_flow[node] = cut.area_flow / max(1, node_fanouts[node]);
+	}
+
+	// marks the nodes used by the current cover and returns the depth
+	int compute_cover()
+	{
+		int depth = 0;
+		node_refs.assign(GetSize(node_types), 0);
+		node_required.assign(GetSize(node_types), INT_MAX);
+
+		for (auto &it : outputs) {
+			int node = it.second / 2;
+			if (node_types[node] == NODE_AND)
+				depth = max(depth, node_depth[node]);
+		}
+
+		for (auto &it : outputs) {
+			int node = it.second / 2;
+			if (node_types[node] == NODE_AND) {
+				node_refs[node]++;
+				node_required[node] = depth;
+			}
+		}
+
+		for (int i = GetSize(and_nodes)-1; i >= 0; i--) {
+			int node = and_nodes[i];
+			if (node_refs[node] == 0)
+				continue;
+			const LutmapCut &cut = node_cuts(node)[best_cut[node]];
+			for (int k = 0; k < cut.size; k++) {
+				int leaf = cut.leaves[k];
+				if (node_types[leaf] != NODE_AND)
+					continue;
+				node_refs[leaf]++;
+				node_required[leaf] = min(node_required[leaf], node_required[node] - 1);
+			}
+		}
+
+		return depth;
+	}
+
+	// picks the cut with the least area flow that meets the required time of each node
+	void recover_area_flow()
+	{
+		for (int node : and_nodes)
+		{
+			LutmapCut *node_cut_list = node_cuts(node);
+			int best = -1;
+
+			for (int i = 0; i < num_cuts[node]; i++) {
+				eval_cut(node_cut_list[i]);
+				if (node_cut_list[i].depth > node_required[node])
+					continue;
+				if (best < 0 || cut_better_area(node_cut_list[i], node_cut_list[best]))
+					best = i;
+			}
+
+			if (best < 0)
+				for (int i = 0; i < num_cuts[node]; i++)
+					if (best < 0 || cut_better_depth(node_cut_list[i], node_cut_list[best]))
+						best = i;
+
+			update_node(node, best);
+		}
+	}
+
+	// references the cut and returns the number of LUTs that are added to the cover
+	int ref_cut(const LutmapCut &cut)
+	{
+		int area = 1;
+		std::vector<const LutmapCut*> worklist = {&cut};
+		while (!worklist.empty()) {
+			const LutmapCut *c = worklist.back();
+			worklist.pop_back();
+			for (int i = 0; i < c->size; i++) {
+				int leaf = c->leaves[i];
+				if (node_types[leaf] == NODE_AND && node_refs[leaf]++ == 0) {
+					worklist.push_back(&node_cuts(leaf)[best_cut[leaf]]);
+					area++;
+				}
+			}
+		}
+		return area;
+	}
+
+	// dereferences the cut and returns the number of LUTs that are removed from the cover
+	int deref_cut(const LutmapCut &cut)
+	{
+		int area = 1;
+		std::vector<const LutmapCut*> worklist = {&cut};
+		while (!worklist.empty()) {
+			const LutmapCut *c = worklist.back();
+			worklist.pop_back();
+			for (int i = 0; i < c->size; i++) {
+				int leaf = c->leaves[i];
+				if (node_types[leaf] == NODE_AND && --node_refs[leaf] == 0) {
+					worklist.push_back(&node_cuts(leaf)[best_cut[leaf]]);
+					area++;
+				}
+			}
+		}
+		return area;
+	}
+
+	// picks the cut that adds the fewest LUTs to the cover, given the cuts of all other nodes
+	void recover_exact_area()
+	{
+		for (int node : and_nodes)
+		{
+			if (node_refs[node] == 0)
+				continue;
+
+			LutmapCut *node_cut_list = node_cuts(node);
+			deref_cut(node_cut_list[best_cut[node]]);
+
+			int best = -1, best_area = 0;
+			for (int i = 0; i < num_cuts[node]; i++) {
+				eval_cut(node_cut_list[i]);
+				if (node_cut_list[i].depth > node_required[node] && i != best_cut[node])
+					continue;
+				int area = ref_cut(node_cut_list[i]);
+				deref_cut(node_cut_list[i]);
+				if (best < 0 || area < best_area || (area == best_area && node_cut_list[i].depth < node_cut_list[best].depth))
+					best = i, best_area = area;
+			}
+
+			update_node(node, best);
+			ref_cut(node_cut_list[best]);
+		}
+	}
+
+	void create_luts()
+	{
+		for (auto cell : aig_cells)
+			module->remove(cell);
+
+		int lut_count = 0;
+		for (int node : and_nodes)
+		{
+			if (node_refs[node] == 0)
+				continue;
+
+			const LutmapCut &cut = node_cuts(node)[best_cut[node]];
+
+			if (cut.size == 0) {
+				module->connect(node_bits[node], (cut.truth & 1) ? State::S1 : State::S0);
+				continue;
+			}
+
+			RTLIL::SigSpec sig_a;
+			for (int i = 0; i < cut.size; i++)
+				sig_a.append(node_bits[cut.leaves[i]]);
+
+			RTLIL::Const lut(State::S0, 1 << cut.size);
+			for (int i = 0; i < (1 << cut.size); i++)
+				if ((cut.truth >> i) & 1)
+					lut.bits()[i] = State::S1;
+
+			module->addLut(NEW_ID, sig_a, node_bits[node], lut);
+			lut_count++;
+		}
+
+		int inv_count = 0;
+		for (auto &it : outputs)
+		{
+			int node = it.second / 2;
+			if (it.first == node_bits[node])
+				continue;
+
+			RTLIL::SigBit sig = node_bits[node];
+			if (node_types[node] == NODE_AND && node_refs[node] > 0 && node_cuts(node)[best_cut[node]].size == 0)
+				sig = (node_cuts(node)[best_cut[node]].truth & 1) ? State::S1 : State::S0;
+
+			if ((it.second & 1) == 0)
+				module->connect(it.first, sig);
+			else if (sig.wire == nullptr)
+				module->connect(it.first, sig == State::S1 ? State::S0 : State::S1);
+			else {
+				module->addLut(NEW_ID, sig, it.first, RTLIL::Const::from_string("01"));
+				inv_count++;
+			}
+		}
+
+		log("Created %d LUTs and %d inverters.\n", lut_count, inv_count);
+	}
+
+	void run()
+	{
+		if (!build_aig())
+			return;
+
+		enumerate_cuts();
+		int depth = compute_cover();
+		log("Depth-optimal cover: %d LUTs, depth %d.\n", count_luts(), depth);
+
+		if (opt_recover)
+		{
+			recover_area_flow();
+			compute_cover();
+			log("After area flow recovery: %d LUTs.\n", count_luts());
+
+			recover_exact_area();
+			depth = compute_cover();
+			log("After exact area recovery: %d LUTs, depth %d.\n", count_luts(), depth);
+		}
+
+		create_luts();
+	}
+
+	int count_luts()
+	{
+		int count = 0;
+		for (int node : and_nodes)
+			if (node_refs[node] > 0 && node_cuts(node)[best_cut[node]].size > 0)
+				count++;
+		return count;
+	}
+};
+
+struct LutmapPass : public Pass {
+	LutmapPass() : Pass("lutmap", "map AIGs to LUTs using priority cuts") { }
+	void help() YS_OVERRIDE
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    lutmap [options] [selection]\n");
+		log("\n");
+		log("This pass maps the $_AND_ and $_NOT_ cells created by 'aigmap' to $lut cells,\n");
+		log("without calling an external tool. It enumerates a limited number of priority\n");
+		log("cuts per node, selects a depth-optimal cover and then recovers area without\n");
+		log("increasing the depth.\n");
+		log("\n");
+		log("    -lut <k>\n");
+		log("        create LUTs with up to <k> inputs, between 2 and 6. (default: 4)\n");
+		log("\n");
+		log("    -cuts <num>\n");
+		log("        keep up to <num> cuts per node. (default: 8)\n");
+		log("\n");
+		log("    -norecover\n");
+		log("        only create the depth-optimal cover, without area recovery.\n");
+		log("\n");
+		log("Signals of the AIG that are used by other cells, module ports or wires with the\n");
+		log("'keep' attribute are kept. Inverted outputs are created as 1-input LUTs.\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
+	{
+		int lut_size = 4, max_cuts = 8;
+		bool opt_recover = true;
+
+		log_header(design, "Executing LUTMAP pass (map AIGs to LUTs using priority cuts).\n");
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++) {
+			if (args[argidx] == "-lut" && argidx+1 < args.size()) {
+				lut_size = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-cuts" && argidx+1 < args.size()) {
+				max_cuts = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-norecover") {
+				opt_recover = false;
+				continue;
+			}
+			break;
+		}
+		extra_args(args, argidx, design);
+
+		if (lut_size < 2 || lut_size > 6)
+			log_cmd_error("The LUT size must be between 2 and 6.\n");
+		if (max_cuts < 1)
+			log_cmd_error("At least one cut per node is needed.\n");
+
+		for (auto module : design->selected_modules())
+		{
+			if (module->has_processes_warn())
+				continue;
+
+			log("Mapping module %s.\n", log_id(module));
+			LutmapWorker worker(module, lut_size, max_cuts, opt_recover);
+			worker.run();
+		}
+	}
+} LutmapPass;
+
+PRIVATE_NAMESPACE_END
@@ -38,14 +38,25 @@ struct MuxcoverWorker
 	{
 		int cost;
 		vector<SigBit> inputs, selects;
+		vector<int> input_nodes;
 		newmux_t() : cost(0) {}
 	};
 
+	struct node_t
+	{
+		SigBit bit;
+		Cell *cell;
+		SigBit ports[3];
+		int children[2];
+	};
+
+	// the nodes of a tree are stored in post-order (A subtree, B subtree, mux), so
+	// the root is the last node and every node comes after the nodes driving it
 	struct tree_t
 	{
 		SigBit root;
-		dict<SigBit, Cell*> muxes;
-		dict<SigBit, newmux_t> newmuxes;
+		vector<node_t> nodes;
+		vector<newmux_t> newmuxes;
 	};
 
 	vector<tree_t> tree_list;
@@ -130,51 +141,80 @@ struct MuxcoverWorker
 		roots.sort();
 		for (auto rootsig : roots)
 		{
+			if (!sig_to_mux.count(rootsig))
+				continue;
+
 			tree_t tree;
 			tree.root = rootsig;
 
-			pool<SigBit> wavefront;
-			wavefront.insert(rootsig);
-
-			while (!wavefront.empty()) {
-				SigBit bit = wavefront.pop();
-				if (sig_to_mux.count(bit) && (bit == rootsig || !roots.count(bit))) {
-					Cell *c = sig_to_mux.at(bit);
-					tree.muxes[bit] = c;
-					wavefront.insert(sigmap(c->getPort(ID::A)));
-					wavefront.insert(sigmap(c->getPort(ID::B)));
-				}
+			// collect the muxes in pre-order visiting B before A, the reverse of
+			// that is the post-order with A before B
+			vector<tuple<SigBit, int, int>> stack;
+			stack.emplace_back(rootsig, -1, 0);
+
+			while (!stack.empty()) {
+				SigBit bit;
+				int parent, port;
+				std::tie(bit, parent, port) = stack.back();
+				stack.pop_back();
+
+				if (parent >= 0)
+					tree.nodes[parent].children[port] = GetSize(tree.nodes);
+
+				node_t node;
+				node.bit = bit;
+				node.cell = sig_to_mux.at(bit);
+				node.ports[0] = sigmap(node.cell->getPort(ID::A));
+				node.ports[1] = sigmap(node.cell->getPort(ID::B));
+				node.ports[2] = sigmap(node.cell->getPort(ID(S)));
+				node.children[0] = -1;
+				node.children[1] = -1;
+				tree.nodes.push_back(node);
+
+				for (int i = 0; i < 2; i++)
+					if (sig_to_mux.count(node.ports[i]) && !roots.count(node.ports[i]))
+						stack.emplace_back(node.ports[i], GetSize(tree.nodes)-1, i);
 			}
 
-			if (!tree.muxes.empty()) {
-				log("    Found tree with %d MUXes at root %s.\n", GetSize(tree.muxes), log_signal(tree.root));
-				tree_list.push_back(tree);
-			}
+			std::reverse(tree.nodes.begin(), tree.nodes.end());
+			for (auto &node : tree.nodes)
+				for (int i = 0; i < 2; i++)
+					if (node.children[i] >= 0)
+						node.children[i] = GetSize(tree.nodes) - 1 - node.children[i];
+
+			log("    Found tree with %d MUXes at root %s.\n", GetSize(tree.nodes), log_signal(tree.root));
+			tree_list.push_back(tree);
 		}
 
 		log("    Finished treeification: Found %d trees.\n", GetSize(tree_list));
 	}
 
-	bool follow_muxtree(SigBit &ret_bit, tree_t &tree, SigBit bit, const char *path, bool first_layer = true)
+	bool follow_muxtree(SigBit &ret_bit, int &ret_node, const tree_t &tree, int node, const char *path)
 	{
-		if (*path) {
-			if (tree.muxes.count(bit) == 0) {
-				if (first_layer || nopartial)
+		SigBit bit = tree.nodes[node].bit;
+		for (; *path; path++) {
+			if (node < 0) {
+				if (nopartial)
 					return false;
-				while (path[0] && path[1])
+				while (path[1])
 					path++;
-				if (path[0] == 'S')
-					ret_bit = State::Sx;
-				else
-					ret_bit = bit;
+				ret_bit = path[0] == 'S' ? SigBit(State::Sx) : bit;
+				ret_node = -1;
 				return true;
 			}
-			char port_name[3] = {'\\', *path, 0};
-			return follow_muxtree(ret_bit, tree, sigmap(tree.muxes.at(bit)->getPort(port_name)), path+1, false);
-		} else {
-			ret_bit = bit;
-			return true;
+			int port = path[0] == 'A' ? 0 : path[0] == 'B' ? 1 : 2;
+			bit = tree.nodes[node].ports[port];
+			node = port < 2 ? tree.nodes[node].children[port] : -1;
 		}
+		ret_bit = bit;
+		ret_node = node;
+		return true;
+	}
+
+	bool follow_muxtree(SigBit &ret_bit, const tree_t &tree, int node, const char *path)
+	{
+		int ret_node;
+		return follow_muxtree(ret_bit, ret_node, tree, node, path);
 	}
 
 	int prepare_decode_mux(SigBit &A, SigBit B, SigBit sel, SigBit bit)
@@ -228,28 +268,33 @@ struct MuxcoverWorker
 		std::get<2>(entry) = true;
 	}
 
-	void find_best_covers(tree_t &tree, const vector<SigBit> &bits)
+	void find_best_covers(tree_t &tree)
 	{
-		for (auto bit : bits)
-			find_best_cover(tree, bit);
+		tree.newmuxes.clear();
+		tree.newmuxes.resize(GetSize(tree.nodes));
+		for (int i = 0; i < GetSize(tree.nodes); i++)
+			find_best_cover(tree, i);
 	}
 
-	int sum_best_covers(tree_t &tree, const vector<SigBit> &bits)
+	int sum_best_covers(const tree_t &tree, const newmux_t &mux)
 	{
 		int sum = 0;
-		for (auto bit : pool<SigBit>(bits.begin(), bits.end())) {
-			int cost = tree.newmuxes.at(bit).cost;
-			log_debug("        Best cost for %s: %d\n", log_signal(bit), cost);
+		for (int i = 0; i < GetSize(mux.inputs); i++) {
+			if (mux.input_nodes[i] < 0)
+				continue;
+			int cost = tree.newmuxes[mux.input_nodes[i]].cost;
+			log_debug("        Best cost for %s: %d\n", log_signal(mux.inputs[i]), cost);
 			sum += cost;
 		}
 		return sum;
 	}
 
-	int find_best_cover(tree_t &tree, SigBit bit)
+	// the inputs of all covers of a node are nodes before it, so their best
+	// covers are known when find_best_covers() gets to the node
+	void find_best_cover(tree_t &tree, int node)
 	{
-		if (tree.newmuxes.count(bit)) {
-			return tree.newmuxes.at(bit).cost;
-		}
+		SigBit bit = tree.nodes[node].bit;
+		int in[16];
 
 		SigBit A, B, C, D, E, F, G, H, I, J, K, L, M, N, O, P;
 		SigBit S1, S2, S3, S4, S5, S6, S7, S8;
@@ -262,10 +307,10 @@ struct MuxcoverWorker
 
 		// 2-Input MUX
 
-		ok = ok && follow_muxtree(A, tree, bit, "A");
-		ok = ok && follow_muxtree(B, tree, bit, "B");
+		ok = ok && follow_muxtree(A, in[0], tree, node, "A");
+		ok = ok && follow_muxtree(B, in[1], tree, node, "B");
 
-		ok = ok && follow_muxtree(S1, tree, bit, "S");
+		ok = ok && follow_muxtree(S1, tree, node, "S");
 
 		if (ok)
 		{
@@ -275,11 +320,11 @@ struct MuxcoverWorker
 			mux.inputs.push_back(B);
 			mux.selects.push_back(S1);
 
-			find_best_covers(tree, mux.inputs);
+			mux.input_nodes.assign(in, in + 2);
 			log_debug("        Decode cost for mux2 at %s: %d\n", log_signal(bit), mux.cost);
 
 			mux.cost += cost_mux2;
-			mux.cost += sum_best_covers(tree, mux.inputs);
+			mux.cost += sum_best_covers(tree, mux);
 
 			log_debug("      Cost of mux2 at %s: %d\n", log_signal(bit), mux.cost);
 
@@ -290,18 +335,18 @@ struct MuxcoverWorker
 
 		if (use_mux4)
 		{
-			ok = ok && follow_muxtree(A, tree, bit, "AA");
-			ok = ok && follow_muxtree(B, tree, bit, "AB");
-			ok = ok && follow_muxtree(C, tree, bit, "BA");
-			ok = ok && follow_muxtree(D, tree, bit, "BB");
+			ok = ok && follow_muxtree(A, in[0], tree, node, "AA");
+			ok = ok && follow_muxtree(B, in[1], tree, node, "AB");
+			ok = ok && follow_muxtree(C, in[2], tree, node, "BA");
+			ok = ok && follow_muxtree(D, in[3], tree, node, "BB");
 
-			ok = ok && follow_muxtree(S1, tree, bit, "AS");
-			ok = ok && follow_muxtree(S2, tree, bit, "BS");
+			ok = ok && follow_muxtree(S1, tree, node, "AS");
+			ok = ok && follow_muxtree(S2, tree, node, "BS");
 
 			if (nodecode)
 				ok = ok && xcmp({S1, S2});
 
-			ok = ok && follow_muxtree(T1, tree, bit, "S");
+			ok = ok && follow_muxtree(T1, tree, node, "S");
 
 			if (ok)
 			{
@@ -317,11 +362,11 @@ struct MuxcoverWorker
 				mux.selects.push_back(S1);
 				mux.selects.push_back(T1);
 
-				find_best_covers(tree, mux.inputs);
+				mux.input_nodes.assign(in, in + 4);
 				log_debug("        Decode cost for mux4 at %s: %d\n", log_signal(bit), mux.cost);
 
 				mux.cost += cost_mux4;
-				mux.cost += sum_best_covers(tree, mux.inputs);
+				mux.cost += sum_best_covers(tree, mux);
 
 				log_debug("      Cost of mux4 at %s: %d\n", log_signal(bit), mux.cost);
 
@@ -334,30 +379,30 @@ struct MuxcoverWorker
 
 		if (use_mux8)
 		{
-			ok = ok && follow_muxtree(A, tree, bit, "AAA");
-			ok = ok && follow_muxtree(B, tree, bit, "AAB");
-			ok = ok && follow_muxtree(C, tree, bit, "ABA");
-			ok = ok && follow_muxtree(D, tree, bit, "ABB");
-			ok = ok && follow_muxtree(E, tree, bit, "BAA");
-			ok = ok && follow_muxtree(F, tree, bit, "BAB");
-			ok = ok && follow_muxtree(G, tree, bit, "BBA");
-			ok = ok && follow_muxtree(H, tree, bit, "BBB");
-
-			ok = ok && follow_muxtree(S1, tree, bit, "AAS");
-			ok = ok && follow_muxtree(S2, tree, bit, "ABS");
-			ok = ok && follow_muxtree(S3, tree, bit, "BAS");
-			ok = ok && follow_muxtree(S4, tree, bit, "BBS");
+			ok = ok && follow_muxtree(A, in[0], tree, node, "AAA");
+			ok = ok && follow_muxtree(B, in[1], tree, node, "AAB");
+			ok = ok && follow_muxtree(C, in[2], tree, node, "ABA");
+			ok = ok && follow_muxtree(D, in[3], tree, node, "ABB");
+			ok = ok && follow_muxtree(E, in[4], tree, node, "BAA");
+			ok = ok && follow_muxtree(F, in[5], tree, node, "BAB");
+			ok = ok && follow_muxtree(G, in[6], tree, node, "BBA");
+			ok = ok && follow_muxtree(H, in[7], tree, node, "BBB");
+
+			ok = ok && follow_muxtree(S1, tree, node, "AAS");
+			ok = ok && follow_muxtree(S2, tree, node, "ABS");
+			ok = ok && follow_muxtree(S3, tree, node, "BAS");
+			ok = ok && follow_muxtree(S4, tree, node, "BBS");
 
 			if (nodecode)
 				ok = ok && xcmp({S1, S2, S3, S4});
 
-			ok = ok && follow_muxtree(T1, tree, bit, "AS");
-			ok = ok && follow_muxtree(T2, tree, bit, "BS");
+			ok = ok && follow_muxtree(T1, tree, node, "AS");
+			ok = ok && follow_muxtree(T2, tree, node, "BS");
 
 			if (nodecode)
 				ok = ok && xcmp({T1, T2});
 
-			ok = ok && follow_muxtree(U1, tree, bit, "S");
+			ok = ok && follow_muxtree(U1, tree, node, "S");
 
 			if (ok)
 			{
@@ -382,11 +427,11 @@ struct MuxcoverWorker
 				mux.selects.push_back(T1);
 				mux.selects.push_back(U1);
 
-				find_best_covers(tree, mux.inputs);
+				mux.input_nodes.assign(in, in + 8);
 				log_debug("        Decode cost for mux8 at %s: %d\n", log_signal(bit), mux.cost);
 
 				mux.cost += cost_mux8;
-				mux.cost += sum_best_covers(tree, mux.inputs);
+				mux.cost += sum_best_covers(tree, mux);
 
 				log_debug("      Cost of mux8 at %s: %d\n", log_signal(bit), mux.cost);
 
@@ -399,50 +444,50 @@ struct MuxcoverWorker
 
 		if (use_mux16)
 		{
-			ok = ok && follow_muxtree(A, tree, bit, "AAAA");
-			ok = ok && follow_muxtree(B, tree, bit, "AAAB");
-			ok = ok && follow_muxtree(C, tree, bit, "AABA");
-			ok = ok && follow_muxtree(D, tree, bit, "AABB");
-			ok = ok && follow_muxtree(E, tree, bit, "ABAA");
-			ok = ok && follow_muxtree(F, tree, bit, "ABAB");
-			ok = ok && follow_muxtree(G, tree, bit, "ABBA");
-			ok = ok && follow_muxtree(H, tree, bit, "ABBB");
-			ok = ok && follow_muxtree(I, tree, bit, "BAAA");
-			ok = ok && follow_muxtree(J, tree, bit, "BAAB");
-			ok = ok && follow_muxtree(K, tree, bit, "BABA");
-			ok = ok && follow_muxtree(L, tree, bit, "BABB");
-			ok = ok && follow_muxtree(M, tree, bit, "BBAA");
-			ok = ok && follow_muxtree(N, tree, bit, "BBAB");
-			ok = ok && follow_muxtree(O, tree, bit, "BBBA");
-			ok = ok && follow_muxtree(P, tree, bit, "BBBB");
-
-			ok = ok && follow_muxtree(S1, tree, bit, "AAAS");
-			ok = ok && follow_muxtree(S2, tree, bit, "AABS");
-			ok = ok && follow_muxtree(S3, tree, bit, "ABAS");
-			ok = ok && follow_muxtree(S4, tree, bit, "ABBS");
-			ok = ok && follow_muxtree(S5, tree, bit, "BAAS");
-			ok = ok && follow_muxtree(S6, tree, bit, "BABS");
-			ok = ok && follow_muxtree(S7, tree, bit, "BBAS");
-			ok = ok && follow_muxtree(S8, tree, bit, "BBBS");
+			ok = ok && follow_muxtree(A, in[0], tree, node, "AAAA");
+			ok = ok && follow_muxtree(B, in[1], tree, node, "AAAB");
+			ok = ok && follow_muxtree(C, in[2], tree, node, "AABA");
+			ok = ok && follow_muxtree(D, in[3], tree, node, "AABB");
+			ok = ok && follow_muxtree(E, in[4], tree, node, "ABAA");
+			ok = ok && follow_muxtree(F, in[5], tree, node, "ABAB");
+			ok = ok && follow_muxtree(G, in[6], tree, node, "ABBA");
+			ok = ok && follow_muxtree(H, in[7], tree, node, "ABBB");
+			ok = ok && follow_muxtree(I, in[8], tree, node, "BAAA");
+			ok = ok && follow_muxtree(J, in[9], tree, node, "BAAB");
+			ok = ok && follow_muxtree(K, in[10], tree, node, "BABA");
+			ok = ok && follow_muxtree(L, in[11], tree, node, "BABB");
+			ok = ok && follow_muxtree(M, in[12], tree, node, "BBAA");
+			ok = ok && follow_muxtree(N, in[13], tree, node, "BBAB");
+			ok = ok && follow_muxtree(O, in[14], tree, node, "BBBA");
+			ok = ok && follow_muxtree(P, in[15], tree, node, "BBBB");
+
+			ok = ok && follow_muxtree(S1, tree, node, "AAAS");
+			ok = ok && follow_muxtree(S2, tree, node, "AABS");
+			ok = ok && follow_muxtree(S3, tree, node, "ABAS");
+			ok = ok && follow_muxtree(S4, tree, node, "ABBS");
+			ok = ok && follow_muxtree(S5, tree, node, "BAAS");
+			ok = ok && follow_muxtree(S6, tree, node, "BABS");
+			ok = ok && follow_muxtree(S7, tree, node, "BBAS");
+			ok = ok && follow_muxtree(S8, tree, node, "BBBS");
 
 			if (nodecode)
 				ok = ok && xcmp({S1, S2, S3, S4, S5, S6, S7, S8});
 
-			ok = ok && follow_muxtree(T1, tree, bit, "AAS");
-			ok = ok && follow_muxtree(T2, tree, bit, "ABS");
-			ok = ok && follow_muxtree(T3, tree, bit, "BAS");
-			ok = ok && follow_muxtree(T4, tree, bit, "BBS");
+			ok = ok && follow_muxtree(T1, tree, node, "AAS");
+			ok = ok && follow_muxtree(T2, tree, node, "ABS");
+			ok = ok && follow_muxtree(T3, tree, node, "BAS");
+			ok = ok && follow_muxtree(T4, tree, node, "BBS");
 
 			if (nodecode)
 				ok = ok && xcmp({T1, T2, T3, T4});
 
-			ok = ok && follow_muxtree(U1, tree, bit, "AS");
-			ok = ok && follow_muxtree(U2, tree, bit, "BS");
+			ok = ok && follow_muxtree(U1, tree, node, "AS");
+			ok = ok && follow_muxtree(U2, tree, node, "BS");
 
 			if (nodecode)
 				ok = ok && xcmp({U1, U2});
 
-			ok = ok && follow_muxtree(V1, tree, bit, "S");
+			ok = ok && follow_muxtree(V1, tree, node, "S");
 
 			if (ok)
 			{
@@ -484,11 +529,11 @@ struct MuxcoverWorker
 				mux.selects.push_back(U1);
 				mux.selects.push_back(V1);
 
-				find_best_covers(tree, mux.inputs);
+				mux.input_nodes.assign(in, in + 16);
 				log_debug("        Decode cost for mux16 at %s: %d\n", log_signal(bit), mux.cost);
 
 				mux.cost += cost_mux16;
-				mux.cost += sum_best_covers(tree, mux.inputs);
+				mux.cost += sum_best_covers(tree, mux);
 
 				log_debug("      Cost of mux16 at %s: %d\n", log_signal(bit), mux.cost);
 
@@ -497,23 +542,35 @@ struct MuxcoverWorker
 			}
 		}
 
-		tree.newmuxes[bit] = best_mux;
-		return best_mux.cost;
+		tree.newmuxes[node] = best_mux;
 	}
 
-	void implement_best_cover(tree_t &tree, SigBit bit, int count_muxes_by_type[4])
+	void implement_best_cover(tree_t &tree, int count_muxes_by_type[4])
 	{
-		newmux_t mux = tree.newmuxes.at(bit);
-
-		for (auto inbit : mux.inputs)
-			implement_best_cover(tree, inbit, count_muxes_by_type);
+		// walk the selected covers in post-order, so the cells driving an input
+		// of a cover are created before the cover itself
+		vector<pair<int, int>> stack;
+		stack.emplace_back(GetSize(tree.nodes)-1, 0);
+
+		while (!stack.empty()) {
+			int node = stack.back().first;
+			const newmux_t &mux = tree.newmuxes[node];
+			if (stack.back().second < GetSize(mux.input_nodes)) {
+				int input_node = mux.input_nodes[stack.back().second++];
+				if (input_node >= 0)
+					stack.emplace_back(input_node, 0);
+				continue;
+			}
+			stack.pop_back();
+			implement_mux(tree.nodes[node].bit, mux, count_muxes_by_type);
+		}
+	}
 
+	void implement_mux(SigBit bit, const newmux_t &mux, int count_muxes_by_type[4])
+	{
 		for (auto selbit : mux.selects)
 			implement_decode_mux(selbit);
 
-		if (GetSize(mux.inputs) == 0)
-			return;
-
 		if (GetSize(mux.inputs) == 2) {
 			count_muxes_by_type[0]++;
 			Cell *cell = module->addCell(NEW_ID, ID($_MUX_));
@@ -589,12 +646,14 @@ struct MuxcoverWorker
 	{
 		int count_muxes_by_type[4] = {0, 0, 0, 0};
 		log_debug("    Searching for best cover for tree at %s.\n", log_signal(tree.root));
-		find_best_cover(tree, tree.root);
-		implement_best_cover(tree, tree.root, count_muxes_by_type);
+		find_best_covers(tree);
+		implement_best_cover(tree, count_muxes_by_type);
 		log("    Replaced tree at %s: %d MUX2, %d MUX4, %d MUX8, %d MUX16\n", log_signal(tree.root),
 				count_muxes_by_type[0], count_muxes_by_type[1], count_muxes_by_type[2], count_muxes_by_type[3]);
-		for (auto &it : tree.muxes)
-			module->remove(it.second);
+		for (auto &node : tree.nodes)
+			module->remove(node.cell);
+		tree.nodes = vector<node_t>();
+		tree.newmuxes = vector<newmux_t>();
 	}
 
 	void run()
@@ -608,8 +667,8 @@ struct MuxcoverWorker
 		if (!nodecode) {
 			log_debug("    Populating cache of decoder muxes.\n");
 			for (auto &tree : tree_list) {
-				find_best_cover(tree, tree.root);
-				tree.newmuxes.clear();
+				find_best_covers(tree);
+				tree.newmuxes = vector<newmux_t>();
 			}
 		}
 
@@ -19,6 +19,7 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
+#include "kernel/ffchain.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -103,13 +104,13 @@ struct ShregmapWorker
 	pool<SigBit> remove_init;
 
 	dict<SigBit, bool> sigbit_init;
-	dict<SigBit, Cell*> sigbit_chain_next;
-	dict<SigBit, Cell*> sigbit_chain_prev;
 	pool<SigBit> sigbit_with_non_chain_users;
-	pool<Cell*> chain_start_cells;
+	FfChainIndex ff_chains;
 
-	void make_sigbit_chain_next_prev()
+	void make_ff_chains()
 	{
+		pool<SigBit> chain_d_bits;
+
 		for (auto wire : module->wires())
 		{
 			if (wire->port_output || wire->get_bool_attribute(ID::keep)) {
@@ -140,24 +141,14 @@ struct ShregmapWorker
 
 				if (opts.init || sigbit_init.count(q_bit) == 0)
 				{
-					auto r = sigbit_chain_next.insert(std::make_pair(d_bit, cell));
-					if (!r.second) {
-						// Insertion not successful means that d_bit is already
-						// connected to another register, thus mark it as a
-						// non chain user ...
+					// d_bit connected to more than one register is a non
+					// chain user. The other registers start chains of their
+					// own (omitting this common flop).
+					// Link: https://github.com/YosysHQ/yosys/pull/1085
+					if (!chain_d_bits.insert(d_bit).second)
 						sigbit_with_non_chain_users.insert(d_bit);
-						// ... and clone d_bit into another wire, and use that
-						// wire as a different key in the d_bit-to-cell dictionary
-						// so that it can be identified as another chain
-						// (omitting this common flop)
-						// Link: https://github.com/YosysHQ/yosys/pull/1085
-						Wire *wire = module->addWire(NEW_ID);
-						module->connect(wire, d_bit);
-						sigmap.add(wire, d_bit);
-						sigbit_chain_next.insert(std::make_pair(wire, cell));
-					}
-
-					sigbit_chain_prev[q_bit] = cell;
+
+					ff_chains.add(cell, d_bit, q_bit);
 					continue;
 				}
 			}
@@ -169,71 +160,36 @@ struct ShregmapWorker
 		}
 	}
 
-	void find_chain_start_cells()
+	bool can_link(int i, int j)
 	{
-		for (auto it : sigbit_chain_next)
-		{
-			if (opts.tech == nullptr && sigbit_with_non_chain_users.count(it.first))
-				goto start_cell;
-
-			if (sigbit_chain_prev.count(it.first) != 0)
-			{
-				Cell *c1 = sigbit_chain_prev.at(it.first);
-				Cell *c2 = it.second;
-
-				if (c1->type != c2->type)
-					goto start_cell;
-
-				if (c1->parameters != c2->parameters)
-					goto start_cell;
-
-				IdString d_port = opts.ffcells.at(c1->type).first;
-				IdString q_port = opts.ffcells.at(c1->type).second;
-
-				auto c1_conn = c1->connections();
-				auto c2_conn = c2->connections();
-
-				c1_conn.erase(d_port);
-				c1_conn.erase(q_port);
-
-				c2_conn.erase(d_port);
-				c2_conn.erase(q_port);
-
-				if (c1_conn != c2_conn)
-					goto start_cell;
+		if (opts.tech == nullptr && sigbit_with_non_chain_users.count(ff_chains.d_bits[j]))
+			return false;
 
-				continue;
-			}
+		Cell *c1 = ff_chains.cells[i];
+		Cell *c2 = ff_chains.cells[j];
 
-		start_cell:
-			chain_start_cells.insert(it.second);
-		}
-	}
+		if (c1->type != c2->type)
+			return false;
 
-	vector<Cell*> create_chain(Cell *start_cell)
-	{
-		vector<Cell*> chain;
+		if (c1->parameters != c2->parameters)
+			return false;
 
-		Cell *c = start_cell;
-		while (c != nullptr)
-		{
-			chain.push_back(c);
+		IdString d_port = opts.ffcells.at(c1->type).first;
+		IdString q_port = opts.ffcells.at(c1->type).second;
 
-			IdString q_port = opts.ffcells.at(c->type).second;
-			SigBit q_bit = sigmap(c->getPort(q_port).as_bit());
+		auto c1_conn = c1->connections();
+		auto c2_conn = c2->connections();
 
-			if (sigbit_chain_next.count(q_bit) == 0)
-				break;
+		c1_conn.erase(d_port);
+		c1_conn.erase(q_port);
 
-			c = sigbit_chain_next.at(q_bit);
-			if (chain_start_cells.count(c) != 0)
-				break;
-		}
+		c2_conn.erase(d_port);
+		c2_conn.erase(q_port);
 
-		return chain;
+		return c1_conn == c2_conn;
 	}
 
-	void process_chain(vector<Cell*> &chain)
+	void process_chain(const vector<int> &chain)
 	{
 		if (GetSize(chain) < opts.keep_before + opts.minlen + opts.keep_after)
 			return;
@@ -246,7 +202,7 @@ struct ShregmapWorker
 			if (opts.maxlen > 0)
 				depth = std::min(opts.maxlen, depth);
 
-			Cell *first_cell = chain[cursor];
+			Cell *first_cell = ff_chains.cells[chain[cursor]];
 			IdString q_port = opts.ffcells.at(first_cell->type).second;
 			dict<int, SigBit> taps_dict;
 
@@ -257,8 +213,7 @@ struct ShregmapWorker
 
 				for (int i = 0; i < depth; i++)
 				{
-					Cell *cell = chain[cursor+i];
-					auto qbit = sigmap(cell->getPort(q_port));
+					SigBit qbit = ff_chains.q_bits[chain[cursor+i]];
 					qbits.push_back(qbit);
 
 					if (sigbit_with_non_chain_users.count(qbit))
@@ -290,7 +245,7 @@ struct ShregmapWorker
 				continue;
 			}
 
-			Cell *last_cell = chain[cursor+depth-1];
+			Cell *last_cell = ff_chains.cells[chain[cursor+depth-1]];
 
 			log("Converting %s.%s ... %s.%s to a shift register with depth %d.\n",
 				log_id(module), log_id(first_cell), log_id(module), log_id(last_cell), depth);
@@ -310,7 +265,7 @@ struct ShregmapWorker
 			if (opts.init) {
 				vector<State> initval;
 				for (int i = depth-1; i >= 0; i--) {
-					SigBit bit = sigmap(chain[cursor+i]->getPort(q_port).as_bit());
+					SigBit bit = ff_chains.q_bits[chain[cursor+i]];
 					if (sigbit_init.count(bit) == 0)
 						initval.push_back(State::Sx);
 					else if (sigbit_init.at(bit))
@@ -324,7 +279,7 @@ struct ShregmapWorker
 
 			if (opts.zinit)
 				for (int i = depth-1; i >= 0; i--) {
-					SigBit bit = sigmap(chain[cursor+i]->getPort(q_port).as_bit());
+					SigBit bit = ff_chains.q_bits[chain[cursor+i]];
 					remove_init.insert(bit);
 				}
 
@@ -354,7 +309,7 @@ struct ShregmapWorker
 				remove_cells.insert(first_cell);
 
 			for (int i = 1; i < depth; i++)
-				remove_cells.insert(chain[cursor+i]);
+				remove_cells.insert(ff_chains.cells[chain[cursor+i]]);
 			cursor += depth;
 		}
 	}
@@ -374,28 +329,24 @@ struct ShregmapWorker
 
 			for (int i = 0; i < GetSize(initsig) && i < GetSize(initval); i++)
 				if (remove_init.count(initsig[i]))
-					initval[i] = State::Sx;
+					initval.bits()[i] = State::Sx;
 
 			if (SigSpec(initval).is_fully_undef())
 				wire->attributes.erase(ID(init));
 		}
 
 		remove_cells.clear();
-		sigbit_chain_next.clear();
-		sigbit_chain_prev.clear();
-		chain_start_cells.clear();
+		ff_chains.clear();
 	}
 
 	ShregmapWorker(Module *module, const ShregmapOptions &opts) :
 			module(module), sigmap(module), opts(opts), dff_count(0), shreg_count(0)
 	{
-		make_sigbit_chain_next_prev();
-		find_chain_start_cells();
+		make_ff_chains();
+		ff_chains.link([&](int i, int j) { return can_link(i, j); });
 
-		for (auto c : chain_start_cells) {
-			vector<Cell*> chain = create_chain(c);
-			process_chain(chain);
-		}
+		for (int start : ff_chains.chain_starts())
+			process_chain(ff_chains.chain(start));
 
 		cleanup();
 	}
@@ -480,7 +480,7 @@ void simplemap_adff(RTLIL::Module *module, RTLIL::Cell *cell)
 	char clk_pol = cell->parameters.at(ID(CLK_POLARITY)).as_bool() ? 'P' : 'N';
 	char rst_pol = cell->parameters.at(ID(ARST_POLARITY)).as_bool() ? 'P' : 'N';
 
-	std::vector<RTLIL::State> rst_val = cell->parameters.at(ID(ARST_VALUE)).bits;
+	std::vector<RTLIL::State> rst_val = cell->parameters.at(ID(ARST_VALUE)).to_bits();
 	while (int(rst_val.size()) < width)
 		rst_val.push_back(RTLIL::State::S0);
 
@@ -573,8 +573,8 @@ void simplemap(RTLIL::Module *module, RTLIL::Cell *cell)
 YOSYS_NAMESPACE_END
 PRIVATE_NAMESPACE_BEGIN
 
-struct SimplemapPass : public Pass {
-	SimplemapPass() : Pass("simplemap", "mapping simple coarse-grain cells") { }
+struct SimplemapPass : public ModulePass {
+	SimplemapPass() : ModulePass("simplemap", "mapping simple coarse-grain cells") { }
 	void help() YS_OVERRIDE
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -589,7 +589,47 @@ struct SimplemapPass : public Pass {
 		log("  $logic_not, $logic_and, $logic_or, $mux, $tribuf\n");
 		log("  $sr, $ff, $dff, $dffsr, $adff, $dlatch\n");
 		log("\n");
+		log("The modules are mapped concurrently when yosys is run with multiple threads\n");
+		log("(yosys -j). The gates of a module are added in one batch, with room for them\n");
+		log("reserved up front.\n");
+		log("\n");
+	}
+	RTLIL::Design *design;
+	const std::map<RTLIL::IdString, void(*)(RTLIL::Module*, RTLIL::Cell*)> *mappers;
+
+	void execute_module(RTLIL::Module *mod) YS_OVERRIDE
+	{
+		std::vector<RTLIL::Cell*> cells;
+		int num_bits = 0;
+
+		for (auto cell : mod->cells()) {
+			if (mappers->count(cell->type) == 0)
+				continue;
+			if (!design->selected(mod, cell))
+				continue;
+			cells.push_back(cell);
+			int width = 0;
+			for (auto &conn : cell->connections())
+				width = std::max(width, GetSize(conn.second));
+			num_bits += width;
+		}
+
+		if (cells.empty())
+			return;
+
+		// there is about one gate (and for the reduce trees one wire) per bit
+		// of the widest port
+		mod->cells_.reserve(GetSize(mod->cells_) + num_bits);
+		mod->wires_.reserve(GetSize(mod->wires_) + num_bits);
+
+		RTLIL::Module::Batch batch(mod);
+		for (auto cell : cells) {
+			log("Mapping %s.%s (%s).\n", log_id(mod), log_id(cell), log_id(cell->type));
+			mappers->at(cell->type)(mod, cell);
+			mod->remove(cell);
+		}
 	}
+
 	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
 	{
 		log_header(design, "Executing SIMPLEMAP pass (map simple cells to gate primitives).\n");
@@ -598,20 +638,9 @@ struct SimplemapPass : public Pass {
 		std::map<RTLIL::IdString, void(*)(RTLIL::Module*, RTLIL::Cell*)> mappers;
 		simplemap_get_mappers(mappers);
 
-		for (auto mod : design->modules()) {
-			if (!design->selected(mod) || mod->get_blackbox_attribute())
-				continue;
-			std::vector<RTLIL::Cell*> cells = mod->cells();
-			for (auto cell : cells) {
-				if (mappers.count(cell->type) == 0)
-					continue;
-				if (!design->selected(mod, cell))
-					continue;
-				log("Mapping %s.%s (%s).\n", log_id(mod), log_id(cell), log_id(cell->type));
-				mappers.at(cell->type)(mod, cell);
-				mod->remove(cell);
-			}
-		}
+		this->design = design;
+		this->mappers = &mappers;
+		execute_modules(design);
 	}
 } SimplemapPass;
 
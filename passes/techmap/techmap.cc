@@ -47,22 +47,13 @@ void apply_prefix(IdString prefix, IdString &id)
 		id = stringf("$techmap%s.%s", prefix.c_str(), id.c_str());
 }
 
-void apply_prefix(IdString prefix, RTLIL::SigSpec &sig, RTLIL::Module *module)
-{
-	vector<SigChunk> chunks = sig;
-	for (auto &chunk : chunks)
-		if (chunk.wire != NULL) {
-			IdString wire_name = chunk.wire->name;
-			apply_prefix(prefix, wire_name);
-			log_assert(module->wires_.count(wire_name) > 0);
-			chunk.wire = module->wires_[wire_name];
-		}
-	sig = chunks;
-}
-
 struct TechmapWorker
 {
-	std::map<RTLIL::IdString, void(*)(RTLIL::Module*, RTLIL::Cell*)> simplemap_mappers;
+	// the template modules for each cell type, and the simplemap mappers, are
+	// only looked up while mapping and are frozen once they are set up
+	typedef frozen_dict<RTLIL::IdString, std::set<RTLIL::IdString, RTLIL::sort_by_id_str>> CelltypeMap;
+	typedef frozen_dict<RTLIL::IdString, void(*)(RTLIL::Module*, RTLIL::Cell*)> SimplemapMappers;
+	SimplemapMappers simplemap_mappers;
 	std::map<std::pair<RTLIL::IdString, std::map<RTLIL::IdString, RTLIL::Const>>, RTLIL::Module*> techmap_cache;
 	std::map<RTLIL::Module*, bool> techmap_do_cache;
 	std::set<RTLIL::Module*, RTLIL::IdString::compare_ptr_by_name<RTLIL::Module>> module_queue;
@@ -81,6 +72,32 @@ struct TechmapWorker
 
 	typedef std::map<std::string, std::vector<TechmapWireData>> TechmapWires;
 
+	// Everything about a template that does not depend on the instance. The
+	// wire and cell names are stored as the suffix that is appended to the
+	// instance prefix (see apply_prefix()), and signals are rewritten through
+	// the wire index instead of looking up prefixed names.
+	struct TechmapTemplate {
+		bool initialized = false;
+		dict<RTLIL::IdString, RTLIL::IdString> positional_ports;
+		SigMap sigmap;
+		pool<RTLIL::SigBit> written_bits;
+		dict<RTLIL::Wire*, int> wire_index;
+		std::vector<RTLIL::Wire*> wires;
+		std::vector<std::pair<bool, std::string>> wire_names;
+		std::vector<std::pair<bool, std::string>> cell_names;
+	};
+
+	dict<RTLIL::Module*, TechmapTemplate> template_cache;
+
+	// The cells that the next techmap_module() call for a module looks at: all
+	// cells in the first call, afterwards only the cells that the previous call
+	// added (instantiated templates and extmapper gates). All other cells have
+	// been mapped already or did not match any template.
+	struct CellWorklist {
+		bool all_cells = true;
+		std::vector<RTLIL::Cell*> cells;
+	};
+
 	bool extern_mode;
 	bool assert_mode;
 	bool flatten_mode;
@@ -98,6 +115,39 @@ struct TechmapWorker
 		ignore_wb = false;
 	}
 
+	static std::pair<bool, std::string> template_name(RTLIL::IdString id)
+	{
+		if (id[0] == '\\')
+			return std::make_pair(true, std::string(".") + (id.c_str()+1));
+		return std::make_pair(false, std::string(".") + id.str());
+	}
+
+	void setup_template(TechmapTemplate &tt, RTLIL::Module *tpl)
+	{
+		tt.initialized = true;
+		tt.sigmap.set(tpl);
+
+		for (auto &it : tpl->wires_) {
+			if (it.second->port_id > 0)
+				tt.positional_ports[stringf("$%d", it.second->port_id)] = it.first;
+			tt.wire_index[it.second] = GetSize(tt.wires);
+			tt.wires.push_back(it.second);
+			tt.wire_names.push_back(template_name(it.first));
+		}
+
+		for (auto &it : tpl->cells_)
+			tt.cell_names.push_back(template_name(it.first));
+
+		for (auto &it1 : tpl->cells_)
+		for (auto &it2 : it1.second->connections_)
+			if (it1.second->output(it2.first))
+				for (auto bit : tt.sigmap(it2.second))
+					tt.written_bits.insert(bit);
+		for (auto &it1 : tpl->connections_)
+			for (auto bit : tt.sigmap(it1.first))
+				tt.written_bits.insert(bit);
+	}
+
 	std::string constmap_tpl_name(SigMap &sigmap, RTLIL::Module *tpl, RTLIL::Cell *cell, bool verbose)
 	{
 		std::string constmap_info;
@@ -160,7 +210,8 @@ struct TechmapWorker
 		return result;
 	}
 
-	void techmap_module_worker(RTLIL::Design *design, RTLIL::Module *module, RTLIL::Cell *cell, RTLIL::Module *tpl)
+	void techmap_module_worker(RTLIL::Design *design, RTLIL::Module *module, RTLIL::Cell *cell, RTLIL::Module *tpl,
+			std::vector<RTLIL::Cell*> &new_cells)
 	{
 		if (tpl->processes.size() != 0) {
 			log("Technology map yielded processes:");
@@ -186,6 +237,29 @@ struct TechmapWorker
 				}
 		}
 
+		// templates are design modules in flatten mode and may still change
+		TechmapTemplate flatten_tt;
+		TechmapTemplate &tt = flatten_mode ? flatten_tt : template_cache[tpl];
+		if (!tt.initialized)
+			setup_template(tt, tpl);
+
+		std::string public_prefix = cell->name.str();
+		std::string private_prefix = "$techmap" + public_prefix;
+		auto prefixed_name = [&](const std::pair<bool, std::string> &name) -> RTLIL::IdString {
+			return (name.first ? public_prefix : private_prefix) + name.second;
+		};
+
+		std::vector<RTLIL::Wire*> new_wires(GetSize(tt.wires));
+		auto map_sig = [&](RTLIL::SigSpec &sig) {
+			vector<SigChunk> chunks = sig;
+			for (auto &chunk : chunks)
+				if (chunk.wire != NULL) {
+					chunk.wire = new_wires.at(tt.wire_index.at(chunk.wire));
+					log_assert(chunk.wire != nullptr);
+				}
+			sig = chunks;
+		};
+
 		dict<IdString, IdString> memory_renames;
 
 		for (auto &it : tpl->memories) {
@@ -204,31 +278,25 @@ struct TechmapWorker
 			design->select(module, m);
 		}
 
-		std::map<RTLIL::IdString, RTLIL::IdString> positional_ports;
 		dict<Wire*, IdString> temp_renamed_wires;
 		pool<SigBit> autopurge_tpl_bits;
 
-		for (auto &it : tpl->wires_)
+		for (int i = 0; i < GetSize(tt.wires); i++)
 		{
-			if (it.second->port_id > 0)
-			{
-				IdString posportname = stringf("$%d", it.second->port_id);
-				positional_ports[posportname] = it.first;
+			RTLIL::Wire *tpl_w = tt.wires[i];
 
-				if (!flatten_mode && it.second->get_bool_attribute(ID(techmap_autopurge)) &&
-						(!cell->hasPort(it.second->name) || !GetSize(cell->getPort(it.second->name))) &&
+			if (tpl_w->port_id > 0 && !flatten_mode && tpl_w->get_bool_attribute(ID(techmap_autopurge)))
+			{
+				IdString posportname = stringf("$%d", tpl_w->port_id);
+				if ((!cell->hasPort(tpl_w->name) || !GetSize(cell->getPort(tpl_w->name))) &&
 						(!cell->hasPort(posportname) || !GetSize(cell->getPort(posportname))))
 				{
-					if (sigmaps.count(tpl) == 0)
-						sigmaps[tpl].set(tpl);
-
-					for (auto bit : sigmaps.at(tpl)(it.second))
+					for (auto bit : tt.sigmap(tpl_w))
 						if (bit.wire != nullptr)
 							autopurge_tpl_bits.insert(bit);
 				}
 			}
-			IdString w_name = it.second->name;
-			apply_prefix(cell->name, w_name);
+			IdString w_name = prefixed_name(tt.wire_names[i]);
 			RTLIL::Wire *w = module->wire(w_name);
 			if (w != nullptr) {
 				if (!flatten_mode || !w->get_bool_attribute(ID(hierconn))) {
@@ -237,54 +305,43 @@ struct TechmapWorker
 					w = nullptr;
 				} else {
 					w->attributes.erase(ID(hierconn));
-					if (GetSize(w) < GetSize(it.second)) {
+					if (GetSize(w) < GetSize(tpl_w)) {
 						log_warning("Widening signal %s.%s to match size of %s.%s (via %s.%s).\n", log_id(module), log_id(w),
-								log_id(tpl), log_id(it.second), log_id(module), log_id(cell));
-						w->width = GetSize(it.second);
+								log_id(tpl), log_id(tpl_w), log_id(module), log_id(cell));
+						w->width = GetSize(tpl_w);
 					}
 				}
 			}
 			if (w == nullptr) {
-				w = module->addWire(w_name, it.second);
+				w = module->addWire(w_name, tpl_w);
 				w->port_input = false;
 				w->port_output = false;
 				w->port_id = 0;
 				if (!flatten_mode)
 					w->attributes.erase(ID(techmap_autopurge));
-				if (it.second->get_bool_attribute(ID(_techmap_special_)))
+				if (tpl_w->get_bool_attribute(ID(_techmap_special_)))
 					w->attributes.clear();
 				if (w->attributes.count(ID(src)))
 					w->add_strpool_attribute(ID(src), extra_src_attrs);
 			}
 			design->select(module, w);
+			new_wires[i] = w;
 
-			if (it.second->name.begins_with("\\_TECHMAP_REPLACE_.")) {
-				IdString replace_name = stringf("%s%s", orig_cell_name.c_str(), it.second->name.c_str() + strlen("\\_TECHMAP_REPLACE_"));
-				Wire *replace_w = module->addWire(replace_name, it.second);
+			if (tpl_w->name.begins_with("\\_TECHMAP_REPLACE_.")) {
+				IdString replace_name = stringf("%s%s", orig_cell_name.c_str(), tpl_w->name.c_str() + strlen("\\_TECHMAP_REPLACE_"));
+				Wire *replace_w = module->addWire(replace_name, tpl_w);
 				module->connect(replace_w, w);
 			}
 		}
 
-		SigMap tpl_sigmap(tpl);
-		pool<SigBit> tpl_written_bits;
-
-		for (auto &it1 : tpl->cells_)
-		for (auto &it2 : it1.second->connections_)
-			if (it1.second->output(it2.first))
-				for (auto bit : tpl_sigmap(it2.second))
-					tpl_written_bits.insert(bit);
-		for (auto &it1 : tpl->connections_)
-			for (auto bit : tpl_sigmap(it1.first))
-				tpl_written_bits.insert(bit);
-
 		SigMap port_signal_map;
 		SigSig port_signal_assign;
 
 		for (auto &it : cell->connections())
 		{
 			RTLIL::IdString portname = it.first;
-			if (positional_ports.count(portname) > 0)
-				portname = positional_ports.at(portname);
+			if (tt.positional_ports.count(portname) > 0)
+				portname = tt.positional_ports.at(portname);
 			if (tpl->wires_.count(portname) == 0 || tpl->wires_.at(portname)->port_id == 0) {
 				if (portname.begins_with("$"))
 					log_error("Can't map port `%s' of cell `%s' to template `%s'!\n", portname.c_str(), cell->name.c_str(), tpl->name.c_str());
@@ -300,20 +357,20 @@ struct TechmapWorker
 			if (w->port_output && !w->port_input) {
 				c.first = it.second;
 				c.second = RTLIL::SigSpec(w);
-				apply_prefix(cell->name, c.second, module);
+				map_sig(c.second);
 				extra_connect.first = c.second;
 				extra_connect.second = c.first;
 			} else if (!w->port_output && w->port_input) {
 				c.first = RTLIL::SigSpec(w);
 				c.second = it.second;
-				apply_prefix(cell->name, c.first, module);
+				map_sig(c.first);
 				extra_connect.first = c.first;
 				extra_connect.second = c.second;
 			} else {
 				SigSpec sig_tpl = w, sig_tpl_pf = w, sig_mod = it.second;
-				apply_prefix(cell->name, sig_tpl_pf, module);
+				map_sig(sig_tpl_pf);
 				for (int i = 0; i < GetSize(sig_tpl) && i < GetSize(sig_mod); i++) {
-					if (tpl_written_bits.count(tpl_sigmap(sig_tpl[i]))) {
+					if (tt.written_bits.count(tt.sigmap(sig_tpl[i]))) {
 						c.first.append(sig_mod[i]);
 						c.second.append(sig_tpl_pf[i]);
 					} else {
@@ -377,9 +434,11 @@ struct TechmapWorker
 			}
 		}
 
+		int cell_idx = 0;
 		for (auto &it : tpl->cells_)
 		{
 			IdString c_name = it.second->name.str();
+			const auto &c_tpl_name = tt.cell_names[cell_idx++];
 			bool techmap_replace_cell = (!flatten_mode) && (c_name == ID(_TECHMAP_REPLACE_));
 
 			if (techmap_replace_cell)
@@ -387,10 +446,11 @@ struct TechmapWorker
 			else if (it.second->name.begins_with("\\_TECHMAP_REPLACE_."))
 				c_name = stringf("%s%s", orig_cell_name.c_str(), c_name.c_str() + strlen("\\_TECHMAP_REPLACE_"));
 			else
-				apply_prefix(cell->name, c_name);
+				c_name = prefixed_name(c_tpl_name);
 
 			RTLIL::Cell *c = module->addCell(c_name, it.second);
 			design->select(module, c);
+			new_cells.push_back(c);
 
 			if (!flatten_mode && c->type.begins_with("\\$"))
 				c->type = c->type.substr(1);
@@ -402,7 +462,7 @@ struct TechmapWorker
 				bool autopurge = false;
 				if (!autopurge_tpl_bits.empty()) {
 					autopurge = GetSize(it2.second) != 0;
-					for (auto &bit : sigmaps.at(tpl)(it2.second))
+					for (auto &bit : tt.sigmap(it2.second))
 						if (!autopurge_tpl_bits.count(bit)) {
 							autopurge = false;
 							break;
@@ -412,7 +472,7 @@ struct TechmapWorker
 				if (autopurge) {
 					autopurge_ports.push_back(it2.first);
 				} else {
-					apply_prefix(cell->name, it2.second, module);
+					map_sig(it2.second);
 					port_signal_map.apply(it2.second);
 				}
 			}
@@ -443,8 +503,8 @@ struct TechmapWorker
 
 		for (auto &it : tpl->connections()) {
 			RTLIL::SigSig c = it;
-			apply_prefix(cell->name.str(), c.first, module);
-			apply_prefix(cell->name.str(), c.second, module);
+			map_sig(c.first);
+			map_sig(c.second);
 			port_signal_map.apply(c.first);
 			port_signal_map.apply(c.second);
 			module->connect(c);
@@ -463,39 +523,30 @@ struct TechmapWorker
 		}
 	}
 
-	bool techmap_module(RTLIL::Design *design, RTLIL::Module *module, RTLIL::Design *map, std::set<RTLIL::Cell*> &handled_cells,
-			const std::map<RTLIL::IdString, std::set<RTLIL::IdString, RTLIL::sort_by_id_str>> &celltypeMap, bool in_recursion)
+	bool techmap_module(RTLIL::Design *design, RTLIL::Module *module, RTLIL::Design *map, CellWorklist &worklist,
+			const CelltypeMap &celltypeMap, bool in_recursion)
 	{
+		YS_PROFILE_SCOPE("techmap.techmap_module");
+
 		std::string mapmsg_prefix = in_recursion ? "Recursively mapping" : "Mapping";
 
 		if (!design->selected(module) || module->get_blackbox_attribute(ignore_wb))
 			return false;
 
-		bool log_continue = false;
-		bool did_something = false;
-		LogMakeDebugHdl mkdebug;
+		std::vector<RTLIL::Cell*> candidates;
+		if (worklist.all_cells)
+			candidates = module->cells();
+		else
+			candidates.swap(worklist.cells);
+		worklist.all_cells = false;
+		worklist.cells.clear();
 
-		SigMap sigmap(module);
+		std::vector<RTLIL::Cell*> &new_cells = worklist.cells;
+		std::vector<std::pair<RTLIL::Cell*, std::string>> mappable_cells;
 
-		dict<SigBit, State> init_bits;
-		pool<SigBit> remove_init_bits;
-
-		for (auto wire : module->wires()) {
-			if (wire->attributes.count("\\init")) {
-				Const value = wire->attributes.at("\\init");
-				for (int i = 0; i < min(GetSize(value), GetSize(wire)); i++)
-					if (value[i] != State::Sx)
-						init_bits[sigmap(SigBit(wire, i))] = value[i];
-			}
-		}
-
-		TopoSort<RTLIL::Cell*, RTLIL::IdString::compare_ptr_by_name<RTLIL::Cell>> cells;
-		std::map<RTLIL::Cell*, std::set<RTLIL::SigBit>> cell_to_inbit;
-		std::map<RTLIL::SigBit, std::set<RTLIL::Cell*>> outbit_to_cell;
-
-		for (auto cell : module->cells())
+		for (auto cell : candidates)
 		{
-			if (!design->selected(module, cell) || handled_cells.count(cell) > 0)
+			if (!design->selected(module, cell))
 				continue;
 
 			std::string cell_type = cell->type.str();
@@ -524,6 +575,42 @@ struct TechmapWorker
 				}
 			}
 
+			mappable_cells.push_back({cell, cell_type});
+		}
+
+		// nothing to do, e.g. in the last iteration of a recursive map
+		if (mappable_cells.empty())
+			return false;
+
+		RTLIL::Module::Batch batch(module);
+
+		bool log_continue = false;
+		bool did_something = false;
+		LogMakeDebugHdl mkdebug;
+
+		SigMap sigmap(module);
+
+		dict<SigBit, State> init_bits;
+		pool<SigBit> remove_init_bits;
+
+		for (auto wire : module->wires()) {
+			if (wire->attributes.count("\\init")) {
+				Const value = wire->attributes.at("\\init");
+				for (int i = 0; i < min(GetSize(value), GetSize(wire)); i++)
+					if (value[i] != State::Sx)
+						init_bits[sigmap(SigBit(wire, i))] = value[i];
+			}
+		}
+
+		TopoSort<RTLIL::Cell*, RTLIL::IdString::compare_ptr_by_name<RTLIL::Cell>> cells;
+		std::map<RTLIL::Cell*, std::set<RTLIL::SigBit>> cell_to_inbit;
+		std::map<RTLIL::SigBit, std::set<RTLIL::Cell*>> outbit_to_cell;
+
+		for (auto &it : mappable_cells)
+		{
+			RTLIL::Cell *cell = it.first;
+			const std::string &cell_type = it.second;
+
 			for (auto &conn : cell->connections())
 			{
 				RTLIL::SigSpec sig = sigmap(conn.second);
@@ -555,7 +642,6 @@ struct TechmapWorker
 
 		for (auto cell : cells.sorted)
 		{
-			log_assert(handled_cells.count(cell) == 0);
 			log_assert(cell == module->cell(cell->name));
 			bool mapped_cell = false;
 
@@ -673,6 +759,8 @@ struct TechmapWorker
 							}
 							log_debug("%s %s.%s (%s) with %s.\n", mapmsg_prefix.c_str(), log_id(module), log_id(cell), log_id(cell->type), extmapper_name.c_str());
 
+							int num_cells = GetSize(module->cells_);
+
 							if (extmapper_name == "simplemap") {
 								if (simplemap_mappers.count(cell->type) == 0)
 									log_error("No simplemap mapper for cell type %s found!\n", RTLIL::id2cstr(cell->type));
@@ -685,6 +773,10 @@ struct TechmapWorker
 								maccmap(module, cell);
 							}
 
+							// the mappers only add cells, which are appended to cells_
+							for (int i = 0; i < GetSize(module->cells_) - num_cells; i++)
+								new_cells.push_back(module->cells_.element(i)->second);
+
 							module->remove(cell);
 							cell = NULL;
 						}
@@ -732,7 +824,7 @@ struct TechmapWorker
 							for (int i = 0; i < sig.size(); i++) {
 								auto it = init_bits.find(sig[i]);
 								if (it != init_bits.end()) {
-									value[i] = it->second;
+									value.bits()[i] = it->second;
 								}
 							}
 							parameters[stringf("\\_TECHMAP_WIREINIT_%s_", RTLIL::id2cstr(conn.first))] = value;
@@ -768,7 +860,7 @@ struct TechmapWorker
 							RTLIL::Const value;
 							for (auto &bit : sigmap(conn.second).to_sigbit_vector()) {
 								RTLIL::Const chunk(unique_bit_id.at(bit), bits);
-								value.bits.insert(value.bits.end(), chunk.bits.begin(), chunk.bits.end());
+								value.bits().insert(value.bits().end(), chunk.begin(), chunk.end());
 							}
 							parameters[stringf("\\_TECHMAP_CONNMAP_%s_", RTLIL::id2cstr(conn.first))] = value;
 						}
@@ -918,7 +1010,8 @@ struct TechmapWorker
 							if (cmd_string.rfind("RECURSION; ", 0) == 0)
 							{
 								cmd_string = cmd_string.substr(strlen("RECURSION; "));
-								while (techmap_module(map, tpl, map, handled_cells, celltypeMap, true)) { }
+								CellWorklist tpl_worklist;
+								while (techmap_module(map, tpl, map, tpl_worklist, celltypeMap, true)) { }
 								goto restart_eval_cmd_string;
 							}
 
@@ -955,7 +1048,8 @@ struct TechmapWorker
 							log_continue = false;
 							mkdebug.off();
 						}
-						while (techmap_module(map, tpl, map, handled_cells, celltypeMap, true)) { }
+						CellWorklist tpl_worklist;
+						while (techmap_module(map, tpl, map, tpl_worklist, celltypeMap, true)) { }
 					}
 				}
 
@@ -1014,7 +1108,7 @@ struct TechmapWorker
 						log("%s\n", msg.c_str());
 					}
 					log_debug("%s %s.%s (%s) using %s.\n", mapmsg_prefix.c_str(), log_id(module), log_id(cell), log_id(cell->type), log_id(tpl));
-					techmap_module_worker(design, module, cell, tpl);
+					techmap_module_worker(design, module, cell, tpl, new_cells);
 					cell = NULL;
 				}
 				did_something = true;
@@ -1025,7 +1119,6 @@ struct TechmapWorker
 			if (assert_mode && !mapped_cell)
 				log_error("(ASSERT MODE) Failed to map cell %s.%s (%s).\n", log_id(module), log_id(cell), log_id(cell->type));
 
-			handled_cells.insert(cell);
 		}
 
 		if (!remove_init_bits.empty()) {
@@ -1036,7 +1129,7 @@ struct TechmapWorker
 					for (int i = 0; i < min(GetSize(value), GetSize(wire)); i++) {
 						SigBit bit = sigmap(SigBit(wire, i));
 						if (remove_init_bits.count(bit))
-							value[i] = State::Sx;
+							value.bits()[i] = State::Sx;
 						else if (value[i] != State::Sx)
 							do_cleanup = false;
 					}
@@ -1057,6 +1150,74 @@ struct TechmapWorker
 	}
 };
 
+// Map designs kept from one techmap call to the next, together with the
+// templates that were derived from them, see 'help techmap_cache'. The key is
+// made of the frontend options, the techmap options, and the names and content
+// hashes of the map files.
+struct TechmapMapCache
+{
+	typedef TechmapWorker::CelltypeMap CelltypeMap;
+
+	struct Entry
+	{
+		RTLIL::Design *map = nullptr;
+		CelltypeMap celltypeMap;
+		std::map<std::pair<RTLIL::IdString, std::map<RTLIL::IdString, RTLIL::Const>>, RTLIL::Module*> techmap_cache;
+		std::map<RTLIL::Module*, bool> techmap_do_cache;
+		dict<RTLIL::Module*, TechmapWorker::TechmapTemplate> template_cache;
+		int uses = 0;
+
+		~Entry() { delete map; }
+	};
+
+	std::map<std::string, Entry*> entries;
+
+	~TechmapMapCache()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		for (auto &it : entries)
+			delete it.second;
+		entries.clear();
+	}
+
+	// The entry is removed while a techmap call uses it, so that a call that
+	// fails halfway does not leave a partially processed map behind.
+	Entry *take(const std::string &key)
+	{
+		auto it = entries.find(key);
+		if (it == entries.end())
+			return nullptr;
+		Entry *entry = it->second;
+		entries.erase(it);
+		return entry;
+	}
+
+	void put(const std::string &key, Entry *entry)
+	{
+		log_assert(entries.count(key) == 0);
+		entries[key] = entry;
+	}
+
+	static TechmapMapCache instance;
+};
+
+TechmapMapCache TechmapMapCache::instance;
+
+static uint64_t hash_map_data(const std::string &data)
+{
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (char c : data) {
+		hash ^= (unsigned char)c;
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
 struct TechmapPass : public Pass {
 	TechmapPass() : Pass("techmap", "generic technology mapper") { }
 	void help() YS_OVERRIDE
@@ -1107,6 +1268,11 @@ struct TechmapPass : public Pass {
 		log("        map file. Note that the Verilog frontend is also called with the\n");
 		log("        '-nooverwrite' option set.\n");
 		log("\n");
+		log("    -nocache\n");
+		log("        read the map files again even if they are unchanged since an earlier\n");
+		log("        techmap call, and do not keep them for later calls. See 'help\n");
+		log("        techmap_cache'.\n");
+		log("\n");
 		log("When a module in the map file has the 'techmap_celltype' attribute set, it will\n");
 		log("match cells with a type that match the text value of this attribute. Otherwise\n");
 		log("the module name will be used to match the cell.\n");
@@ -1225,11 +1391,14 @@ struct TechmapPass : public Pass {
 		log_push();
 
 		TechmapWorker worker;
-		simplemap_get_mappers(worker.simplemap_mappers);
+		std::map<RTLIL::IdString, void(*)(RTLIL::Module*, RTLIL::Cell*)> mappers;
+		simplemap_get_mappers(mappers);
+		worker.simplemap_mappers = TechmapWorker::SimplemapMappers(mappers.begin(), mappers.end());
 
 		std::vector<std::string> map_files;
 		std::string verilog_frontend = "verilog -nooverwrite -noblackbox";
 		int max_iter = -1;
+		bool use_cache = true;
 
 		size_t argidx;
 		for (argidx = 1; argidx < args.size(); argidx++) {
@@ -1269,51 +1438,98 @@ struct TechmapPass : public Pass {
 				worker.ignore_wb = true;
 				continue;
 			}
+			if (args[argidx] == "-nocache") {
+				use_cache = false;
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
-		RTLIL::Design *map = new RTLIL::Design;
-		if (map_files.empty()) {
-			std::istringstream f(stdcells_code);
-			Frontend::frontend_call(map, &f, "<techmap.v>", verilog_frontend);
+		std::string cache_key = stringf("%s|%d%d%d%d%d", verilog_frontend.c_str(), worker.extern_mode,
+				worker.assert_mode, worker.recursive_mode, worker.autoproc_mode, worker.ignore_wb);
+		std::vector<std::string> map_data(GetSize(map_files));
+
+		if (map_files.empty())
+			cache_key += "|<techmap.v>";
+
+		for (int i = 0; i < GetSize(map_files); i++) {
+			std::string &fn = map_files[i];
+			if (fn.compare(0, 1, "%") == 0) {
+				if (!saved_designs.count(fn.substr(1)))
+					log_cmd_error("Can't saved design `%s'.\n", fn.c_str()+1);
+				// saved designs can change without notice
+				use_cache = false;
+			} else {
+				std::ifstream f;
+				rewrite_filename(fn);
+				f.open(fn.c_str(), std::ios::binary);
+				yosys_input_files.insert(fn);
+				if (f.fail())
+					log_cmd_error("Can't open map file `%s'\n", fn.c_str());
+				map_data[i].assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+				cache_key += stringf("|%s:%016llx", fn.c_str(), (unsigned long long)hash_map_data(map_data[i]));
+			}
+		}
+
+		std::unique_ptr<TechmapMapCache::Entry> cache_entry;
+		if (use_cache)
+			cache_entry.reset(TechmapMapCache::instance.take(cache_key));
+
+		if (cache_entry != nullptr) {
+			log("Using map design from an earlier techmap call (used %d time%s before).\n",
+					cache_entry->uses, cache_entry->uses == 1 ? "" : "s");
 		} else {
-			for (auto &fn : map_files)
-				if (fn.compare(0, 1, "%") == 0) {
-					if (!saved_designs.count(fn.substr(1))) {
-						delete map;
-						log_cmd_error("Can't saved design `%s'.\n", fn.c_str()+1);
+			cache_entry.reset(new TechmapMapCache::Entry);
+			cache_entry->map = new RTLIL::Design;
+		}
+
+		RTLIL::Design *map = cache_entry->map;
+		auto &celltypeMap = cache_entry->celltypeMap;
+
+		if (cache_entry->uses == 0)
+		{
+			if (map_files.empty()) {
+				std::istringstream f(stdcells_code);
+				Frontend::frontend_call(map, &f, "<techmap.v>", verilog_frontend);
+			} else {
+				for (int i = 0; i < GetSize(map_files); i++) {
+					const std::string &fn = map_files[i];
+					if (fn.compare(0, 1, "%") == 0) {
+						for (auto mod : saved_designs.at(fn.substr(1))->modules())
+							if (!map->has(mod->name))
+								map->add(mod->clone());
+					} else {
+						std::istringstream f(map_data[i]);
+						Frontend::frontend_call(map, &f, fn, (fn.size() > 3 && fn.compare(fn.size()-3, std::string::npos, ".il") == 0 ? "ilang" : verilog_frontend));
 					}
-					for (auto mod : saved_designs.at(fn.substr(1))->modules())
-						if (!map->has(mod->name))
-							map->add(mod->clone());
+				}
+			}
+
+			// derived templates are added to the map later, they must not match
+			// cell types in later calls
+			std::map<RTLIL::IdString, std::set<RTLIL::IdString, RTLIL::sort_by_id_str>> celltypes;
+			for (auto &it : map->modules_) {
+				if (it.second->attributes.count(ID(techmap_celltype)) && !it.second->attributes.at(ID(techmap_celltype)).empty()) {
+					char *p = strdup(it.second->attributes.at(ID(techmap_celltype)).decode_string().c_str());
+					for (char *q = strtok(p, " \t\r\n"); q; q = strtok(NULL, " \t\r\n"))
+						celltypes[RTLIL::escape_id(q)].insert(it.first);
+					free(p);
 				} else {
-					std::ifstream f;
-					rewrite_filename(fn);
-					f.open(fn.c_str());
-					yosys_input_files.insert(fn);
-					if (f.fail())
-						log_cmd_error("Can't open map file `%s'\n", fn.c_str());
-					Frontend::frontend_call(map, &f, fn, (fn.size() > 3 && fn.compare(fn.size()-3, std::string::npos, ".il") == 0 ? "ilang" : verilog_frontend));
+					string module_name = it.first.str();
+					if (it.first.begins_with("\\$"))
+						module_name = module_name.substr(1);
+					celltypes[module_name].insert(it.first);
 				}
+			}
+			celltypeMap = TechmapMapCache::CelltypeMap(celltypes.begin(), celltypes.end());
 		}
 
 		log_header(design, "Continuing TECHMAP pass.\n");
 
-		std::map<RTLIL::IdString, std::set<RTLIL::IdString, RTLIL::sort_by_id_str>> celltypeMap;
-		for (auto &it : map->modules_) {
-			if (it.second->attributes.count(ID(techmap_celltype)) && !it.second->attributes.at(ID(techmap_celltype)).bits.empty()) {
-				char *p = strdup(it.second->attributes.at(ID(techmap_celltype)).decode_string().c_str());
-				for (char *q = strtok(p, " \t\r\n"); q; q = strtok(NULL, " \t\r\n"))
-					celltypeMap[RTLIL::escape_id(q)].insert(it.first);
-				free(p);
-			} else {
-				string module_name = it.first.str();
-				if (it.first.begins_with("\\$"))
-					module_name = module_name.substr(1);
-				celltypeMap[module_name].insert(it.first);
-			}
-		}
+		worker.techmap_cache.swap(cache_entry->techmap_cache);
+		worker.techmap_do_cache.swap(cache_entry->techmap_do_cache);
+		worker.template_cache.swap(cache_entry->template_cache);
 
 		for (auto module : design->modules())
 			worker.module_queue.insert(module);
@@ -1325,10 +1541,10 @@ struct TechmapPass : public Pass {
 
 			int module_max_iter = max_iter;
 			bool did_something = true;
-			std::set<RTLIL::Cell*> handled_cells;
+			TechmapWorker::CellWorklist worklist;
 			while (did_something) {
 				did_something = false;
-				if (worker.techmap_module(design, module, map, handled_cells, celltypeMap, false))
+				if (worker.techmap_module(design, module, map, worklist, celltypeMap, false))
 					did_something = true;
 				if (did_something)
 					module->check();
@@ -1338,14 +1554,78 @@ struct TechmapPass : public Pass {
 		}
 
 		log("No more expansions possible.\n");
-		delete map;
+
+		if (use_cache) {
+			worker.techmap_cache.swap(cache_entry->techmap_cache);
+			worker.techmap_do_cache.swap(cache_entry->techmap_do_cache);
+			worker.template_cache.swap(cache_entry->template_cache);
+			cache_entry->uses++;
+			TechmapMapCache::instance.put(cache_key, cache_entry.release());
+		}
 
 		log_pop();
 	}
 } TechmapPass;
 
-struct FlattenPass : public Pass {
-	FlattenPass() : Pass("flatten", "flatten design") { }
+struct TechmapCachePass : public Pass {
+	TechmapCachePass() : Pass("techmap_cache", "configure the cache of techmap map files") { }
+	void on_shutdown() YS_OVERRIDE
+	{
+		// the map designs must go before the IdString tables
+		TechmapMapCache::instance.clear();
+	}
+	void help() YS_OVERRIDE
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    techmap_cache [options]\n");
+		log("\n");
+		log("'techmap' keeps the map designs it has read for later calls in the same session,\n");
+		log("together with the templates it has derived from them for the parameters of the\n");
+		log("mapped cells. A later call with the same map files and options reuses them, so\n");
+		log("that for example the many calls of techmap with +/techmap.v in a synthesis\n");
+		log("script read and specialize the map file only once. Map files are compared by\n");
+		log("content, but files included by a Verilog map file are not checked. Map designs\n");
+		log("given as '-map %%<design-name>' are never cached.\n");
+		log("\n");
+		log("    -clear\n");
+		log("        free all map designs held in memory.\n");
+		log("\n");
+		log("    -list\n");
+		log("        list the map designs held in memory.\n");
+		log("\n");
+		log("See also 'techmap -nocache'.\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design*) YS_OVERRIDE
+	{
+		TechmapMapCache &cache = TechmapMapCache::instance;
+		bool flag_list = false;
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-clear") {
+				cache.clear();
+				continue;
+			}
+			if (args[argidx] == "-list") {
+				flag_list = true;
+				continue;
+			}
+			break;
+		}
+		if (argidx != args.size())
+			cmd_error(args, argidx, "Extra argument.");
+
+		if (flag_list)
+			for (auto &it : cache.entries)
+				log("%s (%d modules, used %d times)\n", it.first.c_str(), GetSize(it.second->map->modules_), it.second->uses);
+	}
+} TechmapCachePass;
+
+struct FlattenPass : public ModulePass {
+	FlattenPass() : ModulePass("flatten", "flatten design") { }
 	void help() YS_OVERRIDE
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -1359,10 +1639,78 @@ struct FlattenPass : public Pass {
 		log("Cells and/or modules with the 'keep_hierarchy' attribute set will not be\n");
 		log("flattened by this command.\n");
 		log("\n");
+		log("When the whole design is selected and has a top module, the modules below the\n");
+		log("top module are flattened bottom-up, so that every module is flattened only\n");
+		log("once, and the modules of one hierarchy level are flattened concurrently (see\n");
+		log("'yosys -j').\n");
+		log("\n");
 		log("    -wb\n");
 		log("        Ignore the 'whitebox' attribute on cell implementations.\n");
 		log("\n");
 	}
+
+	RTLIL::Design *design;
+	bool ignore_wb;
+	TechmapWorker::CelltypeMap celltypeMap;
+
+	void execute_module(RTLIL::Module *module) YS_OVERRIDE
+	{
+		TechmapWorker worker;
+		worker.flatten_mode = true;
+		worker.ignore_wb = ignore_wb;
+
+		TechmapWorker::CellWorklist worklist;
+		while (worker.techmap_module(design, module, design, worklist, celltypeMap, false)) { }
+	}
+
+	// Sorts the modules below top by their height in the hierarchy, leaf modules
+	// first. Returns false for recursive hierarchies and for instances that still
+	// have parameters, which need the top-down flattening that derives modules.
+	bool hierarchy_levels(RTLIL::Module *top, std::vector<std::vector<RTLIL::Module*>> &levels)
+	{
+		dict<RTLIL::Module*, int> height;
+		pool<RTLIL::Module*> active;
+		bool ok = true;
+
+		std::function<int(RTLIL::Module*)> visit = [&](RTLIL::Module *module) -> int {
+			auto it = height.find(module);
+			if (it != height.end())
+				return it->second;
+			if (active.count(module)) {
+				ok = false;
+				return 0;
+			}
+			active.insert(module);
+			int h = 0;
+			for (auto cell : module->cells()) {
+				RTLIL::Module *sub = design->module(cell->type);
+				if (sub == nullptr || sub->get_blackbox_attribute(ignore_wb))
+					continue;
+				if (!cell->parameters.empty())
+					ok = false;
+				h = std::max(h, visit(sub) + 1);
+			}
+			active.erase(module);
+			height[module] = h;
+			return h;
+		};
+
+		visit(top);
+		if (!ok)
+			return false;
+
+		levels.clear();
+		for (auto module : design->modules()) {
+			auto it = height.find(module);
+			if (it == height.end())
+				continue;
+			if (GetSize(levels) <= it->second)
+				levels.resize(it->second + 1);
+			levels[it->second].push_back(module);
+		}
+		return true;
+	}
+
 	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
 	{
 		log_header(design, "Executing FLATTEN pass (flatten design).\n");
@@ -1381,10 +1729,13 @@ struct FlattenPass : public Pass {
 		}
 		extra_args(args, argidx, design);
 
+		this->design = design;
+		ignore_wb = worker.ignore_wb;
 
-		std::map<RTLIL::IdString, std::set<RTLIL::IdString, RTLIL::sort_by_id_str>> celltypeMap;
+		std::vector<std::pair<RTLIL::IdString, std::set<RTLIL::IdString, RTLIL::sort_by_id_str>>> celltypes;
 		for (auto module : design->modules())
-			celltypeMap[module->name].insert(module->name);
+			celltypes.push_back({module->name, {module->name}});
+		celltypeMap = TechmapWorker::CelltypeMap(celltypes.begin(), celltypes.end());
 
 		RTLIL::Module *top_mod = NULL;
 		if (design->full_selection())
@@ -1392,18 +1743,25 @@ struct FlattenPass : public Pass {
 				if (mod->get_bool_attribute(ID(top)))
 					top_mod = mod;
 
-		std::set<RTLIL::Cell*> handled_cells;
-		if (top_mod != NULL) {
+		std::vector<std::vector<RTLIL::Module*>> levels;
+		if (top_mod != NULL && hierarchy_levels(top_mod, levels)) {
+			// the templates of each level are the already flattened modules of
+			// the levels below it, and are only read while it is flattened
+			for (auto &level : levels)
+				execute_modules(level);
+		} else if (top_mod != NULL) {
 			worker.flatten_do_list.insert(top_mod->name);
 			while (!worker.flatten_do_list.empty()) {
 				auto mod = design->module(*worker.flatten_do_list.begin());
-				while (worker.techmap_module(design, mod, design, handled_cells, celltypeMap, false)) { }
+				TechmapWorker::CellWorklist worklist;
+				while (worker.techmap_module(design, mod, design, worklist, celltypeMap, false)) { }
 				worker.flatten_done_list.insert(mod->name);
 				worker.flatten_do_list.erase(mod->name);
 			}
 		} else {
 			for (auto mod : vector<Module*>(design->modules())) {
-				while (worker.techmap_module(design, mod, design, handled_cells, celltypeMap, false)) { }
+				TechmapWorker::CellWorklist worklist;
+				while (worker.techmap_module(design, mod, design, worklist, celltypeMap, false)) { }
 			}
 		}
 
@@ -19,6 +19,7 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
+#include "kernel/ffindex.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -56,7 +57,8 @@ struct ZinitPass : public Pass {
 
 		for (auto module : design->selected_modules())
 		{
-			SigMap sigmap(module);
+			FfIndex ff_index(module);
+			SigMap &sigmap = ff_index.sigmap;
 			dict<SigBit, State> initbits;
 			pool<SigBit> donebits;
 
@@ -89,18 +91,9 @@ struct ZinitPass : public Pass {
 				}
 			}
 
-			pool<IdString> dff_types = {
-				ID($ff), ID($dff), ID($dffe), ID($dffsr), ID($adff),
-				ID($_FF_), ID($_DFFE_NN_), ID($_DFFE_NP_), ID($_DFFE_PN_), ID($_DFFE_PP_),
-				ID($_DFFSR_NNN_), ID($_DFFSR_NNP_), ID($_DFFSR_NPN_), ID($_DFFSR_NPP_),
-				ID($_DFFSR_PNN_), ID($_DFFSR_PNP_), ID($_DFFSR_PPN_), ID($_DFFSR_PPP_),
-				ID($_DFF_N_), ID($_DFF_NN0_), ID($_DFF_NN1_), ID($_DFF_NP0_), ID($_DFF_NP1_),
-				ID($_DFF_P_), ID($_DFF_PN0_), ID($_DFF_PN1_), ID($_DFF_PP0_), ID($_DFF_PP1_)
-			};
-
-			for (auto cell : module->selected_cells())
+			for (auto cell : ff_index.ff_cells)
 			{
-				if (!dff_types.count(cell->type))
+				if (FfIndex::is_latch(cell->type) || !design->selected(module, cell))
 					continue;
 
 				SigSpec sig_d = sigmap(cell->getPort(ID(D)));
@@ -113,21 +106,21 @@ struct ZinitPass : public Pass {
 
 				for (int i = 0; i < GetSize(sig_q); i++) {
 					if (initbits.count(sig_q[i])) {
-						initval.bits.push_back(initbits.at(sig_q[i]));
+						initval.bits().push_back(initbits.at(sig_q[i]));
 						donebits.insert(sig_q[i]);
 					} else
-						initval.bits.push_back(all_mode ? State::S0 : State::Sx);
+						initval.bits().push_back(all_mode ? State::S0 : State::Sx);
 				}
 
 				Wire *initwire = module->addWire(NEW_ID, GetSize(initval));
 				initwire->attributes[ID(init)] = initval;
 
 				for (int i = 0; i < GetSize(initwire); i++)
-					if (initval.bits.at(i) == State::S1)
+					if (initval[i] == State::S1)
 					{
 						sig_d[i] = module->NotGate(NEW_ID, sig_d[i]);
 						module->addNotGate(NEW_ID, SigSpec(initwire, i), sig_q[i]);
-						initwire->attributes[ID(init)].bits.at(i) = State::S0;
+						initwire->attributes[ID(init)].bits().at(i) = State::S0;
 					}
 					else
 					{
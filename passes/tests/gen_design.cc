@@ -0,0 +1,318 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Clifford Wolf <clifford@clifford.at>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+struct GenDesignWorker
+{
+	RTLIL::Design *design;
+	uint32_t rng_state = 123456789;
+
+	std::string top_name = "\\top";
+	int num_cells = 1000, width = 8, num_inputs = 8, num_outputs = 8;
+	int depth = 0, fanout = 2, num_mems = 0, mem_abits = 8, dff_percent = 10;
+
+	GenDesignWorker(RTLIL::Design *design) : design(design) { }
+
+	void seed(uint32_t seed)
+	{
+		// xorshift gets stuck at zero
+		rng_state = seed ^ 123456789;
+		if (rng_state == 0)
+			rng_state = 1;
+	}
+
+	uint32_t rng(uint32_t limit)
+	{
+		rng_state ^= rng_state << 13;
+		rng_state ^= rng_state >> 17;
+		rng_state ^= rng_state << 5;
+		return rng_state % limit;
+	}
+
+	const RTLIL::SigSpec &pick(const std::vector<RTLIL::SigSpec> &signals)
+	{
+		// half of the operands are taken from the most recent signals, which
+		// makes the logic deeper than with uniformly chosen operands
+		int n = GetSize(signals);
+		if (n > 64 && rng(2))
+			return signals[n - 1 - rng(64)];
+		return signals[rng(n)];
+	}
+
+	RTLIL::SigSpec pick_bits(const std::vector<RTLIL::SigSpec> &signals, int num_bits)
+	{
+		RTLIL::SigSpec sig;
+		while (GetSize(sig) < num_bits)
+			sig.append(pick(signals));
+		return sig.extract(0, num_bits);
+	}
+
+	RTLIL::Module *gen_module(RTLIL::IdString name, RTLIL::Module *sub)
+	{
+		RTLIL::Module *module = design->addModule(name);
+		RTLIL::Wire *clk = module->addWire(ID(clk));
+		clk->port_input = true;
+
+		std::vector<RTLIL::SigSpec> signals;
+		for (int i = 0; i < num_inputs; i++) {
+			RTLIL::Wire *wire = module->addWire(stringf("\\in%d", i), width);
+			wire->port_input = true;
+			signals.push_back(wire);
+		}
+
+		int wire_idx = 0;
+		auto new_signal = [&]() {
+			return RTLIL::SigSpec(module->addWire(stringf("$n%d", wire_idx++), width));
+		};
+
+		for (int i = 0; i < num_cells; i++)
+		{
+			RTLIL::SigSpec y = new_signal();
+			RTLIL::IdString cell_name = stringf("$c%d", i);
+
+			if (int(rng(100)) < dff_percent) {
+				module->addDff(cell_name, clk, pick(signals), y);
+			} else {
+				switch (rng(3)) {
+				case 0:
+					module->addAnd(cell_name, pick(signals), pick(signals), y);
+					break;
+				case 1:
+					module->addAdd(cell_name, pick(signals), pick(signals), y);
+					break;
+				default:
+					module->addMux(cell_name, pick(signals), pick(signals), pick(signals)[rng(width)], y);
+					break;
+				}
+			}
+
+			signals.push_back(y);
+		}
+
+		for (int i = 0; i < num_mems; i++)
+		{
+			RTLIL::Memory *memory = new RTLIL::Memory;
+			memory->name = stringf("\\mem%d", i);
+			memory->width = width;
+			memory->size = 1 << mem_abits;
+			module->memories[memory->name] = memory;
+
+			RTLIL::Cell *wr = module->addCell(stringf("$memwr%d", i), ID($memwr));
+			wr->setParam(ID(MEMID), RTLIL::Const(memory->name.str()));
+			wr->setParam(ID(ABITS), mem_abits);
+			wr->setParam(ID(WIDTH), width);
+			wr->setParam(ID(CLK_ENABLE), RTLIL::Const(1));
+			wr->setParam(ID(CLK_POLARITY), RTLIL::Const(1));
+			wr->setParam(ID(PRIORITY), RTLIL::Const(0));
+			wr->setPort(ID(CLK), clk);
+			wr->setPort(ID(EN), RTLIL::SigSpec(pick(signals)[rng(width)], width));
+			wr->setPort(ID(ADDR), pick_bits(signals, mem_abits));
+			wr->setPort(ID(DATA), pick(signals));
+
+			RTLIL::SigSpec data = new_signal();
+			RTLIL::Cell *rd = module->addCell(stringf("$memrd%d", i), ID($memrd));
+			rd->setParam(ID(MEMID), RTLIL::Const(memory->name.str()));
+			rd->setParam(ID(ABITS), mem_abits);
+			rd->setParam(ID(WIDTH), width);
+			rd->setParam(ID(CLK_ENABLE), RTLIL::Const(1));
+			rd->setParam(ID(CLK_POLARITY), RTLIL::Const(1));
+			rd->setParam(ID(TRANSPARENT), RTLIL::Const(0));
+			rd->setPort(ID(CLK), clk);
+			rd->setPort(ID(EN), RTLIL::State::S1);
+			rd->setPort(ID(ADDR), pick_bits(signals, mem_abits));
+			rd->setPort(ID(DATA), data);
+			signals.push_back(data);
+		}
+
+		if (sub != nullptr)
+			for (int i = 0; i < fanout; i++)
+			{
+				RTLIL::Cell *cell = module->addCell(stringf("\\u%d", i), sub->name);
+				cell->setPort(ID(clk), clk);
+				for (int j = 0; j < num_inputs; j++)
+					cell->setPort(stringf("\\in%d", j), pick(signals));
+				for (int j = 0; j < num_outputs; j++) {
+					RTLIL::SigSpec y = new_signal();
+					cell->setPort(stringf("\\out%d", j), y);
+					signals.push_back(y);
+				}
+			}
+
+		// outputs are driven by the last signals, so that most of the logic
+		// is in their fan-in
+		for (int i = 0; i < num_outputs; i++) {
+			RTLIL::Wire *wire = module->addWire(stringf("\\out%d", i), width);
+			wire->port_output = true;
+			module->connect(wire, signals[std::max(GetSize(signals) - 1 - i, 0)]);
+		}
+
+		module->fixup_ports();
+		return module;
+	}
+
+	void run()
+	{
+		for (int level = 0; level <= depth; level++) {
+			RTLIL::IdString name = level == 0 ? top_name : stringf("%s_l%d", top_name.c_str(), level);
+			if (design->module(name) != nullptr)
+				log_cmd_error("Module %s already exists.\n", log_id(name));
+		}
+
+		// the module of each level instantiates the module of the next level
+		RTLIL::Module *sub = nullptr;
+		for (int level = depth; level >= 0; level--) {
+			RTLIL::IdString name = level == 0 ? top_name : stringf("%s_l%d", top_name.c_str(), level);
+			sub = gen_module(name, sub);
+			log("Generated module %s with %d cells.\n", log_id(sub), GetSize(sub->cells()));
+		}
+		sub->set_bool_attribute(ID(top));
+
+		double instances = 0;
+		for (int level = 0; level <= depth; level++)
+			instances += pow(fanout, level);
+		log("Flattened design has %.0f cells.\n", instances * (num_cells + 2*num_mems));
+	}
+};
+
+struct GenDesignPass : public Pass {
+	GenDesignPass() : Pass("gen_design", "generate a random design of a given size") { }
+	void help() YS_OVERRIDE
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    gen_design [options]\n");
+		log("\n");
+		log("Generate a random design for stress-testing and benchmarking. Every module is\n");
+		log("a random DAG of $and, $add, $mux and $dff cells on buses of the same width,\n");
+		log("optionally with memories and instances of the module of the next hierarchy\n");
+		log("level. The same seed and options always generate the same design.\n");
+		log("\n");
+		log("    -seed <n>\n");
+		log("        seed of the random number generator (default: 1)\n");
+		log("\n");
+		log("    -top <name>\n");
+		log("        name of the top module (default: top). the modules of the lower\n");
+		log("        hierarchy levels are called <name>_l1, <name>_l2, ...\n");
+		log("\n");
+		log("    -cells <n>\n");
+		log("        number of logic cells in each module (default: 1000)\n");
+		log("\n");
+		log("    -width <n>\n");
+		log("        width of all buses (default: 8)\n");
+		log("\n");
+		log("    -inputs <n>, -outputs <n>\n");
+		log("        number of input and output ports of each module (default: 8)\n");
+		log("\n");
+		log("    -dff <percent>\n");
+		log("        percentage of $dff cells among the logic cells (default: 10)\n");
+		log("\n");
+		log("    -depth <n>\n");
+		log("        number of hierarchy levels below the top module (default: 0)\n");
+		log("\n");
+		log("    -fanout <n>\n");
+		log("        number of instances of the next level in each module (default: 2)\n");
+		log("\n");
+		log("    -mem <n>\n");
+		log("        number of memories in each module, each with one synchronous read\n");
+		log("        and one write port (default: 0)\n");
+		log("\n");
+		log("    -memabits <n>\n");
+		log("        number of address bits of the memories (default: 8)\n");
+		log("\n");
+		log("For example, a flat design with one million cells:\n");
+		log("\n");
+		log("    gen_design -cells 1000000 -width 4\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
+	{
+		GenDesignWorker worker(design);
+		worker.seed(1);
+
+		log_header(design, "Executing GEN_DESIGN pass (generating a random design).\n");
+
+		auto int_arg = [&](size_t &argidx, int min_value) {
+			int value = atoi(args[++argidx].c_str());
+			if (value < min_value)
+				log_cmd_error("Invalid value for %s: %s\n", args[argidx-1].c_str(), args[argidx].c_str());
+			return value;
+		};
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-seed" && argidx+1 < args.size()) {
+				worker.seed(atoi(args[++argidx].c_str()));
+				continue;
+			}
+			if (args[argidx] == "-top" && argidx+1 < args.size()) {
+				worker.top_name = RTLIL::escape_id(args[++argidx]);
+				continue;
+			}
+			if (args[argidx] == "-cells" && argidx+1 < args.size()) {
+				worker.num_cells = int_arg(argidx, 0);
+				continue;
+			}
+			if (args[argidx] == "-width" && argidx+1 < args.size()) {
+				worker.width = int_arg(argidx, 1);
+				continue;
+			}
+			if (args[argidx] == "-inputs" && argidx+1 < args.size()) {
+				worker.num_inputs = int_arg(argidx, 1);
+				continue;
+			}
+			if (args[argidx] == "-outputs" && argidx+1 < args.size()) {
+				worker.num_outputs = int_arg(argidx, 1);
+				continue;
+			}
+			if (args[argidx] == "-dff" && argidx+1 < args.size()) {
+				worker.dff_percent = std::min(int_arg(argidx, 0), 100);
+				continue;
+			}
+			if (args[argidx] == "-depth" && argidx+1 < args.size()) {
+				worker.depth = int_arg(argidx, 0);
+				continue;
+			}
+			if (args[argidx] == "-fanout" && argidx+1 < args.size()) {
+				worker.fanout = int_arg(argidx, 1);
+				continue;
+			}
+			if (args[argidx] == "-mem" && argidx+1 < args.size()) {
+				worker.num_mems = int_arg(argidx, 0);
+				continue;
+			}
+			if (args[argidx] == "-memabits" && argidx+1 < args.size()) {
+				worker.mem_abits = int_arg(argidx, 1);
+				if (worker.mem_abits > 24)
+					log_cmd_error("Invalid value for -memabits: %d (at most 24)\n", worker.mem_abits);
+				continue;
+			}
+			break;
+		}
+		extra_args(args, argidx, design, false);
+
+		worker.run();
+	}
+} GenDesignPass;
+
+PRIVATE_NAMESPACE_END
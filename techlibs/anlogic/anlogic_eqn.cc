@@ -19,6 +19,7 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
+#include "kernel/truthtable.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -36,14 +37,13 @@ struct AnlogicEqnPass : public Pass {
 
 	Const init2eqn(Const init, int inputs)
 	{
-		std::string init_bits = init.as_string();
+		TruthTable table(init, inputs);
 		const char* names[] = { "A" , "B", "C", "D", "E", "F" };
 
 		std::string eqn;
-		int width = (int)pow(2,inputs);
-		for(int i=0;i<width;i++)
+		for(int i=0;i<table.size();i++)
 		{
-			if (init_bits[width-1-i]=='1')
+			if (table.get(i))
 			{
 				eqn += "(";
 				for(int j=0;j<inputs;j++)
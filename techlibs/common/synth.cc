@@ -21,6 +21,12 @@
 #include "kernel/celltypes.h"
 #include "kernel/rtlil.h"
 #include "kernel/log.h"
+#include "backends/ilang/ilang_backend.h"
+#include "backends/rtlil_bin/rtlil_bin.h"
+#include "libs/sha1/sha1.h"
+
+#include <sys/stat.h>
+#include <errno.h>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -78,16 +84,29 @@ struct SynthPass : public ScriptPass
 		log("    -abc9\n");
 		log("        use new ABC9 flow (EXPERIMENTAL)\n");
 		log("\n");
+		log("    -incremental <dir>\n");
+		log("        keep the synthesized modules in the given cache directory. before\n");
+		log("        the 'coarse' label, each module is looked up by a hash of its RTLIL,\n");
+		log("        the interfaces of the modules it instantiates, and the options of\n");
+		log("        this command. modules found in the cache are replaced by the cached\n");
+		log("        result and not selected for the following commands. the other modules\n");
+		log("        are added to the cache before the 'check' label. this can not be\n");
+		log("        combined with -flatten or -run. the cache is never cleaned up.\n");
+		log("\n");
 		log("\n");
 		log("The following commands are executed by this synthesis command:\n");
 		help_script();
 		log("\n");
 	}
 
-	string top_module, fsm_opts, memory_opts, abc;
+	string top_module, fsm_opts, memory_opts, abc, incremental_dir, incremental_options;
 	bool autotop, flatten, noalumacc, nofsm, noabc, noshare;
 	int lut;
 
+	// cache keys of the modules that are synthesized in the incremental mode
+	dict<RTLIL::IdString, std::string> incremental_keys;
+	bool incremental_active;
+
 	void clear_flags() YS_OVERRIDE
 	{
 		top_module.clear();
@@ -102,6 +121,113 @@ struct SynthPass : public ScriptPass
 		noabc = false;
 		noshare = false;
 		abc = "abc";
+		incremental_dir.clear();
+		incremental_options.clear();
+		incremental_keys.clear();
+		incremental_active = false;
+	}
+
+	std::string incremental_key(RTLIL::Module *module)
+	{
+		std::stringstream buf;
+		buf << yosys_version_str << "\n" << incremental_options << "\n";
+		ILANG_BACKEND::dump_module(buf, "", module, module->design, false);
+
+		pool<RTLIL::IdString> submodules;
+		for (auto cell : module->cells())
+			if (module->design->module(cell->type) != nullptr)
+				submodules.insert(cell->type);
+		submodules.sort();
+
+		for (auto type : submodules) {
+			buf << "interface " << type.str() << "\n";
+			RTLIL::Module *submodule = module->design->module(type);
+			for (auto port : submodule->ports) {
+				RTLIL::Wire *wire = submodule->wire(port);
+				buf << port.str() << " " << wire->width << " " << wire->port_input << wire->port_output << "\n";
+			}
+		}
+
+		return sha1(buf.str());
+	}
+
+	void incremental_begin()
+	{
+		log_header(active_design, "Looking up modules in cache directory `%s'.\n", incremental_dir.c_str());
+
+#ifdef _WIN32
+		if (mkdir(incremental_dir.c_str()) != 0 && errno != EEXIST)
+#else
+		if (mkdir(incremental_dir.c_str(), 0777) != 0 && errno != EEXIST)
+#endif
+			log_cmd_error("Can't create directory `%s': %s\n", incremental_dir.c_str(), strerror(errno));
+
+		// all keys are computed before any module is replaced
+		dict<RTLIL::IdString, std::string> keys;
+		for (auto module : active_design->modules())
+			if (!module->get_blackbox_attribute())
+				keys[module->name] = incremental_key(module);
+
+		RTLIL::Selection selection(false);
+		int num_cached = 0;
+
+		for (auto &it : keys)
+		{
+			std::string filename = incremental_dir + "/" + it.second + ".yrb";
+			RTLIL::Design cached_design;
+			RTLIL::Module *cached_module = nullptr;
+			if (check_file_exists(filename) && RTLIL_BIN::read_file(filename, &cached_design))
+				cached_module = cached_design.module(it.first);
+
+			if (cached_module == nullptr) {
+				log("Module %s is not cached and will be synthesized.\n", log_id(it.first));
+				selection.selected_modules.insert(it.first);
+				incremental_keys[it.first] = it.second;
+				continue;
+			}
+
+			log("Using cached module %s from `%s'.\n", log_id(it.first), filename.c_str());
+			active_design->remove(active_design->module(it.first));
+			active_design->add(cached_module->clone());
+			num_cached++;
+		}
+
+		log("Found %d of %d modules in the cache.\n", num_cached, GetSize(keys));
+
+		active_design->selection_stack.push_back(selection);
+		incremental_active = true;
+	}
+
+	void incremental_end()
+	{
+		active_design->selection_stack.pop_back();
+		incremental_active = false;
+
+		log_header(active_design, "Adding synthesized modules to cache directory `%s'.\n", incremental_dir.c_str());
+
+		for (auto &it : incremental_keys)
+		{
+			RTLIL::Module *module = active_design->module(it.first);
+			if (module == nullptr)
+				continue;
+
+			std::string filename = incremental_dir + "/" + it.second + ".yrb";
+			std::string temp_filename = filename + ".tmp";
+			log("Saving module %s to `%s'.\n", log_id(module), filename.c_str());
+
+			RTLIL::Design cached_design;
+			cached_design.add(module->clone());
+
+			std::ofstream f(temp_filename.c_str(), std::ofstream::binary);
+			if (f.fail())
+				log_cmd_error("Can't open file `%s' for writing: %s\n", temp_filename.c_str(), strerror(errno));
+			RTLIL_BIN::write_design(f, &cached_design);
+			f.close();
+			if (f.fail() || rename(temp_filename.c_str(), filename.c_str()) != 0)
+				log_cmd_error("Writing file `%s' failed.\n", filename.c_str());
+		}
+
+		incremental_keys.clear();
 	}
 
 	void execute(std::vector<std::string> args, RTLIL::Design *design) YS_OVERRIDE
@@ -167,10 +293,24 @@ struct SynthPass : public ScriptPass
 				abc = "abc9";
 				continue;
 			}
+			if (args[argidx] == "-incremental" && argidx+1 < args.size()) {
+				incremental_dir = args[++argidx];
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
+		// the cache key covers all options except the cache directory
+		for (size_t i = 1; i < args.size(); i++)
+			if (args[i] == "-incremental")
+				i++;
+			else
+				incremental_options += " " + args[i];
+
+		if (!incremental_dir.empty() && (flatten || !run_from.empty() || !run_to.empty()))
+			log_cmd_error("The -incremental option can not be combined with -flatten or -run.\n");
+
 		if (!design->full_selection())
 			log_cmd_error("This command only operates on fully selected designs!\n");
 
@@ -204,6 +344,8 @@ struct SynthPass : public ScriptPass
 
 		if (check_label("coarse"))
 		{
+			if (!incremental_dir.empty() && commands_active())
+				incremental_begin();
 			run("proc");
 			if (help_mode || flatten)
 				run("flatten", "  (if -flatten)");
@@ -269,6 +411,8 @@ struct SynthPass : public ScriptPass
 
 		if (check_label("check"))
 		{
+			if (incremental_active && commands_active())
+				incremental_end();
 			run("hierarchy -check");
 			run("stat");
 			run("check");
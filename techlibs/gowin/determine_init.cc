@@ -38,7 +38,7 @@ struct DetermineInitPass : public Pass {
 	{
 		for (int i = 0; i < GetSize(init); i++) {
 			if (init[i] != State::S0 && init[i] != State::S1)
-				init[i] = State::S0;
+				init.bits()[i] = State::S0;
 		}
 
 		return init;
@@ -35,10 +35,10 @@ void invert_gp_dff(Cell *cell, bool invert_input)
 	{
 		Const initval = cell->getParam("\\INIT");
 		if (GetSize(initval) >= 1) {
-			if (initval.bits[0] == State::S0)
-				initval.bits[0] = State::S1;
-			else if (initval.bits[0] == State::S1)
-				initval.bits[0] = State::S0;
+			if (initval[0] == State::S0)
+				initval.bits()[0] = State::S1;
+			else if (initval[0] == State::S1)
+				initval.bits()[0] = State::S0;
 			cell->setParam("\\INIT", initval);
 		}
 
@@ -46,10 +46,10 @@ void invert_gp_dff(Cell *cell, bool invert_input)
 		{
 			Const srmode = cell->getParam("\\SRMODE");
 			if (GetSize(srmode) >= 1) {
-				if (srmode.bits[0] == State::S0)
-					srmode.bits[0] = State::S1;
-				else if (srmode.bits[0] == State::S1)
-					srmode.bits[0] = State::S0;
+				if (srmode[0] == State::S0)
+					srmode.bits()[0] = State::S1;
+				else if (srmode[0] == State::S1)
+					srmode.bits()[0] = State::S0;
 				cell->setParam("\\SRMODE", srmode);
 			}
 		}
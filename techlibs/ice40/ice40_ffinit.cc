@@ -164,7 +164,7 @@ struct Ice40FfinitPass : public Pass {
 
 				for (int i = 0; i < GetSize(wirebits) && i < GetSize(initval); i++) {
 					if (handled_initbits.count(wirebits[i]))
-						initval[i] = State::Sx;
+						initval.bits()[i] = State::Sx;
 					else if (initval[i] != State::Sx)
 						remove_attribute = false;
 				}
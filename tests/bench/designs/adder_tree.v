@@ -0,0 +1,12 @@
+// Sum of N 16-bit inputs, registered
+module top #(parameter N = 16) (input clk, input [16*N-1:0] in, output reg [31:0] sum);
+	integer i;
+	reg [31:0] acc;
+	always @* begin
+		acc = 0;
+		for (i = 0; i < N; i = i+1)
+			acc = acc + in[16*i +: 16];
+	end
+	always @(posedge clk)
+		sum <= acc;
+endmodule
@@ -0,0 +1,14 @@
+// N registered 8x8 multipliers with an XOR reduction of the products
+module top #(parameter N = 16) (input clk, input [8*N-1:0] a, b, output reg [15:0] y);
+	reg [16*N-1:0] p;
+	integer i;
+	reg [15:0] x;
+	always @(posedge clk) begin
+		for (i = 0; i < N; i = i+1)
+			p[16*i +: 16] <= a[8*i +: 8] * b[8*i +: 8];
+		x = 0;
+		for (i = 0; i < N; i = i+1)
+			x = x ^ p[16*i +: 16];
+		y <= x;
+	end
+endmodule
@@ -0,0 +1,10 @@
+// N pipeline stages, each selecting between rotated and inverted data
+module top #(parameter N = 16) (input clk, input [N-1:0] sel, input [31:0] in, output [31:0] out);
+	reg [31:0] stage [0:N];
+	integer i;
+	always @* stage[0] = in;
+	always @(posedge clk)
+		for (i = 0; i < N; i = i+1)
+			stage[i+1] <= sel[i] ? {stage[i][30:0], stage[i][31]} : ~stage[i] + i;
+	assign out = stage[N];
+endmodule
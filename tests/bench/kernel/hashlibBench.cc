@@ -0,0 +1,90 @@
+#include <benchmark/benchmark.h>
+
+#include "kernel/yosys.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+static void BM_DictInsert(benchmark::State &state)
+{
+	int n = state.range(0);
+	for (auto _ : state) {
+		dict<int, int> d;
+		for (int i = 0; i < n; i++)
+			d[i * 7919] = i;
+		benchmark::DoNotOptimize(d);
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_DictInsert)->Range(1 << 10, 1 << 20);
+
+static void BM_DictLookup(benchmark::State &state)
+{
+	int n = state.range(0);
+	dict<int, int> d;
+	for (int i = 0; i < n; i++)
+		d[i * 7919] = i;
+	for (auto _ : state) {
+		int64_t sum = 0;
+		for (int i = 0; i < n; i++)
+			sum += d.at(i * 7919);
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_DictLookup)->Range(1 << 10, 1 << 20);
+
+static void BM_DictStringInsert(benchmark::State &state)
+{
+	int n = state.range(0);
+	std::vector<std::string> keys;
+	for (int i = 0; i < n; i++)
+		keys.push_back(stringf("key_%d", i));
+	for (auto _ : state) {
+		dict<std::string, int> d;
+		for (int i = 0; i < n; i++)
+			d[keys[i]] = i;
+		benchmark::DoNotOptimize(d);
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_DictStringInsert)->Range(1 << 10, 1 << 18);
+
+static void BM_PoolInsert(benchmark::State &state)
+{
+	int n = state.range(0);
+	for (auto _ : state) {
+		pool<int> p;
+		for (int i = 0; i < n; i++)
+			p.insert(i * 7919);
+		benchmark::DoNotOptimize(p);
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_PoolInsert)->Range(1 << 10, 1 << 20);
+
+static void BM_PoolLookup(benchmark::State &state)
+{
+	int n = state.range(0);
+	pool<int> p;
+	for (int i = 0; i < n; i++)
+		p.insert(i * 7919);
+	for (auto _ : state) {
+		int count = 0;
+		for (int i = 0; i < 2*n; i++)
+			count += p.count(i * 7919);
+		benchmark::DoNotOptimize(count);
+	}
+	state.SetItemsProcessed(state.iterations() * 2 * n);
+}
+BENCHMARK(BM_PoolLookup)->Range(1 << 10, 1 << 20);
+
+YOSYS_NAMESPACE_END
+
+int main(int argc, char **argv)
+{
+	Yosys::yosys_setup();
+	benchmark::Initialize(&argc, argv);
+	benchmark::RunSpecifiedBenchmarks();
+	Yosys::yosys_shutdown();
+	return 0;
+}
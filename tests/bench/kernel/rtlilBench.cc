@@ -0,0 +1,134 @@
+#include <benchmark/benchmark.h>
+
+#include "kernel/yosys.h"
+#include "kernel/rtlil.h"
+#include "kernel/sigtools.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+static void BM_IdStringIntern(benchmark::State &state)
+{
+	int n = state.range(0);
+	std::vector<std::string> names;
+	for (int i = 0; i < n; i++)
+		names.push_back(stringf("\\bench_intern_%d", i));
+	for (auto _ : state) {
+		// new strings, released again at the end of the iteration
+		std::vector<IdString> ids;
+		ids.reserve(n);
+		for (auto &name : names)
+			ids.push_back(IdString(name));
+		benchmark::DoNotOptimize(ids);
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_IdStringIntern)->Range(1 << 10, 1 << 18);
+
+static void BM_IdStringLookup(benchmark::State &state)
+{
+	int n = state.range(0);
+	std::vector<std::string> names;
+	std::vector<IdString> keep;
+	for (int i = 0; i < n; i++) {
+		names.push_back(stringf("\\bench_lookup_%d", i));
+		keep.push_back(names.back());
+	}
+	for (auto _ : state) {
+		int sum = 0;
+		for (auto &name : names)
+			sum += IdString(name).index_;
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_IdStringLookup)->Range(1 << 10, 1 << 18);
+
+static void BM_SigSpecPackUnpack(benchmark::State &state)
+{
+	int n = state.range(0);
+	Design design;
+	Module *module = design.addModule(ID(bench));
+	Wire *a = module->addWire(ID(a), n);
+	Wire *b = module->addWire(ID(b), n);
+
+	// alternating bits of two wires, so packing creates many chunks
+	std::vector<SigBit> bits;
+	for (int i = 0; i < n; i++)
+		bits.push_back(SigBit(i % 4 < 2 ? a : b, i));
+
+	for (auto _ : state) {
+		SigSpec sig(bits);
+		benchmark::DoNotOptimize(sig.chunks());
+		benchmark::DoNotOptimize(sig.bits());
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_SigSpecPackUnpack)->Range(1 << 6, 1 << 16);
+
+static void BM_SigSpecHash(benchmark::State &state)
+{
+	int n = state.range(0);
+	Design design;
+	Module *module = design.addModule(ID(bench));
+	Wire *a = module->addWire(ID(a), n);
+
+	for (auto _ : state) {
+		// copies do not share the cached hash
+		SigSpec sig = SigSpec(a).extract(1, n-1);
+		benchmark::DoNotOptimize(sig.hash());
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_SigSpecHash)->Range(1 << 6, 1 << 16);
+
+static void BM_SigMapConstruct(benchmark::State &state)
+{
+	int n = state.range(0);
+	Design design;
+	Module *module = design.addModule(ID(bench));
+	Wire *prev = module->addWire(ID(w0), 8);
+	for (int i = 1; i < n; i++) {
+		Wire *w = module->addWire(stringf("\\w%d", i), 8);
+		module->connect(w, prev);
+		prev = w;
+	}
+
+	for (auto _ : state) {
+		SigMap sigmap(module);
+		benchmark::DoNotOptimize(sigmap(prev));
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_SigMapConstruct)->Range(1 << 8, 1 << 16);
+
+static void BM_ModuleAddRemoveCell(benchmark::State &state)
+{
+	int n = state.range(0);
+	Design design;
+	Module *module = design.addModule(ID(bench));
+	std::vector<Wire*> wires;
+	for (int i = 0; i < n + 2; i++)
+		wires.push_back(module->addWire(stringf("\\w%d", i)));
+
+	for (auto _ : state) {
+		std::vector<Cell*> cells;
+		cells.reserve(n);
+		for (int i = 0; i < n; i++)
+			cells.push_back(module->addAnd(NEW_ID, wires[i], wires[i+1], wires[i+2]));
+		for (auto cell : cells)
+			module->remove(cell);
+	}
+	state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_ModuleAddRemoveCell)->Range(1 << 8, 1 << 16);
+
+YOSYS_NAMESPACE_END
+
+int main(int argc, char **argv)
+{
+	Yosys::yosys_setup();
+	benchmark::Initialize(&argc, argv);
+	benchmark::RunSpecifiedBenchmarks();
+	Yosys::yosys_shutdown();
+	return 0;
+}
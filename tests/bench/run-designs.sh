@@ -0,0 +1,27 @@
+#!/bin/bash
+#
+# End-to-end timings of opt, techmap and abc on the synthetic designs in
+# designs/, for increasing values of their size parameter N. The times are
+# taken from the profile written by "yosys -B" and include nested calls.
+
+set -e
+
+yosys=${1:-../../yosys}
+sizes=${SIZES:-"4 16 64 256"}
+
+printf "%-24s %6s %12s %12s %12s %10s\n" "design" "N" "opt [s]" "techmap [s]" "abc [s]" "cells"
+
+for design in designs/*.v; do
+	name=$(basename $design .v)
+	for n in $sizes; do
+		json=designs/${name}_$n.json
+		cells=$($yosys -q -B $json -p "read_verilog $design; hierarchy -top top -chparam N $n; proc; flatten" \
+				-p "opt; memory; opt; techmap; opt; abc; opt_clean" -p "tee -o /dev/stdout stat" |
+				sed -n 's/^ *Number of cells: *\([0-9]*\)$/\1/p' | tail -n 1)
+		total() {
+			sed -n "s/^ *\"$1\": {\"calls\": [0-9]*, \"total_ns\": \([0-9]*\),.*/\1/p" $json | awk '{ printf "%.3f", $1 / 1e9 }'
+		}
+		printf "%-24s %6d %12s %12s %12s %10s\n" $name $n $(total opt) $(total techmap) $(total abc) $cells
+		rm -f $json
+	done
+done
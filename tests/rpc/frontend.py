@@ -51,11 +51,15 @@ def map_parameter(parameter):
 	if parameter["type"] == "real":
 		return float(parameter["value"])
 
+rtlil_bin_file = None
+
 def call(input_json):
 	input = json.loads(input_json)
 	if input["method"] == "modules":
 		return json.dumps({"modules": modules()})
 	if input["method"] == "derive":
+		if rtlil_bin_file is not None:
+			return json.dumps({"frontend": "rtlil_bin", "file": rtlil_bin_file})
 		try:
 			frontend, source = derive(input["module"],
 				{name: map_parameter(value) for name, value in input["parameters"].items()})
@@ -64,7 +68,10 @@ def call(input_json):
 			return json.dumps({"error": str(e)})
 
 def main():
+	global rtlil_bin_file
 	parser = argparse.ArgumentParser()
+	parser.add_argument("--rtlil-bin", metavar="FILE",
+		help="answer derive requests with the given binary RTLIL file")
 	modes = parser.add_subparsers(dest="mode")
 	mode_stdio = modes.add_parser("stdio")
 	if os.name == "posix":
@@ -73,6 +80,7 @@ def main():
 		mode_path = modes.add_parser("named-pipe")
 	mode_path.add_argument("path")
 	args = parser.parse_args()
+	rtlil_bin_file = args.rtlil_bin
 
 	if args.mode == "stdio":
 		while True:
@@ -0,0 +1,8 @@
+// The tests of hashlibFlatTest.cc with the scalar matching of the control
+// bytes of flat_dict<> and flat_pool<> instead of SSE2.
+#define HASHLIB_NO_SIMD
+#include "hashlibFlatTest.cc"
+
+#ifdef HASHLIB_SSE2
+#  error "HASHLIB_NO_SIMD did not disable the SSE2 code"
+#endif
@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+
+#include "kernel/yosys.h"
+
+#include <map>
+#include <set>
+
+YOSYS_NAMESPACE_BEGIN
+
+// The tests are also built with HASHLIB_NO_SIMD in hashlibFlatScalarTest.cc,
+// so that they cover the SSE2 and the scalar matching of the control bytes.
+
+namespace {
+	// two probe sequences, the keys below 1000 fill up the groups of one of them
+	struct two_chain_ops {
+		static inline bool cmp(int a, int b) { return a == b; }
+		static inline unsigned int hash(int a) { return a < 1000 ? 0 : 1; }
+	};
+
+	template<typename OPS>
+	void check_equal(const flat_dict<int, int, OPS> &dict, const std::map<int, int> &ref, int max_key)
+	{
+		ASSERT_EQ(dict.size(), ref.size());
+		for (int key = 0; key < max_key; key++) {
+			auto it = ref.find(key);
+			ASSERT_EQ(dict.count(key), it != ref.end() ? 1 : 0) << "key " << key;
+			if (it != ref.end()) {
+				ASSERT_NE(dict.find(key), dict.end());
+				EXPECT_EQ(dict.find(key)->second, it->second);
+				EXPECT_EQ(dict.at(key), it->second);
+			} else {
+				EXPECT_EQ(dict.find(key), dict.end());
+				EXPECT_EQ(dict.at(key, -1), -1);
+			}
+		}
+	}
+}
+
+TEST(KernelHashlibFlatTest, countFindAfterErase)
+{
+	flat_dict<int, int> dict;
+	for (int i = 0; i < 100; i++)
+		dict[i] = 2*i;
+
+	EXPECT_EQ(dict.erase(42), 1);
+	EXPECT_EQ(dict.erase(42), 0);
+	EXPECT_EQ(dict.count(42), 0);
+	EXPECT_EQ(dict.find(42), dict.end());
+	EXPECT_THROW(dict.at(42), std::out_of_range);
+
+	// the last entry was moved to the place of the erased one
+	EXPECT_EQ(dict.count(99), 1);
+	EXPECT_EQ(dict.at(99), 198);
+	EXPECT_EQ(dict.size(), 99u);
+
+	for (int i = 0; i < 100; i++)
+		if (i != 42)
+			EXPECT_EQ(dict.at(i), 2*i);
+
+	flat_pool<std::string> pool = {"a", "b", "c"};
+	EXPECT_EQ(pool.erase("b"), 1);
+	EXPECT_EQ(pool.count("b"), 0);
+	EXPECT_EQ(pool.find("b"), pool.end());
+	EXPECT_EQ(pool.count("a"), 1);
+	EXPECT_EQ(pool.count("c"), 1);
+
+	pool.erase("a");
+	pool.erase("c");
+	EXPECT_TRUE(pool.empty());
+	EXPECT_EQ(pool.count("a"), 0);
+	pool.insert("b");
+	EXPECT_EQ(pool.count("b"), 1);
+}
+
+template<typename OPS>
+void erase_reinsert(int num_keys)
+{
+	flat_dict<int, int, OPS> dict;
+	std::map<int, int> ref;
+	int max_key = 2 * num_keys + 100;
+
+	for (int i = 0; i < num_keys; i++)
+		dict[i] = ref[i] = i;
+	check_equal(dict, ref, max_key);
+
+	int step = num_keys / 20;
+	for (int round = 0; round < 20; round++)
+	{
+		int base = step * round;
+		for (int i = base; i < base + step; i++)
+			EXPECT_EQ(dict.erase(i), int(ref.erase(i)));
+		for (int i = base; i < base + step; i += 2)
+			dict[i] = ref[i] = -i;
+		for (int i = 0; i < step / 2; i++)
+			dict[num_keys + base + i] = ref[num_keys + base + i] = round;
+		check_equal(dict, ref, max_key);
+	}
+
+	// erasing everything and inserting again
+	for (auto &it : ref)
+		EXPECT_EQ(dict.erase(it.first), 1);
+	EXPECT_TRUE(dict.empty());
+	check_equal(dict, std::map<int, int>(), max_key);
+	for (auto &it : ref)
+		dict[it.first] = it.second;
+	check_equal(dict, ref, max_key);
+}
+
+TEST(KernelHashlibFlatTest, eraseReinsert)
+{
+	erase_reinsert<hash_ops<int>>(900);
+	erase_reinsert<two_chain_ops>(200);
+}
+
+TEST(KernelHashlibFlatTest, tombstoneThreshold)
+{
+	flat_dict<int, int, two_chain_ops> dict;
+	std::map<int, int> ref;
+
+	// erasing from the full groups of the first probe sequence leaves deleted
+	// markers, which count towards the rebuild threshold together with the
+	// slots used by the keys of the other probe sequence. the index is
+	// rebuilt with deleted markers left after about 360 of these keys.
+	for (int i = 0; i < 240; i++)
+		dict[i] = ref[i] = i;
+	for (int i = 0; i < 200; i++)
+		EXPECT_EQ(dict.erase(i), int(ref.erase(i)));
+	check_equal(dict, ref, 1500);
+
+	for (int i = 0; i < 400; i++) {
+		dict[1000 + i] = ref[1000 + i] = i;
+		if (i % 20 == 0)
+			check_equal(dict, ref, 1500);
+	}
+	check_equal(dict, ref, 1500);
+
+	for (int i = 0; i < 200; i++)
+		dict[i] = ref[i] = -i;
+	check_equal(dict, ref, 1500);
+}
+
+TEST(KernelHashlibFlatTest, randomOperations)
+{
+	flat_pool<int> pool;
+	std::set<int> ref;
+
+	uint32_t seed = 1;
+	for (int i = 0; i < 20000; i++) {
+		seed = seed * 1103515245 + 12345;
+		int key = (seed >> 8) % 512;
+		if ((seed >> 4) & 1) {
+			EXPECT_EQ(pool.insert(key).second, ref.insert(key).second);
+		} else {
+			EXPECT_EQ(pool.erase(key), int(ref.erase(key)));
+		}
+		if (i % 1000 == 0) {
+			ASSERT_EQ(pool.size(), ref.size());
+			for (int k = 0; k < 512; k++)
+				ASSERT_EQ(pool.count(k), int(ref.count(k))) << "key " << k;
+		}
+	}
+
+	std::set<int> values(pool.begin(), pool.end());
+	EXPECT_EQ(values, ref);
+}
+
+TEST(KernelHashlibFlatTest, rehashWhileIterating)
+{
+	flat_dict<int, int> dict;
+	for (int i = 0; i < 20; i++)
+		dict[i] = i;
+
+	// iterators are positions in the entries, so they stay valid when
+	// inserting rebuilds the index, and the new entries are not visited
+	std::set<int> visited;
+	for (auto it = dict.begin(); it != dict.end(); ++it) {
+		EXPECT_TRUE(visited.insert(it->first).second);
+		for (int i = 0; i < 10; i++)
+			dict[1000 + 10*it->first + i] = it->first;
+	}
+	EXPECT_EQ(GetSize(visited), 20);
+	EXPECT_EQ(dict.size(), 220u);
+	for (int i = 0; i < 20; i++)
+		for (int j = 0; j < 10; j++)
+			EXPECT_EQ(dict.at(1000 + 10*i + j), i);
+
+	// erasing while iterating visits every entry once
+	visited.clear();
+	for (auto it = dict.begin(); it != dict.end();) {
+		EXPECT_TRUE(visited.insert(it->first).second);
+		if (it->first % 3 == 0)
+			it = dict.erase(it);
+		else
+			++it;
+	}
+	EXPECT_EQ(GetSize(visited), 220);
+	for (int key : visited)
+		EXPECT_EQ(dict.count(key), key % 3 == 0 ? 0 : 1);
+
+	// sort() rebuilds the index
+	flat_pool<int> pool;
+	for (int i = 99; i >= 0; i--)
+		pool.insert(i);
+	pool.sort();
+	int expected = 0;
+	for (int value : pool)
+		EXPECT_EQ(value, expected++);
+	for (int i = 0; i < 100; i++)
+		EXPECT_EQ(pool.count(i), 1);
+}
+
+YOSYS_NAMESPACE_END
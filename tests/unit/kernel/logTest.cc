@@ -11,4 +11,21 @@ TEST(KernelLogTest, logvValidValues)
 	EXPECT_EQ(7, 7);
 }
 
+TEST(KernelLogTest, logIdKeepsName)
+{
+	const char *p;
+	{
+		RTLIL::IdString id("\\log_id_test_name");
+		p = log_id(id);
+	}
+	EXPECT_STREQ(p, "log_id_test_name");
+	EXPECT_STREQ(log_id(RTLIL::IdString("$auto$x")), "$auto$x");
+
+	// the cache is a ring, the most recent results stay valid
+	const char *q = nullptr;
+	for (int i = 0; i < 5000; i++)
+		q = log_id(RTLIL::IdString(stringf("\\log_id_ring_%d", i)));
+	EXPECT_STREQ(q, "log_id_ring_4999");
+}
+
 YOSYS_NAMESPACE_END
@@ -11,4 +11,39 @@ TEST(KernelRtlilTest, getReferenceValid)
 	EXPECT_EQ(33, 33);
 }
 
+TEST(KernelRtlilTest, sigSpecPatternOps)
+{
+	RTLIL::Module module;
+	RTLIL::Wire *a = module.addWire("\\a", 8);
+	RTLIL::Wire *b = module.addWire("\\b", 8);
+	RTLIL::Wire *c = module.addWire("\\c", 8);
+
+	RTLIL::SigSpec sig({RTLIL::SigSpec(b), RTLIL::SigSpec(a)});
+
+	RTLIL::SigSpec replaced = sig;
+	dict<RTLIL::SigBit, RTLIL::SigBit> rules;
+	rules[RTLIL::SigBit(a, 2)] = RTLIL::SigBit(c, 0);
+	replaced.replace(rules);
+	EXPECT_EQ(replaced, RTLIL::SigSpec({RTLIL::SigSpec(b), RTLIL::SigSpec(a, 3, 5), RTLIL::SigSpec(c, 0), RTLIL::SigSpec(a, 0, 2)}));
+
+	RTLIL::SigSpec unchanged = sig;
+	unchanged.replace(RTLIL::SigSpec(c, 0, 4), RTLIL::SigSpec(a, 0, 4));
+	EXPECT_EQ(unchanged, sig);
+
+	RTLIL::SigSpec removed = sig;
+	removed.remove(RTLIL::SigSpec(a, 2, 4));
+	EXPECT_EQ(removed, RTLIL::SigSpec({RTLIL::SigSpec(b), RTLIL::SigSpec(a, 6, 2), RTLIL::SigSpec(a, 0, 2)}));
+
+	pool<RTLIL::SigBit> bits = {RTLIL::SigBit(b, 0), RTLIL::SigBit(b, 7)};
+	RTLIL::SigSpec other = RTLIL::SigSpec(c).repeat(2);
+	RTLIL::SigSpec removed2 = sig;
+	removed2.remove2(bits, &other);
+	EXPECT_EQ(removed2, RTLIL::SigSpec({RTLIL::SigSpec(b, 1, 6), RTLIL::SigSpec(a)}));
+	EXPECT_EQ(other, RTLIL::SigSpec({RTLIL::SigSpec(c, 1, 6), RTLIL::SigSpec(c)}));
+
+	EXPECT_EQ(sig.extract(RTLIL::SigSpec({RTLIL::SigSpec(a, 6, 2), RTLIL::SigSpec(b, 0, 2)})),
+			RTLIL::SigSpec({RTLIL::SigSpec(a, 6, 2), RTLIL::SigSpec(b, 0, 2)}));
+	EXPECT_EQ(sig.extract(bits), RTLIL::SigSpec({RTLIL::SigSpec(b, 7), RTLIL::SigSpec(b, 0)}));
+}
+
 YOSYS_NAMESPACE_END
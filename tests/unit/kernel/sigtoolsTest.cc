@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+
+#include "kernel/yosys.h"
+#include "kernel/sigtools.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+TEST(KernelSigtoolsTest, indexedSigPool)
+{
+	RTLIL::Module module;
+	RTLIL::Wire *a = module.addWire("\\a", 4);
+	RTLIL::Wire *b = module.addWire("\\b", 4);
+
+	SigBitIndex index(&module);
+	IndexedSigPool pool(index);
+
+	pool.add(RTLIL::SigSpec({RTLIL::SigSpec(RTLIL::State::S1), RTLIL::SigSpec(a, 1, 2)}));
+	EXPECT_EQ(pool.size(), 2u);
+	EXPECT_TRUE(pool.check(RTLIL::SigBit(a, 2)));
+	EXPECT_FALSE(pool.check(RTLIL::SigBit(a, 3)));
+	EXPECT_TRUE(pool.check_any(a));
+	EXPECT_FALSE(pool.check_all(a));
+	EXPECT_TRUE(pool.check_all(RTLIL::SigSpec(a, 1, 2)));
+	EXPECT_EQ(pool.extract(a), RTLIL::SigSpec(a, 1, 2));
+
+	pool.expand(a, b);
+	EXPECT_EQ(pool.extract(b), RTLIL::SigSpec(b, 1, 2));
+
+	// wires added after the index was set up get a new range
+	RTLIL::Wire *c = module.addWire("\\c", 3);
+	pool.add(RTLIL::SigSpec(c, 2));
+	EXPECT_TRUE(pool.check(RTLIL::SigBit(c, 2)));
+	EXPECT_FALSE(pool.check(RTLIL::SigBit(b, 3)));
+
+	pool.del(a);
+	EXPECT_EQ(pool.size(), 3u);
+	EXPECT_EQ(pool.export_all(), RTLIL::SigSpec({RTLIL::SigSpec(c, 2), RTLIL::SigSpec(b, 1, 2)}));
+}
+
+TEST(KernelSigtoolsTest, indexedSigSet)
+{
+	RTLIL::Module module;
+	RTLIL::Wire *a = module.addWire("\\a", 4);
+
+	SigBitIndex index(&module);
+	IndexedSigSet<int> set(index);
+
+	set.insert(RTLIL::SigSpec(a, 0, 2), 1);
+	set.insert(RTLIL::SigSpec(a, 1, 2), 2);
+	set.insert(RTLIL::SigSpec(a, 1, 1), 2);
+	EXPECT_EQ(set.find(RTLIL::SigSpec(a, 1)), std::set<int>({1, 2}));
+	EXPECT_EQ(set.find(RTLIL::SigSpec(a, 2)), std::set<int>({2}));
+	EXPECT_FALSE(set.has(RTLIL::SigSpec(a, 3)));
+
+	set.erase(RTLIL::SigSpec(a, 1), 1);
+	EXPECT_EQ(set.find(RTLIL::SigSpec(a, 0, 2)), std::set<int>({1, 2}));
+	set.erase(a);
+	EXPECT_FALSE(set.has(a));
+}
+
+YOSYS_NAMESPACE_END
@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+
+#include "kernel/yosys.h"
+#include "kernel/truthtable.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+namespace {
+	// reference implementation of TruthTable::compose() with one table
+	// lookup per input assignment
+	TruthTable compose_ref(const TruthTable &f, const std::vector<TruthTable> &inputs, int num_vars)
+	{
+		TruthTable tt(num_vars);
+		for (int i = 0; i < tt.size(); i++) {
+			int index = 0;
+			for (int j = 0; j < GetSize(inputs); j++)
+				index |= inputs[j].get(i) << j;
+			tt.set(i, f.get(index));
+		}
+		return tt;
+	}
+
+	TruthTable random_table(int num_vars, uint32_t &seed)
+	{
+		TruthTable tt(num_vars);
+		for (int i = 0; i < tt.size(); i++) {
+			seed = seed * 1103515245 + 12345;
+			tt.set(i, (seed >> 16) & 1);
+		}
+		return tt;
+	}
+}
+
+TEST(KernelTruthTableTest, constAndVars)
+{
+	TruthTable and2(RTLIL::Const::from_string("1000"), 2);
+	EXPECT_EQ(and2, TruthTable::var(2, 0) & TruthTable::var(2, 1));
+	EXPECT_EQ(and2.as_const(), RTLIL::Const::from_string("1000"));
+	EXPECT_TRUE((and2 | ~and2).is_const(true));
+	EXPECT_TRUE((and2 ^ and2).is_const(false));
+
+	for (int num_vars : {3, 6, 8})
+		for (int var = 0; var < num_vars; var++) {
+			TruthTable tt = TruthTable::var(num_vars, var);
+			for (int i = 0; i < tt.size(); i++)
+				EXPECT_EQ(tt.get(i), bool((i >> var) & 1));
+			for (int other = 0; other < num_vars; other++)
+				EXPECT_EQ(tt.depends_on(other), other == var);
+		}
+}
+
+TEST(KernelTruthTableTest, cofactor)
+{
+	uint32_t seed = 1;
+	for (int num_vars : {1, 4, 6, 7, 9}) {
+		TruthTable f = random_table(num_vars, seed);
+		for (int var = 0; var < num_vars; var++)
+			for (bool value : {false, true}) {
+				TruthTable c = f.cofactor(var, value);
+				ASSERT_EQ(c.num_vars, num_vars - 1);
+				for (int i = 0; i < c.size(); i++) {
+					int lo = i & ((1 << var) - 1);
+					int index = ((i - lo) << 1) | (value << var) | lo;
+					EXPECT_EQ(c.get(i), f.get(index));
+				}
+			}
+	}
+}
+
+TEST(KernelTruthTableTest, compose)
+{
+	uint32_t seed = 2;
+	for (int num_vars : {2, 5, 7}) {
+		TruthTable f = random_table(num_vars, seed);
+		for (int n : {3, 6, 8}) {
+			std::vector<TruthTable> inputs;
+			for (int j = 0; j < num_vars; j++)
+				inputs.push_back(j % 3 == 2 ? random_table(n, seed) : TruthTable::var(n, (j * 5) % n));
+			EXPECT_EQ(f.compose(inputs), compose_ref(f, inputs, n));
+		}
+	}
+}
+
+YOSYS_NAMESPACE_END
@@ -0,0 +1,25 @@
+#!/bin/bash
+
+trap 'echo "ERROR in bugpoint_jobs.sh" >&2; exit 1' ERR
+
+cat > bugpoint_jobs.v << "EOT"
+module top(input [7:0] a, b, output [7:0] x, y, z);
+	assign x = a & b;
+	assign y = a | b;
+	assign z = (a + b) ^ (a - b);
+endmodule
+EOT
+
+# the "crash" is any $_XOR_ cell left in the design
+echo 'select -assert-none t:$_XOR_' > bugpoint_jobs.ys
+
+for j in 1 4; do
+	../../yosys -q -p 'read_verilog bugpoint_jobs.v; synth -run coarse; techmap; opt_clean' \
+			-p 'bugpoint -yosys ../../yosys -script bugpoint_jobs.ys -cells -j '$j \
+			-p 'select -assert-count 1 t:*; select -assert-count 1 t:$_XOR_; write_ilang bugpoint_jobs_'$j'.il'
+done
+
+cmp bugpoint_jobs_1.il bugpoint_jobs_4.il
+test $(ls -d bugpoint_[A-Za-z0-9]*/ 2>/dev/null | wc -l) -eq 0
+
+rm -f bugpoint_jobs.v bugpoint_jobs.ys bugpoint_jobs_[14].il bugpoint-case.il bugpoint-case.log
@@ -0,0 +1,32 @@
+#!/bin/bash
+
+trap 'echo "ERROR in check.sh" >&2; exit 1' ERR
+
+cat > check.v << "EOT"
+module loop(input a, output y);
+	wire w;
+	assign w = a & y;
+	assign y = w | a;
+endmodule
+module conflict(input a, b, output y);
+	assign y = a;
+	assign y = b;
+endmodule
+module undriven(input a, output y);
+	wire u;
+	assign y = a ^ u;
+endmodule
+EOT
+
+for j in 1 4; do
+	../../yosys -j $j -p 'read_verilog check.v; proc; opt_clean; check' -l check_$j.log > /dev/null
+	grep -q 'found and reported 3 problems' check_$j.log
+	grep -q 'found logic loop in module loop' check_$j.log
+	grep -q 'multiple conflicting drivers for conflict' check_$j.log
+	grep -q 'Wire undriven.u is used but has no driver' check_$j.log
+	grep -v '^End of script\|^Time spent\|^CPU:\|^Yosys ' check_$j.log > check_$j.txt
+done
+
+cmp check_1.txt check_4.txt
+
+rm -f check.v check_[14].log check_[14].txt
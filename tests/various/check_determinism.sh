@@ -0,0 +1,30 @@
+#!/bin/bash
+
+trap 'echo "ERROR in check_determinism.sh" >&2; exit 1' ERR
+
+cat > check_determinism.v << "EOT"
+module sub #(parameter W = 8) (input clk, input [W-1:0] a, b, output reg [W-1:0] x, y);
+	always @(posedge clk) begin
+		x <= a ^ b;
+		y <= a ^ b;
+	end
+endmodule
+
+module top(input clk, input [15:0] a, b, output [7:0] x1, y1, output [15:0] x2, y2);
+	sub #(8) s1(.clk(clk), .a(a[7:0]), .b(b[7:0]), .x(x1), .y(y1));
+	sub #(16) s2(.clk(clk), .a(a), .b(b), .x(x2), .y(y2));
+endmodule
+EOT
+
+../../yosys -p 'read_verilog check_determinism.v; hierarchy -top top; proc' \
+		-p 'check_determinism -j 4 opt_merge; check_determinism -runs 2 -seed 3 opt_reduce' \
+		-p 'check_determinism simplemap; check_determinism -runs 2 aigmap' \
+		-p 'tee -o check_determinism_1.il dump' > check_determinism.log
+test $(grep -c "match the run with 1 thread" check_determinism.log) = 4
+
+# the design is left as if the command had been run once
+../../yosys -q -p 'read_verilog check_determinism.v; hierarchy -top top; proc' \
+		-p 'opt_merge; opt_reduce; simplemap; aigmap; tee -q -o check_determinism_2.il dump'
+cmp check_determinism_1.il check_determinism_2.il
+
+rm check_determinism.v check_determinism.log check_determinism_[12].il
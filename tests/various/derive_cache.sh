@@ -0,0 +1,28 @@
+#!/bin/bash
+
+trap 'echo "ERROR in derive_cache.sh" >&2; exit 1' ERR
+
+cat > derive_cache.v << "EOT"
+module sub #(parameter W = 8) (input [W-1:0] a, output [W-1:0] y);
+	assign y = a + W;
+endmodule
+
+module top(input [3:0] a, input [7:0] b, output [3:0] x, output [7:0] y);
+	sub #(.W(4)) s1(.a(a), .y(x));
+	sub #(.W(8)) s2(.a(b), .y(y));
+endmodule
+EOT
+
+rm -rf derive_cache.d
+mkdir derive_cache.d
+
+for i in 1 2; do
+	../../yosys -ql derive_cache_$i.log -p 'read_verilog -derive_cache derive_cache.d derive_cache.v' \
+			-p 'hierarchy -top top; proc; write_ilang derive_cache_'$i'.il'
+done
+
+! grep -q "from derive cache file" derive_cache_1.log
+test $(grep -c "from derive cache file" derive_cache_2.log) -eq 2
+cmp derive_cache_1.il derive_cache_2.il
+
+rm -rf derive_cache.v derive_cache.d derive_cache_1.log derive_cache_2.log derive_cache_1.il derive_cache_2.il
@@ -0,0 +1,15 @@
+#!/bin/bash
+
+trap 'echo "ERROR in dfflibmap_filter.sh" >&2; exit 1' ERR
+
+# dfflibmap only parses the groups it needs; the result must be the same as
+# with the complete library that read_liberty put into the session cache
+../../yosys -q -p "read_verilog ../liberty/small.v; synth -top small; design -save synth" \
+	-p "dfflibmap -liberty ../liberty/normal.lib; write_ilang dfflibmap_filter_1.il" \
+	-p "design -load synth; read_liberty -lib ../liberty/normal.lib; dfflibmap -liberty ../liberty/normal.lib; delete =A:blackbox; write_ilang dfflibmap_filter_2.il"
+
+sed -i '/^# Generated by/d' dfflibmap_filter_1.il dfflibmap_filter_2.il
+cmp dfflibmap_filter_1.il dfflibmap_filter_2.il
+grep -q "cell \\\\dff " dfflibmap_filter_1.il
+
+rm dfflibmap_filter_1.il dfflibmap_filter_2.il
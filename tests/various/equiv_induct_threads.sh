@@ -0,0 +1,38 @@
+#!/bin/bash
+
+trap 'echo "ERROR in equiv_induct_threads.sh" >&2; exit 1' ERR
+
+cat > equiv_induct_threads.v << "EOT"
+module gold(input clk, a, output reg [3:0] cnt, output reg [3:0] acc, output y);
+	always @(posedge clk) begin
+		cnt <= cnt + 1;
+		acc <= acc ^ {4{a}};
+	end
+	assign y = a & cnt[0];
+endmodule
+
+module gate(input clk, a, output reg [3:0] cnt, output reg [3:0] acc, output y);
+	always @(posedge clk) begin
+		cnt <= cnt - 4'b1111;
+		acc <= a ? ~acc : acc;
+	end
+	assign y = a | cnt[0];
+endmodule
+EOT
+
+# y can diverge at any time, acc does not share any cells with it and is
+# proven in a group of its own
+for j in 1 4; do
+	../../yosys -q -p 'read_verilog equiv_induct_threads.v; proc; opt_clean; techmap; opt_clean' \
+			-p 'equiv_make gold gate equiv; hierarchy -top equiv' \
+			-p 'tee -q -o equiv_induct_threads_j'$j'.out equiv_induct -seq 2 -j '$j \
+			-p 'equiv_remove; select -assert-count 1 t:$equiv; write_ilang equiv_induct_threads_j'$j'.il'
+done
+
+cmp equiv_induct_threads_j1.out equiv_induct_threads_j4.out
+cmp equiv_induct_threads_j1.il equiv_induct_threads_j4.il
+
+../../yosys -q -p 'read_verilog equiv_induct_threads.v; hierarchy -top gold; proc' \
+		-p 'equiv_opt -assert -j 2 opt -full'
+
+rm equiv_induct_threads.v equiv_induct_threads_j1.il equiv_induct_threads_j4.il
@@ -0,0 +1,31 @@
+#!/bin/bash
+
+trap 'echo "ERROR in equiv_simple_threads.sh" >&2; exit 1' ERR
+
+cat > equiv_simple_threads.v << "EOT"
+module gold(input clk, input [7:0] a, b, output [7:0] x, y, output reg [7:0] z);
+	assign x = a + b;
+	assign y = a & ~b;
+	always @(posedge clk)
+		z <= x ^ y;
+endmodule
+
+module gate(input clk, input [7:0] a, b, output [7:0] x, y, output reg [7:0] z);
+	assign x = b + a;
+	assign y = ~(~a | b);
+	always @(posedge clk)
+		z <= (b + a) ^ (a & ~b);
+endmodule
+EOT
+
+for j in 1 4; do
+	../../yosys -q -p 'read_verilog equiv_simple_threads.v; proc; opt_clean; techmap; opt -fast' \
+			-p 'equiv_make gold gate equiv; hierarchy -top equiv' \
+			-p 'tee -q -o equiv_simple_threads_j'$j'.out equiv_simple -seq 2 -j '$j \
+			-p 'equiv_status -assert; write_ilang equiv_simple_threads_j'$j'.il'
+done
+
+cmp equiv_simple_threads_j1.out equiv_simple_threads_j4.out
+cmp equiv_simple_threads_j1.il equiv_simple_threads_j4.il
+
+rm equiv_simple_threads.v equiv_simple_threads_j[14].il equiv_simple_threads_j[14].out
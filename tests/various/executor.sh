@@ -0,0 +1,22 @@
+#!/bin/bash
+
+trap 'echo "ERROR in executor.sh" >&2; exit 1' ERR
+
+cat > executor.v << "EOT"
+module top(input [7:0] a, b, c, output [7:0] x, y);
+	assign x = a * b;
+	assign y = b + c;
+endmodule
+EOT
+
+# the launcher records the working directories and runs the tools locally
+rm -f executor_dirs.txt executor_staged.txt
+../../yosys -ql executor.log -p 'read_verilog executor.v; synth -run coarse; techmap' \
+		-p 'executor -stage-in "echo %d >> executor_staged.txt" -launcher "cd %p && echo %d >> executor_dirs.txt && sh -c %c"' \
+		-p 'abc -partition 2; executor -local'
+
+test $(wc -l < executor_dirs.txt) -ge 2
+cmp <(sort executor_dirs.txt) <(sort executor_staged.txt)
+grep -q "yosys-abc-" executor_dirs.txt
+
+rm -f executor.v executor.log executor_dirs.txt executor_staged.txt
@@ -0,0 +1,34 @@
+#!/bin/bash
+
+trap 'echo "ERROR in extract_threads.sh" >&2; exit 1' ERR
+
+cat > extract_threads.v << "EOT"
+module top(input [7:0] a, b, c, d, e, f, output [7:0] x, y, z, w);
+	assign x = a * b + c;
+	assign y = c * d + e;
+	assign z = (a * f + b) * (d * e + f);
+	assign w = x * y + z;
+endmodule
+EOT
+
+cat > extract_threads_map.v << "EOT"
+module macc(input [7:0] a, b, c, output [7:0] y);
+	assign y = a * b + c;
+endmodule
+EOT
+
+# the subtrees of the search are explored concurrently, but the matches and
+# the mined subcircuits must be the same as with a single thread
+for j in 1 4; do
+	../../yosys -q -p 'read_verilog extract_threads.v; proc; opt_clean' \
+			-p 'extract -map extract_threads_map.v -j '$j'; write_ilang extract_threads_j'$j'.il'
+	../../yosys -q -p 'read_verilog extract_threads.v; proc; opt_clean' \
+			-p 'extract -mine extract_threads_mine_j'$j'.il -mine_cells_span 2 3 -mine_min_freq 2 -j '$j
+done
+
+cmp extract_threads_j1.il extract_threads_j4.il
+cmp extract_threads_mine_j1.il extract_threads_mine_j4.il
+grep -q 'cell \\macc' extract_threads_j1.il
+
+rm extract_threads.v extract_threads_map.v extract_threads_j1.il extract_threads_j4.il
+rm extract_threads_mine_j1.il extract_threads_mine_j4.il
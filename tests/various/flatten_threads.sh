@@ -0,0 +1,19 @@
+#!/bin/bash
+
+trap 'echo "ERROR in flatten_threads.sh" >&2; exit 1' ERR
+
+# bottom-up flattening gives the same design with and without threads
+for j in 1 4; do
+	../../yosys -q -j $j -p "gen_design -seed 3 -cells 50 -depth 3 -fanout 3; hierarchy -top top; flatten;
+			select -assert-count 0 t:top_l*; select -assert-count 1 w:u2.u1.u0.out0;
+			write_ilang flatten_threads_$j.il"
+done
+cmp flatten_threads_1.il flatten_threads_4.il
+
+# instances of kept modules stay, and the kept modules are
+# flattened themselves
+../../yosys -q -j 4 -p "gen_design -seed 3 -cells 50 -depth 2 -fanout 2; hierarchy -top top;
+		setattr -mod -set keep_hierarchy 1 top_l1; flatten;
+		select -assert-count 2 t:top_l1; select -assert-count 0 top_l1/t:top_l2"
+
+rm -f flatten_threads_1.il flatten_threads_4.il
@@ -0,0 +1,22 @@
+#!/bin/bash
+
+trap 'echo "ERROR in flowmap_threads.sh" >&2; exit 1' ERR
+
+cat > flowmap_threads.v << "EOT"
+module top(input [7:0] a, b, input [2:0] s, output [7:0] y, output z);
+	wire [7:0] t = s[0] ? a + b : a ^ b;
+	assign y = s[1] ? t - a : t & {8{s[2]}};
+	assign z = ^y | &t;
+endmodule
+EOT
+
+# the nodes of each level are labeled concurrently, but the result must be
+# the same as with a single thread
+for j in 1 4; do
+	../../yosys -q -p 'read_verilog flowmap_threads.v; synth -run coarse; techmap; opt -fast' \
+			-p 'flowmap -maxlut 4 -j '$j'; write_ilang flowmap_threads_j'$j'.il'
+done
+
+cmp flowmap_threads_j1.il flowmap_threads_j4.il
+
+rm flowmap_threads.v flowmap_threads_j1.il flowmap_threads_j4.il
@@ -0,0 +1,42 @@
+#!/bin/bash
+
+trap 'echo "ERROR in fsm_extract_threads.sh" >&2; exit 1' ERR
+
+cat > fsm_extract_threads.v << "EOT"
+module top(input clk, rst, input [9:0] c, output reg [2:0] y);
+	reg [2:0] state;
+	always @(posedge clk)
+		if (rst)
+			state <= 0;
+		else
+			case (state)
+				0: state <= c[0] ? 1 : c[1] ? 2 : 0;
+				1: state <= c[2] && c[3] ? 3 : c[4] ? 4 : 1;
+				2: state <= c[5] ? 5 : c[2] || c[6] ? 0 : 2;
+				3: state <= c[7] ? 6 : 3;
+				4: state <= c[8] && !c[9] ? 0 : 4;
+				5: state <= c[9] ? 1 : 6;
+				6: state <= 0;
+			endcase
+	always @*
+		y = state == 3 ? 1 : state == 5 ? 2 : 0;
+endmodule
+EOT
+
+# the transitions of the states are found concurrently, but the result and
+# the log must be the same as with a single thread
+for j in 1 4; do
+	../../yosys -j $j -p 'read_verilog fsm_extract_threads.v; proc; opt; fsm_detect' \
+			-p 'tee -o fsm_extract_threads_j'$j'.log fsm_extract' \
+			-p 'select -assert-count 1 t:$fsm' -p 'write_ilang fsm_extract_threads_j'$j'.il' > /dev/null
+done
+
+cmp fsm_extract_threads_j1.log fsm_extract_threads_j4.log
+cmp fsm_extract_threads_j1.il fsm_extract_threads_j4.il
+
+# SAT is used for FSMs with many control inputs, the FSM is extracted
+# with and without it
+../../yosys -q -p 'read_verilog fsm_extract_threads.v; proc; opt; fsm_detect; fsm_extract -sat 0; select -assert-count 1 t:$fsm'
+../../yosys -q -p 'read_verilog fsm_extract_threads.v; proc; opt; fsm_detect; fsm_extract -nosat; select -assert-count 1 t:$fsm'
+
+rm fsm_extract_threads.v fsm_extract_threads_j1.log fsm_extract_threads_j4.log fsm_extract_threads_j1.il fsm_extract_threads_j4.il
@@ -0,0 +1,16 @@
+#!/bin/bash
+
+trap 'echo "ERROR in gen_design.sh" >&2; exit 1' ERR
+
+# the same seed gives the same design, another seed a different one
+../../yosys -q -p "gen_design -seed 5 -cells 200 -depth 2 -mem 1 -memabits 4; write_ilang gen_design_a.il"
+../../yosys -q -p "gen_design -seed 5 -cells 200 -depth 2 -mem 1 -memabits 4; write_ilang gen_design_b.il"
+../../yosys -q -p "gen_design -seed 6 -cells 200 -depth 2 -mem 1 -memabits 4; write_ilang gen_design_c.il"
+cmp gen_design_a.il gen_design_b.il
+if cmp -s gen_design_a.il gen_design_c.il; then false; fi
+
+# the generated hierarchy is valid and can be synthesized
+../../yosys -q -p "gen_design -seed 5 -cells 200 -depth 2 -mem 1 -memabits 4; hierarchy -check; check -assert; synth -flatten; select -assert-count 0 t:\$memrd"
+../../yosys -q -p "read_ilang gen_design_a.il; hierarchy -check -top top; select -assert-count 2 top_l1/t:top_l2"
+
+rm -f gen_design_a.il gen_design_b.il gen_design_c.il
@@ -0,0 +1,43 @@
+#!/bin/bash
+
+trap 'echo "ERROR in hierarchy_libdir.sh" >&2; exit 1' ERR
+
+rm -rf hierarchy_libdir hierarchy_libdir_cache
+mkdir -p hierarchy_libdir hierarchy_libdir_cache
+
+cat > hierarchy_libdir/inv.v << "EOT2"
+module inv(input a, output y);
+	assign y = ~a;
+endmodule
+EOT2
+
+# cells.v does not match the names of the modules it declares
+cat > hierarchy_libdir/cells.v << "EOT2"
+// module fake_and(input a, b, output y);
+module and2(input a, b, output y);
+	assign y = a & b;
+endmodule
+module or2(input a, b, output y);
+	assign y = a | b;
+endmodule
+EOT2
+
+cat > hierarchy_libdir_top.v << "EOT2"
+module top(input a, b, output y, z);
+	wire t;
+	inv i0 (.a(a), .y(t));
+	and2 i1 (.a(t), .b(b), .y(y));
+	or2 i2 (.a(a), .b(b), .y(z));
+endmodule
+EOT2
+
+for i in 1 2; do
+	../../yosys -q -l hierarchy_libdir.log -p 'read_verilog hierarchy_libdir_top.v' \
+			-p 'hierarchy -check -top top -libdir hierarchy_libdir -libdir_cache hierarchy_libdir_cache' \
+			-p 'select -assert-count 3 t:inv t:and2 t:or2'
+	test $(ls hierarchy_libdir_cache | wc -l) -eq 1
+done
+# the second run uses the cached index
+if grep -q 'Indexed\|Scanned' hierarchy_libdir.log; then false; fi
+
+rm -rf hierarchy_libdir hierarchy_libdir_cache hierarchy_libdir_top.v hierarchy_libdir.log
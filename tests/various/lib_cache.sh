@@ -0,0 +1,36 @@
+#!/bin/bash
+
+trap 'echo "ERROR in lib_cache.sh" >&2; exit 1' ERR
+
+cat > lib_cache.v << "EOT"
+`define W 4
+(* keep *)
+module lib_and(input [`W-1:0] a, b, output [`W-1:0] y);
+	assign y = a & b;
+endmodule
+
+module lib_buf #(parameter WIDTH = 1) (input [WIDTH-1:0] a, output [WIDTH-1:0] y);
+	assign y = a;
+endmodule
+EOT
+
+rm -rf lib_cache.d
+mkdir lib_cache.d
+
+for i in 1 2; do
+	../../yosys -ql lib_cache_$i.log -p 'read_verilog -lib -lib_cache lib_cache.d lib_cache.v; write_ilang lib_cache_'$i'.il'
+done
+
+! grep -q "from library cache file" lib_cache_1.log
+grep -q "Loaded 2 modules from library cache file" lib_cache_2.log
+cmp lib_cache_1.il lib_cache_2.il
+
+# different frontend options miss the cache
+../../yosys -ql lib_cache_3.log -p 'read_verilog -lib -lib_cache lib_cache.d -DFOO lib_cache.v'
+! grep -q "from library cache file" lib_cache_3.log
+
+# modules that are already defined are not loaded from the cache
+../../yosys -ql lib_cache_4.log -p 'read_verilog -lib lib_cache.v; read_verilog -lib -overwrite -lib_cache lib_cache.d lib_cache.v'
+! grep -q "from library cache file" lib_cache_4.log
+
+rm -rf lib_cache.v lib_cache.d lib_cache_[1-4].log lib_cache_[12].il
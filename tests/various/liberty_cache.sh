@@ -0,0 +1,17 @@
+#!/bin/bash
+
+trap 'echo "ERROR in liberty_cache.sh" >&2; exit 1' ERR
+
+rm -rf liberty_cache.dir
+
+# the first run compiles the library, the second one loads it from the cache directory
+../../yosys -q -p "liberty_cache -dir liberty_cache.dir; read_liberty -lib ../liberty/normal.lib; write_ilang liberty_cache_1.il" \
+	-p "design -reset; read_liberty -lib ../liberty/normal.lib; write_ilang liberty_cache_2.il"
+test $(ls liberty_cache.dir/*.ylib | wc -l) = 1
+../../yosys -p "liberty_cache -dir liberty_cache.dir; read_liberty -lib ../liberty/normal.lib; write_ilang liberty_cache_3.il" | grep -q "Loaded compiled liberty file"
+
+sed -i '/^# Generated by/d' liberty_cache_1.il liberty_cache_2.il liberty_cache_3.il
+cmp liberty_cache_1.il liberty_cache_2.il
+cmp liberty_cache_1.il liberty_cache_3.il
+
+rm -rf liberty_cache.dir liberty_cache_1.il liberty_cache_2.il liberty_cache_3.il
@@ -0,0 +1,15 @@
+#!/bin/bash
+
+trap 'echo "ERROR in log_async.sh" >&2; exit 1' ERR
+
+# the log written from the background thread must be the same as without it
+script='read_verilog ../simple/fiedler-cooley.v; synth -run coarse; tee -q -o log_async_tee.txt stat; opt_clean -verbose'
+../../yosys -Q -T -p "$script" -l log_async_sync.txt > /dev/null
+cp log_async_tee.txt log_async_tee_sync.txt
+../../yosys -Q -T -a -p "$script" -l log_async_async.txt > log_async_stdout.txt
+
+cmp log_async_sync.txt log_async_async.txt
+cmp log_async_sync.txt log_async_stdout.txt
+cmp log_async_tee_sync.txt log_async_tee.txt
+
+rm log_async_sync.txt log_async_async.txt log_async_stdout.txt log_async_tee.txt log_async_tee_sync.txt
@@ -0,0 +1,52 @@
+#!/bin/bash
+
+trap 'echo "ERROR in memory_bram_shapes.sh" >&2; exit 1' ERR
+
+cat > memory_bram_shapes.v << "EOT"
+module ram(input clk, we, input [3:0] wa, ra, input [7:0] d, output reg [7:0] q);
+	reg [7:0] mem [0:15];
+	always @(posedge clk) begin
+		if (we) mem[wa] <= d;
+		q <= mem[ra];
+	end
+endmodule
+
+module top(input clk, we, input [3:0] wa, ra, input [7:0] d, output [7:0] q1, q2, q3);
+	ram r1(.clk(clk), .we(we), .wa(wa), .ra(ra), .d(d), .q(q1));
+	ram r2(.clk(clk), .we(!we), .wa(ra), .ra(wa), .d(d), .q(q2));
+	ram r3(.clk(clk), .we(we), .wa(wa), .ra(ra), .d(~d), .q(q3));
+endmodule
+EOT
+
+cat > memory_bram_shapes.txt << "EOT"
+bram RAM16X8
+  init 0
+  abits 4
+  dbits 8
+  groups 2
+  ports  1 1
+  wrmode 1 0
+  enable 1 0
+  transp 0 0
+  clocks 1 1
+  clkpol 1 1
+endbram
+
+match RAM16X8
+endmatch
+EOT
+
+# the rules are only tried on the first of the three memories, the result
+# and the log are the same with and without threads
+for j in 1 4; do
+	../../yosys -j $j -p 'read_verilog memory_bram_shapes.v; hierarchy -top top; flatten; proc; opt; memory -nomap' \
+			-p 'tee -o memory_bram_shapes_j'$j'.log memory_bram -rules memory_bram_shapes.txt' \
+			-p 'select -assert-count 3 t:RAM16X8; select -assert-none t:$mem' \
+			-p 'write_ilang memory_bram_shapes_j'$j'.il' > /dev/null
+done
+
+test $(grep -c "reusing its rule selection" memory_bram_shapes_j1.log) = 2
+cmp memory_bram_shapes_j1.log memory_bram_shapes_j4.log
+cmp memory_bram_shapes_j1.il memory_bram_shapes_j4.il
+
+rm memory_bram_shapes.v memory_bram_shapes.txt memory_bram_shapes_j1.log memory_bram_shapes_j4.log memory_bram_shapes_j1.il memory_bram_shapes_j4.il
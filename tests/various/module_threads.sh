@@ -0,0 +1,39 @@
+#!/bin/bash
+
+trap 'echo "ERROR in module_threads.sh" >&2; exit 1' ERR
+
+cat > module_threads.v << "EOT"
+module sub1(input [7:0] a, b, output [7:0] x, y);
+	assign x = a + b;
+	assign y = a + b;
+endmodule
+
+module sub2(input [7:0] a, b, output [7:0] x, y);
+	assign x = a & b;
+	assign y = (a & b) ^ (a & b);
+endmodule
+
+module sub3(input clk, input [7:0] a, b, output reg [7:0] x, y);
+	always @(posedge clk) begin
+		x <= a - b;
+		y <= a - b;
+	end
+endmodule
+
+module top(input clk, input [7:0] a, b, output [7:0] x1, y1, x2, y2, x3, y3);
+	sub1 s1(.a(a), .b(b), .x(x1), .y(y1));
+	sub2 s2(.a(a), .b(b), .x(x2), .y(y2));
+	sub3 s3(.clk(clk), .a(a), .b(b), .x(x3), .y(y3));
+endmodule
+EOT
+
+for j in 1 4; do
+	../../yosys -q -j $j -p 'read_verilog module_threads.v; proc; opt_expr' \
+			-p 'tee -q -o module_threads_j'$j'.out opt_merge' \
+			-p 'write_ilang module_threads_j'$j'.il'
+done
+
+cmp module_threads_j1.out module_threads_j4.out
+cmp module_threads_j1.il module_threads_j4.il
+
+rm module_threads.v module_threads_j1.il module_threads_j4.il
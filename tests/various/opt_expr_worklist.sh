@@ -0,0 +1,23 @@
+#!/bin/bash
+
+trap 'echo "ERROR in opt_expr_worklist.sh" >&2; exit 1' ERR
+
+cat > opt_expr_worklist.v << "EOT2"
+module top(input [7:0] a, b, input s, output [7:0] x, y, z);
+	wire [7:0] t = a & 8'h00;
+	wire [7:0] u = t | b;
+	assign x = s ? u : u;
+	assign y = (u ^ u) + a;
+	assign z = !s ? ~(t + 8'h01) : b - 8'h00;
+endmodule
+EOT2
+
+# later iterations only visit the cells affected by earlier rewrites, with the
+# same result as visiting all cells in every iteration
+for mode in "" "-noincr"; do
+	../../yosys -p "read_verilog opt_expr_worklist.v; proc; gen_design -top big -cells 500 -seed 3" \
+			-p "opt_expr -full $mode; opt_clean" -p "tee -o opt_expr_worklist$mode.txt stat" > /dev/null
+done
+cmp opt_expr_worklist.txt opt_expr_worklist-noincr.txt
+
+rm -f opt_expr_worklist.v opt_expr_worklist.txt opt_expr_worklist-noincr.txt
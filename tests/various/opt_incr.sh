@@ -0,0 +1,31 @@
+#!/bin/bash
+
+trap 'echo "ERROR in opt_incr.sh" >&2; exit 1' ERR
+
+cat > opt_incr.v << "EOT2"
+module sub(input [7:0] a, output [7:0] y);
+	wire [7:0] t = a & 8'h0f;
+	assign y = t | (t & 8'h03);
+endmodule
+
+module top(input clk, input [7:0] a, b, output reg [7:0] y, z);
+	wire [7:0] s;
+	sub u(.a(a), .y(s));
+	always @(posedge clk) begin
+		y <= b ? s : s;
+		z <= (a == a) ? b : 8'h00;
+	end
+endmodule
+EOT2
+
+# later iterations only visit changed modules, with the same result as
+# running every iteration on the whole design
+for mode in "" "-noincr"; do
+	../../yosys -p "read_verilog opt_incr.v; proc; gen_design -top big -cells 500 -seed 2" \
+			-p "opt $mode" -p "tee -o opt_incr_stat$mode.txt stat" > opt_incr$mode.log
+done
+grep -q "Visiting .* modules that changed in the last iteration" opt_incr.log
+if grep -q "Visiting" opt_incr-noincr.log; then false; fi
+cmp opt_incr_stat.txt opt_incr_stat-noincr.txt
+
+rm -f opt_incr.v opt_incr.log opt_incr-noincr.log opt_incr_stat.txt opt_incr_stat-noincr.txt
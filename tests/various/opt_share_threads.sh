@@ -0,0 +1,44 @@
+#!/bin/bash
+
+trap 'echo "ERROR in opt_share_threads.sh" >&2; exit 1' ERR
+
+cat > opt_share_threads.v << "EOT"
+module sub #(parameter N = 0) (input [1:0] s, t, input [7:0] a, b, c, output reg [7:0] y, z, w);
+	always @* begin
+		case (s)
+			0: y = a + b;
+			1: y = a - b;
+			2: y = a + c;
+			default: y = N;
+		endcase
+		case (t)
+			0: z = c >> a;
+			1: z = c >> b;
+			default: z = c >> N;
+		endcase
+		w = s[0] ? (c ^ a) : (c ^ b);
+	end
+endmodule
+
+module top(input [1:0] s, t, input [7:0] a, b, c, output [7:0] y1, z1, w1, y2, z2, w2, y3, z3, w3);
+	sub #(1) s1(.s(s), .t(t), .a(a), .b(b), .c(c), .y(y1), .z(z1), .w(w1));
+	sub #(2) s2(.s(t), .t(s), .a(b), .b(c), .c(a), .y(y2), .z(z2), .w(w2));
+	sub #(3) s3(.s(s), .t(s), .a(c), .b(a), .c(b), .y(y3), .z(z3), .w(w3));
+endmodule
+EOT
+
+# the log and the netlists (including the names of new cells and wires) must
+# not depend on the thread timing
+for j in 1 4; do
+	../../yosys -q -j $j -p 'read_verilog opt_share_threads.v; hierarchy -top top; proc; opt_clean; alumacc; design -save pre' \
+			-p 'tee -q -o opt_share_threads_j'$j'.log opt_share' \
+			-p 'opt_clean; tee -q -a opt_share_threads_j'$j'.log stat; write_ilang opt_share_threads_j'$j'.il' \
+			-p 'flatten; design -stash post; design -load pre; flatten; rename top gold; design -copy-from post -as gate top' \
+			-p 'miter -equiv -flatten -ignore_gold_x -make_outputs gold gate miter; sat -set-def-inputs -verify -prove trigger 0 miter'
+done
+
+cmp opt_share_threads_j1.log opt_share_threads_j4.log
+cmp opt_share_threads_j1.il opt_share_threads_j4.il
+grep -q "Found cells that share an operand" opt_share_threads_j4.log
+
+rm opt_share_threads.v opt_share_threads_j[14].log opt_share_threads_j[14].il
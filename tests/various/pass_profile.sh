@@ -0,0 +1,22 @@
+#!/bin/bash
+
+trap 'echo "ERROR in pass_profile.sh" >&2; exit 1' ERR
+
+cat > pass_profile.v << "EOT"
+module top(input clk, input [7:0] a, b, output reg [7:0] y);
+	always @(posedge clk)
+		y <= a * b;
+endmodule
+EOT
+
+../../yosys -q -B pass_profile.json -p "read_verilog pass_profile.v; synth -top top"
+
+# top-level commands with their arguments, and nested calls of synth
+grep -q '"traceEvents": \[' pass_profile.json
+grep -q '"name": "synth", .*"command": "synth -top top", "depth": 0' pass_profile.json
+grep -q '"name": "opt_clean", .*"depth": 2' pass_profile.json
+grep -q '"name": "read_verilog", .*"depth": 0' pass_profile.json
+grep -q '"synth": {"calls": 1' pass_profile.json
+if grep -q '"name": "read_verilog", .*"depth": 1' pass_profile.json; then false; fi
+
+rm -f pass_profile.v pass_profile.json
@@ -0,0 +1,45 @@
+#!/bin/bash
+
+trap 'echo "ERROR in pmux_threads.sh" >&2; exit 1' ERR
+
+cat > pmux_threads.v << "EOT"
+module sub #(parameter N = 0) (input [2:0] s, input [7:0] a, b, output reg [7:0] y, z);
+	always @* begin
+		case (s)
+			0: y = a;
+			1: y = b;
+			2: y = a + N;
+			3: y = b - N;
+			4: y = a;
+			5: y = b;
+			default: y = 0;
+		endcase
+		case (s)
+			0, 2: z = a;
+			3, 7: z = a;
+			default: z = b ^ N;
+		endcase
+	end
+endmodule
+
+module top(input [2:0] s, input [7:0] a, b, output [7:0] y1, z1, y2, z2, y3, z3);
+	sub #(1) s1(.s(s), .a(a), .b(b), .y(y1), .z(z1));
+	sub #(2) s2(.s(s), .a(b), .b(a), .y(y2), .z(z2));
+	sub #(3) s3(.s(s), .a(a), .b(a), .y(y3), .z(z3));
+endmodule
+EOT
+
+# the log and the netlists (including the names of new cells and wires) must
+# not depend on the thread timing
+for j in 1 4; do
+	../../yosys -q -j $j -p 'read_verilog pmux_threads.v; hierarchy -top top; proc; opt_clean' \
+			-p 'tee -q -o pmux_threads_j'$j'.log opt_reduce -fine' \
+			-p 'tee -q -a pmux_threads_j'$j'.log pmux2shiftx -v' \
+			-p 'opt_clean; tee -q -a pmux_threads_j'$j'.log stat' \
+			-p 'write_ilang pmux_threads_j'$j'.il'
+done
+
+cmp pmux_threads_j1.log pmux_threads_j4.log
+cmp pmux_threads_j1.il pmux_threads_j4.il
+
+rm pmux_threads.v pmux_threads_j[14].log pmux_threads_j[14].il
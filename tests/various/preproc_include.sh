@@ -0,0 +1,33 @@
+#!/bin/bash
+
+trap 'echo "ERROR in preproc_include.sh" >&2; exit 1' ERR
+
+cat > preproc_include.vh << "EOT"
+// guarded header, skipped when included again
+`ifndef PREPROC_INCLUDE_VH
+`define PREPROC_INCLUDE_VH
+`define WIDTH 8
+`endif
+EOT
+
+cat > preproc_include_1.v << "EOT"
+`include "preproc_include.vh"
+`include "preproc_include.vh"
+module add1(input [`WIDTH-1:0] a, b, output [`WIDTH-1:0] y);
+	assign y = a + b;
+endmodule
+EOT
+
+cat > preproc_include_2.v << "EOT"
+`include "preproc_include.vh"
+module add2(input [`WIDTH-1:0] a, b, output [`WIDTH-1:0] y);
+	assign y = a + b;
+endmodule
+EOT
+
+# the cached header is read again after it changed on disk
+../../yosys -q -p "read_verilog preproc_include_1.v preproc_include_2.v; select -assert-count 2 t:\$add r:Y_WIDTH=8 %i" \
+	-p "! sed -i 's/WIDTH 8/WIDTH 16/' preproc_include.vh" \
+	-p "design -reset; verilog_defines -reset; read_verilog preproc_include_1.v preproc_include_2.v; select -assert-count 2 t:\$add r:Y_WIDTH=16 %i"
+
+rm preproc_include.vh preproc_include_1.v preproc_include_2.v
@@ -0,0 +1,42 @@
+#!/bin/bash
+
+trap 'echo "ERROR in proc_mux_threads.sh" >&2; exit 1' ERR
+
+cat > proc_mux_threads.v << "EOT"
+module sub(input clk, input [1:0] s, input [7:0] a, b, output reg [7:0] x, y);
+	always @(posedge clk)
+		case (s)
+			0: x <= a;
+			1: x <= b;
+			2: x <= a + b;
+		endcase
+	always @*
+		if (s[0]) y = a ^ b; else if (s[1]) y = a; else y = 0;
+endmodule
+
+module top(input clk, input [1:0] s, input [7:0] a, b, output reg [7:0] x, y, z, output [7:0] x1, y1);
+	sub u(.clk(clk), .s(s), .a(a), .b(b), .x(x1), .y(y1));
+	always @(posedge clk) begin
+		x <= s[0] ? a : b;
+		if (s == 3) y <= a - b;
+	end
+	always @*
+		casez (s)
+			2'b1?: z = a;
+			2'b01: z = b;
+			default: z = 8'hff;
+		endcase
+endmodule
+EOT
+
+# processes are converted concurrently, but the result and the log must be
+# the same as with a single thread
+for j in 1 4; do
+	../../yosys -j $j -p 'read_verilog proc_mux_threads.v' -p 'tee -o proc_mux_threads_j'$j'.log proc' \
+			-p 'write_ilang proc_mux_threads_j'$j'.il' > /dev/null
+done
+
+cmp proc_mux_threads_j1.log proc_mux_threads_j4.log
+cmp proc_mux_threads_j1.il proc_mux_threads_j4.il
+
+rm proc_mux_threads.v proc_mux_threads_j1.log proc_mux_threads_j4.log proc_mux_threads_j1.il proc_mux_threads_j4.il
@@ -0,0 +1,30 @@
+#!/bin/bash
+
+trap 'echo "ERROR in protobuf.sh" >&2; exit 1' ERR
+
+# protobuf support is optional (ENABLE_PROTOBUF)
+if ! ../../yosys -q -p 'help read_protobuf' > /dev/null 2>&1; then
+	echo "Skipping protobuf.sh (no protobuf support)"
+	exit 0
+fi
+
+cat > protobuf.v << "EOT"
+module sub(input [3:0] b, a, output [3:0] y);
+	assign y = a & ~b;
+endmodule
+module top(input [3:0] x, z, output [3:0] y, output w);
+	sub u(x, z, y);
+	assign w = ^y;
+	(* keep *) wire [39:0] c = 40'h1234567890;
+endmodule
+EOT
+
+../../yosys -q -p 'read_verilog protobuf.v; hierarchy -top top; proc; opt_clean; write_protobuf protobuf.pb' \
+	-p 'flatten; design -stash gold' \
+	-p 'read_protobuf protobuf.pb; hierarchy -top top' \
+	-p 'select -assert-count 1 top/u; select -assert-count 1 top/c a:keep %i; select -assert-count 2 sub/i:*' \
+	-p 'flatten; design -stash gate' \
+	-p 'design -copy-from gold -as gold top; design -copy-from gate -as gate top' \
+	-p 'equiv_make gold gate equiv; equiv_simple; equiv_status -assert'
+
+rm -f protobuf.v protobuf.pb
@@ -0,0 +1,37 @@
+#!/bin/bash
+
+trap 'echo "ERROR in read_ilang.sh" >&2; exit 1' ERR
+
+cat > read_ilang.v << "EOT"
+module sub #(parameter W = 4) (input [W-1:0] a, output [W-1:0] y);
+	assign y = ~a;
+endmodule
+
+module top(input clk, input [3:0] addr, input [7:0] din, input we, output reg [7:0] dout, output [3:0] n);
+	(* keep *) reg [7:0] mem [0:15];
+	(* str = "a\tb\"c" *) wire [0:3] rev = {addr[1:0], 2'b1x};
+	always @(posedge clk) begin
+		if (we)
+			mem[addr] <= din;
+		case (addr)
+			4'b0000: dout <= 8'hx5;
+			4'b1zz1: dout <= mem[addr];
+			default: dout <= rev;
+		endcase
+	end
+	sub #(.W(4)) s(.a(addr), .y(n));
+endmodule
+EOT
+
+# the hand-written parser reads the same design as the bison parser,
+# also when the modules are parsed concurrently
+../../yosys -q -p "read_verilog read_ilang.v; write_ilang read_ilang_1.il" \
+	-p "design -reset; read_ilang -bison read_ilang_1.il; write_ilang read_ilang_2.il" \
+	-p "design -reset; read_ilang read_ilang_1.il; write_ilang read_ilang_3.il" \
+	-p "design -reset; read_ilang -j 2 read_ilang_1.il; write_ilang read_ilang_4.il"
+
+sed -i '/^# Generated by/d' read_ilang_2.il read_ilang_3.il read_ilang_4.il
+cmp read_ilang_2.il read_ilang_3.il
+cmp read_ilang_2.il read_ilang_4.il
+
+rm read_ilang.v read_ilang_1.il read_ilang_2.il read_ilang_3.il read_ilang_4.il
@@ -0,0 +1,29 @@
+#!/bin/bash
+
+trap 'echo "ERROR in read_top.sh" >&2; exit 1' ERR
+
+cat > read_top.v << "EOT"
+module leaf(input a, output y);
+	assign y = ~a;
+endmodule
+module mid(input a, output y);
+	leaf u(a, y);
+endmodule
+module other(input a, output y);
+	mid u(a, y);
+endmodule
+module top(input a, output y);
+	mid u(a, y);
+endmodule
+EOT
+
+../../yosys -q -p 'read_verilog read_top.v; write_ilang read_top.il; write_json read_top.json'
+
+# only the modules below the top modules are loaded
+../../yosys -q -p 'read_ilang -top top read_top.il; write_ilang read_top_1.il'
+test "$(grep '^module' read_top_1.il | sort | tr '\n' ' ')" = 'module \leaf module \mid module \top '
+
+../../yosys -q -p 'read_json -top mid -top other read_top.json; write_ilang read_top_2.il'
+test "$(grep '^module' read_top_2.il | sort | tr '\n' ' ')" = 'module \leaf module \mid module \other '
+
+if ../../yosys -q -p 'read_ilang -top nope read_top.il' 2> /dev/null; then false; fi
@@ -0,0 +1,30 @@
+#!/bin/bash
+
+trap 'echo "ERROR in read_verilog_prefetch.sh" >&2; exit 1' ERR
+
+cat > read_verilog_prefetch_1.v << "EOT"
+module sub1(input [7:0] a, b, output [7:0] y);
+	assign y = a + b;
+endmodule
+EOT
+
+cat > read_verilog_prefetch_2.v << "EOT"
+module sub2(input [7:0] a, b, output [7:0] y);
+	assign y = a ^ b;
+endmodule
+EOT
+
+cat > read_verilog_prefetch_3.v << "EOT"
+module top(input [7:0] a, b, output [7:0] x, y);
+	sub1 s1(.a(a), .b(b), .y(x));
+	sub2 s2(.a(a), .b(b), .y(y));
+endmodule
+EOT
+
+files="read_verilog_prefetch_1.v read_verilog_prefetch_2.v read_verilog_prefetch_3.v"
+../../yosys -q -p "read_verilog $files; hierarchy -top top; write_ilang read_verilog_prefetch_j0.il"
+../../yosys -q -p "read_verilog -j 2 $files; hierarchy -top top; write_ilang read_verilog_prefetch_j2.il"
+
+cmp read_verilog_prefetch_j0.il read_verilog_prefetch_j2.il
+
+rm $files read_verilog_prefetch_j0.il read_verilog_prefetch_j2.il
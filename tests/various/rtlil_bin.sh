@@ -0,0 +1,34 @@
+#!/bin/bash
+
+trap 'echo "ERROR in rtlil_bin.sh" >&2; exit 1' ERR
+
+cat > rtlil_bin.v << "EOT"
+module sub #(parameter W = 4) (input [W-1:0] a, output [W-1:0] y);
+	assign y = ~a;
+endmodule
+
+module top(input clk, input [3:0] addr, input [7:0] din, input we, output reg [7:0] dout, output [3:0] n);
+	(* keep *) reg [7:0] mem [0:15];
+	always @(posedge clk) begin
+		if (we)
+			mem[addr] <= din;
+		case (addr)
+			4'b0000: dout <= 8'hx5;
+			4'b1zz1: dout <= mem[addr];
+			default: dout <= 0;
+		endcase
+	end
+	sub #(.W(4)) s(.a(addr), .y(n));
+endmodule
+EOT
+
+# processes, memories, attributes, parameters and x/z constants survive a round trip
+../../yosys -q -p "read_verilog rtlil_bin.v; hierarchy -top top; write_ilang rtlil_bin_1.il; write_rtlil_bin rtlil_bin.bin" \
+	-p "design -reset; read_rtlil_bin rtlil_bin.bin; write_ilang rtlil_bin_2.il" \
+	-p "design -stash spilled -file rtlil_bin_spill.bin; design -load spilled; write_ilang rtlil_bin_3.il"
+
+sed -i '/^# Generated by/d' rtlil_bin_1.il rtlil_bin_2.il rtlil_bin_3.il
+cmp rtlil_bin_1.il rtlil_bin_2.il
+cmp rtlil_bin_1.il rtlil_bin_3.il
+
+rm rtlil_bin.v rtlil_bin.bin rtlil_bin_spill.bin rtlil_bin_1.il rtlil_bin_2.il rtlil_bin_3.il
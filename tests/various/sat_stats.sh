@@ -0,0 +1,17 @@
+#!/bin/bash
+
+trap 'echo "ERROR in sat_stats.sh" >&2; exit 1' ERR
+
+cat > sat_stats.v << "EOT"
+module top(input [7:0] a, b, output [7:0] y1, y2);
+	assign y1 = a + b;
+	assign y2 = b + a * 8'd1;
+endmodule
+EOT
+
+../../yosys -p 'read_verilog sat_stats.v; proc; sat -verify -prove y1 y2 -stats' > sat_stats.log
+grep -q "SAT solver statistics:" sat_stats.log
+grep -q "^ *1 solver calls" sat_stats.log
+
+../../yosys -p 'read_verilog sat_stats.v; proc; freduce -stats' > sat_stats.log
+grep -q "SAT solver statistics:" sat_stats.log
@@ -0,0 +1,27 @@
+#!/bin/bash
+
+trap 'echo "ERROR in scc_ltp.sh" >&2; exit 1' ERR
+
+cat > scc_ltp.v << "EOT"
+module top(input i, output o, p);
+	wire x, y, z, f, c1, c2;
+	\$_AND_ a (.A(i), .B(y), .Y(x));
+	\$_AND_ b (.A(x), .B(z), .Y(y));
+	\$_NOT_ c (.A(y), .Y(z));
+	\$_OR_ d (.A(i), .B(f), .Y(f));
+	\$_NOT_ n1 (.A(i), .Y(c1));
+	\$_NOT_ n2 (.A(c1), .Y(c2));
+	\$_NOT_ n3 (.A(c2), .Y(p));
+	assign o = z ^ f;
+endmodule
+EOT
+
+# the loops through cell b form one SCC, cell d feeds back into itself
+../../yosys -q -p 'read_verilog -icells scc_ltp.v; proc; scc -expect 2; scc -nofeedback -expect 1' \
+		-p 'scc -select; select -assert-count 8 %; select -assert-count 4 % t:* %i'
+
+../../yosys -q -p 'read_verilog -icells scc_ltp.v; proc; select n1 n2 n3 i c1 c2 p; tee -o scc_ltp.log ltp'
+grep -q "length=3" scc_ltp.log
+grep -q "3: p (via n3)" scc_ltp.log
+
+rm -f scc_ltp.v scc_ltp.log
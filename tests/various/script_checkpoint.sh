@@ -0,0 +1,35 @@
+#!/bin/bash
+
+trap 'echo "ERROR in script_checkpoint.sh" >&2; exit 1' ERR
+
+cat > script_checkpoint.v << "EOT"
+module top(input clk, input [7:0] a, b, output reg [7:0] y);
+	always @(posedge clk)
+		y <= a * b + y;
+endmodule
+EOT
+
+rm -rf script_checkpoint.dir
+setup='read_verilog script_checkpoint.v; scratchpad -set script.checkpoint_dir script_checkpoint.dir'
+
+../../yosys -p "$setup; synth -noabc -top top" -l script_checkpoint_1.log > /dev/null
+test "$(grep -c 'Resuming synth' script_checkpoint_1.log)" = 0
+ls script_checkpoint.dir/synth-coarse-*.yrb script_checkpoint.dir/synth-fine-*.yrb script_checkpoint.dir/synth-check-*.yrb > /dev/null
+
+# the same script resumes at the last label
+../../yosys -p "$setup; synth -noabc -top top" -l script_checkpoint_2.log > /dev/null
+grep -q "Resuming synth at label \`check'" script_checkpoint_2.log
+grep 'Number of cells' script_checkpoint_1.log | tail -n 1 > script_checkpoint_1.txt
+grep 'Number of cells' script_checkpoint_2.log | tail -n 1 > script_checkpoint_2.txt
+cmp script_checkpoint_1.txt script_checkpoint_2.txt
+
+# an option that only changes the commands of the 'fine' label
+../../yosys -p "$setup; synth -top top" -l script_checkpoint_3.log > /dev/null
+grep -q "Resuming synth at label \`fine'" script_checkpoint_3.log
+
+# a different input design does not use the checkpoints
+sed -i 's/a \* b/a - b/' script_checkpoint.v
+../../yosys -p "$setup; synth -noabc -top top" -l script_checkpoint_4.log > /dev/null
+test "$(grep -c 'Resuming synth' script_checkpoint_4.log)" = 0
+
+rm -rf script_checkpoint.v script_checkpoint.dir script_checkpoint_[1234].log script_checkpoint_[12].txt
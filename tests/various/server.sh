@@ -0,0 +1,50 @@
+#!/bin/bash
+
+trap 'echo "ERROR in server.sh" >&2; exit 1' ERR
+
+rm -f server.sock server.log
+cat > server.v << "EOT"
+module top(input [7:0] a, b, output [7:0] y);
+	assign y = a + b;
+endmodule
+EOT
+
+# three requests; the last one deletes the design in its own process only
+../../yosys -q -l server.log -p 'read_verilog server.v; design -save base' \
+		-p 'server -socket server.sock -n 3' -p 'select -assert-count 1 top/t:*' &
+server_pid=$!
+
+for i in $(seq 50); do
+	test -S server.sock && break
+	sleep 0.1
+done
+
+request() {
+	python3 -c '
+import socket, sys
+s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+s.connect("server.sock")
+s.sendall(sys.stdin.buffer.read())
+s.shutdown(socket.SHUT_WR)
+while True:
+	data = s.recv(4096)
+	if not data:
+		break
+	sys.stdout.buffer.write(data)
+'
+}
+
+echo 'synth -run coarse; select -assert-count 1 t:$alu' | request > server_1.out
+grep -q '^yosys-server: exit 0$' server_1.out
+
+printf 'design -load base\nselect -assert-count 2 t:*\n' | request > server_2.out
+grep -q '^yosys-server: exit 1$' server_2.out
+grep -q 'Assertion failed' server_2.out
+
+echo 'delete top' | request > server_3.out
+grep -q '^yosys-server: exit 0$' server_3.out
+
+wait $server_pid
+test ! -e server.sock
+
+rm -f server.v server.log server_[123].out
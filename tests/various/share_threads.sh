@@ -0,0 +1,32 @@
+#!/bin/bash
+
+trap 'echo "ERROR in share_threads.sh" >&2; exit 1' ERR
+
+cat > share_threads.v << "EOT"
+module top(input [1:0] s, input t, input [7:0] a, b, c, d, output reg [15:0] y, output [15:0] z);
+	always @*
+		case (s)
+			0: y = a * b;
+			1: y = c * d;
+			2: y = a * d;
+			default: y = b * c;
+		endcase
+	assign z = t ? (a * c) : (b * d);
+endmodule
+EOT
+
+# the SAT problems are solved concurrently, but the result and the log must
+# be the same as with a single thread
+for j in 1 4; do
+	../../yosys -p 'read_verilog share_threads.v; proc; opt; wreduce' \
+			-p 'tee -o share_threads_j'$j'.log share -aggressive -j '$j \
+			-p 'write_ilang share_threads_j'$j'.il' > /dev/null
+done
+
+cmp share_threads_j1.log share_threads_j4.log
+cmp share_threads_j1.il share_threads_j4.il
+
+# without SAT problems only the pairs with contradicting patterns are shared
+../../yosys -q -p 'read_verilog share_threads.v; proc; opt; wreduce; share -aggressive -sat_limit 0; select -assert-max 3 t:$mul'
+
+rm share_threads.v share_threads_j1.log share_threads_j4.log share_threads_j1.il share_threads_j4.il
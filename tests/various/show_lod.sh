@@ -0,0 +1,30 @@
+#!/bin/bash
+
+trap 'echo "ERROR in show_lod.sh" >&2; exit 1' ERR
+
+cat > show_lod.v << "EOT"
+module sub(input [3:0] a, b, output [3:0] y);
+	wire [3:0] t = a & {b[1:0], a[3:2]};
+	assign y = ~t;
+endmodule
+
+module top(input [3:0] a, b, output [3:0] y, z);
+	sub u1 (.a(a), .b(b), .y(y));
+	sub u2 (.a(b), .b(a), .y(z));
+endmodule
+EOT
+
+../../yosys -q -p 'read_verilog show_lod.v; hierarchy -top top; proc; flatten' \
+		-p 'show -format dot -prefix show_lod_buses -buses' \
+		-p 'show -format dot -prefix show_lod_hier -cluster hier' \
+		-p 'show -format dot -prefix show_lod_collapse -cluster hier -collapse -maxfanout 1'
+
+# no splice boxes with -buses
+! grep -q 'style=rounded' show_lod_buses.dot
+grep -q 'subgraph cluster_k' show_lod_hier.dot
+grep -q 'shape=box3d, label="u1\\n2 cells"' show_lod_collapse.dot
+grep -q 'shape=box3d, label="u2\\n2 cells"' show_lod_collapse.dot
+grep -q 'label="[0-9]* more"' show_lod_collapse.dot
+! grep -q 'shape=record' show_lod_collapse.dot
+
+rm show_lod.v show_lod_*.dot
@@ -0,0 +1,61 @@
+#!/bin/bash
+
+trap 'echo "ERROR in sim_replay.sh" >&2; exit 1' ERR
+
+cat > sim_replay.v << "EOT"
+module top(input clk, input en, input [3:0] d, output reg [7:0] acc = 0);
+	always @(posedge clk)
+		if (en)
+			acc <= acc * 3 + d;
+endmodule
+EOT
+
+# a testbench trace with a whole-vector and a bit-select variable for d
+cat > sim_replay.vcd << "EOT"
+$timescale 1ns $end
+$scope module tb $end
+$var reg 1 ! clk $end
+$scope module dut $end
+$var wire 1 ! clk $end
+$var wire 1 " en $end
+$var wire 4 # d [3:0] $end
+$var wire 1 $ d [2] $end
+$upscope $end
+$upscope $end
+$enddefinitions $end
+#0
+$dumpvars
+0!
+1"
+b1 #
+$end
+#5
+1!
+#10
+0!
+b101 #
+#15
+1!
+#20
+0!
+0"
+#25
+1!
+#30
+0!
+1"
+0$
+#35
+1!
+#40
+EOT
+
+# acc: 1, 3+5 = 8, 8, 24+1 = 25; the -vcd output of the replay can be
+# replayed again, its scope is the top module
+../../yosys -q -p "read_verilog sim_replay.v; proc; design -save orig" \
+	-p "sim -r sim_replay.vcd -scope tb.dut -vcd sim_replay_out.vcd -w" \
+	-p "sat -seq 1 -set-init-attr -prove acc 25 -verify" \
+	-p "design -load orig; sim -r sim_replay_out.vcd -w" \
+	-p "sat -seq 1 -set-init-attr -prove acc 25 -verify"
+
+rm sim_replay.v sim_replay.vcd sim_replay_out.vcd
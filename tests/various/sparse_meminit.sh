@@ -0,0 +1,28 @@
+#!/bin/bash
+
+trap 'echo "ERROR in sparse_meminit.sh" >&2; exit 1' ERR
+
+cat > sparse_meminit.v << "EOT"
+module top(input clk, input [11:0] addr, output reg [31:0] data);
+	reg [31:0] mem [0:4095];
+	initial begin
+		mem[5] = 32'd5;
+		mem[4000] = 32'hzzzzzzzz;
+		mem[4001] = 32'h1234xxxx;
+	end
+	always @(posedge clk)
+		data <= mem[addr];
+endmodule
+EOT
+
+# only the initialized words are written, the others are x anyway
+../../yosys -q -p 'read_verilog sparse_meminit.v; proc; memory -nomap' \
+		-p 'write_verilog -noattr sparse_meminit_1.v; write_ilang sparse_meminit_1.il'
+test $(grep -c "mem\[.*\] = " sparse_meminit_1.v) = 3
+grep -q "mem\[4000\] = 32'hzzzzzzzz;" sparse_meminit_1.v
+
+# the init value survives a round trip through the sparse Verilog output
+../../yosys -q -p 'read_verilog sparse_meminit_1.v; proc; memory -nomap; write_ilang sparse_meminit_2.il'
+grep "parameter .INIT" sparse_meminit_1.il > sparse_meminit_1.out
+grep "parameter .INIT" sparse_meminit_2.il > sparse_meminit_2.out
+cmp sparse_meminit_1.out sparse_meminit_2.out
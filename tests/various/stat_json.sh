@@ -0,0 +1,37 @@
+#!/bin/bash
+
+trap 'echo "ERROR in stat_json.sh" >&2; exit 1' ERR
+
+cat > stat_json.v << "EOT"
+module leaf(input a, b, output y);
+	assign y = a & b;
+endmodule
+
+module mid(input a, b, output y);
+	wire t;
+	leaf l0 (.a(a), .b(b), .y(t));
+	leaf l1 (.a(t), .b(b), .y(y));
+endmodule
+
+(* top *)
+module top(input a, b, output y);
+	wire t;
+	mid m0 (.a(a), .b(b), .y(t));
+	mid m1 (.a(t), .b(b), .y(y));
+endmodule
+EOT
+
+../../yosys -q -p 'read_verilog stat_json.v; proc; techmap' \
+		-p 'tee -q -o stat_json.out stat -json'
+
+python3 -c '
+import json
+stat = json.load(open("stat_json.out"))
+assert stat["modules"]["\\leaf"]["num_cells_by_type"] == {"$_AND_": 1}
+assert stat["modules"]["\\top"]["num_cells"] == 2
+assert stat["design"]["top"] == "\\top"
+assert stat["design"]["totals"]["num_cells"] == 4
+assert stat["design"]["totals"]["num_cells_by_type"] == {"$_AND_": 4}
+'
+
+rm stat_json.v
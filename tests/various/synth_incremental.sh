@@ -0,0 +1,38 @@
+#!/bin/bash
+
+trap 'echo "ERROR in synth_incremental.sh" >&2; exit 1' ERR
+
+cat > synth_incremental.v << "EOT"
+module sub(input [3:0] a, b, output [3:0] y);
+	assign y = a + b;
+endmodule
+module top(input [3:0] a, b, c, output [3:0] y);
+	wire [3:0] t;
+	sub s(.a(a), .b(b), .y(t));
+	assign y = t ^ c;
+endmodule
+EOT
+
+rm -rf synth_incremental.dir
+script='read_verilog synth_incremental.v; synth -top top -incremental synth_incremental.dir'
+
+../../yosys -p "$script" -l synth_incremental_1.log > /dev/null
+grep -q 'Found 0 of 2 modules in the cache' synth_incremental_1.log
+
+../../yosys -p "$script" -l synth_incremental_2.log > /dev/null
+grep -q 'Found 2 of 2 modules in the cache' synth_incremental_2.log
+grep -A20 '=== design hierarchy ===' synth_incremental_1.log | grep 'Number of cells' > synth_incremental_1.txt
+grep -A20 '=== design hierarchy ===' synth_incremental_2.log | grep 'Number of cells' > synth_incremental_2.txt
+cmp synth_incremental_1.txt synth_incremental_2.txt
+
+# changing the body of a submodule keeps the cached parent
+sed -i 's/a + b/a - b/' synth_incremental.v
+../../yosys -p "$script" -l synth_incremental_3.log > /dev/null
+grep -q 'Found 1 of 2 modules in the cache' synth_incremental_3.log
+grep -q 'Module sub is not cached' synth_incremental_3.log
+
+# other options do not use the cached results
+../../yosys -p "$script -noalumacc" -l synth_incremental_4.log > /dev/null
+grep -q 'Found 0 of 2 modules in the cache' synth_incremental_4.log
+
+rm -rf synth_incremental.v synth_incremental.dir synth_incremental_[1234].log synth_incremental_[12].txt
@@ -0,0 +1,51 @@
+#!/bin/bash
+
+trap 'echo "ERROR in techmap_cache.sh" >&2; exit 1' ERR
+
+cat > techmap_cache.v << "EOT2"
+module top(input [3:0] a, b, output [3:0] x, y);
+	assign x = a & b;
+	assign y = a | b;
+endmodule
+EOT2
+
+cat > techmap_cache_map1.v << "EOT2"
+(* techmap_celltype = "$and" *)
+module map_and(A, B, Y);
+	parameter A_SIGNED = 0;
+	parameter B_SIGNED = 0;
+	parameter A_WIDTH = 1;
+	parameter B_WIDTH = 1;
+	parameter Y_WIDTH = 1;
+	input [A_WIDTH-1:0] A;
+	input [B_WIDTH-1:0] B;
+	output [Y_WIDTH-1:0] Y;
+	assign Y = ~(~A | ~B);
+endmodule
+EOT2
+
+# the second call reuses the map design and the template derived for $and
+../../yosys -p "read_verilog techmap_cache.v; design -save orig;
+		techmap -map techmap_cache_map1.v; select -assert-count 0 t:\$and;
+		design -load orig; techmap -map techmap_cache_map1.v; select -assert-count 0 t:\$and;
+		techmap_cache -list" > techmap_cache.log
+grep -q "Using map design from an earlier techmap call (used 1 time before)" techmap_cache.log
+grep -q "techmap_cache_map1.v.*used 2 times" techmap_cache.log
+
+# a changed map file is read again, and -nocache always reads it
+cat > techmap_cache.ys << "EOT2"
+read_verilog techmap_cache.v
+design -save orig
+techmap -map techmap_cache_map1.v
+design -load orig
+!sed -i 's/~(~A | ~B)/A ^ B/' techmap_cache_map1.v
+techmap -map techmap_cache_map1.v
+select -assert-count 1 t:$xor
+design -load orig
+techmap -nocache -map techmap_cache_map1.v
+select -assert-count 1 t:$xor
+EOT2
+../../yosys techmap_cache.ys > techmap_cache.log
+if grep -q "Using map design from an earlier" techmap_cache.log; then false; fi
+
+rm -f techmap_cache.ys techmap_cache.v techmap_cache_map1.v techmap_cache.log
@@ -0,0 +1,33 @@
+#!/bin/bash
+
+trap 'echo "ERROR in techmap_gates_threads.sh" >&2; exit 1' ERR
+
+cat > techmap_gates_threads.v << "EOT"
+module sub #(parameter W = 8) (input clk, input [W-1:0] a, b, output reg [W-1:0] x, output [W-1:0] y, output z);
+	always @(posedge clk)
+		x <= a ^ b;
+	assign y = a + b;
+	assign z = |(a & b);
+endmodule
+
+module top(input clk, input [15:0] a, b, output [7:0] x1, y1, output [15:0] x2, y2, output z1, z2);
+	sub #(8) s1(.clk(clk), .a(a[7:0]), .b(b[7:0]), .x(x1), .y(y1), .z(z1));
+	sub #(16) s2(.clk(clk), .a(a), .b(b), .x(x2), .y(y2), .z(z2));
+endmodule
+EOT
+
+# the modules are mapped concurrently, the log and the netlists (including the
+# names of the new cells and wires) must not depend on the thread timing
+for j in 1 4; do
+	../../yosys -q -j $j -p 'read_verilog techmap_gates_threads.v; hierarchy -top top; proc; opt_clean' \
+			-p 'tee -q -o techmap_gates_threads_j'$j'.log simplemap' \
+			-p 'select */t:$add; tee -q -a techmap_gates_threads_j'$j'.log aigmap -select' \
+			-p 'tee -q -a techmap_gates_threads_j'$j'.log select -count %' \
+			-p 'select -clear; opt_clean; tee -q -a techmap_gates_threads_j'$j'.log stat' \
+			-p 'write_ilang techmap_gates_threads_j'$j'.il'
+done
+
+cmp techmap_gates_threads_j1.log techmap_gates_threads_j4.log
+cmp techmap_gates_threads_j1.il techmap_gates_threads_j4.il
+
+rm techmap_gates_threads.v techmap_gates_threads_j[14].log techmap_gates_threads_j[14].il
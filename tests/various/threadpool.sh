@@ -0,0 +1,50 @@
+#!/bin/bash
+
+trap 'echo "ERROR in threadpool.sh" >&2; exit 1' ERR
+
+cat > threadpool.v << "EOT"
+module sub1(input clk, input [7:0] a, b, output reg [7:0] x, y);
+	always @(posedge clk) begin
+		x <= a + b;
+		y <= a + b;
+	end
+endmodule
+
+module sub2(input [7:0] a, b, input [1:0] s, output reg [7:0] x, output [7:0] y);
+	always @* begin
+		case (s)
+			0: x = a;
+			1: x = b;
+			2: x = a & b;
+			default: x = a | b;
+		endcase
+	end
+	assign y = (a & b) ^ (a & b);
+endmodule
+
+module top(input clk, input [7:0] a, b, input [1:0] s, output [7:0] x1, y1, x2, y2);
+	sub1 s1(.clk(clk), .a(a), .b(b), .x(x1), .y(y1));
+	sub2 s2(.a(a), .b(b), .s(s), .x(x2), .y(y2));
+endmodule
+EOT
+
+# the worker threads of all passes come from one pool, YOSYS_THREADS sets
+# the default size, the output is the same as with a single thread
+run() {
+	../../yosys -q "$@" -p 'read_verilog threadpool.v; hierarchy -top top' \
+			-p 'tee -q -o threadpool_'$name'.log proc; tee -q -a threadpool_'$name'.log opt_merge' \
+			-p 'tee -q -a threadpool_'$name'.log simplemap; tee -q -a threadpool_'$name'.log stat' \
+			-p 'write_verilog -noattr threadpool_'$name'.v; write_json threadpool_'$name'.json; write_ilang threadpool_'$name'.il'
+}
+
+name=j1 run -j 1
+name=j4 run -j 4
+name=env YOSYS_THREADS=4 run
+
+for name in j4 env; do
+	for ext in log v json il; do
+		cmp threadpool_j1.$ext threadpool_$name.$ext
+	done
+done
+
+rm -f threadpool.v threadpool_*.log threadpool_*.v threadpool_*.json threadpool_*.il
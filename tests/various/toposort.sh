@@ -0,0 +1,22 @@
+#!/bin/bash
+
+trap 'echo "ERROR in toposort.sh" >&2; exit 1' ERR
+
+cat > toposort.v << "EOT"
+module top(input i, output o);
+	wire x, y, z;
+	\$_AND_ a (.A(i), .B(y), .Y(x));
+	\$_AND_ b (.A(x), .B(z), .Y(y));
+	\$_NOT_ c (.A(y), .Y(z));
+	\$_NOT_ d (.A(z), .Y(o));
+endmodule
+EOT
+
+../../yosys -q -p 'read_verilog -icells toposort.v; torder; tee -o toposort.log torder'
+
+# the two loops through cell b are reported as one strongly connected component
+test $(grep -c "loop" toposort.log) -eq 1
+grep -q "^  loop a b c$" toposort.log
+test "$(grep "^  cell" toposort.log | tr -d '\n')" = "  cell c  cell b  cell a  cell d"
+
+rm -f toposort.v toposort.log
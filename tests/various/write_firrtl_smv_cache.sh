@@ -0,0 +1,51 @@
+#!/bin/bash
+
+trap 'echo "ERROR in write_firrtl_smv_cache.sh" >&2; exit 1' ERR
+
+rm -rf write_firrtl_smv_cache.dir
+
+cat > write_firrtl_smv_cache.v << "EOT"
+module leaf(input clk, input [7:0] a, b, output reg [7:0] y);
+	wire [7:0] t = (a + b) ^ a;
+	always @(posedge clk)
+		y <= t & b;
+endmodule
+
+module mid(input clk, input [7:0] a, b, output [7:0] y);
+	wire [7:0] t;
+	leaf l0 (.clk(clk), .a(a), .b(b), .y(t));
+	leaf l1 (.clk(clk), .a(t), .b(a), .y(y));
+endmodule
+
+module top(input clk, input [7:0] a, b, output [7:0] y);
+	wire [7:0] t;
+	mid m0 (.clk(clk), .a(a), .b(b), .y(t));
+	mid m1 (.clk(clk), .a(t), .b(b), .y(y));
+endmodule
+EOT
+
+# modules written concurrently end up in the same order
+../../yosys -q -p "read_verilog write_firrtl_smv_cache.v; hierarchy -top top; proc; opt_clean" \
+	-p "write_firrtl -j 1 write_firrtl_smv_cache_1.fir; write_firrtl -j 4 write_firrtl_smv_cache_2.fir" \
+	-p "write_smv -j 1 write_firrtl_smv_cache_1.smv; write_smv -j 4 write_firrtl_smv_cache_2.smv"
+cmp write_firrtl_smv_cache_1.fir write_firrtl_smv_cache_2.fir
+cmp write_firrtl_smv_cache_1.smv write_firrtl_smv_cache_2.smv
+
+# the second run takes every module from the cache directory
+for i in 3 4; do
+	../../yosys -p "read_verilog write_firrtl_smv_cache.v; hierarchy -top top; proc; opt_clean" \
+		-p "write_firrtl -cache write_firrtl_smv_cache.dir write_firrtl_smv_cache_$i.fir" \
+		-p "write_smv -cache write_firrtl_smv_cache.dir write_firrtl_smv_cache_$i.smv" > write_firrtl_smv_cache_$i.log
+	cmp write_firrtl_smv_cache_1.fir write_firrtl_smv_cache_$i.fir
+	cmp write_firrtl_smv_cache_1.smv write_firrtl_smv_cache_$i.smv
+done
+test $(grep -c "from the cache" write_firrtl_smv_cache_3.log) = 0
+test $(grep -c "from the cache" write_firrtl_smv_cache_4.log) = 6
+
+# after a change only the changed module is written again
+../../yosys -p "read_verilog write_firrtl_smv_cache.v; hierarchy -top top; proc; opt_clean" \
+	-p "rename -hide top/t; write_firrtl -cache write_firrtl_smv_cache.dir write_firrtl_smv_cache_5.fir" \
+	-p "write_smv -cache write_firrtl_smv_cache.dir write_firrtl_smv_cache_5.smv" > write_firrtl_smv_cache_5.log
+test $(grep -c "from the cache" write_firrtl_smv_cache_5.log) = 4
+
+rm -rf write_firrtl_smv_cache.dir write_firrtl_smv_cache.v write_firrtl_smv_cache_*.fir write_firrtl_smv_cache_*.smv write_firrtl_smv_cache_*.log
@@ -0,0 +1,29 @@
+#!/bin/bash
+
+trap 'echo "ERROR in write_ilang_threads.sh" >&2; exit 1' ERR
+
+cat > write_ilang_threads.v << "EOT"
+module sub #(parameter W = 4) (input clk, input [W-1:0] a, b, output reg [W-1:0] y);
+	(* keep, src = "\"quoted\"\tname" *)
+	wire [W-1:0] t = a + b;
+	always @(posedge clk)
+		if (a[0])
+			y <= t ^ {W{1'bx}};
+endmodule
+
+module top(input clk, input [7:0] a, b, output [7:0] y1, y2, output [15:0] y3);
+	sub #(.W(8)) s1(.clk(clk), .a(a), .b(b), .y(y1));
+	sub #(.W(8)) s2(.clk(clk), .a(b), .b(a), .y(y2));
+	sub #(.W(16)) s3(.clk(clk), .a({a, b}), .b({b, a}), .y(y3));
+endmodule
+EOT
+
+# modules written concurrently end up in the same order, and the output reads back
+../../yosys -q -p "read_verilog write_ilang_threads.v; hierarchy -top top" \
+	-p "write_ilang -j 1 write_ilang_threads_1.il; write_ilang -j 4 write_ilang_threads_2.il"
+cmp write_ilang_threads_1.il write_ilang_threads_2.il
+
+../../yosys -q -p "read_ilang write_ilang_threads_2.il; write_ilang -j 4 write_ilang_threads_3.il"
+cmp write_ilang_threads_1.il write_ilang_threads_3.il
+
+rm write_ilang_threads.v write_ilang_threads_1.il write_ilang_threads_2.il write_ilang_threads_3.il
@@ -0,0 +1,30 @@
+#!/bin/bash
+
+trap 'echo "ERROR in write_json_threads.sh" >&2; exit 1' ERR
+
+cat > write_json_threads.v << "EOT"
+module sub #(parameter W = 4) (input clk, input [W-1:0] a, b, output reg [W-1:0] y);
+	always @(posedge clk)
+		y <= (a + b) ^ 32'h1234_5678;
+endmodule
+
+module top(input clk, input [7:0] a, b, output [7:0] y1, y2, output [15:0] y3);
+	sub #(.W(8)) s1(.clk(clk), .a(a), .b(b), .y(y1));
+	sub #(.W(8)) s2(.clk(clk), .a(b), .b(a), .y(y2));
+	sub #(.W(16)) s3(.clk(clk), .a({a, b}), .b({b, a}), .y(y3));
+endmodule
+EOT
+
+rm -rf write_json_threads.dir
+
+# concurrent output is the same as serial output, and split modules read back
+../../yosys -q -p "read_verilog write_json_threads.v; hierarchy -top top; synth" \
+	-p "write_json -aig -j 1 write_json_threads_1.json; write_json -aig -j 4 write_json_threads_2.json" \
+	-p "write_json -split write_json_threads.dir -j 4 write_json_threads_index.json" \
+	-p "design -reset; read_json write_json_threads.dir/top.json; read_json write_json_threads.dir/_paramod_sub_W_8.json" \
+	-p "read_json write_json_threads.dir/_paramod_sub_W_16.json; hierarchy -check -top top; select -assert-count 3 top/t:\$paramod*"
+
+cmp write_json_threads_1.json write_json_threads_2.json
+grep -q '"top": "top.json"' write_json_threads_index.json
+
+rm -rf write_json_threads.v write_json_threads_1.json write_json_threads_2.json write_json_threads_index.json write_json_threads.dir
@@ -0,0 +1,26 @@
+#!/bin/bash
+
+trap 'echo "ERROR in write_netlist_threads.sh" >&2; exit 1' ERR
+
+cat > write_netlist_threads.v << "EOT"
+module sub #(parameter W = 4) (input clk, input [W-1:0] a, b, output reg [W-1:0] y);
+	always @(posedge clk)
+		y <= (a + b) ^ {W{1'b1}};
+endmodule
+
+module top(input clk, input [7:0] a, b, output [7:0] y1, y2, output [15:0] y3);
+	sub #(.W(8)) s1(.clk(clk), .a(a), .b(b), .y(y1));
+	sub #(.W(8)) s2(.clk(clk), .a(b), .b(a), .y(y2));
+	sub #(.W(16)) s3(.clk(clk), .a({a, b}), .b({b, a}), .y(y3));
+endmodule
+EOT
+
+# modules written concurrently end up in the same order and with the same names
+for fmt in blif edif spice; do
+	../../yosys -q -p "read_verilog write_netlist_threads.v; hierarchy -top top; synth -run begin:fine; techmap; opt -fast" \
+		-p "write_$fmt -j 1 write_netlist_threads_1.$fmt; write_$fmt -j 4 write_netlist_threads_2.$fmt"
+	cmp write_netlist_threads_1.$fmt write_netlist_threads_2.$fmt
+	rm write_netlist_threads_1.$fmt write_netlist_threads_2.$fmt
+done
+
+rm write_netlist_threads.v
@@ -0,0 +1,37 @@
+#!/bin/bash
+
+trap 'echo "ERROR in write_smt2_threads.sh" >&2; exit 1' ERR
+
+cat > write_smt2_threads.v << "EOT"
+module sub1(input clk, input [7:0] a, output reg [7:0] y);
+	always @(posedge clk)
+		y <= a + 8'd1;
+endmodule
+
+module sub2(input clk, input [7:0] a, output reg [7:0] y);
+	always @(negedge clk)
+		y <= a ^ 8'h5a;
+endmodule
+
+module sub3(input [7:0] a, output [7:0] y);
+	assign y = ~a;
+endmodule
+
+module top(input clk, input [7:0] a, output [7:0] y1, y2, y3);
+	sub1 s1(.clk(clk), .a(a), .y(y1));
+	sub2 s2(.clk(clk), .a(a), .y(y2));
+	sub3 s3(.a(a), .y(y3));
+endmodule
+EOT
+
+# concurrent and incremental output is the same as serial output
+../../yosys -q -l write_smt2_threads.log -p "read_verilog write_smt2_threads.v; hierarchy -top top; proc; opt_clean" \
+	-p "write_smt2 -stbv -j 1 write_smt2_threads_1.smt2; write_smt2 -stbv -j 4 write_smt2_threads_2.smt2" \
+	-p "write_smt2 -stbv -incremental write_smt2_threads_3.smt2; write_smt2 -stbv -incremental write_smt2_threads_4.smt2"
+
+cmp write_smt2_threads_1.smt2 write_smt2_threads_2.smt2
+cmp write_smt2_threads_1.smt2 write_smt2_threads_3.smt2
+cmp write_smt2_threads_1.smt2 write_smt2_threads_4.smt2
+grep -q "Reusing SMT-LIBv2 representation of module top" write_smt2_threads.log
+
+rm -f write_smt2_threads.v write_smt2_threads.log write_smt2_threads_[1234].smt2
@@ -0,0 +1,41 @@
+#!/bin/bash
+
+trap 'echo "ERROR in write_table_columnar.sh" >&2; exit 1' ERR
+
+cat > write_table_columnar.v << "EOT"
+module sub(input [3:0] a, b, output [3:0] y);
+	assign y = a + b;
+endmodule
+
+module top(input [3:0] a, b, output [3:0] y1, y2);
+	sub s1 (.a(a), .b(b), .y(y1));
+	sub s2 (.a(b), .b(a), .y(y2));
+endmodule
+EOT
+
+../../yosys -q -p "read_verilog write_table_columnar.v; hierarchy -top top; proc; techmap; opt_clean" \
+	-p "write_table -j 1 write_table_columnar_1.txt; write_table -j 4 write_table_columnar_2.txt" \
+	-p "write_table -j 4 -columnar write_table_columnar.bin"
+cmp write_table_columnar_1.txt write_table_columnar_2.txt
+
+# the columnar file holds the same rows as the text table
+python3 -c '
+import struct
+data = open("write_table_columnar.bin", "rb").read()
+assert data[:8] == b"YSTBL\0\0\1"
+pos, rows = 8, []
+def read(n):
+	global pos
+	pos += 4*n
+	return struct.unpack_from("<%dI" % n, data, pos - 4*n)
+while pos < len(data):
+	num_rows, num_strings = read(2)
+	offsets = read(num_strings + 1)
+	strings = [data[pos+offsets[i]:pos+offsets[i+1]].decode() for i in range(num_strings)]
+	pos += (offsets[-1] + 3) // 4 * 4
+	columns = [read(num_rows) for i in range(6)]
+	rows += ["\t".join(strings[c[r]] for c in columns) for r in range(num_rows)]
+assert rows == open("write_table_columnar_1.txt").read().splitlines()
+'
+
+rm write_table_columnar.v write_table_columnar_1.txt write_table_columnar_2.txt write_table_columnar.bin
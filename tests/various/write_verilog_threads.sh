@@ -0,0 +1,25 @@
+#!/bin/bash
+
+trap 'echo "ERROR in write_verilog_threads.sh" >&2; exit 1' ERR
+
+cat > write_verilog_threads.v << "EOT"
+module sub #(parameter W = 4) (input clk, input [W-1:0] a, b, output reg [W-1:0] y);
+	always @(posedge clk)
+		y <= (a + b) ^ {W{1'bx}} ^ 32'h1234_5678;
+endmodule
+
+module top(input clk, input [7:0] a, b, output [7:0] y1, y2, output [15:0] y3);
+	sub #(.W(8)) s1(.clk(clk), .a(a), .b(b), .y(y1));
+	sub #(.W(8)) s2(.clk(clk), .a(b), .b(a), .y(y2));
+	sub #(.W(16)) s3(.clk(clk), .a({a, b}), .b({b, a}), .y(y3));
+endmodule
+EOT
+
+# modules dumped concurrently are written in the same order and with the same names
+../../yosys -q -p "read_verilog write_verilog_threads.v; hierarchy -top top; synth; write_verilog -j 1 write_verilog_threads_1.v; write_verilog -j 4 write_verilog_threads_2.v" \
+	-p "write_verilog -noexpr -j 1 write_verilog_threads_3.v; write_verilog -noexpr -j 4 write_verilog_threads_4.v"
+
+cmp write_verilog_threads_1.v write_verilog_threads_2.v
+cmp write_verilog_threads_3.v write_verilog_threads_4.v
+
+rm write_verilog_threads.v write_verilog_threads_1.v write_verilog_threads_2.v write_verilog_threads_3.v write_verilog_threads_4.v